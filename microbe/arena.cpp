@@ -0,0 +1,110 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "arena.h"
+
+#include <QtGlobal>
+
+#include <cstdlib>
+
+namespace MicrobeCompiler
+{
+
+/// Size of the blocks that memory is handed out from
+static const size_t BLOCK_SIZE = 64 * 1024;
+
+Arena * Arena::m_pCurrent = nullptr;
+
+
+//BEGIN class Arena
+Arena::Arena()
+{
+	m_pFree = nullptr;
+	m_freeSize = 0;
+	m_pPrevious = m_pCurrent;
+	m_pCurrent = this;
+}
+
+
+Arena::~Arena()
+{
+	Q_ASSERT( m_pCurrent == this );
+	m_pCurrent = m_pPrevious;
+
+	for ( char * block : m_blocks )
+		free( block );
+}
+
+
+size_t Arena::alignedSize( size_t size )
+{
+	const size_t alignment = alignof( std::max_align_t );
+	return qMax( ( size + alignment - 1 ) & ~( alignment - 1 ), alignment );
+}
+
+
+void * Arena::allocate( size_t size )
+{
+	size = alignedSize( size );
+
+	QHash< size_t, FreeSlot * >::iterator slot = m_freeSlots.find( size );
+	if ( slot != m_freeSlots.end() && *slot )
+	{
+		FreeSlot * p = *slot;
+		*slot = p->next;
+		return p;
+	}
+
+	if ( size > m_freeSize )
+	{
+		// Objects bigger than a block get a block of their own, leaving the
+		// unused part of the last block for the objects that follow
+		const size_t blockSize = qMax( size, BLOCK_SIZE );
+		char * block = static_cast<char*>( malloc( blockSize ) );
+		Q_CHECK_PTR( block );
+		m_blocks << block;
+
+		if ( blockSize > BLOCK_SIZE )
+			return block;
+
+		m_pFree = block;
+		m_freeSize = blockSize;
+	}
+
+	void * p = m_pFree;
+	m_pFree += size;
+	m_freeSize -= size;
+	return p;
+}
+
+
+void Arena::deallocate( void * p, size_t size )
+{
+	if ( !p )
+		return;
+
+	FreeSlot *& slot = m_freeSlots[ alignedSize( size ) ];
+	FreeSlot * freed = static_cast<FreeSlot*>( p );
+	freed->next = slot;
+	slot = freed;
+}
+//END class Arena
+
+}
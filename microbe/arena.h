@@ -0,0 +1,101 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <QHash>
+#include <QList>
+
+#include <cstddef>
+
+namespace MicrobeCompiler
+{
+
+/**
+Memory for the objects created while compiling a program - the nodes of the
+expression trees and the instructions of the code. Memory is handed out from
+large blocks, and memory given back is kept for objects of the same size, so
+that compiling allocates little from the heap. All the blocks are freed
+together when the arena is destroyed.
+
+Objects still alive when the arena is destroyed are not destructed; their
+memory is simply released. So nothing allocated from the arena may be used
+after the compilation that it belongs to.
+
+The arena being constructed most recently (and not yet destroyed) is the one
+that BTreeNode and Instruction are allocated from.
+*/
+class Arena
+{
+	public:
+		/**
+		 * Constructs the arena and makes it the current one.
+		 */
+		Arena();
+		/**
+		 * Frees all the memory of the arena, and makes the arena that was
+		 * current before this one was constructed current again.
+		 */
+		~Arena();
+		/**
+		 * @return the arena to allocate compilation objects from.
+		 */
+		static Arena * current() { return m_pCurrent; }
+		/**
+		 * @return memory for an object of the given size.
+		 */
+		void * allocate( size_t size );
+		/**
+		 * Gives back the memory of an object of the given size, for reuse by
+		 * the next object of that size.
+		 */
+		void deallocate( void * p, size_t size );
+
+	protected:
+		/**
+		 * Memory that has been given back, linked through its first bytes.
+		 */
+		struct FreeSlot
+		{
+			FreeSlot * next;
+		};
+
+		/**
+		 * @return size rounded up to the alignment of the allocations.
+		 */
+		static size_t alignedSize( size_t size );
+
+		QList<char*> m_blocks;
+		QHash< size_t, FreeSlot * > m_freeSlots; // Keyed by the aligned size
+		char * m_pFree; // Start of the unused part of the last block
+		size_t m_freeSize; // Size of the unused part of the last block
+		Arena * m_pPrevious;
+
+		static Arena * m_pCurrent;
+
+	private:
+		Arena( const Arena & );
+		Arena & operator = ( const Arena & );
+};
+
+}
+
+#endif
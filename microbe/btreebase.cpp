@@ -23,6 +23,9 @@
 #include "parser.h"
 #include "pic14.h"
 
+namespace MicrobeCompiler
+{
+
 BTreeBase::BTreeBase()
 {
 	m_root = nullptr;
@@ -246,3 +249,5 @@ void BTreeBase::replaceNode(BTreeNode *node, BTreeNode *replacement)
 	if( node->parent()->left() == node ) node->parent()->setLeft(replacement);
 	if( node->parent()->right() == node ) node->parent()->setRight(replacement);
 }
+
+}
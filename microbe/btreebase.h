@@ -22,6 +22,9 @@
 #include "microbe.h"
 #include "btreenode.h"
 
+namespace MicrobeCompiler
+{
+
 /**
 @short This holds a pointer to the start of the tree, and provides the traversal code.
 @author Daniel Clarke
@@ -56,4 +59,6 @@ protected:
     BTreeNode *m_root;    
 };
 
+}
+
 #endif
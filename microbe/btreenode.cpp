@@ -18,9 +18,13 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include "arena.h"
 #include "btreenode.h"
 #include "pic14.h"
 
+namespace MicrobeCompiler
+{
+
 BTreeNode::BTreeNode()
 {
 	m_parent = nullptr;
@@ -41,6 +45,17 @@ BTreeNode::~BTreeNode()
 	// Must not delete children as might be unlinking!!! deleteChildren();
 }
 
+void * BTreeNode::operator new( size_t size )
+{
+	Q_ASSERT( Arena::current() );
+	return Arena::current()->allocate( size );
+}
+
+void BTreeNode::operator delete( void * p, size_t size )
+{
+	Arena::current()->deallocate( p, size );
+}
+
 void BTreeNode::deleteChildren()
 {
 	if(m_left)
@@ -64,3 +79,5 @@ void BTreeNode::deleteChildren()
 // {
 // 	
 // }
+
+}
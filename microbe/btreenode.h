@@ -27,6 +27,9 @@
 #include <QString>
 #include <QList>
 
+namespace MicrobeCompiler
+{
+
 /**
 A node points to the two child nodes (left and right), and contains the binary
 operation used to combine them.
@@ -41,6 +44,12 @@ class BTreeNode
 		BTreeNode(BTreeNode *p, BTreeNode *l, BTreeNode *r);
 		~BTreeNode();
 
+		/**
+		 * Nodes are allocated from the current Arena.
+		 */
+		static void * operator new( size_t size );
+		static void operator delete( void * p, size_t size );
+
 		/**
 		 * Used for debugging purposes; prints the tree structure to stdout.
 		 */
@@ -104,4 +113,6 @@ class BTreeNode
 		Expression::Operation m_childOp;
 };
 
+}
+
 #endif
@@ -26,6 +26,7 @@
 #include "btreebase.h"
 #include "btreenode.h"
 #include "expression.h"
+#include "lexer.h"
 #include "traverser.h"
 #include "parser.h"
 #include "pic14.h"
@@ -33,6 +34,9 @@
 #include <QDebug>
 #include <QRegExp>
 
+namespace MicrobeCompiler
+{
+
 Expression::Expression( PIC14 *pic, MicrobeApp *master, SourceLineMicrobe sourceLine, bool suppressNumberTooBig )
 	: m_sourceLine(sourceLine)
 {
@@ -253,31 +257,36 @@ void Expression::doOp( Operation op, BTreeNode *left, BTreeNode *right )
 	}
 }
 
-void Expression::buildTree( const QString & unstrippedExpression, BTreeBase *tree, BTreeNode *node, int level )
+void Expression::buildTree( const Lexer & lexer, int first, int last, BTreeBase *tree, BTreeNode *node, int level )
 {
-	int firstEnd = 0;
-	int secondStart = 0;
+	int firstEnd = first;
+	int secondStart = first;
 	bool unary = false;
 	Operation op = noop;
-	QString expression = stripBrackets( unstrippedExpression );
+	if ( !stripBrackets( lexer, &first, &last ) )
+	{
+		// Stray brackets might cause the expression parser some problems,
+		// so we just avoid parsing anything altogether
+		first = last;
+	}
 	switch(level)
 	{
 		// ==, !=
 		case 0:
 		{
-		int equpos = findSkipBrackets(expression, "==");
-		int neqpos = findSkipBrackets(expression, "!=");
+		int equpos = findSkipBrackets(lexer, first, last, Token::Equals);
+		int neqpos = findSkipBrackets(lexer, first, last, Token::NotEquals);
 		if( equpos != -1 )
 		{
 			op = equals;
 			firstEnd = equpos;
-			secondStart = equpos + 2;
+			secondStart = equpos + 1;
 		}
 		else if( neqpos != -1 )
 		{
 			op = notequals;
 			firstEnd = neqpos;
-			secondStart = neqpos + 2;
+			secondStart = neqpos + 1;
 		}
 		else op = noop;
 		break;
@@ -286,23 +295,21 @@ void Expression::buildTree( const QString & unstrippedExpression, BTreeBase *tre
 		// <, <=, >=, >
 		case 1:
 		{
-		int ltpos = findSkipBrackets(expression, "<");
-		int lepos = findSkipBrackets(expression, "<=");
-		int gepos = findSkipBrackets(expression, ">=");
-		int gtpos = findSkipBrackets(expression, ">");
-		// Note: if (for example) "<=" is present, "<" will also be present. This
-		// means that we have to check for "<=" before "<", etc.
+		int ltpos = findSkipBrackets(lexer, first, last, Token::Less);
+		int lepos = findSkipBrackets(lexer, first, last, Token::LessOrEqual);
+		int gepos = findSkipBrackets(lexer, first, last, Token::GreaterOrEqual);
+		int gtpos = findSkipBrackets(lexer, first, last, Token::Greater);
 		if( lepos != -1 )
 		{
 			op = le;
 			firstEnd = lepos;
-			secondStart = lepos + 2;
+			secondStart = lepos + 1;
 		}
 		else if( gepos != -1 )
 		{
 			op = ge;
 			firstEnd = gepos;
-			secondStart = gepos + 2;
+			secondStart = gepos + 1;
 		}
 		else if( ltpos != -1 )
 		{
@@ -323,8 +330,8 @@ void Expression::buildTree( const QString & unstrippedExpression, BTreeBase *tre
 		// +,-
 		case 2:
 		{
-		int addpos = findSkipBrackets(expression, '+');
-		int subpos = findSkipBrackets(expression, '-');
+		int addpos = findSkipBrackets(lexer, first, last, Token::Plus);
+		int subpos = findSkipBrackets(lexer, first, last, Token::Minus);
 		if( subpos != -1 )
 		{
 			op = subtraction;
@@ -344,8 +351,8 @@ void Expression::buildTree( const QString & unstrippedExpression, BTreeBase *tre
 		// *,/
 		case 3:
 		{
-		int mulpos = findSkipBrackets(expression, '*');
-		int divpos = findSkipBrackets(expression, '/');
+		int mulpos = findSkipBrackets(lexer, first, last, Token::Multiply);
+		int divpos = findSkipBrackets(lexer, first, last, Token::Divide);
 		if( divpos != -1 )
 		{
 			op = division;
@@ -365,7 +372,7 @@ void Expression::buildTree( const QString & unstrippedExpression, BTreeBase *tre
 		// ^
 		case 4:
 		{
-		int exppos = findSkipBrackets(expression, '^');
+		int exppos = findSkipBrackets(lexer, first, last, Token::Power);
 		if( exppos != -1 )
 		{
 			op = exponent;
@@ -379,41 +386,44 @@ void Expression::buildTree( const QString & unstrippedExpression, BTreeBase *tre
 		// AND, OR, XOR
 		case 5:
 		{
-		int bwAndPos = findSkipBrackets(expression, " AND ");
-		int bwOrPos = findSkipBrackets(expression, " OR ");
-		int bwXorPos = findSkipBrackets(expression, " XOR ");
+		int bwAndPos = findSkipBrackets(lexer, first, last, Token::And);
+		int bwOrPos = findSkipBrackets(lexer, first, last, Token::Or);
+		int bwXorPos = findSkipBrackets(lexer, first, last, Token::Xor);
 		if( bwAndPos != -1 )
 		{
 			op = bwand;
 			firstEnd = bwAndPos;
-			secondStart = bwAndPos + 5;
+			secondStart = bwAndPos + 1;
 		}
 		else if( bwOrPos != -1 )
 		{
 			op = bwor;
 			firstEnd = bwOrPos;
-			secondStart = bwOrPos + 4;
+			secondStart = bwOrPos + 1;
 		}
 		else if( bwXorPos != -1 )
 		{
 			op = bwxor;
 			firstEnd = bwXorPos;
-			secondStart = bwXorPos + 5;
+			secondStart = bwXorPos + 1;
 		}
 		else op = noop;
 		break;
 		}
 
 		// NOT
+		// As the keywords are tokens of their own, a leading "NOT x" is
+		// parsed as bwnot here, where it used to be reported as a missing
+		// operator because " NOT " was only found with spaces around it.
 		case 6:
 		{
-		int bwNotPos = findSkipBrackets(expression, " NOT ");
+		int bwNotPos = findSkipBrackets(lexer, first, last, Token::Not);
 		if( bwNotPos != -1 )
 		{
 			op = bwnot;
 			unary = true;
 			firstEnd = bwNotPos; // this line is not needed for unary things/
-			secondStart = bwNotPos + 5;
+			secondStart = bwNotPos + 1;
 		}
 		else op = noop;
 		break;
@@ -422,9 +432,9 @@ void Expression::buildTree( const QString & unstrippedExpression, BTreeBase *tre
 
 	node->setChildOp(op);
 
-	QString tokens[2];
-	tokens[0] = expression.left(firstEnd).trimmed();
-	tokens[1] = expression.mid(secondStart).trimmed();
+	// The token ranges of the operands
+	const int operandFirst[2] = { first, secondStart };
+	const int operandLast[2] = { firstEnd, last };
 
 	if( op != noop )
 	{
@@ -447,7 +457,7 @@ void Expression::buildTree( const QString & unstrippedExpression, BTreeBase *tre
 				newNode->setValue("");
 				newNode->setType(number);
 			}
-			else buildTree(tokens[j], tree, newNode, 0 );
+			else buildTree(lexer, operandFirst[j], operandLast[j], tree, newNode, 0 );
 		}
 	}
 	else
@@ -455,10 +465,10 @@ void Expression::buildTree( const QString & unstrippedExpression, BTreeBase *tre
 		// if there was no relevant operation i.e. " 3*4 / 6" as opposed to " 3*4 + 6"
 		// then just pass the node onto the next parsing level.
 		// unless we are at the lowest level, in which case we have reached a final value.
-		if( level == 6 ) expressionValue(expression,tree,node);
+		if( level == 6 ) expressionValue(lexer.span(first, last),tree,node);
 		else
 		{
-			buildTree(expression,tree,node,level + 1);
+			buildTree(lexer,first,last,tree,node,level + 1);
 		}
 	}
 }
@@ -477,13 +487,19 @@ void Expression::doUnaryOp(Operation op, BTreeNode *node)
 }
 
 void Expression::compileExpression( const QString & expression )
+{
+	const Lexer lexer(expression);
+	compileExpression(lexer, 0, lexer.count());
+}
+
+void Expression::compileExpression( const Lexer & lexer, int first, int last )
 {
 	// Make a tree to put the expression in.
 	BTreeBase *tree = new BTreeBase();
 	BTreeNode *root = new BTreeNode();
 
 	// parse the expression into the tree
-	buildTree(expression,tree,root,0);
+	buildTree(lexer,first,last,tree,root,0);
 	// compile the tree into assembly code
 	tree->setRoot(root);
 	tree->pruneTree(tree->root());
@@ -497,12 +513,21 @@ void Expression::compileExpression( const QString & expression )
 
 void Expression::compileConditional( const QString & expression, Code * ifCode, Code * elseCode )
 {
-	if( expression.contains(QRegExp("=>|=<|=!")) )
+	const Lexer lexer(expression);
+
+	// A lone "=" is either a comparison written the wrong way round (as in
+	// "=>", "=<" or "=!"), or an assignment where a comparison should be
+	const int assign = lexer.find( Token::Assign );
+	for ( int i = assign; i != -1; i = lexer.find( Token::Assign, i + 1 ) )
 	{
-		mistake( MicrobeApp::InvalidComparison, expression );
-		return;
+		const int end = lexer.at(i).end;
+		if ( end < expression.length() && (expression[end] == '>' || expression[end] == '<' || expression[end] == '!') )
+		{
+			mistake( MicrobeApp::InvalidComparison, expression );
+			return;
+		}
 	}
-	if( expression.contains(QRegExp("[^=><!][=][^=]")))
+	if( assign != -1 )
 	{
 		mistake( MicrobeApp::InvalidEquals );
 		return;
@@ -512,7 +537,7 @@ void Expression::compileConditional( const QString & expression, Code * ifCode,
 	BTreeNode *root = new BTreeNode();
 
 	// parse the expression into the tree
-	buildTree(expression,tree,root,0);
+	buildTree(lexer,0,lexer.count(),tree,root,0);
 
 	// Modify the tree so it is always at the top level of the form (kwoerpkwoep) == (qwopekqpowekp)
 	if ( root->childOp() != equals &&
@@ -577,111 +602,47 @@ void Expression::mistake( MicrobeApp::MistakeType type, const QString & context
 	mb->compileError( type, context, m_sourceLine );
 }
 
-int Expression::findSkipBrackets( const QString & expr, char ch, int startPos)
+int Expression::findSkipBrackets( const Lexer & lexer, int first, int last, Token::Type type )
 {
-	bool found = false;
-	int i = startPos;
-	int bracketLevel = 0;
-	while(!found)
+	for ( int i = first; i < last; ++i )
 	{
-		if(expr[i].toLatin1() == '\'')
-		{
-			if( i + 2 < int(expr.length()) )
-			{
-				if( expr[i+2].toLatin1() == '\'' )
-				{
-				 i = i + 2;
-				 found = true;
-				}
-			}
-		}
+		const Token & token = lexer.at(i);
+		if ( token.type == type )
+			return i;
 
-		if(expr[i].toLatin1() == '(') bracketLevel++;
-		else if(expr[i].toLatin1() == ')') bracketLevel--;
-
-		if( bracketLevel == 0 )
+		if ( token.type == Token::OpenBracket )
 		{
-			if(expr[i].toLatin1() == ch) found = true;
-			else i++;
+			// Nothing after an unclosed bracket is outside brackets
+			if ( token.match == -1 || token.match >= last )
+				return -1;
+			i = token.match;
 		}
-		else i++;
-
-		if( i >= int(expr.length()) )
+		else if ( token.type == Token::CloseBracket )
 		{
-			found = true;
-			i = -1;
+			// Nor is anything after a stray closing bracket
+			return -1;
 		}
 	}
-	return i;
+	return -1;
 }
 
-int Expression::findSkipBrackets( const QString & expr, QString phrase, int startPos)
+bool Expression::stripBrackets( const Lexer & lexer, int * first, int * last )
 {
-	bool found = false;
-	int i = startPos;
-	int bracketLevel = 0;
-	while(!found)
+	while ( *first < *last && lexer.at(*first).type == Token::OpenBracket )
 	{
-		if(expr[i].toLatin1() == '\'')
+		const int match = lexer.at(*first).match;
+		if ( match == -1 || match >= *last )
 		{
-			if( i + 2 < int(expr.length()) )
-			{
-				if( expr[i+2].toLatin1() == '\'' )
-				{
-				 i = i + 2;
-				 found = true;
-				}
-			}
+			mistake( MicrobeApp::MismatchedBrackets, lexer.span( *first, *last ) );
+			return false;
 		}
+		if ( match != *last - 1 )
+			break;
 
-		if(expr[i].toLatin1() == '(') bracketLevel++;
-		else if(expr[i].toLatin1() == ')') bracketLevel--;
-
-		if( bracketLevel == 0 )
-		{
-			if(expr.mid(i,phrase.length()) == phrase) found = true;
-			else i++;
-		}
-		else i++;
-
-		if( i >= int(expr.length()) )
-		{
-			found = true;
-			i = -1;
-		}
+		++*first;
+		--*last;
 	}
-	return i;
-}
-
-QString Expression::stripBrackets( QString expression )
-{
-	bool stripping = true;
-	int bracketLevel = 0;
-	int i = 0;
-	expression = expression.trimmed();
-	while(stripping)
-	{
-		if( expression.at(i) == '(' ) bracketLevel++;
-		else if( expression.at(i) == ')' )
-		{
-			if( i == int(expression.length() - 1) && bracketLevel == 1)
-			{
-				expression = expression.mid(1,expression.length() - 2).trimmed();
-			}
-			bracketLevel--;
-		}
-		if( i == int(expression.length() - 1) && bracketLevel > 0 )
-		{
-			mistake( MicrobeApp::MismatchedBrackets, expression );
-			// Stray brackets might cause the expressionession parser some problems,
-			// so we just avoid parsing anything altogether
-			expression = "";
-			stripping = false;
-		}
-		i++;
-		if( bracketLevel == 0 ) stripping = false;
-	}
-	return expression;
+	return true;
 }
 
 void Expression::expressionValue( QString expr, BTreeBase */*tree*/, BTreeNode *node)
@@ -826,7 +787,8 @@ QString Expression::processConstant( const QString & expr, bool * isConstant )
 	BTreeNode *root = new BTreeNode();
 
 	// parse the expression into the tree
-	buildTree(expr,tree,root,0);
+	const Lexer lexer(expr);
+	buildTree(lexer,0,lexer.count(),tree,root,0);
 	// compile the tree into assembly code
 	tree->setRoot(root);
 	tree->pruneTree(tree->root());
@@ -848,3 +810,5 @@ QString Expression::processConstant( const QString & expr, bool * isConstant )
 	delete tree;
 	return code;
 }
+
+}
@@ -27,9 +27,15 @@
 #define EXPRESSION_H
 
 #include "microbe.h"
+#include "lexer.h"
 
 #include <QString>
 
+class MicrobeTest;
+
+namespace MicrobeCompiler
+{
+
 class PIC14;
 class BTreeNode;
 class MicrobeApp;
@@ -75,6 +81,11 @@ class Expression
 		 * to generate the assembly.
 		 */
 		void compileExpression( const QString & expression);
+		/**
+		 * As above, for the expression made up of the tokens first to last
+		 * (exclusive) of a line that has already been split up.
+		 */
+		void compileExpression( const Lexer & lexer, int first, int last );
 		void compileConditional( const QString & expression, Code * ifCode, Code * elseCode );
 		/** 
 		 * Returns a *number* rather than evaluating code, and sets isConstant to true
@@ -83,6 +94,8 @@ class Expression
 		QString processConstant( const QString & expr, bool * isConsant );
 		
 	private:
+		friend class ::MicrobeTest;
+
 		PIC14 *m_pic;
 		MicrobeApp *mb;
 	
@@ -95,14 +108,23 @@ class Expression
 		void doOp( Operation op, BTreeNode *left, BTreeNode *right );
 		void doUnaryOp( Operation op, BTreeNode *node );
 		/**
-		 * Parses an expression, and generates a tree structure from it.
+		 * Parses the expression made up of the tokens first to last
+		 * (exclusive), and generates a tree structure from it.
 		 */
-		void buildTree( const QString & expression, BTreeBase *tree, BTreeNode *node, int level );
+		void buildTree( const Lexer & lexer, int first, int last, BTreeBase *tree, BTreeNode *node, int level );
 
-		static int findSkipBrackets( const QString & expr, char ch, int startPos = 0);
-		static int findSkipBrackets( const QString & expr, QString phrase, int startPos = 0);
-	
-		QString stripBrackets( QString expression );
+		/**
+		 * @return the index of the first token of the given type in first to
+		 * last that is not inside brackets, or -1 if there is none.
+		 */
+		static int findSkipBrackets( const Lexer & lexer, int first, int last, Token::Type type );
+		/**
+		 * Moves first and last in past the brackets that enclose the whole
+		 * range.
+		 * @return false (after reporting it) if the opening bracket is not
+		 * closed.
+		 */
+		bool stripBrackets( const Lexer & lexer, int * first, int * last );
 	
 		void mistake( MicrobeApp::MistakeType type, const QString & context = nullptr );
 	
@@ -128,4 +150,6 @@ class Expression
 		bool m_bSupressNumberTooBig;
 };
 
+}
+
 #endif
@@ -23,6 +23,7 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include "arena.h"
 #include "instruction.h"
 #include "optimizer.h"
 #include "pic14.h"
@@ -31,6 +32,10 @@
 #include <cassert>
 #include <iostream>
 using namespace std;
+
+namespace MicrobeCompiler
+{
+
 //modified new variable pic_type is added
 extern QString pic_type;
 //BEGIN class Register
@@ -2010,14 +2015,38 @@ ProcessorState::ProcessorState()
 }
 
 
+/**
+ * The general purpose registers seen so far, and their position in
+ * ProcessorState::m_registers.
+ */
+static QHash< QString, int > & gprIndices()
+{
+	static QHash< QString, int > indices;
+	return indices;
+}
+
+
+int ProcessorState::index( const Register & reg )
+{
+	if ( reg.type() != Register::GPR )
+		return reg.type();
+
+	QHash< QString, int > & indices = gprIndices();
+	QHash< QString, int >::const_iterator it = indices.constFind( reg.name() );
+	if ( it != indices.constEnd() )
+		return *it;
+
+	int index = Register::none + 1 + indices.size();
+	indices.insert( reg.name(), index );
+	return index;
+}
+
+
 void ProcessorState::reset()
 {
 	working.reset();
 	status.reset();
-
-	RegisterMap::iterator end = m_registers.end();
-	for ( RegisterMap::iterator it = m_registers.begin(); it != end; ++it )
-		(*it).reset();
+	m_registers.clear();
 }
 
 
@@ -2026,56 +2055,20 @@ void ProcessorState::merge( const ProcessorState & state )
 	working.merge( state.working );
 	status.merge( state.status );
 
-	RegisterMap::iterator this_it = m_registers.begin();
-	RegisterMap::const_iterator other_it = state.m_registers.begin();
-
-	RegisterMap::iterator this_end = m_registers.end();
-	RegisterMap::const_iterator other_end = state.m_registers.end();
-
-	while ( true )
-	{
-		if ( this_it == this_end )
-		{
-			// So remaining registers of this are default
-			while ( other_it != other_end )
-			{
-				m_registers[ other_it.key() ].merge( *other_it );
-				++other_it;
-			}
-			return;
-		}
-
-		if ( other_it == other_end )
-		{
-			// So remaining registers of other are default
-			while ( this_it != this_end )
-			{
-				(*this_it).merge( RegisterState() );
-				++this_it;
-			}
-			return;
-		}
+	const int common = qMin( m_registers.size(), state.m_registers.size() );
+	RegisterState * thisRegs = m_registers.data();
+	const RegisterState * otherRegs = state.m_registers.constData();
 
-		//RegisterState thisReg = *this_it;
-		//RegisterState otherReg = *other_it;
+	// As RegisterState::merge, written out over the plain arrays so that the
+	// compiler can vectorise the loop
+	for ( int i = 0; i < common; ++i )
+		thisRegs[i].known &= otherRegs[i].known & ~( thisRegs[i].value ^ otherRegs[i].value );
 
-		if ( this_it.key() == other_it.key() )
-		{
-			(*this_it).merge( *other_it );
-			++this_it;
-			++other_it;
-		}
-		else if ( this_it.key() < other_it.key() )
-		{
-			(*this_it).merge( RegisterState() );
-			++this_it;
-		}
-		else // other_it.key() < this_it.key()
-		{
-			m_registers[ other_it.key() ].merge( *other_it );
-			++other_it;
-		}
-	}
+	// The remaining registers of other are default, so those of this become
+	// unknown; and merging the remaining registers of other into the default
+	// registers of this leaves them default
+	for ( int i = common; i < m_registers.size(); ++i )
+		thisRegs[i].known = 0x0;
 }
 
 
@@ -2087,7 +2080,16 @@ RegisterState & ProcessorState::reg( const Register & reg )
 	if ( reg.type() == Register::STATUS )
 		return status;
 
-	return m_registers[ reg ];
+	const int i = index( reg );
+	if ( i >= m_registers.size() )
+	{
+		// QVarLengthArray does not construct primitive types when growing
+		const int oldSize = m_registers.size();
+		m_registers.resize( i + 1 );
+		for ( int j = oldSize; j <= i; ++j )
+			m_registers[j].reset();
+	}
+	return m_registers[i];
 }
 
 
@@ -2099,7 +2101,8 @@ RegisterState ProcessorState::reg( const Register & reg ) const
 	if ( reg.type() == Register::STATUS )
 		return status;
 
-	return m_registers[ reg ];
+	const int i = index( reg );
+	return ( i < m_registers.size() ) ? m_registers[i] : RegisterState();
 }
 
 
@@ -2111,61 +2114,22 @@ bool ProcessorState::operator == ( const ProcessorState & state ) const
 	if ( status != state.status )
 		return false;
 
-	RegisterMap::const_iterator this_it = m_registers.begin();
-	RegisterMap::const_iterator other_it = state.m_registers.begin();
-
-	RegisterMap::const_iterator this_end = m_registers.end();
-	RegisterMap::const_iterator other_end = state.m_registers.end();
-
-	while ( true )
+	const int common = qMin( m_registers.size(), state.m_registers.size() );
+	for ( int i = 0; i < common; ++i )
 	{
-		if ( this_it == this_end )
-		{
-			// So remaining registers of this are default
-			while ( other_it != other_end )
-			{
-				if ( *other_it != RegisterState() )
-					return false;
-				++other_it;
-			}
-			return true;
-		}
-
-		if ( other_it == other_end )
-		{
-			// So remaining registers of other are default
-			while ( this_it != this_end )
-			{
-				if ( *this_it != RegisterState() )
-					return false;
-				++this_it;
-			}
-			return true;
-		}
-
-		//RegisterState thisReg = *this_it;
-		//RegisterState otherReg = *other_it;
+		if ( m_registers[i] != state.m_registers[i] )
+			return false;
+	}
 
-		if ( this_it.key() == other_it.key() )
-		{
-			if ( *this_it != *other_it )
-				return false;
-			++this_it;
-			++other_it;
-		}
-		else if ( this_it.key() < other_it.key() )
-		{
-			if ( *this_it != RegisterState() )
-				return false;
-			++this_it;
-		}
-		else // other_it.key() < this_it.key()
-		{
-			if ( *other_it != RegisterState() )
-				return false;
-			++other_it;
-		}
+	// So remaining registers of the shorter one are default
+	const RegisterArray & longer = ( m_registers.size() > common ) ? m_registers : state.m_registers;
+	for ( int i = common; i < longer.size(); ++i )
+	{
+		if ( longer[i] != RegisterState() )
+			return false;
 	}
+
+	return true;
 }
 
 
@@ -2175,12 +2139,20 @@ void ProcessorState::print()
 	working.print();
 	cout << " STATUS:\n";
 	working.print();
-	RegisterMap::iterator end = m_registers.end();
-	for ( RegisterMap::iterator it = m_registers.begin(); it != end; ++it )
+
+	QHash< int, QString > gprNames;
+	const QHash< QString, int > & indices = gprIndices();
+	for ( QHash< QString, int >::const_iterator it = indices.constBegin(); it != indices.constEnd(); ++it )
+		gprNames[ it.value() ] = it.key();
+
+	for ( int i = 0; i < m_registers.size(); ++i )
 	{
-		cout << " " << it.key().name().toStdString() << ":\n";
-        it.value().print();
-// 		it.value().print();
+		if ( m_registers[i] == RegisterState() )
+			continue;
+
+		QString name = ( i < Register::none ) ? Register( Register::Type(i) ).name() : gprNames.value(i);
+		cout << " " << name.toStdString() << ":\n";
+		m_registers[i].print();
 	}
 }
 //END class ProcessorState
@@ -2307,35 +2279,34 @@ void Code::removeInstruction( Instruction * instruction )
 	// instruction.
 
 	iterator e = end();
-	iterator previous = e; // Refers to the previous instruction if it was a bit test instruction
-	for ( iterator i = begin(); i != e; ++i )
-	{
-		if ( *i != instruction )
-		{
-			if ( dynamic_cast<Instr_btfss*>(*i) || dynamic_cast<Instr_btfsc*>(*i) )
-				previous = i;
-			else
-				previous = e;
-			continue;
-		}
-
-		iterator next = ++iterator(i);
+	iterator i = find( instruction );
+	if ( i == e )
+		return;
 
-		QStringList labels = instruction->labels();
-		i.list->erase( i.it );
+	Instruction * previous = previousInstruction( i );
+	if ( !dynamic_cast<Instr_btfss*>(previous) && !dynamic_cast<Instr_btfsc*>(previous) )
+		previous = nullptr;
 
-		if ( previous != e )
-		{
-			labels += (*previous)->labels();
-			previous.list->erase( previous.it );
-		}
+	iterator next = ++iterator(i);
+	Instruction * nextInstruction = (next != e) ? *next : nullptr;
 
-		if ( next != e )
-			(*next)->addLabels( labels );
+	QStringList labels = instruction->labels();
+	labelsRemoved( instruction, labels );
+	i.list->erase( i.it );
+	m_locations.remove( instruction );
 
-		break;
+	if ( previous )
+	{
+		labels += previous->labels();
+		labelsRemoved( previous, previous->labels() );
+		iterator p = find( previous );
+		p.list->erase( p.it );
+		m_locations.remove( previous );
 	}
 
+	if ( nextInstruction )
+		nextInstruction->addLabels( labels );
+
 // 	instruction->removeOutputs();
 }
 
@@ -2350,7 +2321,13 @@ void Code::append( Instruction * instruction, InstructionPosition position )
 	removeInstruction( instruction );
 	m_instructionLists[position].append( instruction );
 
+	Location location;
+	location.position = position;
+	location.index = m_instructionLists[position].size() - 1;
+	m_locations.insert( instruction, location );
+
 	instruction->setCode( this );
+	labelsAdded( instruction, instruction->labels() );
 
 	if ( instruction->type() == Instruction::Assembly /*||
 			instruction->type() == Instruction::Raw*/ )
@@ -2363,31 +2340,65 @@ void Code::append( Instruction * instruction, InstructionPosition position )
 }
 
 
-Instruction * Code::instruction( const QString & label ) const
+void Code::labelsAdded( Instruction * instruction, const QStringList & labels )
 {
-	for ( unsigned i = 0; i < PositionCount; ++i )
+	// Instructions that have been removed keep their labels, but these have
+	// been given to the next instruction
+	if ( !m_locations.contains( instruction ) )
+		return;
+
+	for ( const QString & label : labels )
+		m_labelIndex.insert( label, instruction );
+}
+
+
+void Code::labelsRemoved( Instruction * instruction, const QStringList & labels )
+{
+	for ( const QString & label : labels )
 	{
-		InstructionList::const_iterator end = m_instructionLists[i].end();
-		for ( InstructionList::const_iterator it = m_instructionLists[i].begin(); it != end; ++it )
-		{
-			if ( (*it)->labels().contains( label ) )
-				return *it;
-		}
+		QHash<QString, Instruction *>::iterator it = m_labelIndex.find( label );
+		if ( it != m_labelIndex.end() && it.value() == instruction )
+			m_labelIndex.erase( it );
 	}
-	return nullptr;
 }
 
 
 Code::iterator Code::find( Instruction * instruction )
 {
-	iterator e = end();
-	iterator i = begin();
-	for ( ; i != e; ++i )
+	QHash<Instruction *, Location>::iterator location = m_locations.find( instruction );
+	if ( location == m_locations.end() || instruction->type() != Instruction::Assembly )
+		return end();
+
+	InstructionList * list = & m_instructionLists[ location->position ];
+	if ( location->index >= list->size() || list->at( location->index ) != instruction )
+		location->index = list->indexOf( instruction );
+
+	CodeIterator codeIterator;
+	codeIterator.code = this;
+	codeIterator.it = list->begin() + location->index;
+	codeIterator.pos = location->position;
+	codeIterator.list = list;
+	codeIterator.listEnd = list->end();
+	return codeIterator;
+}
+
+
+Instruction * Code::previousInstruction( const iterator & i ) const
+{
+	int index = int(i.it - i.list->begin()) - 1;
+	for ( int position = i.pos; position >= 0; --position )
 	{
-		if ( *i == instruction )
-			break;
+		const InstructionList & list = m_instructionLists[position];
+		if ( position != i.pos )
+			index = list.size() - 1;
+
+		for ( ; index >= 0; --index )
+		{
+			if ( list[index]->type() == Instruction::Assembly )
+				return list[index];
+		}
 	}
-	return i;
+	return nullptr;
 }
 
 
@@ -2653,7 +2664,18 @@ CodeIterator & CodeIterator::removeAndIncrement()
 
 void CodeIterator::insertBefore( Instruction * ins )
 {
-	list->insert( it, ins );
+	Code::Location location;
+	location.position = pos;
+	location.index = int(it - list->begin());
+
+	// Inserting may move the list, so the iterators are found again
+	it = list->insert( it, ins );
+	++it;
+	listEnd = list->end();
+
+	code->m_locations.insert( ins, location );
+	ins->setCode( code );
+	code->labelsAdded( ins, ins->labels() );
 }
 //END class CodeIterator
 
@@ -2698,6 +2720,7 @@ CodeConstIterator & CodeConstIterator::operator ++ ()
 //BEGIN class Instruction
 Instruction::Instruction()
 {
+	m_pCode = nullptr;
 	m_bInputStateChanged = true;
 	m_bPositionAffectsBranching = false;
 	m_bUsed = false;
@@ -2711,15 +2734,34 @@ Instruction::~ Instruction()
 }
 
 
+void * Instruction::operator new( size_t size )
+{
+	Q_ASSERT( Arena::current() );
+	return Arena::current()->allocate( size );
+}
+
+
+void Instruction::operator delete( void * p, size_t size )
+{
+	Arena::current()->deallocate( p, size );
+}
+
+
 void Instruction::addLabels( const QStringList & labels )
 {
 	m_labels += labels;
+	if ( m_pCode )
+		m_pCode->labelsAdded( this, labels );
 }
 
 
 void Instruction::setLabels( const QStringList & labels )
 {
+	if ( m_pCode )
+		m_pCode->labelsRemoved( this, m_labels );
 	m_labels = labels;
+	if ( m_pCode )
+		m_pCode->labelsAdded( this, m_labels );
 }
 
 
@@ -3772,3 +3814,4 @@ QString Instr_raw::code() const
 }
 //END MicrobeApp (non-assembly) Operations
 
+}
@@ -26,10 +26,15 @@
 #ifndef INSTRUCTION_H
 #define INSTRUCTION_H
 
+#include <QHash>
 #include <QMap>
 #include <QString>
 #include <QStringList>
 #include <QList>
+#include <QVarLengthArray>
+
+namespace MicrobeCompiler
+{
 
 class Code;
 class CodeIterator;
@@ -348,6 +353,13 @@ class RegisterState
 		uchar value;
 };
 
+}
+
+Q_DECLARE_TYPEINFO( MicrobeCompiler::RegisterState, Q_PRIMITIVE_TYPE );
+
+namespace MicrobeCompiler
+{
+
 
 /**
 Setting and dependency information for register bits. See the respective member
@@ -431,12 +443,20 @@ class ProcessorState
 		RegisterState status;
 
 	protected:
-		typedef QMap< Register, RegisterState > RegisterMap;
 		/**
-		 * All registers other than working and status. Entries are created on
-		 * calls to reg with a new Register.
+		 * @return the position of the register's state in m_registers. The
+		 * special function registers are at their type, and the general
+		 * purpose registers follow them in the order they are first seen.
 		 */
-		RegisterMap m_registers;
+		static int index( const Register & reg );
+
+		typedef QVarLengthArray< RegisterState, 128 > RegisterArray;
+		/**
+		 * All registers other than working and status, indexed by index().
+		 * The array is grown on calls to reg with a register past its end;
+		 * registers past the end are in the default (unknown) state.
+		 */
+		RegisterArray m_registers;
 };
 
 
@@ -560,13 +580,22 @@ class Code
 		 * @returns the Instruction with the given label (or null if no such
 		 * Instruction).
 		 */
-		Instruction * instruction( const QString & label ) const;
+		Instruction * instruction( const QString & label ) const { return m_labelIndex.value( label ); }
 		/**
 		 * Look for an Assembly instruction (other types are ignored).
 		 * @return an iterator to the current instruction, or end if it wasn't
 		 * found.
 		 */
 		iterator find( Instruction * instruction );
+		/**
+		 * Called by Instruction when it is given labels, to keep the index of
+		 * labels up to date.
+		 */
+		void labelsAdded( Instruction * instruction, const QStringList & labels );
+		/**
+		 * Called by Instruction when it loses labels.
+		 */
+		void labelsRemoved( Instruction * instruction, const QStringList & labels );
 		/**
 		 * Removes the Instruction (regardless of position).
 		 * @warning You should always use only this function to remove an
@@ -615,8 +644,30 @@ class Code
 		 */
 		QStringList findVariables() const;
 
+		/**
+		 * Where an instruction is: the list it is in, and the index in the
+		 * list that it was last seen at. Instructions inserted or removed
+		 * earlier in the list move it, in which case it is looked for again.
+		 */
+		class Location
+		{
+			public:
+				InstructionPosition position;
+				int index;
+		};
+
+		/**
+		 * @returns the Assembly instruction before the one at the given
+		 * iterator, or null if it is the first.
+		 */
+		Instruction * previousInstruction( const iterator & i ) const;
+
 		InstructionList m_instructionLists[ PositionCount ]; ///< @see InstructionPosition
 		QStringList m_queuedLabels[ PositionCount ]; ///< @see InstructionPosition
+		QHash<QString, Instruction *> m_labelIndex; ///< The instruction given each label
+		QHash<Instruction *, Location> m_locations; ///< Where each instruction is
+
+		friend class CodeIterator;
 
 	private: // Disable copy constructor and operator=
 		Code( const Code & );
@@ -727,6 +778,11 @@ class Instruction
 
 		Instruction();
 		virtual ~Instruction();
+		/**
+		 * Instructions are allocated from the current Arena.
+		 */
+		static void * operator new( size_t size );
+		static void operator delete( void * p, size_t size );
 		void setCode( Code * code ) { m_pCode = code; }
 
 		/**
@@ -1324,4 +1380,6 @@ class Instr_raw : public Instruction
 
 
 
+}
+
 #endif
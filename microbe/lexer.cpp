@@ -0,0 +1,219 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "lexer.h"
+
+namespace MicrobeCompiler
+{
+
+static bool isWordChar( QChar c )
+{
+	return c.isLetterOrNumber() || c == '_' || c == '.';
+}
+
+/**
+ * @return whether the token stands on its own in a run (as the statement
+ * parser splits at these even without spaces).
+ */
+static bool isSeparator( Token::Type type )
+{
+	return type == Token::Assign || type == Token::OpenBrace;
+}
+
+//BEGIN class Lexer
+Lexer::Lexer( const QString & text )
+	: m_text( text )
+{
+	tokenise();
+}
+
+void Lexer::tokenise()
+{
+	const int length = m_text.length();
+	m_tokens.reserve( length / 2 + 1 );
+
+	// Indices of the open brackets not yet matched
+	QVector<int> openBrackets;
+
+	int i = 0;
+	while ( i < length )
+	{
+		const QChar c = m_text[i];
+		if ( c.isSpace() )
+		{
+			++i;
+			continue;
+		}
+
+		Token token;
+		token.type = Token::Other;
+		token.begin = i;
+		token.match = -1;
+
+		const QChar next = (i + 1 < length) ? m_text[i + 1] : QChar();
+
+		if ( isWordChar(c) )
+		{
+			int end = i + 1;
+			while ( end < length && isWordChar( m_text[end] ) )
+				++end;
+
+			// Binary and hex literals of the form b'0101' and h'3A'
+			if ( end == i + 1 && (c == 'b' || c == 'h') && next == '\'' )
+			{
+				end = m_text.indexOf( '\'', i + 2 );
+				end = (end == -1) ? length : end + 1;
+			}
+
+			// The operator keywords are whole words, so "(a)AND(b)" has an
+			// And token just as "a AND b" does, while "ANDY" is a Word.
+			token.type = Token::Word;
+			const int wordLength = end - i;
+			if ( wordLength == 3 && m_text.midRef( i, 3 ) == QLatin1String("AND") )
+				token.type = Token::And;
+			else if ( wordLength == 2 && m_text.midRef( i, 2 ) == QLatin1String("OR") )
+				token.type = Token::Or;
+			else if ( wordLength == 3 && m_text.midRef( i, 3 ) == QLatin1String("XOR") )
+				token.type = Token::Xor;
+			else if ( wordLength == 3 && m_text.midRef( i, 3 ) == QLatin1String("NOT") )
+				token.type = Token::Not;
+			i = end;
+		}
+		else if ( c == '\'' && i + 2 < length && m_text[i + 2] == '\'' )
+		{
+			token.type = Token::Character;
+			i += 3;
+		}
+		else if ( next == '=' && (c == '=' || c == '!' || c == '<' || c == '>') )
+		{
+			switch ( c.toLatin1() )
+			{
+				case '=': token.type = Token::Equals; break;
+				case '!': token.type = Token::NotEquals; break;
+				case '<': token.type = Token::LessOrEqual; break;
+				default: token.type = Token::GreaterOrEqual; break;
+			}
+			i += 2;
+		}
+		else
+		{
+			switch ( c.toLatin1() )
+			{
+				case '<': token.type = Token::Less; break;
+				case '>': token.type = Token::Greater; break;
+				case '+': token.type = Token::Plus; break;
+				case '-': token.type = Token::Minus; break;
+				case '*': token.type = Token::Multiply; break;
+				case '/': token.type = Token::Divide; break;
+				case '^': token.type = Token::Power; break;
+				case '=': token.type = Token::Assign; break;
+				case '(': token.type = Token::OpenBracket; break;
+				case ')': token.type = Token::CloseBracket; break;
+				case '{': token.type = Token::OpenBrace; break;
+				case '}': token.type = Token::CloseBrace; break;
+				default: break;
+			}
+			++i;
+		}
+
+		token.end = i;
+
+		if ( token.type == Token::OpenBracket )
+			openBrackets.append( m_tokens.size() );
+		else if ( token.type == Token::CloseBracket && !openBrackets.isEmpty() )
+		{
+			token.match = openBrackets.takeLast();
+			m_tokens[token.match].match = m_tokens.size();
+		}
+
+		m_tokens.append( token );
+	}
+}
+
+QString Lexer::span( int first, int last ) const
+{
+	if ( first < 0 || first >= last )
+		return QString();
+	return m_text.mid( m_tokens[first].begin, m_tokens[last - 1].end - m_tokens[first].begin );
+}
+
+bool Lexer::isWord( int i, const QString & word ) const
+{
+	const Token & token = m_tokens[i];
+
+	// The keyword operators are words too
+	const bool isWordType = token.type == Token::Word || (token.type >= Token::And && token.type <= Token::Not);
+	if ( !isWordType || token.end - token.begin != word.length() )
+		return false;
+
+	return m_text.midRef( token.begin, word.length() ) == word;
+}
+
+int Lexer::findWord( const QString & word, int from ) const
+{
+	for ( int i = qMax( from, 0 ); i < m_tokens.size(); ++i )
+	{
+		if ( isWord( i, word ) )
+			return i;
+	}
+	return -1;
+}
+
+int Lexer::find( Token::Type type, int from ) const
+{
+	for ( int i = qMax( from, 0 ); i < m_tokens.size(); ++i )
+	{
+		if ( m_tokens[i].type == type )
+			return i;
+	}
+	return -1;
+}
+
+int Lexer::tokenAt( int position ) const
+{
+	// The tokens are in order, so this is a binary search
+	int first = 0;
+	int last = m_tokens.size();
+	while ( first < last )
+	{
+		const int middle = (first + last) / 2;
+		if ( m_tokens[middle].begin < position )
+			first = middle + 1;
+		else
+			last = middle;
+	}
+	return first;
+}
+
+int Lexer::runEnd( int i ) const
+{
+	if ( i < 0 || i >= m_tokens.size() )
+		return i;
+	if ( isSeparator( m_tokens[i].type ) )
+		return i + 1;
+
+	int end = i + 1;
+	while ( end < m_tokens.size() && m_tokens[end].begin == m_tokens[end - 1].end && !isSeparator( m_tokens[end].type ) )
+		++end;
+	return end;
+}
+//END class Lexer
+
+}
@@ -0,0 +1,131 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <QString>
+#include <QVector>
+
+namespace MicrobeCompiler
+{
+
+/**
+A token found by Lexer, as the span of the text that it covers.
+*/
+class Token
+{
+	public:
+		enum Type
+		{
+			Word, // Variable, label, keyword or number, including "b'0101'" and "h'3A'"
+			Character, // Quoted character, e.g. 'A'
+			Equals, // ==
+			NotEquals, // !=
+			LessOrEqual, // <=
+			GreaterOrEqual, // >=
+			Less, // <
+			Greater, // >
+			Plus,
+			Minus,
+			Multiply,
+			Divide,
+			Power, // ^
+			And, // AND
+			Or, // OR
+			Xor, // XOR
+			Not, // NOT
+			Assign, // =
+			OpenBracket,
+			CloseBracket,
+			OpenBrace,
+			CloseBrace,
+			Other // Any other character
+		};
+
+		Type type;
+		int begin; // Position of the first character in the text
+		int end; // Position after the last character
+		/**
+		 * For brackets, the index of the matching bracket, or -1 if there is
+		 * none.
+		 */
+		int match;
+};
+
+typedef QVector<Token> TokenList;
+
+/**
+Splits a line of Microbe (or an expression) into tokens in one pass, with the
+brackets matched up, so that the statement parser and the expression tree
+builder can find what they are looking for by going through the tokens rather
+than searching and copying the text again and again.
+*/
+class Lexer
+{
+	public:
+		Lexer( const QString & text );
+
+		const QString & text() const { return m_text; }
+		const TokenList & tokens() const { return m_tokens; }
+		int count() const { return m_tokens.size(); }
+		const Token & at( int i ) const { return m_tokens[i]; }
+		/**
+		 * @return the text of the tokens first to last (exclusive), including
+		 * the spaces between them.
+		 */
+		QString span( int first, int last ) const;
+		QString tokenText( int i ) const { return span( i, i + 1 ); }
+		/**
+		 * @return whether token i is a word with the given text.
+		 */
+		bool isWord( int i, const QString & word ) const;
+		/**
+		 * @return the index of the first word with the given text at or after
+		 * from, or -1 if there is none.
+		 */
+		int findWord( const QString & word, int from = 0 ) const;
+		/**
+		 * @return the index of the first token of the given type at or after
+		 * from, or -1 if there is none.
+		 */
+		int find( Token::Type type, int from = 0 ) const;
+		/**
+		 * @return the index of the first token that starts at or after the
+		 * given position in the text (the number of tokens if there is none).
+		 */
+		int tokenAt( int position ) const;
+		/**
+		 * @return the index after the tokens that run on from token i without
+		 * a space between them, e.g. for "porta.3=1" the run from "porta.3"
+		 * is just that token, as "=" always stands alone.
+		 */
+		int runEnd( int i ) const;
+
+	protected:
+		void tokenise();
+
+		QString m_text;
+		TokenList m_tokens;
+};
+
+}
+
+#endif
@@ -63,6 +63,8 @@ int main(int argc, char **argv)
     parser.addOption(showSourceOption);
     QCommandLineOption noOptimizeOption(QStringLiteral("no-optimize"), i18n( "Do not attempt optimization of generated instructions."));
     parser.addOption(noOptimizeOption);
+    QCommandLineOption statsOption(QStringLiteral("stats"), i18n( "Print how long each optimization pass took to stderr."));
+    parser.addOption(statsOption);
     parser.addPositionalArgument( QStringLiteral("Input URL"), i18n( "Input filename" ));
     parser.addPositionalArgument( QStringLiteral("Output URL"), i18n( "Output filename" ));
 
@@ -72,10 +74,10 @@ int main(int argc, char **argv)
     const QStringList positionArguments = parser.positionalArguments();
     if (positionArguments.count() == 2 )
 	{
-		MicrobeApp mb;
+		MicrobeCompiler::MicrobeApp mb;
 //		QString s = mb.compile( positionArguments[0], parser.isSet(showSourceOption), !parser.isSet(noOptimizeOption));
 
-		QString s = mb.compile( positionArguments[0], !parser.isSet(noOptimizeOption));
+		QString s = mb.compile( positionArguments[0], !parser.isSet(noOptimizeOption), parser.isSet(statsOption));
 
 		QString errorReport = mb.errorReport();
 		
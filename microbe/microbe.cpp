@@ -23,6 +23,7 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include "arena.h"
 #include "instruction.h"
 #include "microbe.h"
 #include "parser.h"
@@ -37,6 +38,9 @@
 #include <iostream>
 using namespace std;
 
+namespace MicrobeCompiler
+{
+
 
 //BEGIN class MicrobeApp
 MicrobeApp::MicrobeApp()
@@ -76,8 +80,12 @@ MicrobeApp::~MicrobeApp()
 }
 
 
-QString MicrobeApp::compile( const QString & url, bool optimize )
+QString MicrobeApp::compile( const QString & url, bool optimize, bool printStats )
 {
+	// The expression trees and instructions live until the end of the
+	// compilation, so the arena is constructed before anything using them
+	Arena arena;
+
 	QFile file( url );
 	if( file.open( QIODevice::ReadOnly ) )
 	{
@@ -117,6 +125,7 @@ QString MicrobeApp::compile( const QString & url, bool optimize )
 	if ( optimize )
 	{
 		Optimizer opt;
+		opt.setPrintStats( printStats );
 		opt.optimize( code );
 	}
 
@@ -539,3 +548,4 @@ QStringList SourceLineMicrobe::toStringList( const SourceLineList & lines )
 }
 //END class SourceLineMicrobe
 
+}
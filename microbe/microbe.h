@@ -23,11 +23,11 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
-#ifndef MICROBE_H
-#define MICROBE_H
+#ifndef MICROBEAPP_H
+#define MICROBEAPP_H
 
-#include <instruction.h>
-#include <variable.h>
+#include "instruction.h"
+#include "variable.h"
 // #include <pic14.h>
 
 #include <QMap>
@@ -35,6 +35,10 @@
 #include <QStringList>
 
 class QString;
+
+namespace MicrobeCompiler
+{
+
 class BTreeBase;
 class BTreeNode;
 class Code;
@@ -151,8 +155,9 @@ class MicrobeApp
 		 * recursion as it performs initialisation of things, to recurse at
 		 * levels use parseUsingChild(), or create your own Parser.
 		 * @param url is used for reporting errors
+		 * @param printStats whether the optimizer prints how long it took
 		 */
-		QString compile( const QString & url, bool optimize );
+		QString compile( const QString & url, bool optimize, bool printStats = false );
 		/**
 		 * Adds the given compiler error at the file line number to the
 		 * compilation report.
@@ -250,5 +255,7 @@ class MicrobeApp
 };
 
 
+}
+
 #endif
 
@@ -14,11 +14,17 @@
 #include <KLocalizedString>
 
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
 
 #include <cassert>
 #include <iostream>
 using namespace std;
 
+namespace MicrobeCompiler
+{
+
 
 QString binary( uchar val )
 {
@@ -32,6 +38,12 @@ QString binary( uchar val )
 Optimizer::Optimizer()
 {
 	m_pCode = nullptr;
+	m_bPrintStats = false;
+	m_propagateTime = 0;
+	m_pruneTime = 0;
+	m_optimizeTime = 0;
+	m_linkGenerations = 0;
+	m_stateUpdates = 0;
 }
 
 
@@ -47,6 +59,7 @@ void Optimizer::optimize( Code * code )
 
     const int maxIterations = 10000; // selected randomly
 
+	QElapsedTimer timer;
 	bool changed;
     int iterationNumber = 0;
 	do
@@ -56,16 +69,31 @@ void Optimizer::optimize( Code * code )
 
 		// Repeatedly generate links and states until
 		// we know as much as possible about the system.
+		timer.start();
 		propagateLinksAndStates();
+		m_propagateTime += timer.nsecsElapsed();
 
 		// Remove instructions without input links
+		timer.start();
 		changed |= pruneInstructions();
+		m_pruneTime += timer.nsecsElapsed();
 
 		// Perform optimizations based on processor states
+		timer.start();
 		changed |= optimizeInstructions();
+		m_optimizeTime += timer.nsecsElapsed();
 	}
 	while ( changed && (iterationNumber < maxIterations) );
 
+	if ( m_bPrintStats )
+	{
+		cerr << "Optimizer: " << iterationNumber << " iterations" << endl;
+		cerr << "  propagate links and states: " << m_propagateTime / 1000000.0 << " ms ("
+			<< m_linkGenerations << " link generations, " << m_stateUpdates << " state updates)" << endl;
+		cerr << "  prune instructions: " << m_pruneTime / 1000000.0 << " ms" << endl;
+		cerr << "  optimize instructions: " << m_optimizeTime / 1000000.0 << " ms" << endl;
+	}
+
     if (iterationNumber >= maxIterations) {
         QString warnMessage( i18n(
             "Internal issue: Optimization has not finished in %1 iterations.",
@@ -76,55 +104,116 @@ void Optimizer::optimize( Code * code )
 }
 
 
+/**
+ * Builds up the most specific known processor state from the instructions
+ * that could be executed immediately before the given instruction. This is
+ * done by taking the output state of the first input link, and then reducing
+ * it to the greatest common denominator of all the input states.
+ * @return whether the instruction has any input links to give a state
+ */
+static bool mergeInputStates( const Instruction * instruction, ProcessorState * input )
+{
+	const InstructionList list = instruction->inputLinks();
+	if ( list.isEmpty() )
+		return false;
+
+	InstructionList::const_iterator inputIt = list.begin();
+	InstructionList::const_iterator inputsEnd = list.end();
+
+	*input = (*(inputIt++))->outputState();
+
+	while ( inputIt != inputsEnd )
+		input->merge( (*inputIt++)->outputState() );
+
+	return true;
+}
+
+
 void Optimizer::propagateLinksAndStates()
 {
-	int count = 0;
+	// The links depend on the states (e.g. for computed jumps), and the
+	// states on the links, so they are generated for the whole code until
+	// they agree. Between those, the states are carried through only the
+	// instructions whose input states changed.
+	QQueue<Instruction *> worklist;
 
-	do
+	++m_linkGenerations;
+	m_pCode->generateLinksAndStates();
+
+	while ( giveInputStates( & worklist ) )
 	{
-		count++;
+		propagateStates( worklist );
+
+		++m_linkGenerations;
 		m_pCode->generateLinksAndStates();
 	}
-	while ( giveInputStates() );
-
-// 	cout << "count="<<count<<endl;
 }
 
 
-bool Optimizer::giveInputStates()
+bool Optimizer::giveInputStates( QQueue<Instruction *> * changed )
 {
-	bool changed = false;
+	bool anyChanged = false;
 
 	Code::iterator end = m_pCode->end();
 	for ( Code::iterator it = m_pCode->begin(); it != end; ++it )
 	{
-		// Now, build up the most specific known processor state from the instructins
-		// that could be executed immediately before this instruction.
-		// This is done by taking the output state of the first input link, and
-		// then reducing it to the greatest common denominator of all the input states.
-
-		const InstructionList list = (*it)->inputLinks();
-		if ( list.isEmpty() )
+		ProcessorState input;
+		if ( !mergeInputStates( *it, & input ) )
 			continue;
 
-		InstructionList::const_iterator inputIt = list.begin();
-		InstructionList::const_iterator inputsEnd = list.end();
+		if ( (changed || !anyChanged) && (*it)->inputState() != input )
+		{
+			anyChanged = true;
+			if ( changed )
+				changed->enqueue( *it );
+		}
+
+		(*it)->setInputState( input );
+	}
+	return anyChanged;
+}
+
+
+void Optimizer::propagateStates( QQueue<Instruction *> & worklist )
+{
+	// The instructions are not added or removed while propagating, so
+	// where each one is can be looked up once
+	QHash<Instruction *, Code::iterator> positions;
+	Code::iterator end = m_pCode->end();
+	for ( Code::iterator it = m_pCode->begin(); it != end; ++it )
+		positions.insert( *it, it );
+
+	QSet<Instruction *> queued;
+	for ( Instruction * instruction : qAsConst(worklist) )
+		queued.insert( instruction );
 
-		ProcessorState input = (*(inputIt++))->outputState();
+	while ( !worklist.isEmpty() )
+	{
+		Instruction * instruction = worklist.dequeue();
+		queued.remove( instruction );
+
+		const ProcessorState before = instruction->outputState();
+		instruction->generateLinksAndStates( positions.value( instruction ) );
+		++m_stateUpdates;
 
-		while ( inputIt != inputsEnd )
-			input.merge( (*inputIt++)->outputState() );
+		if ( instruction->outputState() == before )
+			continue;
 
-		if ( !changed )
+		const InstructionList outputs = instruction->outputLinks();
+		for ( Instruction * output : outputs )
 		{
-			ProcessorState before = (*it)->inputState();
-			bool stateChanged = ( before != input );
-			changed |= stateChanged;
-		}
+			ProcessorState input;
+			if ( !mergeInputStates( output, & input ) || output->inputState() == input )
+				continue;
 
-		(*it)->setInputState( input );
+			output->setInputState( input );
+			if ( !queued.contains( output ) )
+			{
+				queued.insert( output );
+				worklist.enqueue( output );
+			}
+		}
 	}
-	return changed;
 }
 
 
@@ -157,7 +246,7 @@ bool Optimizer::pruneInstructions()
 
 	//BEGIN remove labels without any reference to them
 	// First: build up a list of labels which are referenced
-	QStringList referencedLabels;
+	QSet<QString> referencedLabels;
 	for ( it = m_pCode->begin(); it != end; ++it )
 	{
 		if ( Instr_goto * ins = dynamic_cast<Instr_goto*>(*it) )
@@ -523,3 +612,4 @@ bool Optimizer::canRemove( Instruction * ins, const Register & reg, uchar bitMas
 	return true;
 }
 
+}
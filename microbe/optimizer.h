@@ -13,6 +13,11 @@
 
 #include "instruction.h"
 
+#include <QQueue>
+
+namespace MicrobeCompiler
+{
+
 
 /// Used for debugging; returns the uchar as a binary string (e.g. 01101010).
 QString binary( uchar val );
@@ -28,6 +33,11 @@ class Optimizer
 		~Optimizer();
 
 		void optimize( Code * code );
+		/**
+		 * Whether to print how long each pass of the optimization took, and
+		 * how much work was done, to stderr once optimize() is done.
+		 */
+		void setPrintStats( bool printStats ) { m_bPrintStats = printStats; }
 		
 	protected:
 		/**
@@ -38,11 +48,21 @@ class Optimizer
 		void propagateLinksAndStates();
 		/**
 		 * Tell the instructions about their input states.
+		 * @param changed if not null, the instructions whose input states
+		 * changed are added to it
 		 * @return whether any input states changed from the previous value
-		 * stored in the instruction (if checkChanged is true - else returns
-		 * true).
+		 * stored in the instruction.
+		 */
+		bool giveInputStates( QQueue<Instruction *> * changed = nullptr );
+		/**
+		 * Regenerates the output states of the instructions in the worklist
+		 * (whose input states have changed), and carries any changes in them
+		 * on to the input states of the instructions they link to, which are
+		 * then added to the worklist. This is repeated until the worklist is
+		 * empty. The links are not regenerated as a whole, so
+		 * propagateLinksAndStates checks them afterwards.
 		 */
-		bool giveInputStates();
+		void propagateStates( QQueue<Instruction *> & worklist );
 		/**
 		 * Remove instructions without any input links (and the ones that are
 		 * only linked to from a removed instruction).
@@ -82,6 +102,14 @@ class Optimizer
 		bool canRemove( Instruction * ins, const Register & reg, uchar bitMask = 0xff );
 		
 		Code * m_pCode;
+		bool m_bPrintStats;
+		qint64 m_propagateTime; // Nanoseconds spent in propagateLinksAndStates
+		qint64 m_pruneTime; // Nanoseconds spent in pruneInstructions
+		qint64 m_optimizeTime; // Nanoseconds spent in optimizeInstructions
+		int m_linkGenerations; // Number of times the links were generated for the whole code
+		int m_stateUpdates; // Number of times an output state was regenerated by propagateStates
 };
 
+}
+
 #endif
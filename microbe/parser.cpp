@@ -21,6 +21,7 @@
 #include "btreebase.h"
 #include "expression.h"
 #include "instruction.h"
+#include "lexer.h"
 #include "parser.h"
 #include "pic14.h"
 #include "traverser.h"
@@ -28,12 +29,14 @@
 #include <cassert>
 #include <QDebug>
 #include <QFile>
-#include <QRegExp>
 #include <QString>
 
 #include <iostream>
 using namespace std;
 
+namespace MicrobeCompiler
+{
+
 
 //BEGIN class Parser
 Parser::Parser( MicrobeApp * _mb )
@@ -198,15 +201,17 @@ Code * Parser::parse( const SourceLineList & lines )
 	{
 		m_currentSourceLine = (*sit).content;
 
-		QString line = (*sit).text();
+		// The line is split into tokens once; the fields are found by going
+		// through them
+		Lexer lexer( (*sit).text() );
 
 		QString command; // e.g. "delay", "for", "subroutine", "increment", etc
 		{
-			int spacepos = line.indexOf(' ');
+			int spacepos = lexer.text().indexOf(' ');
 			if ( spacepos >= 0 )
-				command = line.left( spacepos );
+				command = lexer.text().left( spacepos );
 			else
-				command = line;
+				command = lexer.text();
 		}
 		OutputFieldMap fieldMap;
 
@@ -220,7 +225,7 @@ Code * Parser::parse( const SourceLineList & lines )
 		DefinitionMap::Iterator dmit = m_definitionMap.find(command);
 		if(dmit == m_definitionMap.end())
 		{
-			if( !processAssignment( (*sit).text() ) )
+			if( !processAssignment( lexer ) )
 			{
 				// Not an assignment, maybe a label
 				if( (*sit).isLabel() )
@@ -237,9 +242,10 @@ Code * Parser::parse( const SourceLineList & lines )
 		}
 		StatementDefinition definition = dmit.value();
 
-		// Start at the first white space character following the statement name
+		// The index of the token to go on from (after the statement name), or
+		// -1 once the end of the line has been reached
 		int newPosition = 0;
-		int position = command.length() + 1;
+		int position = lexer.tokenAt( command.length() );
 
 		// Temporaries for use inside the switch
 		Field nextField;
@@ -268,13 +274,8 @@ Code * Parser::parse( const SourceLineList & lines )
 				case (Field::Variable):
 				case (Field::Name):
 				{
-					newPosition = line.indexOf( ' ', position );
-					if(position == newPosition)
-					{
-						newPosition = -1;
-						token = line.mid(position);
-					}
-					else token = line.mid(position, newPosition - position);
+					newPosition = lexer.runEnd(position);
+					token = lexer.span(position, newPosition);
 					if( token.isEmpty() )
 					{
 						if(field.type() == Field::Label)
@@ -302,25 +303,26 @@ Code * Parser::parse( const SourceLineList & lines )
 					{
 						nextField = (*it);
 						if(nextField.type() == Field::FixedString)
-							newPosition = line.indexOf(QRegExp("\\b" + nextField.string() + "\\b"));
+							newPosition = lexer.findWord(nextField.string(), position);
 						// Although code is not necessarily braced, after an expression it is the only
 						// sensilbe way to have it.
 						else if(nextField.type() == Field::Code)
 						{
-							newPosition = line.indexOf("{");
-							if(newPosition == -1) newPosition = line.length() + 1;
+							newPosition = lexer.find(Token::OpenBrace, position);
+							if(newPosition == -1) newPosition = lexer.count();
 						}
 						else if(nextField.type() == Field::Newline)
-							newPosition = line.length()+1;
+							newPosition = lexer.count();
 						else qDebug() << "Bad statement definition - awkward field type after expression";
 					}
-					else newPosition = line.length() + 1;
+					else newPosition = lexer.count();
 					if(newPosition == -1)
 					{
 						// Something was missing, we'll just play along for now,
 						// the next iteration will catch whatever was supposed to be there
+						token = lexer.span(position, lexer.count());
 					}
-					token = line.mid(position, newPosition - position);
+					else token = lexer.span(position, newPosition);
 					position = newPosition;
 					saveToken = true;
 				}
@@ -332,8 +334,8 @@ Code * Parser::parse( const SourceLineList & lines )
 					// (we could check until we come across a non-pin, but no command has that format at
 					// the moment).
 
-					token = line.mid( position + 1 );
-					position = line.length() + 1;
+					token = lexer.span( position, lexer.count() );
+					position = lexer.count();
 					if ( token.isEmpty() )
 						mistake( MicrobeApp::PinListExpected );
 					else
@@ -346,10 +348,10 @@ Code * Parser::parse( const SourceLineList & lines )
 					if ( !(*sit).hasBracedCode() )
 					{
 						saveSingleLine = true;
-						token = line.mid(position);
-						position = line.length() + 1;
+						token = lexer.span(position, lexer.count());
+						position = lexer.count();
 					}
-					else if( position != -1  && position <= int(line.length()) )
+					else if( position != -1 && position < lexer.count() )
 					{
 						mistake( MicrobeApp::UnexpectedStatementBeforeBracket );
 						errorInLine = true;
@@ -366,8 +368,7 @@ Code * Parser::parse( const SourceLineList & lines )
 				case (Field::FixedString):
 				{
 					// Is the string found, and is it starting in the right place?
-					int stringPosition  = line.indexOf(QRegExp("\\b"+field.string()+"\\b"));
-					if( stringPosition != position || stringPosition == -1 )
+					if( position == -1 || position >= lexer.count() || !lexer.isWord(position, field.string()) )
 					{
 						if( !field.compulsory() )
 						{
@@ -386,7 +387,7 @@ Code * Parser::parse( const SourceLineList & lines )
 					}
 					else
 					{
-						position += field.string().length() + 1;
+						++position;
 					}
 				}
 					break;
@@ -401,8 +402,8 @@ Code * Parser::parse( const SourceLineList & lines )
 					if( nextField.type() == Field::FixedString )
 					{
 						nextStatement = *(++StatementList::Iterator(sit));
-						newPosition = nextStatement.text().indexOf(QRegExp("\\b" + nextField.string() + "\\b"));
-						if(newPosition != 0)
+						Lexer nextLexer( nextStatement.text() );
+						if( nextLexer.count() == 0 || !nextLexer.isWord(0, nextField.string()) )
 						{
 							// If the next field is optional just carry on as nothing happened,
 							// the next line will be processed as a new statement
@@ -410,7 +411,8 @@ Code * Parser::parse( const SourceLineList & lines )
 
 						}
 						position = 0;
-						line = (*(++sit)).text();
+						++sit;
+						lexer = nextLexer;
 						m_currentSourceLine = (*sit).content;
 					}
 
@@ -438,7 +440,7 @@ Code * Parser::parse( const SourceLineList & lines )
 
 		// See if we got to the end of the line, but not all fields had been
 		// processed.
-		if( position != -1  && position <= int(line.length()) )
+		if( position != -1 && position < lexer.count() )
 		{
 			mistake( MicrobeApp::TooManyTokens );
 			errorInLine = true;
@@ -457,14 +459,26 @@ Code * Parser::parse( const SourceLineList & lines )
 	return m_code;
 }
 
-bool Parser::processAssignment(const QString &line)
+bool Parser::processAssignment(const Lexer &lexer)
 {
-	QStringList tokens = Statement::tokenise(line);
+	// The tokens are split at spaces, and on either side of "=" (the runs
+	// of the lexer)
+	QString tokens[3];
+	int firstRunEnd = lexer.runEnd(0);
+	int secondRunEnd = lexer.runEnd(firstRunEnd);
 
 	// Have to have at least 3 tokens for an assignment;
-	if ( tokens.size() < 3 )
+	if ( secondRunEnd >= lexer.count() )
 		return false;
 
+	tokens[0] = lexer.span(0, firstRunEnd);
+	tokens[1] = lexer.span(firstRunEnd, secondRunEnd);
+	tokens[2] = lexer.span(secondRunEnd, lexer.runEnd(secondRunEnd));
+
+	// The expression being assigned starts after the first "="
+	const int assign = lexer.find(Token::Assign);
+	const int expressionStart = assign + 1;
+
 	QString firstToken = tokens[0];
 
 	firstToken = mb->alias(firstToken);
@@ -501,14 +515,14 @@ bool Parser::processAssignment(const QString &line)
 		if ( tokens[1] != "=" )
 			mistake( MicrobeApp::UnassignedPort, tokens[1] );
 
-		Expression( m_pPic, mb, m_currentSourceLine, false ).compileExpression(line.mid(line.indexOf("=")+1));
+		Expression( m_pPic, mb, m_currentSourceLine, false ).compileExpression(lexer, expressionStart, lexer.count());
 		m_pPic->saveResultToVar( firstToken );
 	}
 	else if ( m_pPic->isValidTris( firstToken ) )
 	{
 		if( tokens[1] == "=" )
 		{
-			Expression( m_pPic, mb, m_currentSourceLine, false ).compileExpression(line.mid(line.indexOf("=")+1));
+			Expression( m_pPic, mb, m_currentSourceLine, false ).compileExpression(lexer, expressionStart, lexer.count());
 			m_pPic->Stristate(firstToken);
 		}
 	}
@@ -528,7 +542,7 @@ bool Parser::processAssignment(const QString &line)
 		// hasn't been defined yet.
 		mb->addVariable( Variable( Variable::charType, firstToken ) );
 
-		Expression( m_pPic, mb, m_currentSourceLine, false ).compileExpression(line.mid(line.indexOf("=")+1));
+		Expression( m_pPic, mb, m_currentSourceLine, false ).compileExpression(lexer, expressionStart, lexer.count());
 
 		Variable v = mb->variable( firstToken );
 		switch ( v.type() )
@@ -831,49 +845,6 @@ void Parser::mistake( MicrobeApp::MistakeType type, const QString & context )
 Statement::Statement() : code(NULL) {
 }
 
-// static function
-QStringList Statement::tokenise(const QString &line)
-{
-	QStringList result;
-	QString current;
-	int count = 0;
-
-	for(int i = 0; i < int(line.length()); i++)
-	{
-		QChar nextChar = line[i];
-		if( nextChar.isSpace() )
-		{
-			if( count > 0 )
-			{
-				result.append(current);
-				current = "";
-				count = 0;
-			}
-		}
-		else if( nextChar == '=' )
-		{
-			if( count > 0 ) result.append(current);
-			current = "";
-			count = 0;
-			result.append("=");
-		}
-		else if( nextChar == '{' )
-		{
-			if( count > 0 ) result.append(current);
-			current = "";
-			count = 0;
-			result.append("{");
-		}
-		else
-		{
-			count++;
-			current.append(nextChar);
-		}
-	}
-	if( count > 0 ) result.append(current);
-	return result;
-}
-
 int Parser::doArithmetic(int lvalue, int rvalue, Expression::Operation op)
 {
 	switch(op)
@@ -1054,4 +1025,4 @@ OutputField::OutputField( const QString & string/*, int lineNumber*/ )
  		}
 #endif
 
-
+}
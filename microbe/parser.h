@@ -28,6 +28,9 @@
 #include <QMap>
 #include <QList>
 
+namespace MicrobeCompiler
+{
+
 class PIC14;
 
 /**
@@ -61,14 +64,6 @@ class Statement
 		 * Just returns whether or not the braced code is empty.
 		 */
 		bool hasBracedCode() const { return !bracedCode.isEmpty(); }
-		/**
-		 * This breaks up the line separated by spaces,{,and =/
-		 */
-		static QStringList tokenise(const QString &line);
-		/**
-		 * @see tokenise(const QString &line)
-		 */
-		QStringList tokenise() const { return tokenise( content.text() ); }
 		/**
 		 * @returns whether or not the content looks like a label (ends with a
 		 * colon).
@@ -263,10 +258,11 @@ class Parser
 		 */
 		static int doArithmetic( int lvalue, int rvalue, Expression::Operation op );
 		/**
+		 * @param lexer the tokens of the statement
 		 * @return whether it was an assignment (which might not have been in
 		 * the proper form).
 		 */
-		bool processAssignment(const QString &line);
+		bool processAssignment(const Lexer &lexer);
 	
 		void compileConditionalExpression( const QString & expression, Code * ifCode, Code * elseCode ) const;
 		QString processConstant(const QString &expression, bool * isConstant, bool suppressNumberTooBig = false) const;
@@ -292,4 +288,6 @@ class Parser
 		Parser &operator=( const Parser & );
 };
 
+}
+
 #endif
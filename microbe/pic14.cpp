@@ -33,6 +33,10 @@
 #include <cassert>
 #include <iostream>
 using namespace std;
+
+namespace MicrobeCompiler
+{
+
 QString pic_type;
 bool LEDSegTable[][7] = {
 { 1, 1, 1, 1, 1, 1, 0 },
@@ -1445,3 +1449,4 @@ int PortPin::portPosition() const
 
 //END class PortPin
 
+}
@@ -33,6 +33,9 @@
 #include <QStringList>
 #include <QList>
 
+namespace MicrobeCompiler
+{
+
 class Code;
 class MicrobeApp;
 class Parser;
@@ -270,4 +273,6 @@ class PIC14
 		int interruptNameToBit(const QString &name, bool flag);
 };
 
+}
+
 #endif
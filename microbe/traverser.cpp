@@ -21,6 +21,9 @@
 #include "traverser.h"
 #include "pic14.h"
 
+namespace MicrobeCompiler
+{
+
 Traverser::Traverser(BTreeNode *root)
 {
 	m_root = root;
@@ -98,3 +101,4 @@ void Traverser::moveToParent()
 	if(current()->parent()) m_current = current()->parent();
 }
 
+}
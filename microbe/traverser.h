@@ -22,6 +22,9 @@
 
 #include "btreenode.h"
 
+namespace MicrobeCompiler
+{
+
 /**
 Keeps persistent information needed and the algorithm for traversing the binary trees made of BTreeNodes, initialise either by passing a BTreeBase or BTreeNode to traverse a sub tree.
 
@@ -69,4 +72,6 @@ protected:
 	BTreeNode *m_current;
 };
 
+}
+
 #endif
@@ -21,6 +21,9 @@
 #include "pic14.h"
 #include "variable.h"
 
+namespace MicrobeCompiler
+{
+
 Variable::Variable( VariableType type, const QString & name )
 {
 	m_type = type;
@@ -76,4 +79,4 @@ bool Variable::isWritable() const
 	return false;
 }
 
-
+}
@@ -24,6 +24,9 @@
 #include <QString>
 #include <QList>
 
+namespace MicrobeCompiler
+{
+
 class PortPin;
 typedef QList<PortPin> PortPinList;
 
@@ -76,4 +79,6 @@ class Variable
 };
 typedef QList<Variable> VariableList;
 
+}
+
 #endif
@@ -35,6 +35,20 @@ AsmFormatter::~AsmFormatter()
 }
 
 QString AsmFormatter::tidyAsm(QStringList lines)
+{
+    readConfig();
+    lines = tidyLines(lines);
+
+    QString code;
+
+    QStringList::iterator end = lines.end();
+    for (QStringList::iterator slit = lines.begin(); slit != end; ++slit)
+        code.append(*slit + '\n');
+
+    return code;
+}
+
+void AsmFormatter::readConfig()
 {
     // Update our indentation values from config
     m_indentAsmName = KTLConfig::indentAsmName();
@@ -42,7 +56,10 @@ QString AsmFormatter::tidyAsm(QStringList lines)
     m_indentEqu = KTLConfig::indentEqu();
     m_indentEquValue = KTLConfig::indentEquValue();
     m_indentComment = m_indentEquComment = KTLConfig::indentComment();
+}
 
+QStringList AsmFormatter::tidyLines(QStringList lines)
+{
     QStringList::iterator end = lines.end();
     for (QStringList::iterator slit = lines.begin(); slit != end; ++slit) {
         switch (lineType(*slit)) {
@@ -59,12 +76,7 @@ QString AsmFormatter::tidyAsm(QStringList lines)
         }
     }
 
-    QString code;
-
-    for (QStringList::iterator slit = lines.begin(); slit != end; ++slit)
-        code.append(*slit + '\n');
-
-    return code;
+    return lines;
 }
 
 void AsmFormatter::pad(QString &text, int length)
@@ -185,3 +197,21 @@ InstructionParts::InstructionParts(QString line)
     }
 }
 // END class InstructionParts
+
+// BEGIN class AsmFormatterThread
+AsmFormatterThread::AsmFormatterThread(const QStringList &lines)
+    : m_lines(lines)
+{
+    m_formatter.readConfig();
+}
+
+void AsmFormatterThread::tidy()
+{
+    m_tidiedLines = m_formatter.tidyLines(m_lines);
+}
+
+void AsmFormatterThread::run()
+{
+    tidy();
+}
+// END class AsmFormatterThread
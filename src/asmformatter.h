@@ -12,6 +12,7 @@
 #define ASMFORMATTER_H
 
 #include <QStringList>
+#include <QThread>
 
 /**
 @author David Saxton
@@ -64,6 +65,16 @@ public:
     };
 
     QString tidyAsm(QStringList lines);
+    /**
+     * Reads the indentation to use from the config. This is done by
+     * tidyAsm, but has to be done before tidyLines.
+     */
+    void readConfig();
+    /**
+     * Tidies each line on its own, so the result has as many lines as
+     * @p lines. Does not use the config, so can be called from any thread.
+     */
+    QStringList tidyLines(QStringList lines);
 
     static LineType lineType(QString line);
 
@@ -84,4 +95,42 @@ protected:
     int m_indentComment;
 };
 
+/**
+Tidies a snapshot of the lines of an assembly file in the background. The
+config is read when this is created, so it has to be created in the GUI
+thread; the QThread::finished signal is emitted once tidiedLines() is ready.
+*/
+class AsmFormatterThread : public QThread
+{
+public:
+    AsmFormatterThread(const QStringList &lines);
+
+    /**
+     * Tidies the lines in the calling thread (instead of calling start).
+     */
+    void tidy();
+
+    /**
+     * @return the lines, as they were before tidying
+     */
+    const QStringList &lines() const
+    {
+        return m_lines;
+    }
+    /**
+     * @return the lines once tidied, which has the same number of lines
+     */
+    const QStringList &tidiedLines() const
+    {
+        return m_tidiedLines;
+    }
+
+protected:
+    void run() override;
+
+    AsmFormatter m_formatter;
+    const QStringList m_lines;
+    QStringList m_tidiedLines;
+};
+
 #endif
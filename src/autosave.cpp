@@ -0,0 +1,221 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "autosave.h"
+#include "itemdocument.h"
+#include "itemdocumentdata.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+#include <QTimer>
+#include <QUrl>
+#include <QUuid>
+
+#include <ktechlab_debug.h>
+
+static const char untitled_prefix[] = "untitled-";
+
+// BEGIN class AutoSaveThread
+/**
+ * Writes a copy of the state of a document to a file.
+ */
+class AutoSaveThread : public QThread
+{
+public:
+    AutoSaveThread(const ItemDocumentData &data, const QString &fileName)
+        : m_data(data)
+        , m_fileName(fileName)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        // The binary format is the quickest to write; loading the copy
+        // works out the format for itself
+        QSaveFile file(m_fileName);
+        if (!file.open(QIODevice::WriteOnly) || !m_data.saveData(&file, true)) {
+            qCWarning(KTL_LOG) << "Could not write the recovery copy" << m_fileName << file.errorString();
+            file.cancelWriting();
+            return;
+        }
+        if (!file.commit())
+            qCWarning(KTL_LOG) << "Could not write the recovery copy" << m_fileName << file.errorString();
+    }
+
+    ItemDocumentData m_data;
+    QString m_fileName;
+};
+// END class AutoSaveThread
+
+// BEGIN class AutoSave
+AutoSave::AutoSave(ItemDocument *itemDocument)
+    : QObject(itemDocument)
+{
+    p_itemDocument = itemDocument;
+    m_pThread = nullptr;
+    m_pLock = nullptr;
+    m_savedState = -1;
+
+    m_pTimer = new QTimer(this);
+    connect(m_pTimer, &QTimer::timeout, this, &AutoSave::save);
+}
+
+AutoSave::~AutoSave()
+{
+    // The document is being closed, having been saved or its changes
+    // thrown away
+    discard();
+}
+
+void AutoSave::setInterval(int minutes)
+{
+    if (minutes <= 0)
+        m_pTimer->stop();
+    else
+        m_pTimer->start(minutes * 60 * 1000);
+}
+
+void AutoSave::save()
+{
+    ItemDocument *document = p_itemDocument;
+    if (!document->isModified() || !document->m_currentState || document->m_currentStateNumber == m_savedState)
+        return;
+
+    // Still writing the last copy (of a very large document to a slow disk)
+    if (m_pThread && m_pThread->isRunning())
+        return;
+
+    QString newFileName;
+    if (document->url().isEmpty()) {
+        if (m_untitledName.isEmpty())
+            m_untitledName = directory() + '/' + untitled_prefix + QUuid::createUuid().toString(QUuid::WithoutBraces) + document->m_fileExtensionValue;
+        newFileName = m_untitledName;
+    } else
+        newFileName = fileName(document->url());
+
+    if (newFileName != m_fileName) {
+        // The document has been saved under a new name (or is having its
+        // first copy written)
+        discard();
+
+        if (!QDir().mkpath(directory()))
+            return;
+
+        QLockFile *lock = new QLockFile(newFileName + ".lock");
+        lock->setStaleLockTime(0);
+        if (!lock->tryLock(0)) {
+            // Another instance of KTechlab has the document open, and keeps
+            // the recovery copy of it
+            delete lock;
+            return;
+        }
+        m_pLock = lock;
+        m_fileName = newFileName;
+    }
+
+    delete m_pThread;
+    m_pThread = new AutoSaveThread(*document->m_currentState, m_fileName);
+    m_pThread->start(QThread::LowPriority);
+    m_savedState = document->m_currentStateNumber;
+}
+
+void AutoSave::discard()
+{
+    if (m_pThread) {
+        m_pThread->wait();
+        delete m_pThread;
+        m_pThread = nullptr;
+    }
+
+    if (!m_fileName.isEmpty()) {
+        QFile::remove(m_fileName);
+        m_fileName.clear();
+    }
+
+    // Unlocking removes the lock file
+    delete m_pLock;
+    m_pLock = nullptr;
+
+    m_savedState = -1;
+}
+
+QString AutoSave::directory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/autosave";
+}
+
+QString AutoSave::fileName(const QUrl &url)
+{
+    // The name of the document is kept to be readable, and the hash of the
+    // whole url tells documents of the same name apart
+    const QByteArray hash = QCryptographicHash::hash(url.toString().toUtf8(), QCryptographicHash::Md5).toHex();
+    return directory() + '/' + QString::fromLatin1(hash) + '-' + url.fileName();
+}
+
+QString AutoSave::recoveryFile(const QUrl &url)
+{
+    const QString copy = fileName(url);
+    if (!QFile::exists(copy))
+        return QString();
+
+    QLockFile lock(copy + ".lock");
+    lock.setStaleLockTime(0);
+    if (!lock.tryLock(0))
+        return QString();
+    lock.unlock();
+
+    // A copy that is older than the document was written before the
+    // document was last saved (such as by another instance of KTechlab)
+    if (url.isLocalFile()) {
+        const QFileInfo document(url.toLocalFile());
+        if (document.exists() && QFileInfo(copy).lastModified() <= document.lastModified()) {
+            removeRecoveryFile(copy);
+            return QString();
+        }
+    }
+
+    return copy;
+}
+
+QStringList AutoSave::untitledRecoveryFiles()
+{
+    QStringList files;
+
+    const QDir dir(directory());
+    const QStringList entries = dir.entryList(QStringList(QString::fromLatin1(untitled_prefix) + '*'), QDir::Files, QDir::Time | QDir::Reversed);
+    for (const QString &entry : entries) {
+        if (entry.endsWith(".lock"))
+            continue;
+
+        const QString copy = dir.filePath(entry);
+        QLockFile lock(copy + ".lock");
+        lock.setStaleLockTime(0);
+        if (!lock.tryLock(0))
+            continue;
+        lock.unlock();
+
+        files << copy;
+    }
+
+    return files;
+}
+
+void AutoSave::removeRecoveryFile(const QString &fileName)
+{
+    QFile::remove(fileName);
+}
+// END class AutoSave
@@ -0,0 +1,101 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+class AutoSaveThread;
+class ItemDocument;
+class QLockFile;
+class QTimer;
+class QUrl;
+
+/**
+Keeps a recovery copy of a modified ItemDocument, so that the changes are not
+lost if KTechlab closes unexpectedly.
+
+Every so often (see setInterval), the present state of the document is
+copied and written out in a background thread, so that the editing does not
+stutter however large the document is. The present state is what the undo
+history is made from, and it is copied on write, so taking a copy of it costs
+next to nothing in the GUI thread.
+
+The copies are kept in the "autosave" directory of the application data,
+each with a lock file that is held for as long as the document is open. A
+copy whose lock is not held was left behind by an instance of KTechlab that
+did not close properly, and can be recovered (see recoveryFile and
+untitledRecoveryFiles).
+
+@short Writes recovery copies of an ItemDocument
+*/
+class AutoSave : public QObject
+{
+    Q_OBJECT
+
+public:
+    AutoSave(ItemDocument *itemDocument);
+    ~AutoSave() override;
+
+    /**
+     * Sets how often the recovery copy is written.
+     * @param minutes the time between copies, or 0 for none
+     */
+    void setInterval(int minutes);
+    /**
+     * Removes the recovery copy, e.g. when the document has been saved.
+     */
+    void discard();
+
+    /**
+     * @return the recovery copy of the document at url that was left behind
+     * and is newer than the document, or an empty string if there is none
+     */
+    static QString recoveryFile(const QUrl &url);
+    /**
+     * @return the recovery copies of documents that had not been saved yet,
+     * which were left behind
+     */
+    static QStringList untitledRecoveryFiles();
+    /**
+     * Removes a recovery copy that has been recovered or is not wanted.
+     */
+    static void removeRecoveryFile(const QString &fileName);
+
+public slots:
+    /**
+     * Writes the recovery copy, if the document has changed since the last
+     * one and the last one has been written.
+     */
+    void save();
+
+protected:
+    /**
+     * @return the directory the recovery copies are kept in
+     */
+    static QString directory();
+    /**
+     * @return the name of the recovery copy of the document at url
+     */
+    static QString fileName(const QUrl &url);
+
+    ItemDocument *p_itemDocument;
+    QTimer *m_pTimer;
+    AutoSaveThread *m_pThread;
+    QLockFile *m_pLock;
+    QString m_fileName; // The recovery copy that is being kept, if any
+    QString m_untitledName; // Used for the copy until the document is saved
+    int m_savedState; // The state of the document in the recovery copy, or -1
+};
+
+#endif
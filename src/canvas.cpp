@@ -19,6 +19,7 @@
 //#include "q3ptrdict.h"
 #include <QPainter>
 #include <QTimer>
+#include <QtMath>
 // #include "q3tl.h"
 // #include <q3pointarray.h>   // needed for q3polygonscanner
 
@@ -239,11 +240,109 @@ int KtlQCanvas::toChunkScaling(int x) const
     return roundDown(x, chunksize);
 }
 
+quint64 KtlQCanvasChunk::s_changeCount = 0;
+
+// The memory for the tiles of a canvas, in kilobytes
+static const int TILE_CACHE_SIZE = 64 * 1024;
+
+KtlQCanvasTileCache::KtlQCanvasTileCache()
+    : tiles(TILE_CACHE_SIZE)
+{
+}
+
 void KtlQCanvas::initChunkSize(const QRect &s)
 {
     m_chunkSize = QRect(toChunkScaling(s.left()), toChunkScaling(s.top()), ((s.width() - 1) / chunksize) + 3, ((s.height() - 1) / chunksize) + 3);
 }
 
+// The chunk size is kept a power of two between these, with about this many
+// items in each chunk that has any
+static const int MIN_CHUNK_SIZE = 8;
+static const int MAX_CHUNK_SIZE = 128;
+static const int TARGET_CHUNK_ITEMS = 6;
+// Past which the chunk size is made bigger still, for huge canvases
+static const qint64 MAX_CHUNKS = 1 << 18;
+
+int KtlQCanvas::adaptedChunkSize(const QRect &size) const
+{
+    qint64 entries = 0;
+    int used = 0;
+    const int numChunks = m_chunkSize.width() * m_chunkSize.height();
+    for (int i = 0; i < numChunks; ++i) {
+        const int n = chunks[i].listPtr()->size();
+        if (n) {
+            entries += n;
+            used++;
+        }
+    }
+
+    int newSize = chunksize;
+    if (used) {
+        // The items in a chunk go roughly as its area (they overestimate it
+        // for items bigger than the chunks, hence the slack either side)
+        double mean = double(entries) / used;
+        while (mean > 2 * TARGET_CHUNK_ITEMS && newSize > MIN_CHUNK_SIZE) {
+            newSize /= 2;
+            mean /= 4;
+        }
+        while (mean < TARGET_CHUNK_ITEMS / 2 && newSize < MAX_CHUNK_SIZE) {
+            newSize *= 2;
+            mean *= 4;
+        }
+    }
+
+    while (qint64(size.width() / newSize + 3) * (size.height() / newSize + 3) > MAX_CHUNKS)
+        newSize *= 2;
+
+    return newSize;
+}
+
+int KtlQCanvas::adaptedMaxClusters() const
+{
+    // Changes are spread over more of the canvas as there are more items, but
+    // clustering them takes time going as the square of the clusters
+    int used = 0;
+    const int numChunks = m_chunkSize.width() * m_chunkSize.height();
+    for (int i = 0; i < numChunks; ++i) {
+        if (!chunks[i].listPtr()->isEmpty())
+            used++;
+    }
+    return qBound(16, used / 16, 100);
+}
+
+void KtlQCanvas::adaptChunkSize()
+{
+    if (grid)
+        return;
+
+    retune(adaptedChunkSize(m_size), adaptedMaxClusters());
+}
+
+void KtlQCanvas::setHeadless(bool headless)
+{
+    if (m_bHeadless == headless)
+        return;
+
+    // Items do not go into or come out of the chunks while headless, so they
+    // have to be taken out first (or put back after)
+    QList<KtlQCanvasItem *> hidden;
+    SortedCanvasItems::iterator end = m_canvasItems.end();
+    for (SortedCanvasItems::iterator it = m_canvasItems.begin(); it != end; ++it) {
+        KtlQCanvasItem *i = it->second;
+        if (i->isVisible()) {
+            i->hide();
+            hidden.append(i);
+        }
+    }
+
+    m_bHeadless = headless;
+
+    for (QList<KtlQCanvasItem *>::iterator itItem = hidden.begin(); itItem != hidden.end(); ++itItem)
+        (*itItem)->show();
+
+    setAllChanged();
+}
+
 void KtlQCanvas::init(int w, int h, int chunksze, int mxclusters)
 {
     init(QRect(0, 0, w, h), chunksze, mxclusters);
@@ -256,12 +355,15 @@ void KtlQCanvas::init(const QRect &r, int chunksze, int mxclusters)
     maxclusters = mxclusters;
     initChunkSize(r);
     chunks = new KtlQCanvasChunk[m_chunkSize.width() * m_chunkSize.height()];
+    m_pTileCache = new KtlQCanvasTileCache;
+    m_collisionQuery = 0;
     update_timer = nullptr;
     bgcolor = Qt::white;
     grid = nullptr;
     htiles = 0;
     vtiles = 0;
     debug_redraw_areas = false;
+    m_bHeadless = false;
 }
 
 KtlQCanvas::KtlQCanvas(QObject *parent)
@@ -296,6 +398,7 @@ KtlQCanvas::~KtlQCanvas()
     qDeleteAll(all);
     delete[] chunks;
     delete[] grid;
+    delete m_pTileCache;
 }
 
 /*!
@@ -319,6 +422,25 @@ KtlQCanvasChunk &KtlQCanvas::chunk(int i, int j) const
     \internal
     Returns the chunk at a pixel position \a x, \a y.
  */
+qint64 KtlQCanvas::chunkMemoryUsage() const
+{
+    const int numChunks = m_chunkSize.width() * m_chunkSize.height();
+    qint64 bytes = numChunks * qint64(sizeof(KtlQCanvasChunk));
+    for (int i = 0; i < numChunks; ++i)
+        bytes += chunks[i].listPtr()->size() * qint64(sizeof(void *));
+    return bytes;
+}
+
+qint64 KtlQCanvas::tileCacheMemoryUsage() const
+{
+    return m_pTileCache->tiles.totalCost() * qint64(1024);
+}
+
+void KtlQCanvas::clearTileCache()
+{
+    m_pTileCache->tiles.clear();
+}
+
 KtlQCanvasChunk &KtlQCanvas::chunkContaining(int x, int y) const
 {
     return chunk(toChunkScaling(x), toChunkScaling(y));
@@ -338,6 +460,9 @@ void KtlQCanvas::resize(const QRect &newSize)
     if (newSize == m_size)
         return;
 
+    const int newChunkSize = adaptedChunkSize(newSize);
+    const int newMaxClusters = adaptedMaxClusters();
+
     //KtlQCanvasItem *item;
     QList<KtlQCanvasItem *> hidden;
     SortedCanvasItems::iterator end = m_canvasItems.end();
@@ -349,11 +474,18 @@ void KtlQCanvas::resize(const QRect &newSize)
         }
     }
 
+    // Measured from the chunks before the items were taken out of them
+    if (!grid) {
+        chunksize = newChunkSize;
+        maxclusters = newMaxClusters;
+    }
+
     initChunkSize(newSize);
     KtlQCanvasChunk *newchunks = new KtlQCanvasChunk[m_chunkSize.width() * m_chunkSize.height()];
     m_size = newSize;
     delete[] chunks;
     chunks = newchunks;
+    m_pTileCache->tiles.clear();
 
     for (QList<KtlQCanvasItem *>::iterator itItem = hidden.begin(); itItem != hidden.end(); ++itItem) {
         KtlQCanvasItem *item = *itItem;
@@ -389,6 +521,7 @@ void KtlQCanvas::retune(int chunksze, int mxclusters)
         KtlQCanvasChunk *newchunks = new KtlQCanvasChunk[m_chunkSize.width() * m_chunkSize.height()];
         delete[] chunks;
         chunks = newchunks;
+        m_pTileCache->tiles.clear();
 
         for (QList<KtlQCanvasItem *>::iterator itItem = hidden.begin(); itItem != hidden.end(); ++itItem) {
             KtlQCanvasItem *item = *itItem;
@@ -525,11 +658,97 @@ void KtlQCanvas::drawViewArea(KtlQCanvasView *view, QPainter *p, const QRect &vr
             // 2015.11.27 - do not clip, in order to fix drawing of garbage on the screen.
             // p->setClipRect(r);
         }
-        p->setWorldTransform(wm * twm);
-
         p->setBrushOrigin(tl.x(), tl.y());
-        drawCanvasArea(ivr, p, false);
+
+        // The tiles are only drawn for scaling (the zoom of ItemView),
+        // which keeps them lined up with the pixels of the view
+        if (wm.type() <= QTransform::TxScale) {
+            p->setWorldTransform(twm);
+            drawCachedTiles(wm, p, vr);
+        } else {
+            p->setWorldTransform(wm * twm);
+            drawCanvasArea(ivr, p, false);
+        }
+    }
+}
+
+void KtlQCanvas::drawCachedTiles(const QTransform &wm, QPainter *p, const QRect &vr)
+{
+    const QTransform iwm = wm.inverted();
+    const qreal dpr = p->device() ? p->device()->devicePixelRatioF() : 1.0;
+    const int size = KtlQCanvasTileCache::TILE_SIZE;
+
+    // Rounding down, for negative contents coordinates too
+    auto tileIndex = [size](int x) {
+        return (x >= 0) ? (x / size) : -((-x + size - 1) / size);
+    };
+
+    const int i1 = tileIndex(vr.left());
+    const int i2 = tileIndex(vr.right());
+    const int j1 = tileIndex(vr.top());
+    const int j2 = tileIndex(vr.bottom());
+
+    for (int i = i1; i <= i2; ++i) {
+        for (int j = j1; j <= j2; ++j) {
+            const QRect tileRect(i * size, j * size, size, size);
+            // The canvas under the tile, with a margin for the rounding of
+            // the transform
+            const QRect area = iwm.mapRect(tileRect).adjusted(-1, -1, 1, 1).intersected(m_size);
+
+            KtlQCanvasTileCache::Key key = {wm.m11(), wm.m22(), wm.dx(), wm.dy(), dpr, i, j};
+            KtlQCanvasTileCache::Tile *tile = m_pTileCache->tiles.object(key);
+
+            if (!tile || tile->stamp < lastChange(area)) {
+                tile = new KtlQCanvasTileCache::Tile;
+                tile->stamp = KtlQCanvasChunk::changeCount();
+                tile->pixmap = QPixmap(qCeil(size * dpr), qCeil(size * dpr));
+                tile->pixmap.setDevicePixelRatio(dpr);
+                tile->pixmap.fill(Qt::white);
+
+                if (!area.isEmpty()) {
+                    QPainter tp;
+                    if (tp.begin(&tile->pixmap)) {
+                        tp.setWorldTransform(wm * QTransform::fromTranslate(-tileRect.x(), -tileRect.y()));
+                        drawCanvasArea(area, &tp, false);
+                        tp.end();
+                    } else
+                        qCWarning(KTL_LOG) << " painter not active";
+                }
+
+                const int cost = std::max(1, int(qint64(tile->pixmap.width()) * tile->pixmap.height() * 4 / 1024));
+                const QPixmap pixmap = tile->pixmap;
+                if (!m_pTileCache->tiles.insert(key, tile, cost)) {
+                    // Too big to be kept (and deleted by the cache)
+                    p->drawPixmap(tileRect.topLeft(), pixmap);
+                    continue;
+                }
+            }
+
+            p->drawPixmap(tileRect.topLeft(), tile->pixmap);
+        }
+    }
+}
+
+quint64 KtlQCanvas::lastChange(const QRect &area) const
+{
+    if (area.isEmpty())
+        return 0;
+
+    int lx = toChunkScaling(area.x());
+    int ly = toChunkScaling(area.y());
+    int mx = toChunkScaling(area.right());
+    int my = toChunkScaling(area.bottom());
+    if (mx >= m_chunkSize.right())
+        mx = m_chunkSize.right() - 1;
+    if (my >= m_chunkSize.bottom())
+        my = m_chunkSize.bottom() - 1;
+
+    quint64 last = 0;
+    for (int x = lx; x <= mx; x++) {
+        for (int y = ly; y <= my; y++)
+            last = std::max(last, chunk(x, y).changeStamp());
     }
+    return last;
 }
 
 void KtlQCanvas::advance()
@@ -562,7 +781,9 @@ void KtlQCanvas::update()
                 QRect r = changeBounds(view->inverseWorldMatrix().mapRect(area));
                 if (!r.isEmpty()) {
                     // as of my testing, drawing below always fails, so just post for an update event to the widget
-                    view->viewport()->update();
+                    // (only of the part that has changed, allowing for rounding in the transform)
+                    const QRect changed = wm.mapRect(r).translated(view->contentsToViewport(QPoint(0, 0)));
+                    view->viewport()->update(changed.adjusted(-1, -1, 1, 1));
 
 #if 0
                     //view->viewport()->setAttribute(Qt::WA_PaintOutsidePaintEvent, true); // note: remove this when possible
@@ -846,6 +1067,9 @@ void KtlQCanvas::drawCanvasArea(const QRect &inarea, QPainter *p, bool /* double
 
     trtr -= area.topLeft();
 
+    if (rgn.isEmpty())
+        return;
+
     for (QList<KtlQCanvasView *>::iterator itView = m_viewList.begin(); itView != m_viewList.end(); ++itView) {
         KtlQCanvasView *view = *itView;
 
@@ -853,7 +1077,10 @@ void KtlQCanvas::drawCanvasArea(const QRect &inarea, QPainter *p, bool /* double
             continue; // Cannot paint those here (see callers).
 
         // as of my testing, drawing below always fails, so just post for an update event to the widget
-        view->viewport()->update();
+        // (only of the chunks that have changed; the rest of the viewport is
+        // kept by the backing store of the widget, and drawViewArea only
+        // draws what is in the rectangle being painted)
+        view->viewport()->update(rgn.translated(view->contentsToViewport(area.topLeft())));
 
 #if 0
         //view->viewport()->setAttribute(Qt::WA_PaintOutsidePaintEvent, true); // note: remove this when possible
@@ -1189,6 +1416,18 @@ KtlQCanvasItemList KtlQCanvas::collisions(const QRect &r) /* const */
     return l;
 }
 
+unsigned KtlQCanvas::nextCollisionQuery() const
+{
+    // Items are in every chunk they cover, so mark those already looked at
+    // with the number of this query, rather than keeping a set of them
+    if (++m_collisionQuery == 0) {
+        for (SortedCanvasItems::const_iterator itIt = m_canvasItems.begin(); itIt != m_canvasItems.end(); ++itIt)
+            itIt->second->m_collisionQuery = 0;
+        m_collisionQuery = 1;
+    }
+    return m_collisionQuery;
+}
+
 KtlQCanvasItemList KtlQCanvas::collisions(const QPolygon &chunklist, const KtlQCanvasItem *item, bool exact) const
 {
     if (isCanvasDebugEnabled()) {
@@ -1200,8 +1439,12 @@ KtlQCanvasItemList KtlQCanvas::collisions(const QPolygon &chunklist, const KtlQC
         qCDebug(KTL_LOG) << "end canvas item list";
     }
 
-    // Q3PtrDict<void> seen;
-    QHash<KtlQCanvasItem *, bool> seen;
+    const unsigned query = nextCollisionQuery();
+
+    // The exact tests (of polygon regions) are slow, and most of the items
+    // sharing a chunk are not near enough to collide
+    const QRect itemRect = exact ? item->boundingRect() : QRect();
+
     KtlQCanvasItemList result;
     for (int i = 0; i < int(chunklist.count()); i++) {
         int x = chunklist[i].x();
@@ -1210,22 +1453,69 @@ KtlQCanvasItemList KtlQCanvas::collisions(const QPolygon &chunklist, const KtlQC
             const KtlQCanvasItemList *l = chunk(x, y).listPtr();
             for (KtlQCanvasItemList::ConstIterator it = l->begin(); it != l->end(); ++it) {
                 KtlQCanvasItem *g = *it;
-                if (g != item) {
-                    // if ( !seen.find(g) ) {
-                    if (seen.find(g) == seen.end()) {
-                        // seen.replace(g,(void*)1);
-                        seen.take(g);
-                        seen.insert(g, true);
-                        // if ( !exact || item->collidesWith(g) )
-                        //	result.append(g);
-                        if (!exact) {
-                            result.append(g);
-                        }
-                        if (isCanvasDebugEnabled()) {
-                            qCDebug(KTL_LOG) << "test collides " << item << " with " << g;
-                        }
-                        if (item->collidesWith(g)) {
+                if (g == item || g->m_collisionQuery == query)
+                    continue;
+
+                g->m_collisionQuery = query;
+
+                if (!exact) {
+                    result.append(g);
+                    continue;
+                }
+                if (!g->m_chunksBoundingRect.intersects(itemRect))
+                    continue;
+
+                if (isCanvasDebugEnabled()) {
+                    qCDebug(KTL_LOG) << "test collides " << item << " with " << g;
+                }
+                if (item->collidesWith(g)) {
+                    result.append(g);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+KtlQCanvasItemList KtlQCanvas::collisions(const QVector<QLine> &segments, const QVector<QRect> &segmentBounds) const
+{
+    const unsigned query = nextCollisionQuery();
+
+    QRect bound;
+    for (const QRect &segmentBound : segmentBounds)
+        bound |= segmentBound;
+
+    KtlQCanvasItemList result;
+    for (int s = 0; s < segments.size(); ++s) {
+        const QRect br = segmentBounds[s] & rect();
+        if (!br.isValid())
+            continue;
+
+        for (int j = toChunkScaling(br.top()); j <= toChunkScaling(br.bottom()); j++) {
+            for (int i = toChunkScaling(br.left()); i <= toChunkScaling(br.right()); i++) {
+                if (!validChunk(i, j))
+                    continue;
+
+                const KtlQCanvasItemList *l = chunk(i, j).listPtr();
+                for (KtlQCanvasItemList::ConstIterator it = l->begin(); it != l->end(); ++it) {
+                    KtlQCanvasItem *g = *it;
+                    if (g->m_collisionQuery == query)
+                        continue;
+
+                    g->m_collisionQuery = query;
+
+                    const QRect itemRect = g->m_chunksBoundingRect;
+                    if (!itemRect.intersects(bound))
+                        continue;
+
+                    // The item is tested against all of the segments near
+                    // it now, as it is not looked at again in this query
+                    const KtlQCanvasPolygonalItem *polygonal = dynamic_cast<const KtlQCanvasPolygonalItem *>(g);
+                    const QPolygon area = polygonal ? polygonal->areaPoints() : QPolygon(itemRect);
+                    for (int k = 0; k < segments.size(); ++k) {
+                        if (segmentBounds[k].intersects(itemRect) && KtlQCanvasGeometry::segmentIntersectsPolygon(segments[k], area)) {
                             result.append(g);
+                            break;
                         }
                     }
                 }
@@ -16,14 +16,17 @@
 #include <QPixmap>
 // #include "q3ptrlist.h"
 #include <QBrush>
+#include <QLine>
 #include <QList>
 #include <QPen>
+#include <QVector>
 // #include "q3pointarray.h" // 2018.08.14
 
 #include "canvasitemlist.h"
 
 class KtlQCanvasView;
 class KtlQCanvasChunk;
+class KtlQCanvasTileCache;
 
 class KtlQCanvas : public QObject
 {
@@ -105,6 +108,38 @@ public:
         return chunksize;
     }
     virtual void retune(int chunksize, int maxclusters = 100);
+    /**
+     * Picks the chunk size, and the most clusters that changes are drawn in,
+     * from how many items there are in the chunks and the size of the
+     * canvas, and retunes if they have changed. This is done on resizing;
+     * call it too after adding or removing a lot of items. It does nothing
+     * for a canvas with tiles, whose chunks are kept the size of a tile.
+     */
+    void adaptChunkSize();
+    /**
+     * A headless canvas keeps its items out of the chunks, as nothing is
+     * drawn from it and its items are not looked for by position; this is
+     * for documents that are only simulated. Turning it off puts the visible
+     * items into the chunks.
+     */
+    void setHeadless(bool headless);
+    bool isHeadless() const
+    {
+        return m_bHeadless;
+    }
+    /**
+     * @return the memory held by the chunks and their item lists, in bytes.
+     */
+    qint64 chunkMemoryUsage() const;
+    /**
+     * @return the memory held by the rendered tiles, in bytes.
+     */
+    qint64 tileCacheMemoryUsage() const;
+    /**
+     * Throws away the rendered tiles; they are drawn again as they are next
+     * shown.
+     */
+    void clearTileCache();
     virtual void setChangedChunk(int i, int j);
     virtual void setChangedChunkContaining(int x, int y);
     virtual void setAllChanged();
@@ -121,6 +156,15 @@ public:
     KtlQCanvasItemList collisions(const QPoint &) /* const */;
     KtlQCanvasItemList collisions(const QRect &) /* const */;
     KtlQCanvasItemList collisions(const QPolygon &pa, const KtlQCanvasItem *item, bool exact) const;
+    /**
+     * @return the items that the line through the given segments crosses.
+     * Only the chunks under the bounding rectangle of each segment are
+     * looked in, and the items are tested against the segments analytically
+     * rather than by rasterising the line.
+     * @param segmentBounds the bounding rectangle of each segment (which
+     * callers testing the same line often can keep)
+     */
+    KtlQCanvasItemList collisions(const QVector<QLine> &segments, const QVector<QRect> &segmentBounds) const;
 
     void drawArea(const QRect &, QPainter *p);
 
@@ -152,12 +196,36 @@ private:
     void init(int w, int h, int chunksze = 16, int maxclust = 100);
     void init(const QRect &r, int chunksze = 16, int maxclust = 100);
     void initChunkSize(const QRect &s);
+    /**
+     * @return the chunk size suited to the items in the chunks now, for the
+     * canvas being @p size
+     */
+    int adaptedChunkSize(const QRect &size) const;
+    /**
+     * @return the most clusters suited to the items in the chunks now
+     */
+    int adaptedMaxClusters() const;
 
     KtlQCanvasChunk &chunk(int i, int j) const;
+    /**
+     * @return the number of a new collisions query, to mark the items looked
+     * at with
+     */
+    unsigned nextCollisionQuery() const;
     KtlQCanvasChunk &chunkContaining(int x, int y) const;
 
     QRect changeBounds(const QRect &inarea);
     void drawChanges(const QRect &inarea);
+    /**
+     * Draws the area @p vr of the contents of a view from the tiles in the
+     * cache, drawing the tiles that are missing or out of date first. The
+     * painter is set up for contents coordinates.
+     */
+    void drawCachedTiles(const QTransform &wm, QPainter *p, const QRect &vr);
+    /**
+     * @return the latest changeStamp of the chunks under @p area
+     */
+    quint64 lastChange(const QRect &area) const;
     void drawChangedItems(QPainter &painter);
     void setNeedRedraw(const KtlQCanvasItemList *list);
 
@@ -167,6 +235,8 @@ private:
     QRect m_size;
     QRect m_chunkSize;
     KtlQCanvasChunk *chunks;
+    KtlQCanvasTileCache *m_pTileCache;
+    mutable unsigned m_collisionQuery; ///< numbers the calls to collisions, to see which items have been looked at
 
     SortedCanvasItems m_canvasItems;
     QList<KtlQCanvasView *> m_viewList;
@@ -182,6 +252,7 @@ private:
     QTimer *update_timer;
     QColor bgcolor;
     bool debug_redraw_areas;
+    bool m_bHeadless;
 
     friend void qt_unview(KtlQCanvas *c);
 
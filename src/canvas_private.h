@@ -16,7 +16,10 @@
 #include "canvasitems.h"
 #include "ktlq3polygonscanner.h"
 #include <QBitmap>
+#include <QCache>
 #include <QImage>
+#include <QLine>
+#include <QPixmap>
 
 class KtlQPolygonalProcessor
 {
@@ -190,6 +193,7 @@ class KtlQCanvasChunk
 public:
     KtlQCanvasChunk()
         : changed(true)
+        , stamp(++s_changeCount)
     {
     }
     // Other code assumes lists are not deleted. Assignment is also
@@ -208,18 +212,19 @@ public:
     void add(KtlQCanvasItem *item)
     {
         list.prepend(item);
-        changed = true;
+        change();
     }
 
     void remove(KtlQCanvasItem *item)
     {
         list.removeAll(item);
-        changed = true;
+        change();
     }
 
     void change()
     {
         changed = true;
+        stamp = ++s_changeCount;
     }
 
     bool hasChanged() const
@@ -234,11 +239,69 @@ public:
         return y;
     }
 
+    /**
+     * @return when the chunk last changed, as a count of the changes to
+     * all the chunks; unlike hasChanged, this is not reset by drawing.
+     */
+    quint64 changeStamp() const
+    {
+        return stamp;
+    }
+    static quint64 changeCount()
+    {
+        return s_changeCount;
+    }
+
 private:
     KtlQCanvasItemList list;
     bool changed;
+    quint64 stamp;
+
+    static quint64 s_changeCount;
 };
 
+/**
+The rendered tiles of a canvas, shared by all the views that show it at the
+same zoom. A tile is a square of the view contents (the canvas after the
+world transform of the view), and stays valid until one of the chunks it
+covers changes.
+*/
+class KtlQCanvasTileCache
+{
+public:
+    class Key
+    {
+    public:
+        qreal m11, m22, dx, dy; // The world transform of the views (scaling and translation only)
+        qreal devicePixelRatio;
+        int i, j;
+
+        bool operator==(const Key &other) const
+        {
+            return m11 == other.m11 && m22 == other.m22 && dx == other.dx && dy == other.dy && devicePixelRatio == other.devicePixelRatio && i == other.i && j == other.j;
+        }
+    };
+
+    class Tile
+    {
+    public:
+        QPixmap pixmap;
+        quint64 stamp; ///< the changeCount of the chunks when the tile was drawn
+    };
+
+    // The width and height of a tile in the contents of the view
+    static const int TILE_SIZE = 256;
+
+    KtlQCanvasTileCache();
+
+    QCache<Key, Tile> tiles; // Cost in kilobytes
+};
+
+inline uint qHash(const KtlQCanvasTileCache::Key &key, uint seed = 0)
+{
+    return qHash(key.i, seed) ^ qHash(key.j * 31, seed) ^ qHash(key.m11, seed) ^ qHash(key.dx, seed) ^ qHash(key.dy * 7, seed);
+}
+
 class KtlQCanvasPolygonScanner : public KtlQ3PolygonScanner
 {
     KtlQPolygonalProcessor &processor;
@@ -254,6 +317,19 @@ public:
     }
 };
 
+/**
+ * Analytic intersection tests for the exact collisions, which are much
+ * cheaper than rasterising the shapes into regions. Points on the edge of a
+ * shape count as in it.
+ */
+namespace KtlQCanvasGeometry
+{
+bool segmentsIntersect(const QLine &a, const QLine &b);
+bool segmentIntersectsRect(const QLine &segment, const QRect &rect);
+bool segmentIntersectsPolygon(const QLine &segment, const QPolygon &polygon);
+bool polygonsIntersect(const QPolygon &a, const QPolygon &b);
+}
+
 // lesser-used data in canvas item, plus room for extension.
 // Be careful adding to this - check all usages.
 class KtlQCanvasItemExtra
@@ -12,6 +12,7 @@
 #include "cells.h"
 #include "cnitem.h"
 #include "icndocument.h"
+#include "stimulus.h"
 
 #include <QPainter>
 #include <QWheelEvent>
@@ -21,6 +22,9 @@
 
 #include <ktechlab_debug.h>
 
+/// The height on screen (in pixels) below which text is not drawn
+static const int MIN_TEXT_HEIGHT = 5;
+
 // BEGIN Class GuiPart
 GuiPart::GuiPart(CNItem *parent, const QRect &r, KtlQCanvas *canvas)
     : // QObject(parent),
@@ -109,8 +113,7 @@ void GuiPart::updateConnectorPoints(bool add)
 
     for (int x = sx; x <= ex; ++x) {
         for (int y = sy; y <= ey; ++y) {
-            if (cells->haveCell(x, y))
-                cells->cell(x, y).CIpenalty += mult * ICNDocument::hs_item / 2;
+            cells->cell(x, y).CIpenalty += mult * ICNDocument::hs_item / 2;
         }
     }
 }
@@ -164,9 +167,13 @@ void Text::setFlags(int flags)
 
 void Text::drawShape(QPainter &p)
 {
+    // Text that would be only a few pixels high cannot be read anyway
+    if (drawScale(p) * QFontMetrics(p_parent->font()).height() < MIN_TEXT_HEIGHT)
+        return;
+
     initPainter(p);
     p.setFont(p_parent->font());
-    p.drawText(drawRect(), m_flags, m_text);
+    m_canvasText.draw(p, drawRect(), m_flags, m_text);
     deinitPainter(p);
 }
 
@@ -306,7 +313,11 @@ void Button::posChanged()
 
 void Button::slotStateChanged()
 {
-    parent()->buttonStateChanged(id(), m_button->isDown() || m_button->isChecked());
+    const bool state = m_button->isDown() || m_button->isChecked();
+    if (parent()->itemDocument() && parent()->itemDocument()->stimulusRecorder())
+        parent()->itemDocument()->stimulusRecorder()->recordButton(parent()->id(), id(), state);
+
+    parent()->buttonStateChanged(id(), state);
 }
 QWidget *Button::widget() const
 {
@@ -546,11 +557,15 @@ void Slider::leaveEvent(QEvent *e)
 
 void Slider::slotValueChanged(int value)
 {
-    if (parent()->itemDocument())
+    if (parent()->itemDocument()) {
         parent()->itemDocument()->setModified(true);
+        parent()->itemDocument()->requestCoalescedStateSave("slider:" + parent()->id() + ':' + id());
+    }
 
     // Note that we do not use value as we want to take into account rotation
     (void)value;
+    if (parent()->itemDocument() && parent()->itemDocument()->stimulusRecorder())
+        parent()->itemDocument()->stimulusRecorder()->recordSlider(parent()->id(), id(), this->value());
     parent()->sliderValueChanged(id(), this->value());
 
     if (canvas())
@@ -13,6 +13,7 @@
 
 //#include <canvas.h> // 2018.10.16 - not needed
 #include "canvasitems.h"
+#include "canvastext.h"
 #include <QIcon>
 #include <QPointer>
 #include <QSlider>
@@ -137,6 +138,7 @@ public:
 protected:
     QString m_text;
     int m_flags;
+    CanvasText m_canvasText;
 };
 typedef QMap<QString, QPointer<Text>> TextMap;
 
@@ -17,6 +17,10 @@
 #include <QPen>
 #include <QPolygon>
 #include <QRect>
+#include <QTransform>
+
+#include <algorithm>
+#include <cmath>
 
 #include <ktechlab_debug.h>
 
@@ -35,6 +39,7 @@ KtlQCanvasItem::KtlQCanvasItem(KtlQCanvas *canvas)
     , m_bNeedRedraw(true)
     , vis(false)
     , sel(false)
+    , m_collisionQuery(0)
 {
     if (isCanvasDebugEnabled()) {
         qCDebug(KTL_LOG) << " this=" << this;
@@ -137,6 +142,105 @@ void KtlQCanvasItem::setSelected(const bool yes)
     }
 }
 
+// BEGIN KtlQCanvasGeometry
+// The sign of the cross product of (b - a) and (c - a): which side of the line
+// through a and b that c is on
+static int orientation(const QPoint &a, const QPoint &b, const QPoint &c)
+{
+    const qint64 cross = qint64(b.x() - a.x()) * (c.y() - a.y()) - qint64(b.y() - a.y()) * (c.x() - a.x());
+    return (cross > 0) - (cross < 0);
+}
+
+// Whether c, which is on the line through a and b, is between them
+static bool onSegment(const QPoint &a, const QPoint &b, const QPoint &c)
+{
+    return c.x() >= std::min(a.x(), b.x()) && c.x() <= std::max(a.x(), b.x()) && c.y() >= std::min(a.y(), b.y()) && c.y() <= std::max(a.y(), b.y());
+}
+
+bool KtlQCanvasGeometry::segmentsIntersect(const QLine &a, const QLine &b)
+{
+    const int o1 = orientation(a.p1(), a.p2(), b.p1());
+    const int o2 = orientation(a.p1(), a.p2(), b.p2());
+    const int o3 = orientation(b.p1(), b.p2(), a.p1());
+    const int o4 = orientation(b.p1(), b.p2(), a.p2());
+
+    if (o1 != o2 && o3 != o4)
+        return true;
+
+    // Where they are in line, or one ends on the other
+    return (o1 == 0 && onSegment(a.p1(), a.p2(), b.p1())) || (o2 == 0 && onSegment(a.p1(), a.p2(), b.p2())) || (o3 == 0 && onSegment(b.p1(), b.p2(), a.p1())) ||
+        (o4 == 0 && onSegment(b.p1(), b.p2(), a.p2()));
+}
+
+bool KtlQCanvasGeometry::segmentIntersectsRect(const QLine &segment, const QRect &rect)
+{
+    if (rect.isEmpty())
+        return false;
+
+    // Clip the segment to the rectangle (Liang-Barsky), which it crosses if
+    // anything is left
+    const double x0 = segment.x1(), y0 = segment.y1();
+    const double dx = segment.dx(), dy = segment.dy();
+    const double p[] = {-dx, dx, -dy, dy};
+    const double q[] = {x0 - rect.left(), rect.right() - x0, y0 - rect.top(), rect.bottom() - y0};
+
+    double t0 = 0., t1 = 1.;
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0.) {
+            // Parallel to this edge, so it has to be on the inside of it
+            if (q[i] < 0.)
+                return false;
+            continue;
+        }
+        const double t = q[i] / p[i];
+        if (p[i] < 0.)
+            t0 = std::max(t0, t);
+        else
+            t1 = std::min(t1, t);
+        if (t0 > t1)
+            return false;
+    }
+    return true;
+}
+
+bool KtlQCanvasGeometry::segmentIntersectsPolygon(const QLine &segment, const QPolygon &polygon)
+{
+    const int n = polygon.size();
+    if (n == 0)
+        return false;
+    if (!segmentIntersectsRect(segment, polygon.boundingRect()))
+        return false;
+
+    if (polygon.containsPoint(segment.p1(), Qt::OddEvenFill))
+        return true;
+
+    // Otherwise it must cross an edge to get inside
+    for (int i = 0; i < n; ++i) {
+        if (segmentsIntersect(segment, QLine(polygon[i], polygon[(i + 1) % n])))
+            return true;
+    }
+    return false;
+}
+
+bool KtlQCanvasGeometry::polygonsIntersect(const QPolygon &a, const QPolygon &b)
+{
+    const int na = a.size();
+    const int nb = b.size();
+    if (na == 0 || nb == 0 || !a.boundingRect().intersects(b.boundingRect()))
+        return false;
+
+    // Either one is inside the other, or their edges cross
+    if (b.containsPoint(a[0], Qt::OddEvenFill) || a.containsPoint(b[0], Qt::OddEvenFill))
+        return true;
+
+    for (int i = 0; i < na; ++i) {
+        if (segmentIntersectsPolygon(QLine(a[i], a[(i + 1) % na]), b))
+            return true;
+    }
+    return false;
+}
+// END KtlQCanvasGeometry
+
 static bool collision_double_dispatch(const KtlQCanvasPolygonalItem *p1, const KtlQCanvasRectangle *r1, const KtlQCanvasEllipse *e1, const KtlQCanvasPolygonalItem *p2, const KtlQCanvasRectangle *r2, const KtlQCanvasEllipse *e2)
 {
     const KtlQCanvasItem *i1 = nullptr;
@@ -150,7 +254,7 @@ static bool collision_double_dispatch(const KtlQCanvasPolygonalItem *p1, const K
         }
     }
     const KtlQCanvasItem *i2 = nullptr;
-    if (i2) {
+    if (p2) {
         i2 = p2;
     } else {
         if (r2) {
@@ -179,11 +283,7 @@ static bool collision_double_dispatch(const KtlQCanvasPolygonalItem *p1, const K
         return xd * xd + yd * yd <= rd * rd;
     } else if (p1 && p2) {
         // d
-        QPolygon pa1 = p1->areaPoints();
-        QPolygon pa2 = p2 ? p2->areaPoints() : QPolygon(i2->boundingRect());
-        bool col = !(QRegion(pa1) & QRegion(pa2, /* true */ Qt::WindingFill)).isEmpty();
-
-        return col;
+        return KtlQCanvasGeometry::polygonsIntersect(p1->areaPoints(), p2->areaPoints());
     } else {
         return collision_double_dispatch(p2, r2, e2, p1, r1, e1);
     }
@@ -221,22 +321,26 @@ bool KtlQCanvasEllipse::collidesWith(const KtlQCanvasPolygonalItem *p, const Ktl
 
 KtlQCanvasItemList KtlQCanvasItem::collisions(const bool exact) const
 {
-    return canvas()->collisions(chunks(), this, exact);
+    // The exact test decides which of the items found collide, so there is
+    // no need to rasterise a polygon for the chunks it covers; those under
+    // its bounding rectangle will do
+    return canvas()->collisions(exact ? KtlQCanvasItem::chunks() : chunks(), this, exact);
 }
 
 void KtlQCanvasItem::addToChunks()
 {
-    if (isVisible() && canvas()) {
+    if (isVisible() && canvas() && !canvas()->isHeadless()) {
         QPolygon pa = chunks();
         for (int i = 0; i < int(pa.count()); i++)
             canvas()->addItemToChunk(this, pa[i].x(), pa[i].y());
+        m_chunksBoundingRect = boundingRect();
         val = true;
     }
 }
 
 void KtlQCanvasItem::removeFromChunks()
 {
-    if (isVisible() && canvas()) {
+    if (isVisible() && canvas() && !canvas()->isHeadless()) {
         QPolygon pa = chunks();
         for (int i = 0; i < int(pa.count()); i++)
             canvas()->removeItemFromChunk(this, pa[i].x(), pa[i].y());
@@ -245,7 +349,7 @@ void KtlQCanvasItem::removeFromChunks()
 
 void KtlQCanvasItem::changeChunks()
 {
-    if (isVisible() && canvas()) {
+    if (isVisible() && canvas() && !canvas()->isHeadless()) {
         if (!val)
             addToChunks();
         QPolygon pa = chunks();
@@ -362,6 +466,11 @@ void KtlQCanvasPolygonalItem::draw(QPainter &p)
     drawShape(p);
 }
 
+double KtlQCanvasPolygonalItem::drawScale(const QPainter &p)
+{
+    return std::sqrt(std::abs(p.worldTransform().determinant()));
+}
+
 void KtlQCanvasPolygonalItem::setPen(const QPen &p)
 {
     if (pn == p)
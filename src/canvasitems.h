@@ -126,6 +126,11 @@ private:
     bool m_bNeedRedraw;
     bool vis;
     bool sel;
+
+    QRect m_chunksBoundingRect; ///< boundingRect when last added to the chunks
+    unsigned m_collisionQuery; ///< the last KtlQCanvas::collisions query that looked at the item
+
+    friend class KtlQCanvas;
 };
 
 class KtlQPolygonalProcessor;
@@ -156,6 +161,12 @@ public:
 protected:
     void draw(QPainter &) override;
     virtual void drawShape(QPainter &) = 0;
+    /**
+     * @return the number of pixels that one unit of the canvas takes up when
+     * drawn with the given painter (i.e. the zoom level of the view). Used to
+     * leave out detail that would be too small to make out.
+     */
+    static double drawScale(const QPainter &p);
 
     bool winding() const;
     void setWinding(bool);
@@ -19,6 +19,7 @@
 #include "mechanicsdocument.h"
 #include "mechanicsgroup.h"
 #include "mechanicsitem.h"
+#include "mechanicssimulation.h"
 #include "node.h"
 #include "nodegroup.h"
 #include "picitem.h"
@@ -35,6 +36,7 @@
 #include <QDebug>
 #include <QPainter>
 #include <QTimer>
+#include <QWheelEvent>
 
 // FIXME: This source file is HUUUGE!!!, contains numerous classes, should be broken down.
 
@@ -282,9 +284,11 @@ void CMManager::wheelEvent(const EventInfo &eventInfo)
 
         ItemView *itemView = dynamic_cast<ItemView *>(p_itemDocument->activeView());
         if (itemView) {
+            QWheelEvent *scrollEvent = eventInfo.wheelEvent(0, 0);
             itemView->cvbEditor()->setPassEventsToView(false);
-            itemView->cvbEditor()->contentsWheelEvent(eventInfo.wheelEvent(0, 0));
+            itemView->cvbEditor()->contentsWheelEvent(scrollEvent);
             itemView->cvbEditor()->setPassEventsToView(true);
+            delete scrollEvent;
         }
     }
 }
@@ -476,7 +480,7 @@ QPoint ConnectorDraw::toValidPos(const QPoint &clickPos, Connector *clickedConne
     if (!clickedConnector)
         return clickPos;
 
-    const QPointList pointList = clickedConnector->connectorPoints();
+    const QPointList pointList = clickedConnector->connectorCellPoints();
 
     QPointList::const_iterator end = pointList.end();
 
@@ -822,11 +826,20 @@ bool CMManualConnector::mouseReleased(const EventInfo &eventInfo)
 // END class CMManualConnector
 
 // BEGIN class CMItemMove
+// The shortest time between moves of the selection while dragging, about a
+// frame of the display
+static const int ITEM_MOVE_INTERVAL = 16;
+
 CMItemMove::CMItemMove(ItemDocument *itemDocument, CMManager *cmManager)
     : CanvasManipulator(itemDocument, cmManager)
 {
     p_flowContainerCandidate = nullptr;
     m_bItemsSnapToGrid = false;
+
+    m_pMoveTimer = new QTimer(this);
+    m_pMoveTimer->setSingleShot(true);
+    m_pMoveTimer->setInterval(ITEM_MOVE_INTERVAL);
+    connect(m_pMoveTimer, &QTimer::timeout, this, &CMItemMove::applyMove);
 }
 
 CMItemMove::~CMItemMove()
@@ -957,7 +970,25 @@ void CMItemMove::scrollCanvasToSelection()
 
 bool CMItemMove::mouseMoved(const EventInfo &eventInfo)
 {
-    QPoint pos = eventInfo.pos;
+    m_targetPos = eventInfo.pos;
+    if (!m_pMoveTimer->isActive())
+        m_pMoveTimer->start();
+
+    return false;
+}
+
+void CMItemMove::flushMove()
+{
+    if (!m_pMoveTimer->isActive())
+        return;
+
+    m_pMoveTimer->stop();
+    applyMove();
+}
+
+void CMItemMove::applyMove()
+{
+    QPoint pos = m_targetPos;
 
     QPoint snapPoint = pos;
     if (m_bItemsSnapToGrid)
@@ -1011,8 +1042,6 @@ bool CMItemMove::mouseMoved(const EventInfo &eventInfo)
     m_prevSnapPoint = snapPoint;
 
     // 	scrollCanvasToSelection();
-
-    return false;
 }
 
 bool CMItemMove::mouseReleased(const EventInfo &eventInfo)
@@ -1021,6 +1050,10 @@ bool CMItemMove::mouseReleased(const EventInfo &eventInfo)
     if (eventInfo.isRightClick || eventInfo.isMiddleClick)
         return false;
 
+    // The items get to where the mouse was last seen before the connectors
+    // are rerouted around them
+    flushMove();
+
     QStringList itemIDs;
 
     const ItemList itemList = p_cnItemSelectList->items();
@@ -1058,8 +1091,26 @@ bool CMItemMove::mouseReleased(const EventInfo &eventInfo)
             flowContainer->setFullBounds(false);
     }
 
-    if (p_icnDocument)
-        p_icnDocument->requestRerouteInvalidatedConnectors();
+    // Only the connectors where the items and their connectors have been
+    // moved to can have ended up going through items
+    if (p_icnDocument) {
+        QRect changedRect;
+        for (ItemList::const_iterator it = itemList.begin(); it != ilEnd; ++it) {
+            if (*it)
+                changedRect |= (*it)->boundingRect();
+        }
+
+        const ConnectorList::iterator translatableEnd = m_translatableConnectors.end();
+        for (ConnectorList::iterator it = m_translatableConnectors.begin(); it != translatableEnd; ++it) {
+            if (*it)
+                changedRect |= (*it)->routeBoundingRect();
+        }
+
+        if (changedRect.isEmpty())
+            p_icnDocument->requestRerouteInvalidatedConnectors();
+        else
+            p_icnDocument->requestRerouteInvalidatedConnectors(changedRect);
+    }
 
     if (m_eventInfo.pos != eventInfo.pos)
         p_itemDocument->requestStateSave();
@@ -1071,6 +1122,8 @@ bool CMItemMove::mouseReleased(const EventInfo &eventInfo)
 
 bool CMItemMove::mousePressedRepeat(const EventInfo &info)
 {
+    flushMove();
+
     if (info.isRightClick)
         p_cnItemSelectList->slotRotateCW();
     else if (info.isMiddleClick)
@@ -1142,6 +1195,9 @@ bool CMItemResize::mouseReleased(const EventInfo & /*eventInfo*/)
 
 CMMechItemMove::CMMechItemMove(ItemDocument *itemDocument, CMManager *cmManager)
     : CanvasManipulator(itemDocument, cmManager)
+    , m_prevClickedOnSM(MechanicsItem::sm_move)
+    , m_velocityX(0.)
+    , m_velocityY(0.)
 {
 }
 
@@ -1172,6 +1228,8 @@ bool CMMechItemMove::mousePressedInitial(const EventInfo &eventInfo)
 {
     m_eventInfo = eventInfo;
     m_prevPos = eventInfo.pos;
+    m_velocityX = m_velocityY = 0.;
+    m_moveTimer.start();
 
     Item *item = dynamic_cast<Item *>(eventInfo.qcanvasItemClickedOn);
     if (!item)
@@ -1227,6 +1285,12 @@ bool CMMechItemMove::mouseMoved(const EventInfo &eventInfo)
             (*it)->moveBy(x - m_prevPos.x(), y - m_prevPos.y());
     }
 
+    const qint64 elapsedMs = m_moveTimer.restart();
+    if (elapsedMs > 0) {
+        m_velocityX = (x - m_prevPos.x()) * 1e3 / elapsedMs;
+        m_velocityY = (y - m_prevPos.y()) * 1e3 / elapsedMs;
+    }
+
     m_prevPos = QPoint(x, y);
 
     p_canvas->update();
@@ -1262,6 +1326,26 @@ bool CMMechItemMove::mouseReleased(const EventInfo &eventInfo)
             mechItem->setSelectionMode(MechanicsItem::sm_resize);
     }
 
+    // Let go of the items with the speed they were being moved at, so that
+    // they slide on (and knock into others), or at least get pushed out of
+    // whatever they were dropped on
+    if (MechanicsSimulation *simulation = p_mechanicsDocument->mechanicsSimulation()) {
+        const bool thrown = m_moveTimer.elapsed() < THROW_MAX_PAUSE_MS;
+        const MechItemList movedList = p_mechItemSelectList->toplevelMechItemList();
+        for (MechanicsItem *moved : movedList) {
+            if (!moved)
+                continue;
+
+            if (thrown) {
+                Vector2D impulse;
+                impulse.x = moved->mechanicsInfoCombined()->mass * m_velocityX;
+                impulse.y = moved->mechanicsInfoCombined()->mass * m_velocityY;
+                simulation->applyImpulse(moved, impulse);
+            } else
+                simulation->wake(moved);
+        }
+    }
+
     QStringList itemIDs;
 
     ItemList itemList = p_mechItemSelectList->items();
@@ -1324,10 +1408,30 @@ KtlQCanvasItemList SelectRectangle::collisions()
 // END class SelectRectangle
 
 // BEGIN class CMSelect
+// The shortest time between updates of the selection while dragging out the
+// rectangle, about a frame of the display
+static const int SELECT_INTERVAL = 16;
+
+/**
+ * @return the item that is selected when @p qcanvasItem is under the select
+ * rectangle, which is the connector for a line of one
+ */
+static KtlQCanvasItem *selectableItem(KtlQCanvasItem *qcanvasItem)
+{
+    if (ConnectorLine *connectorLine = dynamic_cast<ConnectorLine *>(qcanvasItem))
+        return connectorLine->parent();
+    return qcanvasItem;
+}
+
 CMSelect::CMSelect(ItemDocument *itemDocument, CMManager *cmManager)
     : CanvasManipulator(itemDocument, cmManager)
 {
     m_selectRectangle = nullptr;
+
+    m_pSelectTimer = new QTimer(this);
+    m_pSelectTimer->setSingleShot(true);
+    m_pSelectTimer->setInterval(SELECT_INTERVAL);
+    connect(m_pSelectTimer, &QTimer::timeout, this, &CMSelect::applySelection);
 }
 
 CMSelect::~CMSelect()
@@ -1372,20 +1476,57 @@ bool CMSelect::mouseMoved(const EventInfo &eventInfo)
 
     m_selectRectangle->setSize(pos.x() - m_eventInfo.pos.x(), pos.y() - m_eventInfo.pos.y());
 
-    if (m_eventInfo.ctrlPressed) {
-        p_itemDocument->select(m_selectRectangle->collisions());
-    } else if (p_selectList) {
-        p_selectList->setItems(m_selectRectangle->collisions());
+    if (!m_pSelectTimer->isActive())
+        m_pSelectTimer->start();
+
+    return false;
+}
+
+void CMSelect::flushSelection()
+{
+    if (!m_pSelectTimer->isActive())
+        return;
+
+    m_pSelectTimer->stop();
+    applySelection();
+}
+
+void CMSelect::applySelection()
+{
+    if (!m_selectRectangle || !p_selectList)
+        return;
+
+    // The canvas looks up the items in the chunks under the rectangle, so
+    // this does not go through every item of the document
+    QSet<KtlQCanvasItem *> collisions;
+    const KtlQCanvasItemList list = m_selectRectangle->collisions();
+    const KtlQCanvasItemList::const_iterator end = list.end();
+    for (KtlQCanvasItemList::const_iterator it = list.begin(); it != end; ++it)
+        collisions.insert(selectableItem(*it));
+
+    // With ctrl pressed, the rectangle adds to the selection, so items that
+    // leave it stay selected
+    if (!m_eventInfo.ctrlPressed) {
+        const QSet<KtlQCanvasItem *>::const_iterator prevEnd = m_prevCollisions.constEnd();
+        for (QSet<KtlQCanvasItem *>::const_iterator it = m_prevCollisions.constBegin(); it != prevEnd; ++it) {
+            if (!collisions.contains(*it))
+                p_selectList->removeQCanvasItem(*it);
+        }
     }
 
-    if (p_selectList && !p_mechanicsDocument) {
-        p_selectList->setSelected(true);
+    const QSet<KtlQCanvasItem *>::const_iterator collisionsEnd = collisions.constEnd();
+    for (QSet<KtlQCanvasItem *>::const_iterator it = collisions.constBegin(); it != collisionsEnd; ++it) {
+        if (!m_prevCollisions.contains(*it))
+            p_selectList->addQCanvasItem(*it);
     }
-    return false;
+
+    m_prevCollisions.swap(collisions);
 }
 
 bool CMSelect::mouseReleased(const EventInfo & /*eventInfo*/)
 {
+    flushSelection();
+
     delete m_selectRectangle;
     m_selectRectangle = nullptr;
 
@@ -15,7 +15,9 @@
 
 //#include <canvas.h> // 2018.10.16 - not needed
 #include "canvasitems.h"
+#include <QElapsedTimer>
 #include <QPointer>
+#include <QSet>
 
 class CanvasManipulator;
 class Connector;
@@ -402,8 +404,21 @@ public:
 protected:
     void canvasResized(const QRect &oldSize, const QRect &newSize) override;
     void scrollCanvasToSelection();
+    /**
+     * Moves the selection to where the mouse has got to. The mouse events
+     * only note the position; this is called once per frame from a timer, so
+     * that a fast drag moves the items (and invalidates their chunks and
+     * translates their connectors) once for many events.
+     */
+    void applyMove();
+    /**
+     * Calls applyMove straight away if there is a move waiting for the timer.
+     */
+    void flushMove();
 
     QPoint m_prevSnapPoint;
+    QPoint m_targetPos; ///< where the mouse has got to, which applyMove moves to
+    QTimer *m_pMoveTimer;
     bool m_bItemsSnapToGrid; ///< true iff selection contains CNItems
     int m_dx;
     int m_dy;
@@ -461,7 +476,16 @@ public:
     bool mouseReleased(const EventInfo &info) override;
 
 protected:
+    /**
+     * Moves that stop for longer than this before the mouse is released do
+     * not throw the items.
+     */
+    static const int THROW_MAX_PAUSE_MS = 100;
+
     uint m_prevClickedOnSM; // Previous select mode of the item that was clicked on
+    QElapsedTimer m_moveTimer; // Since the last move
+    double m_velocityX; // Pixels per second that the items were last being moved at
+    double m_velocityY;
 };
 
 /**
@@ -512,7 +536,22 @@ public:
     bool mouseReleased(const EventInfo &info) override;
 
 protected:
+    /**
+     * Brings the selection up to date with the rectangle. The mouse events
+     * only resize the rectangle; this is called once per frame from a timer,
+     * and only selects the items that have come under the rectangle and
+     * unselects those that have left it since the last time.
+     */
+    void applySelection();
+    /**
+     * Calls applySelection straight away if there is one waiting for the
+     * timer.
+     */
+    void flushSelection();
+
     SelectRectangle *m_selectRectangle;
+    QTimer *m_pSelectTimer;
+    QSet<KtlQCanvasItem *> m_prevCollisions; ///< the items under the rectangle when the selection was last applied
 };
 
 /**
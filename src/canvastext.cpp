@@ -0,0 +1,88 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "canvastext.h"
+
+#include <QPainter>
+#include <QRect>
+#include <QTextOption>
+#include <QTransform>
+
+#include <cmath>
+
+CanvasText::CanvasText()
+    : m_flags(0)
+    , m_textWidth(-1)
+    , m_zoomBucket(0)
+    , m_bValid(false)
+{
+    m_staticText.setPerformanceHint(QStaticText::AggressiveCaching);
+}
+
+void CanvasText::draw(QPainter &p, const QRect &rect, int flags, const QString &text)
+{
+    const QTransform &world = p.worldTransform();
+    const double scale = std::sqrt(std::abs(world.determinant()));
+    const int zoomBucket = (scale > 0.) ? int(std::lround(std::log2(scale) * ZOOM_BUCKETS_PER_OCTAVE)) : 0;
+    const int textWidth = (flags & Qt::TextWordWrap) ? rect.width() : -1;
+
+    if (!m_bValid || text != m_text || flags != m_flags || textWidth != m_textWidth || p.font() != m_font) {
+        m_text = text;
+        m_flags = flags;
+        m_textWidth = textWidth;
+        m_font = p.font();
+
+        m_staticText.setText(text);
+        m_staticText.setTextFormat(Qt::PlainText);
+        m_staticText.setTextWidth(textWidth);
+
+        QTextOption option(Qt::Alignment(flags & Qt::AlignHorizontal_Mask));
+        option.setWrapMode((flags & Qt::TextWordWrap) ? QTextOption::WordWrap : QTextOption::NoWrap);
+        m_staticText.setTextOption(option);
+
+        m_bValid = false;
+    }
+
+    if (!m_bValid || zoomBucket != m_zoomBucket) {
+        const double bucketScale = std::exp2(double(zoomBucket) / ZOOM_BUCKETS_PER_OCTAVE);
+        m_staticText.prepare(QTransform::fromScale(bucketScale, bucketScale), m_font);
+        m_zoomBucket = zoomBucket;
+        m_bValid = true;
+    }
+
+    // Wrapped text is aligned across the width by the layout, and otherwise
+    // the text is placed as drawText would
+    const QSizeF size = m_staticText.size();
+    double x = rect.left();
+    if (textWidth < 0) {
+        if (flags & Qt::AlignRight)
+            x = rect.left() + rect.width() - size.width();
+        else if (flags & Qt::AlignHCenter)
+            x = rect.left() + (rect.width() - size.width()) / 2;
+    }
+    double y = rect.top();
+    if (flags & Qt::AlignBottom)
+        y = rect.top() + rect.height() - size.height();
+    else if (flags & Qt::AlignVCenter)
+        y = rect.top() + (rect.height() - size.height()) / 2;
+
+    // drawText clips to the rectangle unless told not to, which only makes
+    // a difference when the text does not fit
+    const bool clip = !(flags & Qt::TextDontClip) && (size.width() > rect.width() || size.height() > rect.height());
+    if (clip) {
+        p.save();
+        p.setClipRect(rect, Qt::IntersectClip);
+    }
+
+    p.drawStaticText(QPointF(x, y), m_staticText);
+
+    if (clip)
+        p.restore();
+}
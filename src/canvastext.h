@@ -0,0 +1,57 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef CANVASTEXT_H
+#define CANVASTEXT_H
+
+#include <QFont>
+#include <QStaticText>
+#include <QString>
+
+class QPainter;
+class QRect;
+
+/**
+Draws a piece of text on the canvas as QPainter::drawText(rect, flags, text)
+would, but keeps the layout (and the glyphs) from one repaint to the next in a
+QStaticText. The text is only laid out again when the text, font, flags or
+width of the rectangle change, or the view is zoomed into another
+ZOOM_BUCKETS_PER_OCTAVE step.
+
+@short Cached layout of text drawn on the canvas
+*/
+class CanvasText
+{
+public:
+    /**
+     * The zoom levels between each doubling that the text is laid out for.
+     * The glyphs are scaled from the nearest layout in between.
+     */
+    static const int ZOOM_BUCKETS_PER_OCTAVE = 4;
+
+    CanvasText();
+
+    /**
+     * Draws text within rect, in the painter's font, using the alignment
+     * flags and Qt::TextWordWrap of flags.
+     */
+    void draw(QPainter &p, const QRect &rect, int flags, const QString &text);
+
+protected:
+    QStaticText m_staticText;
+    QString m_text;
+    QFont m_font;
+    int m_flags;
+    int m_textWidth;  ///< the width that the text is wrapped to, or -1
+    int m_zoomBucket; ///< that m_staticText was prepared for
+    bool m_bValid;
+};
+
+#endif
@@ -11,83 +11,85 @@
 #include "cells.h"
 #include "utils.h"
 
+#include <QThreadStorage>
+
 // BEGIN class Cells
+const Cell Cells::s_emptyCell;
+
 Cells::Cells(const QRect &canvasRect)
 {
-    init(canvasRect);
+    setCanvasRect(canvasRect);
 }
 
 Cells::~Cells()
 {
-    unsigned w = unsigned(m_cellsRect.width());
-    for (uint i = 0; i < w; i++)
-        delete[] m_cells[i];
-    delete[] m_cells;
 }
 
 Cells::Cells(const Cells &c)
+    : m_cellsRect(c.m_cellsRect)
+    , m_cells(c.m_cells)
 {
-    init(QRect(c.cellsRect().topLeft() * 8, c.cellsRect().size() * 8));
-
-    unsigned w = unsigned(m_cellsRect.width());
-    unsigned h = unsigned(m_cellsRect.height());
-
-    for (uint i = 0; i < w; i++) {
-        for (uint j = 0; j < h; j++) {
-            m_cells[i][j] = c.cell(i, j);
-        }
-    }
 }
 
-void Cells::init(const QRect &canvasRect)
+void Cells::setCanvasRect(const QRect &canvasRect)
 {
     m_cellsRect = QRect(roundDown(canvasRect.topLeft(), 8), canvasRect.size() / 8);
     m_cellsRect = m_cellsRect.normalized();
 
-    unsigned w = unsigned(m_cellsRect.width());
-    unsigned h = unsigned(m_cellsRect.height());
-
-    typedef Cell *cellptr;
-    m_cells = new cellptr[w];
-    for (uint i = 0; i < w; ++i) {
-        m_cells[i] = new Cell[h];
-    }
-}
-
-void Cells::reset()
-{
-    unsigned w = unsigned(m_cellsRect.width());
-    unsigned h = unsigned(m_cellsRect.height());
-
-    for (uint i = 0; i < w; i++) {
-        for (uint j = 0; j < h; j++)
-            m_cells[i][j].reset();
-    }
+    if (!m_cellsRect.isEmpty())
+        m_cells.fit(m_cellsRect);
 }
 // END class Cells
 
-// BEGIN class Point
-Point::Point()
-{
-    x = y = prevX = prevY = startCellPos;
-}
-// END class Point
-
 // BEGIN class Cell
 Cell::Cell()
 {
-    addedToLabels = false;
-    permanent = false;
     CIpenalty = 0;
     numCon = 0;
     Cpenalty = 0;
-    bestScore = 0xffff; // Nice large value
 }
+// END class Cell
 
-void Cell::reset()
+// BEGIN class RouteCell
+RouteCell::RouteCell()
+{
+    reset();
+    searchGeneration = 0;
+}
+
+void RouteCell::reset()
 {
-    addedToLabels = false;
     permanent = false;
     bestScore = 0xffff; // Nice large value
+    prevX = prevY = startCellPos;
 }
-// END class Cell
+// END class RouteCell
+
+// BEGIN class RouteCells
+RouteCells::RouteCells()
+{
+    // The cells start off in generation 0, and so are reset when first got
+    m_searchGeneration = 1;
+}
+
+RouteCells *RouteCells::self()
+{
+    static QThreadStorage<RouteCells *> routeCells;
+    if (!routeCells.hasLocalData())
+        routeCells.setLocalData(new RouteCells);
+    return routeCells.localData();
+}
+
+void RouteCells::reset()
+{
+    if (++m_searchGeneration != 0)
+        return;
+
+    // The generations have wrapped around, so the old ones could be taken
+    // as current
+    m_cells.forEach([](RouteCell &c) {
+        c.searchGeneration = 0;
+    });
+    m_searchGeneration = 1;
+}
+// END class RouteCells
@@ -13,36 +13,158 @@
 
 #include "utils.h"
 #include <QRect>
-#include <cassert>
-#include <map>
 
-class Point
+#include <algorithm>
+#include <vector>
+
+/**
+A cell waiting to be checked by ConRouter. The labels are kept as a binary
+heap, with the lowest estimate of the route length through the cell on top.
+*/
+class TempLabel
 {
 public:
-    Point();
+    /**
+     * Ordering for the std heap functions (which put the greatest on top):
+     * lowest estimate first, and then the cell furthest along its route.
+     */
+    bool operator<(const TempLabel &other) const
+    {
+        if (estimate != other.estimate)
+            return estimate > other.estimate;
+        return score < other.score;
+    }
 
+    unsigned estimate; ///< score plus the least score left to the target
+    unsigned short score; ///< the bestScore of the cell when it was added
     short x;
     short y;
-    short prevX;
-    short prevY;
 };
 
-// Key = cell, data = previous cell, compare = score
-typedef std::multimap<unsigned short, Point> TempLabelMap;
+typedef std::vector<TempLabel> TempLabelHeap;
+
+/**
+Cells of type T, kept in square tiles that are only made when a cell in them
+is first got, so any cell position can be used.
+*/
+template<typename T> class CellTiles
+{
+public:
+    CellTiles()
+    {
+    }
+    CellTiles(const CellTiles &other)
+        : m_tiles(other.m_tiles.size(), nullptr)
+        , m_tileRect(other.m_tileRect)
+    {
+        for (unsigned t = 0; t < m_tiles.size(); ++t) {
+            if (other.m_tiles[t]) {
+                m_tiles[t] = new T[TILE_CELLS];
+                std::copy(other.m_tiles[t], other.m_tiles[t] + TILE_CELLS, m_tiles[t]);
+            }
+        }
+    }
+    ~CellTiles()
+    {
+        for (typename std::vector<T *>::iterator it = m_tiles.begin(); it != m_tiles.end(); ++it)
+            delete[] *it;
+    }
+
+    /**
+     * @return the cell, or nullptr if its tile has not been made.
+     */
+    T *find(int i, int j) const
+    {
+        const int tx = (i >> TILE_SHIFT) - m_tileRect.left();
+        const int ty = (j >> TILE_SHIFT) - m_tileRect.top();
+        if (tx < 0 || ty < 0 || tx >= m_tileRect.width() || ty >= m_tileRect.height())
+            return nullptr;
+
+        T *tile = m_tiles[ty * m_tileRect.width() + tx];
+        return tile ? &tile[((j & TILE_MASK) << TILE_SHIFT) | (i & TILE_MASK)] : nullptr;
+    }
+    /**
+     * @return the cell, making its tile if need be.
+     */
+    T &get(int i, int j)
+    {
+        if (T *cell = find(i, j))
+            return *cell;
+
+        fit(QRect(i, j, 1, 1));
+        T *&tile = m_tiles[((j >> TILE_SHIFT) - m_tileRect.top()) * m_tileRect.width() + (i >> TILE_SHIFT) - m_tileRect.left()];
+        tile = new T[TILE_CELLS];
+        return tile[((j & TILE_MASK) << TILE_SHIFT) | (i & TILE_MASK)];
+    }
+    /**
+     * Makes room for the tiles of the given cells (without making them), so
+     * that they do not have to be made room for a row or column at a time.
+     */
+    void fit(const QRect &cellRect)
+    {
+        const QRect needed(QPoint(cellRect.left() >> TILE_SHIFT, cellRect.top() >> TILE_SHIFT), QPoint(cellRect.right() >> TILE_SHIFT, cellRect.bottom() >> TILE_SHIFT));
+        if (m_tileRect.contains(needed))
+            return;
+
+        const QRect tileRect = m_tileRect.isEmpty() ? needed : (m_tileRect | needed);
+        std::vector<T *> tiles(tileRect.width() * tileRect.height(), nullptr);
+        for (int ty = m_tileRect.top(); ty <= m_tileRect.bottom(); ++ty) {
+            for (int tx = m_tileRect.left(); tx <= m_tileRect.right(); ++tx)
+                tiles[(ty - tileRect.top()) * tileRect.width() + tx - tileRect.left()] = m_tiles[(ty - m_tileRect.top()) * m_tileRect.width() + tx - m_tileRect.left()];
+        }
+
+        m_tiles.swap(tiles);
+        m_tileRect = tileRect;
+    }
+    /**
+     * Calls function on every cell that has been made.
+     */
+    template<typename Function> void forEach(Function function)
+    {
+        for (typename std::vector<T *>::iterator it = m_tiles.begin(); it != m_tiles.end(); ++it) {
+            if (*it)
+                std::for_each(*it, *it + TILE_CELLS, function);
+        }
+    }
+    /**
+     * @return the memory held by the tiles that have been made, in bytes.
+     */
+    qint64 memoryUsage() const
+    {
+        qint64 bytes = m_tiles.capacity() * qint64(sizeof(T *));
+        for (typename std::vector<T *>::const_iterator it = m_tiles.begin(); it != m_tiles.end(); ++it) {
+            if (*it)
+                bytes += TILE_CELLS * qint64(sizeof(T));
+        }
+        return bytes;
+    }
+
+protected:
+    /**
+     * Tiles are (1 << TILE_SHIFT) cells square.
+     */
+    static const int TILE_SHIFT = 5;
+    static const int TILE_MASK = (1 << TILE_SHIFT) - 1;
+    static const int TILE_CELLS = 1 << (2 * TILE_SHIFT);
+
+    /// The tiles by row, covering m_tileRect (which is in tiles); nullptr for those not made yet
+    std::vector<T *> m_tiles;
+    QRect m_tileRect;
+
+private:
+    CellTiles &operator=(const CellTiles &);
+};
 
 /**
 @short Used for mapping out connections
+
+What is known about using a cell, kept for as long as the document is open.
+The state of a route search is kept apart, in a RouteCell.
 */
-const short startCellPos = -(1 << 14);
 class Cell
 {
 public:
     Cell();
-    /**
-     * Resets bestScore, prevX, prevY, addedToLabels, it, permanent for
-     * each cell.
-     */
-    void reset();
 
     /**
      * 'Penalty' of using the cell from CNItem.
@@ -52,6 +174,26 @@ public:
      * 'Penalty' of using the cell from Connector.
      */
     unsigned short Cpenalty;
+    /**
+     * Number of connectors through that point.
+     */
+    unsigned short numCon;
+};
+
+const short startCellPos = -(1 << 14);
+
+/**
+The state of a cell in a route search by ConRouter.
+*/
+class RouteCell
+{
+public:
+    RouteCell();
+    /**
+     * Resets bestScore, prevX, prevY and permanent.
+     */
+    void reset();
+
     /**
      * Best (lowest) score so far, _the_ best if it is permanent.
      */
@@ -66,32 +208,35 @@ public:
      */
     bool permanent;
     /**
-     * Whether the cell has already been added to the list of cells to
-     * check.
-     */
-    bool addedToLabels;
-    /**
-     * Pointer to the point in the TempLabelMap.
-     */
-    Point *point;
-    /**
-     * Number of connectors through that point.
+     * The search that the rest of the cell belongs to.
+     * @see RouteCells::cell
      */
-    unsigned short numCon;
+    unsigned searchGeneration;
 };
 
 /**
+The cells of a document, for routing connectors.
+
+Any cell can be got, not just those in cellsRect: penalties of items and
+connectors hanging off the canvas are kept too, so that the cells never have
+to be made again when the canvas changes size.
+
 @author David Saxton
 */
 class Cells
 {
 public:
     Cells(const QRect &canvasRect);
+    /**
+     * Copies the cells, e.g. to see later which penalties have changed.
+     */
+    Cells(const Cells &c);
     ~Cells();
     /**
-     * Resets bestScore, prevX, prevY, addedToLabels, it, permanent for each cell
+     * Sets the rectangle of the canvas, which routes must stay inside. The
+     * cells already made are kept, along with their penalties.
      */
-    void reset();
+    void setCanvasRect(const QRect &canvasRect);
 
     QRect cellsRect() const
     {
@@ -101,12 +246,13 @@ public:
     /**
      * Returns the cell containing the given position on the canvas.
      */
-    Cell &cellContaining(int x, int y) const
+    Cell &cellContaining(int x, int y)
     {
         return cell(roundDown(x, 8), roundDown(y, 8));
     }
     /**
-     * @return if the given cell exists.
+     * @return if the given cell is in the canvas (cell and cellContaining
+     * can be used for any cell).
      */
     bool haveCell(int i, int j) const
     {
@@ -125,25 +271,76 @@ public:
     {
         return haveCell(roundDown(x, 8), roundDown(y, 8));
     }
-    Cell &cell(int i, int j) const
+    Cell &cell(int i, int j)
+    {
+        return m_cells.get(i, j);
+    }
+    /**
+     * As above, but without making the cell (a cell that has not been made
+     * has no penalties). This can be used by several threads at once.
+     */
+    const Cell &cell(int i, int j) const
+    {
+        const Cell *c = m_cells.find(i, j);
+        return c ? *c : s_emptyCell;
+    }
+    /**
+     * @return the memory held by the cells that have been made, in bytes.
+     */
+    qint64 memoryUsage() const
     {
-        assert(i < m_cellsRect.right());
-        assert(j < m_cellsRect.bottom());
-        i -= m_cellsRect.left();
-        j -= m_cellsRect.top();
-        return m_cells[i][j];
+        return m_cells.memoryUsage();
     }
 
 protected:
-    void init(const QRect &canvasRect);
-
     QRect m_cellsRect;
+    CellTiles<Cell> m_cells;
 
-    Cell **m_cells;
+    static const Cell s_emptyCell;
 
 private:
-    Cells(const Cells &);
     Cells &operator=(const Cells &);
 };
 
+/**
+The state of the route search of ConRouter, for each cell. There is one set
+of these for each thread, shared by all of the documents, as only one route
+is searched for at a time.
+*/
+class RouteCells
+{
+public:
+    RouteCells();
+
+    /**
+     * @return the route cells of the current thread.
+     */
+    static RouteCells *self();
+
+    /**
+     * Resets bestScore, prevX, prevY and permanent for each cell. This only
+     * starts a new search generation; the cells are reset as they are next
+     * got.
+     */
+    void reset();
+
+    RouteCell &cell(int i, int j)
+    {
+        RouteCell &c = m_cells.get(i, j);
+        if (c.searchGeneration != m_searchGeneration) {
+            c.reset();
+            c.searchGeneration = m_searchGeneration;
+        }
+        return c;
+    }
+
+protected:
+    CellTiles<RouteCell> m_cells;
+    unsigned m_searchGeneration;
+
+private:
+    RouteCells(const RouteCells &);
+    RouteCells &operator=(const RouteCells &);
+};
+
 #endif
@@ -16,14 +16,22 @@
 
 #include <KActionCollection>
 #include <KLocalizedString>
+#include <KSelectAction>
+#include <KToggleAction>
 
 #include <QAction>
 #include <QActionGroup>
 #include <QDragEnterEvent>
 #include <QMimeData>
 
+#include <algorithm>
+#include <iterator>
+
 #include <ktechlab_debug.h>
 
+/// The priorities that the simulation of a document can be given
+static const double simulationPriorities[] = {1., 0.5, 0.25, 0.1};
+
 CircuitView::CircuitView(CircuitDocument *circuitDocument, ViewContainer *viewContainer, uint viewAreaId)
     : ICNView(circuitDocument, viewContainer, viewAreaId)
     , p_circuitDocument(circuitDocument)
@@ -82,6 +90,47 @@ CircuitView::CircuitView(CircuitDocument *circuitDocument, ViewContainer *viewCo
         connect(ra, &QAction::triggered, circuitDocument, &CircuitDocument::createSubcircuit);
         ac->addAction(ra->objectName(), ra);
     }
+    {
+        QAction *ra = new QAction(QIcon::fromTheme("document-save"), i18n("Save Simulation State"), ac);
+        ra->setObjectName("circuit_save_state");
+        connect(ra, &QAction::triggered, circuitDocument, &CircuitDocument::saveSimulationCheckpoint);
+        ac->addAction(ra->objectName(), ra);
+    }
+    {
+        QAction *ra = new QAction(QIcon::fromTheme("document-revert"), i18n("Restore Simulation State"), ac);
+        ra->setObjectName("circuit_restore_state");
+        connect(ra, &QAction::triggered, circuitDocument, &CircuitDocument::restoreSimulationCheckpoint);
+        ac->addAction(ra->objectName(), ra);
+    }
+    {
+        QAction *ra = new QAction(QIcon::fromTheme("media-record"), i18n("Record Stimulus"), ac);
+        ra->setObjectName("circuit_record_stimulus");
+        ra->setCheckable(true);
+        connect(ra, &QAction::toggled, circuitDocument, &CircuitDocument::setStimulusRecording);
+        ac->addAction(ra->objectName(), ra);
+    }
+    {
+        QAction *ra = new QAction(QIcon::fromTheme("media-playback-start"), i18n("Play Stimulus..."), ac);
+        ra->setObjectName("circuit_play_stimulus");
+        connect(ra, &QAction::triggered, circuitDocument, &CircuitDocument::playStimulusFile);
+        ac->addAction(ra->objectName(), ra);
+    }
+    {
+        KToggleAction *ta = new KToggleAction(QIcon::fromTheme("media-playback-pause"), i18n("Pause This Circuit"), ac);
+        ta->setObjectName("circuit_pause_simulation");
+        connect(ta, &KToggleAction::toggled, circuitDocument, &CircuitDocument::setSimulationPaused);
+        ac->addAction(ta->objectName(), ta);
+    }
+    {
+        KSelectAction *sa = new KSelectAction(i18n("Simulation Priority"), ac);
+        sa->setObjectName("circuit_simulation_priority");
+        QStringList items;
+        for (double priority : simulationPriorities)
+            items << i18n("%1%", int(priority * 100));
+        sa->setItems(items);
+        connect(sa, qOverload<int>(&KSelectAction::triggered), this, &CircuitView::slotSimulationPriority);
+        ac->addAction(sa->objectName(), sa);
+    }
     {
         // new QAction( i18n("Rotate Clockwise"), "object-rotate-right", "]", circuitDocument, SLOT(rotateClockwise()), ac, "edit_rotate_cw" );
         QAction *ra = new QAction(QIcon::fromTheme("object-rotate-right"), i18n("Rotate Clockwise"), ac);
@@ -131,7 +180,9 @@ CircuitView::CircuitView(CircuitDocument *circuitDocument, ViewContainer *viewCo
     // see slotUpdateRunningStatus
     m_statusBar->setStatusText(i18n("Simulation Initializing"));
     connect(Simulator::self(), &Simulator::simulatingStateChanged, this, &CircuitView::slotUpdateRunningStatus);
-    slotUpdateRunningStatus(Simulator::self()->isSimulating());
+    connect(Simulator::self(), &Simulator::stepRateChanged, this, &CircuitView::slotUpdateSimulationSharing);
+    connect(circuitDocument, &CircuitDocument::simulationSharingChanged, this, &CircuitView::slotUpdateSimulationSharing);
+    slotUpdateSimulationSharing();
 }
 
 CircuitView::~CircuitView()
@@ -141,7 +192,51 @@ CircuitView::~CircuitView()
 
 void CircuitView::slotUpdateRunningStatus(bool isRunning)
 {
-    m_statusBar->setStatusText(isRunning ? i18n("Simulation Running") : i18n("Simulation Paused"));
+    if (!isRunning || p_circuitDocument->isSimulationPaused()) {
+        m_statusBar->setStatusText(i18n("Simulation Paused"));
+        return;
+    }
+
+    const double ratio = Simulator::self()->documentRealTimeRatio(p_circuitDocument);
+    if (ratio > 0.)
+        m_statusBar->setStatusText(i18n("Simulation Running (%1% of real time)", QString::number(ratio * 100., 'g', 3)));
+    else
+        m_statusBar->setStatusText(i18n("Simulation Running"));
+}
+
+void CircuitView::slotUpdateSimulationSharing()
+{
+    if (KToggleAction *ta = qobject_cast<KToggleAction *>(actionByName("circuit_pause_simulation")))
+        ta->setChecked(p_circuitDocument->isSimulationPaused());
+
+    if (KSelectAction *sa = qobject_cast<KSelectAction *>(actionByName("circuit_simulation_priority"))) {
+        const double *priority = std::find(std::begin(simulationPriorities), std::end(simulationPriorities), p_circuitDocument->simulationPriority());
+        sa->setCurrentItem((priority != std::end(simulationPriorities)) ? int(priority - std::begin(simulationPriorities)) : -1);
+    }
+
+    slotUpdateRunningStatus(Simulator::self()->isSimulating());
+}
+
+void CircuitView::slotSimulationPriority(int index)
+{
+    if (index >= 0 && index < int(std::end(simulationPriorities) - std::begin(simulationPriorities)))
+        p_circuitDocument->setSimulationPriority(simulationPriorities[index]);
+}
+
+void CircuitView::showEvent(QShowEvent *e)
+{
+    ICNView::showEvent(e);
+    // The view can outlive the document for a moment
+    if (document())
+        p_circuitDocument->updateSimulationShare();
+}
+
+void CircuitView::hideEvent(QHideEvent *e)
+{
+    ICNView::hideEvent(e);
+    // The view can outlive the document for a moment
+    if (document())
+        p_circuitDocument->updateSimulationShare();
 }
 
 void CircuitView::dragEnterEvent(QDragEnterEvent *e)
@@ -28,8 +28,18 @@ public:
 public slots:
     virtual void slotUpdateRunningStatus(bool isRunning);
 
+protected slots:
+    /**
+     * Shows whether the document is paused and how fast it is being
+     * simulated, in the status bar and the simulation actions.
+     */
+    void slotUpdateSimulationSharing();
+    void slotSimulationPriority(int index);
+
 protected:
     void dragEnterEvent(QDragEnterEvent *e) override;
+    void showEvent(QShowEvent *e) override;
+    void hideEvent(QHideEvent *e) override;
     CircuitDocument *p_circuitDocument;
 };
 
@@ -21,17 +21,25 @@
 
 #include <QBitArray>
 #include <QPainter>
+#include <QPixmap>
+#include <QPixmapCache>
 
 #include <cmath>
 #include <cstdlib>
 
 #include <ktechlab_debug.h>
 
+/// The size on screen (in pixels) below which items are drawn as outlines
+static const int MIN_DETAILED_SIZE = 12;
+/// The margin (in pixels) around the bounding rect kept in cached bodies, for antialiased pens
+static const int CACHED_BODY_MARGIN = 2;
+
 CNItem::CNItem(ICNDocument *icnDocument, bool newItem, const QString &id)
     : Item(icnDocument, newItem, id)
     , CIWidgetMgr(icnDocument ? icnDocument->canvas() : nullptr, this)
     , p_icnDocument(icnDocument)
     , b_pointsAdded(false)
+    , m_bCacheBody(false)
 {
     qCDebug(KTL_LOG) << " this=" << this;
 
@@ -392,6 +400,81 @@ void CNItem::drawShape(QPainter &p)
     // 	deinitPainter(p);
 }
 
+void CNItem::draw(QPainter &p)
+{
+    const QRect r = boundingRect();
+    if (drawScale(p) * qMin(r.width(), r.height()) >= MIN_DETAILED_SIZE) {
+        if (!m_bCacheBody || !drawCachedBody(p))
+            Item::draw(p);
+        return;
+    }
+
+    p.setPen(pen());
+    p.setBrush(brush());
+    CNItem::drawShape(p);
+}
+
+bool CNItem::drawCachedBody(QPainter &p)
+{
+    const QTransform &transform = p.worldTransform();
+    if (transform.type() > QTransform::TxScale || transform.m11() != transform.m22() || transform.m11() <= 0)
+        return false;
+
+    const double scale = transform.m11();
+    const QRect r = boundingRect().adjusted(-CACHED_BODY_MARGIN, -CACHED_BODY_MARGIN, CACHED_BODY_MARGIN, CACHED_BODY_MARGIN);
+
+    // Everything that drawShape may depend on; the position of the item is
+    // given relative to its bounding rect, so that items at different places
+    // share the same pixmap.
+    int angle = 0;
+    bool flipped = false;
+    if (Component *c = dynamic_cast<Component *>(this)) {
+        angle = c->angleDegrees();
+        flipped = c->flipped();
+    }
+
+    uint propertiesHash = 0;
+    for (VariantDataMap::const_iterator it = m_variantData.constBegin(); it != m_variantData.constEnd(); ++it)
+        propertiesHash = qHash(it.value()->value().toString(), propertiesHash ^ qHash(it.key()));
+
+    const QString key = QString("ktl-body:%1:%2,%3:%4x%5:%6:%7:%8:%9:%10,%11:%12")
+                            .arg(m_type)
+                            .arg(x() - r.left())
+                            .arg(y() - r.top())
+                            .arg(r.width())
+                            .arg(r.height())
+                            .arg(angle)
+                            .arg(flipped)
+                            .arg(isSelected())
+                            .arg(qRound(scale * 1000))
+                            .arg(pen().color().rgba())
+                            .arg(brush().color().rgba())
+                            .arg(propertiesHash);
+
+    QPixmap pixmap;
+    if (!QPixmapCache::find(key, &pixmap)) {
+        pixmap = QPixmap(int(std::ceil(r.width() * scale)), int(std::ceil(r.height() * scale)));
+        pixmap.fill(Qt::transparent);
+
+        QPainter pixmapPainter(&pixmap);
+        pixmapPainter.scale(scale, scale);
+        pixmapPainter.translate(-r.left(), -r.top());
+        Item::draw(pixmapPainter);
+        pixmapPainter.end();
+
+        QPixmapCache::insert(key, pixmap);
+    }
+
+    // The pixmap is placed on whole device pixels, which may be up to half a
+    // pixel away from where drawShape would have drawn at fractional zooms
+    const QPoint topLeft = transform.map(QPointF(r.topLeft())).toPoint();
+    p.save();
+    p.resetTransform();
+    p.drawPixmap(topLeft, pixmap);
+    p.restore();
+    return true;
+}
+
 void CNItem::initPainter(QPainter &p)
 {
     p.setRenderHint(QPainter::Antialiasing);
@@ -452,13 +535,11 @@ void CNItem::updateConnectorPoints(bool add)
 
     for (int x = sx_M; x < ex_M; x++) {
         for (int y = sy_M; y < ey_M; y++) {
-            if (cells->haveCell(x, y)) {
-                if (x != sx_M && y != sy_M && x != (ex_M - 1) && y != (ey_M - 1)) {
-                    cells->cell(x, y).CIpenalty += mult * ICNDocument::hs_item;
-                } else {
-                    //					(*cells)[x][y].CIpenalty += mult*ICNDocument::hs_item/2;
-                    cells->cell(x, y).CIpenalty += mult * ICNDocument::hs_connector * 5;
-                }
+            if (x != sx_M && y != sy_M && x != (ex_M - 1) && y != (ey_M - 1)) {
+                cells->cell(x, y).CIpenalty += mult * ICNDocument::hs_item;
+            } else {
+                //				(*cells)[x][y].CIpenalty += mult*ICNDocument::hs_item/2;
+                cells->cell(x, y).CIpenalty += mult * ICNDocument::hs_connector * 5;
             }
         }
     }
@@ -127,6 +127,22 @@ public:
     virtual void updateNodeLevels();
     void drawShape(QPainter &p) override;
 
+protected:
+    /**
+     * Draws just the outline of the item (as CNItem::drawShape) when the item
+     * is too small on the screen for the detail of drawShape to be made out,
+     * e.g. when zoomed out of a large circuit. If m_bCacheBody is set, the
+     * detailed drawing is rendered once into a pixmap shared by all items
+     * drawn the same, which is then blitted on later repaints.
+     */
+    void draw(QPainter &p) override;
+    /**
+     * Draws the item from the pixmap cache.
+     * @return false if the item could not be drawn from the cache (e.g. the
+     * painter is rotated), in which case it has to be drawn as normal
+     */
+    bool drawCachedBody(QPainter &p);
+
 signals:
     /**
      * Emitted when the angle or flipped'ness changes. Note that CNItem doesn't
@@ -181,6 +197,13 @@ protected:
     QColor m_selectedCol;
     QColor m_brushCol;
     bool b_pointsAdded;
+    /**
+     * Set this to true in the constructor if drawShape depends only on the
+     * type, size, orientation and property values of the item (and not on
+     * e.g. the state of the simulation), so that it can be drawn from the
+     * pixmap cache.
+     */
+    bool m_bCacheBody;
 };
 typedef QList<CNItem *> CNItemList;
 
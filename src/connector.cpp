@@ -21,6 +21,7 @@
 
 #include <QPainter>
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 
@@ -42,12 +43,16 @@ Connector::Connector(Node * /*startNode*/, Node * /*endNode*/, ICNDocument *icnD
     qCDebug(KTL_LOG) << " this=" << this;
 
     m_currentAnimationOffset = 0.0;
+    m_currentAnimationSpeed = 0.0;
+    m_prevVoltage = 0.0;
+    m_voltageColor = Component::voltageColor(0.0);
     p_parentContainer = nullptr;
     p_nodeGroup = nullptr;
     b_semiHidden = false;
     b_deleted = false;
     b_pointsAdded = false;
     b_manualPoints = false;
+    m_bRouteSegmentsDirty = true;
     p_icnDocument = icnDocument;
     m_conRouter = new ConRouter(p_icnDocument);
 
@@ -138,13 +143,18 @@ int getSlope(float x1, float y1, float x2, float y2)
 
 void Connector::updateDrawList()
 {
-    if (!startNode() || !endNode() || !canvas())
+    if (!startNode() || !endNode() || !canvas() || p_icnDocument->isHeadless())
         return;
 
     QPointList drawLineList;
 
-    int prevX = (*m_conRouter->cellPointList()->begin()).x();
-    int prevY = (*m_conRouter->cellPointList()->begin()).y();
+    // The bumps are worked out for each cell of the route
+    const QPointList cellPoints = m_conRouter->cellPointList();
+    if (cellPoints.isEmpty())
+        return;
+
+    int prevX = cellPoints.first().x();
+    int prevY = cellPoints.first().y();
 
     int prevX_canvas = toCanvas(prevX);
     int prevY_canvas = toCanvas(prevY);
@@ -152,7 +162,7 @@ void Connector::updateDrawList()
     Cells *cells = p_icnDocument->cells();
 
     bool bumpNow = false;
-    for (QPoint p : *m_conRouter->cellPointList()) {
+    for (QPoint p : cellPoints) {
         const int x = p.x();
         const int y = p.y();
 
@@ -295,10 +305,15 @@ void Connector::setSemiHidden(bool semiHidden)
 
 void Connector::updateConnectorPoints(bool add)
 {
+    // The route is taken out of the cells before it is changed, and put back
+    // after
+    m_bRouteSegmentsDirty = true;
+
     if (!canvas())
         return;
 
-    if (b_deleted || !isVisible())
+    // Nothing is routed in a headless document
+    if (b_deleted || !isVisible() || p_icnDocument->isHeadless())
         add = false;
 
     // Check we haven't already added/removed the points...
@@ -308,13 +323,14 @@ void Connector::updateConnectorPoints(bool add)
     b_pointsAdded = add;
 
     // We don't include the end points in the mapping
-    if (m_conRouter->cellPointList()->size() < 3)
+    const QPointList cellPoints = m_conRouter->cellPointList();
+    if (cellPoints.size() < 3)
         return;
 
     Cells *cells = p_icnDocument->cells();
 
     const int mult = (add) ? 1 : -1;
-    for (QPoint p : *m_conRouter->cellPointList()) {
+    for (QPoint p : cellPoints) {
         int x = p.x();
         int y = p.y();
 
@@ -328,8 +344,7 @@ void Connector::updateConnectorPoints(bool add)
         p_icnDocument->addCPenalty(x + 1, y, mult * ICNDocument::hs_connector / 2);
         p_icnDocument->addCPenalty(x, y + 1, mult * ICNDocument::hs_connector / 2);
 
-        if (cells->haveCell(x, y))
-            cells->cell(x, y).numCon += mult;
+        cells->cell(x, y).numCon += mult;
     }
 
     // 	updateDrawList();
@@ -407,7 +422,11 @@ void Connector::rerouteConnector()
     updateConnectorPoints(false);
 
     m_conRouter->mapRoute(int(startNode()->x()), int(startNode()->y()), int(endNode()->x()), int(endNode()->y()));
+    routeMapped();
+}
 
+void Connector::routeMapped()
+{
     b_manualPoints = false;
     updateConnectorPoints(true);
 }
@@ -440,7 +459,7 @@ ConnectorData Connector::connectorData() const
 
     connectorData.manualRoute = usesManualPoints();
 
-    connectorData.route = *m_conRouter->cellPointList();
+    connectorData.route = m_conRouter->routeCorners();
 
     if (startNode()->isChildNode()) {
         connectorData.startNodeIsChild = true;
@@ -498,8 +517,16 @@ void Connector::updateConnectorLines(bool forceRedraw)
         color = QColor(101, 134, 192);
     else if (!KTLConfig::showVoltageColor())
         color = Qt::black;
-    else
-        color = Component::voltageColor(wire() ? wire()->voltage() : 0.0);
+    else {
+        // The colour scale is logarithmic, so is only worked out again when
+        // the voltage moves
+        const double v = wire() ? wire()->voltage() : 0.0;
+        if (v != m_prevVoltage) {
+            m_voltageColor = Component::voltageColor(v);
+            m_prevVoltage = v;
+        }
+        color = m_voltageColor;
+    }
 
     int z = ICNDocument::Z::Connector + (isSelected() ? 5 : 0);
 
@@ -536,7 +563,78 @@ QPointList Connector::connectorPoints(bool reverse) const
     return m_conRouter->pointList(doReverse);
 }
 
-void Connector::incrementCurrentAnimation(double deltaTime)
+QPointList Connector::connectorCellPoints(bool reverse) const
+{
+    const QPointList cellPoints = m_conRouter->cellPointList();
+
+    QPointList points;
+    points.reserve(cellPoints.size());
+    for (const QPoint &cellPoint : cellPoints)
+        points.append(toCanvas(cellPoint));
+
+    if (reverse != pointsAreReverse(points))
+        std::reverse(points.begin(), points.end());
+    return points;
+}
+
+QRect Connector::routeBoundingRect() const
+{
+    const QPointList points = m_conRouter->pointList(false);
+
+    QRect bound;
+    const QPointList::const_iterator end = points.end();
+    for (QPointList::const_iterator it = points.begin(); it != end; ++it)
+        bound |= QRect(*it, QSize(1, 1));
+    return bound;
+}
+
+KtlQCanvasItemList Connector::routeCollisions() const
+{
+    if (!canvas())
+        return KtlQCanvasItemList();
+
+    updateRouteSegments();
+    return canvas()->collisions(m_routeSegments, m_routeSegmentBounds);
+}
+
+void Connector::updateRouteSegments() const
+{
+    if (!m_bRouteSegmentsDirty)
+        return;
+
+    m_bRouteSegmentsDirty = false;
+    m_routeSegments.clear();
+    m_routeSegmentBounds.clear();
+
+    const QPointList points = m_conRouter->pointList(false);
+    if (points.isEmpty())
+        return;
+
+    QPoint start = points.first();
+    QPoint prev = start;
+    for (const QPoint &p : points) {
+        if (p == prev)
+            continue;
+
+        // The route goes from cell to cell, so carry on the segment for as
+        // long as it goes in the same direction
+        const QPoint along = prev - start;
+        const QPoint next = p - prev;
+        if (along != QPoint() && (along.x() * next.y() != along.y() * next.x() || QPoint::dotProduct(along, next) < 0)) {
+            m_routeSegments.append(QLine(start, prev));
+            start = prev;
+        }
+        prev = p;
+    }
+    if (prev != start || m_routeSegments.isEmpty())
+        m_routeSegments.append(QLine(start, prev));
+
+    m_routeSegmentBounds.reserve(m_routeSegments.size());
+    for (const QLine &segment : qAsConst(m_routeSegments))
+        m_routeSegmentBounds.append(QRect(segment.p1(), segment.p2()).normalized());
+}
+
+void Connector::updateCurrentAnimationSpeed()
 {
     // The values and equations used in this function have just been developed
     // empircally to be able to show a nice range of currents while still giving
@@ -545,6 +643,7 @@ void Connector::incrementCurrentAnimation(double deltaTime)
     double I_min = 1e-4;
     double sf = 3.0; // scaling factor
 
+    m_currentAnimationSpeed = 0.0;
     for (int i = 0; i < m_wires.size(); ++i) {
         if (!m_wires[i])
             continue;
@@ -554,9 +653,19 @@ void Connector::incrementCurrentAnimation(double deltaTime)
         double I_abs = I * sign;
         double prop = (I_abs > I_min) ? std::log(I_abs / I_min) : 0.0;
 
-        m_currentAnimationOffset += deltaTime * sf * std::pow(prop, 1.3) * sign;
+        m_currentAnimationSpeed += sf * std::pow(prop, 1.3) * sign;
     }
 }
+
+bool Connector::incrementCurrentAnimation(double deltaTime)
+{
+    if (m_currentAnimationSpeed == 0.0)
+        return false;
+
+    const int oldOffset = int(m_currentAnimationOffset);
+    m_currentAnimationOffset += deltaTime * m_currentAnimationSpeed;
+    return int(m_currentAnimationOffset) != oldOffset;
+}
 // END class Connector
 
 // BEGIN class ConnectorLine
@@ -13,7 +13,9 @@
 
 //#include <canvas.h> // 2018.10.16 - not needed
 #include "canvasitems.h"
+#include <QLine>
 #include <QPointer>
+#include <QVector>
 // #include <q3valuevector.h>
 
 class Cell;
@@ -166,17 +168,47 @@ public:
     bool pointsAreReverse(const QPointList &pointList) const;
 
     /**
-     * Returns the points, given in canvas-reference, in order of start node to
-     * end node if reverse is false
+     * Returns the points at the corners of the route, given in
+     * canvas-reference, in order of start node to end node if reverse is false
      * @param reverse whether or not to reverse the points from start node to end node
      */
     QPointList connectorPoints(bool reverse = false) const;
+    /**
+     * As connectorPoints, but with a point for every cell along the route,
+     * for following the route a step at a time.
+     */
+    QPointList connectorCellPoints(bool reverse = false) const;
+    /**
+     * @return the smallest rectangle (in canvas-reference) containing the
+     * points of the route
+     */
+    QRect routeBoundingRect() const;
+    /**
+     * @return the canvas items that the route crosses. This is the exact test
+     * for the route, as the connector has no area itself; the segments of the
+     * route and their bounds are kept until the route changes.
+     */
+    KtlQCanvasItemList routeCollisions() const;
 
     /**
      * Reroute the connector. Note that if this connector is controlled by a
      * NodeGroup, it will do nothing (other than print out a warning)
      */
     void rerouteConnector();
+    /**
+     * The router of the connector, for when the route is mapped elsewhere
+     * (see ICNDocument::rerouteConnectors). Call routeMapped afterwards.
+     */
+    ConRouter *conRouter() const
+    {
+        return m_conRouter;
+    }
+    /**
+     * Makes the route just mapped by the router the route of the connector,
+     * adding its points to the cells, as rerouteConnector does after mapping
+     * the route.
+     */
+    void routeMapped();
 
     /**
      * Translates the route by the given amoumt. No checking is done to see if
@@ -209,11 +241,19 @@ public:
         return m_currentAnimationOffset;
     }
 
+    /**
+     * Works out how fast the current animation moves from the currents in the
+     * wires. This only needs calling when the currents have been worked out
+     * again.
+     */
+    void updateCurrentAnimationSpeed();
     /**
      * Increases the currentAnimationOffset according to the current flowing in
-     * the connector and deltaTime.
+     * the connector (as of the last updateCurrentAnimationSpeed) and deltaTime.
+     * @return whether the animation moved by a pixel or more, i.e. whether the
+     * connector has to be drawn again
      */
-    void incrementCurrentAnimation(double deltaTime);
+    bool incrementCurrentAnimation(double deltaTime);
 
 signals:
     void removed(Connector *connector);
@@ -225,9 +265,6 @@ public slots:
     void removeConnectorNodeArg(Node *);
     void removeConnector(Node *);
 
-    // protected:
-    //	bool m_bIsSyncingWires;
-
 protected:
     WireVector m_wires;
 
@@ -238,15 +275,28 @@ private:
     bool b_pointsAdded;
 
     double m_currentAnimationOffset;
+    double m_currentAnimationSpeed; // In pixels per second
+    double m_prevVoltage;  // The wire voltage that m_voltageColor is for
+    QColor m_voltageColor;
 
     NodeGroup *p_nodeGroup;
     CNItem *p_parentContainer;
     ICNDocument *p_icnDocument;
     ConRouter *m_conRouter;
 
+    /**
+     * Works out m_routeSegments and m_routeSegmentBounds from the route, if
+     * it has changed since they were last worked out.
+     */
+    void updateRouteSegments() const;
+
     QString m_id;
     QRect m_oldBoundRect;
 
+    mutable QVector<QLine> m_routeSegments; // In canvas-reference, with the cells in a line joined up
+    mutable QVector<QRect> m_routeSegmentBounds;
+    mutable bool m_bRouteSegmentsDirty;
+
     ConnectorLineList m_connectorLineList;
 };
 
@@ -12,9 +12,11 @@
 #include "icndocument.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
+#include <iterator>
 
 #include <ktechlab_debug.h>
 
@@ -30,23 +32,39 @@ ConRouter::~ConRouter()
 
 QPointList ConRouter::pointList(bool reverse) const
 {
+    if (!reverse)
+        return m_pointList;
+
     QPointList pointList;
+    pointList.reserve(m_pointList.size());
+    std::reverse_copy(m_pointList.begin(), m_pointList.end(), std::back_inserter(pointList));
+    return pointList;
+}
 
-    if (reverse) {
-        bool notDone = m_cellPointList.size() > 0;
-        for (QPointList::const_iterator it = (--m_cellPointList.constEnd()); notDone; --it) {
-            pointList.append(toCanvas(&*it));
-            if (it == m_cellPointList.begin())
-                notDone = false;
-        }
-    } else {
-        const QPointList::const_iterator end = m_cellPointList.end();
-        for (QPointList::const_iterator it = m_cellPointList.begin(); it != end; ++it) {
-            pointList.append(toCanvas(&*it));
+QPointList ConRouter::cellPointList() const
+{
+    if (m_cellPointList.isEmpty())
+        return QPointList();
+
+    QPointList cellPointList;
+    QPoint prevCellPoint = m_cellPointList.first();
+    for (const QPoint &cellPoint : m_cellPointList) {
+        while (prevCellPoint != cellPoint) {
+            cellPointList.append(prevCellPoint);
+
+            if (prevCellPoint.x() < cellPoint.x())
+                prevCellPoint.setX(prevCellPoint.x() + 1);
+            else if (prevCellPoint.x() > cellPoint.x())
+                prevCellPoint.setX(prevCellPoint.x() - 1);
+            if (prevCellPoint.y() < cellPoint.y())
+                prevCellPoint.setY(prevCellPoint.y() + 1);
+            else if (prevCellPoint.y() > cellPoint.y())
+                prevCellPoint.setY(prevCellPoint.y() - 1);
         }
     }
+    cellPointList.append(prevCellPoint);
 
-    return pointList;
+    return cellPointList;
 }
 
 QPointListList ConRouter::splitPoints(const QPoint &pos) const
@@ -55,15 +73,17 @@ QPointListList ConRouter::splitPoints(const QPoint &pos) const
 
     QList<QPointList> list;
 
+    const QPointList cells = cellPointList();
+
     // Check that the point is in the connector points, and not at the start or end
     bool found = false;
-    QPointList::const_iterator end = m_cellPointList.end();
+    QPointList::const_iterator end = cells.end();
 
     double dl[] = {0.0, 1.1, 1.5}; // sqrt(2) < 1.5 < sqrt(5)
     for (unsigned i = 0; (i < 3) && !found; ++i) {
-        for (QPointList::const_iterator it = m_cellPointList.begin(); it != end && !found; ++it) {
-            QPointList::const_iterator fromLast = --m_cellPointList.constEnd();
-            if (qpoint_distance(*it, split) <= dl[i] && it != m_cellPointList.begin() && it != fromLast) // m_cellPointList.fromLast() )
+        for (QPointList::const_iterator it = cells.begin(); it != end && !found; ++it) {
+            QPointList::const_iterator fromLast = --cells.constEnd();
+            if (qpoint_distance(*it, split) <= dl[i] && it != cells.begin() && it != fromLast) // cells.fromLast() )
                 found = true;
         }
     }
@@ -75,10 +95,10 @@ QPointListList ConRouter::splitPoints(const QPoint &pos) const
         qCWarning(KTL_LOG) << "ConRouter::splitConnectorPoints: Could not find point (" << pos.x() << ", " << pos.y() << ") in connector points";
         qCWarning(KTL_LOG) << "ConRouter::splitConnectorPoints: Returning generic list";
 
-        first.append(toCanvas(m_cellPointList.first()));
+        first.append(toCanvas(cells.first()));
         first.append(pos);
         second.append(pos);
-        second.append(toCanvas(m_cellPointList.last()));
+        second.append(toCanvas(cells.last()));
 
         list.append(first);
         list.append(second);
@@ -88,7 +108,7 @@ QPointListList ConRouter::splitPoints(const QPoint &pos) const
 
     // Now add the points to the two lists
     bool gotToSplit = false;
-    for (QPointList::const_iterator it = m_cellPointList.begin(); it != end; ++it) {
+    for (QPointList::const_iterator it = cells.begin(); it != end; ++it) {
         QPoint canvasPoint = toCanvas(&*it);
         if (*it == split) {
             gotToSplit = true;
@@ -112,7 +132,7 @@ QPointListList ConRouter::dividePoints(uint n) const
 {
     // Divide the points up into n pieces...
 
-    QPointList points = m_cellPointList;
+    QPointList points = cellPointList();
     assert(n != 0);
     if (points.size() == 0) {
         points += QPoint(toCanvas(m_lcx), toCanvas(m_lcy));
@@ -137,17 +157,18 @@ QPointListList ConRouter::dividePoints(uint n) const
     return pll;
 }
 
-void ConRouter::checkACell(int x, int y, Cell *prev, int prevX, int prevY, int nextScore)
+void ConRouter::checkACell(int x, int y, RouteCell *prev, int prevX, int prevY, int nextScore)
 {
     // 	if ( !p_icnDocument->isValidCellReference(x,y) ) return;
-    if (!cellsPtr->haveCell(x, y))
+    if (!cellsPtr->haveCell(x, y) || !m_searchRect.contains(x, y))
         return;
 
-    Cell *c = &cellsPtr->cell(x, y);
+    RouteCell *c = &routeCells->cell(x, y);
     if (c->permanent)
         return;
 
-    int newScore = nextScore + c->CIpenalty + c->Cpenalty;
+    const Cell &penalties = cellsPtr->cell(x, y);
+    int newScore = nextScore + penalties.CIpenalty + penalties.Cpenalty;
 
     // Check for changing direction
     if (x != prevX && prev->prevX == prevX)
@@ -158,35 +179,29 @@ void ConRouter::checkACell(int x, int y, Cell *prev, int prevX, int prevY, int n
     if (c->bestScore < newScore)
         return;
 
-    // We only want to change the previous cell if the score is different,
-    // or the score is the same but this cell allows the connector
-    // to travel in the same direction
+    c->prevX = prevX;
+    c->prevY = prevY;
 
-    if (c->bestScore == newScore && x != prevX && y != prevY)
+    // A label with this score is already waiting
+    if (c->bestScore == newScore)
         return;
 
+    // Any label with the old score is left in the heap, and skipped when it
+    // comes to the top
     c->bestScore = newScore;
-    c->prevX = prevX;
-    c->prevY = prevY;
 
-    if (!c->addedToLabels) {
-        c->addedToLabels = true;
-        Point point;
-        point.x = x;
-        point.y = y;
-        point.prevX = prevX;
-        point.prevY = prevY;
-        TempLabelMap::iterator it = tempLabels.insert(std::make_pair(newScore, point));
-        c->point = &it->second;
-    } else {
-        c->point->prevX = prevX;
-        c->point->prevY = prevY;
-    }
+    TempLabel label;
+    label.estimate = newScore + remainingScore(x, y);
+    label.score = newScore;
+    label.x = x;
+    label.y = y;
+    tempLabels.push_back(label);
+    std::push_heap(tempLabels.begin(), tempLabels.end());
 }
 
 void ConRouter::checkCell(int x, int y)
 {
-    Cell *c = &cellsPtr->cell(x, y);
+    RouteCell *c = &routeCells->cell(x, y);
 
     c->permanent = true;
     int nextScore = c->bestScore + 1;
@@ -220,8 +235,9 @@ bool ConRouter::needsRouting(int sx, int sy, int ex, int ey) const
 
 void ConRouter::setRoutePoints(const QPointList &pointList)
 {
+    // Which may be every cell along the route, as saved by older versions
     m_cellPointList = pointList;
-    removeDuplicatePoints();
+    compressRoute();
 }
 
 void ConRouter::setPoints(const QPointList &pointList, bool reverse)
@@ -229,43 +245,14 @@ void ConRouter::setPoints(const QPointList &pointList, bool reverse)
     if (pointList.size() == 0)
         return;
 
-    QPointList cellPointList;
-
-    QPoint prevCellPoint = fromCanvas(*pointList.begin());
-    cellPointList.append(prevCellPoint);
-    const QPointList::const_iterator end = pointList.end();
-    for (QPointList::const_iterator it = pointList.begin(); it != end; ++it) {
-        QPoint cellPoint = fromCanvas(*it);
-
-        while (prevCellPoint != cellPoint) {
-            cellPointList.append(prevCellPoint);
-
-            if (prevCellPoint.x() < cellPoint.x())
-                prevCellPoint.setX(prevCellPoint.x() + 1);
-            else if (prevCellPoint.x() > cellPoint.x())
-                prevCellPoint.setX(prevCellPoint.x() - 1);
-            if (prevCellPoint.y() < cellPoint.y())
-                prevCellPoint.setY(prevCellPoint.y() + 1);
-            else if (prevCellPoint.y() > cellPoint.y())
-                prevCellPoint.setY(prevCellPoint.y() - 1);
-        };
-
-        prevCellPoint = cellPoint;
-    }
-    cellPointList.append(prevCellPoint);
+    m_cellPointList.clear();
+    for (const QPoint &point : pointList)
+        m_cellPointList.append(fromCanvas(point));
 
-    if (reverse) {
-        m_cellPointList.clear();
-        const QPointList::iterator begin = cellPointList.begin();
-        for (QPointList::iterator it = --cellPointList.end(); it != begin; --it) {
-            m_cellPointList += *it;
-        }
-        m_cellPointList += *begin;
-    } else {
-        m_cellPointList = cellPointList;
-    }
+    if (reverse)
+        std::reverse(m_cellPointList.begin(), m_cellPointList.end());
 
-    removeDuplicatePoints();
+    compressRoute();
 }
 
 void ConRouter::translateRoute(int dx, int dy)
@@ -284,17 +271,23 @@ void ConRouter::translateRoute(int dx, int dy)
         (*it) += ds;
     }
 
-    removeDuplicatePoints();
+    compressRoute();
 }
 
 void ConRouter::mapRoute(int sx, int sy, int ex, int ey)
+{
+    mapRoute(sx, sy, ex, ey, p_icnDocument->cells());
+}
+
+void ConRouter::mapRoute(int sx, int sy, int ex, int ey, const Cells *cells)
 {
     const int scx = fromCanvas(sx);
     const int scy = fromCanvas(sy);
     const int ecx = fromCanvas(ex);
     const int ecy = fromCanvas(ey);
 
-    cellsPtr = p_icnDocument->cells();
+    cellsPtr = cells;
+    routeCells = RouteCells::self();
 
     if (!cellsPtr->haveCell(scx, scy) || !cellsPtr->haveCell(ecx, ecy)) {
         qCDebug(KTL_LOG) << "cellPtr doesn't have cells, giving up";
@@ -352,27 +345,37 @@ void ConRouter::mapRoute(int sx, int sy, int ex, int ey)
 
     // It seems we must resort to brute-force route-checking
     {
-        cellsPtr->reset();
-
-        xcells = p_icnDocument->canvas()->width() / 8;
-        ycells = p_icnDocument->canvas()->height() / 8;
-
-        // Now to map out the shortest routes to the cells
-        Cell *const startCell = &cellsPtr->cell(ecx, ecy);
-        startCell->permanent = true;
-        startCell->bestScore = 0;
-        startCell->prevX = startCellPos;
-        startCell->prevY = startCellPos;
-
-        tempLabels.clear();
-        checkCell(ecx, ecy);
-
-        // Daniel: I changed it from a do while to a while otherwise
-        // in rare cases the iterator can end up as end().
-        while (tempLabels.size() > 0 && !cellsPtr->cell(scx, scy).permanent) {
-            TempLabelMap::iterator it = tempLabels.begin();
-            checkCell(it->second.x, it->second.y);
-            tempLabels.erase(it);
+        // Only look at the cells near the two ends, unless there is no route
+        // there
+        const QRect endsRect = QRect(QPoint(std::min(scx, ecx), std::min(scy, ecy)), QPoint(std::max(scx, ecx), std::max(scy, ecy)));
+        const QRect allCellsRect = cellsPtr->cellsRect();
+        m_tcx = scx;
+        m_tcy = scy;
+
+        for (int margin = SEARCH_MARGIN;; margin *= 2) {
+            m_searchRect = endsRect.adjusted(-margin, -margin, margin, margin) & allCellsRect;
+            routeCells->reset();
+
+            // Now to map out the shortest routes to the cells
+            RouteCell *const startCell = &routeCells->cell(ecx, ecy);
+            startCell->bestScore = 0;
+
+            tempLabels.clear();
+            checkCell(ecx, ecy);
+
+            RouteCell *const targetCell = &routeCells->cell(scx, scy);
+            while (!tempLabels.empty() && !targetCell->permanent) {
+                std::pop_heap(tempLabels.begin(), tempLabels.end());
+                const TempLabel label = tempLabels.back();
+                tempLabels.pop_back();
+
+                const RouteCell &c = routeCells->cell(label.x, label.y);
+                if (!c.permanent && c.bestScore == label.score)
+                    checkCell(label.x, label.y);
+            }
+
+            if (targetCell->permanent || m_searchRect == allCellsRect)
+                break;
         }
 
         // Now, retrace the shortest route from the endcell to get out points :)
@@ -381,8 +384,8 @@ void ConRouter::mapRoute(int sx, int sy, int ex, int ey)
 
         do {
             m_cellPointList.append(QPoint(x, y));
-            int newx = cellsPtr->cell(x, y).prevX;
-            int newy = cellsPtr->cell(x, y).prevY;
+            int newx = routeCells->cell(x, y).prevX;
+            int newy = routeCells->cell(x, y).prevY;
             if (newx == x && newy == y) {
                 ok = false;
             }
@@ -394,7 +397,7 @@ void ConRouter::mapRoute(int sx, int sy, int ex, int ey)
         m_cellPointList.append(QPoint(ecx, ecy));
     }
 
-    removeDuplicatePoints();
+    compressRoute();
 }
 
 bool ConRouter::checkLineRoute(int scx, int scy, int ecx, int ecy, int maxConScore, int maxCIScore)
@@ -417,7 +420,7 @@ bool ConRouter::checkLineRoute(int scx, int scy, int ecx, int ecy, int maxConSco
         x = scx;
     }
 
-    Cells *cells = p_icnDocument->cells();
+    const Cells *cells = cellsPtr;
 
     if (isHorizontal) {
         for (int x = start; x != end; x += dd) {
@@ -438,22 +441,37 @@ bool ConRouter::checkLineRoute(int scx, int scy, int ecx, int ecy, int maxConSco
 
     m_cellPointList.prepend(QPoint(scx, scy));
     m_cellPointList.append(QPoint(ecx, ecy));
-    removeDuplicatePoints();
+    compressRoute();
     return true;
 }
 
-void ConRouter::removeDuplicatePoints()
+void ConRouter::compressRoute()
 {
-    QPoint invalid(-(1 << 30), -(1 << 30));
-    QPoint prev = invalid;
-
-    const QPointList::iterator end = m_cellPointList.end();
-    for (QPointList::iterator it = m_cellPointList.begin(); it != end; ++it) {
-        if (*it == prev) {
-            *it = invalid;
-        } else {
-            prev = *it;
+    // Points are dropped where the route carries on in the same direction,
+    // one cell at a time, so that cellPointList gives the cells back
+    QPointList corners;
+    corners.reserve(m_cellPointList.size());
+
+    QPoint prevStep;
+    for (const QPoint &p : qAsConst(m_cellPointList)) {
+        if (!corners.isEmpty() && p == corners.last())
+            continue;
+
+        if (corners.size() >= 2) {
+            const QPoint step = p - corners.last();
+            if (step == prevStep && std::abs(step.x()) <= 1 && std::abs(step.y()) <= 1) {
+                corners.last() = p;
+                continue;
+            }
         }
+        if (!corners.isEmpty())
+            prevStep = p - corners.last();
+        corners.append(p);
     }
-    m_cellPointList.removeAll(invalid);
+    m_cellPointList = corners;
+
+    m_pointList.clear();
+    m_pointList.reserve(m_cellPointList.size());
+    for (const QPoint &p : qAsConst(m_cellPointList))
+        m_pointList.append(toCanvas(p));
 }
@@ -16,8 +16,9 @@
 #include <QList>
 #include <QPoint>
 
+#include <cstdlib>
+
 class ICNDocument;
-class Cell;
 
 typedef QList<QPoint> QPointList;
 typedef QList<QPointList> QPointListList;
@@ -42,6 +43,13 @@ public:
      * What this class is all about - finding a route, from (sx,sy) to (ex,ey).
      */
     void mapRoute(int sx, int sy, int ex, int ey);
+    /**
+     * Finds a route as above, but using the given cells rather than those of
+     * the document. The cells are only read (the state of the search is kept
+     * in the RouteCells of the thread), so routers on different threads can
+     * use the same cells at the same time.
+     */
+    void mapRoute(int sx, int sy, int ex, int ey, const Cells *cells);
     /**
      * Translates the precalculated routepoints by the given amount
      */
@@ -60,16 +68,23 @@ public:
      */
     bool needsRouting(int sx, int sy, int ex, int ey) const;
     /**
-     * Returns the list of canvas points
+     * Returns the list of canvas points at the corners of the route (and its
+     * ends). The list is kept, so returning it forwards does not copy it.
      */
     QPointList pointList(bool reverse) const;
     /**
-     * Returns a pointer to the internal cellPointList
+     * Returns the cell points at the corners of the route (and its ends),
+     * which is how the route is kept.
      */
-    QPointList *cellPointList()
+    const QPointList &routeCorners() const
     {
-        return &m_cellPointList;
+        return m_cellPointList;
     }
+    /**
+     * Returns every cell point along the route, for where each cell matters
+     * (such as for the penalties of the cells the route goes through).
+     */
+    QPointList cellPointList() const;
     /**
      * This will return two lists of Canvas points from the splitting of the
      * route at the Canvas point "pos". The internal stored points are not
@@ -87,19 +102,42 @@ protected:
      * Check a line of the ICNDocument cells for a valid route
      */
     bool checkLineRoute(int scx, int scy, int ecx, int ecy, int maxConScore, int maxCIScore);
-    void checkACell(int x, int y, Cell *prev, int prevX, int prevY, int nextScore);
+    void checkACell(int x, int y, RouteCell *prev, int prevX, int prevY, int nextScore);
     void checkCell(int x, int y); // Gets the shortest route from the final cell
     /**
-     * Remove duplicated points from the route
+     * The least score a route from the given cell to the target cell
+     * (m_tcx, m_tcy) can have, as each cell adds at least one.
+     */
+    unsigned remainingScore(int x, int y) const
+    {
+        return std::abs(x - m_tcx) + std::abs(y - m_tcy);
+    }
+    /**
+     * Removes the points from the route that are not at a corner (or an end),
+     * and updates m_pointList to match.
+     */
+    void compressRoute();
+
+    /**
+     * How far (in cells) the brute-force search first looks beyond the
+     * rectangle spanned by the two ends of the route. This is doubled until
+     * a route is found, or the search covers all of the cells.
+     *
+     * The search itself is A*: it starts from the end cell, and takes the
+     * cells in order of their score plus remainingScore, so it heads for
+     * the start cell rather than spreading out evenly.
      */
-    void removeDuplicatePoints();
+    static const int SEARCH_MARGIN = 16;
 
-    int xcells, ycells;
+    QRect m_searchRect; ///< cells the brute-force search may use
     int m_lcx, m_lcy; // Last x / y from mapRoute, if we need a point on the route
-    Cells *cellsPtr;
-    TempLabelMap tempLabels;
+    int m_tcx, m_tcy; // The cell the brute-force search is heading for
+    const Cells *cellsPtr;
+    RouteCells *routeCells;
+    TempLabelHeap tempLabels;
     ICNDocument *p_icnDocument;
-    QPointList m_cellPointList;
+    QPointList m_cellPointList; // The corners of the route; every cell while mapping it
+    QPointList m_pointList; // m_cellPointList in canvas-space
 };
 
 #endif
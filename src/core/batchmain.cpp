@@ -0,0 +1,955 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+/*
+ * ktechlab-batch: simulates a circuit without showing any windows, and
+ * writes the values of its probes as CSV. For regression and throughput
+ * tests on machines without a display.
+ *
+ * With --sweep, --vary or --runs, the circuit is simulated many times with
+ * different property values instead, each run in its own ktechlab-batch
+ * process (the simulator is a singleton), as many at a time as there are
+ * cores. The probe values of each run are summarised, one row per run.
+ *
+ * With --worker, the runs are shared out among other machines as well: each
+ * worker is a command that starts ktechlab-batch there (such as through ssh).
+ * A worker is sent the circuit on its standard input (the circuit "-") and
+ * writes the probe values of its run to its standard output as usual, so it
+ * needs nothing but ktechlab-batch installed (and any files the circuit
+ * reads). Runs whose worker could not be reached are done again elsewhere.
+ *
+ * With --ac, the circuit is simulated for --time to settle, and then its
+ * small-signal frequency response to one of its signal sources is written
+ * instead, as the magnitude (in dB) and phase of each probe by frequency.
+ *
+ * With --dc, a property is stepped through a range instead, and the DC
+ * operating point found at each value (each starting from the one before),
+ * for transfer curves.
+ */
+
+#include "acanalysis.h"
+#include "circuit.h"
+#include "circuitdocument.h"
+#include "component.h"
+#include "element.h"
+#include "headless.h"
+#include "item.h"
+#include "probe.h"
+#include "simulator.h"
+#include "variant.h"
+
+#include <ktechlab_version.h>
+
+#include <KAboutData>
+#include <KLocalizedString>
+#include <KShell>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QTemporaryFile>
+#include <QTextStream>
+#include <QThread>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <random>
+#include <vector>
+
+using Headless::printError;
+using Headless::processPendingEvents;
+
+static void writeRow(QTextStream &stream, double time, const QList<Probe *> &probes)
+{
+    stream << time;
+    for (QList<Probe *>::const_iterator it = probes.begin(); it != probes.end(); ++it)
+        stream << ',' << (*it)->value();
+    stream << '\n';
+}
+
+static bool lessId(const Probe *a, const Probe *b)
+{
+    return a->id() < b->id();
+}
+
+/**
+ * Splits "item:property=value" into its parts.
+ */
+static bool parseAssignment(const QString &spec, QString *itemId, QString *propertyId, QString *value)
+{
+    const int colon = spec.indexOf(':');
+    const int equals = spec.indexOf('=', colon + 1);
+    if (colon <= 0 || equals <= colon + 1)
+        return false;
+
+    *itemId = spec.left(colon);
+    *propertyId = spec.mid(colon + 1, equals - colon - 1);
+    *value = spec.mid(equals + 1);
+    return true;
+}
+
+/**
+ * @return the property of the item with the given id, or nullptr (with an
+ * error printed) if there is no such item or property.
+ */
+static Property *findProperty(ItemDocument *document, const QString &itemId, const QString &propertyId)
+{
+    Item *item = document->itemWithID(itemId);
+    if (!item) {
+        printError(i18n("There is no item \"%1\" in the circuit", itemId));
+        return nullptr;
+    }
+    if (!item->hasProperty(propertyId)) {
+        printError(i18n("Item \"%1\" has no property \"%2\"", itemId, propertyId));
+        return nullptr;
+    }
+    return item->property(propertyId);
+}
+
+/**
+ * Sets a property from a "item:property=value" specification, as given to
+ * --set.
+ */
+static bool applySetting(ItemDocument *document, const QString &spec)
+{
+    QString itemId, propertyId, value;
+    if (!parseAssignment(spec, &itemId, &propertyId, &value)) {
+        printError(i18n("Expected item:property=value, not \"%1\"", spec));
+        return false;
+    }
+
+    Property *property = findProperty(document, itemId, propertyId);
+    if (!property)
+        return false;
+
+    bool ok = true;
+    switch (property->type()) {
+    case Variant::Type::Double:
+        property->setValue(value.toDouble(&ok));
+        break;
+    case Variant::Type::Int:
+        property->setValue(value.toInt(&ok));
+        break;
+    case Variant::Type::Bool:
+        ok = (value == "true" || value == "false");
+        property->setValue(value == "true");
+        break;
+    default:
+        property->setValue(value);
+        break;
+    }
+
+    if (!ok) {
+        printError(i18n("Invalid value \"%1\" for property \"%2\" of \"%3\"", value, propertyId, itemId));
+        return false;
+    }
+    return true;
+}
+
+// BEGIN Sweeps
+namespace
+{
+/**
+ * A numerical property that takes a different value in each run: either
+ * stepped through a range (--sweep), or picked at random within a
+ * tolerance of its value in the document (--vary).
+ */
+class Variation
+{
+public:
+    QString name; ///< item:property
+    bool random;
+    bool integer; ///< whether the property is an Int
+    double start;
+    double stop;
+    int count;        ///< number of values to sweep through
+    double nominal;   ///< the value in the document
+    double tolerance; ///< relative
+};
+
+/**
+ * The probe values of one run, over all the samples.
+ */
+class ProbeSummary
+{
+public:
+    ProbeSummary()
+        : last(0.)
+        , min(std::numeric_limits<double>::infinity())
+        , max(-std::numeric_limits<double>::infinity())
+        , sum(0.)
+        , count(0)
+    {
+    }
+
+    void add(double value)
+    {
+        last = value;
+        min = std::min(min, value);
+        max = std::max(max, value);
+        sum += value;
+        count++;
+    }
+    double mean() const
+    {
+        return count > 0 ? sum / count : 0.;
+    }
+
+    double last; ///< the final value
+    double min;
+    double max;
+    double sum;
+    int count;
+};
+
+class Run
+{
+public:
+    QStringList settings; ///< as for --set
+    std::vector<double> values; ///< value of each Variation
+    std::vector<ProbeSummary> probes;
+    bool succeeded;
+    int attempts; ///< how many times the run has been started
+};
+
+/**
+ * Somewhere the runs can be done: this machine, or a command that starts
+ * ktechlab-batch on another (from --worker).
+ */
+class Worker
+{
+public:
+    QString program;
+    QStringList arguments; ///< put before those of the run
+    bool remote; ///< whether it is sent the circuit rather than its file name
+    int slots; ///< how many runs it does at a time
+    int running;
+};
+}
+
+// Runs that could not be started, or whose worker went away, are started
+// again (on whichever worker is free) this many times at most
+static const int MAX_RUN_ATTEMPTS = 3;
+// What ssh exits with when it could not connect
+static const int REMOTE_CONNECTION_FAILED = 255;
+
+/**
+ * Parses "[slots:]command" (for --worker).
+ */
+static bool parseWorker(const QString &spec, Worker *worker)
+{
+    QString command = spec;
+    worker->slots = 1;
+
+    const int colon = spec.indexOf(':');
+    if (colon > 0) {
+        bool ok = false;
+        const int slots = spec.left(colon).toInt(&ok);
+        if (ok) {
+            if (slots < 1)
+                return false;
+            worker->slots = slots;
+            command = spec.mid(colon + 1);
+        }
+    }
+
+    KShell::Errors error;
+    QStringList arguments = KShell::splitArgs(command, KShell::NoOptions, &error);
+    if (error != KShell::NoError || arguments.isEmpty())
+        return false;
+
+    worker->program = arguments.takeFirst();
+    worker->arguments = arguments;
+    worker->remote = true;
+    worker->running = 0;
+    return true;
+}
+
+/**
+ * Parses "item:property=start:stop:count" (for --sweep) or
+ * "item:property=tolerance[%]" (for --vary, taking the nominal value from
+ * the document).
+ */
+static bool parseVariation(ItemDocument *document, const QString &spec, bool random, Variation *variation)
+{
+    QString itemId, propertyId, value;
+    if (!parseAssignment(spec, &itemId, &propertyId, &value)) {
+        printError(i18n("Expected item:property=..., not \"%1\"", spec));
+        return false;
+    }
+
+    Property *property = findProperty(document, itemId, propertyId);
+    if (!property)
+        return false;
+    if (property->type() != Variant::Type::Double && property->type() != Variant::Type::Int) {
+        printError(i18n("Property \"%1\" of \"%2\" is not a number", propertyId, itemId));
+        return false;
+    }
+
+    variation->name = itemId + ':' + propertyId;
+    variation->random = random;
+    variation->integer = (property->type() == Variant::Type::Int);
+    variation->nominal = property->value().toDouble();
+
+    bool ok = true;
+    if (random) {
+        const bool percent = value.endsWith('%');
+        variation->tolerance = (percent ? value.left(value.size() - 1) : value).toDouble(&ok);
+        if (percent)
+            variation->tolerance /= 100.;
+        variation->count = 1;
+        ok = ok && variation->tolerance >= 0.;
+    } else {
+        const QStringList range = value.split(':');
+        ok = (range.size() == 3);
+        if (ok) {
+            bool startOk, stopOk, countOk;
+            variation->start = range[0].toDouble(&startOk);
+            variation->stop = range[1].toDouble(&stopOk);
+            variation->count = range[2].toInt(&countOk);
+            ok = startOk && stopOk && countOk && variation->count >= 1;
+        }
+    }
+
+    if (!ok)
+        printError(random ? i18n("Expected item:property=tolerance, not \"%1\"", spec) : i18n("Expected item:property=start:stop:count, not \"%1\"", spec));
+    return ok;
+}
+
+/**
+ * Fills in the probe summaries of the run from the CSV written by the
+ * ktechlab-batch process that did it.
+ */
+static bool readRunOutput(const QByteArray &output, int probeCount, Run *run)
+{
+    run->probes.assign(probeCount, ProbeSummary());
+
+    const QList<QByteArray> lines = output.split('\n');
+    int rows = 0;
+    // The first line is the header
+    for (int i = 1; i < lines.size(); ++i) {
+        const QList<QByteArray> fields = lines[i].trimmed().split(',');
+        if (fields.size() != probeCount + 1)
+            continue;
+
+        for (int p = 0; p < probeCount; ++p)
+            run->probes[p].add(fields[p + 1].toDouble());
+        rows++;
+    }
+    return rows > 0;
+}
+
+static int runSweep(ItemDocument *document, const QList<Probe *> &probes, const QByteArray &circuit, const QStringList &childArguments, const QStringList &sweeps, const QStringList &vary, int runsPerPoint, std::vector<Worker> &workers, unsigned seed, QTextStream &output)
+{
+    std::vector<Variation> variations;
+    for (QStringList::const_iterator it = sweeps.begin(); it != sweeps.end(); ++it) {
+        Variation variation;
+        if (!parseVariation(document, *it, false, &variation))
+            return 1;
+        variations.push_back(variation);
+    }
+    for (QStringList::const_iterator it = vary.begin(); it != vary.end(); ++it) {
+        Variation variation;
+        if (!parseVariation(document, *it, true, &variation))
+            return 1;
+        variations.push_back(variation);
+    }
+
+    // Every combination of the swept values, with runsPerPoint random
+    // picks of the varied values for each
+    std::mt19937 random(seed);
+    std::vector<Run> runs;
+
+    std::vector<int> point(variations.size(), 0);
+    bool done = false;
+    while (!done) {
+        for (int r = 0; r < runsPerPoint; ++r) {
+            Run run;
+            run.succeeded = false;
+            run.attempts = 0;
+            for (unsigned v = 0; v < variations.size(); ++v) {
+                const Variation &variation = variations[v];
+                double value;
+                if (variation.random) {
+                    std::uniform_real_distribution<double> distribution(-variation.tolerance, variation.tolerance);
+                    value = variation.nominal * (1. + distribution(random));
+                } else if (variation.count == 1) {
+                    value = variation.start;
+                } else {
+                    value = variation.start + (variation.stop - variation.start) * point[v] / (variation.count - 1);
+                }
+                if (variation.integer)
+                    value = qRound64(value);
+                run.values.push_back(value);
+                run.settings << "--set" << QString("%1=%2").arg(variation.name).arg(value, 0, 'g', 17);
+            }
+            runs.push_back(run);
+        }
+
+        // Next combination, like an odometer
+        done = true;
+        for (unsigned v = 0; v < variations.size(); ++v) {
+            if (++point[v] < variations[v].count) {
+                done = false;
+                break;
+            }
+            point[v] = 0;
+        }
+    }
+
+    int slots = 0;
+    for (const Worker &worker : workers)
+        slots += worker.slots;
+    printError(i18n("Simulating %1 runs, %2 at a time", int(runs.size()), slots));
+
+    // Keep each worker busy until all of the runs are done. The first of the
+    // child arguments is the circuit, which is "-" for the remote workers.
+    QStringList remoteArguments = childArguments;
+    remoteArguments[0] = QStringLiteral("-");
+
+    std::deque<Run *> pending;
+    for (Run &run : runs)
+        pending.push_back(&run);
+    int running = 0;
+    int failed = 0;
+    QEventLoop loop;
+
+    // Whether the run should be done again, as it was the worker that failed
+    // rather than the simulation
+    auto workerFailed = [](const Worker &worker, int exitCode, QProcess::ExitStatus status) {
+        return status != QProcess::NormalExit || (worker.remote && exitCode == REMOTE_CONNECTION_FAILED);
+    };
+
+    std::function<void()> startRuns = [&]() {
+        for (Worker &worker : workers) {
+            while (worker.running < worker.slots && !pending.empty()) {
+                Run *run = pending.front();
+                pending.pop_front();
+                run->attempts++;
+
+                QProcess *process = new QProcess;
+                Worker *w = &worker;
+                QObject::connect(process, qOverload<int, QProcess::ExitStatus>(&QProcess::finished), [&, process, run, w](int exitCode, QProcess::ExitStatus status) {
+                    w->running--;
+                    running--;
+
+                    run->succeeded = (status == QProcess::NormalExit && exitCode == 0 && readRunOutput(process->readAllStandardOutput(), probes.size(), run));
+                    if (!run->succeeded) {
+                        // Only pass on what the run had to say if it went wrong
+                        fputs(process->readAllStandardError().constData(), stderr);
+                        if (workerFailed(*w, exitCode, status) && run->attempts < MAX_RUN_ATTEMPTS)
+                            pending.push_back(run);
+                        else
+                            failed++;
+                    }
+                    process->deleteLater();
+                    startRuns();
+                    if (running == 0)
+                        loop.quit();
+                });
+
+                process->start(worker.program, worker.arguments + (worker.remote ? remoteArguments : childArguments) + run->settings);
+                if (!process->waitForStarted()) {
+                    printError(i18n("Could not start %1: %2", worker.program, process->errorString()));
+                    delete process;
+                    // Leave this worker out from now on
+                    worker.slots = 0;
+                    if (run->attempts < MAX_RUN_ATTEMPTS)
+                        pending.push_front(run);
+                    else
+                        failed++;
+                    break;
+                }
+                if (worker.remote) {
+                    process->write(circuit);
+                    process->closeWriteChannel();
+                }
+                worker.running++;
+                running++;
+            }
+        }
+
+        // With every worker gone, there is nowhere left to do the rest
+        if (running == 0 && !pending.empty()) {
+            failed += int(pending.size());
+            pending.clear();
+        }
+    };
+
+    startRuns();
+    if (running > 0)
+        loop.exec();
+
+    // One row per run
+    output << "run";
+    for (std::vector<Variation>::const_iterator it = variations.begin(); it != variations.end(); ++it)
+        output << ',' << it->name;
+    for (QList<Probe *>::const_iterator it = probes.begin(); it != probes.end(); ++it) {
+        const QString id = (*it)->id();
+        output << ',' << id << "_final," << id << "_min," << id << "_max," << id << "_mean";
+    }
+    output << '\n';
+
+    for (unsigned r = 0; r < runs.size(); ++r) {
+        const Run &run = runs[r];
+        if (!run.succeeded)
+            continue;
+
+        output << r;
+        for (std::vector<double>::const_iterator it = run.values.begin(); it != run.values.end(); ++it)
+            output << ',' << *it;
+        for (std::vector<ProbeSummary>::const_iterator it = run.probes.begin(); it != run.probes.end(); ++it)
+            output << ',' << it->last << ',' << it->min << ',' << it->max << ',' << it->mean();
+        output << '\n';
+    }
+
+    // And the spread of the final value of each probe over all the runs
+    output << '\n' << "probe,runs,mean,stddev,min,max\n";
+    for (int p = 0; p < probes.size(); ++p) {
+        ProbeSummary summary;
+        double sumSquares = 0.;
+        for (std::vector<Run>::const_iterator it = runs.begin(); it != runs.end(); ++it) {
+            if (it->succeeded) {
+                summary.add(it->probes[p].last);
+                sumSquares += it->probes[p].last * it->probes[p].last;
+            }
+        }
+        if (summary.count == 0)
+            continue;
+
+        const double mean = summary.mean();
+        const double stddev = std::sqrt(std::max(0., sumSquares / summary.count - mean * mean));
+        output << probes[p]->id() << ',' << summary.count << ',' << mean << ',' << stddev << ',' << summary.min << ',' << summary.max << '\n';
+    }
+    output.flush();
+
+    if (failed > 0) {
+        printError(i18n("%1 of %2 runs failed", failed, int(runs.size())));
+        return 1;
+    }
+    return 0;
+}
+// END Sweeps
+
+// BEGIN AC analysis
+/**
+ * @return the signal element of the component, or nullptr if it has none.
+ */
+static Element *signalElement(Component *component)
+{
+    const ElementMapList &elements = component->elementMapList();
+    for (ElementMapList::const_iterator it = elements.begin(); it != elements.end(); ++it) {
+        if (it->e && (it->e->type() == Element::Element_VoltageSignal || it->e->type() == Element::Element_CurrentSignal))
+            return it->e;
+    }
+    return nullptr;
+}
+
+/**
+ * Writes the frequency response of the probes to the source given by
+ * sourceId (or to the only signal source in the circuit, if it is empty),
+ * over the frequencies from a "start:stop:points" specification.
+ */
+static int runAc(ItemDocument *document, const QList<Probe *> &probes, const QString &spec, const QString &sourceId, int threadCount, QTextStream &output)
+{
+    const QStringList fields = spec.split(':');
+    bool startOk = false, stopOk = false, pointsOk = false;
+    const double start = fields.value(0).toDouble(&startOk);
+    const double stop = fields.value(1).toDouble(&stopOk);
+    const int points = fields.value(2).toInt(&pointsOk);
+    if (fields.size() != 3 || !startOk || !stopOk || !pointsOk || start <= 0. || stop <= 0. || points < 1) {
+        printError(i18n("Expected start:stop:points with frequencies above zero, not \"%1\"", spec));
+        return 1;
+    }
+
+    Element *source = nullptr;
+    if (!sourceId.isEmpty()) {
+        Component *component = dynamic_cast<Component *>(document->itemWithID(sourceId));
+        source = component ? signalElement(component) : nullptr;
+        if (!source) {
+            printError(i18n("There is no signal source \"%1\" in the circuit", sourceId));
+            return 1;
+        }
+    } else {
+        const ItemList items = document->itemList();
+        for (ItemList::const_iterator it = items.begin(); it != items.end(); ++it) {
+            Component *component = dynamic_cast<Component *>(it->data());
+            Element *element = component ? signalElement(component) : nullptr;
+            if (!element)
+                continue;
+            if (source) {
+                printError(i18n("The circuit has more than one signal source, so one must be given with --ac-source"));
+                return 1;
+            }
+            source = element;
+        }
+        if (!source) {
+            printError(i18n("The circuit has no signal source to analyse the response to"));
+            return 1;
+        }
+    }
+
+    ElementSet *elementSet = source->elementSet();
+    if (!elementSet || !elementSet->matrix()) {
+        printError(i18n("The signal source is not connected to anything"));
+        return 1;
+    }
+    if (elementSet->circuit()->usesNgspice()) {
+        printError(i18n("AC analysis is not available for circuits solved by ngspice"));
+        return 1;
+    }
+
+    AcAnalysis analysis(elementSet);
+    if (!analysis.setSource(source)) {
+        printError(i18n("The signal source is not connected to anything"));
+        return 1;
+    }
+
+    const std::vector<AcSolution> solutions = analysis.solve(AcAnalysis::logSpacing(start, stop, points), threadCount);
+
+    output << "frequency";
+    for (QList<Probe *>::const_iterator it = probes.begin(); it != probes.end(); ++it)
+        output << ',' << (*it)->id() << " dB," << (*it)->id() << " phase";
+    output << '\n';
+
+    int singular = 0;
+    for (std::vector<AcSolution>::const_iterator solution = solutions.begin(); solution != solutions.end(); ++solution) {
+        if (!solution->solved)
+            singular++;
+        output << solution->frequency;
+        for (QList<Probe *>::const_iterator it = probes.begin(); it != probes.end(); ++it) {
+            const std::complex<double> value = (*it)->acValue(*solution);
+            output << ',' << 20. * std::log10(std::abs(value)) << ',' << std::arg(value) * 180. / M_PI;
+        }
+        output << '\n';
+    }
+    output.flush();
+
+    if (singular > 0) {
+        printError(i18n("The circuit could not be solved at %1 of the frequencies", singular));
+        return 1;
+    }
+    return 0;
+}
+// END AC analysis
+
+// BEGIN DC sweep
+/**
+ * Writes the probe values at the DC operating point of the circuit for each
+ * value of the property in a "item:property=start:stop:count" specification.
+ */
+static int runDcSweep(CircuitDocument *document, const QList<Probe *> &probes, const QString &spec, QTextStream &output)
+{
+    Variation variation;
+    if (!parseVariation(document, spec, false, &variation))
+        return 1;
+
+    const QString itemId = variation.name.section(':', 0, 0);
+    Item *item = document->itemWithID(itemId);
+    Property *property = item->property(variation.name.section(':', 1));
+
+    output << variation.name;
+    for (QList<Probe *>::const_iterator it = probes.begin(); it != probes.end(); ++it)
+        output << ',' << (*it)->id();
+    output << '\n';
+
+    QElapsedTimer timer;
+    timer.start();
+
+    int failed = 0;
+    for (int i = 0; i < variation.count; ++i) {
+        double value = (variation.count > 1) ? variation.start + (variation.stop - variation.start) * i / (variation.count - 1) : variation.start;
+        if (variation.integer) {
+            value = qRound(value);
+            property->setValue(int(value));
+        } else
+            property->setValue(value);
+
+        // Passed on to the elements straight away, rather than from the
+        // event loop, so that the circuits are not rebuilt
+        item->applyPropertyChanges();
+        if (!document->solveDc())
+            failed++;
+
+        output << value;
+        for (QList<Probe *>::const_iterator it = probes.begin(); it != probes.end(); ++it)
+            output << ',' << (*it)->value();
+        output << '\n';
+    }
+    output.flush();
+
+    printError(i18n("Swept %1 points in %2 s", variation.count, timer.elapsed() * 1e-3));
+    if (failed > 0) {
+        printError(i18n("The operating point did not converge at %1 of the points", failed));
+        return 1;
+    }
+    return 0;
+}
+// END DC sweep
+
+int main(int argc, char **argv)
+{
+    Headless::useOffscreenPlatform();
+
+    QApplication app(argc, argv);
+    KLocalizedString::setApplicationDomain("ktechlab");
+
+    // Same component name as the GUI, so that the same data files are found
+    KAboutData about("ktechlab", i18n("KTechLab Batch Simulator"), KTECHLAB_VERSION_STRING, i18n("Simulates a circuit without a GUI, printing the values of its probes"), KAboutLicense::GPL_V2, i18n("(C) 2003-2026, The KTechLab developers"), "", "https://userbase.kde.org/KTechlab", "ktechlab-devel@kde.org");
+    KAboutData::setApplicationData(about);
+
+    QCommandLineParser parser;
+    about.setupCommandLine(&parser);
+    parser.addPositionalArgument(QStringLiteral("circuit"), i18n("The circuit to simulate, or - to read it from standard input."));
+
+    QCommandLineOption timeOption(QStringList() << "t" << "time", i18n("Simulated time to run for, in seconds (default 1)."), i18n("seconds"), "1");
+    QCommandLineOption intervalOption(QStringList() << "i" << "interval", i18n("Simulated time between probe samples, in seconds (default 0.001). With 0, only the initial and final values are written."), i18n("seconds"), "0.001");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", i18n("File to write the probe values to, instead of standard output."), i18n("file"));
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads", i18n("Number of threads for solving separate circuits (0 for one per core)."), i18n("count"));
+    QCommandLineOption statsOption(QStringList() << "s" << "statistics", i18n("File to write the simulation statistics to, as CSV."), i18n("file"));
+    QCommandLineOption setOption("set", i18n("Sets a property of an item before simulating, e.g. R1:resistance=4700. May be given more than once."), i18n("item:property=value"));
+    QCommandLineOption sweepOption("sweep", i18n("Simulates once for each of count values of the property, evenly spaced from start to stop. With more than one, every combination is simulated."), i18n("item:property=start:stop:count"));
+    QCommandLineOption varyOption("vary", i18n("Gives the property a random value within the tolerance (relative, or a percentage) of its value in the circuit, for each run."), i18n("item:property=tolerance"));
+    QCommandLineOption runsOption("runs", i18n("Number of runs (with different random values from --vary) for each swept value (default 1)."), i18n("count"), "1");
+    QCommandLineOption jobsOption("jobs", i18n("Number of runs to simulate at the same time (default one per core)."), i18n("count"));
+    QCommandLineOption seedOption("seed", i18n("Seed for the random values from --vary (default 1)."), i18n("number"), "1");
+    QCommandLineOption workerOption("worker", i18n("Also does runs with the command, which starts ktechlab-batch on another machine (e.g. \"8:ssh build1 ktechlab-batch\"), that many at a time (default 1). The circuit is sent to it. May be given more than once; then runs are only done on this machine if --jobs is given."), i18n("[slots:]command"));
+    parser.addOption(timeOption);
+    parser.addOption(intervalOption);
+    parser.addOption(outputOption);
+    parser.addOption(threadsOption);
+    parser.addOption(statsOption);
+    parser.addOption(setOption);
+    parser.addOption(sweepOption);
+    parser.addOption(varyOption);
+    parser.addOption(runsOption);
+    parser.addOption(jobsOption);
+    parser.addOption(seedOption);
+    QCommandLineOption acOption("ac", i18n("Writes the small-signal frequency response of the probes, at points frequencies (in hertz) spaced logarithmically from start to stop, instead of their values over time. The circuit is first simulated for --time to reach its operating point, so give the signal source no amplitude with --set."), i18n("start:stop:points"));
+    QCommandLineOption acSourceOption("ac-source", i18n("The signal source to find the response to with --ac (default the only one in the circuit)."), i18n("item"));
+    parser.addOption(workerOption);
+    QCommandLineOption dcOption("dc", i18n("Writes the values of the probes at the DC operating point for each of count values of the property, evenly spaced from start to stop, instead of their values over time."), i18n("item:property=start:stop:count"));
+    parser.addOption(acOption);
+    parser.addOption(acSourceOption);
+    parser.addOption(dcOption);
+
+    parser.process(app);
+    about.processCommandLine(&parser);
+
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    bool ok = false;
+    const double time = parser.value(timeOption).toDouble(&ok);
+    if (!ok || time < 0.) {
+        printError(i18n("Invalid time: %1", parser.value(timeOption)));
+        return 1;
+    }
+    const double interval = parser.value(intervalOption).toDouble(&ok);
+    if (!ok || interval < 0.) {
+        printError(i18n("Invalid interval: %1", parser.value(intervalOption)));
+        return 1;
+    }
+    const int runsPerPoint = parser.value(runsOption).toInt(&ok);
+    if (!ok || runsPerPoint < 1) {
+        printError(i18n("Invalid number of runs: %1", parser.value(runsOption)));
+        return 1;
+    }
+    const bool sweeping = parser.isSet(sweepOption) || parser.isSet(varyOption) || runsPerPoint > 1;
+    if (sweeping && (parser.isSet(acOption) || parser.isSet(dcOption))) {
+        printError(i18n("--ac and --dc cannot be combined with --sweep, --vary or --runs"));
+        return 1;
+    }
+    if (parser.isSet(acOption) && parser.isSet(dcOption)) {
+        printError(i18n("--ac and --dc cannot be combined"));
+        return 1;
+    }
+
+    std::vector<Worker> workers;
+    const QStringList workerSpecs = parser.values(workerOption);
+    for (QStringList::const_iterator it = workerSpecs.begin(); it != workerSpecs.end(); ++it) {
+        Worker worker;
+        if (!parseWorker(*it, &worker)) {
+            printError(i18n("Expected [slots:]command, not \"%1\"", *it));
+            return 1;
+        }
+        workers.push_back(worker);
+    }
+
+    HeadlessSession session;
+    Simulator *simulator = session.simulator();
+    if (parser.isSet(threadsOption))
+        simulator->setSolverThreadCount(parser.value(threadsOption).toInt());
+
+    // A circuit sent from another machine is read into a file of its own, as
+    // documents are opened from files
+    const QString circuitArgument = parser.positionalArguments().at(0);
+    QTemporaryFile circuitFile(QDir::tempPath() + QLatin1String("/ktechlab-batch-XXXXXX.circuit"));
+    QString circuitPath = circuitArgument;
+    if (circuitArgument == QLatin1String("-")) {
+        QFile input;
+        if (!input.open(stdin, QIODevice::ReadOnly) || !circuitFile.open() || circuitFile.write(input.readAll()) < 0 || !circuitFile.flush()) {
+            printError(i18n("Could not read the circuit from standard input"));
+            return 1;
+        }
+        circuitPath = circuitFile.fileName();
+    }
+
+    const QUrl url = QUrl::fromUserInput(circuitPath, QDir::currentPath(), QUrl::AssumeLocalFile);
+    CircuitDocument *document = new CircuitDocument(url.fileName());
+    // Only simulated, so the canvas and connector routes are not kept up
+    document->setHeadless(true);
+    if (!document->openURL(url)) {
+        printError(i18n("Could not load %1", url.toDisplayString()));
+        delete document;
+        return 1;
+    }
+
+    const QStringList settings = parser.values(setOption);
+    for (QStringList::const_iterator it = settings.begin(); it != settings.end(); ++it) {
+        if (!applySetting(document, *it)) {
+            delete document;
+            return 1;
+        }
+    }
+
+    // Let the document build its circuits (which it does from a timer)
+    processPendingEvents();
+
+    QList<Probe *> probes;
+    const ItemList items = document->itemList();
+    for (ItemList::const_iterator it = items.begin(); it != items.end(); ++it) {
+        if (Probe *probe = dynamic_cast<Probe *>(it->data()))
+            probes << probe;
+    }
+    std::sort(probes.begin(), probes.end(), lessId);
+
+    QFile outputFile;
+    if (parser.isSet(outputOption)) {
+        outputFile.setFileName(parser.value(outputOption));
+        if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            printError(i18n("Could not open '%1' for writing", outputFile.fileName()));
+            delete document;
+            return 1;
+        }
+    } else {
+        outputFile.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+    }
+    QTextStream output(&outputFile);
+
+    if (sweeping) {
+        // Each run is a ktechlab-batch of its own, with one solver thread
+        // as the runs already use all the cores
+        QStringList childArguments;
+        childArguments << QFileInfo(url.toLocalFile()).absoluteFilePath() << "--time" << parser.value(timeOption) << "--interval" << parser.value(intervalOption) << "--threads" << "1";
+        for (QStringList::const_iterator it = settings.begin(); it != settings.end(); ++it)
+            childArguments << "--set" << *it;
+
+        if (workers.empty() || parser.isSet(jobsOption)) {
+            Worker local;
+            local.program = QCoreApplication::applicationFilePath();
+            local.remote = false;
+            local.slots = parser.isSet(jobsOption) ? std::max(1, parser.value(jobsOption).toInt()) : QThread::idealThreadCount();
+            local.running = 0;
+            workers.push_back(local);
+        }
+
+        QByteArray circuit;
+        if (workers.size() > 1 || workers.front().remote) {
+            QFile file(url.toLocalFile());
+            if (!file.open(QIODevice::ReadOnly)) {
+                printError(i18n("Could not read %1 to send it to the workers", url.toDisplayString()));
+                delete document;
+                return 1;
+            }
+            circuit = file.readAll();
+        }
+
+        const unsigned seed = parser.value(seedOption).toUInt();
+
+        const int result = runSweep(document, probes, circuit, childArguments, parser.values(sweepOption), parser.values(varyOption), runsPerPoint, workers, seed, output);
+        delete document;
+        return result;
+    }
+
+    const long long totalSteps = qRound64(time * LINEAR_UPDATE_RATE);
+
+    if (parser.isSet(dcOption)) {
+        const int result = runDcSweep(document, probes, parser.value(dcOption), output);
+        delete document;
+        return result;
+    }
+
+    if (parser.isSet(acOption)) {
+        simulator->runSteps(totalSteps);
+
+        int threadCount = QThread::idealThreadCount() - 1;
+        if (parser.isSet(threadsOption) && parser.value(threadsOption).toInt() > 0)
+            threadCount = parser.value(threadsOption).toInt() - 1;
+
+        const int result = runAc(document, probes, parser.value(acOption), parser.value(acSourceOption), threadCount, output);
+        delete document;
+        return result;
+    }
+
+    output << "time";
+    for (QList<Probe *>::const_iterator it = probes.begin(); it != probes.end(); ++it)
+        output << ',' << (*it)->id();
+    output << '\n';
+
+    const long long sampleSteps = (interval > 0.) ? std::max<long long>(1, qRound64(interval * LINEAR_UPDATE_RATE)) : totalSteps;
+
+    simulator->setTimingEnabled(parser.isSet(statsOption));
+    simulator->resetStatistics();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    writeRow(output, 0., probes);
+    long long done = 0;
+    while (done < totalSteps) {
+        const long long steps = std::min(sampleSteps, totalSteps - done);
+        simulator->runSteps(steps);
+        done += steps;
+
+        // Components may ask for the circuits to be rebuilt (e.g. when a
+        // switch changes), which is done from the event loop
+        app.processEvents();
+
+        writeRow(output, double(done) / LINEAR_UPDATE_RATE, probes);
+    }
+    output.flush();
+
+    const qint64 elapsedMs = timer.elapsed();
+    printError(i18n("Simulated %1 s in %2 s (%3 linear steps per second)", time, elapsedMs * 1e-3, elapsedMs > 0 ? qRound64(totalSteps * 1e3 / elapsedMs) : 0));
+
+    if (parser.isSet(statsOption)) {
+        QFile statsFile(parser.value(statsOption));
+        if (!statsFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            printError(i18n("Could not open '%1' for writing", statsFile.fileName()));
+            delete document;
+            return 1;
+        }
+        QTextStream stream(&statsFile);
+        stream << simulator->statistics().toCsv();
+    }
+
+    delete document;
+    return 0;
+}
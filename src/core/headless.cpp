@@ -0,0 +1,60 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "headless.h"
+#include "ktechlab.h"
+#include "simulator.h"
+
+#include <QCoreApplication>
+#include <QString>
+
+#include <algorithm>
+#include <cstdio>
+
+void Headless::useOffscreenPlatform()
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+}
+
+void Headless::printError(const QString &message)
+{
+    fprintf(stderr, "%s\n", qPrintable(message));
+}
+
+void Headless::processPendingEvents()
+{
+    for (int i = 0; i < 4; ++i)
+        QCoreApplication::processEvents();
+}
+
+void Headless::runSteps(Simulator *simulator, long long steps)
+{
+    const long long chunk = LINEAR_UPDATE_RATE / 100;
+    for (long long done = 0; done < steps; done += chunk) {
+        simulator->runSteps(std::min(chunk, steps - done));
+        QCoreApplication::processEvents();
+    }
+}
+
+// BEGIN class HeadlessSession
+HeadlessSession::HeadlessSession()
+    : m_pKTechlab(new KTechlab())
+    , m_pSimulator(Simulator::self())
+{
+    m_pSimulator->setRunInThread(false);
+    m_pSimulator->slotSetSimulating(false);
+}
+
+HeadlessSession::~HeadlessSession()
+{
+    delete m_pKTechlab;
+}
+// END class HeadlessSession
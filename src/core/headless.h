@@ -0,0 +1,74 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <QtGlobal>
+
+class KTechlab;
+class QString;
+class Simulator;
+
+/**
+Helpers for the programs that simulate circuits without showing any windows:
+ktechlab-batch, and the simulation benchmark and regression tests.
+*/
+namespace Headless
+{
+/**
+ * Has Qt use the offscreen platform unless QT_QPA_PLATFORM says otherwise,
+ * as nothing is ever shown. Must be called before the QApplication is made.
+ */
+void useOffscreenPlatform();
+/**
+ * Writes the message on a line of its own to standard error.
+ */
+void printError(const QString &message);
+/**
+ * Runs the event loop until nothing is left to do straight away. Documents
+ * build their circuits, and changes to properties are passed on, from
+ * zero-length timers, which can start further timers.
+ */
+void processPendingEvents();
+/**
+ * Simulates steps linear steps, letting the event loop run in between (as
+ * components may ask for the circuits to be rebuilt from it).
+ */
+void runSteps(Simulator *simulator, long long steps);
+}
+
+/**
+The main window, which the components and documents expect to be around
+although it is never shown, and the simulator set up to be stepped with
+Simulator::runSteps rather than by itself. Documents must be deleted before
+the session is.
+@short A simulation without a GUI
+*/
+class HeadlessSession
+{
+public:
+    HeadlessSession();
+    ~HeadlessSession();
+
+    Simulator *simulator() const
+    {
+        return m_pSimulator;
+    }
+
+protected:
+    KTechlab *m_pKTechlab;
+    Simulator *m_pSimulator;
+
+private:
+    Q_DISABLE_COPY(HeadlessSession)
+};
+
+#endif
@@ -10,6 +10,7 @@
 
 #include "diagnosticstyle.h"
 #include "ktechlab.h"
+#include "startuptrace.h"
 
 //#include <dcopclient.h>
 #include <ktechlab_version.h>
@@ -19,15 +20,19 @@
 
 #include <QApplication>
 #include <QCommandLineParser>
+#include <QDBusConnection>
 #include <QDir>
 #include <QStandardPaths>
 
 int main(int argc, char **argv)
 {
+    StartupTrace::start();
+
     // enable high dpi support
     QCoreApplication::setAttribute(Qt::AA_UseHighDpiPixmaps, true);
     QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling, true);
 
+    StartupTrace::Phase applicationPhase("Application");
     QApplication app(argc, argv);
     KLocalizedString::setApplicationDomain("ktechlab");
 
@@ -54,10 +59,15 @@ int main(int argc, char **argv)
     //              application's window? currently this is not implemented
     //              but it had references in the .desktop file
     parser.addPositionalArgument(QStringLiteral("url"), i18n("Document to open."), QStringLiteral("[url]"));
+    const QCommandLineOption startupTraceOption(QStringLiteral("startup-trace"), i18n("Write the times taken by the phases of startup to <file>, in the Chrome trace event format."), QStringLiteral("file"));
+    parser.addOption(startupTraceOption);
 
     parser.process(app);
     about.processCommandLine(&parser);
 
+    if (parser.isSet(startupTraceOption))
+        StartupTrace::setOutputFile(parser.value(startupTraceOption));
+
     // Add our custom icons to the search path
     const QStringList iconDirs = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, "ktechlab/icons", QStandardPaths::LocateDirectory);
     const QStringList picsDirs = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, "ktechlab/pics", QStandardPaths::LocateDirectory);
@@ -68,18 +78,33 @@ int main(int argc, char **argv)
         // app.setStyle(new DiagnosticStyle());
     }
 
-    // register ourselves as a dcop client
-    // app.dcopClient()->registerAs(app.name(), false);
+    // register ourselves on the session bus, so that the documents exported
+    // in Document::setDCOPID can be reached; one name per running instance
+    QDBusConnection::sessionBus().registerService(QString("org.kde.ktechlab-%1").arg(QCoreApplication::applicationPid()));
+
+    applicationPhase.end();
 
-    KTechlab *ktechlab = new KTechlab();
+    KTechlab *ktechlab;
+    {
+        StartupTrace::Phase phase("Main window");
+        ktechlab = new KTechlab();
+    }
+
+    // The window is shown before the document is opened, and the libraries
+    // not needed to show it are loaded once the event loop is running (see
+    // KTechlab::slotLoadDeferred)
+    {
+        StartupTrace::Phase phase("Show");
+        ktechlab->show();
+    }
 
     // 2019.10.03 - note: possibly add support for multiple URLs to be opened from
     //              command line?
     if (parser.positionalArguments().count() > 0) {
+        StartupTrace::Phase phase("Open document");
         const QUrl url = QUrl::fromUserInput(parser.positionalArguments().at(0), QDir::currentPath(), QUrl::AssumeLocalFile);
         ktechlab->load(url);
     }
 
-    ktechlab->show();
     return app.exec();
 }
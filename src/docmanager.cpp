@@ -8,10 +8,12 @@
  *   (at your option) any later version.                                   *
  ***************************************************************************/
 
+#include "autosave.h"
 #include "docmanager.h"
 #include "docmanageriface.h"
 #include "electronics/circuitdocument.h"
 #include "flowcodedocument.h"
+#include "itemdocumentdata.h"
 #include "iteminterface.h"
 #include "itemselector.h"
 #include "ktechlab.h"
@@ -25,10 +27,14 @@
 #include <KXMLGUIFactory>
 
 #include <QAction>
+#include <QAtomicInt>
 #include <QFile>
+#include <QProgressDialog>
 #include <QTabWidget>
+#include <QThread>
 
 #include <cassert>
+#include <vector>
 
 #include <ktlconfig.h>
 
@@ -57,6 +63,7 @@ DocManager::DocManager()
 
 DocManager::~DocManager()
 {
+    clearPreloadedData();
     delete m_pIface;
 }
 
@@ -135,6 +142,122 @@ Document *DocManager::openURL(const QUrl &url, ViewArea *viewArea)
         return openTextFile(url, viewArea);
 }
 
+// BEGIN class DocumentLoadThread
+/**
+ * Reads the files it is given, a file at a time, until there are none left
+ * or the loading is cancelled.
+ */
+class DocumentLoadThread : public QThread
+{
+public:
+    DocumentLoadThread(const QStringList *fileNames, std::vector<ItemDocumentData *> *data, QAtomicInt *nextFile, QAtomicInt *loadedCount, const QAtomicInt *cancelled)
+        : m_pFileNames(fileNames)
+        , m_pData(data)
+        , m_pNextFile(nextFile)
+        , m_pLoadedCount(loadedCount)
+        , m_pCancelled(cancelled)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        while (!m_pCancelled->loadAcquire()) {
+            const int i = m_pNextFile->fetchAndAddRelaxed(1);
+            if (i >= m_pFileNames->size())
+                return;
+
+            QFile file(m_pFileNames->at(i));
+            if (file.open(QIODevice::ReadOnly)) {
+                ItemDocumentData *data = new ItemDocumentData(Document::dt_none);
+                QString errorMessage;
+
+                // Files that cannot be read are left to openURL, which says
+                // what went wrong
+                if (data->loadData(&file, &errorMessage))
+                    (*m_pData)[i] = data;
+                else
+                    delete data;
+            }
+
+            m_pLoadedCount->ref();
+        }
+    }
+
+    const QStringList *m_pFileNames;
+    std::vector<ItemDocumentData *> *m_pData;
+    QAtomicInt *m_pNextFile;
+    QAtomicInt *m_pLoadedCount;
+    const QAtomicInt *m_pCancelled;
+};
+// END class DocumentLoadThread
+
+bool DocManager::preloadURLs(const QList<QUrl> &urls)
+{
+    QList<QUrl> toLoad;
+    QStringList fileNames;
+    for (QList<QUrl>::const_iterator it = urls.constBegin(); it != urls.constEnd(); ++it) {
+        if (!it->isLocalFile() || findDocument(*it) || m_preloadedData.contains(*it))
+            continue;
+
+        const QString fileName = it->fileName();
+        if (fileName.endsWith(".circuit") || fileName.endsWith(".flowcode")) {
+            toLoad << *it;
+            fileNames << it->toLocalFile();
+        }
+    }
+    if (toLoad.isEmpty())
+        return true;
+
+    std::vector<ItemDocumentData *> data(toLoad.size(), nullptr);
+    QAtomicInt nextFile(0);
+    QAtomicInt loadedCount(0);
+    QAtomicInt cancelled(0);
+
+    std::vector<DocumentLoadThread *> threads(qBound(1, QThread::idealThreadCount(), toLoad.size()));
+    for (std::vector<DocumentLoadThread *>::iterator it = threads.begin(); it != threads.end(); ++it) {
+        *it = new DocumentLoadThread(&fileNames, &data, &nextFile, &loadedCount, &cancelled);
+        (*it)->start();
+    }
+
+    QProgressDialog progress(i18n("Reading documents..."), i18n("Cancel"), 0, toLoad.size(), KTechlab::self());
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(500);
+
+    // Being modal, the progress dialog keeps the events going as it is
+    // updated
+    for (std::vector<DocumentLoadThread *>::iterator it = threads.begin(); it != threads.end(); ++it) {
+        while (!(*it)->wait(20)) {
+            progress.setValue(loadedCount.loadAcquire());
+            if (progress.wasCanceled())
+                cancelled.storeRelease(1);
+        }
+        delete *it;
+    }
+    progress.setValue(toLoad.size());
+
+    const bool wasCancelled = cancelled.loadAcquire();
+    for (int i = 0; i < toLoad.size(); ++i) {
+        if (wasCancelled)
+            delete data[i];
+        else if (data[i])
+            m_preloadedData.insert(toLoad[i], data[i]);
+    }
+
+    return !wasCancelled;
+}
+
+void DocManager::clearPreloadedData()
+{
+    qDeleteAll(m_preloadedData);
+    m_preloadedData.clear();
+}
+
+ItemDocumentData *DocManager::takePreloadedData(const QUrl &url)
+{
+    return m_preloadedData.take(url);
+}
+
 Document *DocManager::getFocusedDocument() const
 {
     Document *doc = p_focusedView ? p_focusedView->document() : nullptr;
@@ -399,11 +522,46 @@ MechanicsDocument *DocManager::createMechanicsDocument()
     return document;
 }
 
+void DocManager::recoverAutoSaves()
+{
+    const QStringList files = AutoSave::untitledRecoveryFiles();
+    if (files.isEmpty())
+        return;
+
+    const int answer = KMessageBox::questionYesNo(KTechlab::self(),
+                                                  i18np("KTechlab closed unexpectedly while a new document had not been saved yet. Recover it?",
+                                                        "KTechlab closed unexpectedly while %1 new documents had not been saved yet. Recover them?",
+                                                        files.size()),
+                                                  i18n("Recover Documents"),
+                                                  KGuiItem(i18n("Recover")),
+                                                  KStandardGuiItem::discard());
+
+    for (const QString &file : files) {
+        if (answer == KMessageBox::Yes) {
+            ItemDocument *document = nullptr;
+            if (file.endsWith(".circuit"))
+                document = createCircuitDocument();
+            else if (file.endsWith(".flowcode"))
+                document = createFlowCodeDocument();
+            else if (file.endsWith(".mechanics"))
+                document = createMechanicsDocument();
+
+            // The copy is removed once it has been recovered
+            if (document && document->recoverFrom(file))
+                continue;
+        }
+        AutoSave::removeRecoveryFile(file);
+    }
+}
+
 CircuitDocument *DocManager::openCircuitFile(const QUrl &url, ViewArea *viewArea)
 {
     CircuitDocument *document = new CircuitDocument(url.fileName());
 
-    if (!document->openURL(url)) {
+    if (ItemDocumentData *data = takePreloadedData(url)) {
+        document->openData(data, url);
+        delete data;
+    } else if (!document->openURL(url)) {
         KMessageBox::error(nullptr, i18n("Could not open Circuit file \"%1\"", url.toDisplayString(QUrl::PreferLocalFile)));
         document->deleteLater();
         return nullptr;
@@ -418,7 +576,10 @@ FlowCodeDocument *DocManager::openFlowCodeFile(const QUrl &url, ViewArea *viewAr
 {
     FlowCodeDocument *document = new FlowCodeDocument(url.fileName());
 
-    if (!document->openURL(url)) {
+    if (ItemDocumentData *data = takePreloadedData(url)) {
+        document->openData(data, url);
+        delete data;
+    } else if (!document->openURL(url)) {
         KMessageBox::error(nullptr, i18n("Could not open FlowCode file \"%1\"", url.toDisplayString(QUrl::PreferLocalFile)));
         document->deleteLater();
         return nullptr;
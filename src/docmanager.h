@@ -13,6 +13,7 @@
 
 #include "view.h"
 
+#include <QHash>
 #include <QPointer>
 #include <QUrl>
 
@@ -21,6 +22,7 @@ class DocManager;
 class DocManagerIface;
 class Document;
 class FlowCodeDocument;
+class ItemDocumentData;
 class KTechlab;
 class MechanicsDocument;
 class TextDocument;
@@ -56,6 +58,16 @@ public:
      * @param viewArea if non-null, will open the new view into the ViewArea
      */
     Document *openURL(const QUrl &url, ViewArea *viewArea = nullptr);
+    /**
+     * Reads the circuit and FlowCode files among urls on worker threads,
+     * showing the progress (with the chance to cancel), so that opening them
+     * afterwards with openURL only has to build the documents on this
+     * thread. What was read is kept until it is used or until
+     * clearPreloadedData is called.
+     * @return false if the user cancelled
+     */
+    bool preloadURLs(const QList<QUrl> &urls);
+    void clearPreloadedData();
     /**
      * Returns the focused View
      */
@@ -79,6 +91,13 @@ public:
      * @see associateDocument
      */
     Document *findDocument(const QUrl &url) const;
+    /**
+     * @return the open documents
+     */
+    DocumentList documentList() const
+    {
+        return m_documentList;
+    }
     /**
      * Associates a url with a pointer to a document. When findFile is called
      * with the given url, it will return a pointer to this document if it still
@@ -114,6 +133,11 @@ public slots:
      * mechanics selector.
      */
     MechanicsDocument *createMechanicsDocument();
+    /**
+     * Offers to recover the documents that had not been saved yet when
+     * KTechlab last closed unexpectedly (see AutoSave).
+     */
+    void recoverAutoSaves();
 
 signals:
     /**
@@ -143,6 +167,11 @@ protected:
      * ViewContainer
      */
     View *createNewView(Document *document, ViewArea *viewArea = nullptr);
+    /**
+     * @return the data read by preloadURLs for url (which the caller then
+     * owns), or null if there is none.
+     */
+    ItemDocumentData *takePreloadedData(const QUrl &url);
     CircuitDocument *openCircuitFile(const QUrl &url, ViewArea *viewArea = nullptr);
     FlowCodeDocument *openFlowCodeFile(const QUrl &url, ViewArea *viewArea = nullptr);
     MechanicsDocument *openMechanicsFile(const QUrl &url, ViewArea *viewArea = nullptr);
@@ -150,6 +179,7 @@ protected:
 
     DocumentList m_documentList;
     URLDocumentMap m_associatedDocuments;
+    QHash<QUrl, ItemDocumentData *> m_preloadedData;
 
     // Keeps track of how many
     // new files have been made
@@ -19,6 +19,7 @@
 #include <KLocalizedString>
 #include <KMessageBox>
 
+#include <QDBusConnection>
 #include <QFileDialog>
 #include <QTabWidget>
 #include <QDebug>
@@ -183,12 +184,19 @@ void Document::setDCOPID(unsigned id)
     if (m_dcopID == id)
         return;
 
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    bus.unregisterObject(QString("/Documents/%1").arg(m_dcopID));
+
     m_dcopID = id;
     if (m_pDocumentIface) {
         QString docID;
         docID.setNum(dcopID());
         m_pDocumentIface->setObjId("Document#" + docID);
     }
+
+    // Only the adaptors are exported (e.g. CircuitDocumentAdaptor), so
+    // documents without one are registered with no interfaces
+    bus.registerObject("/Documents/" + QString::number(id), this, QDBusConnection::ExportAdaptors);
 }
 
 #include "moc_document.cpp"
@@ -12,13 +12,27 @@
 #include "circuitdocument.h"
 #include "cnitem.h"
 #include "connector.h"
+#include "ecnode.h"
 #include "flowcodedocument.h"
 #include "itemlibrary.h"
 #include "libraryitem.h"
 #include "mechanicsdocument.h"
+#include "oscilloscopedata.h"
+#include "probe.h"
+#include "probedatawriter.h"
+#include "simulator.h"
+#include "telemetrystream.h"
 #include "textdocument.h"
+#include "variant.h"
 #include "view.h"
 
+#include <QBuffer>
+#include <QSharedMemory>
+#include <QUuid>
+
+#include <algorithm>
+#include <cstring>
+
 // BEGIN class DocumentIface
 DocumentIface::DocumentIface(Document *document)
     : DCOPObject(/* TODO "Document" */)
@@ -162,10 +176,114 @@ void FlowCodeDocumentIface::convertToAssembly()
 // BEGIN class CircuitDocumentIface
 CircuitDocumentIface::CircuitDocumentIface(CircuitDocument *document)
     : ICNDocumentIface(document)
+    , m_pProbeMemory(nullptr)
 {
     m_pCircuitDocument = document;
 }
 
+CircuitDocumentIface::~CircuitDocumentIface()
+{
+    delete m_pProbeMemory;
+}
+
+bool CircuitDocumentIface::setComponentProperty(const QString &itemId, const QString &propertyId, const QString &value)
+{
+    Item *item = m_pCircuitDocument->itemWithID(itemId);
+    if (!item || !item->hasProperty(propertyId))
+        return false;
+
+    Variant *property = item->property(propertyId);
+    QVariant newValue(value);
+    if (!newValue.convert(property->value().userType()))
+        return false;
+
+    property->setValue(newValue);
+    // Rather than waiting for the item to act on the change from its timer,
+    // as the simulation may be run straight after
+    item->applyPropertyChanges();
+    return true;
+}
+
+double CircuitDocumentIface::runSimulation(double seconds)
+{
+    Simulator *simulator = Simulator::self();
+    const bool wasSimulating = simulator->isSimulating();
+    simulator->slotSetSimulating(false);
+
+    m_pCircuitDocument->assignPendingCircuits();
+    simulator->runSteps(qRound64(seconds * LINEAR_UPDATE_RATE));
+
+    if (wasSimulating)
+        simulator->slotSetSimulating(true);
+
+    return double(simulator->time()) / LOGIC_UPDATE_RATE;
+}
+
+QString CircuitDocumentIface::probeDataKey()
+{
+    QList<ProbeData *> probes;
+    uint64_t begin = Simulator::self()->time();
+    const ItemList items = m_pCircuitDocument->itemList();
+    for (Item *item : items) {
+        Probe *probe = dynamic_cast<Probe *>(item);
+        if (!probe || !probe->probeData())
+            continue;
+        ProbeData *data = probe->probeData();
+        data->collectData();
+        probes << data;
+        begin = std::min(begin, data->resetTime());
+    }
+
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    BinaryProbeDataWriter writer(&buffer);
+    writer.write(probes, begin, Simulator::self()->time());
+    const QByteArray data = buffer.data();
+
+    delete m_pProbeMemory;
+    m_pProbeMemory = new QSharedMemory(QStringLiteral("ktechlab-probes-") + QUuid::createUuid().toString(QUuid::WithoutBraces));
+    if (!m_pProbeMemory->create(int(sizeof(quint32)) + data.size())) {
+        delete m_pProbeMemory;
+        m_pProbeMemory = nullptr;
+        return QString();
+    }
+
+    m_pProbeMemory->lock();
+    const quint32 size = data.size();
+    uchar *memory = static_cast<uchar *>(m_pProbeMemory->data());
+    std::memcpy(memory, &size, sizeof(size));
+    std::memcpy(memory + sizeof(size), data.constData(), data.size());
+    m_pProbeMemory->unlock();
+
+    return m_pProbeMemory->key();
+}
+
+bool CircuitDocumentIface::watchNodeTelemetry(const QString &itemId, const QString &nodeId)
+{
+    CNItem *item = m_pCircuitDocument->cnItemWithID(itemId);
+    if (!item)
+        return false;
+
+    ECNode *node = dynamic_cast<ECNode *>(m_pCircuitDocument->nodeWithID(item->nodeId(nodeId)));
+    return Simulator::self()->telemetryStream()->watchNode(itemId + '.' + nodeId, node);
+}
+
+bool CircuitDocumentIface::watchProbeTelemetry(const QString &itemId)
+{
+    const Probe *probe = dynamic_cast<Probe *>(m_pCircuitDocument->itemWithID(itemId));
+    return Simulator::self()->telemetryStream()->watchProbe(itemId, probe);
+}
+
+bool CircuitDocumentIface::unwatchTelemetry(const QString &name)
+{
+    return Simulator::self()->telemetryStream()->unwatch(name);
+}
+
+QString CircuitDocumentIface::telemetryKey()
+{
+    return Simulator::self()->telemetryStream()->key();
+}
+
 void CircuitDocumentIface::setOrientation0()
 {
     m_pCircuitDocument->setOrientation0();
@@ -26,6 +26,7 @@ class FlowCodeDocument;
 class ICNDocument;
 class ItemDocument;
 class MechanicsDocument;
+class QSharedMemory;
 class TextDocument;
 class View;
 
@@ -161,8 +162,56 @@ class CircuitDocumentIface : public ICNDocumentIface
 
 public:
     CircuitDocumentIface(CircuitDocument *document);
+    ~CircuitDocumentIface() override;
 
-    // k_dcop: TODO port to dbus
+    // The calls from here to telemetryKey are exported on the session bus
+    // by CircuitDocumentAdaptor; the rest are still to be ported from DCOP
+    /**
+     * Sets the property of the component with the given id, as if done from
+     * the item editor. The value is converted to the type of the property.
+     * @return false if there is no such component or property
+     */
+    bool setComponentProperty(const QString &itemId, const QString &propertyId, const QString &value);
+    /**
+     * Runs the simulation for the given number of seconds of simulated time,
+     * as fast as it will go, and returns once done. The simulation is paused
+     * while doing this (and is left running again after if it was running).
+     * @return the Simulator time reached, in seconds
+     */
+    double runSimulation(double seconds);
+    /**
+     * Writes the data recorded by the probes of the circuit into a block of
+     * shared memory, in the form written by BinaryProbeDataWriter, so that
+     * long traces do not have to be passed back a sample at a time. The
+     * block is kept until this is next called or the document is closed;
+     * it starts with the size of the data as a quint32.
+     * @return the key to attach to the block with (see QSharedMemory), or
+     * an empty string if it could not be created
+     */
+    QString probeDataKey();
+    /**
+     * Adds the voltage of the given node of the given item to the values
+     * published after each step of the simulation (see TelemetryStream), as
+     * the channel named "item.node".
+     * @return false if there is no such node or it could not be added
+     */
+    bool watchNodeTelemetry(const QString &itemId, const QString &nodeId);
+    /**
+     * Adds the value of the probe with the given id to the values published
+     * after each step of the simulation, as the channel named by the id.
+     * @see watchNodeTelemetry
+     */
+    bool watchProbeTelemetry(const QString &itemId);
+    /**
+     * Removes the channel with the given name from the values published.
+     */
+    bool unwatchTelemetry(const QString &name);
+    /**
+     * @return the key to attach to the block of shared memory that the
+     * values are published in (see TelemetryStream for its layout), or an
+     * empty string if it could not be created
+     */
+    QString telemetryKey();
     void setOrientation0();
     void setOrientation90();
     void setOrientation180();
@@ -176,6 +225,7 @@ public:
 
 protected:
     CircuitDocument *m_pCircuitDocument;
+    QSharedMemory *m_pProbeMemory;
 };
 
 class FlowCodeDocumentIface : public ICNDocumentIface
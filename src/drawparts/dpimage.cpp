@@ -15,108 +15,101 @@
 
 #include <KLocalizedString>
 
+#include <QCache>
+#include <QCryptographicHash>
 #include <QPainter>
+#include <QRunnable>
+#include <QThreadPool>
 #include <QTimer>
 
-#include <ktechlab_debug.h>
+#include <algorithm>
 
-// BEGIN class ImageScaleThread
-ImageScaleThread::ImageScaleThread()
+// BEGIN class ScaledImage
+ScaledImage::ScaledImage()
+    : m_scaling(Unscaled)
 {
-    // Start with a blank (grey) image
-    QPixmap pm(1, 1);
-    pm.fill(Qt::gray);
-    m_image = pm.toImage();
-
-    m_width = -1;
-    m_height = -1;
-    m_bDoneNormalScale = false;
-    m_bDoneSmoothScale = false;
-    m_bSettingsChanged = false;
 }
 
-bool ImageScaleThread::updateSettings(const QString &imageURL, int width, int height)
+QImage ScaledImage::bestScaling(BestScaling *scaling) const
 {
-    if (isRunning()) {
-        qCWarning(KTL_LOG) << "Cannot update settings while running.";
-        return false;
-    }
+    QMutexLocker locker(&m_mutex);
+    if (scaling)
+        *scaling = m_scaling;
+    return m_scaled;
+}
 
-    bool changed = false;
+void ScaledImage::setScaled(const QImage &image, BestScaling scaling)
+{
+    QMutexLocker locker(&m_mutex);
+    m_scaled = image;
+    m_scaling = scaling;
+}
+// END class ScaledImage
 
-    if (m_width != width) {
-        m_width = width;
-        changed = true;
+// BEGIN class ImageScaleTask
+class ImageScaleTask : public QRunnable
+{
+public:
+    ImageScaleTask(const QImage &image, const QSize &size, const QSharedPointer<ScaledImage> &scaled)
+        : m_image(image)
+        , m_size(size)
+        , m_pScaled(scaled)
+    {
     }
 
-    if (m_height != height) {
-        m_height = height;
-        changed = true;
-    }
+    void run() override
+    {
+        // Once the scaled image has gone from the cache and its DPImages,
+        // nobody is waiting for it
+        QSharedPointer<ScaledImage> scaled = m_pScaled.toStrongRef();
+        if (!scaled)
+            return;
 
-    if (m_imageURL != imageURL) {
-        m_imageURL = imageURL;
-        m_image.load(m_imageURL);
-        if (m_image.isNull()) {
-            QPixmap pm(1, 1);
-            pm.fill(Qt::gray);
-            m_image = pm.toImage();
-        }
-        changed = true;
+        scaled->setScaled(m_image.scaled(m_size), ScaledImage::NormalScaled);
+        scaled->setScaled(m_image.scaled(m_size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation), ScaledImage::SmoothScaled);
     }
 
-    if (changed) {
-        m_bSettingsChanged = true;
-        m_bDoneNormalScale = false;
-        m_bDoneSmoothScale = false;
-    }
-
-    return changed;
-}
+protected:
+    QImage m_image;
+    QSize m_size;
+    QWeakPointer<ScaledImage> m_pScaled;
+};
+// END class ImageScaleTask
 
-QImage ImageScaleThread::bestScaling(BestScaling *scaling) const
-{
-    BestScaling temp;
-    if (!scaling)
-        scaling = &temp;
+// BEGIN class ImageScaleCache
+// The scaled images kept around after the DPImages using them have gone
+// (e.g. for resizing back), in kilobytes
+static const int IMAGE_CACHE_SIZE = 64 * 1024;
 
-    if (m_bDoneSmoothScale) {
-        *scaling = SmoothScaled;
-        return m_smoothScaled;
-    }
-
-    else if (m_bDoneNormalScale) {
-        *scaling = NormalScaled;
-        return m_normalScaled;
-    }
+typedef QCache<QByteArray, QSharedPointer<ScaledImage>> ScaledImageCache;
+Q_GLOBAL_STATIC_WITH_ARGS(ScaledImageCache, scaledImageCache, (IMAGE_CACHE_SIZE))
 
-    else {
-        *scaling = Unscaled;
-        return m_image;
-    }
+QByteArray ImageScaleCache::imageHash(const QImage &image)
+{
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    const QImage::Format format = image.format();
+    hash.addData(reinterpret_cast<const char *>(&format), sizeof(format));
+    const QSize size = image.size();
+    hash.addData(reinterpret_cast<const char *>(&size), sizeof(size));
+    hash.addData(reinterpret_cast<const char *>(image.constBits()), int(image.sizeInBytes()));
+    return hash.result();
 }
 
-void ImageScaleThread::run()
+QSharedPointer<ScaledImage> ImageScaleCache::scaled(const QImage &image, const QByteArray &imageHash, const QSize &size)
 {
-    do {
-        m_bSettingsChanged = false;
-        if (!m_bDoneNormalScale) {
-            m_normalScaled = m_image.scaled(m_width, m_height);
-            m_bDoneNormalScale = true;
-        }
-    } while (m_bSettingsChanged);
+    const QByteArray key = imageHash + QByteArray::number(size.width()) + 'x' + QByteArray::number(size.height());
 
-    // If m_bSettingsChanged is true, then another thread called updateSettings
-    // while we were doing normal scaling, so don't both doing smooth scaling
-    // just yet.
+    if (QSharedPointer<ScaledImage> *cached = scaledImageCache->object(key))
+        return *cached;
 
-    if (!m_bDoneSmoothScale) {
-        // m_smoothScaled = m_image.smoothScale( m_width, m_height ); // 2018.12.01
-        m_smoothScaled = m_image.scaled(QSize(m_width, m_height), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-        m_bDoneSmoothScale = true;
-    }
+    QSharedPointer<ScaledImage> scaled(new ScaledImage);
+    const int cost = std::max(1, int(qint64(size.width()) * size.height() * 4 / 1024));
+    scaledImageCache->insert(key, new QSharedPointer<ScaledImage>(scaled), cost);
+
+    QThreadPool::globalInstance()->start(new ImageScaleTask(image, size, scaled));
+    return scaled;
 }
-// END class ImageScaleThread
+// END class ImageScaleCache
 
 // BEGIN class DPImage
 Item *DPImage::construct(ItemDocument *itemDocument, bool newItem, const char *id)
@@ -134,7 +127,7 @@ DPImage::DPImage(ItemDocument *itemDocument, bool newItem, const char *id)
 {
     m_bSettingsChanged = false;
     m_bResizeToImage = newItem;
-    m_imageScaling = ImageScaleThread::Unscaled;
+    m_imageScaling = ScaledImage::Unscaled;
 
     m_pRectangularOverlay = new RectangularOverlay(this);
 
@@ -151,7 +144,6 @@ DPImage::DPImage(ItemDocument *itemDocument, bool newItem, const char *id)
 
 DPImage::~DPImage()
 {
-    m_imageScaleThread.wait();
 }
 
 void DPImage::setSelected(bool yes)
@@ -172,21 +164,29 @@ void DPImage::postResize()
 void DPImage::dataChanged()
 {
     m_imageURL = dataString("image");
-    m_image.load(m_imageURL);
+    m_sourceImage.load(m_imageURL);
+    m_pScaledImage.reset();
 
-    if (m_image.isNull()) {
+    if (m_sourceImage.isNull()) {
         // Make a grey image
         // m_image.resize( width(), height() ); // 2018.12.01
         m_image = m_image.copy(0, 0, width(), height());
         m_image.fill(Qt::gray);
 
-        m_imageScaling = ImageScaleThread::SmoothScaled;
+        m_sourceImage = QImage(1, 1, QImage::Format_RGB32);
+        m_sourceImage.fill(Qt::gray);
+        m_sourceImageHash = ImageScaleCache::imageHash(m_sourceImage);
+
+        m_imageScaling = ScaledImage::SmoothScaled;
     } else {
+        m_image = QPixmap::fromImage(m_sourceImage);
+        m_sourceImageHash = ImageScaleCache::imageHash(m_sourceImage);
+
         if (m_bResizeToImage) {
             int w = m_image.width();
             int h = m_image.height();
             setSize(0, 0, w, h);
-            m_imageScaling = ImageScaleThread::SmoothScaled;
+            m_imageScaling = ScaledImage::SmoothScaled;
         } else {
             m_bResizeToImage = true;
             m_bSettingsChanged = true;
@@ -196,26 +196,24 @@ void DPImage::dataChanged()
 
 void DPImage::checkImageScaling()
 {
-    if (!m_bSettingsChanged && (m_imageScaling == ImageScaleThread::SmoothScaled)) {
+    if (!m_bSettingsChanged && (m_imageScaling == ScaledImage::SmoothScaled)) {
         // Image scaling is already at its best, so return
         return;
     }
 
-    ImageScaleThread::BestScaling bs;
-    QImage im = m_imageScaleThread.bestScaling(&bs);
+    if (m_bSettingsChanged || !m_pScaledImage) {
+        m_bSettingsChanged = false;
+        m_imageScaling = ScaledImage::Unscaled;
+        m_pScaledImage = ImageScaleCache::scaled(m_sourceImage, m_sourceImageHash, QSize(width(), height()));
+    }
+
+    ScaledImage::BestScaling bs;
+    QImage im = m_pScaledImage->bestScaling(&bs);
     if (bs > m_imageScaling) {
         m_imageScaling = bs;
         m_image = QPixmap::fromImage(im);
         setChanged();
     }
-
-    if (!m_imageScaleThread.isRunning()) {
-        if (m_imageScaleThread.updateSettings(m_imageURL, width(), height())) {
-            m_bSettingsChanged = false;
-            m_imageScaling = ImageScaleThread::Unscaled;
-            m_imageScaleThread.start();
-        }
-    }
 }
 
 void DPImage::drawShape(QPainter &p)
@@ -13,48 +13,58 @@
 
 #include "drawpart.h"
 
+#include <QByteArray>
 #include <QImage>
+#include <QMutex>
 #include <QPixmap>
-#include <QThread>
+#include <QSharedPointer>
 
 /**
-@short Thread to perform quick and then good image scaling.
-@author David Saxton
+An image scaled to a given size, shared by the DPImages that show the same
+image at the same size. The scaling is done in the global QThreadPool, first
+quickly and then smoothly; the best scaling done so far can be read at any
+time.
+@see ImageScaleCache
 */
-class ImageScaleThread : public QThread
+class ScaledImage
 {
 public:
     enum BestScaling { Unscaled, NormalScaled, SmoothScaled };
 
-    ImageScaleThread();
-    /**
-     * Use the given settings.
-     * @return if any of the settings changed.
-     */
-    bool updateSettings(const QString &imageURL, int width, int height);
+    ScaledImage();
     /**
      * @param scaling is set to the type of scaling that this image has had.
-     * @return the best image done so far.
+     * @return the best image done so far (null if Unscaled).
      */
     QImage bestScaling(BestScaling *scaling = nullptr) const;
-
-protected:
     /**
-     * Start scaling.
+     * Called from the thread pool with the image scaled so far.
      */
-    void run() override;
+    void setScaled(const QImage &image, BestScaling scaling);
 
-    QImage m_image;
-    QImage m_normalScaled;
-    QImage m_smoothScaled;
-
-    bool m_bDoneNormalScale;
-    bool m_bDoneSmoothScale;
+protected:
+    mutable QMutex m_mutex;
+    QImage m_scaled;
+    BestScaling m_scaling;
+};
 
-    int m_width;
-    int m_height;
-    QString m_imageURL;
-    bool m_bSettingsChanged;
+/**
+Scales images for DPImage. The scaled images are kept by the hash of the
+image data and the size, so that an image shown many times at the same size
+is only scaled once.
+*/
+class ImageScaleCache
+{
+public:
+    /**
+     * @return a hash of the pixels of the image, to pass to scaled.
+     */
+    static QByteArray imageHash(const QImage &image);
+    /**
+     * @return the image scaled to the given size, which is being scaled in
+     * the thread pool if it was not in the cache.
+     */
+    static QSharedPointer<ScaledImage> scaled(const QImage &image, const QByteArray &imageHash, const QSize &size);
 };
 
 /**
@@ -79,7 +89,7 @@ protected:
 protected slots:
     /**
      * Called from a timeout event after resizing to see if the image
-     * resizing thread has done anything useful yet.
+     * scaling has done anything useful yet.
      */
     void checkImageScaling();
 
@@ -87,9 +97,11 @@ private:
     void drawShape(QPainter &p) override;
     void dataChanged() override;
 
-    ImageScaleThread::BestScaling m_imageScaling;
+    ScaledImage::BestScaling m_imageScaling;
     QPixmap m_image;
-    ImageScaleThread m_imageScaleThread;
+    QImage m_sourceImage;
+    QByteArray m_sourceImageHash;
+    QSharedPointer<ScaledImage> m_pScaledImage;
     RectangularOverlay *m_pRectangularOverlay;
     QTimer *m_pCheckImageScalingTimer;
     QString m_imageURL;
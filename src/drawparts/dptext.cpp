@@ -16,7 +16,6 @@
 #include <KLocalizedString>
 
 #include <QPainter>
-#include <QTextEdit>
 
 // #include <q3simplerichtext.h> // 2018.08.13 - not needed anymore
 // #include <q3stylesheet.h>
@@ -86,6 +85,7 @@ void DPText::dataChanged()
         // Format the text to be HTML
         m_text.replace('\n', "<br>");
     }
+    m_document.setHtml(m_text);
 
     update();
 }
@@ -122,11 +122,12 @@ void DPText::drawShape(QPainter &p)
     bound.setRight(bound.right() - pad);
     bound.setBottom(bound.bottom() - pad);
 
-    QTextEdit *t = new QTextEdit(m_text);
-    t->resize(bound.width(), bound.height()); // t->setWidth( bound.width() );
-    t->viewport()->setAutoFillBackground(false);
-    t->setFrameStyle(QFrame::NoFrame);
+    // The document keeps its layout until the text or the width changes
+    if (m_document.textWidth() != bound.width())
+        m_document.setTextWidth(bound.width());
 
-    t->render(&p, bound.topLeft(), QRegion(), QWidget::DrawChildren); // t->draw( &p, bound.left(), bound.top(), bound, QColorGroup() );
-    delete t;
+    p.save();
+    p.translate(bound.topLeft());
+    m_document.drawContents(&p, QRectF(0, 0, bound.width(), bound.height()));
+    p.restore();
 }
@@ -13,6 +13,8 @@
 
 #include "drawpart.h"
 
+#include <QTextDocument>
+
 /**
 @short Represents editable text on the canvas
 @author David Saxton
@@ -38,6 +40,7 @@ private:
     void drawShape(QPainter &p) override;
     void dataChanged() override;
     QString m_text;
+    QTextDocument m_document; ///< m_text, laid out for the last width it was drawn at
     bool b_displayBackground;
     QColor m_backgroundColor;
     QColor m_frameColor;
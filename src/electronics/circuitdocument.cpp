@@ -10,6 +10,7 @@
 
 #include "circuitdocument.h"
 #include "canvasmanipulator.h"
+#include "circuitdocumentadaptor.h"
 #include "circuiticndocument.h"
 #include "circuitview.h"
 #include "cnitemgroup.h"
@@ -20,8 +21,13 @@
 #include "ecnode.h"
 #include "itemdocumentdata.h"
 #include "ktechlab.h"
+#include "logicboundary.h"
+#include "logicnetlist.h"
 #include "pin.h"
+#include "probe.h"
 #include "simulator.h"
+#include "stallwatch.h"
+#include "stimulus.h"
 #include "subcircuits.h"
 #include "switch.h"
 
@@ -30,20 +36,44 @@
 #include <KMessageBox>
 #include <KToggleAction>
 
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileDialog>
+#include <QPainter>
+#include <QHash>
 #include <QInputDialog>
 #include <QRegExp>
+#include <QThread>
 #include <QTimer>
 
+#include <vector>
+
 #include <ktlconfig.h>
 #include <ktechlab_debug.h>
 
+/// The share of a frame that working out the wire currents for the animation
+/// may take before it is done less often
+static const double maxAnimationFrameShare = 0.25;
+
+/// The most frames that the wire currents are kept for, when throttled
+static const int maxCurrentsFrameInterval = 16;
+
 CircuitDocument::CircuitDocument(const QString &caption)
     : CircuitICNDocument(caption)
+    , m_bAssignCircuitsPending(false)
+    , m_pLogicNetlist(nullptr)
+    , m_bLogicNetlistIdeal(false)
+    , m_currentsFrame(0)
+    , m_currentsFrameInterval(1)
+    , m_simulationPriority(1.)
 {
     m_pOrientationAction = new KActionMenu(QIcon::fromTheme("transform-rotate"), i18n("Orientation"), this);
 
     m_type = Document::dt_circuit;
-    m_pDocumentIface = new CircuitDocumentIface(this);
+    CircuitDocumentIface *iface = new CircuitDocumentIface(this);
+    m_pDocumentIface = iface;
+    new CircuitDocumentAdaptor(this, iface);
     m_fileExtensionInfo = QString("*.circuit|%1(*.circuit)\n*|%2").arg(i18n("Circuit")).arg(i18n("All Files"));
     m_fileExtensionValue = QString(".circuit");
 
@@ -60,11 +90,14 @@ CircuitDocument::CircuitDocument(const QString &caption)
     m_updateCircuitsTmr = new QTimer();
     connect(m_updateCircuitsTmr, &QTimer::timeout, this, &CircuitDocument::assignCircuits);
 
+    updateSimulationShare();
+
     requestStateSave();
 }
 
 CircuitDocument::~CircuitDocument()
 {
+    SimulationLocker locker;
     m_bDeleted = true;
 
     disconnect(m_updateCircuitsTmr, &QTimer::timeout, this, &CircuitDocument::assignCircuits);
@@ -85,6 +118,8 @@ CircuitDocument::~CircuitDocument()
     }
 
     deleteCircuits();
+    if (!Simulator::isDestroyedSim())
+        Simulator::self()->removeDocument(this);
 
     delete m_updateCircuitsTmr;
     delete m_pDocumentIface;
@@ -186,6 +221,7 @@ View *CircuitDocument::createView(ViewContainer *viewContainer, uint viewAreaId)
 
 void CircuitDocument::slotUpdateConfiguration()
 {
+    SimulationLocker locker;
     CircuitICNDocument::slotUpdateConfiguration();
 
     ECNodeMap::iterator nodeEnd = m_ecNodeList.end();
@@ -202,25 +238,88 @@ void CircuitDocument::slotUpdateConfiguration()
     ComponentList::iterator componentsEnd = m_componentList.end();
     for (ComponentList::iterator it = m_componentList.begin(); it != componentsEnd; ++it)
         (*it)->slotUpdateConfiguration();
+
+    // Which gates depend on which others within a logic update changes with
+    // ideal logic, so they have to be compiled again
+    if (m_pLogicNetlist && KTLConfig::idealLogic() != m_bLogicNetlistIdeal)
+        requestAssignCircuits();
+
+    updateSimulationShare();
+}
+
+MemoryUsage CircuitDocument::memoryUsage() const
+{
+    MemoryUsage usage = ICNDocument::memoryUsage();
+
+    SimulationLocker locker;
+
+    const ItemMap::const_iterator end = m_itemList.constEnd();
+    for (ItemMap::const_iterator it = m_itemList.constBegin(); it != end; ++it) {
+        const Probe *probe = dynamic_cast<const Probe *>(*it);
+        if (probe && probe->probeData())
+            usage.bytes[MemoryUsage::ProbeData] += probe->probeData()->memoryUsage();
+    }
+
+    for (const Circuit *circuit : m_circuitList)
+        usage.bytes[MemoryUsage::LogicCaches] += circuit->logicCacheMemoryUsage();
+
+    return usage;
+}
+
+void CircuitDocument::trimCaches()
+{
+    ICNDocument::trimCaches();
+
+    SimulationLocker locker;
+    for (Circuit *circuit : m_circuitList)
+        circuit->trimLogicCache();
 }
 
 void CircuitDocument::update()
 {
+    // Called with the simulation locked (see Canvas::update), so that what
+    // is drawn can be taken from it before checking what has changed
+    const ComponentList::iterator componentEnd = m_componentList.end();
+    for (ComponentList::iterator it = m_componentList.begin(); it != componentEnd; ++it)
+        (*it)->publishDisplayState();
+
     CircuitICNDocument::update();
 
     bool animWires = KTLConfig::animateWires();
 
     if (KTLConfig::showVoltageColor() || animWires) {
-        if (animWires) {
-            // Wire animation is for showing currents, so we need to recalculate the currents
-            // in the wires.
+        const double framePeriod = 1.0 / double(frameRate());
+
+        QElapsedTimer timer;
+        timer.start();
+
+        // Wire animation is for showing currents, so we need to recalculate the
+        // currents in the wires. This is the expensive part, so is done less
+        // often than every frame when it takes up too much of the frame.
+        const bool calculateCurrents = animWires && (++m_currentsFrame >= m_currentsFrameInterval);
+        if (calculateCurrents) {
+            m_currentsFrame = 0;
             calculateConnectorCurrents();
         }
 
         ConnectorList::iterator end = m_connectorList.end();
         for (ConnectorList::iterator it = m_connectorList.begin(); it != end; ++it) {
-            (*it)->incrementCurrentAnimation(1.0 / double(KTLConfig::refreshRate()));
-            (*it)->updateConnectorLines(animWires);
+            bool moved = false;
+            if (animWires) {
+                if (calculateCurrents)
+                    (*it)->updateCurrentAnimationSpeed();
+                moved = (*it)->incrementCurrentAnimation(framePeriod);
+            }
+            // Only connectors whose dashes moved are drawn again
+            (*it)->updateConnectorLines(moved);
+        }
+
+        if (calculateCurrents) {
+            const double elapsed = timer.nsecsElapsed() * 1e-9;
+            if (elapsed > framePeriod * maxAnimationFrameShare)
+                m_currentsFrameInterval = qMin(m_currentsFrameInterval * 2, maxCurrentsFrameInterval);
+            else if (elapsed < framePeriod * maxAnimationFrameShare / 4)
+                m_currentsFrameInterval = qMax(m_currentsFrameInterval / 2, 1);
         }
     }
 
@@ -233,6 +332,40 @@ void CircuitDocument::update()
     }
 }
 
+void CircuitDocument::drawOverlay(QPainter &p, const QRect &clip)
+{
+    if (m_heatMap.isEmpty())
+        return;
+
+    p.save();
+    p.setPen(Qt::NoPen);
+
+    const ComponentList::const_iterator end = m_componentList.constEnd();
+    for (ComponentList::const_iterator it = m_componentList.constBegin(); it != end; ++it) {
+        const double heat = m_heatMap.value(*it);
+        if (heat <= 0. || !*it || !(*it)->isVisible())
+            continue;
+
+        const QRect rect = (*it)->boundingRect();
+        if (!rect.intersects(clip))
+            continue;
+
+        p.setBrush(QColor(255, 0, 0, qRound(32 + 160 * qMin(heat, 1.))));
+        p.drawRect(rect);
+    }
+
+    p.restore();
+}
+
+void CircuitDocument::setHeatMap(const QHash<const Component *, double> &heatMap)
+{
+    if (heatMap.isEmpty() && m_heatMap.isEmpty())
+        return;
+
+    m_heatMap = heatMap;
+    m_canvas->setAllChanged();
+}
+
 void CircuitDocument::fillContextMenu(const QPoint &pos)
 {
     CircuitICNDocument::fillContextMenu(pos);
@@ -272,32 +405,92 @@ void CircuitDocument::fillContextMenu(const QPoint &pos)
     }
 }
 
-void CircuitDocument::deleteCircuits()
+CircuitPartition::~CircuitPartition()
 {
-    const CircuitList::iterator end = m_circuitList.end();
-    for (CircuitList::iterator it = m_circuitList.begin(); it != end; ++it) {
-        if (!Simulator::isDestroyedSim()) {
+    qDeleteAll(circuits);
+    qDeleteAll(boundaries);
+}
+
+void CircuitDocument::detachCircuits()
+{
+    // The netlist gives the callbacks back to the LogicIns, so this has to go
+    // before any of them are deleted
+    if (m_pLogicNetlist) {
+        if (!Simulator::isDestroyedSim())
+            Simulator::self()->detachLogicNetlist(m_pLogicNetlist);
+        delete m_pLogicNetlist;
+        m_pLogicNetlist = nullptr;
+    }
+
+    if (!Simulator::isDestroyedSim()) {
+        const CircuitList::iterator end = m_circuitList.end();
+        for (CircuitList::iterator it = m_circuitList.begin(); it != end; ++it)
             Simulator::self()->detachCircuit(*it);
-        }
-        delete *it;
     }
     m_circuitList.clear();
     m_pinList.clear();
     m_wireList.clear();
 }
 
+void CircuitDocument::deleteCircuits()
+{
+    detachCircuits();
+
+    const QList<CircuitPartition *>::iterator end = m_partitions.end();
+    for (QList<CircuitPartition *>::iterator it = m_partitions.begin(); it != end; ++it)
+        delete *it;
+    m_partitions.clear();
+}
+
 void CircuitDocument::requestAssignCircuits()
 {
     // 	qCDebug(KTL_LOG);
     if (m_bDeleted) {
         return;
     }
-    deleteCircuits();
+    if (QThread::currentThread() != thread()) {
+        // Called from the simulation thread; the timer belongs to this one
+        QMetaObject::invokeMethod(this, "requestAssignCircuits", Qt::QueuedConnection);
+        return;
+    }
+    m_currentSteps.clear();
+
+    // The circuits are still detached straight away, as the components in
+    // them may be about to go
+    if (isBulkLoading() && m_bAssignCircuitsPending)
+        return;
+
+    SimulationLocker locker;
+    detachCircuits();
     m_updateCircuitsTmr->stop();
+
+    if (isBulkLoading()) {
+        m_bAssignCircuitsPending = true;
+        return;
+    }
+
     m_updateCircuitsTmr->setSingleShot(true);
     m_updateCircuitsTmr->start(0 /*, true */);
 }
 
+void CircuitDocument::assignPendingCircuits()
+{
+    if (m_updateCircuitsTmr->isActive()) {
+        m_updateCircuitsTmr->stop();
+        assignCircuits();
+    }
+}
+
+void CircuitDocument::bulkLoadFinished()
+{
+    CircuitICNDocument::bulkLoadFinished();
+
+    if (m_bAssignCircuitsPending) {
+        m_bAssignCircuitsPending = false;
+        requestAssignCircuits();
+    }
+}
+
 void CircuitDocument::connectorAddedSlot(Connector *connector)
 {
     if (connector) {
@@ -358,6 +551,35 @@ void CircuitDocument::calculateConnectorCurrents()
     for (CircuitList::iterator it = m_circuitList.begin(); it != circuitEnd; ++it)
         (*it)->updateCurrents();
 
+    PinList groundPins = resetConnectorCurrents();
+
+    // Which currents can be worked out from which depends only on how the
+    // circuit is connected (and on the switches), so the order found by going
+    // over the wires again and again is used until that changes
+    if (!m_currentSteps.isEmpty()) {
+        if (replayConnectorCurrents())
+            return;
+        groundPins = resetConnectorCurrents();
+    }
+
+    findConnectorCurrents(groundPins);
+}
+
+bool CircuitDocument::inSameAnalogPartition(Pin *a, Pin *b) const
+{
+    if (m_updateCircuitsTmr->isActive() || m_bAssignCircuitsPending)
+        return false;
+
+    const QList<CircuitPartition *>::const_iterator end = m_partitions.constEnd();
+    for (QList<CircuitPartition *>::const_iterator it = m_partitions.constBegin(); it != end; ++it) {
+        if ((*it)->pinList.contains(a))
+            return (*it)->canReuse && (*it)->pinList.contains(b);
+    }
+    return false;
+}
+
+PinList CircuitDocument::resetConnectorCurrents()
+{
     PinList groundPins;
 
     // Tell the Pins to reset their calculated currents to zero
@@ -394,6 +616,13 @@ void CircuitDocument::calculateConnectorCurrents()
     for (WireList::iterator it = m_wireList.begin(); it != clEnd; ++it)
         (*it)->setCurrentKnown(false);
 
+    return groundPins;
+}
+
+void CircuitDocument::findConnectorCurrents(PinList groundPins)
+{
+    m_currentSteps.clear();
+
     SwitchList switches = m_switchList;
     WireList wires = m_wireList;
     bool found = true;
@@ -403,6 +632,7 @@ void CircuitDocument::calculateConnectorCurrents()
         for (WireList::iterator itW = wires.begin(); itW != wires.end();) {
             if ((*itW)->calculateCurrent()) {
                 found = true;
+                m_currentSteps.append({*itW, nullptr, nullptr});
                 itW = wires.erase(itW);
                 // note: assigning a temporary iterator, incrementing and erasing, seems to crash
             } else {
@@ -414,6 +644,7 @@ void CircuitDocument::calculateConnectorCurrents()
         for (SwitchList::iterator it = switches.begin(); it != switchesEnd;) {
             if ((*it)->calculateCurrent()) {
                 found = true;
+                m_currentSteps.append({nullptr, *it, nullptr});
                 // note: assigning a temporary iterator, incrementing and erasing, seems to crash
                 // it = container.erase( it ) seems to crash other times
                 SwitchList::iterator oldIt = it;
@@ -431,6 +662,7 @@ void CircuitDocument::calculateConnectorCurrents()
         for (PinList::iterator it = groundPins.begin(); it != groundPinsEnd;) {
             if ((*it)->calculateCurrentFromWires()) {
                 found = true;
+                m_currentSteps.append({nullptr, nullptr, *it});
                 // note: assigning a temporary iterator, incrementing and erasing, seems to crash sometimes;
                 // it = container.erase( it ) seems to crash other times
                 PinList::iterator oldIt = it;
@@ -442,8 +674,66 @@ void CircuitDocument::calculateConnectorCurrents()
     }
 }
 
+bool CircuitDocument::replayConnectorCurrents()
+{
+    const QVector<CurrentStep>::const_iterator end = m_currentSteps.constEnd();
+    for (QVector<CurrentStep>::const_iterator it = m_currentSteps.constBegin(); it != end; ++it) {
+        bool found;
+        if (it->wire)
+            found = it->wire->calculateCurrent();
+        else if (it->sw)
+            found = it->sw->calculateCurrent();
+        else if (it->pin)
+            found = it->pin->calculateCurrentFromWires();
+        else
+            found = false; // The wire or pin has gone
+
+        if (!found)
+            return false;
+    }
+
+    return true;
+}
+
+static void addToKey(const PinList &pins, std::vector<quintptr> *key)
+{
+    key->push_back(pins.size());
+    const PinList::const_iterator end = pins.end();
+    for (PinList::const_iterator it = pins.begin(); it != end; ++it)
+        key->push_back(quintptr(static_cast<Pin *>(*it)));
+}
+
+/**
+ * @return what the circuits made from the partition depend on: the pins in
+ * it (in order), and what each of them is connected to.
+ */
+static std::vector<quintptr> partitionKey(const PinList &pinList)
+{
+    std::vector<quintptr> key;
+    const PinList::const_iterator end = pinList.end();
+    for (PinList::const_iterator it = pinList.begin(); it != end; ++it) {
+        Pin *pin = *it;
+        key.push_back(quintptr(pin));
+        key.push_back(quintptr(pin->groundType()));
+
+        addToKey(pin->localConnectedPins(), &key);
+        addToKey(pin->groundDependentPins(), &key);
+        addToKey(pin->circuitDependentPins(), &key);
+
+        const ElementList elements = pin->elements();
+        key.push_back(elements.size());
+        const ElementList::const_iterator eEnd = elements.end();
+        for (ElementList::const_iterator e = elements.begin(); e != eEnd; ++e)
+            key.push_back(quintptr(*e));
+    }
+    return key;
+}
+
 void CircuitDocument::assignCircuits()
 {
+    StallWatch::Region region("Assign circuits", this);
+    SimulationLocker locker;
+
     // Now we can finally add the unadded components to the Simulator
     const ComponentList::iterator toSimulateEnd = m_toSimulateList.end();
     for (ComponentList::iterator it = m_toSimulateList.begin(); it != toSimulateEnd; ++it)
@@ -451,7 +741,11 @@ void CircuitDocument::assignCircuits()
 
     m_toSimulateList.clear();
 
+    delete m_pLogicNetlist;
+    m_pLogicNetlist = new LogicNetlist;
+
     // Stage 0: Build up pin and wire lists
+    m_currentSteps.clear();
     m_pinList.clear();
 
     const ECNodeMap::const_iterator nodeListEnd = m_ecNodeList.end();
@@ -463,38 +757,99 @@ void CircuitDocument::assignCircuits()
             m_pinList << ecnode->pin(i);
     }
 
+    // The wires are taken from the pins, rather than from the connectors, as
+    // flattened subcircuits have wires without connectors. Each wire is
+    // listed once, by the pin it starts at.
     m_wireList.clear();
 
-    const ConnectorList::const_iterator connectorListEnd = m_connectorList.end();
-    for (ConnectorList::const_iterator it = m_connectorList.begin(); it != connectorListEnd; ++it) {
-        for (unsigned i = 0; i < (*it)->numWires(); i++)
-            m_wireList << (*it)->wire(i);
+    const PinList::const_iterator wirePinsEnd = m_pinList.constEnd();
+    for (PinList::const_iterator it = m_pinList.constBegin(); it != wirePinsEnd; ++it) {
+        if (*it)
+            m_wireList += (*it)->outputWireList();
     }
 
     typedef QList<PinList> PinListList;
 
     // Stage 1: Partition the circuit up into dependent areas (bar splitting
     // at ground pins)
-    PinList unassignedPins = m_pinList;
+    QSet<Pin *> assignedPins;
+    assignedPins.reserve(m_pinList.size());
     PinListList pinListList;
 
-    while (!unassignedPins.isEmpty()) {
+    const PinList::const_iterator pinListEnd = m_pinList.constEnd();
+    for (PinList::const_iterator it = m_pinList.constBegin(); it != pinListEnd; ++it) {
+        if (!*it || assignedPins.contains(*it))
+            continue;
+
         PinList pinList;
-        getPartition(*unassignedPins.begin(), &pinList, &unassignedPins);
+        getPartition(*it, &pinList, &assignedPins);
         pinListList.append(pinList);
     }
 
     // 	qCDebug(KTL_LOG) << "pinListList.size()="<<pinListList.size();
 
-    // Stage 2: Split up each partition into circuits by ground pins
-    const PinListList::iterator nllEnd = pinListList.end();
-    for (PinListList::iterator it = pinListList.begin(); it != nllEnd; ++it)
-        splitIntoCircuits(&*it);
+    // Stage 2: Keep the circuits of the partitions that have not changed
+    // since last time (along with their solutions and caches). The rest of
+    // the old circuits have to be deleted before any new ones are made, as
+    // their elements will go in the new ones
+    QHash<Pin *, CircuitPartition *> oldPartitions;
+    const QList<CircuitPartition *>::const_iterator oldEnd = m_partitions.constEnd();
+    for (QList<CircuitPartition *>::const_iterator it = m_partitions.constBegin(); it != oldEnd; ++it) {
+        if ((*it)->canReuse)
+            oldPartitions.insert((*it)->pinList.first(), *it);
+    }
 
-    // Stage 3: Initialize the circuits
-    m_circuitList.removeAll(nullptr);
-    CircuitList::iterator circuitListEnd = m_circuitList.end();
-    for (CircuitList::iterator it = m_circuitList.begin(); it != circuitListEnd; ++it)
+    QList<CircuitPartition *> partitions;
+    QSet<CircuitPartition *> keptPartitions;
+    QSet<const ElementSet *> keptElementSets;
+    PinListList changedPinLists;
+    QList<std::vector<quintptr>> changedKeys;
+    const PinListList::const_iterator pllEnd = pinListList.constEnd();
+    for (PinListList::const_iterator it = pinListList.constBegin(); it != pllEnd; ++it) {
+        const std::vector<quintptr> key = partitionKey(*it);
+        CircuitPartition *partition = oldPartitions.value(it->first());
+        if (!partition || partition->key != key || partition->pinList.contains(nullptr)) {
+            changedPinLists.append(*it);
+            changedKeys.append(key);
+            continue;
+        }
+
+        oldPartitions.remove(it->first());
+        partitions.append(partition);
+        keptPartitions.insert(partition);
+        m_circuitList += partition->circuits;
+
+        const CircuitList::const_iterator end = partition->circuits.constEnd();
+        for (CircuitList::const_iterator circuit = partition->circuits.constBegin(); circuit != end; ++circuit)
+            keptElementSets.insert((*circuit)->elementSet());
+    }
+
+    for (QList<CircuitPartition *>::const_iterator it = m_partitions.constBegin(); it != oldEnd; ++it) {
+        if (!keptPartitions.contains(*it))
+            delete *it;
+    }
+    m_partitions = partitions;
+
+    // Stage 3: Split up each of the other partitions into circuits by ground
+    // pins
+    CircuitList newCircuits;
+    QList<LogicBoundary *> newBoundaries;
+    for (int i = 0; i < changedPinLists.size(); ++i) {
+        CircuitPartition *partition = new CircuitPartition;
+        partition->pinList = changedPinLists[i];
+        partition->key = changedKeys[i];
+        partition->canReuse = splitIntoCircuits(&changedPinLists[i], &partition->circuits, &partition->boundaries);
+        partition->circuits.removeAll(nullptr);
+
+        newCircuits += partition->circuits;
+        newBoundaries += partition->boundaries;
+        m_partitions.append(partition);
+    }
+    m_circuitList += newCircuits;
+
+    // Stage 4: Initialize the new circuits
+    CircuitList::iterator circuitListEnd = newCircuits.end();
+    for (CircuitList::iterator it = newCircuits.begin(); it != circuitListEnd; ++it)
         (*it)->init();
 
     m_switchList.clear();
@@ -511,64 +866,116 @@ void CircuitDocument::assignCircuits()
         m_switchList += component->switchList();
     }
 
-    circuitListEnd = m_circuitList.end();
-    for (CircuitList::iterator it = m_circuitList.begin(); it != circuitListEnd; ++it)
+    const QList<LogicBoundary *>::const_iterator newBoundariesEnd = newBoundaries.constEnd();
+    for (QList<LogicBoundary *>::const_iterator it = newBoundaries.constBegin(); it != newBoundariesEnd; ++it)
+        (*it)->initCNodes();
+
+    circuitListEnd = newCircuits.end();
+    for (CircuitList::iterator it = newCircuits.begin(); it != circuitListEnd; ++it)
         (*it)->createMatrixMap();
 
     for (ItemMap::const_iterator it = m_itemList.begin(); it != cilEnd; ++it) {
         Component *component = dynamic_cast<Component *>(*it);
 
         if (component)
-            component->initElements(1);
+            component->initElements(1, &keptElementSets);
     }
 
-    circuitListEnd = m_circuitList.end();
-    for (CircuitList::iterator it = m_circuitList.begin(); it != circuitListEnd; ++it) {
+    circuitListEnd = newCircuits.end();
+    for (CircuitList::iterator it = newCircuits.begin(); it != circuitListEnd; ++it)
         (*it)->initCache();
-        Simulator::self()->attachCircuit(*it);
+
+    circuitListEnd = m_circuitList.end();
+    for (CircuitList::iterator it = m_circuitList.begin(); it != circuitListEnd; ++it)
+        Simulator::self()->attachCircuit(*it, this);
+
+    // Stage 5: Compile the logic gates that are only connected to other logic
+    const ComponentList::const_iterator componentListEnd = m_componentList.constEnd();
+    for (ComponentList::const_iterator it = m_componentList.constBegin(); it != componentListEnd; ++it) {
+        LogicGate gate;
+        if ((*it)->describeLogicGate(&gate))
+            m_pLogicNetlist->addGate(gate);
+    }
+
+    m_bLogicNetlistIdeal = LogicOut::idealLogic();
+    if (m_pLogicNetlist->compile() > 0)
+        Simulator::self()->attachLogicNetlist(m_pLogicNetlist);
+    else {
+        delete m_pLogicNetlist;
+        m_pLogicNetlist = nullptr;
     }
 }
 
-void CircuitDocument::getPartition(Pin *pin, PinList *pinList, PinList *unassignedPins, bool onlyGroundDependent)
+/**
+ * A pin, and the pins connected to it that have still to be gone through by
+ * getPartition or recursivePinAdd (which would otherwise recurse).
+ */
+class ConnectedPins
 {
-    if (!pin)
-        return;
+public:
+    ConnectedPins(Pin *pin, bool circuitDependent)
+        : pin(pin)
+        , pins(pin->localConnectedPins())
+        , next(0)
+    {
+        pins += pin->groundDependentPins();
+        if (circuitDependent)
+            pins += pin->circuitDependentPins();
+    }
 
-    unassignedPins->removeAll(pin);
+    Pin *pin;
+    PinList pins;
+    int next;
+};
 
-    if (pinList->contains(pin))
+void CircuitDocument::getPartition(Pin *pin, PinList *pinList, QSet<Pin *> *assignedPins, bool onlyGroundDependent)
+{
+    if (!pin)
         return;
 
+    // The pins are gone through in the same order as recursing into each
+    // connected pin would, but without running out of stack on long chains
+    QSet<Pin *> inPartition;
+    std::vector<ConnectedPins> stack;
+
+    assignedPins->insert(pin);
+    inPartition.insert(pin);
     pinList->append(pin);
+    stack.push_back(ConnectedPins(pin, !onlyGroundDependent));
 
-    const PinList localConnectedPins = pin->localConnectedPins();
-    const PinList::const_iterator end = localConnectedPins.end();
-    for (PinList::const_iterator it = localConnectedPins.begin(); it != end; ++it)
-        getPartition(*it, pinList, unassignedPins, onlyGroundDependent);
+    while (!stack.empty()) {
+        ConnectedPins &top = stack.back();
+        if (top.next == top.pins.size()) {
+            stack.pop_back();
+            continue;
+        }
 
-    const PinList groundDependentPins = pin->groundDependentPins();
-    const PinList::const_iterator dEnd = groundDependentPins.end();
-    for (PinList::const_iterator it = groundDependentPins.begin(); it != dEnd; ++it)
-        getPartition(*it, pinList, unassignedPins, onlyGroundDependent);
+        Pin *next = top.pins[top.next++];
+        if (!next || inPartition.contains(next))
+            continue;
 
-    if (!onlyGroundDependent) {
-        PinList circuitDependentPins = pin->circuitDependentPins();
-        const PinList::const_iterator dEnd = circuitDependentPins.end();
-        for (PinList::const_iterator it = circuitDependentPins.begin(); it != dEnd; ++it)
-            getPartition(*it, pinList, unassignedPins, onlyGroundDependent);
+        assignedPins->insert(next);
+        inPartition.insert(next);
+        pinList->append(next);
+        stack.push_back(ConnectedPins(next, !onlyGroundDependent));
     }
 }
 
-void CircuitDocument::splitIntoCircuits(PinList *pinList)
+bool CircuitDocument::splitIntoCircuits(PinList *pinList, CircuitList *circuits, QList<LogicBoundary *> *boundaries)
 {
     // First: identify ground
-    PinList unassignedPins = *pinList;
+    QSet<Pin *> assignedPins;
+    assignedPins.reserve(pinList->size());
     typedef QList<PinList> PinListList;
     PinListList pinListList;
 
-    while (!unassignedPins.isEmpty()) {
+    const PinList::const_iterator pinListEnd = pinList->constEnd();
+    for (PinList::const_iterator it = pinList->constBegin(); it != pinListEnd; ++it) {
+        if (!*it || assignedPins.contains(*it))
+            continue;
+
         PinList tempPinList;
-        getPartition(*unassignedPins.begin(), &tempPinList, &unassignedPins, true);
+        getPartition(*it, &tempPinList, &assignedPins, true);
         pinListList.append(tempPinList);
     }
 
@@ -576,30 +983,35 @@ void CircuitDocument::splitIntoCircuits(PinList *pinList)
     for (PinListList::iterator it = pinListList.begin(); it != nllEnd; ++it)
         Circuit::identifyGround(*it);
 
-    while (!pinList->isEmpty()) {
-        PinList::iterator end = pinList->end();
-        PinList::iterator it = pinList->begin();
+    // Pins that are not ground go into exactly one circuit; ground pins end
+    // the circuits, and go into each of them
+    bool canReuse = true;
+    QSet<Pin *> takenPins;
+    takenPins.reserve(pinList->size());
 
-        while (it != end && (*it)->eqId() == -1)
-            ++it;
+    for (PinList::const_iterator it = pinList->constBegin(); it != pinListEnd; ++it) {
+        if (!*it || (*it)->eqId() == -1 || takenPins.contains(*it))
+            continue;
 
-        if (it == end)
-            break;
-        else {
-            Circuitoid *circuitoid = new Circuitoid;
-            recursivePinAdd(*it, circuitoid, pinList);
+        Circuitoid *circuitoid = new Circuitoid;
+        recursivePinAdd(*it, circuitoid, &takenPins);
 
-            if (!tryAsLogicCircuit(circuitoid))
-                m_circuitList += createCircuit(circuitoid);
+        if (!tryAsLogicCircuit(circuitoid)) {
+            if (createLogicBoundaries(circuitoid, boundaries))
+                canReuse = false;
+            *circuits += createCircuit(circuitoid);
+        } else if (!circuitoid->elementList.isEmpty())
+            canReuse = false;
 
-            delete circuitoid;
-        }
+        delete circuitoid;
     }
 
     // Remaining pins are ground; tell them about it
     // TODO This is a bit hacky....
-    const PinList::iterator end = pinList->end();
-    for (PinList::iterator it = pinList->begin(); it != end; ++it) {
+    for (PinList::const_iterator it = pinList->constBegin(); it != pinListEnd; ++it) {
+        if (!*it || takenPins.contains(*it))
+            continue;
+
         (*it)->setVoltage(0.0);
         ElementList elements = (*it)->elements();
         const ElementList::iterator eEnd = elements.end();
@@ -610,43 +1022,49 @@ void CircuitDocument::splitIntoCircuits(PinList *pinList)
             }
         }
     }
+
+    return canReuse;
 }
 
-void CircuitDocument::recursivePinAdd(Pin *pin, Circuitoid *circuitoid, PinList *unassignedPins)
+void CircuitDocument::recursivePinAdd(Pin *pin, Circuitoid *circuitoid, QSet<Pin *> *takenPins)
 {
-    if (!pin)
-        return;
+    // As with getPartition, this goes through the pins in the order that
+    // recursing would; the elements of a pin are added after the pins
+    // connected to it
+    std::vector<ConnectedPins> stack;
 
-    if (pin->eqId() != -1)
-        unassignedPins->removeAll(pin);
+    auto addPin = [circuitoid, takenPins, &stack](Pin *pin) {
+        if (!pin)
+            return;
 
-    if (circuitoid->contains(pin))
-        return;
+        if (pin->eqId() != -1)
+            takenPins->insert(pin);
 
-    circuitoid->addPin(pin);
+        if (circuitoid->contains(pin))
+            return;
 
-    if (pin->eqId() == -1)
-        return;
+        circuitoid->addPin(pin);
 
-    const PinList localConnectedPins = pin->localConnectedPins();
-    const PinList::const_iterator end = localConnectedPins.end();
-    for (PinList::const_iterator it = localConnectedPins.begin(); it != end; ++it)
-        recursivePinAdd(*it, circuitoid, unassignedPins);
+        if (pin->eqId() != -1)
+            stack.push_back(ConnectedPins(pin, true));
+    };
 
-    const PinList groundDependentPins = pin->groundDependentPins();
-    const PinList::const_iterator gdEnd = groundDependentPins.end();
-    for (PinList::const_iterator it = groundDependentPins.begin(); it != gdEnd; ++it)
-        recursivePinAdd(*it, circuitoid, unassignedPins);
+    addPin(pin);
 
-    const PinList circuitDependentPins = pin->circuitDependentPins();
-    const PinList::const_iterator cdEnd = circuitDependentPins.end();
-    for (PinList::const_iterator it = circuitDependentPins.begin(); it != cdEnd; ++it)
-        recursivePinAdd(*it, circuitoid, unassignedPins);
+    while (!stack.empty()) {
+        ConnectedPins &top = stack.back();
+        if (top.next < top.pins.size()) {
+            addPin(top.pins[top.next++]);
+            continue;
+        }
+
+        const ElementList elements = top.pin->elements();
+        const ElementList::const_iterator eEnd = elements.end();
+        for (ElementList::const_iterator it = elements.begin(); it != eEnd; ++it)
+            circuitoid->addElement(*it);
 
-    const ElementList elements = pin->elements();
-    const ElementList::const_iterator eEnd = elements.end();
-    for (ElementList::const_iterator it = elements.begin(); it != eEnd; ++it)
-        circuitoid->addElement(*it);
+        stack.pop_back();
+    }
 }
 
 bool CircuitDocument::tryAsLogicCircuit(Circuitoid *circuitoid)
@@ -685,9 +1103,10 @@ bool CircuitDocument::tryAsLogicCircuit(Circuitoid *circuitoid)
 
     if (logicOutCount > 1)
         return false;
-    else if (logicOutCount == 1)
+    else if (logicOutCount == 1) {
         Simulator::self()->createLogicChain(out, logicInList, circuitoid->pinList);
-    else {
+        m_pLogicNetlist->addChain(out, logicInList);
+    } else {
         // We have ourselves stranded LogicIns...so lets set them all to low
 
         const PinList::const_iterator pinListEnd = circuitoid->pinList.constEnd();
@@ -696,7 +1115,7 @@ bool CircuitDocument::tryAsLogicCircuit(Circuitoid *circuitoid)
 
         for (ElementList::const_iterator it = circuitoid->elementList.begin(); it != end; ++it) {
             LogicIn *logicIn = static_cast<LogicIn *>(*it);
-            logicIn->setNextLogic(nullptr);
+            logicIn->removeFromLogicChain();
             logicIn->setElementSet(nullptr);
             if (logicIn->isHigh()) {
                 logicIn->setLastState(false);
@@ -708,6 +1127,69 @@ bool CircuitDocument::tryAsLogicCircuit(Circuitoid *circuitoid)
     return true;
 }
 
+bool CircuitDocument::createLogicBoundaries(Circuitoid *circuitoid, QList<LogicBoundary *> *boundaries)
+{
+    std::multimap<int, PinList> eqs;
+    Circuit::groupConnectedPins(circuitoid->pinList, &eqs);
+
+    bool created = false;
+    const std::multimap<int, PinList>::const_iterator eqsEnd = eqs.end();
+    for (std::multimap<int, PinList>::const_iterator eq = eqs.begin(); eq != eqsEnd; ++eq) {
+        const PinList &pins = eq->second;
+
+        bool isGround = false;
+        const PinList::const_iterator pinsEnd = pins.end();
+        for (PinList::const_iterator it = pins.begin(); it != pinsEnd; ++it)
+            isGround |= (*it)->eqId() == -1;
+        if (isGround)
+            continue;
+
+        // The LogicIns on the node with the same thresholds change together
+        QList<LogicInList> logicInLists;
+        for (PinList::const_iterator it = pins.begin(); it != pinsEnd; ++it) {
+            const ElementList elements = (*it)->elements();
+            const ElementList::const_iterator eEnd = elements.end();
+            for (ElementList::const_iterator e = elements.begin(); e != eEnd; ++e) {
+                if ((*e)->type() != Element::Element_LogicIn || !circuitoid->contains(*e))
+                    continue;
+
+                LogicIn *logicIn = static_cast<LogicIn *>(*e);
+                const LogicConfig config = logicIn->logic();
+
+                QList<LogicInList>::iterator list = logicInLists.begin();
+                for (; list != logicInLists.end(); ++list) {
+                    const LogicConfig listConfig = list->first()->logic();
+                    if (listConfig.risingTrigger == config.risingTrigger && listConfig.fallingTrigger == config.fallingTrigger)
+                        break;
+                }
+
+                if (list == logicInLists.end())
+                    logicInLists.append(LogicInList() << logicIn);
+                else
+                    list->append(logicIn);
+            }
+        }
+
+        const QList<LogicInList>::const_iterator listsEnd = logicInLists.constEnd();
+        for (QList<LogicInList>::const_iterator list = logicInLists.constBegin(); list != listsEnd; ++list) {
+            LogicBoundary *boundary = new LogicBoundary(pins.first(), *list);
+
+            const LogicInList::const_iterator listEnd = list->end();
+            for (LogicInList::const_iterator it = list->begin(); it != listEnd; ++it)
+                circuitoid->removeElement(*it);
+            circuitoid->addElement(boundary->sense());
+
+            Simulator::self()->createLogicChain(boundary->driver(), *list, PinList());
+            m_pLogicNetlist->addChain(boundary->driver(), *list);
+
+            boundaries->append(boundary);
+            created = true;
+        }
+    }
+
+    return created;
+}
+
 Circuit *CircuitDocument::createCircuit(Circuitoid *circuitoid)
 {
     if (!circuitoid)
@@ -785,6 +1267,226 @@ bool CircuitDocument::isValidItem(Item *item)
     return (dynamic_cast<Component *>(item) || dynamic_cast<DrawPart *>(item));
 }
 
+/** Magic number ("KTLS") that simulation states start with */
+static const quint32 SIMULATION_STATE_MAGIC = 0x4b544c53;
+static const quint32 SIMULATION_STATE_VERSION = 1;
+
+QByteArray CircuitDocument::saveSimulationState()
+{
+    SimulationLocker locker;
+
+    // The circuits must be those that are being simulated
+    assignPendingCircuits();
+
+    QByteArray state;
+    QDataStream stream(&state, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << SIMULATION_STATE_MAGIC << SIMULATION_STATE_VERSION;
+
+    stream << quint32(m_componentList.size());
+    for (Component *component : qAsConst(m_componentList)) {
+        QByteArray componentState;
+        QDataStream componentStream(&componentState, QIODevice::WriteOnly);
+        componentStream.setVersion(QDataStream::Qt_5_0);
+        component->saveSimulationState(componentStream);
+        stream << component->id() << componentState;
+    }
+
+    stream << quint32(m_circuitList.size());
+    for (Circuit *circuit : qAsConst(m_circuitList))
+        circuit->saveState(stream);
+
+    return state;
+}
+
+bool CircuitDocument::restoreSimulationState(const QByteArray &state)
+{
+    SimulationLocker locker;
+
+    assignPendingCircuits();
+
+    QDataStream stream(state);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic, version, componentCount;
+    stream >> magic >> version >> componentCount;
+    if (magic != SIMULATION_STATE_MAGIC || version != SIMULATION_STATE_VERSION || int(componentCount) != m_componentList.size())
+        return false;
+
+    // Read all the component states before restoring any, so that a circuit
+    // that no longer has the same components is left untouched
+    QHash<QString, QByteArray> componentStates;
+    for (quint32 i = 0; i < componentCount; ++i) {
+        QString id;
+        QByteArray componentState;
+        stream >> id >> componentState;
+        componentStates[id] = componentState;
+    }
+
+    quint32 circuitCount;
+    stream >> circuitCount;
+    if (stream.status() != QDataStream::Ok || int(circuitCount) != m_circuitList.size())
+        return false;
+
+    for (Component *component : qAsConst(m_componentList)) {
+        if (!componentStates.contains(component->id()))
+            return false;
+    }
+
+    // The elements go first, as restoring the circuits passes the solution
+    // on to the pins, which the components then read
+    bool ok = true;
+    for (Component *component : qAsConst(m_componentList)) {
+        QDataStream componentStream(componentStates[component->id()]);
+        componentStream.setVersion(QDataStream::Qt_5_0);
+        if (!component->restoreSimulationState(componentStream))
+            ok = false;
+    }
+
+    for (Circuit *circuit : qAsConst(m_circuitList)) {
+        if (!circuit->restoreState(stream))
+            ok = false;
+    }
+
+    return ok;
+}
+
+void CircuitDocument::saveSimulationCheckpoint()
+{
+    m_simulationCheckpoint = saveSimulationState();
+}
+
+void CircuitDocument::restoreSimulationCheckpoint()
+{
+    if (m_simulationCheckpoint.isEmpty()) {
+        KMessageBox::sorry(activeView(), i18n("No simulation state has been saved yet."));
+        return;
+    }
+
+    if (!restoreSimulationState(m_simulationCheckpoint))
+        KMessageBox::error(activeView(), i18n("The circuit has changed since the simulation state was saved, so the state could not be fully restored."));
+}
+
+void CircuitDocument::setStimulusRecording(bool record)
+{
+    if (record) {
+        delete m_pStimulusRecorder;
+        m_pStimulusRecorder = new StimulusRecorder();
+        return;
+    }
+
+    StimulusRecorder *recorder = m_pStimulusRecorder;
+    m_pStimulusRecorder = nullptr;
+    if (!recorder)
+        return;
+
+    if (recorder->stimulus().isEmpty()) {
+        KMessageBox::sorry(activeView(), i18n("No changes were made to the items while recording."));
+        delete recorder;
+        return;
+    }
+
+    const QString fileName = QFileDialog::getSaveFileName(activeView(), i18n("Save Stimulus"), QString(), i18n("Stimulus Files (*.stimulus);;All Files (*)"));
+    if (!fileName.isEmpty()) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Text) || !recorder->stimulus().save(&file))
+            KMessageBox::sorry(activeView(), i18n("Could not write to '%1'", fileName));
+    }
+    delete recorder;
+}
+
+void CircuitDocument::playStimulusFile()
+{
+    const QString fileName = QFileDialog::getOpenFileName(activeView(), i18n("Play Stimulus"), QString(), i18n("Stimulus Files (*.stimulus);;All Files (*)"));
+    if (fileName.isEmpty())
+        return;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        KMessageBox::sorry(activeView(), i18n("Could not open '%1'", fileName));
+        return;
+    }
+
+    Stimulus stimulus;
+    QString errorMessage;
+    if (!stimulus.load(&file, &errorMessage)) {
+        KMessageBox::sorry(activeView(), i18n("Could not read the stimulus in '%1': %2", fileName, errorMessage));
+        return;
+    }
+
+    playStimulus(stimulus);
+}
+
+void CircuitDocument::playStimulus(const Stimulus &stimulus)
+{
+    delete m_pStimulusPlayer;
+
+    long long startStep;
+    {
+        SimulationLocker locker;
+        startStep = Simulator::self()->stepNumber();
+    }
+
+    StimulusPlayer *player = new StimulusPlayer(this, stimulus, startStep);
+    connect(player, &StimulusPlayer::finished, player, &QObject::deleteLater);
+    m_pStimulusPlayer = player;
+    Simulator::self()->setStimulusPlayer(player);
+}
+
+bool CircuitDocument::isSimulationPaused() const
+{
+    return Simulator::self()->isDocumentPaused(this);
+}
+
+void CircuitDocument::setSimulationPaused(bool paused)
+{
+    if (paused == isSimulationPaused())
+        return;
+
+    Simulator::self()->setDocumentPaused(this, paused);
+    emit simulationSharingChanged();
+}
+
+void CircuitDocument::setSimulationPriority(double priority)
+{
+    if (priority == m_simulationPriority)
+        return;
+
+    m_simulationPriority = priority;
+    updateSimulationShare();
+    emit simulationSharingChanged();
+}
+
+void CircuitDocument::updateSimulationShare()
+{
+    // Documents without views (e.g. when run from the command line) are not
+    // hidden
+    const ViewList views = viewList();
+    bool shown = views.isEmpty();
+    for (const QPointer<View> &view : views) {
+        if (view && view->isVisible())
+            shown = true;
+    }
+
+    double share = m_simulationPriority;
+    if (!shown)
+        share *= KTLConfig::hiddenDocumentSimulationShare() / 100.;
+    Simulator::self()->setDocumentShare(this, share);
+}
+
+bool CircuitDocument::solveDc()
+{
+    SimulationLocker locker;
+
+    bool converged = true;
+    const CircuitList::iterator end = m_circuitList.end();
+    for (CircuitList::iterator it = m_circuitList.begin(); it != end; ++it) {
+        if (!(*it)->solveDc())
+            converged = false;
+    }
+    return converged;
+}
+
 void CircuitDocument::displayEquations()
 {
     qCDebug(KTL_LOG) << "######################################################";
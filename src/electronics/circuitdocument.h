@@ -14,6 +14,14 @@
 #include "circuiticndocument.h"
 #include "pin.h"
 
+#include <QByteArray>
+#include <QHash>
+#include <QPointer>
+#include <QSet>
+#include <QVector>
+
+#include <vector>
+
 class Circuit;
 class Component;
 class Connector;
@@ -21,8 +29,12 @@ class ECNode;
 class Element;
 class CircuitICNDocument;
 class KTechlab;
+class LogicBoundary;
+class LogicNetlist;
 class Pin;
 class QTimer;
+class Stimulus;
+class StimulusPlayer;
 class Switch;
 class Wire;
 
@@ -42,26 +54,60 @@ class Circuitoid
 public:
     bool contains(Pin *node)
     {
-        return pinList.contains(node);
+        return pinSet.contains(node);
     }
     bool contains(Element *ele)
     {
-        return elementList.contains(ele);
+        return elementSet.contains(ele);
     }
 
     void addPin(Pin *node)
     {
-        if (node && !contains(node))
+        if (node && !contains(node)) {
             pinList += node;
+            pinSet.insert(node);
+        }
     }
     void addElement(Element *ele)
     {
-        if (ele && !contains(ele))
+        if (ele && !contains(ele)) {
             elementList += ele;
+            elementSet.insert(ele);
+        }
+    }
+    void removeElement(Element *ele)
+    {
+        if (elementSet.remove(ele))
+            elementList.removeAll(ele);
     }
 
     PinList pinList;
     ElementList elementList;
+
+private:
+    QSet<Pin *> pinSet;
+    QSet<Element *> elementSet;
+};
+
+/**
+The circuits made from one partition of the pins (see
+CircuitDocument::getPartition), kept so that they can be used again while the
+partition does not change.
+*/
+class CircuitPartition
+{
+public:
+    CircuitPartition()
+        : canReuse(false)
+    {
+    }
+    ~CircuitPartition();
+
+    PinList pinList;
+    std::vector<quintptr> key; ///< the pins, and what each is connected to
+    CircuitList circuits;
+    QList<LogicBoundary *> boundaries; ///< deleted after the circuits, as the sensing LogicIns are in them
+    bool canReuse; ///< false when logic chains were made from the pins
 };
 
 /**
@@ -81,12 +127,79 @@ public:
     View *createView(ViewContainer *viewContainer, uint viewAreaId) override;
 
     void calculateConnectorCurrents();
+    /**
+     * @return whether the two pins are in the same partition of the circuits
+     * as they are now, and the partition is simulated as an analog circuit
+     * (rather than as logic chains). Elements can then be put between the
+     * pins, with the partition being the only one that has to be remade.
+     * This is false while the circuits are waiting to be reassigned.
+     */
+    bool inSameAnalogPartition(Pin *a, Pin *b) const;
     /**
      * Count the number of ExternalConnection components in the CNItemList
      */
     int countExtCon(const ItemList &cnItemList) const;
 
     void update() override;
+    void drawOverlay(QPainter &p, const QRect &clip) override;
+    MemoryUsage memoryUsage() const override;
+    /**
+     * As well as what ItemDocument::trimCaches frees, this empties the logic
+     * caches of the circuits.
+     */
+    void trimCaches() override;
+    /**
+     * Sets how hot to draw each component over the circuit, from 0 (not
+     * drawn) to 1, to show where the simulation time goes. An empty map
+     * removes the heat map.
+     * @see SimulatorStatistics::components
+     */
+    void setHeatMap(const QHash<const Component *, double> &heatMap);
+
+    /**
+     * Saves the state of the simulation of the circuit: that of the
+     * elements, of components that keep state of their own (such as PICs)
+     * and the solutions of the circuits. Simulated time and callbacks that
+     * components have scheduled are not part of it.
+     */
+    QByteArray saveSimulationState();
+    /**
+     * Restores a state saved by saveSimulationState.
+     * @return false if the circuit has changed in a way that the state no
+     * longer fits it, in which case none (or only part) of it was restored
+     */
+    bool restoreSimulationState(const QByteArray &state);
+    /**
+     * Replays the stimulus on the circuit, from the next linear step of the
+     * simulator, in place of any that is being replayed already.
+     */
+    void playStimulus(const Stimulus &stimulus);
+    /**
+     * Solves each of the circuits for its DC operating point, starting from
+     * its last solution (see Circuit::solveDc).
+     * @return false if any of them did not converge
+     */
+    bool solveDc();
+    /**
+     * @return whether the simulation of this document is paused, while that
+     * of the others carries on (see Simulator::setDocumentPaused)
+     */
+    bool isSimulationPaused() const;
+    /**
+     * @return the share of the simulation (from 0 to 1) that this document
+     * gets while it is shown
+     */
+    double simulationPriority() const
+    {
+        return m_simulationPriority;
+    }
+    /**
+     * Works out the share of the simulation that this document gets: its
+     * priority, cut down while none of its views are shown (by the
+     * HiddenDocumentSimulationShare setting). Called when its views are
+     * shown or hidden.
+     */
+    void updateSimulationShare();
 
 public slots:
     /**
@@ -102,19 +215,50 @@ public slots:
     void rotateClockwise();
     void flipHorizontally();
     void flipVertically();
+    /**
+     * Keeps the state of the simulation, to go back to with
+     * restoreSimulationCheckpoint.
+     */
+    void saveSimulationCheckpoint();
+    void restoreSimulationCheckpoint();
+    /**
+     * Starts recording the changes the user makes to the items, or stops
+     * and asks where to save what has been recorded.
+     */
+    void setStimulusRecording(bool record);
+    /**
+     * Asks for a stimulus file and replays it.
+     */
+    void playStimulusFile();
+    void setSimulationPaused(bool paused);
+    void setSimulationPriority(double priority);
     /**
      * Enables / disables / selects various actions depending on what is
      * selected or not.
      */
     void slotInitItemActions() override;
     void requestAssignCircuits();
+    /**
+     * If the circuits are waiting to be reassigned (see
+     * requestAssignCircuits), reassigns them straight away, so that those
+     * being simulated are the ones for the components as they are now.
+     */
+    void assignPendingCircuits();
     void componentAdded(Item *item);
     void componentRemoved(Item *item);
     void connectorAddedSlot(Connector *connector);
     void slotUpdateConfiguration() override;
 
+signals:
+    /**
+     * Emitted when the simulation of the document is paused or carried on,
+     * or its priority changed.
+     */
+    void simulationSharingChanged();
+
 protected:
     void itemAdded(Item *item) override;
+    void bulkLoadFinished() override;
     void fillContextMenu(const QPoint &pos) override;
     bool isValidItem(Item *item) override;
     bool isValidItem(const QString &itemId) override;
@@ -130,6 +274,14 @@ private:
      * m_logicCircuits, and return true. Else returns false.
      */
     bool tryAsLogicCircuit(Circuitoid *circuitoid);
+    /**
+     * Puts the LogicIns on each node of the analog circuitoid behind a
+     * LogicBoundary (one for each set of thresholds), so that the circuit
+     * checks one LogicIn per node and the LogicIns join a logic chain.
+     * @param boundaries the boundaries made are added to this
+     * @return whether any boundaries were made
+     */
+    bool createLogicBoundaries(Circuitoid *circuitoid, QList<LogicBoundary *> *boundaries);
     /**
      * Creates a circuit from the circuitoid
      */
@@ -139,34 +291,85 @@ private:
      * @param pin Current node (will be added, then tested for further
      * connections).
      * @param pinList List of nodes in current partition.
-     * @param unassignedPins The pool of all nodes in the CircuitDocument
-     * waiting for assignment.
+     * @param assignedPins The nodes that have been put in a partition so far;
+     * the nodes added to pinList are added to this too.
      * @param onlyGroundDependent if true, then the partition will not use
      * circuit-dependent pins to include new pins while growing the
      * partition.
      */
-    void getPartition(Pin *pin, PinList *pinList, PinList *unassignedPins, bool onlyGroundDependent = false);
+    void getPartition(Pin *pin, PinList *pinList, QSet<Pin *> *assignedPins, bool onlyGroundDependent = false);
     /**
      * Takes the nodeList (generated by getPartition), splits it at ground nodes,
      * and creates circuits from each split.
+     * @param circuits the circuits created are added to this
+     * @param boundaries the LogicBoundarys made for the circuits are added to this
+     * @return false if any logic chains were made from the partition (which
+     * are not kept from one assignCircuits to the next)
+     */
+    bool splitIntoCircuits(PinList *pinList, CircuitList *circuits, QList<LogicBoundary *> *boundaries);
+    /**
+     * Construct a circuit from the given node, stopping at the groundnodes.
+     * The nodes that are not ground are added to takenPins.
+     */
+    void recursivePinAdd(Pin *pin, Circuitoid *circuitoid, QSet<Pin *> *takenPins);
+
+    /**
+     * A step in working out the currents in the wires: the current in a wire
+     * or through a switch, or the current of a ground pin from its wires.
+     */
+    class CurrentStep
+    {
+    public:
+        QPointer<Wire> wire;
+        Switch *sw;
+        QPointer<Pin> pin;
+    };
+    /**
+     * Sets the currents of the pins to those from the components, and marks
+     * the currents of the wires and switches as unknown.
+     * @return the ground pins, whose currents are worked out from their wires
      */
-    void splitIntoCircuits(PinList *pinList);
+    PinList resetConnectorCurrents();
     /**
-     * Construct a circuit from the given node, stopping at the groundnodes
+     * Works out the currents in the wires and switches by going over them
+     * until no more can be worked out, and records the order they were
+     * worked out in as m_currentSteps.
      */
-    void recursivePinAdd(Pin *pin, Circuitoid *circuitoid, PinList *unassignedPins);
+    void findConnectorCurrents(PinList groundPins);
+    /**
+     * Works out the currents in the order recorded by findConnectorCurrents.
+     * @return false if a step could not be worked out (e.g. as a switch
+     * has been closed since), in which case the currents are left half done
+     */
+    bool replayConnectorCurrents();
 
+    /**
+     * Takes the circuits out of the simulator, but keeps them in
+     * m_partitions for assignCircuits to use again.
+     */
+    void detachCircuits();
     void deleteCircuits();
 
     QTimer *m_updateCircuitsTmr;
+    bool m_bAssignCircuitsPending; ///< requested during a bulk load
     CircuitList m_circuitList;
+    QList<CircuitPartition *> m_partitions; ///< those that can be used again
     ComponentList m_toSimulateList;
     ComponentList m_componentList; // List is built up during call to assignCircuits
+    LogicNetlist *m_pLogicNetlist; ///< the logic gates compiled from the logic chains, if any
+    bool m_bLogicNetlistIdeal; ///< whether the gates were compiled with ideal logic
+    QHash<const Component *, double> m_heatMap;
 
     // hmm, we have one of these in circuit too....
     PinList m_pinList;
     WireList m_wireList;
     SwitchList m_switchList;
+    QVector<CurrentStep> m_currentSteps; ///< the order the currents were last worked out in, until the circuits change
+    int m_currentsFrame;         ///< frames since the wire currents were worked out for the animation
+    int m_currentsFrameInterval; ///< frames between working out the wire currents, raised when it takes too long
+    QByteArray m_simulationCheckpoint;
+    QPointer<StimulusPlayer> m_pStimulusPlayer;
+    double m_simulationPriority;
 };
 
 #endif
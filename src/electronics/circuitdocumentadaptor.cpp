@@ -0,0 +1,56 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "circuitdocumentadaptor.h"
+#include "circuitdocument.h"
+#include "documentiface.h"
+
+CircuitDocumentAdaptor::CircuitDocumentAdaptor(CircuitDocument *document, CircuitDocumentIface *iface)
+    : QDBusAbstractAdaptor(document)
+    , m_pIface(iface)
+{
+}
+
+bool CircuitDocumentAdaptor::setComponentProperty(const QString &itemId, const QString &propertyId, const QString &value)
+{
+    return m_pIface->setComponentProperty(itemId, propertyId, value);
+}
+
+double CircuitDocumentAdaptor::runSimulation(double seconds)
+{
+    return m_pIface->runSimulation(seconds);
+}
+
+QString CircuitDocumentAdaptor::probeDataKey()
+{
+    return m_pIface->probeDataKey();
+}
+
+bool CircuitDocumentAdaptor::watchNodeTelemetry(const QString &itemId, const QString &nodeId)
+{
+    return m_pIface->watchNodeTelemetry(itemId, nodeId);
+}
+
+bool CircuitDocumentAdaptor::watchProbeTelemetry(const QString &itemId)
+{
+    return m_pIface->watchProbeTelemetry(itemId);
+}
+
+bool CircuitDocumentAdaptor::unwatchTelemetry(const QString &name)
+{
+    return m_pIface->unwatchTelemetry(name);
+}
+
+QString CircuitDocumentAdaptor::telemetryKey()
+{
+    return m_pIface->telemetryKey();
+}
+
+#include "moc_circuitdocumentadaptor.cpp"
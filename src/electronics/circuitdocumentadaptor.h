@@ -0,0 +1,58 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef CIRCUITDOCUMENTADAPTOR_H
+#define CIRCUITDOCUMENTADAPTOR_H
+
+#include <QDBusAbstractAdaptor>
+
+class CircuitDocument;
+class CircuitDocumentIface;
+
+/**
+Exports the scripting calls of CircuitDocumentIface on the session bus, as
+the interface org.kde.ktechlab.CircuitDocument of the object at
+/Documents/<id> (see Document::setDCOPID). The rest of the DCOP interfaces
+have not been ported yet, so only the calls here can be made from outside.
+@author KTechLab developers
+*/
+class CircuitDocumentAdaptor : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.ktechlab.CircuitDocument")
+
+public:
+    CircuitDocumentAdaptor(CircuitDocument *document, CircuitDocumentIface *iface);
+
+public Q_SLOTS:
+    /// @see CircuitDocumentIface::setComponentProperty
+    bool setComponentProperty(const QString &itemId, const QString &propertyId, const QString &value);
+    /**
+     * @see CircuitDocumentIface::runSimulation
+     * The reply is only sent once the time has been simulated, so callers
+     * asking for long runs need a longer timeout than the default of D-Bus.
+     */
+    double runSimulation(double seconds);
+    /// @see CircuitDocumentIface::probeDataKey
+    QString probeDataKey();
+    /// @see CircuitDocumentIface::watchNodeTelemetry
+    bool watchNodeTelemetry(const QString &itemId, const QString &nodeId);
+    /// @see CircuitDocumentIface::watchProbeTelemetry
+    bool watchProbeTelemetry(const QString &itemId);
+    /// @see CircuitDocumentIface::unwatchTelemetry
+    bool unwatchTelemetry(const QString &name);
+    /// @see CircuitDocumentIface::telemetryKey
+    QString telemetryKey();
+
+private:
+    CircuitDocumentIface *m_pIface;
+};
+
+#endif
@@ -19,6 +19,7 @@
 #include "item.h"
 #include "junctionnode.h"
 #include "nodegroup.h"
+#include "simulator.h"
 
 #include <ktechlab_debug.h>
 
@@ -324,6 +325,8 @@ void CircuitICNDocument::slotAssignNodeGroups()
 
 void CircuitICNDocument::flushDeleteList()
 {
+    SimulationLocker locker;
+
     // Remove duplicate items in the delete list
     KtlQCanvasItemList::iterator end = m_itemDeleteList.end();
     for (KtlQCanvasItemList::iterator it = m_itemDeleteList.begin(); it != end; ++it) {
@@ -341,7 +344,7 @@ void CircuitICNDocument::flushDeleteList()
         m_selectList->removeQCanvasItem(*it);
 
         if (Item *item = dynamic_cast<Item *>(qcanvasItem))
-            m_itemList.remove(item->id());
+            unlistItem(item->id());
         else if (ECNode *node = dynamic_cast<ECNode *>(qcanvasItem))
             m_ecNodeList.remove(node->id());
         else if (Connector *con = dynamic_cast<Connector *>(qcanvasItem))
@@ -384,6 +387,7 @@ bool CircuitICNDocument::registerItem(KtlQCanvasItem *qcanvasItem)
             emit nodeAdded(static_cast<Node *>(node));
         } else if (Connector *connector = dynamic_cast<Connector *>(qcanvasItem)) {
             m_connectorList.append(connector);
+            setHandleItem(connector->id(), connector);
             emit connectorAdded(connector);
         } else {
             qCCritical(KTL_LOG) << "Unrecognised item";
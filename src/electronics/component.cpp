@@ -38,6 +38,9 @@
 #include "voltagesource.h"
 
 #include <QBitArray>
+#include <QDataStream>
+#include <QFontMetrics>
+#include <QHash>
 #include <QPainter>
 #include <QWidget>
 #include <cmath>
@@ -88,18 +91,37 @@ void Component::removeItem()
     CNItem::removeItem();
 }
 
-void Component::removeElements(bool setPinsInterIndependent)
+void Component::saveSimulationState(QDataStream &stream) const
 {
-    const ElementMapList::iterator end = m_elementMapList.end();
-    for (ElementMapList::iterator it = m_elementMapList.begin(); it != end; ++it) {
-        Element *e = (*it).e;
-        if (e) {
-            emit elementDestroyed(e);
-            e->componentDeleted();
-        }
+    stream << quint32(m_elementMapList.size());
+    for (const ElementMap &elementMap : m_elementMapList) {
+        stream << qint32(elementMap.e->type());
+        elementMap.e->saveState(stream);
     }
-    m_elementMapList.clear();
+}
+
+bool Component::restoreSimulationState(QDataStream &stream)
+{
+    quint32 count;
+    stream >> count;
+    if (count != quint32(m_elementMapList.size()))
+        return false;
 
+    for (const ElementMap &elementMap : qAsConst(m_elementMapList)) {
+        qint32 type;
+        stream >> type;
+        if (type != qint32(elementMap.e->type()))
+            return false;
+        elementMap.e->restoreState(stream);
+    }
+
+    return stream.status() == QDataStream::Ok;
+}
+
+void Component::removeElements(bool setPinsInterIndependent)
+{
+    // The switches go first, as they remove the elements they are simulated
+    // with themselves
     const SwitchList::iterator swEnd = m_switchList.end();
     for (SwitchList::iterator it = m_switchList.begin(); it != swEnd; ++it) {
         Switch *sw = *it;
@@ -111,6 +133,16 @@ void Component::removeElements(bool setPinsInterIndependent)
     }
     m_switchList.clear();
 
+    const ElementMapList::iterator end = m_elementMapList.end();
+    for (ElementMapList::iterator it = m_elementMapList.begin(); it != end; ++it) {
+        Element *e = (*it).e;
+        if (e) {
+            emit elementDestroyed(e);
+            e->componentDeleted();
+        }
+    }
+    m_elementMapList.clear();
+
     if (setPinsInterIndependent)
         setAllPinsInterIndependent();
 }
@@ -417,58 +449,70 @@ void Component::initDIP(const QStringList &pins)
     updateAttachedPositioning();
 }
 
-void Component::initDIPSymbol(const QStringList &pins, int _width)
+/**
+ * @return the bounding rectangles of the pin names of a DIP symbol (in the
+ * order of the pins). Measuring the text is the slow part of laying out the
+ * symbol, and the same ICs tend to appear many times, so the rectangles are
+ * kept for each layout.
+ */
+static QVector<QRect> dipTextRects(const QStringList &pins, int width, int offsetX, int offsetY, const QFont &font)
 {
-    const int numPins = pins.size();
-    const int numSide = numPins / 2 + numPins % 2;
+    static QHash<QString, QVector<QRect>> cache;
 
-    setSize(-(_width - (_width % 16)) / 2, -(numSide + 1) * 8, _width, (numSide + 1) * 16, true);
+    const QString key = pins.join('\n') + QString("\t%1,%2,%3\t").arg(width).arg(offsetX).arg(offsetY) + font.toString();
+    QHash<QString, QVector<QRect>>::const_iterator it = cache.constFind(key);
+    if (it != cache.constEnd())
+        return it.value();
 
-    // 2015.01.11 - do not use painter
-    //     QWidget tmpWidget;
-    //     //tmpWidget.setAttribute(Qt::WA_PaintOutsidePaintEvent, true); // note: add this if needed
-    //     //QPainter p(&tmpWidget);
-    //     QPainter p;
-    //     const bool isSuccess = p.begin(&tmpWidget);
-    //     if (!isSuccess) {
-    //         qCWarning(KTL_LOG) << " painter not active";
-    //     }
+    const int numPins = pins.size();
+    const int numSide = numPins / 2 + numPins % 2;
 
     // p.setFont( font() ); // 2015.01.11 - do not use painter
-    QFontMetrics fontMetrics(font());
+    QFontMetrics fontMetrics(font);
+    QVector<QRect> textRects(numPins);
 
     // Pins along left
     for (int i = 0; i < numSide; i++) {
         if (!pins[i].isEmpty()) {
-            const QString text = pins.at(i);
-
-            const int _top = (i + 1) * 16 - 8 + offsetY();
-            const int _width = width() / 2 - 6;
-            const int _left = 6 + offsetX();
+            const int _top = (i + 1) * 16 - 8 + offsetY;
+            const int _width = width / 2 - 6;
+            const int _left = 6 + offsetX;
             const int _height = 16;
 
             // QRect br = p.boundingRect( QRect( _left, _top, _width, _height ), Qt::AlignLeft, text ); // 2015.01.11 - do not use painter
-            QRect br = fontMetrics.boundingRect(QRect(_left, _top, _width, _height), Qt::AlignLeft, text);
-
-            addDisplayText(text, br, text);
+            textRects[i] = fontMetrics.boundingRect(QRect(_left, _top, _width, _height), Qt::AlignLeft, pins[i]);
         }
     }
     // Pins along right
     for (int i = numSide; i < numPins; i++) {
         if (!pins[i].isEmpty()) {
-            const QString text = pins.at(i);
-
-            const int _top = (2 * numSide - i) * 16 - 8 + offsetY();
-            const int _width = width() / 2 - 6;
-            const int _left = (width() / 2) + offsetX();
+            const int _top = (2 * numSide - i) * 16 - 8 + offsetY;
+            const int _width = width / 2 - 6;
+            const int _left = (width / 2) + offsetX;
             const int _height = 16;
 
             // QRect br = p.boundingRect( QRect( _left, _top, _width, _height ), Qt::AlignRight, text ); // 2015.01.11 - do not use painter
-            QRect br = fontMetrics.boundingRect(QRect(_left, _top, _width, _height), Qt::AlignLeft, text);
-            addDisplayText(text, br, text);
+            textRects[i] = fontMetrics.boundingRect(QRect(_left, _top, _width, _height), Qt::AlignLeft, pins[i]);
         }
     }
 
+    cache.insert(key, textRects);
+    return textRects;
+}
+
+void Component::initDIPSymbol(const QStringList &pins, int _width)
+{
+    const int numPins = pins.size();
+    const int numSide = numPins / 2 + numPins % 2;
+
+    setSize(-(_width - (_width % 16)) / 2, -(numSide + 1) * 8, _width, (numSide + 1) * 16, true);
+
+    const QVector<QRect> textRects = dipTextRects(pins, width(), offsetX(), offsetY(), font());
+    for (int i = 0; i < numPins; i++) {
+        if (!pins[i].isEmpty())
+            addDisplayText(pins[i], textRects[i], pins[i]);
+    }
+
     updateAttachedPositioning();
 }
 
@@ -1045,7 +1089,7 @@ void Component::setAllPinsInterIndependent()
     }
 }
 
-void Component::initElements(const uint stage)
+void Component::initElements(const uint stage, const QSet<const ElementSet *> *keptSets)
 {
     /// @todo this function is ugly and messy and needs tidying up
 
@@ -1053,7 +1097,8 @@ void Component::initElements(const uint stage)
 
     if (stage == 1) {
         for (ElementMapList::iterator it = m_elementMapList.begin(); it != end; ++it) {
-            (*it).e->add_initial_dc();
+            if (!keptSets || !keptSets->contains((*it).e->elementSet()))
+                (*it).e->add_initial_dc();
         }
         return;
     }
@@ -15,14 +15,17 @@
 #include "cnitem.h"
 
 #include <QList>
+#include <QSet>
 
 class ICNDocument;
 class CircuitDocument;
 class ECNode;
 class ECSubcircuit;
 class Element;
+class ElementSet;
 class Node;
 class Pin;
+class QDataStream;
 
 class BJT;
 class Capacitance;
@@ -33,6 +36,7 @@ class CurrentSource;
 class Diode;
 class JFET;
 class Inductance;
+class LogicGate;
 class LogicIn;
 class LogicOut;
 class MOSFET;
@@ -130,7 +134,13 @@ public:
     {
         return m_pCircuitDocument;
     }
-    void initElements(const uint stage);
+    /**
+     * Stage 0 gives the elements their cnodes; stage 1 adds their initial
+     * contributions to the matrix.
+     * @param keptSets the element sets that were already set up (whose
+     * elements are left alone in stage 1)
+     */
+    void initElements(const uint stage, const QSet<const ElementSet *> *keptSets = nullptr);
     void finishedCreation() override;
     /**
      * If reinherit (and use) the stepNonLogic function, then you must also
@@ -142,6 +152,60 @@ public:
         return false;
     }
     virtual void stepNonLogic() {};
+    /**
+     * Components that draw something of the state of the simulation (such
+     * as how bright a LED is) reinherit this to copy that state to what
+     * drawShape and contentChanged read. It is called in the GUI thread,
+     * with the simulation locked, once every frame before the document is
+     * updated, so that drawing does not have to lock the simulation.
+     */
+    virtual void publishDisplayState() {};
+    /**
+     * Components that only use stepNonLogic to update what is shown can
+     * reinherit this to be stepped every that many linear steps, rather than
+     * in every one. It is read when the component is attached to the
+     * Simulator.
+     */
+    virtual int nonLogicStepDivider() const
+    {
+        return 1;
+    }
+    /**
+     * Called when the simulation of the document carries on after being
+     * held (see Simulator::setDocumentPaused), with how long it was held for
+     * in TIME_UNITS_PER_SECOND. The callbacks the component had scheduled
+     * have been moved on by as much; components that keep the times they
+     * schedule them from reinherit this to move those on too.
+     */
+    virtual void simulationResumed(long long heldFor)
+    {
+        Q_UNUSED(heldFor);
+    }
+    /**
+     * Combinational logic gates (whose output only depends on the current
+     * state of their inputs) reinherit this to describe themselves, so that
+     * they can be evaluated along with the other gates of the document when
+     * they are entirely connected to logic.
+     * @return true if gate was filled in
+     */
+    virtual bool describeLogicGate(LogicGate *gate) const
+    {
+        Q_UNUSED(gate);
+        return false;
+    }
+    /**
+     * Writes the state of the elements of the component, for saving the
+     * state of the simulation. Components that keep simulation state of
+     * their own (such as a running program) reinherit this and
+     * restoreSimulationState to add it, after calling the base class.
+     */
+    virtual void saveSimulationState(QDataStream &stream) const;
+    /**
+     * Reads back the state written by saveSimulationState.
+     * @return false if the state does not fit the component (e.g. its
+     * elements have changed since)
+     */
+    virtual bool restoreSimulationState(QDataStream &stream);
     /**
      * Returns the translation matrix used for painting et al
      * @param angleDegrees The orientation to use
@@ -248,6 +312,13 @@ public:
     {
         return m_switchList;
     }
+    /**
+     * @return the elements that this component uses, with their pins.
+     */
+    const ElementMapList &elementMapList() const
+    {
+        return m_elementMapList;
+    }
 
 signals:
     /**
@@ -9,16 +9,23 @@
 
 #include "componentmodellibrary.h"
 
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
 #include <QStandardPaths>
-#include <QElapsedTimer>
 
 #include <cassert>
 
 #include <ktechlab_debug.h>
 
-// A prime number slightly larger than the number of models for any particular type
-// const int maxComponentModels = 101;
+/// How many models read from the library files are kept
+static const int maxRecentModels = 64;
+/// Changed whenever the format of the cached index changes
+static const quint32 indexVersion = 1;
 
 // BEGIN class ComponentModel
 ComponentModel::ComponentModel()
@@ -53,6 +60,7 @@ ComponentModelLibrary *ComponentModelLibrary::self()
 }
 
 ComponentModelLibrary::ComponentModelLibrary()
+    : m_recentModels(maxRecentModels)
 {
     loadModels();
 }
@@ -61,6 +69,32 @@ ComponentModelLibrary::~ComponentModelLibrary()
 {
 }
 
+ComponentModel ComponentModelLibrary::model(ModelType modelType, const QString &id)
+{
+    const QString key = QString::number(modelType) + '/' + id;
+    if (ComponentModel *model = m_recentModels.object(key))
+        return *model;
+
+    const ModelLocationHash &locations = m_modelLocations[modelType];
+    ModelLocationHash::const_iterator it = locations.constFind(id);
+    if (it == locations.constEnd()) {
+        qCWarning(KTL_LOG) << "No model with id=\"" << id << "\" for type=" << modelType << ".";
+        return ComponentModel();
+    }
+
+    QFile file(m_modelFiles[it->file]);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(it->offset)) {
+        qCWarning(KTL_LOG) << "Could not read model \"" << id << "\" from \"" << file.fileName() << "\".";
+        return ComponentModel();
+    }
+
+    ComponentModel *model = new ComponentModel;
+    readModel(file, model);
+    const ComponentModel result = *model;
+    m_recentModels.insert(key, model);
+    return result;
+}
+
 void ComponentModelLibrary::loadModels()
 {
     QElapsedTimer ct;
@@ -69,9 +103,7 @@ void ComponentModelLibrary::loadModels()
     QStringList files;
     files << "transistors_lib.txt";
 
-    // Used to check that maxComponentModels isn't too small
-    typedef QMap<ModelType, int> IntMap;
-    IntMap modelCount;
+    const QString indexDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/models/";
 
     QStringList::iterator end = files.end();
     for (QStringList::iterator it = files.begin(); it != end; ++it) {
@@ -81,95 +113,187 @@ void ComponentModelLibrary::loadModels()
             continue;
         }
 
-        QFile file(fileName);
-        if (!file.open(QIODevice::ReadOnly)) {
-            qCWarning(KTL_LOG) << "Could not open library file \"" << fileName << "\" for reading.";
+        const int file = m_modelFiles.size();
+        m_modelFiles << fileName;
+
+        const QString indexFileName = indexDir + *it + ".index";
+        if (readIndex(file, indexFileName))
             continue;
-        }
 
+        if (buildIndex(file))
+            writeIndex(file, indexFileName);
+    }
+
+    qCDebug(KTL_LOG) << "It took " << ct.elapsed() << " milliseconds to read in the index of the component models.";
+}
+
+bool ComponentModelLibrary::readIndex(int file, const QString &indexFileName)
+{
+    QFile indexFile(indexFileName);
+    if (!indexFile.open(QIODevice::ReadOnly))
+        return false;
+
+    const QFileInfo libraryInfo(m_modelFiles[file]);
+
+    QDataStream stream(&indexFile);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint32 version;
+    qint64 size;
+    QDateTime lastModified;
+    stream >> version >> size >> lastModified;
+    if (version != indexVersion || size != libraryInfo.size() || lastModified != libraryInfo.lastModified())
+        return false;
+
+    quint32 count;
+    stream >> count;
+
+    // Read into a separate list first, so that a broken index adds nothing
+    QList<QPair<ModelType, QPair<QString, qint64>>> entries;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        qint32 type;
         QString id;
-        QString typeString;
-        ComponentModel *model = nullptr;
-
-        QTextStream stream(&file);
-        while (!stream.atEnd()) {
-            QString line = stream.readLine();
-
-            if (line.isEmpty())
-                continue;
-
-            if (line == "[/]") {
-                // End of previous model
-
-                assert(model);
-
-                ModelType type = None;
-                if (typeString == "NPN")
-                    type = NPN;
-                else if (typeString == "PNP")
-                    type = PNP;
-                else
-                    qCCritical(KTL_LOG) << "Unknown type \"" << typeString << "\".";
-
-                if (m_componentModelIDs[type].contains(id))
-                    qCCritical(KTL_LOG) << "Already have model with id=\"" << id << "\" for type=\"" << typeString << "\".";
-
-                if (!m_componentModels.contains(type)) {
-                    m_componentModels[type] = ComponentModelDict(/* maxComponentModels */);
-                    // m_componentModels[type].setAutoDelete( true ); // 2018.08.14 - not needed
-                }
-
-                m_componentModels[type].insert(id, *model);
-                m_componentModelIDs[type] << id;
-
-                /* if ( int(modelCount[type] * 1.2) > maxComponentModels )  // 2018.08.14 - not needed
-                {
-                    qCWarning(KTL_LOG) << "There are "<<modelCount[type]<<" models for component type \""<<typeString<<"\". Consider enlarging the dictionary.";
-                } */
-
-                // Reset the model
-                model = nullptr;
-                id = QString();
-                typeString = QString();
-
-                modelCount[type]++;
-            } else if (line.startsWith("[")) {
-                // Already handled the case with "[/]", so must be beginning of
-                // new model
-
-                // Check that their isn't a previous model that hasn't saved
-                assert(!model);
-
-                model = new ComponentModel;
-                id = line.mid(1, line.length() - 2); // extract the text between the square brackets
-            } else {
-                // Setting a property of the model
-                assert(model);
-
-                int pos = line.indexOf('=');
-                assert(pos != -1);
-
-                QString name = line.left(pos);
-                QString value = line.mid(pos + 1);
-
-                if (name == "Description")
-                    model->setDescription(value);
-                else if (name == "Type")
-                    typeString = value;
-                else {
-                    bool ok;
-                    double realValue = value.toDouble(&ok);
-
-                    if (!ok)
-                        qCCritical(KTL_LOG) << "Could not convert \"" << value << "\" to a real number (for property \"" << name << "\".";
-                    else
-                        model->setProperty(name, realValue);
-                }
-            }
+        qint64 offset;
+        stream >> type >> id >> offset;
+        entries << qMakePair(ModelType(type), qMakePair(id, offset));
+    }
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    for (int i = 0; i < entries.size(); ++i)
+        addLocation(entries[i].first, entries[i].second.first, file, entries[i].second.second);
+    return true;
+}
+
+bool ComponentModelLibrary::buildIndex(int file)
+{
+    QFile libraryFile(m_modelFiles[file]);
+    if (!libraryFile.open(QIODevice::ReadOnly)) {
+        qCWarning(KTL_LOG) << "Could not open library file \"" << libraryFile.fileName() << "\" for reading.";
+        return false;
+    }
+
+    // Only the id and type of each model are looked at here
+    QString id;
+    QString typeString;
+    qint64 offset = -1;
+
+    while (!libraryFile.atEnd()) {
+        const QString line = QString::fromUtf8(libraryFile.readLine()).trimmed();
+
+        if (line.isEmpty())
+            continue;
+
+        if (line == "[/]") {
+            // End of previous model
+            assert(offset != -1);
+
+            ModelType type = stringToType(typeString);
+            if (m_modelLocations[type].contains(id))
+                qCCritical(KTL_LOG) << "Already have model with id=\"" << id << "\" for type=\"" << typeString << "\".";
+            else
+                addLocation(type, id, file, offset);
+
+            // Reset the model
+            offset = -1;
+            id = QString();
+            typeString = QString();
+        } else if (line.startsWith("[")) {
+            // Already handled the case with "[/]", so must be beginning of
+            // new model
+
+            // Check that their isn't a previous model that hasn't saved
+            assert(offset == -1);
+
+            id = line.mid(1, line.length() - 2); // extract the text between the square brackets
+            offset = libraryFile.pos();
+        } else if (line.startsWith("Type=")) {
+            typeString = line.mid(5);
         }
     }
+    return true;
+}
+
+void ComponentModelLibrary::writeIndex(int file, const QString &indexFileName) const
+{
+    QDir().mkpath(QFileInfo(indexFileName).absolutePath());
+
+    QSaveFile indexFile(indexFileName);
+    if (!indexFile.open(QIODevice::WriteOnly))
+        return;
+
+    const QFileInfo libraryInfo(m_modelFiles[file]);
+
+    QList<QPair<ModelType, QPair<QString, qint64>>> entries;
+    for (QMap<ModelType, ModelLocationHash>::const_iterator typeIt = m_modelLocations.constBegin(); typeIt != m_modelLocations.constEnd(); ++typeIt) {
+        for (ModelLocationHash::const_iterator it = typeIt->constBegin(); it != typeIt->constEnd(); ++it) {
+            if (it->file == file)
+                entries << qMakePair(typeIt.key(), qMakePair(it.key(), it->offset));
+        }
+    }
+
+    QDataStream stream(&indexFile);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << indexVersion << qint64(libraryInfo.size()) << libraryInfo.lastModified();
+    stream << quint32(entries.size());
+    for (int i = 0; i < entries.size(); ++i)
+        stream << qint32(entries[i].first) << entries[i].second.first << entries[i].second.second;
+
+    if (!indexFile.commit())
+        qCWarning(KTL_LOG) << "Could not write the index of the component models to \"" << indexFileName << "\".";
+}
+
+void ComponentModelLibrary::addLocation(ModelType type, const QString &id, int file, qint64 offset)
+{
+    m_modelLocations[type].insert(id, {file, offset});
+    m_componentModelIDs[type] << id;
+}
+
+void ComponentModelLibrary::readModel(QFile &file, ComponentModel *model)
+{
+    while (!file.atEnd()) {
+        const QString line = QString::fromUtf8(file.readLine()).trimmed();
+
+        if (line.isEmpty())
+            continue;
+
+        if (line == "[/]")
+            return;
+
+        // Setting a property of the model
+        int pos = line.indexOf('=');
+        if (pos == -1) {
+            qCCritical(KTL_LOG) << "Could not read line \"" << line << "\" of a model.";
+            continue;
+        }
+
+        QString name = line.left(pos);
+        QString value = line.mid(pos + 1);
+
+        if (name == "Description")
+            model->setDescription(value);
+        else if (name == "Type")
+            continue;
+        else {
+            bool ok;
+            double realValue = value.toDouble(&ok);
+
+            if (!ok)
+                qCCritical(KTL_LOG) << "Could not convert \"" << value << "\" to a real number (for property \"" << name << "\".";
+            else
+                model->setProperty(name, realValue);
+        }
+    }
+}
+
+ComponentModelLibrary::ModelType ComponentModelLibrary::stringToType(const QString &typeString)
+{
+    if (typeString == "NPN")
+        return NPN;
+    if (typeString == "PNP")
+        return PNP;
 
-    qCDebug(KTL_LOG) << "It took " << ct.elapsed() << " milliseconds to read in the component models.";
+    qCCritical(KTL_LOG) << "Unknown type \"" << typeString << "\".";
+    return None;
 }
 // END class ComponentModelLibrary
 
@@ -10,10 +10,14 @@
 #ifndef COMPONENTMODELLIBRARY_H
 #define COMPONENTMODELLIBRARY_H
 
+#include <QCache>
+#include <QHash>
 #include <QMap>
 #include <QObject>
 #include <QStringList>
 
+class QFile;
+
 typedef QMap<QString, double> DoubleMap;
 
 class ComponentModel
@@ -52,9 +56,13 @@ protected:
     DoubleMap m_property;
 };
 
-typedef QMultiHash<QString, ComponentModel> ComponentModelDict;
-
 /**
+Only an index of the models (where each starts in its library file) is read
+when the library is created; the models themselves are read from the file
+when first asked for, and the most recently used ones are kept. The index of
+each library file is cached on disk, and read again from the library file
+when that changes.
+
 @author David Saxton <david@bluehaze.org>
 */
 class ComponentModelLibrary : public QObject
@@ -62,7 +70,6 @@ class ComponentModelLibrary : public QObject
     Q_OBJECT
 public:
     enum ModelType { None, NPN, PNP };
-    typedef QMap<ModelType, ComponentModelDict> ComponentModelDictMap;
     typedef QMap<ModelType, QStringList> ModelStringListMap;
 
     /**
@@ -73,18 +80,58 @@ public:
     {
         return m_componentModelIDs[modelType];
     }
+    /**
+     * @return the model with the given @p id, reading it from its library
+     * file if it is not among those read recently. If there is no such
+     * model, then one with no properties (all 0.0) is returned.
+     */
+    ComponentModel model(ModelType modelType, const QString &id);
 
     static ComponentModelLibrary *self();
     ~ComponentModelLibrary() override;
 
 protected:
     /**
-     * Reads in the component models from disk.
+     * Where a model is in the library files.
+     */
+    class ModelLocation
+    {
+    public:
+        int file;      ///< Index into m_modelFiles
+        qint64 offset; ///< Of the line after the one with the id
+    };
+    typedef QHash<QString, ModelLocation> ModelLocationHash;
+
+    /**
+     * Reads in the index of the component models, from the cache or else
+     * from the library files.
      */
     void loadModels();
+    /**
+     * Reads the index of the library file from the cache.
+     * @return false if there is no index, or it is out of date
+     */
+    bool readIndex(int file, const QString &indexFileName);
+    /**
+     * Reads the index from the library file itself.
+     */
+    bool buildIndex(int file);
+    void writeIndex(int file, const QString &indexFileName) const;
+    /**
+     * Adds the model to the index.
+     */
+    void addLocation(ModelType type, const QString &id, int file, qint64 offset);
+    /**
+     * Reads the properties of a model from the file, from the current
+     * position up to the end of the model.
+     */
+    static void readModel(QFile &file, ComponentModel *model);
+    static ModelType stringToType(const QString &typeString);
 
-    ComponentModelDictMap m_componentModels;
+    QStringList m_modelFiles;
+    QMap<ModelType, ModelLocationHash> m_modelLocations;
     ModelStringListMap m_componentModelIDs;
+    QCache<QString, ComponentModel> m_recentModels;
 
 private:
     ComponentModelLibrary();
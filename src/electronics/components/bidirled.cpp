@@ -33,7 +33,6 @@ BiDirLED::BiDirLED(ICNDocument *icnDocument, bool newItem, const char *id)
     : Component(icnDocument, newItem, id ? id : "bidir_led")
 {
     m_name = i18n("Bidirectional LED");
-    m_bDynamicContent = true;
 
     setSize(-8, -16, 16, 32);
     init1PinLeft();
@@ -46,6 +45,7 @@ BiDirLED::BiDirLED(ICNDocument *icnDocument, bool newItem, const char *id)
     avg_brightness[0] = avg_brightness[1] = 255;
     lastUpdatePeriod = 1.;
     r[0] = r[1] = g[0] = g[1] = b[0] = b[1] = 0;
+    m_displayBrightness[0] = m_displayBrightness[1] = 255;
     last_brightness[0] = last_brightness[1] = 255;
 
     createProperty("0-color1", Variant::Type::Color);
@@ -80,20 +80,33 @@ void BiDirLED::stepNonLogic()
         avg_brightness[i] += LED::brightness(m_pDiode[i]->current()) * LINEAR_UPDATE_PERIOD;
 }
 
+void BiDirLED::publishDisplayState()
+{
+    if (lastUpdatePeriod == 0.)
+        return;
+
+    for (unsigned i = 0; i < 2; i++) {
+        m_displayBrightness[i] = uint(avg_brightness[i] / lastUpdatePeriod);
+        avg_brightness[i] = 0.;
+    }
+    lastUpdatePeriod = 0.;
+}
+
+bool BiDirLED::contentChanged() const
+{
+    for (unsigned i = 0; i < 2; i++) {
+        if (m_displayBrightness[i] != last_brightness[i])
+            return true;
+    }
+    return false;
+}
+
 void BiDirLED::drawShape(QPainter &p)
 {
     initPainter(p);
 
     for (unsigned i = 0; i < 2; i++) {
-        uint _b;
-        if (lastUpdatePeriod == 0.)
-            _b = last_brightness[i];
-
-        else {
-            _b = uint(avg_brightness[i] / lastUpdatePeriod);
-            last_brightness[i] = _b;
-        }
-        avg_brightness[i] = 0.;
+        const uint _b = last_brightness[i] = m_displayBrightness[i];
 
         p.setBrush(QColor(uint(255 - (255 - _b) * (1 - r[i])), uint(255 - (255 - _b) * (1 - g[i])), uint(255 - (255 - _b) * (1 - b[i]))));
 
@@ -112,7 +125,6 @@ void BiDirLED::drawShape(QPainter &p)
         p.drawPolygon(pa);
         p.drawPolyline(pa);
     }
-    lastUpdatePeriod = 0.;
 
     // Draw the arrows indicating it's a LED
     int _x = int(x()) - 2;
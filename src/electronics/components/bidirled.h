@@ -31,6 +31,12 @@ public:
     {
         return true;
     }
+    /**
+     * Only true when either half is now a different brightness to that last
+     * drawn.
+     */
+    bool contentChanged() const override;
+    void publishDisplayState() override;
 
 private:
     void drawShape(QPainter &p) override;
@@ -40,6 +46,7 @@ private:
     double b[2];
 
     double avg_brightness[2];
+    uint m_displayBrightness[2]; // As published for drawing
     uint last_brightness[2];
     double lastUpdatePeriod;
     Diode *m_pDiode[2];
@@ -30,6 +30,7 @@ Capacitor::Capacitor(ICNDocument *icnDocument, bool newItem, const char *id)
     : Component(icnDocument, newItem, id ? id : "capacitor")
 {
     m_name = i18n("Capacitor");
+    m_bCacheBody = true;
     setSize(-8, -8, 16, 16);
 
     init1PinLeft();
@@ -37,7 +38,7 @@ Capacitor::Capacitor(ICNDocument *icnDocument, bool newItem, const char *id)
 
     m_capacitance = createCapacitance(m_pNNode[0], m_pPNode[0], 0.001);
 
-    createProperty("Capacitance", Variant::Type::Double);
+    m_pCapacitanceProperty = createProperty("Capacitance", Variant::Type::Double);
     property("Capacitance")->setCaption(i18n("Capacitance"));
     property("Capacitance")->setUnit("F");
     property("Capacitance")->setMinValue(1e-12);
@@ -53,7 +54,7 @@ Capacitor::~Capacitor()
 
 void Capacitor::dataChanged()
 {
-    double capacitance = dataDouble("Capacitance");
+    double capacitance = m_pCapacitanceProperty->doubleValue();
 
     QString display = QString::number(capacitance / getMultiplier(capacitance), 'g', 3) + getNumberMag(capacitance) + "F";
     setDisplayText("capacitance", display);
@@ -35,6 +35,7 @@ private:
     void drawShape(QPainter &p) override;
 
     Capacitance *m_capacitance;
+    Property *m_pCapacitanceProperty;
 };
 
 #endif
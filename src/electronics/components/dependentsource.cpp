@@ -133,6 +133,7 @@ ECCCCS::ECCCCS(ICNDocument *icnDocument, bool newItem, const char *id)
     : DependentSource(icnDocument, newItem, id ? id : "cccs")
 {
     m_name = i18n("Current Controlled Current Source");
+    m_bCacheBody = true;
     m_cccs = createCCCS(m_pNNode[0], m_pPNode[0], m_pNNode[1], m_pPNode[1], 1.);
     m_pNNode[1]->pin()->setGroundType(Pin::gt_medium);
 }
@@ -176,6 +177,7 @@ ECCCVS::ECCCVS(ICNDocument *icnDocument, bool newItem, const char *id)
     : DependentSource(icnDocument, newItem, id ? id : "ccvs")
 {
     m_name = i18n("Current Controlled Voltage Source");
+    m_bCacheBody = true;
     m_ccvs = createCCVS(m_pNNode[0], m_pPNode[0], m_pNNode[1], m_pPNode[1], 1.);
     m_pNNode[1]->pin()->setGroundType(Pin::gt_medium);
 }
@@ -218,6 +220,7 @@ ECVCCS::ECVCCS(ICNDocument *icnDocument, bool newItem, const char *id)
     : DependentSource(icnDocument, newItem, id ? id : "vccs")
 {
     m_name = i18n("Voltage Controlled Current Source");
+    m_bCacheBody = true;
     m_vccs = createVCCS(m_pNNode[0], m_pPNode[0], m_pNNode[1], m_pPNode[1], 1.);
     m_pNNode[1]->pin()->setGroundType(Pin::gt_medium);
 }
@@ -260,6 +263,7 @@ ECVCVS::ECVCVS(ICNDocument *icnDocument, bool newItem, const char *id)
     : DependentSource(icnDocument, newItem, id ? id : "vcvs")
 {
     m_name = i18n("Voltage Controlled Voltage Source");
+    m_bCacheBody = true;
     m_vcvs = createVCVS(m_pNNode[0], m_pPNode[0], m_pNNode[1], m_pPNode[1], 1.);
     m_pNNode[1]->pin()->setGroundType(Pin::gt_medium);
 }
@@ -13,6 +13,7 @@
 #include "ecnode.h"
 #include "libraryitem.h"
 #include "logic.h"
+#include "logicnetlist.h"
 #include "simulator.h"
 
 #include <KLocalizedString>
@@ -52,12 +53,34 @@ Inverter::Inverter(ICNDocument *icnDocument, bool newItem, const char *id)
     //m_pIn->setCallback(this, (CallbackPtr)(&Inverter::inStateChanged));
     m_pIn->setCallback2(Inverter_inStateChanged, this);
     inStateChanged(false);
+
+    createProperty("delay", Variant::Type::Double);
+    property("delay")->setUnit("S");
+    property("delay")->setCaption(i18n("Propagation Delay"));
+    property("delay")->setMinValue(0.);
+    property("delay")->setMaxValue(double(LOGIC_WHEEL_SIZE - 1) / LOGIC_UPDATE_RATE);
+    property("delay")->setValue(1. / LOGIC_UPDATE_RATE);
+    property("delay")->setAdvanced(true);
 }
 
 Inverter::~Inverter()
 {
 }
 
+bool Inverter::describeLogicGate(LogicGate *gate) const
+{
+    gate->operation = LogicGate::Or;
+    gate->inverted = true;
+    gate->inputs.assign(1, m_pIn);
+    gate->output = m_pOut;
+    return true;
+}
+
+void Inverter::dataChanged()
+{
+    m_pOut->setPropagationDelay(qRound(dataDouble("delay") * LOGIC_UPDATE_RATE));
+}
+
 void Inverter::inStateChanged(bool newState)
 {
     m_pOut->setHigh(!newState);
@@ -110,12 +133,34 @@ Buffer::Buffer(ICNDocument *icnDocument, bool newItem, const char *id)
     //m_pIn->setCallback(this, (CallbackPtr)(&Buffer::inStateChanged));
     m_pIn->setCallback2(Buffer_inStateChanged, this);
     inStateChanged(false);
+
+    createProperty("delay", Variant::Type::Double);
+    property("delay")->setUnit("S");
+    property("delay")->setCaption(i18n("Propagation Delay"));
+    property("delay")->setMinValue(0.);
+    property("delay")->setMaxValue(double(LOGIC_WHEEL_SIZE - 1) / LOGIC_UPDATE_RATE);
+    property("delay")->setValue(1. / LOGIC_UPDATE_RATE);
+    property("delay")->setAdvanced(true);
 }
 
 Buffer::~Buffer()
 {
 }
 
+bool Buffer::describeLogicGate(LogicGate *gate) const
+{
+    gate->operation = LogicGate::Or;
+    gate->inverted = false;
+    gate->inputs.assign(1, m_pIn);
+    gate->output = m_pOut;
+    return true;
+}
+
+void Buffer::dataChanged()
+{
+    m_pOut->setPropagationDelay(qRound(dataDouble("delay") * LOGIC_UPDATE_RATE));
+}
+
 void Buffer::inStateChanged(bool newState)
 {
     m_pOut->setHigh(newState);
@@ -250,10 +295,12 @@ void ECLogicOutput::inStateChanged(bool newState)
     }
 }
 
-void ECLogicOutput::drawShape(QPainter &p)
+void ECLogicOutput::publishDisplayState()
 {
     unsigned long long newTime = m_pSimulator->time();
     unsigned long long runTime = newTime - m_lastDrawTime;
+    if (runTime == 0)
+        return;
     m_lastDrawTime = newTime;
 
     if (m_bLastState) {
@@ -261,20 +308,19 @@ void ECLogicOutput::drawShape(QPainter &p)
         m_highTime += newTime - m_lastSwitchTime;
     }
 
-    double state;
+    m_lastDrawState = double(m_highTime) / double(runTime);
 
-    if (runTime == 0)
-        state = m_lastDrawState;
+    m_lastSwitchTime = newTime;
+    m_highTime = 0;
+}
 
-    else
-        state = m_lastDrawState = double(m_highTime) / double(runTime);
+void ECLogicOutput::drawShape(QPainter &p)
+{
+    const double state = m_lastDrawState;
 
     initPainter(p);
     p.setBrush(QColor(255, uint(255 - state * (255 - 166)), uint((1 - state) * 255)));
     p.drawEllipse(int(x() - 8), int(y() - 8), width(), height());
     deinitPainter(p);
-
-    m_lastSwitchTime = newTime;
-    m_highTime = 0;
 }
 // END class ECLogicOutput
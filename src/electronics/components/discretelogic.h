@@ -26,12 +26,15 @@ public:
     Inverter(ICNDocument *icnDocument, bool newItem, const char *id = nullptr);
     ~Inverter() override;
 
+    bool describeLogicGate(LogicGate *gate) const override;
+
     static Item *construct(ItemDocument *itemDocument, bool newItem, const char *id);
     static LibraryItem *libraryItem();
 
 public: // internal interface
     void inStateChanged(bool newState);
 protected:
+    void dataChanged() override;
     void drawShape(QPainter &p) override;
 
     LogicIn *m_pIn;
@@ -48,12 +51,15 @@ public:
     Buffer(ICNDocument *icnDocument, bool newItem, const char *id = nullptr);
     ~Buffer() override;
 
+    bool describeLogicGate(LogicGate *gate) const override;
+
     static Item *construct(ItemDocument *itemDocument, bool newItem, const char *id);
     static LibraryItem *libraryItem();
 
 public: // internal interface
     void inStateChanged(bool newState);
 private:
+    void dataChanged() override;
     void drawShape(QPainter &p) override;
 
     LogicIn *m_pIn;
@@ -96,6 +102,12 @@ public:
     static Item *construct(ItemDocument *itemDocument, bool newItem, const char *id);
     static LibraryItem *libraryItem();
 
+    /**
+     * Takes the share of the time since the last frame that the input was
+     * high for drawing.
+     */
+    void publishDisplayState() override;
+
 public: // internal interface
     void inStateChanged(bool newState);
 protected:
@@ -106,7 +118,7 @@ protected:
     unsigned long long m_highTime;
     bool m_bLastState;
 
-    double m_lastDrawState;
+    double m_lastDrawState; // As published for drawing
     LogicIn *m_pIn;
     Simulator *m_pSimulator;
 };
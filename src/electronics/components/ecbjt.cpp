@@ -45,6 +45,7 @@ ECBJT::ECBJT(bool isNPN, ICNDocument *icnDocument, bool newItem, const char *id)
     else
         m_name = i18n("PNP Transistor");
 
+    m_bCacheBody = true;
     setSize(-8, -8, 16, 16);
     m_pBJT = createBJT(createPin(8, -16, 90, "c"), createPin(-16, 0, 0, "b"), createPin(8, 16, 270, "e"), m_bIsNPN);
 
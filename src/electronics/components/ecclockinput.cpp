@@ -17,18 +17,17 @@
 #include <KLocalizedString>
 #include <QPainter>
 
+#include <algorithm>
 #include <cmath>
 
-#include <ktechlab_debug.h>
-
 using namespace std;
 
 // was a constant, this is my guess for an appropriate name.
 //#define TIME_INTERVAL 100 // 2015.09.27 - added proper constant to simulator class
 
-static inline uint roundDouble(const double x)
+static inline long long roundDouble(const double x)
 {
-    return uint(std::floor(x + 0.5));
+    return (long long)std::floor(x + 0.5);
 }
 
 Item *ECClockInput::construct(ItemDocument *itemDocument, bool newItem, const char *id)
@@ -47,19 +46,12 @@ ECClockInput::ECClockInput(ICNDocument *icnDocument, bool newItem, const char *i
     m_name = i18n("Clock Input");
     setSize(-16, -8, 32, 16);
 
-    m_lastSetTime = 0;
-    m_time = 0;
     m_high_time = 0;
     m_low_time = 0;
-    m_period = 0;
-    m_bSetStepCallbacks = true;
+    m_nextTransition = 0;
+    m_bHigh = false;
     m_pSimulator = Simulator::self();
-
-    for (unsigned i = 0; i < LOGIC_UPDATE_PER_STEP; i++) {
-        ComponentCallback *ccb = new ComponentCallback(this, static_cast<VoidCallbackPtr>(&ECClockInput::stepCallback));
-        m_pComponentCallback[i] = new list<ComponentCallback>;
-        m_pComponentCallback[i]->push_back(*ccb);
-    }
+    m_pTransitionCallback = new ComponentCallback(this, static_cast<VoidCallbackPtr>(&ECClockInput::stepTransition));
 
     init1PinRight();
     m_pOut = createLogicOut(m_pPNode[0], false);
@@ -81,88 +73,45 @@ ECClockInput::ECClockInput(ICNDocument *icnDocument, bool newItem, const char *i
 
 ECClockInput::~ECClockInput()
 {
-    for (unsigned i = 0; i < LOGIC_UPDATE_PER_STEP; i++)
-        delete m_pComponentCallback[i];
+    if (!Simulator::isDestroyedSim())
+        m_pSimulator->detachComponentCallbacks(*this);
+    delete m_pTransitionCallback;
 }
 
 void ECClockInput::dataChanged()
 {
-    m_high_time = roundDouble(dataDouble("high-time") * LOGIC_UPDATE_RATE);
-    m_low_time = roundDouble(dataDouble("low-time") * LOGIC_UPDATE_RATE);
-    m_period = m_low_time + m_high_time;
+    // A time shorter than a logic update would have the clock scheduled
+    // again in the logic update it was called in, forever
+    m_high_time = std::max(roundDouble(dataDouble("high-time") * TIME_UNITS_PER_SECOND), TIME_UNITS_PER_LOGIC_UPDATE);
+    m_low_time = std::max(roundDouble(dataDouble("low-time") * TIME_UNITS_PER_SECOND), TIME_UNITS_PER_LOGIC_UPDATE);
 
     const double frequency = 1. / (dataDouble("high-time") + dataDouble("low-time"));
     QString display = QString::number(frequency / getMultiplier(frequency), 'g', 3) + getNumberMag(frequency) + "Hz";
     setDisplayText("freq", display);
 
-    bool setStepCallbacks = m_period > LOGIC_UPDATE_PER_STEP;
-    if (setStepCallbacks != m_bSetStepCallbacks) {
-        m_bSetStepCallbacks = setStepCallbacks;
-        if (setStepCallbacks) {
-            m_pSimulator->detachComponentCallbacks(*this);
-        } else {
-            m_pSimulator->attachComponentCallback(this, static_cast<VoidCallbackPtr>(&ECClockInput::stepLogic));
-        }
-    }
-
-    m_bLastStepCallbackOut = false;
-    m_lastSetTime = m_pSimulator->time();
-    if (m_lastSetTime < 0) {
-        qCWarning(KTL_LOG) << " m_lastSetTime = " << m_lastSetTime;
-    }
-}
+    // Start again with a full low time
+    SimulationLocker locker(m_pSimulator);
+    m_pSimulator->detachComponentCallbacks(*this);
 
-void ECClockInput::stepLogic()
-{
-    m_pOut->setHigh(m_time > m_low_time);
+    m_bHigh = false;
+    m_pOut->setHigh(false);
 
-    ++m_time;
-    if (m_time > m_period) {
-        m_time -= int(m_time / m_period) * m_period;
-    }
+    m_nextTransition = m_pSimulator->fineTime() + m_low_time;
+    m_pSimulator->scheduleEdge(m_nextTransition, m_pTransitionCallback);
 }
 
-void ECClockInput::stepCallback()
+void ECClockInput::stepTransition()
 {
-    m_pOut->setHigh(m_bLastStepCallbackOut);
-    m_bLastStepCallbackOut = !m_bLastStepCallbackOut;
+    m_bHigh = !m_bHigh;
+    m_pOut->setHigh(m_bHigh);
+
+    m_nextTransition += m_bHigh ? m_high_time : m_low_time;
+    m_pSimulator->scheduleEdge(m_nextTransition, m_pTransitionCallback);
 }
 
-void ECClockInput::stepNonLogic()
+void ECClockInput::simulationResumed(long long heldFor)
 {
-    if (!m_bSetStepCallbacks) {
-        return;
-    }
-
-    bool addingHigh = !m_bLastStepCallbackOut;
-
-    //     { // for testing
-    //         const long long remainingLogicSteps = m_pSimulator->time() % LOGIC_UPDATE_PER_STEP;
-    //         if (remainingLogicSteps != 0) {
-    //             qCWarning(KTL_LOG) << "remainingLogicSteps should be 0, but got " << remainingLogicSteps;
-    //         }
-    //     }
-
-    // TODO review this method
-
-    long long lowerTime = m_pSimulator->time();
-    long long upperTime = lowerTime + LOGIC_UPDATE_PER_STEP;
-
-    long long upTo = m_lastSetTime;
-
-    while (upTo + (addingHigh ? m_high_time : m_low_time) < upperTime) {
-        upTo += addingHigh ? m_high_time : m_low_time;
-        addingHigh = !addingHigh;
-
-        long long at = upTo - lowerTime;
-        if (at >= 0 && at < LOGIC_UPDATE_PER_STEP)
-            m_pSimulator->addStepCallback(at, &m_pComponentCallback[at]->front());
-    }
-
-    m_lastSetTime = upTo;
-    if (m_lastSetTime < 0) {
-        qCWarning(KTL_LOG) << " m_lastSetTime = " << m_lastSetTime;
-    }
+    m_nextTransition += heldFor;
 }
 
 void ECClockInput::drawShape(QPainter &p)
@@ -11,15 +11,11 @@
 #ifndef ECCLOCKINPUT_H
 #define ECCLOCKINPUT_H
 
-#include <list>
-
 #include "component.h"
 
 class ComponentCallback;
 class Simulator;
 
-template<typename T> class LinkedList;
-
 /**
 @short Boolean clock input
 @author David Saxton
@@ -33,37 +29,26 @@ public:
     static Item *construct(ItemDocument *itemDocument, bool newItem, const char *id);
     static LibraryItem *libraryItem();
 
-    /** callback for logic steps, for each logic update step;
-     only active when the period of the clock is less or equal than LOGIC_UPDATE_PER_STEP */
-    void stepCallback();
-    /** callback for linear steps, for each linear update step;
-     only active when the period of the clock is greater than LOGIC_UPDATE_PER_STEP */
-    void stepLogic();
-    /** callback at linear steps; always active */
-    void stepNonLogic() override;
-    bool doesStepNonLogic() const override
-    {
-        return true;
-    }
+    /** callback at each transition of the output, which schedules the next
+     one; the clock is not called by the simulator in between */
+    void stepTransition();
+    void simulationResumed(long long heldFor) override;
 
 protected:
     void drawShape(QPainter &p) override;
     void dataChanged() override;
 
-    uint m_time;
-    /** unit: simulator logic update tick == 1s / LOGIC_UPDATE_RATE */
-    uint m_high_time;
-    /** unit: simulator logic update tick == 1s / LOGIC_UPDATE_RATE */
-    uint m_low_time;
-    /** unit: simulator logic update tick == 1s / LOGIC_UPDATE_RATE */
-    uint m_period;
-    /** unit: simulator logic update tick == 1s / LOGIC_UPDATE_RATE */
-    long long m_lastSetTime;
+    /** unit: simulator fine time == 1s / TIME_UNITS_PER_SECOND */
+    long long m_high_time;
+    /** unit: simulator fine time == 1s / TIME_UNITS_PER_SECOND */
+    long long m_low_time;
+    /** unit: simulator fine time == 1s / TIME_UNITS_PER_SECOND; the
+     transition happens in the logic update that starts at or after it */
+    long long m_nextTransition;
     LogicOut *m_pOut;
-    bool m_bSetStepCallbacks;
-    bool m_bLastStepCallbackOut;
+    bool m_bHigh;
     Simulator *m_pSimulator;
-    std::list<ComponentCallback> *m_pComponentCallback[100 /* == LOGIC_UPDATE_PER_STEP */];
+    ComponentCallback *m_pTransitionCallback;
 };
 
 #endif
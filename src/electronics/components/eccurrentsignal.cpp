@@ -11,6 +11,8 @@
 #include "eccurrentsignal.h"
 #include "currentsignal.h"
 #include "ecnode.h"
+#include "filefilters.h"
+#include "itemdocument.h"
 #include "libraryitem.h"
 #include "pin.h"
 #include "simulator.h"
@@ -41,6 +43,25 @@ ECCurrentSignal::ECCurrentSignal(ICNDocument *icnDocument, bool newItem, const c
     m_currentSignal = createCurrentSignal(m_pNNode[0], m_pPNode[0], 0.);
     m_currentSignal->setStep(ElementSignal::st_sinusoidal, 50.);
 
+    createProperty("0-waveform", Variant::Type::Select);
+    property("0-waveform")->setCaption(i18n("Waveform"));
+    QStringMap waveforms;
+    waveforms["sine"] = i18n("Sine");
+    waveforms["square"] = i18n("Square");
+    waveforms["sawtooth"] = i18n("Sawtooth");
+    waveforms["triangle"] = i18n("Triangle");
+    waveforms["waveform"] = i18n("From File");
+    property("0-waveform")->setAllowed(waveforms);
+    property("0-waveform")->setValue("sine");
+
+    createProperty("0-waveformFile", Variant::Type::FileName);
+    property("0-waveformFile")->setCaption(i18n("Waveform File"));
+    property("0-waveformFile")->setFileFilters({
+        {i18n("Waveform Files") + QLatin1String(" (*.csv *.pwl *.txt *.vcd)"), QStringLiteral("*.csv *.pwl *.txt *.vcd")},
+        {i18n("All Files"), QStringLiteral("*")},
+    });
+    property("0-waveformFile")->setValue("");
+
     createProperty("1-frequency", Variant::Type::Double);
     property("1-frequency")->setCaption(i18n("Frequency"));
     property("1-frequency")->setUnit("Hz");
@@ -67,11 +88,22 @@ void ECCurrentSignal::dataChanged()
 {
     const double current = dataDouble("1-current");
     const double frequency = dataDouble("1-frequency");
+    const ElementSignal::Type type = ElementSignal::typeFromName(dataString("0-waveform"));
+
+    if (type == ElementSignal::st_waveform) {
+        // The currents are read from the file as they are
+        const QString fileName = dataString("0-waveformFile");
+        if (!m_currentSignal->setWaveform(fileName) && !fileName.isEmpty())
+            p_itemDocument->canvas()->setMessage(i18n("Could not read %1", fileName));
+        setDisplayText("current", "");
+        m_currentSignal->setCurrent(1.);
+        return;
+    }
 
     QString display = QString::number(current / getMultiplier(current), 'g', 3) + getNumberMag(current) + "A";
     setDisplayText("current", display);
 
-    m_currentSignal->setStep(ElementSignal::st_sinusoidal, frequency);
+    m_currentSignal->setStep(type, frequency);
     m_currentSignal->setCurrent(current);
 }
 
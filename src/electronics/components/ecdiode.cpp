@@ -30,6 +30,7 @@ ECDiode::ECDiode(ICNDocument *icnDocument, bool newItem, const char *id)
     : Component(icnDocument, newItem, id ? id : "diode")
 {
     m_name = i18n("Diode");
+    m_bCacheBody = true;
 
     setSize(-8, -8, 16, 16);
 
@@ -30,6 +30,7 @@ ECFixedVoltage::ECFixedVoltage(ICNDocument *icnDocument, bool newItem, const cha
     : Component(icnDocument, newItem, id ? id : "fixed_voltage")
 {
     m_name = i18n("Fixed Voltage");
+    m_bCacheBody = true;
     setSize(-8, -8, 16, 16);
 
     init1PinRight();
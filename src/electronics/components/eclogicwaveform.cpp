@@ -0,0 +1,143 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "eclogicwaveform.h"
+
+#include "itemdocument.h"
+#include "libraryitem.h"
+#include "logic.h"
+#include "simulator.h"
+
+#include <KLocalizedString>
+#include <QFileInfo>
+#include <QPainter>
+
+#include <cmath>
+
+Item *ECLogicWaveform::construct(ItemDocument *itemDocument, bool newItem, const char *id)
+{
+    return new ECLogicWaveform(static_cast<ICNDocument *>(itemDocument), newItem, id);
+}
+
+LibraryItem *ECLogicWaveform::libraryItem()
+{
+    return new LibraryItem(QStringList(QString("ec/logic_waveform")), i18n("Logic Waveform"), i18n("Logic"), "clockinput.png", LibraryItem::lit_component, ECLogicWaveform::construct);
+}
+
+ECLogicWaveform::ECLogicWaveform(ICNDocument *icnDocument, bool newItem, const char *id)
+    : Component(icnDocument, newItem, (id) ? id : "logic_waveform")
+{
+    m_name = i18n("Logic Waveform");
+    setSize(-16, -8, 32, 16);
+
+    m_threshold = 0.5;
+    m_startTime = 0;
+    m_time = 0.;
+    m_pSimulator = Simulator::self();
+    m_pPointCallback = new ComponentCallback(this, static_cast<VoidCallbackPtr>(&ECLogicWaveform::stepPoint));
+
+    init1PinRight();
+    m_pOut = createLogicOut(m_pPNode[0], false);
+
+    createProperty("waveformFile", Variant::Type::FileName);
+    property("waveformFile")->setCaption(i18n("Waveform File"));
+    property("waveformFile")->setFileFilters({
+        {i18n("Waveform Files") + QLatin1String(" (*.vcd *.csv *.pwl *.txt)"), QStringLiteral("*.vcd *.csv *.pwl *.txt")},
+        {i18n("All Files"), QStringLiteral("*")},
+    });
+    property("waveformFile")->setValue("");
+
+    createProperty("signal", Variant::Type::String);
+    property("signal")->setCaption(i18n("VCD Signal"));
+    property("signal")->setAdvanced(true);
+    property("signal")->setValue("");
+
+    createProperty("threshold", Variant::Type::Double);
+    property("threshold")->setCaption(i18n("Threshold"));
+    property("threshold")->setAdvanced(true);
+    property("threshold")->setValue(0.5);
+
+    addDisplayText("file", QRect(-32, -24, 64, 14), "", false);
+}
+
+ECLogicWaveform::~ECLogicWaveform()
+{
+    if (!Simulator::isDestroyedSim())
+        m_pSimulator->detachComponentCallbacks(*this);
+    delete m_pPointCallback;
+}
+
+void ECLogicWaveform::dataChanged()
+{
+    // The waveform is read by stepPoint while simulating
+    SimulationLocker locker(m_pSimulator);
+    m_pSimulator->detachComponentCallbacks(*this);
+
+    m_threshold = dataDouble("threshold");
+
+    const QString fileName = dataString("waveformFile");
+    const bool opened = m_waveform.open(fileName, dataString("signal"));
+    if (!opened && !fileName.isEmpty())
+        p_itemDocument->canvas()->setMessage(i18n("Could not read %1", fileName));
+    setDisplayText("file", QFileInfo(fileName).fileName());
+
+    // Start the waveform again from its beginning
+    m_startTime = m_pSimulator->fineTime();
+    m_time = 0.;
+    m_pOut->setHigh(opened && m_waveform.valueAt(0.) >= m_threshold);
+    if (opened)
+        scheduleNextPoint();
+}
+
+void ECLogicWaveform::stepPoint()
+{
+    m_pOut->setHigh(m_waveform.valueAt(m_time) >= m_threshold);
+    scheduleNextPoint();
+}
+
+void ECLogicWaveform::simulationResumed(long long heldFor)
+{
+    m_startTime += heldFor;
+}
+
+void ECLogicWaveform::scheduleNextPoint()
+{
+    const double next = m_waveform.nextPointTime(m_time);
+    if (std::isinf(next))
+        return;
+
+    // Points closer together than a logic update are all output in the
+    // same update, leaving the output at the last of them
+    m_time = next;
+    m_pSimulator->scheduleEdge(m_startTime + (long long)std::ceil(next * TIME_UNITS_PER_SECOND), m_pPointCallback);
+}
+
+void ECLogicWaveform::drawShape(QPainter &p)
+{
+    initPainter(p);
+
+    int _x = int(x()) - 10;
+    int _y = int(y()) - 8;
+
+    p.drawRect(_x - 6, _y, 32, 16);
+
+    // An irregular pulse train, to tell it from the clock input
+    p.drawLine(_x, _y + 12, _x + 3, _y + 12);
+    p.drawLine(_x + 3, _y + 12, _x + 3, _y + 4);
+    p.drawLine(_x + 3, _y + 4, _x + 5, _y + 4);
+    p.drawLine(_x + 5, _y + 4, _x + 5, _y + 12);
+    p.drawLine(_x + 5, _y + 12, _x + 11, _y + 12);
+    p.drawLine(_x + 11, _y + 12, _x + 11, _y + 4);
+    p.drawLine(_x + 11, _y + 4, _x + 17, _y + 4);
+    p.drawLine(_x + 17, _y + 4, _x + 17, _y + 12);
+    p.drawLine(_x + 17, _y + 12, _x + 20, _y + 12);
+
+    deinitPainter(p);
+}
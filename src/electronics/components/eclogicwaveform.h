@@ -0,0 +1,59 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef ECLOGICWAVEFORM_H
+#define ECLOGICWAVEFORM_H
+
+#include "component.h"
+#include "pwlwaveform.h"
+
+class ComponentCallback;
+class Simulator;
+
+/**
+@short Logic output that plays a waveform from a file
+A logic output driven by a waveform streamed from a file (see PwlWaveform),
+such as a capture from a logic analyser. The output is high where the value
+is at least the threshold. It is only called by the simulator at the points
+of the file, so a long file with few changes costs little.
+*/
+class ECLogicWaveform : public Component
+{
+public:
+    ECLogicWaveform(ICNDocument *icnDocument, bool newItem, const char *id = nullptr);
+    ~ECLogicWaveform() override;
+
+    static Item *construct(ItemDocument *itemDocument, bool newItem, const char *id);
+    static LibraryItem *libraryItem();
+
+    /** callback at each point of the waveform, which schedules the next */
+    void stepPoint();
+    void simulationResumed(long long heldFor) override;
+
+protected:
+    void drawShape(QPainter &p) override;
+    void dataChanged() override;
+    /**
+     * Schedules stepPoint for the first point after m_time.
+     */
+    void scheduleNextPoint();
+
+    PwlWaveform m_waveform;
+    double m_threshold;
+    /** unit: simulator fine time == 1s / TIME_UNITS_PER_SECOND */
+    long long m_startTime;
+    /** of the point last output, in seconds from m_startTime */
+    double m_time;
+    LogicOut *m_pOut;
+    Simulator *m_pSimulator;
+    ComponentCallback *m_pPointCallback;
+};
+
+#endif
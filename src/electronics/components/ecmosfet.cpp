@@ -113,6 +113,7 @@ ECMOSFET::ECMOSFET(int MOSFET_type, ICNDocument *icnDocument, bool newItem, cons
 #endif
     }
 
+    m_bCacheBody = true;
     setSize(-8, -16, 16, 32);
     ECNode *NodeS = createPin(8, 24, 270, "s");
     m_pMOSFET = createMOSFET(createPin(8, -24, 90, "d"), createPin(-16, 8, 0, "g"), NodeS, NodeS, m_MOSFET_type);
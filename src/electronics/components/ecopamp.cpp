@@ -12,10 +12,13 @@
 
 #include "ecnode.h"
 #include "libraryitem.h"
+#include "opamp.h"
 
 #include <KLocalizedString>
 #include <QPainter>
 
+#include <algorithm>
+
 Item *ECOpAmp::construct(ItemDocument *itemDocument, bool newItem, const char *id)
 {
     return new ECOpAmp(static_cast<ICNDocument *>(itemDocument), newItem, id);
@@ -30,6 +33,7 @@ ECOpAmp::ECOpAmp(ICNDocument *icnDocument, bool newItem, const char *id)
     : Component(icnDocument, newItem, id ? id : "opamp")
 {
     m_name = i18n("Operational Amplifier");
+    m_bCacheBody = true;
 
     QPolygon pa(3);
     pa[0] = QPoint(-16, -16);
@@ -39,13 +43,34 @@ ECOpAmp::ECOpAmp(ICNDocument *icnDocument, bool newItem, const char *id)
 
     init2PinLeft(-8, 8);
     init1PinRight();
-    createOpAmp(m_pNNode[0], m_pPNode[0], m_pNNode[1]);
+    m_pOpAmp = createOpAmp(m_pNNode[0], m_pPNode[0], m_pNNode[1]);
+
+    createProperty("outputHigh", Variant::Type::Double);
+    property("outputHigh")->setCaption(i18n("Output High"));
+    property("outputHigh")->setUnit("V");
+    property("outputHigh")->setMinValue(-1e6);
+    property("outputHigh")->setMaxValue(1e6);
+    property("outputHigh")->setValue(15.0);
+
+    createProperty("outputLow", Variant::Type::Double);
+    property("outputLow")->setCaption(i18n("Output Low"));
+    property("outputLow")->setUnit("V");
+    property("outputLow")->setMinValue(-1e6);
+    property("outputLow")->setMaxValue(1e6);
+    property("outputLow")->setValue(-15.0);
 }
 
 ECOpAmp::~ECOpAmp()
 {
 }
 
+void ECOpAmp::dataChanged()
+{
+    const double high = dataDouble("outputHigh");
+    const double low = dataDouble("outputLow");
+    m_pOpAmp->setOutputLimits(std::min(low, high), std::max(low, high));
+}
+
 void ECOpAmp::drawShape(QPainter &p)
 {
     initPainter(p);
@@ -13,6 +13,8 @@
 
 #include "component.h"
 
+class OpAmp;
+
 /**
 @short Operational Amplifier
 @author David Saxton
@@ -28,6 +30,9 @@ public:
 
 protected:
     void drawShape(QPainter &p) override;
+    void dataChanged() override;
+
+    OpAmp *m_pOpAmp;
 };
 
 #endif
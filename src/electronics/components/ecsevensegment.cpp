@@ -34,7 +34,6 @@ ECSevenSegment::ECSevenSegment(ICNDocument *icnDocument, bool newItem, const cha
     : Component(icnDocument, newItem, id ? id : "seven_segment")
 {
     m_name = i18n("Seven Segment LED");
-    m_bDynamicContent = true;
 
     // QStringList pins = QStringList::split( ',', "g,f,e,d,"+QString(QChar(0xB7))+",c,b,a" );
     QStringList pins = QString("g,f,e,d," + QString(QChar(0xB7)) + ",c,b,a").split(',');
@@ -55,7 +54,7 @@ ECSevenSegment::ECSevenSegment(ICNDocument *icnDocument, bool newItem, const cha
         m_diodes[i] = nullptr;
         m_nodes[i] = nullptr;
         avg_brightness[i] = 0.;
-        last_brightness[i] = 255;
+        m_displayBrightness[i] = last_brightness[i] = 255;
     }
     m_nNode = nullptr;
 
@@ -118,6 +117,27 @@ void ECSevenSegment::stepNonLogic()
     lastUpdatePeriod += LINEAR_UPDATE_PERIOD;
 }
 
+void ECSevenSegment::publishDisplayState()
+{
+    if (lastUpdatePeriod == 0.)
+        return;
+
+    for (uint i = 0; i < 8; ++i) {
+        m_displayBrightness[i] = uint(avg_brightness[i] / lastUpdatePeriod);
+        avg_brightness[i] = 0.;
+    }
+    lastUpdatePeriod = 0.;
+}
+
+bool ECSevenSegment::contentChanged() const
+{
+    for (uint i = 0; i < 8; ++i) {
+        if (m_displayBrightness[i] != last_brightness[i])
+            return true;
+    }
+    return false;
+}
+
 void ECSevenSegment::drawShape(QPainter &p)
 {
     CNItem::drawShape(p);
@@ -139,10 +159,8 @@ void ECSevenSegment::drawShape(QPainter &p)
     // 	pen.setCapStyle(Qt::RoundCap);
     // 	p.setPen(pen);
 
-    if (lastUpdatePeriod != 0.) {
-        for (uint i = 0; i < 8; ++i) {
-            last_brightness[i] = uint(avg_brightness[i] / lastUpdatePeriod);
-        }
+    for (uint i = 0; i < 8; ++i) {
+        last_brightness[i] = m_displayBrightness[i];
     }
 
     double _b;
@@ -188,10 +206,5 @@ void ECSevenSegment::drawShape(QPainter &p)
     p.setPen(Qt::NoPen);
     p.drawPie(x2 + 3, y3 - 2, 3, 3, 0, 16 * 360);
 
-    lastUpdatePeriod = 0.;
-    for (uint i = 0; i < 8; ++i) {
-        avg_brightness[i] = 0.;
-    }
-
     deinitPainter(p);
 }
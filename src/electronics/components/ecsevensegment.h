@@ -34,6 +34,12 @@ public:
     {
         return true;
     }
+    /**
+     * Only true when a segment is now a different brightness to that last
+     * drawn.
+     */
+    bool contentChanged() const override;
+    void publishDisplayState() override;
     void dataChanged() override;
 
 private:
@@ -42,6 +48,7 @@ private:
     bool m_bCommonCathode;
     double lastUpdatePeriod;
     double avg_brightness[8];
+    uint m_displayBrightness[8]; // As published for drawing
     uint last_brightness[8];
     Diode *m_diodes[8];
     ECNode *m_nodes[8];
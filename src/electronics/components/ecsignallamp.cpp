@@ -47,7 +47,7 @@ ECSignalLamp::ECSignalLamp(ICNDocument *icnDocument, bool newItem, const char *i
 
     advanceSinceUpdate = 0;
     avgPower = 0.;
-    m_bDynamicContent = true;
+    m_displayBrightness = m_lastBrightness = 255;
 }
 
 ECSignalLamp::~ECSignalLamp()
@@ -64,6 +64,24 @@ void ECSignalLamp::stepNonLogic()
     ++advanceSinceUpdate;
 }
 
+int ECSignalLamp::brightness() const
+{
+    // Calculate the brightness as a linear function of power, bounded below by
+    // 25 milliWatts and above by 500 milliWatts.
+    return (avgPower < LIGHTUP) ? 255 : ((avgPower > WATTAGE) ? 0 : int(255 * (1 - ((avgPower - LIGHTUP) / (WATTAGE - LIGHTUP)))));
+}
+
+void ECSignalLamp::publishDisplayState()
+{
+    m_displayBrightness = brightness();
+    advanceSinceUpdate = 0;
+}
+
+bool ECSignalLamp::contentChanged() const
+{
+    return m_displayBrightness != m_lastBrightness;
+}
+
 void ECSignalLamp::drawShape(QPainter &p)
 {
     initPainter(p);
@@ -71,12 +89,9 @@ void ECSignalLamp::drawShape(QPainter &p)
     int _x = int(x());
     int _y = int(y());
 
-    // Calculate the brightness as a linear function of power, bounded below by
-    // 25 milliWatts and above by 500 milliWatts.
-    int brightness = (avgPower < LIGHTUP) ? 255 : ((avgPower > WATTAGE) ? 0 : int(255 * (1 - ((avgPower - LIGHTUP) / (WATTAGE - LIGHTUP)))));
-    advanceSinceUpdate = 0;
+    m_lastBrightness = m_displayBrightness;
 
-    p.setBrush(QColor(255, 255, brightness));
+    p.setBrush(QColor(255, 255, m_lastBrightness));
     p.drawEllipse(_x - 8, _y - 8, 16, 16);
 
     int pos = 8 - int(8 * M_SQRT1_2);
@@ -33,11 +33,24 @@ public:
     {
         return true;
     }
+    /**
+     * Only true when the lamp is now a different brightness to that last
+     * drawn.
+     */
+    bool contentChanged() const override;
+    void publishDisplayState() override;
 
 private:
     void drawShape(QPainter &p) override;
+    /**
+     * @return the brightness for the current average power, from 255 (off)
+     * to 0 (fully lit).
+     */
+    int brightness() const;
     double avgPower;
     uint advanceSinceUpdate;
+    int m_displayBrightness; // As published for drawing
+    int m_lastBrightness;
 };
 
 #endif
@@ -12,6 +12,8 @@
 
 #include "ecvoltagesignal.h"
 #include "ecnode.h"
+#include "filefilters.h"
+#include "itemdocument.h"
 #include "libraryitem.h"
 #include "pin.h"
 #include "simulator.h"
@@ -45,6 +47,25 @@ ECVoltageSignal::ECVoltageSignal(ICNDocument *icnDocument, bool newItem, const c
     m_voltageSignal = createVoltageSignal(m_pNNode[0], m_pPNode[0], 0.);
     m_voltageSignal->setStep(ElementSignal::st_sinusoidal, 50.);
 
+    createProperty("waveform", Variant::Type::Select);
+    property("waveform")->setCaption(i18n("Waveform"));
+    QStringMap waveforms;
+    waveforms["sine"] = i18n("Sine");
+    waveforms["square"] = i18n("Square");
+    waveforms["sawtooth"] = i18n("Sawtooth");
+    waveforms["triangle"] = i18n("Triangle");
+    waveforms["waveform"] = i18n("From File");
+    property("waveform")->setAllowed(waveforms);
+    property("waveform")->setValue("sine");
+
+    createProperty("waveformFile", Variant::Type::FileName);
+    property("waveformFile")->setCaption(i18n("Waveform File"));
+    property("waveformFile")->setFileFilters({
+        {i18n("Waveform Files") + QLatin1String(" (*.csv *.pwl *.txt *.vcd)"), QStringLiteral("*.csv *.pwl *.txt *.vcd")},
+        {i18n("All Files"), QStringLiteral("*")},
+    });
+    property("waveformFile")->setValue("");
+
     createProperty("frequency", Variant::Type::Double);
     property("frequency")->setCaption(i18n("Frequency"));
     property("frequency")->setUnit("Hz");
@@ -79,9 +100,20 @@ void ECVoltageSignal::dataChanged()
 {
     const double voltage = dataDouble("voltage");
     const double frequency = dataDouble("frequency");
+    const ElementSignal::Type type = ElementSignal::typeFromName(dataString("waveform"));
     bool rms = dataString("peak-rms") == "RMS";
 
-    m_voltageSignal->setStep(ElementSignal::st_sinusoidal, frequency);
+    if (type == ElementSignal::st_waveform) {
+        // The voltages are read from the file as they are
+        const QString fileName = dataString("waveformFile");
+        if (!m_voltageSignal->setWaveform(fileName) && !fileName.isEmpty())
+            p_itemDocument->canvas()->setMessage(i18n("Could not read %1", fileName));
+        setDisplayText("voltage", "");
+        m_voltageSignal->setVoltage(1.);
+        return;
+    }
+
+    m_voltageSignal->setStep(type, frequency);
     if (rms) {
         QString display = QString::number(voltage / getMultiplier(voltage), 'g', 3) + getNumberMag(voltage) + "V RMS";
         setDisplayText("voltage", display);
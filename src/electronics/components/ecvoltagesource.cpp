@@ -35,6 +35,7 @@ ECCell::ECCell(ICNDocument *icnDocument, bool newItem, const char *id)
     : Component(icnDocument, newItem, id ? id : "cell")
 {
     m_name = i18n("Battery");
+    m_bCacheBody = true;
     setSize(-8, -8, 16, 16);
     voltage = 0;
 
@@ -29,6 +29,7 @@ Inductor::Inductor(ICNDocument *icnDocument, bool newItem, const char *id)
     : Component(icnDocument, newItem, id ? id : "inductor")
 {
     m_name = i18n("Inductor");
+    m_bCacheBody = true;
     setSize(-16, -8, 32, 16);
 
     init1PinLeft();
@@ -36,7 +37,7 @@ Inductor::Inductor(ICNDocument *icnDocument, bool newItem, const char *id)
 
     m_pInductance = createInductance(m_pNNode[0], m_pPNode[0], 0.001);
 
-    createProperty("Inductance", Variant::Type::Double);
+    m_pInductanceProperty = createProperty("Inductance", Variant::Type::Double);
     property("Inductance")->setCaption(i18n("Inductance"));
     property("Inductance")->setUnit("H");
     property("Inductance")->setMinValue(1e-12);
@@ -52,7 +53,7 @@ Inductor::~Inductor()
 
 void Inductor::dataChanged()
 {
-    double inductance = dataDouble("Inductance");
+    double inductance = m_pInductanceProperty->doubleValue();
 
     QString display = QString::number(inductance / getMultiplier(inductance), 'g', 3) + getNumberMag(inductance) + "H";
     setDisplayText("inductance", display);
@@ -30,6 +30,7 @@ private:
     void drawShape(QPainter &p) override;
 
     Inductance *m_pInductance;
+    Property *m_pInductanceProperty;
 };
 
 #endif
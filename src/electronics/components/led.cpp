@@ -31,13 +31,11 @@ LibraryItem *LED::libraryItem()
 LED::LED(ICNDocument *icnDocument, bool newItem, const char *id)
     : ECDiode(icnDocument, newItem, id ? id : "led")
 {
-    m_bDynamicContent = true;
     m_name = i18n("LED");
     setSize(-8, -16, 24, 24, true);
-    avg_brightness = 255;
-    lastUpdatePeriod = 1.;
     r = g = b = 0;
-    last_brightness = 255;
+    m_displayBrightness = last_brightness = 255;
+    m_brightnessHandle = Simulator::self()->attachDiodeBrightness(m_diode);
 
     createProperty("0-color", Variant::Type::Color);
     property("0-color")->setCaption(i18n("Color"));
@@ -46,6 +44,8 @@ LED::LED(ICNDocument *icnDocument, bool newItem, const char *id)
 
 LED::~LED()
 {
+    if (!Simulator::isDestroyedSim())
+        Simulator::self()->detachDiodeBrightness(m_brightnessHandle);
 }
 
 void LED::dataChanged()
@@ -56,10 +56,20 @@ void LED::dataChanged()
     b = color.blue() / double(0x100);
 }
 
-void LED::stepNonLogic()
+void LED::publishDisplayState()
 {
-    avg_brightness += brightness(m_diode->current()) * LINEAR_UPDATE_PERIOD;
-    lastUpdatePeriod += LINEAR_UPDATE_PERIOD;
+    Simulator *simulator = Simulator::self();
+    const int brightness = simulator->diodeBrightness(m_brightnessHandle);
+    if (brightness == -1)
+        return;
+
+    m_displayBrightness = uint(brightness);
+    simulator->restartDiodeBrightness(m_brightnessHandle);
+}
+
+bool LED::contentChanged() const
+{
+    return m_displayBrightness != last_brightness;
 }
 
 void LED::drawShape(QPainter &p)
@@ -72,15 +82,9 @@ void LED::drawShape(QPainter &p)
     // BEGIN draw "Diode" part
     uint _b;
 
-    if (lastUpdatePeriod != 0.) {
-        last_brightness = uint(avg_brightness / lastUpdatePeriod);
-    }
-
+    last_brightness = m_displayBrightness;
     _b = last_brightness;
 
-    avg_brightness = 0.;
-    lastUpdatePeriod = 0.;
-
     p.setBrush(QColor(uint(255 - (255 - _b) * (1 - r)), uint(255 - (255 - _b) * (1 - g)), uint(255 - (255 - _b) * (1 - b))));
 
     QPolygon pa(3);
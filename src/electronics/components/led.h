@@ -33,20 +33,25 @@ public:
     static uint brightness(double i);
 
     void dataChanged() override;
-    void stepNonLogic() override;
-    bool doesStepNonLogic() const override
-    {
-        return true;
-    }
+    /**
+     * Only true when the LED is now a different brightness to that last
+     * drawn, so that a steady LED is not redrawn every frame.
+     */
+    bool contentChanged() const override;
+    /**
+     * Takes the brightness averaged over the steps since the last frame, as
+     * added up by the Simulator, for drawing.
+     */
+    void publishDisplayState() override;
 
 private:
     void drawShape(QPainter &p) override;
 
     double r, g, b;
 
-    double avg_brightness;
+    uint m_displayBrightness; // As published for drawing
     uint last_brightness;
-    double lastUpdatePeriod;
+    int m_brightnessHandle; // For reading the brightness from the Simulator
 };
 
 #endif
@@ -30,7 +30,7 @@ LEDPart::LEDPart(Component *pParent, const QString &strPNode, const QString &str
 
     avg_brightness = 255;
     lastUpdatePeriod = 1.;
-    last_brightness = 255;
+    m_displayBrightness = 255;
     r = g = b = 0;
 }
 
@@ -59,18 +59,19 @@ void LEDPart::step()
     lastUpdatePeriod += LINEAR_UPDATE_PERIOD;
 }
 
-void LEDPart::draw(QPainter &p, int x, int y, int w, int h)
+void LEDPart::publish()
 {
-    uint _b;
     if (lastUpdatePeriod == 0.)
-        _b = last_brightness;
-    else {
-        _b = uint(avg_brightness / lastUpdatePeriod);
-        last_brightness = _b;
-    }
+        return;
 
+    m_displayBrightness = uint(avg_brightness / lastUpdatePeriod);
     avg_brightness = 0.;
     lastUpdatePeriod = 0.;
+}
+
+void LEDPart::draw(QPainter &p, int x, int y, int w, int h)
+{
+    const uint _b = m_displayBrightness;
 
     p.setBrush(QColor(uint(255 - (255 - _b) * (1 - r)), uint(255 - (255 - _b) * (1 - g)), uint(255 - (255 - _b) * (1 - b))));
     p.drawRect(x, y, w, h);
@@ -222,6 +223,12 @@ void LEDBarGraphDisplay::stepNonLogic()
         m_LEDParts[i]->step();
 }
 
+void LEDBarGraphDisplay::publishDisplayState()
+{
+    for (unsigned i = 0; i < m_numRows; i++)
+        m_LEDParts[i]->publish();
+}
+
 void LEDBarGraphDisplay::drawShape(QPainter &p)
 {
     Component::drawShape(p);
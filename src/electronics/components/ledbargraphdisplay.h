@@ -32,6 +32,11 @@ public:
     void setDiodeSettings(const DiodeSettings &ds);
     void setColor(const QColor &color);
     void step();
+    /**
+     * Takes the brightness averaged over the steps since the last frame for
+     * drawing.
+     */
+    void publish();
 
     void draw(QPainter &p, int x, int y, int w, int h);
 
@@ -44,7 +49,7 @@ private:
     double r, g, b;
     double lastUpdatePeriod;
     double avg_brightness;
-    uint last_brightness;
+    uint m_displayBrightness; // As published for drawing
 };
 
 class LEDBarGraphDisplay : public Component
@@ -65,6 +70,7 @@ private:
     {
         return true;
     }
+    void publishDisplayState() override;
     void drawShape(QPainter &p) override;
 
     LEDPart *m_LEDParts[max_LED_rows];
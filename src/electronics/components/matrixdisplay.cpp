@@ -44,7 +44,6 @@ MatrixDisplay::MatrixDisplay(ICNDocument *icnDocument, bool newItem, const char
     for (unsigned i = 0; i < max_md_width; i++)
         m_pColNodes[i] = nullptr;
 
-    m_lastUpdatePeriod = 0.0;
     m_r = m_g = m_b = 0.0;
     m_bRowCathode = true;
     m_numRows = 0;
@@ -79,6 +78,29 @@ MatrixDisplay::MatrixDisplay(ICNDocument *icnDocument, bool newItem, const char
 
 MatrixDisplay::~MatrixDisplay()
 {
+    if (Simulator::isDestroyedSim())
+        return;
+
+    for (const QVector<int> &column : qAsConst(m_brightnessHandles)) {
+        for (int handle : column) {
+            if (handle != -1)
+                Simulator::self()->detachDiodeBrightness(handle);
+        }
+    }
+}
+
+void MatrixDisplay::removeDiodes()
+{
+    for (unsigned i = 0; i < m_numCols; i++) {
+        for (unsigned j = 0; j < m_numRows; j++) {
+            if (m_brightnessHandles[i][j] != -1)
+                Simulator::self()->detachDiodeBrightness(m_brightnessHandles[i][j]);
+            m_brightnessHandles[i][j] = -1;
+
+            removeElement(m_pDiodes[i][j], false);
+            m_pDiodes[i][j] = nullptr;
+        }
+    }
 }
 
 void MatrixDisplay::dataChanged()
@@ -100,13 +122,15 @@ void MatrixDisplay::dataChanged()
     if ((rowCathode != m_bRowCathode) || ledsChanged) {
         m_bRowCathode = rowCathode;
 
+        removeDiodes();
+
         for (unsigned i = 0; i < m_numCols; i++) {
             for (unsigned j = 0; j < m_numRows; j++) {
-                removeElement(m_pDiodes[i][j], false);
                 if (rowCathode)
                     m_pDiodes[i][j] = createDiode(m_pColNodes[i], m_pRowNodes[j]);
                 else
                     m_pDiodes[i][j] = createDiode(m_pRowNodes[j], m_pColNodes[i]);
+                m_brightnessHandles[i][j] = Simulator::self()->attachDiodeBrightness(m_pDiodes[i][j]);
             }
         }
     }
@@ -123,31 +147,26 @@ void MatrixDisplay::initPins(unsigned numRows, unsigned numCols)
     if (numCols > max_md_width)
         numCols = max_md_width;
 
-    m_lastUpdatePeriod = 0.0;
-
     // BEGIN Remove diodes
     // All the diodes are going to be re-added from dataChanged (where this
     // function is called from), so easiest just to delete the diodes now and
     // resize.
 
-    for (unsigned i = 0; i < m_numCols; i++) {
-        for (unsigned j = 0; j < m_numRows; j++)
-            removeElement(m_pDiodes[i][j], false);
-    }
+    removeDiodes();
 
-    m_avgBrightness.resize(numCols);
     m_lastBrightness.resize(numCols);
     m_pDiodes.resize(numCols);
+    m_brightnessHandles.resize(numCols);
 
     for (unsigned i = 0; i < numCols; i++) {
-        m_avgBrightness[i].resize(numRows);
         m_lastBrightness[i].resize(numRows);
         m_pDiodes[i].resize(numRows);
+        m_brightnessHandles[i].resize(numRows);
 
         for (unsigned j = 0; j < numRows; j++) {
-            m_avgBrightness[i][j] = 0.0;
             m_lastBrightness[i][j] = 255;
             m_pDiodes[i][j] = nullptr;
+            m_brightnessHandles[i][j] = -1;
         }
     }
     // END Remove diodes
@@ -202,14 +221,22 @@ QString MatrixDisplay::rowPinID(int row) const
     return QString("row_%1").arg(QString::number(row));
 }
 
-void MatrixDisplay::stepNonLogic()
+void MatrixDisplay::publishDisplayState()
 {
-    for (unsigned i = 0; i < m_numCols; i++) {
-        for (unsigned j = 0; j < m_numRows; j++)
-            m_avgBrightness[i][j] += LED::brightness(m_pDiodes[i][j]->current()) * LINEAR_UPDATE_PERIOD;
-    }
+    // To avoid flicker, require at least a 10 ms sample before changing
+    // the brightness
+    const long long minUpdateSteps = LINEAR_UPDATE_RATE / 100 - 1;
+    Simulator *simulator = Simulator::self();
 
-    m_lastUpdatePeriod += LINEAR_UPDATE_PERIOD;
+    for (int i = 0; i < int(m_numCols); i++) {
+        for (int j = 0; j < int(m_numRows); j++) {
+            const int handle = m_brightnessHandles[i][j];
+            if (handle != -1 && simulator->diodeBrightnessSteps(handle) > minUpdateSteps) {
+                m_lastBrightness[i][j] = unsigned(simulator->diodeBrightness(handle));
+                simulator->restartDiodeBrightness(handle);
+            }
+        }
+    }
 }
 
 void MatrixDisplay::drawShape(QPainter &p)
@@ -223,15 +250,8 @@ void MatrixDisplay::drawShape(QPainter &p)
     const int _x = int(x() + offsetX());
     const int _y = int(y() + offsetY());
 
-    // To avoid flicker, require at least a 10 ms sample before changing
-    // the brightness
-    double minUpdatePeriod = 0.0099;
-
     for (int i = 0; i < int(m_numCols); i++) {
         for (int j = 0; j < int(m_numRows); j++) {
-            if (m_lastUpdatePeriod > minUpdatePeriod)
-                m_lastBrightness[i][j] = unsigned(m_avgBrightness[i][j] / m_lastUpdatePeriod);
-
             double _b = m_lastBrightness[i][j];
 
             QColor brush = QColor(uint(255 - (255 - _b) * (1 - m_r)), uint(255 - (255 - _b) * (1 - m_g)), uint(255 - (255 - _b) * (1 - m_b)));
@@ -241,14 +261,5 @@ void MatrixDisplay::drawShape(QPainter &p)
         }
     }
 
-    if (m_lastUpdatePeriod > minUpdatePeriod) {
-        m_lastUpdatePeriod = 0.0;
-
-        for (unsigned i = 0; i < m_numCols; i++) {
-            for (unsigned j = 0; j < m_numRows; j++)
-                m_avgBrightness[i][j] = 0.0;
-        }
-    }
-
     deinitPainter(p);
 }
@@ -29,11 +29,11 @@ public:
     static Item *construct(ItemDocument *itemDocument, bool newItem, const char *id);
     static LibraryItem *libraryItem();
 
-    void stepNonLogic() override;
-    bool doesStepNonLogic() const override
-    {
-        return true;
-    }
+    /**
+     * Takes the brightness of each diode, averaged over at least 10 ms (to
+     * avoid flicker), for drawing.
+     */
+    void publishDisplayState() override;
 
 protected:
     void drawShape(QPainter &p) override;
@@ -43,15 +43,19 @@ protected:
     QString colPinID(int col) const;
     QString rowPinID(int row) const;
 
-    QVector<QVector<double>> m_avgBrightness;
-    QVector<QVector<unsigned>> m_lastBrightness;
+    /**
+     * Stops the Simulator adding up the brightness of the diodes, and removes
+     * them.
+     */
+    void removeDiodes();
+
+    QVector<QVector<unsigned>> m_lastBrightness; // As published for drawing
     QVector<QVector<Diode *>> m_pDiodes;
+    QVector<QVector<int>> m_brightnessHandles; // For reading the brightnesses from the Simulator
 
     ECNode *m_pRowNodes[max_md_height];
     ECNode *m_pColNodes[max_md_width];
 
-    double m_lastUpdatePeriod;
-
     double m_r, m_g, m_b;
     bool m_bRowCathode;
 
@@ -60,7 +60,29 @@ void Meter::dataChanged()
     setChanged();
 }
 
+/// The meters only need sampling at 1 kHz to show a steady reading
+static const int METER_STEP_DIVIDER = LINEAR_UPDATE_RATE / 1000;
+
+int Meter::nonLogicStepDivider() const
+{
+    return METER_STEP_DIVIDER;
+}
+
 void Meter::stepNonLogic()
+{
+    const double v = meterValue();
+    if (!b_timerStarted && std::abs(((v - m_old_value) / m_old_value)) > 1e-6) {
+        b_timerStarted = true;
+    }
+
+    if (b_timerStarted) {
+        m_timeSinceUpdate += LINEAR_UPDATE_PERIOD * METER_STEP_DIVIDER;
+        m_avgValue += v * LINEAR_UPDATE_PERIOD * METER_STEP_DIVIDER;
+        // 		setChanged();
+    }
+}
+
+void Meter::publishDisplayState()
 {
     if (b_firstRun) {
         p_displayText->setText(displayText());
@@ -71,19 +93,9 @@ void Meter::stepNonLogic()
         b_firstRun = false;
     }
 
-    const double v = meterValue();
-    if (!b_timerStarted && std::abs(((v - m_old_value) / m_old_value)) > 1e-6) {
-        b_timerStarted = true;
-    }
-
-    if (b_timerStarted) {
-        m_timeSinceUpdate += LINEAR_UPDATE_PERIOD;
-        m_avgValue += v * LINEAR_UPDATE_PERIOD;
-        // 		setChanged();
-        if (m_timeSinceUpdate > 0.05) {
-            if (p_displayText->setText(displayText()))
-                updateAttachedPositioning();
-        }
+    if (m_timeSinceUpdate > 0.05) {
+        if (p_displayText->setText(displayText()))
+            updateAttachedPositioning();
     }
 }
 
@@ -27,6 +27,12 @@ public:
     {
         return true;
     }
+    int nonLogicStepDivider() const override;
+    /**
+     * Updates the text with the value averaged since it was last updated,
+     * at most every 50 ms of simulated time.
+     */
+    void publishDisplayState() override;
     void drawShape(QPainter &p) override;
     bool contentChanged() const override;
 
@@ -13,6 +13,7 @@
 #include "icndocument.h"
 #include "libraryitem.h"
 #include "logic.h"
+#include "simulator.h"
 
 #include <KLocalizedString>
 #include <QPainter>
@@ -29,7 +30,7 @@ void MultiInputGate_inStateChanged(void *objV, bool state) { // Enable
     objT->inStateChanged(state);
 }
 
-MultiInputGate::MultiInputGate(ICNDocument *icnDocument, bool newItem, const char *id, const QString &rectangularShapeText, bool invertedOutput, int baseWidth, bool likeOR)
+MultiInputGate::MultiInputGate(ICNDocument *icnDocument, bool newItem, const char *id, const QString &rectangularShapeText, bool invertedOutput, LogicGate::Operation operation, int baseWidth, bool likeOR)
     : Component(icnDocument, newItem, id)
 {
     m_bLikeOR = likeOR;
@@ -37,6 +38,7 @@ MultiInputGate::MultiInputGate(ICNDocument *icnDocument, bool newItem, const cha
     m_numInputs = 0;
     m_distinctiveWidth = baseWidth;
     m_bInvertedOutput = invertedOutput;
+    m_operation = operation;
     m_rectangularShapeText = rectangularShapeText;
 
     for (int i = 0; i < maxGateInput; ++i) {
@@ -57,6 +59,14 @@ MultiInputGate::MultiInputGate(ICNDocument *icnDocument, bool newItem, const cha
     property("numInput")->setMaxValue(maxGateInput);
     property("numInput")->setValue(2);
 
+    createProperty("delay", Variant::Type::Double);
+    property("delay")->setUnit("S");
+    property("delay")->setCaption(i18n("Propagation Delay"));
+    property("delay")->setMinValue(0.);
+    property("delay")->setMaxValue(double(LOGIC_WHEEL_SIZE - 1) / LOGIC_UPDATE_RATE);
+    property("delay")->setValue(1. / LOGIC_UPDATE_RATE);
+    property("delay")->setAdvanced(true);
+
     m_bDoneInit = true;
 }
 
@@ -64,6 +74,15 @@ MultiInputGate::~MultiInputGate()
 {
 }
 
+bool MultiInputGate::describeLogicGate(LogicGate *gate) const
+{
+    gate->operation = m_operation;
+    gate->inverted = m_bInvertedOutput;
+    gate->inputs.assign(inLogic, inLogic + m_numInputs);
+    gate->output = m_pOut;
+    return true;
+}
+
 void MultiInputGate::slotUpdateConfiguration()
 {
     updateLogicSymbolShape();
@@ -111,6 +130,7 @@ int MultiInputGate::logicSymbolShapeToWidth() const
 void MultiInputGate::dataChanged()
 {
     updateInputs(std::min(maxGateInput, dataInt("numInput")));
+    m_pOut->setPropagationDelay(qRound(dataDouble("delay") * LOGIC_UPDATE_RATE));
 }
 
 void MultiInputGate::updateInputs(int newNum)
@@ -219,7 +239,7 @@ LibraryItem *ECXnor::libraryItem()
 }
 
 ECXnor::ECXnor(ICNDocument *icnDocument, bool newItem, const char *id)
-    : MultiInputGate(icnDocument, newItem, id ? id : "xnor", "=1", true, 48, true)
+    : MultiInputGate(icnDocument, newItem, id ? id : "xnor", "=1", true, LogicGate::Xor, 48, true)
 {
     m_name = i18n("XNOR gate");
 
@@ -279,7 +299,7 @@ LibraryItem *ECXor::libraryItem()
 }
 
 ECXor::ECXor(ICNDocument *icnDocument, bool newItem, const char *id)
-    : MultiInputGate(icnDocument, newItem, id ? id : "xor", "=1", false, 48, true)
+    : MultiInputGate(icnDocument, newItem, id ? id : "xor", "=1", false, LogicGate::Xor, 48, true)
 {
     m_name = i18n("XOR gate");
 
@@ -337,7 +357,7 @@ LibraryItem *ECOr::libraryItem()
 }
 
 ECOr::ECOr(ICNDocument *icnDocument, bool newItem, const char *id)
-    : MultiInputGate(icnDocument, newItem, id ? id : "or", QChar(0x2265) + QString("1"), false, 48, true)
+    : MultiInputGate(icnDocument, newItem, id ? id : "or", QChar(0x2265) + QString("1"), false, LogicGate::Or, 48, true)
 {
     m_name = i18n("OR gate");
 
@@ -396,7 +416,7 @@ LibraryItem *ECNor::libraryItem()
 }
 
 ECNor::ECNor(ICNDocument *icnDocument, bool newItem, const char *id)
-    : MultiInputGate(icnDocument, newItem, id ? id : "nor", QChar(0x2265) + QString("1"), true, 48, true)
+    : MultiInputGate(icnDocument, newItem, id ? id : "nor", QChar(0x2265) + QString("1"), true, LogicGate::Or, 48, true)
 {
     m_name = i18n("NOR Gate");
 
@@ -455,7 +475,7 @@ LibraryItem *ECNand::libraryItem()
 }
 
 ECNand::ECNand(ICNDocument *icnDocument, bool newItem, const char *id)
-    : MultiInputGate(icnDocument, newItem, id ? id : "nand", "&", true, 32, false)
+    : MultiInputGate(icnDocument, newItem, id ? id : "nand", "&", true, LogicGate::And, 32, false)
 {
     m_name = i18n("NAND Gate");
 
@@ -509,7 +529,7 @@ LibraryItem *ECAnd::libraryItem()
 }
 
 ECAnd::ECAnd(ICNDocument *icnDocument, bool newItem, const char *id)
-    : MultiInputGate(icnDocument, newItem, id ? id : "and", "&", false, 32, false)
+    : MultiInputGate(icnDocument, newItem, id ? id : "and", "&", false, LogicGate::And, 32, false)
 {
     m_name = i18n("AND Gate");
 
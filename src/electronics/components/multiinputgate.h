@@ -13,6 +13,7 @@
 
 #include "component.h"
 #include "logic.h"
+#include "logicnetlist.h"
 
 const int maxGateInput = 256;
 
@@ -26,15 +27,18 @@ public:
      * @param rectangularShapeText is the text displayed in the logic symbol
      * when drawing in rectangular mode, e.g. "&" for AND and "=1" for XOR.
      * @param invertedOutput true for NAND, NOR, XNOR; false for AND, OR, XOR
+     * @param operation what the gate does before any inversion of the output
      * @param baseWidth is the width of the logic gate when drawing in
      * distinctive mode.
      * @param likeOR true for OR, NOR, XOR, XNOR (specifically, this value
      * used in computer the length of input pins, as OR types have a curvy
      * base when the shape is distinctive).
      */
-    MultiInputGate(ICNDocument *icnDocument, bool newItem, const char *id, const QString &rectangularShapeText, bool invertedOutput, int baseWidth, bool likeOR);
+    MultiInputGate(ICNDocument *icnDocument, bool newItem, const char *id, const QString &rectangularShapeText, bool invertedOutput, LogicGate::Operation operation, int baseWidth, bool likeOR);
     ~MultiInputGate() override;
 
+    bool describeLogicGate(LogicGate *gate) const override;
+
 protected:
     enum LogicSymbolShape { Distinctive, Rectangular };
 
@@ -69,6 +73,7 @@ protected:
     LogicSymbolShape m_logicSymbolShape;
     QString m_rectangularShapeText;
     bool m_bInvertedOutput;
+    LogicGate::Operation m_operation;
     bool m_bLikeOR;
 
 private:
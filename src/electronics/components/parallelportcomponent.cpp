@@ -16,12 +16,15 @@
 #include "libraryitem.h"
 #include "pin.h"
 #include "resistance.h"
+#include "simulator.h"
 
 #include <KLocalizedString>
 
 #include <QDebug>
 #include <QPainter>
+#include <QTimer>
 
+#include <algorithm>
 #include <cmath>
 
 void ParallelPortComponent_dataCallback(void *objV, bool state) {
@@ -56,6 +59,11 @@ ParallelPortComponent::ParallelPortComponent(ICNDocument *icnDocument, bool newI
     setItemPoints(pa);
 
     m_pParallelPort = new ParallelPort();
+    m_status = 0;
+
+    m_pPollTimer = new QTimer(this);
+    m_pPollTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_pPollTimer, &QTimer::timeout, this, &ParallelPortComponent::pollStatus);
 
     for (unsigned i = 0; i < 24; ++i)
         m_pLogic[i] = nullptr;
@@ -141,6 +149,13 @@ ParallelPortComponent::ParallelPortComponent(ICNDocument *icnDocument, bool newI
     Variant *v = createProperty("port", Variant::Type::Combo);
     v->setAllowed(ParallelPort::ports());
     v->setCaption(i18n("Port"));
+
+    v = createProperty("pollInterval", Variant::Type::Double);
+    v->setCaption(i18n("Status Poll Interval"));
+    v->setUnit("S");
+    v->setMinValue(1e-3);
+    v->setMaxValue(1.);
+    v->setValue(1e-3);
 }
 
 ParallelPortComponent::~ParallelPortComponent()
@@ -161,15 +176,22 @@ void ParallelPortComponent::dataChanged()
 
 void ParallelPortComponent::initPort(const QString &port)
 {
+    m_pPollTimer->stop();
+
     if (port.isEmpty()) {
         m_pParallelPort->closePort();
+        pollStatus();
         return;
     }
 
     if (!m_pParallelPort->openPort(port)) {
         p_itemDocument->canvas()->setMessage(i18n("Could not open port %1", port));
+        pollStatus();
         return;
     }
+
+    pollStatus();
+    m_pPollTimer->start(std::max(1, int(std::lround(dataDouble("pollInterval") * 1e3))));
 }
 
 void ParallelPortComponent::dataCallback(bool)
@@ -190,12 +212,20 @@ void ParallelPortComponent::controlCallback(bool)
     m_pParallelPort->writeToControl(value);
 }
 
-void ParallelPortComponent::stepNonLogic()
+void ParallelPortComponent::pollStatus()
 {
-    uchar status = m_pParallelPort->readFromRegister(ParallelPort::Status);
+    const uchar status = m_pParallelPort->readFromRegister(ParallelPort::Status);
+    const uchar changed = status ^ m_status;
+    if (!changed)
+        return;
+    m_status = status;
+
+    SimulationLocker locker;
     // Bits 0...2 in the Status register are not used
-    for (int i = 3; i < 8; ++i)
-        m_pLogic[i + 8]->setHigh(status | (1 << i));
+    for (int i = 3; i < 8; ++i) {
+        if (changed & (1 << i))
+            m_pLogic[i + 8]->setHigh(status & (1 << i));
+    }
 }
 
 void ParallelPortComponent::drawShape(QPainter &p)
@@ -15,6 +15,7 @@
 #include "logic.h"
 
 class ParallelPort;
+class QTimer;
 
 /**
 @author David Saxton
@@ -28,14 +29,14 @@ public:
     static Item *construct(ItemDocument *itemDocument, bool newItem, const char *id);
     static LibraryItem *libraryItem();
 
-    void stepNonLogic() override;
-    bool doesStepNonLogic() const override
-    {
-        return true;
-    }
-
 protected:
     void initPort(const QString &port);
+    /**
+     * Reads the Status register, and passes on the bits that have changed
+     * to the outputs. Called from m_pPollTimer, at the rate set by the
+     * "pollInterval" property, rather than at every step of the simulation.
+     */
+    void pollStatus();
     void dataChanged() override;
     void drawShape(QPainter &p) override;
 public: // internal interfaces
@@ -46,6 +47,8 @@ protected:
     LogicOut *m_pLogic[24];
 
     ParallelPort *m_pParallelPort;
+    QTimer *m_pPollTimer;
+    uchar m_status; ///< the Status register as last passed on to the outputs
 };
 
 #endif
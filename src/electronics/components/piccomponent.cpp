@@ -24,14 +24,18 @@
 #include "piccomponentpin.h"
 #include "picinfo.h"
 #include "projectmanager.h"
+#include "simulator.h"
 
 #include <KLocalizedString>
 #include <KMessageBox>
 
+#include <QDataStream>
 #include <QIcon>
 #include <QPointer>
 #include <QStringList>
 
+#include <algorithm>
+
 #include "gpsim/ioports.h"
 #include "gpsim/pic-processor.h"
 
@@ -65,6 +69,11 @@ PICComponent::PICComponent(ICNDocument *icnDocument, bool newItem, const char *i
     m_bCreatedInitialPackage = false;
     m_bLoadingProgram = false;
     m_pGpsim = nullptr;
+    m_pInterpreter = nullptr;
+    m_bInterpret = false;
+    m_bInterpreterRunning = false;
+    m_pSimulator = Simulator::self();
+    m_pInterpreterCallback = new ComponentCallback(this, static_cast<VoidCallbackPtr>(&PICComponent::stepInterpreter));
 
     addButton("run", QRect(), QIcon::fromTheme("media-playback-start"));
     addButton("pause", QRect(), QIcon::fromTheme("media-playback-pause"));
@@ -93,6 +102,17 @@ PICComponent::PICComponent(ICNDocument *icnDocument, bool newItem, const char *i
     });
     property("program")->setFileFilters(fileFilters);
 
+    createProperty("clock", Variant::Type::Double);
+    property("clock")->setUnit("Hz");
+    property("clock")->setCaption(i18n("Clock Frequency"));
+    property("clock")->setMinValue(1e3);
+    property("clock")->setMaxValue(1e9);
+    property("clock")->setValue(4e6);
+
+    createProperty("interpret", Variant::Type::Bool);
+    property("interpret")->setCaption(i18n("Interpret FlowCode"));
+    property("interpret")->setValue(false);
+
     // Used for restoring the pins on file loading before we have had a change
     // to compile the PIC program
     createProperty("lastPackage", Variant::Type::String);
@@ -115,6 +135,8 @@ PICComponent::PICComponent(ICNDocument *icnDocument, bool newItem, const char *i
 
 PICComponent::~PICComponent()
 {
+    deleteInterpreter();
+    delete m_pInterpreterCallback;
     deletePICComponentPins();
     delete m_pGpsim;
 }
@@ -122,7 +144,13 @@ PICComponent::~PICComponent()
 void PICComponent::dataChanged()
 {
     qCDebug(KTL_LOG);
-    initPIC(false);
+    if (m_pGpsim)
+        m_pGpsim->setClockFrequency(dataDouble("clock"));
+    if (m_pInterpreter) {
+        SimulationLocker locker(m_pSimulator);
+        m_pInterpreter->setInstructionTime(instructionTime());
+    }
+    initPIC((m_bInterpret != dataBool("interpret")) && dataString("program").endsWith(".flowcode"));
 }
 
 void PICComponent::initPIC(bool forceReload)
@@ -149,6 +177,8 @@ void PICComponent::initPIC(bool forceReload)
 
     delete m_pGpsim;
     m_pGpsim = nullptr;
+    deleteInterpreter();
+    m_bInterpret = dataBool("interpret");
 
     switch (GpsimProcessor::isValidProgramFile(newProgram)) {
     case GpsimProcessor::DoesntExist:
@@ -170,7 +200,10 @@ void PICComponent::initPIC(bool forceReload)
 
     case GpsimProcessor::Valid:
         m_picFile = newProgram;
-        m_symbolFile = createSymbolFile();
+        if (m_bInterpret && newProgram.endsWith(".flowcode"))
+            loadInterpreter();
+        else
+            m_symbolFile = createSymbolFile();
         break;
     }
 
@@ -260,7 +293,7 @@ void PICComponent::attachPICComponentPins()
 
     const PICComponentPinMap::iterator end = m_picComponentPinMap.end();
     for (PICComponentPinMap::iterator it = m_picComponentPinMap.begin(); it != end; ++it)
-        it.value()->attach(picProcessor->get_pin(it.key()));
+        it.value()->attach(m_pGpsim, picProcessor->get_pin(it.key()));
 }
 
 void PICComponent::slotUpdateFileList()
@@ -302,6 +335,23 @@ void PICComponent::buttonStateChanged(const QString &id, bool state)
         return;
     }
 
+    if (m_pInterpreter) {
+        SimulationLocker locker(m_pSimulator);
+        if (id == "run")
+            setInterpreterRunning(true);
+
+        else if (id == "pause")
+            setInterpreterRunning(false);
+
+        else if (id == "reset") {
+            m_pInterpreter->reset(m_pSimulator->fineTime());
+            setInterpreterRunning(m_bInterpreterRunning);
+        }
+
+        slotUpdateBtns();
+        return;
+    }
+
     if (!m_pGpsim)
         return;
 
@@ -323,6 +373,43 @@ void PICComponent::buttonStateChanged(const QString &id, bool state)
     slotUpdateBtns();
 }
 
+void PICComponent::saveSimulationState(QDataStream &stream) const
+{
+    Component::saveSimulationState(stream);
+
+    // The symbol file tells whether the same program is still loaded
+    const bool hasProgram = m_pGpsim && (m_pGpsim->codLoadStatus() == GpsimProcessor::CodSuccess);
+    stream << hasProgram;
+    if (!hasProgram)
+        return;
+
+    stream << m_symbolFile << m_pGpsim->isRunning();
+    m_pGpsim->saveState(stream);
+}
+
+bool PICComponent::restoreSimulationState(QDataStream &stream)
+{
+    if (!Component::restoreSimulationState(stream))
+        return false;
+
+    bool hasProgram;
+    stream >> hasProgram;
+    if (!hasProgram)
+        return true;
+
+    QString symbolFile;
+    bool isRunning;
+    stream >> symbolFile >> isRunning;
+    if (!m_pGpsim || (m_pGpsim->codLoadStatus() != GpsimProcessor::CodSuccess) || (symbolFile != m_symbolFile))
+        return false;
+
+    if (!m_pGpsim->restoreState(stream))
+        return false;
+
+    m_pGpsim->setRunning(isRunning);
+    return true;
+}
+
 bool PICComponent::mouseDoubleClickEvent(const EventInfo &eventInfo)
 {
     Q_UNUSED(eventInfo);
@@ -349,7 +436,8 @@ void PICComponent::slotCODCreationSucceeded()
     m_bLoadingProgram = false;
 
     delete m_pGpsim;
-    m_pGpsim = new GpsimProcessor(m_symbolFile);
+    m_pGpsim = new GpsimProcessor(m_symbolFile, this);
+    m_pGpsim->setClockFrequency(dataDouble("clock"));
 
     if (m_pGpsim->codLoadStatus() == GpsimProcessor::CodSuccess) {
         MicroInfo *microInfo = m_pGpsim->microInfo();
@@ -380,12 +468,110 @@ void PICComponent::slotCODCreationFailed()
     slotUpdateBtns();
 }
 
+void PICComponent::loadInterpreter()
+{
+    FlowInterpreter *interpreter = new FlowInterpreter(this);
+    QString errorMessage;
+    if (!interpreter->load(m_picFile, &errorMessage)) {
+        KMessageBox::error(nullptr, i18n("Could not interpret \"%1\":\n%2", m_picFile, errorMessage));
+        delete interpreter;
+        return;
+    }
+
+    MicroInfo *microInfo = MicroLibrary::self()->microInfoWithID(interpreter->microID());
+    if (!microInfo) {
+        qCWarning(KTL_LOG) << "unknown PIC" << interpreter->microID() << ", defaulting to P16F84";
+        microInfo = MicroLibrary::self()->microInfoWithID("P16F84");
+    }
+    property("lastPackage")->setValue(microInfo->id());
+    initPackage(microInfo);
+
+    SimulationLocker locker(m_pSimulator);
+    m_pInterpreter = interpreter;
+    m_pInterpreter->setInstructionTime(instructionTime());
+    m_pInterpreter->reset(m_pSimulator->fineTime());
+    setInterpreterRunning(true);
+}
+
+void PICComponent::deleteInterpreter()
+{
+    if (!m_pInterpreter)
+        return;
+
+    if (!Simulator::isDestroyedSim()) {
+        SimulationLocker locker(m_pSimulator);
+        m_pSimulator->detachComponentCallbacks(*this);
+    }
+
+    delete m_pInterpreter;
+    m_pInterpreter = nullptr;
+    m_bInterpreterRunning = false;
+}
+
+void PICComponent::setInterpreterRunning(bool running)
+{
+    m_pSimulator->detachComponentCallbacks(*this);
+
+    m_bInterpreterRunning = running && !m_pInterpreter->isHalted();
+    if (!m_bInterpreterRunning)
+        return;
+
+    // Carry on from now, rather than catching up on the time spent paused
+    m_pInterpreter->setNextTime(std::max(m_pInterpreter->nextTime(), m_pSimulator->fineTime()));
+    m_pSimulator->scheduleEdge(m_pInterpreter->nextTime(), m_pInterpreterCallback);
+}
+
+void PICComponent::simulationResumed(long long heldFor)
+{
+    // Rather than catching up on the instructions due while held
+    if (m_bInterpreterRunning)
+        m_pInterpreter->setNextTime(m_pInterpreter->nextTime() + heldFor);
+}
+
+void PICComponent::stepInterpreter()
+{
+    m_pInterpreter->run(m_pSimulator->fineTime() + TIME_UNITS_PER_LOGIC_UPDATE);
+
+    if (m_pInterpreter->isHalted()) {
+        m_bInterpreterRunning = false;
+        QMetaObject::invokeMethod(this, "slotUpdateBtns", Qt::QueuedConnection);
+    } else
+        m_pSimulator->scheduleEdge(m_pInterpreter->nextTime(), m_pInterpreterCallback);
+}
+
+long long PICComponent::instructionTime() const
+{
+    return qRound64(4 * TIME_UNITS_PER_SECOND / dataDouble("clock"));
+}
+
+PICComponentPin *PICComponent::pinWithID(const QString &pinID) const
+{
+    for (PICComponentPin *pin : m_picComponentPinMap) {
+        if (pin->id() == pinID)
+            return pin;
+    }
+    return nullptr;
+}
+
+bool PICComponent::isHigh(const QString &pinID) const
+{
+    PICComponentPin *pin = pinWithID(pinID);
+    return pin && pin->isHigh();
+}
+
+void PICComponent::setOutput(const QString &pinID, bool isOutput, bool high)
+{
+    if (PICComponentPin *pin = pinWithID(pinID))
+        pin->setOutput(!isOutput, isOutput && high);
+}
+
 void PICComponent::programReload()
 {
     qCDebug(KTL_LOG);
 
     delete m_pGpsim;
     m_pGpsim = nullptr;
+    deleteInterpreter();
 
     initPIC(true);
 
@@ -400,9 +586,15 @@ void PICComponent::slotUpdateBtns()
         return;
     }
 
-    button("run")->setEnabled(m_pGpsim && !m_pGpsim->isRunning());
-    button("pause")->setEnabled(m_pGpsim && m_pGpsim->isRunning());
-    button("reset")->setEnabled(m_pGpsim);
+    if (m_pInterpreter) {
+        button("run")->setEnabled(!m_bInterpreterRunning && !m_pInterpreter->isHalted());
+        button("pause")->setEnabled(m_bInterpreterRunning);
+        button("reset")->setEnabled(true);
+    } else {
+        button("run")->setEnabled(m_pGpsim && !m_pGpsim->isRunning());
+        button("pause")->setEnabled(m_pGpsim && m_pGpsim->isRunning());
+        button("reset")->setEnabled(m_pGpsim);
+    }
     button("reload")->setEnabled(!m_bLoadingProgram && (dataString("program") != _def_PICComponent_fileName));
 
     canvas()->setChanged(button("run")->boundingRect());
@@ -15,10 +15,12 @@
 #ifndef NO_GPSIM
 
 #include "component.h"
+#include "flowinterpreter.h"
 
 #include <QMap>
 #include <QPointer>
 
+class ComponentCallback;
 class Document;
 class ECNode;
 class GpsimProcessor;
@@ -30,15 +32,19 @@ class PIC_IOPORT;
 class PICComponent;
 class PICComponentPin;
 class PicPin;
+class Simulator;
 class TextDocument;
 
 typedef QMap<int, PICComponentPin *> PICComponentPinMap;
 
 /**
+The program is run by gpsim once it has been compiled, or for FlowCode
+programs with the "interpret" property set, by a FlowInterpreter without
+compiling it.
 @short Electronic PIC device
 @author David Saxton
 */
-class PICComponent : public Component
+class PICComponent : public Component, protected FlowInterpreter::Pins
 {
     Q_OBJECT
 public:
@@ -49,6 +55,12 @@ public:
     static LibraryItem *libraryItem();
 
     void buttonStateChanged(const QString &id, bool state) override;
+    /**
+     * Adds the state of the running program, if there is one.
+     */
+    void saveSimulationState(QDataStream &stream) const override;
+    bool restoreSimulationState(QDataStream &stream) override;
+    void simulationResumed(long long heldFor) override;
     bool mouseDoubleClickEvent(const EventInfo &eventInfo) override;
 
     void programReload();
@@ -83,12 +95,42 @@ protected:
      * Initializes the PIC from the options the user has selected.
      */
     void initPIC(bool forceReload);
+    /**
+     * Loads m_picFile into a FlowInterpreter and sets it running.
+     */
+    void loadInterpreter();
+    void deleteInterpreter();
+    /**
+     * Schedules the next part of the interpreted program to be run, or
+     * stops it from being run. The simulator must be locked.
+     */
+    void setInterpreterRunning(bool running);
+    /**
+     * Called from the simulator to run the parts of the interpreted program
+     * that are due in this logic update.
+     */
+    void stepInterpreter();
+    /**
+     * @return the time an instruction cycle takes at the clock frequency
+     */
+    long long instructionTime() const;
+    PICComponentPin *pinWithID(const QString &pinID) const;
+
+    // BEGIN FlowInterpreter::Pins
+    bool isHigh(const QString &pinID) const override;
+    void setOutput(const QString &pinID, bool isOutput, bool high) override;
+    // END FlowInterpreter::Pins
 
     QPointer<GpsimProcessor> m_pGpsim;
     QString m_picFile;      ///< The input program that the user selected
     QString m_symbolFile;   ///< The symbol file that was generated from m_picFile
     bool m_bLoadingProgram; ///< True between createSymbolFile being called and the file being created
     PICComponentPinMap m_picComponentPinMap;
+    FlowInterpreter *m_pInterpreter; ///< Runs m_picFile in place of gpsim when it is being interpreted
+    ComponentCallback *m_pInterpreterCallback;
+    Simulator *m_pSimulator;
+    bool m_bInterpret; ///< Whether m_picFile was loaded to be interpreted
+    bool m_bInterpreterRunning;
     bool m_bCreatedInitialPackage; ///< Set true once the initial package is loaded; until then, will load a package from the lastPackage data
     static QString _def_PICComponent_fileName;
 };
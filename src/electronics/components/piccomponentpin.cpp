@@ -11,6 +11,7 @@
 #include "config.h"
 #ifndef NO_GPSIM
 
+#include "gpsimprocessor.h"
 #include "micropackage.h"
 #include "piccomponent.h"
 #include "piccomponentpin.h"
@@ -27,6 +28,9 @@ PICComponentPin::PICComponentPin(PICComponent *picComponent, PicPin picPin)
 {
     m_gOutHigh = 0.0;
     m_gOutLow = 0.0;
+    m_bSyncedOutput = false;
+    m_bOutputIsInput = false;
+    m_bOutputDrivingState = false;
     m_picPin = picPin;
     m_pPICComponent = picComponent;
     m_pLogicOut = nullptr;
@@ -84,10 +88,13 @@ PICComponentPin::~PICComponentPin()
         m_pLogicOut->setCallback2(nullptr, nullptr);
     }
 
+    if (m_pGpsim)
+        m_pGpsim->cancelPinUpdate(this);
+
     delete m_pStimulusNode;
 }
 
-void PICComponentPin::attach(IOPIN *iopin)
+void PICComponentPin::attach(GpsimProcessor *gpsim, IOPIN *iopin)
 {
     if (!iopin) {
         qCWarning(KTL_LOG) << " iopin is nullptr";
@@ -104,6 +111,7 @@ void PICComponentPin::attach(IOPIN *iopin)
         return;
     }
 
+    m_pGpsim = gpsim;
     m_pIOPIN = iopin;
     m_pStimulusNode = new Stimulus_Node(m_id.toLatin1());
     m_pStimulusNode->attach_stimulus(iopin);
@@ -134,16 +142,42 @@ void PICComponentPin::set_nodeVoltage(double v)
     if (!m_pLogicOut || !m_pIOPIN)
         return;
 
-    if (m_pIOPIN->get_direction() == IOPIN::DIR_INPUT) {
+    // gpsim calls this whenever the node is updated, e.g. for every write to
+    // the port, so only pass on what has actually changed
+    const bool isInput = (m_pIOPIN->get_direction() == IOPIN::DIR_INPUT);
+    const bool drivingState = !isInput && m_pIOPIN->getDrivingState();
+    setOutput(isInput, drivingState);
+}
+
+void PICComponentPin::setOutput(bool isInput, bool drivingState)
+{
+    if (!m_pLogicOut)
+        return;
+
+    if (m_bSyncedOutput && (isInput == m_bOutputIsInput) && (drivingState == m_bOutputDrivingState))
+        return;
+
+    m_bSyncedOutput = true;
+    m_bOutputIsInput = isInput;
+    m_bOutputDrivingState = drivingState;
+
+    if (isInput) {
         m_pLogicOut->setOutputHighConductance(0.0);
         m_pLogicOut->setOutputLowConductance(0.0);
     } else {
-        m_pLogicOut->setHigh(m_pIOPIN->getDrivingState());
+        m_pLogicOut->setHigh(drivingState);
         m_pLogicOut->setOutputHighConductance(m_gOutHigh);
         m_pLogicOut->setOutputLowConductance(m_gOutLow);
     }
 }
 
+bool PICComponentPin::isHigh() const
+{
+    if (m_pLogicOut)
+        return m_pLogicOut->isHigh();
+    return m_pLogicIn && m_pLogicIn->isHigh();
+}
+
 void PICComponentPin::logicCallback(bool state)
 {
     if (!m_pIOPIN)
@@ -155,17 +189,31 @@ void PICComponentPin::logicCallback(bool state)
     if (m_pIOPIN->get_direction() == IOPIN::DIR_INPUT) {
         Zth = 1e5;
 
-        m_pIOPIN->setDrivenState(state);
-        if (m_pStimulusNode)
-            m_pStimulusNode->update();
+        if (m_pGpsim)
+            m_pGpsim->queuePinUpdate(this);
+        else
+            updateDrivenState();
     } else
         Zth = 0;
 }
 
+void PICComponentPin::updateDrivenState()
+{
+    if (!m_pIOPIN || (m_pIOPIN->get_direction() != IOPIN::DIR_INPUT))
+        return;
+
+    m_pIOPIN->setDrivenState(bDrivingState);
+    if (m_pStimulusNode)
+        m_pStimulusNode->update();
+}
+
 void PICComponentPin::resetOutput()
 {
     if (m_pLogicOut)
         m_pLogicOut->setHigh(false);
+
+    // The output no longer shows what the processor last drove
+    m_bSyncedOutput = false;
 }
 
 #endif
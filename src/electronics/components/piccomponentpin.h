@@ -17,8 +17,11 @@
 #include "gpsim/stimuli.h"
 #include "logic.h"
 
+#include <QPointer>
 #include <QString>
 
+class GpsimProcessor;
+
 /**
 @short Controls a pin on the PIC component
 @author David Saxton
@@ -31,7 +34,7 @@ public:
     /**
      * Attach this to gpsim
      */
-    void attach(IOPIN *iopin);
+    void attach(GpsimProcessor *gpsim, IOPIN *iopin);
     /**
      * Called when the IOPIN this class is associated with changes state.
      * Updates the associated LogicOut / LogicIn / etc according to what
@@ -39,9 +42,30 @@ public:
      */
     void set_nodeVoltage(double v) override;
     /**
-     * Called from our logic pin when the logic changes state.
+     * Makes the pin an input, or an output driven to the given state. Used
+     * by set_nodeVoltage, and by PICComponent in place of the IOPIN when the
+     * program is being interpreted.
+     */
+    void setOutput(bool isInput, bool drivingState);
+    /**
+     * @return the logic state of the node the pin is connected to
+     */
+    bool isHigh() const;
+    QString id() const
+    {
+        return m_id;
+    }
+    /**
+     * Called from our logic pin when the logic changes state. If the pin is
+     * an input, the new state is queued with the GpsimProcessor to be passed
+     * on before its next instruction.
      */
     void logicCallback(bool state);
+    /**
+     * Passes the state queued by logicCallback on to the IOPIN. Called from
+     * GpsimProcessor::flushPinUpdates.
+     */
+    void updateDrivenState();
     /**
      * Sets the output (if has one) to low. Called when the user stops the
      * PIC.
@@ -55,7 +79,14 @@ protected:
     double m_gOutHigh;
     double m_gOutLow;
 
+    // What set_nodeVoltage last passed on to the logic output, so that it
+    // only touches the output when the processor side has changed
+    bool m_bSyncedOutput;
+    bool m_bOutputIsInput;
+    bool m_bOutputDrivingState;
+
     PicPin m_picPin;
+    QPointer<GpsimProcessor> m_pGpsim;
     IOPIN *m_pIOPIN;
     LogicOut *m_pLogicOut;
     LogicIn *m_pLogicIn;
@@ -9,12 +9,14 @@
  ***************************************************************************/
 
 #include "probe.h" //HACK: This has to be included before the oscilloscope headers
+#include "acanalysis.h"
 #include "ecnode.h"
 #include "libraryitem.h"
 #include "logic.h"
 #include "oscilloscope.h"
 #include "oscilloscopedata.h"
 #include "pin.h"
+#include "protocoldecoder.h"
 #include "simulator.h"
 #include "voltagesource.h"
 
@@ -32,6 +34,40 @@ Probe::Probe(ICNDocument *icnDocument, bool newItem, const char *id)
     createProperty("color", Variant::Type::Color);
     property("color")->setCaption(i18n("Color"));
     property("color")->setValue(QColor(Qt::black));
+
+    createProperty("depth", Variant::Type::Int);
+    property("depth")->setCaption(i18n("Samples Kept"));
+    property("depth")->setMinValue(1024);
+    property("depth")->setMaxValue(64 * 1024 * 1024);
+    property("depth")->setValue(DEFAULT_PROBE_DATA_DEPTH);
+    property("depth")->setAdvanced(true);
+
+    createProperty("trigger", Variant::Type::Select);
+    property("trigger")->setCaption(i18n("Trigger"));
+    QStringMap allowed;
+    allowed["None"] = i18n("None");
+    allowed["Rising"] = i18n("Rising Edge");
+    allowed["Falling"] = i18n("Falling Edge");
+    allowed["Either"] = i18n("Either Edge");
+    allowed["High"] = i18n("While High");
+    allowed["Low"] = i18n("While Low");
+    property("trigger")->setAllowed(allowed);
+    property("trigger")->setValue("None");
+    property("trigger")->setAdvanced(true);
+
+    createProperty("trigger_pre", Variant::Type::Double);
+    property("trigger_pre")->setCaption(i18n("Time Before Trigger"));
+    property("trigger_pre")->setUnit("s");
+    property("trigger_pre")->setMinValue(0.0);
+    property("trigger_pre")->setValue(1e-3);
+    property("trigger_pre")->setAdvanced(true);
+
+    createProperty("trigger_post", Variant::Type::Double);
+    property("trigger_post")->setCaption(i18n("Time After Trigger"));
+    property("trigger_post")->setUnit("s");
+    property("trigger_post")->setMinValue(0.0);
+    property("trigger_post")->setValue(1e-3);
+    property("trigger_post")->setAdvanced(true);
 }
 
 Probe::~Probe()
@@ -42,8 +78,27 @@ Probe::~Probe()
 void Probe::dataChanged()
 {
     m_color = dataColor("color");
-    if (p_probeData)
+    if (p_probeData) {
         p_probeData->setColor(m_color);
+        p_probeData->setDepth(dataInt("depth"));
+
+        const QString trigger = dataString("trigger");
+        ProbeData::TriggerType triggerType = ProbeData::NoTrigger;
+        if (trigger == "Rising")
+            triggerType = ProbeData::RisingEdge;
+        else if (trigger == "Falling")
+            triggerType = ProbeData::FallingEdge;
+        else if (trigger == "Either")
+            triggerType = ProbeData::EitherEdge;
+        else if (trigger == "High")
+            triggerType = ProbeData::HighLevel;
+        else if (trigger == "Low")
+            triggerType = ProbeData::LowLevel;
+
+        // Logic probes record 0 or 1, so are compared half way between
+        const double level = hasProperty("trigger_level") ? dataDouble("trigger_level") : 0.5;
+        p_probeData->setTrigger(triggerType, level, uint64_t(dataDouble("trigger_pre") * LOGIC_UPDATE_RATE), uint64_t(dataDouble("trigger_post") * LOGIC_UPDATE_RATE));
+    }
     setChanged();
 }
 // END class Probe
@@ -77,6 +132,32 @@ FloatingProbe::FloatingProbe(ICNDocument *icnDocument, bool newItem, const char
     property("lower_abs_value")->setMinValue(0.0);
     property("lower_abs_value")->setUnit("V");
     property("lower_abs_value")->setAdvanced(true);
+
+    createProperty("trigger_level", Variant::Type::Double);
+    property("trigger_level")->setCaption(i18n("Trigger Level"));
+    property("trigger_level")->setMinValue(-1e12);
+    property("trigger_level")->setMaxValue(1e12);
+    property("trigger_level")->setValue(0.0);
+    property("trigger_level")->setUnit("V");
+    property("trigger_level")->setAdvanced(true);
+
+    createProperty("sample_period", Variant::Type::Double);
+    property("sample_period")->setCaption(i18n("Sample Period"));
+    property("sample_period")->setUnit("s");
+    property("sample_period")->setMinValue(LINEAR_UPDATE_PERIOD);
+    property("sample_period")->setMaxValue(1.0);
+    property("sample_period")->setValue(LINEAR_UPDATE_PERIOD);
+    property("sample_period")->setAdvanced(true);
+
+    createProperty("decimation", Variant::Type::Select);
+    property("decimation")->setCaption(i18n("Decimation"));
+    allowed.clear();
+    allowed["Latest"] = i18n("Latest Value");
+    allowed["Average"] = i18n("Average");
+    allowed["MinMax"] = i18n("Minimum and Maximum");
+    property("decimation")->setAllowed(allowed);
+    property("decimation")->setValue("Latest");
+    property("decimation")->setAdvanced(true);
 }
 
 FloatingProbe::~FloatingProbe()
@@ -94,6 +175,14 @@ void FloatingProbe::dataChanged()
 
     m_pFloatingProbeData->setUpperAbsValue(dataDouble("upper_abs_value"));
     m_pFloatingProbeData->setLowerAbsValue(dataDouble("lower_abs_value"));
+
+    const QString decimation = dataString("decimation");
+    FloatingProbeData::Decimation decimationType = FloatingProbeData::LatestDecimation;
+    if (decimation == "Average")
+        decimationType = FloatingProbeData::AverageDecimation;
+    else if (decimation == "MinMax")
+        decimationType = FloatingProbeData::MinMaxDecimation;
+    m_pFloatingProbeData->setSampling(unsigned(qRound(dataDouble("sample_period") * LINEAR_UPDATE_RATE)), decimationType);
 }
 
 void FloatingProbe::drawShape(QPainter &p)
@@ -152,7 +241,17 @@ VoltageProbe::~VoltageProbe()
 
 void VoltageProbe::stepNonLogic()
 {
-    m_pFloatingProbeData->addDataPoint(m_pPin1->voltage() - m_pPin2->voltage());
+    m_pFloatingProbeData->addDataPoint(value());
+}
+
+double VoltageProbe::value() const
+{
+    return m_pPin1->voltage() - m_pPin2->voltage();
+}
+
+std::complex<double> VoltageProbe::acValue(const AcSolution &solution) const
+{
+    return solution.pinValue(m_pPin1) - solution.pinValue(m_pPin2);
 }
 // END class VoltageProbe
 
@@ -184,7 +283,17 @@ CurrentProbe::~CurrentProbe()
 
 void CurrentProbe::stepNonLogic()
 {
-    m_pFloatingProbeData->addDataPoint(-m_voltageSource->cbranchCurrent(0));
+    m_pFloatingProbeData->addDataPoint(value());
+}
+
+double CurrentProbe::value() const
+{
+    return -m_voltageSource->cbranchCurrent(0);
+}
+
+std::complex<double> CurrentProbe::acValue(const AcSolution &solution) const
+{
+    return -solution.branchValue(m_voltageSource, 0);
 }
 // END class CurrentProbe
 
@@ -218,6 +327,39 @@ LogicProbe::LogicProbe(ICNDocument *icnDocument, bool newItem, const char *id)
     p_probeData = p_logicProbeData = static_cast<LogicProbeData *>(registerProbe(this));
     property("color")->setValue(p_probeData->color());
 
+    createProperty("decoder", Variant::Type::Select);
+    property("decoder")->setCaption(i18n("Decoder"));
+    QStringMap allowed;
+    allowed["None"] = i18n("None");
+    allowed["UART"] = i18n("UART");
+    allowed["SPI"] = i18n("SPI");
+    allowed["I2C"] = i18n("I2C");
+    property("decoder")->setAllowed(allowed);
+    property("decoder")->setValue("None");
+    property("decoder")->setAdvanced(true);
+
+    createProperty("decoder_clock", Variant::Type::String);
+    property("decoder_clock")->setCaption(i18n("Decoder Clock Probe"));
+    property("decoder_clock")->setValue("");
+    property("decoder_clock")->setAdvanced(true);
+
+    createProperty("decoder_baud", Variant::Type::Double);
+    property("decoder_baud")->setCaption(i18n("Decoder Baud Rate"));
+    property("decoder_baud")->setUnit("Bd");
+    property("decoder_baud")->setMinValue(1.0);
+    property("decoder_baud")->setMaxValue(1e6);
+    property("decoder_baud")->setValue(9600.0);
+    property("decoder_baud")->setAdvanced(true);
+
+    createProperty("decoder_edge", Variant::Type::Select);
+    property("decoder_edge")->setCaption(i18n("Decoder Clock Edge"));
+    allowed.clear();
+    allowed["Rising"] = i18n("Rising");
+    allowed["Falling"] = i18n("Falling");
+    property("decoder_edge")->setAllowed(allowed);
+    property("decoder_edge")->setValue("Rising");
+    property("decoder_edge")->setAdvanced(true);
+
     m_pSimulator = Simulator::self();
     //m_pIn->setCallback(this, (CallbackPtr)(&LogicProbe::logicCallback));
     m_pIn->setCallback2(LogicProbe_logicCallback, this);
@@ -233,6 +375,28 @@ void LogicProbe::logicCallback(bool value)
     p_logicProbeData->addDataPoint(LogicDataPoint(value, m_pSimulator->time()));
 }
 
+double LogicProbe::value() const
+{
+    return m_pIn->isHigh() ? 1. : 0.;
+}
+
+void LogicProbe::dataChanged()
+{
+    Probe::dataChanged();
+    if (!p_logicProbeData)
+        return;
+
+    // A new decoder starts again from the oldest data kept, so only make
+    // one when its settings have changed
+    const QString protocol = dataString("decoder");
+    const QString settings = QStringList({protocol, dataString("decoder_clock"), QString::number(dataDouble("decoder_baud")), dataString("decoder_edge")}).join('\n');
+    if (settings == m_decoderSettings)
+        return;
+    m_decoderSettings = settings;
+
+    p_logicProbeData->setDecoder(ProtocolDecoder::create(p_logicProbeData, protocol, dataString("decoder_clock"), dataDouble("decoder_baud"), dataString("decoder_edge") == "Rising"));
+}
+
 void LogicProbe::drawShape(QPainter &p)
 {
     initPainter(p);
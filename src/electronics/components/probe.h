@@ -14,6 +14,9 @@
 #include <component.h>
 #include <logic.h>
 
+#include <complex>
+
+class AcSolution;
 class LogicProbeData;
 class ProbeData;
 class FloatingProbeData;
@@ -28,6 +31,29 @@ public:
     Probe(ICNDocument *icnDocument, bool newItem, const char *id = nullptr);
     ~Probe() override;
 
+    /**
+     * @return what is being probed at the moment: volts, amps, or 0 / 1
+     * for a logic probe.
+     */
+    virtual double value() const = 0;
+    /**
+     * @return the small-signal value of what is being probed, from an AC
+     * analysis of its circuit, or 0 if the probe is not in that circuit (or
+     * is a logic probe).
+     */
+    virtual std::complex<double> acValue(const AcSolution &solution) const
+    {
+        Q_UNUSED(solution);
+        return 0.;
+    }
+    /**
+     * @return the data recorded by the probe, as kept by the oscilloscope
+     */
+    ProbeData *probeData() const
+    {
+        return p_probeData;
+    }
+
 protected:
     void dataChanged() override;
 
@@ -69,6 +95,8 @@ public:
     static LibraryItem *libraryItem();
 
     void stepNonLogic() override;
+    double value() const override;
+    std::complex<double> acValue(const AcSolution &solution) const override;
 
 protected:
     Pin *m_pPin1;
@@ -88,6 +116,8 @@ public:
     static LibraryItem *libraryItem();
 
     void stepNonLogic() override;
+    double value() const override;
+    std::complex<double> acValue(const AcSolution &solution) const override;
 
 protected:
     VoltageSource *m_voltageSource;
@@ -106,13 +136,16 @@ public:
     static LibraryItem *libraryItem();
 
     void logicCallback(bool value);
+    double value() const override;
 
 protected:
+    void dataChanged() override;
     void drawShape(QPainter &p) override;
 
     LogicProbeData *p_logicProbeData;
     LogicIn *m_pIn;
     Simulator *m_pSimulator;
+    QString m_decoderSettings; // The properties the decoder was last created with
 };
 
 #endif
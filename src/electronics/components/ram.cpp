@@ -9,12 +9,27 @@
  ***************************************************************************/
 
 #include "ram.h"
+#include "canvasitemparts.h"
+#include "filefilters.h"
+#include "itemdocument.h"
 #include "libraryitem.h"
 #include "logic.h"
+#include "simulator.h"
 #include "variant.h"
 
 #include <KLocalizedString>
-#include <cmath>
+
+#include <QFile>
+#include <QFileDialog>
+#include <QIcon>
+
+static FileFilters contentsFileFilters()
+{
+    return FileFilters({
+        {i18n("Binary Files") + QLatin1String(" (*.bin)"), QStringLiteral("*.bin")},
+        {i18n("All Files"), QStringLiteral("*")},
+    });
+}
 
 void RAM_inStateChanged(void *objV, bool state) {
     RAM *objT = static_cast<RAM*>(objV);
@@ -36,7 +51,8 @@ RAM::RAM(ICNDocument *icnDocument, bool newItem, const char *id)
 {
     m_name = i18n("RAM");
 
-    // m_data = nullptr; // should be initialized by the constructor anyway
+    m_bytesPerWord = 0;
+    m_output = 0;
     m_pCS = nullptr;
     m_pOE = nullptr;
     m_pWE = nullptr;
@@ -55,7 +71,12 @@ RAM::RAM(ICNDocument *icnDocument, bool newItem, const char *id)
     property("addressSize")->setMaxValue(24);
     property("addressSize")->setValue(4);
 
-    m_data = createProperty("data", Variant::Type::Raw)->value().toBitArray();
+    createProperty("contents", Variant::Type::FileName);
+    property("contents")->setCaption(i18n("Contents File"));
+    property("contents")->setFileFilters(contentsFileFilters());
+    property("contents")->setValue("");
+
+    addButton("dump", QRect(), QIcon::fromTheme("document-save"));
 }
 
 RAM::~RAM()
@@ -64,44 +85,133 @@ RAM::~RAM()
 
 void RAM::dataChanged()
 {
-    m_wordSize = dataInt("wordSize");
-    m_addressSize = dataInt("addressSize");
+    const int wordSize = dataInt("wordSize");
+    const int addressSize = dataInt("addressSize");
+    const QString contentsFile = dataString("contents");
+
+    SimulationLocker locker;
+
+    if (wordSize != m_wordSize || addressSize != m_addressSize) {
+        initPins();
+
+        m_wordSize = wordSize;
+        m_addressSize = addressSize;
+        m_bytesPerWord = (m_wordSize + 7) / 8;
+        m_data = QByteArray(m_bytesPerWord << m_addressSize, 0);
+        m_contentsFile.clear();
+
+        // The outputs have been made again for the new word size
+        m_output = 0;
+        for (LogicOut *out : qAsConst(m_dataOut))
+            out->setHigh(false);
+    }
+
+    if (contentsFile != m_contentsFile) {
+        m_contentsFile = contentsFile;
+        if (!contentsFile.isEmpty() && !loadContents(contentsFile))
+            p_itemDocument->canvas()->setMessage(i18n("Could not read %1", contentsFile));
+    }
+
+    inStateChanged(false);
+}
+
+void RAM::buttonStateChanged(const QString &id, bool state)
+{
+    if (!state || id != "dump")
+        return;
+
+    const QString fileName = QFileDialog::getSaveFileName(nullptr, i18n("Dump RAM Contents"), QString(), contentsFileFilters().toQtStyleString());
+    if (fileName.isEmpty())
+        return;
+
+    if (!saveContents(fileName))
+        p_itemDocument->canvas()->setMessage(i18n("Could not write %1", fileName));
+}
+
+bool RAM::loadContents(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
 
-    int newSize = int(m_wordSize * std::pow(2., m_addressSize));
-    m_data.resize(newSize);
+    const QByteArray contents = file.read(m_data.size());
 
-    initPins();
+    SimulationLocker locker;
+    m_data.fill(0);
+    m_data.replace(0, contents.size(), contents);
+    inStateChanged(false);
+    return true;
+}
+
+bool RAM::saveContents(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    SimulationLocker locker;
+    return file.write(m_data) == m_data.size();
+}
+
+quint64 RAM::readWord(unsigned address) const
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(m_data.constData()) + address * m_bytesPerWord;
+    quint64 word = 0;
+    for (int i = 0; i < m_bytesPerWord; ++i)
+        word |= quint64(bytes[i]) << (8 * i);
+    return word;
+}
+
+void RAM::writeWord(unsigned address, quint64 word)
+{
+    char *bytes = m_data.data() + address * m_bytesPerWord;
+    for (int i = 0; i < m_bytesPerWord; ++i)
+        bytes[i] = char(word >> (8 * i));
+}
+
+void RAM::setOutput(quint64 word)
+{
+    quint64 changed = word ^ m_output;
+    m_output = word;
+
+    for (int i = 0; changed; ++i, changed >>= 1) {
+        if (changed & 1)
+            m_dataOut[i]->setHigh((word >> i) & 1);
+    }
 }
 
 void RAM::inStateChanged(bool newState)
 {
     Q_UNUSED(newState);
 
-    bool cs = m_pCS->isHigh();
-    bool oe = m_pOE->isHigh();
-    bool we = m_pWE->isHigh();
+    if (!m_pCS || m_data.isEmpty())
+        return;
 
-    if (!cs || !oe) {
-        for (int i = 0; i < m_wordSize; ++i)
-            m_dataOut[i]->setHigh(false);
-    }
+    const bool cs = m_pCS->isHigh();
+    const bool oe = m_pOE->isHigh();
+    const bool we = m_pWE->isHigh();
 
-    if (!cs || (!oe && !we))
+    if (!cs || (!oe && !we)) {
+        setOutput(0);
         return;
+    }
 
     unsigned address = 0;
-    for (int i = 0; i < m_addressSize; ++i)
-        address += (m_address[i]->isHigh() ? 1 : 0) << i;
+    for (int i = 0; i < m_addressSize; ++i) {
+        if (m_address[i]->isHigh())
+            address |= 1u << i;
+    }
 
     if (we) {
-        for (int i = 0; i < m_wordSize; ++i)
-            m_data[m_wordSize * address + i] = m_dataIn[i]->isHigh();
+        quint64 word = 0;
+        for (int i = 0; i < m_wordSize; ++i) {
+            if (m_dataIn[i]->isHigh())
+                word |= quint64(1) << i;
+        }
+        writeWord(address, word);
     }
 
-    if (oe) {
-        for (int i = 0; i < m_wordSize; ++i)
-            m_dataOut[i]->setHigh(m_data[m_wordSize * address + i]);
-    }
+    setOutput(oe ? readWord(address) : 0);
 }
 
 void RAM::initPins()
@@ -139,6 +249,9 @@ void RAM::initPins()
     initDIPSymbol(pins, 72);
     initDIP(pins);
 
+    button("dump")->setOriginalRect(QRect(offsetX() + (width() - 20) / 2, height() + 4 + offsetY(), 20, 20));
+    updateAttachedPositioning();
+
     ECNode *node;
 
     if (!m_pCS) {
@@ -14,10 +14,16 @@
 #include "component.h"
 #include "logic.h"
 
-#include <QBitArray>
-//#include <q3ptrvector.h>  // 2018.10.17
+#include <QByteArray>
 
 /**
+Static RAM, with chip select, output enable and write enable inputs.
+
+The contents are held packed a word at a time, in the fewest whole bytes that
+the word fits in (e.g. one byte for words of up to eight bits), with the
+lowest byte first. The contents can be loaded from a file of the same form,
+given by the "contents" property, and dumped to one with the dump button.
+
 @author David Saxton
 */
 class RAM : public CallbackClass, public Component
@@ -29,14 +35,38 @@ public:
     static Item *construct(ItemDocument *itemDocument, bool newItem, const char *id);
     static LibraryItem *libraryItem();
 
+    /**
+     * Loads the contents from the file. A file shorter than the RAM leaves
+     * the rest of it zero, and any more of it is ignored.
+     * @return false if the file could not be read
+     */
+    bool loadContents(const QString &fileName);
+    /**
+     * Writes the contents to the file.
+     * @return false if the file could not be written
+     */
+    bool saveContents(const QString &fileName) const;
+
 protected:
     void initPins();
     void dataChanged() override;
+    void buttonStateChanged(const QString &id, bool state) override;
+    quint64 readWord(unsigned address) const;
+    void writeWord(unsigned address, quint64 word);
+    /**
+     * Drives the data outputs with the word, only setting those that change.
+     */
+    void setOutput(quint64 word);
+
 public: // internal interfaces
     void inStateChanged(bool newState);
+
 protected:
+    QByteArray m_data;
+    int m_bytesPerWord;
+    QString m_contentsFile; ///< the file the contents were last loaded from
+    quint64 m_output;       ///< the word the data outputs are driven with
 
-    QBitArray m_data;
     LogicIn *m_pCS; // Chip select
     LogicIn *m_pOE; // Output enable
     LogicIn *m_pWE; // Write enable
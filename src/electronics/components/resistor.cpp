@@ -30,13 +30,14 @@ Resistor::Resistor(ICNDocument *icnDocument, bool newItem, const char *id)
     : Component(icnDocument, newItem, id ? id : "resistor")
 {
     m_name = i18n("Resistor");
+    m_bCacheBody = true;
     setSize(-16, -8, 32, 16);
 
     init1PinLeft();
     init1PinRight();
     m_resistance = createResistance(m_pPNode[0], m_pNNode[0], 1.);
 
-    createProperty("resistance", Variant::Type::Double);
+    m_pResistanceProperty = createProperty("resistance", Variant::Type::Double);
     property("resistance")->setCaption(i18n("Resistance"));
     property("resistance")->setUnit(QChar(0x3a9));
     property("resistance")->setValue(1e4);
@@ -51,7 +52,7 @@ Resistor::~Resistor()
 
 void Resistor::dataChanged()
 {
-    double resistance = dataDouble("resistance");
+    double resistance = m_pResistanceProperty->doubleValue();
 
     QString display = QString::number(resistance / getMultiplier(resistance), 'g', 3) + getNumberMag(resistance) + QChar(0x3a9);
     setDisplayText("res", display);
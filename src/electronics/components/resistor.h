@@ -31,6 +31,7 @@ protected:
     void drawShape(QPainter &p) override;
 
     Resistance *m_resistance;
+    Property *m_pResistanceProperty;
 };
 
 #endif
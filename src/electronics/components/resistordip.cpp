@@ -30,6 +30,7 @@ ResistorDIP::ResistorDIP(ICNDocument *icnDocument, bool newItem, const char *id)
     : Component(icnDocument, newItem, id ? id : "multiplexer")
 {
     m_name = i18n("Resistor DIP");
+    m_bCacheBody = true;
 
     m_resistorCount = 0;
     for (int i = 0; i < maxCount; ++i)
@@ -12,6 +12,7 @@
 
 #include "canvasitemparts.h"
 #include "ecnode.h"
+#include "itemdocument.h"
 #include "libraryitem.h"
 #include "switch.h"
 
@@ -208,6 +209,9 @@ void ECRotoSwitch::buttonStateChanged(const QString &id, bool state)
         m_curPosition = nextPos;
 
         property("cur_position")->setValue(m_curPosition);
+
+        if (itemDocument())
+            itemDocument()->requestCoalescedStateSave("position:" + id());
     }
 }
 
@@ -16,11 +16,15 @@
 #include "libraryitem.h"
 #include "pin.h"
 #include "resistance.h"
+#include "simulator.h"
 
 #include <KLocalizedString>
 
+#include <QMutexLocker>
 #include <QPainter>
+#include <QTimer>
 
+#include <algorithm>
 #include <cmath>
 
 #include <ktechlab_debug.h>
@@ -58,6 +62,25 @@ SerialPortComponent::SerialPortComponent(ICNDocument *icnDocument, bool newItem,
     setItemPoints(pa);
 
     m_pSerialPort = new SerialPort();
+    m_inputState = 0;
+
+    m_pSimulator = Simulator::self();
+    m_bUart = true;
+    m_bitTime = LOGIC_UPDATE_RATE / 9600.;
+    m_pSampleCallback = new ComponentCallback(this, static_cast<VoidCallbackPtr>(&SerialPortComponent::sampleTD));
+    m_bReceiving = false;
+    m_rxFrameStart = 0;
+    m_rxBit = 0;
+    m_rxByte = 0;
+    m_pTransmitCallback = new ComponentCallback(this, static_cast<VoidCallbackPtr>(&SerialPortComponent::transmitRD));
+    m_bSending = false;
+    m_txFrameStart = 0;
+    m_txBit = 0;
+    m_txByte = 0;
+
+    m_pPollTimer = new QTimer(this);
+    m_pPollTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_pPollTimer, &QTimer::timeout, this, &SerialPortComponent::pollInputs);
 
     ECNode *pin = nullptr;
 
@@ -66,10 +89,10 @@ SerialPortComponent::SerialPortComponent(ICNDocument *icnDocument, bool newItem,
     addDisplayText("CD", QRect(-28, 24, 28, 16), "CD", true, Qt::AlignLeft | Qt::AlignVCenter);
     m_pCD = createLogicOut(pin, false);
 
-    // Doesn't work
-    // 	pin = createPin( -40,  16,   0, "RD" );
+    // Works (with UART framing); idles high
+    pin = createPin(-40, 16, 0, "RD");
     addDisplayText("RD", QRect(-28, 8, 28, 16), "RD", true, Qt::AlignLeft | Qt::AlignVCenter);
-    // 	m_pRD = createLogicOut( pin, false  );
+    m_pRD = createLogicOut(pin, true);
 
     // Works
     pin = createPin(-40, 0, 0, "TD");
@@ -118,91 +141,184 @@ SerialPortComponent::SerialPortComponent(ICNDocument *icnDocument, bool newItem,
     v->setAllowed(SerialPort::ports());
     v->setCaption(i18n("Port"));
 
-    // 	v = createProperty( "baudRate", Variant::Type::Select );
-    // 	v->setAllowed( QStringList::split( ",", "B0,B50,B75,B110,B134,B150,B200,B300,B600,B1200,B1800,B2400,B4800,B9600,B19200,B38400" ) );
-    // 	v->setCaption( i18n("Baud rate") );
-    // 	v->setValue("B9600");
+    v = createProperty("baudRate", Variant::Type::Select);
+    v->setAllowed(QStringList({"300", "1200", "2400", "4800", "9600", "19200", "38400", "57600", "115200"}));
+    v->setCaption(i18n("Baud rate"));
+    v->setValue("9600");
+
+    v = createProperty("uart", Variant::Type::Bool);
+    v->setCaption(i18n("UART Framing"));
+    v->setValue(true);
 }
 
 SerialPortComponent::~SerialPortComponent()
 {
+    if (!Simulator::isDestroyedSim())
+        m_pSimulator->detachComponentCallbacks(*this);
+    delete m_pSampleCallback;
+    delete m_pTransmitCallback;
     delete m_pSerialPort;
 }
 
 void SerialPortComponent::dataChanged()
 {
-#if 0
-	QString baudString = dataString("baudRate");
-	unsigned baudRate = 0;
-	
-	if ( baudString == "B0" )
-		baudRate = B0;
-	else if ( baudString == "B50" )
-		baudRate = B50;
-	else if ( baudString == "B75" )
-		baudRate = B75;
-	else if ( baudString == "B110" )
-		baudRate = B110;
-	else if ( baudString == "B134" )
-		baudRate = B134;
-	else if ( baudString == "B150" )
-		baudRate = B150;
-	else if ( baudString == "B200" )
-		baudRate = B200;
-	else if ( baudString == "B300" )
-		baudRate = B300;
-	else if ( baudString == "B600" )
-		baudRate = B600;
-	else if ( baudString == "B1200" )
-		baudRate = B1200;
-	else if ( baudString == "B1800" )
-		baudRate = B1800;
-	else if ( baudString == "B2400" )
-		baudRate = B2400;
-	else if ( baudString == "B4800" )
-		baudRate = B4800;
-	else if ( baudString == "B9600" )
-		baudRate = B9600;
-	else if ( baudString == "B19200" )
-		baudRate = B19200;
-	else if ( baudString == "B38400" )
-		baudRate = B38400;
-	else
-	{
-		qCCritical(KTL_LOG) << "Unknown baud rate = \""<<baudString<<"\"";
-		return;
-	}
-	
-	initPort( dataString("port"), baudRate );
-#endif
-
-    initPort(dataString("port"), 200);
+    const qint32 baudRate = dataString("baudRate").toInt();
+
+    {
+        // Start again with both lines idle
+        SimulationLocker locker(m_pSimulator);
+        m_pSimulator->detachComponentCallbacks(*this);
+
+        m_bUart = dataBool("uart");
+        m_bitTime = double(LOGIC_UPDATE_RATE) / std::max(baudRate, 1);
+        m_bReceiving = false;
+        m_bSending = false;
+        m_pRD->setHigh(true);
+
+        QMutexLocker bufferLocker(&m_bufferMutex);
+        m_txBuffer.clear();
+        m_rxBuffer.clear();
+    }
+
+    initPort(dataString("port"), baudRate);
 }
 
 void SerialPortComponent::initPort(const QString &port, qint32 baudRate)
 {
+    m_pPollTimer->stop();
+
     if (port.isEmpty()) {
         m_pSerialPort->closePort();
+        pollPort();
         return;
     }
 
     if (!m_pSerialPort->openPort(port, baudRate)) {
         p_itemDocument->canvas()->setMessage(i18n("Could not open port %1", port));
+        pollPort();
         return;
     }
+
+    pollPort();
+    m_pPollTimer->start(POLL_INTERVAL);
 }
 
-void SerialPortComponent::stepNonLogic()
+void SerialPortComponent::pollPort()
 {
-    m_pCD->setHigh(m_pSerialPort->getDataCarrierDetectSignal());
-    // 	m_pRD->setHigh(m_pSerialPort->getSecondaryReceivedDataSignal());
-    m_pCTS->setHigh(m_pSerialPort->getClearToSendSignal());
-    m_pRI->setHigh(m_pSerialPort->getRingIndicatorSignal());
+    const int state = m_pSerialPort->inputSignals();
+    if (state != m_inputState) {
+        m_inputState = state;
+
+        SimulationLocker locker(m_pSimulator);
+        m_pCD->setHigh(state & SerialPort::DataCarrierDetect);
+        m_pCTS->setHigh(state & SerialPort::ClearToSend);
+        m_pRI->setHigh(state & SerialPort::RingIndicator);
+    }
+
+    if (!m_bUart)
+        return;
+
+    const QByteArray received = m_pSerialPort->readData();
+    QByteArray toSend;
+    {
+        QMutexLocker bufferLocker(&m_bufferMutex);
+        toSend.swap(m_txBuffer);
+        m_rxBuffer += received;
+    }
+    m_pSerialPort->writeData(toSend);
+
+    if (received.isEmpty())
+        return;
+
+    SimulationLocker locker(m_pSimulator);
+    if (!m_bSending) {
+        m_bSending = true;
+        m_txBit = 0;
+        m_pSimulator->scheduleCallback(m_pSimulator->time(), m_pTransmitCallback);
+    }
+}
+
+void SerialPortComponent::scheduleBit(long long frameStart, double bit, ComponentCallback *callback)
+{
+    m_pSimulator->scheduleCallback(frameStart + std::llround(bit * m_bitTime), callback);
 }
 
 void SerialPortComponent::tdCallback(bool isHigh)
 {
-    m_pSerialPort->setBreakEnabled(isHigh);
+    if (!m_bUart) {
+        m_pSerialPort->setBreakEnabled(isHigh);
+        return;
+    }
+
+    // A falling edge on the idle line is the start of a frame, which is
+    // then sampled in the middle of each bit
+    if (isHigh || m_bReceiving)
+        return;
+
+    m_bReceiving = true;
+    m_rxFrameStart = m_pSimulator->time();
+    m_rxBit = 0;
+    m_rxByte = 0;
+    scheduleBit(m_rxFrameStart, 0.5, m_pSampleCallback);
+}
+
+void SerialPortComponent::sampleTD()
+{
+    const bool isHigh = m_pTD->isHigh();
+
+    if (m_rxBit == 0) {
+        // Only a glitch if the start bit has gone already
+        if (isHigh) {
+            m_bReceiving = false;
+            return;
+        }
+    } else if (m_rxBit <= 8) {
+        if (isHigh)
+            m_rxByte |= 1 << (m_rxBit - 1);
+    } else {
+        // Frames without a stop bit are dropped
+        if (isHigh) {
+            QMutexLocker bufferLocker(&m_bufferMutex);
+            m_txBuffer += char(m_rxByte);
+        }
+        m_bReceiving = false;
+        return;
+    }
+
+    m_rxBit++;
+    scheduleBit(m_rxFrameStart, m_rxBit + 0.5, m_pSampleCallback);
+}
+
+void SerialPortComponent::transmitRD()
+{
+    if (m_txBit == 0) {
+        {
+            QMutexLocker bufferLocker(&m_bufferMutex);
+            if (m_rxBuffer.isEmpty()) {
+                m_bSending = false;
+                return;
+            }
+            m_txByte = uchar(m_rxBuffer.at(0));
+            m_rxBuffer.remove(0, 1);
+        }
+        m_txFrameStart = m_pSimulator->time();
+        m_pRD->setHigh(false);
+    } else if (m_txBit <= 8) {
+        m_pRD->setHigh(m_txByte & (1 << (m_txBit - 1)));
+    } else {
+        m_pRD->setHigh(true);
+    }
+
+    // The next frame starts once the stop bit is over
+    m_txBit = (m_txBit + 1) % 10;
+    scheduleBit(m_txFrameStart, (m_txBit == 0) ? 10 : m_txBit, m_pTransmitCallback);
+}
+
+void SerialPortComponent::simulationResumed(long long heldFor)
+{
+    // The frames are timed in logic updates
+    m_rxFrameStart += heldFor / TIME_UNITS_PER_LOGIC_UPDATE;
+    m_txFrameStart += heldFor / TIME_UNITS_PER_LOGIC_UPDATE;
 }
 
 void SerialPortComponent::dtrCallback(bool isHigh)
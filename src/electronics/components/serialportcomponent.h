@@ -14,9 +14,23 @@
 #include "component.h"
 #include "logic.h"
 
+#include <QByteArray>
+#include <QMutex>
+
+class ComponentCallback;
+class QTimer;
 class SerialPort;
+class Simulator;
 
 /**
+Connects a circuit to a real serial port. With UART framing enabled, TD is
+read as 8N1 frames at the baud rate, and the bytes are written to the port;
+and the bytes received from the port are sent out on RD. Otherwise, TD sets
+the break state of the port. The modem lines are passed straight through.
+
+The port is only touched from the GUI thread (from m_pPollTimer); the
+simulation only exchanges data with it through m_txBuffer and m_rxBuffer.
+
 @author David Saxton
 */
 class SerialPortComponent : public CallbackClass, public Component
@@ -28,21 +42,40 @@ public:
     static Item *construct(ItemDocument *itemDocument, bool newItem, const char *id);
     static LibraryItem *libraryItem();
 
-    void stepNonLogic() override;
-    bool doesStepNonLogic() const override
-    {
-        return true;
-    }
+    /**
+     * How often (in milliseconds) the port is read and written.
+     */
+    static const int POLL_INTERVAL = 1;
+
+    /** scheduled callback at the middle of each bit of a frame on TD */
+    void sampleTD();
+    /** scheduled callback at the start of each bit of a frame on RD */
+    void transmitRD();
+    void simulationResumed(long long heldFor) override;
 
 protected:
     void initPort(const QString &port, qint32 baudRate);
     void dataChanged() override;
     void drawShape(QPainter &p) override;
+    /**
+     * Reads the input lines of the port, and passes on any that have
+     * changed to the outputs; and passes the data of the UART between the
+     * port and the buffers. Called from m_pPollTimer, so that the port is
+     * read at a fixed rate rather than at every step of the simulation.
+     */
+    void pollPort();
+    /**
+     * Schedules the callback for the given bit of a frame that started at
+     * frameStart.
+     */
+    void scheduleBit(long long frameStart, double bit, ComponentCallback *callback);
+
 public: // internal interfaces
     void tdCallback(bool isHigh);
     void dtrCallback(bool isHigh);
     void dsrCallback(bool isHigh);
     void rtsCallback(bool isHigh);
+
 protected:
     LogicIn *m_pTD;
     LogicIn *m_pDTR;
@@ -50,11 +83,35 @@ protected:
     // 		LogicIn * m_pRTS;
 
     LogicOut *m_pCD;
-    // 		LogicOut * m_pRD;
+    LogicOut *m_pRD;
     LogicOut *m_pCTS;
     LogicOut *m_pRI;
 
     SerialPort *m_pSerialPort;
+    QTimer *m_pPollTimer;
+    int m_inputState; ///< the input lines last passed on, as SerialPort::InputSignal
+
+    Simulator *m_pSimulator;
+    bool m_bUart;
+    double m_bitTime; ///< unit: simulator logic update tick == 1s / LOGIC_UPDATE_RATE
+
+    // Receiving on TD
+    ComponentCallback *m_pSampleCallback;
+    bool m_bReceiving;
+    long long m_rxFrameStart;
+    int m_rxBit; ///< the bit of the frame to be sampled next, 0 being the start bit
+    uint m_rxByte;
+
+    // Sending on RD
+    ComponentCallback *m_pTransmitCallback;
+    bool m_bSending;
+    long long m_txFrameStart;
+    int m_txBit; ///< the bit of the frame to be sent next, 0 being the start bit
+    uint m_txByte;
+
+    QMutex m_bufferMutex;
+    QByteArray m_txBuffer; ///< decoded from TD, to be written to the port
+    QByteArray m_rxBuffer; ///< read from the port, to be sent on RD
 };
 
 #endif
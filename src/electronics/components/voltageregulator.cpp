@@ -32,6 +32,8 @@ LibraryItem *VoltageRegulator::libraryItem()
 VoltageRegulator::VoltageRegulator(ICNDocument *icnDocument, bool newItem, const QString &id)
     : Component(icnDocument, newItem, (!id.isEmpty()) ? id : "voltageregulator")
 {
+    m_bCacheBody = true;
+
     createProperty("voltageout", Variant::Type::Double);
     property("voltageout")->setCaption(i18n("Voltage Out"));
     property("voltageout")->setMinValue(2);
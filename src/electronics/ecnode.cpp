@@ -20,11 +20,25 @@
 #include <ktlconfig.h>
 #include <ktechlab_debug.h>
 
+#include <cmath>
+
+/// The maximum length of the voltage indicator
+static const int vLength = 8;
+
+/// The current at the middle of the current indicator
+static const double iMidPoint = 0.03;
+
+/// The maximum thickness of the current indicator
+static const int iLength = 6;
+
 ECNode::ECNode(ICNDocument *icnDocument, Node::node_type _type, int dir, const QPoint &pos, QString *_id)
     : Node(icnDocument, _type, dir, pos, _id)
 {
     m_prevV = 0;
     m_prevI = 0;
+    m_prevColor = Component::voltageColor(0).rgb();
+    m_prevBarLength = 0;
+    m_prevBarThickness = 0;
     m_pinPoint = nullptr;
     m_bShowVoltageBars = KTLConfig::showVoltageBars();
     m_bShowVoltageColor = KTLConfig::showVoltageColor();
@@ -74,21 +88,56 @@ Pin *ECNode::pin(unsigned num) const
 
 void ECNode::setNodeChanged()
 {
+    for (Pin *pin : m_pins) {
+        if (pin)
+            pin->publishDisplayState();
+    }
+
     if (!canvas() || numPins() != 1)
         return;
 
     Pin *pin = m_pins[0];
 
-    double v = pin->voltage();
-    double i = pin->current();
+    double v = pin->displayVoltage();
+    double i = pin->displayCurrent();
 
-    if (v != m_prevV || i != m_prevI) {
-        QRect r = boundingRect();
-        // 		r.setCoords( r.left()+(r.width()/2)-1, r.top()+(r.height()/2)-1, r.right()-(r.width()/2)+1, r.bottom()-(r.height()/2)+1 );
-        canvas()->setChanged(r);
-        m_prevV = v;
-        m_prevI = i;
-    }
+    if (v == m_prevV && i == m_prevI)
+        return;
+
+    m_prevV = v;
+    m_prevI = i;
+
+    // Only what is drawn of the voltage and current counts, which moves in
+    // whole steps of colour and pixels
+    const QRgb color = m_bShowVoltageColor ? Component::voltageColor(v).rgb() : m_prevColor;
+    const int barLength = m_bShowVoltageBars ? voltageBarLength(v) : 0;
+    const int barThickness = (barLength != 0) ? currentBarThickness(i) : 0;
+
+    if (color == m_prevColor && barLength == m_prevBarLength && barThickness == m_prevBarThickness)
+        return;
+
+    m_prevColor = color;
+    m_prevBarLength = barLength;
+    m_prevBarThickness = barThickness;
+
+    QRect r = boundingRect();
+    // 		r.setCoords( r.left()+(r.width()/2)-1, r.top()+(r.height()/2)-1, r.right()-(r.width()/2)+1, r.bottom()-(r.height()/2)+1 );
+    canvas()->setChanged(r);
+}
+
+int ECNode::voltageBarLength(double v)
+{
+    double prop = Component::voltageLength(v);
+    if (v > 0)
+        prop *= -1.0;
+
+    return int(vLength * prop);
+}
+
+int ECNode::currentBarThickness(double i)
+{
+    const double prop = 1 - iMidPoint / (iMidPoint + std::abs(i));
+    return int((iLength - 2) * prop + 2);
 }
 
 void ECNode::setParentItem(CNItem *parentItem)
@@ -218,10 +267,10 @@ QPoint ECNode::findConnectorDivergePoint(bool *found)
             continue;
 
         if (gotP1) {
-            p2 = (*it)->connectorPoints(at < inSize);
+            p2 = (*it)->connectorCellPoints(at < inSize);
             gotP2 = true;
         } else {
-            p1 = (*it)->connectorPoints(at < inSize);
+            p1 = (*it)->connectorCellPoints(at < inSize);
             gotP1 = true;
         }
     }
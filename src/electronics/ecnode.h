@@ -85,7 +85,23 @@ public:
     {
         m_bShowVoltageColor = show;
     }
+    /**
+     * Publishes the voltage and current of the pins for drawing (see
+     * Pin::publishDisplayState), and marks the node as needing to be redrawn
+     * if what it shows of them (the voltage colour and the voltage bar) has
+     * changed since it was last drawn. Called with the simulation locked.
+     */
     void setNodeChanged();
+    /**
+     * @return the length in pixels of the voltage bar drawn for a pin at the
+     * voltage v (negative for positive voltages, as the bar points up)
+     */
+    static int voltageBarLength(double v);
+    /**
+     * @return the thickness in pixels of the voltage bar drawn for a pin
+     * with the current i flowing into it
+     */
+    static int currentBarThickness(double i);
 
     /**
      * Returns true if this node is connected (or is the same as) the node given
@@ -169,6 +185,10 @@ protected:
     bool m_bShowVoltageColor;
     double m_prevV;
     double m_prevI;
+    // What is shown of m_prevV and m_prevI, as last drawn
+    QRgb m_prevColor;
+    int m_prevBarLength;
+    int m_prevBarThickness;
     KtlQCanvasRectangle *m_pinPoint;
     PinVector m_pins;
 
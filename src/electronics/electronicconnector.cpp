@@ -22,6 +22,7 @@ ElectronicConnector::ElectronicConnector(ECNode *startNode, ECNode *endNode, ICN
 {
     m_startEcNode = startNode;
     m_endEcNode = endNode;
+    m_bIsSyncingWires = false;
 
     if (startNode && endNode) {
         connect(startNode, &ECNode::numPinsChanged, this, &ElectronicConnector::syncWiresWithNodes);
@@ -39,7 +40,9 @@ void ElectronicConnector::syncWiresWithNodes()
     ECNode *startEcNode = m_startEcNode;
     ECNode *endEcNode = m_endEcNode;
 
-    if (!startEcNode || !endEcNode)
+    // Setting the pin count of a junction node at our end tells us about it
+    // again, before we have made our wires for it
+    if (!startEcNode || !endEcNode || m_bIsSyncingWires)
         return;
 
     // FIXME more dynamic_cast to avoid using type() member
@@ -58,16 +61,13 @@ void ElectronicConnector::syncWiresWithNodes()
     if (newNumWires == oldNumWires)
         return;
 
-    // Critical section? ################3
-    //	m_bIsSyncingWires = true;
+    m_bIsSyncingWires = true;
     if (isStartNodeJunction)
         startEcNode->setNumPins(newNumWires);
 
     if (isEndNodeJunction)
         endEcNode->setNumPins(newNumWires);
-
-    //	m_bIsSyncingWires = false;
-    // ####################################
+    m_bIsSyncingWires = false;
 
     if (newNumWires > oldNumWires) {
         m_wires.resize(newNumWires);
@@ -57,6 +57,8 @@ private:
     /// pointers to the endnodes of the connectors
     QPointer<ECNode> m_startEcNode;
     QPointer<ECNode> m_endEcNode;
+    /// whether syncWiresWithNodes is setting the pin counts of the end nodes
+    bool m_bIsSyncingWires;
 };
 
 #endif
@@ -18,16 +18,25 @@
 #include "language.h"
 #include "languagemanager.h"
 #include "microlibrary.h"
+#include "piccomponentpin.h"
 #include "processchain.h"
 #include "simulator.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 
 #include <KLocalizedString>
 #include <KMessageBox>
 
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QTemporaryFile>
 #include <QTextStream>
 #include <QTimer>
@@ -61,6 +70,12 @@ void quit_gui()
 {
 }
 
+/// How often the registers shown in the views are checked for changes (ms)
+static const int REGISTER_UPDATE_INTERVAL = 40;
+
+/// Changed whenever the format of the files written by GpsimDebugInfo::writeCache changes
+static const quint32 debugInfoCacheVersion = 1;
+
 // BEGIN class GpsimProcessor
 /**
 Work around a bug in gpsim: the directory in a filename is recorded twice, e.g.
@@ -88,10 +103,15 @@ GpsimProcessor::GpsimProcessor(QString symbolFile, QObject *parent)
     }
 
     m_bCanExecuteNextCycle = true;
+    m_cyclesExecuted = 0;
+    m_clockFrequency = 4e6;
+    m_cyclePeriod = TIME_UNITS_PER_LOGIC_UPDATE;
+    m_bProfiling = false;
     m_bIsRunning = false;
     m_pPicProcessor = nullptr;
     m_codLoadStatus = CodUnknown;
     m_pRegisterMemory = nullptr;
+    m_pRegisterUpdateTimer = nullptr;
     m_debugMode = GpsimDebugger::AsmDebugger;
     m_pDebugger[0] = m_pDebugger[1] = nullptr;
 
@@ -110,8 +130,22 @@ GpsimProcessor::GpsimProcessor(QString symbolFile, QObject *parent)
 
     if (codLoadStatus() == CodSuccess) {
         m_pRegisterMemory = new RegisterSet(m_pPicProcessor);
+
+        // The views are updated from the GUI rather than from the simulation
+        m_pRegisterUpdateTimer = new QTimer(this);
+        connect(m_pRegisterUpdateTimer, &QTimer::timeout, this, [this]() { m_pRegisterMemory->update(); });
+        m_pRegisterUpdateTimer->start(REGISTER_UPDATE_INTERVAL);
+        m_pDebugInfo = GpsimDebugInfo::forSymbolFile(m_symbolFile);
+
+        // Working out the lines means parsing the assembly, so it is only
+        // done when neither this session nor an earlier one has done it
+        const QStringList sources = sourceFileList();
+        const int addressSize = programMemorySize();
+        const bool haveLines = m_pDebugInfo->isComplete(addressSize) || (m_pDebugInfo->readCache(sources) && m_pDebugInfo->isComplete(addressSize));
         m_pDebugger[0] = new GpsimDebugger(GpsimDebugger::AsmDebugger, this);
         m_pDebugger[1] = new GpsimDebugger(GpsimDebugger::HLLDebugger, this);
+        if (!haveLines)
+            m_pDebugInfo->writeCache(sources);
         Simulator::self()->attachGpsimProcessor(this);
         DebugManager::self()->registerGpsim(this);
     }
@@ -122,6 +156,7 @@ GpsimProcessor::~GpsimProcessor()
     if (!Simulator::isDestroyedSim()) {
         Simulator::self()->detachGpsimProcessor(this);
     }
+    delete m_pRegisterUpdateTimer;
     delete m_pRegisterMemory;
 
     if (m_pDebugger[0])
@@ -198,6 +233,9 @@ void GpsimProcessor::setRunning(bool run)
 
 void GpsimProcessor::executeNext()
 {
+    // Also while paused, so that gpsim (and the register view) sees the pins
+    flushPinUpdates();
+
     if (!m_bIsRunning)
         return;
 
@@ -207,6 +245,7 @@ void GpsimProcessor::executeNext()
     }
 
     unsigned long long beforeExecuteCount = get_cycles().get();
+    const unsigned address = m_bProfiling ? m_pPicProcessor->pc->get_value() : 0;
 
     if (get_bp().have_interrupt()) {
         m_pPicProcessor->interrupt();
@@ -218,11 +257,63 @@ void GpsimProcessor::executeNext()
             m_bCanExecuteNextCycle = false;
     }
 
+    const unsigned long long cycles = get_cycles().get() - beforeExecuteCount;
+    m_cyclesExecuted += cycles;
+    if (m_bProfiling && (address < m_addressCycles.size()))
+        m_addressCycles[address] += cycles;
+
     currentDebugger()->checkForBreak();
+}
+
+void GpsimProcessor::setClockFrequency(double frequency)
+{
+    if (frequency <= 0.)
+        return;
+
+    SimulationLocker locker;
+    m_clockFrequency = frequency;
+    m_cyclePeriod = std::max(1LL, (long long)std::llround(4. * TIME_UNITS_PER_SECOND / frequency));
+}
+
+void GpsimProcessor::setProfiling(bool profiling)
+{
+    SimulationLocker locker;
+    m_bProfiling = profiling;
+    if (profiling)
+        m_addressCycles.assign(programMemorySize(), 0);
+    else {
+        m_addressCycles.clear();
+        m_addressCycles.shrink_to_fit();
+    }
+}
 
-    // Let's also update the values of RegisterInfo every 25 milliseconds
-    if ((beforeExecuteCount % 10000) == 0)
-        registerMemory()->update();
+void GpsimProcessor::resetProfile()
+{
+    SimulationLocker locker;
+    std::fill(m_addressCycles.begin(), m_addressCycles.end(), 0);
+}
+
+void GpsimProcessor::queuePinUpdate(PICComponentPin *pin)
+{
+    if (std::find(m_pendingPins.begin(), m_pendingPins.end(), pin) == m_pendingPins.end())
+        m_pendingPins.push_back(pin);
+}
+
+void GpsimProcessor::cancelPinUpdate(PICComponentPin *pin)
+{
+    m_pendingPins.erase(std::remove(m_pendingPins.begin(), m_pendingPins.end(), pin), m_pendingPins.end());
+}
+
+void GpsimProcessor::flushPinUpdates()
+{
+    if (m_pendingPins.empty())
+        return;
+
+    // Updating a node can call back into the pins, so take the queue first
+    std::vector<PICComponentPin *> pins;
+    pins.swap(m_pendingPins);
+    for (PICComponentPin *pin : pins)
+        pin->updateDrivenState();
 }
 
 void GpsimProcessor::reset()
@@ -236,6 +327,64 @@ void GpsimProcessor::reset()
     }
 }
 
+void GpsimProcessor::saveState(QDataStream &stream) const
+{
+    const unsigned registerCount = m_pPicProcessor->rma.get_size();
+    stream << quint32(registerCount);
+    for (unsigned i = 0; i < registerCount; ++i)
+        stream << quint32(m_pPicProcessor->rma[i].value.data);
+
+    stream << quint32(m_pPicProcessor->Wreg->value.data);
+    stream << quint32(m_pPicProcessor->pc->get_value());
+
+    const unsigned stackSize = m_pPicProcessor->stack->stack_mask + 1;
+    stream << quint32(stackSize);
+    for (unsigned i = 0; i < stackSize; ++i)
+        stream << quint32(m_pPicProcessor->stack->contents[i]);
+    stream << quint32(m_pPicProcessor->stack->pointer);
+
+    stream << m_bCanExecuteNextCycle;
+}
+
+bool GpsimProcessor::restoreState(QDataStream &stream)
+{
+    quint32 registerCount;
+    stream >> registerCount;
+    if (registerCount != m_pPicProcessor->rma.get_size())
+        return false;
+
+    quint32 value;
+    for (unsigned i = 0; i < registerCount; ++i) {
+        stream >> value;
+        m_pPicProcessor->rma[i].value.data = value;
+    }
+
+    stream >> value;
+    m_pPicProcessor->Wreg->value.data = value;
+    stream >> value;
+    m_pPicProcessor->pc->put_value(value);
+
+    quint32 stackSize;
+    stream >> stackSize;
+    if (stackSize != m_pPicProcessor->stack->stack_mask + 1)
+        return false;
+    for (unsigned i = 0; i < stackSize; ++i) {
+        stream >> value;
+        m_pPicProcessor->stack->contents[i] = value;
+    }
+    stream >> value;
+    m_pPicProcessor->stack->pointer = value;
+
+    stream >> m_bCanExecuteNextCycle;
+
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    m_pRegisterMemory->update();
+    emitLineReached();
+    return true;
+}
+
 MicroInfo *GpsimProcessor::microInfo() const
 {
     if (!m_pPicProcessor) {
@@ -393,18 +542,10 @@ GpsimDebugger::GpsimDebugger(Type type, GpsimProcessor *gpsim)
     m_addressToLineMap = nullptr;
     m_stackLevelLowerBreak = -1;
     m_addressSize = 0;
+    m_bHasBreakpoints = false;
 
     connect(m_pGpsim, &GpsimProcessor::runningStatusChanged, this, &GpsimDebugger::gpsimRunningStatusChanged);
 
-    if (type == HLLDebugger) {
-        const QStringList sourceFileList = m_pGpsim->sourceFileList();
-        QStringList::const_iterator sflEnd = sourceFileList.end();
-        for (QStringList::const_iterator it = sourceFileList.begin(); it != sflEnd; ++it) {
-            AsmParser p(*it);
-            p.parse(this);
-        }
-    }
-
     initAddressToLineMap();
 }
 
@@ -457,20 +598,59 @@ void GpsimDebugger::initAddressToLineMap()
 {
     m_addressSize = m_pGpsim->programMemorySize();
 
+    const GpsimDebugInfo *debugInfo = m_pGpsim->m_pDebugInfo.data();
+    if (debugInfo->addressLines[m_type].size() != int(m_addressSize))
+        findAddressLines();
+
     delete[] m_addressToLineMap;
     m_addressToLineMap = new DebugLine *[m_addressSize];
     memset(m_addressToLineMap, 0, m_addressSize * sizeof(DebugLine *));
 
+    // The DebugLines hold the breakpoints, so they are not shared
+    const QVector<SourceLine> &lines = debugInfo->lines[m_type];
+    const QVector<int> &addressLines = debugInfo->addressLines[m_type];
+    QVector<DebugLine *> debugLines(lines.size(), nullptr);
+
+    for (unsigned i = 0; i < m_addressSize; ++i) {
+        const int index = addressLines[i];
+        if (index == -1)
+            continue;
+
+        if (!debugLines[index])
+            debugLines[index] = new DebugLine(lines[index].fileName(), lines[index].line());
+        m_addressToLineMap[i] = debugLines[index];
+    }
+
+    updateBreakpointAddresses();
+}
+
+void GpsimDebugger::findAddressLines()
+{
+    QVector<SourceLine> &lines = m_pGpsim->m_pDebugInfo->lines[m_type];
+    QVector<int> &addressLines = m_pGpsim->m_pDebugInfo->addressLines[m_type];
+    lines.clear();
+    addressLines.fill(-1, m_addressSize);
+
     if (m_type == AsmDebugger) {
         for (unsigned i = 0; i < m_addressSize; ++i) {
             int line = m_pGpsim->picProcessor()->pma->get_src_line(i) - 1;
             int fileID = m_pGpsim->picProcessor()->pma->get_file_id(i);
             FileContext *fileContext = m_pGpsim->picProcessor()->files[fileID];
 
-            if (fileContext)
-                m_addressToLineMap[i] = new DebugLine(sanitizeGpsimFile(fileContext->name().c_str()), line);
+            if (fileContext) {
+                addressLines[i] = lines.size();
+                lines.append(SourceLine(sanitizeGpsimFile(fileContext->name().c_str()), line));
+            }
         }
     } else {
+        m_sourceLineMap.clear();
+        const QStringList sourceFileList = m_pGpsim->sourceFileList();
+        QStringList::const_iterator sflEnd = sourceFileList.end();
+        for (QStringList::const_iterator it = sourceFileList.begin(); it != sflEnd; ++it) {
+            AsmParser p(*it);
+            p.parse(this);
+        }
+
         SourceLineMap::const_iterator slmEnd = m_sourceLineMap.end();
         for (SourceLineMap::const_iterator it = m_sourceLineMap.begin(); it != slmEnd; ++it) {
             SourceLineMap::const_iterator next = it;
@@ -497,19 +677,19 @@ void GpsimDebugger::initAddressToLineMap()
                 continue;
             }
 
-            DebugLine *debugLine = new DebugLine(sourceLine.fileName(), sourceLine.line());
+            const int index = lines.size();
             bool used = false;
 
             for (int i = asmFromLine; i <= asmToLine; ++i) {
                 int address = m_pGpsim->picProcessor()->pma->find_address_from_line(m_pGpsim->picProcessor()->files[fileID], i + 1);
                 if (address != -1) {
                     used = true;
-                    m_addressToLineMap[address] = debugLine;
+                    addressLines[address] = index;
                 }
             }
 
-            if (!used)
-                delete debugLine;
+            if (used)
+                lines.append(sourceLine);
         }
     }
 }
@@ -523,6 +703,8 @@ void GpsimDebugger::setBreakpoints(const QString &path, const IntList &lines)
 
         dl->setBreakpoint(lines.contains(dl->line()));
     }
+
+    updateBreakpointAddresses();
 }
 
 void GpsimDebugger::setBreakpoint(const QString &path, int line, bool isBreakpoint)
@@ -534,6 +716,68 @@ void GpsimDebugger::setBreakpoint(const QString &path, int line, bool isBreakpoi
         if ((m_addressToLineMap[i]->fileName() == path) && (line == m_addressToLineMap[i]->line()))
             m_addressToLineMap[i]->setBreakpoint(isBreakpoint);
     }
+
+    updateBreakpointAddresses();
+}
+
+void GpsimDebugger::updateBreakpointAddresses()
+{
+    m_breakpointAddresses.assign(m_addressSize, false);
+    m_bHasBreakpoints = false;
+
+    for (unsigned i = 0; i < m_addressSize; ++i) {
+        if (m_addressToLineMap[i] && m_addressToLineMap[i]->isBreakpoint()) {
+            m_breakpointAddresses[i] = true;
+            m_bHasBreakpoints = true;
+        }
+    }
+}
+
+QMap<int, unsigned long long> GpsimDebugger::lineCycles(const QString &path)
+{
+    QMap<int, unsigned long long> cycles;
+    if (!m_pGpsim->isProfiling())
+        return cycles;
+
+    for (unsigned i = 0; i < m_addressSize; ++i) {
+        DebugLine *dl = m_addressToLineMap[i];
+        const unsigned long long addressCycles = m_pGpsim->addressCycles(i);
+        if (dl && addressCycles && (dl->fileName() == path))
+            cycles[dl->line()] += addressCycles;
+    }
+
+    return cycles;
+}
+
+bool GpsimDebugger::exportProfile(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    unsigned long long total = 0;
+    for (unsigned i = 0; i < m_addressSize; ++i)
+        total += m_pGpsim->addressCycles(i);
+
+    QTextStream stream(&file);
+    stream << "address,file,line,cycles,percent\n";
+    for (unsigned i = 0; i < m_addressSize; ++i) {
+        const unsigned long long cycles = m_pGpsim->addressCycles(i);
+        if (!cycles)
+            continue;
+
+        // Lines are counted from one in the file, as editors show them
+        DebugLine *dl = m_addressToLineMap[i];
+        stream << QString("0x%1").arg(i, 4, 16, QChar('0')) << ',';
+        if (dl)
+            stream << '"' << QString(dl->fileName()).replace('"', "\"\"") << "\"," << (dl->line() + 1) << ',';
+        else
+            stream << ",,";
+        stream << cycles << ',' << QString::number(100. * cycles / total, 'f', 2) << '\n';
+    }
+
+    stream.flush();
+    return file.error() == QFile::NoError;
 }
 
 DebugLine *GpsimDebugger::currentDebugLine()
@@ -561,14 +805,26 @@ void GpsimDebugger::emitLineReached()
 
 void GpsimDebugger::checkForBreak()
 {
-    DebugLine *currentLine = m_addressToLineMap[m_pGpsim->picProcessor()->pc->get_value()];
-    int currentStackLevel = int(m_pGpsim->picProcessor()->stack->pointer & m_pGpsim->picProcessor()->stack->stack_mask);
+    // This is called after every instruction, so get out early when there
+    // is nothing to break on
+    if (!m_bHasBreakpoints && (m_stackLevelLowerBreak == -1))
+        return;
+
+    const unsigned address = m_pGpsim->picProcessor()->pc->get_value();
+    bool lineBreakpoint = m_bHasBreakpoints && (address < m_addressSize) && m_breakpointAddresses[address];
+    bool stackBreakpoint = false;
+    if (m_stackLevelLowerBreak != -1) {
+        int currentStackLevel = int(m_pGpsim->picProcessor()->stack->pointer & m_pGpsim->picProcessor()->stack->stack_mask);
+        stackBreakpoint = m_stackLevelLowerBreak >= currentStackLevel;
+    }
+
+    if (!lineBreakpoint && !stackBreakpoint)
+        return;
 
+    DebugLine *currentLine = (address < m_addressSize) ? m_addressToLineMap[address] : nullptr;
     bool ontoNextLine = m_pBreakFromOldLine != currentLine;
-    bool lineBreakpoint = currentLine ? currentLine->isBreakpoint() : false;
-    bool stackBreakpoint = m_stackLevelLowerBreak >= currentStackLevel;
 
-    if (ontoNextLine && (lineBreakpoint || stackBreakpoint))
+    if (ontoNextLine)
         m_pGpsim->setRunning(false);
 }
 
@@ -614,6 +870,7 @@ void GpsimDebugger::stackStep(int dl)
     // Reset any previous stackStep, and step
     m_pBreakFromOldLine = nullptr;
     m_stackLevelLowerBreak = -1;
+    m_pGpsim->flushPinUpdates();
     m_pGpsim->picProcessor()->step_one(false);
 
     int currentStack = m_pGpsim->picProcessor()->stack->pointer & m_pGpsim->picProcessor()->stack->stack_mask;
@@ -632,6 +889,138 @@ void GpsimDebugger::stackStep(int dl)
 }
 // END class Debugger
 
+// BEGIN class GpsimDebugInfo
+QSharedPointer<GpsimDebugInfo> GpsimDebugInfo::forSymbolFile(const QString &symbolFile)
+{
+    static QHash<QString, QWeakPointer<GpsimDebugInfo>> debugInfos;
+
+    const QFileInfo fileInfo(symbolFile);
+    const QString path = fileInfo.absoluteFilePath();
+
+    QSharedPointer<GpsimDebugInfo> debugInfo = debugInfos.value(path).toStrongRef();
+    if (debugInfo && (debugInfo->m_modified == fileInfo.lastModified()) && (debugInfo->m_size == fileInfo.size()))
+        return debugInfo;
+
+    // Forget the programs that are no longer running
+    for (QHash<QString, QWeakPointer<GpsimDebugInfo>>::iterator it = debugInfos.begin(); it != debugInfos.end();) {
+        if (it.value().isNull())
+            it = debugInfos.erase(it);
+        else
+            ++it;
+    }
+
+    debugInfo = QSharedPointer<GpsimDebugInfo>::create();
+    debugInfo->m_modified = fileInfo.lastModified();
+    debugInfo->m_size = fileInfo.size();
+
+    QFile file(path);
+    if (file.open(QIODevice::ReadOnly)) {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        if (hash.addData(&file))
+            debugInfo->m_hash = hash.result().toHex();
+    }
+
+    debugInfos.insert(path, debugInfo);
+    return debugInfo;
+}
+
+bool GpsimDebugInfo::isComplete(int addressSize) const
+{
+    return (addressLines[0].size() == addressSize) && (addressLines[1].size() == addressSize);
+}
+
+QString GpsimDebugInfo::cachePath() const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/gpsim/" + QString::fromLatin1(m_hash) + ".lines";
+}
+
+bool GpsimDebugInfo::readCache(const QStringList &sourceFiles)
+{
+    if (m_hash.isEmpty())
+        return false;
+
+    QFile cacheFile(cachePath());
+    if (!cacheFile.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&cacheFile);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint32 version;
+    QStringList files;
+    stream >> version >> files;
+    if (version != debugInfoCacheVersion || files != sourceFiles)
+        return false;
+
+    for (const QString &sourceFile : sourceFiles) {
+        qint64 size;
+        QDateTime modified;
+        stream >> size >> modified;
+        const QFileInfo sourceInfo(sourceFile);
+        if (size != sourceInfo.size() || modified != sourceInfo.lastModified())
+            return false;
+    }
+
+    // Read into separate vectors first, so that a broken cache changes nothing
+    QVector<SourceLine> cachedLines[2];
+    QVector<int> cachedAddressLines[2];
+    for (int type = 0; type < 2; ++type) {
+        quint32 count;
+        stream >> count;
+        for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+            QString fileName;
+            qint32 line;
+            stream >> fileName >> line;
+            cachedLines[type].append(SourceLine(fileName, line));
+        }
+        stream >> cachedAddressLines[type];
+
+        for (int index : qAsConst(cachedAddressLines[type])) {
+            if (index < -1 || index >= cachedLines[type].size())
+                return false;
+        }
+    }
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    for (int type = 0; type < 2; ++type) {
+        lines[type] = cachedLines[type];
+        addressLines[type] = cachedAddressLines[type];
+    }
+    return true;
+}
+
+void GpsimDebugInfo::writeCache(const QStringList &sourceFiles) const
+{
+    if (m_hash.isEmpty())
+        return;
+
+    const QString path = cachePath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile cacheFile(path);
+    if (!cacheFile.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream stream(&cacheFile);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << debugInfoCacheVersion << sourceFiles;
+    for (const QString &sourceFile : sourceFiles) {
+        const QFileInfo sourceInfo(sourceFile);
+        stream << qint64(sourceInfo.size()) << sourceInfo.lastModified();
+    }
+
+    for (int type = 0; type < 2; ++type) {
+        stream << quint32(lines[type].size());
+        for (const SourceLine &sourceLine : lines[type])
+            stream << sourceLine.fileName() << qint32(sourceLine.line());
+        stream << addressLines[type];
+    }
+
+    if (!cacheFile.commit())
+        qCWarning(KTL_LOG) << "could not write the gpsim line cache" << path;
+}
+// END class GpsimDebugInfo
+
 // BEGIN class RegisterSet
 RegisterSet::RegisterSet(pic_processor *picProcessor)
 {
@@ -639,12 +1028,12 @@ RegisterSet::RegisterSet(pic_processor *picProcessor)
     qCDebug(KTL_LOG) << "numRegisters=" << numRegisters;
     m_registers.resize(numRegisters /*, nullptr - 2018.06.02 - initialized below */);
     for (unsigned i = 0; i < numRegisters; ++i) {
-        RegisterInfo *info = new RegisterInfo(&picProcessor->rma[i]);
+        RegisterInfo *info = new RegisterInfo(this, &picProcessor->rma[i]);
         m_registers[i] = info;
         m_nameToRegisterMap[info->name()] = info;
         qCDebug(KTL_LOG) << " add register info " << info->name() << " at pos " << i << " addr " << info;
     }
-    RegisterInfo *info = new RegisterInfo(picProcessor->Wreg); // is this correct for "W" member? TODO
+    RegisterInfo *info = new RegisterInfo(this, picProcessor->Wreg); // is this correct for "W" member? TODO
     m_registers.append(info);
     m_nameToRegisterMap[info->name()] = info;
     qCDebug(KTL_LOG) << " add register info " << info->name() << " at end, addr " << info;
@@ -680,18 +1069,20 @@ RegisterInfo *RegisterSet::fromName(const QString &name)
 
 void RegisterSet::update()
 {
-    for (int i = 0; i < m_registers.size(); ++i)
-        m_registers[i]->update();
+    for (int i = 0; i < m_watchedRegisters.size(); ++i)
+        m_watchedRegisters[i]->update();
 }
 // END class RegisterSet
 
 // BEGIN class RegisterInfo
-RegisterInfo::RegisterInfo(Register *reg)
+RegisterInfo::RegisterInfo(RegisterSet *registerSet, Register *reg)
 {
     assert(reg);
+    m_pRegisterSet = registerSet;
     m_pRegister = reg;
     m_type = Invalid;
     m_prevEmitValue = 0;
+    m_watchCount = 0;
 
     switch (m_pRegister->isa()) {
     case Register::GENERIC_REGISTER:
@@ -728,6 +1119,25 @@ void RegisterInfo::update()
     }
 }
 
+void RegisterInfo::watch()
+{
+    if (m_watchCount++)
+        return;
+
+    // The watcher reads the current value itself
+    m_prevEmitValue = value();
+    m_pRegisterSet->m_watchedRegisters.append(this);
+}
+
+void RegisterInfo::unwatch()
+{
+    assert(m_watchCount > 0);
+    if (--m_watchCount)
+        return;
+
+    m_pRegisterSet->m_watchedRegisters.removeOne(this);
+}
+
 QString RegisterInfo::toString(RegisterType type)
 {
     switch (type) {
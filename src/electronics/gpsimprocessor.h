@@ -16,18 +16,27 @@
 
 #include "sourceline.h"
 
+#include <QDateTime>
 #include <QMap>
 // #include <q3valuevector.h>
 #include <QList>
 #include <QObject>
+#include <QSharedPointer>
 #include <QVector>
 
+#include <vector>
+
 class DebugLine;
+class GpsimDebugInfo;
 class GpsimProcessor;
 class MicroInfo;
+class PICComponentPin;
+class QDataStream;
 class pic_processor; // from gpsim
+class QTimer;
 class Register;
 class RegisterMemoryAccess;
+class RegisterSet;
 
 typedef QMap<SourceLine, SourceLine> SourceLineMap;
 typedef QList<int> IntList;
@@ -84,7 +93,7 @@ class RegisterInfo : public QObject
 {
     Q_OBJECT
 public:
-    RegisterInfo(Register *reg);
+    RegisterInfo(RegisterSet *registerSet, Register *reg);
 
     enum RegisterType { Invalid, Generic, File, SFR, Breakpoint };
 
@@ -103,6 +112,13 @@ public:
      * Checks to see if the value has changed; if so, emit new value.
      */
     void update();
+    /**
+     * Called by something showing the value of this register, so that
+     * RegisterSet::update checks it for changes. Each call must be matched
+     * by a call to unwatch.
+     */
+    void watch();
+    void unwatch();
 
 signals:
     void valueChanged(unsigned newValue);
@@ -110,8 +126,10 @@ signals:
 protected:
     QString m_name;
     RegisterType m_type;
+    RegisterSet *m_pRegisterSet;
     Register *m_pRegister;
     unsigned m_prevEmitValue;
+    int m_watchCount;
 };
 
 /**
@@ -125,7 +143,7 @@ public:
     ~RegisterSet();
 
     /**
-     * Calls update for each RegisterInfo in this set.
+     * Calls update for each RegisterInfo in this set that is being watched.
      */
     void update();
     /**
@@ -143,6 +161,9 @@ protected:
     typedef QMap<QString, RegisterInfo *> RegisterInfoMap;
     RegisterInfoMap m_nameToRegisterMap;
     QVector<RegisterInfo *> m_registers;
+    QVector<RegisterInfo *> m_watchedRegisters;
+
+    friend class RegisterInfo;
 };
 
 /**
@@ -222,6 +243,18 @@ public:
      * the initial stack level (instead of <= initial).
      */
     void stepOut();
+    /**
+     * Adds up the cycles the processor has spent at the program addresses
+     * of each line of the given file (see GpsimProcessor::setProfiling).
+     * @return the cycles of each line that has been run
+     */
+    QMap<int, unsigned long long> lineCycles(const QString &path);
+    /**
+     * Writes the cycles spent at each program address that has been run, with
+     * the source line of the address, as comma separated values.
+     * @return true if the file could be written
+     */
+    bool exportProfile(const QString &fileName);
 
 signals:
     /**
@@ -235,10 +268,27 @@ protected slots:
     void gpsimRunningStatusChanged(bool isRunning);
 
 protected:
+    /**
+     * Creates the DebugLines for the program addresses, working out which
+     * lines they are for first if no other processor running the program
+     * has done so.
+     */
     void initAddressToLineMap();
+    /**
+     * Works out the source lines of the program addresses for this type of
+     * debugger, and stores them in the processor's GpsimDebugInfo.
+     */
+    void findAddressLines();
     void stackStep(int dl);
     void emitLineReached();
+    /**
+     * Works out m_breakpointAddresses from the DebugLines, after the
+     * breakpoints have changed.
+     */
+    void updateBreakpointAddresses();
 
+    std::vector<bool> m_breakpointAddresses; // Whether the line at each program address has a breakpoint
+    bool m_bHasBreakpoints;          // Whether any of m_breakpointAddresses is set
     int m_stackLevelLowerBreak;      // Set by step-over, for when the stack level decreases to the one given
     SourceLine m_previousAtLineEmit; // Used for working out whether we should emit a new line reached signal
     DebugLine **m_addressToLineMap;
@@ -249,6 +299,50 @@ protected:
     SourceLineMap m_sourceLineMap; // assembly <--> High level language
 };
 
+/**
+@short The source lines of the addresses of a program
+Working out which lines the program addresses were assembled from means
+parsing the assembly files and searching gpsim's tables, so this is done once
+for each cod file and shared by all the GpsimProcessors running the program.
+*/
+class GpsimDebugInfo
+{
+public:
+    /**
+     * @return the debug info of the cod file, which is that of the other
+     * processors running it unless the file has changed since they loaded it.
+     */
+    static QSharedPointer<GpsimDebugInfo> forSymbolFile(const QString &symbolFile);
+
+    /**
+     * @return whether the lines of both debugger types have been worked out
+     * for a program of the given size.
+     */
+    bool isComplete(int addressSize) const;
+    /**
+     * Reads the lines worked out by an earlier session for a cod file with
+     * the same contents, which are kept in the cache directory.
+     * @param sourceFiles the files the lines were worked out from; the cache
+     * is not used if any of them has changed since it was written
+     * @return whether the lines were read
+     */
+    bool readCache(const QStringList &sourceFiles);
+    /**
+     * Writes the lines for readCache to use in later sessions.
+     */
+    void writeCache(const QStringList &sourceFiles) const;
+
+    QVector<SourceLine> lines[2];  // For each debugger type; each becomes one DebugLine
+    QVector<int> addressLines[2]; // For each debugger type, the index into lines of each address, or -1
+
+protected:
+    QString cachePath() const;
+
+    QDateTime m_modified; // When the cod file was modified
+    qint64 m_size;        // The size of the cod file
+    QByteArray m_hash;    // Hash of the contents of the cod file, empty if it could not be read
+};
+
 /**
 @author David Saxton
 */
@@ -324,11 +418,88 @@ public:
      * mode, then this function will do nothing.
      */
     void executeNext();
+    /**
+     * @return the number of processor cycles run by executeNext since the
+     * count was last reset (for the simulation statistics).
+     */
+    unsigned long long cyclesExecuted() const
+    {
+        return m_cyclesExecuted;
+    }
+    void resetCyclesExecuted()
+    {
+        m_cyclesExecuted = 0;
+    }
+    /**
+     * Sets the frequency of the oscillator driving the processor, which
+     * executes an instruction cycle every four periods of it. The default of
+     * 4 MHz gives one instruction cycle per logic update.
+     */
+    void setClockFrequency(double frequency);
+    /**
+     * Sets whether executeNext counts the cycles spent at each program
+     * address, for finding the hotspots of the program. Turning profiling on
+     * starts the counts again from zero.
+     */
+    void setProfiling(bool profiling);
+    bool isProfiling() const
+    {
+        return m_bProfiling;
+    }
+    /**
+     * @return the cycles spent at the program address while profiling
+     */
+    unsigned long long addressCycles(unsigned address) const
+    {
+        return (address < m_addressCycles.size()) ? m_addressCycles[address] : 0;
+    }
+    /**
+     * Sets the cycles of all the program addresses back to zero.
+     */
+    void resetProfile();
+    double clockFrequency() const
+    {
+        return m_clockFrequency;
+    }
+    /**
+     * @return the time between instruction cycles, in
+     * TIME_UNITS_PER_SECOND, at which the simulator calls executeNext.
+     */
+    long long cyclePeriod() const
+    {
+        return m_cyclePeriod;
+    }
+    /**
+     * Queues the pin to pass its state from the circuit on to gpsim before
+     * the next instruction is executed, so that a pin that changes several
+     * times between instructions only updates its gpsim node once.
+     */
+    void queuePinUpdate(PICComponentPin *pin);
+    /**
+     * Removes the pin from those waiting to pass their state on to gpsim.
+     */
+    void cancelPinUpdate(PICComponentPin *pin);
+    /**
+     * Passes the state of the queued pins on to gpsim. Called before an
+     * instruction is executed.
+     */
+    void flushPinUpdates();
     /**
      * Reset all parts of the simulation. Gpsim will not run until
      * setRunning(true) is called. Breakpoints are not affected.
      */
     void reset();
+    /**
+     * Writes the state of the program: the register memory, W, the program
+     * counter and the stack. The internal state of the peripherals (such as
+     * timer prescalers) is not kept by gpsim in a form that can be saved.
+     */
+    void saveState(QDataStream &stream) const;
+    /**
+     * Reads back the state written by saveState.
+     * @return false if the state is not for this type of processor
+     */
+    bool restoreState(QDataStream &stream);
     /**
      * Returns the microinfo describing this processor.
      */
@@ -393,11 +564,13 @@ protected:
     void emitLineReached();
 
     pic_processor *m_pPicProcessor;
+    QTimer *m_pRegisterUpdateTimer; ///< Updates the watched registers for the views
     CodLoadStatus m_codLoadStatus;
     const QString m_symbolFile;
     RegisterSet *m_pRegisterMemory;
     GpsimDebugger::Type m_debugMode;
     GpsimDebugger *m_pDebugger[2]; // Asm, HLL
+    QSharedPointer<GpsimDebugInfo> m_pDebugInfo;
 
     /**
      * We are called effectively for each cycle of the cycle of the
@@ -406,6 +579,12 @@ protected:
      * realtime simulation.
      */
     bool m_bCanExecuteNextCycle;
+    unsigned long long m_cyclesExecuted;
+    double m_clockFrequency;
+    long long m_cyclePeriod;
+    std::vector<PICComponentPin *> m_pendingPins; ///< Pins waiting for flushPinUpdates
+    bool m_bProfiling;
+    std::vector<unsigned long long> m_addressCycles; ///< The cycles spent at each program address, when profiling
 
 private:
     bool m_bIsRunning;
@@ -35,7 +35,7 @@ void JunctionNode::drawShape(QPainter &p)
 {
     initPainter(p);
 
-    double v = pin() ? pin()->voltage() : 0.0;
+    double v = pin() ? pin()->displayVoltage() : 0.0;
     QColor voltageColor = Component::voltageColor(v);
 
     QPen pen = p.pen();
@@ -22,6 +22,8 @@ Pin::Pin(ECNode *parent)
     m_pECNode = parent;
     m_voltage = 0.;
     m_current = 0.;
+    m_displayVoltage = 0.;
+    m_displayCurrent = 0.;
     m_eqId = -2;
     m_bCurrentIsKnown = false;
     m_groundType = Pin::gt_never;
@@ -107,6 +107,27 @@ public:
     {
         return m_current;
     }
+    /**
+     * Copies the voltage and current to what is drawn (see displayVoltage),
+     * which is done in the GUI thread while the simulation is locked.
+     */
+    void publishDisplayState()
+    {
+        m_displayVoltage = m_voltage;
+        m_displayCurrent = m_current;
+    }
+    /**
+     * The voltage and current when publishDisplayState was last called.
+     * Drawing code uses these, so that it does not need the simulation lock.
+     */
+    double displayVoltage() const
+    {
+        return m_displayVoltage;
+    }
+    double displayCurrent() const
+    {
+        return m_displayCurrent;
+    }
     /**
      * In many cases (such as if this pin is a ground pin), the current
      * flowing into the pin has not been calculated, and so the value
@@ -249,6 +270,8 @@ public:
 protected:
     double m_voltage;
     double m_current;
+    double m_displayVoltage;
+    double m_displayCurrent;
 
     int m_eqId;
     int m_groundType;
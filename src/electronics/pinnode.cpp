@@ -15,33 +15,8 @@
 #include <QPainter>
 #include <cmath>
 
-/// The maximum length of the voltage indicator
-const int vLength = 8;
-
-/// The current at the middle of the current indicator
-const double iMidPoint = 0.03;
-
-/// The maximum thicnkess of the current indicator
-const int iLength = 6;
-
-inline double calcIProp(const double i)
-{
-    return 1 - iMidPoint / (iMidPoint + std::abs(i));
-}
-
-inline int calcThickness(const double prop)
-{
-    return int((iLength - 2) * prop + 2);
-}
-
-inline int calcLength(double v)
-{
-    double prop = Component::voltageLength(v);
-    if (v > 0)
-        prop *= -1.0;
-
-    return int(vLength * prop);
-}
+/// The length on screen (in pixels) below which pins are not drawn
+const int minPinLength = 3;
 PinNode::PinNode(ICNDocument *icnDocument, int dir, const QPoint &pos, QString *id)
     : ECNode(icnDocument, Node::ec_pin, dir, pos, id)
 {
@@ -66,7 +41,7 @@ void PinNode::drawShape(QPainter &p)
 {
     initPainter(p);
 
-    double v = pin() ? pin()->voltage() : 0.0;
+    double v = pin() ? pin()->displayVoltage() : 0.0;
     QColor voltageColor = Component::voltageColor(v);
 
     QPen pen = p.pen();
@@ -85,14 +60,18 @@ void PinNode::drawShape(QPainter &p)
         m_pinPoint->setPen(pen.color());
     }
 
+    // Not worth drawing when zoomed out so far that the pin is a speck
+    if (drawScale(p) * std::abs(m_length) < minPinLength) {
+        deinitPainter(p);
+        return;
+    }
+
     // Now to draw on our current/voltage bar indicators
-    int length = calcLength(v);
+    int length = voltageBarLength(v);
 
     if ((numPins() == 1) && m_bShowVoltageBars && length != 0) {
         // we can assume that v != 0 as length != 0
-        double i = pin()->current();
-        double iProp = calcIProp(i);
-        int thickness = calcThickness(iProp);
+        int thickness = currentBarThickness(pin()->displayCurrent());
 
         p.setPen(QPen(voltageColor, thickness));
 
@@ -124,6 +124,40 @@ bool SerialPort::getRingIndicatorSignal()
     return m_port->pinoutSignals() & QSerialPort::RingIndicatorSignal;
 }
 
+int SerialPort::inputSignals()
+{
+    if (!m_port)
+        return 0;
+
+    const QSerialPort::PinoutSignals pinout = m_port->pinoutSignals();
+    int state = 0;
+    if (pinout & QSerialPort::DataCarrierDetectSignal)
+        state |= DataCarrierDetect;
+    if (pinout & QSerialPort::SecondaryReceivedDataSignal)
+        state |= SecondaryReceivedData;
+    if (pinout & QSerialPort::ClearToSendSignal)
+        state |= ClearToSend;
+    if (pinout & QSerialPort::RingIndicatorSignal)
+        state |= RingIndicator;
+    return state;
+}
+
+void SerialPort::writeData(const QByteArray &data)
+{
+    if (!m_port || data.isEmpty())
+        return;
+
+    m_port->write(data);
+}
+
+QByteArray SerialPort::readData()
+{
+    if (!m_port)
+        return QByteArray();
+
+    return m_port->readAll();
+}
+
 bool SerialPort::openPort(const QString &port, qint32 baudRate)
 {
     closePort();
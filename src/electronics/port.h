@@ -42,6 +42,8 @@ Abstraction for a serial port, allowing control over individual pins.
 class SerialPort : public Port
 {
 public:
+    enum InputSignal { DataCarrierDetect = 1 << 0, SecondaryReceivedData = 1 << 1, ClearToSend = 1 << 2, RingIndicator = 1 << 3 };
+
     SerialPort();
     ~SerialPort() override;
 
@@ -54,6 +56,20 @@ public:
     bool getSecondaryReceivedDataSignal();
     bool getClearToSendSignal();
     bool getRingIndicatorSignal();
+    /**
+     * @return the input lines that are high, as InputSignal OR'd together.
+     * Unlike the functions above, this reads all of them in one go.
+     */
+    int inputSignals();
+    /**
+     * Queues the data to be written to the port. The data is written out
+     * from the event loop, so this does not block.
+     */
+    void writeData(const QByteArray &data);
+    /**
+     * @return the data that has been received since the last call
+     */
+    QByteArray readData();
 
     /**
      * @see Port::ports
@@ -0,0 +1,275 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "acanalysis.h"
+#include "capacitance.h"
+#include "circuit.h"
+#include "element.h"
+#include "elementset.h"
+#include "inductance.h"
+#include "matrix.h"
+#include "pin.h"
+
+#include <QAtomicInt>
+#include <QThread>
+
+#include <algorithm>
+#include <cmath>
+
+typedef std::complex<double> Complex;
+
+// BEGIN class AcSolution
+AcSolution::AcSolution()
+    : frequency(0.)
+    , solved(false)
+    , elementSet(nullptr)
+{
+}
+
+Complex AcSolution::pinValue(Pin *pin) const
+{
+    if (!pin || !elementSet || pin->eqId() < 0 || !elementSet->circuit()->contains(pin))
+        return 0.;
+    return x[pin->eqId()];
+}
+
+Complex AcSolution::branchValue(Element *element, int branch) const
+{
+    if (!element || element->elementSet() != elementSet || branch >= element->numCBranches())
+        return 0.;
+    return x[elementSet->cnodeCount() + element->cbranch(branch)->n()];
+}
+// END class AcSolution
+
+// BEGIN class AcWorker
+/**
+Solves frequencies from the queue shared with the other workers until it is
+empty.
+*/
+class AcWorker : public QThread
+{
+public:
+    AcWorker(const AcAnalysis *analysis, const std::vector<double> &frequencies, std::vector<AcSolution> &solutions, QAtomicInt &next)
+        : m_pAnalysis(analysis)
+        , m_frequencies(frequencies)
+        , m_solutions(solutions)
+        , m_next(next)
+    {
+    }
+
+    void drain()
+    {
+        const int count = m_frequencies.size();
+        for (int i = m_next.fetchAndAddRelaxed(1); i < count; i = m_next.fetchAndAddRelaxed(1))
+            m_solutions[i] = m_pAnalysis->solve(m_frequencies[i]);
+    }
+
+protected:
+    void run() override
+    {
+        drain();
+    }
+
+    const AcAnalysis *m_pAnalysis;
+    const std::vector<double> &m_frequencies;
+    std::vector<AcSolution> &m_solutions;
+    QAtomicInt &m_next;
+};
+// END class AcWorker
+
+// BEGIN class AcAnalysis
+static int cnodeIndex(Element *element, int node)
+{
+    CNode *cnode = element->cnode(node);
+    return (!cnode || cnode->isGround) ? -1 : int(cnode->n());
+}
+
+AcAnalysis::AcAnalysis(ElementSet *elementSet)
+    : m_pElementSet(elementSet)
+{
+    m_size = elementSet->cnodeCount() + elementSet->cbranchCount();
+    m_g.assign(m_size * m_size, 0.);
+    m_excitation.assign(m_size, 0.);
+
+    const Matrix *matrix = elementSet->matrix();
+    for (unsigned i = 0; i < m_size; ++i) {
+        for (unsigned j = 0; j < m_size; ++j)
+            m_g[i * m_size + j] = matrix->g(i, j);
+    }
+
+    // Swap the companion models of the energy storage elements for their
+    // admittances
+    const unsigned n = elementSet->cnodeCount();
+    const ElementList &elements = elementSet->elements();
+    for (ElementList::const_iterator it = elements.begin(); it != elements.end(); ++it) {
+        Element *e = *it;
+        if (!e || !e->isActive())
+            continue;
+
+        if (e->type() == Element::Element_Capacitance) {
+            Capacitance *capacitance = static_cast<Capacitance *>(e);
+            const int i = cnodeIndex(e, 0);
+            const int j = cnodeIndex(e, 1);
+            addConductance(i, j, -capacitance->stampedConductance());
+            addCapacitance(i, j, capacitance->capacitance());
+        } else if (e->type() == Element::Element_Inductance) {
+            // The branch equation is v0 - v1 - r i = v_eq for the companion
+            // model, and v0 - v1 - jwL i = 0 for the admittance
+            Inductance *inductance = static_cast<Inductance *>(e);
+            const unsigned k = n + e->cbranch(0)->n();
+            m_g[k * m_size + k] += inductance->stampedResistance();
+            m_susceptances.push_back({k, k, -inductance->inductance()});
+        }
+    }
+}
+
+void AcAnalysis::addConductance(int i, int j, double g)
+{
+    if (i >= 0)
+        m_g[i * m_size + i] += g;
+    if (j >= 0)
+        m_g[j * m_size + j] += g;
+    if (i >= 0 && j >= 0) {
+        m_g[i * m_size + j] -= g;
+        m_g[j * m_size + i] -= g;
+    }
+}
+
+void AcAnalysis::addCapacitance(int i, int j, double c)
+{
+    if (i >= 0)
+        m_susceptances.push_back({unsigned(i), unsigned(i), c});
+    if (j >= 0)
+        m_susceptances.push_back({unsigned(j), unsigned(j), c});
+    if (i >= 0 && j >= 0) {
+        m_susceptances.push_back({unsigned(i), unsigned(j), -c});
+        m_susceptances.push_back({unsigned(j), unsigned(i), -c});
+    }
+}
+
+bool AcAnalysis::setSource(Element *source)
+{
+    if (!source || source->elementSet() != m_pElementSet || !source->isActive())
+        return false;
+
+    // As the signals stamp their values into b
+    std::fill(m_excitation.begin(), m_excitation.end(), 0.);
+    if (source->type() == Element::Element_VoltageSignal) {
+        m_excitation[m_pElementSet->cnodeCount() + source->cbranch(0)->n()] = 1.;
+        return true;
+    }
+    if (source->type() == Element::Element_CurrentSignal) {
+        const int i = cnodeIndex(source, 0);
+        const int j = cnodeIndex(source, 1);
+        if (i >= 0)
+            m_excitation[i] = -1.;
+        if (j >= 0)
+            m_excitation[j] = 1.;
+        return true;
+    }
+    return false;
+}
+
+AcSolution AcAnalysis::solve(double frequency) const
+{
+    AcSolution solution;
+    solution.frequency = frequency;
+    solution.elementSet = m_pElementSet;
+    solution.x.assign(m_size, 0.);
+
+    const unsigned size = m_size;
+    const double omega = 2. * M_PI * frequency;
+
+    std::vector<Complex> a(m_g.begin(), m_g.end());
+    for (std::vector<Susceptance>::const_iterator it = m_susceptances.begin(); it != m_susceptances.end(); ++it)
+        a[it->i * size + it->j] += Complex(0., omega * it->value);
+    std::vector<Complex> b(m_excitation.begin(), m_excitation.end());
+
+    // Gaussian elimination with partial pivoting; the system is small and
+    // only solved once, so it is not worth keeping the decomposition
+    for (unsigned k = 0; k < size; ++k) {
+        unsigned pivot = k;
+        double largest = std::abs(a[k * size + k]);
+        for (unsigned i = k + 1; i < size; ++i) {
+            const double value = std::abs(a[i * size + k]);
+            if (value > largest) {
+                largest = value;
+                pivot = i;
+            }
+        }
+        if (largest == 0.)
+            return solution;
+
+        if (pivot != k) {
+            std::swap_ranges(a.begin() + k * size, a.begin() + (k + 1) * size, a.begin() + pivot * size);
+            std::swap(b[k], b[pivot]);
+        }
+
+        const Complex *const rowK = &a[k * size];
+        for (unsigned i = k + 1; i < size; ++i) {
+            Complex *const row = &a[i * size];
+            if (row[k] == 0.)
+                continue;
+            const Complex factor = row[k] / rowK[k];
+            for (unsigned j = k + 1; j < size; ++j)
+                row[j] -= factor * rowK[j];
+            b[i] -= factor * b[k];
+        }
+    }
+
+    for (unsigned k = size; k-- > 0;) {
+        Complex sum = b[k];
+        for (unsigned j = k + 1; j < size; ++j)
+            sum -= a[k * size + j] * solution.x[j];
+        solution.x[k] = sum / a[k * size + k];
+    }
+
+    solution.solved = true;
+    return solution;
+}
+
+std::vector<AcSolution> AcAnalysis::solve(const std::vector<double> &frequencies, int threadCount) const
+{
+    std::vector<AcSolution> solutions(frequencies.size());
+    QAtomicInt next(0);
+
+    std::vector<AcWorker *> workers;
+    threadCount = std::min(threadCount, int(frequencies.size()) - 1);
+    for (int i = 0; i < threadCount; ++i) {
+        AcWorker *worker = new AcWorker(this, frequencies, solutions, next);
+        workers.push_back(worker);
+        worker->start();
+    }
+
+    AcWorker(this, frequencies, solutions, next).drain();
+
+    for (std::vector<AcWorker *>::iterator it = workers.begin(); it != workers.end(); ++it) {
+        (*it)->wait();
+        delete *it;
+    }
+    return solutions;
+}
+
+std::vector<double> AcAnalysis::logSpacing(double start, double stop, int points)
+{
+    std::vector<double> frequencies;
+    if (points < 1)
+        return frequencies;
+    if (points == 1) {
+        frequencies.push_back(start);
+        return frequencies;
+    }
+
+    const double ratio = std::log(stop / start);
+    for (int i = 0; i < points; ++i)
+        frequencies.push_back(start * std::exp(ratio * i / (points - 1)));
+    return frequencies;
+}
+// END class AcAnalysis
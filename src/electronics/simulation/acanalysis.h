@@ -0,0 +1,128 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef ACANALYSIS_H
+#define ACANALYSIS_H
+
+#include <complex>
+#include <vector>
+
+class Element;
+class ElementSet;
+class Pin;
+
+/**
+The small-signal nodal voltages and branch currents of a circuit at one
+frequency, as found by AcAnalysis. The values are phasors relative to the
+source, which has an amplitude of 1 (volt or amp) and a phase of 0.
+*/
+class AcSolution
+{
+public:
+    AcSolution();
+
+    /**
+     * @return the phasor of the voltage of the pin, or 0 if the pin is not
+     * in the circuit that was analysed (or is ground).
+     */
+    std::complex<double> pinValue(Pin *pin) const;
+    /**
+     * @return the phasor of the current of the branch of the element, or 0
+     * if the element is not in the circuit that was analysed.
+     */
+    std::complex<double> branchValue(Element *element, int branch) const;
+
+    double frequency;
+    bool solved; ///< false if the system was singular, when the values are all 0
+    std::vector<std::complex<double>> x;
+    ElementSet *elementSet;
+};
+
+/**
+AC (small-signal) analysis: the frequency response of a circuit to one of its
+signal sources, without having to simulate it over many periods of each
+frequency.
+
+The analysis is done around the present solution of the circuit, which should
+be its operating point (e.g. after simulating it long enough to settle, with
+the signal source at no amplitude). The matrix of the element set is then
+already linear: the nonlinear elements are stamped with their conductances
+linearised around the operating point by the Newton iteration. The companion
+models that the capacitors and inductors are stamped with for the transient
+integration are taken back out of it and replaced with their admittances,
+giving A(w) = G + jwC. The sources are all set to zero apart from the one
+being analysed, and the complex system A(w) x = b is solved for each
+frequency, with the frequencies shared out among threads.
+
+The matrix is copied when the analysis is created, so the circuit may carry on
+being simulated while it is solved.
+
+@short Small-signal frequency response of a circuit
+*/
+class AcAnalysis
+{
+public:
+    /**
+     * Takes the linearised matrix of the element set. This must be called
+     * from the simulator thread, while the circuit is not being solved.
+     */
+    AcAnalysis(ElementSet *elementSet);
+
+    /**
+     * Sets the signal (a VoltageSignal or CurrentSignal of the element set)
+     * that drives the circuit.
+     * @return false if the element is not a signal in this element set
+     */
+    bool setSource(Element *source);
+    /**
+     * Solves for the response at the frequency (in hertz). This may be
+     * called from any thread.
+     */
+    AcSolution solve(double frequency) const;
+    /**
+     * Solves for the response at each of the frequencies, with up to
+     * threadCount threads in addition to the calling thread.
+     */
+    std::vector<AcSolution> solve(const std::vector<double> &frequencies, int threadCount) const;
+    /**
+     * @return points frequencies from start to stop, evenly spaced on a
+     * logarithmic scale (as for a Bode plot).
+     */
+    static std::vector<double> logSpacing(double start, double stop, int points);
+
+protected:
+    /**
+     * The entry of the matrix that is multiplied by jw.
+     */
+    class Susceptance
+    {
+    public:
+        unsigned i, j;
+        double value;
+    };
+    /**
+     * Adds the conductance g between the cnodes i and j (either of which may
+     * be -1 for ground) to G.
+     */
+    void addConductance(int i, int j, double g);
+    /**
+     * Adds the capacitance c between the cnodes i and j (either of which may
+     * be -1 for ground) to C.
+     */
+    void addCapacitance(int i, int j, double c);
+
+    ElementSet *m_pElementSet;
+    unsigned m_size;
+    std::vector<double> m_g; ///< the real part of the matrix, by row
+    std::vector<Susceptance> m_susceptances;
+    std::vector<double> m_excitation; ///< b, for a unit source
+};
+
+#endif
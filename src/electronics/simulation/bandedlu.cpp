@@ -0,0 +1,294 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "bandedlu.h"
+
+#include <math/qkernels.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+BandedLU::BandedLU()
+    : m_size(0)
+    , m_bandwidth(0)
+{
+}
+
+void BandedLU::analyse(const std::vector<std::vector<unsigned>> &pattern, unsigned nodeCount)
+{
+    m_size = pattern.size();
+    nodeCount = std::min(nodeCount, m_size);
+
+    // The graph of the nodes, for ordering them
+    std::vector<std::vector<unsigned>> adjacency(nodeCount);
+    for (unsigned i = 0; i < nodeCount; ++i) {
+        for (unsigned j : pattern[i]) {
+            if (j < nodeCount && j != i) {
+                adjacency[i].push_back(j);
+                adjacency[j].push_back(i);
+            }
+        }
+    }
+    for (std::vector<unsigned> &neighbours : adjacency) {
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    }
+
+    const std::vector<unsigned> nodes = orderNodes(adjacency, nodeCount);
+    std::vector<unsigned> nodePosition(nodeCount);
+    for (unsigned p = 0; p < nodeCount; ++p)
+        nodePosition[nodes[p]] = p;
+
+    // Each branch goes after the last of its nodes (either way round in the
+    // pattern, in case it is not quite symmetric)
+    std::vector<int> lastNode(m_size - nodeCount, -1);
+    for (unsigned i = 0; i < m_size; ++i) {
+        for (unsigned j : pattern[i]) {
+            if (j >= m_size)
+                continue;
+            if (i < nodeCount && j >= nodeCount)
+                lastNode[j - nodeCount] = std::max(lastNode[j - nodeCount], int(nodePosition[i]));
+            else if (i >= nodeCount && j < nodeCount)
+                lastNode[i - nodeCount] = std::max(lastNode[i - nodeCount], int(nodePosition[j]));
+        }
+    }
+
+    std::vector<std::vector<unsigned>> branchesAfter(nodeCount);
+    std::vector<unsigned> unattached;
+    for (unsigned b = nodeCount; b < m_size; ++b) {
+        if (lastNode[b - nodeCount] >= 0)
+            branchesAfter[lastNode[b - nodeCount]].push_back(b);
+        else
+            unattached.push_back(b);
+    }
+
+    m_iperm.clear();
+    m_iperm.reserve(m_size);
+    for (unsigned p = 0; p < nodeCount; ++p) {
+        m_iperm.push_back(nodes[p]);
+        m_iperm.insert(m_iperm.end(), branchesAfter[p].begin(), branchesAfter[p].end());
+    }
+    m_iperm.insert(m_iperm.end(), unattached.begin(), unattached.end());
+
+    m_perm.resize(m_size);
+    for (unsigned i = 0; i < m_size; ++i)
+        m_perm[m_iperm[i]] = i;
+
+    m_bandwidth = 0;
+    for (unsigned i = 0; i < m_size; ++i) {
+        for (unsigned j : pattern[i]) {
+            if (j < m_size)
+                m_bandwidth = std::max(m_bandwidth, unsigned(std::abs(int(m_perm[i]) - int(m_perm[j]))));
+        }
+    }
+
+    m_val.assign(bandSize(), 0.);
+}
+
+std::vector<unsigned> BandedLU::orderNodes(const std::vector<std::vector<unsigned>> &adjacency, unsigned nodeCount) const
+{
+    std::vector<unsigned> order;
+    order.reserve(nodeCount);
+    std::vector<bool> numbered(nodeCount, false);
+    std::vector<int> distance(nodeCount, -1);
+    std::vector<unsigned> visited;
+
+    const auto byDegree = [&adjacency](unsigned a, unsigned b) {
+        const size_t degreeA = adjacency[a].size();
+        const size_t degreeB = adjacency[b].size();
+        return degreeA < degreeB || (degreeA == degreeB && a < b);
+    };
+
+    // Goes breadth first from the node, returning the depth of the search
+    // and setting furthest to the node of least degree in the last level
+    const auto search = [&](unsigned from, unsigned *furthest) {
+        visited.clear();
+        visited.push_back(from);
+        distance[from] = 0;
+        for (size_t head = 0; head < visited.size(); ++head) {
+            const unsigned v = visited[head];
+            for (unsigned u : adjacency[v]) {
+                if (distance[u] < 0 && !numbered[u]) {
+                    distance[u] = distance[v] + 1;
+                    visited.push_back(u);
+                }
+            }
+        }
+
+        const int depth = distance[visited.back()];
+        *furthest = visited.back();
+        for (unsigned v : visited) {
+            if (distance[v] == depth && byDegree(v, *furthest))
+                *furthest = v;
+            distance[v] = -1;
+        }
+        return depth;
+    };
+
+    for (unsigned seed = 0; seed < nodeCount; ++seed) {
+        if (numbered[seed])
+            continue;
+
+        // Start from a pseudo-peripheral node of this part of the circuit
+        // (one at the end of a longest path through it), found by going to
+        // the furthest node until that gets no further
+        unsigned start = seed;
+        int depth = -1;
+        for (int tries = 0; tries < 8; ++tries) {
+            unsigned furthest;
+            const int newDepth = search(start, &furthest);
+            if (newDepth <= depth)
+                break;
+            depth = newDepth;
+            start = furthest;
+        }
+
+        // Cuthill-McKee: breadth first, taking the neighbours of each node
+        // in order of degree
+        size_t head = order.size();
+        order.push_back(start);
+        numbered[start] = true;
+        for (; head < order.size(); ++head) {
+            const size_t first = order.size();
+            for (unsigned u : adjacency[order[head]]) {
+                if (!numbered[u]) {
+                    numbered[u] = true;
+                    order.push_back(u);
+                }
+            }
+            std::sort(order.begin() + first, order.end(), byDegree);
+        }
+    }
+
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+void BandedLU::factor(const QuickMatrix *mat, unsigned fromRow)
+{
+    const unsigned size = m_size;
+    const unsigned band = m_bandwidth;
+    const unsigned width = 2 * band + 1;
+    double *const val = m_val.data();
+
+    // Row by row, as for the dense solver: each row of the factorization
+    // only depends on the same row of the matrix and the rows before it
+    for (unsigned i = fromRow; i < size; ++i) {
+        const unsigned first = (i > band) ? i - band : 0;
+        const unsigned last = std::min(size - 1, i + band);
+
+        // The entry for (internal) column c is at row[c]
+        double *const row = val + i * width + band - i;
+        const double *const a = (*mat)[i];
+        std::fill(val + i * width, val + (i + 1) * width, 0.);
+        for (unsigned c = first; c <= last; ++c)
+            row[c] = a[m_iperm[c]];
+
+        for (unsigned k = first; k < i; ++k) {
+            const double *const pivotRow = val + k * width + band - k;
+            const double l = row[k] /= pivotRow[k];
+            if (std::abs(l) > 1e-12) {
+                const unsigned end = std::min(last, k + band);
+                QuickKernels::axpy(row + k + 1, pivotRow + k + 1, -l, end - k);
+            }
+        }
+
+        // detect singular matrixes (as in the dense factorization)...
+        double &pivot = row[i];
+        if (std::abs(pivot) < 1e-10)
+            pivot = (pivot < 0.) ? -1e-10 : 1e-10;
+    }
+}
+
+void BandedLU::solve(double *y) const
+{
+    const unsigned size = m_size;
+    const unsigned band = m_bandwidth;
+    const unsigned width = 2 * band + 1;
+    const double *const val = m_val.data();
+
+    // Forward substitution (L has a unit diagonal)
+    for (unsigned i = 1; i < size; ++i) {
+        const unsigned first = (i > band) ? i - band : 0;
+        const double *const row = val + i * width + band - i;
+        y[i] -= QuickKernels::dot(row + first, y + first, i - first);
+    }
+
+    // Back substitution
+    for (unsigned i = size; i-- > 0;) {
+        const unsigned last = std::min(size - 1, i + band);
+        const double *const row = val + i * width + band - i;
+        y[i] = (y[i] - QuickKernels::dot(row + i + 1, y + i + 1, last - i)) / row[i];
+    }
+}
+
+void BandedLU::matrixValues(const QuickMatrix *mat, std::vector<double> *values) const
+{
+    values->clear();
+    for (unsigned i = 0; i < m_size; ++i) {
+        const double *const a = (*mat)[i];
+        const unsigned first = (i > m_bandwidth) ? i - m_bandwidth : 0;
+        const unsigned last = std::min(m_size - 1, i + m_bandwidth);
+        for (unsigned c = first; c <= last; ++c)
+            values->push_back(a[m_iperm[c]]);
+    }
+}
+
+double BandedLU::pivotRatio() const
+{
+    if (m_size == 0)
+        return 1.;
+
+    const unsigned width = 2 * m_bandwidth + 1;
+    double largest = 0.;
+    double smallest = std::numeric_limits<double>::max();
+    for (unsigned i = 0; i < m_size; ++i) {
+        const double u = std::abs(m_val[i * width + m_bandwidth]);
+        largest = std::max(largest, u);
+        smallest = std::min(smallest, u);
+    }
+    return largest / smallest;
+}
+
+double BandedLU::rowProduct(const QuickMatrix *mat, unsigned row, const double *x) const
+{
+    const double *const a = (*mat)[row];
+    const unsigned first = (row > m_bandwidth) ? row - m_bandwidth : 0;
+    const unsigned last = std::min(m_size - 1, row + m_bandwidth);
+
+    double sum = 0.;
+    for (unsigned c = first; c <= last; ++c)
+        sum += a[m_iperm[c]] * x[m_iperm[c]];
+    return sum;
+}
+
+void BandedLU::display() const
+{
+    const unsigned width = 2 * m_bandwidth + 1;
+
+    for (unsigned i = 0; i < m_size; ++i) {
+        const unsigned first = (i > m_bandwidth) ? i - m_bandwidth : 0;
+        const unsigned last = std::min(m_size - 1, i + m_bandwidth);
+        for (unsigned c = first; c <= last; ++c) {
+            const double value = m_val[i * width + m_bandwidth + c - i];
+            if (c > first && value >= 0)
+                std::cout << "+";
+            std::cout << value << "(" << c << ")";
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "ordering:   ";
+    for (unsigned i = 0; i < m_size; i++) {
+        std::cout << i << "->" << m_perm[i] << "  ";
+    }
+    std::cout << std::endl;
+}
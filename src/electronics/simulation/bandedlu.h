@@ -0,0 +1,146 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef BANDEDLU_H
+#define BANDEDLU_H
+
+#include <math/qmatrix.h>
+
+#include <QtGlobal>
+
+#include <vector>
+
+/**
+Banded LU decomposition for the MNA equations, used by Matrix for circuits
+whose equations can be numbered so that every nonzero is close to the
+diagonal, as for ladders and chains of stages. Without pivoting, the fill-in
+stays within the band, so the factorization costs O(n b^2) for a half
+bandwidth of b, over contiguous rows with no indexing.
+
+Usage is as for SparseLU:
+(1) Call analyse with the sparsity pattern of the matrix, which numbers the
+    equations to narrow the band.
+(2) Call factor with the numeric values, as often as the values change.
+(3) Call solve to do forward and backward substitution.
+
+The nodes (cnodes) are numbered by reverse Cuthill-McKee, which goes through
+the graph of the circuit breadth first, so that connected nodes get numbers
+close together. As the branch rows usually have a zero diagonal, each is
+then put straight after the last of the nodes it is connected to, by which
+time its diagonal has been filled in.
+
+@short Banded LU factorization with bandwidth-reducing ordering
+*/
+class BandedLU
+{
+public:
+    BandedLU();
+
+    /**
+     * Computes the ordering and the bandwidth.
+     * @param pattern for each (external) row, the (external) columns that
+     * may be nonzero, which should be symmetric (as are the stamps of the
+     * elements).
+     * @param nodeCount the number of leading rows that are nodes; the rest
+     * are branches.
+     */
+    void analyse(const std::vector<std::vector<unsigned>> &pattern, unsigned nodeCount);
+    /**
+     * Numeric factorization.
+     * @param mat the matrix values, with the rows already permuted (i.e.
+     * row permutation()[i] of mat holds external row i) and the columns in
+     * external order.
+     * @param fromRow rows of the (internal) factorization before this are
+     * assumed to be unchanged since the last call.
+     */
+    void factor(const QuickMatrix *mat, unsigned fromRow = 0);
+    /**
+     * Forward and backward substitution, in place. y is indexed by the
+     * internal (permuted) numbering.
+     */
+    void solve(double *y) const;
+    /**
+     * Copies the values of mat in the band into values, as with
+     * SparseLU::matrixValues.
+     */
+    void matrixValues(const QuickMatrix *mat, std::vector<double> *values) const;
+    /**
+     * @return the ratio of the largest to the smallest magnitude on the
+     * diagonal of U, a cheap estimate of the condition number of the
+     * factorized matrix.
+     */
+    double pivotRatio() const;
+    /**
+     * @return the product of (internal) row row of mat, laid out as for
+     * factor, with x (in external order). Only the entries in the band are
+     * used.
+     */
+    double rowProduct(const QuickMatrix *mat, unsigned row, const double *x) const;
+    /**
+     * The numeric factorization, for saving and restoring it.
+     */
+    const std::vector<double> &values() const
+    {
+        return m_val;
+    }
+    void setValues(const std::vector<double> &values)
+    {
+        m_val = values;
+    }
+
+    unsigned size() const
+    {
+        return m_size;
+    }
+    /**
+     * @return the half bandwidth: the furthest that any nonzero is from the
+     * diagonal, in the internal numbering
+     */
+    unsigned bandwidth() const
+    {
+        return m_bandwidth;
+    }
+    /**
+     * @return the number of entries stored for the band
+     */
+    unsigned bandSize() const
+    {
+        return m_size * (2 * m_bandwidth + 1);
+    }
+    /**
+     * Maps external row / column numbers to the internal numbering.
+     */
+    const std::vector<unsigned> &permutation() const
+    {
+        return m_perm;
+    }
+
+    /**
+     * Prints the factorization to stdout.
+     */
+    void display() const;
+
+protected:
+    /**
+     * Numbers the nodes by reverse Cuthill-McKee.
+     * @return the nodes in their new order
+     */
+    std::vector<unsigned> orderNodes(const std::vector<std::vector<unsigned>> &adjacency, unsigned nodeCount) const;
+
+    unsigned m_size;
+    unsigned m_bandwidth;
+    std::vector<unsigned> m_perm;  ///< external -> internal
+    std::vector<unsigned> m_iperm; ///< internal -> external
+    /// Row i of LU holds the (internal) columns i - m_bandwidth up to
+    /// i + m_bandwidth, with the unit diagonal of L not stored
+    std::vector<double> m_val;
+};
+
+#endif
@@ -101,18 +101,23 @@ void BJT::updateCurrents()
 
 void BJT::update_dc()
 {
-    if (!b_status)
-        return;
+    evaluate_dc();
+    stamp_dc();
+}
 
-    calc_eq();
+void BJT::evaluate_dc()
+{
+    if (b_status)
+        calc_eq();
+}
 
-    BJTState diff = m_ns - m_os;
-    for (unsigned i = 0; i < 3; ++i) {
-        for (unsigned j = 0; j < 3; ++j)
-            A_g(i, j) += diff.A[i][j];
+void BJT::stamp_dc()
+{
+    if (!b_status)
+        return;
 
-        b_i(i) += diff.I[i];
-    }
+    const BJTState diff = m_ns - m_os;
+    m_stamp.stamp(p_eSet, p_cnode, diff.A, diff.I);
 
     m_os = m_ns;
 }
@@ -12,6 +12,7 @@
 #define BJT_H
 
 #include "nonlinear.h"
+#include "stampkernel.h"
 
 class BJTState
 {
@@ -40,7 +41,7 @@ public:
 /**
 @author David Saxton
 */
-class BJT : public NonLinear
+class BJT final : public NonLinear
 {
 public:
     BJT(bool isNPN);
@@ -51,12 +52,18 @@ public:
         return Element_BJT;
     }
     void update_dc() override;
+    void evaluate_dc() override;
+    void stamp_dc() override;
     void add_initial_dc() override;
     BJTSettings settings() const
     {
         return m_bjtSettings;
     }
     void setBJTSettings(const BJTSettings &settings);
+    bool isNPN() const
+    {
+        return m_pol == 1;
+    }
 
 protected:
     void updateCurrents() override;
@@ -74,6 +81,7 @@ protected:
     double V_BE_prev, V_BC_prev;
     double V_BE_lim, V_BC_lim;
     BJTSettings m_bjtSettings;
+    StampKernel<3> m_stamp;
 };
 
 #endif
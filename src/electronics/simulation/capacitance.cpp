@@ -16,7 +16,7 @@ Capacitance::Capacitance(const double capacitance, const double delta)
     m_cap = capacitance;
     m_scaled_cap = i_eq_old = 0.;
     m_numCNodes = 2;
-    setMethod(Capacitance::m_euler);
+    setMethod(Capacitance::m_gear);
 }
 
 Capacitance::~Capacitance()
@@ -33,6 +33,22 @@ void Capacitance::add_initial_dc()
     // We don't need to do anything here, as time_step() will do that for us,
     // apart from to make sure our old values are 0
     m_scaled_cap = i_eq_old = 0.;
+    resetIntegration();
+}
+
+void Capacitance::removeCompanion()
+{
+    if (!b_status)
+        return;
+
+    const double g = -m_scaled_cap;
+    const double I = -i_eq_old;
+    const double A[2][2] = {{g, -g}, {-g, g}};
+    const double b[2] = {-I, I};
+    m_stamp.stamp(p_eSet, p_cnode, A, b);
+
+    m_scaled_cap = i_eq_old = 0.;
+    resetIntegration();
 }
 
 void Capacitance::updateCurrents()
@@ -49,30 +65,54 @@ void Capacitance::time_step()
     if (!b_status)
         return;
 
-    double v = p_cnode[0]->v - p_cnode[1]->v;
-    double i_eq_new = 0.0, scaled_cap_new = 0.0;
-
-    if (m_method == Capacitance::m_euler) {
-        scaled_cap_new = m_cap / m_delta;
-        i_eq_new = -v * scaled_cap_new;
-    } else if (m_method == Capacitance::m_trap) {
-        // TODO Implement + test trapezoidal method
-        scaled_cap_new = 2. * m_cap / m_delta;
-    }
-
-    if (m_scaled_cap != scaled_cap_new) {
-        const double tmp = scaled_cap_new - m_scaled_cap;
-        A_g(0, 0) += tmp;
-        A_g(0, 1) -= tmp;
-        A_g(1, 0) -= tmp;
-        A_g(1, 1) += tmp;
-    }
-
-    if (i_eq_new != i_eq_old) {
-        const double tmp = i_eq_new - i_eq_old;
-        b_i(0) -= tmp;
-        b_i(1) += tmp;
-    }
+    const double v = p_cnode[0]->v - p_cnode[1]->v;
+    acceptStep(v, v * m_scaled_cap + i_eq_old);
+    integrate();
+}
+
+void Capacitance::retry_step()
+{
+    if (!b_status)
+        return;
+
+    integrate();
+}
+
+void Capacitance::restoreState(QDataStream &stream)
+{
+    Reactive::restoreState(stream);
+
+    // Stamp the step from the restored state in place of the current one
+    if (b_status)
+        integrate();
+}
+
+double Capacitance::truncationError() const
+{
+    if (!b_status)
+        return 0.;
+
+    const double v = p_cnode[0]->v - p_cnode[1]->v;
+    return estimateError(v, v * m_scaled_cap + i_eq_old, m_cap, 1e-6);
+}
+
+void Capacitance::integrate()
+{
+    if (m_method == Capacitance::m_trap)
+        prepareStep(integration_trap, m_cap);
+    else if (m_method == Capacitance::m_gear)
+        prepareStep(integration_gear, m_cap);
+    else
+        prepareStep(integration_euler, m_cap);
+
+    const double scaled_cap_new = m_weight;
+    const double i_eq_new = m_offset;
+
+    const double g = scaled_cap_new - m_scaled_cap;
+    const double I = i_eq_new - i_eq_old;
+    const double A[2][2] = {{g, -g}, {-g, g}};
+    const double b[2] = {-I, I};
+    m_stamp.stamp(p_eSet, p_cnode, A, b);
 
     m_scaled_cap = scaled_cap_new;
     i_eq_old = i_eq_new;
@@ -12,18 +12,20 @@
 #define CAPACITANCE_H
 
 #include "reactive.h"
+#include "stampkernel.h"
 
 /**
 @author David Saxton
 @short Capacitance
 */
-class Capacitance : public Reactive
+class Capacitance final : public Reactive
 {
 public:
     enum Method {
         m_none,  // None
         m_euler, // Backward Euler
-        m_trap   // Trapezoidal (currently unimplemented)
+        m_trap,  // Trapezoidal
+        m_gear   // Second order Gear (BDF2)
     };
     Capacitance(const double capacitance, const double delta);
     ~Capacitance() override;
@@ -38,12 +40,37 @@ public:
      */
     void setMethod(Method m);
     void time_step() override;
+    void retry_step() override;
+    double truncationError() const override;
+    void restoreState(QDataStream &stream) override;
     void add_initial_dc() override;
+    /**
+     * Takes the companion model out of the matrix, leaving the capacitor as
+     * an open circuit (as at DC), and starts the integration afresh from the
+     * next time_step.
+     */
+    void removeCompanion();
     void setCapacitance(const double c);
+    double capacitance() const
+    {
+        return m_cap;
+    }
+    /**
+     * @return the conductance of the companion model last stamped for the
+     * integration, which AcAnalysis takes back out of the matrix.
+     */
+    double stampedConductance() const
+    {
+        return m_scaled_cap;
+    }
 
 protected:
     void updateCurrents() override;
     bool updateStatus() override;
+    /**
+     * Stamps the integration over the next m_delta.
+     */
+    void integrate();
 
 private:
     double m_cap;    // Capacitance
@@ -51,6 +78,7 @@ private:
 
     double m_scaled_cap; // capacitance scaled to time base of latest m_delta
     double i_eq_old;
+    StampKernel<2> m_stamp;
 };
 
 #endif
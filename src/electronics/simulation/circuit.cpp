@@ -9,39 +9,127 @@
  ***************************************************************************/
 
 #include "circuit.h"
+#include "capacitance.h"
 #include "circuitdocument.h"
 #include "element.h"
 #include "elementset.h"
+#include "inductance.h"
 #include "logic.h"
+#include "logiccache.h"
+#include "matrix.h"
+#include "ngspicecircuit.h"
 #include "nonlinear.h"
 #include "pin.h"
 #include "reactive.h"
+#include "simulator.h"
 #include "wire.h"
 
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+
 //#include <vector>
+
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <map>
 
 typedef std::multimap<int, PinList> PinListMap;
 
+/// The shortest time step is LINEAR_UPDATE_PERIOD / 2^MAX_STEP_LEVEL
+static const int MAX_STEP_LEVEL = 8;
+
+/// A circuit has settled once no part of its solution moves by more than this
+/// (relative and absolute) over SETTLE_STEPS linear updates in a row
+static const double SETTLE_REL_TOL = 1e-10;
+static const double SETTLE_ABS_TOL = 1e-12;
+static const int SETTLE_STEPS = 10;
+
+/// Newton iterations allowed for each time step; iterations that reuse the
+/// LU decomposition are cheap, so this is mostly a guard against oscillation
+static const int STEP_NEWTON_ITERATIONS = 20;
+
+/// Newton iterations allowed for each solve while finding the operating point
+static const int OPERATING_POINT_ITERATIONS = 150;
+
+/// The operating points found for each circuit topology, which a circuit
+/// made again from the same pins and elements starts from. The solves can
+/// be done from the worker threads, hence the mutex.
+static std::map<std::vector<quintptr>, std::vector<double>> s_operatingPoints;
+static QMutex s_operatingPointsMutex;
+/// The cache is emptied once it gets to this size, as it is keyed by pointers
+/// that go stale as components are removed
+static const size_t MAX_OPERATING_POINTS = 256;
+
+/**
+A LogicCache that can be used by several circuits that are built the same (e.g.
+copies of a subcircuit), which may be solved from different worker threads.
+*/
+class SharedLogicCache
+{
+public:
+    QMutex mutex;
+    LogicCache cache;
+};
+
+/// The logic caches of the circuits that can share them, keyed by how the
+/// circuits are built
+static std::map<std::vector<quint64>, std::weak_ptr<SharedLogicCache>> s_sharedLogicCaches;
+static QMutex s_sharedLogicCachesMutex;
+/// Circuits larger than this are not shared, as the key holds the whole matrix
+static const unsigned MAX_SHARED_CACHE_SIZE = 64;
+
+/// Each strategy is tried for STRATEGY_TRIAL_SOLVES solves, after the
+/// STRATEGY_WARMUP_SOLVES that refill the caches it switched to, or for
+/// STRATEGY_TRIAL_MAX_STEPS steps of a circuit that is seldom solved
+static const int STRATEGY_WARMUP_SOLVES = 4;
+static const int STRATEGY_TRIAL_SOLVES = 200;
+static const int STRATEGY_TRIAL_MAX_STEPS = 2000;
+/// The strategies are tried again after this many steps, as what the
+/// circuit is doing (and so the quickest strategy) can change
+static const int STRATEGY_TRIAL_INTERVAL = 100000;
+
+static quint64 keyBits(double value)
+{
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
 // BEGIN class Circuit
+bool Circuit::m_bTimingEnabled = false;
+bool Circuit::m_bReferenceMode = false;
+
 Circuit::Circuit()
 {
     m_bCanAddChanged = true;
     m_pNextChanged[0] = m_pNextChanged[1] = nullptr;
     m_logicOutCount = 0;
     m_bCanCache = false;
+    m_bUseLogicCache = true;
     m_pLogicOut = nullptr;
+    m_pLogicCache = std::make_shared<SharedLogicCache>();
     m_elementSet = new ElementSet(this, 0, 0); // why do we do this?
+    m_pNgspice = nullptr;
     m_cnodeCount = m_branchCount = -1;
     m_prepNLCount = 0;
-    m_pLogicCacheBase = new LogicCacheNode;
+    m_bNonLogicSolved = false;
+    m_stepLevel = 0;
+    m_bParked = false;
+    m_settledSteps = 0;
+    m_bFindOperatingPoint = false;
+    m_strategy = 0;
+    m_bTryingStrategies = false;
+    m_strategySteps = m_trialSolves = 0;
+    m_trialNs = 0;
 }
 
 Circuit::~Circuit()
 {
+    delete m_pNgspice;
     delete m_elementSet;
-    delete m_pLogicCacheBase;
     delete[] m_pLogicOut;
 }
 
@@ -85,15 +173,7 @@ int Circuit::identifyGround(PinList nodeList, int *highest)
 
     // Now to give all the Pins ids
     PinListMap eqs;
-    while (!nodeList.isEmpty()) {
-        PinList associated;
-        PinList nodes;
-        Pin *node = *nodeList.begin();
-        recursivePinAdd(node, &nodeList, &associated, &nodes);
-        if (nodes.size() > 0) {
-            eqs.insert(std::make_pair(associated.size(), nodes));
-        }
-    }
+    groupConnectedPins(nodeList, &eqs);
 
     // Now, we want to look through the associated Pins,
     // to find the ones with the highest "Ground Priority". Anything with a lower
@@ -159,26 +239,15 @@ void Circuit::init()
     }
 
     // Now to give all the Pins ids
-    int groundCount = 0;
     PinListMap eqs;
-    PinList unassignedNodes = m_pinList;
-    while (!unassignedNodes.isEmpty()) {
-        PinList associated;
-        PinList nodes;
-        Pin *node = *unassignedNodes.begin();
-        if (recursivePinAdd(node, &unassignedNodes, &associated, &nodes)) {
-            groundCount++;
-        }
-        if (nodes.size() > 0) {
-            eqs.insert(std::make_pair(associated.size(), nodes));
-        }
-    }
+    const int groundCount = groupConnectedPins(m_pinList, &eqs);
 
     m_cnodeCount = eqs.size() - groundCount;
 
-    delete m_pLogicCacheBase;
-    m_pLogicCacheBase = nullptr;
+    m_pLogicCache = std::make_shared<SharedLogicCache>();
 
+    delete m_pNgspice;
+    m_pNgspice = nullptr;
     delete m_elementSet;
     m_elementSet = new ElementSet(this, m_cnodeCount, m_branchCount);
 
@@ -235,6 +304,39 @@ void Circuit::init()
         i++;
     }
 
+    // The pins are only read from now on, so are kept with their cnodes in
+    // plain arrays for passing the solution back
+    m_pins.clear();
+    m_pinCNodes.clear();
+    m_pins.reserve(m_pinList.size());
+    m_pinCNodes.reserve(m_pinList.size());
+    for (PinList::const_iterator it = m_pinList.constBegin(); it != m_pinList.constEnd(); ++it) {
+        if (Pin *pin = *it) {
+            m_pins.push_back(pin);
+            m_pinCNodes.push_back(pin->eqId());
+        }
+    }
+
+    // A circuit made from the same pins and elements before starts from the
+    // operating point that was found then, rather than from the guess above
+    m_topologyKey.clear();
+    for (PinList::const_iterator it = m_pinList.constBegin(); it != m_pinList.constEnd(); ++it) {
+        m_topologyKey.push_back(quintptr(static_cast<Pin *>(*it)));
+        m_topologyKey.push_back(quintptr((*it) ? (*it)->eqId() : -2));
+    }
+    for (ElementList::iterator it = m_elementList.begin(); it != listEnd; ++it)
+        m_topologyKey.push_back(quintptr(*it));
+
+    {
+        QMutexLocker locker(&s_operatingPointsMutex);
+        const auto found = s_operatingPoints.find(m_topologyKey);
+        if (found != s_operatingPoints.end() && found->second.size() == x->size()) {
+            for (unsigned j = 0; j < x->size(); ++j)
+                (*x)[j] = found->second[j];
+        }
+    }
+    m_bFindOperatingPoint = true;
+
     // And add the elements to the elementSet
     for (ElementList::iterator it = m_elementList.begin(); it != listEnd; ++it) {
         // We don't want the element to prematurely try to do anything,
@@ -266,20 +368,90 @@ void Circuit::init()
             break;
         }
     }
+
+    m_signalList.clear();
+    m_capacitances.clear();
+    m_inductances.clear();
+    for (ElementList::iterator it = m_elementList.begin(); it != listEnd; ++it) {
+        switch ((*it)->type()) {
+        case Element::Element_Capacitance:
+            m_capacitances.push_back(static_cast<Capacitance *>(*it));
+            break;
+        case Element::Element_Inductance:
+            m_inductances.push_back(static_cast<Inductance *>(*it));
+            break;
+        default:
+            if ((*it)->isReactive())
+                m_signalList.append(static_cast<Reactive *>(*it));
+            break;
+        }
+    }
+    m_stepLevel = 0;
+
+    m_bParked = false;
+    m_settledSteps = 0;
+    m_settledX.clear();
+}
+
+void Circuit::saveState(QDataStream &stream) const
+{
+    const QuickVector *x = m_elementSet->x();
+    const unsigned size = x->size();
+
+    stream << quint32(size);
+    for (unsigned i = 0; i < size; ++i)
+        stream << (*x)[i];
+}
+
+bool Circuit::restoreState(QDataStream &stream)
+{
+    quint32 size;
+    stream >> size;
+
+    QuickVector *x = m_elementSet->x();
+    if (size != x->size())
+        return false;
+
+    for (unsigned i = 0; i < size; ++i)
+        stream >> (*x)[i];
+
+    m_elementSet->updateInfo();
+    updateNodalVoltages();
+
+    // The restored state may well not be settled
+    wake();
+    m_settledX.clear();
+
+    if (m_pNgspice && !m_pNgspice->restart()) {
+        delete m_pNgspice;
+        m_pNgspice = nullptr;
+    }
+    return true;
 }
 
 void Circuit::initCache()
 {
     m_elementSet->updateInfo();
 
+    // A large circuit may be handed to ngspice, which needs no cache
+    delete m_pNgspice;
+    m_pNgspice = NgspiceCircuit::create(m_elementSet, m_elementList);
+    if (m_pNgspice) {
+        m_bCanCache = false;
+        delete[] m_pLogicOut;
+        m_pLogicOut = nullptr;
+        m_strategies.clear();
+        m_bTryingStrategies = false;
+        return;
+    }
+
     m_bCanCache = true;
     m_logicOutCount = 0;
 
     delete[] m_pLogicOut;
     m_pLogicOut = nullptr;
 
-    delete m_pLogicCacheBase;
-    m_pLogicCacheBase = nullptr;
+    m_pLogicCache = std::make_shared<SharedLogicCache>();
 
     const ElementList::iterator end = m_elementList.end();
     for (ElementList::iterator it = m_elementList.begin(); it != end && m_bCanCache; ++it) {
@@ -316,69 +488,249 @@ void Circuit::initCache()
         }
     }
 
-    if (!m_bCanCache)
+    if (m_bCanCache) {
+        m_pLogicOut = new LogicOut *[m_logicOutCount];
+        unsigned i = 0;
+        for (ElementList::iterator it = m_elementList.begin(); it != end && m_bCanCache; ++it) {
+            if ((*it)->type() == Element::Element_LogicOut)
+                m_pLogicOut[i++] = static_cast<LogicOut *>(*it);
+        }
+
+        shareLogicCache();
+    }
+
+    initStrategies();
+}
+
+void Circuit::initStrategies()
+{
+    m_strategies.clear();
+    m_bTryingStrategies = false;
+    m_bUseLogicCache = !m_bReferenceMode;
+
+    Matrix *matrix = m_elementSet->matrix();
+    if (!matrix || m_bReferenceMode)
         return;
 
-    m_pLogicOut = new LogicOut *[m_logicOutCount];
-    unsigned i = 0;
-    for (ElementList::iterator it = m_elementList.begin(); it != end && m_bCanCache; ++it) {
-        if ((*it)->type() == Element::Element_LogicOut)
-            m_pLogicOut[i++] = static_cast<LogicOut *>(*it);
+    // The LU cache is skipped for smaller matrices anyway, and a logic cache
+    // with nothing to key on holds a single solution, which is always worth
+    // keeping
+    const bool tryLUCache = m_elementSet->x()->size() >= Matrix::LU_CACHE_MIN_ROWS;
+    const bool tryLogicCache = m_bCanCache && m_logicOutCount > 0;
+
+    // The solver picked by Matrix::createMap comes first, so that it is kept
+    // if none of the others are found to be quicker
+    for (Matrix::SolverType solver : matrix->availableSolvers()) {
+        for (int luCache = 1; luCache >= (tryLUCache ? 0 : 1); --luCache) {
+            for (int logicCache = 1; logicCache >= (tryLogicCache ? 0 : 1); --logicCache)
+                m_strategies.push_back({solver, bool(luCache), bool(logicCache), -1.});
+        }
+    }
+
+    if (m_strategies.size() <= 1) {
+        m_strategies.clear();
+        return;
     }
 
-    m_pLogicCacheBase = new LogicCacheNode;
+    startStrategyTrial();
 }
 
-void Circuit::setCacheInvalidated()
+void Circuit::startStrategyTrial()
 {
-    if (m_pLogicCacheBase) {
-        delete m_pLogicCacheBase->high;
-        m_pLogicCacheBase->high = nullptr;
+    for (SolverStrategy &strategy : m_strategies)
+        strategy.cost = -1.;
+    m_bTryingStrategies = true;
+    useStrategy(0);
+}
 
-        delete m_pLogicCacheBase->low;
-        m_pLogicCacheBase->low = nullptr;
+void Circuit::useStrategy(int i)
+{
+    const SolverStrategy &strategy = m_strategies[i];
+    Matrix *matrix = m_elementSet->matrix();
+    matrix->setSolverType(Matrix::SolverType(strategy.solver));
+    matrix->setLUCacheEnabled(strategy.luCache);
+    m_bUseLogicCache = strategy.logicCache;
+
+    m_strategy = i;
+    m_strategySteps = 0;
+    m_trialSolves = 0;
+    m_trialNs = 0;
+}
+
+void Circuit::updateStrategy(bool solved, qint64 ns)
+{
+    ++m_strategySteps;
+
+    if (!m_bTryingStrategies) {
+        if (m_strategySteps >= STRATEGY_TRIAL_INTERVAL)
+            startStrategyTrial();
+        return;
+    }
+
+    // The first solves after switching refill the caches
+    if (solved && ++m_trialSolves > STRATEGY_WARMUP_SOLVES)
+        m_trialNs += ns;
+
+    const int measured = m_trialSolves - STRATEGY_WARMUP_SOLVES;
+    if (measured < STRATEGY_TRIAL_SOLVES && m_strategySteps < STRATEGY_TRIAL_MAX_STEPS)
+        return;
+
+    if (measured > 0)
+        m_strategies[m_strategy].cost = double(m_trialNs) / measured;
+
+    if (m_strategy + 1 < int(m_strategies.size())) {
+        useStrategy(m_strategy + 1);
+        return;
+    }
+
+    int best = 0;
+    for (int i = 1; i < int(m_strategies.size()); ++i) {
+        const double cost = m_strategies[i].cost;
+        if (cost >= 0. && (m_strategies[best].cost < 0. || cost < m_strategies[best].cost))
+            best = i;
+    }
+
+    m_bTryingStrategies = false;
+    useStrategy(best);
+}
+
+void Circuit::detachLogicCache()
+{
+    m_pLogicCache = std::make_shared<SharedLogicCache>();
+    if (m_bCanCache)
+        m_pLogicCache->cache.reset(m_logicOutCount, m_elementSet->x()->size());
+}
+
+void Circuit::shareLogicCache()
+{
+    const unsigned size = m_elementSet->x()->size();
+    if (m_elementSet->containsNonLinear() || size > MAX_SHARED_CACHE_SIZE) {
+        detachLogicCache();
+        return;
+    }
+
+    std::vector<quint64> key;
+    key.reserve(2 + 5 * m_logicOutCount + size * (size + 1));
+    key.push_back(size);
+    key.push_back(m_logicOutCount);
+
+    // The LogicOuts are not all in the matrix while low, so are keyed on
+    // their own
+    for (unsigned i = 0; i < m_logicOutCount; ++i) {
+        LogicOut *logicOut = m_pLogicOut[i];
+        CNode *cnode = logicOut->cnode(0);
+        key.push_back((!cnode || cnode->isGround) ? quint64(-1) : cnode->n());
+        key.push_back(logicOut->outputState());
+        key.push_back(keyBits(logicOut->outputHighConductance()));
+        key.push_back(keyBits(logicOut->outputLowConductance()));
+        key.push_back(keyBits(logicOut->outputHighVoltage()));
+    }
+
+    const Matrix *matrix = m_elementSet->matrix();
+    const QuickVector &b = *m_elementSet->b();
+    for (unsigned i = 0; i < size; ++i) {
+        for (unsigned j = 0; j < size; ++j)
+            key.push_back(keyBits(matrix->g(i, j)));
+        key.push_back(keyBits(b[i]));
+    }
+
+    QMutexLocker locker(&s_sharedLogicCachesMutex);
+
+    std::weak_ptr<SharedLogicCache> &shared = s_sharedLogicCaches[key];
+    m_pLogicCache = shared.lock();
+    if (m_pLogicCache)
+        return;
+
+    detachLogicCache();
+    shared = m_pLogicCache;
+
+    // Forget the caches whose circuits have all gone
+    for (auto it = s_sharedLogicCaches.begin(); it != s_sharedLogicCaches.end();) {
+        if (it->second.expired())
+            it = s_sharedLogicCaches.erase(it);
+        else
+            ++it;
+    }
+}
 
-        delete m_pLogicCacheBase->data;
-        m_pLogicCacheBase->data = nullptr;
+void Circuit::setCacheInvalidated()
+{
+    // The circuits sharing the cache have not changed, so their solutions
+    // are still good
+    if (m_pLogicCache.use_count() > 1) {
+        detachLogicCache();
+        return;
     }
+
+    QMutexLocker locker(&m_pLogicCache->mutex);
+    m_pLogicCache->cache.clear();
+}
+
+qint64 Circuit::logicCacheMemoryUsage() const
+{
+    const std::shared_ptr<SharedLogicCache> logicCache = m_pLogicCache;
+    QMutexLocker locker(&logicCache->mutex);
+    // Less the copy of the pointer held here
+    return logicCache->cache.memoryUsage() / std::max<long>(1, logicCache.use_count() - 1);
+}
+
+void Circuit::trimLogicCache()
+{
+    QMutexLocker locker(&m_pLogicCache->mutex);
+    m_pLogicCache->cache.trim();
 }
 
 void Circuit::cacheAndUpdate()
 {
-    LogicCacheNode *node = m_pLogicCacheBase;
-    for (unsigned i = 0; i < m_logicOutCount; i++) {
-        if (m_pLogicOut[i]->outputState()) {
-            if (!node->high)
-                node->high = new LogicCacheNode;
+    // The key is held by the cache, which may be shared, so it is set again
+    // each time the cache is locked
+    auto setKey = [this](LogicCache &cache) {
+        cache.clearKey();
+        for (unsigned i = 0; i < m_logicOutCount; i++) {
+            if (m_pLogicOut[i]->outputState())
+                cache.setKeyBit(i);
+        }
+    };
 
-            node = node->high;
-        } else {
-            if (!node->low)
-                node->low = new LogicCacheNode;
+    // Held here, as solving can detach this circuit from a shared cache
+    const std::shared_ptr<SharedLogicCache> logicCache = m_pLogicCache;
+    QuickVector *x = m_elementSet->x();
 
-            node = node->low;
+    {
+        QMutexLocker locker(&logicCache->mutex);
+        setKey(logicCache->cache);
+        if (const double *solution = logicCache->cache.find()) {
+            const unsigned size = x->size();
+            for (unsigned i = 0; i < size; i++)
+                (*x)[i] = solution[i];
+            locker.unlock();
+
+            m_elementSet->updateInfo();
+            m_stats.cacheHits++;
+            return;
         }
     }
 
-    if (node->data) {
-        (*m_elementSet->x()) = *node->data;
-        m_elementSet->updateInfo();
+    m_stats.cacheMisses++;
+
+    solveUncached();
+
+    if (logicCache != m_pLogicCache)
         return;
-    }
 
+    // Another circuit sharing the cache may have got there first
+    QMutexLocker locker(&logicCache->mutex);
+    setKey(logicCache->cache);
+    if (!logicCache->cache.find())
+        logicCache->cache.insert(x);
+}
+
+void Circuit::solveUncached()
+{
     if (m_elementSet->containsNonLinear())
-        m_elementSet->doNonLinear(150, 1e-10, 1e-13);
+        doNonLinear(150, 1e-10, 1e-13);
     else
         m_elementSet->doLinear(true);
-
-    if (node->data) {
-        node->data = m_elementSet->x();
-    } else {
-        node->data = new QuickVector(m_elementSet->x());
-    }
-
-    //	node->data = new Vector( m_elementSet->x()->size() );
-    //	*node->data = *m_elementSet->x();
 }
 
 void Circuit::createMatrixMap()
@@ -386,62 +738,419 @@ void Circuit::createMatrixMap()
     m_elementSet->createMatrixMap();
 }
 
-bool Circuit::recursivePinAdd(Pin *node, PinList *unassignedNodes, PinList *associated, PinList *nodes)
+void Circuit::setTimingEnabled(bool enabled)
 {
-    if (!unassignedNodes->contains(node))
-        return false;
-    unassignedNodes->removeAll(node);
+    m_bTimingEnabled = enabled;
+    Matrix::setTimingEnabled(enabled);
+}
+
+void Circuit::setReferenceMode(bool reference)
+{
+    m_bReferenceMode = reference;
+    Matrix::setReferenceMode(reference);
+    Reactive::setReferenceMode(reference);
+}
+
+void Circuit::resetStats()
+{
+    m_stats.reset();
+    m_elementSet->resetNonLinearStats();
+    if (Matrix *matrix = m_elementSet->matrix())
+        matrix->resetFactorizationCounts();
+}
 
-    bool foundGround = node->eqId() == -1;
+unsigned long Circuit::factorizationCount() const
+{
+    const Matrix *matrix = m_elementSet->matrix();
+    return matrix ? matrix->factorizationCount() : 0;
+}
+
+qint64 Circuit::factorizationNs() const
+{
+    const Matrix *matrix = m_elementSet->matrix();
+    return matrix ? matrix->factorizationNs() : 0;
+}
+
+unsigned long Circuit::restoredFactorizationCount() const
+{
+    const Matrix *matrix = m_elementSet->matrix();
+    return matrix ? matrix->restoredFactorizationCount() : 0;
+}
+
+bool Circuit::usesSparseSolver() const
+{
+    const Matrix *matrix = m_elementSet->matrix();
+    return matrix && matrix->solverType() == Matrix::SparseSolver;
+}
+
+bool Circuit::usesBandedSolver() const
+{
+    const Matrix *matrix = m_elementSet->matrix();
+    return matrix && matrix->solverType() == Matrix::BandedSolver;
+}
 
-    const PinList circuitDependentPins = node->circuitDependentPins();
-    const PinList::const_iterator dEnd = circuitDependentPins.end();
-    for (PinList::const_iterator it = circuitDependentPins.begin(); it != dEnd; ++it) {
-        if (!associated->contains(*it))
-            associated->append(*it);
+bool Circuit::usesLUCache() const
+{
+    const Matrix *matrix = m_elementSet->matrix();
+    return matrix && matrix->isLUCacheEnabled();
+}
+
+/**
+ * The pins handed to groupConnectedPins, compiled into arrays indexed by the
+ * position of the pin, so that going over the connections does not need to
+ * look the pins up in sets or copy their lists of connected pins again.
+ */
+class PinGraph
+{
+public:
+    explicit PinGraph(const PinList &nodeList)
+    {
+        QHash<Pin *, int> indexes;
+        indexes.reserve(nodeList.size());
+        const PinList::const_iterator end = nodeList.end();
+        for (PinList::const_iterator it = nodeList.begin(); it != end; ++it) {
+            Pin *pin = *it;
+            if (pin && !indexes.contains(pin)) {
+                indexes.insert(pin, int(pins.size()));
+                pins.push_back(pin);
+            }
+        }
+
+        // Connections to pins that are not in the list are left out, as the
+        // groups are made only from the pins in the list
+        QHash<Pin *, int> dependentIndexes;
+        connectionStart.reserve(pins.size() + 1);
+        dependentStart.reserve(pins.size() + 1);
+        for (Pin *pin : pins) {
+            connectionStart.push_back(int(connections.size()));
+            const PinList connected = pin->localConnectedPins();
+            for (PinList::const_iterator it = connected.begin(); it != connected.end(); ++it) {
+                const int index = indexes.value(*it, -1);
+                if (index != -1)
+                    connections.push_back(index);
+            }
+
+            dependentStart.push_back(int(dependents.size()));
+            const PinList circuitDependentPins = pin->circuitDependentPins();
+            for (PinList::const_iterator it = circuitDependentPins.begin(); it != circuitDependentPins.end(); ++it) {
+                QHash<Pin *, int>::const_iterator found = dependentIndexes.constFind(*it);
+                if (found == dependentIndexes.constEnd())
+                    found = dependentIndexes.insert(*it, dependentIndexes.size());
+                dependents.push_back(found.value());
+            }
+        }
+        connectionStart.push_back(int(connections.size()));
+        dependentStart.push_back(int(dependents.size()));
+        dependentCount = dependentIndexes.size();
     }
 
-    nodes->append(node);
+    std::vector<Pin *> pins;
+    std::vector<int> connectionStart; // Where the connections of each pin start in connections
+    std::vector<int> connections;     // The indexes of the pins that each pin is connected to
+    std::vector<int> dependentStart;  // Where the dependent pins of each pin start in dependents
+    std::vector<int> dependents;      // The circuit-dependent pins, numbered in order of appearance
+    int dependentCount;
+};
+
+int Circuit::groupConnectedPins(const PinList &nodeList, PinListMap *eqs)
+{
+    const PinGraph graph(nodeList);
+    const int pinCount = int(graph.pins.size());
+
+    std::vector<bool> assigned(pinCount, false);
+    std::vector<int> dependentGroup(graph.dependentCount, -1); // The group each dependent pin was last counted in
+    std::vector<std::pair<int, int>> stack; // The pins being gone through, and the next of their connections
+
+    int groundCount = 0;
+    for (int first = 0; first < pinCount; ++first) {
+        if (assigned[first])
+            continue;
+
+        // The pins are added in the order that recursing into each connected
+        // pin would, but without running out of stack on long chains of pins
+        bool foundGround = false;
+        int associated = 0;
+        PinList nodes;
+
+        auto addNode = [&](int index) {
+            if (assigned[index])
+                return;
+            assigned[index] = true;
 
-    const PinList localConnectedPins = node->localConnectedPins();
-    const PinList::const_iterator end = localConnectedPins.end();
-    for (PinList::const_iterator it = localConnectedPins.begin(); it != end; ++it)
-        foundGround |= recursivePinAdd(*it, unassignedNodes, associated, nodes);
+            Pin *node = graph.pins[index];
+            foundGround |= node->eqId() == -1;
 
-    return foundGround;
+            for (int d = graph.dependentStart[index]; d < graph.dependentStart[index + 1]; ++d) {
+                const int dependent = graph.dependents[d];
+                if (dependentGroup[dependent] != first) {
+                    dependentGroup[dependent] = first;
+                    associated++;
+                }
+            }
+
+            nodes.append(node);
+            stack.push_back(std::make_pair(index, graph.connectionStart[index]));
+        };
+
+        addNode(first);
+
+        while (!stack.empty()) {
+            std::pair<int, int> &top = stack.back();
+            if (top.second == graph.connectionStart[top.first + 1]) {
+                stack.pop_back();
+                continue;
+            }
+            addNode(graph.connections[top.second++]);
+        }
+
+        if (foundGround)
+            groundCount++;
+        eqs->insert(std::make_pair(associated, nodes));
+    }
+    return groundCount;
 }
 
 void Circuit::doNonLogic()
 {
+    solveNonLogic();
+    finishNonLogic();
+}
+
+void Circuit::solveNonLogic()
+{
+    m_bNonLogicSolved = false;
+
     if (!m_elementSet || m_cnodeCount + m_branchCount <= 0)
         return;
 
-    if (m_bCanCache) {
-        if (!m_elementSet->b()->isChanged() && !m_elementSet->matrix()->isChanged())
-            return;
-        cacheAndUpdate();
-        updateNodalVoltages();
-        m_elementSet->b()->setUnchanged();
+    // The strategies are timed while they are being tried, whether or not
+    // the timing is enabled for the stats
+    QElapsedTimer timer;
+    if (m_bTimingEnabled || m_bTryingStrategies)
+        timer.start();
+
+    m_elementSet->setLogicCheckDeferred(true);
+
+    if (m_pNgspice) {
+        stepReactive();
+        m_bNonLogicSolved = m_pNgspice->step();
+        if (!m_bNonLogicSolved) {
+            // Carry on with the element set, which the elements have been
+            // stamping into all along
+            delete m_pNgspice;
+            m_pNgspice = nullptr;
+        }
+    } else if (m_bCanCache) {
+        if (m_elementSet->b()->isChanged() || m_elementSet->matrix()->isChanged()) {
+            if (m_bUseLogicCache)
+                cacheAndUpdate();
+            else
+                solveUncached();
+            m_bNonLogicSolved = true;
+            m_elementSet->b()->setUnchanged();
+        }
+    } else if (!m_capacitances.empty() || !m_inductances.empty()) {
+        // Anything stamped into a parked circuit (e.g. a source changed by a
+        // component) wakes it up
+        if (m_bParked && (m_elementSet->b()->isChanged() || m_elementSet->matrix()->isChanged()))
+            wake();
+
+        if (!m_bParked) {
+            m_bNonLogicSolved = solveTransient();
+            updateSettled();
+        }
+    } else {
+        stepReactive();
+        m_bNonLogicSolved = solveStep();
+    }
+
+    m_elementSet->setLogicCheckDeferred(false);
+
+    if (m_bNonLogicSolved)
+        m_stats.solves++;
+
+    const qint64 ns = timer.isValid() ? timer.nsecsElapsed() : 0;
+    if (m_bTimingEnabled)
+        m_stats.solveNs += ns;
+    if (!m_strategies.empty())
+        updateStrategy(m_bNonLogicSolved, ns);
+}
+
+void Circuit::finishNonLogic()
+{
+    if (!m_bNonLogicSolved)
         return;
+
+    m_bNonLogicSolved = false;
+    m_elementSet->checkLogic();
+    updateNodalVoltages();
+}
+
+bool Circuit::solveDc()
+{
+    // ngspice does its own transient analysis
+    if (m_pNgspice)
+        return false;
+    if (!m_elementSet || m_cnodeCount + m_branchCount <= 0)
+        return true;
+
+    for (Capacitance *capacitance : m_capacitances)
+        capacitance->removeCompanion();
+    for (Inductance *inductance : m_inductances)
+        inductance->removeCompanion();
+
+    bool converged = true;
+    if (m_elementSet->containsNonLinear()) {
+        m_bFindOperatingPoint = false;
+        converged = m_elementSet->solveOperatingPoint(OPERATING_POINT_ITERATIONS);
+    } else
+        m_elementSet->doLinear(true);
+
+    m_elementSet->b()->setUnchanged();
+    updateNodalVoltages();
+
+    // The capacitors and inductors restart from here
+    wake();
+    return converged;
+}
+
+void Circuit::stepReactive()
+{
+    const ReactiveList::iterator signalEnd = m_signalList.end();
+    for (ReactiveList::iterator it = m_signalList.begin(); it != signalEnd; ++it)
+        (*it)->time_step();
+}
+
+void Circuit::stepEnergyStorage(double delta)
+{
+    for (Capacitance *capacitance : m_capacitances) {
+        capacitance->setDelta(delta);
+        capacitance->time_step();
+    }
+    for (Inductance *inductance : m_inductances) {
+        inductance->setDelta(delta);
+        inductance->time_step();
+    }
+}
+
+void Circuit::retryEnergyStorage(double delta)
+{
+    for (Capacitance *capacitance : m_capacitances) {
+        capacitance->setDelta(delta);
+        capacitance->retry_step();
     }
+    for (Inductance *inductance : m_inductances) {
+        inductance->setDelta(delta);
+        inductance->retry_step();
+    }
+}
 
+bool Circuit::solveTransient()
+{
     stepReactive();
+
+    if (m_bReferenceMode) {
+        stepEnergyStorage(LINEAR_UPDATE_PERIOD);
+        return solveStep();
+    }
+
+    bool solved = false;
+
+    // Count in units of the shortest step, so that the steps always add up to
+    // exactly one linear update period
+    int remaining = 1 << MAX_STEP_LEVEL;
+    while (remaining > 0) {
+        while ((1 << (MAX_STEP_LEVEL - m_stepLevel)) > remaining)
+            m_stepLevel++;
+
+        stepEnergyStorage(LINEAR_UPDATE_PERIOD / (1 << m_stepLevel));
+        solved |= solveStep();
+        double error = truncationError();
+
+        while (error > 1. && m_stepLevel < MAX_STEP_LEVEL) {
+            // The error goes roughly with the cube of the step
+            m_stepLevel = std::min(MAX_STEP_LEVEL, m_stepLevel + ((error > 64.) ? 2 : 1));
+
+            retryEnergyStorage(LINEAR_UPDATE_PERIOD / (1 << m_stepLevel));
+            solved |= solveStep();
+            error = truncationError();
+        }
+
+        remaining -= 1 << (MAX_STEP_LEVEL - m_stepLevel);
+
+        // Doubling the step should leave the error well within tolerance
+        if (error < 1. / 16. && m_stepLevel > 0)
+            m_stepLevel--;
+    }
+
+    return solved;
+}
+
+bool Circuit::solveStep()
+{
     if (m_elementSet->containsNonLinear()) {
-        m_elementSet->doNonLinear(10, 1e-9, 1e-12);
-        updateNodalVoltages();
-    } else {
-        if (m_elementSet->doLinear(true))
-            updateNodalVoltages();
+        doNonLinear(STEP_NEWTON_ITERATIONS, 1e-9, 1e-12);
+        return true;
     }
+    return m_elementSet->doLinear(true);
 }
 
-void Circuit::stepReactive()
+void Circuit::doNonLinear(int maxIterations, double maxErrorV, double maxErrorI)
 {
-    ElementList::iterator listEnd = m_elementList.end();
-    for (ElementList::iterator it = m_elementList.begin(); it != listEnd; ++it) {
-        Element *const e = *it;
-        if (e && e->isReactive())
-            (static_cast<Reactive *>(e))->time_step();
+    if (!m_bFindOperatingPoint) {
+        m_elementSet->doNonLinear(maxIterations, maxErrorV, maxErrorI);
+        return;
+    }
+
+    m_bFindOperatingPoint = false;
+    if (!m_elementSet->solveOperatingPoint(std::max(maxIterations, OPERATING_POINT_ITERATIONS), maxErrorV, maxErrorI))
+        return;
+
+    const QuickVector &x = *m_elementSet->x();
+    QMutexLocker locker(&s_operatingPointsMutex);
+    if (s_operatingPoints.size() >= MAX_OPERATING_POINTS)
+        s_operatingPoints.clear();
+    std::vector<double> &operatingPoint = s_operatingPoints[m_topologyKey];
+    operatingPoint.resize(x.size());
+    for (unsigned i = 0; i < x.size(); ++i)
+        operatingPoint[i] = x[i];
+}
+
+double Circuit::truncationError() const
+{
+    double error = 0.;
+    for (const Capacitance *capacitance : m_capacitances)
+        error = std::max(error, capacitance->truncationError());
+    for (const Inductance *inductance : m_inductances)
+        error = std::max(error, inductance->truncationError());
+    return error;
+}
+
+void Circuit::updateSettled()
+{
+    if (!m_signalList.isEmpty())
+        return;
+
+    const QuickVector &x = *m_elementSet->x();
+    const unsigned size = x.size();
+
+    bool settled = (m_settledX.size() == size);
+    m_settledX.resize(size);
+
+    for (unsigned i = 0; i < size; ++i) {
+        const double v = x[i];
+        if (std::abs(v - m_settledX[i]) > SETTLE_ABS_TOL + SETTLE_REL_TOL * std::abs(v))
+            settled = false;
+        m_settledX[i] = v;
+    }
+
+    m_settledSteps = settled ? m_settledSteps + 1 : 0;
+
+    if (m_settledSteps >= SETTLE_STEPS) {
+        m_bParked = true;
+        // So that only what is stamped from now on counts as a change (the
+        // nonlinear solver leaves the vector marked as changed)
+        m_elementSet->b()->setUnchanged();
     }
 }
 
@@ -449,15 +1158,14 @@ void Circuit::updateNodalVoltages()
 {
     CNode **_cnodes = m_elementSet->cnodes();
 
-    const PinList::iterator endIt = m_pinList.end();
-    for (PinList::iterator it = m_pinList.begin(); it != endIt; ++it) {
-        Pin *const node = *it;
-        int i = node->eqId();
-        if (i == -1)
-            node->setVoltage(0.);
+    const size_t pinCount = m_pins.size();
+    for (size_t i = 0; i < pinCount; ++i) {
+        const int cnode = m_pinCNodes[i];
+        if (cnode == -1)
+            m_pins[i]->setVoltage(0.);
         else {
-            const double v = _cnodes[i]->v;
-            node->setVoltage(std::isfinite(v) ? v : 0.);
+            const double v = _cnodes[cnode]->v;
+            m_pins[i]->setVoltage(std::isfinite(v) ? v : 0.);
         }
     }
 }
@@ -475,21 +1183,3 @@ void Circuit::displayEquations()
     m_elementSet->displayEquations();
 }
 // END class Circuit
-
-// BEGIN class LogicCacheNode
-
-LogicCacheNode::LogicCacheNode()
-{
-    low = nullptr;
-    high = nullptr;
-    data = nullptr;
-}
-
-LogicCacheNode::~LogicCacheNode()
-{
-    delete low;
-    delete high;
-    if (data)
-        delete data;
-}
-// END class LogicCacheNode
@@ -13,10 +13,19 @@
 
 #include <QList>
 #include <QPointer>
+#include <QSet>
+
+#include <map>
+#include <memory>
+#include <vector>
 
 #include "elementset.h"
 
+class Capacitance;
 class CircuitDocument;
+class Inductance;
+class NgspiceCircuit;
+class QDataStream;
 class Wire;
 class Pin;
 class Element;
@@ -24,16 +33,45 @@ class LogicOut;
 
 typedef QList<QPointer<Pin>> PinList;
 typedef QList<Element *> ElementList;
+class Reactive;
+typedef QList<Reactive *> ReactiveList;
+class SharedLogicCache;
 
-class LogicCacheNode
+/**
+Counts of how much work a Circuit has been doing, for finding the circuits
+that take up the simulation time.
+*/
+class CircuitStats
 {
 public:
-    LogicCacheNode();
-    ~LogicCacheNode();
+    CircuitStats()
+    {
+        reset();
+    }
+    void reset()
+    {
+        solves = logicSolves = cacheHits = cacheMisses = 0;
+        solveNs = 0;
+    }
 
-    LogicCacheNode *high;
-    LogicCacheNode *low;
-    QuickVector *data;
+    unsigned long solves;      ///< calls to solveNonLogic that solved the circuit
+    unsigned long logicSolves; ///< calls to doLogic, after a LogicOut in the circuit changed
+    unsigned long cacheHits;   ///< solutions found in the logic cache
+    unsigned long cacheMisses; ///< solutions that had to be solved for and added to the cache
+    qint64 solveNs;            ///< time spent in solveNonLogic, while timing is enabled
+};
+
+/**
+One of the ways that Circuit::solveNonLogic can go about solving a circuit,
+of which it picks the quickest by trying each in turn.
+*/
+class SolverStrategy
+{
+public:
+    int solver;      ///< the Matrix::SolverType
+    bool luCache;    ///< whether the matrix keeps its factorizations in its LU cache
+    bool logicCache; ///< whether solutions are kept in the logic cache
+    double cost;     ///< ns per solve when last tried, or negative if not known
 };
 
 /**
@@ -58,6 +96,10 @@ public:
     void addElement(Element *element);
 
     bool contains(Pin *node);
+    ElementSet *elementSet() const
+    {
+        return m_elementSet;
+    }
     bool containsNonLinear() const
     {
         return m_elementSet->containsNonLinear();
@@ -66,27 +108,179 @@ public:
     void init();
     /**
      * Called after everything else has been setup - before doNonLogic or
-     * doLogic are called for the first time. Preps the circuit.
+     * doLogic are called for the first time. Preps the circuit, and starts
+     * trying out the ways of solving it (see SolverStrategy).
      */
     void initCache();
     /**
-     * Marks all cached results as invalidated and removes them.
+     * Marks all cached results as invalidated and removes them. A cache that
+     * is shared with other circuits is left to them, and this circuit starts
+     * a cache of its own.
      */
     void setCacheInvalidated();
     /**
-     * Solves for non-logic elements
+     * Solves for non-logic elements. Equivalent to solveNonLogic followed by
+     * finishNonLogic.
      */
     void doNonLogic();
+    /**
+     * The part of doNonLogic that only touches this circuit's own elements,
+     * and so may be run in a worker thread alongside other circuits.
+     */
+    void solveNonLogic();
+    /**
+     * The part of doNonLogic that passes the solution back to the pins and
+     * logic inputs (which can call into components). Must be called from the
+     * simulator thread after solveNonLogic.
+     */
+    void finishNonLogic();
+    /**
+     * Solves for the DC operating point with the values the elements have
+     * now, and passes it on to the pins. The capacitors and inductors are
+     * taken out of the matrix (as open and short circuits), restarting their
+     * integration from the operating point when the simulation carries on;
+     * signals keep the value they have at the time.
+     *
+     * The Newton iteration starts from the last solution, so stepping a
+     * value in small steps and solving after each (a DC sweep) follows the
+     * solution along from one step to the next, usually in a few iterations
+     * each.
+     * @return whether the solution converged
+     */
+    bool solveDc();
+    /**
+     * @return the size of the MNA system, as a rough measure of how much work
+     * solving this circuit is.
+     */
+    int equationCount() const
+    {
+        return m_cnodeCount + m_branchCount;
+    }
+    /**
+     * @return how the Newton iteration has been getting on, for circuits
+     * that contain nonlinear elements.
+     */
+    const NonLinearStats &nonLinearStats() const
+    {
+        return m_elementSet->nonLinearStats();
+    }
+    /**
+     * @return the counts of the work done by this circuit, since they were
+     * last reset.
+     */
+    const CircuitStats &stats() const
+    {
+        return m_stats;
+    }
+    /**
+     * @return the number of (numeric) factorizations of the matrix, and the
+     * number restored from the LU cache.
+     */
+    unsigned long factorizationCount() const;
+    qint64 factorizationNs() const;
+    unsigned long restoredFactorizationCount() const;
+    /**
+     * @return whether the matrix is solved with the sparse LU decomposition
+     */
+    bool usesSparseSolver() const;
+    /**
+     * @return whether the matrix is solved with the banded LU decomposition
+     */
+    bool usesBandedSolver() const;
+    /**
+     * @return whether the matrix keeps its factorizations in its LU cache
+     */
+    bool usesLUCache() const;
+    /**
+     * @return whether solutions for each state of the LogicOuts are kept in
+     * the logic cache
+     */
+    bool usesLogicCache() const
+    {
+        return m_bCanCache && m_bUseLogicCache;
+    }
+    /**
+     * @return whether the strategies are still being timed, in which case
+     * the ones above may change
+     */
+    bool isChoosingStrategy() const
+    {
+        return m_bTryingStrategies;
+    }
+    /**
+     * @return the bytes of the logic cache, shared out between the circuits
+     * that use it
+     */
+    qint64 logicCacheMemoryUsage() const;
+    /**
+     * Empties the logic cache (of this and of the circuits it is shared
+     * with), and frees its memory.
+     */
+    void trimLogicCache();
+    /**
+     * Resets the stats, nonLinearStats and factorization counts.
+     */
+    void resetStats();
+    /**
+     * Sets whether solveNonLogic records how long it takes in stats(), and
+     * the matrix how long its LU decompositions take. Off by default, as
+     * reading the clock for every solve is not free.
+     */
+    static void setTimingEnabled(bool enabled);
+    static bool timingEnabled()
+    {
+        return m_bTimingEnabled;
+    }
+    /**
+     * Sets whether circuits are simulated the way they were before the
+     * adaptive integration and solver strategies: energy storage stepped with
+     * backward Euler once every linear update, no solutions cached for logic
+     * states, and the matrix in its reference mode (see
+     * Matrix::setReferenceMode). For recording reference results; set it
+     * before the circuits are built.
+     */
+    static void setReferenceMode(bool reference);
+    static bool referenceMode()
+    {
+        return m_bReferenceMode;
+    }
+    const PinList &pins() const
+    {
+        return m_pinList;
+    }
     /**
      * Solves for logic elements (i.e just does fbSub)
      */
     void doLogic()
     {
+        // ngspice sees the change from the next linear update on
+        if (m_pNgspice)
+            return;
+        m_stats.logicSolves++;
         m_elementSet->doLinear(false);
     }
+    /**
+     * @return whether the circuit is being solved by ngspice rather than by
+     * its element set (see NgspiceCircuit)
+     */
+    bool usesNgspice() const
+    {
+        return m_pNgspice;
+    }
 
     void displayEquations();
     void updateCurrents();
+    /**
+     * Writes the solution (the nodal voltages and branch currents), for
+     * saving the state of the simulation.
+     */
+    void saveState(QDataStream &stream) const;
+    /**
+     * Reads back a solution written by saveState, and passes it on to the
+     * pins. The elements should have their state restored first.
+     * @return false if the solution is not of the size of this circuit
+     */
+    bool restoreState(QDataStream &stream);
 
     void createMatrixMap();
     /**
@@ -107,6 +301,23 @@ public:
     {
         return m_pNextChanged[chain];
     }
+    /**
+     * @return true if the circuit has settled, and is not being solved until
+     * something changes.
+     */
+    bool isParked() const
+    {
+        return m_bParked;
+    }
+    /**
+     * Makes a settled circuit carry on solving, e.g. because one of its
+     * LogicOuts changed.
+     */
+    void wake()
+    {
+        m_bParked = false;
+        m_settledSteps = 0;
+    }
     void setCanAddChanged(bool canAdd)
     {
         m_bCanAddChanged = canAdd;
@@ -115,38 +326,151 @@ public:
     {
         return m_bCanAddChanged;
     }
+    /**
+     * Adds each node in nodeList to eqs (keyed by the number of
+     * circuit-dependent pins) along with the nodes it is connected to.
+     * Returns the number of the groups that contain ground.
+     */
+    static int groupConnectedPins(const PinList &nodeList, std::multimap<int, PinList> *eqs);
 
 protected:
+    /**
+     * Looks for the solution in the logic cache, and otherwise solves for it
+     * (see solveUncached) and adds it.
+     */
     void cacheAndUpdate();
+    /**
+     * Solves a circuit that is linear, or nonlinear without energy storage,
+     * from scratch.
+     */
+    void solveUncached();
+    /**
+     * Sets up m_strategies from the solvers the matrix has available and
+     * the caches that are of use to this circuit, and starts trying them.
+     */
+    void initStrategies();
+    /**
+     * Starts timing each of m_strategies in turn, from the first.
+     */
+    void startStrategyTrial();
+    /**
+     * Switches the matrix and caches to m_strategies[i].
+     */
+    void useStrategy(int i);
+    /**
+     * Called at the end of solveNonLogic while there is a choice of
+     * strategies, with how long it took. Moves the trial on, or starts
+     * another every STRATEGY_TRIAL_INTERVAL steps.
+     */
+    void updateStrategy(bool solved, qint64 ns);
+    /**
+     * Sets m_pLogicCache to the cache of a circuit that is built the same as
+     * this one (the same matrix, source vector and LogicOuts), if there is
+     * one, so that the solutions found by either are used by both. Only
+     * linear circuits are shared, as the solutions of nonlinear ones also
+     * depend on the parameters of the nonlinear elements.
+     */
+    void shareLogicCache();
+    /**
+     * Gives this circuit an empty cache of its own.
+     */
+    void detachLogicCache();
     /**
      * Update the nodal voltages from those calculated in ElementSet
      */
     void updateNodalVoltages();
     /**
-     * Step the reactive elements.
+     * Step the reactive elements that are stepped once per linear update.
      */
     void stepReactive();
     /**
-     * Returns true if any of the nodes are ground
+     * Steps the energy storage elements on by delta.
+     */
+    void stepEnergyStorage(double delta);
+    /**
+     * Steps the energy storage elements again, from where the last step
+     * started, with the shorter delta.
      */
-    static bool recursivePinAdd(Pin *node, PinList *unassignedNodes, PinList *associated, PinList *nodes);
+    void retryEnergyStorage(double delta);
+    /**
+     * Steps the reactive elements and solves over one linear update period,
+     * in as many steps as the truncation error of the energy storage
+     * elements calls for. Steps are LINEAR_UPDATE_PERIOD / 2^n for n up to
+     * MAX_STEP_LEVEL, and a step whose error is too large is done again
+     * with a shorter one.
+     * @return whether the solution changed
+     */
+    bool solveTransient();
+    /**
+     * Solves the circuit once with the current matrix and source vector.
+     * @return whether the solution changed
+     */
+    bool solveStep();
+    /**
+     * Solves for the nonlinear elements, with gmin stepping the first time
+     * after init (see ElementSet::solveOperatingPoint), and once the
+     * operating point has been found, keeps it for warm starting circuits
+     * with the same topology later.
+     */
+    void doNonLinear(int maxIterations, double maxErrorV, double maxErrorI);
+    /**
+     * @return the largest truncationError of the energy storage elements
+     */
+    double truncationError() const;
+    /**
+     * Parks the circuit once its solution has not moved for SETTLE_STEPS
+     * linear updates. Circuits with signals are never parked.
+     */
+    void updateSettled();
 
     int m_cnodeCount;
     int m_branchCount;
     int m_prepNLCount; // Count until next m_elementSet->prepareNonLinear() is called
+    bool m_bNonLogicSolved; // Set by solveNonLogic if finishNonLogic has results to pass on
 
     PinList m_pinList;
     ElementList m_elementList;
+    std::vector<Pin *> m_pins;    // The pins of m_pinList, as they were at init
+    std::vector<int> m_pinCNodes; // The cnode of each of m_pins, or -1 for ground
+    ReactiveList m_signalList; // Reactive elements that are stepped once per linear update
+    // The energy storage elements, by type, so that each is stepped without
+    // going through the vtable
+    std::vector<Capacitance *> m_capacitances;
+    std::vector<Inductance *> m_inductances;
+    int m_stepLevel; // Steps are currently LINEAR_UPDATE_PERIOD / 2^m_stepLevel
+
+    // Stuff for parking settled circuits
+    bool m_bParked;
+    int m_settledSteps;
+    std::vector<double> m_settledX; // The solution after the last linear update
+
+    // Stuff for warm starting
+    std::vector<quintptr> m_topologyKey; // The pins, their cnodes and the elements
+    bool m_bFindOperatingPoint;          // Whether the next nonlinear solve is the first since init
     ElementSet *m_elementSet;
+    NgspiceCircuit *m_pNgspice; // If the circuit is solved by ngspice
 
     // Stuff for caching
     bool m_bCanCache;
-    LogicCacheNode *m_pLogicCacheBase;
+    bool m_bUseLogicCache; // Whether the logic cache is used, if it can be
+    std::shared_ptr<SharedLogicCache> m_pLogicCache;
     unsigned m_logicOutCount;
     LogicOut **m_pLogicOut;
 
     bool m_bCanAddChanged;
     Circuit *m_pNextChanged[2];
+
+    // Stuff for picking the strategy
+    std::vector<SolverStrategy> m_strategies; // Empty if there is no choice
+    int m_strategy;                           // The one in use
+    bool m_bTryingStrategies;
+    int m_strategySteps; // Since the strategy was switched, or since the last trial ended
+    int m_trialSolves;   // With the strategy being tried
+    qint64 m_trialNs;
+
+    CircuitStats m_stats;
+    static bool m_bTimingEnabled;
+    static bool m_bReferenceMode;
 };
 
 #endif
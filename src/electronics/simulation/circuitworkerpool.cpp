@@ -0,0 +1,146 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "circuitworkerpool.h"
+#include "circuit.h"
+
+#include <QThread>
+
+// BEGIN class CircuitWorker
+class CircuitWorker : public QThread
+{
+public:
+    CircuitWorker(CircuitWorkerPool *pool)
+        : m_pPool(pool)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        m_pPool->workerLoop();
+    }
+
+    CircuitWorkerPool *m_pPool;
+};
+// END class CircuitWorker
+
+// BEGIN class CircuitWorkerPool
+CircuitWorkerPool::CircuitWorkerPool(int threadCount)
+    : m_pCircuits(nullptr)
+    , m_pBatchEnds(nullptr)
+    , m_nextCircuit(0)
+    , m_busyWorkers(0)
+    , m_generation(0)
+    , m_bQuit(false)
+{
+    for (int i = 0; i < threadCount; ++i) {
+        CircuitWorker *worker = new CircuitWorker(this);
+        m_workers.push_back(worker);
+        worker->start();
+    }
+}
+
+CircuitWorkerPool::~CircuitWorkerPool()
+{
+    m_mutex.lock();
+    m_bQuit = true;
+    m_startCondition.wakeAll();
+    m_mutex.unlock();
+
+    for (std::vector<CircuitWorker *>::iterator it = m_workers.begin(); it != m_workers.end(); ++it) {
+        (*it)->wait();
+        delete *it;
+    }
+}
+
+void CircuitWorkerPool::solveNonLogic(const std::vector<Circuit *> &circuits)
+{
+    solve(circuits, nullptr);
+}
+
+void CircuitWorkerPool::solveNonLogic(const std::vector<Circuit *> &circuits, const std::vector<int> &batchEnds)
+{
+    solve(circuits, &batchEnds);
+}
+
+void CircuitWorkerPool::solve(const std::vector<Circuit *> &circuits, const std::vector<int> *batchEnds)
+{
+    const size_t batches = batchEnds ? batchEnds->size() : circuits.size();
+    if (m_workers.empty() || batches < 2) {
+        for (std::vector<Circuit *>::const_iterator it = circuits.begin(); it != circuits.end(); ++it)
+            (*it)->solveNonLogic();
+        return;
+    }
+
+    m_mutex.lock();
+    m_pCircuits = &circuits;
+    m_pBatchEnds = batchEnds;
+    m_nextCircuit.storeRelease(0);
+    m_busyWorkers = m_workers.size();
+    m_generation++;
+    m_startCondition.wakeAll();
+    m_mutex.unlock();
+
+    drain();
+
+    m_mutex.lock();
+    while (m_busyWorkers > 0)
+        m_doneCondition.wait(&m_mutex);
+    m_pCircuits = nullptr;
+    m_pBatchEnds = nullptr;
+    m_mutex.unlock();
+}
+
+void CircuitWorkerPool::drain()
+{
+    const std::vector<Circuit *> &circuits = *m_pCircuits;
+
+    int i;
+    if (!m_pBatchEnds) {
+        const int count = circuits.size();
+        while ((i = m_nextCircuit.fetchAndAddOrdered(1)) < count)
+            circuits[i]->solveNonLogic();
+        return;
+    }
+
+    const std::vector<int> &batchEnds = *m_pBatchEnds;
+    const int count = batchEnds.size();
+    while ((i = m_nextCircuit.fetchAndAddOrdered(1)) < count) {
+        const int end = batchEnds[i];
+        for (int circuit = i ? batchEnds[i - 1] : 0; circuit < end; ++circuit)
+            circuits[circuit]->solveNonLogic();
+    }
+}
+
+void CircuitWorkerPool::workerLoop()
+{
+    unsigned generation = 0;
+
+    m_mutex.lock();
+    while (true) {
+        while (!m_bQuit && generation == m_generation)
+            m_startCondition.wait(&m_mutex);
+
+        if (m_bQuit)
+            break;
+
+        generation = m_generation;
+        m_mutex.unlock();
+
+        drain();
+
+        m_mutex.lock();
+        if (--m_busyWorkers == 0)
+            m_doneCondition.wakeAll();
+    }
+    m_mutex.unlock();
+}
+// END class CircuitWorkerPool
@@ -0,0 +1,95 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef CIRCUITWORKERPOOL_H
+#define CIRCUITWORKERPOOL_H
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <vector>
+
+class Circuit;
+class CircuitWorker;
+
+/**
+A set of threads that solve independent Circuits in parallel. Circuits are
+taken one at a time from a shared queue, so threads that got small circuits
+pick up more of them while another thread is busy with a large one. Giving
+the circuits largest first keeps the threads from all waiting on one big
+circuit at the end. Small circuits can be given in batches (e.g. those of one
+document), so that they are taken together.
+
+Only Circuit::solveNonLogic is called from the worker threads; everything
+that can call back into components (logic callbacks, pin voltages) is left
+for Circuit::finishNonLogic, which the caller does afterwards.
+
+@short Parallel solving of electrically independent circuits
+*/
+class CircuitWorkerPool
+{
+public:
+    /**
+     * @param threadCount the number of threads to create, in addition to the
+     * calling thread (which also takes part in solving).
+     */
+    CircuitWorkerPool(int threadCount);
+    ~CircuitWorkerPool();
+
+    int threadCount() const
+    {
+        return m_workers.size();
+    }
+    /**
+     * Calls Circuit::solveNonLogic for every circuit, returning once all of
+     * them have been solved.
+     */
+    void solveNonLogic(const std::vector<Circuit *> &circuits);
+    /**
+     * As solveNonLogic, but the threads take the circuits a batch at a time,
+     * solving each batch in order. Batching the small circuits keeps them
+     * from costing more to hand out than to solve.
+     * @param batchEnds the index in circuits after the last circuit of each
+     * batch, in increasing order
+     */
+    void solveNonLogic(const std::vector<Circuit *> &circuits, const std::vector<int> &batchEnds);
+
+protected:
+    /**
+     * Solves the circuits in batches, or one by one if batchEnds is null.
+     */
+    void solve(const std::vector<Circuit *> &circuits, const std::vector<int> *batchEnds);
+    /**
+     * Solves batches from the queue until it is empty.
+     */
+    void drain();
+    /**
+     * Run by each worker thread.
+     */
+    void workerLoop();
+
+    std::vector<CircuitWorker *> m_workers;
+
+    QMutex m_mutex;
+    QWaitCondition m_startCondition;
+    QWaitCondition m_doneCondition;
+
+    const std::vector<Circuit *> *m_pCircuits;
+    const std::vector<int> *m_pBatchEnds; ///< null while each circuit is a batch of its own
+    QAtomicInt m_nextCircuit;               ///< the next batch to be taken
+    int m_busyWorkers;
+    unsigned m_generation;
+    bool m_bQuit;
+
+    friend class CircuitWorker;
+};
+
+#endif
@@ -11,6 +11,8 @@
 #include "currentsignal.h"
 #include "element.h"
 
+#include <QDataStream>
+
 CurrentSignal::CurrentSignal(double delta, double current)
     : Reactive::Reactive(delta)
 {
@@ -26,8 +28,8 @@ CurrentSignal::~CurrentSignal()
 void CurrentSignal::setCurrent(double i)
 {
     // Instead of calling step again, we can just "adjust" what the current should be
-    m_newCurrent *= i / m_current;
     m_current = i;
+    m_newCurrent = m_current * amplitude();
     addCurrents();
 }
 
@@ -49,6 +51,18 @@ void CurrentSignal::time_step()
     addCurrents();
 }
 
+void CurrentSignal::saveState(QDataStream &stream) const
+{
+    stream << m_phase << m_time;
+}
+
+void CurrentSignal::restoreState(QDataStream &stream)
+{
+    stream >> m_phase >> m_time;
+    m_newCurrent = m_current * amplitude();
+    addCurrents();
+}
+
 void CurrentSignal::addCurrents()
 {
     if (!b_status)
@@ -33,7 +33,17 @@ public:
     {
         return m_current;
     }
+    /**
+     * @return the current of the signal at the present time, as last
+     * worked out by time_step
+     */
+    double outputCurrent() const
+    {
+        return m_newCurrent;
+    }
     void time_step() override;
+    void saveState(QDataStream &stream) const override;
+    void restoreState(QDataStream &stream) override;
 
 protected:
     void updateCurrents() override;
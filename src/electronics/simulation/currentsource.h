@@ -29,6 +29,10 @@ public:
         return Element_CurrentSource;
     }
     void setCurrent(const double i);
+    double current() const
+    {
+        return m_i;
+    }
 
 protected:
     void updateCurrents() override;
@@ -72,18 +72,26 @@ void Diode::updateCurrents()
 
 void Diode::update_dc()
 {
-    if (!b_status)
-        return;
+    evaluate_dc();
+    stamp_dc();
+}
 
-    calc_eq();
+void Diode::evaluate_dc()
+{
+    if (b_status)
+        calc_eq();
+}
 
-    A_g(0, 0) += g_new - g_old;
-    A_g(1, 1) += g_new - g_old;
-    A_g(0, 1) -= g_new - g_old;
-    A_g(1, 0) -= g_new - g_old;
+void Diode::stamp_dc()
+{
+    if (!b_status)
+        return;
 
-    b_i(0) -= I_new - I_old;
-    b_i(1) += I_new - I_old;
+    const double g = g_new - g_old;
+    const double I = I_new - I_old;
+    const double A[2][2] = {{g, -g}, {-g, g}};
+    const double b[2] = {-I, I};
+    m_stamp.stamp(p_eSet, p_cnode, A, b);
 
     g_old = g_new;
     I_old = I_new;
@@ -123,9 +131,11 @@ void Diode::calcIg(double V, double *I_D, double *g) const
     double g_tiny = (V < -10 * V_T * N && V_B != 0) ? I_S : 0;
 
     if (V >= (-3 * N * V_T)) {
+        double I, g_D;
+        diodeCurrentConductance(V, I_S, N, &I, &g_D);
+        *I_D = I + (g_tiny * V);
         if (g)
-            *g = diodeConductance(V, I_S, N) + g_tiny;
-        *I_D = diodeCurrent(V, I_S, N) + (g_tiny * V);
+            *g = g_D + g_tiny;
     } else if (V_B == 0 || V >= -V_B) {
         double a = (3 * N * V_T) / (V * M_E);
         a = a * a * a;
@@ -12,6 +12,7 @@
 #define DIODE_H
 
 #include "nonlinear.h"
+#include "stampkernel.h"
 
 class DiodeSettings
 {
@@ -38,13 +39,15 @@ This simulates a diode. The simulated diode characteristics are:
 @short Simulates the electrical property of diode-ness
 @author David Saxton
 */
-class Diode : public NonLinear
+class Diode final : public NonLinear
 {
 public:
     Diode();
     ~Diode() override;
 
     void update_dc() override;
+    void evaluate_dc() override;
+    void stamp_dc() override;
     void add_initial_dc() override;
     Element::Type type() const override
     {
@@ -72,6 +75,7 @@ protected:
     double V_lim;
 
     DiodeSettings m_diodeSettings;
+    StampKernel<2> m_stamp;
 };
 
 #endif
@@ -12,10 +12,101 @@
 #include "elementset.h"
 
 #include <cassert>
+#include <mutex>
+#include <new>
+#include <vector>
 
 #include <ktechlab_debug.h>
 
+namespace
+{
+/**
+ * Free lists of blocks for the elements, one for each multiple of
+ * BLOCK_ALIGN bytes up to MAX_BLOCK_SIZE. Blocks are carved from chunks of
+ * BLOCKS_PER_CHUNK contiguous blocks, which are kept for the lifetime of the
+ * program, so that the blocks of deleted elements are reused by the next
+ * circuits built. Larger elements use the global allocator.
+ */
+class ElementPool
+{
+public:
+    static const size_t BLOCK_ALIGN = 16;
+    static const size_t MAX_BLOCK_SIZE = 1024;
+    static const size_t BLOCKS_PER_CHUNK = 64;
+
+    ~ElementPool()
+    {
+        for (char *chunk : m_chunks)
+            ::operator delete(chunk);
+    }
+
+    void *allocate(size_t size)
+    {
+        if (size > MAX_BLOCK_SIZE)
+            return ::operator new(size);
+
+        const size_t sizeClass = (size + BLOCK_ALIGN - 1) / BLOCK_ALIGN;
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        FreeBlock *&head = m_free[sizeClass];
+        if (!head) {
+            const size_t blockSize = sizeClass * BLOCK_ALIGN;
+            char *chunk = static_cast<char *>(::operator new(blockSize * BLOCKS_PER_CHUNK));
+            m_chunks.push_back(chunk);
+            for (size_t i = BLOCKS_PER_CHUNK; i-- > 0;) {
+                FreeBlock *block = reinterpret_cast<FreeBlock *>(chunk + i * blockSize);
+                block->next = head;
+                head = block;
+            }
+        }
+
+        FreeBlock *block = head;
+        head = block->next;
+        return block;
+    }
+
+    void release(void *p, size_t size)
+    {
+        if (size > MAX_BLOCK_SIZE)
+            return ::operator delete(p);
+
+        const size_t sizeClass = (size + BLOCK_ALIGN - 1) / BLOCK_ALIGN;
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        FreeBlock *block = static_cast<FreeBlock *>(p);
+        block->next = m_free[sizeClass];
+        m_free[sizeClass] = block;
+    }
+
+protected:
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    std::mutex m_mutex;
+    FreeBlock *m_free[MAX_BLOCK_SIZE / BLOCK_ALIGN + 1] = {};
+    std::vector<char *> m_chunks;
+};
+
+ElementPool &elementPool()
+{
+    static ElementPool pool;
+    return pool;
+}
+}
+
 // BEGIN class Element
+void *Element::operator new(size_t size)
+{
+    return elementPool().allocate(size);
+}
+
+void Element::operator delete(void *p, size_t size)
+{
+    if (p)
+        elementPool().release(p, size);
+}
+
 Element::Element()
 {
     b_status = false;
@@ -91,6 +182,7 @@ void Element::setCNodes(const int n0, const int n1, const int n2, const int n3)
     p_cnode[2] = (n2 > -1) ? p_eSet->cnodes()[n2] : (n2 == -1 ? p_eSet->ground() : nullptr);
     p_cnode[3] = (n3 > -1) ? p_eSet->cnodes()[n3] : (n3 == -1 ? p_eSet->ground() : nullptr);
     updateStatus();
+    p_eSet->setLogicThresholdsChanged();
 }
 
 void Element::setCBranches(const int b0, const int b1, const int b2, const int b3)
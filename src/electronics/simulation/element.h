@@ -14,9 +14,12 @@
 #include "elementset.h"
 #include "matrix.h"
 
+#include <QtGlobal>
+
 #include <stdint.h>
 
 class ElementSet;
+class QDataStream;
 typedef unsigned int uint;
 
 const double T = 300.;            ///< Temperature in Kelvin
@@ -131,6 +134,13 @@ public:
 
     Element();
     virtual ~Element();
+    /**
+     * Elements are allocated from pools of blocks of the same size, as
+     * circuits create and delete many small elements each time they are
+     * rebuilt.
+     */
+    static void *operator new(size_t size);
+    static void operator delete(void *p, size_t size);
     /**
      * This must be called when the circuit is changed. The function will get
      * all the required pointers from ElementSet
@@ -207,7 +217,29 @@ public:
      * Returns the type of element
      */
     virtual Type type() const = 0;
+    /**
+     * Elements that keep state between simulation steps (other than the
+     * nodal voltages and branch currents, which are kept by Circuit)
+     * reinherit these to write and read it back, for saving the state of
+     * the simulation.
+     */
+    virtual void saveState(QDataStream &stream) const
+    {
+        Q_UNUSED(stream);
+    }
+    virtual void restoreState(QDataStream &stream)
+    {
+        Q_UNUSED(stream);
+    }
 
+    /**
+     * @return whether the element takes part in the circuit, i.e. it has its
+     * nodes and branches, and not all of its nodes are ground
+     */
+    bool isActive() const
+    {
+        return b_status;
+    }
     /**
      * Does the required MNA stuff. This should be called from ElementSet when necessary.
      */
@@ -240,6 +272,45 @@ protected:
 
     inline double &b_i(uint i);
     inline double &b_v(uint i);
+    /**
+     * Adds delta to the conductance between cnodes i and j (as with A_g),
+     * only marking the matrix as changed if it changes.
+     */
+    inline void stampG(uint i, uint j, double delta);
+    /**
+     * As stampG, for the entries between cbranches i and j (as with A_d).
+     */
+    inline void stampD(uint i, uint j, double delta);
+    /**
+     * As stampG, for the entry of cbranch i and cnode j (as with A_c).
+     */
+    inline void stampC(uint i, uint j, double delta);
+    /**
+     * Adds the conductance g between cnodes i and j, i.e. g to their own
+     * entries and -g to the entries between them.
+     */
+    inline void stampConductance(uint i, uint j, double g);
+    /**
+     * As stampConductance, but as a low-rank update to the decomposition of
+     * the matrix (see Matrix::addRankOne), for conductances that are
+     * switched back and forth.
+     */
+    inline void stampConductanceRankOne(uint i, uint j, double g);
+    /**
+     * As stampConductanceRankOne, for a conductance between cnode i and
+     * ground.
+     */
+    inline void stampConductanceRankOne(uint i, double g);
+    /**
+     * Adds delta to the current into cnode i (as with b_i), leaving the
+     * vector unchanged if delta is zero, so that a parked or cached
+     * circuit is not solved again for nothing.
+     */
+    inline void stampI(uint i, double delta);
+    /**
+     * As stampI, for the voltage of cbranch i (as with b_v).
+     */
+    inline void stampV(uint i, double delta);
 
     ElementSet *p_eSet;
 
@@ -307,4 +378,65 @@ double &Element::b_v(uint i)
     return (*(p_eSet->b()))[p_eSet->cnodeCount() + p_cbranch[i]->n()];
 }
 
+void Element::stampG(uint i, uint j, double delta)
+{
+    if (p_cnode[i]->isGround || p_cnode[j]->isGround)
+        return;
+    p_eSet->matrix()->add(p_cnode[i]->n(), p_cnode[j]->n(), delta);
+}
+
+void Element::stampD(uint i, uint j, double delta)
+{
+    const int n = p_eSet->cnodeCount();
+    p_eSet->matrix()->add(n + p_cbranch[i]->n(), n + p_cbranch[j]->n(), delta);
+}
+
+void Element::stampC(uint i, uint j, double delta)
+{
+    if (p_cnode[j]->isGround)
+        return;
+    p_eSet->matrix()->add(p_eSet->cnodeCount() + p_cbranch[i]->n(), p_cnode[j]->n(), delta);
+}
+
+void Element::stampConductance(uint i, uint j, double g)
+{
+    if (g == 0.)
+        return;
+    stampG(i, i, g);
+    stampG(j, j, g);
+    stampG(i, j, -g);
+    stampG(j, i, -g);
+}
+
+void Element::stampConductanceRankOne(uint i, uint j, double g)
+{
+    const int a = p_cnode[i]->isGround ? -1 : p_cnode[i]->n();
+    const int b = p_cnode[j]->isGround ? -1 : p_cnode[j]->n();
+    if (a < 0 && b < 0)
+        return;
+    p_eSet->matrix()->addRankOne(a, b, a, b, g);
+}
+
+void Element::stampConductanceRankOne(uint i, double g)
+{
+    if (p_cnode[i]->isGround)
+        return;
+    const int a = p_cnode[i]->n();
+    p_eSet->matrix()->addRankOne(a, -1, a, -1, g);
+}
+
+void Element::stampI(uint i, double delta)
+{
+    if (delta == 0. || p_cnode[i]->isGround)
+        return;
+    (*(p_eSet->b()))[p_cnode[i]->n()] += delta;
+}
+
+void Element::stampV(uint i, double delta)
+{
+    if (delta == 0.)
+        return;
+    (*(p_eSet->b()))[p_eSet->cnodeCount() + p_cbranch[i]->n()] += delta;
+}
+
 #endif
@@ -11,16 +11,49 @@
 #include "elementset.h"
 #include "bjt.h"
 #include "circuit.h"
+#include "diode.h"
 #include "element.h"
+#include "jfet.h"
 #include "logic.h"
 #include "matrix.h"
-#include "nonlinear.h"
+#include "mosfet.h"
+#include "opamp.h"
 
 #include <QDebug>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <functional>
 #include <iostream>
+#include <limits>
+
+/**
+Evaluates a chunk of the nonlinear devices of an ElementSet on the thread pool.
+*/
+class NonLinearJob : public QRunnable
+{
+public:
+    NonLinearJob(std::function<void()> evaluate, QSemaphore *done)
+        : m_evaluate(evaluate)
+        , m_done(done)
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override
+    {
+        m_evaluate();
+        m_done->release();
+    }
+
+protected:
+    std::function<void()> m_evaluate;
+    QSemaphore *m_done;
+};
 
 ElementSet::ElementSet(Circuit *circuit, const int n, const int m)
     : m_cb(m)
@@ -30,29 +63,41 @@ ElementSet::ElementSet(Circuit *circuit, const int n, const int m)
     int tmp = m_cn + m_cb;
 
     p_logicIn = nullptr;
+    b_logicThresholdsChanged = true;
 
     if (tmp) {
         p_A = new Matrix(m_cn, m_cb);
         p_b = new QuickVector(tmp);
         p_x = new QuickVector(tmp);
+        p_dx = new QuickVector(tmp);
+        p_dx_prev = new QuickVector(tmp);
     } else {
         p_A = nullptr;
-        p_x = p_b = nullptr;
+        p_x = p_b = p_dx = p_dx_prev = nullptr;
     }
 
+    // The nodes and branches are kept in contiguous arrays, with the arrays
+    // of pointers handed to the elements pointing into them
+    m_cnodeStorage = new CNode[m_cn];
     m_cnodes = new CNode *[m_cn];
     for (uint i = 0; i < m_cn; i++) {
-        m_cnodes[i] = new CNode(i);
+        m_cnodeStorage[i].set_n(i);
+        m_cnodes[i] = &m_cnodeStorage[i];
     }
 
+    m_cbranchStorage = new CBranch[m_cb];
     m_cbranches = new CBranch *[m_cb];
     for (uint i = 0; i < m_cb; i++) {
-        m_cbranches[i] = new CBranch(i);
+        m_cbranchStorage[i].set_n(i);
+        m_cbranches[i] = &m_cbranchStorage[i];
     }
 
     m_ground = new CNode();
     m_ground->isGround = true;
     b_containsNonLinear = false;
+    b_deferLogicCheck = false;
+    b_haveLU = false;
+    b_lastConverged = false;
 }
 
 ElementSet::~ElementSet()
@@ -66,13 +111,10 @@ ElementSet::~ElementSet()
             (*it)->elementSetDeleted();
     }
 
-    for (uint i = 0; i < m_cn; i++)
-        delete m_cnodes[i];
-    for (uint i = 0; i < m_cb; i++)
-        delete m_cbranches[i];
-
     delete[] m_cbranches;
+    delete[] m_cbranchStorage;
     delete[] m_cnodes;
+    delete[] m_cnodeStorage;
     delete[] p_logicIn;
     delete m_ground;
     if (p_A)
@@ -81,6 +123,8 @@ ElementSet::~ElementSet()
         delete p_b;
     if (p_x)
         delete p_x;
+    delete p_dx;
+    delete p_dx_prev;
 }
 
 void ElementSet::setCacheInvalidated()
@@ -94,15 +138,61 @@ void ElementSet::addElement(Element *e)
         return;
     e->setElementSet(this);
     m_elementList.append(e);
-    if (e->isNonLinear()) {
-        b_containsNonLinear = true;
-        m_cnonLinearList.append(static_cast<NonLinear *>(e));
+    switch (e->type()) {
+    case Element::Element_Diode:
+        m_diodes.push_back(static_cast<Diode *>(e));
+        break;
+    case Element::Element_BJT:
+        m_bjts.push_back(static_cast<BJT *>(e));
+        break;
+    case Element::Element_JFET:
+        m_jfets.push_back(static_cast<JFET *>(e));
+        break;
+    case Element::Element_MOSFET:
+        m_mosfets.push_back(static_cast<MOSFET *>(e));
+        break;
+    case Element::Element_OpAmp:
+        m_opAmps.push_back(static_cast<OpAmp *>(e));
+        return;
+    default:
+        Q_ASSERT(!e->isNonLinear());
+        return;
     }
+    b_containsNonLinear = true;
 }
 
 void ElementSet::createMatrixMap()
 {
-    // mapping nolonger done, overly ambitious optimization...
+    // Tell the matrix which elements can be nonzero, so that it can decide
+    // whether to use the sparse solver. An element only ever adds to the
+    // entries between its own cnodes and cbranches.
+    if (p_A) {
+        ElementList::iterator end = m_elementList.end();
+        for (ElementList::iterator it = m_elementList.begin(); it != end; ++it) {
+            Element *e = *it;
+
+            unsigned ids[MAX_CNODES + MAX_CBRANCHES];
+            unsigned count = 0;
+
+            for (int i = 0; i < e->numCNodes(); i++) {
+                CNode *node = e->cnode(i);
+                if (node && !node->isGround)
+                    ids[count++] = node->n();
+            }
+            for (int i = 0; i < e->numCBranches(); i++) {
+                if (CBranch *branch = e->cbranch(i))
+                    ids[count++] = m_cn + branch->n();
+            }
+
+            for (unsigned i = 0; i < count; i++) {
+                for (unsigned j = 0; j < count; j++)
+                    p_A->setUse(ids[i], ids[j]);
+            }
+        }
+
+        p_A->createMap();
+        b_haveLU = false;
+    }
 
     // And do our logic as well...
 
@@ -119,55 +209,182 @@ void ElementSet::createMatrixMap()
         if (LogicIn *in = dynamic_cast<LogicIn *>(*it))
             p_logicIn[i++] = in;
     }
+    b_logicThresholdsChanged = true;
 }
 
 void ElementSet::doNonLinear(int maxIterations, double maxErrorV, double maxErrorI)
 {
-    QuickVector *p_x_prev = new QuickVector(p_x);
-
     // And now tell the cnodes and cbranches about their new voltages & currents
     updateInfo();
 
-    const NonLinearList::iterator end = m_cnonLinearList.end();
+    const unsigned size = m_cn + m_cb;
+
+    p_dx_prev->fillWithZeros();
+    double lastUpdate = 0.; // the largest element of the last update
+    bool reusedLU = false;  // whether the update was solved with an old decomposition
+    bool forceLU = !b_lastConverged;
+    bool converged = false;
 
     int k = 0;
     do {
         // Tell the nonlinear elements to update its J, A and b from the newly calculated x
-        for (NonLinearList::iterator it = m_cnonLinearList.begin(); it != end; ++it)
-            (*it)->update_dc();
+        updateOpAmpRegions();
+        updateNonLinear();
 
-        *p_x = *p_b; // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+        residual();
 
-        p_A->performLU();
-        p_A->fbSub(p_x);
-        updateInfo();
+        // Reuse the decomposition while it is converging well
+        reusedLU = p_A->isChanged() && b_haveLU && !forceLU && lastUpdate < NEWTON_REUSE_MAX_UPDATE;
+        if (!reusedLU && p_A->isChanged()) {
+            p_A->performLU();
+            m_nonLinearStats.factorizations++;
+        }
+        b_haveLU = true;
+        forceLU = false;
+
+        p_A->fbSub(p_dx);
 
         // Now, check for convergence
-        bool converged = true;
-        for (unsigned i = 0; i < m_cn; ++i) {
-            double diff = std::abs((*p_x_prev)[i] - (*p_x)[i]);
-            if (diff > maxErrorI) {
+        double update = 0.;
+        double turn = 0.; // negative if the update goes back on the last one
+        bool settled = true;
+        converged = true;
+        for (unsigned i = 0; i < size; ++i) {
+            turn += (*p_dx)[i] * (*p_dx_prev)[i];
+            const double dx = std::abs((*p_dx)[i]);
+            const double maxError = (i < m_cn) ? maxErrorV : maxErrorI;
+            if (dx > maxError)
                 converged = false;
-                break;
-            }
+            if (dx > NEWTON_REUSE_SETTLED * maxError)
+                settled = false;
+            update = std::max(update, dx);
         }
-        if (converged) {
-            for (unsigned i = m_cn; i < m_cn + m_cb; ++i) {
-                double diff = std::abs((*p_x_prev)[i] - (*p_x)[i]);
-                if (diff > maxErrorV) {
-                    converged = false;
-                    break;
-                }
+
+        // An iteration that is still not getting anywhere after a while, and
+        // is going back the way it came, is probably jumping back and forth
+        // around the solution
+        double step = 1.;
+        if (!converged && k >= NEWTON_DAMPING_ITERATIONS && turn < 0. && update > NEWTON_REUSE_CONTRACTION * lastUpdate) {
+            step = NEWTON_DAMPING;
+            m_nonLinearStats.dampedSteps++;
+        }
+
+        if (step != 1.)
+            *p_dx *= step;
+        p_x->addScaled(*p_dx, 1.);
+        updateInfo();
+        std::swap(p_dx, p_dx_prev);
+
+        // An old decomposition only converges linearly, so small updates
+        // alone do not mean that the iteration is close to the solution
+        // (unless they are very small); and once it is converging much more
+        // slowly than a new one would, refactorizing saves iterations
+        if (reusedLU && !settled && (k == 0 || update > NEWTON_REUSE_CONTRACTION * lastUpdate))
+            converged = false;
+        if (reusedLU && k > 0 && update > NEWTON_REFRESH_CONTRACTION * lastUpdate)
+            forceLU = true;
+        lastUpdate = update;
+    } while (!converged && ++k < maxIterations);
+
+    const unsigned iterations = std::min(k + 1, maxIterations);
+    m_nonLinearStats.solves++;
+    m_nonLinearStats.iterations += iterations;
+    m_nonLinearStats.mostIterations = std::max(m_nonLinearStats.mostIterations, iterations);
+    if (!converged)
+        m_nonLinearStats.failures++;
+    b_lastConverged = converged;
+}
+
+void ElementSet::updateNonLinear()
+{
+    const unsigned count = m_diodes.size() + m_bjts.size() + m_jfets.size() + m_mosfets.size();
+    const unsigned chunks = count / NONLINEAR_CHUNK_SIZE;
+
+    if (chunks < 2) {
+        evaluateNonLinear(0, count);
+    } else {
+        // Each device only writes to its own state while being evaluated, so
+        // all but the last chunk are given to the thread pool (or evaluated
+        // here if it has no thread free). The devices keep what they worked
+        // out until they are stamped, one at a time, below.
+        QSemaphore done;
+        int started = 0;
+        for (unsigned c = 0; c + 1 < chunks; ++c) {
+            const unsigned begin = c * count / chunks;
+            const unsigned end = (c + 1) * count / chunks;
+            NonLinearJob *job = new NonLinearJob([this, begin, end]() {
+                evaluateNonLinear(begin, end);
+            }, &done);
+            if (QThreadPool::globalInstance()->tryStart(job)) {
+                started++;
+                continue;
             }
+            delete job;
+            evaluateNonLinear(begin, end);
         }
+        evaluateNonLinear((chunks - 1) * count / chunks, count);
+        done.acquire(started);
+    }
 
-        *p_x_prev = *p_x; // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+    for (Diode *diode : m_diodes)
+        diode->stamp_dc();
+    for (BJT *bjt : m_bjts)
+        bjt->stamp_dc();
+    for (JFET *jfet : m_jfets)
+        jfet->stamp_dc();
+    for (MOSFET *mosfet : m_mosfets)
+        mosfet->stamp_dc();
+}
 
-        if (converged)
-            break;
-    } while (++k < maxIterations);
+void ElementSet::evaluateNonLinear(unsigned begin, unsigned end)
+{
+    // Takes the devices in the list that fall in [begin, end), and moves the
+    // range on to the next list
+    auto evaluate = [&begin, &end](const auto &devices) {
+        const unsigned size = devices.size();
+        for (unsigned i = begin; i < std::min(end, size); ++i)
+            devices[i]->evaluate_dc();
+        begin = (begin > size) ? begin - size : 0;
+        end = (end > size) ? end - size : 0;
+    };
+    evaluate(m_diodes);
+    evaluate(m_bjts);
+    evaluate(m_jfets);
+    evaluate(m_mosfets);
+}
 
-    delete p_x_prev;
+bool ElementSet::solveOperatingPoint(int maxIterations, double maxErrorV, double maxErrorI)
+{
+    doNonLinear(maxIterations, maxErrorV, maxErrorI);
+    if (b_lastConverged)
+        return true;
+
+    // A step that does not converge is carried on from anyway, as the next
+    // one may still get there
+    p_x->fillWithZeros();
+    for (double gmin = GMIN_START; gmin >= GMIN_END; gmin /= GMIN_FACTOR) {
+        addGroundConductance(gmin);
+        doNonLinear(maxIterations, maxErrorV, maxErrorI);
+        addGroundConductance(-gmin);
+    }
+
+    doNonLinear(maxIterations, maxErrorV, maxErrorI);
+    return b_lastConverged;
+}
+
+void ElementSet::addGroundConductance(double g)
+{
+    for (unsigned i = 0; i < m_cn; ++i)
+        p_A->add(i, i, g);
+
+    // The old decomposition is too far off to iterate with
+    b_haveLU = false;
+}
+
+void ElementSet::residual()
+{
+    p_A->multiply(p_x, p_dx);
+    p_dx->setDifference(*p_b, *p_dx);
 }
 
 bool ElementSet::doLinear(bool performLU)
@@ -181,12 +398,39 @@ bool ElementSet::doLinear(bool performLU)
     *p_x = *p_b; // <<< why does this code work, when I try it, I always get the default shallow copy.
 
     p_A->fbSub(p_x);
-    updateInfo();
+
+    if (!m_opAmps.empty()) {
+        // The op-amps are piecewise linear, so solve again until none of
+        // them changes region, without the logic seeing the solutions along
+        // the way
+        const bool deferLogicCheck = b_deferLogicCheck;
+        b_deferLogicCheck = true;
+        updateInfo();
+        for (int i = 0; i < OPAMP_REGION_ITERATIONS && updateOpAmpRegions(); ++i) {
+            p_A->performLU();
+            *p_x = *p_b;
+            p_A->fbSub(p_x);
+            updateInfo();
+        }
+        b_deferLogicCheck = deferLogicCheck;
+        if (!b_deferLogicCheck)
+            checkLogic();
+    } else
+        updateInfo();
+
     p_b->setUnchanged();
 
     return true;
 }
 
+bool ElementSet::updateOpAmpRegions()
+{
+    bool changed = false;
+    for (OpAmp *opAmp : m_opAmps)
+        changed |= opAmp->updateRegion();
+    return changed;
+}
+
 void ElementSet::updateInfo()
 {
     for (uint i = 0; i < m_cn; i++) {
@@ -210,9 +454,60 @@ void ElementSet::updateInfo()
         }
     }
 
-    // Tell logic to check themselves
+    if (!b_deferLogicCheck)
+        checkLogic();
+}
+
+void ElementSet::checkLogic()
+{
+    if (b_logicThresholdsChanged)
+        updateLogicThresholds();
+
+    // Only the inputs whose voltage is past the threshold for their state
+    // can change, so those are the only ones told to check themselves
+    const double *const x = p_x ? &(*p_x)[0] : nullptr;
+    const unsigned *const nodes = m_logicNodes.data();
+    const double *const rising = m_logicRising.data();
+    const double *const falling = m_logicFalling.data();
+    char *const high = m_logicHigh.data();
+
     for (uint i = 0; i < m_clogic; ++i) {
-        p_logicIn[i]->check();
+        const double v = (nodes[i] < m_cn) ? x[nodes[i]] : 0.;
+        const bool crossed = high[i] ? (v <= falling[i]) : (v > rising[i]);
+        if (!crossed)
+            continue;
+
+        LogicIn *in = p_logicIn[i];
+        in->check();
+        high[i] = in->isHigh();
+    }
+}
+
+void ElementSet::updateLogicThresholds()
+{
+    b_logicThresholdsChanged = false;
+
+    m_logicNodes.resize(m_clogic);
+    m_logicRising.resize(m_clogic);
+    m_logicFalling.resize(m_clogic);
+    m_logicHigh.resize(m_clogic);
+
+    for (uint i = 0; i < m_clogic; ++i) {
+        LogicIn *in = p_logicIn[i];
+        const CNode *node = in->cnode(0);
+        const LogicConfig config = in->logic();
+
+        m_logicHigh[i] = in->isHigh();
+        if (!node || node->isGround || !in->elementSet()) {
+            // Not checked (as in LogicIn::check), so never crosses
+            m_logicNodes[i] = m_cn;
+            m_logicRising[i] = std::numeric_limits<double>::infinity();
+            m_logicFalling[i] = -std::numeric_limits<double>::infinity();
+        } else {
+            m_logicNodes[i] = node->n();
+            m_logicRising[i] = config.risingTrigger;
+            m_logicFalling[i] = config.fallingTrigger;
+        }
     }
 }
 
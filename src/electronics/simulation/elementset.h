@@ -11,22 +11,49 @@
 #ifndef ELEMENTSET_H
 #define ELEMENTSET_H
 
-//#include <vector>
-
 #include <QList>
 
+#include <vector>
+
+class BJT;
 class CBranch;
 class Circuit;
 class CNode;
+class Diode;
 class Element;
 class ElementSet;
+class JFET;
 class LogicIn;
 class Matrix;
-class NonLinear;
+class MOSFET;
+class OpAmp;
 class QuickVector; // not exactly sure how these types of declarations work.
 
 typedef QList<Element *> ElementList;
-typedef QList<NonLinear *> NonLinearList;
+
+/**
+Counts of what ElementSet::doNonLinear has done, for seeing how hard a circuit
+is to solve.
+*/
+class NonLinearStats
+{
+public:
+    NonLinearStats()
+    {
+        reset();
+    }
+    void reset()
+    {
+        solves = iterations = factorizations = dampedSteps = failures = mostIterations = 0;
+    }
+
+    unsigned long solves;         ///< calls to doNonLinear
+    unsigned long iterations;     ///< Newton iterations, over all the calls
+    unsigned long factorizations; ///< iterations that refactorized the matrix rather than reusing the LU
+    unsigned long dampedSteps;    ///< updates that were only partly applied, as the iteration was not converging
+    unsigned long failures;       ///< calls that stopped at the iteration limit without converging
+    unsigned mostIterations;      ///< the most iterations taken by one call
+};
 
 /**
 Steps in simulation of a set of elements:
@@ -62,6 +89,10 @@ public:
         return m_pCircuit;
     }
     void addElement(Element *e);
+    const ElementList &elements() const
+    {
+        return m_elementList;
+    }
     void setCacheInvalidated();
     /**
      * Returns the matrix in use. This is created once on the creation of the ElementSet
@@ -93,10 +124,98 @@ public:
         return b_containsNonLinear;
     }
     /**
-     * Solves for nonlinear elements, or just does linear if it doesn't contain
-     * any nonlinear.
+     * Solves for nonlinear elements by Newton-Raphson iteration, with the
+     * nonlinear elements relinearizing themselves around the voltages from
+     * the previous iteration.
+     *
+     * Each iteration solves for the update from the residual b - Ax, so the
+     * LU decomposition from an earlier iteration (or call) can be reused
+     * while the iteration is converging quickly; it still converges to the
+     * same solution, only less quickly. The nonlinear elements limit how far
+     * their own voltages move in one iteration; past that, an iteration that
+     * is still jumping back and forth after NEWTON_DAMPING_ITERATIONS only
+     * takes part of each update.
+     *
+     * @param maxErrorV the largest change in a node voltage for the
+     * iteration to have converged
+     * @param maxErrorI the largest change in a branch current for the
+     * iteration to have converged
      */
     void doNonLinear(int maxIterations, double maxErrorV = 1e-9, double maxErrorI = 1e-12);
+    /**
+     * Finds the DC operating point. This is doNonLinear, but when that does
+     * not converge from the current solution, the iteration is started
+     * again from zero with a conductance of GMIN_START from every node to
+     * ground, which makes the circuit close to linear. The conductance is
+     * then taken down by GMIN_FACTOR at a time to GMIN_END, each solve
+     * starting from the one before, and finally taken away (gmin stepping).
+     * @return whether the final iteration converged
+     */
+    bool solveOperatingPoint(int maxIterations, double maxErrorV = 1e-9, double maxErrorI = 1e-12);
+    /**
+     * @return what doNonLinear has done since the statistics were last reset
+     */
+    const NonLinearStats &nonLinearStats() const
+    {
+        return m_nonLinearStats;
+    }
+    void resetNonLinearStats()
+    {
+        m_nonLinearStats.reset();
+    }
+    /**
+     * The LU decomposition is only reused while the largest update in an
+     * iteration is below this (in volts or amps).
+     */
+    static constexpr double NEWTON_REUSE_MAX_UPDATE = 0.1;
+    /**
+     * With a reused LU decomposition, the iteration has only converged once
+     * the update is below the tolerance and at most this fraction of the
+     * update before...
+     */
+    static constexpr double NEWTON_REUSE_CONTRACTION = 0.5;
+    /**
+     * ...or once the update is below this fraction of the tolerance.
+     */
+    static constexpr double NEWTON_REUSE_SETTLED = 0.01;
+    /**
+     * The matrix is refactorized when an update with a reused decomposition
+     * is more than this fraction of the one before.
+     */
+    static constexpr double NEWTON_REFRESH_CONTRACTION = 0.005;
+    /**
+     * After this many iterations, an update that goes back on the one before
+     * without being much smaller is only applied partly...
+     */
+    static const int NEWTON_DAMPING_ITERATIONS = 8;
+    /**
+     * ...by this fraction.
+     */
+    static constexpr double NEWTON_DAMPING = 0.5;
+    /**
+     * The conductance (in siemens) from each node to ground that gmin
+     * stepping starts from...
+     */
+    static constexpr double GMIN_START = 1e-2;
+    /**
+     * ...divides by at each step...
+     */
+    static constexpr double GMIN_FACTOR = 10.;
+    /**
+     * ...and stops at, before it is taken away.
+     */
+    static constexpr double GMIN_END = 1e-12;
+    /**
+     * A linear circuit is solved again at most this many times for its
+     * op-amps moving between their linear and saturated regions.
+     */
+    static const int OPAMP_REGION_ITERATIONS = 16;
+    /**
+     * The nonlinear devices are evaluated in parallel by doNonLinear, in
+     * chunks of at least this many, when there are enough for two chunks.
+     * Fewer devices are quicker to evaluate than to hand to other threads.
+     */
+    static const unsigned NONLINEAR_CHUNK_SIZE = 64;
     /**
      * Solves for linear and logic elements.
      * @returns true if anything changed
@@ -138,27 +257,100 @@ public:
      * Update the nodal voltages and branch currents from the x vector
      */
     void updateInfo();
+    /**
+     * While deferred, updateInfo does not tell the logic inputs to check
+     * themselves, as that may invoke callbacks into components. This is used
+     * when solving in a worker thread; call checkLogic afterwards from the
+     * simulator thread.
+     */
+    void setLogicCheckDeferred(bool deferred)
+    {
+        b_deferLogicCheck = deferred;
+    }
+    /**
+     * Tells the logic inputs whose voltage has crossed one of their
+     * thresholds to check themselves against the new voltages.
+     */
+    void checkLogic();
+    /**
+     * Marks the thresholds that checkLogic compares against as needing to
+     * be gathered from the logic inputs again, as one of them has a new
+     * node, config or state.
+     */
+    void setLogicThresholdsChanged()
+    {
+        b_logicThresholdsChanged = true;
+    }
 
 private:
+    /**
+     * Gathers the nodes, thresholds and states of the logic inputs into the
+     * flat arrays that checkLogic goes through.
+     */
+    void updateLogicThresholds();
+    /**
+     * Puts b - Ax in p_dx.
+     */
+    void residual();
+    /**
+     * Adds the conductance g from each node to ground, for gmin stepping.
+     */
+    void addGroundConductance(double g);
+    /**
+     * Moves the op-amps into the regions that the last solve calls for.
+     * @return whether any op-amp changed region
+     */
+    bool updateOpAmpRegions();
+    /**
+     * Evaluates the nonlinear devices (in parallel, if there are enough of
+     * them) and then stamps them, for an iteration of doNonLinear.
+     */
+    void updateNonLinear();
+    /**
+     * Evaluates the nonlinear devices from begin up to end, counting through
+     * m_diodes, m_bjts, m_jfets and then m_mosfets.
+     */
+    void evaluateNonLinear(unsigned begin, unsigned end);
+
     // calc engine stuff
     Matrix *p_A;
     QuickVector *p_x;
     QuickVector *p_b;
+    QuickVector *p_dx;      ///< the residual, and then the update solved from it
+    QuickVector *p_dx_prev; ///< the update in the last iteration
     // end calc engine stuff.
 
+    NonLinearStats m_nonLinearStats;
+    bool b_haveLU; ///< whether the matrix has been decomposed, so that the LU can be reused
+    bool b_lastConverged;
+
     ElementList m_elementList;
-    NonLinearList m_cnonLinearList;
+    // The nonlinear elements, by type, so that each is updated without going
+    // through the vtable
+    std::vector<Diode *> m_diodes;
+    std::vector<BJT *> m_bjts;
+    std::vector<JFET *> m_jfets;
+    std::vector<MOSFET *> m_mosfets;
+    std::vector<OpAmp *> m_opAmps;
 
     uint m_cb;
     CBranch **m_cbranches; // Pointer to an array of cbranches
+    CBranch *m_cbranchStorage; // The cbranches themselves
 
     uint m_cn;
     CNode **m_cnodes; // Pointer to an array of cnodes
+    CNode *m_cnodeStorage; // The cnodes themselves
     CNode *m_ground;
 
     uint m_clogic;
     LogicIn **p_logicIn;
+    std::vector<unsigned> m_logicNodes; ///< Node of each of p_logicIn (m_cn for ground or no node)
+    std::vector<double> m_logicRising;  ///< Voltage above which each of p_logicIn goes high
+    std::vector<double> m_logicFalling; ///< Voltage at or below which each of p_logicIn goes low
+    std::vector<char> m_logicHigh;      ///< State each of p_logicIn was last seen in
+    bool b_logicThresholdsChanged;
     bool b_containsNonLinear;
+    bool b_deferLogicCheck;
     Circuit *m_pCircuit;
 };
 
@@ -9,45 +9,118 @@
  ***************************************************************************/
 
 #include "elementsignal.h"
+#include "pwlwaveform.h"
+
+#include <QString>
+
 #include <cmath>
 
+/** Number of steps of a cycle in the sine table */
+static const int SINE_TABLE_SIZE = 4096;
+
+/**
+One cycle of a sine, with an extra entry at the end so that interpolating
+from the last step needs no wrapping. With linear interpolation, the error
+is less than 3e-7.
+*/
+class SineTable
+{
+public:
+    SineTable()
+    {
+        for (int i = 0; i <= SINE_TABLE_SIZE; ++i)
+            value[i] = sin(2 * M_PI * i / SINE_TABLE_SIZE);
+    }
+
+    double at(double phase) const
+    {
+        const double pos = phase * SINE_TABLE_SIZE;
+        const int i = int(pos);
+        return value[i] + (value[i + 1] - value[i]) * (pos - i);
+    }
+
+    double value[SINE_TABLE_SIZE + 1];
+};
+
+static const SineTable sineTable;
+
 ElementSignal::ElementSignal()
 {
     m_type = ElementSignal::st_sinusoidal;
+    m_phase = 0.;
     m_time = 0.;
     m_frequency = 0.;
+    m_waveform = nullptr;
 }
 
 ElementSignal::~ElementSignal()
 {
+    delete m_waveform;
+}
+
+ElementSignal::Type ElementSignal::typeFromName(const QString &name)
+{
+    if (name == "square")
+        return ElementSignal::st_square;
+    if (name == "sawtooth")
+        return ElementSignal::st_sawtooth;
+    if (name == "triangle")
+        return ElementSignal::st_triangular;
+    if (name == "waveform")
+        return ElementSignal::st_waveform;
+    return ElementSignal::st_sinusoidal;
 }
 
 void ElementSignal::setStep(Type type, double frequency)
 {
     m_type = type;
     m_frequency = frequency;
-    m_omega = 2 * M_PI * m_frequency;
-    m_time = 1. / (4. * m_frequency);
+    m_phase = 0.25;
+    m_time = 0.;
+}
+
+bool ElementSignal::setWaveform(const QString &fileName)
+{
+    m_type = ElementSignal::st_waveform;
+    m_time = 0.;
+
+    if (!m_waveform)
+        m_waveform = new PwlWaveform;
+    return m_waveform->open(fileName);
 }
 
 double ElementSignal::advance(double delta)
 {
-    m_time += delta;
-    if (m_time >= 1. / m_frequency)
-        m_time -= 1. / m_frequency;
+    if (m_type == ElementSignal::st_waveform) {
+        m_time += delta;
+        return amplitude();
+    }
 
+    m_phase += delta * m_frequency;
+    if (m_phase >= 1.)
+        m_phase -= floor(m_phase);
+
+    return amplitude();
+}
+
+double ElementSignal::amplitude() const
+{
     switch (m_type) {
-    case ElementSignal::st_sawtooth: {
-        double val = (m_time * m_omega / M_PI);
-        return 1 - remainder(val, 2);
-    }
+    case ElementSignal::st_sawtooth:
+        return 1. - 2. * m_phase;
     case ElementSignal::st_square:
-        return ((int(trunc(m_time * m_omega / M_PI)) & 1) == 0) ? 1 : -1;
-    case ElementSignal::st_triangular:
-        // TODO Triangular signal
-        return 0.;
+        return (m_phase < 0.5) ? 1. : -1.;
+    case ElementSignal::st_triangular: {
+        // Distance from the peak at a quarter of the cycle, from -0.5 to 0.5
+        double offset = m_phase - 0.25;
+        if (offset >= 0.5)
+            offset -= 1.;
+        return 1. - 4. * std::abs(offset);
+    }
+    case ElementSignal::st_waveform:
+        return m_waveform ? m_waveform->valueAt(m_time) : 0.;
     case ElementSignal::st_sinusoidal:
     default:
-        return sin(m_time * m_omega);
+        return sineTable.at(m_phase);
     }
 }
@@ -11,28 +11,56 @@
 #ifndef ELEMENTSIGNAL_H
 #define ELEMENTSIGNAL_H
 
+class PwlWaveform;
+class QString;
+
 /**
 @short Provides different signals
 @author David Saxton
+
+The periodic signals are generated from a phase accumulator, which counts
+cycles of the signal from 0 up to 1, rather than from the time; the sine is
+looked up from a table. The st_waveform signal is instead read from a file
+by PwlWaveform, and is given in the units of the element.
 */
 class ElementSignal
 {
 public:
-    enum Type { st_sinusoidal, st_square, st_sawtooth, st_triangular };
+    enum Type { st_sinusoidal, st_square, st_sawtooth, st_triangular, st_waveform };
     ElementSignal();
     ~ElementSignal();
 
+    /**
+     * @return the type with the name used to save it: "sine", "square",
+     * "sawtooth", "triangle" or "waveform"
+     */
+    static Type typeFromName(const QString &name);
+
+    /**
+     * Sets the type of periodic signal, starting at the peak of its cycle.
+     */
     void setStep(Type type, double frequency);
+    /**
+     * Makes the signal the waveform read from the file, starting at its
+     * beginning.
+     * @return false if the file could not be read
+     */
+    bool setWaveform(const QString &fileName);
     /**
      * Advances the timer, returns amplitude (between -1 and 1)
      */
     double advance(double delta);
+    /**
+     * @return the amplitude (between -1 and 1) at the current time
+     */
+    double amplitude() const;
 
 protected:
     Type m_type;
-    double m_time;
+    double m_phase; // Fraction of the cycle of a periodic signal, from 0 to 1
+    double m_time; // Time since the start of a waveform, in seconds
     double m_frequency;
-    double m_omega; // Used for sinusoidal signal
+    PwlWaveform *m_waveform;
 };
 
 #endif
@@ -18,7 +18,7 @@ Inductance::Inductance(double inductance, double delta)
     scaled_inductance = v_eq_old = 0.0;
     m_numCNodes = 2;
     m_numCBranches = 1;
-    setMethod(Inductance::m_euler);
+    setMethod(Inductance::m_gear);
 }
 
 Inductance::~Inductance()
@@ -40,6 +40,19 @@ void Inductance::add_initial_dc()
     // The adding of r_eg and v_eq will be done for us by time_step.
     // So for now, just reset the constants used.
     scaled_inductance = v_eq_old = 0.0;
+    resetIntegration();
+}
+
+void Inductance::removeCompanion()
+{
+    if (!b_status)
+        return;
+
+    stampD(0, 0, scaled_inductance);
+    stampV(0, -v_eq_old);
+
+    scaled_inductance = v_eq_old = 0.;
+    resetIntegration();
 }
 
 void Inductance::updateCurrents()
@@ -56,24 +69,51 @@ void Inductance::time_step()
     if (!b_status)
         return;
 
-    double i = p_cbranch[0]->i;
-    double v_eq_new = 0.0, r_eq_new = 0.0;
+    const double i = p_cbranch[0]->i;
+    acceptStep(i, i * scaled_inductance + v_eq_old);
+    integrate();
+}
+
+void Inductance::retry_step()
+{
+    if (!b_status)
+        return;
+
+    integrate();
+}
 
-    if (m_method == Inductance::m_euler) {
-        r_eq_new = m_inductance / m_delta;
-        v_eq_new = -i * r_eq_new;
-    } else if (m_method == Inductance::m_trap) {
-        // TODO Implement + test trapezoidal method
-        r_eq_new = 2.0 * m_inductance / m_delta;
-    }
+void Inductance::restoreState(QDataStream &stream)
+{
+    Reactive::restoreState(stream);
 
-    if (scaled_inductance != r_eq_new) {
-        A_d(0, 0) -= r_eq_new - scaled_inductance;
-    }
+    // Stamp the step from the restored state in place of the current one
+    if (b_status)
+        integrate();
+}
 
-    if (v_eq_new != v_eq_old) {
-        b_v(0) += v_eq_new - v_eq_old;
-    }
+double Inductance::truncationError() const
+{
+    if (!b_status)
+        return 0.;
+
+    const double i = p_cbranch[0]->i;
+    return estimateError(i, i * scaled_inductance + v_eq_old, m_inductance, 1e-9);
+}
+
+void Inductance::integrate()
+{
+    if (m_method == Inductance::m_trap)
+        prepareStep(integration_trap, m_inductance);
+    else if (m_method == Inductance::m_gear)
+        prepareStep(integration_gear, m_inductance);
+    else
+        prepareStep(integration_euler, m_inductance);
+
+    const double r_eq_new = m_weight;
+    const double v_eq_new = m_offset;
+
+    stampD(0, 0, scaled_inductance - r_eq_new);
+    stampV(0, v_eq_new - v_eq_old);
 
     scaled_inductance = r_eq_new;
     v_eq_old = v_eq_new;
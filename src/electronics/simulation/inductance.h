@@ -17,13 +17,14 @@
 
 @author David Saxton
 */
-class Inductance : public Reactive
+class Inductance final : public Reactive
 {
 public:
     enum Method {
         m_none,  // None
         m_euler, // Backward Euler
-        m_trap   // Trapezoidal (currently unimplemented)
+        m_trap,  // Trapezoidal
+        m_gear   // Second order Gear (BDF2)
     };
     Inductance(double capacitance, double delta);
     ~Inductance() override;
@@ -39,12 +40,37 @@ public:
      */
     void setMethod(Method m);
     void time_step() override;
+    void retry_step() override;
+    double truncationError() const override;
+    void restoreState(QDataStream &stream) override;
     void add_initial_dc() override;
+    /**
+     * Takes the companion model out of the matrix, leaving the inductor as
+     * a short circuit (as at DC), and starts the integration afresh from the
+     * next time_step.
+     */
+    void removeCompanion();
     void setInductance(double i);
+    double inductance() const
+    {
+        return m_inductance;
+    }
+    /**
+     * @return the resistance of the companion model last stamped for the
+     * integration, which AcAnalysis takes back out of the matrix.
+     */
+    double stampedResistance() const
+    {
+        return scaled_inductance;
+    }
 
 protected:
     void updateCurrents() override;
     bool updateStatus() override;
+    /**
+     * Stamps the integration over the next m_delta.
+     */
+    void integrate();
 
 private:
     double m_inductance; // Inductance
@@ -116,18 +116,23 @@ void JFET::updateCurrents()
 
 void JFET::update_dc()
 {
-    if (!b_status)
-        return;
+    evaluate_dc();
+    stamp_dc();
+}
 
-    calc_eq();
+void JFET::evaluate_dc()
+{
+    if (b_status)
+        calc_eq();
+}
 
-    JFETState diff = m_ns - m_os;
-    for (unsigned i = 0; i < 3; ++i) {
-        for (unsigned j = 0; j < 3; ++j)
-            A_g(i, j) += diff.A[i][j];
+void JFET::stamp_dc()
+{
+    if (!b_status)
+        return;
 
-        b_i(i) += diff.I[i];
-    }
+    const JFETState diff = m_ns - m_os;
+    m_stamp.stamp(p_eSet, p_cnode, diff.A, diff.I);
 
     m_os = m_ns;
 }
@@ -182,17 +187,19 @@ void JFET::calcIg(double V_GS, double V_GD, double V_DS, double *I_GS, double *I
     double beta = m_jfetSettings.beta;
     double I_S = m_jfetSettings.I_S;
     double N = m_jfetSettings.N;
-    double N_R = m_jfetSettings.N_R;
 
-    // GS diode
+    // GS diode (the recombination current, with emission coefficient N_R,
+    // has no saturation current in this model and so is left out)
     double g_tiny = (V_GS < (-10 * V_T * N)) ? I_S : 0;
-    *g_GS = diodeConductance(V_GS, I_S, N) + diodeConductance(V_GS, 0, N_R) + g_tiny;
-    *I_GS = diodeCurrent(V_GS, I_S, N) + diodeCurrent(V_GS, 0, N_R) + g_tiny * V_GS;
+    diodeCurrentConductance(V_GS, I_S, N, I_GS, g_GS);
+    *g_GS += g_tiny;
+    *I_GS += g_tiny * V_GS;
 
     // GD diode
     g_tiny = (V_GD < (-10 * V_T * N)) ? I_S : 0;
-    *g_GD = diodeConductance(V_GD, I_S, N) + diodeConductance(V_GD, 0, N_R) + g_tiny;
-    *I_GD = diodeCurrent(V_GD, I_S, N) + diodeCurrent(V_GD, 0, N_R) + (g_tiny * V_GD);
+    diodeCurrentConductance(V_GD, I_S, N, I_GD, g_GD);
+    *g_GD += g_tiny;
+    *I_GD += g_tiny * V_GD;
 
     double V_GST = V_GS - V_Th;
     double V_GDT = V_GD - V_Th;
@@ -12,6 +12,7 @@
 #define JFET_H
 
 #include "nonlinear.h"
+#include "stampkernel.h"
 
 class JFETState
 {
@@ -40,7 +41,7 @@ public:
 /**
 @author David Saxton
  */
-class JFET : public NonLinear
+class JFET final : public NonLinear
 {
 public:
     enum JFET_type { nJFET, pJFET };
@@ -53,6 +54,8 @@ public:
         return Element_JFET;
     }
     void update_dc() override;
+    void evaluate_dc() override;
+    void stamp_dc() override;
     void add_initial_dc() override;
     JFETSettings settings() const
     {
@@ -80,6 +83,7 @@ protected:
     double V_GS_prev, V_GD_prev;
     double V_lim;
     JFETSettings m_jfetSettings;
+    StampKernel<3> m_stamp;
 
     static const uint PinD, PinG, PinS;
 };
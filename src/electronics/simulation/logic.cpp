@@ -12,6 +12,9 @@
 #include "circuit.h"
 #include "elementset.h"
 #include "simulator.h"
+
+#include <QDataStream>
+
 #include <vector>
 
 #include <ktlconfig.h>
@@ -38,7 +41,8 @@ LogicIn::LogicIn(LogicConfig config)
     m_pCallback2Obj = nullptr;
     m_numCNodes = 1;
     m_bLastState = false;
-    m_pNextLogic = nullptr;
+    m_pChainDriver = nullptr;
+    m_chainIndex = 0;
     setLogic(getConfig());
 }
 
@@ -67,6 +71,18 @@ void LogicIn::setCallback2(Callback2Ptr fun, Callback2Obj obj)
 //     }
     m_pCallback2Func = fun;
     m_pCallback2Obj = obj;
+
+    if (m_pChainDriver) {
+        LogicOut::FanOut &fanOut = m_pChainDriver->m_fanOut[m_chainIndex];
+        fanOut.func = fun;
+        fanOut.obj = obj;
+    }
+}
+
+void LogicIn::removeFromLogicChain()
+{
+    if (m_pChainDriver)
+        m_pChainDriver->removeFanOut(this);
 }
 
 void LogicIn::check()
@@ -98,13 +114,15 @@ void LogicIn::check()
 void LogicIn::setLogic(LogicConfig config)
 {
     m_config = config;
+    if (p_eSet)
+        p_eSet->setLogicThresholdsChanged();
     check();
 }
 
 void LogicIn::setElementSet(ElementSet *c)
 {
     if (c)
-        m_pNextLogic = nullptr;
+        removeFromLogicChain();
     else
         m_cnodeI[0] = 0.;
 
@@ -132,6 +150,8 @@ LogicConfig LogicIn::getConfig()
 // END class LogicIn
 
 // BEGIN class LogicOut
+bool LogicOut::m_bIdealLogic = false;
+
 LogicOut::LogicOut(LogicConfig config, bool _high)
     : LogicIn(config)
 {
@@ -139,7 +159,10 @@ LogicOut::LogicOut(LogicConfig config, bool _high)
     m_bOutputHighConductanceConst = false;
     m_bOutputLowConductanceConst = false;
     m_bOutputHighVoltageConst = false;
-    m_pNextChanged[0] = m_pNextChanged[1] = nullptr;
+    m_pNextChanged = nullptr;
+    m_propagationDelay = 1;
+    m_bScheduledState = false;
+    m_bPassedOnState = false;
     m_pSimulator = nullptr;
     m_bUseLogicChain = false;
     b_state = false;
@@ -187,7 +210,11 @@ void LogicOut::setElementSet(ElementSet *c)
 
     if (c) {
         m_bUseLogicChain = false;
-        m_pNextChanged[0] = m_pNextChanged[1] = nullptr;
+        clearFanOut();
+        if (!m_bCanAddChanged) {
+            m_pSimulator->removeChangedLogic(this);
+            m_bCanAddChanged = true;
+        }
     }
 
     // NOTE Make sure that the next two lines are the same as those in setHigh and setLogic
@@ -197,6 +224,50 @@ void LogicOut::setElementSet(ElementSet *c)
     LogicIn::setElementSet(c);
 }
 
+void LogicOut::setFanOut(const LogicInList &logicIns)
+{
+    clearFanOut();
+
+    m_fanOut.reserve(logicIns.size());
+    for (LogicIn *logicIn : logicIns) {
+        logicIn->removeFromLogicChain();
+        logicIn->m_pChainDriver = this;
+        logicIn->m_chainIndex = m_fanOut.size();
+        m_fanOut.push_back({logicIn, logicIn->callback2Function(), logicIn->callback2Object()});
+    }
+
+    setChainState(b_state);
+}
+
+void LogicOut::removeFanOut(LogicIn *logicIn)
+{
+    if (logicIn->m_pChainDriver != this)
+        return;
+
+    m_fanOut.erase(m_fanOut.begin() + logicIn->m_chainIndex);
+    for (unsigned i = logicIn->m_chainIndex; i < m_fanOut.size(); ++i)
+        m_fanOut[i].logicIn->m_chainIndex = i;
+
+    logicIn->m_pChainDriver = nullptr;
+    logicIn->m_chainIndex = 0;
+}
+
+void LogicOut::clearFanOut()
+{
+    for (const FanOut &fanOut : m_fanOut) {
+        fanOut.logicIn->m_pChainDriver = nullptr;
+        fanOut.logicIn->m_chainIndex = 0;
+    }
+    m_fanOut.clear();
+}
+
+void LogicOut::setChainState(bool state)
+{
+    setLastState(state);
+    for (const FanOut &fanOut : m_fanOut)
+        fanOut.logicIn->setLastState(state);
+}
+
 void LogicOut::setOutputHighConductance(double g)
 {
     m_bOutputHighConductanceConst = true;
@@ -227,6 +298,8 @@ void LogicOut::setOutputHighVoltage(double v)
 void LogicOut::setLogic(LogicConfig config)
 {
     m_config = config;
+    if (p_eSet)
+        p_eSet->setLogicThresholdsChanged();
 
     if (!m_bOutputHighConductanceConst)
         m_gHigh = 1.0 / config.highImpedance;
@@ -270,8 +343,10 @@ void LogicOut::add_initial_dc()
     if (!b_status)
         return;
 
-    A_g(0, 0) += m_g_out - m_old_g_out;
-    b_i(0) += m_g_out * m_v_out - m_old_g_out * m_old_v_out;
+    // Toggling the output only changes its conductance to ground, which is
+    // kept as an update to the decomposition of the matrix
+    stampConductanceRankOne(0, m_g_out - m_old_g_out);
+    stampI(0, m_g_out * m_v_out - m_old_g_out * m_old_v_out);
 }
 
 void LogicOut::updateCurrents()
@@ -286,16 +361,67 @@ void LogicOut::updateCurrents()
     m_cnodeI[0] = (m_v_out - p_cnode[0]->v) * m_g_out;
 }
 
-void LogicOut::setHigh(bool high)
+void LogicOut::setPropagationDelay(unsigned delay)
 {
-    if (high == b_state)
-        return;
+    m_propagationDelay = std::min<unsigned>(delay, LOGIC_WHEEL_SIZE - 1);
+}
+
+void LogicOut::setIdealLogic(bool ideal)
+{
+    m_bIdealLogic = ideal;
+}
+
+bool LogicOut::takeScheduledState()
+{
+    if (m_bScheduledState != b_state) {
+        b_state = m_bScheduledState;
+        setChainState(b_state);
+    }
+
+    if (b_state == m_bPassedOnState)
+        return false;
+
+    m_bPassedOnState = b_state;
+    return true;
+}
 
+void LogicOut::saveState(QDataStream &stream) const
+{
+    // This is b_state unless a delayed change is on its way
+    stream << m_bScheduledState;
+}
+
+void LogicOut::restoreState(QDataStream &stream)
+{
+    bool high;
+    stream >> high;
+    setHigh(high);
+}
+
+void LogicOut::setHigh(bool high)
+{
     if (m_bUseLogicChain) {
-        b_state = high;
+        const unsigned delay = propagationDelay();
+        if (delay > 0) {
+            // The LogicIns keep the old state until the change is due
+            if (high == m_bScheduledState)
+                return;
+
+            m_bScheduledState = high;
+            if (m_bCanAddChanged) {
+                m_pSimulator->addChangedLogic(this, delay);
+                m_bCanAddChanged = false;
+            }
+            return;
+        }
+
+        // (a delayed change may still be on its way, from before ideal logic
+        // was turned on)
+        if (high == b_state && high == m_bScheduledState)
+            return;
 
-        for (LogicIn *logic = this; logic; logic = logic->nextLogic())
-            logic->setLastState(high);
+        b_state = m_bScheduledState = high;
+        setChainState(high);
 
         if (m_bCanAddChanged) {
             m_pSimulator->addChangedLogic(this);
@@ -305,6 +431,9 @@ void LogicOut::setHigh(bool high)
         return;
     }
 
+    if (high == b_state)
+        return;
+
     m_old_g_out = m_g_out;
     m_old_v_out = m_v_out;
 
@@ -317,7 +446,7 @@ void LogicOut::setHigh(bool high)
     m_old_g_out = 0.;
     m_old_v_out = 0.;
 
-    b_state = high;
+    b_state = m_bScheduledState = high;
 
     if (p_eSet && p_eSet->circuit()->canAddChanged()) {
         m_pSimulator->addChangedCircuit(p_eSet->circuit());
@@ -16,12 +16,18 @@
 #include <QList>
 #include <QPointer>
 
+#include <vector>
+
 class Component;
 class Pin;
 class Simulator;
 
 typedef QList<QPointer<Pin>> PinList;
 
+class LogicIn;
+class LogicOut;
+typedef QList<LogicIn *> LogicInList;
+
 class LogicConfig
 {
 public:
@@ -70,6 +76,10 @@ public:
      * Set logic values from the LogicConfig.
      */
     virtual void setLogic(LogicConfig config);
+    LogicConfig logic() const
+    {
+        return m_config;
+    }
     /**
      * Check if the input state has changed, to see if we need to callback.
      */
@@ -90,6 +100,14 @@ public:
 //     void setCallback(CallbackClass *object, CallbackPtr func);
 
     void setCallback2(Callback2Ptr fun, Callback2Obj obj);
+    Callback2Ptr callback2Function() const
+    {
+        return m_pCallback2Func;
+    }
+    Callback2Obj callback2Object() const
+    {
+        return m_pCallback2Obj;
+    }
 
     /**
      * Reads the LogicConfig values in from KTLConfig, and returns them in a
@@ -102,21 +120,21 @@ public:
     void setLastState(bool state)
     {
         m_bLastState = state;
+        if (p_eSet)
+            p_eSet->setLogicThresholdsChanged();
     }
     /**
-     * Returns a pointer to the next LogicIn in the chain.
+     * @return the LogicOut at the start of the logic chain that this belongs
+     * to, or null if it is not in one.
      */
-    LogicIn *nextLogic() const
+    LogicOut *logicChainDriver() const
     {
-        return m_pNextLogic;
+        return m_pChainDriver;
     }
     /**
-     * Sets the next LogicIn in the chain.
+     * Takes this out of the logic chain it belongs to, if any.
      */
-    void setNextLogic(LogicIn *next)
-    {
-        m_pNextLogic = next;
-    }
+    void removeFromLogicChain();
     /**
      * Calls the callback function, if there is one.
      */
@@ -141,8 +159,11 @@ protected:
     Callback2Obj m_pCallback2Obj;
 
     bool m_bLastState;
-    LogicIn *m_pNextLogic;
+    LogicOut *m_pChainDriver; ///< the start of the logic chain this is in
+    unsigned m_chainIndex;    ///< where this is in the fan-out of m_pChainDriver
     LogicConfig m_config;
+
+    friend class LogicOut;
 };
 
 /**
@@ -187,9 +208,55 @@ public:
         return m_vHigh;
     }
     /**
-     * Sets the pin to be high/low
+     * Returns the conductance of the output when high and when low.
+     */
+    double outputHighConductance() const
+    {
+        return m_gHigh;
+    }
+    double outputLowConductance() const
+    {
+        return m_gLow;
+    }
+    /**
+     * Sets the pin to be high/low. In a logic chain, the change reaches the
+     * LogicIns after the propagation delay.
      */
     void setHigh(bool high);
+    /**
+     * Saves the state being output, or the state it is changing to if the
+     * change is still waiting for the propagation delay. Restoring it sets
+     * the output with setHigh.
+     */
+    void saveState(QDataStream &stream) const override;
+    void restoreState(QDataStream &stream) override;
+    /**
+     * Sets how many logic updates (1/LOGIC_UPDATE_RATE seconds) changes to
+     * the output take to reach the LogicIns of its logic chain. The default
+     * of one update is how logic has always been simulated; with no delay,
+     * changes are passed on in the same logic update, so that a path of
+     * gates settles at once. Only applies to LogicOuts at the start of a
+     * logic chain.
+     */
+    void setPropagationDelay(unsigned delay);
+    /**
+     * @return the propagation delay in use, which is none with ideal logic.
+     */
+    unsigned propagationDelay() const
+    {
+        return m_bIdealLogic ? 0 : m_propagationDelay;
+    }
+    /**
+     * Sets whether all LogicOuts pass on their changes in the same logic
+     * update, whatever their propagation delay, so that any path of gates
+     * settles at once (see the IdealLogic setting). Loops of gates then go
+     * round LOGIC_MAX_DELTAS times in each logic update.
+     */
+    static void setIdealLogic(bool ideal);
+    static bool idealLogic()
+    {
+        return m_bIdealLogic;
+    }
     /**
      * @returns the state that this is outputting (regardless of voltage level on logic)
      */
@@ -197,20 +264,59 @@ public:
     {
         return b_state;
     }
+    /**
+     * @return the voltage and conductance that the output is stamped with
+     * at the moment (i.e. a voltage source of outputVoltage() behind a
+     * conductance of outputConductance())
+     */
+    double outputVoltage() const
+    {
+        return m_v_out;
+    }
+    double outputConductance() const
+    {
+        return m_g_out;
+    }
     /**
      * Set whether or not this LogicOut is the head of a LogicChain (controls
      * itself and a bunch of LogicIns).
      */
     void setUseLogicChain(bool use);
     /**
-     * When a LogicOut configured as the start of a LogicChain changes start, it
-     * appends a pointer to itself to the list of change LogicOut, starting from
-     * the Simulator. This functions enables appending the next changed LogicOut
-     * to this one.
+     * Sets the LogicIns that this passes its state on to, as the start of a
+     * logic chain, taking them out of any other chain. They (and this) take
+     * on the state being output straight away.
+     */
+    void setFanOut(const LogicInList &logicIns);
+    /**
+     * Takes logicIn out of the fan-out.
+     */
+    void removeFanOut(LogicIn *logicIn);
+    /**
+     * Takes all the LogicIns out of the fan-out.
+     */
+    void clearFanOut();
+    /**
+     * Calls the callbacks of this and of the fan-out, as the start of a logic
+     * chain whose state has changed.
+     */
+    void callChainCallbacks()
+    {
+        callCallback();
+        for (const FanOut &fanOut : m_fanOut) {
+            if (fanOut.func)
+                fanOut.func(fanOut.obj, b_state);
+        }
+    }
+    /**
+     * When a LogicOut configured as the start of a LogicChain changes state, it
+     * appends a pointer to itself to the list of changed LogicOuts due in the
+     * same logic update, kept by the Simulator. This functions enables
+     * appending the next changed LogicOut to this one.
      */
-    void setNextChanged(LogicOut *logicOut, unsigned char chain)
+    void setNextChanged(LogicOut *logicOut)
     {
-        m_pNextChanged[chain] = logicOut;
+        m_pNextChanged = logicOut;
     }
     /**
      * To avoid a pointer to this LogicOut being added twice in one
@@ -222,23 +328,59 @@ public:
     {
         m_bCanAddChanged = canAdd;
     }
+    bool canAddChanged() const
+    {
+        return m_bCanAddChanged;
+    }
     /**
      * Returns the next LogicOut that has changed, when configured as the start
      * of a LogicChain.
      * @see setNextChanged
      */
-    LogicOut *nextChanged(unsigned char chain) const
+    LogicOut *nextChanged() const
+    {
+        return m_pNextChanged;
+    }
+    /**
+     * Called by the Simulator when the change is due: takes on the state
+     * the output was set to (if it was delayed).
+     * @return false if the state is the one last passed on to the logic
+     * chain, i.e. the output changed back again in the meantime.
+     */
+    bool takeScheduledState();
+    /**
+     * Makes the next change that is due pass on the state, even if it is the
+     * one passed on last (e.g. as the logic chain is new).
+     */
+    void resetPassedOnState()
     {
-        return m_pNextChanged[chain];
+        m_bPassedOnState = !b_state;
     }
     PinList pinList;
     PinList::iterator pinListBegin;
     PinList::iterator pinListEnd;
 
 protected:
+    /**
+     * A LogicIn in the fan-out, with its callback copied alongside, so that
+     * a change is passed on by going through one array rather than through
+     * each of the LogicIns.
+     */
+    class FanOut
+    {
+    public:
+        LogicIn *logicIn;
+        Callback2Ptr func;
+        Callback2Obj obj;
+    };
+
     void configChanged();
     void updateCurrents() override;
     void add_initial_dc() override;
+    /**
+     * Sets the last state of this and of the fan-out.
+     */
+    void setChainState(bool state);
 
     // Pre-initalized levels from config
     double m_gHigh;
@@ -256,9 +398,16 @@ protected:
     double m_old_v_out;
     bool b_state;
     bool m_bCanAddChanged;
-    LogicOut *m_pNextChanged[2];
+    LogicOut *m_pNextChanged;
+    unsigned m_propagationDelay;
+    static bool m_bIdealLogic;
+    bool m_bScheduledState; ///< the state to take on, once a delayed change is due (else b_state)
+    bool m_bPassedOnState;  ///< the state last passed on to the logic chain
     Simulator *m_pSimulator;
     bool m_bUseLogicChain;
+    std::vector<FanOut> m_fanOut;
+
+    friend class LogicIn;
 };
 
 #endif
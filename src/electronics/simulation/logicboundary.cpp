@@ -0,0 +1,54 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "logicboundary.h"
+#include "pin.h"
+
+LogicBoundary::LogicBoundary(Pin *pin, const LogicInList &logicIns)
+    : m_pin(pin)
+    , m_logicIns(logicIns)
+{
+    Q_ASSERT(!logicIns.isEmpty());
+
+    // The LogicIns keep their state, so that their components do not see a
+    // change when they go behind the boundary
+    const LogicConfig config = logicIns.first()->logic();
+    const bool isHigh = logicIns.first()->isHigh();
+
+    m_sense = new LogicIn(config);
+    m_sense->setLogic(config);
+    m_sense->setLastState(isHigh);
+    m_sense->setCallback2(senseChanged, this);
+
+    m_driver = new LogicOut(config, isHigh);
+}
+
+LogicBoundary::~LogicBoundary()
+{
+    // The sense is normally out of its element set by now, as the circuit
+    // goes first
+    if (m_sense->elementSet())
+        m_sense->componentDeleted();
+    else
+        delete m_sense;
+
+    delete m_driver;
+}
+
+void LogicBoundary::initCNodes()
+{
+    if (m_pin)
+        m_sense->setCNodes(m_pin->eqId());
+}
+
+void LogicBoundary::senseChanged(Callback2Obj obj, bool isHigh)
+{
+    static_cast<LogicBoundary *>(obj)->m_driver->setHigh(isHigh);
+}
@@ -0,0 +1,68 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef LOGICBOUNDARY_H
+#define LOGICBOUNDARY_H
+
+#include "logic.h"
+
+/**
+Stands between a node of an analog circuit and the LogicIns on it (which have
+infinite impedance, so take no part in the solution). Instead of the circuit
+checking each of the LogicIns, it checks one sensing LogicIn with the same
+thresholds, and the changes of that are passed on by a LogicOut at the head of
+a logic chain holding the LogicIns. The gates behind them then see the node as
+a logic net driven from outside, and can be compiled into a LogicNetlist.
+
+The sensing LogicIn is added to the circuit in place of the LogicIns, and is
+given the node of the pin once the pins have been numbered (see initCNodes).
+The circuit has to be deleted before the boundary.
+*/
+class LogicBoundary
+{
+public:
+    LogicBoundary(Pin *pin, const LogicInList &logicIns);
+    ~LogicBoundary();
+
+    /**
+     * @return the LogicIn that is checked by the circuit
+     */
+    LogicIn *sense() const
+    {
+        return m_sense;
+    }
+    /**
+     * @return the LogicOut that passes the changes of sense() on, which heads
+     * the logic chain of the LogicIns
+     */
+    LogicOut *driver() const
+    {
+        return m_driver;
+    }
+    const LogicInList &logicIns() const
+    {
+        return m_logicIns;
+    }
+    /**
+     * Gives the sensing LogicIn the node of the pin. This has to be called
+     * once the circuit has been initialized.
+     */
+    void initCNodes();
+
+protected:
+    static void senseChanged(Callback2Obj obj, bool isHigh);
+
+    QPointer<Pin> m_pin;
+    LogicInList m_logicIns;
+    LogicIn *m_sense;
+    LogicOut *m_driver;
+};
+
+#endif
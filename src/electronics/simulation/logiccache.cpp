@@ -0,0 +1,224 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "logiccache.h"
+
+#include <math/qvector.h>
+
+const unsigned LogicCache::MAX_BYTES;
+const unsigned LogicCache::NONE;
+
+LogicCache::LogicCache()
+    : m_keyWords(0)
+    , m_solutionSize(0)
+    , m_capacity(0)
+    , m_count(0)
+    , m_keyHash(0)
+    , m_head(NONE)
+    , m_tail(NONE)
+    , m_tableMask(0)
+{
+}
+
+void LogicCache::reset(unsigned keyBits, unsigned solutionSize)
+{
+    m_keyWords = (keyBits + 63) / 64;
+    m_solutionSize = solutionSize;
+
+    m_key.assign(m_keyWords, 0);
+
+    // Free everything, as the slots no longer fit
+    trim();
+
+    if (solutionSize == 0) {
+        m_capacity = 0;
+        return;
+    }
+
+    // Solution, key and hash, the LRU links, and (at most) two table entries
+    const unsigned slotBytes = solutionSize * sizeof(double) + (m_keyWords + 1) * sizeof(quint64) + 4 * sizeof(unsigned);
+    m_capacity = std::max(1u, MAX_BYTES / slotBytes);
+
+    // There can't be more solutions than there are output states
+    if (keyBits < 32)
+        m_capacity = std::min(m_capacity, 1u << keyBits);
+}
+
+void LogicCache::clear()
+{
+    m_count = 0;
+    m_head = m_tail = NONE;
+    std::fill(m_table.begin(), m_table.end(), NONE);
+}
+
+void LogicCache::trim()
+{
+    std::vector<quint64>().swap(m_keys);
+    std::vector<double>().swap(m_solutions);
+    std::vector<quint64>().swap(m_hashes);
+    std::vector<unsigned>().swap(m_prev);
+    std::vector<unsigned>().swap(m_next);
+    std::vector<unsigned>().swap(m_table);
+    m_tableMask = 0;
+    m_count = 0;
+    m_head = m_tail = NONE;
+}
+
+qint64 LogicCache::memoryUsage() const
+{
+    return m_keys.capacity() * sizeof(quint64) + m_solutions.capacity() * sizeof(double) + m_hashes.capacity() * sizeof(quint64) + (m_prev.capacity() + m_next.capacity() + m_table.capacity()) * sizeof(unsigned);
+}
+
+quint64 LogicCache::hashKey() const
+{
+    // FNV-1a over the words, with a final mix as the low bits of the
+    // trailing word are usually all that differ
+    quint64 hash = 14695981039346656037ull;
+    for (unsigned i = 0; i < m_keyWords; ++i) {
+        hash ^= m_key[i];
+        hash *= 1099511628211ull;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+bool LogicCache::keyEquals(unsigned slot) const
+{
+    const quint64 *key = m_keys.data() + slot * m_keyWords;
+    for (unsigned i = 0; i < m_keyWords; ++i) {
+        if (key[i] != m_key[i])
+            return false;
+    }
+    return true;
+}
+
+const double *LogicCache::find()
+{
+    m_keyHash = hashKey();
+
+    if (m_table.empty())
+        return nullptr;
+
+    for (unsigned position = unsigned(m_keyHash) & m_tableMask;; position = (position + 1) & m_tableMask) {
+        const unsigned slot = m_table[position];
+        if (slot == NONE)
+            return nullptr;
+
+        if (m_hashes[slot] == m_keyHash && keyEquals(slot)) {
+            if (slot != m_head) {
+                unlink(slot);
+                linkFront(slot);
+            }
+            return &m_solutions[slot * m_solutionSize];
+        }
+    }
+}
+
+void LogicCache::insert(const QuickVector *x)
+{
+    if (m_capacity == 0)
+        return;
+
+    unsigned slot;
+    if (m_count < m_capacity) {
+        // Use a new slot, growing the storage for it
+        slot = m_count++;
+        m_keys.resize(m_count * m_keyWords);
+        m_solutions.resize(m_count * m_solutionSize);
+        m_hashes.resize(m_count);
+        m_prev.resize(m_count);
+        m_next.resize(m_count);
+
+        if (2 * m_count > m_table.size())
+            rehash(std::max<unsigned>(16, 2 * m_table.size()));
+    } else {
+        // Reuse the least recently used slot
+        slot = m_tail;
+        unlink(slot);
+
+        unsigned position = unsigned(m_hashes[slot]) & m_tableMask;
+        while (m_table[position] != slot)
+            position = (position + 1) & m_tableMask;
+        removeFromTable(position);
+    }
+
+    std::copy(m_key.begin(), m_key.end(), m_keys.begin() + slot * m_keyWords);
+    double *solution = &m_solutions[slot * m_solutionSize];
+    for (unsigned i = 0; i < m_solutionSize; ++i)
+        solution[i] = (*x)[i];
+    m_hashes[slot] = m_keyHash;
+    linkFront(slot);
+
+    unsigned position = unsigned(m_keyHash) & m_tableMask;
+    while (m_table[position] != NONE)
+        position = (position + 1) & m_tableMask;
+    m_table[position] = slot;
+}
+
+void LogicCache::rehash(unsigned tableSize)
+{
+    m_table.assign(tableSize, NONE);
+    m_tableMask = tableSize - 1;
+
+    for (unsigned slot = m_head; slot != NONE; slot = m_next[slot]) {
+        unsigned position = unsigned(m_hashes[slot]) & m_tableMask;
+        while (m_table[position] != NONE)
+            position = (position + 1) & m_tableMask;
+        m_table[position] = slot;
+    }
+}
+
+void LogicCache::removeFromTable(unsigned position)
+{
+    unsigned hole = position;
+    m_table[hole] = NONE;
+
+    for (unsigned next = (hole + 1) & m_tableMask; m_table[next] != NONE; next = (next + 1) & m_tableMask) {
+        const unsigned home = unsigned(m_hashes[m_table[next]]) & m_tableMask;
+
+        // Leave the entry if its home lies cyclically in (hole, next]
+        const bool reachable = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (reachable)
+            continue;
+
+        m_table[hole] = m_table[next];
+        m_table[next] = NONE;
+        hole = next;
+    }
+}
+
+void LogicCache::unlink(unsigned slot)
+{
+    const unsigned prev = m_prev[slot];
+    const unsigned next = m_next[slot];
+
+    if (prev != NONE)
+        m_next[prev] = next;
+    else
+        m_head = next;
+
+    if (next != NONE)
+        m_prev[next] = prev;
+    else
+        m_tail = prev;
+}
+
+void LogicCache::linkFront(unsigned slot)
+{
+    m_prev[slot] = NONE;
+    m_next[slot] = m_head;
+    if (m_head != NONE)
+        m_prev[m_head] = slot;
+    m_head = slot;
+    if (m_tail == NONE)
+        m_tail = slot;
+}
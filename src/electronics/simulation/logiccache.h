@@ -0,0 +1,138 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef LOGICCACHE_H
+#define LOGICCACHE_H
+
+#include <QtGlobal>
+
+#include <algorithm>
+#include <vector>
+
+class QuickVector;
+
+/**
+Solutions of a Circuit, keyed on the states of its LogicOuts. Used by Circuit
+for circuits whose solution only depends on which outputs are high.
+
+Usage:
+(1) Call reset with the number of LogicOuts and the size of the solution.
+(2) For each solve, call clearKey and setKeyBit for every LogicOut that is
+    high, then find. If that returns nothing, solve and call insert.
+
+The key is a bitmask hashed into an open addressing table, and solutions are
+stored in flat arrays that are allocated as the cache fills up and reused
+afterwards. The cache holds at most MAX_BYTES of solutions and keys; once
+full, the least recently used solution is replaced.
+
+@short Bounded cache of logic-dependent circuit solutions
+*/
+class LogicCache
+{
+public:
+    LogicCache();
+
+    /**
+     * Empties the cache, and sets it up for the given key and solution sizes.
+     * Sizes of zero free all memory.
+     */
+    void reset(unsigned keyBits, unsigned solutionSize);
+    /**
+     * Removes all the solutions, keeping the memory for reuse.
+     */
+    void clear();
+    /**
+     * Removes all the solutions, and frees their memory.
+     */
+    void trim();
+    /**
+     * @return the bytes allocated for the solutions and keys
+     */
+    qint64 memoryUsage() const;
+
+    void clearKey()
+    {
+        std::fill(m_key.begin(), m_key.end(), 0);
+    }
+    void setKeyBit(unsigned bit)
+    {
+        m_key[bit >> 6] |= quint64(1) << (bit & 63);
+    }
+    /**
+     * @return the cached solution for the current key, or nullptr if there
+     * is none. A solution found becomes the most recently used one.
+     */
+    const double *find();
+    /**
+     * Caches the solution for the current key, which must not be in the
+     * cache already.
+     */
+    void insert(const QuickVector *x);
+
+    /**
+     * @return the number of solutions in the cache
+     */
+    unsigned count() const
+    {
+        return m_count;
+    }
+    /**
+     * @return the maximum number of solutions for the current sizes
+     */
+    unsigned capacity() const
+    {
+        return m_capacity;
+    }
+
+    /**
+     * Upper limit on the memory used for keys and solutions.
+     */
+    static const unsigned MAX_BYTES = 4 << 20;
+
+protected:
+    quint64 hashKey() const;
+    bool keyEquals(unsigned slot) const;
+    /**
+     * Grows the table to at least twice the number of solutions.
+     */
+    void rehash(unsigned tableSize);
+    /**
+     * Removes the table entry at the given position, moving along any
+     * entries after it that would otherwise not be found.
+     */
+    void removeFromTable(unsigned position);
+
+    void unlink(unsigned slot);
+    void linkFront(unsigned slot);
+
+    unsigned m_keyWords;
+    unsigned m_solutionSize;
+    unsigned m_capacity;
+    unsigned m_count;
+
+    std::vector<quint64> m_key;
+    quint64 m_keyHash; ///< Hash of m_key, as computed by the last find
+
+    // Per solution slot
+    std::vector<quint64> m_keys;
+    std::vector<double> m_solutions;
+    std::vector<quint64> m_hashes;
+    std::vector<unsigned> m_prev; ///< Towards the most recently used
+    std::vector<unsigned> m_next; ///< Towards the least recently used
+    unsigned m_head;
+    unsigned m_tail;
+
+    std::vector<unsigned> m_table; ///< Slot for each position, or NONE
+    unsigned m_tableMask;
+
+    static const unsigned NONE = ~0u;
+};
+
+#endif
@@ -0,0 +1,297 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "logicnetlist.h"
+
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <deque>
+
+static void LogicNetlist_inputChanged(void *objV, bool state)
+{
+    LogicNetlist::Input *input = static_cast<LogicNetlist::Input *>(objV);
+    input->netlist->inputChanged(input->net, state);
+}
+
+LogicNetlist::LogicNetlist()
+    : m_bDirty(false)
+{
+}
+
+LogicNetlist::~LogicNetlist()
+{
+    for (std::vector<TakenCallback>::const_iterator it = m_takenCallbacks.begin(); it != m_takenCallbacks.end(); ++it)
+        it->logicIn->setCallback2(it->function, it->object);
+}
+
+void LogicNetlist::addChain(LogicOut *out, const LogicInList &logicIns)
+{
+    m_chainOf[out] = out;
+    for (LogicInList::const_iterator it = logicIns.begin(); it != logicIns.end(); ++it)
+        m_chainOf[*it] = out;
+}
+
+void LogicNetlist::addGate(const LogicGate &gate)
+{
+    m_candidates.push_back(gate);
+}
+
+int LogicNetlist::compile()
+{
+    // Only gates that are entirely in logic chains can be compiled
+    std::vector<const LogicGate *> gates;
+    QHash<const LogicOut *, unsigned> driverOf;
+    for (std::vector<LogicGate>::const_iterator it = m_candidates.begin(); it != m_candidates.end(); ++it) {
+        const LogicGate &gate = *it;
+        if (!gate.output || gate.inputs.empty())
+            continue;
+        if (m_chainOf.value(gate.output) != gate.output)
+            continue;
+
+        bool inChains = true;
+        for (std::vector<LogicIn *>::const_iterator in = gate.inputs.begin(); in != gate.inputs.end() && inChains; ++in)
+            inChains = m_chainOf.contains(*in);
+        if (!inChains)
+            continue;
+
+        driverOf[gate.output] = gates.size();
+        gates.push_back(&gate);
+    }
+
+    // A gate with a propagation delay passes on its output through the timing
+    // wheel of the Simulator, so the gates after it do not depend on it within
+    // an evaluate, and it can be part of a loop
+    const unsigned candidateCount = gates.size();
+    std::vector<bool> delayed(candidateCount);
+    for (unsigned g = 0; g < candidateCount; ++g)
+        delayed[g] = gates[g]->output->propagationDelay() > 0;
+
+    // Levelize (gates in or after a loop of gates without a delay are never
+    // reached, and are left to their callbacks)
+    std::vector<unsigned> pending(candidateCount, 0);
+    std::vector<std::vector<unsigned>> successors(candidateCount);
+    for (unsigned g = 0; g < candidateCount; ++g) {
+        const std::vector<LogicIn *> &inputs = gates[g]->inputs;
+        for (std::vector<LogicIn *>::const_iterator in = inputs.begin(); in != inputs.end(); ++in) {
+            QHash<const LogicOut *, unsigned>::const_iterator driver = driverOf.constFind(m_chainOf.value(*in));
+            if (driver != driverOf.constEnd() && !delayed[*driver]) {
+                successors[*driver].push_back(g);
+                pending[g]++;
+            }
+        }
+    }
+
+    std::vector<unsigned> level(candidateCount, 0);
+    std::vector<unsigned> order;
+    std::deque<unsigned> ready;
+    for (unsigned g = 0; g < candidateCount; ++g) {
+        if (pending[g] == 0)
+            ready.push_back(g);
+    }
+    while (!ready.empty()) {
+        const unsigned g = ready.front();
+        ready.pop_front();
+        order.push_back(g);
+
+        for (std::vector<unsigned>::const_iterator s = successors[g].begin(); s != successors[g].end(); ++s) {
+            level[*s] = std::max(level[*s], level[g] + 1);
+            if (--pending[*s] == 0)
+                ready.push_back(*s);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&level](unsigned a, unsigned b) {
+        return level[a] < level[b];
+    });
+
+    // Number the nets: those driven from outside first (which includes the
+    // outputs of delayed gates, as they reach their LogicIns from the wheel),
+    // then the outputs of the compiled gates by level
+    std::vector<bool> compiled(candidateCount, false);
+    for (std::vector<unsigned>::const_iterator g = order.begin(); g != order.end(); ++g)
+        compiled[*g] = true;
+
+    QHash<const LogicOut *, unsigned> netOf;
+    std::vector<bool> initialValues;
+    for (std::vector<unsigned>::const_iterator g = order.begin(); g != order.end(); ++g) {
+        const std::vector<LogicIn *> &inputs = gates[*g]->inputs;
+        for (std::vector<LogicIn *>::const_iterator in = inputs.begin(); in != inputs.end(); ++in) {
+            LogicOut *net = m_chainOf.value(*in);
+            QHash<const LogicOut *, unsigned>::const_iterator driver = driverOf.constFind(net);
+            if ((driver == driverOf.constEnd() || !compiled[*driver] || delayed[*driver]) && !netOf.contains(net)) {
+                netOf[net] = initialValues.size();
+                initialValues.push_back(net->isHigh());
+            }
+        }
+    }
+    const unsigned inputNetCount = initialValues.size();
+
+    // The output of a delayed gate is kept apart from the net its LogicIns
+    // read, which only changes once the delay is over
+    std::vector<unsigned> outputOf(candidateCount, 0);
+    for (std::vector<unsigned>::const_iterator g = order.begin(); g != order.end(); ++g) {
+        LogicOut *out = gates[*g]->output;
+        outputOf[*g] = initialValues.size();
+        initialValues.push_back(out->outputState());
+        if (!delayed[*g])
+            netOf[out] = outputOf[*g];
+    }
+
+    m_values.assign((initialValues.size() + 63) / 64, 0);
+    for (unsigned net = 0; net < initialValues.size(); ++net)
+        setValue(net, initialValues[net]);
+
+    m_fanoutOfNet.assign(initialValues.size(), std::vector<unsigned>());
+    m_dirtyGates.assign(order.empty() ? 0 : level[order.back()] + 1, std::vector<unsigned>());
+    m_gates.clear();
+    m_gates.reserve(order.size());
+
+    // The addresses of the inputs are given to the callbacks, so they must
+    // not move
+    m_inputs.clear();
+    m_inputs.reserve(inputNetCount);
+    std::vector<bool> inputTaken(inputNetCount, false);
+
+    for (std::vector<unsigned>::const_iterator g = order.begin(); g != order.end(); ++g) {
+        const LogicGate &gate = *gates[*g];
+
+        CompiledGate c;
+        c.operation = gate.operation;
+        c.inverted = gate.inverted;
+        c.dirty = false;
+        c.inputCount = gate.inputs.size();
+        c.level = level[*g];
+        c.output = outputOf[*g];
+        c.out = gate.output;
+
+        const unsigned index = m_gates.size();
+        for (std::vector<LogicIn *>::const_iterator in = gate.inputs.begin(); in != gate.inputs.end(); ++in) {
+            const unsigned net = netOf.value(m_chainOf.value(*in));
+            const unsigned word = net / 64;
+            const quint64 bit = quint64(1) << (net % 64);
+
+            // Inputs on the same net have to be counted more than once, so
+            // go in terms of their own
+            std::vector<Term>::iterator term = c.terms.begin();
+            while (term != c.terms.end() && (term->word != word || (term->mask & bit)))
+                ++term;
+            if (term == c.terms.end())
+                c.terms.push_back(Term{word, bit});
+            else
+                term->mask |= bit;
+
+            std::vector<unsigned> &fanout = m_fanoutOfNet[net];
+            if (fanout.empty() || fanout.back() != index)
+                fanout.push_back(index);
+
+            TakenCallback taken;
+            taken.logicIn = *in;
+            taken.function = (*in)->callback2Function();
+            taken.object = (*in)->callback2Object();
+            m_takenCallbacks.push_back(taken);
+
+            // One LogicIn of each outside net tells us about changes; the
+            // rest of the compiled LogicIns need not do anything
+            if (net < inputNetCount && !inputTaken[net]) {
+                inputTaken[net] = true;
+                m_inputs.push_back(Input{this, net});
+                (*in)->setCallback2(LogicNetlist_inputChanged, &m_inputs.back());
+            } else {
+                (*in)->setCallback2(nullptr, nullptr);
+            }
+        }
+
+        m_gates.push_back(c);
+        markDirty(index);
+    }
+
+    m_chainOf.clear();
+    m_candidates.clear();
+
+    return m_gates.size();
+}
+
+void LogicNetlist::markDirty(unsigned gate)
+{
+    CompiledGate &c = m_gates[gate];
+    if (c.dirty)
+        return;
+
+    c.dirty = true;
+    m_dirtyGates[c.level].push_back(gate);
+    m_bDirty = true;
+}
+
+void LogicNetlist::inputChanged(unsigned net, bool high)
+{
+    if (value(net) == high)
+        return;
+
+    setValue(net, high);
+
+    const std::vector<unsigned> &fanout = m_fanoutOfNet[net];
+    for (std::vector<unsigned>::const_iterator it = fanout.begin(); it != fanout.end(); ++it)
+        markDirty(*it);
+}
+
+void LogicNetlist::evaluate()
+{
+    m_bDirty = false;
+
+    // Gates only feed gates in higher levels, so the levels below the current
+    // one do not get any more dirty gates
+    for (std::vector<std::vector<unsigned>>::iterator dirty = m_dirtyGates.begin(); dirty != m_dirtyGates.end(); ++dirty) {
+        for (std::vector<unsigned>::const_iterator it = dirty->begin(); it != dirty->end(); ++it) {
+            CompiledGate &gate = m_gates[*it];
+            gate.dirty = false;
+
+            unsigned highCount = 0;
+            for (std::vector<Term>::const_iterator term = gate.terms.begin(); term != gate.terms.end(); ++term)
+                highCount += qPopulationCount(m_values[term->word] & term->mask);
+
+            bool high;
+            switch (gate.operation) {
+            case LogicGate::And:
+                high = (highCount == gate.inputCount);
+                break;
+            case LogicGate::Or:
+                high = (highCount > 0);
+                break;
+            case LogicGate::Xor:
+            default:
+                high = (highCount == 1);
+                break;
+            }
+            if (gate.inverted)
+                high = !high;
+
+            if (high == value(gate.output))
+                continue;
+
+            setValue(gate.output, high);
+            m_changedGates.push_back(*it);
+
+            const std::vector<unsigned> &fanout = m_fanoutOfNet[gate.output];
+            for (std::vector<unsigned>::const_iterator next = fanout.begin(); next != fanout.end(); ++next)
+                markDirty(*next);
+        }
+        dirty->clear();
+    }
+
+    // Marking the gates above dirty set this again
+    m_bDirty = false;
+
+    // Pass the new states on to the pins and the rest of the logic chains
+    for (std::vector<unsigned>::const_iterator it = m_changedGates.begin(); it != m_changedGates.end(); ++it) {
+        const CompiledGate &gate = m_gates[*it];
+        gate.out->setHigh(value(gate.output));
+    }
+    m_changedGates.clear();
+}
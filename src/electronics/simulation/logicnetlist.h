@@ -0,0 +1,200 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef LOGICNETLIST_H
+#define LOGICNETLIST_H
+
+#include "logic.h"
+
+#include <QHash>
+#include <QtGlobal>
+
+#include <vector>
+
+/**
+Describes a combinational logic gate: one whose output only depends on the
+current state of its inputs. Sequential parts are not described as gates.
+@see Component::describeLogicGate
+*/
+class LogicGate
+{
+public:
+    enum Operation {
+        And, ///< high if all of the inputs are high
+        Or,  ///< high if any of the inputs is high
+        Xor  ///< high if exactly one of the inputs is high (as with ECXor)
+    };
+
+    LogicGate()
+        : operation(Or)
+        , inverted(false)
+        , output(nullptr)
+    {
+    }
+
+    Operation operation;
+    bool inverted; ///< whether the output is the inverse of the operation
+    std::vector<LogicIn *> inputs;
+    LogicOut *output;
+};
+
+/**
+Evaluates the combinational logic gates of a document without going through
+the callbacks of their inputs for each edge.
+
+Usage:
+(1) Add the logic chains (as they are created), and then the gates.
+(2) Call compile. Gates whose inputs and output are all in logic chains, and
+    which are not part of a loop of gates without a propagation delay, are
+    compiled: they are sorted into levels (each gate only depending on gates
+    without a delay in lower levels), and the callbacks of their inputs are
+    taken over.
+(3) Whenever isDirty() is true, call evaluate (done by the Simulator).
+
+The state of the nets is kept as the bits of 64-bit words, numbered so that
+the inputs of a gate tend to share words. A gate is evaluated by counting the
+high inputs in each of the words it uses at once. Only gates with an input
+that has changed are evaluated (each at most once per evaluate), in order of
+level, so a path of gates settles in one go. The outputs that changed are
+then set, which passes them on to the pins and to the components that are
+not compiled.
+
+A gate with a propagation delay (the default, see LogicOut::setPropagationDelay)
+is evaluated in the same way, but its output reaches the gates it drives
+through the timing wheel of the Simulator, as if it were driven from outside
+the netlist; so those gates are evaluated in the logic update the delay ends
+in, and loops through delayed gates (e.g. ring oscillators) are compiled too.
+
+Only combinational gates are compiled. Sequential parts (flip-flops, latches,
+counters and the like) keep their callbacks, and drive and read compiled gates
+through the logic chains as any other component does.
+
+The callbacks of the inputs are given back when the netlist is deleted, so
+it must be deleted before the components (CircuitDocument does so along with
+its circuits).
+
+@short Levelized evaluation of logic gates
+*/
+class LogicNetlist
+{
+public:
+    LogicNetlist();
+    ~LogicNetlist();
+
+    /**
+     * Adds a logic chain, that out drives the LogicIns of.
+     */
+    void addChain(LogicOut *out, const LogicInList &logicIns);
+    /**
+     * Adds a gate, to be compiled if it can be.
+     */
+    void addGate(const LogicGate &gate);
+    /**
+     * Compiles the gates added.
+     * @return the number of gates that were compiled
+     */
+    int compile();
+    /**
+     * @return whether an input of a compiled gate has changed since the last
+     * evaluate.
+     */
+    bool isDirty() const
+    {
+        return m_bDirty;
+    }
+    /**
+     * Evaluates the gates whose inputs have changed, and sets the outputs
+     * that change.
+     */
+    void evaluate();
+
+    int gateCount() const
+    {
+        return int(m_gates.size());
+    }
+    int levelCount() const
+    {
+        return int(m_dirtyGates.size());
+    }
+
+    /**
+     * Called from the callback of the first compiled LogicIn of a net that
+     * is driven from outside the netlist.
+     */
+    void inputChanged(unsigned net, bool high);
+
+    /**
+     * The callback given to the LogicIns on nets driven from outside the
+     * netlist.
+     */
+    class Input
+    {
+    public:
+        LogicNetlist *netlist;
+        unsigned net;
+    };
+
+protected:
+    class Term
+    {
+    public:
+        unsigned word;
+        quint64 mask;
+    };
+
+    class CompiledGate
+    {
+    public:
+        LogicGate::Operation operation;
+        bool inverted;
+        bool dirty;
+        unsigned inputCount;
+        unsigned level;
+        unsigned output;         ///< state of the output (the net it drives, unless delayed)
+        LogicOut *out;
+        std::vector<Term> terms; ///< the bits of the inputs, by word
+    };
+
+    class TakenCallback
+    {
+    public:
+        LogicIn *logicIn;
+        Callback2Ptr function;
+        Callback2Obj object;
+    };
+
+    bool value(unsigned net) const
+    {
+        return m_values[net / 64] & (quint64(1) << (net % 64));
+    }
+    void setValue(unsigned net, bool high)
+    {
+        if (high)
+            m_values[net / 64] |= quint64(1) << (net % 64);
+        else
+            m_values[net / 64] &= ~(quint64(1) << (net % 64));
+    }
+    void markDirty(unsigned gate);
+
+    /// Nets by the LogicIns and LogicOut in them, while adding
+    QHash<const LogicIn *, LogicOut *> m_chainOf;
+    std::vector<LogicGate> m_candidates;
+
+    std::vector<CompiledGate> m_gates;
+    std::vector<std::vector<unsigned>> m_fanoutOfNet; ///< gates with an input on each net
+    std::vector<std::vector<unsigned>> m_dirtyGates; ///< by level
+    std::vector<unsigned> m_changedGates;
+    std::vector<quint64> m_values;
+    std::vector<Input> m_inputs;
+    std::vector<TakenCallback> m_takenCallbacks;
+    bool m_bDirty;
+};
+
+#endif
@@ -10,10 +10,27 @@
 
 #include "matrix.h"
 
+#include "bandedlu.h"
 #include "element.h"
+#include "sparselu.h"
 
+#include <math/qkernels.h>
+
+#include <QElapsedTimer>
+
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <iostream>
+#include <limits>
+
+#include <ktechlab_debug.h>
+
+bool Matrix::m_bTimingEnabled = false;
+unsigned Matrix::m_refactorInterval = 0;
+bool Matrix::m_bMixedPrecision = false;
+bool Matrix::m_bReferenceMode = false;
+std::atomic<unsigned> Matrix::m_layoutGenerations(0);
 
 Matrix::Matrix(CUI n, CUI m)
     : m_n(n)
@@ -30,16 +47,159 @@ Matrix::Matrix(CUI n, CUI m)
 
     for (unsigned int i = 0; i < size; i++)
         m_inMap[i] = i;
+
+    m_solverType = DenseSolver;
+    m_sparse = nullptr;
+    m_banded = nullptr;
+    m_pattern.resize(size);
+    m_luCacheClock = 0;
+    m_bLUCacheEnabled = true;
+    m_factorizationCount = m_restoredFactorizationCount = 0;
+    m_factorizationNs = 0;
+    m_factorizationsSinceFull = 0;
+    m_conditionEstimate = 0.;
+    m_bUpdatesChanged = false;
+    m_layoutGeneration = ++m_layoutGenerations;
+    m_bFloatLU = false;
+    m_bMixedPrecisionFailed = false;
+    m_normA = 0.;
 }
 
 Matrix::~Matrix()
 {
     delete m_mat;
     delete m_lu;
+    delete m_sparse;
+    delete m_banded;
     delete[] m_y;
     delete[] m_inMap;
 }
 
+void Matrix::setUse(CUI i, CUI j)
+{
+    if (i < m_pattern.size())
+        m_pattern[i].push_back(j);
+}
+
+void Matrix::createMap(bool allowSparse)
+{
+    const unsigned int size = m_mat->size_m();
+
+    if (!allowSparse || m_bReferenceMode || size < BANDED_MIN_SIZE || m_sparse || m_banded) {
+        m_pattern.clear();
+        return;
+    }
+
+    for (unsigned int i = 0; i < size; i++) {
+        std::vector<unsigned> &row = m_pattern[i];
+        std::sort(row.begin(), row.end());
+        row.erase(std::unique(row.begin(), row.end()), row.end());
+    }
+
+    BandedLU *banded = new BandedLU;
+    banded->analyse(m_pattern, m_n);
+
+    SparseLU *sparse = nullptr;
+    if (size >= SPARSE_MIN_SIZE) {
+        sparse = new SparseLU;
+        sparse->analyse(m_pattern, m_n);
+    }
+    m_pattern.clear();
+
+    // The banded and sparse solvers are kept if they are worth using over
+    // the dense one
+    if (banded->bandSize() > SPARSE_MAX_DENSITY * size * size) {
+        delete banded;
+        banded = nullptr;
+    }
+    if (sparse && sparse->nonZeros() > SPARSE_MAX_DENSITY * size * size) {
+        delete sparse;
+        sparse = nullptr;
+    }
+    if (!banded && !sparse)
+        return;
+
+    m_sparse = sparse;
+    m_banded = banded;
+
+    // Of those, the banded one is picked unless its band is much bigger
+    // than the sparse factorization
+    if (banded && !(sparse && banded->bandSize() > BANDED_MAX_SPARSE_RATIO * sparse->nonZeros()))
+        setSolverType(BandedSolver);
+    else
+        setSolverType(SparseSolver);
+}
+
+std::vector<Matrix::SolverType> Matrix::availableSolvers() const
+{
+    std::vector<SolverType> solvers;
+    solvers.push_back(m_solverType);
+    if (m_banded && m_solverType != BandedSolver)
+        solvers.push_back(BandedSolver);
+    if (m_sparse && m_solverType != SparseSolver)
+        solvers.push_back(SparseSolver);
+    if ((m_sparse || m_banded) && m_solverType != DenseSolver && m_mat->size_m() <= DENSE_MAX_TRIAL_SIZE)
+        solvers.push_back(DenseSolver);
+    return solvers;
+}
+
+bool Matrix::setSolverType(SolverType type)
+{
+    if (type == m_solverType)
+        return true;
+    if ((type == SparseSolver && !m_sparse) || (type == BandedSolver && !m_banded))
+        return false;
+
+    const unsigned int size = m_mat->size_m();
+
+    // Move the rows of the matrix to where the solver expects them (the
+    // dense solver takes them in any order)
+    std::vector<unsigned> perm(size);
+    if (type == SparseSolver)
+        perm = m_sparse->permutation();
+    else if (type == BandedSolver)
+        perm = m_banded->permutation();
+    else {
+        for (unsigned int i = 0; i < size; i++)
+            perm[i] = i;
+    }
+
+    std::vector<double *> rows(size);
+    for (unsigned int i = 0; i < size; i++)
+        rows[perm[i]] = (*m_mat)[m_inMap[i]];
+    for (unsigned int i = 0; i < size; i++) {
+        (*m_mat)[i] = rows[i];
+        m_inMap[i] = perm[i];
+    }
+
+    // The dense LU storage is only needed by the dense solver
+    if (type == DenseSolver) {
+        if (!m_lu)
+            m_lu = new QuickMatrix(size);
+    } else {
+        delete m_lu;
+        m_lu = nullptr;
+    }
+
+    m_solverType = type;
+    m_layoutGeneration = ++m_layoutGenerations;
+    max_k = 0;
+    m_pivot.clear();
+    m_bFloatLU = false;
+    m_luCache.clear();
+    m_updates.clear();
+    m_factoredUpdates.clear();
+    m_bUpdatesChanged = false;
+    return true;
+}
+
+void Matrix::setLUCacheEnabled(bool enabled)
+{
+    m_bLUCacheEnabled = enabled;
+    if (!enabled)
+        m_luCache.clear();
+}
+
 void Matrix::swapRows(CUI a, CUI b)
 {
     if (a == b)
@@ -50,26 +210,254 @@ void Matrix::swapRows(CUI a, CUI b)
     m_inMap[a] = m_inMap[b];
     m_inMap[b] = old;
 
+    m_layoutGeneration = ++m_layoutGenerations;
     max_k = 0;
 }
 
+void Matrix::addRankOne(int ui, int uj, int vi, int vj, double delta)
+{
+    if (delta == 0.)
+        return;
+
+    RankOneUpdate update;
+    update.ui = ui;
+    update.uj = uj;
+    update.vi = vi;
+    update.vj = vj;
+    update.delta = delta;
+
+    // The entries of u v^T are 1 where the signs of the unit vectors agree
+    // and -1 where they do not
+    const int rows[2] = {ui, uj};
+    const int cols[2] = {vi, vj};
+    bool changed = false;
+    for (int r = 0; r < 2; r++) {
+        if (rows[r] < 0)
+            continue;
+        double *const row = (*m_mat)[m_inMap[rows[r]]];
+        for (int c = 0; c < 2; c++) {
+            if (cols[c] < 0)
+                continue;
+            const double newValue = row[cols[c]] + ((r == c) ? delta : -delta);
+            if (newValue != row[cols[c]]) {
+                row[cols[c]] = newValue;
+                changed = true;
+            }
+        }
+    }
+    if (!changed)
+        return;
+
+    // The decomposition is being redone anyway; and one in single precision
+    // is refined against the matrix as it is, so it cannot be updated
+    if (max_k < m_mat->size_m() || m_bFloatLU || m_bReferenceMode) {
+        setChanged(update);
+        return;
+    }
+
+    for (std::vector<RankOneUpdate>::iterator it = m_updates.begin(); it != m_updates.end(); ++it) {
+        if (it->ui != ui || it->uj != uj || it->vi != vi || it->vj != vj)
+            continue;
+
+        it->delta += delta;
+        if (it->delta == 0.)
+            m_updates.erase(it);
+        m_bUpdatesChanged = true;
+        return;
+    }
+
+    if (m_updates.size() >= MAX_RANK_ONE_UPDATES) {
+        foldUpdates();
+        setChanged(update);
+        return;
+    }
+
+    m_updates.push_back(update);
+    m_bUpdatesChanged = true;
+}
+
+void Matrix::setChanged(const RankOneUpdate &update)
+{
+    const int rows[2] = {update.ui, update.uj};
+    const int cols[2] = {update.vi, update.vj};
+    for (int r = 0; r < 2; r++) {
+        for (int c = 0; c < 2; c++) {
+            if (rows[r] >= 0 && cols[c] >= 0)
+                setChanged(m_inMap[rows[r]], cols[c]);
+        }
+    }
+}
+
+void Matrix::foldUpdates()
+{
+    for (std::vector<RankOneUpdate>::const_iterator it = m_updates.begin(); it != m_updates.end(); ++it)
+        setChanged(*it);
+
+    m_updates.clear();
+    m_factoredUpdates.clear();
+    m_bUpdatesChanged = false;
+}
+
+bool Matrix::factorUpdates()
+{
+    m_bUpdatesChanged = false;
+
+    const unsigned int n = m_mat->size_m();
+    const unsigned int k = m_updates.size();
+
+    // Z = A^-1 U, a column for each update. The decomposition does not
+    // change while there are updates, so each is only worked out once
+    for (std::vector<RankOneUpdate>::iterator it = m_updates.begin(); it != m_updates.end(); ++it) {
+        if (!it->z.empty())
+            continue;
+        it->z.assign(n, 0.);
+        if (it->ui >= 0)
+            it->z[it->ui] = 1.;
+        if (it->uj >= 0)
+            it->z[it->uj] = -1.;
+        solveLU(it->z.data());
+    }
+
+    // The Woodbury identity gives the solution of (A + U D V^T) x = b as
+    // x = y - Z w, where y = A^-1 b and (I + D V^T Z) w = D V^T y
+    m_capacitance.assign(k * k, 0.);
+    for (unsigned int a = 0; a < k; a++) {
+        const RankOneUpdate &update = m_updates[a];
+        for (unsigned int l = 0; l < k; l++) {
+            const std::vector<double> &z = m_updates[l].z;
+            double vz = 0.;
+            if (update.vi >= 0)
+                vz += z[update.vi];
+            if (update.vj >= 0)
+                vz -= z[update.vj];
+            m_capacitance[a * k + l] = ((a == l) ? 1. : 0.) + update.delta * vz;
+        }
+    }
+
+    // LU decompose it, with partial pivoting as it is small
+    m_capacitancePivot.resize(k);
+    for (unsigned int i = 0; i < k; i++)
+        m_capacitancePivot[i] = i;
+
+    for (unsigned int c = 0; c < k; c++) {
+        unsigned int p = c;
+        for (unsigned int r = c + 1; r < k; r++) {
+            if (std::abs(m_capacitance[r * k + c]) > std::abs(m_capacitance[p * k + c]))
+                p = r;
+        }
+        if (std::abs(m_capacitance[p * k + c]) < 1e-12)
+            return false;
+
+        if (p != c) {
+            std::swap_ranges(m_capacitance.begin() + p * k, m_capacitance.begin() + (p + 1) * k, m_capacitance.begin() + c * k);
+            std::swap(m_capacitancePivot[c], m_capacitancePivot[p]);
+        }
+
+        for (unsigned int r = c + 1; r < k; r++) {
+            const double l = m_capacitance[r * k + c] /= m_capacitance[c * k + c];
+            for (unsigned int j = c + 1; j < k; j++)
+                m_capacitance[r * k + j] -= l * m_capacitance[c * k + j];
+        }
+    }
+
+    m_factoredUpdates = m_updates;
+    return true;
+}
+
 void Matrix::performLU()
 {
     unsigned int n = m_mat->size_m();
-    if (n == 0)
+    if (n == 0 || !isChanged())
         return;
 
-    // Copy the affected segment to LU
-    for (uint i = max_k; i < n; i++) {
-        for (uint j = max_k; j < n; j++) {
-            (*m_lu)[i][j] = (*m_mat)[i][j];
+    QElapsedTimer timer;
+    if (m_bTimingEnabled)
+        timer.start();
+
+    // Only the low-rank updates have changed since the matrix was last
+    // decomposed, so the decomposition is kept; otherwise it is redone
+    // from the first row that has changed, updates and all
+    if (max_k < n || !factorUpdates()) {
+        foldUpdates();
+        factorize();
+    }
+
+    if (m_bTimingEnabled)
+        m_factorizationNs += timer.nsecsElapsed();
+}
+
+void Matrix::factorize()
+{
+    const unsigned int n = m_mat->size_m();
+
+    if (m_refactorInterval && !m_bReferenceMode && ++m_factorizationsSinceFull >= m_refactorInterval) {
+        m_factorizationsSinceFull = 0;
+        m_bFloatLU = false;
+        refactorFully();
+        return;
+    }
+
+    if (useFloatLU()) {
+        factorizeFloat();
+        return;
+    }
+
+    // The rows of m_lu are out of date after decomposing in single precision
+    if (m_bFloatLU) {
+        m_bFloatLU = false;
+        max_k = 0;
+    }
+
+    // Rows were swapped around in the last factorization, so none of it can
+    // be kept
+    if (!m_pivot.empty()) {
+        m_pivot.clear();
+        max_k = 0;
+    }
+
+    const bool useCache = m_bLUCacheEnabled && !m_bReferenceMode && (n - max_k >= LU_CACHE_MIN_ROWS);
+    quint64 hash = 0;
+    if (useCache) {
+        luCacheKey(&m_luCacheKey);
+        hash = valueHash(m_luCacheKey);
+        if (restoreLU(hash)) {
+            max_k = n;
+            m_restoredFactorizationCount++;
+            return;
         }
     }
 
+    m_factorizationCount++;
+
+    if (m_solverType == SparseSolver) {
+        // The factorization is done row by row, so only the rows from the
+        // first changed one need redoing
+        m_sparse->factor(m_mat, max_k);
+        max_k = n;
+        if (useCache)
+            storeLU(hash);
+        return;
+    }
+
+    if (m_solverType == BandedSolver) {
+        // As for the dense solver, but only over the band
+        m_banded->factor(m_mat, max_k);
+        max_k = n;
+        if (useCache)
+            storeLU(hash);
+        return;
+    }
+
+    // Rows of LU only depend on the same and earlier rows of the matrix, so
+    // only the rows from the first changed one need redoing - but all of
+    // each of those rows, as the part left of max_k holds L
+    for (uint i = max_k; i < n; i++) {
+        std::memcpy((*m_lu)[i], (*m_mat)[i], n * sizeof(double));
+    }
+
     // LU decompose the matrix, and store result back in matrix
     for (uint k = 0; k < n - 1; k++) {
         double *const lu_K_K = &(*m_lu)[k][k];
-        unsigned foo = std::max(k, max_k) + 1;
 
         // detect singular matrixes...
         if (std::abs(*lu_K_K) < 1e-10) {
@@ -80,56 +468,438 @@ void Matrix::performLU()
         }
         // #############
 
-        for (uint i = foo; i < n; i++) {
-            (*m_lu)[i][k] /= *lu_K_K;
+        for (uint i = std::max(k + 1, max_k); i < n; i++) {
+            const double lu_I_K = (*m_lu)[i][k] /= *lu_K_K;
+            if (std::abs(lu_I_K) > 1e-12) {
+                m_lu->partialSAF(k, i, k + 1, -lu_I_K);
+            }
         }
+    }
 
-        for (uint i = std::max(k, max_k) + 1; i < n; i++) {
-            const double lu_I_K = (*m_lu)[i][k];
-            if (std::abs(lu_I_K) > 1e-12) {
-                m_lu->partialSAF(k, i, foo, -lu_I_K);
+    max_k = n;
+    if (useCache)
+        storeLU(hash);
+}
+
+void Matrix::refactorFully()
+{
+    const unsigned int n = m_mat->size_m();
+    const bool wasIllConditioned = isIllConditioned();
+    m_factorizationCount++;
+
+    double largest = 0.;
+    double smallest = std::numeric_limits<double>::max();
+
+    if (m_solverType == SparseSolver) {
+        // The ordering of the sparse solver is fixed by its symbolic
+        // factorization, so only the rounding errors are cleared
+        m_sparse->factor(m_mat, 0);
+        m_conditionEstimate = m_sparse->pivotRatio();
+    } else if (m_solverType == BandedSolver) {
+        // Pivoting would widen the band, so as for the sparse solver
+        m_banded->factor(m_mat, 0);
+        m_conditionEstimate = m_banded->pivotRatio();
+    } else {
+        for (uint i = 0; i < n; i++)
+            std::memcpy((*m_lu)[i], (*m_mat)[i], n * sizeof(double));
+
+        m_pivot.resize(n);
+        for (uint i = 0; i < n; i++)
+            m_pivot[i] = i;
+
+        for (uint k = 0; k < n; k++) {
+            // Take the row with the largest value in the column as the pivot
+            uint p = k;
+            for (uint i = k + 1; i < n; i++) {
+                if (std::abs((*m_lu)[i][k]) > std::abs((*m_lu)[p][k]))
+                    p = i;
+            }
+            if (p != k) {
+                m_lu->swapRows(k, p);
+                std::swap(m_pivot[k], m_pivot[p]);
+            }
+
+            double *const lu_K_K = &(*m_lu)[k][k];
+
+            // detect singular matrixes (as in the unpivoted factorization)...
+            if (std::abs(*lu_K_K) < 1e-10)
+                *lu_K_K = (*lu_K_K < 0.) ? -1e-10 : 1e-10;
+
+            largest = std::max(largest, std::abs(*lu_K_K));
+            smallest = std::min(smallest, std::abs(*lu_K_K));
+
+            for (uint i = k + 1; i < n; i++) {
+                const double lu_I_K = (*m_lu)[i][k] /= *lu_K_K;
+                if (std::abs(lu_I_K) > 1e-12)
+                    m_lu->partialSAF(k, i, k + 1, -lu_I_K);
             }
         }
+        m_conditionEstimate = largest / smallest;
     }
 
     max_k = n;
+
+    // Only warn when the matrix becomes ill-conditioned, not on every
+    // refactorization while it stays so
+    if (isIllConditioned() && !wasIllConditioned)
+        qCWarning(KTL_LOG) << "circuit matrix of size" << n << "is ill-conditioned, estimated condition number" << m_conditionEstimate;
+}
+
+bool Matrix::useFloatLU() const
+{
+    return m_bMixedPrecision && !m_bReferenceMode && !m_bMixedPrecisionFailed && m_solverType == DenseSolver && m_mat->size_m() >= MIXED_PRECISION_MIN_SIZE;
+}
+
+void Matrix::factorizeFloat()
+{
+    const unsigned int n = m_mat->size_m();
+
+    // Rows were swapped around in the last factorization, or it was in
+    // double precision, so none of it can be kept
+    if (!m_pivot.empty() || !m_bFloatLU) {
+        m_pivot.clear();
+        max_k = 0;
+        m_floatLU.resize(n * n);
+        m_bFloatLU = true;
+    }
+
+    m_factorizationCount++;
+
+    m_normA = 0.;
+    for (uint i = 0; i < n; i++) {
+        const double *const row = (*m_mat)[i];
+        double sum = 0.;
+        for (uint j = 0; j < n; j++)
+            sum += std::abs(row[j]);
+        m_normA = std::max(m_normA, sum);
+
+        if (i >= max_k) {
+            float *const lu = &m_floatLU[i * n];
+            for (uint j = 0; j < n; j++)
+                lu[j] = float(row[j]);
+        }
+    }
+
+    // As for the factorization in double precision
+    for (uint k = 0; k < n - 1; k++) {
+        float *const lu_K = &m_floatLU[k * n];
+        float &lu_K_K = lu_K[k];
+
+        if (std::abs(lu_K_K) < 1e-10f)
+            lu_K_K = (lu_K_K < 0.f) ? -1e-10f : 1e-10f;
+
+        for (uint i = std::max(k + 1, max_k); i < n; i++) {
+            float *const lu_I = &m_floatLU[i * n];
+            const float lu_I_K = lu_I[k] /= lu_K_K;
+            if (std::abs(lu_I_K) > 1e-12f) {
+                for (uint j = k + 1; j < n; j++)
+                    lu_I[j] -= lu_I_K * lu_K[j];
+            }
+        }
+    }
+
+    max_k = n;
+}
+
+void Matrix::solveFloatLU(double *x)
+{
+    const unsigned int size = m_mat->size_m();
+
+    for (uint i = 0; i < size; i++)
+        m_y[m_inMap[i]] = x[i];
+
+    // The factors are in single precision, but the sums are kept in double
+    for (uint i = 1; i < size; i++) {
+        const float *const lu = &m_floatLU[i * size];
+        double sum = 0.;
+        for (uint j = 0; j < i; j++)
+            sum += lu[j] * m_y[j];
+        m_y[i] -= sum;
+    }
+
+    for (int i = size - 1; i >= 0; i--) {
+        const float *const lu = &m_floatLU[i * size];
+        double sum = 0.;
+        for (uint j = i + 1; j < size; j++)
+            sum += lu[j] * m_y[j];
+        m_y[i] = (m_y[i] - sum) / lu[i];
+    }
+
+    for (uint i = 0; i < size; i++)
+        x[i] = m_y[i];
+}
+
+bool Matrix::solveRefined(double *x)
+{
+    const unsigned int size = m_mat->size_m();
+
+    m_rhs.assign(x, x + size);
+    m_residual.resize(size);
+
+    double normB = 0.;
+    for (uint i = 0; i < size; i++)
+        normB = std::max(normB, std::abs(x[i]));
+
+    solveFloatLU(x);
+
+    for (unsigned step = 0; step < MAX_REFINEMENT_STEPS; step++) {
+        double normR = 0.;
+        double normX = 0.;
+        for (uint i = 0; i < size; i++) {
+            m_residual[i] = m_rhs[i] - QuickKernels::dot((*m_mat)[m_inMap[i]], x, size);
+            normR = std::max(normR, std::abs(m_residual[i]));
+            normX = std::max(normX, std::abs(x[i]));
+        }
+
+        if (normR <= REFINEMENT_TOLERANCE * (m_normA * normX + normB))
+            return true;
+
+        solveFloatLU(m_residual.data());
+        for (uint i = 0; i < size; i++)
+            x[i] += m_residual[i];
+    }
+
+    // Put the right side back for solving again
+    std::copy(m_rhs.begin(), m_rhs.end(), x);
+    return false;
+}
+
+void Matrix::luCacheKey(std::vector<double> *values) const
+{
+    if (m_solverType == SparseSolver) {
+        m_sparse->matrixValues(m_mat, values);
+        return;
+    }
+    if (m_solverType == BandedSolver) {
+        m_banded->matrixValues(m_mat, values);
+        return;
+    }
+
+    const unsigned int n = m_mat->size_m();
+    values->resize(n * n);
+    for (unsigned int i = 0; i < n; i++)
+        std::copy((*m_mat)[i], (*m_mat)[i] + n, values->begin() + i * n);
+}
+
+// The values are told apart by all but the lowest 12 bits of the mantissa
+static const quint64 LU_CACHE_VALUE_MASK = ~quint64(0xfff);
+
+quint64 Matrix::valueHash(const std::vector<double> &values)
+{
+    // FNV-1a
+    quint64 hash = 14695981039346656037ull;
+    for (std::vector<double>::const_iterator it = values.begin(); it != values.end(); ++it) {
+        quint64 bits;
+        std::memcpy(&bits, &*it, sizeof(bits));
+        hash ^= bits & LU_CACHE_VALUE_MASK;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool Matrix::sameValues(const std::vector<double> &a, const std::vector<double> &b)
+{
+    if (a.size() != b.size())
+        return false;
+
+    for (size_t i = 0; i < a.size(); i++) {
+        quint64 bitsA, bitsB;
+        std::memcpy(&bitsA, &a[i], sizeof(bitsA));
+        std::memcpy(&bitsB, &b[i], sizeof(bitsB));
+        if ((bitsA ^ bitsB) & LU_CACHE_VALUE_MASK)
+            return false;
+    }
+    return true;
+}
+
+bool Matrix::restoreLU(quint64 hash)
+{
+    for (std::vector<CachedLU>::iterator it = m_luCache.begin(); it != m_luCache.end(); ++it) {
+        // The hash only narrows it down; a different matrix may have the
+        // same one
+        if (it->hash != hash || !sameValues(it->key, m_luCacheKey))
+            continue;
+
+        it->lastUse = ++m_luCacheClock;
+
+        if (m_solverType == SparseSolver) {
+            m_sparse->setValues(it->values);
+        } else if (m_solverType == BandedSolver) {
+            m_banded->setValues(it->values);
+        } else {
+            const unsigned int n = m_lu->size_m();
+            for (unsigned int i = 0; i < n; i++)
+                std::copy(it->values.begin() + i * n, it->values.begin() + (i + 1) * n, (*m_lu)[i]);
+        }
+        return true;
+    }
+    return false;
+}
+
+void Matrix::storeLU(quint64 hash)
+{
+    std::vector<CachedLU>::iterator entry;
+    if (m_luCache.size() < LU_CACHE_SIZE) {
+        m_luCache.push_back(CachedLU());
+        entry = m_luCache.end() - 1;
+    } else {
+        entry = m_luCache.begin();
+        for (std::vector<CachedLU>::iterator it = m_luCache.begin(); it != m_luCache.end(); ++it) {
+            if (it->lastUse < entry->lastUse)
+                entry = it;
+        }
+    }
+
+    entry->hash = hash;
+    entry->lastUse = ++m_luCacheClock;
+    entry->key = m_luCacheKey;
+
+    if (m_solverType == SparseSolver) {
+        entry->values = m_sparse->values();
+    } else if (m_solverType == BandedSolver) {
+        entry->values = m_banded->values();
+    } else {
+        const unsigned int n = m_lu->size_m();
+        entry->values.resize(n * n);
+        for (unsigned int i = 0; i < n; i++)
+            std::copy((*m_lu)[i], (*m_lu)[i] + n, entry->values.begin() + i * n);
+    }
 }
 
 void Matrix::fbSub(QuickVector *b)
 {
-    unsigned int size = m_mat->size_m();
+    const unsigned int size = m_mat->size_m();
+
+    double *const solution = b->data();
+
+    if (m_bFloatLU) {
+        // A decomposition that is being reused for a changed matrix (as by
+        // the Newton iterations) is only meant to be close, so is not refined
+        if (max_k < size) {
+            solveFloatLU(solution);
+            return;
+        }
+
+        if (solveRefined(solution))
+            return;
+
+        qCWarning(KTL_LOG) << "iterative refinement did not converge for a circuit matrix of size" << size << "- decomposing it in double precision";
+        m_bMixedPrecisionFailed = true;
+        max_k = 0;
+        factorize();
+    }
+
+    solveLU(solution);
+
+    const unsigned int k = m_factoredUpdates.size();
+    if (k > 0) {
+        // Correct the solution for the low-rank updates (see factorUpdates),
+        // solving for w with the pivoted rows
+        m_updateWeights.resize(k);
+        for (unsigned int a = 0; a < k; a++) {
+            const RankOneUpdate &update = m_factoredUpdates[m_capacitancePivot[a]];
+            double vy = 0.;
+            if (update.vi >= 0)
+                vy += solution[update.vi];
+            if (update.vj >= 0)
+                vy -= solution[update.vj];
+            m_updateWeights[a] = update.delta * vy;
+        }
+
+        for (unsigned int a = 1; a < k; a++) {
+            for (unsigned int l = 0; l < a; l++)
+                m_updateWeights[a] -= m_capacitance[a * k + l] * m_updateWeights[l];
+        }
+        for (int a = k - 1; a >= 0; a--) {
+            for (unsigned int l = a + 1; l < k; l++)
+                m_updateWeights[a] -= m_capacitance[a * k + l] * m_updateWeights[l];
+            m_updateWeights[a] /= m_capacitance[a * k + a];
+        }
+
+        for (unsigned int l = 0; l < k; l++) {
+            const double w = m_updateWeights[l];
+            QuickKernels::axpy(solution, m_factoredUpdates[l].z.data(), -w, size);
+        }
+    }
+}
+
+void Matrix::solveLU(double *x)
+{
+    const unsigned int size = m_mat->size_m();
 
     for (uint i = 0; i < size; i++) {
-        m_y[m_inMap[i]] = (*b)[i];
+        m_y[m_inMap[i]] = x[i];
+    }
+
+    if (m_solverType == SparseSolver || m_solverType == BandedSolver) {
+        if (m_solverType == SparseSolver)
+            m_sparse->solve(m_y);
+        else
+            m_banded->solve(m_y);
+
+        // Columns are permuted too, so map the solution back
+        for (uint i = 0; i < size; i++)
+            x[i] = m_y[m_inMap[i]];
+        return;
+    }
+
+    if (!m_pivot.empty()) {
+        // Put the right side in the order of the pivoted rows
+        m_pivotedY.resize(size);
+        for (uint i = 0; i < size; i++)
+            m_pivotedY[i] = m_y[m_pivot[i]];
+        std::copy(m_pivotedY.begin(), m_pivotedY.end(), m_y);
     }
 
     // Forward substitution
     for (uint i = 1; i < size; i++) {
-        double sum = 0;
-        for (unsigned int j = 0; j < i; j++) {
-            sum += (*m_lu)[i][j] * m_y[j];
-        }
-        m_y[i] -= sum;
+        m_y[i] -= QuickKernels::dot((*m_lu)[i], m_y, i);
     }
 
     // Back substitution
     m_y[size - 1] /= (*m_lu)[size - 1][size - 1];
     for (int i = size - 2; i >= 0; i--) {
-        double sum = 0;
-        for (uint j = i + 1; j < size; j++) {
-            sum += (*m_lu)[i][j] * m_y[j];
-        }
-        m_y[i] -= sum;
+        m_y[i] -= QuickKernels::dot((*m_lu)[i] + i + 1, m_y + i + 1, size - i - 1);
         m_y[i] /= (*m_lu)[i][i];
     }
 
     // I think we don't need to reverse the mapping because we only permute rows, not columns.
     for (uint i = 0; i < size; i++)
-        (*b)[i] = m_y[i];
+        x[i] = m_y[i];
+}
+
+void Matrix::multiply(const QuickVector *x, QuickVector *result)
+{
+    const unsigned int size = m_mat->size_m();
+    const double *const values = x->data();
+    double *const product = result->data();
+
+    if (m_solverType == SparseSolver) {
+        for (uint i = 0; i < size; i++)
+            product[i] = m_sparse->rowProduct(m_mat, m_inMap[i], values);
+        return;
+    }
+    if (m_solverType == BandedSolver) {
+        for (uint i = 0; i < size; i++)
+            product[i] = m_banded->rowProduct(m_mat, m_inMap[i], values);
+        return;
+    }
+
+    for (uint i = 0; i < size; i++)
+        product[i] = QuickKernels::dot((*m_mat)[m_inMap[i]], values, size);
 }
 
 void Matrix::displayLU()
 {
+    if (m_solverType == SparseSolver) {
+        m_sparse->display();
+        return;
+    }
+    if (m_solverType == BandedSolver) {
+        m_banded->display();
+        return;
+    }
+
     uint n = m_mat->size_m();
     for (uint _i = 0; _i < n; _i++) {
         uint i = m_inMap[_i];
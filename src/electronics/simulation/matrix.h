@@ -13,6 +13,14 @@
 
 #include <math/qmatrix.h>
 
+#include <QtGlobal>
+
+#include <atomic>
+#include <vector>
+
+class BandedLU;
+class SparseLU;
+
 /**
 This class performs matrix storage, lu decomposition, forward and backward
 substitution, and a few other useful operations. Steps in using class:
@@ -21,17 +29,25 @@ substitution, and a few other useful operations. Steps in using class:
     (1) Call zero (unnecessary after initial creation) to reset the pattern
         & matrix
     (2) Call setUse to set the use of each element in the matrix
-    (3) Call createMap to generate the row-wise permutation mapping for use
-        in partial pivoting
+    (3) Call createMap to choose between the dense, banded and sparse
+        solvers, and (for the banded and sparse solvers) generate the
+        ordering of the equations
 (3) Add the values to the matrix
 (4) Call performLU, and get the results with fbSub
 (5) Repeat 2, 3, 4 or 5 as necessary.
-@todo We need to allow createMap to work while the matrix has already been initialised
+
+Values that switch back and forth (such as the output conductance of a
+LogicOut) can be changed with addRankOne instead of add. performLU then keeps
+the decomposition, and fbSub corrects its solutions for the changes with the
+Woodbury identity, which costs a few forward and back substitutions rather
+than a factorization.
 @short Matrix manipulation class tailored for circuit equations
 @author David Saxton
 */
 class Matrix
 {
+    friend class MatrixTest;
+
 public:
     /**
      * Creates a size x size square matrix m, with all values zero,
@@ -40,13 +56,60 @@ public:
     Matrix(CUI n, CUI m);
     ~Matrix();
 
+    enum SolverType {
+        DenseSolver, ///< LU decomposition over the full matrix
+        SparseSolver, ///< Sparse LU over the pattern given by setUse
+        BandedSolver ///< LU decomposition over a band around the diagonal, after reordering
+    };
+
+    /**
+     * Marks the element at row i, col j as (possibly) nonzero. This is used
+     * by createMap to work out the sparsity pattern of the matrix.
+     */
+    void setUse(CUI i, CUI j);
+    /**
+     * Decides which solver to use from the pattern given by setUse. If the
+     * banded or sparse solver is picked, this computes the ordering (and
+     * for the sparse solver, the symbolic factorization), which is then
+     * reused for every performLU. Values that have already been added to the
+     * matrix are kept. The other solvers that are worth trying for the
+     * pattern are kept too, for setSolverType.
+     * @param allowSparse if false, the dense solver is always used
+     */
+    void createMap(bool allowSparse = true);
+    SolverType solverType() const
+    {
+        return m_solverType;
+    }
+    /**
+     * @return the solvers that setSolverType can switch to, starting with
+     * the one picked by createMap
+     */
+    std::vector<SolverType> availableSolvers() const;
+    /**
+     * Switches to another of the availableSolvers, moving the rows of the
+     * matrix to where it expects them. The decomposition is redone by the
+     * next performLU.
+     * @return false if the solver is not available
+     */
+    bool setSolverType(SolverType type);
+    /**
+     * Sets whether performLU keeps factorizations in its cache (see
+     * LU_CACHE_SIZE). On by default.
+     */
+    void setLUCacheEnabled(bool enabled);
+    bool isLUCacheEnabled() const
+    {
+        return m_bLUCacheEnabled;
+    }
+
     /**
      * Returns true if the matrix is changed since last calling performLU()
      * - i.e. if we do need to call performLU again.
      */
     inline bool isChanged() const
     {
-        return max_k < m_mat->size_m();
+        return max_k < m_mat->size_m() || m_bUpdatesChanged;
     }
     /**
      * Performs LU decomposition. Going along the rows,
@@ -54,11 +117,103 @@ public:
      * the previous values.
      */
     void performLU();
+    /**
+     * @return the number of times performLU has factorized the matrix, and
+     * the number of times it restored a factorization from the cache
+     * instead, since the counts were last reset.
+     */
+    unsigned long factorizationCount() const
+    {
+        return m_factorizationCount;
+    }
+    unsigned long restoredFactorizationCount() const
+    {
+        return m_restoredFactorizationCount;
+    }
+    /**
+     * @return the time spent in performLU since the counts were last reset,
+     * while timing is enabled.
+     */
+    qint64 factorizationNs() const
+    {
+        return m_factorizationNs;
+    }
+    void resetFactorizationCounts()
+    {
+        m_factorizationCount = m_restoredFactorizationCount = 0;
+        m_factorizationNs = 0;
+    }
+    /**
+     * Sets whether performLU records how long it takes in factorizationNs.
+     */
+    static void setTimingEnabled(bool enabled)
+    {
+        m_bTimingEnabled = enabled;
+    }
+    /**
+     * Sets how often performLU redoes the whole factorization, this time
+     * with partial pivoting (for the dense solver), instead of only the rows
+     * that changed: once every interval factorizations, or never if the
+     * interval is zero (the default). This stops rounding errors building up
+     * over long simulations, and estimates the condition number of the
+     * matrix, warning when it is ill-conditioned.
+     */
+    static void setRefactorInterval(unsigned interval)
+    {
+        m_refactorInterval = interval;
+    }
+    /**
+     * Sets whether large dense matrices (of at least MIXED_PRECISION_MIN_SIZE)
+     * are decomposed in single precision, which halves the memory that the
+     * decomposition goes through. fbSub then refines the solution in double
+     * precision until the residual is within REFINEMENT_TOLERANCE; a matrix
+     * for which that does not happen goes back to double precision.
+     */
+    static void setMixedPrecision(bool mixed)
+    {
+        m_bMixedPrecision = mixed;
+    }
+    /**
+     * Sets whether matrices are solved the way they were before the banded
+     * and sparse solvers, the factorization cache, rank one updates, periodic
+     * refactorization and mixed precision: always dense, refactorizing the
+     * rows that changed in double precision. Only meant for recording
+     * reference results to compare the faster solvers against. Set it before
+     * any circuit is built, as createMap looks at it.
+     */
+    static void setReferenceMode(bool reference)
+    {
+        m_bReferenceMode = reference;
+    }
+    static bool referenceMode()
+    {
+        return m_bReferenceMode;
+    }
+    /**
+     * @return the condition number estimated by the last full
+     * refactorization (zero if there has not been one), from the ratio of
+     * the largest to the smallest pivot.
+     */
+    double conditionEstimate() const
+    {
+        return m_conditionEstimate;
+    }
+    bool isIllConditioned() const
+    {
+        return m_conditionEstimate > ILL_CONDITIONED;
+    }
     /**
      * Applies the right side vector (x) to the decomposed matrix,
-     * with the solution returned in x.
+     * with the solution returned in x. This works in place, without
+     * allocating.
      */
     void fbSub(QuickVector *x);
+    /**
+     * Puts the product of the matrix (not its LU decomposition) and x in
+     * result (which must not be x), using only the entries given by setUse
+     * for a sparse matrix.
+     */
+    void multiply(const QuickVector *x, QuickVector *result);
     /**
      * Prints the LU-decomposed matrix to stdout
      */
@@ -69,23 +224,86 @@ public:
     double &g(CUI i, CUI j)
     {
         const unsigned int mapped_i = m_inMap[i];
-        if (mapped_i < max_k)
-            max_k = mapped_i;
-        if (j < max_k)
-            max_k = j;
+        setChanged(mapped_i, j);
+        return (*m_mat)[mapped_i][j];
+    }
+    /**
+     * Adds delta to the element at row i, col j. Unlike writing through g(),
+     * the decomposition is only invalidated if the value actually changes,
+     * so stamps that are often unchanged (such as the conductances of
+     * companion models and nonlinear elements) are best made with this.
+     */
+    void add(CUI i, CUI j, const double delta)
+    {
+        if (delta == 0.)
+            return;
 
-        // I think I need the next line...
-        if (max_k > 0)
-            max_k--;
+        const unsigned int mapped_i = m_inMap[i];
+        double &value = (*m_mat)[mapped_i][j];
+        const double newValue = value + delta;
+        if (newValue == value)
+            return;
 
-        return (*m_mat)[mapped_i][j];
+        setChanged(mapped_i, j);
+        value = newValue;
     }
 
+    /**
+     * Adds delta u v^T to the matrix, where u = e_ui - e_uj and
+     * v = e_vi - e_vj are made from unit vectors (an index of -1 leaving its
+     * vector out), e.g. a conductance g between cnodes a and b is
+     * addRankOne(a, b, a, b, g). While the decomposition is up to date, the
+     * change is kept as a low-rank update to it rather than marking it as
+     * needing to be redone, so this is for values that are changed often
+     * without anything else changing. Changes to the same u and v are
+     * merged, and go away when they add up to nothing (e.g. a switch that is
+     * toggled back).
+     */
+    void addRankOne(int ui, int uj, int vi, int vj, double delta);
+
     double g(CUI i, CUI j) const
     {
         return (*m_mat)[m_inMap[i]][j];
     }
 
+    /**
+     * @return where the element at row i, col j is stored, for stamping
+     * into directly (see StampKernel). This stays the same until
+     * layoutGeneration changes. Writing to it does not mark the matrix as
+     * changed; use setChangedFrom with changedFrom(i, j) for that.
+     */
+    double *entry(CUI i, CUI j)
+    {
+        return &(*m_mat)[m_inMap[i]][j];
+    }
+    /**
+     * @return the value to give setChangedFrom after changing the element at
+     * row i, col j through entry
+     */
+    unsigned int changedFrom(CUI i, CUI j) const
+    {
+        const unsigned int mapped_i = m_inMap[i];
+        return (mapped_i < j) ? mapped_i : j;
+    }
+    /**
+     * Marks the decomposition as needing to be redone from k, as given by
+     * changedFrom (the smallest of those of the elements changed).
+     */
+    void setChangedFrom(CUI k)
+    {
+        setChanged(k, k);
+    }
+    /**
+     * @return a number that changes whenever the rows of the matrix are
+     * moved about in storage (which invalidates the pointers from entry).
+     * No two matrices have the same number, so pointers into a matrix that
+     * has been deleted are not mistaken for ones into a new matrix.
+     */
+    unsigned int layoutGeneration() const
+    {
+        return m_layoutGeneration;
+    }
+
     double &b(CUI i, CUI j)
     {
         return g(i, j + m_n);
@@ -119,12 +337,216 @@ public:
         return (*m_mat)[m_inMap[i]][j];
     }
 
+    /**
+     * Matrices smaller than this are always solved densely.
+     */
+    static const unsigned int SPARSE_MIN_SIZE = 32;
+    /**
+     * The sparse solver is only used if the factorization (including fill-in)
+     * has fewer than this fraction of the elements of the full matrix.
+     */
+    static constexpr double SPARSE_MAX_DENSITY = 0.4;
+    /**
+     * Matrices smaller than this are never solved as banded.
+     */
+    static const unsigned int BANDED_MIN_SIZE = 16;
+    /**
+     * The banded solver is picked over the sparse solver while its band has
+     * at most this many times the nonzeros of the sparse factorization, as
+     * it goes through them without any indexing.
+     */
+    static constexpr double BANDED_MAX_SPARSE_RATIO = 2.0;
+    /**
+     * The dense solver is only offered by availableSolvers (once another
+     * has been picked) for matrices up to this size, above which it is not
+     * going to be the quickest.
+     */
+    static const unsigned int DENSE_MAX_TRIAL_SIZE = 128;
+    /**
+     * Number of numeric factorizations kept by performLU, so that a matrix
+     * that keeps going back to earlier values (e.g. capacitor conductances as
+     * the time step changes, or a switch being toggled) only needs to be
+     * factorized once for each.
+     */
+    static const unsigned int LU_CACHE_SIZE = 8;
+    /**
+     * The cache is only used when at least this many rows of the
+     * factorization need redoing, below which refactorizing is about as
+     * quick as hashing the matrix.
+     */
+    static const unsigned int LU_CACHE_MIN_ROWS = 8;
+    /**
+     * The most low-rank updates (see addRankOne) kept on the decomposition;
+     * beyond this (or if the updated matrix is close to singular), the
+     * decomposition is redone instead.
+     */
+    static const unsigned int MAX_RANK_ONE_UPDATES = 8;
+    /**
+     * Matrices whose estimated condition number is above this are reported
+     * as ill-conditioned.
+     */
+    static constexpr double ILL_CONDITIONED = 1e12;
+    /**
+     * Dense matrices smaller than this are always decomposed in double
+     * precision, as their decomposition fits in the cache anyway.
+     */
+    static const unsigned int MIXED_PRECISION_MIN_SIZE = 64;
+    /**
+     * The iterative refinement of a solution from a single precision
+     * decomposition stops when the largest element of the residual is at
+     * most this times |A| |x| + |b| (in the infinity norm).
+     */
+    static constexpr double REFINEMENT_TOLERANCE = 1e-13;
+    static const unsigned int MAX_REFINEMENT_STEPS = 8;
+
 private:
+    /**
+     * Marks the decomposition as needing to be redone from the element at
+     * (mapped) row i, col j.
+     */
+    void setChanged(CUI i, CUI j)
+    {
+        if (i < max_k)
+            max_k = i;
+        if (j < max_k)
+            max_k = j;
+
+        // I think I need the next line...
+        if (max_k > 0)
+            max_k--;
+    }
     /**
      * Swaps around the rows in the (a) the matrix; and (b) the mappings
      */
     void swapRows(CUI a, CUI b);
+    /**
+     * Does the work of performLU: factorizes the rows from max_k, or
+     * restores them from the cache.
+     */
+    void factorize();
+    /**
+     * Factorizes the whole matrix, with partial pivoting for the dense
+     * solver, and estimates its condition number.
+     */
+    void refactorFully();
+    /**
+     * @return whether the matrix is decomposed in single precision (see
+     * setMixedPrecision) from now on
+     */
+    bool useFloatLU() const;
+    /**
+     * Factorizes the rows from max_k in single precision, into m_floatLU.
+     */
+    void factorizeFloat();
+    /**
+     * As solveLU, with the single precision decomposition.
+     */
+    void solveFloatLU(double *x);
+    /**
+     * Solves into x (which holds the right side) with the single precision
+     * decomposition, refining the solution in double precision.
+     * @return false if the refinement did not converge
+     */
+    bool solveRefined(double *x);
+    /**
+     * Solves with the decomposition alone (without the low-rank updates),
+     * in place. x is indexed as the right side vector given to fbSub.
+     */
+    void solveLU(double *x);
+    /**
+     * Works out the small matrix that the Woodbury identity solves for the
+     * low-rank updates, and takes a copy of the updates for fbSub to use.
+     * @return false if the updated matrix is close to singular
+     */
+    bool factorUpdates();
+    /**
+     * Gives up on the low-rank updates, marking the decomposition as
+     * needing to be redone from where they changed the matrix.
+     */
+    void foldUpdates();
+    /**
+     * Copies the values of the matrix that the solver in use factorizes into
+     * values (all of them for the dense solver).
+     */
+    void luCacheKey(std::vector<double> *values) const;
+    /**
+     * @return a hash of the values, ignoring the lowest few bits of each (so
+     * that rounding in how a value was added up does not matter).
+     */
+    static quint64 valueHash(const std::vector<double> &values);
+    /**
+     * @return whether the values are the same, ignoring the bits that
+     * valueHash does.
+     */
+    static bool sameValues(const std::vector<double> &a, const std::vector<double> &b);
+    /**
+     * Restores the factorization cached for the matrix values in
+     * m_luCacheKey, which hash to the given hash, returning false if there
+     * is none.
+     */
+    bool restoreLU(quint64 hash);
+    /**
+     * Caches the current factorization, of the matrix values in
+     * m_luCacheKey, replacing the least recently used.
+     */
+    void storeLU(quint64 hash);
 
+    class CachedLU
+    {
+    public:
+        quint64 hash;
+        unsigned lastUse;
+        std::vector<double> key; ///< the values of the matrix that was factorized
+        std::vector<double> values;
+    };
+    /**
+     * A change of delta u v^T to the matrix since it was decomposed (see
+     * addRankOne).
+     */
+    class RankOneUpdate
+    {
+    public:
+        int ui, uj, vi, vj;
+        double delta;
+        std::vector<double> z; ///< The decomposition solved for u, once worked out
+    };
+    /**
+     * Marks the decomposition as needing to be redone from the entries of
+     * the matrix that the update changes.
+     */
+    void setChanged(const RankOneUpdate &update);
+
+    std::vector<RankOneUpdate> m_updates;
+    std::vector<RankOneUpdate> m_factoredUpdates; ///< those that fbSub corrects for
+    bool m_bUpdatesChanged; ///< whether m_updates has changed since factorUpdates
+    std::vector<double> m_capacitance; ///< LU of I + D V^T Z, as used by the Woodbury identity
+    std::vector<unsigned> m_capacitancePivot;
+    std::vector<double> m_updateWeights; // Avoids recreating it lots of times
+
+    std::vector<CachedLU> m_luCache;
+    std::vector<double> m_luCacheKey; // Avoids recreating it lots of times
+    unsigned m_luCacheClock;
+    bool m_bLUCacheEnabled;
+    unsigned long m_factorizationCount;
+    unsigned long m_restoredFactorizationCount;
+    qint64 m_factorizationNs;
+    static bool m_bTimingEnabled;
+    static unsigned m_refactorInterval;
+    static bool m_bMixedPrecision;
+    static bool m_bReferenceMode;
+    bool m_bFloatLU; ///< whether the decomposition is in m_floatLU rather than m_lu
+    bool m_bMixedPrecisionFailed; ///< set when refinement has not converged for this matrix
+    std::vector<float> m_floatLU; ///< the single precision decomposition, a row after another
+    double m_normA; ///< the infinity norm of the matrix when it was last decomposed in single precision
+    std::vector<double> m_rhs; // Avoids recreating it lots of times
+    std::vector<double> m_residual; // Avoids recreating it lots of times
+    unsigned m_factorizationsSinceFull;
+    double m_conditionEstimate;
+    std::vector<unsigned> m_pivot; // Row of m_lu to take each row of the LU from, if it was pivoted
+    std::vector<double> m_pivotedY; // Avoids recreating it lots of times
+
+    unsigned int m_layoutGeneration;
+    static std::atomic<unsigned> m_layoutGenerations; // The last layoutGeneration given to any matrix
     unsigned int m_n;   // number of cnodes.
     unsigned int max_k; // optimization variable, allows partial L_U re-do.
 
@@ -133,6 +555,11 @@ private:
     QuickMatrix *m_mat;
     QuickMatrix *m_lu;
     double *m_y; // Avoids recreating it lots of times
+
+    SolverType m_solverType;
+    SparseLU *m_sparse;
+    BandedLU *m_banded;
+    std::vector<std::vector<unsigned>> m_pattern; // Only used until createMap is called
 };
 
 #endif
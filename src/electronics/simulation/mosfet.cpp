@@ -130,18 +130,23 @@ void MOSFET::updateCurrents()
 
 void MOSFET::update_dc()
 {
-    if (!b_status)
-        return;
+    evaluate_dc();
+    stamp_dc();
+}
 
-    calc_eq();
+void MOSFET::evaluate_dc()
+{
+    if (b_status)
+        calc_eq();
+}
 
-    MOSFETState diff = m_ns - m_os;
-    for (unsigned i = 0; i < 4; ++i) {
-        for (unsigned j = 0; j < 4; ++j)
-            A_g(i, j) += diff.A[i][j];
+void MOSFET::stamp_dc()
+{
+    if (!b_status)
+        return;
 
-        b_i(i) += diff.I[i];
-    }
+    const MOSFETState diff = m_ns - m_os;
+    m_stamp.stamp(p_eSet, p_cnode, diff.A, diff.I);
 
     m_os = m_ns;
 }
@@ -12,6 +12,7 @@
 #define MOSFET_H
 
 #include "nonlinear.h"
+#include "stampkernel.h"
 
 class MOSFETState
 {
@@ -57,7 +58,7 @@ public:
 /**
 @author David Saxton
  */
-class MOSFET : public NonLinear
+class MOSFET final : public NonLinear
 {
 public:
     enum MOSFET_type { neMOSFET, peMOSFET /*, ndMOSFET, pdMOSFET*/ };
@@ -70,6 +71,8 @@ public:
         return Element_MOSFET;
     }
     void update_dc() override;
+    void evaluate_dc() override;
+    void stamp_dc() override;
     void add_initial_dc() override;
     MOSFETSettings settings() const
     {
@@ -93,6 +96,7 @@ protected:
     double V_lim;
     double V_GS_prev, V_GD_prev, V_BD_prev, V_DS_prev, V_BS_prev;
     MOSFETSettings m_mosfetSettings;
+    StampKernel<4> m_stamp;
 
     static const uint PinD, PinG, PinS, PinB;
 };
@@ -0,0 +1,663 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "ngspicecircuit.h"
+#include "bjt.h"
+#include "capacitance.h"
+#include "currentsignal.h"
+#include "currentsource.h"
+#include "diode.h"
+#include "element.h"
+#include "elementset.h"
+#include "inductance.h"
+#include "logic.h"
+#include "resistance.h"
+#include "simulator.h"
+#include "vccs.h"
+#include "vcvs.h"
+#include "voltagepoint.h"
+#include "voltagesignal.h"
+#include "voltagesource.h"
+
+#include <math/qvector.h>
+
+#include <QLibrary>
+
+#include <ktechlab_debug.h>
+
+#include <algorithm>
+#include <climits>
+
+// BEGIN ngspice API
+// The parts of sharedspice.h that are used here, as the library is loaded at
+// run time rather than linked against
+
+struct NgVecValues {
+    char *name;
+    double creal;
+    double cimag;
+    bool is_scale;
+    bool is_complex;
+};
+
+struct NgVecValuesAll {
+    int veccount;
+    int vecindex;
+    NgVecValues **vecsa;
+};
+
+struct NgVecInfo {
+    int number;
+    char *vecname;
+    bool is_real;
+    void *pdvec;
+    void *pdvecscale;
+};
+
+struct NgVecInfoAll {
+    char *name;
+    char *title;
+    char *date;
+    char *type;
+    int veccount;
+    NgVecInfo **vecs;
+};
+
+typedef int (*NgSendChar)(char *, int, void *);
+typedef int (*NgSendStat)(char *, int, void *);
+typedef int (*NgControlledExit)(int, bool, bool, int, void *);
+typedef int (*NgSendData)(NgVecValuesAll *, int, int, void *);
+typedef int (*NgSendInitData)(NgVecInfoAll *, int, void *);
+typedef int (*NgBGThreadRunning)(bool, int, void *);
+typedef int (*NgGetVSRCData)(double *, double, char *, int, void *);
+typedef int (*NgGetISRCData)(double *, double, char *, int, void *);
+typedef int (*NgGetSyncData)(double, double *, double, int, int, int, void *);
+
+typedef int (*NgSpiceInit)(NgSendChar, NgSendStat, NgControlledExit, NgSendData, NgSendInitData, NgBGThreadRunning, void *);
+typedef int (*NgSpiceInitSync)(NgGetVSRCData, NgGetISRCData, NgGetSyncData, int *, void *);
+typedef int (*NgSpiceCommand)(char *);
+typedef int (*NgSpiceCirc)(char **);
+typedef bool (*NgSpiceSetBkpt)(double);
+// END ngspice API
+
+/// Linear updates after which the analysis is started again, so that the
+/// points that ngspice keeps of it do not grow without end
+static const int RESTART_STEPS = 1000;
+
+/// How long to wait for ngspice to get through a linear update before giving up on it
+static const int STEP_TIMEOUT_MS = 10000;
+
+/// How close to the time asked for a point has to be, to be the point at that time
+static const double TIME_TOLERANCE = 1e-6 * LINEAR_UPDATE_PERIOD;
+
+static QString s_libraryFileName;
+static int s_minEquations = 500;
+static QLibrary *s_library = nullptr;
+static NgSpiceCommand s_command = nullptr;
+static NgSpiceCirc s_circ = nullptr;
+static NgSpiceSetBkpt s_setBkpt = nullptr;
+static NgspiceCircuit *s_active = nullptr; // The circuit that ngspice is solving
+
+static QByteArray number(double value)
+{
+    return QByteArray::number(value, 'g', 17);
+}
+
+static QByteArray nodeName(CNode *cnode)
+{
+    return cnode->isGround ? QByteArray("0") : "n" + QByteArray::number(cnode->n());
+}
+
+/**
+ * @return the name of the ngspice vector in the form used for m_solutionIndex,
+ * whether it is given as a node or branch name or as "v(node)" or "i(source)"
+ */
+static QByteArray vectorName(const char *name)
+{
+    QByteArray vector = QByteArray(name).toLower();
+    if (vector.startsWith("v(") && vector.endsWith(')'))
+        return vector.mid(2, vector.size() - 3);
+    if (vector.startsWith("i(") && vector.endsWith(')'))
+        return vector.mid(2, vector.size() - 3) + "#branch";
+    return vector;
+}
+
+// BEGIN class NgspiceCircuit
+NgspiceCircuit::NgspiceCircuit(ElementSet *elementSet, const ElementList &elements)
+    : m_elementSet(elementSet)
+    , m_elements(elements)
+    , m_targetTime(0.)
+    , m_steps(0)
+    , m_bLoaded(false)
+    , m_bRunning(false)
+    , m_bHalting(false)
+    , m_bFailed(false)
+{
+}
+
+NgspiceCircuit::~NgspiceCircuit()
+{
+    halt();
+    if (s_active == this)
+        s_active = nullptr;
+}
+
+void NgspiceCircuit::setLibrary(const QString &fileName)
+{
+    // The library cannot be unloaded once it has been started, so a change
+    // of file name only applies from the next run of KTechLab
+    s_libraryFileName = fileName;
+}
+
+void NgspiceCircuit::setMinEquations(int count)
+{
+    s_minEquations = count;
+}
+
+bool NgspiceCircuit::loadLibrary()
+{
+    if (s_library)
+        return s_command;
+
+    s_library = new QLibrary(s_libraryFileName);
+    if (!s_library->load()) {
+        qCWarning(KTL_LOG) << "could not load the ngspice library" << s_libraryFileName << ":" << s_library->errorString();
+        return false;
+    }
+
+    NgSpiceInit init = reinterpret_cast<NgSpiceInit>(s_library->resolve("ngSpice_Init"));
+    NgSpiceInitSync initSync = reinterpret_cast<NgSpiceInitSync>(s_library->resolve("ngSpice_Init_Sync"));
+    NgSpiceCommand command = reinterpret_cast<NgSpiceCommand>(s_library->resolve("ngSpice_Command"));
+    s_circ = reinterpret_cast<NgSpiceCirc>(s_library->resolve("ngSpice_Circ"));
+    s_setBkpt = reinterpret_cast<NgSpiceSetBkpt>(s_library->resolve("ngSpice_SetBkpt"));
+    if (!init || !initSync || !command || !s_circ || !s_setBkpt) {
+        qCWarning(KTL_LOG) << s_libraryFileName << "is missing functions of the ngspice shared library API";
+        return false;
+    }
+
+    init(sendChar, sendStat, controlledExit, sendData, sendInitData, bgThreadRunning, nullptr);
+    int id = 0;
+    initSync(getVSourceData, getISourceData, nullptr, &id, nullptr);
+
+    s_command = command;
+    return true;
+}
+
+NgspiceCircuit *NgspiceCircuit::create(ElementSet *elementSet, const ElementList &elements)
+{
+    if (s_libraryFileName.isEmpty() || s_active)
+        return nullptr;
+
+    if (elementSet->cnodeCount() + elementSet->cbranchCount() < s_minEquations)
+        return nullptr;
+
+    if (!loadLibrary())
+        return nullptr;
+
+    NgspiceCircuit *circuit = new NgspiceCircuit(elementSet, elements);
+    if (!circuit->writeNetlist() || !circuit->start()) {
+        delete circuit;
+        return nullptr;
+    }
+    return circuit;
+}
+
+bool NgspiceCircuit::writeNetlist()
+{
+    m_netlist.clear();
+    m_sources.clear();
+    m_sourceIndex.clear();
+    m_solutionIndex.clear();
+
+    const QuickVector &x = *m_elementSet->x();
+    const int cnodeCount = m_elementSet->cnodeCount();
+
+    // The branch currents that ngspice does not have are kept as they are
+    m_solution.assign(x.size(), 0.);
+    for (unsigned i = 0; i < x.size(); ++i)
+        m_solution[i] = x[i];
+
+    for (int i = 0; i < cnodeCount; ++i)
+        m_solutionIndex.insert("n" + QByteArray::number(i), i);
+
+    auto voltage = [&x](CNode *cnode) {
+        return cnode->isGround ? 0. : x[cnode->n()];
+    };
+    auto addSource = [this](const QByteArray &name, Element *element, int part) {
+        m_sourceIndex.insert(name, int(m_sources.size()));
+        m_sources.push_back({element, part});
+    };
+    auto addBranch = [this, cnodeCount](const QByteArray &name, Element *element, bool reversed) {
+        const int position = cnodeCount + element->cbranch(0)->n();
+        m_solutionIndex.insert(name + "#branch", reversed ? (-1 - position) : position);
+    };
+
+    QList<QByteArray> models;
+    m_netlist << "* KTechLab circuit";
+
+    const int elementCount = m_elements.size();
+    for (int i = 0; i < elementCount; ++i) {
+        Element *element = m_elements[i];
+        if (!element->isActive())
+            continue;
+
+        const QByteArray id = QByteArray::number(i);
+        const QByteArray n0 = (element->numCNodes() > 0) ? nodeName(element->cnode(0)) : QByteArray();
+        const QByteArray n1 = (element->numCNodes() > 1) ? nodeName(element->cnode(1)) : QByteArray();
+
+        switch (element->type()) {
+        case Element::Element_Resistance: {
+            // A resistance of no conductance is left open
+            const double g = static_cast<Resistance *>(element)->conductance();
+            if (g != 0.)
+                m_netlist << "r" + id + ' ' + n0 + ' ' + n1 + ' ' + number(1. / g);
+            break;
+        }
+
+        case Element::Element_Capacitance: {
+            const double c = static_cast<Capacitance *>(element)->capacitance();
+            const double v = voltage(element->cnode(0)) - voltage(element->cnode(1));
+            m_netlist << "c" + id + ' ' + n0 + ' ' + n1 + ' ' + number(c) + " ic=" + number(v);
+            break;
+        }
+
+        case Element::Element_Inductance: {
+            const double l = static_cast<Inductance *>(element)->inductance();
+            const double current = x[cnodeCount + element->cbranch(0)->n()];
+            m_netlist << "l" + id + ' ' + n0 + ' ' + n1 + ' ' + number(l) + " ic=" + number(current);
+            addBranch("l" + id, element, false);
+            break;
+        }
+
+        case Element::Element_VoltageSource:
+        case Element::Element_VoltageSignal: {
+            m_netlist << "v" + id + ' ' + n1 + ' ' + n0 + " dc 0 external";
+            addSource("v" + id, element, 0);
+            addBranch("v" + id, element, false);
+            break;
+        }
+
+        case Element::Element_VoltagePoint: {
+            m_netlist << "v" + id + ' ' + n0 + " 0 dc 0 external";
+            addSource("v" + id, element, 0);
+            addBranch("v" + id, element, true);
+            break;
+        }
+
+        case Element::Element_CurrentSource:
+        case Element::Element_CurrentSignal: {
+            m_netlist << "i" + id + ' ' + n0 + ' ' + n1 + " dc 0 external";
+            addSource("i" + id, element, 0);
+            break;
+        }
+
+        case Element::Element_LogicIn: {
+            // Infinite impedance, so nothing to write
+            break;
+        }
+
+        case Element::Element_LogicOut: {
+            // A conductance and voltage that change with the output, so it is
+            // a behavioural source driven by a node for each
+            const QByteArray vNode = "lv" + id;
+            const QByteArray gNode = "lg" + id;
+            m_netlist << "v" + id + "v " + vNode + " 0 dc 0 external";
+            m_netlist << "v" + id + "g " + gNode + " 0 dc 0 external";
+            m_netlist << "b" + id + ' ' + n0 + " 0 i=(v(" + n0 + ")-v(" + vNode + "))*v(" + gNode + ')';
+            addSource("v" + id + 'v', element, 0);
+            addSource("v" + id + 'g', element, 1);
+            break;
+        }
+
+        case Element::Element_VCVS: {
+            const QByteArray n2 = nodeName(element->cnode(2));
+            const QByteArray n3 = nodeName(element->cnode(3));
+            m_netlist << "e" + id + ' ' + n3 + ' ' + n2 + ' ' + n1 + ' ' + n0 + ' ' + number(static_cast<VCVS *>(element)->gain());
+            addBranch("e" + id, element, true);
+            break;
+        }
+
+        case Element::Element_VCCS: {
+            const QByteArray n2 = nodeName(element->cnode(2));
+            const QByteArray n3 = nodeName(element->cnode(3));
+            m_netlist << "g" + id + ' ' + n3 + ' ' + n2 + ' ' + n0 + ' ' + n1 + ' ' + number(static_cast<VCCS *>(element)->gain());
+            break;
+        }
+
+        case Element::Element_Diode: {
+            const DiodeSettings settings = static_cast<Diode *>(element)->settings();
+            m_netlist << "d" + id + ' ' + n0 + ' ' + n1 + " dmod" + id;
+            QByteArray model = ".model dmod" + id + " d(is=" + number(settings.I_S) + " n=" + number(settings.N);
+            if (settings.V_B > 0.)
+                model += " bv=" + number(settings.V_B);
+            models << model + ')';
+            break;
+        }
+
+        case Element::Element_BJT: {
+            BJT *bjt = static_cast<BJT *>(element);
+            const BJTSettings settings = bjt->settings();
+            const QByteArray n2 = nodeName(element->cnode(2));
+            // Nodes are base, collector and emitter, and SPICE wants the collector first
+            m_netlist << "q" + id + ' ' + n1 + ' ' + n0 + ' ' + n2 + " qmod" + id;
+            models << ".model qmod" + id + (bjt->isNPN() ? " npn(is=" : " pnp(is=") + number(settings.I_S) + " nf=" + number(settings.N_F) + " nr=" + number(settings.N_R) + " bf=" + number(settings.B_F) + " br=" + number(settings.B_R) + ')';
+            break;
+        }
+
+        default:
+            // E.g. the op-amp and the FETs, which have no SPICE counterpart
+            // with the same model
+            return false;
+        }
+    }
+
+    m_netlist << models;
+
+    for (int i = 0; i < cnodeCount; ++i)
+        m_netlist << ".ic v(n" + QByteArray::number(i) + ")=" + number(x[i]);
+
+    // The analysis runs a little past the last step before the restart, and
+    // never steps over more than a linear update
+    const double stopTime = (RESTART_STEPS + 2) * LINEAR_UPDATE_PERIOD;
+    m_netlist << ".tran " + number(LINEAR_UPDATE_PERIOD) + ' ' + number(stopTime) + " 0 " + number(LINEAR_UPDATE_PERIOD) + " uic";
+    m_netlist << ".end";
+
+    m_netlistValues = netlistValues();
+    m_sourceValues.assign(m_sources.size(), 0.);
+    return true;
+}
+
+std::vector<double> NgspiceCircuit::netlistValues() const
+{
+    std::vector<double> values;
+    values.reserve(m_elements.size());
+
+    for (Element *element : m_elements) {
+        values.push_back(element->isActive() ? 1. : 0.);
+
+        switch (element->type()) {
+        case Element::Element_Resistance:
+            values.push_back(static_cast<Resistance *>(element)->conductance());
+            break;
+        case Element::Element_Capacitance:
+            values.push_back(static_cast<Capacitance *>(element)->capacitance());
+            break;
+        case Element::Element_Inductance:
+            values.push_back(static_cast<Inductance *>(element)->inductance());
+            break;
+        case Element::Element_VCVS:
+            values.push_back(static_cast<VCVS *>(element)->gain());
+            break;
+        case Element::Element_VCCS:
+            values.push_back(static_cast<VCCS *>(element)->gain());
+            break;
+        case Element::Element_Diode: {
+            const DiodeSettings settings = static_cast<Diode *>(element)->settings();
+            values.insert(values.end(), {settings.I_S, settings.N, settings.V_B});
+            break;
+        }
+        case Element::Element_BJT: {
+            const BJTSettings settings = static_cast<BJT *>(element)->settings();
+            values.insert(values.end(), {settings.I_S, settings.N_F, settings.N_R, settings.B_F, settings.B_R});
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return values;
+}
+
+void NgspiceCircuit::updateSources()
+{
+    const size_t count = m_sources.size();
+    for (size_t i = 0; i < count; ++i) {
+        Element *element = m_sources[i].element;
+        double value = 0.;
+
+        switch (element->type()) {
+        case Element::Element_VoltageSource:
+            value = static_cast<VoltageSource *>(element)->voltage();
+            break;
+        case Element::Element_VoltagePoint:
+            // VoltagePoint keeps its voltage negated
+            value = -static_cast<VoltagePoint *>(element)->voltage();
+            break;
+        case Element::Element_VoltageSignal:
+            value = static_cast<VoltageSignal *>(element)->outputVoltage();
+            break;
+        case Element::Element_CurrentSource:
+            value = static_cast<CurrentSource *>(element)->current();
+            break;
+        case Element::Element_CurrentSignal:
+            value = static_cast<CurrentSignal *>(element)->outputCurrent();
+            break;
+        case Element::Element_LogicOut: {
+            LogicOut *logicOut = static_cast<LogicOut *>(element);
+            value = (m_sources[i].part == 0) ? logicOut->outputVoltage() : logicOut->outputConductance();
+            break;
+        }
+        default:
+            break;
+        }
+
+        m_sourceValues[i] = value;
+    }
+}
+
+bool NgspiceCircuit::start()
+{
+    s_active = this;
+
+    m_targetTime = 0.;
+    m_steps = 0;
+    m_bFailed = false;
+    m_bHalting = false;
+    m_reached.acquire(m_reached.available());
+    m_proceed.acquire(m_proceed.available());
+    m_stopped.acquire(m_stopped.available());
+
+    updateSources();
+
+    // ngSpice_Circ takes the lines as a null terminated array
+    std::vector<char *> lines;
+    lines.reserve(m_netlist.size() + 1);
+    for (QByteArray &line : m_netlist)
+        lines.push_back(line.data());
+    lines.push_back(nullptr);
+
+    if (s_circ(lines.data()) != 0 || m_bFailed) {
+        qCWarning(KTL_LOG) << "ngspice could not load the netlist of the circuit";
+        return false;
+    }
+    m_bLoaded = true;
+
+    m_bRunning = true;
+    s_command(const_cast<char *>("bg_run"));
+
+    // The point at the start of the analysis
+    if (!m_reached.tryAcquire(1, STEP_TIMEOUT_MS) || m_bFailed || !m_bRunning) {
+        qCWarning(KTL_LOG) << "ngspice could not start the analysis of the circuit";
+        halt();
+        return false;
+    }
+    return true;
+}
+
+void NgspiceCircuit::halt()
+{
+    if (m_bRunning) {
+        // The background thread is waiting in sendData for the next step
+        m_bHalting = true;
+        m_proceed.release();
+        s_command(const_cast<char *>("bg_halt"));
+        if (!m_stopped.tryAcquire(1, STEP_TIMEOUT_MS))
+            qCWarning(KTL_LOG) << "ngspice did not halt the analysis";
+        m_bRunning = false;
+    }
+
+    if (m_bLoaded) {
+        s_command(const_cast<char *>("remcirc"));
+        m_bLoaded = false;
+    }
+}
+
+bool NgspiceCircuit::restart()
+{
+    halt();
+    return writeNetlist() && start();
+}
+
+bool NgspiceCircuit::step()
+{
+    if (m_bFailed || !m_bRunning)
+        return false;
+
+    if (++m_steps > RESTART_STEPS || netlistValues() != m_netlistValues) {
+        if (!restart())
+            return false;
+        m_steps = 1;
+    }
+
+    // ngspice is waiting in sendData, so does not read the sources meanwhile
+    updateSources();
+    m_targetTime += LINEAR_UPDATE_PERIOD;
+    s_setBkpt(m_targetTime);
+    m_proceed.release();
+
+    if (!m_reached.tryAcquire(1, STEP_TIMEOUT_MS) || m_bFailed || !m_bRunning) {
+        qCWarning(KTL_LOG) << "ngspice failed to solve the circuit";
+        m_bFailed = true;
+        halt();
+        return false;
+    }
+
+    QuickVector *x = m_elementSet->x();
+    const size_t size = m_solution.size();
+    for (size_t i = 0; i < size; ++i)
+        (*x)[i] = m_solution[i];
+    m_elementSet->updateInfo();
+    return true;
+}
+
+int NgspiceCircuit::sendChar(char *output, int id, void *user)
+{
+    Q_UNUSED(id);
+    Q_UNUSED(user);
+    qCDebug(KTL_LOG) << "ngspice:" << output;
+    return 0;
+}
+
+int NgspiceCircuit::sendStat(char *status, int id, void *user)
+{
+    Q_UNUSED(status);
+    Q_UNUSED(id);
+    Q_UNUSED(user);
+    return 0;
+}
+
+int NgspiceCircuit::controlledExit(int status, bool unload, bool quit, int id, void *user)
+{
+    Q_UNUSED(unload);
+    Q_UNUSED(quit);
+    Q_UNUSED(id);
+    Q_UNUSED(user);
+    qCWarning(KTL_LOG) << "ngspice stopped with status" << status;
+
+    if (NgspiceCircuit *circuit = s_active) {
+        circuit->m_bFailed = true;
+        circuit->m_reached.release();
+    }
+    return 0;
+}
+
+int NgspiceCircuit::sendData(NgVecValuesAll *values, int count, int id, void *user)
+{
+    Q_UNUSED(count);
+    Q_UNUSED(id);
+    Q_UNUSED(user);
+
+    NgspiceCircuit *circuit = s_active;
+    if (!circuit || circuit->m_bHalting)
+        return 0;
+
+    double time = 0.;
+    for (int k = 0; k < values->veccount; ++k) {
+        if (values->vecsa[k]->is_scale)
+            time = values->vecsa[k]->creal;
+    }
+    if (time < circuit->m_targetTime - TIME_TOLERANCE)
+        return 0;
+
+    const int slotCount = std::min<int>(values->veccount, circuit->m_vectorSlots.size());
+    for (int k = 0; k < slotCount; ++k) {
+        const int slot = circuit->m_vectorSlots[k];
+        if (slot == INT_MIN)
+            continue;
+        if (slot >= 0)
+            circuit->m_solution[slot] = values->vecsa[k]->creal;
+        else
+            circuit->m_solution[-1 - slot] = -values->vecsa[k]->creal;
+    }
+
+    // Hold the analysis here until the next step
+    circuit->m_reached.release();
+    circuit->m_proceed.acquire();
+    return 0;
+}
+
+int NgspiceCircuit::sendInitData(NgVecInfoAll *info, int id, void *user)
+{
+    Q_UNUSED(id);
+    Q_UNUSED(user);
+
+    NgspiceCircuit *circuit = s_active;
+    if (!circuit)
+        return 0;
+
+    circuit->m_vectorSlots.assign(info->veccount, INT_MIN);
+    for (int k = 0; k < info->veccount; ++k)
+        circuit->m_vectorSlots[k] = circuit->m_solutionIndex.value(vectorName(info->vecs[k]->vecname), INT_MIN);
+    return 0;
+}
+
+int NgspiceCircuit::bgThreadRunning(bool notRunning, int id, void *user)
+{
+    Q_UNUSED(id);
+    Q_UNUSED(user);
+
+    NgspiceCircuit *circuit = s_active;
+    if (!circuit || !notRunning)
+        return 0;
+
+    // Also wakes a step that is waiting for a point that will not come
+    circuit->m_bRunning = false;
+    circuit->m_stopped.release();
+    circuit->m_reached.release();
+    return 0;
+}
+
+int NgspiceCircuit::getVSourceData(double *value, double time, char *name, int id, void *user)
+{
+    Q_UNUSED(time);
+    Q_UNUSED(id);
+    Q_UNUSED(user);
+
+    NgspiceCircuit *circuit = s_active;
+    const int index = circuit ? circuit->m_sourceIndex.value(QByteArray(name).toLower(), -1) : -1;
+    *value = (index >= 0) ? circuit->m_sourceValues[index] : 0.;
+    return 0;
+}
+
+int NgspiceCircuit::getISourceData(double *value, double time, char *name, int id, void *user)
+{
+    return getVSourceData(value, time, name, id, user);
+}
+// END class NgspiceCircuit
@@ -0,0 +1,171 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef NGSPICECIRCUIT_H
+#define NGSPICECIRCUIT_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QSemaphore>
+#include <QString>
+
+#include <atomic>
+#include <vector>
+
+class Element;
+class ElementSet;
+typedef QList<Element *> ElementList;
+struct NgVecInfoAll;
+struct NgVecValuesAll;
+
+/**
+Solves a circuit with ngspice rather than with its ElementSet, for large
+analog circuits where a production SPICE engine is much quicker than the
+built-in solver. The ngspice shared library is loaded at run time (see
+setLibrary), so KTechLab does not depend on it being installed.
+
+The elements of the circuit are written out as a netlist, and ngspice runs a
+transient analysis of it in its background thread. The analysis is held at
+the end of each linear update until step is called for the next one, so that
+it goes in lock-step with the logic and the processors of the Simulator. The
+sources whose values can change (voltage and current sources, signals and
+LogicOuts) are EXTERNAL sources of ngspice, and are given their values at the
+start of each step; a change to a LogicOut is seen by ngspice from the next
+linear update on.
+
+The library holds a single simulation, so only one circuit at a time is
+solved by ngspice. A change to a value that is written into the netlist
+(e.g. a resistance) starts the analysis again from the present solution, as
+does running for a while, so that ngspice does not keep every point of a
+long run in memory.
+
+@short Solves a Circuit with ngspice
+*/
+class NgspiceCircuit
+{
+public:
+    ~NgspiceCircuit();
+
+    /**
+     * Sets the file name of the ngspice shared library (e.g. libngspice.so),
+     * which is loaded the first time it is needed. An empty file name turns
+     * solving with ngspice off.
+     */
+    static void setLibrary(const QString &fileName);
+    /**
+     * Sets the number of equations (nodes and branches) from which circuits
+     * are solved by ngspice.
+     */
+    static void setMinEquations(int count);
+    /**
+     * Writes the netlist of the elements and starts ngspice on it, from the
+     * present solution in the element set.
+     * @return the circuit, or null if ngspice is not to be used for it: it
+     * is turned off or could not be loaded, the circuit is too small, it has
+     * elements that cannot be written as a netlist, or another circuit is
+     * already being solved by ngspice
+     */
+    static NgspiceCircuit *create(ElementSet *elementSet, const ElementList &elements);
+
+    /**
+     * Runs ngspice over the next linear update, and puts the solution into
+     * the element set (see ElementSet::updateInfo).
+     * @return false if ngspice failed, in which case the circuit should go
+     * back to being solved by its element set
+     */
+    bool step();
+    /**
+     * Starts the analysis again from the solution in the element set, e.g.
+     * after it has been restored.
+     */
+    bool restart();
+
+protected:
+    NgspiceCircuit(ElementSet *elementSet, const ElementList &elements);
+
+    /**
+     * An EXTERNAL source of the netlist, and the element its value comes from.
+     */
+    class Source
+    {
+    public:
+        Element *element;
+        int part; // For LogicOuts: 0 for the voltage, 1 for the conductance
+    };
+
+    /**
+     * Loads the library and hands it the callbacks, if not done already.
+     * @return false if it could not be loaded
+     */
+    static bool loadLibrary();
+
+    /**
+     * Writes the netlist, with the nodes starting from the solution in the
+     * element set.
+     * @return false if there is an element that cannot be written
+     */
+    bool writeNetlist();
+    /**
+     * @return the values written into the netlist (rather than given as
+     * EXTERNAL sources), for noticing when they change
+     */
+    std::vector<double> netlistValues() const;
+    /**
+     * Reads the values of the EXTERNAL sources from their elements.
+     */
+    void updateSources();
+    /**
+     * Loads the netlist into ngspice and starts the analysis, waiting for
+     * the first point.
+     */
+    bool start();
+    /**
+     * Halts the analysis, if it is running.
+     */
+    void halt();
+
+    // Called by ngspice, from its background thread apart from the first
+    static int sendChar(char *output, int id, void *user);
+    static int sendStat(char *status, int id, void *user);
+    static int controlledExit(int status, bool unload, bool quit, int id, void *user);
+    static int sendData(NgVecValuesAll *values, int count, int id, void *user);
+    static int sendInitData(NgVecInfoAll *info, int id, void *user);
+    static int bgThreadRunning(bool notRunning, int id, void *user);
+    static int getVSourceData(double *value, double time, char *name, int id, void *user);
+    static int getISourceData(double *value, double time, char *name, int id, void *user);
+
+    ElementSet *m_elementSet;
+    ElementList m_elements;
+    QList<QByteArray> m_netlist;
+    std::vector<double> m_netlistValues;
+
+    std::vector<Source> m_sources;
+    QHash<QByteArray, int> m_sourceIndex; // By the name of the source in the netlist
+    std::vector<double> m_sourceValues;
+
+    // The position in the x vector by the name of the ngspice vector, or
+    // -1 - the position for a branch current that ngspice has the other way
+    QHash<QByteArray, int> m_solutionIndex;
+    std::vector<int> m_vectorSlots; // m_solutionIndex of each vector sent by ngspice, or INT_MIN for those not wanted
+    std::vector<double> m_solution;
+
+    double m_targetTime; // The time of the analysis that the next point is wanted at
+    int m_steps;         // The steps done since the analysis was started
+    bool m_bLoaded;      // Whether the netlist is loaded into ngspice
+    std::atomic<bool> m_bRunning;
+    std::atomic<bool> m_bHalting;
+    std::atomic<bool> m_bFailed;
+    QSemaphore m_reached; // Released by ngspice once it has got to m_targetTime
+    QSemaphore m_proceed; // Released to let ngspice carry on to the next m_targetTime
+    QSemaphore m_stopped; // Released by ngspice once the background thread has ended
+};
+
+#endif
@@ -23,15 +23,12 @@ NonLinear::NonLinear()
 {
 }
 
-double NonLinear::diodeCurrent(double v, double I_S, double N) const
-{
-    return I_S * (exp(std::min<double>(v / (N * V_T), KTL_MAX_EXPONENT)) - 1);
-}
-
-double NonLinear::diodeConductance(double v, double I_S, double N) const
+void NonLinear::diodeCurrentConductance(double v, double I_S, double N, double *I, double *g) const
 {
     double Vt = V_T * N;
-    return I_S * exp(std::min<double>(v / Vt, KTL_MAX_EXPONENT)) / Vt;
+    double e = I_S * exp(std::min<double>(v / Vt, KTL_MAX_EXPONENT));
+    *I = e - I_S;
+    *g = e / Vt;
 }
 
 double NonLinear::diodeVoltage(double V, double V_prev, double N, double V_lim) const
@@ -73,11 +70,8 @@ void NonLinear::diodeJunction(double V, double I_S, double N, double *I, double
         a = a * a * a;
         *I = -I_S * (1 + a);
         *g = +I_S * 3 * a / V;
-    } else {
-        double e = exp(std::min<double>(V / Vt, KTL_MAX_EXPONENT));
-        *I = I_S * (e - 1);
-        *g = I_S * e / Vt;
-    }
+    } else
+        diodeCurrentConductance(V, I_S, N, I, g);
 }
 
 double NonLinear::fetVoltage(double V, double V_prev, double Vth) const
@@ -163,11 +157,8 @@ void NonLinear::mosDiodeJunction(double V, double I_S, double N, double *I, doub
     if (V <= 0) {
         *g = I_S / Vt;
         *I = *g * V;
-    } else {
-        double e = exp(std::min<double>(V / Vt, KTL_MAX_EXPONENT));
-        *I = I_S * (e - 1);
-        *g = I_S * e / Vt;
-    }
+    } else
+        diodeCurrentConductance(V, I_S, N, I, g);
 
     *I += V * I_S;
     *g += I_S;
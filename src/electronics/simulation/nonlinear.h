@@ -30,17 +30,24 @@ public:
      * Newton-Raphson iteration: Update equation system.
      */
     virtual void update_dc() = 0;
-
-protected:
     /**
-     * The diode current.
+     * The first half of update_dc: works out the new conductances and
+     * currents from the node voltages. This only writes to the element's own
+     * state, so different elements can be evaluated from different threads.
+     */
+    virtual void evaluate_dc() = 0;
+    /**
+     * The second half of update_dc: stamps the change worked out by
+     * evaluate_dc into the matrix and right side vector.
      */
-    double diodeCurrent(double v, double I_S, double N) const;
+    virtual void stamp_dc() = 0;
+
+protected:
     /**
-     * Conductance of the diode - the derivative of Schockley's
-     * approximation.
+     * The diode current from Schockley's approximation, and the conductance
+     * (its derivative), which share the one exponential.
      */
-    double diodeConductance(double v, double I_S, double N) const;
+    void diodeCurrentConductance(double v, double I_S, double N, double *I, double *g) const;
     /**
      * Limits the diode voltage to prevent divergence in the nonlinear
      * iterations.
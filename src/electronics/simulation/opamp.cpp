@@ -11,30 +11,131 @@
 #include "opamp.h"
 #include "elementset.h"
 
+#include <QDataStream>
+
 OpAmp::OpAmp()
     : Element::Element()
 {
     m_numCBranches = 1;
     m_numCNodes = 3;
+    m_region = Linear;
+    m_outputLow = -15.;
+    m_outputHigh = 15.;
 }
 
 OpAmp::~OpAmp()
 {
 }
 
+void OpAmp::setOutputLimits(double low, double high)
+{
+    m_outputLow = low;
+    m_outputHigh = high;
+
+    // Solve the circuit again, as the op-amp may now be in another region
+    stampOutputVoltage();
+    if (p_eSet)
+        p_eSet->setCacheInvalidated();
+}
+
 void OpAmp::add_initial_dc()
 {
+    m_region = Linear;
+
     if (!b_status)
         return;
 
     // Non-inverting input
-    A_c(0, 0) = 1;
+    stampC(0, 0, 1);
 
     // Inverting input
-    A_c(0, 2) = -1;
+    stampC(0, 2, -1);
 
     // Output
     A_b(1, 0) = 1;
+
+    stampOutputVoltage();
+}
+
+void OpAmp::setRegion(Region region)
+{
+    if (region == m_region)
+        return;
+
+    // The output branch is V+ - V- = 0 when linear, and Vout = rail when saturated
+    const double linear = ((region == Linear) ? 1. : 0.) - ((m_region == Linear) ? 1. : 0.);
+    m_region = region;
+
+    if (!b_status)
+        return;
+
+    stampC(0, 0, linear);
+    stampC(0, 2, -linear);
+    stampC(0, 1, -linear);
+    stampOutputVoltage();
+}
+
+void OpAmp::stampOutputVoltage()
+{
+    if (!b_status)
+        return;
+
+    switch (m_region) {
+    case Linear:
+        b_v(0) = 0.;
+        break;
+    case SaturatedHigh:
+        b_v(0) = m_outputHigh;
+        break;
+    case SaturatedLow:
+        b_v(0) = m_outputLow;
+        break;
+    }
+}
+
+bool OpAmp::updateRegion()
+{
+    if (!b_status)
+        return false;
+
+    const double V_out = p_cnode[1]->v;
+    const double V_in = p_cnode[0]->v - p_cnode[2]->v;
+
+    Region region = m_region;
+    switch (m_region) {
+    case Linear:
+        if (V_out > m_outputHigh)
+            region = SaturatedHigh;
+        else if (V_out < m_outputLow)
+            region = SaturatedLow;
+        break;
+    case SaturatedHigh:
+        if (V_in < 0.)
+            region = Linear;
+        break;
+    case SaturatedLow:
+        if (V_in > 0.)
+            region = Linear;
+        break;
+    }
+
+    if (region == m_region)
+        return false;
+
+    setRegion(region);
+    return true;
+}
+
+void OpAmp::saveState(QDataStream &stream) const
+{
+    stream << qint8(m_region);
+}
+
+void OpAmp::restoreState(QDataStream &stream)
+{
+    qint8 region;
+    stream >> region;
+    setRegion(Region(region));
 }
 
 void OpAmp::updateCurrents()
@@ -17,11 +17,19 @@
 node 0: non-inverting input
 node 1: output
 node 2: inverting input
+
+An ideal op-amp whose output is limited to lie between two rails. It is
+piecewise linear: within the rails the output branch holds the inputs at the
+same voltage, and in saturation it holds the output at the rail. The circuit
+stays linear, with ElementSet calling updateRegion after each solve and
+solving again if the op-amp has moved into another region.
 @author David Saxton
 */
 class OpAmp : public Element
 {
 public:
+    enum Region { Linear, SaturatedHigh, SaturatedLow };
+
     OpAmp();
     ~OpAmp() override;
 
@@ -29,10 +37,41 @@ public:
     {
         return Element_OpAmp;
     }
+    /**
+     * Sets the voltages that the output saturates at.
+     */
+    void setOutputLimits(double low, double high);
+    Region region() const
+    {
+        return m_region;
+    }
+    /**
+     * Moves the op-amp into the region that the nodal voltages of the last
+     * solve call for: out of the linear region when the output is beyond a
+     * rail, and back into it when the inputs would drive the output away
+     * from the rail it is saturated at.
+     * @return whether the region changed, so that the circuit has to be
+     * solved again
+     */
+    bool updateRegion();
+    void saveState(QDataStream &stream) const override;
+    void restoreState(QDataStream &stream) override;
 
 protected:
     void updateCurrents() override;
     void add_initial_dc() override;
+    /**
+     * Restamps the output branch for the region.
+     */
+    void setRegion(Region region);
+    /**
+     * Puts the voltage that the output branch holds in the region into b.
+     */
+    void stampOutputVoltage();
+
+    Region m_region;
+    double m_outputLow;
+    double m_outputHigh;
 };
 
 #endif
@@ -0,0 +1,399 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "pwlwaveform.h"
+
+#include <QRegularExpression>
+#include <QStringList>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+PwlWaveform::PwlWaveform()
+    : m_map(nullptr)
+    , m_data(nullptr)
+    , m_dataSize(0)
+    , m_chunkOffset(0)
+    , m_pos(0)
+    , m_p0({0., 0.})
+    , m_p1({0., 0.})
+    , m_atStart(true)
+    , m_atEnd(true)
+    , m_isVcd(false)
+    , m_vcdTimescale(1.)
+    , m_vcdTime(0.)
+    , m_vcdPending({0., 0.})
+    , m_hasVcdPending(false)
+{
+}
+
+PwlWaveform::~PwlWaveform()
+{
+    if (m_map)
+        m_file.unmap(m_map);
+}
+
+bool PwlWaveform::open(const QString &fileName, const QString &signal)
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+    m_file.close();
+    m_file.setFileName(fileName);
+    m_signal = signal.toUtf8();
+
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    if (!rewind()) {
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+bool PwlWaveform::rewind()
+{
+    m_atStart = true;
+    m_atEnd = true;
+    m_tokens.clear();
+    if (!loadChunk(0, CHUNK_SIZE))
+        return false;
+
+    // A value change dump starts with its header, of commands such as
+    // $date or $timescale
+    m_isVcd = false;
+    QByteArray line;
+    while (readLine(&line)) {
+        line = line.trimmed();
+        if (line.isEmpty())
+            continue;
+        m_isVcd = line.startsWith('$');
+        break;
+    }
+    if (!loadChunk(0, CHUNK_SIZE))
+        return false;
+
+    if (m_isVcd) {
+        m_vcdTime = 0.;
+        m_hasVcdPending = false;
+        if (!readVcdHeader())
+            return false;
+    }
+
+    m_p1.time = -std::numeric_limits<double>::infinity();
+    if (!readPoint(m_p0)) {
+        m_p0 = m_p1 = {0., 0.};
+        return false;
+    }
+
+    m_p1 = m_p0;
+    Point p;
+    if (readPoint(p)) {
+        m_p1 = p;
+        m_atEnd = false;
+    }
+    return true;
+}
+
+bool PwlWaveform::advance()
+{
+    Point p;
+    if (m_atEnd || !readPoint(p)) {
+        m_atEnd = true;
+        return false;
+    }
+    m_p0 = m_p1;
+    m_p1 = p;
+    m_atStart = false;
+    return true;
+}
+
+bool PwlWaveform::readPoint(Point &p)
+{
+    if (m_isVcd) {
+        // Only the last of the changes at the same time counts, which is
+        // only known once a change for a later time has been read
+        Point point = m_vcdPending;
+        bool found = m_hasVcdPending;
+        m_hasVcdPending = false;
+
+        Point change;
+        while (readVcdChange(change)) {
+            if (!found || change.time <= point.time) {
+                point.value = change.value;
+                if (!found)
+                    point.time = change.time;
+                found = true;
+                continue;
+            }
+            m_vcdPending = change;
+            m_hasVcdPending = true;
+            break;
+        }
+
+        if (!found)
+            return false;
+        p = point;
+        return true;
+    }
+
+    static const QRegularExpression separator("[,\\s]+");
+
+    QByteArray bytes;
+    while (readLine(&bytes)) {
+        const QString line = QString::fromLatin1(bytes).trimmed();
+        if (line.isEmpty() || line.startsWith('#') || line.startsWith('*') || line.startsWith(';'))
+            continue;
+
+        const QStringList fields = line.split(separator, Qt::SkipEmptyParts);
+        if (fields.size() < 2)
+            continue;
+
+        bool timeOk, valueOk;
+        const double time = fields[0].toDouble(&timeOk);
+        const double value = fields[1].toDouble(&valueOk);
+        if (!timeOk || !valueOk || time <= m_p1.time)
+            continue;
+
+        p = {time, value};
+        return true;
+    }
+    return false;
+}
+
+double PwlWaveform::valueAt(double time)
+{
+    if (!m_file.isOpen())
+        return 0.;
+
+    if (time < m_p0.time && !m_atStart)
+        rewind();
+
+    while (time > m_p1.time && advance()) {
+    }
+
+    if (time <= m_p0.time)
+        return m_p0.value;
+    if (time >= m_p1.time)
+        return m_p1.value;
+    if (m_isVcd)
+        return m_p0.value;
+    return m_p0.value + (m_p1.value - m_p0.value) * (time - m_p0.time) / (m_p1.time - m_p0.time);
+}
+
+double PwlWaveform::nextPointTime(double time)
+{
+    if (!m_file.isOpen())
+        return std::numeric_limits<double>::infinity();
+
+    if (time < m_p0.time && !m_atStart)
+        rewind();
+    if (time < m_p0.time)
+        return m_p0.time;
+
+    while (time >= m_p1.time && advance()) {
+    }
+
+    return (time < m_p1.time) ? m_p1.time : std::numeric_limits<double>::infinity();
+}
+
+// BEGIN Reading the file
+bool PwlWaveform::loadChunk(qint64 offset, qint64 size)
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+
+    size = std::max(std::min(size, m_file.size() - offset), qint64(0));
+    m_chunkOffset = offset;
+    m_pos = 0;
+
+    if (size > 0)
+        m_map = m_file.map(offset, size);
+    if (m_map) {
+        m_data = reinterpret_cast<const char *>(m_map);
+        m_dataSize = size;
+        return true;
+    }
+
+    // Such as for files on some network file systems
+    if (!m_file.seek(offset))
+        return false;
+    m_buffer = m_file.read(size);
+    m_data = m_buffer.constData();
+    m_dataSize = m_buffer.size();
+    return m_dataSize == size;
+}
+
+bool PwlWaveform::readLine(QByteArray *line)
+{
+    for (;;) {
+        const char *start = m_data + m_pos;
+        const qint64 remaining = m_dataSize - m_pos;
+        const char *newline = remaining > 0 ? static_cast<const char *>(memchr(start, '\n', remaining)) : nullptr;
+        if (newline) {
+            qint64 length = newline - start;
+            if (length > 0 && start[length - 1] == '\r')
+                length--;
+            *line = QByteArray(start, length);
+            m_pos += newline - start + 1;
+            return true;
+        }
+
+        if (m_chunkOffset + m_dataSize >= m_file.size()) {
+            // The last line, which has no line ending
+            if (remaining <= 0)
+                return false;
+            *line = QByteArray(start, remaining);
+            m_pos = m_dataSize;
+            return true;
+        }
+
+        // The line carries on into the next chunk, so that starts with it
+        // (and is made bigger, for a line longer than a chunk)
+        const qint64 size = (m_pos == 0) ? 2 * m_dataSize : CHUNK_SIZE;
+        if (!loadChunk(m_chunkOffset + m_pos, size))
+            return false;
+    }
+}
+
+bool PwlWaveform::readToken(QByteArray *token)
+{
+    while (m_tokens.isEmpty()) {
+        QByteArray line;
+        if (!readLine(&line))
+            return false;
+        m_tokens = line.simplified().split(' ');
+        m_tokens.removeAll(QByteArray());
+    }
+    *token = m_tokens.takeFirst();
+    return true;
+}
+// END Reading the file
+
+// BEGIN Value change dumps
+bool PwlWaveform::readVcdHeader()
+{
+    m_vcdId.clear();
+    m_vcdTimescale = 1.;
+    QList<QByteArray> scopes;
+
+    QByteArray token;
+    while (readToken(&token)) {
+        if (token == "$enddefinitions") {
+            skipVcdCommand();
+            return !m_vcdId.isEmpty();
+        }
+
+        if (token == "$timescale") {
+            QByteArray timescale;
+            while (readToken(&token) && token != "$end")
+                timescale += token;
+
+            static const char *const units[] = {"fs", "ps", "ns", "us", "ms", "s"};
+            double multiplier = 1e-15;
+            for (const char *unit : units) {
+                if (timescale.endsWith(unit)) {
+                    timescale.chop(int(strlen(unit)));
+                    m_vcdTimescale = timescale.toDouble() * multiplier;
+                    break;
+                }
+                multiplier *= 1e3;
+            }
+        } else if (token == "$scope") {
+            QByteArray type, name;
+            if (readToken(&type) && readToken(&name))
+                scopes << name;
+            skipVcdCommand();
+        } else if (token == "$upscope") {
+            if (!scopes.isEmpty())
+                scopes.removeLast();
+            skipVcdCommand();
+        } else if (token == "$var") {
+            // $var type size id reference [bits] $end
+            QByteArray type, size, id, reference;
+            if (readToken(&type) && readToken(&size) && readToken(&id) && readToken(&reference) && m_vcdId.isEmpty()) {
+                QList<QByteArray> path = scopes;
+                path << reference;
+                const QByteArray fullName = path.join('.');
+                if (m_signal.isEmpty() || m_signal == reference || m_signal == fullName)
+                    m_vcdId = id;
+            }
+            skipVcdCommand();
+        } else if (token.startsWith('$'))
+            skipVcdCommand();
+    }
+
+    return false;
+}
+
+void PwlWaveform::skipVcdCommand()
+{
+    QByteArray token;
+    while (readToken(&token) && token != "$end") {
+    }
+}
+
+bool PwlWaveform::readVcdChange(Point &p)
+{
+    QByteArray token;
+    while (readToken(&token)) {
+        const char c = token[0];
+        QByteArray id;
+        double value = 0.;
+
+        switch (c) {
+        case '#':
+            m_vcdTime = token.mid(1).toDouble();
+            continue;
+        case '$':
+            // The values in $dumpvars and the like are read as any others
+            if (token == "$comment")
+                skipVcdCommand();
+            continue;
+        case 'b':
+        case 'B':
+            // Bits that are x or z are taken as 0
+            for (int i = 1; i < token.size(); ++i)
+                value = 2. * value + (token[i] == '1' ? 1. : 0.);
+            if (!readToken(&id))
+                return false;
+            break;
+        case 'r':
+        case 'R':
+            value = token.mid(1).toDouble();
+            if (!readToken(&id))
+                return false;
+            break;
+        case '0':
+        case '1':
+        case 'x':
+        case 'X':
+        case 'z':
+        case 'Z':
+            value = (c == '1') ? 1. : 0.;
+            id = token.mid(1);
+            break;
+        default:
+            continue;
+        }
+
+        if (id == m_vcdId) {
+            p = {m_vcdTime * m_vcdTimescale, value};
+            return true;
+        }
+    }
+    return false;
+}
+// END Value change dumps
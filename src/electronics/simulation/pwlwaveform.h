@@ -0,0 +1,154 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef PWLWAVEFORM_H
+#define PWLWAVEFORM_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+
+/**
+A waveform read from a file, either of points or a value change dump.
+
+A file of points has one per line, each a time in seconds and a value
+separated by a comma or whitespace (so both CSV files and SPICE style PWL lists
+can be used). Blank lines, lines starting with '#', '*' or ';', and lines that
+do not start with two numbers (such as a CSV header) are skipped, as are points
+that do not come after the one before. The value is interpolated linearly
+between the points.
+
+A value change dump (VCD, as written by logic analysers and HDL simulators) is
+recognised from its header. The waveform is that of one of its variables: a
+wire (whose value is 0 or 1, with x and z taken as 0), a vector (whose value is
+that of its bits as an unsigned number) or a real. The value is held from one
+change to the next.
+
+The file is streamed rather than read in whole: it is memory mapped a chunk at
+a time, and only the two points either side of the time last asked for are
+held, so long stimuli take no memory. The value before the first point is that
+of the first point, and the value after the last point is that of the last
+point.
+*/
+class PwlWaveform
+{
+public:
+    PwlWaveform();
+    ~PwlWaveform();
+
+    /**
+     * Opens the file and reads its first points.
+     * @param signal for a value change dump, the name of the variable to
+     * use (which may have its scope in front, e.g. "top.clk"), or empty for
+     * the first one
+     * @return false if the file could not be read or has no points
+     */
+    bool open(const QString &fileName, const QString &signal = QString());
+    QString fileName() const
+    {
+        return m_file.fileName();
+    }
+    /**
+     * @return the value at the time. This is quick when the times asked for
+     * increase from one call to the next; asking for an earlier time reads
+     * the file again from the start.
+     */
+    double valueAt(double time);
+    /**
+     * @return the time of the first point after the given time, or infinity
+     * if there is none. As for valueAt, this is quick for increasing times.
+     */
+    double nextPointTime(double time);
+
+    /**
+     * Size of the chunks that the file is mapped in.
+     */
+    static const qint64 CHUNK_SIZE = 1 << 20;
+
+protected:
+    class Point
+    {
+    public:
+        double time;
+        double value;
+    };
+
+    /**
+     * Goes back to the first point of the file.
+     * @return false if the file has no points
+     */
+    bool rewind();
+    /**
+     * Moves on to the next segment.
+     * @return false if m_p1 is the last point
+     */
+    bool advance();
+    /**
+     * Reads the next point from the file that comes after m_p1 into p.
+     * @return false if the end of the file has been reached
+     */
+    bool readPoint(Point &p);
+
+    /**
+     * Maps (or reads, if the file cannot be mapped) the chunk of the file
+     * of the given size from offset.
+     */
+    bool loadChunk(qint64 offset, qint64 size);
+    /**
+     * Reads the next line of the file, without its line ending.
+     * @return false at the end of the file
+     */
+    bool readLine(QByteArray *line);
+    /**
+     * Reads the next token (separated by whitespace) of the file.
+     * @return false at the end of the file
+     */
+    bool readToken(QByteArray *token);
+
+    /**
+     * Reads the header of a value change dump, up to $enddefinitions.
+     * @return false if it does not have the variable
+     */
+    bool readVcdHeader();
+    /**
+     * Skips the tokens of a value change dump up to and including $end.
+     */
+    void skipVcdCommand();
+    /**
+     * Reads the next change of the variable from a value change dump.
+     * @return false at the end of the file
+     */
+    bool readVcdChange(Point &p);
+
+    QFile m_file;
+    uchar *m_map; // The mapped chunk, or null if it was read into m_buffer
+    QByteArray m_buffer;
+    const char *m_data; // The chunk, from m_map or m_buffer
+    qint64 m_dataSize;
+    qint64 m_chunkOffset; // In the file, of the chunk
+    qint64 m_pos; // In the chunk, of the next line
+    QList<QByteArray> m_tokens; // Those of the line that have not been read yet
+
+    Point m_p0; // The start of the segment being interpolated over
+    Point m_p1; // The end of the segment being interpolated over
+    bool m_atStart; // Whether m_p0 is the first point of the file
+    bool m_atEnd; // Whether m_p1 is the last point of the file
+
+    bool m_isVcd;
+    QByteArray m_signal; // The variable of a value change dump to use
+    QByteArray m_vcdId; // The identifier code of the variable
+    double m_vcdTimescale; // Seconds per unit of time of the dump
+    double m_vcdTime; // Of the changes being read, in units of the dump
+    Point m_vcdPending; // A change read ahead, for a later time than the point being read
+    bool m_hasVcdPending;
+};
+
+#endif
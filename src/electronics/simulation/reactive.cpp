@@ -10,10 +10,20 @@
 
 #include "reactive.h"
 
+#include <QDataStream>
+
+#include <algorithm>
+#include <cmath>
+
+static const double TRUNCATION_REL_TOL = 1e-3;
+
+bool Reactive::m_bReferenceMode = false;
+
 Reactive::Reactive(const double delta)
     : Element()
 {
     m_delta = delta;
+    resetIntegration();
 }
 
 Reactive::~Reactive()
@@ -30,3 +40,98 @@ bool Reactive::updateStatus()
 {
     return Element::updateStatus();
 }
+
+void Reactive::saveState(QDataStream &stream) const
+{
+    stream << m_x0 << m_d0 << m_x1 << m_h1 << m_bHistory << m_stepDelta << qint32(m_stepRule);
+}
+
+void Reactive::restoreState(QDataStream &stream)
+{
+    qint32 stepRule;
+    stream >> m_x0 >> m_d0 >> m_x1 >> m_h1 >> m_bHistory >> m_stepDelta >> stepRule;
+    m_stepRule = Integration(stepRule);
+}
+
+void Reactive::resetIntegration()
+{
+    m_weight = m_offset = 0.;
+    m_x0 = m_d0 = m_x1 = 0.;
+    m_h1 = 0.;
+    m_bHistory = false;
+    m_stepDelta = 0.;
+    m_stepRule = integration_euler;
+}
+
+void Reactive::acceptStep(double x, double d)
+{
+    if (m_stepDelta > 0.) {
+        m_x1 = m_x0;
+        m_h1 = m_stepDelta;
+        m_bHistory = true;
+    }
+    m_x0 = x;
+    m_d0 = d;
+}
+
+void Reactive::prepareStep(Integration rule, double k)
+{
+    const double h = m_delta;
+
+    if (!m_bHistory || m_bReferenceMode)
+        rule = integration_euler;
+
+    switch (rule) {
+    case integration_euler:
+        m_weight = k / h;
+        m_offset = -m_weight * m_x0;
+        break;
+
+    case integration_trap:
+        m_weight = 2. * k / h;
+        m_offset = -(m_weight * m_x0 + m_d0);
+        break;
+
+    case integration_gear: {
+        // Variable step BDF2, with w the ratio of this step to the last one
+        const double w = h / m_h1;
+        const double a0 = (1. + 2. * w) / (1. + w);
+        const double a1 = 1. + w;
+        const double a2 = w * w / (1. + w);
+        m_weight = a0 * k / h;
+        m_offset = -(k / h) * (a1 * m_x0 - a2 * m_x1);
+        break;
+    }
+    }
+
+    m_stepDelta = h;
+    m_stepRule = rule;
+}
+
+double Reactive::estimateError(double x, double d, double k, double absTol) const
+{
+    if (m_stepDelta <= 0. || k <= 0.)
+        return 0.;
+
+    const double h = m_stepDelta;
+
+    // The gap between the rate at the end of the step and the average rate
+    // over the step is about h/2 |x''|, giving the backward Euler error.
+    const double slope = k * (x - m_x0) / h;
+    const double gap = std::abs(d - slope);
+    double error = 0.5 * h * gap / k;
+
+    if (m_stepRule != integration_euler) {
+        // For a locally exponential response, h/tau is about 2 gap/slope, and
+        // the second order errors (h^3/12 |x'''| and 2h^3/9 |x'''|) are the
+        // Euler error times (h/tau)/6 and 4(h/tau)/9 respectively.
+        const double scale = std::max(std::abs(slope), std::abs(d));
+        if (scale <= 0.)
+            return 0.;
+        const double c = (m_stepRule == integration_trap) ? (1. / 3.) : (8. / 9.);
+        error *= std::min(1., c * gap / scale);
+    }
+
+    const double tolerance = TRUNCATION_REL_TOL * std::max(std::abs(x), std::abs(m_x0)) + absTol;
+    return error / tolerance;
+}
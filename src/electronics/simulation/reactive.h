@@ -35,11 +35,81 @@ public:
      * Called on every time step for the element to update itself
      */
     virtual void time_step() = 0;
+    /**
+     * Throws away the solution found since the last time_step, and sets up
+     * the same step again with the delta that has been set since.
+     */
+    virtual void retry_step()
+    {
+    }
+    /**
+     * @return the estimated local truncation error of the solution found
+     * since the last time_step, as a multiple of the tolerated error (so a
+     * value above 1 means the step should be retried with a smaller delta).
+     */
+    virtual double truncationError() const
+    {
+        return 0.;
+    }
+    void saveState(QDataStream &stream) const override;
+    void restoreState(QDataStream &stream) override;
+    /**
+     * Sets whether every step uses backward Euler, whatever rule the element
+     * asks for (see Circuit::setReferenceMode).
+     */
+    static void setReferenceMode(bool reference)
+    {
+        m_bReferenceMode = reference;
+    }
 
 protected:
     bool updateStatus() override;
 
+    enum Integration {
+        integration_euler, // Backward Euler
+        integration_trap,  // Trapezoidal
+        integration_gear   // Second order Gear (BDF2)
+    };
+    /**
+     * Integration shared by the energy storage elements, for a state x
+     * (capacitor voltage, inductor current) that changes at a rate of d / k
+     * (capacitor current over capacitance, inductor voltage over inductance).
+     * Over each step, the integration rule approximates d at the end of the
+     * step as m_weight * x + m_offset, which the element stamps as a
+     * conductance (or resistance) and a source.
+     */
+    void resetIntegration();
+    /**
+     * Takes x and d of the last solution as the state to integrate from.
+     */
+    void acceptStep(double x, double d);
+    /**
+     * Sets m_weight and m_offset for a step of m_delta from the accepted
+     * state. Second order rules fall back to backward Euler until there is
+     * enough history.
+     */
+    void prepareStep(Integration rule, double k);
+    /**
+     * Estimates the error in x of the step from the accepted state to the
+     * solution (x, d), relative to a tolerance of 0.1% of |x| plus absTol.
+     * Only the step itself is used, so input changes at the start of the step
+     * (which would upset an estimate from older history) do no harm.
+     */
+    double estimateError(double x, double d, double k, double absTol) const;
+
     double m_delta; // Delta time interval
+
+    double m_weight; // d = m_weight * x + m_offset at the end of the step
+    double m_offset;
+
+private:
+    double m_x0, m_d0; // The accepted state
+    double m_x1;       // The state accepted before that
+    double m_h1;       // The step from m_x1 to m_x0
+    bool m_bHistory;   // Set once the accepted state came from a step
+    double m_stepDelta;
+    Integration m_stepRule;
+    static bool m_bReferenceMode;
 };
 
 #endif
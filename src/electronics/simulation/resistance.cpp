@@ -34,12 +34,12 @@ void Resistance::setConductance(const double g)
     if (p_eSet)
         p_eSet->setCacheInvalidated();
 
-    // Remove old resistance
-    m_g = -m_g;
-    add_initial_dc();
+    // Change the old resistance to the new one, which is kept as an update
+    // to the decomposition of the matrix (e.g. for a switch)
+    if (b_status)
+        stampConductanceRankOne(0, 1, g - m_g);
 
     m_g = g;
-    add_initial_dc();
 }
 
 void Resistance::setResistance(const double r)
@@ -52,10 +52,7 @@ void Resistance::add_initial_dc()
     if (!b_status)
         return;
 
-    A_g(0, 0) += m_g;
-    A_g(1, 1) += m_g;
-    A_g(0, 1) -= m_g;
-    A_g(1, 0) -= m_g;
+    stampConductance(0, 1, m_g);
 }
 
 void Resistance::updateCurrents()
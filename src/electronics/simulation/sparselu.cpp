@@ -0,0 +1,584 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "sparselu.h"
+
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QtGlobal>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <queue>
+#include <set>
+
+namespace
+{
+/**
+ * Cached symbolic factorizations, most recently used first. The pattern is
+ * kept alongside the structure so that hash collisions are harmless.
+ */
+class StructureCacheEntry
+{
+public:
+    quint64 hash;
+    unsigned nodeCount;
+    std::vector<std::vector<unsigned>> pattern;
+    std::shared_ptr<const SparseLU::Structure> structure;
+};
+
+typedef std::list<StructureCacheEntry> StructureCache;
+
+StructureCache &structureCache()
+{
+    static StructureCache cache;
+    return cache;
+}
+
+std::mutex &structureCacheMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+/**
+ * Factors one diagonal block of a dissected matrix in a thread of the global
+ * thread pool.
+ */
+class BlockFactorJob : public QRunnable
+{
+public:
+    BlockFactorJob(std::function<void()> factor, QSemaphore *done)
+        : m_factor(factor)
+        , m_done(done)
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override
+    {
+        m_factor();
+        m_done->release();
+    }
+
+protected:
+    std::function<void()> m_factor;
+    QSemaphore *m_done;
+};
+
+quint64 patternHash(const std::vector<std::vector<unsigned>> &pattern, unsigned nodeCount)
+{
+    // FNV-1a
+    quint64 hash = 14695981039346656037ull;
+    auto add = [&hash](quint64 value) {
+        hash ^= value;
+        hash *= 1099511628211ull;
+    };
+
+    add(nodeCount);
+    add(pattern.size());
+    for (std::vector<std::vector<unsigned>>::const_iterator row = pattern.begin(); row != pattern.end(); ++row) {
+        add(row->size());
+        for (std::vector<unsigned>::const_iterator it = row->begin(); it != row->end(); ++it)
+            add(*it);
+    }
+    return hash;
+}
+}
+
+SparseLU::SparseLU()
+    : m_bStructureCached(false)
+{
+}
+
+void SparseLU::analyse(const std::vector<std::vector<unsigned>> &pattern, unsigned nodeCount)
+{
+    const quint64 hash = patternHash(pattern, nodeCount);
+
+    m_structure.reset();
+    m_bStructureCached = false;
+
+    {
+        std::lock_guard<std::mutex> lock(structureCacheMutex());
+        StructureCache &cache = structureCache();
+        for (StructureCache::iterator it = cache.begin(); it != cache.end(); ++it) {
+            if (it->hash == hash && it->nodeCount == nodeCount && it->pattern == pattern) {
+                m_structure = it->structure;
+                cache.splice(cache.begin(), cache, it);
+                m_bStructureCached = true;
+                break;
+            }
+        }
+    }
+
+    if (!m_structure) {
+        Structure *structure = new Structure;
+        structure->size = pattern.size();
+        computeOrdering(structure, pattern, std::min<unsigned>(nodeCount, structure->size));
+        computeSymbolic(structure, pattern);
+        m_structure.reset(structure);
+
+        StructureCacheEntry entry;
+        entry.hash = hash;
+        entry.nodeCount = nodeCount;
+        entry.pattern = pattern;
+        entry.structure = m_structure;
+
+        std::lock_guard<std::mutex> lock(structureCacheMutex());
+        StructureCache &cache = structureCache();
+        cache.push_front(entry);
+        while (cache.size() > STRUCTURE_CACHE_SIZE)
+            cache.pop_back();
+    }
+
+    m_val.assign(m_structure->col.size(), 0.);
+    m_work.assign(m_structure->size, 0.);
+
+    // The calling thread factors the last block with m_work
+    const unsigned blockCount = m_structure->blockStart.empty() ? 0 : unsigned(m_structure->blockStart.size() - 1);
+    m_blockWork.assign((blockCount > 1) ? blockCount - 1 : 0, std::vector<double>(m_structure->size, 0.));
+}
+
+void SparseLU::clearStructureCache()
+{
+    std::lock_guard<std::mutex> lock(structureCacheMutex());
+    structureCache().clear();
+}
+
+void SparseLU::computeOrdering(Structure *s, const std::vector<std::vector<unsigned>> &pattern, unsigned nodeCount)
+{
+    const unsigned size = s->size;
+    std::vector<unsigned> &perm = s->perm;
+    std::vector<unsigned> &iperm = s->iperm;
+
+    perm.assign(size, 0);
+    iperm.clear();
+    iperm.reserve(size);
+    s->blockStart.clear();
+
+    // Graph of the node part of the matrix
+    std::vector<std::vector<unsigned>> adjacent(nodeCount);
+    for (unsigned i = 0; i < nodeCount; ++i) {
+        const std::vector<unsigned> &row = pattern[i];
+        for (std::vector<unsigned>::const_iterator it = row.begin(); it != row.end(); ++it) {
+            const unsigned j = *it;
+            if (j >= nodeCount || j == i)
+                continue;
+            adjacent[i].push_back(j);
+            adjacent[j].push_back(i);
+        }
+    }
+    for (std::vector<unsigned> &adj : adjacent) {
+        std::sort(adj.begin(), adj.end());
+        adj.erase(std::unique(adj.begin(), adj.end()), adj.end());
+    }
+
+    std::vector<unsigned> nodes(nodeCount);
+    for (unsigned i = 0; i < nodeCount; ++i)
+        nodes[i] = i;
+
+    if (nodeCount < DISSECTION_MIN_NODES) {
+        minimumDegreeOrder(adjacent, nodes, &iperm);
+    } else {
+        // Split the parts again and again, keeping the separators for the
+        // border (the innermost separators first, as they are the smallest)
+        std::vector<std::vector<unsigned>> parts(1, nodes);
+        std::vector<std::vector<unsigned>> separators;
+        for (unsigned depth = 0; depth < DISSECTION_DEPTH; ++depth) {
+            std::vector<std::vector<unsigned>> split;
+            for (const std::vector<unsigned> &part : parts) {
+                std::vector<unsigned> partA, partB, separator;
+                if (bisect(adjacent, part, &partA, &partB, &separator)) {
+                    split.push_back(partA);
+                    split.push_back(partB);
+                    separators.insert(separators.begin(), separator);
+                } else
+                    split.push_back(part);
+            }
+            parts.swap(split);
+        }
+
+        for (const std::vector<unsigned> &part : parts) {
+            s->blockStart.push_back(iperm.size());
+            minimumDegreeOrder(adjacent, part, &iperm);
+        }
+        s->blockStart.push_back(iperm.size());
+
+        for (const std::vector<unsigned> &separator : separators)
+            iperm.insert(iperm.end(), separator.begin(), separator.end());
+
+        if (parts.size() < 2)
+            s->blockStart.clear();
+    }
+
+    // Branches stay where they are, after all of the nodes
+    for (unsigned k = nodeCount; k < size; ++k)
+        iperm.push_back(k);
+
+    for (unsigned k = 0; k < size; ++k)
+        perm[iperm[k]] = k;
+}
+
+void SparseLU::minimumDegreeOrder(const std::vector<std::vector<unsigned>> &adjacent, const std::vector<unsigned> &nodes, std::vector<unsigned> *order)
+{
+    const unsigned count = nodes.size();
+
+    // Elimination graph of the nodes, numbered by their position in nodes
+    std::vector<unsigned> local(adjacent.size(), count);
+    for (unsigned i = 0; i < count; ++i)
+        local[nodes[i]] = i;
+
+    std::vector<std::set<unsigned>> graph(count);
+    for (unsigned i = 0; i < count; ++i) {
+        const std::vector<unsigned> &adj = adjacent[nodes[i]];
+        for (std::vector<unsigned>::const_iterator it = adj.begin(); it != adj.end(); ++it) {
+            if (local[*it] != count)
+                graph[i].insert(local[*it]);
+        }
+    }
+
+    std::vector<bool> eliminated(count, false);
+    for (unsigned k = 0; k < count; ++k) {
+        // Pick the node with the fewest neighbours (the lowest index on ties,
+        // so that the ordering is reproducible)
+        unsigned best = count;
+        for (unsigned i = 0; i < count; ++i) {
+            if (!eliminated[i] && (best == count || graph[i].size() < graph[best].size()))
+                best = i;
+        }
+
+        eliminated[best] = true;
+        order->push_back(nodes[best]);
+
+        // Eliminating the node connects all of its neighbours together
+        const std::set<unsigned> neighbours = graph[best];
+        for (std::set<unsigned>::const_iterator it = neighbours.begin(); it != neighbours.end(); ++it) {
+            std::set<unsigned> &adj = graph[*it];
+            adj.erase(best);
+            for (std::set<unsigned>::const_iterator other = neighbours.begin(); other != neighbours.end(); ++other) {
+                if (*other != *it)
+                    adj.insert(*other);
+            }
+        }
+        graph[best].clear();
+    }
+}
+
+bool SparseLU::bisect(const std::vector<std::vector<unsigned>> &adjacent, const std::vector<unsigned> &nodes, std::vector<unsigned> *partA, std::vector<unsigned> *partB, std::vector<unsigned> *separator)
+{
+    const unsigned count = nodes.size();
+    if (count < DISSECTION_MIN_NODES / 2)
+        return false;
+
+    const unsigned none = ~0u;
+    std::vector<unsigned> level(adjacent.size(), none);
+    std::vector<bool> inNodes(adjacent.size(), false);
+    for (unsigned node : nodes)
+        inNodes[node] = true;
+
+    // Breadth first search over the nodes, giving the nodes in the order
+    // reached (and their levels)
+    std::vector<unsigned> reached;
+    auto search = [&](unsigned start) {
+        for (unsigned node : reached)
+            level[node] = none;
+        reached.clear();
+
+        level[start] = 0;
+        reached.push_back(start);
+        for (unsigned i = 0; i < reached.size(); ++i) {
+            const unsigned node = reached[i];
+            for (unsigned next : adjacent[node]) {
+                if (inNodes[next] && level[next] == none) {
+                    level[next] = level[node] + 1;
+                    reached.push_back(next);
+                }
+            }
+        }
+    };
+
+    // The node furthest from an arbitrary node is at the edge of the graph,
+    // which gives the most levels
+    search(nodes.front());
+    search(reached.back());
+
+    if (reached.size() < count) {
+        // Not connected: the nodes reached and the rest need no separator
+        for (unsigned node : nodes)
+            (level[node] == none ? partB : partA)->push_back(node);
+        return !partB->empty();
+    }
+
+    const unsigned levels = level[reached.back()] + 1;
+    if (levels < 3)
+        return false;
+
+    // The level that the middle node is on separates the levels before it
+    // from those after it
+    const unsigned middle = level[reached[count / 2]];
+    if (middle == 0 || middle == levels - 1)
+        return false;
+
+    for (unsigned node : nodes) {
+        if (level[node] < middle)
+            partA->push_back(node);
+        else if (level[node] > middle)
+            partB->push_back(node);
+        else
+            separator->push_back(node);
+    }
+    return true;
+}
+
+void SparseLU::computeSymbolic(Structure *s, const std::vector<std::vector<unsigned>> &pattern)
+{
+    const unsigned size = s->size;
+    const std::vector<unsigned> &perm = s->perm;
+    const std::vector<unsigned> &iperm = s->iperm;
+    std::vector<unsigned> &rowStart = s->rowStart;
+    std::vector<unsigned> &col = s->col;
+    std::vector<unsigned> &diag = s->diag;
+
+    rowStart.assign(size + 1, 0);
+    diag.assign(size, 0);
+    col.clear();
+
+    // Row i of the factorization has the pattern of row i of A, together with
+    // the upper pattern of every row k for which (i,k) is in the lower pattern
+    // of row i (including lower entries that are themselves fill-in).
+    std::vector<unsigned> mark(size, size);
+    std::vector<unsigned> upper;
+    std::vector<unsigned> lowerCols;
+    std::priority_queue<unsigned, std::vector<unsigned>, std::greater<unsigned>> lower;
+
+    for (unsigned i = 0; i < size; ++i) {
+        upper.clear();
+        lowerCols.clear();
+
+        mark[i] = i;
+        upper.push_back(i);
+
+        const std::vector<unsigned> &row = pattern[iperm[i]];
+        for (std::vector<unsigned>::const_iterator it = row.begin(); it != row.end(); ++it) {
+            const unsigned j = perm[*it];
+            if (mark[j] == i)
+                continue;
+            mark[j] = i;
+            if (j < i)
+                lower.push(j);
+            else
+                upper.push_back(j);
+        }
+
+        while (!lower.empty()) {
+            const unsigned k = lower.top();
+            lower.pop();
+            lowerCols.push_back(k);
+
+            for (unsigned p = diag[k] + 1; p < rowStart[k + 1]; ++p) {
+                const unsigned j = col[p];
+                if (mark[j] == i)
+                    continue;
+                mark[j] = i;
+                if (j < i)
+                    lower.push(j);
+                else
+                    upper.push_back(j);
+            }
+        }
+
+        std::sort(upper.begin(), upper.end());
+
+        rowStart[i] = col.size();
+        col.insert(col.end(), lowerCols.begin(), lowerCols.end());
+        diag[i] = col.size();
+        col.insert(col.end(), upper.begin(), upper.end());
+        rowStart[i + 1] = col.size();
+    }
+
+    s->srcCol.resize(col.size());
+    for (unsigned p = 0; p < col.size(); ++p)
+        s->srcCol[p] = iperm[col[p]];
+}
+
+void SparseLU::factor(const QuickMatrix *mat, unsigned fromRow)
+{
+    const std::vector<unsigned> &blockStart = m_structure->blockStart;
+    if (blockStart.size() < 3) {
+        factorRows(mat, fromRow, m_structure->size, m_work.data());
+        return;
+    }
+
+    // The diagonal blocks do not depend on each other, so all but the last
+    // are given to the thread pool (or factored here if it has no thread
+    // free), and the border is factored once they are all done
+    const unsigned blockCount = blockStart.size() - 1;
+    QSemaphore done;
+    int started = 0;
+    for (unsigned b = 0; b < blockCount; ++b) {
+        const unsigned begin = std::max(blockStart[b], fromRow);
+        const unsigned end = blockStart[b + 1];
+        if (begin >= end)
+            continue;
+
+        if (b + 1 < blockCount) {
+            double *w = m_blockWork[b].data();
+            BlockFactorJob *job = new BlockFactorJob([this, mat, begin, end, w]() {
+                factorRows(mat, begin, end, w);
+            }, &done);
+            if (QThreadPool::globalInstance()->tryStart(job)) {
+                started++;
+                continue;
+            }
+            delete job;
+        }
+        factorRows(mat, begin, end, m_work.data());
+    }
+    done.acquire(started);
+
+    factorRows(mat, std::max(blockStart.back(), fromRow), m_structure->size, m_work.data());
+}
+
+void SparseLU::factorRows(const QuickMatrix *mat, unsigned begin, unsigned end, double *w)
+{
+    const unsigned *const rowStart = m_structure->rowStart.data();
+    const unsigned *const col = m_structure->col.data();
+    const unsigned *const diagonal = m_structure->diag.data();
+    const unsigned *const srcCol = m_structure->srcCol.data();
+    double *const val = m_val.data();
+
+    for (unsigned i = begin; i < end; ++i) {
+        const unsigned rowBegin = rowStart[i];
+        const unsigned rowEnd = rowStart[i + 1];
+        const unsigned diag = diagonal[i];
+        const double *const a = (*mat)[i];
+
+        for (unsigned p = rowBegin; p < rowEnd; ++p)
+            w[col[p]] = a[srcCol[p]];
+
+        // Columns are sorted, so the lower entries are visited in elimination order
+        for (unsigned p = rowBegin; p < diag; ++p) {
+            const unsigned k = col[p];
+            const double l = w[k] / val[diagonal[k]];
+            w[k] = l;
+
+            if (std::abs(l) <= 1e-12)
+                continue;
+
+            const unsigned kEnd = rowStart[k + 1];
+            for (unsigned q = diagonal[k] + 1; q < kEnd; ++q)
+                w[col[q]] -= l * val[q];
+        }
+
+        // detect singular matrixes (as in the dense solver)...
+        double &pivot = w[i];
+        if (std::abs(pivot) < 1e-10)
+            pivot = (pivot < 0.) ? -1e-10 : 1e-10;
+
+        for (unsigned p = rowBegin; p < rowEnd; ++p) {
+            const unsigned j = col[p];
+            val[p] = w[j];
+            w[j] = 0.;
+        }
+    }
+}
+
+void SparseLU::matrixValues(const QuickMatrix *mat, std::vector<double> *values) const
+{
+    const unsigned size = m_structure->size;
+    const unsigned *const rowStart = m_structure->rowStart.data();
+    const unsigned *const srcCol = m_structure->srcCol.data();
+
+    values->resize(rowStart[size]);
+    double *out = values->data();
+    for (unsigned i = 0; i < size; ++i) {
+        const double *const a = (*mat)[i];
+        for (unsigned p = rowStart[i]; p < rowStart[i + 1]; ++p)
+            *out++ = a[srcCol[p]];
+    }
+}
+
+double SparseLU::pivotRatio() const
+{
+    const unsigned size = m_structure->size;
+    if (size == 0)
+        return 1.;
+
+    double largest = 0.;
+    double smallest = std::numeric_limits<double>::max();
+    for (unsigned i = 0; i < size; ++i) {
+        const double u = std::abs(m_val[m_structure->diag[i]]);
+        largest = std::max(largest, u);
+        smallest = std::min(smallest, u);
+    }
+    return largest / smallest;
+}
+
+double SparseLU::rowProduct(const QuickMatrix *mat, unsigned row, const double *x) const
+{
+    const unsigned *const srcCol = m_structure->srcCol.data();
+    const double *const a = (*mat)[row];
+
+    double sum = 0.;
+    for (unsigned p = m_structure->rowStart[row]; p < m_structure->rowStart[row + 1]; ++p)
+        sum += a[srcCol[p]] * x[srcCol[p]];
+    return sum;
+}
+
+void SparseLU::solve(double *y) const
+{
+    const unsigned size = m_structure->size;
+    const unsigned *const rowStart = m_structure->rowStart.data();
+    const unsigned *const col = m_structure->col.data();
+    const unsigned *const diagonal = m_structure->diag.data();
+    const double *const val = m_val.data();
+
+    // Forward substitution (L has a unit diagonal)
+    for (unsigned i = 0; i < size; ++i) {
+        double sum = 0.;
+        for (unsigned p = rowStart[i]; p < diagonal[i]; ++p)
+            sum += val[p] * y[col[p]];
+        y[i] -= sum;
+    }
+
+    // Back substitution
+    for (int i = int(size) - 1; i >= 0; --i) {
+        const unsigned diag = diagonal[i];
+        double sum = 0.;
+        for (unsigned p = diag + 1; p < rowStart[i + 1]; ++p)
+            sum += val[p] * y[col[p]];
+        y[i] = (y[i] - sum) / val[diag];
+    }
+}
+
+void SparseLU::display() const
+{
+    const Structure &s = *m_structure;
+
+    for (unsigned i = 0; i < s.size; ++i) {
+        for (unsigned p = s.rowStart[i]; p < s.rowStart[i + 1]; ++p) {
+            if (p > s.rowStart[i] && m_val[p] >= 0)
+                std::cout << "+";
+            std::cout << m_val[p] << "(" << s.col[p] << ")";
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "ordering:   ";
+    for (unsigned i = 0; i < s.size; i++) {
+        std::cout << i << "->" << s.perm[i] << "  ";
+    }
+    std::cout << std::endl;
+}
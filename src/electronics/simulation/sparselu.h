@@ -0,0 +1,223 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef SPARSELU_H
+#define SPARSELU_H
+
+#include <math/qmatrix.h>
+
+#include <QtGlobal>
+
+#include <memory>
+#include <vector>
+
+/**
+Sparse LU decomposition for the MNA equations, used by Matrix for circuits
+that are large enough for elimination over zeros in the dense solver to
+dominate.
+
+Usage:
+(1) Call analyse with the sparsity pattern of the matrix. This computes a
+    fill-reducing ordering of the nodes and the symbolic factorization (the
+    positions of all nonzeros in L and U, including fill-in).
+(2) Call factor with the numeric values, as often as the values change.
+(3) Call solve to do forward and backward substitution.
+
+The symbolic factorization only depends on the pattern, so it is reused for
+every numeric factorization until the topology of the circuit changes (at
+which point a new Matrix, and so a new SparseLU, is created). Symbolic
+factorizations are also kept in a small cache keyed on the pattern, so that
+rebuilding a circuit with the same connectivity (e.g. toggling a switch back,
+or reassigning circuits after an edit elsewhere in the document) does not
+recompute the ordering.
+
+Large circuits are ordered by nested dissection: the nodes are split into
+parts that are not connected to each other except through a separating set
+of nodes, and the separators are ordered after all of the parts. This gives
+the matrix a bordered block diagonal form, in which the rows of each diagonal
+block only depend on the rows of the same block, so the blocks are factored
+in parallel before the border.
+
+Like the dense solver, no numerical pivoting is performed: the rows and
+columns are permuted symmetrically, and only the node (cnode) part of the
+matrix is reordered. The branch rows are kept after all the nodes so that
+their (usually zero) diagonal has been filled in by the time it is used as a
+pivot.
+
+@short Sparse LU factorization with symbolic reuse
+*/
+class SparseLU
+{
+    friend class MatrixTest;
+
+public:
+    SparseLU();
+
+    /**
+     * The result of the symbolic analysis, shared between all SparseLUs with
+     * the same pattern.
+     */
+    class Structure
+    {
+    public:
+        unsigned size;
+
+        std::vector<unsigned> perm;  ///< external -> internal
+        std::vector<unsigned> iperm; ///< internal -> external
+
+        // Row-wise storage of L (strictly lower, unit diagonal not stored) and
+        // U (upper, including diagonal) in the same arrays, columns sorted.
+        std::vector<unsigned> rowStart;
+        std::vector<unsigned> col;
+        std::vector<unsigned> diag;   ///< position of the diagonal in each row
+        std::vector<unsigned> srcCol; ///< external column of each entry
+
+        /// The independent diagonal blocks (internal rows blockStart[b] up to
+        /// blockStart[b + 1]), the rows after the last block being the
+        /// border. Empty if the matrix was not dissected.
+        std::vector<unsigned> blockStart;
+    };
+
+    /**
+     * Computes (or takes from the cache) the ordering and symbolic
+     * factorization.
+     * @param pattern for each (external) row, the (external) columns that
+     * may be nonzero. Diagonal entries are always added.
+     * @param nodeCount the number of leading rows that may be reordered.
+     */
+    void analyse(const std::vector<std::vector<unsigned>> &pattern, unsigned nodeCount);
+    /**
+     * Numeric factorization.
+     * @param mat the matrix values, with the rows already permuted (i.e.
+     * row permutation()[i] of mat holds external row i) and the columns in
+     * external order.
+     * @param fromRow rows of the (internal) factorization before this are
+     * assumed to be unchanged since the last call.
+     */
+    void factor(const QuickMatrix *mat, unsigned fromRow = 0);
+    /**
+     * Forward and backward substitution, in place. y is indexed by the
+     * internal (permuted) numbering.
+     */
+    void solve(double *y) const;
+    /**
+     * Copies the values of mat that factor would use into values, in the
+     * order of the pattern (for the LU cache of Matrix to tell matrices
+     * apart by).
+     */
+    void matrixValues(const QuickMatrix *mat, std::vector<double> *values) const;
+    /**
+     * @return the ratio of the largest to the smallest magnitude on the
+     * diagonal of U, a cheap estimate of the condition number of the
+     * factorized matrix.
+     */
+    double pivotRatio() const;
+    /**
+     * @return the product of (internal) row row of mat, laid out as for
+     * factor, with x (in external order). Only the entries in the pattern are
+     * used.
+     */
+    double rowProduct(const QuickMatrix *mat, unsigned row, const double *x) const;
+    /**
+     * The numeric factorization, for saving and restoring it.
+     */
+    const std::vector<double> &values() const
+    {
+        return m_val;
+    }
+    void setValues(const std::vector<double> &values)
+    {
+        m_val = values;
+    }
+
+    unsigned size() const
+    {
+        return m_structure->size;
+    }
+    /**
+     * @return the number of nonzeros in L and U (including fill-in)
+     */
+    unsigned nonZeros() const
+    {
+        return unsigned(m_structure->col.size());
+    }
+    /**
+     * Maps external row / column numbers to the internal numbering.
+     */
+    const std::vector<unsigned> &permutation() const
+    {
+        return m_structure->perm;
+    }
+    /**
+     * @return whether the last analyse found the structure in the cache
+     */
+    bool structureWasCached() const
+    {
+        return m_bStructureCached;
+    }
+    /**
+     * Removes all the cached symbolic factorizations.
+     */
+    static void clearStructureCache();
+    /**
+     * Prints the decomposed matrix to stdout
+     */
+    void display() const;
+
+    /**
+     * Maximum number of symbolic factorizations kept in the cache.
+     */
+    static const unsigned STRUCTURE_CACHE_SIZE = 32;
+    /**
+     * Circuits with at least this many nodes are ordered by nested
+     * dissection, and factored a block at a time in parallel.
+     */
+    static const unsigned DISSECTION_MIN_NODES = 256;
+    /**
+     * How many times the nodes are split in two, i.e. up to 2^depth blocks.
+     */
+    static const unsigned DISSECTION_DEPTH = 2;
+
+protected:
+    /**
+     * Orders the first nodeCount rows / columns, on the symmetrized pattern:
+     * by nested dissection for large circuits, with each part (and the
+     * whole, for smaller circuits) in minimum degree order.
+     */
+    static void computeOrdering(Structure *s, const std::vector<std::vector<unsigned>> &pattern, unsigned nodeCount);
+    /**
+     * Appends the nodes to order, in minimum degree order on the graph
+     * adjacent restricted to the nodes.
+     */
+    static void minimumDegreeOrder(const std::vector<std::vector<unsigned>> &adjacent, const std::vector<unsigned> &nodes, std::vector<unsigned> *order);
+    /**
+     * Splits the nodes into two parts that are not adjacent to each other,
+     * and the separator between them, from the levels of a breadth first
+     * search from a node at the edge of the graph.
+     * @return false if the nodes could not usefully be split
+     */
+    static bool bisect(const std::vector<std::vector<unsigned>> &adjacent, const std::vector<unsigned> &nodes, std::vector<unsigned> *partA, std::vector<unsigned> *partB, std::vector<unsigned> *separator);
+    static void computeSymbolic(Structure *s, const std::vector<std::vector<unsigned>> &pattern);
+    /**
+     * Numeric factorization of the rows from begin up to end, using w as the
+     * work row (which must be zero, and is left so).
+     */
+    void factorRows(const QuickMatrix *mat, unsigned begin, unsigned end, double *w);
+
+    std::shared_ptr<const Structure> m_structure;
+    bool m_bStructureCached;
+
+    std::vector<double> m_val;
+
+    mutable std::vector<double> m_work;
+    std::vector<std::vector<double>> m_blockWork; ///< Work rows for the blocks factored in other threads
+};
+
+#endif
@@ -0,0 +1,118 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef STAMPKERNEL_H
+#define STAMPKERNEL_H
+
+#include "element.h"
+
+#include <algorithm>
+
+/**
+Stamps a device with N cnodes (such as a BJT with 3, or a diode with 2) into
+the matrix and right side vector all in one go. Where each entry is stored is
+worked out the first time, and again only when the element set, the cnodes or
+the layout of the matrix change. Stamping then adds straight to the entries
+and marks the matrix as changed once, rather than looking up the cnodes and
+the row mapping for each entry as Element::stampG does.
+@short Stamps a fixed-size device into an ElementSet
+*/
+template<unsigned N> class StampKernel
+{
+public:
+    StampKernel()
+        : m_pElementSet(nullptr)
+        , m_generation(0)
+        , m_changedFrom(0)
+    {
+        for (unsigned i = 0; i < N; ++i)
+            m_cnodes[i] = nullptr;
+    }
+
+    /**
+     * Adds A to the conductances between the cnodes, and I to the currents
+     * into them, skipping the entries of ground cnodes.
+     */
+    void stamp(ElementSet *eSet, CNode *const *cnodes, const double (&A)[N][N], const double (&I)[N])
+    {
+        Matrix *matrix = eSet->matrix();
+        if (eSet != m_pElementSet || matrix->layoutGeneration() != m_generation || !hasCNodes(cnodes))
+            bind(eSet, cnodes);
+
+        bool changed = false;
+        for (unsigned i = 0; i < N; ++i) {
+            for (unsigned j = 0; j < N; ++j) {
+                double *const entry = m_entries[i][j];
+                if (!entry || A[i][j] == 0.)
+                    continue;
+                const double value = *entry + A[i][j];
+                if (value != *entry) {
+                    *entry = value;
+                    changed = true;
+                }
+            }
+        }
+        if (changed)
+            matrix->setChangedFrom(m_changedFrom);
+
+        bool currentChanged = false;
+        for (unsigned i = 0; i < N; ++i) {
+            if (m_currents[i] && I[i] != 0.) {
+                *m_currents[i] += I[i];
+                currentChanged = true;
+            }
+        }
+        if (currentChanged)
+            eSet->b()->setChanged();
+    }
+
+private:
+    bool hasCNodes(CNode *const *cnodes) const
+    {
+        for (unsigned i = 0; i < N; ++i) {
+            if (cnodes[i] != m_cnodes[i])
+                return false;
+        }
+        return true;
+    }
+
+    void bind(ElementSet *eSet, CNode *const *cnodes)
+    {
+        Matrix *matrix = eSet->matrix();
+        double *b = eSet->b()->data();
+
+        m_pElementSet = eSet;
+        m_generation = matrix->layoutGeneration();
+        m_changedFrom = ~0u;
+
+        for (unsigned i = 0; i < N; ++i) {
+            m_cnodes[i] = cnodes[i];
+            m_currents[i] = cnodes[i]->isGround ? nullptr : b + cnodes[i]->n();
+
+            for (unsigned j = 0; j < N; ++j) {
+                if (cnodes[i]->isGround || cnodes[j]->isGround) {
+                    m_entries[i][j] = nullptr;
+                    continue;
+                }
+                m_entries[i][j] = matrix->entry(cnodes[i]->n(), cnodes[j]->n());
+                m_changedFrom = std::min(m_changedFrom, matrix->changedFrom(cnodes[i]->n(), cnodes[j]->n()));
+            }
+        }
+    }
+
+    ElementSet *m_pElementSet;
+    unsigned m_generation; ///< of the layout of the matrix that the entries are in
+    unsigned m_changedFrom;
+    CNode *m_cnodes[N];
+    double *m_entries[N][N];
+    double *m_currents[N];
+};
+
+#endif
@@ -30,6 +30,10 @@ public:
         return Element_VCCS;
     }
     void setGain(const double g);
+    double gain() const
+    {
+        return m_g;
+    }
 
 protected:
     void updateCurrents() override;
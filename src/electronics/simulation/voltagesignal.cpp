@@ -11,10 +11,13 @@
 #include "voltagesignal.h"
 #include "elementset.h"
 
+#include <QDataStream>
+
 VoltageSignal::VoltageSignal(const double delta, const double voltage)
     : Reactive::Reactive(delta)
 {
     m_voltage = voltage;
+    m_stampedVoltage = 0.;
     m_numCNodes = 2;
     m_numCBranches = 1;
 }
@@ -37,13 +40,35 @@ void VoltageSignal::add_initial_dc()
     A_c(0, 0) = -1;
     A_b(1, 0) = 1;
     A_c(0, 1) = 1;
+    m_stampedVoltage = 0.;
 }
 
 void VoltageSignal::time_step()
 {
     if (!b_status)
         return;
-    b_v(0) = m_voltage * advance(m_delta);
+
+    // Only touch the b vector when the voltage changes, so that the circuit
+    // is not solved again while it holds (as with a square wave)
+    const double voltage = m_voltage * advance(m_delta);
+    if (voltage != m_stampedVoltage) {
+        b_v(0) = voltage;
+        m_stampedVoltage = voltage;
+    }
+}
+
+void VoltageSignal::saveState(QDataStream &stream) const
+{
+    stream << m_phase << m_time;
+}
+
+void VoltageSignal::restoreState(QDataStream &stream)
+{
+    stream >> m_phase >> m_time;
+    if (b_status) {
+        m_stampedVoltage = m_voltage * amplitude();
+        b_v(0) = m_stampedVoltage;
+    }
 }
 
 void VoltageSignal::updateCurrents()
@@ -33,7 +33,17 @@ public:
     {
         return m_voltage;
     }
+    /**
+     * @return the voltage of the signal at the present time (the amplitude
+     * times the waveform), as last stamped by time_step
+     */
+    double outputVoltage() const
+    {
+        return m_stampedVoltage;
+    }
     void time_step() override;
+    void saveState(QDataStream &stream) const override;
+    void restoreState(QDataStream &stream) override;
 
 protected:
     void updateCurrents() override;
@@ -41,6 +51,7 @@ protected:
 
 private:
     double m_voltage; // Voltage
+    double m_stampedVoltage; // Voltage last put into the b vector
 };
 
 #endif
@@ -28,6 +28,10 @@ public:
         return Element_VoltageSource;
     }
     void setVoltage(const double v);
+    double voltage() const
+    {
+        return m_v;
+    }
 
 protected:
     void updateCurrents() override;
@@ -0,0 +1,277 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "stimulus.h"
+#include "canvasitemparts.h"
+#include "circuitdocument.h"
+#include "cnitem.h"
+#include "simulator.h"
+#include "variant.h"
+
+#include <KLocalizedString>
+
+#include <QColor>
+#include <QIODevice>
+#include <QRegularExpression>
+#include <QTextStream>
+
+#include <algorithm>
+
+#include <ktechlab_debug.h>
+
+static const char *const typeNames[] = {"button", "slider", "property"};
+
+// BEGIN class Stimulus
+bool Stimulus::load(QIODevice *device, QString *errorMessage)
+{
+    static const QRegularExpression fields("^(\\S+)\\s+(\\S+)\\s+(\\S+)\\s+(\\S+)\\s*(.*)$");
+
+    QTextStream stream(device);
+    QVector<StimulusEvent> events;
+    QString line;
+    int lineNumber = 0;
+    while (stream.readLineInto(&line)) {
+        lineNumber++;
+        line = line.trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        const QRegularExpressionMatch match = fields.match(line);
+        StimulusEvent event;
+        bool ok = match.hasMatch();
+        if (ok)
+            event.time = match.captured(1).toDouble(&ok);
+        if (ok) {
+            const QString typeName = match.captured(3);
+            const char *const *type = std::find(std::begin(typeNames), std::end(typeNames), typeName);
+            ok = (type != std::end(typeNames));
+            if (ok)
+                event.type = StimulusEvent::Type(type - std::begin(typeNames));
+        }
+        if (!ok || event.time < 0.) {
+            *errorMessage = i18n("Line %1 is not a change of the form \"time item button|slider|property id value\": %2", lineNumber, line);
+            return false;
+        }
+
+        event.item = match.captured(2);
+        event.id = match.captured(4);
+        event.value = match.captured(5);
+        events.append(event);
+    }
+
+    if (stream.status() != QTextStream::Ok) {
+        *errorMessage = device->errorString();
+        return false;
+    }
+
+    // Changes at the same time are made in the order they are in the file
+    m_events += events;
+    std::stable_sort(m_events.begin(), m_events.end(), [](const StimulusEvent &a, const StimulusEvent &b) {
+        return a.time < b.time;
+    });
+    return true;
+}
+
+bool Stimulus::save(QIODevice *device) const
+{
+    QTextStream stream(device);
+    stream << "# KTechlab stimulus: time (s), item, button|slider|property, id, value\n";
+    for (const StimulusEvent &event : m_events)
+        stream << QString::number(event.time, 'g', 12) << ' ' << event.item << ' ' << typeNames[event.type] << ' ' << event.id << ' ' << event.value << '\n';
+
+    stream.flush();
+    return stream.status() == QTextStream::Ok;
+}
+// END class Stimulus
+
+// BEGIN class StimulusRecorder
+StimulusRecorder::StimulusRecorder()
+{
+    SimulationLocker locker;
+    m_startStep = Simulator::self()->stepNumber();
+}
+
+void StimulusRecorder::recordButton(const QString &item, const QString &id, bool state)
+{
+    record(item, StimulusEvent::Button, id, state ? "1" : "0");
+}
+
+void StimulusRecorder::recordSlider(const QString &item, const QString &id, int value)
+{
+    record(item, StimulusEvent::Slider, id, QString::number(value));
+}
+
+void StimulusRecorder::recordProperty(const QString &item, const Variant *property)
+{
+    const QVariant value = property->value();
+
+    switch (property->type()) {
+    case Variant::Type::Raw:
+    case Variant::Type::None:
+        return;
+    case Variant::Type::Int:
+    case Variant::Type::Double:
+        record(item, StimulusEvent::Property, property->id(), QString::number(value.toDouble(), 'g', 17));
+        return;
+    case Variant::Type::Bool:
+        record(item, StimulusEvent::Property, property->id(), value.toBool() ? "1" : "0");
+        return;
+    case Variant::Type::Color:
+        record(item, StimulusEvent::Property, property->id(), value.value<QColor>().name());
+        return;
+    default:
+        record(item, StimulusEvent::Property, property->id(), value.toString());
+        return;
+    }
+}
+
+void StimulusRecorder::record(const QString &item, StimulusEvent::Type type, const QString &id, const QString &value)
+{
+    long long step;
+    {
+        SimulationLocker locker;
+        step = Simulator::self()->stepNumber();
+    }
+
+    StimulusEvent event;
+    event.time = double(step - m_startStep) / LINEAR_UPDATE_RATE;
+    event.item = item;
+    event.type = type;
+    event.id = id;
+    // Only the first line of multiline text fits on the line of the change
+    event.value = value.section('\n', 0, 0);
+    m_stimulus.append(event);
+}
+// END class StimulusRecorder
+
+// BEGIN class StimulusPlayer
+StimulusPlayer::StimulusPlayer(CircuitDocument *circuitDocument, const Stimulus &stimulus, long long startStep)
+    : QObject(circuitDocument)
+    , p_circuitDocument(circuitDocument)
+    , m_stimulus(stimulus)
+    , m_startStep(startStep)
+    , m_next(0)
+{
+    updateNextStep();
+}
+
+StimulusPlayer::~StimulusPlayer()
+{
+    if (!Simulator::isDestroyedSim() && Simulator::self()->stimulusPlayer() == this)
+        Simulator::self()->setStimulusPlayer(nullptr);
+}
+
+void StimulusPlayer::updateNextStep()
+{
+    if (m_next >= m_stimulus.events().size())
+        m_nextStep = -1;
+    else
+        m_nextStep = m_startStep + qRound64(m_stimulus.events()[m_next].time * LINEAR_UPDATE_RATE);
+}
+
+void StimulusPlayer::applyDue(long long step)
+{
+    CircuitDocument *circuitDocument = p_circuitDocument;
+
+    {
+        SimulationLocker locker;
+        while (m_nextStep >= 0 && m_nextStep <= step) {
+            const StimulusEvent &event = m_stimulus.events()[m_next++];
+            if (!circuitDocument || !apply(event))
+                qCWarning(KTL_LOG) << "Could not make the change of the stimulus to" << event.item << typeNames[event.type] << event.id;
+            updateNextStep();
+        }
+
+        // The circuits are remade (e.g. for a switch that has joined two of
+        // them) before the next step, rather than when the event loop gets to
+        // it, so the simulation is the same each time
+        if (circuitDocument)
+            circuitDocument->assignPendingCircuits();
+    }
+
+    if (m_nextStep < 0) {
+        if (Simulator::self()->stimulusPlayer() == this)
+            Simulator::self()->setStimulusPlayer(nullptr);
+        emit finished();
+    }
+}
+
+bool StimulusPlayer::apply(const StimulusEvent &event)
+{
+    CNItem *item = dynamic_cast<CNItem *>(p_circuitDocument->itemWithID(event.item));
+    if (!item)
+        return false;
+
+    switch (event.type) {
+    case StimulusEvent::Button: {
+        Button *button = item->button(event.id);
+        if (!button)
+            return false;
+
+        const bool state = (event.value == "1");
+        if (button->state() != state)
+            button->setState(state);
+        else {
+            // The item was told of the change, but the button was left as
+            // it was (as for the release of a toggle button)
+            item->buttonStateChanged(event.id, state);
+        }
+        return true;
+    }
+    case StimulusEvent::Slider: {
+        Slider *slider = item->slider(event.id);
+        bool ok = false;
+        const int value = event.value.toInt(&ok);
+        if (!slider || !ok)
+            return false;
+
+        slider->setValue(value);
+        return true;
+    }
+    case StimulusEvent::Property: {
+        if (!item->hasProperty(event.id))
+            return false;
+
+        Property *property = item->property(event.id);
+        switch (property->type()) {
+        case Variant::Type::Raw:
+        case Variant::Type::None:
+            return false;
+        case Variant::Type::Int:
+        case Variant::Type::Double: {
+            bool ok = false;
+            const double value = event.value.toDouble(&ok);
+            if (!ok)
+                return false;
+            property->setValue(value);
+            break;
+        }
+        case Variant::Type::Bool:
+            property->setValue(QVariant(event.value == "1" || event.value == "true"));
+            break;
+        case Variant::Type::Color:
+            property->setValue(QColor(event.value));
+            break;
+        default:
+            property->setValue(event.value);
+            break;
+        }
+
+        // Rather than from a timer, as when the user changes it
+        item->applyPropertyChanges();
+        return true;
+    }
+    }
+
+    return false;
+}
+// END class StimulusPlayer
+
+#include "moc_stimulus.cpp"
@@ -0,0 +1,179 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef STIMULUS_H
+#define STIMULUS_H
+
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QVector>
+
+class CircuitDocument;
+class QIODevice;
+class Variant;
+
+/**
+A change made to an item of a circuit while it is being simulated, as the user
+would make it: pressing or releasing a button (e.g. of a push switch or a
+keypad), moving a slider (e.g. of a potentiometer), or setting a property.
+*/
+class StimulusEvent
+{
+public:
+    enum Type { Button, Slider, Property };
+
+    double time; ///< in seconds from the start of the stimulus
+    QString item; ///< the id of the item
+    Type type;
+    QString id; ///< of the button, slider or property
+    QString value; ///< 0 or 1 for a button
+};
+
+/**
+Changes to make to the items of a circuit at given times, so that a circuit
+that is normally driven with the mouse can be simulated the same way each
+time (e.g. for measuring how fast it is simulated).
+
+The file is text, with a change on each line: the time in seconds, the id of
+the item, one of "button", "slider" or "property", the id of the button,
+slider or property, and the value, separated by whitespace. The value is the
+rest of the line, so may have spaces in it. Blank lines and lines starting
+with '#' are skipped. For example:
+
+    # Press and release the button of a push switch
+    0.1 ptm_switch__1 button button 1
+    0.15 ptm_switch__1 button button 0
+    0.2 potentiometer__2 slider slider 250
+    0.3 resistor__3 property resistance 2200
+
+@short Changes to replay on a circuit
+*/
+class Stimulus
+{
+public:
+    /**
+     * Reads the stimulus from the device, adding to any changes already
+     * read. The changes are kept in order of time.
+     * @param errorMessage set to what went wrong if this fails
+     * @return true if successful
+     */
+    bool load(QIODevice *device, QString *errorMessage);
+    /**
+     * Writes the stimulus to the device.
+     * @return true if successful
+     */
+    bool save(QIODevice *device) const;
+
+    /**
+     * Adds a change, which must not come before the last one.
+     */
+    void append(const StimulusEvent &event)
+    {
+        m_events.append(event);
+    }
+    const QVector<StimulusEvent> &events() const
+    {
+        return m_events;
+    }
+    bool isEmpty() const
+    {
+        return m_events.isEmpty();
+    }
+
+protected:
+    QVector<StimulusEvent> m_events;
+};
+
+/**
+Records the changes the user makes to the items of a circuit, timed from when
+the recorder is created. The buttons, sliders and items of the document tell
+it of their changes through ItemDocument::stimulusRecorder.
+*/
+class StimulusRecorder
+{
+public:
+    StimulusRecorder();
+
+    void recordButton(const QString &item, const QString &id, bool state);
+    void recordSlider(const QString &item, const QString &id, int value);
+    /**
+     * Records the value that the property has been set to. Properties that
+     * cannot be written as text (raw data) are not recorded.
+     */
+    void recordProperty(const QString &item, const Variant *property);
+    const Stimulus &stimulus() const
+    {
+        return m_stimulus;
+    }
+
+protected:
+    void record(const QString &item, StimulusEvent::Type type, const QString &id, const QString &value);
+
+    long long m_startStep; ///< the linear step of the simulator that the recording started at
+    Stimulus m_stimulus;
+};
+
+/**
+Replays a Stimulus on a circuit document. While it is set on the simulator
+(with Simulator::setStimulusPlayer), the changes are made between linear
+steps, at the step that each is due in, so replaying the same stimulus gives
+the same simulation. The changes are made from the GUI thread, in the same way
+as when the user makes them.
+*/
+class StimulusPlayer : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @param startStep the linear step of the simulator that the stimulus
+     * starts at
+     */
+    StimulusPlayer(CircuitDocument *circuitDocument, const Stimulus &stimulus, long long startStep);
+    ~StimulusPlayer() override;
+
+    /**
+     * @return the linear step of the simulator that the next change is due
+     * in, or -1 if all of them have been made
+     */
+    long long nextStep() const
+    {
+        return m_nextStep;
+    }
+    /**
+     * Makes the changes that are due by the given linear step of the
+     * simulator. Called by the simulator from the GUI thread.
+     */
+    void applyDue(long long step);
+
+signals:
+    /**
+     * Emitted once the last change has been made.
+     */
+    void finished();
+
+protected:
+    /**
+     * Makes the change to the item, as the user would.
+     * @return false if the circuit does not have the item or what is to be
+     * changed in it
+     */
+    bool apply(const StimulusEvent &event);
+    void updateNextStep();
+
+    QPointer<CircuitDocument> p_circuitDocument;
+    Stimulus m_stimulus;
+    long long m_startStep;
+    int m_next; ///< the index of the next change in m_stimulus
+    long long m_nextStep;
+};
+
+#endif
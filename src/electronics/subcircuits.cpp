@@ -21,6 +21,7 @@
 
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QStandardPaths>
 #include <QTextStream>
 
@@ -46,18 +47,43 @@ static QList<int> asIntList(const QString &string)
 }
 
 void Subcircuits::initECSubcircuit(int subcircuitId, ECSubcircuit *ecSubcircuit)
+{
+    const SubcircuitData *subcircuitTemplate = subcircuits()->subcircuitTemplate(subcircuitId);
+    if (!subcircuitTemplate)
+        return;
+
+    // The template is copied, so it can be used again for the next instance
+    SubcircuitData subcircuit = *subcircuitTemplate;
+    subcircuit.initECSubcircuit(ecSubcircuit);
+}
+
+const SubcircuitData *Subcircuits::subcircuitTemplate(int subcircuitId)
 {
     const QString fileName = genFileName(subcircuitId);
-    if (!QFile::exists(fileName)) {
+    const QFileInfo fileInfo(fileName);
+    if (!fileInfo.exists()) {
         qCDebug(KTL_LOG) << "Subcircuits::createSubcircuit: Subcircuit \"" << fileName << "\" was not found.";
-        return;
+        m_templates.remove(subcircuitId);
+        return nullptr;
     }
 
-    SubcircuitData subcircuit;
-    if (!subcircuit.loadData(QUrl::fromLocalFile(genFileName(subcircuitId))))
-        return;
+    QHash<int, SubcircuitTemplate>::iterator it = m_templates.find(subcircuitId);
+    if (it != m_templates.end()) {
+        if (it.value().lastModified == fileInfo.lastModified() && it.value().size == fileInfo.size())
+            return &it.value().data;
 
-    subcircuit.initECSubcircuit(ecSubcircuit);
+        // The file has changed since it was read
+        m_templates.erase(it);
+    }
+
+    SubcircuitTemplate subcircuitTemplate;
+    if (!subcircuitTemplate.data.loadData(QUrl::fromLocalFile(fileName)))
+        return nullptr;
+
+    subcircuitTemplate.data.compile();
+    subcircuitTemplate.lastModified = fileInfo.lastModified();
+    subcircuitTemplate.size = fileInfo.size();
+    return &m_templates.insert(subcircuitId, subcircuitTemplate).value().data;
 }
 
 ECSubcircuit *Subcircuits::createSubcircuit(int id, CircuitDocument *circuitDocument, bool newItem, const char *newId)
@@ -137,6 +163,7 @@ void Subcircuits::addSubcircuit(const QString &name, const QString &subcircuitXm
     QTextStream stream(&file);
     stream << subcircuitXml;
     file.close();
+    subcircuits()->m_templates.remove(id);
 
     QList<int> idList = asIntList(subcircGroup.readEntry<QString>(QString("Ids"), QString()));
     idList += id;
@@ -161,6 +188,7 @@ void Subcircuits::slotItemRemoved(const QString &id)
     QString temp = id;
     temp.remove("sc/");
     const int id_num = temp.toInt();
+    m_templates.remove(id_num);
     const QString fileName = genFileName(id_num);
     QFile file(fileName);
     file.remove();
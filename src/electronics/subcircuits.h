@@ -11,6 +11,10 @@
 #ifndef SUBCIRCUITS_H
 #define SUBCIRCUITS_H
 
+#include "itemdocumentdata.h"
+
+#include <QDateTime>
+#include <QHash>
 #include <QObject>
 
 class CircuitDocument;
@@ -62,6 +66,19 @@ protected slots:
 
 private:
     Subcircuits();
+    /**
+     * The subcircuit as read from its file and compiled, ready to be copied
+     * for each instance of it. This is kept until the file changes.
+     * @return the template, or nullptr if the file could not be read
+     */
+    const SubcircuitData *subcircuitTemplate(int subcircuitId);
+
+    struct SubcircuitTemplate {
+        SubcircuitData data;
+        QDateTime lastModified;
+        qint64 size = 0;
+    };
+    QHash<int, SubcircuitTemplate> m_templates;
 
     friend Subcircuits *subcircuits();
 };
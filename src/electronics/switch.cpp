@@ -24,12 +24,18 @@
 
 #include <ktechlab_debug.h>
 
+// The conductances of the switch when it is a resistance (a milliohm closed,
+// a gigaohm open)
+static const double closed_conductance = 1e3;
+static const double open_conductance = 1e-9;
+
 Switch::Switch(Component *parent, Pin *p1, Pin *p2, State state)
 {
     m_bouncePeriod_ms = 5;
     m_bBounce = false;
     m_bounceStart = 0;
     m_pBounceResistance = nullptr;
+    m_pStamp = nullptr;
     m_pP1 = p1;
     m_pP2 = p2;
     m_pComponent = parent;
@@ -43,6 +49,9 @@ Switch::Switch(Component *parent, Pin *p1, Pin *p2, State state)
 
 Switch::~Switch()
 {
+    if (m_pStamp)
+        m_pComponent->removeElement(m_pStamp, true);
+
     if (m_pP1)
         m_pP1->setSwitchConnected(m_pP2, false);
     if (m_pP2)
@@ -56,6 +65,9 @@ void Switch::setState(State state)
 
     m_state = state;
 
+    if (!m_pStamp)
+        tryCreateStamp();
+
     if (m_bBounce)
         startBouncing();
     else {
@@ -70,8 +82,36 @@ void Switch::setBounce(bool bounce, int msec)
     m_bouncePeriod_ms = msec;
 }
 
+void Switch::tryCreateStamp()
+{
+    // When opening, the pins are joined by the switch itself, so whether
+    // they would still be in the same partition is not known
+    if (m_state != Closed || !m_pP1 || !m_pP2)
+        return;
+
+    CircuitDocument *cd = m_pComponent->circuitDocument();
+    if (!cd || !cd->inSameAnalogPartition(m_pP1, m_pP2))
+        return;
+
+    m_pStamp = m_pComponent->createResistance(m_pP1, m_pP2, 1. / open_conductance);
+    cd->requestAssignCircuits();
+}
+
+double Switch::stampConductance() const
+{
+    return (m_state == Closed) ? closed_conductance : open_conductance;
+}
+
 void Switch::startBouncing()
 {
+    if (m_pStamp) {
+        // The stamp bounces instead of having a resistance of its own
+        m_bounceStart = Simulator::self()->time();
+        srand(time(nullptr));
+        bounce();
+        return;
+    }
+
     if (m_pBounceResistance) {
         // Already active?
         return;
@@ -116,12 +156,21 @@ void Switch::bounce()
 
     // 4th power of the conductance seems to give a nice distribution
     g = pow(g, 4);
-    m_pBounceResistance->setConductance(g);
+    if (m_pStamp)
+        m_pStamp->setConductance(g);
+    else if (m_pBounceResistance)
+        m_pBounceResistance->setConductance(g);
 }
 
 void Switch::stopBouncing()
 {
     //	Simulator::self()->detachSwitch( this );
+    if (m_pStamp) {
+        // Only the value changes, so the circuits stay as they are
+        m_pStamp->setConductance(stampConductance());
+        return;
+    }
+
     m_pComponent->removeElement(m_pBounceResistance, true);
     m_pBounceResistance = nullptr;
 
@@ -141,7 +190,9 @@ bool Switch::calculateCurrent()
     if (!m_pP1 || !m_pP2)
         return false;
 
-    if (state() == Open) {
+    // The current through the stamp is given to the pins with those of the
+    // other elements of the component
+    if (state() == Open || m_pStamp) {
         m_pP1->setSwitchCurrentKnown(this);
         m_pP2->setSwitchCurrentKnown(this);
         return true;
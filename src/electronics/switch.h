@@ -21,6 +21,12 @@ class Resistance;
 class QTimer;
 
 /**
+A switch between two pins. Closing the switch joins the pins as a wire would,
+which changes how the circuits are made up, and so the circuits have to be
+reassigned. Where the pins are in the same analog circuit partition anyway
+(e.g. the switches of a keypad, which are joined through the rest of the
+circuit), the switch is instead put in the circuit as a resistance of very
+low or very high value, so that pressing it only changes the value.
 @author David Saxton
 */
 
@@ -71,11 +77,22 @@ protected slots:
 
 protected:
     void startBouncing();
+    /**
+     * Puts the switch in the circuit as a resistance (m_pStamp), if the
+     * switch is being closed and the pins are in the same analog partition.
+     * The circuits are then reassigned this once.
+     */
+    void tryCreateStamp();
+    /**
+     * @return the conductance of m_pStamp for the present state
+     */
+    double stampConductance() const;
 
     bool m_bBounce;
     int m_bouncePeriod_ms;
     unsigned long long m_bounceStart; // Simulator time that bouncing started
     Resistance *m_pBounceResistance;
+    Resistance *m_pStamp; // The switch as a resistance, if the pins are not joined as by a wire
     State m_state;
     Component *m_pComponent;
     QPointer<Pin> m_pP1;
@@ -0,0 +1,208 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "telemetrystream.h"
+#include "ecnode.h"
+#include "pin.h"
+#include "probe.h"
+#include "simulator.h"
+
+#include <QSharedMemory>
+#include <QUuid>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+#include <ktechlab_debug.h>
+
+static_assert(sizeof(TelemetryHeader) <= TelemetryStream::HEADER_SIZE, "TelemetryHeader does not fit");
+static_assert(offsetof(TelemetryHeader, written) == 32, "TelemetryHeader is not laid out as documented");
+static_assert(offsetof(TelemetryHeader, names) == 64, "TelemetryHeader is not laid out as documented");
+
+TelemetryStream::TelemetryStream(QObject *parent)
+    : QObject(parent)
+    , m_pMemory(nullptr)
+    , m_pHeader(nullptr)
+    , m_pRing(nullptr)
+    , m_written(0)
+    , m_recordSize(sizeof(quint64))
+    , m_capacity(0)
+{
+}
+
+TelemetryStream::~TelemetryStream()
+{
+    delete m_pMemory;
+}
+
+QString TelemetryStream::key()
+{
+    if (m_pMemory)
+        return m_pMemory->key();
+
+    QSharedMemory *memory = new QSharedMemory(QStringLiteral("ktechlab-telemetry-") + QUuid::createUuid().toString(QUuid::WithoutBraces));
+    if (!memory->create(HEADER_SIZE + RING_SIZE)) {
+        qCWarning(KTL_LOG) << "could not create the telemetry memory:" << memory->errorString();
+        delete memory;
+        return QString();
+    }
+
+    uchar *data = static_cast<uchar *>(memory->data());
+    std::memset(data, 0, HEADER_SIZE);
+    TelemetryHeader *header = new (data) TelemetryHeader;
+    header->magic = MAGIC;
+    header->version = VERSION;
+    header->layout.store(0);
+    header->written.store(0);
+    header->stepPeriod = 1. / LINEAR_UPDATE_RATE;
+    header->timeUnitsPerSecond = LOGIC_UPDATE_RATE;
+
+    SimulationLocker locker;
+    m_pMemory = memory;
+    m_pHeader = header;
+    m_pRing = data + HEADER_SIZE;
+    writeLayout();
+
+    return m_pMemory->key();
+}
+
+bool TelemetryStream::watchNode(const QString &name, const ECNode *node)
+{
+    if (!node)
+        return false;
+
+    if (!addChannel({name, node, nullptr}))
+        return false;
+
+    connect(node, &Node::removed, this, &TelemetryStream::slotNodeRemoved, Qt::UniqueConnection);
+    return true;
+}
+
+bool TelemetryStream::watchProbe(const QString &name, const Probe *probe)
+{
+    if (!probe)
+        return false;
+
+    if (!addChannel({name, nullptr, probe}))
+        return false;
+
+    connect(probe, &Item::removed, this, &TelemetryStream::slotItemRemoved, Qt::UniqueConnection);
+    return true;
+}
+
+bool TelemetryStream::addChannel(const Channel &channel)
+{
+    if (channel.name.isEmpty() || m_channels.size() >= unsigned(TelemetryHeader::MAX_CHANNELS) || channelNames().contains(channel.name))
+        return false;
+
+    SimulationLocker locker;
+    m_channels.push_back(channel);
+    writeLayout();
+    return true;
+}
+
+bool TelemetryStream::unwatch(const QString &name)
+{
+    SimulationLocker locker;
+    const std::vector<Channel>::iterator it = std::find_if(m_channels.begin(), m_channels.end(), [&name](const Channel &channel) {
+        return channel.name == name;
+    });
+    if (it == m_channels.end())
+        return false;
+
+    m_channels.erase(it);
+    writeLayout();
+    return true;
+}
+
+void TelemetryStream::unwatchAll()
+{
+    SimulationLocker locker;
+    m_channels.clear();
+    writeLayout();
+}
+
+QStringList TelemetryStream::channelNames() const
+{
+    QStringList names;
+    for (const Channel &channel : m_channels)
+        names << channel.name;
+    return names;
+}
+
+void TelemetryStream::slotNodeRemoved(Node *node)
+{
+    SimulationLocker locker;
+    m_channels.erase(std::remove_if(m_channels.begin(), m_channels.end(), [node](const Channel &channel) {
+                         return channel.node == node;
+                     }),
+                     m_channels.end());
+    writeLayout();
+}
+
+void TelemetryStream::slotItemRemoved(Item *item)
+{
+    SimulationLocker locker;
+    m_channels.erase(std::remove_if(m_channels.begin(), m_channels.end(), [item](const Channel &channel) {
+                         return channel.probe && static_cast<const Item *>(channel.probe) == item;
+                     }),
+                     m_channels.end());
+    writeLayout();
+}
+
+void TelemetryStream::writeLayout()
+{
+    m_recordSize = sizeof(quint64) + sizeof(double) * m_channels.size();
+    m_capacity = RING_SIZE / m_recordSize;
+    m_written = 0;
+
+    if (!m_pHeader)
+        return;
+
+    // As a sequence lock: readers that see an odd layout, or a different
+    // one after reading, start again
+    const quint32 layout = m_pHeader->layout.load(std::memory_order_relaxed);
+    m_pHeader->layout.store(layout + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_pHeader->channelCount = m_channels.size();
+    m_pHeader->recordSize = m_recordSize;
+    m_pHeader->capacity = m_capacity;
+    m_pHeader->written.store(0, std::memory_order_relaxed);
+    std::memset(m_pHeader->names, 0, sizeof(m_pHeader->names));
+    for (size_t i = 0; i < m_channels.size(); ++i) {
+        const QByteArray name = m_channels[i].name.toUtf8().left(TelemetryHeader::NAME_SIZE - 1);
+        std::memcpy(m_pHeader->names[i], name.constData(), name.size());
+    }
+
+    m_pHeader->layout.store(layout + 2, std::memory_order_release);
+}
+
+void TelemetryStream::publish(quint64 time)
+{
+    uchar *record = m_pRing + (m_written % m_capacity) * m_recordSize;
+    std::memcpy(record, &time, sizeof(time));
+
+    double *values = reinterpret_cast<double *>(record + sizeof(time));
+    for (const Channel &channel : m_channels) {
+        if (channel.probe) {
+            *values++ = channel.probe->value();
+        } else {
+            const Pin *pin = channel.node->pin();
+            *values++ = pin ? pin->voltage() : 0.;
+        }
+    }
+
+    m_pHeader->written.store(++m_written, std::memory_order_release);
+}
+
+#include "moc_telemetrystream.cpp"
@@ -0,0 +1,159 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef TELEMETRYSTREAM_H
+#define TELEMETRYSTREAM_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+#include <vector>
+
+class ECNode;
+class Item;
+class Node;
+class Probe;
+class QSharedMemory;
+
+/**
+The start of the block of shared memory written by TelemetryStream. All the
+fields are in the byte order of the machine, at the offsets given.
+
+The channels (the names and the number of them) are only changed with layout
+odd, and written is set back to 0 at the same time, so a reader should take
+layout before and after reading anything else, and start again if it was odd
+or has changed.
+*/
+struct TelemetryHeader {
+    static const int MAX_CHANNELS = 64;
+    static const int NAME_SIZE = 32;
+
+    quint32 magic; ///< 0: TelemetryStream::MAGIC
+    quint32 version; ///< 4: TelemetryStream::VERSION
+    std::atomic<quint32> layout; ///< 8: incremented before and after the channels change
+    quint32 channelCount; ///< 12
+    quint32 recordSize; ///< 16: in bytes, 8 + 8 * channelCount
+    quint32 capacity; ///< 20: the number of records that the ring holds
+    double stepPeriod; ///< 24: the simulated time between records, in seconds
+    std::atomic<quint64> written; ///< 32: the number of records written
+    quint32 timeUnitsPerSecond; ///< 40: of the time at the start of each record
+    quint32 reserved[5]; ///< 44
+    char names[MAX_CHANNELS][NAME_SIZE]; ///< 64: UTF-8, padded with zeros
+};
+
+/**
+Publishes the values of a watch list of nodes and probes after each linear
+step of the Simulator, into a ring buffer in a block of shared memory (see
+QSharedMemory), so that other processes (such as dashboards for testing
+hardware in the loop) can follow the simulation at its full rate without
+going through Qt signals or D-Bus.
+
+The block starts with a TelemetryHeader, and the ring of records starts
+HEADER_SIZE bytes in. Record i (counting from 0 since the channels last
+changed) is at (i % capacity) * recordSize from the start of the ring: the
+simulator time at the end of the step as a quint64, followed by the value of
+each channel as a double (volts for nodes, and what the probe shows for
+probes).
+
+The watch list is set from outside through the session bus, with the
+watchNodeTelemetry and watchProbeTelemetry calls of the circuit document (see
+CircuitDocumentAdaptor), and telemetryKey gives the key to attach with.
+
+There is only one writer, which fills in a record before storing the new
+count of records in written (with release semantics), so nothing is locked.
+A reader loads written (with acquire semantics), copies the records it has
+not seen yet, and loads written again; records older than the second count
+less capacity may have been overwritten while being copied, and so are to be
+thrown away.
+
+@short Lock-free stream of simulated values through shared memory
+*/
+class TelemetryStream : public QObject
+{
+    Q_OBJECT
+public:
+    static const quint32 MAGIC = 0x4b544c54; // "TLTK" in memory, on little endian machines
+    static const quint32 VERSION = 1;
+    static const int HEADER_SIZE = 4096;
+    static const int RING_SIZE = 4 * 1024 * 1024;
+
+    explicit TelemetryStream(QObject *parent = nullptr);
+    ~TelemetryStream() override;
+
+    /**
+     * Creates the block of shared memory if it has not been created yet.
+     * @return the key to attach to the block with, or an empty string if it
+     * could not be created
+     */
+    QString key();
+    /**
+     * Adds the voltage of the node to the channels.
+     * @return false if the name is empty or already taken, or there are
+     * already TelemetryHeader::MAX_CHANNELS channels
+     */
+    bool watchNode(const QString &name, const ECNode *node);
+    /**
+     * Adds the value of the probe (see Probe::value) to the channels.
+     * @see watchNode
+     */
+    bool watchProbe(const QString &name, const Probe *probe);
+    /**
+     * Removes the channel with the given name.
+     * @return false if there is no such channel
+     */
+    bool unwatch(const QString &name);
+    void unwatchAll();
+    QStringList channelNames() const;
+
+    /**
+     * @return whether publish has anything to do
+     */
+    bool isPublishing() const
+    {
+        return m_pHeader && !m_channels.empty();
+    }
+    /**
+     * Writes the current values of the channels as the next record. Called
+     * by the Simulator, with the simulation locked, after each linear step.
+     */
+    void publish(quint64 time);
+
+protected slots:
+    void slotNodeRemoved(Node *node);
+    void slotItemRemoved(Item *item);
+
+protected:
+    class Channel
+    {
+    public:
+        QString name;
+        const ECNode *node;
+        const Probe *probe;
+    };
+
+    bool addChannel(const Channel &channel);
+    /**
+     * Writes the channels to the header, and starts the ring again. The
+     * simulation must be locked.
+     */
+    void writeLayout();
+
+    std::vector<Channel> m_channels;
+    QSharedMemory *m_pMemory;
+    TelemetryHeader *m_pHeader; ///< In m_pMemory, or null if not created
+    uchar *m_pRing;
+    quint64 m_written;
+    quint32 m_recordSize;
+    quint32 m_capacity;
+};
+
+#endif
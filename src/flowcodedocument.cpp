@@ -50,6 +50,8 @@ FlowCodeDocument::FlowCodeDocument(const QString &caption)
     m_fileExtensionInfo = QString("*.flowcode|FlowCode (*.flowcode)\n*|%1").arg(i18n("All Files"));
     m_fileExtensionValue = QString(".flowcode");
     requestStateSave();
+
+    connect(this, &FlowCodeDocument::connectorAdded, this, [this]() { invalidateFlowPartCode(); });
 }
 
 FlowCodeDocument::~FlowCodeDocument()
@@ -69,6 +71,21 @@ View *FlowCodeDocument::createView(ViewContainer *viewContainer, uint viewAreaId
     return view;
 }
 
+void FlowCodeDocument::invalidateFlowPartCode(const FlowPart *part)
+{
+    if (part)
+        m_flowPartCode.remove(part);
+    else
+        m_flowPartCode.clear();
+}
+
+void FlowCodeDocument::flushDeleteList()
+{
+    // The deleted items could be those that the code refers to
+    invalidateFlowPartCode();
+    FlowICNDocument::flushDeleteList();
+}
+
 void FlowCodeDocument::setPicType(const QString &id)
 {
     if (m_microSettings && m_microSettings->microInfo() && m_microSettings->microInfo()->id() == id)
@@ -11,6 +11,7 @@
 #ifndef FLOWCODEDOCUMENT_H
 #define FLOWCODEDOCUMENT_H
 
+#include "flowcode.h"
 #include "flowicndocument.h"
 
 #include <QPointer>
@@ -54,6 +55,20 @@ public:
      * (such as compilage) can be done.
      */
     void setPicType(const QString &id);
+    /**
+     * The code generated by each FlowPart when the document was last converted,
+     * kept until the part or the connections between the parts change.
+     */
+    FlowPartCodeMap *flowPartCode()
+    {
+        return &m_flowPartCode;
+    }
+    /**
+     * Forgets the code generated by the FlowPart, or by all the parts if
+     * part is null.
+     */
+    void invalidateFlowPartCode(const FlowPart *part = nullptr);
+    void flushDeleteList() override;
 
     enum ConvertToTarget { MicrobeOutput, AssemblyOutput, HexOutput, PICOutput };
 
@@ -93,6 +108,7 @@ private:
     MicroSettings *m_microSettings; // Stores initial settings of the PIC
     PicItem *m_picItem;             // Allows the user to change the PIC settings
     StringIntMap m_varNames;
+    FlowPartCodeMap m_flowPartCode;
 };
 
 #endif
@@ -183,35 +183,27 @@ void FlowContainer::updateConnectorPoints(bool add)
     // Top strip
     for (int y = _y; y < _y + 24; ++y) {
         for (int x = _x; x <= _x + w; x += 8) {
-            if (cells->haveCellContaing(x, y)) {
-                cells->cellContaining(x, y).CIpenalty += mult * ICNDocument::hs_item;
-            }
+            cells->cellContaining(x, y).CIpenalty += mult * ICNDocument::hs_item;
         }
     }
 
     // Bottom strip
     for (int y = _y + h - 16; y <= _y + h; ++y) {
         for (int x = _x; x <= _x + width(); x += 8) {
-            if (cells->haveCellContaing(x, y)) {
-                cells->cellContaining(x, y).CIpenalty += mult * ICNDocument::hs_item;
-            }
+            cells->cellContaining(x, y).CIpenalty += mult * ICNDocument::hs_item;
         }
     }
 
     // Left strip
     int x = _x;
     for (int y = _y + 24; y < _y + h - 16; y += 8) {
-        if (cells->haveCellContaing(x, y)) {
-            cells->cellContaining(x, y).CIpenalty += mult * ICNDocument::hs_item;
-        }
+        cells->cellContaining(x, y).CIpenalty += mult * ICNDocument::hs_item;
     }
 
     // Right strip
     x = _x + width();
     for (int y = _y + 24; y < _y + h - 16; y += 8) {
-        if (cells->haveCellContaing(x, y)) {
-            cells->cellContaining(x, y).CIpenalty += mult * ICNDocument::hs_item;
-        }
+        cells->cellContaining(x, y).CIpenalty += mult * ICNDocument::hs_item;
     }
 }
 
@@ -314,7 +314,7 @@ void FlowICNDocument::flushDeleteList()
         m_selectList->removeQCanvasItem(*it);
 
         if (Item *item = dynamic_cast<Item *>(qcanvasItem))
-            m_itemList.remove(item->id());
+            unlistItem(item->id());
 
         else if (FPNode *node = dynamic_cast<FPNode *>(qcanvasItem))
             m_flowNodeList.remove(node->id());
@@ -360,6 +360,7 @@ bool FlowICNDocument::registerItem(KtlQCanvasItem *qcanvasItem)
             emit nodeAdded(static_cast<Node *>(node));
         } else if (Connector *connector = dynamic_cast<Connector *>(qcanvasItem)) {
             m_connectorList.append(connector);
+            setHandleItem(connector->id(), connector);
             emit connectorAdded(connector);
         } else {
             qCCritical(KTL_LOG) << "Unrecognised item";
@@ -0,0 +1,849 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "flowinterpreter.h"
+#include "document.h"
+#include "itemdocumentdata.h"
+#include "simulator.h"
+
+#include <KLocalizedString>
+
+#include <QFile>
+#include <QSet>
+#include <QVarLengthArray>
+
+#include <algorithm>
+
+// Instruction cycles taken by the parts, roughly as compiled by microbe
+static const int cycles_simple = 1; // e.g. bsf
+static const int cycles_branch = 2; // e.g. goto
+static const int cycles_test = 3; // e.g. btfss and goto
+static const int cycles_compare = 6; // e.g. movf, subwf, btfss and goto
+static const int cycles_call = 4; // call and return
+
+// BEGIN Expression operators
+// The operators that are not a single character of the text
+static const int op_negate = 'n';
+static const int op_shiftLeft = 'l';
+static const int op_shiftRight = 'r';
+
+static int precedence(int op)
+{
+    switch (op) {
+    case op_negate:
+    case '~':
+        return 7;
+    case '*':
+    case '/':
+    case '%':
+        return 6;
+    case '+':
+    case '-':
+        return 5;
+    case op_shiftLeft:
+    case op_shiftRight:
+        return 4;
+    case '&':
+        return 3;
+    case '^':
+        return 2;
+    case '|':
+        return 1;
+    }
+    return 0;
+}
+
+static bool isUnary(int op)
+{
+    return (op == op_negate) || (op == '~');
+}
+// END Expression operators
+
+/**
+ * @return the index (0 for A) of the port of a register such as "PORTA" or
+ * "TRISA", or -1 if name is not such a register
+ */
+static int portIndex(const QString &name, const QString &prefix)
+{
+    if ((name.length() != prefix.length() + 1) || !name.startsWith(prefix))
+        return -1;
+    const int port = name.at(prefix.length()).unicode() - 'A';
+    return (port >= 0 && port < 5) ? port : -1;
+}
+
+/**
+ * Reads a number as written in FlowCode (e.g. "10", "0x1f" or "0b101").
+ */
+static bool parseNumber(const QString &text, int *value)
+{
+    bool ok;
+    const QString lower = text.trimmed().toLower();
+    if (lower.startsWith("0x"))
+        *value = lower.mid(2).toInt(&ok, 16);
+    else if (lower.startsWith("0b"))
+        *value = lower.mid(2).toInt(&ok, 2);
+    else
+        *value = lower.toInt(&ok, 10);
+    return ok;
+}
+
+// BEGIN class FlowInterpreter
+FlowInterpreter::FlowInterpreter(Pins *pins)
+{
+    m_pins = pins;
+    m_start = -1;
+    m_current = -1;
+    m_bReentering = false;
+    m_bHalted = true;
+    m_time = 0;
+    m_instructionTime = TIME_UNITS_PER_SECOND / 1000000;
+
+    for (int port = 0; port < 5; ++port) {
+        m_initialLatches[port] = m_latches[port] = 0;
+        m_initialTris[port] = m_tris[port] = 0xff;
+        for (int bit = 0; bit < 8; ++bit)
+            m_pinIDs[port][bit] = QString("R%1%2").arg(QChar('A' + port)).arg(bit);
+    }
+}
+
+FlowInterpreter::~FlowInterpreter()
+{
+}
+
+bool FlowInterpreter::load(const QString &fileName, QString *errorMessage)
+{
+    m_parts.clear();
+    m_subs.clear();
+    m_variableNames.clear();
+    m_initialVariables.clear();
+    m_start = -1;
+    m_bHalted = true;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *errorMessage = i18n("Could not open %1 for reading.", fileName);
+        return false;
+    }
+
+    ItemDocumentData data(Document::dt_flowcode);
+    if (!data.loadData(&file, errorMessage))
+        return false;
+
+    // BEGIN Create the parts
+    static const QHash<QString, Part::Type> partTypes = {
+        {"flow/start", Part::Start},
+        {"flow/end", Part::End},
+        {"flow/inputbutton", Part::PassThrough},
+        {"flow/setpin", Part::SetPin},
+        {"flow/testpin", Part::TestPin},
+        {"flow/readport", Part::ReadPort},
+        {"flow/writeport", Part::WritePort},
+        {"flow/varassignment", Part::Assignment},
+        {"flow/varcomparison", Part::Comparison},
+        {"flow/unary", Part::Unary},
+        {"flow/delay", Part::Delay},
+        {"flow/while", Part::While},
+        {"flow/repeat", Part::Repeat},
+        {"flow/forloop", Part::ForLoop},
+        {"flow/sub", Part::Sub},
+        {"flow/callsub", Part::CallSub},
+    };
+
+    QHash<QString, int> partOfItem;
+    const ItemDataMap &items = data.itemDataMap();
+    for (ItemDataMap::const_iterator it = items.begin(); it != items.end(); ++it) {
+        const ItemData &item = it.value();
+        if (!item.type.startsWith("flow/"))
+            continue; // e.g. drawing parts
+
+        if (!partTypes.contains(item.type)) {
+            *errorMessage = i18n("The flow part \"%1\" cannot be interpreted; the program must be compiled to be simulated.", item.type.mid(5));
+            return false;
+        }
+
+        Part part;
+        part.type = partTypes.value(item.type);
+        part.id = it.key();
+        part.next = part.alt = part.body = -1;
+        part.cycles = cycles_branch;
+        part.port = part.bit = 0;
+        part.state = false;
+        part.target.type = Expression::Variable;
+        part.target.index = 0;
+        part.delay = 0;
+
+        const QStringMap &s = item.dataString;
+        bool ok = true;
+
+        switch (part.type) {
+        case Part::Start:
+            if (m_start != -1) {
+                *errorMessage = i18n("The program has more than one start.");
+                return false;
+            }
+            m_start = m_parts.size();
+            part.cycles = cycles_simple;
+            break;
+
+        case Part::End:
+        case Part::PassThrough:
+            part.cycles = cycles_simple;
+            break;
+
+        case Part::SetPin:
+        case Part::TestPin: {
+            const QString pin = s.value("pin");
+            part.port = portIndex(pin.left(2), "R");
+            part.bit = pin.mid(2).toInt(&ok);
+            ok = ok && (pin.length() == 3) && (part.port != -1) && (part.bit < 8);
+            part.state = (s.value("state") == "high");
+            part.cycles = (part.type == Part::SetPin) ? cycles_branch : cycles_test;
+            break;
+        }
+
+        case Part::ReadPort:
+            part.port = portIndex(s.value("0-port"), "PORT");
+            ok = (part.port != -1) && compile(s.value("1-var"), &part.target);
+            break;
+
+        case Part::WritePort:
+            ok = compile(s.value("1-port"), &part.target) && compile(s.value("0-var"), &part.value);
+            part.cycles += part.value.tokens.size();
+            break;
+
+        case Part::Assignment:
+            ok = compile(s.value("0-var1"), &part.target) && compile(s.value("2-var2"), &part.value);
+            part.cycles += part.value.tokens.size();
+            break;
+
+        case Part::Unary:
+            part.op = s.value("1-op");
+            ok = compile(s.value("0-var"), &part.target);
+            break;
+
+        case Part::Delay:
+            part.delay = qRound64(item.dataNumber.value("delay_length") * TIME_UNITS_PER_SECOND);
+            break;
+
+        case Part::Comparison:
+        case Part::While:
+        case Part::Repeat:
+            part.condition.op = s.value("1op");
+            ok = compile(s.value("0var1"), &part.condition.left) && compile(s.value("2var2"), &part.condition.right);
+            part.cycles = cycles_compare;
+            break;
+
+        case Part::ForLoop:
+            ok = compile(s.value("0-var"), &part.target) && compile(s.value("1-initial"), &part.value) && compile(s.value("2-end"), &part.end) && compile(s.value("3-step"), &part.step);
+            part.cycles = cycles_compare;
+            break;
+
+        case Part::Sub:
+            part.sub = s.value("sub");
+            m_subs[part.sub] = m_parts.size();
+            break;
+
+        case Part::CallSub:
+            part.sub = s.value("sub");
+            part.cycles = cycles_call;
+            break;
+        }
+
+        if (!ok) {
+            *errorMessage = i18n("The settings of the flow part \"%1\" cannot be interpreted.", it.key());
+            return false;
+        }
+
+        partOfItem[it.key()] = m_parts.size();
+        m_parts << part;
+    }
+
+    if (m_start == -1) {
+        *errorMessage = i18n("The program has no start.");
+        return false;
+    }
+
+    for (const Part &part : qAsConst(m_parts)) {
+        if ((part.type == Part::CallSub) && !m_subs.contains(part.sub)) {
+            *errorMessage = i18n("There is no subroutine called \"%1\".", part.sub);
+            return false;
+        }
+    }
+    // END Create the parts
+
+    // BEGIN Connect the parts
+    // The nodes of parts are given as "item/node", and junctions by their id
+    QHash<QString, QStringList> links;
+    const ConnectorDataMap &connectors = data.connectorDataMap();
+    for (const ConnectorData &connector : connectors) {
+        const QString start = connector.startNodeIsChild ? (connector.startNodeParent + '/' + connector.startNodeCId) : connector.startNodeId;
+        const QString end = connector.endNodeIsChild ? (connector.endNodeParent + '/' + connector.endNodeCId) : connector.endNodeId;
+        links[start] << end;
+        links[end] << start;
+    }
+
+    // Follows the connectors from an output through any junctions to the
+    // input that it leads to
+    auto partAfter = [&](const QString &itemID, const QString &output) -> int {
+        QStringList queue(itemID + '/' + output);
+        QSet<QString> visited;
+        visited.insert(queue.first());
+        while (!queue.isEmpty()) {
+            const QStringList linked = links.value(queue.takeFirst());
+            for (const QString &node : linked) {
+                if (visited.contains(node))
+                    continue;
+                visited.insert(node);
+
+                const int slash = node.indexOf('/');
+                if (slash == -1) {
+                    queue << node;
+                    continue;
+                }
+
+                const QString nodeID = node.mid(slash + 1);
+                if ((nodeID == "stdinput") || (nodeID == "ext_in"))
+                    return partOfItem.value(node.left(slash), -1);
+            }
+        }
+
+        // Not connected, or connected to the end of the body of a container
+        return -1;
+    };
+
+    for (Part &part : m_parts) {
+        switch (part.type) {
+        case Part::While:
+        case Part::Repeat:
+        case Part::ForLoop:
+            part.body = partAfter(part.id, "int_in");
+            part.next = partAfter(part.id, "ext_out");
+            break;
+
+        case Part::Sub:
+            part.body = partAfter(part.id, "int_in");
+            break;
+
+        case Part::End:
+            break;
+
+        default:
+            part.next = partAfter(part.id, "stdoutput");
+            if ((part.type == Part::TestPin) || (part.type == Part::Comparison))
+                part.alt = partAfter(part.id, "altoutput");
+            break;
+        }
+    }
+    // END Connect the parts
+
+    // BEGIN Read the settings of the microcontroller
+    const MicroData &microData = data.microData();
+    m_microID = microData.id;
+
+    for (int port = 0; port < 5; ++port) {
+        m_initialLatches[port] = 0;
+        m_initialTris[port] = 0xff;
+    }
+
+    for (PinDataMap::const_iterator it = microData.pinMap.begin(); it != microData.pinMap.end(); ++it) {
+        const int port = portIndex(it.key().left(2), "R");
+        bool ok;
+        const int bit = it.key().mid(2).toInt(&ok);
+        if ((port == -1) || !ok || (bit >= 8))
+            continue;
+
+        if (it.value().type == PinSettings::pt_output)
+            m_initialTris[port] &= ~(1 << bit);
+        if (it.value().state == PinSettings::ps_on)
+            m_initialLatches[port] |= (1 << bit);
+    }
+
+    for (QStringMap::const_iterator it = microData.variableMap.begin(); it != microData.variableMap.end(); ++it) {
+        int value;
+        if (parseNumber(it.value(), &value))
+            m_initialVariables[variable(it.key())] = value & 0xff;
+    }
+    // END Read the settings of the microcontroller
+
+    return true;
+}
+
+void FlowInterpreter::setInstructionTime(long long time)
+{
+    m_instructionTime = std::max(time, 1LL);
+}
+
+void FlowInterpreter::reset(long long time)
+{
+    m_variables = m_initialVariables;
+    m_frames.clear();
+    m_current = m_start;
+    m_bReentering = false;
+    m_bHalted = (m_start == -1);
+    m_time = time;
+
+    for (int port = 0; port < 5; ++port) {
+        m_latches[port] = m_initialLatches[port];
+        m_tris[port] = m_initialTris[port];
+        updatePins(port, 0xff);
+    }
+}
+
+void FlowInterpreter::run(long long until)
+{
+    while (!m_bHalted && (m_time < until))
+        m_time += step();
+}
+
+long long FlowInterpreter::step()
+{
+    const int index = m_current;
+    const Part &part = m_parts[index];
+    const bool reentering = m_bReentering;
+    m_bReentering = false;
+
+    switch (part.type) {
+    case Part::Start:
+    case Part::PassThrough:
+        advance(part.next);
+        break;
+
+    case Part::End:
+        m_bHalted = true;
+        break;
+
+    case Part::Sub:
+        // Only reached by a connector leading into a subroutine
+        advance(-1);
+        break;
+
+    case Part::SetPin: {
+        const int latch = part.state ? (m_latches[part.port] | (1 << part.bit)) : (m_latches[part.port] & ~(1 << part.bit));
+        const int changed = latch ^ m_latches[part.port];
+        m_latches[part.port] = latch;
+        updatePins(part.port, changed);
+        advance(part.next);
+        break;
+    }
+
+    case Part::TestPin:
+        advance(((readPort(part.port) >> part.bit) & 1) ? part.next : part.alt);
+        break;
+
+    case Part::ReadPort:
+        assign(part.target, readPort(part.port));
+        advance(part.next);
+        break;
+
+    case Part::WritePort:
+    case Part::Assignment:
+        assign(part.target, evaluate(part.value));
+        advance(part.next);
+        break;
+
+    case Part::Unary: {
+        const int value = valueOf(part.target);
+
+        if (part.op == "Rotate Left")
+            assign(part.target, (value << 1) | (value >> 7));
+        else if (part.op == "Rotate Right")
+            assign(part.target, (value >> 1) | (value << 7));
+        else if (part.op == "Increment")
+            assign(part.target, value + 1);
+        else if (part.op == "Decrement")
+            assign(part.target, value - 1);
+        advance(part.next);
+        break;
+    }
+
+    case Part::Comparison:
+        advance(evaluate(part.condition) ? part.next : part.alt);
+        break;
+
+    case Part::Delay:
+        advance(part.next);
+        return part.cycles * m_instructionTime + part.delay;
+
+    case Part::While:
+        if (!reentering)
+            m_frames << index;
+        if (evaluate(part.condition))
+            enterBody(part.body);
+        else {
+            m_frames.removeLast();
+            advance(part.next);
+        }
+        break;
+
+    case Part::Repeat:
+        if (!reentering) {
+            m_frames << index;
+            enterBody(part.body);
+        } else if (evaluate(part.condition)) {
+            m_frames.removeLast();
+            advance(part.next);
+        } else
+            enterBody(part.body);
+        break;
+
+    case Part::ForLoop: {
+        int value;
+        if (!reentering) {
+            m_frames << index;
+            value = evaluate(part.value) & 0xff;
+        } else {
+            const int previous = valueOf(part.target);
+            value = (previous + evaluate(part.step)) & 0xff;
+            // Stop rather than wrap around, as a step past 255 would
+            if (value < previous)
+                value = 0x100;
+        }
+
+        if (value <= evaluate(part.end)) {
+            assign(part.target, value);
+            enterBody(part.body);
+        } else {
+            m_frames.removeLast();
+            advance(part.next);
+        }
+        break;
+    }
+
+    case Part::CallSub:
+        if (!reentering) {
+            m_frames << index;
+            enterBody(m_parts[m_subs.value(part.sub)].body);
+        } else {
+            m_frames.removeLast();
+            advance(part.next);
+        }
+        break;
+    }
+
+    return part.cycles * m_instructionTime;
+}
+
+void FlowInterpreter::advance(int part)
+{
+    if (part != -1) {
+        m_current = part;
+        return;
+    }
+
+    if (m_frames.isEmpty()) {
+        m_bHalted = true;
+        return;
+    }
+
+    // Back to the loop or call that the block is the body of
+    m_current = m_frames.last();
+    m_bReentering = true;
+}
+
+void FlowInterpreter::enterBody(int body)
+{
+    if (body != -1)
+        m_current = body;
+    else {
+        // An empty body; the loop or call carries straight on
+        m_bReentering = true;
+    }
+}
+
+int FlowInterpreter::evaluate(const Expression &expression) const
+{
+    QVarLengthArray<int, 16> stack;
+
+    for (const Expression::Token &token : expression.tokens) {
+        switch (token.type) {
+        case Expression::Number:
+            stack.append(token.value);
+            break;
+
+        case Expression::Variable:
+            stack.append(m_variables[token.value]);
+            break;
+
+        case Expression::Port:
+            stack.append(readPort(token.value));
+            break;
+
+        case Expression::Tris:
+            stack.append(m_tris[token.value]);
+            break;
+
+        case Expression::Operator: {
+            if (isUnary(token.value)) {
+                int &a = stack.last();
+                a = (token.value == op_negate) ? -a : ~a;
+                break;
+            }
+
+            const int b = stack.last();
+            stack.removeLast();
+            int &a = stack.last();
+            switch (token.value) {
+            case '*':
+                a *= b;
+                break;
+            case '/':
+                a = (b & 0xff) ? (a & 0xff) / (b & 0xff) : 0;
+                break;
+            case '%':
+                a = (b & 0xff) ? (a & 0xff) % (b & 0xff) : 0;
+                break;
+            case '+':
+                a += b;
+                break;
+            case '-':
+                a -= b;
+                break;
+            case op_shiftLeft:
+                a = (a << (b & 7));
+                break;
+            case op_shiftRight:
+                a = (a & 0xff) >> (b & 7);
+                break;
+            case '&':
+                a &= b;
+                break;
+            case '^':
+                a ^= b;
+                break;
+            case '|':
+                a |= b;
+                break;
+            }
+            break;
+        }
+        }
+    }
+
+    return stack.last() & 0xff;
+}
+
+bool FlowInterpreter::evaluate(const Condition &condition) const
+{
+    const int left = evaluate(condition.left);
+    const int right = evaluate(condition.right);
+
+    if (condition.op == "==")
+        return left == right;
+    if (condition.op == "!=")
+        return left != right;
+    if (condition.op == "<")
+        return left < right;
+    if (condition.op == ">")
+        return left > right;
+    if (condition.op == "<=")
+        return left <= right;
+    if (condition.op == ">=")
+        return left >= right;
+    return false;
+}
+
+int FlowInterpreter::valueOf(const Target &target) const
+{
+    switch (target.type) {
+    case Expression::Port:
+        return readPort(target.index);
+    case Expression::Tris:
+        return m_tris[target.index];
+    default:
+        return m_variables[target.index];
+    }
+}
+
+void FlowInterpreter::assign(const Target &target, int value)
+{
+    value &= 0xff;
+
+    switch (target.type) {
+    case Expression::Port: {
+        const int changed = value ^ m_latches[target.index];
+        m_latches[target.index] = value;
+        updatePins(target.index, changed);
+        break;
+    }
+
+    case Expression::Tris: {
+        const int changed = value ^ m_tris[target.index];
+        m_tris[target.index] = value;
+        updatePins(target.index, changed);
+        break;
+    }
+
+    default:
+        m_variables[target.index] = value;
+        break;
+    }
+}
+
+int FlowInterpreter::readPort(int port) const
+{
+    // Output pins read back what they are set to
+    int value = m_latches[port] & ~m_tris[port];
+    for (int bit = 0; bit < 8; ++bit) {
+        if (((m_tris[port] >> bit) & 1) && m_pins->isHigh(m_pinIDs[port][bit]))
+            value |= (1 << bit);
+    }
+    return value;
+}
+
+void FlowInterpreter::updatePins(int port, int changed)
+{
+    for (int bit = 0; bit < 8; ++bit) {
+        if ((changed >> bit) & 1)
+            m_pins->setOutput(m_pinIDs[port][bit], !((m_tris[port] >> bit) & 1), (m_latches[port] >> bit) & 1);
+    }
+}
+
+bool FlowInterpreter::compile(const QString &text, Expression *expression)
+{
+    expression->tokens.clear();
+
+    // Converted to reverse Polish notation with the shunting-yard algorithm
+    QVector<int> operators; // With '(' for an open bracket
+    bool expectOperand = true;
+    int depth = 0; // Of the stack when the expression is evaluated
+
+    auto popOperator = [&]() -> bool {
+        const int op = operators.takeLast();
+        if (op == '(')
+            return false;
+        if (!isUnary(op) && (--depth < 1))
+            return false;
+        expression->tokens << Expression::Token{Expression::Operator, op};
+        return true;
+    };
+
+    const int length = text.length();
+    int i = 0;
+    while (i < length) {
+        const QChar c = text.at(i);
+
+        if (c.isSpace()) {
+            ++i;
+            continue;
+        }
+
+        if (c.isLetterOrNumber() || (c == '_')) {
+            if (!expectOperand)
+                return false;
+
+            int end = i;
+            while ((end < length) && (text.at(end).isLetterOrNumber() || (text.at(end) == '_')))
+                ++end;
+            const QString word = text.mid(i, end - i);
+            i = end;
+
+            Expression::Token token;
+            if (c.isDigit()) {
+                token.type = Expression::Number;
+                if (!parseNumber(word, &token.value))
+                    return false;
+            } else if ((token.value = portIndex(word, "PORT")) != -1)
+                token.type = Expression::Port;
+            else if ((token.value = portIndex(word, "TRIS")) != -1)
+                token.type = Expression::Tris;
+            else {
+                token.type = Expression::Variable;
+                token.value = variable(word);
+            }
+
+            expression->tokens << token;
+            ++depth;
+            expectOperand = false;
+            continue;
+        }
+
+        if (c == '(') {
+            if (!expectOperand)
+                return false;
+            operators << '(';
+            ++i;
+            continue;
+        }
+
+        if (c == ')') {
+            if (expectOperand)
+                return false;
+            while (!operators.isEmpty() && (operators.last() != '(')) {
+                if (!popOperator())
+                    return false;
+            }
+            if (operators.isEmpty())
+                return false;
+            operators.removeLast();
+            ++i;
+            continue;
+        }
+
+        int op = c.unicode();
+        if (expectOperand) {
+            // Unary operators are applied to what follows them
+            if (op == '-')
+                op = op_negate;
+            else if (op != '~')
+                return false;
+            operators << op;
+            ++i;
+            continue;
+        }
+
+        if (text.midRef(i, 2) == QLatin1String("<<"))
+            op = op_shiftLeft;
+        else if (text.midRef(i, 2) == QLatin1String(">>"))
+            op = op_shiftRight;
+        else if (!precedence(op) || isUnary(op))
+            return false;
+        i += (op == op_shiftLeft || op == op_shiftRight) ? 2 : 1;
+
+        while (!operators.isEmpty() && (operators.last() != '(') && (precedence(operators.last()) >= precedence(op))) {
+            if (!popOperator())
+                return false;
+        }
+        operators << op;
+        expectOperand = true;
+    }
+
+    if (expectOperand)
+        return false;
+
+    while (!operators.isEmpty()) {
+        if (!popOperator())
+            return false;
+    }
+
+    return depth == 1;
+}
+
+bool FlowInterpreter::compile(const QString &text, Target *target)
+{
+    Expression expression;
+    if (!compile(text, &expression) || (expression.tokens.size() != 1) || (expression.tokens.first().type == Expression::Number) || (expression.tokens.first().type == Expression::Operator))
+        return false;
+
+    target->type = expression.tokens.first().type;
+    target->index = expression.tokens.first().value;
+    return true;
+}
+
+int FlowInterpreter::variable(const QString &name)
+{
+    int index = m_variableNames.indexOf(name);
+    if (index == -1) {
+        index = m_variableNames.size();
+        m_variableNames << name;
+        m_initialVariables << 0;
+    }
+    return index;
+}
+// END class FlowInterpreter
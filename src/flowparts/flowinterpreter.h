@@ -0,0 +1,236 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef FLOWINTERPRETER_H
+#define FLOWINTERPRETER_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+Runs a FlowCode program by walking its flow parts, rather than by compiling it
+to assembly and running that in gpsim. Loading a program only needs the
+.flowcode file to be read, so a change to the program can be tried out
+straight away.
+
+The variables and ports are those of a PIC: 8 bits wide, with the direction
+of each pin set by the bits of TRISx and the output of each pin by the bits of
+PORTx. The time each part takes is a rough count of the instruction cycles
+that the compiled program would take for it (apart from delays, which take
+their length exactly), so the timing is close to, but not the same as, that
+of the compiled program.
+
+Parts that need the toolchain (embedded code, interrupts, and the parts for
+counting, pulses, keypads and seven segment displays) cannot be interpreted,
+and load fails for programs that have them.
+
+@short Interprets FlowCode programs
+*/
+class FlowInterpreter
+{
+public:
+    /**
+     * The pins of the microcontroller that the program is run on.
+     */
+    class Pins
+    {
+    public:
+        virtual ~Pins()
+        {
+        }
+        /**
+         * @return whether the pin with the given id (e.g. "RA0") is high
+         */
+        virtual bool isHigh(const QString &pinID) const = 0;
+        /**
+         * Makes the pin an output driven high or low, or an input.
+         */
+        virtual void setOutput(const QString &pinID, bool isOutput, bool high) = 0;
+    };
+
+    FlowInterpreter(Pins *pins);
+    ~FlowInterpreter();
+
+    /**
+     * Reads the program from the .flowcode file.
+     * @param errorMessage set to why the program cannot be interpreted if
+     * this fails
+     * @return true if successful
+     */
+    bool load(const QString &fileName, QString *errorMessage);
+    /**
+     * @return the id of the microcontroller that the program was written for
+     * (e.g. "P16F84")
+     */
+    QString microID() const
+    {
+        return m_microID;
+    }
+    /**
+     * Sets the time that an instruction cycle takes, i.e. four clock cycles.
+     * All times are in the units of the simulator (TIME_UNITS_PER_SECOND).
+     */
+    void setInstructionTime(long long time);
+    /**
+     * Puts the program, the variables and the pins back to how they start,
+     * with the first part to be run at the given time.
+     */
+    void reset(long long time);
+    /**
+     * Runs the parts that are due before @p until.
+     */
+    void run(long long until);
+    /**
+     * @return the time that the next part is due to be run at
+     */
+    long long nextTime() const
+    {
+        return m_time;
+    }
+    /**
+     * Sets the time that the next part is due to be run at, e.g. when the
+     * program carries on after being paused.
+     */
+    void setNextTime(long long time)
+    {
+        m_time = time;
+    }
+    /**
+     * @return whether the program has come to its end
+     */
+    bool isHalted() const
+    {
+        return m_bHalted;
+    }
+
+protected:
+    /**
+     * An expression (e.g. "x + PORTA"), kept in reverse Polish notation so
+     * that running it is quick.
+     */
+    class Expression
+    {
+    public:
+        enum TokenType { Number, Variable, Port, Tris, Operator };
+
+        class Token
+        {
+        public:
+            TokenType type;
+            int value; // The number, the index of the variable or port, or the operator
+        };
+
+        QVector<Token> tokens;
+    };
+
+    class Condition
+    {
+    public:
+        Expression left;
+        QString op;
+        Expression right;
+    };
+
+    /**
+     * Where a value is put by assignments, reading ports and unary
+     * operations.
+     */
+    class Target
+    {
+    public:
+        Expression::TokenType type; // One of Variable, Port or Tris
+        int index;
+    };
+
+    class Part
+    {
+    public:
+        enum Type { Start, End, PassThrough, SetPin, TestPin, ReadPort, WritePort, Assignment, Comparison, Unary, Delay, While, Repeat, ForLoop, Sub, CallSub };
+
+        Type type;
+        QString id; // Of the item in the document
+        int next; // The part after this one (from stdoutput or ext_out), or -1 for the end of the block
+        int alt; // From altoutput
+        int body; // From int_in
+        int cycles; // The instruction cycles taken each time the part is run
+
+        // The settings of the part, for the types that use them
+        int port;
+        int bit;
+        bool state;
+        QString op;
+        Target target;
+        Expression value;
+        Expression end;
+        Expression step;
+        Condition condition;
+        long long delay;
+        QString sub;
+    };
+
+    /**
+     * Runs the current part.
+     * @return the time that it took
+     */
+    long long step();
+    /**
+     * Moves on to the given part, or to the end of the enclosing block if it
+     * is -1.
+     */
+    void advance(int part);
+    /**
+     * Moves on to the first part of the body of the current part, which
+     * has been pushed onto the frames.
+     */
+    void enterBody(int body);
+    int evaluate(const Expression &expression) const;
+    bool evaluate(const Condition &condition) const;
+    int valueOf(const Target &target) const;
+    void assign(const Target &target, int value);
+    int readPort(int port) const;
+    /**
+     * Passes what has changed in the latch and direction of the port on
+     * to the pins.
+     */
+    void updatePins(int port, int changed);
+
+    /**
+     * Turns the text of an expression into an Expression.
+     * @return false if the text is not an expression that can be interpreted
+     */
+    bool compile(const QString &text, Expression *expression);
+    bool compile(const QString &text, Target *target);
+    int variable(const QString &name);
+
+    Pins *m_pins;
+    QString m_microID;
+    QVector<Part> m_parts;
+    int m_start;
+    QHash<QString, int> m_subs; // The Sub parts by name
+    QStringList m_variableNames;
+    QVector<int> m_initialVariables;
+    QVector<int> m_variables;
+    int m_initialLatches[5];
+    int m_initialTris[5];
+    int m_latches[5]; // The PORTx registers
+    int m_tris[5]; // The TRISx registers; a set bit is an input
+    QString m_pinIDs[5][8];
+
+    int m_current; // The part being run
+    bool m_bReentering; // Whether the current part is a loop or call whose body has just been run
+    QVector<int> m_frames; // The loops and calls that are being run, innermost last
+    bool m_bHalted;
+    long long m_time;
+    long long m_instructionTime;
+};
+
+#endif
@@ -469,10 +469,25 @@ void FlowPart::handleIfElse(FlowCode *code, const QString &case1Statement, const
     code->addCodeBranch(stop);
 }
 
+void FlowPart::reparented(Item *oldParent, Item *newParent)
+{
+    CNItem::reparented(oldParent, newParent);
+
+    // Moving in or out of a container changes which branches are valid
+    if (m_pFlowCodeDocument && !m_pFlowCodeDocument->isDeleted())
+        m_pFlowCodeDocument->invalidateFlowPartCode();
+}
+
 Variant *FlowPart::createProperty(const QString &id, Variant::Type::Value type)
 {
-    if (type != Variant::Type::Port && type != Variant::Type::Pin && type != Variant::Type::VarName && type != Variant::Type::SevenSegment && type != Variant::Type::KeyPad)
-        return CNItem::createProperty(id, type);
+    if (type != Variant::Type::Port && type != Variant::Type::Pin && type != Variant::Type::VarName && type != Variant::Type::SevenSegment && type != Variant::Type::KeyPad) {
+        Variant *v = CNItem::createProperty(id, type);
+        connect(v, qOverload<QVariant, QVariant>(&Variant::valueChanged), this, [this] {
+            if (m_pFlowCodeDocument && !m_pFlowCodeDocument->isDeleted())
+                m_pFlowCodeDocument->invalidateFlowPartCode(this);
+        });
+        return v;
+    }
 
     Variant *v = createProperty(id, Variant::Type::String);
     v->setType(type);
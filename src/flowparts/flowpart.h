@@ -132,6 +132,7 @@ public slots:
 
 protected:
     void updateAttachedPositioning() override;
+    void reparented(Item *oldParent, Item *newParent) override;
     /**
      * Removes the node ids that shouldn't be used for finding the end part
      */
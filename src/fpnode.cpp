@@ -242,10 +242,10 @@ QPoint FPNode::findConnectorDivergePoint(bool *found)
             continue;
 
         if (gotP1) {
-            p2 = (*it)->connectorPoints(at < inSize);
+            p2 = (*it)->connectorCellPoints(at < inSize);
             gotP2 = true;
         } else {
-            p1 = (*it)->connectorPoints(at < inSize);
+            p1 = (*it)->connectorCellPoints(at < inSize);
             gotP1 = true;
         }
     }
@@ -18,6 +18,7 @@
 #include <QFormLayout>
 #include <QMimeDatabase>
 #include <QPushButton>
+#include <QSpinBox>
 #include <QString>
 #include <QVBoxLayout>
 
@@ -27,6 +28,7 @@ ImageExportDialog::ImageExportDialog(QWidget *parent)
           QStringLiteral("image/png"),
           QStringLiteral("image/bmp"),
           QStringLiteral("image/svg+xml"),
+          QStringLiteral("application/pdf"),
       })
 {
     setWindowTitle(i18n("Export As Image"));
@@ -55,6 +57,15 @@ ImageExportDialog::ImageExportDialog(QWidget *parent)
     m_cropCheck->setChecked(true); // yes by default?
 
     formLayout->addRow(i18n("Crop image:"), m_cropCheck);
+
+    m_scaleSpin = new QSpinBox(this);
+    m_scaleSpin->setObjectName("scaleSpin");
+    m_scaleSpin->setRange(10, 1000);
+    m_scaleSpin->setSingleStep(50);
+    m_scaleSpin->setValue(100);
+    m_scaleSpin->setSuffix(i18n("%"));
+
+    formLayout->addRow(i18n("Scale:"), m_scaleSpin);
     layout->addLayout(formLayout);
 
     layout->addStretch();
@@ -80,7 +91,7 @@ QString ImageExportDialog::filePath() const
 QString ImageExportDialog::formatType() const
 {
     const int formatIndex = m_formatSelect->currentIndex();
-    return (formatIndex == 0) ? QStringLiteral("PNG") : (formatIndex == 1) ? QStringLiteral("BMP") : (formatIndex == 2) ? QStringLiteral("SVG") : QString();
+    return (formatIndex == 0) ? QStringLiteral("PNG") : (formatIndex == 1) ? QStringLiteral("BMP") : (formatIndex == 2) ? QStringLiteral("SVG") : (formatIndex == 3) ? QStringLiteral("PDF") : QString();
 }
 
 bool ImageExportDialog::isCropSelected() const
@@ -88,9 +99,16 @@ bool ImageExportDialog::isCropSelected() const
     return m_cropCheck->isChecked();
 }
 
+double ImageExportDialog::scale() const
+{
+    return m_scaleSpin->value() / 100.0;
+}
+
 void ImageExportDialog::handleFormatIndexChanged(int index)
 {
     m_filePathEdit->setMimeTypeFilters((index != -1) ? QStringList {m_mimeTypeNames.at(index)} : QStringList());
+    // Only the bitmaps have a size in pixels
+    m_scaleSpin->setEnabled(index == 0 || index == 1);
 
     updateExportButton();
 }
@@ -16,6 +16,7 @@
 class KComboBox;
 class KUrlRequester;
 class QCheckBox;
+class QSpinBox;
 class QPushButton;
 class QDialogButtonBox;
 class QString;
@@ -31,6 +32,11 @@ public:
     QString filePath() const;
     QString formatType() const;
     bool isCropSelected() const;
+    /**
+     * @return the pixels of the image for each pixel of the canvas, for the
+     * bitmap formats
+     */
+    double scale() const;
 
 private Q_SLOTS:
     void handleFormatIndexChanged(int index);
@@ -41,6 +47,7 @@ private:
     KComboBox *m_formatSelect;
     KUrlRequester *m_filePathEdit;
     QCheckBox *m_cropCheck;
+    QSpinBox *m_scaleSpin;
     QDialogButtonBox *m_buttonBox;
     QPushButton *m_exportButton;
 };
@@ -25,9 +25,13 @@
 
 // #include <q3dragobject.h>
 // #include <q3popupmenu.h>
+#include <QBoxLayout>
 #include <QLayout>
+#include <QLineEdit>
 #include <QMenu>
 #include <QMimeData>
+#include <QSet>
+#include <QShowEvent>
 
 #include <cassert>
 
@@ -53,6 +57,8 @@ ILVItem::ILVItem(QTreeWidgetItem *parent, const QString &id)
 
 ItemSelector::ItemSelector(QWidget *parent)
     : QTreeWidget(parent)
+    , m_pSearchLine(nullptr)
+    , m_bLibraryItemsAdded(false)
 {
     qCDebug(KTL_LOG) << " this=" << this;
 
@@ -94,6 +100,7 @@ ItemSelector::ItemSelector(QWidget *parent)
     connect(this, &ItemSelector::customContextMenuRequested, this, &ItemSelector::slotContextMenuRequested);
 
     connect(this, &ItemSelector::itemSelectionChanged, this, &ItemSelector::slotItemSelected);
+    connect(this, &ItemSelector::itemExpanded, this, &ItemSelector::slotItemExpanded);
 }
 
 ItemSelector::~ItemSelector()
@@ -104,67 +111,261 @@ ItemSelector::~ItemSelector()
 void ItemSelector::clear()
 {
     m_categories.clear();
+    m_entries.clear();
+    m_entryIndex.clear();
+    m_trigrams.clear();
+    m_filter.clear();
+    if (m_pSearchLine)
+        m_pSearchLine->clear();
     QTreeWidget::clear();
 }
 
+void ItemSelector::addSearchLine()
+{
+    m_pSearchLine = new QLineEdit(parentWidget());
+    m_pSearchLine->setPlaceholderText(i18n("Search..."));
+    m_pSearchLine->setClearButtonEnabled(true);
+
+    if (QBoxLayout *layout = qobject_cast<QBoxLayout *>(parentWidget()->layout()))
+        layout->insertWidget(layout->indexOf(this), m_pSearchLine);
+
+    connect(m_pSearchLine, &QLineEdit::textChanged, this, &ItemSelector::setFilter);
+}
+
+void ItemSelector::showEvent(QShowEvent *event)
+{
+    if (!m_bLibraryItemsAdded) {
+        m_bLibraryItemsAdded = true;
+
+        // Items added before now (such as the subcircuits) stay after those
+        // of the library
+        const int earlierCount = topLevelItemCount();
+        addLibraryItems();
+        for (int i = 0; i < earlierCount; ++i) {
+            QTreeWidgetItem *item = takeTopLevelItem(0);
+            const bool expanded = item->isExpanded();
+            addTopLevelItem(item);
+            item->setExpanded(expanded);
+        }
+    }
+
+    QTreeWidget::showEvent(event);
+}
+
 void ItemSelector::addItem(const QString &caption, const QString &id, const QString &_category, const QIcon &icon, bool removable)
 {
     qCDebug(KTL_LOG) << "id=" << id;
-    ILVItem *parentItem = nullptr;
 
     QString category = _category;
-    if (!category.startsWith("/")) {
-        category.prepend('/');
-    }
-
-    do {
+    if (category.startsWith("/"))
         category.remove(0, 1);
-        QString cat;
-        category.replace("\\/", "|");
-        int pos = category.indexOf('/');
-        if (pos == -1)
-            cat = category;
-        else
-            cat = category.left(pos);
-
-        cat.replace("|", "/");
-
-        if (m_categories.indexOf(cat) == -1) {
-            m_categories.append(cat);
-
-            if (parentItem) {
-                parentItem = new ILVItem(parentItem, "");
-            } else {
-                parentItem = new ILVItem(this, "");
-            }
-            // parentItem->setExpandable(true); // 2018.08.12 - is it needed?
-
-            parentItem->setExpanded(readOpenState(cat));
-
-            parentItem->setText(0, cat);
-        } else {
-            QList<QTreeWidgetItem *> foundList = findItems(cat, Qt::MatchExactly);
-            if (foundList.size() > 1) {
-                qCWarning(KTL_LOG) << "found multiple categories for '" << cat << "'";
-            }
-            parentItem = dynamic_cast<ILVItem *>(foundList.front());
+    category.replace("\\/", "|");
+
+    // Slashes within names stay as '|' in the path, so that it names one
+    // category
+    QString path;
+    ILVItem *parentItem = nullptr;
+    const QStringList names = category.split('/');
+    for (QString name : names) {
+        path += '/' + name;
+        name.replace("|", "/");
+
+        if (!m_categories.contains(path)) {
+            Category newCategory;
+            newCategory.item = parentItem ? new ILVItem(parentItem, "") : new ILVItem(this, "");
+            newCategory.item->setText(0, name);
+            newCategory.item->setData(0, ILVItem::DataRole_Category, path);
+            newCategory.item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+            newCategory.wasExpanded = readOpenState(name);
+            newCategory.populated = newCategory.wasExpanded;
+            m_categories.insert(path, newCategory);
+
+            newCategory.item->setExpanded(newCategory.wasExpanded);
         }
 
-        category.remove(0, pos);
-    } while (category.contains('/'));
+        parentItem = m_categories[path].item;
+    }
 
-    if (!parentItem) {
-        qCCritical(KTL_LOG) << "Unexpected error in finding parent item for category list";
-        return;
+    Entry entry;
+    entry.text = caption.toLower();
+    entry.caption = caption;
+    entry.id = id;
+    entry.icon = icon;
+    entry.category = path;
+    entry.item = nullptr;
+    entry.removable = removable;
+    entry.hidden = !matchesFilter(entry);
+
+    const int index = m_entries.size();
+    m_entries.append(entry);
+    m_entryIndex.insert(id, index);
+
+    for (int i = 0; i + 3 <= entry.text.length(); ++i) {
+        QVector<int> &entries = m_trigrams[entry.text.mid(i, 3)];
+        if (entries.isEmpty() || entries.last() != index)
+            entries.append(index);
     }
 
-    ILVItem *item = new ILVItem(parentItem, id);
+    Category &itemCategory = m_categories[path];
+    if (itemCategory.populated)
+        createEntryItem(index);
+    else
+        itemCategory.pendingEntries.append(index);
+
+    // Shows the category if this is the first item found in it
+    if (!m_filter.isEmpty())
+        applyFilter();
+}
+
+void ItemSelector::createEntryItem(int index)
+{
+    Entry &entry = m_entries[index];
+    Category &category = m_categories[entry.category];
+
+    ILVItem *item = new ILVItem(category.item, entry.id);
     // item->setPixmap( 0, icon );  // 2018.08.12 - replaced with line below
-    item->setIcon(0, icon);
-    item->setText(0, caption);
+    item->setIcon(0, entry.icon);
+    item->setText(0, entry.caption);
     // item->setDragEnabled(true); // 2018.08.12 - replaced with line below
     item->setFlags(Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsDragEnabled);
-    item->setRemovable(removable);
+    item->setRemovable(entry.removable);
+    item->setHidden(entry.hidden);
+    entry.item = item;
+
+    category.item->setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicatorWhenChildless);
+}
+
+void ItemSelector::populateCategory(Category &category)
+{
+    category.populated = true;
+
+    const QVector<int> pendingEntries = category.pendingEntries;
+    category.pendingEntries.clear();
+    for (int index : pendingEntries) {
+        if (!m_entries[index].id.isEmpty())
+            createEntryItem(index);
+    }
+
+    if (!category.item->childCount())
+        category.item->setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicatorWhenChildless);
+}
+
+ItemSelector::Category *ItemSelector::categoryOfItem(QTreeWidgetItem *item)
+{
+    if (!item)
+        return nullptr;
+
+    const QString path = item->data(0, ILVItem::DataRole_Category).toString();
+    if (path.isEmpty())
+        return nullptr;
+
+    QHash<QString, Category>::iterator it = m_categories.find(path);
+    return (it == m_categories.end()) ? nullptr : &it.value();
+}
+
+void ItemSelector::slotItemExpanded(QTreeWidgetItem *item)
+{
+    Category *category = categoryOfItem(item);
+    if (category && !category->populated)
+        populateCategory(*category);
+}
+
+bool ItemSelector::matchesFilter(const Entry &entry) const
+{
+    return m_filter.isEmpty() || entry.text.contains(m_filter);
+}
+
+QVector<int> ItemSelector::candidateEntries(const QString &filter) const
+{
+    if (filter.length() < 3) {
+        QVector<int> entries(m_entries.size());
+        for (int i = 0; i < entries.size(); ++i)
+            entries[i] = i;
+        return entries;
+    }
+
+    // Every entry containing the filter has all of its trigrams, so those
+    // of the rarest trigram are the fewest to check
+    const QVector<int> *fewest = nullptr;
+    for (int i = 0; i + 3 <= filter.length(); ++i) {
+        QHash<QString, QVector<int>>::const_iterator it = m_trigrams.constFind(filter.mid(i, 3));
+        if (it == m_trigrams.constEnd())
+            return QVector<int>();
+
+        if (!fewest || it->size() < fewest->size())
+            fewest = &it.value();
+    }
+
+    return *fewest;
+}
+
+void ItemSelector::setFilter(const QString &text)
+{
+    const QString filter = text.trimmed().toLower();
+    if (filter == m_filter)
+        return;
+
+    // The categories are opened to show what is found, and put back as
+    // they were once the filter is cleared
+    if (m_filter.isEmpty()) {
+        for (Category &category : m_categories)
+            category.wasExpanded = category.item->isExpanded();
+    }
+
+    m_filter = filter;
+    applyFilter();
+}
+
+void ItemSelector::applyFilter()
+{
+    QVector<bool> matches(m_entries.size(), m_filter.isEmpty());
+    if (!m_filter.isEmpty()) {
+        const QVector<int> candidates = candidateEntries(m_filter);
+        for (int index : candidates)
+            matches[index] = matchesFilter(m_entries[index]);
+    }
+
+    // Only the items that change are shown or hidden
+    QSet<QString> shownCategories;
+    for (int i = 0; i < m_entries.size(); ++i) {
+        Entry &entry = m_entries[i];
+        if (entry.id.isEmpty())
+            continue;
+
+        if (matches[i])
+            shownCategories.insert(entry.category);
+
+        if (entry.hidden != matches[i])
+            continue;
+
+        entry.hidden = !matches[i];
+        if (entry.item)
+            entry.item->setHidden(entry.hidden);
+    }
+
+    // Along with the categories that contain them
+    const QList<QString> foundCategories = shownCategories.values();
+    for (QString path : foundCategories) {
+        int pos;
+        while ((pos = path.lastIndexOf('/')) > 0) {
+            path.truncate(pos);
+            shownCategories.insert(path);
+        }
+    }
+
+    for (Category &category : m_categories) {
+        const QString path = category.item->data(0, ILVItem::DataRole_Category).toString();
+        const bool shown = m_filter.isEmpty() || shownCategories.contains(path);
+        category.item->setHidden(!shown);
+
+        if (m_filter.isEmpty())
+            category.item->setExpanded(category.wasExpanded);
+        else if (shown) {
+            if (!category.populated)
+                populateCategory(category);
+            category.item->setExpanded(true);
+        }
+    }
 }
 
 void ItemSelector::writeOpenStates()
@@ -174,16 +375,9 @@ void ItemSelector::writeOpenStates()
     // config->setGroup( name() );
     KConfigGroup configGroup = configPtr->group(objectName());
 
-    const QStringList::iterator end = m_categories.end();
-    for (QStringList::iterator it = m_categories.begin(); it != end; ++it) {
-        QList<QTreeWidgetItem *> itemsFound = findItems(*it, Qt::MatchExactly);
-        if (itemsFound.size() > 1) {
-            qCWarning(KTL_LOG) << " too many items " << itemsFound.size() << " for category '" << *it << "'";
-        }
-        QTreeWidgetItem *item = itemsFound.first() /* findItem( *it, 0 ) */;
-        if (item) {
-            configGroup.writeEntry(*it + "IsOpen", item->isExpanded() /* isOpen() */);
-        }
+    for (const Category &category : qAsConst(m_categories)) {
+        const bool expanded = m_filter.isEmpty() ? category.item->isExpanded() : category.wasExpanded;
+        configGroup.writeEntry(category.item->text(0) + "IsOpen", expanded /* isOpen() */);
     }
 }
 
@@ -282,12 +476,24 @@ void ItemSelector::slotRemoveSelectedItem()
         return;
     }
 
-    emit itemRemoved(item->data(0, ILVItem::DataRole_ID).toString() /*key( 0, 0 ) */);
+    const QString id = item->data(0, ILVItem::DataRole_ID).toString();
+    emit itemRemoved(id /*key( 0, 0 ) */);
+
+    QHash<QString, int>::iterator entryIt = m_entryIndex.find(id);
+    if (entryIt != m_entryIndex.end()) {
+        // The entry is left in the trigram index, and skipped from now on
+        Entry &entry = m_entries[entryIt.value()];
+        entry.id.clear();
+        entry.item = nullptr;
+        m_entryIndex.erase(entryIt);
+    }
+
     ILVItem *parent = dynamic_cast<ILVItem *>(item->QTreeWidgetItem::parent());
     delete item;
     // Get rid of the category as well if it has no children
-    if (parent && !parent->childCount() /* firstChild() */) {
-        m_categories.removeAll(parent->text(0));
+    Category *category = categoryOfItem(parent);
+    if (category && !parent->childCount() /* firstChild() */ && category->pendingEntries.isEmpty()) {
+        m_categories.remove(parent->data(0, ILVItem::DataRole_Category).toString());
         delete parent;
     }
 }
@@ -406,14 +612,16 @@ ComponentSelector::ComponentSelector(KateMDI::ToolView *parent)
              "Some components (such as subcircuits) can be removed by right clicking on the item and selecting \"Remove\"."));
 
     setListCaption(i18n("Component"));
+    addSearchLine();
+}
 
-    LibraryItemList *items = itemLibrary()->items();
-    qCDebug(KTL_LOG) << " there are " << items->count() << " items";
-    const LibraryItemList::iterator end = items->end();
-    for (LibraryItemList::iterator it = items->begin(); it != end; ++it) {
-        if ((*it)->type() == LibraryItem::lit_component)
-            addItem((*it)->name(), (*it)->activeID(), (*it)->category(), (*it)->icon());
-    }
+void ComponentSelector::addLibraryItems()
+{
+    const LibraryItemList items = itemLibrary()->items(LibraryItem::lit_component);
+    qCDebug(KTL_LOG) << " there are " << items.count() << " items";
+    const LibraryItemList::const_iterator end = items.end();
+    for (LibraryItemList::const_iterator it = items.begin(); it != end; ++it)
+        addItem((*it)->name(), (*it)->activeID(), (*it)->category(), (*it)->icon());
 }
 // END class ComponentSelector
 
@@ -438,13 +646,15 @@ FlowPartSelector::FlowPartSelector(KateMDI::ToolView *parent)
              "stop placement."));
 
     setListCaption(i18n("Flow Part"));
+    addSearchLine();
+}
 
-    LibraryItemList *items = itemLibrary()->items();
-    const LibraryItemList::iterator end = items->end();
-    for (LibraryItemList::iterator it = items->begin(); it != end; ++it) {
-        if ((*it)->type() == LibraryItem::lit_flowpart)
-            addItem((*it)->name(), (*it)->activeID(), (*it)->category(), (*it)->icon());
-    }
+void FlowPartSelector::addLibraryItems()
+{
+    const LibraryItemList items = itemLibrary()->items(LibraryItem::lit_flowpart);
+    const LibraryItemList::const_iterator end = items.end();
+    for (LibraryItemList::const_iterator it = items.begin(); it != end; ++it)
+        addItem((*it)->name(), (*it)->activeID(), (*it)->category(), (*it)->icon());
 }
 // END class FlowPartSelector
 
@@ -465,14 +675,15 @@ MechanicsSelector::MechanicsSelector(QWidget *parent)
     : ItemSelector(static_cast<QWidget *>(parent))
 {
     setWhatsThis(i18n("Add mechanical parts to the mechanics work area by dragging them there."));
+    addSearchLine();
+}
 
-    LibraryItemList *items = itemLibrary()->items();
-    const LibraryItemList::iterator end = items->end();
-    for (LibraryItemList::iterator it = items->begin(); it != end; ++it) {
-        if ((*it)->type() == LibraryItem::lit_mechanical) {
-            addItem((*it)->name(), (*it)->activeID(), (*it)->category(), (*it)->icon());
-        }
-    }
+void MechanicsSelector::addLibraryItems()
+{
+    const LibraryItemList items = itemLibrary()->items(LibraryItem::lit_mechanical);
+    const LibraryItemList::const_iterator end = items.end();
+    for (LibraryItemList::const_iterator it = items.begin(); it != end; ++it)
+        addItem((*it)->name(), (*it)->activeID(), (*it)->category(), (*it)->icon());
 }
 // END class MechanicsSelector
 
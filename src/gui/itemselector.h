@@ -13,14 +13,18 @@
 
 // #include <q3listview.h> // gone in kde4..
 
+#include <QHash>
+#include <QIcon>
 #include <QPixmap>
 #include <QString>
 #include <QTreeWidget>
+#include <QVector>
 // #include <q3listview.h>
 
 // #include <k3listview.h>
 
 class ProjectItem;
+class QLineEdit;
 // class Q3StoredDrag;  // 2018.08.12 - move to QTreeWidget
 class QMimeData;
 
@@ -38,6 +42,7 @@ class ILVItem : public QObject, public QTreeWidgetItem /* K3ListViewItem */
 public:
     enum {
         DataRole_ID = Qt::UserRole,
+        DataRole_Category, // The path of a category item, as used by ItemSelector
         // note: add here isRemovable, projectItem
     } ILVItemRole;
 
@@ -101,6 +106,11 @@ public slots:
     virtual void slotContextMenuRequested(const QPoint &pos);
     virtual void clear();
     void slotRemoveSelectedItem();
+    /**
+     * Shows only the items whose captions contain the text (ignoring case),
+     * and the categories they are in. An empty text shows every item.
+     */
+    void setFilter(const QString &text);
 
 signals:
     /**
@@ -128,21 +138,86 @@ protected:
     bool readOpenState(const QString &id);
 
     QTreeWidgetItem *selectedItem() const;
+    /**
+     * Puts a line for searching the items (see setFilter) above the list.
+     */
+    void addSearchLine();
 
     QMimeData *mimeData(const QList<QTreeWidgetItem *> items) const override;
+    /**
+     * Adds the items of the library that belong in the selector. This is
+     * left until the selector is first shown, so that starting does not
+     * have to wait for the items of every selector to be made.
+     */
+    virtual void addLibraryItems()
+    {
+    }
+    void showEvent(QShowEvent *event) override;
 
 private slots:
     void slotItemSelected();
     void slotItemClicked(QTreeWidgetItem *item, int);
     void slotItemDoubleClicked(QTreeWidgetItem *, int);
+    void slotItemExpanded(QTreeWidgetItem *item);
 
 private:
     /**
-     * @return a dragobject encoding the currently selected component item.
+     * An item added with addItem. Its ILVItem is not made until its category
+     * is first expanded, so that closed categories of a large library cost
+     * next to nothing.
+     */
+    class Entry
+    {
+    public:
+        QString text; // The caption in lower case, for searching
+        QString caption;
+        QString id;
+        QIcon icon;
+        QString category; // The path of the category
+        ILVItem *item;
+        bool removable;
+        bool hidden;
+    };
+
+    class Category
+    {
+    public:
+        ILVItem *item;
+        QVector<int> pendingEntries; // Entries without an ILVItem yet
+        bool populated;
+        bool wasExpanded; // Whether it was expanded before the filter was set
+    };
+
+    /**
+     * @return whether the entry is shown with the present filter
      */
-    // 		Q3DragObject * dragObject();
+    bool matchesFilter(const Entry &entry) const;
+    /**
+     * @return the entries that may contain the filter text, from the trigram
+     * index (or every entry for text that is too short to have a trigram)
+     */
+    QVector<int> candidateEntries(const QString &filter) const;
+    /**
+     * Shows and hides the items and categories for the present filter.
+     */
+    void applyFilter();
+    /**
+     * Makes the ILVItems of the entries in the category that do not have one.
+     */
+    void populateCategory(Category &category);
+    void createEntryItem(int index);
+    /**
+     * @return the category of a category item, or null for other items
+     */
+    Category *categoryOfItem(QTreeWidgetItem *item);
 
-    QStringList m_categories;
+    QHash<QString, Category> m_categories; // By path
+    QVector<Entry> m_entries;
+    QHash<QString, int> m_entryIndex; // By id
+    QHash<QString, QVector<int>> m_trigrams; // The entries that have each trigram in their text
+    QString m_filter; // In lower case
+    QLineEdit *m_pSearchLine;
+    bool m_bLibraryItemsAdded;
 };
 
 /**
@@ -159,6 +234,9 @@ public:
         return "ComponentSelector";
     }
 
+protected:
+    void addLibraryItems() override;
+
 private:
     ComponentSelector(KateMDI::ToolView *parent);
     static ComponentSelector *m_pSelf;
@@ -178,6 +256,9 @@ public:
         return "FlowPartSelector";
     }
 
+protected:
+    void addLibraryItems() override;
+
 private:
     FlowPartSelector(KateMDI::ToolView *parent);
     static FlowPartSelector *m_pSelf;
@@ -196,6 +277,9 @@ public:
         return "MechanicsSelector";
     }
 
+protected:
+    void addLibraryItems() override;
+
 private:
     MechanicsSelector(QWidget *parent = nullptr);
     static MechanicsSelector *m_pSelf;
@@ -17,6 +17,9 @@
 #include <QEvent>
 #include <QLayout>
 #include <QMenu>
+#include <QScrollBar>
+#include <QTextCursor>
+#include <QTimer>
 
 #include <ktechlab_debug.h>
 
@@ -41,6 +44,11 @@ LogView::LogView(KateMDI::ToolView *parent)
     // Connect up signal emitted when the user doubleclicks on a paragraph in the log view
     // connect( this, SIGNAL(clicked(int,int)), this, SLOT(slotParaClicked(int,int)) );
     // ^ reimplemented by: mouseDoubleClickEvent()
+
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(50);
+    connect(m_flushTimer, &QTimer::timeout, this, &LogView::flushOutput);
 }
 
 LogView::~LogView()
@@ -49,6 +57,8 @@ LogView::~LogView()
 
 void LogView::clear()
 {
+    m_pendingOutput.clear();
+    m_flushTimer->stop();
     m_messageInfoMap.clear();
     KTextEdit::clear();
 }
@@ -56,30 +66,62 @@ void LogView::clear()
 void LogView::addOutput(QString text, OutputType outputType, MessageInfo messageInfo)
 {
     tidyText(text);
+    QString html;
     switch (outputType) {
     case LogView::ot_important:
-        append(QString("<font color=\"#000000\"><b>%1</b></font>").arg(text));
+        html = QString("<font color=\"#000000\"><b>%1</b></font>").arg(text);
         break;
 
     case LogView::ot_info:
-        append(QString("<font color=\"#000000\"><i>%1</i></font>").arg(text));
+        html = QString("<font color=\"#000000\"><i>%1</i></font>").arg(text);
         break;
 
     case LogView::ot_message:
-        append(QString("<font color=\"#000000\">%1</font>").arg(text));
+        html = QString("<font color=\"#000000\">%1</font>").arg(text);
         break;
 
     case LogView::ot_warning:
-        append(QString("<font color=\"#666666\">%1</font>").arg(text));
+        html = QString("<font color=\"#666666\">%1</font>").arg(text);
         break;
 
     case LogView::ot_error:
-        append(QString("<font color=\"#800000\">%1</font>").arg(text));
+        html = QString("<font color=\"#800000\">%1</font>").arg(text);
         break;
     }
 
-    // m_messageInfoMap[  paragraphs()-1 ] = messageInfo;
-    m_messageInfoMap[document()->blockCount() - 1] = messageInfo;
+    m_pendingOutput.append(qMakePair(html, messageInfo));
+    if (!m_flushTimer->isActive())
+        m_flushTimer->start();
+}
+
+void LogView::flushOutput()
+{
+    m_flushTimer->stop();
+    if (m_pendingOutput.isEmpty())
+        return;
+
+    QScrollBar *scrollBar = verticalScrollBar();
+    const bool atBottom = (scrollBar->value() == scrollBar->maximum());
+
+    QTextCursor cursor(document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.beginEditBlock();
+
+    // Like append, which starts a new paragraph unless the view is empty
+    bool isEmpty = document()->isEmpty();
+    for (const QPair<QString, MessageInfo> &output : qAsConst(m_pendingOutput)) {
+        if (!isEmpty)
+            cursor.insertBlock();
+        isEmpty = false;
+        cursor.insertHtml(output.first);
+        m_messageInfoMap[cursor.blockNumber()] = output.second;
+    }
+
+    cursor.endEditBlock();
+    m_pendingOutput.clear();
+
+    if (atBottom)
+        scrollBar->setValue(scrollBar->maximum());
 }
 
 void LogView::mouseDoubleClickEvent(QMouseEvent *e)
@@ -15,8 +15,11 @@ class KTechlab;
 // class Q3PopupMenu;
 
 #include <KTextEdit>
+#include <QList>
 #include <QMap>
 
+class QTimer;
+
 namespace KateMDI
 {
 class ToolView;
@@ -71,7 +74,16 @@ signals:
 
 public slots:
     virtual void clear();
+    /**
+     * Queues the text to be added. The queued output is added in one go
+     * shortly after, so that a process outputting thousands of lines does
+     * not have the view laid out again for each of them.
+     */
     void addOutput(QString text, OutputType outputType, MessageInfo messageInfo = MessageInfo());
+    /**
+     * Adds the output queued by addOutput.
+     */
+    void flushOutput();
 
 protected:
     virtual QMenu *createPopupMenu(const QPoint &pos);
@@ -85,6 +97,8 @@ protected:
     void untidyText(QString &t);
 
     MessageInfoMap m_messageInfoMap;
+    QList<QPair<QString, MessageInfo>> m_pendingOutput; // HTML of the queued paragraphs
+    QTimer *m_flushTimer;
 
     void mouseDoubleClickEvent(QMouseEvent *e) override;
 
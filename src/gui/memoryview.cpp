@@ -0,0 +1,225 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "memoryview.h"
+#include "docmanager.h"
+#include "itemdocument.h"
+#include "katemdi.h"
+#include "memoryusage.h"
+
+#include <KFormat>
+#include <KLocalizedString>
+#include <KMessageBox>
+
+#include <QGridLayout>
+#include <QHeaderView>
+#include <QPushButton>
+#include <QSet>
+#include <QTimer>
+#include <QTreeWidget>
+
+#include <cassert>
+
+#include <ktechlab_debug.h>
+
+static const int NAME_COLUMN = 0;
+static const int SIZE_COLUMN = 1;
+
+static QString subsystemName(int subsystem)
+{
+    switch (subsystem) {
+    case MemoryUsage::UndoHistory:
+        return i18n("Undo history");
+    case MemoryUsage::ProbeData:
+        return i18n("Probe data");
+    case MemoryUsage::LogicCaches:
+        return i18n("Logic caches");
+    case MemoryUsage::RoutingCells:
+        return i18n("Routing cells");
+    case MemoryUsage::CanvasChunks:
+        return i18n("Canvas chunks");
+    case MemoryUsage::CanvasTiles:
+        return i18n("Canvas tiles");
+    case MemoryUsage::HiddenSubcircuitItems:
+        return i18n("Hidden subcircuit items");
+    }
+    return QString();
+}
+
+static void setSize(QTreeWidgetItem *item, qint64 bytes)
+{
+    item->setText(SIZE_COLUMN, KFormat().formatByteSize(bytes));
+    item->setToolTip(SIZE_COLUMN, i18np("1 byte", "%1 bytes", bytes));
+    item->setTextAlignment(SIZE_COLUMN, Qt::AlignRight | Qt::AlignVCenter);
+}
+
+// BEGIN class MemoryView
+MemoryView *MemoryView::m_pSelf = nullptr;
+MemoryView *MemoryView::self(KateMDI::ToolView *parent)
+{
+    if (!m_pSelf) {
+        assert(parent);
+        m_pSelf = new MemoryView(parent);
+    }
+    return m_pSelf;
+}
+
+MemoryView::MemoryView(KateMDI::ToolView *parent)
+    : QWidget(static_cast<QWidget *>(parent))
+{
+    if (parent->layout()) {
+        parent->layout()->addWidget(this);
+    } else {
+        qCWarning(KTL_LOG) << " unexpected null layout on parent " << parent;
+    }
+
+    QGridLayout *grid = new QGridLayout(this);
+    grid->setMargin(0);
+    grid->setSpacing(6);
+
+    m_pTree = new QTreeWidget(this);
+    m_pTree->setFocusPolicy(Qt::NoFocus);
+    m_pTree->setHeaderLabels({i18n("Document"), i18n("Memory")});
+    m_pTree->headerItem()->setToolTip(SIZE_COLUMN, i18n("Estimated from the larger structures only, so the real use is somewhat more."));
+    m_pTree->header()->setSectionResizeMode(NAME_COLUMN, QHeaderView::Stretch);
+    m_pTree->header()->setSectionResizeMode(SIZE_COLUMN, QHeaderView::ResizeToContents);
+    m_pTree->header()->setStretchLastSection(false);
+    connect(m_pTree, &QTreeWidget::itemSelectionChanged, this, &MemoryView::slotSelectionChanged);
+    grid->addWidget(m_pTree, 0, 0, 1, 3);
+
+    QPushButton *trimButton = new QPushButton(i18n("Trim Caches"), this);
+    trimButton->setToolTip(i18n("Frees the rendered tiles of the canvases and the logic caches of the circuits of every document; they are made again as they are needed."));
+    connect(trimButton, &QPushButton::clicked, this, &MemoryView::slotTrimCaches);
+    grid->addWidget(trimButton, 1, 1);
+
+    m_pClearUndoButton = new QPushButton(i18n("Clear Undo History"), this);
+    m_pClearUndoButton->setToolTip(i18n("Forgets the undo and redo history of the selected document."));
+    m_pClearUndoButton->setEnabled(false);
+    connect(m_pClearUndoButton, &QPushButton::clicked, this, &MemoryView::slotClearUndoHistory);
+    grid->addWidget(m_pClearUndoButton, 1, 2);
+
+    grid->setColumnStretch(0, 1);
+
+    m_pUpdateTimer = new QTimer(this);
+    connect(m_pUpdateTimer, &QTimer::timeout, this, &MemoryView::slotUpdate);
+}
+
+MemoryView::~MemoryView()
+{
+}
+
+void MemoryView::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+
+    slotUpdate();
+    m_pUpdateTimer->start(UPDATE_INTERVAL_MS);
+}
+
+void MemoryView::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+
+    m_pUpdateTimer->stop();
+}
+
+ItemDocument *MemoryView::selectedDocument() const
+{
+    QTreeWidgetItem *item = m_pTree->currentItem();
+    if (!item || !item->isSelected())
+        return nullptr;
+    while (item->parent())
+        item = item->parent();
+
+    const int index = m_pTree->indexOfTopLevelItem(item);
+    return (index >= 0 && index < m_documents.size()) ? m_documents[index].data() : nullptr;
+}
+
+void MemoryView::slotSelectionChanged()
+{
+    m_pClearUndoButton->setEnabled(selectedDocument());
+}
+
+void MemoryView::slotUpdate()
+{
+    // The rows are made again, so which documents were expanded and selected
+    // is remembered by document
+    QSet<ItemDocument *> expanded;
+    for (int i = 0; i < m_pTree->topLevelItemCount() && i < m_documents.size(); ++i) {
+        if (m_pTree->topLevelItem(i)->isExpanded())
+            expanded.insert(m_documents[i].data());
+    }
+    ItemDocument *selected = selectedDocument();
+
+    m_pTree->blockSignals(true);
+    m_pTree->clear();
+    m_documents.clear();
+
+    QTreeWidgetItem *selectedItem = nullptr;
+    const DocumentList documents = DocManager::self()->documentList();
+    for (Document *document : documents) {
+        ItemDocument *itemDocument = dynamic_cast<ItemDocument *>(document);
+        if (!itemDocument)
+            continue;
+
+        const MemoryUsage usage = itemDocument->memoryUsage();
+
+        QTreeWidgetItem *documentItem = new QTreeWidgetItem(m_pTree);
+        documentItem->setText(NAME_COLUMN, itemDocument->caption());
+        setSize(documentItem, usage.total());
+        for (int subsystem = 0; subsystem < MemoryUsage::SubsystemCount; ++subsystem) {
+            QTreeWidgetItem *subsystemItem = new QTreeWidgetItem(documentItem);
+            subsystemItem->setText(NAME_COLUMN, subsystemName(subsystem));
+            setSize(subsystemItem, usage.bytes[subsystem]);
+        }
+
+        documentItem->setExpanded(expanded.contains(itemDocument));
+        if (itemDocument == selected)
+            selectedItem = documentItem;
+        m_documents << itemDocument;
+    }
+
+    if (selectedItem)
+        m_pTree->setCurrentItem(selectedItem);
+    m_pTree->blockSignals(false);
+
+    slotSelectionChanged();
+}
+
+void MemoryView::slotTrimCaches()
+{
+    const DocumentList documents = DocManager::self()->documentList();
+    for (Document *document : documents) {
+        if (ItemDocument *itemDocument = dynamic_cast<ItemDocument *>(document))
+            itemDocument->trimCaches();
+    }
+
+    slotUpdate();
+}
+
+void MemoryView::slotClearUndoHistory()
+{
+    // The document may be closed while asking
+    QPointer<ItemDocument> document = selectedDocument();
+    if (!document)
+        return;
+
+    KGuiItem clearItem = KStandardGuiItem::clear();
+    clearItem.setText(i18n("Clear History"));
+    const int answer = KMessageBox::warningContinueCancel(this, i18n("Clear the undo and redo history of \"%1\"? This cannot be undone.", document->caption()), i18n("Clear Undo History"), clearItem);
+    if (answer != KMessageBox::Continue || !document)
+        return;
+
+    document->clearHistory();
+    slotUpdate();
+}
+// END class MemoryView
+
+#include "moc_memoryview.cpp"
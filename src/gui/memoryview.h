@@ -0,0 +1,82 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef MEMORYVIEW_H
+#define MEMORYVIEW_H
+
+#include <QList>
+#include <QPointer>
+#include <QWidget>
+
+class ItemDocument;
+class QPushButton;
+class QTimer;
+class QTreeWidget;
+
+namespace KateMDI
+{
+class ToolView;
+}
+
+/**
+Shows the memory that each open circuit or FlowCode document is using, broken
+down by subsystem, with actions to free what can be made again.
+@see ItemDocument::memoryUsage
+*/
+class MemoryView : public QWidget
+{
+    Q_OBJECT
+public:
+    static MemoryView *self(KateMDI::ToolView *parent = nullptr);
+    static QString toolViewIdentifier()
+    {
+        return "MemoryView";
+    }
+    ~MemoryView() override;
+
+    /**
+     * How often the figures are updated while the view is shown.
+     */
+    static const int UPDATE_INTERVAL_MS = 2000;
+
+public slots:
+    void slotUpdate();
+    /**
+     * Frees the caches of every open document.
+     */
+    void slotTrimCaches();
+    /**
+     * Clears the undo / redo history of the selected document, after asking.
+     */
+    void slotClearUndoHistory();
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private slots:
+    void slotSelectionChanged();
+
+private:
+    MemoryView(KateMDI::ToolView *parent);
+    static MemoryView *m_pSelf;
+
+    /**
+     * @return the document of the selected row, or nullptr
+     */
+    ItemDocument *selectedDocument() const;
+
+    QTreeWidget *m_pTree;
+    QPushButton *m_pClearUndoButton;
+    QTimer *m_pUpdateTimer;
+    QList<QPointer<ItemDocument>> m_documents; ///< Of the top-level rows of the tree, in order
+};
+
+#endif
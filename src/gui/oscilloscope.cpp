@@ -13,17 +13,23 @@
 #include "oscilloscopedata.h"
 #include "oscilloscopeview.h"
 #include "probe.h"
+#include "probedatawriter.h"
+#include "probeexportdlg.h"
 #include "probepositioner.h"
+#include "protocoldecoder.h"
 #include "simulator.h"
 
 #include <KConfigGroup>
 #include <KLocalizedString>
+#include <KMessageBox>
 #include <KSharedConfig>
 #include <cmath>
 
 // #include <q3button.h>
 
+#include <QFile>
 #include <QLabel>
+#include <QScopedPointer>
 #include <QScrollBar>
 #include <QSlider>
 #include <QStyleFactory>
@@ -68,6 +74,11 @@ Oscilloscope::Oscilloscope(KateMDI::ToolView *parent)
     // 	b_isPaused = false;
     m_zoomLevel = 0.5;
     m_pSimulator = Simulator::self();
+    m_triggerState = Armed;
+    m_triggerProbe = nullptr;
+    m_triggerTime = 0;
+    m_holdTime = 0;
+    m_collectedTime = 0;
 
     horizontalScroll->setSingleStep(32);
     horizontalScroll->setPageStep(oscilloscopeView->width());
@@ -76,12 +87,14 @@ Oscilloscope::Oscilloscope(KateMDI::ToolView *parent)
     zoomDial->setNotchesVisible(true);
 
     connect(resetBtn, &QPushButton::clicked, this, &Oscilloscope::reset);
+    connect(exportBtn, &QPushButton::clicked, this, &Oscilloscope::slotExportData);
     connect(zoomDial, &QDial::valueChanged, this, &Oscilloscope::slotZoomDialChanged);
     connect(horizontalScroll, &QScrollBar::valueChanged, this, &Oscilloscope::slotSliderValueChanged);
 
     // 	connect( pauseBtn, SIGNAL(clicked()), this, SLOT(slotTogglePause()));
 
     QTimer *updateScrollTmr = new QTimer(this);
+    connect(updateScrollTmr, &QTimer::timeout, this, &Oscilloscope::updateTrigger);
     connect(updateScrollTmr, &QTimer::timeout, this, &Oscilloscope::updateScrollbars);
     updateScrollTmr->start(20);
 
@@ -178,6 +191,7 @@ ProbeData *Oscilloscope::registerProbe(Probe *probe)
     }
 
     m_probeDataMap[id] = probeData;
+    probeData->setName(probe->id());
 
     if (!m_oldestProbe) {
         m_oldestProbe = probeData;
@@ -203,6 +217,7 @@ void Oscilloscope::unregisterProbe(int id)
     m_floatingProbeDataMap.remove(id);
 
     bool oldestDestroyed = it.value() == m_oldestProbe;
+    const bool triggerDestroyed = it.value() == m_triggerProbe;
 
     if (it != m_probeDataMap.end())
         m_probeDataMap.erase(it);
@@ -210,6 +225,9 @@ void Oscilloscope::unregisterProbe(int id)
     if (oldestDestroyed)
         getOldestProbe();
 
+    if (triggerDestroyed)
+        rearmTrigger();
+
     emit probeUnregistered(id);
 }
 
@@ -257,7 +275,134 @@ void Oscilloscope::reset()
     for (ProbeDataMap::iterator it = m_probeDataMap.begin(); it != end; ++it)
         (*it)->eraseData();
 
-    oscilloscopeView->updateView();
+    rearmTrigger();
+    oscilloscopeView->updateFullView();
+}
+
+void Oscilloscope::rearmTrigger()
+{
+    m_triggerState = Armed;
+    m_triggerProbe = nullptr;
+
+    const ProbeDataMap::iterator end = m_probeDataMap.end();
+    for (ProbeDataMap::iterator it = m_probeDataMap.begin(); it != end; ++it)
+        (*it)->setRecording(true);
+}
+
+void Oscilloscope::collectProbeData()
+{
+    // Anything recorded up to now will be in the queues
+    m_collectedTime = recordTime();
+
+    const ProbeDataMap::iterator end = m_probeDataMap.end();
+    for (ProbeDataMap::iterator it = m_probeDataMap.begin(); it != end; ++it)
+        (*it)->collectData();
+
+    // The decoders carry on from the edges they have already seen
+    const LogicProbeDataMap::iterator logicEnd = m_logicProbeDataMap.end();
+    for (LogicProbeDataMap::iterator it = m_logicProbeDataMap.begin(); it != logicEnd; ++it) {
+        ProtocolDecoder *decoder = (*it)->decoder();
+        if (!decoder)
+            continue;
+
+        if (decoder->needsClock()) {
+            for (LogicProbeDataMap::iterator clock = m_logicProbeDataMap.begin(); clock != logicEnd; ++clock) {
+                if ((*clock)->name() == decoder->clockProbeName()) {
+                    decoder->setClock(*clock);
+                    break;
+                }
+            }
+        }
+        decoder->update(m_collectedTime);
+    }
+}
+
+void Oscilloscope::updateTrigger()
+{
+    collectProbeData();
+
+    const ProbeDataMap::iterator end = m_probeDataMap.end();
+
+    if (m_triggerState == Armed) {
+        bool hasTrigger = false;
+        uint64_t preTime = 0;
+        for (ProbeDataMap::iterator it = m_probeDataMap.begin(); it != end && m_triggerState == Armed; ++it) {
+            ProbeData *probe = *it;
+            if (probe->triggerType() == ProbeData::NoTrigger)
+                continue;
+
+            hasTrigger = true;
+            preTime = qMax(preTime, probe->triggerPreTime());
+            if (probe->findTrigger(&m_triggerTime)) {
+                m_triggerState = Triggered;
+                m_triggerProbe = probe;
+                preTime = probe->triggerPreTime();
+            }
+        }
+
+        // Without a trigger, everything is recorded
+        if (!hasTrigger)
+            return;
+
+        // Only keep the data from the time before the trigger (or now, if
+        // there has not been one yet) that is wanted
+        const uint64_t keepFrom = (m_triggerState == Triggered) ? m_triggerTime : m_pSimulator->time();
+        for (ProbeDataMap::iterator it = m_probeDataMap.begin(); it != end; ++it)
+            (*it)->discardBefore((keepFrom > preTime) ? keepFrom - preTime : 0);
+    }
+
+    if (m_triggerState != Triggered || m_pSimulator->time() < m_triggerTime + m_triggerProbe->triggerPostTime())
+        return;
+
+    // Everything wanted after the trigger has been recorded, so stop there
+    // and show the trigger in the middle of the view
+    m_triggerState = Held;
+    m_holdTime = m_pSimulator->time();
+    for (ProbeDataMap::iterator it = m_probeDataMap.begin(); it != end; ++it)
+        (*it)->setRecording(false);
+
+    updateScrollbars();
+    if (m_oldestProbe) {
+        const int pageLength = int(oscilloscopeView->width() * sliderTicksPerSecond() / pixelsPerSecond());
+        const int64_t triggerTicks = int64_t(m_triggerTime - m_oldestProbe->resetTime()) * sliderTicksPerSecond() / LOGIC_UPDATE_RATE;
+        horizontalScroll->setValue(int(triggerTicks - pageLength / 2));
+    }
+    oscilloscopeView->updateFullView();
+}
+
+void Oscilloscope::slotExportData()
+{
+    collectProbeData();
+
+    ProbeExportDialog exportDialog(m_probeDataMap.values(), this);
+    const uint64_t visibleBegin = scrollTime();
+    exportDialog.setRanges(m_oldestProbe ? m_oldestProbe->resetTime() : 0, recordTime(), visibleBegin, visibleBegin + uint64_t(oscilloscopeView->width() * LOGIC_UPDATE_RATE / pixelsPerSecond()));
+    if (exportDialog.exec() == QDialog::Rejected)
+        return;
+
+    const QString fileName = exportDialog.filePath();
+    const ProbeExportDialog::Format format = exportDialog.format();
+
+    QFile file(fileName);
+    if (!file.open((format == ProbeExportDialog::BinaryFormat) ? QIODevice::WriteOnly : (QIODevice::WriteOnly | QIODevice::Text))) {
+        KMessageBox::error(this, i18n("Could not open '%1' for writing. Check that you have write permissions", fileName), i18n("Saving File"));
+        return;
+    }
+
+    QScopedPointer<ProbeDataWriter> writer;
+    switch (format) {
+    case ProbeExportDialog::CsvFormat:
+        writer.reset(new CsvProbeDataWriter(&file));
+        break;
+    case ProbeExportDialog::BinaryFormat:
+        writer.reset(new BinaryProbeDataWriter(&file));
+        break;
+    case ProbeExportDialog::VcdFormat:
+        writer.reset(new VcdProbeDataWriter(&file));
+        break;
+    }
+
+    writer->write(exportDialog.selectedProbes(), exportDialog.rangeBegin(), exportDialog.rangeEnd());
 }
 
 void Oscilloscope::slotSliderValueChanged(int value)
@@ -290,7 +435,12 @@ uint64_t Oscilloscope::time() const
     if (!m_oldestProbe)
         return 0;
 
-    return uint64_t(m_pSimulator->time() - m_oldestProbe->resetTime());
+    return uint64_t(recordTime() - m_oldestProbe->resetTime());
+}
+
+uint64_t Oscilloscope::recordTime() const
+{
+    return (m_triggerState == Held) ? m_holdTime : m_pSimulator->time();
 }
 
 int64_t Oscilloscope::scrollTime() const
@@ -303,7 +453,7 @@ int64_t Oscilloscope::scrollTime() const
 
     if (horizontalScroll->maximum() == 0) {
         int64_t lengthAsTime = int64_t(oscilloscopeView->width() * LOGIC_UPDATE_RATE / pixelsPerSecond());
-        int64_t ret = m_pSimulator->time() - lengthAsTime;
+        int64_t ret = recordTime() - lengthAsTime;
         if (ret < 0)
             return 0;
         return ret;
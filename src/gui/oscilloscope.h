@@ -153,6 +153,11 @@ public slots:
      * Resets all recorded data
      */
     void reset();
+    /**
+     * Asks which probes, over what time, to export the data of, and saves
+     * it to the file and in the format asked for
+     */
+    void slotExportData();
     /**
      * Called when the zoom slider value was changed.
      */
@@ -167,7 +172,26 @@ public slots:
     void slotTogglePause();
 
 protected:
+    enum TriggerState {
+        Armed, // Keeping the data from just before now, for when a probe triggers
+        Triggered, // Recording the data after the trigger
+        Held // Not recording, as all the data wanted around the trigger is there
+    };
+
     void getOldestProbe();
+    /**
+     * Starts looking for a trigger again, recording on all probes.
+     */
+    void rearmTrigger();
+    /**
+     * @return the Simulator time that the probes have been recorded up to
+     */
+    uint64_t recordTime() const;
+    /**
+     * Adds the data points recorded by the simulation to the data of each
+     * probe (see ProbeData::collectData).
+     */
+    void collectProbeData();
 
     int m_nextId;
     ProbeData *m_oldestProbe;
@@ -180,8 +204,19 @@ protected:
 
     Simulator *m_pSimulator;
 
+    TriggerState m_triggerState;
+    ProbeData *m_triggerProbe; // The probe that triggered, if any
+    uint64_t m_triggerTime;
+    uint64_t m_holdTime;
+    uint64_t m_collectedTime; // The recordTime() when the probe data was last collected
+
 protected slots:
     void updateScrollbars();
+    /**
+     * Looks for the probes with a trigger set meeting their condition, and
+     * drops or stops recording the data that is not wanted around it.
+     */
+    void updateTrigger();
 
 private:
     Oscilloscope(KateMDI::ToolView *parent);
@@ -12,6 +12,7 @@
 #include "oscilloscopedata.h"
 #include "oscilloscopeview.h"
 #include "probepositioner.h"
+#include "protocoldecoder.h"
 #include "simulator.h"
 
 #include <KConfigGroup>
@@ -30,6 +31,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
 
 #include <ktechlab_debug.h>
 
@@ -43,7 +45,10 @@ inline uint64_t min(uint64_t a, uint64_t b)
 OscilloscopeView::OscilloscopeView(QWidget *parent)
     : QFrame(parent /*, Qt::WNoAutoErase */)
     , b_needRedraw(true)
+    , b_needFullRedraw(true)
     , m_pixmap(nullptr)
+    , m_renderTime(0)
+    , m_renderEnd(0)
     , m_fps(10)
     , m_sliderValueAtClick(-1)
     , m_clickOffsetPos(-1)
@@ -68,24 +73,45 @@ OscilloscopeView::~OscilloscopeView()
 
 void OscilloscopeView::updateView()
 {
-    if (m_updateViewTmr->isActive())
+    // Nothing to draw while the tool view is hidden; showEvent redraws
+    if (!isVisible() || m_updateViewTmr->isActive())
         return;
 
     m_updateViewTmr->setSingleShot(true);
     m_updateViewTmr->start(1000 / m_fps);
 }
 
+void OscilloscopeView::updateFullView()
+{
+    b_needFullRedraw = true;
+    updateView();
+}
+
 void OscilloscopeView::updateViewTimeout()
 {
     b_needRedraw = true;
     repaint();
 }
 
+void OscilloscopeView::showEvent(QShowEvent *e)
+{
+    b_needRedraw = true;
+    b_needFullRedraw = true;
+    QFrame::showEvent(e);
+}
+
+void OscilloscopeView::hideEvent(QHideEvent *e)
+{
+    m_updateViewTmr->stop();
+    QFrame::hideEvent(e);
+}
+
 void OscilloscopeView::resizeEvent(QResizeEvent *e)
 {
     delete m_pixmap;
     m_pixmap = new QPixmap(e->size());
     b_needRedraw = true;
+    b_needFullRedraw = true;
     QFrame::resizeEvent(e);
 }
 
@@ -170,6 +196,11 @@ void OscilloscopeView::slotSetFrameRate(QAction *action)
 
 void OscilloscopeView::paintEvent(QPaintEvent *e)
 {
+    // The probes pass their data through queues, so the simulation does not
+    // need to be stopped while drawing it
+    if (b_needRedraw)
+        Oscilloscope::self()->collectProbeData();
+
     QPainter p(this);
     if (!p.isActive()) {
         qCWarning(KTL_LOG) << "Painter is not active";
@@ -183,29 +214,98 @@ void OscilloscopeView::paintEvent(QPaintEvent *e)
             return;
         }
 
-        QPainter pixmapPainter(m_pixmap);
-        if (!pixmapPainter.isActive()) {
-            qCWarning(KTL_LOG) << "Pixmap painter is not active";
-            return;
-        }
-
-        m_pixmap->fill(palette().color(backgroundRole()));
-        drawGrid(pixmapPainter);
-        drawLogicData(pixmapPainter);
-        drawFloatingData(pixmapPainter);
-        pixmapPainter.setPen(Qt::black);
-        pixmapPainter.drawRect(frameRect());
+        updatePixmap();
         b_needRedraw = false;
     }
 
     QRect r = e->rect();
     p.drawPixmap(r, *m_pixmap, r);
 
+    // The grid and frame stay put while the traces move along under them,
+    // so they are drawn over the pixmap rather than into it
+    drawGrid(p);
+    p.setPen(Qt::black);
+    p.drawRect(frameRect());
+
     if (testAttribute(Qt::WA_UnderMouse)) {
         drawTimeCursorLine(p);
     }
 }
 
+void OscilloscopeView::updatePixmap()
+{
+    Oscilloscope *oscilloscope = Oscilloscope::self();
+    const double timePerPixel = LOGIC_UPDATE_RATE / oscilloscope->pixelsPerSecond();
+    const int64_t scrollTime = oscilloscope->scrollTime();
+    const QVector<double> key = renderKey();
+
+    // When only the scroll position and the data have moved on since the
+    // pixmap was last drawn, what is there is moved along by a whole number
+    // of pixels and just the part from where the data ended before is drawn
+    int fromX = 0;
+    if (!b_needFullRedraw && key == m_renderKey && scrollTime >= m_renderTime) {
+        const double shift = floor((scrollTime - m_renderTime) / timePerPixel);
+        const double renderTime = m_renderTime + shift * timePerPixel;
+        const double keptX = floor((double(m_renderEnd) - renderTime) / timePerPixel) - 1;
+        if (shift < width() && keptX > 0) {
+            m_pixmap->scroll(-int(shift), 0, m_pixmap->rect());
+            m_renderTime = renderTime;
+            fromX = int(qMin(keptX, double(width())));
+        }
+    }
+
+    // What has been decoded since may begin before the data that is new
+    uint64_t decodedFrom = std::numeric_limits<uint64_t>::max();
+    const LogicProbeDataMap::const_iterator logicEnd = oscilloscope->m_logicProbeDataMap.end();
+    for (LogicProbeDataMap::const_iterator it = oscilloscope->m_logicProbeDataMap.begin(); it != logicEnd; ++it) {
+        if (ProtocolDecoder *decoder = (*it)->decoder())
+            decodedFrom = qMin(decodedFrom, decoder->takeChangedFrom());
+    }
+    if (fromX > 0 && decodedFrom != std::numeric_limits<uint64_t>::max())
+        fromX = int(qBound(0.0, floor((double(decodedFrom) - m_renderTime) / timePerPixel) - 1, double(fromX)));
+
+    if (fromX == 0) {
+        m_renderTime = scrollTime;
+        m_renderKey = key;
+        b_needFullRedraw = false;
+    }
+    m_renderEnd = oscilloscope->m_collectedTime;
+
+    if (fromX >= width())
+        return;
+
+    QPainter pixmapPainter(m_pixmap);
+    if (!pixmapPainter.isActive()) {
+        qCWarning(KTL_LOG) << "Pixmap painter is not active";
+        return;
+    }
+
+    const QRect changed(fromX, 0, width() - fromX, height());
+    pixmapPainter.setClipRect(changed);
+    pixmapPainter.fillRect(changed, palette().color(backgroundRole()));
+    drawLogicData(pixmapPainter, m_renderTime, fromX);
+    drawFloatingData(pixmapPainter, m_renderTime, fromX);
+}
+
+QVector<double> OscilloscopeView::renderKey() const
+{
+    Oscilloscope *oscilloscope = Oscilloscope::self();
+
+    QVector<double> key;
+    key << width() << height() << oscilloscope->pixelsPerSecond() << m_halfOutputHeight;
+
+    const ProbeDataMap::const_iterator end = oscilloscope->m_probeDataMap.end();
+    for (ProbeDataMap::const_iterator it = oscilloscope->m_probeDataMap.begin(); it != end; ++it) {
+        ProbeData *probe = it.value();
+        key << it.key() << oscilloscope->probePositioner->probePosition(probe) << probe->color().rgba() << double(probe->resetTime());
+
+        if (FloatingProbeData *floatingProbe = dynamic_cast<FloatingProbeData *>(probe))
+            key << floatingProbe->scaling() << floatingProbe->upperAbsValue() << floatingProbe->lowerAbsValue() << floatingProbe->sampleRate();
+    }
+
+    return key;
+}
+
 void OscilloscopeView::drawGrid(QPainter &p)
 {
     QPen gridPen(QColor(128, 128, 128, 128)); // Light grey color, semi-transparent
@@ -252,29 +352,18 @@ void OscilloscopeView::updateOutputHeight()
     m_halfOutputHeight = int((Oscilloscope::self()->probePositioner->probeOutputHeight() - (probeArrowWidth / Oscilloscope::self()->numberOfProbes())) / 2) - 1;
 }
 
-void OscilloscopeView::drawLogicData(QPainter &p)
+void OscilloscopeView::drawLogicData(QPainter &p, double timeOffset, int fromX)
 {
     const double pixelsPerSecond = Oscilloscope::self()->pixelsPerSecond();
 
     const LogicProbeDataMap::iterator end = Oscilloscope::self()->m_logicProbeDataMap.end();
     for (LogicProbeDataMap::iterator it = Oscilloscope::self()->m_logicProbeDataMap.begin(); it != end; ++it) {
-        // When searching for the next logic value to display, we look along
-        // until there is a recorded point which is at least one pixel along
-        // If we are zoomed out far, there might be thousands of data points
-        // between each pixel. It is time consuming searching for the next point
-        // to display one at a time, so we record the average number of data points
-        // between pixels ( = deltaAt / totalDeltaAt)
-        int64_t deltaAt = 1;
-        int totalDeltaAt = 1;
-
         LogicProbeData *probe = it.value();
 
-        vector<LogicDataPoint> *data = probe->m_data;
-        if (!data->size())
+        if (probe->isEmpty())
             continue;
 
         const int midHeight = Oscilloscope::self()->probePositioner->probePosition(probe);
-        const int64_t timeOffset = Oscilloscope::self()->scrollTime();
 
         // Draw the horizontal line indicating the midpoint of our output
         p.setPen(QColor(228, 228, 228));
@@ -283,86 +372,109 @@ void OscilloscopeView::drawLogicData(QPainter &p)
         // Set the pen colour according to the colour the user has selected for the probe
         p.setPen(probe->color());
 
-        // The smallest time step that will display in our oscilloscope
-        const int minTimeStep = int(LOGIC_UPDATE_RATE / pixelsPerSecond);
+        // The time that each column of pixels covers
+        const double timePerPixel = LOGIC_UPDATE_RATE / pixelsPerSecond;
+        const auto toX = [&](uint64_t time) {
+            return int(qBound(-1.0, (double(time) - timeOffset) / timePerPixel, width() + 1.0));
+        };
 
-        int64_t at = probe->findPos(timeOffset);
-        const int64_t maxAt = probe->m_data->size();
-        int64_t prevTime = (*data)[at].time;
-        int prevX = (at > 0) ? 0 : int((prevTime - timeOffset) * (pixelsPerSecond / LOGIC_UPDATE_RATE));
-        bool prevHigh = (*data)[at].value;
+        // Start a column early, to join up with what is already there
+        const int startX = qMax(0, fromX - 1);
+        const uint64_t maxAt = probe->endIndex();
+        uint64_t at = probe->findPos(uint64_t(qMax(0.0, timeOffset + startX * timePerPixel)));
+        int prevX = qMax(startX, toX(probe->dataPoint(at).time));
+        bool prevHigh = probe->dataPoint(at).value;
         int prevY = midHeight + int(prevHigh ? -m_halfOutputHeight : +m_halfOutputHeight);
 
-        while (at < maxAt) {
-            // Search for the next pos which will show up at our zoom level
-            int64_t previousAt = at;
-            int64_t dAt = deltaAt / totalDeltaAt;
-
-            while ((dAt > 1) && (at < maxAt) && ((int64_t((*data)[at].time) - prevTime) != minTimeStep)) {
-                // Search forwards until we overshoot
-                while (at < maxAt && (int64_t((*data)[at].time) - prevTime) < minTimeStep)
-                    at += dAt;
-                dAt /= 2;
-
-                // Search backwards until we undershoot
-                while ((at < maxAt) && (int64_t((*data)[at].time) - prevTime) > minTimeStep) {
-                    at -= dAt;
-                    if (at < 0)
-                        at = 0;
-                }
-                dAt /= 2;
+        // Go along a column of pixels at a time. The columns that the value
+        // does not change in are skipped, and for those that it changes in,
+        // the pyramid of the probe data says whether it is high or low in
+        // between, without going through each of the data points.
+        int x = prevX;
+        uint64_t next = at + 1;
+        while (next < maxAt && x <= width()) {
+            const int64_t columnEnd = int64_t(timeOffset + (x + 1) * timePerPixel);
+            const uint64_t last = probe->findPos(columnEnd);
+            if (last < next) {
+                x = toX(probe->dataPoint(next).time);
+                continue;
             }
 
-            // Possibly increment the value of at found by one (or more if this is the first go)
-            while ((previousAt == at) || ((at < maxAt) && (int64_t((*data)[at].time) - prevTime) < minTimeStep))
-                at++;
-
-            if (at >= maxAt)
-                break;
+            MinMax<bool> values = probe->valueRange(next, last + 1);
+            values.include(MinMax<bool>(prevHigh));
 
-            // Update the average values
-            deltaAt += at - previousAt;
-            totalDeltaAt++;
+            p.drawLine(prevX, prevY, x, prevY);
+            if (values.min != values.max)
+                p.drawLine(x, midHeight - m_halfOutputHeight, x, midHeight + m_halfOutputHeight);
 
-            bool nextHigh = (*data)[at].value;
-            if (nextHigh == prevHigh)
-                continue;
+            prevHigh = probe->dataPoint(last).value;
+            prevX = x;
+            prevY = midHeight + int(prevHigh ? -m_halfOutputHeight : +m_halfOutputHeight);
 
-            int64_t nextTime = (*data)[at].time;
-            int nextX = int((nextTime - timeOffset) * (pixelsPerSecond / LOGIC_UPDATE_RATE));
-            int nextY = midHeight + int(nextHigh ? -m_halfOutputHeight : +m_halfOutputHeight);
+            next = last + 1;
+            ++x;
+        }
 
-            p.drawLine(prevX, prevY, nextX, prevY);
-            p.drawLine(nextX, prevY, nextX, nextY);
+        // Carry on the last value to the end
+        if (prevX < width())
+            p.drawLine(prevX, prevY, width(), prevY);
 
-            prevHigh = nextHigh;
-            prevTime = nextTime;
-            prevX = nextX;
-            prevY = nextY;
+        if (ProtocolDecoder *decoder = probe->decoder())
+            drawAnnotations(p, decoder, probe->color(), midHeight, timeOffset, fromX);
+    }
+}
 
-            if (nextX > width())
-                break;
-        };
+void OscilloscopeView::drawAnnotations(QPainter &p, const ProtocolDecoder *decoder, const QColor &color, int midHeight, double timeOffset, int fromX)
+{
+    const double timePerPixel = LOGIC_UPDATE_RATE / Oscilloscope::self()->pixelsPerSecond();
+    const auto toX = [&](uint64_t time) {
+        return int(qBound(-1.0, (double(time) - timeOffset) / timePerPixel, width() + 1.0));
+    };
+
+    const QFontMetrics metrics = p.fontMetrics();
+    const int boxHeight = qMin(metrics.height() + 2, 2 * m_halfOutputHeight);
+    const double endTime = timeOffset + (width() + 1) * timePerPixel;
+
+    // The labels of the instants (e.g. the I2C start and stop) reach to the
+    // right of them, so start a little before the columns being drawn
+    const int markerMargin = metrics.horizontalAdvance(QStringLiteral("Sr")) + 4;
+    const std::deque<ProtocolDecoder::Annotation> &annotations = decoder->annotations();
+    size_t at = decoder->findAnnotation(uint64_t(qMax(0.0, timeOffset + (fromX - markerMargin) * timePerPixel)));
+
+    for (; at < annotations.size() && double(annotations[at].begin) <= endTime; ++at) {
+        const ProtocolDecoder::Annotation &annotation = annotations[at];
+        const QColor lineColor = annotation.error ? QColor(Qt::red) : color;
+        const int left = toX(annotation.begin);
+
+        if (annotation.begin == annotation.end) {
+            p.setPen(lineColor);
+            p.drawLine(left, midHeight - m_halfOutputHeight, left, midHeight + m_halfOutputHeight);
+            p.drawText(left + 2, midHeight - m_halfOutputHeight + metrics.ascent(), annotation.text);
+            continue;
+        }
 
-        // If we could not draw right to the end; it is because we exceeded
-        // maxAt
-        if (prevX < width())
-            p.drawLine(prevX, prevY, width(), prevY);
+        QColor fillColor = lineColor;
+        fillColor.setAlpha(64);
+        const QRect box(left, midHeight - boxHeight / 2, qMax(toX(annotation.end) - left, 2), boxHeight);
+        p.fillRect(box, fillColor);
+        p.setPen(lineColor);
+        p.drawRect(box);
+        p.setPen(Qt::black);
+        p.drawText(box, Qt::AlignCenter, metrics.elidedText(annotation.text, Qt::ElideRight, box.width() - 4));
     }
 }
 
 #define v_to_y int(midHeight - (logarithmic ? ((v > 0) ? log(v / lowerAbsValue) : -log(-v / lowerAbsValue)) : v) * sf)
 
-void OscilloscopeView::drawFloatingData(QPainter &p)
+void OscilloscopeView::drawFloatingData(QPainter &p, double timeOffset, int fromX)
 {
     const double pixelsPerSecond = Oscilloscope::self()->pixelsPerSecond();
 
     const FloatingProbeDataMap::iterator end = Oscilloscope::self()->m_floatingProbeDataMap.end();
     for (FloatingProbeDataMap::iterator it = Oscilloscope::self()->m_floatingProbeDataMap.begin(); it != end; ++it) {
         FloatingProbeData *probe = it.value();
-        vector<float> *data = probe->m_data;
 
-        if (!data->size())
+        if (probe->isEmpty())
             continue;
 
         bool logarithmic = probe->scaling() == FloatingProbeData::Logarithmic;
@@ -370,7 +482,6 @@ void OscilloscopeView::drawFloatingData(QPainter &p)
         double sf = m_halfOutputHeight / (logarithmic ? log(probe->upperAbsValue() / lowerAbsValue) : probe->upperAbsValue());
 
         const int midHeight = Oscilloscope::self()->probePositioner->probePosition(probe);
-        const int64_t timeOffset = Oscilloscope::self()->scrollTime();
 
         // Draw the horizontal line indicating the midpoint of our output
         p.setPen(QColor(228, 228, 228));
@@ -379,37 +490,99 @@ void OscilloscopeView::drawFloatingData(QPainter &p)
         // Set the pen colour according to the colour the user has selected for the probe
         p.setPen(probe->color());
 
-        int64_t at = probe->findPos(timeOffset);
-        const int64_t atEnd = probe->m_data->size();
-        if (at > atEnd)
-            at = atEnd;
-        int64_t prevTime = probe->toTime(at);
+        // When there are several samples to a column of pixels, a line is
+        // drawn down each column from the greatest to the least value in it,
+        // which the pyramid of the probe data gives without going through
+        // each of the samples
+        const double samplesPerPixel = probe->sampleRate() / pixelsPerSecond;
+        if (samplesPerPixel >= 2) {
+            // The position of the left edge of the view in the samples
+            const double firstSample = (double(timeOffset) - double(probe->resetTime())) * probe->sampleRate() / LOGIC_UPDATE_RATE;
+            const double minAt = probe->beginIndex();
+            const double maxAt = probe->endIndex();
+
+            bool hasPrevious = false;
+            int prevX = 0;
+            int prevTop = 0;
+            int prevBottom = 0;
+            for (int x = qMax(0, fromX - 1); x <= width(); ++x) {
+                const double columnBegin = qBound(minAt, firstSample + x * samplesPerPixel, maxAt);
+                const double columnEnd = qBound(minAt, firstSample + (x + 1) * samplesPerPixel, maxAt);
+                if (uint64_t(columnBegin) >= uint64_t(columnEnd)) {
+                    if (columnBegin >= maxAt)
+                        break;
+                    continue;
+                }
+
+                const MinMax<float> values = probe->valueRange(uint64_t(columnBegin), uint64_t(columnEnd));
+                double v = values.max;
+                const int maxY = v_to_y;
+                v = values.min;
+                const int minY = v_to_y;
+                int top = qMin(minY, maxY);
+                int bottom = qMax(minY, maxY);
+
+                // Join up with the previous column
+                if (hasPrevious) {
+                    const int joinTop = qMin(top, prevBottom);
+                    const int joinBottom = qMax(bottom, prevTop);
+                    prevTop = top;
+                    prevBottom = bottom;
+                    top = joinTop;
+                    bottom = joinBottom;
+                } else {
+                    prevTop = top;
+                    prevBottom = bottom;
+                    hasPrevious = true;
+                }
+
+                p.drawLine(x, top, x, bottom);
+                prevX = x;
+            }
 
-        double v = 0;
-        if (at < atEnd) {
-            v = (*data)[(at > 0) ? at : 0];
+            // If we could not draw right to the end, it is because we ran
+            // out of samples
+            if (hasPrevious && prevX < width()) {
+                double v = probe->lastValue();
+                const int y = v_to_y;
+                p.drawLine(prevX, y, width(), y);
+            }
+            continue;
         }
-        int prevY = v_to_y;
-        int prevX = int((prevTime - timeOffset) * (pixelsPerSecond / LOGIC_UPDATE_RATE));
 
-        while (at < atEnd - 1) {
-            at++;
+        const auto toX = [&](uint64_t sample) {
+            return int(qBound(-1e6, (double(probe->toTime(sample)) - timeOffset) * (pixelsPerSecond / LOGIC_UPDATE_RATE), 1e6));
+        };
 
-            uint64_t nextTime = prevTime + uint64_t(LOGIC_UPDATE_RATE * LINEAR_UPDATE_PERIOD);
+        // Samples with the same value are drawn as one line along their
+        // run, which is then joined to the first sample of the next run
+        const uint64_t at = probe->findPos(uint64_t(qMax(0.0, timeOffset + (fromX - 1) / pixelsPerSecond * LOGIC_UPDATE_RATE)));
+        uint64_t run = probe->findRun(at);
+        double v = probe->run(run).value;
+        int prevY = v_to_y;
+        int prevX = toX(at);
 
-            double v = (*data)[(at > 0) ? at : 0];
-            int nextY = v_to_y;
-            int nextX = int((nextTime - timeOffset) * (pixelsPerSecond / LOGIC_UPDATE_RATE));
+        while (++run < probe->runEndIndex() && prevX <= width()) {
+            const FloatingRun next = probe->run(run);
 
-            p.drawLine(prevX, prevY, nextX, nextY);
+            const int lastX = toX(next.begin - 1);
+            p.drawLine(prevX, prevY, lastX, prevY);
+
+            v = next.value;
+            const int nextY = v_to_y;
+            const int nextX = toX(next.begin);
+            p.drawLine(lastX, prevY, nextX, nextY);
 
-            prevTime = nextTime;
             prevX = nextX;
             prevY = nextY;
+        }
 
-            if (nextX > width())
-                break;
-        };
+        // Along the last run, up to the newest sample
+        if (prevX <= width()) {
+            const int lastX = toX(probe->endIndex() - 1);
+            p.drawLine(prevX, prevY, lastX, prevY);
+            prevX = lastX;
+        }
 
         // If we could not draw right to the end; it is because we exceeded
         // maxAt
@@ -12,8 +12,12 @@
 #define OSCILLOSCOPEVIEW_H
 
 #include <QFrame>
+#include <QVector>
+
+#include <stdint.h>
 
 class Oscilloscope;
+class ProtocolDecoder;
 class Simulator;
 class QMouseEvent;
 class QPaintEvent;
@@ -35,6 +39,11 @@ public slots:
      * Sets the needRedraw flag to true, and then class repaint
      */
     void updateView();
+    /**
+     * As updateView, but draws everything again rather than just what has
+     * changed since the last time
+     */
+    void updateFullView();
     void slotSetFrameRate(QAction *);
 
 protected slots:
@@ -46,15 +55,40 @@ protected:
     void mouseReleaseEvent(QMouseEvent *event) override;
     void paintEvent(QPaintEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
 
+    /**
+     * Draws the probe data into the pixmap, reusing what was drawn last time
+     * where it can.
+     */
+    void updatePixmap();
+    /**
+     * @return everything other than the scroll position and the data that
+     * the drawing in the pixmap depends on
+     */
+    QVector<double> renderKey() const;
     void drawGrid(QPainter &p);
     void drawTimeCursorLine(QPainter &p);
-    void drawLogicData(QPainter &p);
-    void drawFloatingData(QPainter &p);
+    /**
+     * Draws the data of the probes, from the column of pixels fromX to the
+     * right edge.
+     * @param timeOffset the Simulator time at the left edge
+     */
+    void drawLogicData(QPainter &p, double timeOffset, int fromX);
+    void drawFloatingData(QPainter &p, double timeOffset, int fromX);
+    /**
+     * Draws what the decoder of a logic probe has decoded, over its trace.
+     */
+    void drawAnnotations(QPainter &p, const ProtocolDecoder *decoder, const QColor &color, int midHeight, double timeOffset, int fromX);
     void updateOutputHeight();
 
     bool b_needRedraw;
+    bool b_needFullRedraw;
     QPixmap *m_pixmap;
+    QVector<double> m_renderKey; // The renderKey() that the pixmap was drawn with
+    double m_renderTime; // The Simulator time at the left edge of the pixmap
+    uint64_t m_renderEnd; // The Simulator time that the data went up to when the pixmap was drawn
     QTimer *m_updateViewTmr;
     int m_fps;
     int m_sliderValueAtClick;
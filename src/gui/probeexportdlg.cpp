@@ -0,0 +1,189 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "probeexportdlg.h"
+#include "oscilloscopedata.h"
+#include "simulator.h"
+
+#include <KComboBox>
+#include <KLocalizedString>
+#include <KUrlRequester>
+
+#include <QDialogButtonBox>
+#include <QDoubleSpinBox>
+#include <QFormLayout>
+#include <QListWidget>
+#include <QPixmap>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+ProbeExportDialog::ProbeExportDialog(const QList<ProbeData *> &probes, QWidget *parent)
+    : QDialog(parent)
+    , m_nameFilters({
+          i18n("CSV Files (*.csv)"),
+          i18n("KTechLab Probe Data (*.ktlprobe)"),
+          i18n("Value Change Dump (*.vcd)"),
+      })
+    , m_probes(probes)
+    , m_recordedBegin(0)
+    , m_recordedEnd(0)
+    , m_visibleBegin(0)
+    , m_visibleEnd(0)
+{
+    setWindowTitle(i18n("Export Probe Data"));
+    setModal(true);
+
+    QVBoxLayout *layout = new QVBoxLayout;
+    setLayout(layout);
+
+    QFormLayout *formLayout = new QFormLayout;
+
+    m_formatSelect = new KComboBox(this);
+    m_formatSelect->addItem(i18n("Comma-separated values"));
+    m_formatSelect->addItem(i18n("Binary"));
+    m_formatSelect->addItem(i18n("Value Change Dump"));
+    formLayout->addRow(i18n("Format:"), m_formatSelect);
+
+    m_filePathEdit = new KUrlRequester(QUrl(), this);
+    m_filePathEdit->setAcceptMode(QFileDialog::AcceptSave);
+    m_filePathEdit->setMode(KFile::File | KFile::LocalOnly);
+    formLayout->addRow(i18n("File name:"), m_filePathEdit);
+
+    m_probeList = new QListWidget(this);
+    for (ProbeData *probe : m_probes) {
+        QPixmap swatch(12, 12);
+        swatch.fill(probe->color());
+        QListWidgetItem *item = new QListWidgetItem(QIcon(swatch), probe->name(), m_probeList);
+        item->setCheckState(Qt::Checked);
+    }
+    formLayout->addRow(i18n("Probes:"), m_probeList);
+
+    m_rangeSelect = new KComboBox(this);
+    m_rangeSelect->addItem(i18n("All recorded data"));
+    m_rangeSelect->addItem(i18n("Shown in the oscilloscope"));
+    m_rangeSelect->addItem(i18n("Custom"));
+    formLayout->addRow(i18n("Time range:"), m_rangeSelect);
+
+    m_fromEdit = new QDoubleSpinBox(this);
+    m_toEdit = new QDoubleSpinBox(this);
+    for (QDoubleSpinBox *edit : {m_fromEdit, m_toEdit}) {
+        edit->setDecimals(6);
+        edit->setSuffix(i18n(" s"));
+    }
+    formLayout->addRow(i18n("From:"), m_fromEdit);
+    formLayout->addRow(i18n("To:"), m_toEdit);
+    layout->addLayout(formLayout);
+
+    m_buttonBox = new QDialogButtonBox(this);
+    m_buttonBox->setStandardButtons(QDialogButtonBox::Cancel);
+    m_exportButton = m_buttonBox->addButton(i18n("Export"), QDialogButtonBox::AcceptRole);
+    connect(m_buttonBox, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(m_buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    layout->addWidget(m_buttonBox);
+
+    connect(m_formatSelect, QOverload<int>::of(&KComboBox::currentIndexChanged), this, &ProbeExportDialog::handleFormatIndexChanged);
+    connect(m_rangeSelect, QOverload<int>::of(&KComboBox::currentIndexChanged), this, &ProbeExportDialog::handleRangeIndexChanged);
+    connect(m_filePathEdit, &KUrlRequester::textChanged, this, &ProbeExportDialog::updateExportButton);
+    connect(m_probeList, &QListWidget::itemChanged, this, &ProbeExportDialog::updateExportButton);
+    connect(m_fromEdit, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, &ProbeExportDialog::updateExportButton);
+    connect(m_toEdit, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, &ProbeExportDialog::updateExportButton);
+
+    handleFormatIndexChanged(m_formatSelect->currentIndex());
+    handleRangeIndexChanged(m_rangeSelect->currentIndex());
+}
+
+void ProbeExportDialog::setRanges(uint64_t recordedBegin, uint64_t recordedEnd, uint64_t visibleBegin, uint64_t visibleEnd)
+{
+    m_recordedBegin = recordedBegin;
+    m_recordedEnd = recordedEnd;
+    m_visibleBegin = qBound(recordedBegin, visibleBegin, recordedEnd);
+    m_visibleEnd = qBound(m_visibleBegin, visibleEnd, recordedEnd);
+
+    for (QDoubleSpinBox *edit : {m_fromEdit, m_toEdit})
+        edit->setRange(double(recordedBegin) / LOGIC_UPDATE_RATE, double(recordedEnd) / LOGIC_UPDATE_RATE);
+
+    handleRangeIndexChanged(m_rangeSelect->currentIndex());
+}
+
+QString ProbeExportDialog::filePath() const
+{
+    return m_filePathEdit->text();
+}
+
+ProbeExportDialog::Format ProbeExportDialog::format() const
+{
+    return Format(m_formatSelect->currentIndex());
+}
+
+QList<ProbeData *> ProbeExportDialog::selectedProbes() const
+{
+    QList<ProbeData *> probes;
+    for (int i = 0; i < m_probes.size(); ++i) {
+        if (m_probeList->item(i)->checkState() == Qt::Checked)
+            probes << m_probes[i];
+    }
+    return probes;
+}
+
+uint64_t ProbeExportDialog::rangeBegin() const
+{
+    switch (Range(m_rangeSelect->currentIndex())) {
+    case AllRange:
+        return m_recordedBegin;
+    case VisibleRange:
+        return m_visibleBegin;
+    case CustomRange:
+        break;
+    }
+    return uint64_t(m_fromEdit->value() * LOGIC_UPDATE_RATE);
+}
+
+uint64_t ProbeExportDialog::rangeEnd() const
+{
+    switch (Range(m_rangeSelect->currentIndex())) {
+    case AllRange:
+        return m_recordedEnd;
+    case VisibleRange:
+        return m_visibleEnd;
+    case CustomRange:
+        break;
+    }
+    return uint64_t(m_toEdit->value() * LOGIC_UPDATE_RATE);
+}
+
+void ProbeExportDialog::handleFormatIndexChanged(int index)
+{
+    m_filePathEdit->setNameFilters((index != -1) ? QStringList {m_nameFilters.at(index)} : QStringList());
+
+    updateExportButton();
+}
+
+void ProbeExportDialog::handleRangeIndexChanged(int index)
+{
+    const bool isCustom = (index == CustomRange);
+    m_fromEdit->setEnabled(isCustom);
+    m_toEdit->setEnabled(isCustom);
+
+    if (!isCustom) {
+        m_fromEdit->setValue(double(rangeBegin()) / LOGIC_UPDATE_RATE);
+        m_toEdit->setValue(double(rangeEnd()) / LOGIC_UPDATE_RATE);
+    }
+
+    updateExportButton();
+}
+
+void ProbeExportDialog::updateExportButton()
+{
+    const bool acceptable = !m_filePathEdit->text().isEmpty() && (m_formatSelect->currentIndex() != -1) && !selectedProbes().isEmpty() && (rangeBegin() <= rangeEnd());
+
+    m_exportButton->setEnabled(acceptable);
+}
+
+#include "moc_probeexportdlg.cpp"
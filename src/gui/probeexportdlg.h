@@ -0,0 +1,82 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef PROBEEXPORTDLG_H
+#define PROBEEXPORTDLG_H
+
+#include <QDialog>
+#include <QList>
+#include <QStringList>
+
+#include <stdint.h>
+
+class KComboBox;
+class KUrlRequester;
+class ProbeData;
+class QDialogButtonBox;
+class QDoubleSpinBox;
+class QListWidget;
+class QPushButton;
+
+/**
+Asks which probes, over which stretch of time, to export the data of, and
+the file and format to export it to.
+*/
+class ProbeExportDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    enum Format { CsvFormat, BinaryFormat, VcdFormat };
+    enum Range { AllRange, VisibleRange, CustomRange };
+
+    ProbeExportDialog(const QList<ProbeData *> &probes, QWidget *parent);
+
+    /**
+     * Sets the Simulator times that the data has been recorded over, and
+     * that are shown in the oscilloscope.
+     */
+    void setRanges(uint64_t recordedBegin, uint64_t recordedEnd, uint64_t visibleBegin, uint64_t visibleEnd);
+
+    QString filePath() const;
+    Format format() const;
+    QList<ProbeData *> selectedProbes() const;
+    /**
+     * @return the Simulator time to export the data from
+     */
+    uint64_t rangeBegin() const;
+    /**
+     * @return the Simulator time to export the data up to
+     */
+    uint64_t rangeEnd() const;
+
+private Q_SLOTS:
+    void handleFormatIndexChanged(int index);
+    void handleRangeIndexChanged(int index);
+    void updateExportButton();
+
+private:
+    const QStringList m_nameFilters;
+    const QList<ProbeData *> m_probes;
+    uint64_t m_recordedBegin;
+    uint64_t m_recordedEnd;
+    uint64_t m_visibleBegin;
+    uint64_t m_visibleEnd;
+    KComboBox *m_formatSelect;
+    KUrlRequester *m_filePathEdit;
+    QListWidget *m_probeList;
+    KComboBox *m_rangeSelect;
+    QDoubleSpinBox *m_fromEdit;
+    QDoubleSpinBox *m_toEdit;
+    QDialogButtonBox *m_buttonBox;
+    QPushButton *m_exportButton;
+};
+
+#endif
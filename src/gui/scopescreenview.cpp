@@ -32,13 +32,24 @@ ScopeScreenView::ScopeScreenView(QWidget *parent)
 {
     m_updateViewTmr = new QTimer(this);
     connect(m_updateViewTmr, SIGNAL(timeout()), this, SLOT(updateViewTimeout()));
-    m_updateViewTmr->start(50);
 }
 
 ScopeScreenView::~ScopeScreenView()
 {
 }
 
+void ScopeScreenView::showEvent(QShowEvent *event)
+{
+    ScopeViewBase::showEvent(event);
+    m_updateViewTmr->start(50);
+}
+
+void ScopeScreenView::hideEvent(QHideEvent *event)
+{
+    ScopeViewBase::hideEvent(event);
+    m_updateViewTmr->stop();
+}
+
 #if 0
 void ScopeScreenView::drawContents(QPainter * p)
 {
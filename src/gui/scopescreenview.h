@@ -65,6 +65,10 @@ public slots:
 
     void updateViewTimeout();
 
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
 private:
     int m_intervalsX;
     int m_ticksPerIntervalX;
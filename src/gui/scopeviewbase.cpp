@@ -37,6 +37,8 @@ ScopeViewBase::~ScopeViewBase()
 
 void ScopeViewBase::paintEvent(QPaintEvent *event)
 {
+    // The probe data is collected from the simulation through queues, so
+    // drawing it does not need the simulation lock
     QRect r = event->rect();
 
     if (b_needRedraw) {
@@ -56,7 +58,6 @@ void ScopeViewBase::paintEvent(QPaintEvent *event)
         if ((!startSuccess) || (!p.isActive())) {
             qCWarning(KTL_LOG) << " painter is not active";
         }
-        p.setClipRegion(event->region());
 
         // let the subclass draw the background (grids, etc.)
         drawBackground(p);
@@ -78,7 +79,7 @@ void ScopeViewBase::paintEvent(QPaintEvent *event)
     if (!paintStarted) {
         qCWarning(KTL_LOG) << " failed to start painting ";
     }
-    p.drawImage(r, m_pixmap->toImage(), r);
+    p.drawPixmap(r, *m_pixmap, r);
 }
 void ScopeViewBase::updateOutputHeight()
 {
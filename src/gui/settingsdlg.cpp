@@ -33,6 +33,7 @@
 #include <ui_logicwidget.h>
 #include <ui_picprogrammerconfigwidget.h>
 #include <ui_sdccoptionswidget.h>
+#include <ui_simulationwidget.h>
 
 class GeneralOptionsWidget : public QWidget, public Ui::GeneralOptionsWidget
 {
@@ -104,6 +105,16 @@ public:
     }
 };
 
+class SimulationWidget : public QWidget, public Ui::SimulationWidget
+{
+public:
+    SimulationWidget(QWidget *parent)
+        : QWidget(parent)
+    {
+        setupUi(this);
+    }
+};
+
 // Make sure that this value is the same as that in ktechlab.kcfg
 const int defaultRefreshRate = 50;
 
@@ -124,6 +135,8 @@ SettingsDlg::SettingsDlg(QWidget *parent, const char *name, KCoreConfigSkeleton
     m_picProgrammerConfigWidget->setObjectName("picProgrammerConfigWidget");
     m_gplinkSettingsWidget = new GplinkSettingsWidget(this);
     m_gplinkSettingsWidget->setObjectName("gplinkSettingsWidget");
+    m_simulationWidget = new SimulationWidget(this);
+    m_simulationWidget->setObjectName("simulationWidget");
 
     m_pPicProgrammerSettings = new PicProgrammerSettings;
 
@@ -134,6 +147,7 @@ SettingsDlg::SettingsDlg(QWidget *parent, const char *name, KCoreConfigSkeleton
     addPage(m_picProgrammerConfigWidget, i18n("Programmer"), "network-connect", i18n("PIC Programmer"));
     addPage(m_asmFormattingWidget, i18n("Formatter"), "indent_asm", i18n("Assembly Formatter"));
     addPage(m_logicWidget, i18n("Logic"), "logic_or", i18n("Electronic Logic Values"));
+    addPage(m_simulationWidget, i18n("Simulation"), "system-run", i18n("Circuit Simulation"));
     addPage(m_gpasmSettingsWidget, "Gpasm", "convert_to_hex", "gpasm");
     addPage(m_gplinkSettingsWidget, "Gplink", "merge", "gplink");
     addPage(m_sdccOptionsWidget, "SDCC", "text-x-csrc", "SDCC");
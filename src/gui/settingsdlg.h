@@ -23,6 +23,7 @@ class LogicWidget;
 class PicProgrammerConfigWidget;
 class PicProgrammerSettings;
 class SDCCOptionsWidget;
+class SimulationWidget;
 
 /**
 @author David Saxton
@@ -66,6 +67,7 @@ protected:
     LogicWidget *m_logicWidget;
     PicProgrammerConfigWidget *m_picProgrammerConfigWidget;
     GplinkSettingsWidget *m_gplinkSettingsWidget;
+    SimulationWidget *m_simulationWidget;
 };
 
 class NameValidator : public QValidator
@@ -0,0 +1,306 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "simulationstatsview.h"
+#include "circuitdocument.h"
+#include "component.h"
+#include "docmanager.h"
+#include "katemdi.h"
+#include "simulator.h"
+
+#include <KLocalizedString>
+#include <KMessageBox>
+
+#include <QCheckBox>
+#include <QFile>
+#include <QFileDialog>
+#include <QGridLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QTextStream>
+#include <QTimer>
+
+#include <cassert>
+
+#include <ktechlab_debug.h>
+
+static const int CIRCUIT_COLUMN = 0;
+static const int EQUATIONS_COLUMN = 1;
+static const int SOLVER_COLUMN = 2;
+static const int SOLVES_COLUMN = 3;
+static const int SOLVE_TIME_COLUMN = 4;
+static const int FACTORIZATIONS_COLUMN = 5;
+static const int ITERATIONS_COLUMN = 6;
+static const int FAILURES_COLUMN = 7;
+static const int CACHE_COLUMN = 8;
+static const int LOGIC_SOLVES_COLUMN = 9;
+static const int COLUMN_COUNT = 10;
+
+static const int COMPONENT_COLUMN = 0;
+static const int CALLBACK_TIME_COLUMN = 1;
+static const int PROCESSOR_TIME_COLUMN = 2;
+static const int CIRCUIT_TIME_COLUMN = 3;
+static const int TOTAL_TIME_COLUMN = 4;
+static const int COMPONENT_COLUMN_COUNT = 5;
+
+/**
+ * The most components listed in the table of components.
+ */
+static const int MAX_COMPONENT_ROWS = 50;
+
+/**
+ * @return an item that sorts by the number, rather than by its text
+ */
+static QTableWidgetItem *numberItem(double value, int decimals = 0)
+{
+    QTableWidgetItem *item = new QTableWidgetItem;
+    item->setData(Qt::DisplayRole, QString::number(value, 'f', decimals).toDouble());
+    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    return item;
+}
+
+// BEGIN class SimulationStatsView
+SimulationStatsView *SimulationStatsView::m_pSelf = nullptr;
+SimulationStatsView *SimulationStatsView::self(KateMDI::ToolView *parent)
+{
+    if (!m_pSelf) {
+        assert(parent);
+        m_pSelf = new SimulationStatsView(parent);
+    }
+    return m_pSelf;
+}
+
+SimulationStatsView::SimulationStatsView(KateMDI::ToolView *parent)
+    : QWidget(static_cast<QWidget *>(parent))
+{
+    if (parent->layout()) {
+        parent->layout()->addWidget(this);
+    } else {
+        qCWarning(KTL_LOG) << " unexpected null layout on parent " << parent;
+    }
+
+    QGridLayout *grid = new QGridLayout(this);
+    grid->setMargin(0);
+    grid->setSpacing(6);
+
+    m_pSummary = new QLabel(this);
+    m_pSummary->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    grid->addWidget(m_pSummary, 0, 0);
+
+    m_pHeatMapCheck = new QCheckBox(i18n("Heat map"), this);
+    m_pHeatMapCheck->setToolTip(i18n("Shades the components of the focused circuit by how much of the simulation time goes on them."));
+    connect(m_pHeatMapCheck, &QCheckBox::toggled, this, &SimulationStatsView::slotHeatMapToggled);
+    grid->addWidget(m_pHeatMapCheck, 0, 1);
+
+    QPushButton *resetButton = new QPushButton(i18n("Reset"), this);
+    resetButton->setToolTip(i18n("Starts counting again from zero."));
+    connect(resetButton, &QPushButton::clicked, this, &SimulationStatsView::slotReset);
+    grid->addWidget(resetButton, 0, 2);
+
+    QPushButton *exportButton = new QPushButton(QIcon::fromTheme("document-export"), i18n("Export CSV..."), this);
+    connect(exportButton, &QPushButton::clicked, this, &SimulationStatsView::slotExport);
+    grid->addWidget(exportButton, 0, 3);
+
+    m_pCircuitTable = new QTableWidget(this);
+    m_pCircuitTable->setFocusPolicy(Qt::NoFocus);
+    m_pCircuitTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_pCircuitTable->verticalHeader()->setVisible(false);
+    m_pCircuitTable->setColumnCount(COLUMN_COUNT);
+    m_pCircuitTable->setHorizontalHeaderItem(CIRCUIT_COLUMN, new QTableWidgetItem(i18n("Circuit")));
+    m_pCircuitTable->setHorizontalHeaderItem(EQUATIONS_COLUMN, new QTableWidgetItem(i18n("Equations")));
+    m_pCircuitTable->setHorizontalHeaderItem(SOLVER_COLUMN, new QTableWidgetItem(i18n("Solver")));
+    m_pCircuitTable->setHorizontalHeaderItem(SOLVES_COLUMN, new QTableWidgetItem(i18n("Solves/s")));
+    m_pCircuitTable->setHorizontalHeaderItem(SOLVE_TIME_COLUMN, new QTableWidgetItem(i18n("Solve Time (%)")));
+    m_pCircuitTable->setHorizontalHeaderItem(FACTORIZATIONS_COLUMN, new QTableWidgetItem(i18n("LU/s")));
+    m_pCircuitTable->setHorizontalHeaderItem(ITERATIONS_COLUMN, new QTableWidgetItem(i18n("Newton Iterations/Solve")));
+    m_pCircuitTable->setHorizontalHeaderItem(FAILURES_COLUMN, new QTableWidgetItem(i18n("Newton Failures")));
+    m_pCircuitTable->setHorizontalHeaderItem(CACHE_COLUMN, new QTableWidgetItem(i18n("Cache Hits (%)")));
+    m_pCircuitTable->setHorizontalHeaderItem(LOGIC_SOLVES_COLUMN, new QTableWidgetItem(i18n("Logic Solves/s")));
+    m_pCircuitTable->horizontalHeaderItem(SOLVE_TIME_COLUMN)->setToolTip(i18n("The share of real time spent solving the circuit."));
+    m_pCircuitTable->horizontalHeaderItem(CACHE_COLUMN)->setToolTip(i18n("How often the solution was found in the cache of solutions for each state of the logic outputs."));
+    m_pCircuitTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_pCircuitTable->horizontalHeader()->setSectionResizeMode(CIRCUIT_COLUMN, QHeaderView::Stretch);
+    m_pCircuitTable->setSortingEnabled(true);
+    m_pCircuitTable->sortByColumn(SOLVE_TIME_COLUMN, Qt::DescendingOrder);
+    grid->addWidget(m_pCircuitTable, 1, 0, 1, 4);
+
+    m_pComponentTable = new QTableWidget(this);
+    m_pComponentTable->setFocusPolicy(Qt::NoFocus);
+    m_pComponentTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_pComponentTable->verticalHeader()->setVisible(false);
+    m_pComponentTable->setColumnCount(COMPONENT_COLUMN_COUNT);
+    m_pComponentTable->setHorizontalHeaderItem(COMPONENT_COLUMN, new QTableWidgetItem(i18n("Component")));
+    m_pComponentTable->setHorizontalHeaderItem(CALLBACK_TIME_COLUMN, new QTableWidgetItem(i18n("Callbacks (%)")));
+    m_pComponentTable->setHorizontalHeaderItem(PROCESSOR_TIME_COLUMN, new QTableWidgetItem(i18n("Processor (%)")));
+    m_pComponentTable->setHorizontalHeaderItem(CIRCUIT_TIME_COLUMN, new QTableWidgetItem(i18n("Circuits (%)")));
+    m_pComponentTable->setHorizontalHeaderItem(TOTAL_TIME_COLUMN, new QTableWidgetItem(i18n("Total (%)")));
+    m_pComponentTable->horizontalHeaderItem(CALLBACK_TIME_COLUMN)->setToolTip(i18n("The share of real time spent in the logic callbacks and steps of the component, estimated from samples."));
+    m_pComponentTable->horizontalHeaderItem(CIRCUIT_TIME_COLUMN)->setToolTip(i18n("An even share of the solve time of each circuit the component is in."));
+    m_pComponentTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_pComponentTable->horizontalHeader()->setSectionResizeMode(COMPONENT_COLUMN, QHeaderView::Stretch);
+    m_pComponentTable->setSortingEnabled(true);
+    m_pComponentTable->sortByColumn(TOTAL_TIME_COLUMN, Qt::DescendingOrder);
+    grid->addWidget(m_pComponentTable, 2, 0, 1, 4);
+
+    grid->setColumnStretch(0, 1);
+
+    m_pUpdateTimer = new QTimer(this);
+    connect(m_pUpdateTimer, &QTimer::timeout, this, &SimulationStatsView::slotUpdate);
+}
+
+SimulationStatsView::~SimulationStatsView()
+{
+}
+
+void SimulationStatsView::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+
+    Simulator::self()->setTimingEnabled(true);
+    slotUpdate();
+    m_pUpdateTimer->start(UPDATE_INTERVAL_MS);
+}
+
+void SimulationStatsView::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+
+    m_pUpdateTimer->stop();
+    if (m_pHeatMapDocument)
+        m_pHeatMapDocument->setHeatMap(QHash<const Component *, double>());
+    if (!Simulator::isDestroyedSim())
+        Simulator::self()->setTimingEnabled(false);
+}
+
+void SimulationStatsView::slotUpdate()
+{
+    const SimulatorStatistics statistics = Simulator::self()->statistics();
+    const double elapsedS = statistics.elapsedNs * 1e-9;
+    if (elapsedS <= 0.)
+        return;
+
+    m_pSummary->setText(i18n("Steps/s: %1   Tick: %2 µs (max %3 µs)   Logic events/s: %4   PIC cycles/s: %5",
+                             qRound64(statistics.steps / elapsedS),
+                             qRound64(statistics.tickAverageNs * 1e-3),
+                             qRound64(statistics.tickMaxNs * 1e-3),
+                             qRound64(statistics.logicEvents / elapsedS),
+                             qRound64(statistics.gpsimCycles / elapsedS)));
+
+    // Sorting while filling in the rows would move them around underneath us
+    m_pCircuitTable->setSortingEnabled(false);
+    m_pCircuitTable->setRowCount(statistics.circuits.size());
+
+    int row = 0;
+    for (std::vector<CircuitStatistics>::const_iterator it = statistics.circuits.begin(); it != statistics.circuits.end(); ++it, ++row) {
+        const CircuitStats &stats = it->stats;
+        const NonLinearStats &nonLinear = it->nonLinearStats;
+        const unsigned long lookups = stats.cacheHits + stats.cacheMisses;
+
+        QString solver = it->sparse ? i18n("Sparse") : (it->banded ? i18n("Banded") : i18n("Dense"));
+        if (it->logicCache)
+            solver = i18n("%1, logic cache", solver);
+        if (!it->luCache)
+            solver = i18n("%1, no LU cache", solver);
+        if (it->choosingStrategy)
+            solver = i18n("%1, choosing", solver);
+        if (it->nonLinear)
+            solver = i18n("%1, nonlinear", solver);
+        if (it->parked)
+            solver = i18n("%1, settled", solver);
+
+        m_pCircuitTable->setItem(row, CIRCUIT_COLUMN, new QTableWidgetItem(it->description));
+        m_pCircuitTable->setItem(row, EQUATIONS_COLUMN, numberItem(it->equations));
+        m_pCircuitTable->setItem(row, SOLVER_COLUMN, new QTableWidgetItem(solver));
+        m_pCircuitTable->setItem(row, SOLVES_COLUMN, numberItem(stats.solves / elapsedS));
+        m_pCircuitTable->setItem(row, SOLVE_TIME_COLUMN, numberItem(statistics.timingEnabled ? 100. * stats.solveNs / statistics.elapsedNs : 0., 2));
+        m_pCircuitTable->setItem(row, FACTORIZATIONS_COLUMN, numberItem(it->factorizations / elapsedS));
+        m_pCircuitTable->setItem(row, ITERATIONS_COLUMN, numberItem(nonLinear.solves > 0 ? double(nonLinear.iterations) / nonLinear.solves : 0., 2));
+        m_pCircuitTable->setItem(row, FAILURES_COLUMN, numberItem(nonLinear.failures));
+        m_pCircuitTable->setItem(row, CACHE_COLUMN, numberItem(lookups > 0 ? 100. * stats.cacheHits / lookups : 0., 1));
+        m_pCircuitTable->setItem(row, LOGIC_SOLVES_COLUMN, numberItem(stats.logicSolves / elapsedS));
+    }
+
+    m_pCircuitTable->setSortingEnabled(true);
+
+    const int componentRows = qMin(int(statistics.components.size()), MAX_COMPONENT_ROWS);
+    m_pComponentTable->setSortingEnabled(false);
+    m_pComponentTable->setRowCount(componentRows);
+
+    for (row = 0; row < componentRows; ++row) {
+        const ComponentStatistics &component = statistics.components[row];
+        const double toPercent = 100. / statistics.elapsedNs;
+
+        m_pComponentTable->setItem(row, COMPONENT_COLUMN, new QTableWidgetItem(component.id));
+        m_pComponentTable->setItem(row, CALLBACK_TIME_COLUMN, numberItem(component.callbackNs * toPercent, 2));
+        m_pComponentTable->setItem(row, PROCESSOR_TIME_COLUMN, numberItem(component.processorNs * toPercent, 2));
+        m_pComponentTable->setItem(row, CIRCUIT_TIME_COLUMN, numberItem(component.circuitNs * toPercent, 2));
+        m_pComponentTable->setItem(row, TOTAL_TIME_COLUMN, numberItem(component.totalNs() * toPercent, 2));
+    }
+
+    m_pComponentTable->setSortingEnabled(true);
+
+    updateHeatMap(statistics);
+}
+
+void SimulationStatsView::updateHeatMap(const SimulatorStatistics &statistics)
+{
+    CircuitDocument *document = nullptr;
+    if (m_pHeatMapCheck->isChecked())
+        document = dynamic_cast<CircuitDocument *>(DocManager::self()->getFocusedDocument());
+
+    if (m_pHeatMapDocument && m_pHeatMapDocument != document)
+        m_pHeatMapDocument->setHeatMap(QHash<const Component *, double>());
+    m_pHeatMapDocument = document;
+
+    if (!document)
+        return;
+
+    // Relative to the most expensive component, which comes first
+    QHash<const Component *, double> heatMap;
+    const qint64 mostNs = statistics.components.empty() ? 0 : statistics.components.front().totalNs();
+    if (mostNs > 0) {
+        for (std::vector<ComponentStatistics>::const_iterator it = statistics.components.begin(); it != statistics.components.end(); ++it)
+            heatMap.insert(it->component, double(it->totalNs()) / mostNs);
+    }
+    document->setHeatMap(heatMap);
+}
+
+void SimulationStatsView::slotHeatMapToggled(bool show)
+{
+    Q_UNUSED(show);
+    updateHeatMap(Simulator::self()->statistics());
+}
+
+void SimulationStatsView::slotReset()
+{
+    Simulator::self()->resetStatistics();
+    slotUpdate();
+}
+
+void SimulationStatsView::slotExport()
+{
+    const QString fileName = QFileDialog::getSaveFileName(this, i18n("Export Simulation Statistics"), QString(), i18n("CSV Files (*.csv);;All Files (*)"));
+    if (fileName.isEmpty())
+        return;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        KMessageBox::error(this, i18n("Could not open '%1' for writing. Check that you have write permissions", fileName), i18n("Saving File"));
+        return;
+    }
+
+    QTextStream stream(&file);
+    stream << Simulator::self()->statistics().toCsv();
+}
+// END class SimulationStatsView
+
+#include "moc_simulationstatsview.cpp"
@@ -0,0 +1,91 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef SIMULATIONSTATSVIEW_H
+#define SIMULATIONSTATSVIEW_H
+
+#include <QPointer>
+#include <QWidget>
+
+class CircuitDocument;
+class QCheckBox;
+class SimulatorStatistics;
+class QLabel;
+class QTableWidget;
+class QTimer;
+
+namespace KateMDI
+{
+class ToolView;
+}
+
+/**
+Shows what the simulator has been doing since the statistics were last reset:
+how fast it is stepping and, for each circuit, how often and how long it is
+solved, how many LU decompositions and Newton iterations that takes, and how
+well the logic cache is doing. Below that, the components that the most time
+goes on, which can also be shown as a heat map over the focused circuit. The
+times are only measured while the view is shown.
+@see Simulator::statistics
+*/
+class SimulationStatsView : public QWidget
+{
+    Q_OBJECT
+public:
+    static SimulationStatsView *self(KateMDI::ToolView *parent = nullptr);
+    static QString toolViewIdentifier()
+    {
+        return "SimulationStatsView";
+    }
+    ~SimulationStatsView() override;
+
+    /**
+     * How often the statistics are read while the view is shown.
+     */
+    static const int UPDATE_INTERVAL_MS = 1000;
+
+public slots:
+    /**
+     * Reads the statistics from the simulator and updates the table.
+     */
+    void slotUpdate();
+    void slotReset();
+    /**
+     * Shows or removes the heat map of the focused circuit.
+     */
+    void slotHeatMapToggled(bool show);
+    /**
+     * Asks for a file name, and writes the statistics to it as CSV.
+     */
+    void slotExport();
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private:
+    SimulationStatsView(KateMDI::ToolView *parent);
+    static SimulationStatsView *m_pSelf;
+
+    /**
+     * Sets the heat map of the focused circuit (if showing it) from the
+     * component statistics, and removes it from any other circuit.
+     */
+    void updateHeatMap(const SimulatorStatistics &statistics);
+
+    QLabel *m_pSummary;
+    QCheckBox *m_pHeatMapCheck;
+    QTableWidget *m_pCircuitTable;
+    QTableWidget *m_pComponentTable;
+    QTimer *m_pUpdateTimer;
+    QPointer<CircuitDocument> m_pHeatMapDocument; ///< the circuit the heat map is shown over
+};
+
+#endif
@@ -0,0 +1,236 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "stallwatchview.h"
+#include "katemdi.h"
+#include "stallwatch.h"
+
+#include <KLocalizedString>
+
+#include <QGridLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QStringList>
+#include <QTableWidget>
+#include <QTimer>
+
+#include <cassert>
+
+#include <ktechlab_debug.h>
+
+static const int BUCKET_COLUMN = 0;
+static const int ITERATIONS_COLUMN = 1;
+static const int SHARE_COLUMN = 2;
+static const int HISTOGRAM_COLUMN_COUNT = 3;
+
+static const int REGION_COLUMN = 0;
+static const int COUNT_COLUMN = 1;
+static const int TOTAL_COLUMN = 2;
+static const int MAX_COLUMN = 3;
+static const int STALLS_COLUMN = 4;
+static const int REGION_COLUMN_COUNT = 5;
+
+static const int WHEN_COLUMN = 0;
+static const int DURATION_COLUMN = 1;
+static const int DOCUMENTS_COLUMN = 2;
+static const int REGIONS_COLUMN = 3;
+static const int STALL_COLUMN_COUNT = 4;
+
+/**
+ * @return an item that sorts by the number, rather than by its text
+ */
+static QTableWidgetItem *numberItem(double value, int decimals = 0)
+{
+    QTableWidgetItem *item = new QTableWidgetItem;
+    item->setData(Qt::DisplayRole, QString::number(value, 'f', decimals).toDouble());
+    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    return item;
+}
+
+static QTableWidgetItem *msItem(qint64 ns)
+{
+    return numberItem(ns * 1e-6, 1);
+}
+
+static QTableWidget *createTable(QWidget *parent, const QStringList &headers)
+{
+    QTableWidget *table = new QTableWidget(parent);
+    table->setFocusPolicy(Qt::NoFocus);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->verticalHeader()->setVisible(false);
+    table->setColumnCount(headers.size());
+    table->setHorizontalHeaderLabels(headers);
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    return table;
+}
+
+// BEGIN class StallWatchView
+StallWatchView *StallWatchView::m_pSelf = nullptr;
+StallWatchView *StallWatchView::self(KateMDI::ToolView *parent)
+{
+    if (!m_pSelf) {
+        assert(parent);
+        m_pSelf = new StallWatchView(parent);
+    }
+    return m_pSelf;
+}
+
+StallWatchView::StallWatchView(KateMDI::ToolView *parent)
+    : QWidget(static_cast<QWidget *>(parent))
+    , m_shownChangeCount(0)
+{
+    if (parent->layout()) {
+        parent->layout()->addWidget(this);
+    } else {
+        qCWarning(KTL_LOG) << " unexpected null layout on parent " << parent;
+    }
+
+    QGridLayout *grid = new QGridLayout(this);
+    grid->setMargin(0);
+    grid->setSpacing(6);
+
+    QLabel *thresholdLabel = new QLabel(i18n("Stall threshold:"), this);
+    grid->addWidget(thresholdLabel, 0, 0);
+
+    m_pThreshold = new QSpinBox(this);
+    m_pThreshold->setRange(10, 10000);
+    m_pThreshold->setSingleStep(10);
+    m_pThreshold->setSuffix(i18n(" ms"));
+    m_pThreshold->setValue(StallWatch::threshold());
+    m_pThreshold->setToolTip(i18n("How long the GUI can be kept from handling events before it is recorded as a stall."));
+    thresholdLabel->setBuddy(m_pThreshold);
+    connect(m_pThreshold, QOverload<int>::of(&QSpinBox::valueChanged), this, &StallWatchView::slotThresholdChanged);
+    grid->addWidget(m_pThreshold, 0, 1);
+
+    QPushButton *resetButton = new QPushButton(i18n("Reset"), this);
+    resetButton->setToolTip(i18n("Forgets the stalls and starts counting again from zero."));
+    connect(resetButton, &QPushButton::clicked, this, &StallWatchView::slotReset);
+    grid->addWidget(resetButton, 0, 3);
+
+    m_pHistogramTable = createTable(this, {i18n("Iteration Time"), i18n("Iterations"), i18n("Share (%)")});
+    m_pHistogramTable->setRowCount(StallWatch::BUCKET_COUNT);
+    for (int bucket = 0; bucket < StallWatch::BUCKET_COUNT; ++bucket)
+        m_pHistogramTable->setItem(bucket, BUCKET_COLUMN, new QTableWidgetItem(StallWatch::bucketLabel(bucket)));
+    grid->addWidget(m_pHistogramTable, 1, 0, 1, 2);
+
+    m_pRegionTable = createTable(this, {i18n("Region"), i18n("Runs"), i18n("Total (ms)"), i18n("Longest (ms)"), i18n("Stalls")});
+    m_pRegionTable->horizontalHeaderItem(STALLS_COLUMN)->setToolTip(i18n("How many of the stalls the region ran in."));
+    m_pRegionTable->horizontalHeader()->setSectionResizeMode(REGION_COLUMN, QHeaderView::Stretch);
+    m_pRegionTable->setSortingEnabled(true);
+    m_pRegionTable->sortByColumn(TOTAL_COLUMN, Qt::DescendingOrder);
+    grid->addWidget(m_pRegionTable, 1, 2, 1, 2);
+
+    m_pStallTable = createTable(this, {i18n("When"), i18n("Duration (ms)"), i18n("Documents"), i18n("Regions")});
+    m_pStallTable->horizontalHeaderItem(REGIONS_COLUMN)->setToolTip(i18n("The regions of code that ran in the stall, with the time each took; nested regions are indented."));
+    m_pStallTable->horizontalHeader()->setSectionResizeMode(REGIONS_COLUMN, QHeaderView::Stretch);
+    grid->addWidget(m_pStallTable, 2, 0, 1, 4);
+
+    grid->setColumnStretch(2, 1);
+    grid->setRowStretch(2, 1);
+
+    m_pUpdateTimer = new QTimer(this);
+    connect(m_pUpdateTimer, &QTimer::timeout, this, &StallWatchView::slotUpdate);
+}
+
+StallWatchView::~StallWatchView()
+{
+}
+
+void StallWatchView::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+
+    slotUpdate();
+    m_pUpdateTimer->start(UPDATE_INTERVAL_MS);
+}
+
+void StallWatchView::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+
+    m_pUpdateTimer->stop();
+}
+
+void StallWatchView::slotThresholdChanged(int ms)
+{
+    StallWatch::setThreshold(ms);
+}
+
+void StallWatchView::slotReset()
+{
+    StallWatch::reset();
+    slotUpdate();
+}
+
+void StallWatchView::slotUpdate()
+{
+    // Every iteration of the event loop is counted, so there is nearly
+    // always something new, but not worth filling the tables in for more
+    // than the timer
+    if (StallWatch::changeCount() == m_shownChangeCount)
+        return;
+    m_shownChangeCount = StallWatch::changeCount();
+
+    const QVector<qint64> &histogram = StallWatch::histogram();
+    qint64 iterations = 0;
+    for (qint64 count : histogram)
+        iterations += count;
+    for (int bucket = 0; bucket < StallWatch::BUCKET_COUNT; ++bucket) {
+        m_pHistogramTable->setItem(bucket, ITERATIONS_COLUMN, numberItem(histogram[bucket]));
+        m_pHistogramTable->setItem(bucket, SHARE_COLUMN, numberItem(iterations > 0 ? 100. * histogram[bucket] / iterations : 0., 2));
+    }
+
+    // Sorting while filling in the rows would move them around underneath us
+    const QMap<QString, StallWatch::RegionStats> &regions = StallWatch::regionStats();
+    m_pRegionTable->setSortingEnabled(false);
+    m_pRegionTable->setRowCount(regions.size());
+
+    int row = 0;
+    for (QMap<QString, StallWatch::RegionStats>::const_iterator it = regions.begin(); it != regions.end(); ++it, ++row) {
+        m_pRegionTable->setItem(row, REGION_COLUMN, new QTableWidgetItem(it.key()));
+        m_pRegionTable->setItem(row, COUNT_COLUMN, numberItem(it->count));
+        m_pRegionTable->setItem(row, TOTAL_COLUMN, msItem(it->totalNs));
+        m_pRegionTable->setItem(row, MAX_COLUMN, msItem(it->maxNs));
+        m_pRegionTable->setItem(row, STALLS_COLUMN, numberItem(it->stalls));
+    }
+
+    m_pRegionTable->setSortingEnabled(true);
+
+    // The most recent stall first
+    const QVector<StallWatch::Stall> &stalls = StallWatch::stalls();
+    m_pStallTable->setRowCount(stalls.size());
+
+    row = 0;
+    for (QVector<StallWatch::Stall>::const_reverse_iterator it = stalls.rbegin(); it != stalls.rend(); ++it, ++row) {
+        QStringList documents;
+        QStringList regionTimes;
+        for (const StallWatch::RegionTime &region : it->regions) {
+            if (!region.document.isEmpty() && !documents.contains(region.document))
+                documents << region.document;
+            const QString name = region.document.isEmpty() ? region.name : i18n("%1 (%2)", region.name, region.document);
+            regionTimes << QString(2 * region.depth, ' ') + i18n("%1: %2 ms", name, QString::number(region.ns * 1e-6, 'f', 1));
+        }
+        if (regionTimes.isEmpty())
+            regionTimes << i18n("Not in any region");
+
+        m_pStallTable->setItem(row, WHEN_COLUMN, new QTableWidgetItem(it->when.toString(Qt::ISODate)));
+        m_pStallTable->setItem(row, DURATION_COLUMN, msItem(it->ns));
+        m_pStallTable->setItem(row, DOCUMENTS_COLUMN, new QTableWidgetItem(documents.join(", ")));
+
+        QTableWidgetItem *regionsItem = new QTableWidgetItem(regionTimes.join("; "));
+        regionsItem->setToolTip(regionTimes.join('\n'));
+        m_pStallTable->setItem(row, REGIONS_COLUMN, regionsItem);
+    }
+}
+// END class StallWatchView
+
+#include "moc_stallwatchview.cpp"
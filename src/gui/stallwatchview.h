@@ -0,0 +1,73 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef STALLWATCHVIEW_H
+#define STALLWATCHVIEW_H
+
+#include <QWidget>
+
+class QSpinBox;
+class QTableWidget;
+class QTimer;
+
+namespace KateMDI
+{
+class ToolView;
+}
+
+/**
+Shows how responsive the GUI has been: a histogram of how long the iterations
+of the event loop took, the stalls (the iterations over the threshold) with
+the regions of code and documents they were spent in, and the totals for each
+region.
+@see StallWatch
+*/
+class StallWatchView : public QWidget
+{
+    Q_OBJECT
+public:
+    static StallWatchView *self(KateMDI::ToolView *parent = nullptr);
+    static QString toolViewIdentifier()
+    {
+        return "StallWatchView";
+    }
+    ~StallWatchView() override;
+
+    /**
+     * How often the view is checked for being out of date while it is shown.
+     */
+    static const int UPDATE_INTERVAL_MS = 1000;
+
+public slots:
+    /**
+     * Fills in the tables from StallWatch, if anything has been recorded
+     * since they were last filled in.
+     */
+    void slotUpdate();
+    void slotReset();
+    void slotThresholdChanged(int ms);
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private:
+    StallWatchView(KateMDI::ToolView *parent);
+    static StallWatchView *m_pSelf;
+
+    QSpinBox *m_pThreshold;
+    QTableWidget *m_pHistogramTable;
+    QTableWidget *m_pRegionTable;
+    QTableWidget *m_pStallTable;
+    QTimer *m_pUpdateTimer;
+    quint64 m_shownChangeCount; ///< StallWatch::changeCount() when the tables were filled in
+};
+
+#endif
@@ -23,53 +23,108 @@
 #include <QGridLayout>
 #include <QHeaderView>
 #include <QLabel>
+#include <QTableView>
+#include <QTimer>
 
 #include <cassert>
 
 #include <ktechlab_debug.h>
+#include <ktlconfig.h>
 
 static const int NAME_COLUMN = 0;
 static const int VALUE_COLUMN = 1;
 
-// BEGIN class SymbolViewerItem
-SymbolViewerItem::SymbolViewerItem(SymbolViewer *symbolViewer, const RegisterInfo *registerInfo, int intendedColumn)
-    : QObject()
-    , QTableWidgetItem()
-    , m_pRegisterInfo(registerInfo)
+// BEGIN class SymbolViewerModel
+SymbolViewerModel::SymbolViewerModel(SymbolViewer *symbolViewer)
+    : QAbstractTableModel(symbolViewer)
     , m_pSymbolViewer(symbolViewer)
 {
-    qCDebug(KTL_LOG) << " reg info name " << m_pRegisterInfo->name();
-    qCDebug(KTL_LOG) << " row " << row() << " column " << column();
-
-    assert(registerInfo);
-    m_pRegisterInfo = registerInfo;
-    m_pSymbolViewer = symbolViewer;
-
-    // note: at initial update the column is set to -1, so don't rely on that
-    if (intendedColumn == NAME_COLUMN) {
-        setText(m_pRegisterInfo->name());
-    } else { // VALUE_COLUMN...
-        setText(m_pSymbolViewer->toDisplayString(m_pRegisterInfo->value()));
+}
+
+void SymbolViewerModel::setRegisterSet(RegisterSet *registerSet)
+{
+    beginResetModel();
+
+    m_registers.clear();
+    m_shownValues.clear();
+
+    const unsigned count = registerSet ? registerSet->size() : 0;
+    for (unsigned i = 0; i < count; ++i) {
+        RegisterInfo *reg = registerSet->fromAddress(i);
+
+        if (!reg) {
+            qCDebug(KTL_LOG) << " skip null register at " << i;
+            continue;
+        }
+
+        if ((reg->type() == RegisterInfo::Generic) || (reg->type() == RegisterInfo::Invalid)) {
+            continue;
+        }
+
+        m_registers.append(reg);
     }
+    m_shownValues.resize(m_registers.size());
 
-    connect(m_pRegisterInfo, &RegisterInfo::valueChanged, this, &SymbolViewerItem::valueChanged);
-    connect(m_pSymbolViewer, &SymbolViewer::valueRadixChanged, this, &SymbolViewerItem::radixChanged);
+    endResetModel();
 }
 
-void SymbolViewerItem::valueChanged(unsigned newValue)
+void SymbolViewerModel::refresh(int first, int last)
 {
-    if (column() == VALUE_COLUMN) {
-        setText(m_pSymbolViewer->toDisplayString(newValue));
+    first = qMax(first, 0);
+    last = qMin(last, m_registers.size() - 1);
+
+    int firstChanged = -1;
+    int lastChanged = -1;
+    for (int row = first; row <= last; ++row) {
+        if (m_registers[row]->value() != m_shownValues[row]) {
+            if (firstChanged < 0)
+                firstChanged = row;
+            lastChanged = row;
+        }
     }
+
+    if (firstChanged >= 0)
+        emit dataChanged(index(firstChanged, VALUE_COLUMN), index(lastChanged, VALUE_COLUMN), {Qt::DisplayRole});
 }
 
-void SymbolViewerItem::radixChanged()
+void SymbolViewerModel::refreshAll()
 {
-    if (column() == VALUE_COLUMN) {
-        valueChanged(m_pRegisterInfo->value());
-    }
+    if (!m_registers.isEmpty())
+        emit dataChanged(index(0, VALUE_COLUMN), index(m_registers.size() - 1, VALUE_COLUMN), {Qt::DisplayRole});
+}
+
+int SymbolViewerModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_registers.size();
+}
+
+int SymbolViewerModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : 2;
 }
-// END class SymbolViewerItem
+
+QVariant SymbolViewerModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || role != Qt::DisplayRole)
+        return QVariant();
+
+    const RegisterInfo *reg = m_registers[index.row()];
+    if (index.column() == NAME_COLUMN)
+        return reg->name();
+
+    const unsigned value = reg->value();
+    m_shownValues[index.row()] = value;
+    return m_pSymbolViewer->toDisplayString(value);
+}
+
+QVariant SymbolViewerModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+
+    return (section == NAME_COLUMN) ? i18n("Name") : i18n("Value");
+}
+// END class SymbolViewerModel
 
 // BEGIN class SymbolView
 SymbolViewer *SymbolViewer::m_pSelf = nullptr;
@@ -96,7 +151,11 @@ SymbolViewer::SymbolViewer(KateMDI::ToolView *parent)
     grid->setMargin(0);
     grid->setSpacing(6);
 
-    m_pSymbolList = new QTableWidget(this);
+    m_pModel = new SymbolViewerModel(this);
+    connect(this, &SymbolViewer::valueRadixChanged, m_pModel, &SymbolViewerModel::refreshAll);
+
+    m_pSymbolList = new QTableView(this);
+    m_pSymbolList->setModel(m_pModel);
     m_pSymbolList->setFocusPolicy(Qt::NoFocus);
     // grid->addMultiCellWidget( m_pSymbolList, 0, 0, 0, 1 ); // 2018.12.02
     grid->addWidget(m_pSymbolList, 0, 0, 1, 2);
@@ -118,13 +177,8 @@ SymbolViewer::SymbolViewer(KateMDI::ToolView *parent)
 
     m_pSymbolList->verticalHeader()->setVisible(false);
     m_pSymbolList->horizontalHeader()->setVisible(true);
-    // m_pSymbolList->addColumn( i18n("Name") ); // 2018.06.02 - use QTableWidget
-    // m_pSymbolList->addColumn( i18n("Value") ); // 2018.06.02 - use QTableWidget
-    m_pSymbolList->setColumnCount(2);
-    m_pSymbolList->setHorizontalHeaderItem(0, new QTableWidgetItem(i18n("Name")));
-    m_pSymbolList->setHorizontalHeaderItem(1, new QTableWidgetItem(i18n("Value")));
-    m_pSymbolList->horizontalHeaderItem(0)->setText(i18n("Name"));
-    m_pSymbolList->horizontalHeaderItem(1)->setText(i18n("Value"));
+    // All rows are the same height, which saves the view measuring each
+    m_pSymbolList->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
     // m_pSymbolList->setFullWidth(true);
     // m_pSymbolList->setColumnWidthMode(1, Q3ListView::Maximum);    // 2018.06.02 - use QTableWidget
     m_pSymbolList->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Preferred);
@@ -133,6 +187,9 @@ SymbolViewer::SymbolViewer(KateMDI::ToolView *parent)
     QHeaderView *symbolListHeader = m_pSymbolList->horizontalHeader();
     symbolListHeader->setSectionResizeMode(0, QHeaderView::Stretch);
     symbolListHeader->setSectionResizeMode(1, QHeaderView::Stretch);
+
+    m_pRefreshTimer = new QTimer(this);
+    connect(m_pRefreshTimer, &QTimer::timeout, this, &SymbolViewer::slotRefresh);
 }
 
 SymbolViewer::~SymbolViewer()
@@ -173,6 +230,7 @@ void SymbolViewer::readProperties(KConfig *config)
         break;
     }
     m_pRadixCombo->setCurrentIndex(pos);
+    m_pModel->refreshAll();
 
     // config->setGroup( oldGroup );
 }
@@ -184,45 +242,46 @@ void SymbolViewer::setContext(GpsimProcessor *gpsim)
     if (registerSet == m_pCurrentContext)
         return;
 
-    m_pSymbolList->clear();
-    m_pSymbolList->setColumnCount(2);
-    m_pSymbolList->setRowCount(0);
-
-    m_pSymbolList->setHorizontalHeaderItem(0, new QTableWidgetItem(i18n("Name")));
-    m_pSymbolList->setHorizontalHeaderItem(1, new QTableWidgetItem(i18n("Value")));
-    m_pSymbolList->horizontalHeaderItem(0)->setText(i18n("Name"));
-    m_pSymbolList->horizontalHeaderItem(1)->setText(i18n("Value"));
-
     m_pGpsim = gpsim;
     m_pCurrentContext = registerSet;
+    m_pModel->setRegisterSet(registerSet);
 
     if (!m_pCurrentContext)
         return;
 
-    connect(gpsim, &GpsimProcessor::destroyed, m_pSymbolList, &QTableWidget::clearContents);
+    // The registers are deleted with the processor
+    connect(gpsim, &GpsimProcessor::destroyed, this, [this, registerSet]() {
+        if (m_pCurrentContext == registerSet)
+            setContext(nullptr);
+    });
+}
 
-    unsigned count = m_pCurrentContext->size();
-    for (unsigned i = 0; i < count; ++i) {
-        RegisterInfo *reg = m_pCurrentContext->fromAddress(i);
+void SymbolViewer::slotRefresh()
+{
+    if (m_pModel->rowCount() == 0)
+        return;
 
-        if (!reg) {
-            qCDebug(KTL_LOG) << " skip null register at " << i;
-            continue;
-        }
+    const int first = m_pSymbolList->rowAt(0);
+    if (first < 0)
+        return;
 
-        if ((reg->type() == RegisterInfo::Generic) || (reg->type() == RegisterInfo::Invalid)) {
-            continue;
-        }
+    int last = m_pSymbolList->rowAt(m_pSymbolList->viewport()->height() - 1);
+    if (last < 0)
+        last = m_pModel->rowCount() - 1;
 
-        qCDebug(KTL_LOG) << " add reg at " << i << " info " << reg;
+    m_pModel->refresh(first, last);
+}
 
-        m_pSymbolList->insertRow(i);
+void SymbolViewer::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    m_pRefreshTimer->start(int(1000. / qMax(1, KTLConfig::refreshRate())));
+}
 
-        SymbolViewerItem *itemName = new SymbolViewerItem(this, reg, 0);
-        m_pSymbolList->setItem(i, 0, itemName);
-        SymbolViewerItem *itemVal = new SymbolViewerItem(this, reg, 1);
-        m_pSymbolList->setItem(i, 1, itemVal);
-    }
+void SymbolViewer::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    m_pRefreshTimer->stop();
 }
 
 void SymbolViewer::selectRadix(int selectIndex)
@@ -14,13 +14,17 @@
 #ifndef SYMBOLVIEWER_H
 #define SYMBOLVIEWER_H
 
+#include <QAbstractTableModel>
 #include <QPointer>
-#include <QTableWidget>
+#include <QVector>
+#include <QWidget>
 
 #include <gpsimprocessor.h>
 
 class KComboBox;
 class KConfig;
+class QTableView;
+class QTimer;
 class SymbolViewer;
 
 namespace KateMDI
@@ -28,6 +32,44 @@ namespace KateMDI
 class ToolView;
 }
 
+/**
+The registers of a processor, for SymbolViewer. Values are read from the
+registers only when the view asks for them, and refresh() notifies the view of
+changes for a range of rows, so that only the visible rows are polled.
+@short Model of the named registers of a processor
+*/
+class SymbolViewerModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    SymbolViewerModel(SymbolViewer *symbolViewer);
+
+    /**
+     * Lists the named registers of the set, or none for a null set.
+     */
+    void setRegisterSet(RegisterSet *registerSet);
+    /**
+     * Emits dataChanged for those values in the rows first to last
+     * (inclusive) that have changed since they were last shown.
+     */
+    void refresh(int first, int last);
+    /**
+     * Emits dataChanged for all the values, e.g. after the radix changed.
+     */
+    void refreshAll();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+protected:
+    SymbolViewer *m_pSymbolViewer;
+    QVector<RegisterInfo *> m_registers;
+    /// The value of each register when it was last shown
+    mutable QVector<unsigned> m_shownValues;
+};
+
 /**
 @author David Saxton
 */
@@ -74,10 +116,21 @@ signals:
 public slots:
     void selectRadix(int selectIndex);
 
+protected slots:
+    /**
+     * Refreshes the values of the rows that are visible.
+     */
+    void slotRefresh();
+
 protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
     QPointer<GpsimProcessor> m_pGpsim;
     RegisterSet *m_pCurrentContext;
-    QTableWidget *m_pSymbolList;
+    QTableView *m_pSymbolList;
+    SymbolViewerModel *m_pModel;
+    QTimer *m_pRefreshTimer;
     Radix m_valueRadix;
 
 private:
@@ -86,21 +139,6 @@ private:
     KComboBox *m_pRadixCombo;
 };
 
-class SymbolViewerItem : public QObject, public QTableWidgetItem
-{
-    Q_OBJECT
-public:
-    SymbolViewerItem(SymbolViewer *symbolViewer, const RegisterInfo *registerInfo, int intendedColumn);
-
-public slots:
-    void valueChanged(unsigned newValue);
-    void radixChanged();
-
-protected:
-    const RegisterInfo *m_pRegisterInfo;
-    SymbolViewer *m_pSymbolViewer;
-};
-
 #endif
 
 #endif
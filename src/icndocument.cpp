@@ -25,18 +25,96 @@
 #include "ktechlab.h"
 #include "nodegroup.h"
 #include "outputflownode.h"
+#include "stallwatch.h"
 #include "utils.h"
 
 #include <QApplication>
+#include <QAtomicInt>
 #include <QClipboard>
+#include <QSet>
+#include <QThread>
 #include <QTimer>
 
+#include <algorithm>
+#include <vector>
+
 #include <ktechlab_debug.h>
 
+// BEGIN class ConnectorRouteThread
+/// How many connectors there must be to a thread for it to be worth starting
+static const int ROUTES_PER_THREAD = 4;
+
+class ConnectorRoute
+{
+public:
+    Connector *connector;
+    int sx, sy, ex, ey;
+};
+
+/**
+ * Maps routes from the list (each taken by one thread only) until there are
+ * none left.
+ */
+static void mapConnectorRoutes(const std::vector<ConnectorRoute> &routes, QAtomicInt *nextRoute, const Cells *cells)
+{
+    const int count = routes.size();
+
+    int i;
+    while ((i = nextRoute->fetchAndAddOrdered(1)) < count) {
+        const ConnectorRoute &route = routes[i];
+        route.connector->conRouter()->mapRoute(route.sx, route.sy, route.ex, route.ey, cells);
+    }
+}
+
+/**
+ * @return whether the penalty of any cell of the route, other than those at
+ * its ends, differs between the two sets of cells.
+ */
+static bool routePenaltiesChanged(const QPointList &cellPoints, const Cells &before, const Cells &now)
+{
+    if (cellPoints.size() < 3)
+        return false;
+
+    const QPointList::const_iterator end = --cellPoints.end();
+    for (QPointList::const_iterator it = ++cellPoints.begin(); it != end; ++it) {
+        if (!now.haveCell(it->x(), it->y()))
+            continue;
+
+        const Cell &a = before.cell(it->x(), it->y());
+        const Cell &b = now.cell(it->x(), it->y());
+        if (a.Cpenalty != b.Cpenalty || a.CIpenalty != b.CIpenalty)
+            return true;
+    }
+    return false;
+}
+
+class ConnectorRouteThread : public QThread
+{
+public:
+    ConnectorRouteThread(const std::vector<ConnectorRoute> *routes, QAtomicInt *nextRoute, const Cells *cells)
+        : m_pRoutes(routes)
+        , m_pNextRoute(nextRoute)
+        , m_pCells(cells)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        mapConnectorRoutes(*m_pRoutes, m_pNextRoute, m_pCells);
+    }
+
+    const std::vector<ConnectorRoute> *m_pRoutes;
+    QAtomicInt *m_pNextRoute;
+    const Cells *m_pCells;
+};
+// END class ConnectorRouteThread
+
 // BEGIN class ICNDocument
 ICNDocument::ICNDocument(const QString &caption)
     : ItemDocument(caption)
     , m_cells(nullptr)
+    , m_bRerouteAll(false)
 {
     m_canvas->retune(48);
     m_selectList = new CNItemGroup(this);
@@ -85,12 +163,7 @@ CNItem *ICNDocument::cnItemWithID(const QString &id)
 
 Connector *ICNDocument::connectorWithID(const QString &id)
 {
-    const ConnectorList::iterator end = m_connectorList.end();
-    for (ConnectorList::iterator it = m_connectorList.begin(); it != end; ++it) {
-        if ((*it)->id() == id)
-            return *it;
-    }
-    return nullptr;
+    return dynamic_cast<Connector *>(handleItem(idHandle(id)));
 }
 
 FlowContainer *ICNDocument::flowContainer(const QPoint &pos)
@@ -424,29 +497,42 @@ void ICNDocument::getTranslatable(const ItemList &itemList, ConnectorList *fixed
     }
 }
 
+MemoryUsage ICNDocument::memoryUsage() const
+{
+    MemoryUsage usage = ItemDocument::memoryUsage();
+
+    usage.bytes[MemoryUsage::RoutingCells] = m_cells->memoryUsage();
+
+    for (const QPointer<Connector> &connector : m_connectorList) {
+        if (connector && !connector->canvas())
+            usage.bytes[MemoryUsage::HiddenSubcircuitItems] += sizeof(Connector);
+    }
+    const NodeList nodes = nodeList();
+    for (const QPointer<Node> &node : nodes) {
+        if (node && !node->canvas())
+            usage.bytes[MemoryUsage::HiddenSubcircuitItems] += sizeof(Node);
+    }
+
+    return usage;
+}
+
 void ICNDocument::addCPenalty(int x, int y, int score)
 {
-    if (m_cells->haveCell(x, y))
-        m_cells->cell(x, y).Cpenalty += score;
+    m_cells->cell(x, y).Cpenalty += score;
 }
 
 void ICNDocument::createCellMap()
 {
-    const ItemMap::iterator ciEnd = m_itemList.end();
-    for (ItemMap::iterator it = m_itemList.begin(); it != ciEnd; ++it) {
-        if (CNItem *cnItem = dynamic_cast<CNItem *>(*it))
-            cnItem->updateConnectorPoints(false);
-    }
-
-    const ConnectorList::iterator conEnd = m_connectorList.end();
-    for (ConnectorList::iterator it = m_connectorList.begin(); it != conEnd; ++it) {
-        (*it)->updateConnectorPoints(false);
+    // The penalties are kept up to date as items and connectors are changed,
+    // including those off the canvas, so only the canvas rectangle changes
+    if (m_cells) {
+        m_cells->setCanvasRect(canvas()->rect());
+        return;
     }
 
-    delete m_cells;
-
     m_cells = new Cells(canvas()->rect());
 
+    const ConnectorList::iterator conEnd = m_connectorList.end();
     for (ConnectorList::iterator it = m_connectorList.begin(); it != conEnd; ++it)
         (*it)->updateConnectorPoints(true);
 }
@@ -505,6 +591,7 @@ bool ICNDocument::registerItem(KtlQCanvasItem *qcanvasItem)
 
         } else if (Connector *connector = dynamic_cast<Connector *>(qcanvasItem)) {
             m_connectorList.append(connector);
+            setHandleItem(connector->id(), connector);
             emit connectorAdded(connector);
         } else {
             qCCritical(KTL_LOG) << "Unrecognised item";
@@ -543,19 +630,30 @@ void ICNDocument::copy()
 
     NodeList nodeList;
     // Remove those connectors (and nodes) which are dangling on an orphan node
+    QSet<Connector *> danglingConnectors;
     NCLMap::iterator nclEnd = nclMap.end();
     for (NCLMap::iterator it = nclMap.begin(); it != nclEnd; ++it) {
         if (it.value().size() > 1)
             nodeList.append(it.key());
         else if (it.value().size() > 0)
-            connectorList.removeAll(it.value().at(0));
+            danglingConnectors.insert(it.value().at(0));
+    }
+    if (!danglingConnectors.isEmpty()) {
+        ConnectorList keptConnectors;
+        keptConnectors.reserve(connectorList.size());
+        for (const QPointer<Connector> &connector : qAsConst(connectorList)) {
+            if (!danglingConnectors.contains(connector))
+                keptConnectors.append(connector);
+        }
+        connectorList = keptConnectors;
     }
 
     data.addItems(m_selectList->items(false));
     data.addNodes(nodeList);
     data.addConnectors(connectorList);
 
-    QApplication::clipboard()->setText(data.toXML(), QClipboard::Clipboard);
+    // The xml is only written if another program wants it; see paste()
+    QApplication::clipboard()->setMimeData(new ItemDocumentMimeData(data), QClipboard::Clipboard);
 }
 
 void ICNDocument::selectAll()
@@ -649,16 +747,33 @@ void ICNDocument::addAllItemConnectorPoints()
 
 void ICNDocument::requestRerouteInvalidatedConnectors()
 {
+    m_bRerouteAll = true;
+    requestEvent(ItemDocumentEvent::RerouteInvalidatedConnectors);
+}
+
+void ICNDocument::requestRerouteInvalidatedConnectors(const QRect &changedRect)
+{
+    m_rerouteRect |= changedRect;
     requestEvent(ItemDocumentEvent::RerouteInvalidatedConnectors);
 }
 
 void ICNDocument::rerouteInvalidatedConnectors()
 {
+    StallWatch::Region region("Reroute connectors", this);
+
     // qApp->processEvents(QEventLoop::AllEvents, 300); // 2015.07.07 - do not process events, if it is not urgently needed; might generate crashes?
 
     // We only ever need to add the connector points for CNItem's when we're about to reroute...
     addAllItemConnectorPoints();
 
+    // When only part of the canvas has changed, only the connectors through
+    // it can have had items moved onto them (an empty rectangle means the
+    // event was requested without saying where)
+    const bool rerouteAll = m_bRerouteAll || m_rerouteRect.isEmpty();
+    const QRect rerouteRect = m_rerouteRect;
+    m_bRerouteAll = false;
+    m_rerouteRect = QRect();
+
     // List of connectors which are to be determined to need rerouting (and whose routes aren't controlled by NodeGroups)
     ConnectorList connectorRerouteList;
 
@@ -691,11 +806,13 @@ void ICNDocument::rerouteInvalidatedConnectors()
             }
 
             // Test to see if the route intersects any Items (we ignore if it is a manual route)
-            if (!needsRerouting && !connector->usesManualPoints()) {
-                const KtlQCanvasItemList collisions = connector->collisions(true);
+            if (!needsRerouting && !connector->usesManualPoints() && (rerouteAll || connector->routeBoundingRect().intersects(rerouteRect))) {
+                const KtlQCanvasItemList collisions = connector->routeCollisions();
                 const KtlQCanvasItemList::const_iterator collisionsEnd = collisions.end();
                 for (KtlQCanvasItemList::const_iterator collisionsIt = collisions.begin(); (collisionsIt != collisionsEnd) && !needsRerouting; ++collisionsIt) {
-                    if (dynamic_cast<Item *>(*collisionsIt))
+                    // A connector in a container goes across it, of course
+                    Item *item = dynamic_cast<Item *>(*collisionsIt);
+                    if (item && item != connector->parentContainer())
                         needsRerouting = true;
                 }
             }
@@ -703,10 +820,14 @@ void ICNDocument::rerouteInvalidatedConnectors()
             if (needsRerouting) {
                 NodeGroup *nodeGroup = connector->nodeGroup();
 
-                if (!nodeGroup && !connectorRerouteList.contains(connector))
-                    connectorRerouteList.append(connector);
-                else if (nodeGroup && !nodeGroupRerouteList.contains(nodeGroup))
-                    nodeGroupRerouteList.append(nodeGroup);
+                if (!nodeGroup) {
+                    if (!connectorRerouteList.contains(connector))
+                        connectorRerouteList.append(connector);
+                } else {
+                    nodeGroup->invalidateRoute(connector);
+                    if (!nodeGroupRerouteList.contains(nodeGroup))
+                        nodeGroupRerouteList.append(nodeGroup);
+                }
             }
         }
     }
@@ -714,7 +835,7 @@ void ICNDocument::rerouteInvalidatedConnectors()
     // To allow proper rerouting, we want to start with clean routes for all of the invalidated connectors
     const NodeGroupList::iterator nodeGroupRerouteEnd = nodeGroupRerouteList.end();
     for (NodeGroupList::iterator it = nodeGroupRerouteList.begin(); it != nodeGroupRerouteEnd; ++it) {
-        const ConnectorList contained = (*it)->connectorList();
+        const ConnectorList contained = (*it)->invalidatedRoutes();
         const ConnectorList::const_iterator end = contained.end();
         for (ConnectorList::const_iterator it = contained.begin(); it != end; ++it)
             (*it)->updateConnectorPoints(false);
@@ -728,8 +849,7 @@ void ICNDocument::rerouteInvalidatedConnectors()
     for (NodeGroupList::iterator it = nodeGroupRerouteList.begin(); it != nodeGroupRerouteEnd; ++it)
         (*it)->updateRoutes();
 
-    for (ConnectorList::iterator it = connectorRerouteList.begin(); it != connectorRerouteEnd; ++it)
-        (*it)->rerouteConnector();
+    rerouteConnectors(connectorRerouteList);
 
     for (ConnectorList::iterator it = m_connectorList.begin(); it != connectorListEnd; ++it) {
         if (*it)
@@ -737,6 +857,69 @@ void ICNDocument::rerouteInvalidatedConnectors()
     }
 }
 
+void ICNDocument::rerouteConnectors(const ConnectorList &connectors)
+{
+    std::vector<ConnectorRoute> routes;
+    routes.reserve(connectors.size());
+
+    const ConnectorList::const_iterator end = connectors.end();
+    for (ConnectorList::const_iterator it = connectors.begin(); it != end; ++it) {
+        Connector *connector = *it;
+        if (!connector)
+            continue;
+
+        if (!connector->isVisible() || connector->nodeGroup() || !connector->startNode() || !connector->endNode()) {
+            // Leave it to do (or warn about) whatever it would normally
+            connector->rerouteConnector();
+            continue;
+        }
+
+        connector->updateConnectorPoints(false);
+
+        ConnectorRoute route;
+        route.connector = connector;
+        route.sx = int(connector->startNode()->x());
+        route.sy = int(connector->startNode()->y());
+        route.ex = int(connector->endNode()->x());
+        route.ey = int(connector->endNode()->y());
+        routes.push_back(route);
+    }
+
+    const int threadCount = std::min(QThread::idealThreadCount(), int(routes.size()) / ROUTES_PER_THREAD);
+    if (threadCount < 2) {
+        for (std::vector<ConnectorRoute>::const_iterator it = routes.begin(); it != routes.end(); ++it)
+            it->connector->rerouteConnector();
+        return;
+    }
+
+    // The routes are mapped against the cells as they are now, which are
+    // kept to see where the routes added since have changed the penalties
+    const Cells before(*m_cells);
+    QAtomicInt nextRoute(0);
+
+    std::vector<ConnectorRouteThread *> threads;
+    for (int i = 1; i < threadCount; ++i) {
+        ConnectorRouteThread *thread = new ConnectorRouteThread(&routes, &nextRoute, &before);
+        threads.push_back(thread);
+        thread->start();
+    }
+
+    mapConnectorRoutes(routes, &nextRoute, &before);
+
+    for (std::vector<ConnectorRouteThread *>::iterator it = threads.begin(); it != threads.end(); ++it) {
+        (*it)->wait();
+        delete *it;
+    }
+
+    for (std::vector<ConnectorRoute>::const_iterator it = routes.begin(); it != routes.end(); ++it) {
+        Connector *connector = it->connector;
+        if (routePenaltiesChanged(connector->conRouter()->cellPointList(), before, *m_cells))
+            connector->rerouteConnector();
+        else
+            connector->routeMapped();
+    }
+}
+
 void ICNDocument::deleteSelection()
 {
     // End whatever editing mode we are in, as we don't want to start editing
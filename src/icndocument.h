@@ -108,6 +108,7 @@ public:
      * Adds score to the cells at the given cell reference
      */
     void addCPenalty(int x, int y, int score);
+    MemoryUsage memoryUsage() const override;
     /**
      * If there are two connectors joined to a node, then they can be merged
      * into one connector. The node will not be removed.
@@ -208,6 +209,23 @@ public:
      * directly - instead use ItemDocument::requestEvent.
      */
     void rerouteInvalidatedConnectors();
+    /**
+     * Reroutes the given connectors. When there are enough of them, their
+     * routes are mapped at the same time on several threads, against a copy
+     * of the cells made once the old routes have been taken out. The
+     * routes are then added in order; one that goes through a cell whose
+     * penalty an earlier route has changed is rerouted as usual instead,
+     * with the earlier routes in place.
+     */
+    void rerouteConnectors(const ConnectorList &connectors);
+    /**
+     * Like requestRerouteInvalidatedConnectors, but for when only the given
+     * rectangle of the canvas has changed (e.g. where items have been moved
+     * to). Connectors that do not pass through it are not checked for
+     * collisions with items, although those whose ends have moved are still
+     * rerouted.
+     */
+    void requestRerouteInvalidatedConnectors(const QRect &changedRect);
     /**
      * Assigns the orphan nodes into NodeGroups. You shouldn't call this
      * function directly - instead use ItemDocument::requestEvent.
@@ -228,9 +246,10 @@ public slots:
      */
     void requestRerouteInvalidatedConnectors();
     /**
-     * Remaps the 2-dimension array of ICNDocument cells, and the various
-     * hitscores / etc associated with them. This is used for connector
-     * routing, and should be called after e.g. items have been moved
+     * Makes the ICNDocument cells used for connector routing, or, once they
+     * have been made, fits them to the canvas. The hitscores associated with
+     * them are kept up to date as items and connectors are added and moved,
+     * so this should be called after the canvas has been resized.
      */
     void createCellMap();
     /**
@@ -291,6 +310,8 @@ protected:
 private:
     Cells *m_cells;
     GuardedNodeGroupList m_nodeGroupList;
+    QRect m_rerouteRect; ///< union of the changed rectangles for the next reroute
+    bool m_bRerouteAll; ///< whether the next reroute must check every connector
 };
 
 /**
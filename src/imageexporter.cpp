@@ -0,0 +1,368 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "imageexporter.h"
+#include "itemdocument.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QImage>
+#include <QPageSize>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QSvgGenerator>
+#include <QThread>
+
+#include <cmath>
+#include <deque>
+
+#include <zlib.h>
+
+#include <ktechlab_debug.h>
+
+// The pixels in a strip of a bitmap, to keep each strip to a few megabytes
+static const int STRIP_PIXELS = 1 << 21;
+
+// BEGIN class PngStripThread
+/**
+Filters and compresses the rows of a strip of a PNG image. The strips are
+compressed independently of each other, each ending on a byte boundary (a
+sync flush), so that the compressed strips joined in order make up the zlib
+stream of the whole image; only the last strip finishes the stream.
+*/
+class PngStripThread : public QThread
+{
+public:
+    PngStripThread(const QImage &strip, bool isLast)
+        : m_strip(strip)
+        , m_bLast(isLast)
+        , m_adler(0)
+        , m_length(0)
+        , m_bFailed(false)
+    {
+    }
+
+    QByteArray compressed() const
+    {
+        return m_compressed;
+    }
+    /**
+     * @return the Adler-32 checksum and the length of the data before it
+     * was compressed, for combining into the checksum of the whole stream
+     */
+    uLong adler() const
+    {
+        return m_adler;
+    }
+    z_off_t length() const
+    {
+        return m_length;
+    }
+    bool failed() const
+    {
+        return m_bFailed;
+    }
+    bool isLast() const
+    {
+        return m_bLast;
+    }
+
+protected:
+    void run() override
+    {
+        const int width = m_strip.width();
+        const int rowBytes = 1 + 3 * width;
+        QByteArray raw(rowBytes * m_strip.height(), Qt::Uninitialized);
+
+        // Each row is filtered with the "Sub" filter: the difference from
+        // the pixel to the left, which suits the large flat areas of a
+        // schematic
+        for (int y = 0; y < m_strip.height(); ++y) {
+            const QRgb *pixels = reinterpret_cast<const QRgb *>(m_strip.constScanLine(y));
+            uchar *out = reinterpret_cast<uchar *>(raw.data()) + y * rowBytes;
+            *out++ = 1;
+            uchar previous[3] = {0, 0, 0};
+            for (int x = 0; x < width; ++x) {
+                const uchar rgb[3] = {uchar(qRed(pixels[x])), uchar(qGreen(pixels[x])), uchar(qBlue(pixels[x]))};
+                for (int i = 0; i < 3; ++i) {
+                    *out++ = uchar(rgb[i] - previous[i]);
+                    previous[i] = rgb[i];
+                }
+            }
+        }
+        m_strip = QImage();
+
+        m_length = raw.size();
+        m_adler = adler32(adler32(0, nullptr, 0), reinterpret_cast<const Bytef *>(raw.constData()), uInt(raw.size()));
+
+        z_stream stream;
+        stream.zalloc = Z_NULL;
+        stream.zfree = Z_NULL;
+        stream.opaque = Z_NULL;
+        // Raw deflate, as the zlib header and checksum are written for the
+        // stream as a whole
+        if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            m_bFailed = true;
+            return;
+        }
+
+        // Room for the data and the marker of a sync flush
+        m_compressed.resize(int(deflateBound(&stream, uLong(raw.size()))) + 16);
+        stream.next_in = reinterpret_cast<Bytef *>(raw.data());
+        stream.avail_in = uInt(raw.size());
+        stream.next_out = reinterpret_cast<Bytef *>(m_compressed.data());
+        stream.avail_out = uInt(m_compressed.size());
+
+        const int result = deflate(&stream, m_bLast ? Z_FINISH : Z_SYNC_FLUSH);
+        if (result != (m_bLast ? Z_STREAM_END : Z_OK) || stream.avail_in != 0)
+            m_bFailed = true;
+
+        m_compressed.resize(int(stream.total_out));
+        deflateEnd(&stream);
+    }
+
+    QImage m_strip;
+    bool m_bLast;
+    QByteArray m_compressed;
+    uLong m_adler;
+    z_off_t m_length;
+    bool m_bFailed;
+};
+// END class PngStripThread
+
+static void writePngChunk(QDataStream &stream, const char *type, const QByteArray &data)
+{
+    uLong crc = crc32(0, nullptr, 0);
+    crc = crc32(crc, reinterpret_cast<const Bytef *>(type), 4);
+    crc = crc32(crc, reinterpret_cast<const Bytef *>(data.constData()), uInt(data.size()));
+
+    stream << quint32(data.size());
+    stream.writeRawData(type, 4);
+    stream.writeRawData(data.constData(), data.size());
+    stream << quint32(crc);
+}
+
+// BEGIN class ImageExporter
+ImageExporter::ImageExporter(ItemDocument *itemDocument, const QRect &area, double scale)
+    : p_itemDocument(itemDocument)
+    , m_area(area)
+    , m_scale(scale)
+{
+    m_imageSize = QSize(std::max(1, int(std::ceil(area.width() * scale))), std::max(1, int(std::ceil(area.height() * scale))));
+}
+
+bool ImageExporter::save(const QString &filePath, const QString &type)
+{
+    if (m_area.isEmpty())
+        return false;
+
+    Canvas *canvas = p_itemDocument->canvas();
+    canvas->setBackgroundPixmap(QPixmap());
+
+    bool saved = false;
+
+    if (type == "PNG" || type == "BMP") {
+        QFile file(filePath);
+        if (file.open(QIODevice::WriteOnly)) {
+            saved = (type == "PNG") ? savePNG(file) : saveBMP(file);
+            file.close();
+            saved = saved && (file.error() == QFileDevice::NoError);
+        }
+    } else if (type == "SVG" || type == "PDF") {
+        // Buttons and sliders are drawn as widgets on bitmaps only
+        p_itemDocument->setSVGExport(true);
+
+        if (type == "SVG") {
+            QSvgGenerator generator;
+            generator.setFileName(filePath);
+            generator.setSize(m_area.size());
+            generator.setViewBox(QRect(QPoint(0, 0), m_area.size()));
+            saved = saveVector(generator);
+        } else {
+            QPdfWriter writer(filePath);
+            // One point of the page for each pixel of the canvas
+            writer.setResolution(72);
+            writer.setPageSize(QPageSize(QSizeF(m_area.size()), QPageSize::Point));
+            writer.setPageMargins(QMarginsF(0, 0, 0, 0));
+            saved = saveVector(writer);
+        }
+
+        p_itemDocument->setSVGExport(false);
+    } else
+        qCWarning(KTL_LOG) << "Unknown type" << type;
+
+    p_itemDocument->updateBackground();
+    return saved;
+}
+
+int ImageExporter::stripHeight() const
+{
+    return qBound(1, STRIP_PIXELS / m_imageSize.width(), m_imageSize.height());
+}
+
+void ImageExporter::renderStrip(QImage &strip, int top)
+{
+    strip.fill(Qt::white);
+
+    QPainter p;
+    if (!p.begin(&strip)) {
+        qCWarning(KTL_LOG) << " painter not active";
+        return;
+    }
+
+    p.translate(0, -top);
+    p.scale(m_scale, m_scale);
+    p.translate(-m_area.x(), -m_area.y());
+
+    // The rows of the canvas under the strip, taking in any that are only
+    // partly covered
+    const int canvasTop = m_area.y() + int(std::floor(top / m_scale));
+    const int canvasBottom = m_area.y() + int(std::ceil((top + strip.height()) / m_scale));
+    const QRect clip(m_area.x(), canvasTop, m_area.width(), canvasBottom - canvasTop + 1);
+
+    p_itemDocument->canvas()->drawArea(clip & m_area, &p);
+    p.end();
+}
+
+bool ImageExporter::savePNG(QIODevice &device)
+{
+    QDataStream stream(&device);
+    stream.setByteOrder(QDataStream::BigEndian);
+
+    static const char signature[] = {'\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n'};
+    stream.writeRawData(signature, sizeof(signature));
+
+    QByteArray header;
+    {
+        QDataStream headerStream(&header, QIODevice::WriteOnly);
+        headerStream << quint32(m_imageSize.width()) << quint32(m_imageSize.height());
+        headerStream << quint8(8) // bits per sample
+                     << quint8(2) // RGB
+                     << quint8(0) << quint8(0) << quint8(0); // deflate, filtered by row, not interlaced
+    }
+    writePngChunk(stream, "IHDR", header);
+
+    const int height = m_imageSize.height();
+    const int rowsPerStrip = stripHeight();
+    // At least one strip is compressed while the next one is rendered
+    const size_t maxThreads = size_t(std::max(2, QThread::idealThreadCount()));
+
+    std::deque<PngStripThread *> threads;
+    uLong adler = adler32(0, nullptr, 0);
+    bool isFirst = true;
+    bool ok = true;
+
+    // Writes out the oldest strip, once it has been compressed
+    auto writeStrip = [&]() {
+        PngStripThread *thread = threads.front();
+        threads.pop_front();
+        thread->wait();
+
+        if (thread->failed())
+            ok = false;
+
+        if (ok) {
+            QByteArray data;
+            if (isFirst)
+                data = QByteArray("\x78\x9c", 2); // zlib header: deflate, 32K window
+            data += thread->compressed();
+            adler = adler32_combine(adler, thread->adler(), thread->length());
+
+            if (thread->isLast()) {
+                QDataStream trailer(&data, QIODevice::Append);
+                trailer << quint32(adler);
+            }
+            writePngChunk(stream, "IDAT", data);
+            isFirst = false;
+        }
+        delete thread;
+    };
+
+    for (int top = 0; top < height; top += rowsPerStrip) {
+        const int rows = std::min(rowsPerStrip, height - top);
+        QImage strip(m_imageSize.width(), rows, QImage::Format_RGB32);
+        renderStrip(strip, top);
+
+        PngStripThread *thread = new PngStripThread(strip, top + rows >= height);
+        threads.push_back(thread);
+        thread->start();
+
+        // Wait for the oldest strips, so that only a few are held at once
+        while (threads.size() >= maxThreads)
+            writeStrip();
+    }
+    while (!threads.empty())
+        writeStrip();
+
+    writePngChunk(stream, "IEND", QByteArray());
+    return ok && (stream.status() == QDataStream::Ok);
+}
+
+bool ImageExporter::saveBMP(QIODevice &device)
+{
+    const int width = m_imageSize.width();
+    const int height = m_imageSize.height();
+    const qint64 rowBytes = (3 * qint64(width) + 3) & ~qint64(3);
+    const qint64 imageBytes = rowBytes * height;
+    if (54 + imageBytes > 0xffffffffLL) {
+        qCWarning(KTL_LOG) << "Image is too large for a BMP file:" << m_imageSize;
+        return false;
+    }
+
+    QDataStream stream(&device);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    // File header, then the BITMAPINFOHEADER of an uncompressed 24-bit
+    // image with the rows from the bottom up
+    stream.writeRawData("BM", 2);
+    stream << quint32(54 + imageBytes) << quint32(0) << quint32(54);
+    stream << quint32(40) << qint32(width) << qint32(height) << quint16(1) << quint16(24);
+    stream << quint32(0) << quint32(imageBytes) << qint32(2835) << qint32(2835) << quint32(0) << quint32(0);
+
+    // The strips are rendered from the bottom of the image, in the order
+    // that their rows are written
+    const int rowsPerStrip = stripHeight();
+    QByteArray row(int(rowBytes), '\0');
+
+    for (int bottom = height; bottom > 0;) {
+        const int top = std::max(0, bottom - rowsPerStrip);
+        QImage strip(width, bottom - top, QImage::Format_RGB32);
+        renderStrip(strip, top);
+
+        for (int y = strip.height() - 1; y >= 0; --y) {
+            const QRgb *pixels = reinterpret_cast<const QRgb *>(strip.constScanLine(y));
+            char *out = row.data();
+            for (int x = 0; x < width; ++x) {
+                *out++ = char(qBlue(pixels[x]));
+                *out++ = char(qGreen(pixels[x]));
+                *out++ = char(qRed(pixels[x]));
+            }
+            stream.writeRawData(row.constData(), row.size());
+        }
+
+        bottom = top;
+    }
+
+    return stream.status() == QDataStream::Ok;
+}
+
+bool ImageExporter::saveVector(QPaintDevice &paintDevice)
+{
+    QPainter p;
+    if (!p.begin(&paintDevice)) {
+        qCWarning(KTL_LOG) << " painter not active";
+        return false;
+    }
+
+    p.translate(-m_area.x(), -m_area.y());
+    p_itemDocument->canvas()->drawArea(m_area, &p);
+    return p.end();
+}
+// END class ImageExporter
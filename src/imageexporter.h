@@ -0,0 +1,84 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef IMAGEEXPORTER_H
+#define IMAGEEXPORTER_H
+
+#include <QRect>
+#include <QSize>
+#include <QString>
+
+class ItemDocument;
+class QImage;
+class QIODevice;
+class QPaintDevice;
+
+/**
+Exports an area of the canvas of an ItemDocument to an image file.
+
+Bitmaps (PNG and BMP) are rendered a strip of rows at a time and written out
+as each strip is done, so the memory used does not grow with the size of the
+image; exporting a poster-size schematic at a high scale only needs a few
+strips in memory. The PNG strips are compressed in other threads while the
+next ones are rendered. The rendering itself stays in the GUI thread, as the
+canvas keeps track of what it has drawn in its items.
+
+Vector formats (SVG and PDF) are drawn in one pass, which takes memory for
+the items drawn rather than for the pixels.
+
+@short Writes images of an ItemDocument
+*/
+class ImageExporter
+{
+public:
+    /**
+     * @param area the area of the canvas to export
+     * @param scale the number of pixels of the image for each pixel of the
+     * canvas (for the bitmap formats)
+     */
+    ImageExporter(ItemDocument *itemDocument, const QRect &area, double scale = 1.0);
+
+    /**
+     * Writes the image.
+     * @param type one of "PNG", "BMP", "SVG" or "PDF"
+     * @return whether the file could be written
+     */
+    bool save(const QString &filePath, const QString &type);
+
+    /**
+     * @return the size of the image in pixels (for the bitmap formats)
+     */
+    QSize imageSize() const
+    {
+        return m_imageSize;
+    }
+
+protected:
+    bool savePNG(QIODevice &device);
+    bool saveBMP(QIODevice &device);
+    bool saveVector(QPaintDevice &paintDevice);
+    /**
+     * @return the number of rows rendered at a time, which is chosen to
+     * keep the strip to a few megabytes
+     */
+    int stripHeight() const;
+    /**
+     * Renders the rows of the image from @p top into @p strip, which is as
+     * wide as the image.
+     */
+    void renderStrip(QImage &strip, int top);
+
+    ItemDocument *p_itemDocument;
+    QRect m_area;
+    double m_scale;
+    QSize m_imageSize;
+};
+
+#endif
@@ -12,6 +12,8 @@
 #include "itemdocumentdata.h"
 #include "ktechlab.h"
 #include "richtexteditor.h"
+#include "simulator.h"
+#include "stimulus.h"
 
 #include <KStandardGuiItem>
 #include <KTextEdit>
@@ -58,7 +60,10 @@ Item::Item(ItemDocument *itemDocument, bool newItem, const QString &id)
     }
 
     m_pPropertyChangedTimer = new QTimer(this);
-    connect(m_pPropertyChangedTimer, &QTimer::timeout, this, &Item::dataChanged);
+    connect(m_pPropertyChangedTimer, &QTimer::timeout, this, [this] {
+        SimulationLocker locker;
+        dataChanged();
+    });
 }
 
 Item::~Item()
@@ -532,19 +537,19 @@ double Item::getMultiplier(const QString &_mag)
 double Item::dataDouble(const QString &id) const
 {
     Variant *variant = property(id);
-    return variant ? variant->value().toDouble() : 0.0;
+    return variant ? variant->doubleValue() : 0.0;
 }
 
 int Item::dataInt(const QString &id) const
 {
     Variant *variant = property(id);
-    return variant ? variant->value().toInt() : 0;
+    return variant ? variant->intValue() : 0;
 }
 
 bool Item::dataBool(const QString &id) const
 {
     Variant *variant = property(id);
-    return variant ? variant->value().toBool() : false;
+    return variant ? variant->boolValue() : false;
 }
 
 QString Item::dataString(const QString &id) const
@@ -571,8 +576,9 @@ Variant *Item::createProperty(const QString &id, Variant::Type::Value type)
 
 Variant *Item::property(const QString &id) const
 {
-    if (m_variantData.contains(id))
-        return m_variantData[id];
+    VariantDataMap::const_iterator it = m_variantData.constFind(id);
+    if (it != m_variantData.constEnd())
+        return it.value();
 
     qCCritical(KTL_LOG) << " No such property with id " << id;
     return nullptr;
@@ -585,15 +591,31 @@ bool Item::hasProperty(const QString &id) const
 
 void Item::finishedCreation()
 {
+    SimulationLocker locker;
     m_bDoneCreation = true;
     dataChanged();
 }
 
+void Item::applyPropertyChanges()
+{
+    if (!m_pPropertyChangedTimer->isActive())
+        return;
+
+    m_pPropertyChangedTimer->stop();
+    SimulationLocker locker;
+    dataChanged();
+}
+
 void Item::propertyChangedInitial()
 {
     if (!m_bDoneCreation)
         return;
 
+    if (p_itemDocument && p_itemDocument->stimulusRecorder()) {
+        if (const Variant *variant = qobject_cast<const Variant *>(sender()))
+            p_itemDocument->stimulusRecorder()->recordProperty(id(), variant);
+    }
+
     m_pPropertyChangedTimer->setSingleShot(true);
     m_pPropertyChangedTimer->start(0 /*, true */);
 }
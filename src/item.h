@@ -56,12 +56,21 @@ public:
         return &m_variantData;
     }
 
+    /**
+     * These look the property up by id. Where this matters, keep the
+     * property returned by createProperty and read it directly instead.
+     */
     double dataDouble(const QString &id) const;
     int dataInt(const QString &id) const;
     bool dataBool(const QString &id) const;
     QString dataString(const QString &id) const;
     QColor dataColor(const QString &id) const;
 
+    /**
+     * The property lives as long as the item, so the pointer returned can be
+     * kept to read the value (e.g. with Variant::doubleValue) without
+     * looking it up by id each time.
+     */
     virtual Property *createProperty(const QString &id, Variant::Type::Value type);
     Property *property(const QString &id) const;
     bool hasProperty(const QString &id) const;
@@ -114,6 +123,12 @@ public:
      * constructing themselves.
      */
     virtual void finishedCreation();
+    /**
+     * Changes to the properties are normally acted on (by dataChanged) from
+     * a timer, once control returns to the event loop. This acts on them
+     * straight away instead, if there are any.
+     */
+    void applyPropertyChanges();
     /**
      * Sets the selected flag of the item to yes. selected or unselected will be
      * emitted as appropriate
@@ -8,6 +8,7 @@
  *   (at your option) any later version.                                   *
  ***************************************************************************/
 
+#include "autosave.h"
 #include "canvasitemparts.h"
 #include "canvasmanipulator.h"
 #include "cells.h"
@@ -19,6 +20,7 @@
 #include "flowcodedocument.h"
 #include "icnview.h"
 #include "imageexportdlg.h"
+#include "imageexporter.h"
 #include "itemdocumentdata.h"
 #include "itemgroup.h"
 #include "itemselector.h"
@@ -26,6 +28,8 @@
 #include "pin.h"
 #include "resizeoverlay.h"
 #include "simulator.h"
+#include "stallwatch.h"
+#include "stimulus.h"
 
 #include <KLocalizedString>
 #include <KMessageBox>
@@ -42,8 +46,7 @@
 #include <QMenu>
 // #include <q3paintdevicemetrics.h>
 #include <QPainter>
-#include <QPicture>
-#include <QRegExp>
+#include <QScreen>
 // #include <q3simplerichtext.h> // 2018.08.13 - not needed
 #include <QFile>
 #include <QPrintDialog>
@@ -57,6 +60,12 @@
 #include <ktlconfig.h>
 #include <ktechlab_debug.h>
 
+/**
+ * How long (in milliseconds) after the last step of a continuous edit its
+ * state is saved.
+ */
+static const int COALESCED_STATE_SAVE_DELAY = 500;
+
 // BEGIN class ItemDocument
 int ItemDocument::m_nextActionTicket = 0;
 
@@ -65,9 +74,13 @@ ItemDocument::ItemDocument(const QString &caption)
 {
     m_queuedEvents = 0;
     m_nextIdNum = 1;
-    m_savedState = nullptr;
+    m_savedState = -1;
     m_currentState = nullptr;
+    m_currentStateNumber = 0;
+    m_nextStateNumber = 0;
     m_bIsLoading = false;
+    m_bBinaryFormat = false;
+    m_bulkLoadDepth = 0;
 
     m_canvas = new Canvas(this);
     m_canvas->setObjectName("canvas");
@@ -82,6 +95,14 @@ ItemDocument::ItemDocument(const QString &caption)
     m_pEventTimer = new QTimer(this);
     connect(m_pEventTimer, &QTimer::timeout, this, &ItemDocument::processItemDocumentEvents);
 
+    m_coalescedActionTicket = -1;
+    m_pCoalescedStateSaveTimer = new QTimer(this);
+    m_pCoalescedStateSaveTimer->setSingleShot(true);
+    connect(m_pCoalescedStateSaveTimer, &QTimer::timeout, this, &ItemDocument::flushCoalescedStateSave);
+
+    m_pAutoSave = new AutoSave(this);
+    m_pStimulusRecorder = nullptr;
+
     connect(this, &ItemDocument::selectionChanged, this, &ItemDocument::slotInitItemActions);
 
     connect(ComponentSelector::self(), qOverload<const QString &>(&ComponentSelector::itemClicked), this, &ItemDocument::slotUnsetRepeatedItemId);
@@ -118,6 +139,7 @@ ItemDocument::~ItemDocument()
     delete m_cmManager;
     delete m_currentState;
     delete m_canvasTip;
+    delete m_pStimulusRecorder;
 }
 
 void ItemDocument::handleNewView(View *view)
@@ -135,6 +157,7 @@ bool ItemDocument::registerItem(KtlQCanvasItem *qcanvasItem)
 
     if (Item *item = dynamic_cast<Item *>(qcanvasItem)) {
         m_itemList[item->id()] = item;
+        setHandleItem(item->id(), item);
         connect(item, &Item::selectionChanged, this, &ItemDocument::selectionChanged);
         itemAdded(item);
         return true;
@@ -185,12 +208,16 @@ void ItemDocument::fileSaveAs()
 
 void ItemDocument::writeFile()
 {
+    // So that the state saved as the file includes the edit
+    flushCoalescedStateSave();
+
     ItemDocumentData data(type());
     data.saveDocumentState(this);
 
-    if (data.saveData(url())) {
-        m_savedState = m_currentState;
+    if (data.saveData(url(), m_bBinaryFormat || KTLConfig::binaryDocuments())) {
+        m_savedState = m_currentStateNumber;
         setModified(false);
+        m_pAutoSave->discard();
     }
 }
 
@@ -201,6 +228,14 @@ bool ItemDocument::openURL(const QUrl &url)
     if (!data.loadData(url))
         return false;
 
+    openData(&data, url);
+    return true;
+}
+
+void ItemDocument::openData(ItemDocumentData *data, const QUrl &url)
+{
+    m_bBinaryFormat = data->isBinaryFormat();
+
     // Why do we stop simulating while loading a document?
     // Crash possible when loading a circuit document, and the Qt event loop is
     // reentered (such as when a PIC component pops-up a message box), which
@@ -210,13 +245,13 @@ bool ItemDocument::openURL(const QUrl &url)
     m_bIsLoading = true;
     bool wasSimulating = Simulator::self()->isSimulating();
     Simulator::self()->slotSetSimulating(false);
-    data.restoreDocument(this);
+    data->restoreDocument(this);
     Simulator::self()->slotSetSimulating(wasSimulating);
     m_bIsLoading = false;
 
     setURL(url);
     clearHistory();
-    m_savedState = m_currentState;
+    m_savedState = m_currentStateNumber;
     setModified(false);
 
     if (FlowCodeDocument *fcd = dynamic_cast<FlowCodeDocument *>(this)) {
@@ -237,6 +272,50 @@ bool ItemDocument::openURL(const QUrl &url)
     }
     slotUpdateZOrdering();
 
+    if (url.isEmpty())
+        return;
+
+    // Changes that were not saved when KTechlab last closed unexpectedly
+    const QString recoveryFile = AutoSave::recoveryFile(url);
+    if (recoveryFile.isEmpty())
+        return;
+
+    const int answer = KMessageBox::questionYesNo(KTechlab::self(),
+                                                  i18n("KTechlab closed unexpectedly while '%1' had changes that were not saved. Recover the changes?", url.fileName()),
+                                                  i18n("Recover Document"),
+                                                  KGuiItem(i18n("Recover")),
+                                                  KStandardGuiItem::discard());
+    if (answer == KMessageBox::Yes)
+        recoverFrom(recoveryFile);
+    else
+        AutoSave::removeRecoveryFile(recoveryFile);
+}
+
+bool ItemDocument::recoverFrom(const QString &fileName)
+{
+    ItemDocumentData data(type());
+
+    QFile file(fileName);
+    QString errorMessage;
+    if (!file.open(QIODevice::ReadOnly) || !data.loadData(&file, &errorMessage)) {
+        qCWarning(KTL_LOG) << "Could not read the recovery copy" << fileName << errorMessage;
+        return false;
+    }
+    file.close();
+
+    // Removed before opening the data, which would otherwise offer it again
+    AutoSave::removeRecoveryFile(fileName);
+
+    // The copy is always in the binary format, which is not what the
+    // document is to be saved in
+    const bool binaryFormat = m_bBinaryFormat;
+    openData(&data, url());
+    m_bBinaryFormat = binaryFormat;
+
+    // No state of the document is the saved one, so that it stays modified
+    // when its changes are undone
+    m_savedState = m_nextStateNumber++;
+    setModified(true);
     return true;
 }
 
@@ -301,19 +380,69 @@ void ItemDocument::print()
 }
 
 void ItemDocument::requestStateSave(int actionTicket)
+{
+    flushCoalescedStateSave();
+    saveState(actionTicket);
+}
+
+void ItemDocument::requestCoalescedStateSave(const QString &editKey, int actionTicket)
+{
+    // Changes from loading, or from playing back a stimulus, are not edits
+    if (m_bIsLoading || Simulator::self()->stimulusPlayer())
+        return;
+
+    if (editKey != m_coalescedEditKey) {
+        flushCoalescedStateSave();
+        m_coalescedEditKey = editKey;
+        m_coalescedActionTicket = actionTicket;
+    }
+
+    m_pCoalescedStateSaveTimer->start(COALESCED_STATE_SAVE_DELAY);
+}
+
+void ItemDocument::flushCoalescedStateSave()
+{
+    if (m_coalescedEditKey.isEmpty())
+        return;
+
+    const int actionTicket = m_coalescedActionTicket;
+    cancelCoalescedStateSave();
+    saveState(actionTicket);
+}
+
+void ItemDocument::cancelCoalescedStateSave()
+{
+    m_pCoalescedStateSaveTimer->stop();
+    m_coalescedEditKey.clear();
+    m_coalescedActionTicket = -1;
+}
+
+void ItemDocument::saveState(int actionTicket)
 {
     if (m_bIsLoading)
         return;
 
+    StallWatch::Region region("Save undo state", this);
     cleanClearStack(m_redoStack);
 
-    if ((actionTicket >= 0) && (actionTicket == m_currentActionTicket)) {
-        delete m_currentState;
-        m_currentState = nullptr;
+    if ((actionTicket >= 0) && (actionTicket == m_currentActionTicket) && m_currentState) {
+        // Part of the same action as the last state, which is replaced
+        if (m_undoStack.isEmpty()) {
+            delete m_currentState;
+            m_currentState = nullptr;
+        } else {
+            ItemDocumentDelta *previous = m_undoStack.pop();
+            delete previous->apply(m_currentState, m_currentStateNumber);
+            m_currentStateNumber = previous->state();
+            delete previous;
+        }
     }
 
     m_currentActionTicket = actionTicket;
 
+    ItemDocumentData *newState = new ItemDocumentData(type());
+    newState->saveDocumentState(this);
+
     // FIXME: it is possible, that we push something here, also nothing has changed, yet.
     // to reproduce do:
     // 1. select an item -> something is pushed onto undoStack, but nothing changed
@@ -321,47 +450,39 @@ void ItemDocument::requestStateSave(int actionTicket)
     // 3. deselect item -> there is still something on the redoStack
     //
     // this way you can fill up the redoStack, as you like :-/
-    if (m_currentState)
-        m_undoStack.push(m_currentState);
+    if (m_currentState) {
+        m_undoStack.push(new ItemDocumentDelta(*newState, *m_currentState, m_currentStateNumber));
+        delete m_currentState;
+    }
 
-    m_currentState = new ItemDocumentData(type());
-    m_currentState->saveDocumentState(this);
+    m_currentState = newState;
+    m_currentStateNumber = m_nextStateNumber++;
 
-    if (!m_savedState)
-        m_savedState = m_currentState;
+    if (m_savedState < 0)
+        m_savedState = m_currentStateNumber;
 
-    setModified(m_savedState != m_currentState);
+    setModified(m_savedState != m_currentStateNumber);
 
     emit undoRedoStateChanged();
 
-    // FIXME To resize undo queue, have to pop and push everything
-    // In Qt4 QStack is used and QStack inherits QVector, that should
-    // make it a bit more easy
-    int maxUndo = KTLConfig::maxUndo();
-    if (maxUndo <= 0 || m_undoStack.count() < maxUndo)
+    // The oldest changes are at the bottom of the stack
+    const int maxUndo = KTLConfig::maxUndo();
+    if (maxUndo <= 0 || m_undoStack.count() <= maxUndo)
         return;
-    IDDStack tempStack;
-    int pushed = 0;
-    while (!m_undoStack.isEmpty() && pushed < maxUndo) {
-        tempStack.push(m_undoStack.pop());
-        pushed++;
-    }
-    cleanClearStack(m_undoStack);
-    while (!tempStack.isEmpty())
-        m_undoStack.push(tempStack.pop());
+    const int excess = m_undoStack.count() - maxUndo;
+    qDeleteAll(m_undoStack.begin(), m_undoStack.begin() + excess);
+    m_undoStack.remove(0, excess);
 }
 
 void ItemDocument::cleanClearStack(IDDStack &stack)
 {
-    while (!stack.isEmpty()) {
-        ItemDocumentData *idd = stack.pop();
-        if (m_currentState != idd)
-            delete idd;
-    }
+    qDeleteAll(stack);
+    stack.clear();
 }
 
 void ItemDocument::clearHistory()
 {
+    cancelCoalescedStateSave();
     cleanClearStack(m_undoStack);
     cleanClearStack(m_redoStack);
     delete m_currentState;
@@ -369,6 +490,35 @@ void ItemDocument::clearHistory()
     requestStateSave();
 }
 
+MemoryUsage ItemDocument::memoryUsage() const
+{
+    MemoryUsage usage;
+
+    if (m_currentState)
+        usage.bytes[MemoryUsage::UndoHistory] += m_currentState->memoryUsage();
+    for (const ItemDocumentDelta *delta : m_undoStack)
+        usage.bytes[MemoryUsage::UndoHistory] += delta->memoryUsage();
+    for (const ItemDocumentDelta *delta : m_redoStack)
+        usage.bytes[MemoryUsage::UndoHistory] += delta->memoryUsage();
+
+    usage.bytes[MemoryUsage::CanvasChunks] = m_canvas->chunkMemoryUsage();
+    usage.bytes[MemoryUsage::CanvasTiles] = m_canvas->tileCacheMemoryUsage();
+
+    // Items inside subcircuits are kept off the canvas
+    const ItemMap::const_iterator end = m_itemList.constEnd();
+    for (ItemMap::const_iterator it = m_itemList.constBegin(); it != end; ++it) {
+        if (*it && !(*it)->canvas())
+            usage.bytes[MemoryUsage::HiddenSubcircuitItems] += sizeof(Item);
+    }
+
+    return usage;
+}
+
+void ItemDocument::trimCaches()
+{
+    m_canvas->clearTileCache();
+}
+
 bool ItemDocument::isUndoAvailable() const
 {
     return !m_undoStack.isEmpty();
@@ -381,39 +531,40 @@ bool ItemDocument::isRedoAvailable() const
 
 void ItemDocument::undo()
 {
-    if (m_undoStack.empty()) {
+    flushCoalescedStateSave();
+
+    if (m_undoStack.empty() || !m_currentState) {
         return;
     }
-    ItemDocumentData *idd = m_undoStack.pop();
-    if (!idd)
-        return;
-
-    if (m_currentState)
-        m_redoStack.push(m_currentState);
+    ItemDocumentDelta *delta = m_undoStack.pop();
+    m_redoStack.push(delta->apply(m_currentState, m_currentStateNumber));
+    m_currentStateNumber = delta->state();
+    delete delta;
 
-    idd->restoreDocument(this);
-    m_currentState = idd;
+    m_currentState->restoreDocument(this);
+    // Restoring the sliders and switches is not an edit of them
+    cancelCoalescedStateSave();
 
-    setModified(m_savedState != m_currentState);
+    setModified(m_savedState != m_currentStateNumber);
     emit undoRedoStateChanged();
 }
 
 void ItemDocument::redo()
 {
-    if (m_redoStack.empty()) {
+    flushCoalescedStateSave();
+
+    if (m_redoStack.empty() || !m_currentState) {
         return;
     }
-    ItemDocumentData *idd = m_redoStack.pop();
-    if (!idd)
-        return;
-
-    if (m_currentState)
-        m_undoStack.push(m_currentState);
+    ItemDocumentDelta *delta = m_redoStack.pop();
+    m_undoStack.push(delta->apply(m_currentState, m_currentStateNumber));
+    m_currentStateNumber = delta->state();
+    delete delta;
 
-    idd->restoreDocument(this);
-    m_currentState = idd;
+    m_currentState->restoreDocument(this);
+    cancelCoalescedStateSave();
 
-    setModified(m_savedState != m_currentState);
+    setModified(m_savedState != m_currentStateNumber);
     emit undoRedoStateChanged();
 }
 
@@ -425,16 +576,24 @@ void ItemDocument::cut()
 
 void ItemDocument::paste()
 {
-    QString xml = QApplication::clipboard()->text(QClipboard::Clipboard);
-    if (xml.isEmpty())
-        return;
+    ItemDocumentData data(type());
 
-    unselectAll();
+    // What was copied in this process can be taken as it is, without going
+    // through xml
+    const QMimeData *mimeData = QApplication::clipboard()->mimeData(QClipboard::Clipboard);
+    if (const ItemDocumentMimeData *itemMimeData = dynamic_cast<const ItemDocumentMimeData *>(mimeData)) {
+        data = itemMimeData->documentData();
+        unselectAll();
+    } else {
+        QString xml = QApplication::clipboard()->text(QClipboard::Clipboard);
+        if (xml.isEmpty())
+            return;
 
-    ItemDocumentData data(type());
+        unselectAll();
 
-    if (!data.fromXML(xml))
-        return;
+        if (!data.fromXML(xml))
+            return;
+    }
 
     data.generateUniqueIDs(this);
     //	data.translateContents( 64, 64 );
@@ -448,10 +607,7 @@ void ItemDocument::paste()
 
 Item *ItemDocument::itemWithID(const QString &id)
 {
-    if (m_itemList.contains(id))
-        return m_itemList[id];
-    else
-        return nullptr;
+    return dynamic_cast<Item *>(handleItem(idHandle(id)));
 }
 
 void ItemDocument::unselectAll()
@@ -485,7 +641,21 @@ void ItemDocument::unselect(KtlQCanvasItem *qcanvasItem)
 void ItemDocument::slotUpdateConfiguration()
 {
     updateBackground();
-    m_canvas->setUpdatePeriod(int(1000. / KTLConfig::refreshRate()));
+    m_canvas->setUpdatePeriod(int(1000. / frameRate()));
+    m_pAutoSave->setInterval(KTLConfig::autoSaveInterval());
+}
+
+int ItemDocument::frameRate()
+{
+    int rate = qMax(1, KTLConfig::refreshRate());
+
+    // Frames the monitor cannot show would only be drawn for nothing
+    if (QScreen *screen = QGuiApplication::primaryScreen()) {
+        const int screenRate = qRound(screen->refreshRate());
+        if (screenRate > 0)
+            rate = qMin(rate, screenRate);
+    }
+    return rate;
 }
 
 KtlQCanvasItem *ItemDocument::itemAtTop(const QPoint &pos) const
@@ -541,18 +711,55 @@ void ItemDocument::distributeVertically()
 
 bool ItemDocument::registerUID(const QString &UID)
 {
-    return m_idList.insert(UID).second;
+    if (m_idHandles.contains(UID))
+        return false;
+
+    int handle;
+    if (!m_freeHandles.isEmpty())
+        handle = m_freeHandles.takeLast();
+    else {
+        handle = m_handleItems.size();
+        m_handleItems.append(nullptr);
+    }
+    m_idHandles.insert(UID, handle);
+    return true;
 }
 
 void ItemDocument::unregisterUID(const QString &uid)
 {
-    m_idList.erase(uid);
+    const QHash<QString, int>::iterator it = m_idHandles.find(uid);
+    if (it != m_idHandles.end()) {
+        m_handleItems[it.value()] = nullptr;
+        m_freeHandles.append(it.value());
+        m_idHandles.erase(it);
+    }
     m_itemList.remove(uid);
 }
 
+void ItemDocument::setHandleItem(const QString &uid, KtlQCanvasItem *qcanvasItem)
+{
+    int handle = idHandle(uid);
+    if (handle == -1) {
+        registerUID(uid);
+        handle = idHandle(uid);
+    }
+    m_handleItems[handle] = qcanvasItem;
+}
+
+void ItemDocument::unlistItem(const QString &uid)
+{
+    if (Item *item = m_itemList.take(uid)) {
+        const int handle = idHandle(uid);
+        if (handleItem(handle) == item)
+            m_handleItems[handle] = nullptr;
+    }
+}
+
 QString ItemDocument::generateUID(QString name)
 {
-    name.remove(QRegExp("__.*")); // Change 'node__13' to 'node', for example
+    const int suffix = name.indexOf("__");
+    if (suffix != -1)
+        name.truncate(suffix); // Change 'node__13' to 'node', for example
     QString idAttempt = name;
 
     while (!registerUID(idAttempt))
@@ -561,6 +768,37 @@ QString ItemDocument::generateUID(QString name)
     return idAttempt;
 }
 
+QStringList ItemDocument::generateUIDs(const QStringList &names)
+{
+    QStringList ids;
+    ids.reserve(names.size());
+
+    // Consecutive names often have the same base (e.g. many pasted
+    // resistors), in which case the base is already known to be taken
+    QString lastBase;
+
+    for (const QString &name : names) {
+        const int suffix = name.indexOf("__");
+        const QString base = (suffix == -1) ? name : name.left(suffix);
+
+        if (ids.isEmpty() || base != lastBase) {
+            lastBase = base;
+            if (registerUID(base)) {
+                ids << base;
+                continue;
+            }
+        }
+
+        QString idAttempt;
+        do
+            idAttempt = base + "__" + QString::number(m_nextIdNum++);
+        while (!registerUID(idAttempt));
+        ids << idAttempt;
+    }
+
+    return ids;
+}
+
 // FIXME: popup menu doesn't seem to work these days. =(
 void ItemDocument::canvasRightClick(const QPoint &pos, KtlQCanvasItem *item)
 {
@@ -672,14 +910,54 @@ void ItemDocument::requestCanvasResize()
     requestEvent(ItemDocumentEvent::ResizeCanvasToItems);
 }
 
+void ItemDocument::setHeadless(bool headless)
+{
+    m_canvas->setHeadless(headless);
+}
+
+bool ItemDocument::isHeadless() const
+{
+    return m_canvas->isHeadless();
+}
+
 void ItemDocument::requestEvent(ItemDocumentEvent::type type)
 {
+    // These only matter for showing the document
+    if (isHeadless())
+        return;
+
     m_queuedEvents |= type;
+    if (m_bulkLoadDepth > 0)
+        return;
+
     m_pEventTimer->stop();
     m_pEventTimer->setSingleShot(true);
     m_pEventTimer->start(0 /*, true */);
 }
 
+void ItemDocument::beginBulkLoad()
+{
+    // The events already waiting are done along with the rest at the end
+    if (m_bulkLoadDepth++ == 0)
+        m_pEventTimer->stop();
+}
+
+void ItemDocument::endBulkLoad()
+{
+    if (--m_bulkLoadDepth > 0)
+        return;
+
+    // The items loaded may well have changed how many there are in a chunk
+    if (!isHeadless())
+        canvas()->adaptChunkSize();
+
+    if (m_queuedEvents) {
+        m_pEventTimer->setSingleShot(true);
+        m_pEventTimer->start(0 /*, true */);
+    }
+    bulkLoadFinished();
+}
+
 void ItemDocument::processItemDocumentEvents()
 {
     // Copy it in case we have new events requested while doing this...
@@ -832,97 +1110,27 @@ void ItemDocument::exportToImage()
     }
 
     const bool crop = exportDialog.isCropSelected();
-    // with Qt, you always "print" to a
-    // QPainter.. whether the output medium is a pixmap, a screen,
-    // or paper
-
-    // needs to be something like QPicture to do SVG etc...
-
-    QRect saveArea;
-    QRect cropArea;
-    QPaintDevice *outputImage;
     const QString type = exportDialog.formatType();
 
-    // did have a switch here but seems you can't use that on strings
-    if (type == "SVG") {
-        KMessageBox::information(nullptr, i18n("SVG export is sub-functional"), i18n("Export As Image"));
-    }
-
+    QRect saveArea = m_canvas->rect();
     if (crop) {
-        cropArea = canvasBoundingRect();
-        if (cropArea.isNull()) {
+        saveArea = canvasBoundingRect();
+        if (saveArea.isNull()) {
             KMessageBox::error(nullptr, i18n("There is nothing to crop"), i18n("Export As Image"));
             return;
         } else {
-            cropArea &= canvas()->rect();
+            saveArea &= canvas()->rect();
         }
     }
 
-    saveArea = m_canvas->rect();
-
-    if (type == "PNG" || type == "BMP")
-        outputImage = new QPixmap(saveArea.size());
-    else if (type == "SVG") {
-        setSVGExport(true);
-        outputImage = new QPicture();
-        // svg can't be cropped using the qimage method.
-        saveArea = cropArea;
-    } else {
-        qCWarning(KTL_LOG) << "Unknown type!";
-        return;
-    }
-
-    // 2018.05.05 - extract to a method
-    // 	//QPainter p(outputImage); // 2016.05.03 - explicitly initialize painter
-    // 	QPainter p;
-    //     const bool isBeginSuccess = p.begin(outputImage);
-    //     if (!isBeginSuccess) {
-    //         qCWarning(KTL_LOG) << " painter not active";
-    //     }
-    //
-    // 	m_canvas->setBackgroundPixmap(QPixmap());
-    // 	m_canvas->drawArea( saveArea, &p );
-    // 	updateBackground();
-    //
-    // 	p.end();
-    exportToImageDraw(saveArea, *outputImage);
-
-    bool saveResult;
-
-    // if cropping we need to convert to an image,
-    // crop, then save.
-    if (crop) {
-        if (type == "SVG")
-            saveResult = dynamic_cast<QPicture *>(outputImage)->save(filePath, type.toLatin1().data());
-        else {
-            QImage img = dynamic_cast<QPixmap *>(outputImage)->toImage();
-            if (saveArea.x() < 0) {
-                cropArea.translate(-saveArea.x(), 0);
-            }
-            if (saveArea.y() < 0) {
-                cropArea.translate(0, -saveArea.y());
-            }
-            qCDebug(KTL_LOG) << " cropArea " << cropArea;
-            QImage imgCropped = img.copy(cropArea);
-            saveResult = imgCropped.save(filePath, type.toLatin1().data());
-        }
-    } else {
-        if (type == "SVG")
-            saveResult = dynamic_cast<QPicture *>(outputImage)->save(filePath, type.toLatin1().data());
-        else
-            saveResult = dynamic_cast<QPixmap *>(outputImage)->save(filePath, type.toLatin1().data());
-    }
-
-    // if(saveResult == true)	KMessageBox::information( this, i18n("Successfully exported to \"%1\"", url.filename() ), i18n("Image Export") );
-    // else KMessageBox::information( this, i18n("Export failed"), i18n("Image Export") );
-
-    if (type == "SVG")
-        setSVGExport(false);
+    // The image is written out a part at a time, so that large canvases can
+    // be exported at a high scale without holding the whole image
+    const bool isBitmap = (type == "PNG" || type == "BMP");
+    ImageExporter exporter(this, saveArea, isBitmap ? exportDialog.scale() : 1.0);
+    const bool saveResult = exporter.save(filePath, type);
 
     if (saveResult == false)
         KMessageBox::information(KTechlab::self(), i18n("Export failed"), i18n("Image Export"));
-
-    delete outputImage;
 }
 
 void ItemDocument::exportToImageDraw(const QRect &saveArea, QPaintDevice &pDev)
@@ -1279,6 +1487,8 @@ void Canvas::drawForeground(QPainter &p, const QRect &clip)
 {
     KtlQCanvas::drawForeground(p, clip);
 
+    p_itemDocument->drawOverlay(p, clip);
+
     if (!m_pMessageTimeout->isActive())
         return;
 
@@ -1340,7 +1550,11 @@ void Canvas::drawForeground(QPainter &p, const QRect &clip)
 
 void Canvas::update()
 {
-    p_itemDocument->update();
+    {
+        // The document publishes what is drawn of the simulation
+        SimulationLocker locker;
+        p_itemDocument->update();
+    }
     KtlQCanvas::update();
 }
 // END class Canvas
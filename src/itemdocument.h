@@ -12,14 +12,18 @@
 #define ITEMDOCUMENT_H
 
 #include "canvasitems.h"
+#include "memoryusage.h"
 #include <canvas.h>
 #include <document.h>
-#include <set>
 
+#include <QHash>
 #include <QMap>
 #include <QStack>
+#include <QStringList>
+#include <QVector>
 // #include <q3valuevector.h>
 
+class AutoSave;
 class Canvas;
 class CanvasTip;
 class Connector;
@@ -27,14 +31,16 @@ class CMManager;
 class ECNode;
 class Item;
 class ItemDocumentData;
+class ItemDocumentDelta;
 class ItemGroup;
 class KTechlab;
+class StimulusRecorder;
 class Operation;
 
 class KActionMenu;
 class KtlQCanvasItem;
 
-typedef QStack<ItemDocumentData *> IDDStack;
+typedef QStack<ItemDocumentDelta *> IDDStack;
 typedef QPointer<Item> GuardedItem;
 typedef QMap<int, GuardedItem> IntItemMap;
 typedef QMap<QString, Item *> ItemMap;
@@ -49,6 +55,8 @@ class ItemDocument : public Document
     Q_OBJECT
 
     friend class KtlTestsAppFixture;
+    friend class ImageExporter;
+    friend class AutoSave;
 
 public:
     ItemDocument(const QString &caption);
@@ -87,6 +95,18 @@ public:
     void fileSaveAs() override;
     void print() override;
     bool openURL(const QUrl &url) override;
+    /**
+     * Opens the document from data already read from url (such as by
+     * DocManager::preloadURLs).
+     */
+    void openData(ItemDocumentData *data, const QUrl &url);
+    /**
+     * Replaces the contents of the document with the recovery copy in
+     * fileName (see AutoSave), which is then removed. The document is left
+     * modified, with its url (if any) unchanged.
+     * @return false if the copy could not be read
+     */
+    bool recoverFrom(const QString &fileName);
     /**
      * Attempt to register the item, returning true iff successful
      */
@@ -114,11 +134,27 @@ public:
      * Generates a unique id based on a possibly unique component name.
      */
     QString generateUID(QString name);
+    /**
+     * Like generateUID, for many names at once (such as everything being
+     * pasted), which is quicker than calling generateUID for each.
+     * @return the ids, in the same order as names
+     */
+    QStringList generateUIDs(const QStringList &names);
     /**
      * Unlists the given id as one that is used.
      * @see registerUID
      */
     virtual void unregisterUID(const QString &uid);
+    /**
+     * Each registered id is given a small integer handle, which is used to
+     * find what has the id without searching through the lists by string.
+     * Handles of unregistered ids are given to new ones.
+     * @return the handle of the id, or -1 if it is not registered
+     */
+    int idHandle(const QString &uid) const
+    {
+        return m_idHandles.value(uid, -1);
+    }
     /**
      * @return Whether or not the item is valid; i.e. is appropriate to the
      * document being edited, and does not have other special restrictions
@@ -175,6 +211,15 @@ public:
      * or nullptr if no such Item exists.
      */
     Item *itemWithID(const QString &);
+    /**
+     * @return what the changes the user makes to the buttons, sliders and
+     * properties of the items are recorded with, or nullptr if they are not
+     * being recorded
+     */
+    StimulusRecorder *stimulusRecorder() const
+    {
+        return m_pStimulusRecorder;
+    }
     /**
      * Returns true if the user can perform an undo action
      * (i.e. the undo stack is not empty)
@@ -211,19 +256,76 @@ public:
      * @see getActionTicket
      */
     void requestStateSave(int actionTicket = -1);
+    /**
+     * Save the state of the document once a continuous edit (such as
+     * dragging a slider or holding down the arrow of a spin box) has
+     * finished, instead of for each step of it. Consecutive requests with
+     * the same editKey are merged until none has come for a short while;
+     * any other state save, undo or redo finishes the edit first.
+     * @param editKey the kind of edit and the items it is of, e.g.
+     * "slider:" followed by the ids of the item and of its slider.
+     * @param actionTicket passed on to requestStateSave at the end.
+     */
+    void requestCoalescedStateSave(const QString &editKey, int actionTicket = -1);
+    /**
+     * Saves the state for a pending continuous edit now, if there is one.
+     * @see requestCoalescedStateSave
+     */
+    void flushCoalescedStateSave();
 
     /**
      * Clears the undo / redo history
      */
     void clearHistory();
+    /**
+     * @return an estimate of the memory that the document is using, by
+     * subsystem.
+     */
+    virtual MemoryUsage memoryUsage() const;
+    /**
+     * Frees what the document only keeps to save redoing work, such as the
+     * rendered tiles of the canvas; it is made again as it is next needed.
+     */
+    virtual void trimCaches();
     /**
      * Requests an event to be done after other stuff (editing, etc) is finished.
      */
     void requestEvent(ItemDocumentEvent::type type);
+    /**
+     * Starts adding lots of things at once (such as when restoring the
+     * document). Until the matching endBulkLoad, the events requested (and
+     * the circuits to be assigned, for circuits) are only collected, and are
+     * done once at the end. These can be nested.
+     * @see ItemDocumentBulkLoad
+     */
+    void beginBulkLoad();
+    void endBulkLoad();
+    bool isBulkLoading() const
+    {
+        return m_bulkLoadDepth > 0;
+    }
+    /**
+     * Makes the document one that is only simulated (as by ktechlab-batch),
+     * so that what is only needed to show and edit it is skipped: its items
+     * are kept out of the chunks of the canvas, connectors are neither drawn
+     * nor routed, and the canvas is not resized or reordered. Set this before
+     * opening the document, and do not give it any views.
+     */
+    void setHeadless(bool headless);
+    bool isHeadless() const;
     /**
      * Called from Canvas (when KtlQCanvas::advance is called).
      */
     virtual void update();
+    /**
+     * Called from Canvas after drawing the items, to draw anything that goes
+     * over them.
+     */
+    virtual void drawOverlay(QPainter &p, const QRect &clip)
+    {
+        Q_UNUSED(p);
+        Q_UNUSED(clip);
+    }
 
     /**
      * Returns a unique id, for use in requestStateSave
@@ -319,6 +421,11 @@ public slots:
      * their configuration.
      */
     void slotUpdateConfiguration() override;
+    /**
+     * @return the number of times a second that the canvas is updated: the
+     * refresh rate from the settings, but no faster than the monitor.
+     */
+    static int frameRate();
     /**
      * Enables / disables / selects various actions depending on
      * what is selected or not.
@@ -347,6 +454,31 @@ protected:
      * Called from registerItem when a new item is added.
      */
     virtual void itemAdded(Item *item);
+    /**
+     * Records qcanvasItem as what has the given id, for handleItem. The id is
+     * registered if it is not already.
+     */
+    void setHandleItem(const QString &uid, KtlQCanvasItem *qcanvasItem);
+    /**
+     * @return what was recorded with setHandleItem for the id with the
+     * given handle, or nullptr if there is nothing
+     */
+    KtlQCanvasItem *handleItem(int handle) const
+    {
+        return (handle >= 0 && handle < m_handleItems.size()) ? m_handleItems[handle] : nullptr;
+    }
+    /**
+     * Removes the item with the given id from the item list, for when it is
+     * about to be deleted.
+     */
+    void unlistItem(const QString &uid);
+    /**
+     * Called at the end of the outermost bulk load, for doing what was held
+     * back during it.
+     */
+    virtual void bulkLoadFinished()
+    {
+    }
     void handleNewView(View *view) override;
     /**
      * Set to true to remove buttons and grid and so on from the canvas, set false to put them back
@@ -383,9 +515,18 @@ protected:
 
 private:
     /**
-     * This clears a given stack and deletes all pointers, but the one to m_currentState.
+     * This clears a given stack and deletes the deltas in it.
      */
     void cleanClearStack(IDDStack &stack);
+    /**
+     * Does the work of requestStateSave, without finishing a pending
+     * continuous edit first.
+     */
+    void saveState(int actionTicket);
+    /**
+     * Forgets a pending continuous edit without saving the state for it.
+     */
+    void cancelCoalescedStateSave();
 
     static int m_nextActionTicket;
 
@@ -393,18 +534,29 @@ private:
     unsigned m_nextIdNum;
     int m_currentActionTicket;
     bool m_bIsLoading;
+    int m_bulkLoadDepth;
+    bool m_bBinaryFormat; // Whether the file was opened from the binary format, which it is saved in again
 
-    ItemDocumentData *m_currentState;
-    ItemDocumentData *m_savedState; // Pointer to the document data that holds the state when it saved
+    ItemDocumentData *m_currentState; // The undo / redo stacks hold the changes from this
+    int m_currentStateNumber;
+    int m_nextStateNumber;
+    int m_savedState; // Number of the state when the document was saved, or -1
 
     KActionMenu *m_pAlignmentAction;
 
     IntItemMap m_zOrder;
 
-    std::set<QString> m_idList; // used to ensure unique IDs to try to make sure save files are valid.
+    QHash<QString, int> m_idHandles; // used to ensure unique IDs to try to make sure save files are valid.
+    QVector<KtlQCanvasItem *> m_handleItems; // Indexed by id handle
+    QVector<int> m_freeHandles;
 
     QTimer *m_pEventTimer;
     QTimer *m_pUpdateItemViewScrollbarsTimer;
+    QTimer *m_pCoalescedStateSaveTimer;
+    QString m_coalescedEditKey; // Of the pending continuous edit, or empty
+    int m_coalescedActionTicket;
+    AutoSave *m_pAutoSave;
+    StimulusRecorder *m_pStimulusRecorder;
 
     IDDStack m_undoStack;
     IDDStack m_redoStack;
@@ -413,6 +565,27 @@ private:
     friend class ItemView;
 };
 
+/**
+Keeps an ItemDocument in a bulk load while in scope.
+@see ItemDocument::beginBulkLoad
+*/
+class ItemDocumentBulkLoad
+{
+public:
+    explicit ItemDocumentBulkLoad(ItemDocument *itemDocument)
+        : m_pItemDocument(itemDocument)
+    {
+        m_pItemDocument->beginBulkLoad();
+    }
+    ~ItemDocumentBulkLoad()
+    {
+        m_pItemDocument->endBulkLoad();
+    }
+
+protected:
+    ItemDocument *m_pItemDocument;
+};
+
 /**
 @author David Saxton
 */
@@ -10,6 +10,7 @@
 
 #include "itemdocumentdata.h"
 #include "connector.h"
+#include "ecnode.h"
 #include "ecsubcircuit.h"
 #include "electronicconnector.h"
 #include "flowcodedocument.h"
@@ -19,7 +20,10 @@
 #include "junctionflownode.h"
 #include "junctionnode.h"
 #include "picitem.h"
+#include "pin.h"
 #include "pinmapping.h"
+#include "simulator.h"
+#include "wire.h"
 
 #include <KIO/FileCopyJob>
 #include <KJobWidgets>
@@ -27,11 +31,19 @@
 #include <KMessageBox>
 
 #include <QBitArray>
+#include <QDataStream>
 #include <QFile>
+#include <QHash>
+#include <QLocale>
 #include <QScopedPointer>
 #include <QTemporaryFile>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+#include <algorithm>
 
 #include <ktechlab_debug.h>
+#include <ktlconfig.h>
 
 // Converts the QBitArray into a string (e.g. "F289A9E") that can be stored in an xml file
 static QString toAsciiHex(QBitArray _data)
@@ -78,6 +90,7 @@ ItemDocumentData::ItemDocumentData(uint documentType)
 {
     reset();
     m_documentType = documentType;
+    m_bBinaryFormat = false;
 }
 
 ItemDocumentData::~ItemDocumentData()
@@ -89,6 +102,7 @@ void ItemDocumentData::reset()
     m_itemDataMap.clear();
     m_connectorDataMap.clear();
     m_nodeDataMap.clear();
+    m_routeSection = QByteArray();
     m_microData.reset();
     m_documentType = Document::dt_none;
 }
@@ -115,59 +129,77 @@ bool ItemDocumentData::loadData(const QUrl &url)
         file.reset(localFile.take());
     }
 
-    QString xml;
-    QTextStream textStream(file.data());
-    while (!textStream.atEnd() /* eof() */)
-        xml += textStream.readLine() + '\n';
+    QString errorMessage;
+    if (!loadData(file.data(), &errorMessage)) {
+        KMessageBox::error(nullptr, errorMessage);
+        return false;
+    }
+    return true;
+}
 
-    return fromXML(xml);
+bool ItemDocumentData::loadData(QIODevice *device, QString *errorMessage)
+{
+    m_bBinaryFormat = (device->peek(4) == QByteArray("KTLB"));
+    if (m_bBinaryFormat)
+        return readBinary(device, errorMessage);
+
+    QXmlStreamReader reader(device);
+    return readXML(reader, errorMessage);
 }
 
 bool ItemDocumentData::fromXML(const QString &xml)
 {
-    reset();
-
-    QDomDocument doc("KTechlab");
+    QXmlStreamReader reader(xml);
     QString errorMessage;
-    if (!doc.setContent(xml, &errorMessage)) {
-        KMessageBox::error(nullptr, i18n("Could not parse XML:\n%1", errorMessage));
+    if (!readXML(reader, &errorMessage)) {
+        KMessageBox::error(nullptr, errorMessage);
         return false;
     }
+    return true;
+}
 
-    QDomElement root = doc.documentElement();
+bool ItemDocumentData::readXML(QXmlStreamReader &reader, QString *errorMessage)
+{
+    reset();
 
-    QDomNode node = root.firstChild();
-    while (!node.isNull()) {
-        QDomElement element = node.toElement();
-        if (!element.isNull()) {
-            const QString tagName = element.tagName();
+    // The elements are read as they come, so the document is never held in
+    // memory other than as the data maps
+    if (reader.readNextStartElement()) {
+        while (reader.readNextStartElement()) {
+            const QStringRef tagName = reader.name();
 
-            if (tagName == "item")
-                elementToItemData(element);
+            if (tagName == QLatin1String("item"))
+                readItemData(reader);
 
-            else if (tagName == "node")
-                elementToNodeData(element);
+            else if (tagName == QLatin1String("node"))
+                readNodeData(reader);
 
-            else if (tagName == "connector")
-                elementToConnectorData(element);
+            else if (tagName == QLatin1String("connector"))
+                readConnectorData(reader);
 
-            else if (tagName == "pic-settings" || tagName == "micro")
-                elementToMicroData(element);
+            else if (tagName == QLatin1String("pic-settings") || tagName == QLatin1String("micro"))
+                readMicroData(reader);
 
-            else if (tagName == "code")
-                ; // do nothing - we no longer use this tag
+            else if (tagName == QLatin1String("code"))
+                reader.skipCurrentElement(); // do nothing - we no longer use this tag
 
-            else
+            else {
                 qCWarning(KTL_LOG) << "Unrecognised element tag name: " << tagName;
+                reader.skipCurrentElement();
+            }
         }
+    }
 
-        node = node.nextSibling();
+    if (reader.hasError()) {
+        *errorMessage = i18n("Could not parse XML:\n%1", reader.errorString());
+        reset();
+        return false;
     }
 
     return true;
 }
 
-bool ItemDocumentData::saveData(const QUrl &url)
+bool ItemDocumentData::saveData(const QUrl &url, bool binary)
 {
     if (url.isLocalFile()) {
         QFile file(url.toLocalFile());
@@ -176,17 +208,22 @@ bool ItemDocumentData::saveData(const QUrl &url)
             return false;
         }
 
-        QTextStream stream(&file);
-        stream << toXML();
+        const bool written = saveData(&file, binary);
         file.close();
+        if (!written) {
+            KMessageBox::error(nullptr, i18n("Could not write '%1'", file.fileName()), i18n("Saving File"));
+            return false;
+        }
     } else {
         QTemporaryFile file;
         if (!file.open()) {
             KMessageBox::error(nullptr, file.errorString());
             return false;
         }
-        QTextStream str(&file);
-        str << toXML();
+        if (!saveData(&file, binary)) {
+            KMessageBox::error(nullptr, file.errorString());
+            return false;
+        }
         file.close();
 
         KIO::FileCopyJob *job = KIO::file_copy(QUrl::fromLocalFile(file.fileName()), url);
@@ -200,58 +237,386 @@ bool ItemDocumentData::saveData(const QUrl &url)
     return true;
 }
 
+bool ItemDocumentData::saveData(QIODevice *device, bool binary)
+{
+    if (binary)
+        return writeBinary(device);
+
+    QXmlStreamWriter writer(device);
+    writeXML(writer);
+    return !writer.hasError();
+}
+
 QString ItemDocumentData::toXML()
 {
-    QDomDocument doc("KTechlab");
+    QString xml;
+    QXmlStreamWriter writer(&xml);
+    writeXML(writer);
+    return xml;
+}
+
+void ItemDocumentData::writeXML(QXmlStreamWriter &writer)
+{
     // TODO Add revision information to save file
+    loadRoutes();
 
-    QDomElement root = doc.createElement("document");
-    root.setAttribute("type", documentTypeString());
-    doc.appendChild(root);
+    // Laid out as QDomDocument used to write it
+    writer.setAutoFormatting(true);
+    writer.setAutoFormattingIndent(1);
+    writer.writeDTD("<!DOCTYPE KTechlab>");
+
+    writer.writeStartElement("document");
+    writer.writeAttribute("type", documentTypeString());
 
     {
         const ItemDataMap::iterator end = m_itemDataMap.end();
-        for (ItemDataMap::iterator it = m_itemDataMap.begin(); it != end; ++it) {
-            QDomElement node = itemDataToElement(doc, it.value());
-            node.setAttribute("id", it.key());
-            root.appendChild(node);
-        }
+        for (ItemDataMap::iterator it = m_itemDataMap.begin(); it != end; ++it)
+            writeItemData(writer, it.key(), it.value());
     }
     {
         const ConnectorDataMap::iterator end = m_connectorDataMap.end();
-        for (ConnectorDataMap::iterator it = m_connectorDataMap.begin(); it != end; ++it) {
-            QDomElement node = connectorDataToElement(doc, it.value());
-            node.setAttribute("id", it.key());
-            root.appendChild(node);
-        }
+        for (ConnectorDataMap::iterator it = m_connectorDataMap.begin(); it != end; ++it)
+            writeConnectorData(writer, it.key(), it.value());
     }
     {
         const NodeDataMap::iterator end = m_nodeDataMap.end();
-        for (NodeDataMap::iterator it = m_nodeDataMap.begin(); it != end; ++it) {
-            QDomElement node = nodeDataToElement(doc, it.value());
-            node.setAttribute("id", it.key());
-            root.appendChild(node);
+        for (NodeDataMap::iterator it = m_nodeDataMap.begin(); it != end; ++it)
+            writeNodeData(writer, it.key(), it.value());
+    }
+    if (m_documentType == Document::dt_flowcode)
+        writeMicroData(writer);
+
+    writer.writeEndElement();
+    writer.writeEndDocument();
+}
+
+// BEGIN binary format
+/*
+ * The binary format is a header, an index of the sections, and then the
+ * sections (each written with its own QDataStream, so that sections that
+ * are not known can be skipped):
+ *   quint32 magic, quint16 version, quint32 document type, quint32 section count
+ *   for each section: quint32 id, quint64 offset (from the start), quint64 size
+ */
+static const quint32 BinaryMagic = 0x4b544c42; // "KTLB"
+static const quint16 BinaryVersion = 1;
+static const QDataStream::Version BinaryStreamVersion = QDataStream::Qt_5_12;
+
+enum BinarySection { ItemSection = 1, NodeSection = 2, ConnectorSection = 3, RouteSection = 4, MicroSection = 5 };
+
+static QDataStream &operator<<(QDataStream &stream, const ItemData &itemData)
+{
+    return stream << itemData.type << itemData.x << itemData.y << qint32(itemData.z) << itemData.size << itemData.setSize << qint32(itemData.orientation) << itemData.angleDegrees << itemData.flipped << itemData.buttonMap
+                  << itemData.sliderMap << itemData.parentId << itemData.dataBool << itemData.dataNumber << itemData.dataColor << itemData.dataString << itemData.dataRaw;
+}
+
+static QDataStream &operator>>(QDataStream &stream, ItemData &itemData)
+{
+    qint32 z;
+    qint32 orientation;
+    stream >> itemData.type >> itemData.x >> itemData.y >> z >> itemData.size >> itemData.setSize >> orientation >> itemData.angleDegrees >> itemData.flipped >> itemData.buttonMap >> itemData.sliderMap >> itemData.parentId >>
+        itemData.dataBool >> itemData.dataNumber >> itemData.dataColor >> itemData.dataString >> itemData.dataRaw;
+    itemData.z = z;
+    itemData.orientation = orientation;
+    return stream;
+}
+
+static QDataStream &operator<<(QDataStream &stream, const NodeData &nodeData)
+{
+    return stream << nodeData.x << nodeData.y;
+}
+
+static QDataStream &operator>>(QDataStream &stream, NodeData &nodeData)
+{
+    return stream >> nodeData.x >> nodeData.y;
+}
+
+/// Everything but the route, which goes in its own section
+static QDataStream &operator<<(QDataStream &stream, const ConnectorData &connectorData)
+{
+    return stream << connectorData.manualRoute << connectorData.startNodeIsChild << connectorData.endNodeIsChild << connectorData.startNodeCId << connectorData.endNodeCId << connectorData.startNodeParent << connectorData.endNodeParent
+                  << connectorData.startNodeId << connectorData.endNodeId;
+}
+
+static QDataStream &operator>>(QDataStream &stream, ConnectorData &connectorData)
+{
+    return stream >> connectorData.manualRoute >> connectorData.startNodeIsChild >> connectorData.endNodeIsChild >> connectorData.startNodeCId >> connectorData.endNodeCId >> connectorData.startNodeParent >> connectorData.endNodeParent >>
+        connectorData.startNodeId >> connectorData.endNodeId;
+}
+
+/**
+ * Writes the entries of map, after how many there are.
+ */
+template<typename Map> static QByteArray mapSection(const Map &map)
+{
+    QByteArray bytes;
+    QDataStream stream(&bytes, QIODevice::WriteOnly);
+    stream.setVersion(BinaryStreamVersion);
+
+    stream << quint32(map.size());
+    const typename Map::const_iterator end = map.constEnd();
+    for (typename Map::const_iterator it = map.constBegin(); it != end; ++it)
+        stream << it.key() << it.value();
+    return bytes;
+}
+
+/**
+ * Reads the entries written by mapSection into map.
+ * @return false if the section is not complete
+ */
+template<typename Map> static bool readMapSection(const QByteArray &bytes, Map *map)
+{
+    QDataStream stream(bytes);
+    stream.setVersion(BinaryStreamVersion);
+
+    quint32 count = 0;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString id;
+        typename Map::mapped_type value;
+        stream >> id >> value;
+        map->insert(id, value);
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+bool ItemDocumentData::readBinary(QIODevice *device, QString *errorMessage)
+{
+    reset();
+
+    QDataStream stream(device);
+    stream.setVersion(BinaryStreamVersion);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint32 documentType = 0;
+    quint32 sectionCount = 0;
+    stream >> magic >> version >> documentType >> sectionCount;
+
+    if (stream.status() != QDataStream::Ok || magic != BinaryMagic) {
+        *errorMessage = i18n("The file is not a valid KTechlab document.");
+        return false;
+    }
+    if (version > BinaryVersion) {
+        *errorMessage = i18n("The file was saved by a newer version of KTechlab, and cannot be opened.");
+        return false;
+    }
+
+    QList<quint32> ids;
+    QList<quint64> offsets;
+    QList<quint64> sizes;
+    for (quint32 i = 0; i < sectionCount && stream.status() == QDataStream::Ok; ++i) {
+        quint32 id;
+        quint64 offset;
+        quint64 size;
+        stream >> id >> offset >> size;
+        ids << id;
+        offsets << offset;
+        sizes << size;
+    }
+
+    bool ok = (stream.status() == QDataStream::Ok);
+    for (int i = 0; i < ids.size() && ok; ++i) {
+        if (!device->seek(offsets[i])) {
+            ok = false;
+            break;
+        }
+        const QByteArray bytes = device->read(sizes[i]);
+        if (quint64(bytes.size()) != sizes[i]) {
+            ok = false;
+            break;
+        }
+
+        switch (ids[i]) {
+        case ItemSection:
+            ok = readMapSection(bytes, &m_itemDataMap);
+            break;
+
+        case NodeSection:
+            ok = readMapSection(bytes, &m_nodeDataMap);
+            break;
+
+        case ConnectorSection:
+            ok = readMapSection(bytes, &m_connectorDataMap);
+            break;
+
+        case RouteSection:
+            // Left as it is until the routes are needed
+            m_routeSection = bytes;
+            break;
+
+        case MicroSection:
+            ok = readMicroSection(bytes);
+            break;
+
+        default:
+            qCWarning(KTL_LOG) << "Unrecognised section " << ids[i];
+            break;
         }
     }
+
+    if (!ok) {
+        *errorMessage = i18n("The file is damaged, and could not be read.");
+        reset();
+        return false;
+    }
+
+    return true;
+}
+
+bool ItemDocumentData::writeBinary(QIODevice *device)
+{
+    QList<quint32> ids;
+    QList<QByteArray> sections;
+
+    ids << ItemSection << NodeSection << ConnectorSection << RouteSection;
+    sections << mapSection(m_itemDataMap) << mapSection(m_nodeDataMap) << mapSection(m_connectorDataMap) << routeSection();
+
     if (m_documentType == Document::dt_flowcode) {
-        QDomElement node = microDataToElement(doc);
-        root.appendChild(node);
+        ids << MicroSection;
+        sections << microSection();
+    }
+
+    QDataStream stream(device);
+    stream.setVersion(BinaryStreamVersion);
+
+    stream << BinaryMagic << BinaryVersion << quint32(m_documentType) << quint32(ids.size());
+
+    // The header, the index (an id and two offsets per section), and then
+    // the sections in order
+    quint64 offset = sizeof(quint32) * 3 + sizeof(quint16) + quint64(ids.size()) * (sizeof(quint32) + 2 * sizeof(quint64));
+    for (int i = 0; i < ids.size(); ++i) {
+        stream << ids[i] << offset << quint64(sections[i].size());
+        offset += sections[i].size();
+    }
+    for (int i = 0; i < sections.size(); ++i)
+        stream.writeRawData(sections[i].constData(), sections[i].size());
+
+    return stream.status() == QDataStream::Ok;
+}
+
+QByteArray ItemDocumentData::routeSection() const
+{
+    // The routes have not been touched since they were read
+    if (!m_routeSection.isNull())
+        return m_routeSection;
+
+    QByteArray bytes;
+    QDataStream stream(&bytes, QIODevice::WriteOnly);
+    stream.setVersion(BinaryStreamVersion);
+
+    stream << quint32(m_connectorDataMap.size());
+    const ConnectorDataMap::const_iterator end = m_connectorDataMap.constEnd();
+    for (ConnectorDataMap::const_iterator it = m_connectorDataMap.constBegin(); it != end; ++it)
+        stream << it.key() << it.value().route;
+    return bytes;
+}
+
+void ItemDocumentData::loadRoutes()
+{
+    if (m_routeSection.isNull())
+        return;
+
+    QDataStream stream(m_routeSection);
+    stream.setVersion(BinaryStreamVersion);
+
+    quint32 count = 0;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString id;
+        QPointList route;
+        stream >> id >> route;
+
+        ConnectorDataMap::iterator connector = m_connectorDataMap.find(id);
+        if (connector != m_connectorDataMap.end())
+            connector.value().route = route;
+    }
+
+    if (stream.status() != QDataStream::Ok)
+        qCWarning(KTL_LOG) << "Could not read all of the connector routes";
+
+    m_routeSection = QByteArray();
+}
+
+QByteArray ItemDocumentData::microSection() const
+{
+    QByteArray bytes;
+    QDataStream stream(&bytes, QIODevice::WriteOnly);
+    stream.setVersion(BinaryStreamVersion);
+
+    stream << m_microData.id << quint32(m_microData.pinMappings.size());
+    const PinMappingMap::const_iterator mappingEnd = m_microData.pinMappings.constEnd();
+    for (PinMappingMap::const_iterator it = m_microData.pinMappings.constBegin(); it != mappingEnd; ++it)
+        stream << it.key() << qint32(it.value().type()) << it.value().pins();
+
+    stream << quint32(m_microData.pinMap.size());
+    const PinDataMap::const_iterator pinEnd = m_microData.pinMap.constEnd();
+    for (PinDataMap::const_iterator it = m_microData.pinMap.constBegin(); it != pinEnd; ++it)
+        stream << it.key() << qint32(it.value().type) << qint32(it.value().state);
+
+    stream << m_microData.variableMap;
+    return bytes;
+}
+
+bool ItemDocumentData::readMicroSection(const QByteArray &bytes)
+{
+    QDataStream stream(bytes);
+    stream.setVersion(BinaryStreamVersion);
+
+    m_microData.reset();
+
+    quint32 count = 0;
+    stream >> m_microData.id >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString id;
+        qint32 type;
+        QStringList pins;
+        stream >> id >> type >> pins;
+
+        PinMapping pinMapping(PinMapping::Type(type));
+        pinMapping.setPins(pins);
+        m_microData.pinMappings[id] = pinMapping;
+    }
+
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString id;
+        qint32 type;
+        qint32 state;
+        stream >> id >> type >> state;
+
+        m_microData.pinMap[id].type = PinSettings::pin_type(type);
+        m_microData.pinMap[id].state = PinSettings::pin_state(state);
     }
 
-    return doc.toString();
+    stream >> m_microData.variableMap;
+    return stream.status() == QDataStream::Ok;
+}
+// END binary format
+
+// BEGIN functions for writing / reading xml elements
+/**
+ * @return the value of the attribute, or defaultValue if it is not there
+ * (as QDomElement::attribute).
+ */
+static QString attribute(const QXmlStreamAttributes &attributes, const QString &name, const QString &defaultValue = QString())
+{
+    return attributes.hasAttribute(name) ? attributes.value(name).toString() : defaultValue;
 }
 
-// BEGIN functions for generating / reading QDomElements
-QDomElement ItemDocumentData::microDataToElement(QDomDocument &doc)
+static QString numberString(double value)
 {
-    QDomElement node = doc.createElement("micro");
-    node.setAttribute("id", m_microData.id);
+    return QString::number(value, 'g', QLocale::FloatingPointShortest);
+}
+
+void ItemDocumentData::writeMicroData(QXmlStreamWriter &writer)
+{
+    writer.writeStartElement("micro");
+    writer.writeAttribute("id", m_microData.id);
 
     {
         const PinMappingMap::iterator end = m_microData.pinMappings.end();
         for (PinMappingMap::iterator it = m_microData.pinMappings.begin(); it != end; ++it) {
-            QDomElement pinMapNode = doc.createElement("pinmap");
-
             QString type;
             switch (it.value().type()) {
             case PinMapping::SevenSegment:
@@ -270,313 +635,299 @@ QDomElement ItemDocumentData::microDataToElement(QDomDocument &doc)
                 break;
             }
 
-            pinMapNode.setAttribute("id", it.key());
-            pinMapNode.setAttribute("type", type);
-            pinMapNode.setAttribute("map", it.value().pins().join(" "));
-
-            node.appendChild(pinMapNode);
+            writer.writeEmptyElement("pinmap");
+            writer.writeAttribute("id", it.key());
+            writer.writeAttribute("type", type);
+            writer.writeAttribute("map", it.value().pins().join(" "));
         }
     }
 
     {
         const PinDataMap::iterator end = m_microData.pinMap.end();
         for (PinDataMap::iterator it = m_microData.pinMap.begin(); it != end; ++it) {
-            QDomElement pinNode = doc.createElement("pin");
-
-            pinNode.setAttribute("id", it.key());
-            pinNode.setAttribute("type", (it.value().type == PinSettings::pt_input) ? "input" : "output");
-            pinNode.setAttribute("state", (it.value().state == PinSettings::ps_off) ? "off" : "on");
-
-            node.appendChild(pinNode);
+            writer.writeEmptyElement("pin");
+            writer.writeAttribute("id", it.key());
+            writer.writeAttribute("type", (it.value().type == PinSettings::pt_input) ? "input" : "output");
+            writer.writeAttribute("state", (it.value().state == PinSettings::ps_off) ? "off" : "on");
         }
     }
 
     {
         const QStringMap::iterator end = m_microData.variableMap.end();
         for (QStringMap::iterator it = m_microData.variableMap.begin(); it != end; ++it) {
-            QDomElement variableNode = doc.createElement("variable");
-
-            variableNode.setAttribute("name", it.key());
-            variableNode.setAttribute("value", it.value());
-
-            node.appendChild(variableNode);
+            writer.writeEmptyElement("variable");
+            writer.writeAttribute("name", it.key());
+            writer.writeAttribute("value", it.value());
         }
     }
 
-    return node;
+    writer.writeEndElement();
 }
 
-void ItemDocumentData::elementToMicroData(QDomElement element)
+void ItemDocumentData::readMicroData(QXmlStreamReader &reader)
 {
-    QString id = element.attribute("id", QString());
+    const QXmlStreamAttributes attributes = reader.attributes();
+    QString id = attribute(attributes, "id");
 
     if (id.isNull())
-        id = element.attribute("pic", QString());
+        id = attribute(attributes, "pic");
 
     if (id.isNull()) {
         qCCritical(KTL_LOG) << "Could not find id in element";
+        reader.skipCurrentElement();
         return;
     }
 
     m_microData.reset();
     m_microData.id = id;
 
-    QDomNode node = element.firstChild();
-    while (!node.isNull()) {
-        QDomElement childElement = node.toElement();
-        if (!childElement.isNull()) {
-            const QString tagName = childElement.tagName();
+    while (reader.readNextStartElement()) {
+        const QStringRef tagName = reader.name();
+        const QXmlStreamAttributes childAttributes = reader.attributes();
 
-            if (tagName == "pinmap") {
-                QString id = childElement.attribute("id", QString());
-                QString typeString = childElement.attribute("type", QString());
+        if (tagName == QLatin1String("pinmap")) {
+            QString id = attribute(childAttributes, "id");
+            QString typeString = attribute(childAttributes, "type");
 
-                if (!id.isEmpty() && !typeString.isEmpty()) {
-                    PinMapping::Type type = PinMapping::Invalid;
+            if (!id.isEmpty() && !typeString.isEmpty()) {
+                PinMapping::Type type = PinMapping::Invalid;
 
-                    if (typeString == "sevensegment")
-                        type = PinMapping::SevenSegment;
+                if (typeString == "sevensegment")
+                    type = PinMapping::SevenSegment;
 
-                    else if (typeString == "keypad_4x3")
-                        type = PinMapping::Keypad_4x3;
+                else if (typeString == "keypad_4x3")
+                    type = PinMapping::Keypad_4x3;
 
-                    else if (typeString == "keypad_4x4")
-                        type = PinMapping::Keypad_4x4;
+                else if (typeString == "keypad_4x4")
+                    type = PinMapping::Keypad_4x4;
 
-                    PinMapping pinMapping(type);
-                    // pinMapping.setPins( QStringList::split( " ", childElement.attribute( "map", 0 ) ) ); // 2018.12.01
-                    pinMapping.setPins(childElement.attribute("map", nullptr).split(" ", Qt::SkipEmptyParts));
-
-                    m_microData.pinMappings[id] = pinMapping;
-                }
-            }
+                PinMapping pinMapping(type);
+                pinMapping.setPins(attribute(childAttributes, "map").split(" ", Qt::SkipEmptyParts));
 
-            else if (tagName == "pin") {
-                QString pinID = childElement.attribute("id", QString());
-                if (!pinID.isEmpty()) {
-                    m_microData.pinMap[pinID].type = (childElement.attribute("type", "input") == "input") ? PinSettings::pt_input : PinSettings::pt_output;
-                    m_microData.pinMap[pinID].state = (childElement.attribute("state", "off") == "off") ? PinSettings::ps_off : PinSettings::ps_on;
-                }
+                m_microData.pinMappings[id] = pinMapping;
             }
+        }
 
-            else if (tagName == "variable") {
-                QString variableId = childElement.attribute("name", QString());
-                m_microData.variableMap[variableId] = childElement.attribute("value", QString());
+        else if (tagName == QLatin1String("pin")) {
+            QString pinID = attribute(childAttributes, "id");
+            if (!pinID.isEmpty()) {
+                m_microData.pinMap[pinID].type = (attribute(childAttributes, "type", "input") == "input") ? PinSettings::pt_input : PinSettings::pt_output;
+                m_microData.pinMap[pinID].state = (attribute(childAttributes, "state", "off") == "off") ? PinSettings::ps_off : PinSettings::ps_on;
             }
+        }
 
-            else
-                qCCritical(KTL_LOG) << "Unrecognised element tag name: " << tagName;
+        else if (tagName == QLatin1String("variable")) {
+            QString variableId = attribute(childAttributes, "name");
+            m_microData.variableMap[variableId] = attribute(childAttributes, "value");
         }
 
-        node = node.nextSibling();
+        else
+            qCCritical(KTL_LOG) << "Unrecognised element tag name: " << tagName;
+
+        reader.skipCurrentElement();
     }
 }
 
-QDomElement ItemDocumentData::itemDataToElement(QDomDocument &doc, const ItemData &itemData)
+void ItemDocumentData::writeItemData(QXmlStreamWriter &writer, const QString &id, const ItemData &itemData)
 {
-    QDomElement node = doc.createElement("item");
-    node.setAttribute("type", itemData.type);
-    node.setAttribute("x", itemData.x);
-    node.setAttribute("y", itemData.y);
+    writer.writeStartElement("item");
+    writer.writeAttribute("id", id);
+    writer.writeAttribute("type", itemData.type);
+    writer.writeAttribute("x", numberString(itemData.x));
+    writer.writeAttribute("y", numberString(itemData.y));
     if (itemData.z != -1)
-        node.setAttribute("z", itemData.z);
+        writer.writeAttribute("z", QString::number(itemData.z));
     if (itemData.setSize) {
-        node.setAttribute("offset-x", itemData.size.x());
-        node.setAttribute("offset-y", itemData.size.y());
-        node.setAttribute("width", itemData.size.width());
-        node.setAttribute("height", itemData.size.height());
+        writer.writeAttribute("offset-x", QString::number(itemData.size.x()));
+        writer.writeAttribute("offset-y", QString::number(itemData.size.y()));
+        writer.writeAttribute("width", QString::number(itemData.size.width()));
+        writer.writeAttribute("height", QString::number(itemData.size.height()));
     }
 
     // If the "orientation" is >= 0, then set by a FlowPart, so we don't need to worry about the angle / flip
     if (itemData.orientation >= 0) {
-        node.setAttribute("orientation", itemData.orientation);
+        writer.writeAttribute("orientation", QString::number(itemData.orientation));
     } else {
-        node.setAttribute("angle", itemData.angleDegrees);
-        node.setAttribute("flip", itemData.flipped);
+        writer.writeAttribute("angle", numberString(itemData.angleDegrees));
+        writer.writeAttribute("flip", QString::number(int(itemData.flipped)));
     }
 
     if (!itemData.parentId.isEmpty())
-        node.setAttribute("parent", itemData.parentId);
+        writer.writeAttribute("parent", itemData.parentId);
 
     const QStringMap::const_iterator stringEnd = itemData.dataString.end();
     for (QStringMap::const_iterator it = itemData.dataString.begin(); it != stringEnd; ++it) {
-        QDomElement e = doc.createElement("data");
-        node.appendChild(e);
-        e.setAttribute("id", it.key());
-        e.setAttribute("type", "string");
-        e.setAttribute("value", it.value());
+        writer.writeEmptyElement("data");
+        writer.writeAttribute("id", it.key());
+        writer.writeAttribute("type", "string");
+        writer.writeAttribute("value", it.value());
     }
 
     const DoubleMap::const_iterator numberEnd = itemData.dataNumber.end();
     for (DoubleMap::const_iterator it = itemData.dataNumber.begin(); it != numberEnd; ++it) {
-        QDomElement e = doc.createElement("data");
-        node.appendChild(e);
-        e.setAttribute("id", it.key());
-        e.setAttribute("type", "number");
-        e.setAttribute("value", QString::number(it.value()));
+        writer.writeEmptyElement("data");
+        writer.writeAttribute("id", it.key());
+        writer.writeAttribute("type", "number");
+        writer.writeAttribute("value", QString::number(it.value()));
     }
 
     const QColorMap::const_iterator colorEnd = itemData.dataColor.end();
     for (QColorMap::const_iterator it = itemData.dataColor.begin(); it != colorEnd; ++it) {
-        QDomElement e = doc.createElement("data");
-        node.appendChild(e);
-        e.setAttribute("id", it.key());
-        e.setAttribute("type", "color");
-        e.setAttribute("value", it.value().name());
+        writer.writeEmptyElement("data");
+        writer.writeAttribute("id", it.key());
+        writer.writeAttribute("type", "color");
+        writer.writeAttribute("value", it.value().name());
     }
 
     const QBitArrayMap::const_iterator rawEnd = itemData.dataRaw.end();
     for (QBitArrayMap::const_iterator it = itemData.dataRaw.begin(); it != rawEnd; ++it) {
-        QDomElement e = doc.createElement("data");
-        node.appendChild(e);
-        e.setAttribute("id", it.key());
-        e.setAttribute("type", "raw");
-        e.setAttribute("value", toAsciiHex(it.value()));
+        writer.writeEmptyElement("data");
+        writer.writeAttribute("id", it.key());
+        writer.writeAttribute("type", "raw");
+        writer.writeAttribute("value", toAsciiHex(it.value()));
     }
 
     const BoolMap::const_iterator boolEnd = itemData.dataBool.end();
     for (BoolMap::const_iterator it = itemData.dataBool.begin(); it != boolEnd; ++it) {
-        QDomElement e = doc.createElement("data");
-        node.appendChild(e);
-        e.setAttribute("id", it.key());
-        e.setAttribute("type", "bool");
-        e.setAttribute("value", QString::number(it.value()));
+        writer.writeEmptyElement("data");
+        writer.writeAttribute("id", it.key());
+        writer.writeAttribute("type", "bool");
+        writer.writeAttribute("value", QString::number(it.value()));
     }
 
     const BoolMap::const_iterator buttonEnd = itemData.buttonMap.end();
     for (BoolMap::const_iterator it = itemData.buttonMap.begin(); it != buttonEnd; ++it) {
-        QDomElement e = doc.createElement("button");
-        node.appendChild(e);
-        e.setAttribute("id", it.key());
-        e.setAttribute("state", QString::number(it.value()));
+        writer.writeEmptyElement("button");
+        writer.writeAttribute("id", it.key());
+        writer.writeAttribute("state", QString::number(it.value()));
     }
 
     const IntMap::const_iterator sliderEnd = itemData.sliderMap.end();
     for (IntMap::const_iterator it = itemData.sliderMap.begin(); it != sliderEnd; ++it) {
-        QDomElement e = doc.createElement("slider");
-        node.appendChild(e);
-        e.setAttribute("id", it.key());
-        e.setAttribute("value", QString::number(it.value()));
+        writer.writeEmptyElement("slider");
+        writer.writeAttribute("id", it.key());
+        writer.writeAttribute("value", QString::number(it.value()));
     }
 
-    return node;
+    writer.writeEndElement();
 }
 
-void ItemDocumentData::elementToItemData(QDomElement element)
+void ItemDocumentData::readItemData(QXmlStreamReader &reader, const QString &parentId)
 {
-    QString id = element.attribute("id", QString());
+    const QXmlStreamAttributes attributes = reader.attributes();
+    QString id = attribute(attributes, "id");
     if (id.isNull()) {
         qCCritical(KTL_LOG) << "Could not find id in element";
+        reader.skipCurrentElement();
         return;
     }
 
     ItemData itemData;
-    itemData.type = element.attribute("type", QString());
-    itemData.x = element.attribute("x", "120").toInt();
-    itemData.y = element.attribute("y", "120").toInt();
-    itemData.z = element.attribute("z", "-1").toInt();
+    itemData.type = attribute(attributes, "type");
+    itemData.x = attribute(attributes, "x", "120").toInt();
+    itemData.y = attribute(attributes, "y", "120").toInt();
+    itemData.z = attribute(attributes, "z", "-1").toInt();
 
-    if (element.hasAttribute("width") && element.hasAttribute("height")) {
+    if (attributes.hasAttribute("width") && attributes.hasAttribute("height")) {
         itemData.setSize = true;
-        itemData.size = QRect(element.attribute("offset-x", "0").toInt(), element.attribute("offset-y", "0").toInt(), element.attribute("width", "120").toInt(), element.attribute("height", "120").toInt());
+        itemData.size = QRect(attribute(attributes, "offset-x", "0").toInt(), attribute(attributes, "offset-y", "0").toInt(), attribute(attributes, "width", "120").toInt(), attribute(attributes, "height", "120").toInt());
     } else
         itemData.setSize = false;
 
-    itemData.angleDegrees = element.attribute("angle", "0").toInt();
-    itemData.flipped = element.attribute("flip", "0").toInt();
-    itemData.orientation = element.attribute("orientation", "-1").toInt();
-    itemData.parentId = element.attribute("parent", QString());
+    itemData.angleDegrees = attribute(attributes, "angle", "0").toInt();
+    itemData.flipped = attribute(attributes, "flip", "0").toInt();
+    itemData.orientation = attribute(attributes, "orientation", "-1").toInt();
+    itemData.parentId = parentId.isNull() ? attribute(attributes, "parent") : parentId;
 
-    m_itemDataMap[id] = itemData;
+    while (reader.readNextStartElement()) {
+        const QStringRef tagName = reader.name();
+        const QXmlStreamAttributes childAttributes = reader.attributes();
 
-    QDomNode node = element.firstChild();
-    while (!node.isNull()) {
-        QDomElement childElement = node.toElement();
-        if (!childElement.isNull()) {
-            const QString tagName = childElement.tagName();
-
-            if (tagName == "item") {
-                // We're reading in a file saved in the older format, with
-                // child items nestled, so we must specify that the new item
-                // has the currently parsed item as its parent.
-                elementToItemData(childElement);
-                QString childId = childElement.attribute("id", QString());
-                if (!childId.isNull())
-                    m_itemDataMap[childId].parentId = id;
-            }
+        if (tagName == QLatin1String("item")) {
+            // We're reading in a file saved in the older format, with
+            // child items nestled, so we must specify that the new item
+            // has the currently parsed item as its parent.
+            readItemData(reader, id);
+            continue;
+        }
 
-            else if (tagName == "data") {
-                QString dataId = childElement.attribute("id", QString());
-                if (!dataId.isNull()) {
-                    QString dataType = childElement.attribute("type", QString());
-                    QString value = childElement.attribute("value", QString());
-
-                    if (dataType == "string" || dataType == "multiline")
-                        m_itemDataMap[id].dataString[dataId] = value;
-                    else if (dataType == "number")
-                        m_itemDataMap[id].dataNumber[dataId] = value.toDouble();
-                    else if (dataType == "color")
-                        m_itemDataMap[id].dataColor[dataId] = QColor(value);
-                    else if (dataType == "raw")
-                        m_itemDataMap[id].dataRaw[dataId] = toQBitArray(value);
-                    else if (dataType == "bool")
-                        m_itemDataMap[id].dataBool[dataId] = bool(value.toInt());
-                    else
-                        qCCritical(KTL_LOG) << "Unknown data type of \"" << dataType << "\" with id \"" << dataId << "\"";
-                }
+        else if (tagName == QLatin1String("data")) {
+            QString dataId = attribute(childAttributes, "id");
+            if (!dataId.isNull()) {
+                QString dataType = attribute(childAttributes, "type");
+                QString value = attribute(childAttributes, "value");
+
+                if (dataType == "string" || dataType == "multiline")
+                    itemData.dataString[dataId] = value;
+                else if (dataType == "number")
+                    itemData.dataNumber[dataId] = value.toDouble();
+                else if (dataType == "color")
+                    itemData.dataColor[dataId] = QColor(value);
+                else if (dataType == "raw")
+                    itemData.dataRaw[dataId] = toQBitArray(value);
+                else if (dataType == "bool")
+                    itemData.dataBool[dataId] = bool(value.toInt());
+                else
+                    qCCritical(KTL_LOG) << "Unknown data type of \"" << dataType << "\" with id \"" << dataId << "\"";
             }
+        }
 
-            else if (tagName == "button") {
-                QString buttonId = childElement.attribute("id", QString());
-                if (!buttonId.isNull())
-                    m_itemDataMap[id].buttonMap[buttonId] = childElement.attribute("state", "0").toInt();
-            }
+        else if (tagName == QLatin1String("button")) {
+            QString buttonId = attribute(childAttributes, "id");
+            if (!buttonId.isNull())
+                itemData.buttonMap[buttonId] = attribute(childAttributes, "state", "0").toInt();
+        }
 
-            else if (tagName == "slider") {
-                QString sliderId = childElement.attribute("id", QString());
-                if (!sliderId.isNull())
-                    m_itemDataMap[id].sliderMap[sliderId] = childElement.attribute("value", "0").toInt();
-            }
+        else if (tagName == QLatin1String("slider")) {
+            QString sliderId = attribute(childAttributes, "id");
+            if (!sliderId.isNull())
+                itemData.sliderMap[sliderId] = attribute(childAttributes, "value", "0").toInt();
+        }
 
-            else if (tagName == "child-node")
-                ; // Tag name was used in 0.1 file save format
+        else if (tagName == QLatin1String("child-node"))
+            ; // Tag name was used in 0.1 file save format
 
-            else
-                qCCritical(KTL_LOG) << "Unrecognised element tag name: " << tagName;
-        }
+        else
+            qCCritical(KTL_LOG) << "Unrecognised element tag name: " << tagName;
 
-        node = node.nextSibling();
+        reader.skipCurrentElement();
     }
+
+    m_itemDataMap[id] = itemData;
 }
 
-QDomElement ItemDocumentData::nodeDataToElement(QDomDocument &doc, const NodeData &nodeData)
+void ItemDocumentData::writeNodeData(QXmlStreamWriter &writer, const QString &id, const NodeData &nodeData)
 {
-    QDomElement node = doc.createElement("node");
-    node.setAttribute("x", nodeData.x);
-    node.setAttribute("y", nodeData.y);
-    return node;
+    writer.writeEmptyElement("node");
+    writer.writeAttribute("id", id);
+    writer.writeAttribute("x", numberString(nodeData.x));
+    writer.writeAttribute("y", numberString(nodeData.y));
 }
 
-void ItemDocumentData::elementToNodeData(QDomElement element)
+void ItemDocumentData::readNodeData(QXmlStreamReader &reader)
 {
-    QString id = element.attribute("id", QString());
+    const QXmlStreamAttributes attributes = reader.attributes();
+    reader.skipCurrentElement();
+
+    QString id = attribute(attributes, "id");
     if (id.isNull()) {
         qCCritical(KTL_LOG) << "Could not find id in element";
         return;
     }
 
     NodeData nodeData;
-    nodeData.x = element.attribute("x", "120").toInt();
-    nodeData.y = element.attribute("y", "120").toInt();
+    nodeData.x = attribute(attributes, "x", "120").toInt();
+    nodeData.y = attribute(attributes, "y", "120").toInt();
 
     m_nodeDataMap[id] = nodeData;
 }
 
-QDomElement ItemDocumentData::connectorDataToElement(QDomDocument &doc, const ConnectorData &connectorData)
+void ItemDocumentData::writeConnectorData(QXmlStreamWriter &writer, const QString &id, const ConnectorData &connectorData)
 {
-    QDomElement node = doc.createElement("connector");
+    writer.writeEmptyElement("connector");
+    writer.writeAttribute("id", id);
 
-    node.setAttribute("manual-route", connectorData.manualRoute);
+    writer.writeAttribute("manual-route", QString::number(int(connectorData.manualRoute)));
 
     QString route;
     const QPointList::const_iterator end = connectorData.route.end();
@@ -584,32 +935,33 @@ QDomElement ItemDocumentData::connectorDataToElement(QDomDocument &doc, const Co
         route.append(QString::number((*it).x()) + ",");
         route.append(QString::number((*it).y()) + ",");
     }
-    node.setAttribute("route", route);
+    writer.writeAttribute("route", route);
 
     if (connectorData.startNodeIsChild) {
-        node.setAttribute("start-node-is-child", 1);
-        node.setAttribute("start-node-cid", connectorData.startNodeCId);
-        node.setAttribute("start-node-parent", connectorData.startNodeParent);
+        writer.writeAttribute("start-node-is-child", "1");
+        writer.writeAttribute("start-node-cid", connectorData.startNodeCId);
+        writer.writeAttribute("start-node-parent", connectorData.startNodeParent);
     } else {
-        node.setAttribute("start-node-is-child", 0);
-        node.setAttribute("start-node-id", connectorData.startNodeId);
+        writer.writeAttribute("start-node-is-child", "0");
+        writer.writeAttribute("start-node-id", connectorData.startNodeId);
     }
 
     if (connectorData.endNodeIsChild) {
-        node.setAttribute("end-node-is-child", 1);
-        node.setAttribute("end-node-cid", connectorData.endNodeCId);
-        node.setAttribute("end-node-parent", connectorData.endNodeParent);
+        writer.writeAttribute("end-node-is-child", "1");
+        writer.writeAttribute("end-node-cid", connectorData.endNodeCId);
+        writer.writeAttribute("end-node-parent", connectorData.endNodeParent);
     } else {
-        node.setAttribute("end-node-is-child", 0);
-        node.setAttribute("end-node-id", connectorData.endNodeId);
+        writer.writeAttribute("end-node-is-child", "0");
+        writer.writeAttribute("end-node-id", connectorData.endNodeId);
     }
-
-    return node;
 }
 
-void ItemDocumentData::elementToConnectorData(QDomElement element)
+void ItemDocumentData::readConnectorData(QXmlStreamReader &reader)
 {
-    QString id = element.attribute("id", QString());
+    const QXmlStreamAttributes attributes = reader.attributes();
+    reader.skipCurrentElement();
+
+    QString id = attribute(attributes, "id");
     if (id.isNull()) {
         qCCritical(KTL_LOG) << "Could not find id in element";
         return;
@@ -617,14 +969,10 @@ void ItemDocumentData::elementToConnectorData(QDomElement element)
 
     ConnectorData connectorData;
 
-    connectorData.manualRoute = (element.attribute("manual-route", "0") == "1");
-    QString route = element.attribute("route", "");
+    connectorData.manualRoute = (attribute(attributes, "manual-route", "0") == "1");
+    QString route = attribute(attributes, "route", "");
 
-    QStringList points = route.split(",", Qt::SkipEmptyParts); // QStringList::split( ",", route ); // 2018.12.01
-    if (route.isEmpty()) {
-        points = QStringList();
-    }
-    qCDebug(KTL_LOG) << "points=" << points;
+    QStringList points = route.split(",", Qt::SkipEmptyParts);
     const QStringList::iterator end = points.end();
     for (QStringList::iterator it = points.begin(); it != end; ++it) {
         int x = (*it).toInt();
@@ -635,23 +983,23 @@ void ItemDocumentData::elementToConnectorData(QDomElement element)
         }
     }
 
-    connectorData.startNodeIsChild = element.attribute("start-node-is-child", "0").toInt();
+    connectorData.startNodeIsChild = attribute(attributes, "start-node-is-child", "0").toInt();
     if (connectorData.startNodeIsChild) {
-        connectorData.startNodeCId = element.attribute("start-node-cid", QString());
-        connectorData.startNodeParent = element.attribute("start-node-parent", QString());
+        connectorData.startNodeCId = attribute(attributes, "start-node-cid");
+        connectorData.startNodeParent = attribute(attributes, "start-node-parent");
     } else
-        connectorData.startNodeId = element.attribute("start-node-id", QString());
+        connectorData.startNodeId = attribute(attributes, "start-node-id");
 
-    connectorData.endNodeIsChild = element.attribute("end-node-is-child", "0").toInt();
+    connectorData.endNodeIsChild = attribute(attributes, "end-node-is-child", "0").toInt();
     if (connectorData.endNodeIsChild) {
-        connectorData.endNodeCId = element.attribute("end-node-cid", QString());
-        connectorData.endNodeParent = element.attribute("end-node-parent", QString());
+        connectorData.endNodeCId = attribute(attributes, "end-node-cid");
+        connectorData.endNodeParent = attribute(attributes, "end-node-parent");
     } else
-        connectorData.endNodeId = element.attribute("end-node-id", QString());
+        connectorData.endNodeId = attribute(attributes, "end-node-id");
 
     m_connectorDataMap[id] = connectorData;
 }
-// END functions for generating / reading QDomElements
+// END functions for writing / reading xml elements
 
 QString ItemDocumentData::documentTypeString() const
 {
@@ -705,41 +1053,46 @@ void ItemDocumentData::generateUniqueIDs(ItemDocument *itemDocument)
     if (!itemDocument)
         return;
 
-    QStringMap replaced;
-    replaced[""] = QString();
-    replaced[QString()] = QString();
+    loadRoutes();
+
+    QHash<QString, QString> replaced;
+    replaced.reserve(m_itemDataMap.size() + m_nodeDataMap.size() + m_connectorDataMap.size() + 1);
+    replaced.insert(QString(), QString());
+
+    // BEGIN Go through and replace the old ids
+    // The new ids are all generated in one go, for the old ids in the order
+    // they are first met
+    QStringList oldIds;
+    oldIds.reserve(replaced.capacity());
+    for (const QString &id : m_itemDataMap.keys() + m_nodeDataMap.keys() + m_connectorDataMap.keys()) {
+        if (!replaced.contains(id)) {
+            replaced.insert(id, QString());
+            oldIds << id;
+        }
+    }
+
+    const QStringList newIds = itemDocument->generateUIDs(oldIds);
+    for (int i = 0; i < oldIds.size(); ++i)
+        replaced[oldIds[i]] = newIds[i];
 
     ItemDataMap newItemDataMap;
     ConnectorDataMap newConnectorDataMap;
     NodeDataMap newNodeDataMap;
 
-    // BEGIN Go through and replace the old ids
     {
-        const ItemDataMap::iterator end = m_itemDataMap.end();
-        for (ItemDataMap::iterator it = m_itemDataMap.begin(); it != end; ++it) {
-            if (!replaced.contains(it.key()))
-                replaced[it.key()] = itemDocument->generateUID(it.key());
-
-            newItemDataMap[replaced[it.key()]] = it.value();
-        }
+        const ItemDataMap::const_iterator end = m_itemDataMap.constEnd();
+        for (ItemDataMap::const_iterator it = m_itemDataMap.constBegin(); it != end; ++it)
+            newItemDataMap.insert(replaced.value(it.key()), it.value());
     }
     {
-        const NodeDataMap::iterator end = m_nodeDataMap.end();
-        for (NodeDataMap::iterator it = m_nodeDataMap.begin(); it != end; ++it) {
-            if (!replaced.contains(it.key()))
-                replaced[it.key()] = itemDocument->generateUID(it.key());
-
-            newNodeDataMap[replaced[it.key()]] = it.value();
-        }
+        const NodeDataMap::const_iterator end = m_nodeDataMap.constEnd();
+        for (NodeDataMap::const_iterator it = m_nodeDataMap.constBegin(); it != end; ++it)
+            newNodeDataMap.insert(replaced.value(it.key()), it.value());
     }
     {
-        const ConnectorDataMap::iterator end = m_connectorDataMap.end();
-        for (ConnectorDataMap::iterator it = m_connectorDataMap.begin(); it != end; ++it) {
-            if (!replaced.contains(it.key()))
-                replaced[it.key()] = itemDocument->generateUID(it.key());
-
-            newConnectorDataMap[replaced[it.key()]] = it.value();
-        }
+        const ConnectorDataMap::const_iterator end = m_connectorDataMap.constEnd();
+        for (ConnectorDataMap::const_iterator it = m_connectorDataMap.constBegin(); it != end; ++it)
+            newConnectorDataMap.insert(replaced.value(it.key()), it.value());
     }
     // END Go through and replace the old ids
 
@@ -769,6 +1122,8 @@ void ItemDocumentData::generateUniqueIDs(ItemDocument *itemDocument)
 
 void ItemDocumentData::translateContents(int dx, int dy)
 {
+    loadRoutes();
+
     // BEGIN Go through and replace the old ids
     {
         const ItemDataMap::iterator end = m_itemDataMap.end();
@@ -800,6 +1155,9 @@ void ItemDocumentData::restoreDocument(ItemDocument *itemDocument)
     if (!itemDocument)
         return;
 
+    SimulationLocker locker;
+    ItemDocumentBulkLoad bulkLoad(itemDocument);
+
     ICNDocument *icnd = dynamic_cast<ICNDocument *>(itemDocument);
     FlowCodeDocument *fcd = dynamic_cast<FlowCodeDocument *>(icnd);
     if (fcd && !m_microData.id.isEmpty()) {
@@ -863,6 +1221,9 @@ void ItemDocumentData::mergeWithDocument(ItemDocument *itemDocument, bool select
     if (!itemDocument)
         return;
 
+    SimulationLocker locker;
+    ItemDocumentBulkLoad bulkLoad(itemDocument);
+
     ICNDocument *icnd = dynamic_cast<ICNDocument *>(itemDocument);
 
     // BEGIN Restore Nodes
@@ -919,6 +1280,8 @@ void ItemDocumentData::mergeWithDocument(ItemDocument *itemDocument, bool select
 
     // BEGIN Restore Connectors
     if (icnd) {
+        loadRoutes();
+
         const ConnectorDataMap::iterator connectorEnd = m_connectorDataMap.end();
         for (ConnectorDataMap::iterator it = m_connectorDataMap.begin(); it != connectorEnd; ++it) {
             if (icnd->connectorWithID(it.key()))
@@ -1044,6 +1407,8 @@ void ItemDocumentData::addItemData(ItemData itemData, QString id)
 
 void ItemDocumentData::addConnectorData(ConnectorData connectorData, QString id)
 {
+    loadRoutes();
+
     if (m_connectorDataMap.contains(id)) {
         qCWarning(KTL_LOG) << "Overwriting connector: " << id;
     }
@@ -1057,8 +1422,183 @@ void ItemDocumentData::addNodeData(NodeData nodeData, QString id)
     }
     m_nodeDataMap[id] = nodeData;
 }
+
+/**
+ * The estimates below count the nodes of the maps and the characters of the
+ * strings, which is most of what the data holds; the allocator's own overhead
+ * is not counted.
+ */
+static qint64 stringUsage(const QString &string)
+{
+    return string.capacity() * qint64(sizeof(QChar));
+}
+
+template<typename Map> static qint64 mapUsage(const Map &map)
+{
+    qint64 bytes = map.size() * qint64(3 * sizeof(void *) + sizeof(typename Map::key_type) + sizeof(typename Map::mapped_type));
+    const typename Map::const_iterator end = map.constEnd();
+    for (typename Map::const_iterator it = map.constBegin(); it != end; ++it)
+        bytes += stringUsage(it.key());
+    return bytes;
+}
+
+static qint64 stringListUsage(const QStringList &list)
+{
+    qint64 bytes = list.size() * qint64(sizeof(void *));
+    for (const QString &string : list)
+        bytes += stringUsage(string);
+    return bytes;
+}
+
+static qint64 itemDataMapUsage(const ItemDataMap &map)
+{
+    qint64 bytes = mapUsage(map);
+    for (const ItemData &itemData : map) {
+        bytes += stringUsage(itemData.type) + stringUsage(itemData.parentId);
+        bytes += mapUsage(itemData.buttonMap) + mapUsage(itemData.sliderMap);
+        bytes += mapUsage(itemData.dataBool) + mapUsage(itemData.dataNumber) + mapUsage(itemData.dataColor);
+        bytes += mapUsage(itemData.dataString) + mapUsage(itemData.dataRaw);
+        for (const QString &string : itemData.dataString)
+            bytes += stringUsage(string);
+        for (const QBitArray &raw : itemData.dataRaw)
+            bytes += raw.size() / 8;
+    }
+    return bytes;
+}
+
+static qint64 connectorDataMapUsage(const ConnectorDataMap &map)
+{
+    qint64 bytes = mapUsage(map);
+    for (const ConnectorData &connectorData : map) {
+        bytes += connectorData.route.size() * qint64(sizeof(void *) + sizeof(QPoint));
+        bytes += stringUsage(connectorData.startNodeCId) + stringUsage(connectorData.endNodeCId);
+        bytes += stringUsage(connectorData.startNodeParent) + stringUsage(connectorData.endNodeParent);
+        bytes += stringUsage(connectorData.startNodeId) + stringUsage(connectorData.endNodeId);
+    }
+    return bytes;
+}
+
+qint64 ItemDocumentData::memoryUsage() const
+{
+    return itemDataMapUsage(m_itemDataMap) + connectorDataMapUsage(m_connectorDataMap) + mapUsage(m_nodeDataMap) + m_routeSection.capacity();
+}
 // END class ItemDocumentData
 
+// BEGIN class ItemDocumentDelta
+/**
+ * Adds the entries of to that are new or different to changed, and the keys
+ * that are only in from to removed.
+ */
+template<typename Map> static void diffMaps(const Map &from, const Map &to, Map *changed, QStringList *removed)
+{
+    const typename Map::const_iterator toEnd = to.constEnd();
+    for (typename Map::const_iterator it = to.constBegin(); it != toEnd; ++it) {
+        const typename Map::const_iterator old = from.constFind(it.key());
+        if (old == from.constEnd() || !(old.value() == it.value()))
+            changed->insert(it.key(), it.value());
+    }
+
+    const typename Map::const_iterator fromEnd = from.constEnd();
+    for (typename Map::const_iterator it = from.constBegin(); it != fromEnd; ++it) {
+        if (!to.contains(it.key()))
+            removed->append(it.key());
+    }
+}
+
+/**
+ * Makes the changes to data, and records in undoChanged and undoRemoved what
+ * takes it back again.
+ */
+template<typename Map> static void applyToMap(const Map &changed, const QStringList &removed, Map *data, Map *undoChanged, QStringList *undoRemoved)
+{
+    const typename Map::const_iterator changedEnd = changed.constEnd();
+    for (typename Map::const_iterator it = changed.constBegin(); it != changedEnd; ++it) {
+        typename Map::iterator old = data->find(it.key());
+        if (old == data->end()) {
+            undoRemoved->append(it.key());
+            data->insert(it.key(), it.value());
+        } else {
+            undoChanged->insert(it.key(), old.value());
+            old.value() = it.value();
+        }
+    }
+
+    const QStringList::const_iterator removedEnd = removed.constEnd();
+    for (QStringList::const_iterator it = removed.constBegin(); it != removedEnd; ++it) {
+        typename Map::iterator old = data->find(*it);
+        if (old != data->end()) {
+            undoChanged->insert(*it, old.value());
+            data->erase(old);
+        }
+    }
+}
+
+ItemDocumentDelta::ItemDocumentDelta(int state)
+    : m_state(state)
+{
+}
+
+ItemDocumentDelta::ItemDocumentDelta(const ItemDocumentData &from, const ItemDocumentData &to, int state)
+    : m_microData(to.m_microData)
+    , m_state(state)
+{
+    diffMaps(from.m_itemDataMap, to.m_itemDataMap, &m_changedItems, &m_removedItems);
+    diffMaps(from.m_connectorDataMap, to.m_connectorDataMap, &m_changedConnectors, &m_removedConnectors);
+    diffMaps(from.m_nodeDataMap, to.m_nodeDataMap, &m_changedNodes, &m_removedNodes);
+}
+
+ItemDocumentDelta *ItemDocumentDelta::apply(ItemDocumentData *data, int dataState) const
+{
+    ItemDocumentDelta *undo = new ItemDocumentDelta(dataState);
+
+    applyToMap(m_changedItems, m_removedItems, &data->m_itemDataMap, &undo->m_changedItems, &undo->m_removedItems);
+    applyToMap(m_changedConnectors, m_removedConnectors, &data->m_connectorDataMap, &undo->m_changedConnectors, &undo->m_removedConnectors);
+    applyToMap(m_changedNodes, m_removedNodes, &data->m_nodeDataMap, &undo->m_changedNodes, &undo->m_removedNodes);
+
+    undo->m_microData = data->m_microData;
+    data->m_microData = m_microData;
+
+    return undo;
+}
+
+qint64 ItemDocumentDelta::memoryUsage() const
+{
+    qint64 bytes = itemDataMapUsage(m_changedItems) + connectorDataMapUsage(m_changedConnectors) + mapUsage(m_changedNodes);
+    bytes += stringListUsage(m_removedItems) + stringListUsage(m_removedConnectors) + stringListUsage(m_removedNodes);
+    return bytes;
+}
+// END class ItemDocumentDelta
+
+// BEGIN class ItemDocumentMimeData
+ItemDocumentMimeData::ItemDocumentMimeData(const ItemDocumentData &data)
+    : m_data(data)
+{
+}
+
+bool ItemDocumentMimeData::hasFormat(const QString &mimeType) const
+{
+    return mimeType == QLatin1String("text/plain") || QMimeData::hasFormat(mimeType);
+}
+
+QStringList ItemDocumentMimeData::formats() const
+{
+    QStringList formats = QMimeData::formats();
+    if (!formats.contains(QLatin1String("text/plain")))
+        formats.prepend(QLatin1String("text/plain"));
+    return formats;
+}
+
+QVariant ItemDocumentMimeData::retrieveData(const QString &mimeType, QVariant::Type type) const
+{
+    if (mimeType != QLatin1String("text/plain"))
+        return QMimeData::retrieveData(mimeType, type);
+
+    if (m_xml.isEmpty())
+        m_xml = m_data.toXML();
+    return m_xml;
+}
+// END class ItemDocumentMimeData
+
 // BEGIN class ItemData
 ItemData::ItemData()
 {
@@ -1070,6 +1610,13 @@ ItemData::ItemData()
     orientation = -1;
     setSize = false;
 }
+
+bool ItemData::operator==(const ItemData &other) const
+{
+    return type == other.type && x == other.x && y == other.y && z == other.z && size == other.size && setSize == other.setSize && orientation == other.orientation && angleDegrees == other.angleDegrees &&
+        flipped == other.flipped && buttonMap == other.buttonMap && sliderMap == other.sliderMap && parentId == other.parentId && dataBool == other.dataBool && dataNumber == other.dataNumber && dataColor == other.dataColor &&
+        dataString == other.dataString && dataRaw == other.dataRaw;
+}
 // END class ItemData
 
 // BEGIN class ConnectorData
@@ -1079,6 +1626,12 @@ ConnectorData::ConnectorData()
     startNodeIsChild = false;
     endNodeIsChild = false;
 }
+
+bool ConnectorData::operator==(const ConnectorData &other) const
+{
+    return route == other.route && manualRoute == other.manualRoute && startNodeIsChild == other.startNodeIsChild && endNodeIsChild == other.endNodeIsChild && startNodeCId == other.startNodeCId && endNodeCId == other.endNodeCId &&
+        startNodeParent == other.startNodeParent && endNodeParent == other.endNodeParent && startNodeId == other.startNodeId && endNodeId == other.endNodeId;
+}
 // END class ConnectorData
 
 // BEGIN class NodeData
@@ -1087,6 +1640,11 @@ NodeData::NodeData()
     x = 0;
     y = 0;
 }
+
+bool NodeData::operator==(const NodeData &other) const
+{
+    return x == other.x && y == other.y;
+}
 // END class NodeDaata
 
 // BEGIN class PinData
@@ -1113,14 +1671,16 @@ void MicroData::reset()
 SubcircuitData::SubcircuitData()
     : ItemDocumentData(Document::dt_circuit)
 {
+    m_bCompiled = false;
 }
 
-void SubcircuitData::initECSubcircuit(ECSubcircuit *ecSubcircuit)
+void SubcircuitData::compile()
 {
-    if (!ecSubcircuit)
+    if (m_bCompiled)
         return;
 
-    generateUniqueIDs(ecSubcircuit->itemDocument());
+    m_bCompiled = true;
+    m_extConNames.clear();
 
     // Generate a list of the External Connections, sorting by x coordinate
     std::multimap<double, QString> extCon;
@@ -1130,9 +1690,6 @@ void SubcircuitData::initECSubcircuit(ECSubcircuit *ecSubcircuit)
             extCon.insert(std::make_pair(it.value().x, it.key()));
     }
 
-    // How many external connections do we have?
-    ecSubcircuit->setNumExtCon(extCon.size());
-
     // Sort the connections into the pins of the subcircuit by y coordinate
     std::multimap<double, QString> leftPins;
     std::multimap<double, QString> rightPins;
@@ -1148,13 +1705,14 @@ void SubcircuitData::initECSubcircuit(ECSubcircuit *ecSubcircuit)
     }
 
     // Remove the external connections (recording their names and associated numerical position)
+    m_extConNames.resize(extCon.size());
     int nodeId = 0;
     typedef QMap<QString, int> IntMap;
     IntMap nodeMap;
     const std::multimap<double, QString>::iterator leftPinsEnd = leftPins.end();
     for (std::multimap<double, QString>::iterator it = leftPins.begin(); it != leftPinsEnd; ++it) {
         nodeMap[it->second] = nodeId;
-        ecSubcircuit->setExtConName(nodeId, m_itemDataMap[it->second].dataString["name"]);
+        m_extConNames[nodeId] = m_itemDataMap[it->second].dataString["name"];
         nodeId++;
         m_itemDataMap.remove(it->second);
     }
@@ -1162,29 +1720,64 @@ void SubcircuitData::initECSubcircuit(ECSubcircuit *ecSubcircuit)
     const std::multimap<double, QString>::iterator rightPinsEnd = rightPins.end();
     for (std::multimap<double, QString>::iterator it = rightPins.begin(); it != rightPinsEnd; ++it) {
         nodeMap[it->second] = nodeId;
-        ecSubcircuit->setExtConName(nodeId, m_itemDataMap[it->second].dataString["name"]);
+        m_extConNames[nodeId] = m_itemDataMap[it->second].dataString["name"];
         nodeId--;
         m_itemDataMap.remove(it->second);
     }
 
-    // Replace connector references to the old External Connectors to the nodes
+    // Replace connector references to the old External Connectors to the
+    // nodes. The parent is left empty, to be the subcircuit that this is put in.
+    loadRoutes();
     const ConnectorDataMap::iterator connectorEnd = m_connectorDataMap.end();
     for (ConnectorDataMap::iterator it = m_connectorDataMap.begin(); it != connectorEnd; ++it) {
         if (it.value().startNodeIsChild && nodeMap.contains(it.value().startNodeParent)) {
             it.value().startNodeCId = QString::number(nodeMap[it.value().startNodeParent]);
-            it.value().startNodeParent = ecSubcircuit->id();
+            it.value().startNodeParent = QString();
         }
         if (it.value().endNodeIsChild && nodeMap.contains(it.value().endNodeParent)) {
             it.value().endNodeCId = QString::number(nodeMap[it.value().endNodeParent]);
-            it.value().endNodeParent = ecSubcircuit->id();
+            it.value().endNodeParent = QString();
         }
     }
+}
 
-    // Create all the new stuff
-    mergeWithDocument(ecSubcircuit->itemDocument(), false);
+void SubcircuitData::initECSubcircuit(ECSubcircuit *ecSubcircuit)
+{
+    if (!ecSubcircuit)
+        return;
+
+    compile();
+    generateUniqueIDs(ecSubcircuit->itemDocument());
+
+    ecSubcircuit->setNumExtCon(m_extConNames.size());
+    for (int i = 0; i < m_extConNames.size(); ++i)
+        ecSubcircuit->setExtConName(i, m_extConNames[i]);
+
+    // Attach the connectors that went to the External Connectors to the subcircuit
+    const ConnectorDataMap::iterator connectorEnd = m_connectorDataMap.end();
+    for (ConnectorDataMap::iterator it = m_connectorDataMap.begin(); it != connectorEnd; ++it) {
+        if (it.value().startNodeIsChild && it.value().startNodeParent.isEmpty())
+            it.value().startNodeParent = ecSubcircuit->id();
+        if (it.value().endNodeIsChild && it.value().endNodeParent.isEmpty())
+            it.value().endNodeParent = ecSubcircuit->id();
+    }
+
+    // Create all the new stuff. When flattening, the connectors and junctions
+    // are left out, and only the wires they would hold are made.
+    const bool flatten = KTLConfig::flattenSubcircuits();
+    if (flatten) {
+        NodeDataMap nodeDataMap;
+        ConnectorDataMap connectorDataMap;
+        nodeDataMap.swap(m_nodeDataMap);
+        connectorDataMap.swap(m_connectorDataMap);
+        mergeWithDocument(ecSubcircuit->itemDocument(), false);
+        nodeDataMap.swap(m_nodeDataMap);
+        connectorDataMap.swap(m_connectorDataMap);
+    } else
+        mergeWithDocument(ecSubcircuit->itemDocument(), false);
 
     // Parent and hide the new stuff
-    itemEnd = m_itemDataMap.end();
+    const ItemDataMap::iterator itemEnd = m_itemDataMap.end();
     for (ItemDataMap::iterator it = m_itemDataMap.begin(); it != itemEnd; ++it) {
         Component *component = static_cast<Component *>(ecSubcircuit->itemDocument()->itemWithID(it.key()));
         if (component) {
@@ -1195,6 +1788,13 @@ void SubcircuitData::initECSubcircuit(ECSubcircuit *ecSubcircuit)
             ecSubcircuit->connect(ecSubcircuit, &ECSubcircuit::subcircuitDeleted, component, &Component::removeItem);
         }
     }
+
+    if (flatten) {
+        createFlattenedWires(ecSubcircuit);
+        ecSubcircuit->doneSCInit();
+        return;
+    }
+
     for (ConnectorDataMap::iterator it = m_connectorDataMap.begin(); it != connectorEnd; ++it) {
         Connector *connector = (static_cast<ICNDocument *>(ecSubcircuit->itemDocument()))->connectorWithID(it.key());
         if (connector) {
@@ -1216,4 +1816,65 @@ void SubcircuitData::initECSubcircuit(ECSubcircuit *ecSubcircuit)
 
     ecSubcircuit->doneSCInit();
 }
+
+void SubcircuitData::createFlattenedWires(ECSubcircuit *ecSubcircuit)
+{
+    ICNDocument *icnd = static_cast<ICNDocument *>(ecSubcircuit->itemDocument());
+
+    // The ends of the connectors are grouped by what they are connected to
+    // (through other connectors and junctions), by their keys
+    QHash<QString, QString> groups;
+    QHash<QString, ECNode *> nodes;
+
+    auto findGroup = [&groups](const QString &key) {
+        QString group = key;
+        while (groups.contains(group) && groups[group] != group)
+            group = groups[group];
+        groups[key] = group;
+        return group;
+    };
+
+    auto addEnd = [&](bool isChild, const QString &parent, const QString &childId, const QString &nodeId) {
+        if (!isChild)
+            return nodeId;
+
+        const QString key = parent + '\n' + childId;
+        if (!nodes.contains(key)) {
+            CNItem *item = icnd->cnItemWithID(parent);
+            ECNode *node = item ? dynamic_cast<ECNode *>(item->childNode(childId)) : nullptr;
+            if (!node)
+                qCCritical(KTL_LOG) << "Unable to find node" << childId << "of" << parent;
+            nodes.insert(key, node);
+        }
+        return key;
+    };
+
+    const ConnectorDataMap::const_iterator connectorEnd = m_connectorDataMap.constEnd();
+    for (ConnectorDataMap::const_iterator it = m_connectorDataMap.constBegin(); it != connectorEnd; ++it) {
+        const ConnectorData &data = it.value();
+        const QString start = findGroup(addEnd(data.startNodeIsChild, data.startNodeParent, data.startNodeCId, data.startNodeId));
+        const QString end = findGroup(addEnd(data.endNodeIsChild, data.endNodeParent, data.endNodeCId, data.endNodeId));
+        groups[start] = end;
+    }
+
+    // Each node is wired to the first node of its group
+    QHash<QString, ECNode *> firstNodes;
+    for (QHash<QString, ECNode *>::const_iterator it = nodes.constBegin(); it != nodes.constEnd(); ++it) {
+        ECNode *node = it.value();
+        if (!node)
+            continue;
+
+        ECNode *&first = firstNodes[findGroup(it.key())];
+        if (!first) {
+            first = node;
+            continue;
+        }
+
+        const unsigned numPins = std::min(first->numPins(), node->numPins());
+        for (unsigned i = 0; i < numPins; ++i) {
+            // The wire belongs to its pins, and goes with them
+            new Wire(first->pin(i), node->pin(i));
+        }
+    }
+}
 // END class SubcircuitData
@@ -14,14 +14,19 @@
 #include "item.h"
 #include "microsettings.h"
 
-#include <QDomDocument>
-#include <QDomElement>
+#include <QByteArray>
+#include <QMimeData>
+#include <QStringList>
+#include <QVector>
 
 class Connector;
 class ECSubcircuit;
 class QUrl;
 class Node;
 class PinMapping;
+class QIODevice;
+class QXmlStreamReader;
+class QXmlStreamWriter;
 
 typedef QList<QPointer<Connector>> ConnectorList;
 typedef QList<QPointer<Item>> ItemList;
@@ -40,6 +45,7 @@ class ItemData
 {
 public:
     ItemData();
+    bool operator==(const ItemData &other) const;
 
     QString type;
     double x;
@@ -65,6 +71,7 @@ class ConnectorData
 {
 public:
     ConnectorData();
+    bool operator==(const ConnectorData &other) const;
 
     QPointList route;
     bool manualRoute;
@@ -87,6 +94,7 @@ class NodeData
 {
 public:
     NodeData();
+    bool operator==(const NodeData &other) const;
 
     double x;
     double y;
@@ -136,11 +144,32 @@ public:
      * @returns true iff successful
      */
     bool loadData(const QUrl &url);
+    /**
+     * Like loadData(const QUrl &), but from a device that is already open,
+     * and without showing any message. This can be used from threads other
+     * than the GUI thread.
+     * @param errorMessage set to what went wrong if this fails
+     */
+    bool loadData(QIODevice *device, QString *errorMessage);
     /**
      * Write the data to the given file.
+     * @param binary whether to use the binary format rather than xml
      * @returns true iff successful
      */
-    bool saveData(const QUrl &url);
+    bool saveData(const QUrl &url, bool binary = false);
+    /**
+     * Like saveData(const QUrl &, bool), but to a device that is already
+     * open, and without showing any message. This can be used from threads
+     * other than the GUI thread.
+     */
+    bool saveData(QIODevice *device, bool binary);
+    /**
+     * @return whether the file read by loadData was in the binary format.
+     */
+    bool isBinaryFormat() const
+    {
+        return m_bBinaryFormat;
+    }
     /**
      * Returns the xml used for describing the data
      */
@@ -202,38 +231,204 @@ public:
     void addNodeData(NodeData nodeData, QString id);
     // END functions for adding data
 
+    // BEGIN functions for returning data
+    const ItemDataMap &itemDataMap() const
+    {
+        return m_itemDataMap;
+    }
+    /**
+     * The routes of the connectors may not have been read yet (see
+     * loadRoutes); the nodes they connect always have been.
+     */
+    const ConnectorDataMap &connectorDataMap() const
+    {
+        return m_connectorDataMap;
+    }
+    const MicroData &microData() const
+    {
+        return m_microData;
+    }
+    // END functions for returning data
+
+    /**
+     * @return a rough estimate of the heap memory held by the stored data,
+     * in bytes
+     */
+    qint64 memoryUsage() const;
+
     // BEGIN functions for returning strings for saving to xml
     QString documentTypeString() const;
     QString revisionString() const;
     // END functions for returning strings for saving to xml
 
 protected:
-    // BEGIN functions for generating QDomElements
-    QDomElement microDataToElement(QDomDocument &doc);
-    QDomElement itemDataToElement(QDomDocument &doc, const ItemData &itemData);
-    QDomElement nodeDataToElement(QDomDocument &doc, const NodeData &nodeData);
-    QDomElement connectorDataToElement(QDomDocument &doc, const ConnectorData &connectorData);
-    // END functions for generating QDomElements
-
-    // BEGIN functions for reading QDomElements to stored data
-    void elementToMicroData(QDomElement element);
-    void elementToItemData(QDomElement element);
-    void elementToNodeData(QDomElement element);
-    void elementToConnectorData(QDomElement element);
-    // END functions for reading QDomElements to stored data
+    /**
+     * Reads the document from reader, an element at a time.
+     * @param errorMessage set to what went wrong if this fails
+     * @return true if successful
+     */
+    bool readXML(QXmlStreamReader &reader, QString *errorMessage);
+    /**
+     * Writes the document to writer, an element at a time.
+     */
+    void writeXML(QXmlStreamWriter &writer);
+
+    /**
+     * Reads the document in the binary format: a header, an index of the
+     * sections, and the sections. The connector routes are kept as they
+     * are read until they are needed.
+     * @return true if successful
+     */
+    bool readBinary(QIODevice *device, QString *errorMessage);
+    /**
+     * Writes the document in the binary format.
+     * @return true if successful
+     */
+    bool writeBinary(QIODevice *device);
+    QByteArray routeSection() const;
+    /**
+     * Puts the routes from the route section (if there is one that has not
+     * been read yet) into the connector data. This must be done before the
+     * connectors are used or changed.
+     */
+    void loadRoutes();
+    QByteArray microSection() const;
+    bool readMicroSection(const QByteArray &bytes);
+
+    // BEGIN functions for writing xml elements
+    void writeMicroData(QXmlStreamWriter &writer);
+    void writeItemData(QXmlStreamWriter &writer, const QString &id, const ItemData &itemData);
+    void writeNodeData(QXmlStreamWriter &writer, const QString &id, const NodeData &nodeData);
+    void writeConnectorData(QXmlStreamWriter &writer, const QString &id, const ConnectorData &connectorData);
+    // END functions for writing xml elements
+
+    // BEGIN functions for reading xml elements to stored data
+    /**
+     * Each of these is called with reader at the start of the element, and
+     * leaves it at the end.
+     */
+    void readMicroData(QXmlStreamReader &reader);
+    /**
+     * @param parentId the item that this is nested in (in the old format)
+     */
+    void readItemData(QXmlStreamReader &reader, const QString &parentId = QString());
+    void readNodeData(QXmlStreamReader &reader);
+    void readConnectorData(QXmlStreamReader &reader);
+    // END functions for reading xml elements to stored data
 
     ItemDataMap m_itemDataMap;
     ConnectorDataMap m_connectorDataMap;
     NodeDataMap m_nodeDataMap;
     MicroData m_microData;
     uint m_documentType; // See Document::DocumentType
+    QByteArray m_routeSection; // Connector routes not read yet
+    bool m_bBinaryFormat;
+
+    friend class ItemDocumentDelta;
+};
+
+/**
+The changes that take an ItemDocumentData from one state of a document to
+another. The undo / redo history of ItemDocument is kept as these, so only
+the current state of the document is stored in full.
+*/
+class ItemDocumentDelta
+{
+public:
+    /**
+     * Records what has to be changed in from to give to.
+     * @param state the number of the state (as given by ItemDocument) that
+     * to is of
+     */
+    ItemDocumentDelta(const ItemDocumentData &from, const ItemDocumentData &to, int state);
+    /**
+     * Makes the changes to data, which must hold the state this was made
+     * from.
+     * @param dataState the number of the state in data before the changes
+     * @return the changes that take data back again
+     */
+    ItemDocumentDelta *apply(ItemDocumentData *data, int dataState) const;
+    /**
+     * @return the number of the state that apply gives
+     */
+    int state() const
+    {
+        return m_state;
+    }
+    /**
+     * @return a rough estimate of the heap memory held by the delta, in bytes
+     */
+    qint64 memoryUsage() const;
+
+protected:
+    ItemDocumentDelta(int state);
+
+    ItemDataMap m_changedItems;
+    ConnectorDataMap m_changedConnectors;
+    NodeDataMap m_changedNodes;
+    QStringList m_removedItems;
+    QStringList m_removedConnectors;
+    QStringList m_removedNodes;
+    MicroData m_microData; // Not compared, as it is small
+    int m_state;
+};
+
+/**
+What ItemDocument puts on the clipboard when copying. Pasting in the same
+process takes a copy of the data as it is, and the xml is only written if
+something else asks for the clipboard text (such as another program).
+*/
+class ItemDocumentMimeData : public QMimeData
+{
+public:
+    ItemDocumentMimeData(const ItemDocumentData &data);
+
+    /**
+     * @return the data that was copied
+     */
+    const ItemDocumentData &documentData() const
+    {
+        return m_data;
+    }
+
+    bool hasFormat(const QString &mimeType) const override;
+    QStringList formats() const override;
+
+protected:
+    QVariant retrieveData(const QString &mimeType, QVariant::Type type) const override;
+
+    mutable ItemDocumentData m_data;
+    mutable QString m_xml;
 };
 
 class SubcircuitData : public ItemDocumentData
 {
 public:
     SubcircuitData();
+    /**
+     * Takes the External Connections out of the data, recording them as the
+     * pins of the subcircuit. This only needs doing once for the subcircuit
+     * (it is done by initECSubcircuit if it has not been), so that copies can
+     * be used as a template for each instance of it.
+     */
+    void compile();
+    /**
+     * Creates the contents of the subcircuit in the document of
+     * ecSubcircuit, and attaches them to it.
+     */
     void initECSubcircuit(ECSubcircuit *ecSubcircuit);
+
+protected:
+    /**
+     * Joins the pins of the components in the subcircuit (and of
+     * ecSubcircuit) with wires as the connectors would, but without creating
+     * the connectors and junction nodes. Pins that the connectors join
+     * through junctions are wired to the first pin of the group.
+     */
+    void createFlattenedWires(ECSubcircuit *ecSubcircuit);
+
+    QVector<QString> m_extConNames; // Indexed by pin
+    bool m_bCompiled;
 };
 
 #endif
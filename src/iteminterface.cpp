@@ -490,34 +490,38 @@ void ItemInterface::tbDataChanged()
         return;
     }
     BoolLock inTbChangedLock(&m_isInTbDataChanged);
+
+    // All the values are set at once
+    QVariantMap data;
+
     // Manual string values
     const KLineEditMap::iterator m_stringLineEditMapEnd = m_stringLineEditMap.end();
     for (KLineEditMap::iterator leit = m_stringLineEditMap.begin(); leit != m_stringLineEditMapEnd; ++leit) {
-        slotSetData(leit.key(), leit.value()->text());
+        data[leit.key()] = leit.value()->text();
     }
 
     // String values from comboboxes
     const KComboBoxMap::iterator m_stringComboBoxMapEnd = m_stringComboBoxMap.end();
     for (KComboBoxMap::iterator cmit = m_stringComboBoxMap.begin(); cmit != m_stringComboBoxMapEnd; ++cmit) {
         qCDebug(KTL_LOG) << "set KCombo data for " << cmit.key() << " to " << cmit.value()->currentText();
-        slotSetData(cmit.key(), cmit.value()->currentText());
+        data[cmit.key()] = cmit.value()->currentText();
     }
 
     // Colors values from colorcombos
     const KColorComboMap::iterator m_colorComboMapEnd = m_colorComboMap.end();
     for (KColorComboMap::iterator ccit = m_colorComboMap.begin(); ccit != m_colorComboMapEnd; ++ccit) {
-        slotSetData(ccit.key(), ccit.value()->color());
+        data[ccit.key()] = ccit.value()->color();
     }
 
     // Bool values from checkboxes
     const QCheckBoxMap::iterator m_boolCheckMapEnd = m_boolCheckMap.end();
     for (QCheckBoxMap::iterator chit = m_boolCheckMap.begin(); chit != m_boolCheckMapEnd; ++chit) {
-        slotSetData(chit.key(), chit.value()->isChecked());
+        data[chit.key()] = chit.value()->isChecked();
     }
 
     const IntSpinBoxMap::iterator m_intSpinBoxMapEnd = m_intSpinBoxMap.end();
     for (IntSpinBoxMap::iterator it = m_intSpinBoxMap.begin(); it != m_intSpinBoxMapEnd; ++it) {
-        slotSetData(it.key(), it.value()->value());
+        data[it.key()] = it.value()->value();
     }
 
     // (?) Combined values from spin boxes and combo boxes
@@ -526,7 +530,7 @@ void ItemInterface::tbDataChanged()
     const DoubleSpinBoxMap::iterator m_doubleSpinBoxMapEnd = m_doubleSpinBoxMap.end();
     for (DoubleSpinBoxMap::iterator sbit = m_doubleSpinBoxMap.begin(); sbit != m_doubleSpinBoxMapEnd; ++sbit) {
         // 		VariantDataMap::iterator vait = variantData.find(sbit.key());
-        slotSetData(sbit.key(), sbit.value()->value());
+        data[sbit.key()] = sbit.value()->value();
     }
 
     // Filenames from KUrlRequesters
@@ -535,11 +539,10 @@ void ItemInterface::tbDataChanged()
         qCDebug(KTL_LOG) << "set kurlrequester data for " << urlit.key() << " to " << urlit.value()->url();
         QVariant urlVar(urlit.value()->url().path());
         qCDebug(KTL_LOG) << "urlVar=" << urlVar << " urlVar.toUrl=" << urlVar.toUrl();
-        slotSetData(urlit.key(), urlVar);
+        data[urlit.key()] = urlVar;
     }
 
-    if (p_cvb)
-        p_cvb->setModified(true);
+    setData(data);
 }
 
 void ItemInterface::setProperty(Variant *v)
@@ -548,6 +551,13 @@ void ItemInterface::setProperty(Variant *v)
 }
 
 void ItemInterface::slotSetData(const QString &id, QVariant value)
+{
+    QVariantMap data;
+    data[id] = value;
+    setData(data);
+}
+
+void ItemInterface::setData(const QVariantMap &data)
 {
     if (!p_itemGroup || (p_itemGroup->itemCount() == 0)) {
         qCDebug(KTL_LOG) << "p_itemGroup not valid:" << p_itemGroup;
@@ -558,22 +568,40 @@ void ItemInterface::slotSetData(const QString &id, QVariant value)
         qCDebug(KTL_LOG) << "Items are not the same type!";
         return;
     }
-    qCDebug(KTL_LOG) << "id=" << id << " value=" << value;
+    qCDebug(KTL_LOG) << "data=" << data;
+
+    // Until the end, the circuit reassignment and the document events (such
+    // as repainting) asked for by the items are only collected
+    if (p_cvb)
+        p_cvb->beginBulkLoad();
 
     const ItemList itemList = p_itemGroup->items(true);
     const ItemList::const_iterator end = itemList.end();
+    for (ItemList::const_iterator it = itemList.begin(); it != end; ++it) {
+        if (!*it)
+            continue;
+        for (QVariantMap::const_iterator dit = data.begin(); dit != data.end(); ++dit)
+            (*it)->property(dit.key())->setValue(dit.value());
+    }
+
+    // The items would otherwise each act on the changes from a timer of their
+    // own, after the end
     for (ItemList::const_iterator it = itemList.begin(); it != end; ++it) {
         if (*it)
-            (*it)->property(id)->setValue(value);
+            (*it)->applyPropertyChanges();
     }
 
+    if (p_cvb)
+        p_cvb->endBulkLoad();
+
     if (p_cvb)
         p_cvb->setModified(true);
 
     ItemEditor::self()->itemGroupUpdated(p_itemGroup);
 
+    // Stepping a spin box saves the state once, when the stepping stops
     if (p_cvb)
-        p_cvb->requestStateSave(m_currentActionTicket);
+        p_cvb->requestCoalescedStateSave(QString("properties:%1").arg(m_currentActionTicket), m_currentActionTicket);
 }
 
 #include "moc_iteminterface.cpp"
@@ -13,6 +13,7 @@
 
 #include <QMap>
 #include <QPointer>
+#include <QVariantMap>
 
 #include "itemgroup.h"
 
@@ -88,6 +89,13 @@ public slots:
      * Else, it only sets the data for the activeCNItem()
      */
     void slotSetData(const QString &id, QVariant value);
+    /**
+     * As slotSetData, for several properties (mapped from their ids) at
+     * once. The items are all changed before the circuits are reassigned
+     * and the document updated, which is then done once, as is the saving
+     * of the undo state.
+     */
+    void setData(const QVariantMap &data);
     /**
      * Essentially the same as slotSetData.
      */
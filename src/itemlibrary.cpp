@@ -107,6 +107,7 @@
 #include "ecbcdto7segment.h"
 #include "ecbjt.h"
 #include "ecclockinput.h"
+#include "eclogicwaveform.h"
 #include "eccurrentsignal.h"
 #include "eccurrentsource.h"
 #include "ecdiode.h"
@@ -134,13 +135,10 @@
 KLocalizedString ItemLibrary::m_emptyItemDescription = ki18n("This help item does not yet exist for the %1 language. Help out with KTechlab by creating one via the \"Edit\" button.");
 
 ItemLibrary::ItemLibrary()
+    : m_addedTypes(0)
 {
-    addFlowParts();
-    addComponents();
-    addMechanics();
-    addDrawParts();
-
-    loadItemDescriptions();
+    // The items and descriptions are added when they are first needed, to
+    // not hold up starting
 }
 
 ItemLibrary::~ItemLibrary()
@@ -151,6 +149,43 @@ ItemLibrary::~ItemLibrary()
     m_items.clear();
 }
 
+void ItemLibrary::addItems(int type)
+{
+    switch (type) {
+    case LibraryItem::lit_flowpart:
+    case LibraryItem::lit_component:
+    case LibraryItem::lit_mechanical:
+    case LibraryItem::lit_drawpart:
+        break;
+
+    default:
+        addItems(LibraryItem::lit_flowpart);
+        addItems(LibraryItem::lit_component);
+        addItems(LibraryItem::lit_mechanical);
+        addItems(LibraryItem::lit_drawpart);
+        return;
+    }
+
+    if (m_addedTypes & (1 << type))
+        return;
+    m_addedTypes |= (1 << type);
+
+    switch (type) {
+    case LibraryItem::lit_flowpart:
+        addFlowParts();
+        break;
+    case LibraryItem::lit_component:
+        addComponents();
+        break;
+    case LibraryItem::lit_mechanical:
+        addMechanics();
+        break;
+    case LibraryItem::lit_drawpart:
+        addDrawParts();
+        break;
+    }
+}
+
 void ItemLibrary::addFlowParts()
 {
     // Container loops
@@ -226,6 +261,7 @@ void ItemLibrary::addComponents()
     addLibraryItem(Inverter::libraryItem());
     addLibraryItem(Buffer::libraryItem());
     addLibraryItem(ECClockInput::libraryItem());
+    addLibraryItem(ECLogicWaveform::libraryItem());
     addLibraryItem(ECLogicOutput::libraryItem());
     addLibraryItem(ECLogicInput::libraryItem());
 
@@ -315,20 +351,59 @@ void ItemLibrary::addLibraryItem(LibraryItem *item)
     m_items.prepend(item);
 }
 
-LibraryItem *ItemLibrary::libraryItem(QString type) const
+LibraryItemList *ItemLibrary::items()
+{
+    addItems(LibraryItem::lit_other);
+    return &m_items;
+}
+
+LibraryItemList ItemLibrary::items(int type)
+{
+    addItems(type);
+
+    LibraryItemList items;
+    const LibraryItemList::const_iterator end = m_items.constEnd();
+    for (LibraryItemList::const_iterator it = m_items.constBegin(); it != end; ++it) {
+        if ((*it)->type() == type)
+            items << *it;
+    }
+    return items;
+}
+
+LibraryItem *ItemLibrary::libraryItem(QString type)
 {
     if (type.startsWith(QString::fromLatin1("/"))) {
         // Possibly change e.g. "/ec/capacitor" to "ec/capacitor"
         type.remove(0, 1);
     }
 
-    LibraryItemList::const_iterator end = m_items.end();
-    LibraryItemList::const_iterator it = m_items.begin();
-    for (; it != end; ++it) {
-        if ((*it)->allIDs().contains(type))
-            return *it;
-    }
-    return nullptr;
+    auto find = [this, &type]() -> LibraryItem * {
+        LibraryItemList::const_iterator end = m_items.constEnd();
+        LibraryItemList::const_iterator it = m_items.constBegin();
+        for (; it != end; ++it) {
+            if ((*it)->allIDs().contains(type))
+                return *it;
+        }
+        return nullptr;
+    };
+
+    // The start of the id says which items it is among, so usually only
+    // those have to be added
+    const QString prefix = type.section('/', 0, 0);
+    if (prefix == QLatin1String("ec"))
+        addItems(LibraryItem::lit_component);
+    else if (prefix == QLatin1String("flow"))
+        addItems(LibraryItem::lit_flowpart);
+    else if (prefix == QLatin1String("dp"))
+        addItems(LibraryItem::lit_drawpart);
+    else if (prefix == QLatin1String("mech"))
+        addItems(LibraryItem::lit_mechanical);
+
+    if (LibraryItem *item = find())
+        return item;
+
+    addItems(LibraryItem::lit_other);
+    return find();
 }
 
 Item *ItemLibrary::createItem(const QString &id, ItemDocument *itemDocument, bool newItem, const char *newId, bool finishCreation)
@@ -522,7 +597,7 @@ bool ItemLibrary::saveDescriptions(const QString &languageCode)
 
     QTextStream stream(&file);
 
-    const QStringMap itemDescriptions = m_itemDescriptions[languageCode];
+    const QStringMap itemDescriptions = descriptions(languageCode);
     for (auto descIt = itemDescriptions.begin(), end = itemDescriptions.end(); descIt != end; ++descIt) {
         stream << QString::fromLatin1("<!-- item: %1 -->\n").arg(descIt.key());
         stream << descIt.value() << Qt::endl;
@@ -533,32 +608,33 @@ bool ItemLibrary::saveDescriptions(const QString &languageCode)
     return true;
 }
 
-bool ItemLibrary::haveDescription(QString type, const QString &languageCode) const
+bool ItemLibrary::haveDescription(QString type, const QString &languageCode)
 {
     if (type.startsWith(QString::fromLatin1("/"))) {
         // Possibly change e.g. "/ec/capacitor" to "ec/capacitor"
         type.remove(0, 1);
     }
 
-    if (!m_itemDescriptions[languageCode].contains(type)) {
+    const QStringMap &itemDescriptions = descriptions(languageCode);
+    if (!itemDescriptions.contains(type)) {
         return libraryItem(type);
     }
 
-    return !m_itemDescriptions[languageCode][type].isEmpty();
+    return !itemDescriptions[type].isEmpty();
 }
 
-QString ItemLibrary::description(QString type, const QString &languageCode) const
+QString ItemLibrary::description(QString type, const QString &languageCode)
 {
     if (type.startsWith(QString::fromLatin1("/"))) {
         // Possibly change e.g. "/ec/capacitor" to "ec/capacitor"
         type.remove(0, 1);
     }
 
-    QString current = m_itemDescriptions[languageCode][type];
+    QString current = descriptions(languageCode).value(type);
 
     if (current.isEmpty()) {
         // Try english-language description
-        current = m_itemDescriptions[QString::fromLatin1("en_US")][type];
+        current = descriptions(QString::fromLatin1("en_US")).value(type);
         if (current.isEmpty())
             return emptyItemDescription(languageCode);
     }
@@ -579,6 +655,7 @@ bool ItemLibrary::setDescription(QString type, const QString &description, const
         type.remove(0, 1);
     }
 
+    descriptions(languageCode);
     m_itemDescriptions[languageCode][type] = description;
     return saveDescriptions(languageCode);
 }
@@ -622,58 +699,64 @@ QString ItemLibrary::itemDescriptionsFile(const QString &languageCode) const
     return url;
 }
 
-void ItemLibrary::loadItemDescriptions()
+QStringList ItemLibrary::descriptionLanguages()
 {
-    // Create an entry for the default language (American English)
-    // and the current language
-    //     KLocale * locale = KLocale::global();
-    // 	m_itemDescriptions[ locale->defaultLanguage() ];
-    // 	m_itemDescriptions[ locale->language() ];
-
-    m_itemDescriptions[QLocale().name()];
-
-    const QStringList languages = descriptionLanguages();
-    QStringList::const_iterator end = languages.end();
-    for (QStringList::const_iterator it = languages.begin(); it != end; ++it) {
-        QString url = itemDescriptionsFile(*it);
-
-        QFile file(url);
-        if (!file.open(QIODevice::ReadOnly)) {
-            qCWarning(KTL_LOG) << "Could not open file \"" << url << "\"";
-            continue;
-        }
+    descriptions(QLocale().name());
+    return m_itemDescriptions.keys();
+}
 
-        QTextStream stream(&file);
-
-        QString type;
-        QString description;
-        while (!stream.atEnd()) {
-            QString line = stream.readLine();
-            if (line.startsWith(QString::fromLatin1("<!-- item: "))) {
-                // Save the previous description
-                if (!type.isEmpty())
-                    m_itemDescriptions[*it][type] = description.trimmed();
-
-                line.remove(QString::fromLatin1("<!-- item: "));
-                line.remove(QString::fromLatin1(" -->"));
-
-                type = line.trimmed();
-                if (type.startsWith(QString::fromLatin1("/"))) {
-                    // Possibly change e.g. "/ec/capacitor" to "ec/capacitor"
-                    type.remove(0, 1);
-                }
-
-                description = QString();
-            } else
-                description += line + '\n';
-        }
+const QStringMap &ItemLibrary::descriptions(const QString &languageCode)
+{
+    QStringMapMap::iterator it = m_itemDescriptions.find(languageCode);
+    if (it == m_itemDescriptions.end())
+        it = m_itemDescriptions.insert(languageCode, loadItemDescriptions(languageCode));
+    return *it;
+}
+
+QStringMap ItemLibrary::loadItemDescriptions(const QString &languageCode) const
+{
+    QStringMap itemDescriptions;
+
+    QString url = itemDescriptionsFile(languageCode);
+
+    QFile file(url);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(KTL_LOG) << "Could not open file \"" << url << "\"";
+        return itemDescriptions;
+    }
+
+    QTextStream stream(&file);
 
-        // Save the previous description
-        if (!type.isEmpty())
-            m_itemDescriptions[*it][type] = description.trimmed();
+    QString type;
+    QString description;
+    while (!stream.atEnd()) {
+        QString line = stream.readLine();
+        if (line.startsWith(QString::fromLatin1("<!-- item: "))) {
+            // Save the previous description
+            if (!type.isEmpty())
+                itemDescriptions[type] = description.trimmed();
+
+            line.remove(QString::fromLatin1("<!-- item: "));
+            line.remove(QString::fromLatin1(" -->"));
+
+            type = line.trimmed();
+            if (type.startsWith(QString::fromLatin1("/"))) {
+                // Possibly change e.g. "/ec/capacitor" to "ec/capacitor"
+                type.remove(0, 1);
+            }
 
-        file.close();
+            description = QString();
+        } else
+            description += line + '\n';
     }
+
+    // Save the previous description
+    if (!type.isEmpty())
+        itemDescriptions[type] = description.trimmed();
+
+    file.close();
+
+    return itemDescriptions;
 }
 
 #include "moc_itemlibrary.cpp"
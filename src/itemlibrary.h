@@ -45,16 +45,19 @@ public:
      */
     void addLibraryItem(LibraryItem *item);
     /**
-     * Returns a list of items in the library
+     * Returns a list of all the items in the library
      */
-    LibraryItemList *items()
-    {
-        return &m_items;
-    }
+    LibraryItemList *items();
     /**
-     * @return the LibraryItem for the item with the given type (id) const.
+     * @return the items in the library of the given LibraryItem::Type. Only
+     * those of the type are added to the library if they have not been
+     * already, so opening one selector does not need the items of the others.
      */
-    LibraryItem *libraryItem(QString type) const;
+    LibraryItemList items(int type);
+    /**
+     * @return the LibraryItem for the item with the given type (id).
+     */
+    LibraryItem *libraryItem(QString type);
     /**
      * Creates a new item with the given id, and returns a pointer to it
      */
@@ -75,11 +78,11 @@ public:
      * @param type the id of the item.
      * @param language the language code, e.g. "es".
      */
-    QString description(QString type, const QString &language) const;
+    QString description(QString type, const QString &language);
     /**
      * @return if we have a description for the item in language.
      */
-    bool haveDescription(QString type, const QString &language) const;
+    bool haveDescription(QString type, const QString &language);
     /**
      * Gives the type item the description.
      * @param type the type of item this description is for.
@@ -108,12 +111,10 @@ public:
      */
     QString emptyItemDescription(const QString &language) const;
     /**
-     * @return the list of language-codes that have item descriptions.
+     * @return the list of language-codes that have item descriptions (the
+     * current language, and any others whose descriptions have been read).
      */
-    QStringList descriptionLanguages() const
-    {
-        return m_itemDescriptions.keys();
-    }
+    QStringList descriptionLanguages();
 
 protected:
     /**
@@ -122,7 +123,21 @@ protected:
      * writing).
      */
     bool saveDescriptions(const QString &language);
-    void loadItemDescriptions();
+    /**
+     * @return the item descriptions for the language, read from its file
+     * the first time they are asked for.
+     */
+    const QStringMap &descriptions(const QString &language);
+    /**
+     * Reads the item descriptions file for the language.
+     */
+    QStringMap loadItemDescriptions(const QString &language) const;
+    /**
+     * Adds the items of the given LibraryItem::Type to the library, unless
+     * they have been already. Items of other types (such as lit_other) are
+     * added along with all of the rest.
+     */
+    void addItems(int type);
     void addComponents();
     void addFlowParts();
     void addMechanics();
@@ -131,6 +146,7 @@ protected:
     ItemLibrary();
 
     LibraryItemList m_items;
+    int m_addedTypes; ///< bit (1 << type) for each LibraryItem::Type whose items have been added
     ImageMap m_imageMap;
     QStringMapMap m_itemDescriptions;               // (Language, type) <--> description
     static KLocalizedString m_emptyItemDescription; // Description template for when a description does not yet exist
@@ -20,6 +20,7 @@
 #include "itemdocument.h"
 #include "itemlibrary.h"
 #include "ktechlab.h"
+#include "simulator.h"
 #include "utils.h"
 
 //#include <kaccel.h>
@@ -34,6 +35,8 @@
 #include <QMenu>
 #include <QMimeData>
 #include <QMouseEvent>
+#include <QScopedPointer>
+#include <QScrollBar>
 #include <QTimer>
 #include <QVBoxLayout>
 
@@ -675,6 +678,10 @@ CVBEditor::CVBEditor(Canvas *canvas, ItemView *itemView)
     b_passEventsToView = true;
     p_itemView = itemView;
 
+    // Falls back to drawing without OpenGL if there is none to be had
+    if (KTLConfig::openGLCanvas())
+        enableOpenGL();
+
     setMouseTracking(true);
     viewport()->setMouseTracking(true);
     setAcceptDrops(true);
@@ -725,19 +732,20 @@ void CVBEditor::updateWorldMatrix()
 
 void CVBEditor::contentsWheelEvent(QWheelEvent *e)
 {
-    QWheelEvent ce(viewport()->mapFromGlobal(e->globalPosition().toPoint()),
-                    e->globalPosition(),
-                    e->pixelDelta(),
-                    e->angleDelta(),
-                    e->buttons(),
-                    e->modifiers(),
-                    e->phase(),
-                    e->inverted());
+    if (!e->pixelDelta().isNull()) {
+        // Touchpads say how far to scroll in pixels, with many small events
+        scrollBy(-e->pixelDelta().x(), -e->pixelDelta().y());
+        return;
+    }
 
-    if ((e->angleDelta().x() != 0) && horizontalScrollBar())
-        QApplication::sendEvent(horizontalScrollBar(), e);
-    else if ((e->angleDelta().y() != 0) && verticalScrollBar())
-        QApplication::sendEvent(verticalScrollBar(), e);
+    // A notch of the wheel (120) scrolls as many lines of the scroll bars as
+    // configured for the application, over a few frames rather than in one
+    // jump. Mice with finer wheels send a part of a notch at a time.
+    const int lines = QApplication::wheelScrollLines();
+    const QPoint angle = e->angleDelta();
+    const int dx = horizontalScrollBar() ? -angle.x() * lines * horizontalScrollBar()->singleStep() / 120 : 0;
+    const int dy = verticalScrollBar() ? -angle.y() * lines * verticalScrollBar()->singleStep() / 120 : 0;
+    smoothScrollBy(dx, dy);
 
 #if 0
 	if ( b_ignoreEvents )
@@ -748,8 +756,38 @@ void CVBEditor::contentsWheelEvent(QWheelEvent *e)
 #endif
 }
 
+/**
+ * @return whether handling the event may edit the items of the document, and
+ * so the circuits being simulated
+ */
+static bool editsItems(QEvent::Type type)
+{
+    switch (type) {
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonRelease:
+    case QEvent::MouseButtonDblClick:
+    case QEvent::MouseMove:
+    case QEvent::DragEnter:
+    case QEvent::DragMove:
+    case QEvent::DragLeave:
+    case QEvent::Drop:
+    case QEvent::KeyPress:
+    case QEvent::KeyRelease:
+        return true;
+    default:
+        return false;
+    }
+}
+
 bool CVBEditor::event(QEvent *e)
 {
+    // Painting only reads what the document has published for it (see
+    // Component::publishDisplayState), so just the events that edit the
+    // items wait for the simulation
+    QScopedPointer<SimulationLocker> locker;
+    if (editsItems(e->type()))
+        locker.reset(new SimulationLocker());
+
     if (!b_passEventsToView) {
         bool isWheel = e->type() == QEvent::Wheel;
         if (isWheel && b_ignoreEvents)
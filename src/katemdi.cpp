@@ -168,6 +168,11 @@ void ToolView::setVisibleToolView(bool vis)
         return;
 
     m_visible = vis;
+    if (m_visible && m_contentFactory) {
+        const std::function<void(ToolView *)> factory = m_contentFactory;
+        m_contentFactory = nullptr;
+        factory(this);
+    }
     emit visibleChanged(m_visible);
 }
 
@@ -176,6 +181,15 @@ bool ToolView::visible() const
     return m_visible;
 }
 
+void ToolView::setContentFactory(const std::function<void(ToolView *)> &factory)
+{
+    if (m_visible) {
+        factory(this);
+        return;
+    }
+    m_contentFactory = factory;
+}
+
 void ToolView::childEvent(QChildEvent *ev)
 {
     // set the widget to be focus proxy if possible
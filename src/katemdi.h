@@ -31,6 +31,8 @@
 #include <QMap>
 #include <QSplitter>
 
+#include <functional>
+
 class QAction;
 
 namespace KateMDI
@@ -130,6 +132,13 @@ protected:
 public:
     bool visible() const;
 
+    /**
+     * Defer making the contents of this toolview until it is first shown;
+     * @p factory is then called once with this toolview as the parent. If
+     * the toolview is already visible, the contents are made now.
+     */
+    void setContentFactory(const std::function<void(ToolView *)> &factory);
+
 protected:
     void childEvent(QChildEvent *ev) override;
 
@@ -137,6 +146,11 @@ private:
     MainWindow *m_mainWin;
     Sidebar *m_sidebar;
 
+    /**
+     * makes the contents on first show, empty once they exist
+     */
+    std::function<void(ToolView *)> m_contentFactory;
+
     /**
      * unique id
      */
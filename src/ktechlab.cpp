@@ -24,12 +24,18 @@
 #include "ktechlab.h"
 #include "languagemanager.h"
 #include "mechanicsdocument.h"
+#include "memoryview.h"
 #include "microlibrary.h"
 #include "newfiledlg.h"
 #include "oscilloscope.h"
 #include "projectmanager.h"
 #include "scopescreen.h"
 #include "settingsdlg.h"
+#include "simulationstatsview.h"
+#include "simulator.h"
+#include "stallwatch.h"
+#include "stallwatchview.h"
+#include "startuptrace.h"
 #include "subcircuits.h"
 #include "symbolviewer.h"
 #include "textdocument.h"
@@ -41,8 +47,8 @@
 #include <QToolButton>
 // #include <q3ptrlist.h>
 #include <QDesktopWidget>
-#include <QElapsedTimer>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QIcon>
 #include <QMenu>
 #include <QMimeData>
@@ -61,6 +67,7 @@
 //#include <kpopupmenu.h>
 //#include <kwin.h>
 #include <KRecentFilesAction>
+#include <KSelectAction>
 #include <KShortcutsDialog>
 #include <KStandardAction>
 #include <KToolBarPopupAction>
@@ -72,16 +79,19 @@
 
 KTechlab *KTechlab::m_pSelf = nullptr;
 
+/// Speed multipliers offered by the "simulation_speed" action, followed by "As Fast as Possible"
+static const double simulationSpeeds[] = {0.1, 0.25, 0.5, 1.0, 2.0, 5.0, 10.0};
+static const int simulationSpeedCount = sizeof(simulationSpeeds) / sizeof(simulationSpeeds[0]);
+static const int simulationSpeedDefault = 3;
+
 KTechlab::KTechlab()
     : KateMDI::MainWindow(nullptr)
 {
     setObjectName("KTechlab");
     m_pSelf = this;
 
-    QElapsedTimer ct;
-    ct.start();
-
     m_bIsShown = false;
+    m_deferredLoadStep = 0;
     m_pContainerDropSource = nullptr;
     m_pContainerDropReceived = nullptr;
     m_pContextMenuContainer = nullptr;
@@ -98,15 +108,30 @@ KTechlab::KTechlab()
 
     setMinimumSize(400, 400);
 
-    setupTabWidget();
-    setupToolDocks();
-    setupActions();
-    setupView();
-    // readProperties( KGlobal::config() );
-    KSharedConfigPtr cfg = KSharedConfig::openConfig();
-    readPropertiesInConfig(cfg.data());
+    StallWatch::install();
 
-    // 	qCDebug(KTL_LOG) << "Constructor time: " << ct.elapsed();
+    {
+        StartupTrace::Phase phase("Tab widget");
+        setupTabWidget();
+    }
+    {
+        StartupTrace::Phase phase("Tool views");
+        setupToolDocks();
+    }
+    {
+        StartupTrace::Phase phase("Actions");
+        setupActions();
+    }
+    {
+        StartupTrace::Phase phase("XML GUI");
+        setupView();
+    }
+    {
+        StartupTrace::Phase phase("Restore properties");
+        // readProperties( KGlobal::config() );
+        KSharedConfigPtr cfg = KSharedConfig::openConfig();
+        readPropertiesInConfig(cfg.data());
+    }
 }
 
 KTechlab::~KTechlab()
@@ -126,9 +151,41 @@ KTechlab::~KTechlab()
 void KTechlab::show()
 {
     KateMDI::MainWindow::show();
+
+    if (!m_bIsShown) {
+        QTimer::singleShot(0, this, &KTechlab::slotLoadDeferred);
+        QTimer::singleShot(0, DocManager::self(), &DocManager::recoverAutoSaves);
+    }
     m_bIsShown = true;
 }
 
+void KTechlab::slotLoadDeferred()
+{
+    // One library per call, so that events are handled in between
+    switch (m_deferredLoadStep++) {
+    case 0: {
+        StartupTrace::Phase phase("Subcircuits");
+        Subcircuits::loadSubcircuits();
+        break;
+    }
+    case 1: {
+        StartupTrace::Phase phase("Item library");
+        itemLibrary()->items();
+        break;
+    }
+    case 2: {
+        StartupTrace::Phase phase("Micro library");
+        MicroLibrary::self();
+        break;
+    }
+    default:
+        StartupTrace::finish();
+        return;
+    }
+
+    QTimer::singleShot(0, this, &KTechlab::slotLoadDeferred);
+}
+
 void KTechlab::openFile(ViewArea *viewArea)
 {
     const QList<QUrl> files = getFileURLs(false);
@@ -190,9 +247,9 @@ void KTechlab::setupToolDocks()
     tv->setObjectName("ComponentSelector-ToolView");
     ComponentSelector::self(tv);
 
-    // Create an instance of the subcircuits interface, now that we have created the component selector
+    // Create an instance of the subcircuits interface, now that we have created the
+    // component selector (the subcircuits themselves are added in slotLoadDeferred)
     subcircuits();
-    Subcircuits::loadSubcircuits();
 
     tv = createToolView(FlowPartSelector::toolViewIdentifier(), KMultiTabBar::Left, QIcon::fromTheme("flowcode"), i18n("Flow Parts"));
     tv->setObjectName("FlowPartSelector-ToolView");
@@ -216,6 +273,26 @@ void KTechlab::setupToolDocks()
     tv->setObjectName("LanguageManager-ToolView");
     LanguageManager::self(tv);
 
+    // The diagnostic views below are only made when first shown; nothing
+    // else uses them, so they cost nothing until asked for
+    tv = createToolView(SimulationStatsView::toolViewIdentifier(), KMultiTabBar::Bottom, QIcon::fromTheme("view-statistics"), i18n("Simulation Statistics"));
+    tv->setObjectName("SimulationStatsView-ToolView");
+    tv->setContentFactory([](KateMDI::ToolView *parent) {
+        SimulationStatsView::self(parent);
+    });
+
+    tv = createToolView(StallWatchView::toolViewIdentifier(), KMultiTabBar::Bottom, QIcon::fromTheme("chronometer"), i18n("GUI Stalls"));
+    tv->setObjectName("StallWatchView-ToolView");
+    tv->setContentFactory([](KateMDI::ToolView *parent) {
+        StallWatchView::self(parent);
+    });
+
+    tv = createToolView(MemoryView::toolViewIdentifier(), KMultiTabBar::Bottom, QIcon::fromTheme("memory"), i18n("Memory"));
+    tv->setObjectName("MemoryView-ToolView");
+    tv->setContentFactory([](KateMDI::ToolView *parent) {
+        MemoryView::self(parent);
+    });
+
 #ifndef NO_GPSIM
     tv = createToolView(SymbolViewer::toolViewIdentifier(), KMultiTabBar::Right, QIcon::fromTheme("blockdevice"), i18n("Symbol Viewer"));
     tv->setObjectName("SymbolViewer-ToolView");
@@ -226,7 +303,9 @@ void KTechlab::setupToolDocks()
 #if 1
     tv = createToolView(ScopeScreen::toolViewIdentifier(), KMultiTabBar::Bottom, QIcon::fromTheme("oscilloscope"), i18n("Scope Screen (Very Rough)"));
     tv->setObjectName("ScopeScreen-ToolView");
-    ScopeScreen::self(tv);
+    tv->setContentFactory([](KateMDI::ToolView *parent) {
+        ScopeScreen::self(parent);
+    });
 #endif
 
     updateSidebarMinimumSizes();
@@ -643,15 +722,78 @@ void KTechlab::setupActions()
         ta->setObjectName("simulation_run");
         ta->setChecked(true);
         connect(ta, &KToggleAction::toggled, Simulator::self(), &Simulator::slotSetSimulating);
+        connect(this, &KTechlab::configurationChanged, Simulator::self(), &Simulator::slotUpdateConfiguration);
         ta->setCheckedState(KGuiItem(i18n("Pause Simulation"), "media-playback-pause", nullptr));
+        connect(Simulator::self(), &Simulator::simulatingStateChanged, ta, &KToggleAction::setChecked);
         ac->addAction(ta->objectName(), ta);
     }
+    {
+        KSelectAction *sa = new KSelectAction(QIcon::fromTheme("media-seek-forward"), i18n("Simulation Speed"), ac);
+        sa->setObjectName("simulation_speed");
+        QStringList items;
+        for (int i = 0; i < simulationSpeedCount; ++i)
+            items << i18n("%1%", int(simulationSpeeds[i] * 100));
+        items << i18n("As Fast as Possible");
+        sa->setItems(items);
+        sa->setCurrentItem(simulationSpeedDefault);
+        connect(sa, qOverload<int>(&KSelectAction::triggered), this, &KTechlab::slotSimulationSpeed);
+        ac->addAction(sa->objectName(), sa);
+    }
+    {
+        QAction *a = new QAction(QIcon::fromTheme("media-skip-forward"), i18n("Run Until..."), ac);
+        a->setObjectName("simulation_run_until");
+        connect(a, &QAction::triggered, this, &KTechlab::slotSimulationRunUntil);
+        connect(Simulator::self(), &Simulator::targetTimeReached, this, &KTechlab::slotSimulationTargetReached);
+        ac->addAction(a->objectName(), a);
+    }
 
     // We can call slotCloseProject now that the actions have been created
     ProjectManager::self()->updateActions();
     DocManager::self()->disableContextActions();
 }
 
+void KTechlab::slotSimulationSpeed(int index)
+{
+    Simulator *simulator = Simulator::self();
+    if (index >= simulationSpeedCount)
+        simulator->setFreeRunning(true);
+    else {
+        simulator->setSpeed(simulationSpeeds[index]);
+        simulator->setFreeRunning(false);
+    }
+}
+
+void KTechlab::slotSimulationRunUntil()
+{
+    Simulator *simulator = Simulator::self();
+    const double now = simulator->time() / double(LOGIC_UPDATE_RATE);
+
+    bool ok = false;
+    const double until = QInputDialog::getDouble(this, i18n("Run Until"), i18n("Run the simulation as fast as possible until the simulated time (in seconds) reaches:"), now + 1.0, now, 1e9, 3, &ok);
+    if (!ok)
+        return;
+
+    simulator->setTargetTime((long long)(until * LOGIC_UPDATE_RATE));
+    simulator->setFreeRunning(true);
+    simulator->slotSetSimulating(true);
+}
+
+void KTechlab::slotSimulationTargetReached()
+{
+    Simulator *simulator = Simulator::self();
+    const double rate = simulator->targetStepRate();
+
+    // Go back to the speed that was selected before running ahead
+    if (KSelectAction *sa = qobject_cast<KSelectAction *>(action("simulation_speed")))
+        slotSimulationSpeed(sa->currentItem());
+    simulator->setTargetTime(-1);
+
+    slotChangeStatusbar(i18n("Simulated time reached %1 s at %2 steps per second (%3 times real time).",
+                             simulator->time() / double(LOGIC_UPDATE_RATE),
+                             qRound(rate),
+                             QString::number(rate / LINEAR_UPDATE_RATE, 'g', 3)));
+}
+
 void KTechlab::setupExampleActions()
 {
     QStringList categories;
@@ -851,7 +993,23 @@ void KTechlab::readPropertiesInConfig(KConfig *conf)
 
         const QStringList groupList = conf->groupList();
         const QStringList::const_iterator groupListEnd = groupList.end();
+
+        // Read the documents of all the views at once first
+        QList<QUrl> urls;
         for (QStringList::const_iterator it = groupList.begin(); it != groupListEnd; ++it) {
+            if (!(*it).startsWith("ViewContainer"))
+                continue;
+
+            const KConfigGroup group = conf->group(*it);
+            const QStringList keys = group.keyList();
+            for (QStringList::const_iterator key = keys.begin(); key != keys.end(); ++key) {
+                if ((*key).endsWith(" file"))
+                    urls << QUrl::fromUserInput(group.readPathEntry(*key, QString()));
+            }
+        }
+        const bool preloaded = DocManager::self()->preloadURLs(urls);
+
+        for (QStringList::const_iterator it = groupList.begin(); it != groupListEnd && preloaded; ++it) {
             if ((*it).startsWith("ViewContainer")) {
                 ViewContainer *viewContainer = new ViewContainer(*it);
 
@@ -862,6 +1020,7 @@ void KTechlab::readPropertiesInConfig(KConfig *conf)
                 addWindow(viewContainer);
             }
         }
+        DocManager::self()->clearPreloadedData();
     }
     // END Restore Open Views
 
@@ -1143,8 +1302,11 @@ void KTechlab::slotFileOpen()
 
     // standard filedialog
     const QList<QUrl> urls = getFileURLs();
-    for (const QUrl &url : urls)
-        load(url);
+    if (DocManager::self()->preloadURLs(urls)) {
+        for (const QUrl &url : urls)
+            load(url);
+    }
+    DocManager::self()->clearPreloadedData();
 }
 
 void KTechlab::addRecentFile(const QUrl &url)
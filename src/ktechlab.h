@@ -227,6 +227,11 @@ private slots:
      */
     void openExample(QAction *);
     void slotViewContainerDestroyed(QObject *obj);
+    /**
+     * Loads what is not needed to show the main window, a step at a time,
+     * once it has been shown. Finishes the startup trace at the end.
+     */
+    void slotLoadDeferred();
 
     // Editing operations
     void slotEditUndo();
@@ -251,6 +256,21 @@ private slots:
     void slotOptionsConfigureToolbars();
     void slotOptionsPreferences();
     void slotLoadRecent(const QUrl &url);
+    /**
+     * Sets the simulation speed from the index of the chosen item in the
+     * "simulation_speed" action (the last item being free-running).
+     */
+    void slotSimulationSpeed(int index);
+    /**
+     * Asks for a simulated time, and runs the simulation as fast as possible
+     * until it is reached.
+     */
+    void slotSimulationRunUntil();
+    /**
+     * Restores the selected simulation speed, and reports how fast the
+     * simulation ran to get there.
+     */
+    void slotSimulationTargetReached();
 
 private:
     void setupActions();
@@ -268,6 +288,7 @@ private:
     QList<KXMLGUIClient *> m_noRemoveGUIClients;
     QLabel *m_pToolBarOverlayLabel;
     bool m_bIsShown; // Set true when show() is called
+    int m_deferredLoadStep; // The next step of slotLoadDeferred
     ViewContainerList m_viewContainerList;
     QTimer *m_pUpdateCaptionsTimer;
     IntStringMap m_exampleFiles;
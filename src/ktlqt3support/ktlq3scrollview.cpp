@@ -42,6 +42,8 @@
 #include "ktlq3scrollview.h"
 
 #include <QCursor>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
 #include <QPainter>
 #include <QPixmap>
 #include <QScrollBar>
@@ -68,6 +70,8 @@ static const int coord_limit = 4000;
 static const int autoscroll_margin = 16;
 static const int initialScrollTime = 30;
 static const int initialScrollAccel = 5;
+static const int smooth_scroll_interval = 16; // About a frame of the display
+static const int smooth_scroll_share = 4;     // Of the distance left, that smoothScrollBy() covers each frame
 
 struct QSVChildRec {
     QSVChildRec(QWidget *c, int xx, int yy)
@@ -116,6 +120,7 @@ public:
         , vbar(new QScrollBar(Qt::Vertical, parent /*, "qt_vbar" */))
         , viewport(new KtlQAbstractScrollAreaWidget(parent, "qt_viewport", QFlag(vpwflags)))
         , clipped_viewport(nullptr)
+        , opengl_viewport(false)
         , flags(vpwflags)
         , vx(0)
         , vy(0)
@@ -128,6 +133,7 @@ public:
         ,
 #endif
         scrollbar_timer(parent /*, "scrollview scrollbar timer" */)
+        , smoothscroll_timer(parent)
         , inresize(false)
         , use_cached_size_hint(true)
     {
@@ -137,6 +143,7 @@ public:
         autoscroll_timer.setObjectName("scrollview autoscroll timer");
 #endif
         scrollbar_timer.setObjectName("scrollview scrollbar timer");
+        smoothscroll_timer.setObjectName("scrollview smooth scroll timer");
         l_marg = r_marg = t_marg = b_marg = 0;
         viewport->ensurePolished();
         vMode = KtlQ3ScrollView::Auto;
@@ -190,8 +197,9 @@ public:
     QScrollBar *vbar;
     bool hbarPressed;
     bool vbarPressed;
-    KtlQAbstractScrollAreaWidget *viewport;
+    QWidget *viewport;
     KtlQClipperWidget *clipped_viewport;
+    bool opengl_viewport;
     int flags;
     // Q3PtrList<QSVChildRec>       children;
     QList<QSVChildRec *> children;
@@ -211,6 +219,8 @@ public:
     bool drag_autoscroll;
 #endif
     QTimer scrollbar_timer;
+    QTimer smoothscroll_timer;
+    QPoint smoothscroll_target; // The contents position that smoothScrollBy is heading for
 
     uint static_bg : 1;
     uint fake_scroll : 1;
@@ -600,6 +610,8 @@ KtlQ3ScrollView::KtlQ3ScrollView(QWidget *parent, const char *name, Qt::WindowFl
     d->viewport->installEventFilter(this);
 
     connect(&d->scrollbar_timer, SIGNAL(timeout()), this, SLOT(updateScrollBars()));
+    d->smoothscroll_timer.setInterval(smooth_scroll_interval);
+    connect(&d->smoothscroll_timer, SIGNAL(timeout()), this, SLOT(doSmoothScroll()));
 
     setFrameStyle(KtlQ3Frame::StyledPanel | KtlQ3Frame::Sunken);
     setLineWidth(style()->pixelMetric(QStyle::PM_DefaultFrameWidth));
@@ -653,6 +665,7 @@ KtlQ3ScrollView::~KtlQ3ScrollView()
 void KtlQ3ScrollView::hbarIsPressed()
 {
     d->hbarPressed = true;
+    d->smoothscroll_timer.stop();
     emit(horizontalSliderPressed());
 }
 
@@ -673,6 +686,7 @@ bool KtlQ3ScrollView::isHorizontalSliderPressed()
 void KtlQ3ScrollView::vbarIsPressed()
 {
     d->vbarPressed = true;
+    d->smoothscroll_timer.stop();
     emit(verticalSliderPressed());
 }
 
@@ -1475,7 +1489,9 @@ bool KtlQ3ScrollView::eventFilter(QObject *obj, QEvent *e)
         switch (e->type()) {
             /* Forward many events to viewport...() functions */
         case QEvent::Paint:
-            viewportPaintEvent(static_cast<QPaintEvent *>(e));
+            // An OpenGL viewport draws from paintGL instead
+            if (!d->opengl_viewport || obj != d->viewport)
+                viewportPaintEvent(static_cast<QPaintEvent *>(e));
             break;
         case QEvent::Resize:
             if (!d->clipped_viewport)
@@ -2036,6 +2052,55 @@ void KtlQ3ScrollView::scrollBy(int dx, int dy)
     setContentsPos(qMax(d->contentsX() + dx, 0), qMax(d->contentsY() + dy, 0));
 }
 
+/*!
+    Scrolls the content by \a dx to the left and \a dy upwards like
+    scrollBy(), but over a few frames of the display rather than in one
+    jump; each frame covers a share of the distance left, so the scroll
+    slows down as it arrives. Calling it again before it has arrived adds
+    to where it is going.
+
+    Each frame only moves the contents a little way, so what is already
+    drawn is scrolled and only the strip that comes into view is drawn.
+*/
+void KtlQ3ScrollView::smoothScrollBy(int dx, int dy)
+{
+    if (!d->smoothscroll_timer.isActive())
+        d->smoothscroll_target = QPoint(contentsX(), contentsY());
+
+    const int maxX = qMax(0, contentsWidth() - visibleWidth());
+    const int maxY = qMax(0, contentsHeight() - visibleHeight());
+    d->smoothscroll_target.setX(qBound(0, d->smoothscroll_target.x() + dx, maxX));
+    d->smoothscroll_target.setY(qBound(0, d->smoothscroll_target.y() + dy, maxY));
+
+    if (!d->smoothscroll_timer.isActive())
+        d->smoothscroll_timer.start();
+}
+
+/*!
+  \internal
+
+  The step of smoothScrollBy() for one frame.
+*/
+void KtlQ3ScrollView::doSmoothScroll()
+{
+    const QPoint pos(contentsX(), contentsY());
+    const QPoint left = d->smoothscroll_target - pos;
+
+    // A share of the distance left, but at least a pixel
+    QPoint step = left / smooth_scroll_share;
+    if (step.x() == 0 && left.x() != 0)
+        step.setX(left.x() > 0 ? 1 : -1);
+    if (step.y() == 0 && left.y() != 0)
+        step.setY(left.y() > 0 ? 1 : -1);
+
+    setContentsPos(pos.x() + step.x(), pos.y() + step.y());
+
+    // Stop when there, or when the contents could not move (they have
+    // been resized since the target was set)
+    if (step.isNull() || QPoint(contentsX(), contentsY()) == pos)
+        d->smoothscroll_timer.stop();
+}
+
 /*!
     Scrolls the content so that the point (\a x, \a y) is in the center
     of visible area.
@@ -2111,8 +2176,11 @@ void KtlQ3ScrollView::moveContents(int x, int y)
             viewport()->update();
         d->moveAllBy(dx, dy);
     } else if (!d->fake_scroll || d->contentsWidth() > visibleWidth()) {
-        // Small move
-        clipper()->scroll(dx, dy);
+        // Small move (what is already drawn by OpenGL cannot be scrolled)
+        if (d->opengl_viewport)
+            clipper()->update();
+        else
+            clipper()->scroll(dx, dy);
     }
     d->hideOrShowAll(this, true);
 }
@@ -2381,6 +2449,55 @@ void KtlQ3ScrollView::frameChanged()
     updateScrollBars();
 }
 
+/*!
+    Replaces the viewport with one that draws the contents with OpenGL,
+    if an OpenGL context can be had. Otherwise the viewport is left
+    as it is, and is drawn by the raster paint engine as before.
+
+    Returns whether the viewport is now drawn with OpenGL.
+
+    Note that you may only call enableOpenGL() prior to adding widgets,
+    and before setting anything on the viewport() itself. It cannot
+    be used along with enableClipper().
+*/
+bool KtlQ3ScrollView::enableOpenGL()
+{
+    if (d->opengl_viewport)
+        return true;
+    if (d->children.count())
+        qFatal("May only call KtlQ3ScrollView::enableOpenGL() before adding widgets");
+    if (d->clipped_viewport)
+        return false;
+
+    QOpenGLContext context;
+    if (!context.create())
+        return false;
+
+    QWidget *old = d->viewport;
+    old->removeEventFilter(this);
+
+    d->viewport = new KtlQGLScrollAreaWidget(this, "qt_viewport", old->windowFlags());
+    d->viewport->setGeometry(old->geometry());
+    d->viewport->installEventFilter(this);
+    d->viewport->setVisible(old->isVisible());
+    d->opengl_viewport = true;
+
+    delete old;
+    return true;
+}
+
+void KtlQGLScrollAreaWidget::paintGL()
+{
+    // The contents are redrawn in full each time (as with a big move)
+    const QColor bg = palette().color(backgroundRole());
+    QOpenGLFunctions *f = context()->functions();
+    f->glClearColor(bg.redF(), bg.greenF(), bg.blueF(), 1.0);
+    f->glClear(GL_COLOR_BUFFER_BIT);
+
+    QPaintEvent e(rect());
+    m_scrollView->viewportPaintEvent(&e);
+}
+
 /*!
     Returns the viewport widget of the scrollview. This is the widget
     containing the contents widget or which is the drawing area.
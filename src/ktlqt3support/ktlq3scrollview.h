@@ -42,6 +42,7 @@
 #ifndef KTL_Q3SCROLLVIEW_H
 #define KTL_Q3SCROLLVIEW_H
 
+#include <QOpenGLWidget>
 #include <QScrollBar>
 #include <ktlqt3support/ktlq3frame.h>
 
@@ -132,6 +133,7 @@ public:
     QPoint contentsToViewport(const QPoint &) const;
     QPoint viewportToContents(const QPoint &) const;
     void enableClipper(bool y);
+    bool enableOpenGL();
 
     void setStaticBackground(bool y);
     bool hasStaticBackground() const;
@@ -158,6 +160,7 @@ Q_SIGNALS:
 public Q_SLOTS:
     virtual void resizeContents(int w, int h);
     void scrollBy(int dx, int dy);
+    void smoothScrollBy(int dx, int dy);
     virtual void setContentsPos(int x, int y);
     void ensureVisible(int x, int y);
     void ensureVisible(int x, int y, int xmargin, int ymargin);
@@ -237,11 +240,13 @@ private Q_SLOTS:
     void vbarIsPressed();
     void vbarIsReleased();
     void doDragAutoScroll();
+    void doSmoothScroll();
     void startDragAutoScroll();
     void stopDragAutoScroll();
 
 private: // Disabled copy constructor and operator=
     Q_DISABLE_COPY(KtlQ3ScrollView)
+    friend class KtlQGLScrollAreaWidget;
     void changeFrameRect(const QRect &);
 
 public:
@@ -261,6 +266,29 @@ public:
     }
 };
 
+/**
+The viewport used by KtlQ3ScrollView::enableOpenGL(): the contents are drawn
+by the usual QPainter calls, but go through the OpenGL paint engine.
+*/
+class KtlQGLScrollAreaWidget : public QOpenGLWidget
+{
+    Q_OBJECT
+
+public:
+    KtlQGLScrollAreaWidget(KtlQ3ScrollView *parent = nullptr, const char *name = nullptr, Qt::WindowFlags f = {})
+        : QOpenGLWidget(parent, f)
+        , m_scrollView(parent)
+    {
+        setObjectName(name);
+    }
+
+protected:
+    void paintGL() override;
+
+private:
+    KtlQ3ScrollView *m_scrollView;
+};
+
 class KtlQClipperWidget : public QWidget
 {
     Q_OBJECT
@@ -13,7 +13,7 @@
 #include "gpsimprocessor.h"
 
 #include <QFile>
-#include <QRegExp>
+#include <QRegularExpression>
 #include <QStringList>
 
 #include <ktechlab_debug.h>
@@ -29,6 +29,17 @@ AsmParser::~AsmParser()
 {
 }
 
+/**
+ * @return the first word of the line, which ends at a space or a comment.
+ */
+static QString firstColumn(const QString &line)
+{
+    int end = 0;
+    while (end < line.length() && line[end] != ';' && line[end] != ' ')
+        ++end;
+    return line.left(end).trimmed();
+}
+
 bool AsmParser::parse(GpsimDebugger *debugger)
 {
     QFile file(m_url);
@@ -43,32 +54,29 @@ bool AsmParser::parse(GpsimDebugger *debugger)
 
     // QStringList nonAbsoluteOps = QStringList::split( ",",
     //		"code,.def,.dim,.direct,endw,extern,.file,global,idata,.ident,.line,.type,udata,udata_acs,udata_ovr,udata_shr" );
-    QStringList nonAbsoluteOps = QString("code,.def,.dim,.direct,endw,extern,.file,global,idata,.ident,.line,.type,udata,udata_acs,udata_ovr,udata_shr").split(",");
+    static const QStringList nonAbsoluteOps = QString("code,.def,.dim,.direct,endw,extern,.file,global,idata,.ident,.line,.type,udata,udata_acs,udata_ovr,udata_shr").split(",");
+
+    // "list p = picid"; the id is empty if the directive is not followed by one
+    static const QRegularExpression picIDRegExp("list\\s+p\\s*=\\s*(\\w*)", QRegularExpression::CaseInsensitiveOption);
 
     unsigned inputAtLine = 0;
-    while (!stream.atEnd()) {
-        const QString line = stream.readLine().trimmed();
+    QString line;
+    while (stream.readLineInto(&line)) {
+        line = line.trimmed();
         if (m_type != Relocatable) {
-            QString col0 = line.section(QRegExp("[; ]"), 0, 0);
-            col0 = col0.trimmed();
-            if (nonAbsoluteOps.contains(col0))
+            if (nonAbsoluteOps.contains(firstColumn(line)))
                 m_type = Relocatable;
         }
 
         if (!m_bContainsRadix) {
-            if (line.contains(QRegExp("^RADIX[\\s]*")) || line.contains(QRegExp("^radix[\\s]*")))
+            if (line.startsWith("RADIX") || line.startsWith("radix"))
                 m_bContainsRadix = true;
         }
 
-        if (m_picID.isEmpty()) {
-            // We look for "list p = ", and "list p = picid ", and subtract the positions / lengths away from each other to get the picid text position
-            QRegExp fullRegExp("[lL][iI][sS][tT][\\s]+[pP][\\s]*=[\\s]*[\\d\\w]+");
-            QRegExp halfRegExp("[lL][iI][sS][tT][\\s]+[pP][\\s]*=[\\s]*");
-
-            int startPos = fullRegExp.indexIn(line);
-            if ((startPos != -1) && (startPos == halfRegExp.indexIn(line))) {
-                m_picID = line.mid(startPos + halfRegExp.matchedLength(), fullRegExp.matchedLength() - halfRegExp.matchedLength());
-                m_picID = m_picID.toUpper();
+        if (m_picID.isEmpty() && line.contains("list", Qt::CaseInsensitive)) {
+            const QRegularExpressionMatch match = picIDRegExp.match(line);
+            if (match.hasMatch() && match.capturedLength(1) > 0) {
+                m_picID = match.captured(1).toUpper();
                 if (!m_picID.startsWith("P"))
                     m_picID.prepend("P");
             }
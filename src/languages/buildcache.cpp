@@ -0,0 +1,210 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "buildcache.h"
+#include "ktechlab.h"
+#include "language.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <ktlconfig.h>
+#include <ktechlab_debug.h>
+
+/** Number of outputs kept, after which the oldest are dropped */
+static const int MAX_ENTRIES = 100;
+
+/** Extensions of the files written alongside the output by gpasm and gplink */
+static const char *const SIDE_EXTENSIONS[] = {"cod", "lst", "map"};
+
+BuildCache *BuildCache::m_pSelf = nullptr;
+
+BuildCache *BuildCache::self()
+{
+    if (!m_pSelf)
+        m_pSelf = new BuildCache();
+    return m_pSelf;
+}
+
+BuildCache::BuildCache()
+    : QObject(KTechlab::self())
+    , m_dir(QDir::tempPath() + QLatin1String("/ktechlab_cache_XXXXXX"))
+{
+}
+
+BuildCache::~BuildCache()
+{
+    m_pSelf = nullptr;
+}
+
+QByteArray BuildCache::key(const ProcessOptions &options) const
+{
+    if (!m_dir.isValid())
+        return QByteArray();
+
+    switch (options.processPath()) {
+    case ProcessOptions::ProcessPath::Microbe_AssemblyAbsolute:
+    case ProcessOptions::ProcessPath::Microbe_PIC:
+    case ProcessOptions::ProcessPath::Microbe_Program:
+    case ProcessOptions::ProcessPath::AssemblyAbsolute_PIC:
+    case ProcessOptions::ProcessPath::AssemblyAbsolute_Program:
+    case ProcessOptions::ProcessPath::AssemblyRelocatable_Library:
+    case ProcessOptions::ProcessPath::AssemblyRelocatable_Object:
+    case ProcessOptions::ProcessPath::AssemblyRelocatable_PIC:
+    case ProcessOptions::ProcessPath::AssemblyRelocatable_Program:
+    case ProcessOptions::ProcessPath::Object_PIC:
+    case ProcessOptions::ProcessPath::Object_Program:
+        break;
+
+    // FlowCode is generated from the document rather than the file, and the
+    // rest either have side effects or depend on more than their input files
+    case ProcessOptions::ProcessPath::C_AssemblyRelocatable:
+    case ProcessOptions::ProcessPath::C_Library:
+    case ProcessOptions::ProcessPath::C_Object:
+    case ProcessOptions::ProcessPath::C_PIC:
+    case ProcessOptions::ProcessPath::C_Program:
+    case ProcessOptions::ProcessPath::FlowCode_AssemblyAbsolute:
+    case ProcessOptions::ProcessPath::FlowCode_Microbe:
+    case ProcessOptions::ProcessPath::FlowCode_PIC:
+    case ProcessOptions::ProcessPath::FlowCode_Program:
+    case ProcessOptions::ProcessPath::Object_Disassembly:
+    case ProcessOptions::ProcessPath::Object_Library:
+    case ProcessOptions::ProcessPath::PIC_AssemblyAbsolute:
+    case ProcessOptions::ProcessPath::Program_Disassembly:
+    case ProcessOptions::ProcessPath::Program_PIC:
+    case ProcessOptions::ProcessPath::Invalid:
+    case ProcessOptions::ProcessPath::None:
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    QStringList settings;
+    settings << QString::number(options.processPath()) << options.m_picID << options.m_hexFormat << QString::number(options.m_bOutputMapFile) << options.m_libraryDir << options.m_linkerScript << options.m_linkOther
+             << options.m_linkLibraries.join('\n') << QString::number(options.b_forceList);
+    settings << QString::number(KTLConfig::radix()) << QString::number(KTLConfig::gpasmWarningLevel()) << QString::number(KTLConfig::ignoreCase()) << QString::number(KTLConfig::dosFormat()) << KTLConfig::miscGpasmOptions()
+             << QString::number(KTLConfig::gplink_link_shared());
+    hash.addData(settings.join('\0').toUtf8());
+
+    const QStringList inputFiles = options.inputFiles();
+    for (const QString &inputFile : inputFiles) {
+        QFile file(inputFile);
+        if (!file.open(QIODevice::ReadOnly))
+            return QByteArray();
+
+        const QByteArray size = QByteArray::number(file.size());
+        hash.addData(size.constData(), size.size() + 1);
+        hash.addData(&file);
+    }
+
+    return hash.result().toHex();
+}
+
+QString BuildCache::cachePath(const QByteArray &key, const QString &extension) const
+{
+    QString path = m_dir.path() + '/' + QString::fromLatin1(key);
+    if (!extension.isEmpty())
+        path += '.' + extension;
+    return path;
+}
+
+/**
+ * @return the path of the file with the given extension written alongside
+ * outputFile
+ */
+static QString sidePath(const QString &outputFile, const QString &extension)
+{
+    const QFileInfo info(outputFile);
+    return info.path() + '/' + info.completeBaseName() + '.' + extension;
+}
+
+/**
+ * Copies from to to, replacing to if it exists.
+ */
+static bool replaceFile(const QString &from, const QString &to)
+{
+    QFile::remove(to);
+    return QFile::copy(from, to);
+}
+
+bool BuildCache::restore(const QByteArray &key, const QString &outputFile) const
+{
+    QHash<QByteArray, QStringList>::const_iterator entry = m_entries.constFind(key);
+    if (entry == m_entries.constEnd())
+        return false;
+
+    if (!replaceFile(cachePath(key), outputFile))
+        return false;
+
+    for (const QString &extension : *entry) {
+        if (!replaceFile(cachePath(key, extension), sidePath(outputFile, extension)))
+            return false;
+    }
+
+    return true;
+}
+
+void BuildCache::beginBuild(const QByteArray &key)
+{
+    m_building.insert(key);
+}
+
+void BuildCache::store(const QByteArray &key, const QString &outputFile, const QDateTime &started)
+{
+    m_building.remove(key);
+
+    // File times may only have a resolution of a second
+    QDateTime since = started;
+    since.setTime(QTime(started.time().hour(), started.time().minute(), started.time().second()));
+
+    QStringList extensions;
+    bool stored = replaceFile(outputFile, cachePath(key));
+    const QString outputExtension = QFileInfo(outputFile).suffix();
+
+    for (const char *extension : SIDE_EXTENSIONS) {
+        if (!stored || outputExtension == QLatin1String(extension))
+            continue;
+
+        const QFileInfo side(sidePath(outputFile, extension));
+        if (!side.exists() || side.lastModified() < since)
+            continue;
+
+        if (replaceFile(side.filePath(), cachePath(key, extension)))
+            extensions << extension;
+        else
+            stored = false;
+    }
+
+    if (stored) {
+        if (!m_entries.contains(key))
+            m_entryOrder << key;
+        m_entries[key] = extensions;
+
+        while (m_entryOrder.size() > MAX_ENTRIES) {
+            const QByteArray oldKey = m_entryOrder.takeFirst();
+            QFile::remove(cachePath(oldKey));
+            for (const QString &extension : m_entries.take(oldKey))
+                QFile::remove(cachePath(oldKey, extension));
+        }
+    } else
+        qCWarning(KTL_LOG) << "Could not store the output" << outputFile;
+
+    emit buildFinished(key);
+}
+
+void BuildCache::abandonBuild(const QByteArray &key)
+{
+    if (m_building.remove(key))
+        emit buildFinished(key);
+}
+
+#include "moc_buildcache.cpp"
@@ -0,0 +1,100 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef BUILDCACHE_H
+#define BUILDCACHE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QTemporaryDir>
+
+class ProcessOptions;
+
+/**
+Keeps copies of the output of the steps of a ProcessChain, keyed by a hash of
+the step, the contents of its input files and the settings it depends on. When
+a step is to be run with a key that has been built before, the output is copied
+back instead, so that reloading a program that has not changed (or starting
+many PICs running the same program) compiles it only once.
+
+Only the steps that depend on nothing but their input files and settings are
+cached - Microbe, and assembling and linking with gputils. Included files are
+not part of the key.
+*/
+class BuildCache : public QObject
+{
+    Q_OBJECT
+public:
+    static BuildCache *self();
+    ~BuildCache() override;
+
+    /**
+     * @return the key for running the step given by the process path of the
+     * options, or an empty key if the step is not cached
+     */
+    QByteArray key(const ProcessOptions &options) const;
+    /**
+     * Copies the output stored for the key to outputFile (and the files with
+     * the same name written alongside it, such as the .cod file).
+     * @return whether there was output stored for the key
+     */
+    bool restore(const QByteArray &key, const QString &outputFile) const;
+    /**
+     * @return whether a step with the key is being run by some ProcessChain
+     */
+    bool isBuilding(const QByteArray &key) const
+    {
+        return m_building.contains(key);
+    }
+    /**
+     * Records that a step with the key is being run, until store or
+     * abandonBuild is called for it.
+     */
+    void beginBuild(const QByteArray &key);
+    /**
+     * Stores a copy of outputFile, and of the files with the same name
+     * written alongside it since the step was started.
+     */
+    void store(const QByteArray &key, const QString &outputFile, const QDateTime &started);
+    /**
+     * Called when the step with the key failed, so nothing is stored.
+     */
+    void abandonBuild(const QByteArray &key);
+
+signals:
+    /**
+     * Emitted when a step being run has finished, successfully or not.
+     */
+    void buildFinished(const QByteArray &key);
+
+protected:
+    BuildCache();
+
+    /**
+     * @return the path of the copy of the output, or of the file alongside it
+     * with the given extension
+     */
+    QString cachePath(const QByteArray &key, const QString &extension = QString()) const;
+
+    QTemporaryDir m_dir;
+    QHash<QByteArray, QStringList> m_entries; // The extensions of the files stored alongside the output
+    QList<QByteArray> m_entryOrder; // Oldest first, for evicting entries
+    QSet<QByteArray> m_building;
+
+private:
+    static BuildCache *m_pSelf;
+};
+
+#endif
@@ -12,6 +12,7 @@
 #include "languagemanager.h"
 #include "logview.h"
 
+#include <KLocalizedString>
 #include <KProcess>
 #include <KShell>
 
@@ -20,10 +21,17 @@
 
 #include <ktechlab_debug.h>
 
+/** Length beyond which a line not yet ended is handled as it is */
+static const int MAX_LINE_LENGTH = 4096;
+
+/** Number of lines outputted by a process that are shown in the log view */
+static const int MAX_SHOWN_LINES = 500;
+
 ExternalLanguage::ExternalLanguage(ProcessChain *processChain, const QString &name)
     : Language(processChain, name)
 {
     m_languageProcess = nullptr;
+    m_lineCount = 0;
 }
 
 ExternalLanguage::~ExternalLanguage()
@@ -48,47 +56,76 @@ void ExternalLanguage::deleteLanguageProcess()
 
 void ExternalLanguage::processStdout()
 {
-    QString allOut = m_languageProcess->readAllStandardOutput();
-    QStringList lines = allOut.split('\n', Qt::SkipEmptyParts); // QStringList::split( '\n', allOut, false ); // 2018.12.01
-    QStringList::iterator end = lines.end();
-
-    for (QStringList::iterator it = lines.begin(); it != end; ++it) {
-        if (isError(*it)) {
-            outputError(*it);
-            outputtedError(*it);
-        } else if (isWarning(*it)) {
-            outputWarning(*it);
-            outputtedWarning(*it);
-        } else {
-            outputMessage(*it);
-            outputtedMessage(*it);
-        }
-    }
+    processOutput(m_stdoutBuffer, m_languageProcess->readAllStandardOutput(), false);
 }
 
 void ExternalLanguage::processStderr()
 {
-    QString allStdErr = m_languageProcess->readAllStandardError();
-    QStringList lines = allStdErr.split('\n', Qt::SkipEmptyParts); // QStringList::split( '\n', allStdErr, false );
-    QStringList::iterator end = lines.end();
-
-    for (QStringList::iterator it = lines.begin(); it != end; ++it) {
-        if (isStderrOutputFatal(*it)) {
-            outputError(*it);
-            outputtedError(*it);
-        } else {
-            outputWarning(*it);
-            outputtedWarning(*it);
-        }
+    processOutput(m_stderrBuffer, m_languageProcess->readAllStandardError(), true);
+}
+
+void ExternalLanguage::processOutput(QByteArray &buffer, const QByteArray &output, bool isStderr, bool flush)
+{
+    buffer += output;
+
+    int start = 0;
+    int end;
+    while ((end = buffer.indexOf('\n', start)) != -1) {
+        if (end > start)
+            processLine(QString::fromUtf8(buffer.constData() + start, end - start), isStderr);
+        start = end + 1;
+    }
+    buffer.remove(0, start);
+
+    if ((flush && !buffer.isEmpty()) || (buffer.size() > MAX_LINE_LENGTH)) {
+        processLine(QString::fromUtf8(buffer), isStderr);
+        buffer.clear();
     }
 }
 
+void ExternalLanguage::processLine(const QString &line, bool isStderr)
+{
+    enum { Message, Warning, Error } type;
+    if (isStderr)
+        type = isStderrOutputFatal(line) ? Error : Warning;
+    else if (isError(line))
+        type = Error;
+    else if (isWarning(line))
+        type = Warning;
+    else
+        type = Message;
+
+    // Past the limit, errors are still counted but not shown
+    if (++m_lineCount <= MAX_SHOWN_LINES) {
+        if (type == Error)
+            outputError(line);
+        else if (type == Warning)
+            outputWarning(line);
+        else
+            outputMessage(line);
+    } else if (type == Error)
+        m_errorCount++;
+
+    if (type == Error)
+        outputtedError(line);
+    else if (type == Warning)
+        outputtedWarning(line);
+    else
+        outputtedMessage(line);
+}
+
 void ExternalLanguage::processExited(int, QProcess::ExitStatus)
 {
     if (!m_languageProcess) {
         qCDebug(KTL_LOG) << " m_languageProcess == nullptr, returning";
         return;
     }
+
+    processOutput(m_stdoutBuffer, m_languageProcess->readAllStandardOutput(), false, true);
+    processOutput(m_stderrBuffer, m_languageProcess->readAllStandardError(), true, true);
+    if (m_lineCount > MAX_SHOWN_LINES)
+        outputMessage(i18np("(1 more message not shown)", "(%1 more messages not shown)", m_lineCount - MAX_SHOWN_LINES));
+
     bool allOk = processExited((m_languageProcess->exitStatus() == QProcess::NormalExit) && (m_errorCount == 0));
     finish(allOk);
     deleteLanguageProcess();
@@ -115,6 +152,9 @@ void ExternalLanguage::resetLanguageProcess()
     reset();
     deleteLanguageProcess();
     m_errorCount = 0;
+    m_lineCount = 0;
+    m_stdoutBuffer.clear();
+    m_stderrBuffer.clear();
 
     m_languageProcess = new KProcess(this);
 
@@ -101,6 +101,23 @@ protected:
     void displayProcessCommand();
 
     KProcess *m_languageProcess;
+
+private:
+    /**
+     * Appends the output read from the process to the buffer, and handles
+     * each line that has been completed.
+     * @param flush whether to also handle what is left of the last line
+     */
+    void processOutput(QByteArray &buffer, const QByteArray &output, bool isStderr, bool flush = false);
+    /**
+     * Passes the line outputted by the process to the log view and to
+     * outputtedMessage, outputtedWarning or outputtedError.
+     */
+    void processLine(const QString &line, bool isStderr);
+
+    QByteArray m_stdoutBuffer; // The start of a stdout line not yet ended
+    QByteArray m_stderrBuffer; // The start of a stderr line not yet ended
+    int m_lineCount;           // Lines outputted by the process so far
 };
 
 #endif
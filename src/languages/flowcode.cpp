@@ -30,6 +30,8 @@ FlowCode::FlowCode(ProcessChain *processChain)
     m_successfulMessage = i18n("*** Microbe generation successful ***");
     m_failedMessage = i18n("*** Microbe generation failed ***");
     p_startPart = nullptr;
+    m_flowPartCode = nullptr;
+    m_recording = nullptr;
 }
 
 FlowCode::~FlowCode()
@@ -65,6 +67,7 @@ void FlowCode::processInput(ProcessOptions options)
         return;
     }
 
+    setFlowPartCode(options.p_flowCodeDocument->flowPartCode());
     const QString code = generateMicrobe(options.p_flowCodeDocument->itemList(), options.p_flowCodeDocument->microSettings());
     if (code.isEmpty()) {
         finish(false);
@@ -82,8 +85,21 @@ void FlowCode::setStartPart(FlowPart *startPart)
     p_startPart = startPart;
 }
 
+void FlowCode::setFlowPartCode(FlowPartCodeMap *flowPartCode)
+{
+    m_flowPartCode = flowPartCode;
+}
+
+void FlowCode::recordStep(FlowPartCode::Type type, FlowPart *part, const QString &code, bool isValid)
+{
+    if (m_recording)
+        m_recording->steps.append({type, code, part, isValid});
+}
+
 void FlowCode::addCode(const QString &code)
 {
+    recordStep(FlowPartCode::Code, nullptr, code);
+
     m_code += code;
     if (!m_code.endsWith("\n"))
         m_code += '\n';
@@ -91,7 +107,9 @@ void FlowCode::addCode(const QString &code)
 
 bool FlowCode::isValidBranch(FlowPart *flowPart)
 {
-    return flowPart && (flowPart->level() >= m_curLevel) && !m_stopParts.contains(flowPart);
+    const bool isValid = flowPart && (flowPart->level() >= m_curLevel) && !m_stopParts.contains(flowPart);
+    recordStep(FlowPartCode::ValidBranch, flowPart, QString(), isValid);
+    return isValid;
 }
 
 void FlowCode::addCodeBranch(FlowPart *flowPart)
@@ -99,13 +117,22 @@ void FlowCode::addCodeBranch(FlowPart *flowPart)
     if (!flowPart)
         return;
 
-    if (!isValidBranch(flowPart))
+    // The code added for the branch belongs to the branch, not to the part
+    // being recorded, which only needs to know that the branch was added
+    recordStep(FlowPartCode::Branch, flowPart);
+    FlowPartCode *const recording = m_recording;
+    m_recording = nullptr;
+
+    if (!isValidBranch(flowPart)) {
+        m_recording = recording;
         return;
+    }
 
     if (m_addedParts.contains(flowPart)) {
         const QString labelName = genLabel(flowPart->id());
         addCode("goto " + labelName);
         m_gotos.append(labelName);
+        m_recording = recording;
         return;
     } else {
         m_addedParts.append(flowPart);
@@ -116,9 +143,64 @@ void FlowCode::addCodeBranch(FlowPart *flowPart)
         addCode(labelName + ':');
         m_labels.append(labelName);
 
-        flowPart->generateMicrobe(this);
+        // A copy, as parts generated during the replay are added to the map
+        const FlowPartCode cached = m_flowPartCode ? m_flowPartCode->value(flowPart) : FlowPartCode();
+        if (cached.steps.isEmpty() || !replayCode(cached)) {
+            FlowPartCode partCode;
+            m_recording = &partCode;
+            flowPart->generateMicrobe(this);
+            m_recording = nullptr;
+
+            if (m_flowPartCode)
+                m_flowPartCode->insert(flowPart, partCode);
+        }
+
         m_curLevel = prevLevel;
     }
+
+    m_recording = recording;
+}
+
+bool FlowCode::replayCode(const FlowPartCode &partCode)
+{
+    const int codeLength = m_code.length();
+    const int addedPartCount = m_addedParts.size();
+    const int gotoCount = m_gotos.size();
+    const int labelCount = m_labels.size();
+    const FlowPartList stopParts = m_stopParts;
+
+    for (const FlowPartCode::Step &step : partCode.steps) {
+        switch (step.type) {
+        case FlowPartCode::Code:
+            addCode(step.code);
+            break;
+
+        case FlowPartCode::Branch:
+            addCodeBranch(step.part);
+            break;
+
+        case FlowPartCode::AddStopPart:
+            addStopPart(step.part);
+            break;
+
+        case FlowPartCode::RemoveStopPart:
+            removeStopPart(step.part);
+            break;
+
+        case FlowPartCode::ValidBranch:
+            if (isValidBranch(step.part) == step.isValid)
+                break;
+
+            m_code.truncate(codeLength);
+            m_addedParts.erase(m_addedParts.begin() + addedPartCount, m_addedParts.end());
+            m_gotos.erase(m_gotos.begin() + gotoCount, m_gotos.end());
+            m_labels.erase(m_labels.begin() + labelCount, m_labels.end());
+            m_stopParts = stopParts;
+            return false;
+        }
+    }
+
+    return true;
 }
 
 QString FlowCode::genLabel(const QString &id)
@@ -128,12 +210,16 @@ QString FlowCode::genLabel(const QString &id)
 
 void FlowCode::addStopPart(FlowPart *part)
 {
+    recordStep(FlowPartCode::AddStopPart, part);
+
     if (part)
         m_stopParts.append(part);
 }
 
 void FlowCode::removeStopPart(FlowPart *part)
 {
+    recordStep(FlowPartCode::RemoveStopPart, part);
+
     if (!part)
         return;
 
@@ -13,6 +13,7 @@
 
 #include "language.h"
 
+#include <QHash>
 #include <QList>
 #include <QObject>
 #include <QPointer>
@@ -27,6 +28,31 @@ class MicroSettings;
 typedef QList<FlowPart *> FlowPartList;
 typedef QList<QPointer<Item>> ItemList;
 
+/**
+The calls that a FlowPart made to FlowCode when generating its code, kept so
+that the part does not have to generate it again until it or the connections
+in the document change. The answers to isValidBranch are kept with the calls,
+as they depend on where the part is added, and the calls are only replayed
+while the answers stay the same.
+*/
+class FlowPartCode
+{
+public:
+    enum Type { Code, Branch, AddStopPart, RemoveStopPart, ValidBranch };
+
+    class Step
+    {
+    public:
+        Type type;
+        QString code;
+        FlowPart *part;
+        bool isValid;
+    };
+
+    QList<Step> steps;
+};
+typedef QHash<const FlowPart *, FlowPartCode> FlowPartCodeMap;
+
 /**
 "FlowCode" can possibly be considered a misnomer, as the output is actually Microbe.
 However, the function of this class is to take a set of FlowParts, and generate the
@@ -77,6 +103,11 @@ public:
      * Generates and returns the microbe code
      */
     QString generateMicrobe(const ItemList &itemList, MicroSettings *settings);
+    /**
+     * Sets where the code generated by each FlowPart is kept between calls to
+     * generateMicrobe. Parts found there are replayed instead of generated.
+     */
+    void setFlowPartCode(FlowPartCodeMap *flowPartCode);
     /**
      * Returns true if the FlowPart is a valid one for adding a branch
      */
@@ -92,6 +123,16 @@ protected:
      * Performs indenting, removal of unnecessary labels, etc.
      */
     void tidyCode();
+    /**
+     * Adds the code that the FlowPart generated before. If an isValidBranch
+     * call now gets a different answer, the code added so far is taken back.
+     * @return whether the code was added
+     */
+    bool replayCode(const FlowPartCode &partCode);
+    /**
+     * Appends a step to the FlowPart code being recorded, if any
+     */
+    void recordStep(FlowPartCode::Type type, FlowPart *part, const QString &code = QString(), bool isValid = false);
 
     QStringList m_gotos;  // Gotos used
     QStringList m_labels; // Labels used
@@ -101,6 +142,8 @@ protected:
     FlowPart *p_startPart;
     QString m_code;
     int m_curLevel;
+    FlowPartCodeMap *m_flowPartCode;
+    FlowPartCode *m_recording; // The code of the FlowPart being generated
 };
 
 #endif
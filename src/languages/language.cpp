@@ -55,6 +55,14 @@ void Language::outputError(const QString &message)
     m_errorCount++;
 }
 
+void Language::reuseOutput(ProcessOptions options)
+{
+    reset();
+    m_processOptions = options;
+    outputMessage(i18n("Input unchanged, using the output of the last build"));
+    finish(true);
+}
+
 void Language::finish(bool successful)
 {
     if (successful) {
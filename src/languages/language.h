@@ -254,6 +254,11 @@ public:
      * if we've done processing.
      */
     virtual ProcessOptions::ProcessPath::Path outputPath(ProcessOptions::ProcessPath::Path inputPath) const = 0;
+    /**
+     * Carries on as if processInput had been called and succeeded, for when
+     * the output has already been put in place from the BuildCache.
+     */
+    void reuseOutput(ProcessOptions options);
 
 signals:
     /**
@@ -14,16 +14,17 @@
 #include "languagemanager.h"
 #include "logview.h"
 
+#include <microbe/microbe.h>
+
 #include <KLocalizedString>
-#include <KMessageBox>
-#include <KProcess>
 
 #include <QFile>
+#include <QTextStream>
 
 #include <ktechlab_debug.h>
 
 Microbe::Microbe(ProcessChain *processChain)
-    : ExternalLanguage(processChain, "Microbe")
+    : Language(processChain, "Microbe")
 {
     m_failedMessage = i18n("*** Compilation failed ***");
     m_successfulMessage = i18n("*** Compilation successful ***");
@@ -60,34 +61,35 @@ Microbe::~Microbe()
 
 void Microbe::processInput(ProcessOptions options)
 {
-    resetLanguageProcess();
+    reset();
     m_processOptions = options;
 
-    *m_languageProcess << ("microbe");
-
-    // Input Asm file
-    *m_languageProcess << (options.inputFiles().first());
+    const QString inputFile = options.inputFiles().first();
+    outputMessage(i18n("Compiling %1", inputFile));
 
-    // Output filename
-    *m_languageProcess << (options.intermediaryOutput());
+    MicrobeCompiler::MicrobeApp microbe;
+    const QString code = microbe.compile(inputFile, true);
 
-    *m_languageProcess << ("--show-source");
+    const QStringList errors = microbe.errorReport().split('\n', Qt::SkipEmptyParts);
+    for (const QString &error : errors)
+        outputError(error);
 
-    if (!start()) {
-        KMessageBox::error(LanguageManager::self()->logView(), i18n("Assembly failed. Please check you have KTechlab installed properly (\"microbe\" could not be started)."));
-        processInitFailed();
+    if (!errors.isEmpty()) {
+        finish(false);
         return;
     }
-}
 
-bool Microbe::isError(const QString &message) const
-{
-    return message.contains("Error", Qt::CaseInsensitive);
-}
+    QFile file(options.intermediaryOutput());
+    if (!file.open(QIODevice::WriteOnly)) {
+        outputError(i18n("Could not write to '%1'", options.intermediaryOutput()));
+        finish(false);
+        return;
+    }
 
-bool Microbe::isWarning(const QString &message) const
-{
-    return message.contains("Warning", Qt::CaseInsensitive);
+    QTextStream stream(&file);
+    stream << code;
+    file.close();
+    finish(true);
 }
 
 ProcessOptions::ProcessPath::Path Microbe::outputPath(ProcessOptions::ProcessPath::Path inputPath) const
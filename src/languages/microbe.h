@@ -11,17 +11,19 @@
 #ifndef MICROBE_H
 #define MICROBE_H
 
-#include "externallanguage.h"
+#include "language.h"
 
 #include <QMap>
 
 typedef QMap<int, QString> ErrorMap;
 
 /**
+Compiles Microbe to assembly. The compiler is linked in, so this is done
+in-process rather than by starting the microbe program.
 @author Daniel Clarke
 @author David Saxton
 */
-class Microbe : public ExternalLanguage
+class Microbe : public Language
 {
 public:
     Microbe(ProcessChain *processChain);
@@ -31,9 +33,6 @@ public:
     ProcessOptions::ProcessPath::Path outputPath(ProcessOptions::ProcessPath::Path inputPath) const override;
 
 protected:
-    bool isError(const QString &message) const override;
-    bool isWarning(const QString &message) const override;
-
     ErrorMap m_errorMessages;
 };
 
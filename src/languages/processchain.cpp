@@ -10,6 +10,7 @@
 
 #include "processchain.h"
 #include "asmparser.h"
+#include "buildcache.h"
 #include "docmanager.h"
 #include "gplib.h"
 #include "ktechlab.h"
@@ -33,6 +34,7 @@
 #include <QDir>
 #include <QFile>
 #include <QTemporaryFile>
+#include <QThread>
 #include <QTimer>
 
 #include <ktlconfig.h>
@@ -59,6 +61,7 @@ ProcessChain::ProcessChain(ProcessOptions options)
         target = options.targetFile();
 
     LanguageManager::self()->logView()->addOutput(i18n("Building: %1", target), LogView::ot_important);
+    connect(this, &ProcessChain::failed, this, &ProcessChain::slotFailed);
     QTimer::singleShot(0, this, SLOT(compile()));
 }
 
@@ -77,6 +80,9 @@ ProcessChain::~ProcessChain()
 // void ProcessChain::compile( ProcessOptions * options )
 void ProcessChain::compile()
 {
+    // Called by the language of the step before once it has succeeded
+    storeBuild();
+
     // If the micro id in the options is empty, then attempt to get it from any
     // open project (it might not be necessarily...but won't hurt if it isn't).
     if (m_processOptions.m_picID.isEmpty()) {
@@ -90,7 +96,7 @@ void ProcessChain::compile()
     switch (m_processOptions.processPath()) {
 #define DIRECT_PROCESS(path, processor)                                                                                                                                                                                                        \
     case ProcessOptions::ProcessPath::path: {                                                                                                                                                                                                  \
-        processor()->processInput(m_processOptions);                                                                                                                                                                                           \
+        process(processor());                                                                                                                                                                                                                  \
         break;                                                                                                                                                                                                                                 \
     }
 #define INDIRECT_PROCESS(path, processor, extension)                                                                                                                                                                                           \
@@ -99,7 +105,7 @@ void ProcessChain::compile()
         f->open();                                                                                                                                                                                                                             \
         f->close();                                                                                                                                                                                                                            \
         m_processOptions.setIntermediaryOutput(f->fileName());                                                                                                                                                                                 \
-        processor()->processInput(m_processOptions);                                                                                                                                                                                           \
+        process(processor());                                                                                                                                                                                                                  \
         break;                                                                                                                                                                                                                                 \
     }
 
@@ -141,8 +147,70 @@ void ProcessChain::compile()
     }
 }
 
+void ProcessChain::process(Language *language)
+{
+    BuildCache *cache = BuildCache::self();
+    const QByteArray key = cache->key(m_processOptions);
+
+    if (!key.isEmpty()) {
+        if (cache->restore(key, m_processOptions.intermediaryOutput())) {
+            language->reuseOutput(m_processOptions);
+            return;
+        }
+
+        if (cache->isBuilding(key)) {
+            // Another chain is building the same thing, so use its output
+            m_waitingKey = key;
+            connect(cache, &BuildCache::buildFinished, this, &ProcessChain::slotBuildFinished);
+            return;
+        }
+
+        cache->beginBuild(key);
+        m_buildKey = key;
+        m_buildOutput = m_processOptions.intermediaryOutput();
+        m_buildStarted = QDateTime::currentDateTime();
+    }
+
+    language->processInput(m_processOptions);
+}
+
+void ProcessChain::storeBuild()
+{
+    if (m_buildKey.isEmpty())
+        return;
+
+    const QByteArray key = m_buildKey;
+    m_buildKey.clear();
+    BuildCache::self()->store(key, m_buildOutput, m_buildStarted);
+}
+
+void ProcessChain::slotBuildFinished(const QByteArray &key)
+{
+    if (key != m_waitingKey)
+        return;
+
+    disconnect(BuildCache::self(), &BuildCache::buildFinished, this, &ProcessChain::slotBuildFinished);
+    m_waitingKey.clear();
+
+    // Either the output is there to be copied now, or the build failed and
+    // this chain will have a go itself
+    compile();
+}
+
+void ProcessChain::slotFailed()
+{
+    if (m_buildKey.isEmpty())
+        return;
+
+    const QByteArray key = m_buildKey;
+    m_buildKey.clear();
+    BuildCache::self()->abandonBuild(key);
+}
+
 void ProcessChain::slotFinishedCompile(Language *language)
 {
+    storeBuild();
+
     ProcessOptions options = language->processOptions();
 
     if (options.b_addToProject && ProjectManager::self()->currentProject())
@@ -271,30 +339,79 @@ LanguageFunction(FlowCode, flowCode, m_pFlowCode) LanguageFunction(Gpasm, gpasm,
     : QObject(KTechlab::self())
 {
     m_processOptionsList = pol;
+    m_bFailed = false;
+
+    for (const ProcessOptions &options : pol) {
+        if (!options.targetFile().isEmpty())
+            m_unfinishedTargets << options.targetFile();
+    }
 
     // Start us off...
-    slotProcessChainSuccessful();
+    startProcesses();
 }
 
-void ProcessListChain::slotProcessChainSuccessful()
+bool ProcessListChain::dependsOnUnfinished(const ProcessOptions &options) const
 {
-    if (m_processOptionsList.isEmpty()) {
+    const QStringList inputs = options.inputFiles() + options.m_linkLibraries;
+    for (const QString &input : inputs) {
+        if (input != options.targetFile() && m_unfinishedTargets.contains(input))
+            return true;
+    }
+    return false;
+}
+
+void ProcessListChain::startProcesses()
+{
+    if (m_bFailed)
+        return;
+
+    if (m_processOptionsList.isEmpty() && m_running.isEmpty()) {
         emit successful();
         return;
     }
 
+    const int maxRunning = qMax(1, QThread::idealThreadCount());
+
     ProcessOptionsList::iterator it = m_processOptionsList.begin();
-    ProcessOptions po = *it;
-    m_processOptionsList.erase(it);
+    while (it != m_processOptionsList.end() && m_running.size() < maxRunning) {
+        // If nothing is running then the list does not order the processes
+        // by their dependencies, so just run them in turn
+        if (dependsOnUnfinished(*it) && !m_running.isEmpty()) {
+            ++it;
+            continue;
+        }
+
+        ProcessOptions po = *it;
+        it = m_processOptionsList.erase(it);
+
+        ProcessChain *pc = LanguageManager::self()->compile(po);
+        m_running[pc] = po.targetFile();
+
+        connect(pc, SIGNAL(successful()), this, SLOT(slotProcessChainSuccessful()));
+        connect(pc, SIGNAL(failed()), this, SLOT(slotProcessChainFailed()));
+    }
+}
 
-    ProcessChain *pc = LanguageManager::self()->compile(po);
+void ProcessListChain::slotProcessChainSuccessful()
+{
+    ProcessChain *pc = static_cast<ProcessChain *>(sender());
+    if (!m_running.contains(pc))
+        return;
 
-    connect(pc, SIGNAL(successful()), this, SLOT(slotProcessChainSuccessful()));
-    connect(pc, SIGNAL(failed()), this, SLOT(slotProcessChainFailed()));
+    m_unfinishedTargets.removeAll(m_running.take(pc));
+    startProcesses();
 }
 
 void ProcessListChain::slotProcessChainFailed()
 {
+    m_running.remove(static_cast<ProcessChain *>(sender()));
+
+    // The processes still running are left to finish, but nothing more is
+    // started
+    if (m_bFailed)
+        return;
+
+    m_bFailed = true;
     emit failed();
 }
 // END class ProcessListChain
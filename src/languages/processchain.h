@@ -12,7 +12,11 @@
 #define PROCESSCHAIN_H
 
 #include "language.h"
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
 #include <QList>
+#include <QStringList>
 #include <QObject>
 
 class FlowCode;
@@ -58,6 +62,17 @@ public slots:
      */
     void compile();
 
+protected slots:
+    /**
+     * Called when a step being run by another ProcessChain has finished, for
+     * when this is waiting on it to use its output.
+     */
+    void slotBuildFinished(const QByteArray &key);
+    /**
+     * Drops the step being run from the BuildCache, as it failed.
+     */
+    void slotFailed();
+
 signals:
     /**
      * Emitted when compiling has successfully gone all the way through to the
@@ -84,9 +99,23 @@ protected:
     Microbe *microbe();
     PicProgrammer *picProgrammer();
     SDCC *sdcc();
+    /**
+     * Runs the step given by the process path of m_processOptions with the
+     * language, or copies its output from the BuildCache if it has been run
+     * on the same input before.
+     */
+    void process(Language *language);
+    /**
+     * Stores the output of the step that has just succeeded in the BuildCache.
+     */
+    void storeBuild();
 
     int m_errorCount;
     ProcessOptions m_processOptions;
+    QByteArray m_buildKey; // Key of the step being run, if it is cached
+    QString m_buildOutput; // Output file of the step being run
+    QDateTime m_buildStarted;
+    QByteArray m_waitingKey; // Key of the step that another ProcessChain is running for us
 
 private:
     FlowCode *m_pFlowCode;
@@ -99,6 +128,12 @@ private:
     SDCC *m_pSDCC;
 };
 
+/**
+Runs a list of processes, such as the targets of a project. Processes that do
+not use the output of one another are run at the same time, up to the number
+of processor cores; a process whose input files or libraries are the targets
+of processes earlier in the list waits until those have finished.
+*/
 class ProcessListChain : public QObject
 {
     Q_OBJECT
@@ -121,7 +156,21 @@ protected slots:
     void slotProcessChainFailed();
 
 protected:
-    ProcessOptionsList m_processOptionsList;
+    /**
+     * Starts the waiting processes that can be run, and emits successful
+     * once there is nothing left to run.
+     */
+    void startProcesses();
+    /**
+     * @return whether the process uses the target of one that has not
+     * finished yet
+     */
+    bool dependsOnUnfinished(const ProcessOptions &options) const;
+
+    ProcessOptionsList m_processOptionsList; // The processes yet to be started
+    QHash<ProcessChain *, QString> m_running; // The target files of the running processes
+    QStringList m_unfinishedTargets;
+    bool m_bFailed;
 };
 
 #endif
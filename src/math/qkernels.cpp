@@ -0,0 +1,173 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "qkernels.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define QKERNELS_AVX2
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define QKERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+double dotScalar(const double *x, const double *y, unsigned n)
+{
+    double sum = 0.;
+    for (unsigned i = 0; i < n; ++i)
+        sum += x[i] * y[i];
+    return sum;
+}
+
+void axpyScalar(double *y, const double *x, double a, unsigned n)
+{
+    for (unsigned i = 0; i < n; ++i)
+        y[i] += a * x[i];
+}
+
+#ifdef QKERNELS_AVX2
+__attribute__((target("avx2,fma"))) double dotAvx2(const double *x, const double *y, unsigned n)
+{
+    // Two accumulators, to hide the latency of the fused multiply-add
+    __m256d sum0 = _mm256_setzero_pd();
+    __m256d sum1 = _mm256_setzero_pd();
+
+    unsigned i = 0;
+    for (; i + 8 <= n; i += 8) {
+        sum0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), sum0);
+        sum1 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4), sum1);
+    }
+    if (i + 4 <= n) {
+        sum0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), sum0);
+        i += 4;
+    }
+
+    const __m256d sum = _mm256_add_pd(sum0, sum1);
+    const __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+    double total = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+
+    for (; i < n; ++i)
+        total += x[i] * y[i];
+    return total;
+}
+
+__attribute__((target("avx2,fma"))) void axpyAvx2(double *y, const double *x, double a, unsigned n)
+{
+    const __m256d va = _mm256_set1_pd(a);
+
+    unsigned i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+
+    for (; i < n; ++i)
+        y[i] += a * x[i];
+}
+
+typedef double (*DotFunction)(const double *, const double *, unsigned);
+typedef void (*AxpyFunction)(double *, const double *, double, unsigned);
+
+bool checkAvx2()
+{
+    // May be called during static initialization, before the compiler's own
+    // check has run
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+bool hasAvx2()
+{
+    static const bool avx2 = checkAvx2();
+    return avx2;
+}
+#endif
+
+#ifdef QKERNELS_NEON
+double dotNeon(const double *x, const double *y, unsigned n)
+{
+    float64x2_t sum0 = vdupq_n_f64(0.);
+    float64x2_t sum1 = vdupq_n_f64(0.);
+
+    unsigned i = 0;
+    for (; i + 4 <= n; i += 4) {
+        sum0 = vfmaq_f64(sum0, vld1q_f64(x + i), vld1q_f64(y + i));
+        sum1 = vfmaq_f64(sum1, vld1q_f64(x + i + 2), vld1q_f64(y + i + 2));
+    }
+
+    double total = vaddvq_f64(vaddq_f64(sum0, sum1));
+    for (; i < n; ++i)
+        total += x[i] * y[i];
+    return total;
+}
+
+void axpyNeon(double *y, const double *x, double a, unsigned n)
+{
+    const float64x2_t va = vdupq_n_f64(a);
+
+    unsigned i = 0;
+    for (; i + 2 <= n; i += 2)
+        vst1q_f64(y + i, vfmaq_f64(vld1q_f64(y + i), va, vld1q_f64(x + i)));
+
+    for (; i < n; ++i)
+        y[i] += a * x[i];
+}
+#endif
+}
+
+namespace QuickKernels
+{
+double dot(const double *x, const double *y, unsigned n)
+{
+#if defined(QKERNELS_AVX2)
+    static const DotFunction dotFunction = hasAvx2() ? dotAvx2 : dotScalar;
+    return dotFunction(x, y, n);
+#elif defined(QKERNELS_NEON)
+    return dotNeon(x, y, n);
+#else
+    return dotScalar(x, y, n);
+#endif
+}
+
+void axpy(double *y, const double *x, double a, unsigned n)
+{
+#if defined(QKERNELS_AVX2)
+    static const AxpyFunction axpyFunction = hasAvx2() ? axpyAvx2 : axpyScalar;
+    axpyFunction(y, x, a, n);
+#elif defined(QKERNELS_NEON)
+    axpyNeon(y, x, a, n);
+#else
+    axpyScalar(y, x, a, n);
+#endif
+}
+
+const char *instructionSet()
+{
+#if defined(QKERNELS_AVX2)
+    return hasAvx2() ? "AVX2" : "scalar";
+#elif defined(QKERNELS_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+const Implementation *implementations()
+{
+    static const Implementation list[] = {{"scalar", dotScalar, axpyScalar},
+#if defined(QKERNELS_AVX2)
+                                          hasAvx2() ? Implementation{"AVX2", dotAvx2, axpyAvx2} : Implementation{nullptr, nullptr, nullptr},
+#elif defined(QKERNELS_NEON)
+                                          {"NEON", dotNeon, axpyNeon},
+#endif
+                                          {nullptr, nullptr, nullptr}};
+    return list;
+}
+}
@@ -0,0 +1,56 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef QKERNELS_H__KTECHLAB_
+#define QKERNELS_H__KTECHLAB_
+
+/**
+The inner loops of the dense LU decomposition and of forward / back
+substitution, vectorised where the processor allows it.
+
+On x86-64 an AVX2 version is used if the processor supports it (checked once,
+at startup), so the build does not need to target AVX2 to benefit from it. On
+ARM64 NEON is always available. Everything else uses the plain loops.
+
+The vectorised versions add up the terms in a different order, so dot can
+differ from the plain loop in the last bits.
+*/
+namespace QuickKernels
+{
+/**
+ * @return the sum of x[i] * y[i] for i in [0, n)
+ */
+double dot(const double *x, const double *y, unsigned n);
+/**
+ * y[i] += a * x[i] for i in [0, n)
+ */
+void axpy(double *y, const double *x, double a, unsigned n);
+/**
+ * @return the name of the instruction set the kernels use, for debugging
+ */
+const char *instructionSet();
+
+/**
+ * One version of the kernels.
+ */
+struct Implementation {
+    const char *name; ///< as returned by instructionSet()
+    double (*dot)(const double *x, const double *y, unsigned n);
+    void (*axpy)(double *y, const double *x, double a, unsigned n);
+};
+/**
+ * @return the versions of the kernels that this processor can run, the plain
+ * loops first, ended by one with a null name. For the tests, which check the
+ * vectorised versions against the plain loops.
+ */
+const Implementation *implementations();
+}
+
+#endif
@@ -21,12 +21,15 @@
 //#ifndef QMATRIX_H
 #include "qmatrix.h"
 //#endif
+#include "qkernels.h"
 
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib> // for NULL
 #include <cstring>
 #include <iostream>
+#include <utility>
 
 /*
 #ifndef BADRNG_H
@@ -68,9 +71,18 @@ void QuickMatrix::allocator()
     assert(m);
     assert(n);
 
+    // All the rows are in one block, each starting on a 32 byte boundary so
+    // that the vector kernels do not straddle cache lines more than needed.
+    const unsigned int stride = (n + 3) & ~3u;
+    storage = new double[m * stride + 3];
+
+    double *block = storage;
+    while (reinterpret_cast<uintptr_t>(block) % 32)
+        block++;
+
     values = new double *[m];
     for (unsigned int i = 0; i < m; i++) {
-        values[i] = new double[n];
+        values[i] = block + i * stride;
     }
 }
 
@@ -109,10 +121,40 @@ QuickMatrix::QuickMatrix(const QuickMatrix *old)
 
 // ####################################
 
+QuickMatrix::QuickMatrix(const QuickMatrix &old)
+    : QuickMatrix(&old)
+{
+}
+
+// ####################################
+
+QuickMatrix::QuickMatrix(QuickMatrix &&old) noexcept
+    : m(old.m)
+    , n(old.n)
+    , values(old.values)
+    , storage(old.storage)
+{
+    old.m = old.n = 0;
+    old.values = nullptr;
+    old.storage = nullptr;
+}
+
+// ####################################
+
+QuickMatrix &QuickMatrix::operator=(QuickMatrix &&othermat) noexcept
+{
+    std::swap(m, othermat.m);
+    std::swap(n, othermat.n);
+    std::swap(values, othermat.values);
+    std::swap(storage, othermat.storage);
+    return *this;
+}
+
+// ####################################
+
 QuickMatrix::~QuickMatrix()
 {
-    for (unsigned int i = 0; i < m; i++)
-        delete[] values[i];
+    delete[] storage;
     delete[] values;
 }
 
@@ -173,64 +215,77 @@ bool QuickMatrix::partialSAF(CUI m_a, CUI m_b, CUI from, const double scalor)
     double *brow = values[m_b];
 
     // iterate over n - m_a columns.
-    for (unsigned int j = from; j < n; j++)
-        brow[j] += arow[j] * scalor;
+    if (from < n)
+        QuickKernels::axpy(brow + from, arow + from, scalor, n - from);
 
     return true;
 }
 
 // ####################################
 
-QuickVector *QuickMatrix::operator*(const QuickVector *operandvec) const
+void QuickMatrix::multiply(const QuickVector &operandvec, QuickVector *result) const
 {
-    if (operandvec->size() != n)
-        return nullptr;
+    assert(operandvec.size() == n && result->size() == m && result != &operandvec);
 
-    QuickVector *ret = new QuickVector(m);
+    const double *x = operandvec.data();
+    for (unsigned int i = 0; i < m; i++)
+        (*result)[i] = QuickKernels::dot(values[i], x, n);
+}
 
-    for (unsigned int i = 0; i < m; i++) {
-        double sum = 0;
-        for (unsigned int j = 0; j < n; j++)
-            sum += values[i][j] * (*operandvec)[j];
-        (*ret)[i] = sum;
-    }
+// ####################################
 
+QuickVector QuickMatrix::operator*(const QuickVector &operandvec) const
+{
+    QuickVector ret(m);
+    multiply(operandvec, &ret);
     return ret;
 }
 
 // ####################################
 
-QuickMatrix *QuickMatrix::operator+=(const QuickMatrix *operandmat)
+QuickMatrix &QuickMatrix::operator+=(const QuickMatrix &operandmat)
 {
-    if (operandmat->n != n || operandmat->m != m)
-        return nullptr;
+    assert(operandmat.n == n && operandmat.m == m);
 
+    for (unsigned int i = 0; i < m; i++)
+        QuickKernels::axpy(values[i], operandmat.values[i], 1., n);
+
+    return *this;
+}
+
+// ####################################
+
+QuickMatrix &QuickMatrix::operator*=(const double y)
+{
     for (unsigned int i = 0; i < m; i++) {
         for (unsigned int j = 0; j < n; j++)
-            values[i][j] += operandmat->values[i][j];
+            values[i][j] *= y;
     }
 
-    return this;
+    return *this;
 }
 
 // ####################################
 
-QuickMatrix *QuickMatrix::operator*(const QuickMatrix *operandmat) const
+void QuickMatrix::multiply(const QuickMatrix &operandmat, QuickMatrix *result) const
 {
-    if (operandmat->m != n)
-        return nullptr;
-
-    QuickMatrix *ret = new QuickMatrix(m, operandmat->n);
+    assert(operandmat.m == n && result->m == m && result->n == operandmat.n);
+    assert(result != this && result != &operandmat);
 
+    // Going along the rows of operandmat keeps to the memory it is stored in
+    result->fillWithZero();
     for (unsigned int i = 0; i < m; i++) {
-        for (unsigned int j = 0; j < operandmat->n; j++) {
-            double sum = 0;
-            for (unsigned int k = 0; k < n; k++)
-                sum += values[i][k] * operandmat->values[k][j];
-            ret->values[i][j] = sum;
-        }
+        for (unsigned int k = 0; k < n; k++)
+            QuickKernels::axpy(result->values[i], operandmat.values[k], values[i][k], operandmat.n);
     }
+}
 
+// ####################################
+
+QuickMatrix QuickMatrix::operator*(const QuickMatrix &operandmat) const
+{
+    QuickMatrix ret(m, operandmat.n);
+    multiply(operandmat, &ret);
     return ret;
 }
 
@@ -249,14 +304,13 @@ void QuickMatrix::dumpToAux() const
 
 void QuickMatrix::fillWithZero()
 {
-    for (unsigned int j = 0; j < m; j++) {
-        memset(values[j], 0, n * sizeof(double)); // fastest method. =)
-    }
+    // the rows may have been permuted, but they are all still in the block
+    memset(storage, 0, (m * ((n + 3) & ~3u) + 3) * sizeof(double)); // fastest method. =)
 }
 
 // ###################################
 // sets the diagonal to a constant.
-QuickMatrix *QuickMatrix::operator=(const double y)
+QuickMatrix &QuickMatrix::operator=(const double y)
 {
     fillWithZero();
     unsigned int size = n;
@@ -265,5 +319,5 @@ QuickMatrix *QuickMatrix::operator=(const double y)
 
     for (unsigned int i = 0; i < size; i++)
         values[i][i] = y;
-    return this;
+    return *this;
 }
@@ -33,6 +33,8 @@ public:
     QuickMatrix(CUI m_in, CUI n_in);
     QuickMatrix(CUI m_in);
     QuickMatrix(const QuickMatrix *old); // ye olde copy constructor.
+    QuickMatrix(const QuickMatrix &old);
+    QuickMatrix(QuickMatrix &&old) noexcept;
     ~QuickMatrix();
 
     // accessors
@@ -65,14 +67,25 @@ public:
     // utility functions:
     void fillWithZero();
 
-    // Matrix arithmetic.
-    QuickMatrix *operator+=(const QuickMatrix *othermat);
-    QuickMatrix *operator*=(const double y);
-    QuickMatrix *operator=(const double y); // sets the diagonal to a constant.
-                                            //	QuickMatrix *operator =(const QuickMatrix *oldmat);
-    QuickMatrix *operator*(const QuickMatrix *operandmat) const;
-
-    QuickVector *operator*(const QuickVector *operandvec) const;
+    // Matrix arithmetic. As with QuickVector, the operators that give a new
+    // matrix or vector are for convenience, and multiply works into one
+    // given to it without allocating.
+    QuickMatrix &operator=(QuickMatrix &&othermat) noexcept;
+    QuickMatrix &operator+=(const QuickMatrix &othermat);
+    QuickMatrix &operator*=(const double y);
+    QuickMatrix &operator=(const double y); // sets the diagonal to a constant.
+    QuickMatrix operator*(const QuickMatrix &operandmat) const;
+    QuickVector operator*(const QuickVector &operandvec) const;
+    /**
+     * Puts the product of this matrix and operandmat in result, which must
+     * be of the right size (and not either of the operands).
+     */
+    void multiply(const QuickMatrix &operandmat, QuickMatrix *result) const;
+    /**
+     * Puts the product of this matrix and operandvec in result, which must
+     * be of the right size (and not operandvec).
+     */
+    void multiply(const QuickVector &operandvec, QuickVector *result) const;
 
     // debugging
     void dumpToAux() const;
@@ -84,7 +97,8 @@ private:
     void allocator();
 
     unsigned int m, n;
-    double **values;
+    double **values; ///< pointers to the rows, which are swapped rather than the rows themselves
+    double *storage; ///< the one block that all the rows are in
 };
 
 #endif
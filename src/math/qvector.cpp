@@ -21,12 +21,15 @@
 // #ifndef QVECTOR_H
 #include "qvector.h"
 // #endif
+#include "qkernels.h"
 
 #include <QDebug>
 #include <cassert>
 #include <cmath>
 #include <cstdlib> // for null
+#include <cstring>
 #include <iostream>
+#include <utility>
 
 using namespace std;
 
@@ -95,6 +98,24 @@ QuickVector::QuickVector(const QuickVector *old)
 
 // #####################################
 
+QuickVector::QuickVector(const QuickVector &old)
+    : QuickVector(&old)
+{
+}
+
+// #####################################
+
+QuickVector::QuickVector(QuickVector &&old) noexcept
+    : m(old.m)
+    , changed(old.changed)
+    , values(old.values)
+{
+    old.m = 0;
+    old.values = nullptr;
+}
+
+// #####################################
+
 QuickVector::~QuickVector()
 {
     delete[] values;
@@ -119,17 +140,32 @@ void QuickVector::fillWithZeros()
 
 // #####################################
 
-QuickVector &QuickVector::operator-(const QuickVector &y) const
+QuickVector QuickVector::operator-(const QuickVector &y) const
 {
-    //	if(y.m != m) abort();
+    QuickVector ret(m);
+    ret.setDifference(*this, y);
+    return ret;
+}
 
-    QuickVector *ret;
-    ret = new QuickVector(m);
+// ####################################
+
+void QuickVector::setDifference(const QuickVector &a, const QuickVector &b)
+{
+    assert(a.m == m && b.m == m);
 
     for (unsigned int i = 0; i < m; i++)
-        ret->values[i] = values[i] - y.values[i];
+        values[i] = a.values[i] - b.values[i];
+    changed = true;
+}
+
+// ####################################
 
-    return *ret;
+void QuickVector::addScaled(const QuickVector &x, const double a)
+{
+    assert(x.m == m);
+
+    QuickKernels::axpy(values, x.values, a, m);
+    changed = true;
 }
 
 // ####################################
@@ -170,6 +206,26 @@ QuickVector &QuickVector::operator=(const QuickVector &y)
 
 // ###################################
 
+QuickVector &QuickVector::operator=(QuickVector &&y) noexcept
+{
+    std::swap(m, y.m);
+    std::swap(values, y.values);
+    changed = true;
+    return *this;
+}
+
+// ###################################
+
+QuickVector &QuickVector::operator*=(const double y)
+{
+    for (unsigned int i = 0; i < m; i++)
+        values[i] *= y;
+    changed = true;
+    return *this;
+}
+
+// ###################################
+
 QuickVector &QuickVector::operator*=(const QuickVector &y)
 {
     //	if(y.m != m) return nullptr;
@@ -33,6 +33,8 @@ public:
     QuickVector(CUI m_in);
     ~QuickVector();
     QuickVector(const QuickVector *old); // ye olde copy constructor.
+    QuickVector(const QuickVector &old);
+    QuickVector(QuickVector &&old) noexcept;
 
     double &operator[](const int i)
     {
@@ -55,18 +57,41 @@ public:
     {
         return m;
     }
+    /**
+     * The values, e.g. for solving into the vector in place.
+     */
+    double *data()
+    {
+        changed = true;
+        return values;
+    }
+    const double *data() const
+    {
+        return values;
+    }
 
     // utility functions:
     //	void fillWithRandom();
     void fillWithZeros();
     bool swapElements(CUI m_a, CUI m_b);
 
-    // Vector arithmetic.
+    // Vector arithmetic. The operators that give a new vector are for
+    // convenience; the solvers use the ones that work in place, or into a
+    // vector given to them, so that they do not allocate.
     QuickVector &operator=(const QuickVector &y);
+    QuickVector &operator=(QuickVector &&y) noexcept;
     QuickVector &operator*=(const double y);
     QuickVector &operator*=(const QuickVector &y);
     QuickVector &operator+=(const QuickVector &y);
-    QuickVector &operator-(const QuickVector &y) const;
+    QuickVector operator-(const QuickVector &y) const;
+    /**
+     * Sets this vector to a - b (either of which can be this vector).
+     */
+    void setDifference(const QuickVector &a, const QuickVector &b);
+    /**
+     * Adds a * x to this vector.
+     */
+    void addScaled(const QuickVector &x, const double a);
 
     // debugging
     void dumpToAux() const;
@@ -85,6 +110,13 @@ public:
     {
         changed = false;
     }
+    /**
+     * Marks the vector as changed, e.g. after writing to it through data().
+     */
+    inline void setChanged()
+    {
+        changed = true;
+    }
 
 private:
     // We don't have a default vector size so therefore we lock the default constructor.
@@ -137,7 +137,7 @@ void MechanicsDocument::appendDeleteList(KtlQCanvasItem *qcanvasItem)
     }
 
     m_itemDeleteList.append(mechItem);
-    m_itemList.remove(mechItem->id());
+    unlistItem(mechItem->id());
 
     disconnect(mechItem, SIGNAL(selectionChanged()), this, SIGNAL(selectionChanged()));
 
@@ -156,7 +156,7 @@ void MechanicsDocument::flushDeleteList()
 
     end = m_itemDeleteList.end();
     for (ItemList::iterator it = m_itemDeleteList.begin(); it != end; ++it) {
-        m_itemList.remove((*it)->id());
+        unlistItem((*it)->id());
         (*it)->setCanvas(nullptr);
         delete *it;
     }
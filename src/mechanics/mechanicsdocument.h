@@ -57,6 +57,10 @@ public:
      * Register an item with the ICNDocument.
      */
     bool registerItem(KtlQCanvasItem *qcanvasItem) override;
+    MechanicsSimulation *mechanicsSimulation() const
+    {
+        return m_mechanicsSimulation;
+    }
 
 protected:
     MechanicsGroup *m_selectList;
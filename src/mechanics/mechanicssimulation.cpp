@@ -12,32 +12,300 @@
 #include "mechanicsdocument.h"
 #include "mechanicsitem.h"
 
+#include <QSet>
 #include <QTimer>
+#include <QVector>
+
+#include <algorithm>
 #include <cmath>
 
 MechanicsSimulation::MechanicsSimulation(MechanicsDocument *mechanicsDocument)
     : QObject(mechanicsDocument)
 {
     p_mechanicsDocument = mechanicsDocument;
+    m_unsteppedTime = 0.;
     m_advanceTmr = new QTimer(this);
     connect(m_advanceTmr, SIGNAL(timeout()), this, SLOT(slotAdvance()));
-    m_advanceTmr->start(20); // it is not implemented anyway, so don't hog the CPU
+    // The timer is only started when a body is woken up
 }
 
 MechanicsSimulation::~MechanicsSimulation()
 {
+    qDeleteAll(m_rigidBodies);
+}
+
+void MechanicsSimulation::applyImpulse(MechanicsItem *item, const Vector2D &impulse, double angularImpulse)
+{
+    if (RigidBody *body = rigidBody(item)) {
+        body->applyImpulse(impulse, angularImpulse);
+        startAdvancing();
+    }
+}
+
+void MechanicsSimulation::wake(MechanicsItem *item)
+{
+    if (RigidBody *body = rigidBody(item)) {
+        body->wake();
+        startAdvancing();
+    }
+}
+
+void MechanicsSimulation::startAdvancing()
+{
+    if (m_advanceTmr->isActive())
+        return;
+
+    m_unsteppedTime = 0.;
+    m_advanceTime.start();
+    m_advanceTmr->start(ADVANCE_INTERVAL_MS);
+}
+
+RigidBody *MechanicsSimulation::rigidBody(MechanicsItem *item)
+{
+    if (!item)
+        return nullptr;
+
+    while (MechanicsItem *parent = dynamic_cast<MechanicsItem *>(item->parentItem()))
+        item = parent;
+
+    updateRigidBodies();
+    return m_rigidBodies.value(item);
+}
+
+void MechanicsSimulation::updateRigidBodies()
+{
+    if (!p_mechanicsDocument)
+        return;
+
+    QSet<MechanicsItem *> topLevel;
+    const ItemList items = p_mechanicsDocument->itemList();
+    for (ItemList::const_iterator it = items.begin(); it != items.end(); ++it) {
+        MechanicsItem *item = dynamic_cast<MechanicsItem *>(static_cast<Item *>(*it));
+        if (item && !dynamic_cast<MechanicsItem *>(item->parentItem()))
+            topLevel.insert(item);
+    }
+
+    // Items that have gone, or have been attached to another
+    for (QHash<MechanicsItem *, RigidBody *>::iterator it = m_rigidBodies.begin(); it != m_rigidBodies.end();) {
+        if (!topLevel.contains(it.key()) || it.value()->overallParent() != it.key()) {
+            delete it.value();
+            it = m_rigidBodies.erase(it);
+        } else
+            ++it;
+    }
+
+    for (MechanicsItem *item : topLevel) {
+        if (m_rigidBodies.contains(item))
+            continue;
+
+        RigidBody *body = new RigidBody(p_mechanicsDocument);
+        body->addMechanicsItem(item);
+        m_rigidBodies.insert(item, body);
+    }
 }
 
 void MechanicsSimulation::slotAdvance()
 {
-    // 	if ( p_mechanicsDocument && p_mechanicsDocument->canvas() )
-    // 		p_mechanicsDocument->canvas()->advance();
+    m_unsteppedTime += m_advanceTime.restart() * 1e-3;
+
+    int steps = int(m_unsteppedTime / TIMESTEP);
+    m_unsteppedTime -= steps * TIMESTEP;
+    steps = std::min(steps, MAX_STEPS_PER_ADVANCE);
+    if (steps == 0)
+        return;
+
+    updateRigidBodies();
+
+    for (int step = 0; step < steps; ++step) {
+        for (int phase = 0; phase < 2; ++phase) {
+            for (RigidBody *body : qAsConst(m_rigidBodies))
+                body->advance(phase, TIMESTEP);
+        }
+        collide();
+    }
+
+    bool awake = false;
+    for (RigidBody *body : qAsConst(m_rigidBodies))
+        awake |= body->isAwake();
+
+    if (!awake)
+        m_advanceTmr->stop();
+}
+
+void MechanicsSimulation::collide()
+{
+    const QVector<RigidBody *> bodies = QVector<RigidBody *>::fromList(m_rigidBodies.values());
+    QVector<QRect> rects(bodies.size());
+    for (int i = 0; i < bodies.size(); ++i) {
+        bodies[i]->updateRigidBodyInfo();
+        rects[i] = bodies[i]->boundingRect();
+    }
+
+    // Put each body in the cells of the grid that its rectangle covers
+    QHash<quint64, QVector<int>> cells;
+    for (int i = 0; i < bodies.size(); ++i) {
+        const QRect &rect = rects[i];
+        if (rect.isEmpty())
+            continue;
+
+        const int left = int(std::floor(double(rect.left()) / COLLISION_CELL_SIZE));
+        const int right = int(std::floor(double(rect.right()) / COLLISION_CELL_SIZE));
+        const int top = int(std::floor(double(rect.top()) / COLLISION_CELL_SIZE));
+        const int bottom = int(std::floor(double(rect.bottom()) / COLLISION_CELL_SIZE));
+        for (int cx = left; cx <= right; ++cx) {
+            for (int cy = top; cy <= bottom; ++cy)
+                cells[(quint64(quint32(cx)) << 32) | quint32(cy)].append(i);
+        }
+    }
+
+    // Only pairs with a body that is awake can have started touching
+    QSet<quint64> tested;
+    for (QHash<quint64, QVector<int>>::const_iterator cell = cells.constBegin(); cell != cells.constEnd(); ++cell) {
+        const QVector<int> &inCell = cell.value();
+        for (int m = 0; m < inCell.size(); ++m) {
+            for (int n = m + 1; n < inCell.size(); ++n) {
+                const int i = std::min(inCell[m], inCell[n]);
+                const int j = std::max(inCell[m], inCell[n]);
+                if (!bodies[i]->isAwake() && !bodies[j]->isAwake())
+                    continue;
+
+                const quint64 pair = (quint64(i) << 32) | quint64(j);
+                if (tested.contains(pair))
+                    continue;
+                tested.insert(pair);
+
+                if (!rects[i].intersects(rects[j]))
+                    continue;
+
+                resolveCollision(bodies[i], rects[i], bodies[j], rects[j]);
+                rects[i] = bodies[i]->boundingRect();
+                rects[j] = bodies[j]->boundingRect();
+            }
+        }
+    }
+}
+
+void MechanicsSimulation::resolveCollision(RigidBody *a, const QRect &rectA, RigidBody *b, const QRect &rectB)
+{
+    const double invA = a->inverseMass();
+    const double invB = b->inverseMass();
+    if (invA + invB <= 0.)
+        return;
+
+    // Push apart along the axis that they overlap the least in
+    const double overlapX = std::min(rectA.right(), rectB.right()) - std::max(rectA.left(), rectB.left()) + 1;
+    const double overlapY = std::min(rectA.bottom(), rectB.bottom()) - std::max(rectA.top(), rectB.top()) + 1;
+
+    Vector2D normal;
+    double overlap;
+    if (overlapX < overlapY) {
+        normal.x = (rectB.center().x() >= rectA.center().x()) ? 1. : -1.;
+        overlap = overlapX;
+    } else {
+        normal.y = (rectB.center().y() >= rectA.center().y()) ? 1. : -1.;
+        overlap = overlapY;
+    }
+
+    a->wake();
+    b->wake();
+
+    a->displace(-normal.x * overlap * invA / (invA + invB), -normal.y * overlap * invA / (invA + invB));
+    b->displace(normal.x * overlap * invB / (invA + invB), normal.y * overlap * invB / (invA + invB));
+
+    // Bounce, if they are moving towards each other
+    const Vector2D va = a->velocity();
+    const Vector2D vb = b->velocity();
+    const double closing = (vb.x - va.x) * normal.x + (vb.y - va.y) * normal.y;
+    if (closing >= 0.)
+        return;
+
+    const double j = -(1. + RigidBody::RESTITUTION) * closing / (invA + invB);
+    Vector2D impulse;
+    impulse.x = j * normal.x;
+    impulse.y = j * normal.y;
+    b->applyImpulse(impulse);
+    impulse.x = -impulse.x;
+    impulse.y = -impulse.y;
+    a->applyImpulse(impulse);
 }
 
 RigidBody::RigidBody(MechanicsDocument *mechanicsDocument)
 {
     p_mechanicsDocument = mechanicsDocument;
     p_overallParent = nullptr;
+    m_mass = 0.;
+    m_momentOfInertia = 0.;
+    m_bAwake = false;
+    m_stillTime = 0.;
+}
+
+void RigidBody::advance(int phase, double delta)
+{
+    if (!m_bAwake || !p_overallParent)
+        return;
+
+    if (phase == 0) {
+        const double linear = std::exp(-LINEAR_FRICTION * delta);
+        m_rigidBodyState.linearMomentum.x *= linear;
+        m_rigidBodyState.linearMomentum.y *= linear;
+        m_rigidBodyState.angularMomentum *= std::exp(-ANGULAR_FRICTION * delta);
+        return;
+    }
+
+    updateRigidBodyInfo();
+
+    const Vector2D v = velocity();
+    const double omega = (m_momentOfInertia > 0.) ? m_rigidBodyState.angularMomentum / m_momentOfInertia : 0.;
+
+    if (v.x != 0. || v.y != 0.)
+        moveBy(v.x * delta, v.y * delta);
+    if (omega != 0.)
+        rotateBy(omega * delta);
+
+    if (v.length() < SLEEP_SPEED && std::abs(omega) < SLEEP_ANGULAR_SPEED)
+        m_stillTime += delta;
+    else
+        m_stillTime = 0.;
+
+    if (m_stillTime >= SLEEP_TIME) {
+        m_bAwake = false;
+        m_rigidBodyState.linearMomentum = Vector2D();
+        m_rigidBodyState.angularMomentum = 0.;
+    }
+}
+
+void RigidBody::applyImpulse(const Vector2D &impulse, double angularImpulse)
+{
+    m_rigidBodyState.linearMomentum.x += impulse.x;
+    m_rigidBodyState.linearMomentum.y += impulse.y;
+    m_rigidBodyState.angularMomentum += angularImpulse;
+    wake();
+}
+
+void RigidBody::wake()
+{
+    m_bAwake = true;
+    m_stillTime = 0.;
+}
+
+Vector2D RigidBody::velocity() const
+{
+    Vector2D v;
+    if (m_mass > 0.) {
+        v.x = m_rigidBodyState.linearMomentum.x / m_mass;
+        v.y = m_rigidBodyState.linearMomentum.y / m_mass;
+    }
+    return v;
+}
+
+double RigidBody::inverseMass() const
+{
+    return (m_mass > 0.) ? 1. / m_mass : 0.;
+}
+
+QRect RigidBody::boundingRect() const
+{
+    return p_overallParent ? p_overallParent->boundingRect() : QRect();
 }
 
 RigidBody::~RigidBody()
@@ -98,8 +366,10 @@ bool RigidBody::findOverallParent()
 
 void RigidBody::updateRigidBodyInfo()
 {
-    if (!p_overallParent)
+    if (!p_overallParent) {
+        m_mass = m_momentOfInertia = 0.;
         return;
+    }
 
     m_mass = p_overallParent->mechanicsInfoCombined()->mass;
     m_momentOfInertia = p_overallParent->mechanicsInfoCombined()->momentOfInertia;
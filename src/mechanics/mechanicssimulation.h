@@ -11,13 +11,17 @@
 #ifndef MECHANICSSIMULATION_H
 #define MECHANICSSIMULATION_H
 
+#include <QElapsedTimer>
+#include <QHash>
 #include <QList>
 #include <QObject>
 #include <QPointer>
+#include <QRect>
 
 class QTimer;
 class MechanicsItem;
 class MechanicsDocument;
+class RigidBody;
 typedef QList<MechanicsItem *> MechanicsItemList;
 
 /**
@@ -54,6 +58,14 @@ public:
 };
 
 /**
+Moves the top level MechanicsItems of a document about as rigid bodies, in
+fixed time steps. Bodies slow down with friction, bounce off each other, and
+go to sleep once they have come to rest; the advance timer only runs while a
+body is awake.
+
+Collisions are found with a uniform grid over the bounding rectangles of the
+bodies (so only bodies in the same cells are tested against each other), and
+are resolved on those rectangles, without turning the bodies.
 @author David Saxton
 */
 class MechanicsSimulation : public QObject
@@ -67,13 +79,67 @@ public:
     {
         return p_mechanicsDocument;
     }
+    /**
+     * Adds the impulse (and angular impulse) to the rigid body that the item
+     * is part of, waking it up.
+     */
+    void applyImpulse(MechanicsItem *item, const Vector2D &impulse, double angularImpulse = 0.);
+    /**
+     * Wakes up the rigid body that the item is part of, e.g. as it has been
+     * moved, so that it is pushed out of anything that it now overlaps.
+     */
+    void wake(MechanicsItem *item);
+
+    /**
+     * Length of a time step, in seconds.
+     */
+    static constexpr double TIMESTEP = 0.005;
+    /**
+     * Interval of the advance timer, while a body is awake.
+     */
+    static const int ADVANCE_INTERVAL_MS = 20;
+    /**
+     * Most time steps taken in one advance, so that a slow advance does not
+     * make the next one slower still.
+     */
+    static const int MAX_STEPS_PER_ADVANCE = 8;
+    /**
+     * Size of the cells of the collision grid, in pixels.
+     */
+    static const int COLLISION_CELL_SIZE = 64;
 
 protected slots:
     void slotAdvance();
 
 protected:
+    /**
+     * Brings the rigid bodies in line with the top level items of the
+     * document.
+     */
+    void updateRigidBodies();
+    /**
+     * @return the rigid body of the top level item that the item is part of
+     */
+    RigidBody *rigidBody(MechanicsItem *item);
+    /**
+     * Finds and resolves the collisions of the awake bodies.
+     */
+    void collide();
+    /**
+     * Pushes the bodies, whose rectangles overlap, apart, and bounces them
+     * off each other.
+     */
+    static void resolveCollision(RigidBody *a, const QRect &rectA, RigidBody *b, const QRect &rectB);
+    /**
+     * Starts the advance timer, if it is not running.
+     */
+    void startAdvancing();
+
     QPointer<MechanicsDocument> p_mechanicsDocument;
     QTimer *m_advanceTmr;
+    QElapsedTimer m_advanceTime; ///< Since the last advance
+    double m_unsteppedTime;      ///< Time passed that is less than a step
+    QHash<MechanicsItem *, RigidBody *> m_rigidBodies;
 };
 
 /**
@@ -90,9 +156,45 @@ public:
     ~RigidBody();
 
     /**
-     *
+     * Advances the body by delta seconds, in two phases (as a canvas does):
+     * phase 0 applies friction to the momentum, and phase 1 moves and turns
+     * the items, and sends the body to sleep once it has been still for
+     * long enough. Does nothing while asleep.
      */
     void advance(int phase, double delta);
+    /**
+     * Adds to the momentum of the body, waking it up.
+     */
+    void applyImpulse(const Vector2D &impulse, double angularImpulse = 0.);
+    /**
+     * Moves the body without changing its momentum (e.g. out of another).
+     */
+    void displace(double dx, double dy)
+    {
+        moveBy(dx, dy);
+    }
+    Vector2D velocity() const;
+    /**
+     * @return one over the mass, or zero if the body has no mass
+     */
+    double inverseMass() const;
+    /**
+     * @return the bounding rectangle of the items, on the canvas
+     */
+    QRect boundingRect() const;
+
+    bool isAwake() const
+    {
+        return m_bAwake;
+    }
+    void wake();
+
+    static constexpr double LINEAR_FRICTION = 1.5;       ///< Fraction of momentum lost per second
+    static constexpr double ANGULAR_FRICTION = 1.5;      ///< Fraction of angular momentum lost per second
+    static constexpr double SLEEP_SPEED = 2.;            ///< Pixels per second below which a body is still
+    static constexpr double SLEEP_ANGULAR_SPEED = 0.02;  ///< Radians per second below which a body is still
+    static constexpr double SLEEP_TIME = 0.5;            ///< Seconds a body is still for before sleeping
+    static constexpr double RESTITUTION = 0.5;           ///< Fraction of speed kept in a collision
     /**
      * Add the MechanicsItem to the entity.
      * @returns true iff successful in adding
@@ -128,12 +230,14 @@ protected:
     void rotateBy(double dtheta);
 
     MechanicsItemList m_mechanicsItemList;
-    MechanicsItem *p_overallParent;
+    QPointer<MechanicsItem> p_overallParent;
     MechanicsDocument *p_mechanicsDocument;
 
     RigidBodyState m_rigidBodyState;
     double m_mass;
     double m_momentOfInertia;
+    bool m_bAwake;
+    double m_stillTime; ///< Seconds for which the body has been still
 };
 
 #endif
@@ -0,0 +1,54 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <QtGlobal>
+
+/**
+The memory that an ItemDocument is using, broken down by the subsystems that
+it goes on, as estimated by the memoryUsage functions of each. Only the large
+parts are counted (e.g. the samples held by a probe, but not the probe), so
+the total is a lower bound.
+@see ItemDocument::memoryUsage
+*/
+class MemoryUsage
+{
+public:
+    enum Subsystem {
+        UndoHistory,           ///< the current state and the undo / redo deltas
+        ProbeData,             ///< samples recorded by the probes
+        LogicCaches,           ///< solutions cached by the circuits for each state of their logic outputs
+        RoutingCells,          ///< the cells that connectors are routed through
+        CanvasChunks,          ///< the lists of the items in each chunk of the canvas
+        CanvasTiles,           ///< rendered tiles of the canvas, shared by its views
+        HiddenSubcircuitItems, ///< the components, connectors and nodes inside subcircuits
+        SubsystemCount
+    };
+
+    MemoryUsage()
+    {
+        for (int i = 0; i < SubsystemCount; ++i)
+            bytes[i] = 0;
+    }
+
+    qint64 total() const
+    {
+        qint64 total = 0;
+        for (int i = 0; i < SubsystemCount; ++i)
+            total += bytes[i];
+        return total;
+    }
+
+    qint64 bytes[SubsystemCount];
+};
+
+#endif
@@ -12,13 +12,21 @@
 #include "micropackage.h"
 
 MicroInfo::MicroInfo()
+    : m_pinCount(0)
+    , m_pins(nullptr)
+    , m_pinAssignmentCount(0)
 {
-    m_package = nullptr;
 }
 
 MicroInfo::~MicroInfo()
 {
-    delete m_package;
+}
+
+MicroPackage *MicroInfo::package() const
+{
+    if (!m_pins)
+        return nullptr;
+    return MicroPackage::package(m_pinCount, m_pins, m_pinAssignmentCount);
 }
 
 #if 0
@@ -11,10 +11,11 @@
 #ifndef MICROINFO_H
 #define MICROINFO_H
 
+#include "micropackage.h"
+
 #include <QStringList>
 
 class AsmInfo;
-class MicroPackage;
 
 /**
 @author David Saxton
@@ -51,12 +52,10 @@ public:
         return NoSupport;
     }
     /**
-     * Returns a pointer to the Micro Package in use
+     * Returns a pointer to the Micro Package in use, which is shared with
+     * other micros having the same pins. It is built when first asked for.
      */
-    MicroPackage *package() const
-    {
-        return m_package;
-    }
+    MicroPackage *package() const;
     /**
      * Returns an id unique to the Micro
      */
@@ -66,8 +65,21 @@ public:
     }
 
 protected:
+    /**
+     * Sets the pins of the package, from a constant table. This only keeps
+     * the table, so that creating the micro costs nothing for the package.
+     */
+    template<int N> void setPackage(int pinCount, const PicPinAssignment (&pins)[N])
+    {
+        m_pinCount = pinCount;
+        m_pins = pins;
+        m_pinAssignmentCount = N;
+    }
+
     QString m_id;
-    MicroPackage *m_package;
+    int m_pinCount;
+    const PicPinAssignment *m_pins; ///< Null if the micro has no package
+    int m_pinAssignmentCount;
 };
 
 #endif
@@ -81,20 +81,17 @@ MicroLibrary::~MicroLibrary()
 
 MicroInfo *MicroLibrary::microInfoWithID(QString id)
 {
-    id = id.toUpper();
-    const MicroInfoList::iterator end = m_microInfoList.end();
-    for (MicroInfoList::iterator it = m_microInfoList.begin(); it != end; ++it) {
-        if ((*it)->id() == id)
-            return *it;
-    }
-
-    return nullptr;
+    return m_microInfoByID.value(id.toUpper(), nullptr);
 }
 
 void MicroLibrary::addMicroInfo(MicroInfo *microInfo)
 {
-    if (microInfo)
-        m_microInfoList += microInfo;
+    if (!microInfo)
+        return;
+
+    m_microInfoList += microInfo;
+    if (!m_microInfoByID.contains(microInfo->id()))
+        m_microInfoByID.insert(microInfo->id(), microInfo);
 }
 
 QStringList MicroLibrary::microIDs(unsigned asmSet, unsigned gpsimSupport, unsigned flowCodeSupport, unsigned microbeSupport)
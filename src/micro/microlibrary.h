@@ -14,6 +14,7 @@
 #include "asminfo.h"
 #include "microinfo.h"
 
+#include <QHash>
 #include <QList>
 #include <QString>
 #include <QStringList>
@@ -51,6 +52,7 @@ private:
     // 		static MicroLibrary * m_pSelf;
 
     MicroInfoList m_microInfoList;
+    QHash<QString, MicroInfo *> m_microInfoByID;
     friend MicroLibrary *microLibrary();
 };
 
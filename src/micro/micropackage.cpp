@@ -10,8 +10,25 @@
 
 #include "micropackage.h"
 
+#include <QGlobalStatic>
+#include <QHash>
+
 #include <ktechlab_debug.h>
 
+namespace
+{
+class PackageCache : public QHash<const PicPinAssignment *, MicroPackage *>
+{
+public:
+    ~PackageCache()
+    {
+        qDeleteAll(*this);
+    }
+};
+}
+
+Q_GLOBAL_STATIC(PackageCache, globalPackageCache);
+
 PicPin::PicPin()
 {
     pinID = QString::fromLatin1("INVALID");
@@ -37,6 +54,17 @@ MicroPackage::~MicroPackage()
 {
 }
 
+MicroPackage *MicroPackage::package(int pinCount, const PicPinAssignment *pins, int assignmentCount)
+{
+    MicroPackage *&package = (*globalPackageCache)[pins];
+    if (!package) {
+        package = new MicroPackage(pinCount);
+        for (int i = 0; i < assignmentCount; ++i)
+            package->assignPin(pins[i].pinPosition, pins[i].type, pins[i].pinID, pins[i].portName, pins[i].portPosition);
+    }
+    return package;
+}
+
 void MicroPackage::assignPin(int pinPosition, PicPin::pin_type type, const QString &pinID, const QString &portName, int portPosition)
 {
     if (m_picPinMap.find(pinPosition) != m_picPinMap.end()) {
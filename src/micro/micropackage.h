@@ -46,6 +46,20 @@ public:
 
 typedef QMap<int, PicPin> PicPinMap;
 
+/**
+A pin of a package, as given in the constant tables of pins that the packages
+are built from (see MicroPackage::package).
+*/
+class PicPinAssignment
+{
+public:
+    int pinPosition;
+    PicPin::pin_type type;
+    const char *pinID;
+    const char *portName; ///< "" if the pin does not belong to a port
+    int portPosition;     ///< -1 if the pin does not belong to a port
+};
+
 /**
 @short Describes the PIC package (i.e. pins)
 @author David Saxton
@@ -56,6 +70,13 @@ public:
     MicroPackage(const int pinCount);
     virtual ~MicroPackage();
 
+    /**
+     * @return the package with the pins in the table, which is built the first
+     * time it is asked for and then shared by all the micros using the
+     * table. The packages are deleted when the program exits.
+     */
+    static MicroPackage *package(int pinCount, const PicPinAssignment *pins, int assignmentCount);
+
     /**
      * Assigns a pin to a position in the package.
      */
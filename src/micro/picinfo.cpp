@@ -13,7 +13,6 @@
 PicInfo::PicInfo()
     : MicroInfo()
 {
-    m_package = nullptr;
 }
 
 PicInfo::~PicInfo()
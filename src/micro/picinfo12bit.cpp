@@ -84,34 +84,35 @@ PicAsm12bit::PicAsm12bit()
     addInstruction("XORLW", nullptr, "1111kkkkkkkk");
 }
 
+static constexpr PicPinAssignment pic16C54Pins[] = {
+    {17, PicPin::type_bidir, "RA0", "PORTA", 0},
+    {18, PicPin::type_bidir, "RA1", "PORTA", 1},
+    {1, PicPin::type_bidir, "RA2", "PORTA", 2},
+    {2, PicPin::type_bidir, "RA3", "PORTA", 3},
+    {3, PicPin::type_open, "RA4", "PORTA", 4},
+
+    {6, PicPin::type_bidir, "RB0", "PORTB", 0},
+    {7, PicPin::type_bidir, "RB1", "PORTB", 1},
+    {8, PicPin::type_bidir, "RB2", "PORTB", 2},
+    {9, PicPin::type_bidir, "RB3", "PORTB", 3},
+    {10, PicPin::type_bidir, "RB4", "PORTB", 4},
+    {11, PicPin::type_bidir, "RB5", "PORTB", 5},
+    {12, PicPin::type_bidir, "RB6", "PORTB", 6},
+    {13, PicPin::type_bidir, "RB7", "PORTB", 7},
+
+    {4, PicPin::type_mclr, "MCLR", "", -1},
+    {5, PicPin::type_vss, "VSS", "", -1},
+    {14, PicPin::type_vdd, "VDD", "", -1},
+    {15, PicPin::type_osc, "OSC2", "", -1},
+    {16, PicPin::type_osc, "OSC1", "", -1},
+};
+
 PicInfo16C54::PicInfo16C54()
     : PicInfo12bit()
 {
     m_id = "P16C54";
 
-    delete m_package;
-    m_package = new MicroPackage(18);
-
-    m_package->assignPin(17, PicPin::type_bidir, "RA0", "PORTA", 0);
-    m_package->assignPin(18, PicPin::type_bidir, "RA1", "PORTA", 1);
-    m_package->assignPin(1, PicPin::type_bidir, "RA2", "PORTA", 2);
-    m_package->assignPin(2, PicPin::type_bidir, "RA3", "PORTA", 3);
-    m_package->assignPin(3, PicPin::type_open, "RA4", "PORTA", 4);
-
-    m_package->assignPin(6, PicPin::type_bidir, "RB0", "PORTB", 0);
-    m_package->assignPin(7, PicPin::type_bidir, "RB1", "PORTB", 1);
-    m_package->assignPin(8, PicPin::type_bidir, "RB2", "PORTB", 2);
-    m_package->assignPin(9, PicPin::type_bidir, "RB3", "PORTB", 3);
-    m_package->assignPin(10, PicPin::type_bidir, "RB4", "PORTB", 4);
-    m_package->assignPin(11, PicPin::type_bidir, "RB5", "PORTB", 5);
-    m_package->assignPin(12, PicPin::type_bidir, "RB6", "PORTB", 6);
-    m_package->assignPin(13, PicPin::type_bidir, "RB7", "PORTB", 7);
-
-    m_package->assignPin(4, PicPin::type_mclr, "MCLR");
-    m_package->assignPin(5, PicPin::type_vss, "VSS");
-    m_package->assignPin(14, PicPin::type_vdd, "VDD");
-    m_package->assignPin(15, PicPin::type_osc, "OSC2");
-    m_package->assignPin(16, PicPin::type_osc, "OSC1");
+    setPackage(18, pic16C54Pins);
 }
 
 PicInfo16C54::~PicInfo16C54()
@@ -128,23 +129,24 @@ PicInfo16C55::~PicInfo16C55()
 {
 }
 
+static constexpr PicPinAssignment pic12C508Pins[] = {
+    {7, PicPin::type_bidir, "GP0", "GPIO", 0},
+    {6, PicPin::type_bidir, "GP1", "GPIO", 1},
+    {5, PicPin::type_bidir, "GP2", "GPIO", 2},
+    {4, PicPin::type_input, "GP3", "GPIO", 3},
+    {3, PicPin::type_bidir, "GP4", "GPIO", 4},
+    {2, PicPin::type_bidir, "GP5", "GPIO", 5},
+
+    {8, PicPin::type_vss, "VSS", "", -1},
+    {1, PicPin::type_vdd, "VDD", "", -1},
+};
+
 PicInfo12C508::PicInfo12C508()
     : PicInfo12bit()
 {
     m_id = "P12C508";
 
-    delete m_package;
-    m_package = new MicroPackage(8);
-
-    m_package->assignPin(7, PicPin::type_bidir, "GP0", "GPIO", 0);
-    m_package->assignPin(6, PicPin::type_bidir, "GP1", "GPIO", 1);
-    m_package->assignPin(5, PicPin::type_bidir, "GP2", "GPIO", 2);
-    m_package->assignPin(4, PicPin::type_input, "GP3", "GPIO", 3);
-    m_package->assignPin(3, PicPin::type_bidir, "GP4", "GPIO", 4);
-    m_package->assignPin(2, PicPin::type_bidir, "GP5", "GPIO", 5);
-
-    m_package->assignPin(8, PicPin::type_vss, "VSS");
-    m_package->assignPin(1, PicPin::type_vdd, "VDD");
+    setPackage(8, pic12C508Pins);
 }
 
 PicInfo12C508::~PicInfo12C508()
@@ -195,65 +195,64 @@ PicInfo18C252::~PicInfo18C252()
 {
 }
 
+static constexpr PicPinAssignment pic18C4x2Pins[] = {
+    {2, PicPin::type_bidir, "RA0", "PORTA", 0},
+    {3, PicPin::type_bidir, "RA1", "PORTA", 1},
+    {4, PicPin::type_bidir, "RA2", "PORTA", 2},
+    {5, PicPin::type_bidir, "RA3", "PORTA", 3},
+    {6, PicPin::type_open, "RA4", "PORTA", 4},
+    {7, PicPin::type_bidir, "RA5", "PORTB", 5},
+
+    {33, PicPin::type_bidir, "RB0", "PORTB", 0},
+    {34, PicPin::type_bidir, "RB1", "PORTB", 1},
+    {35, PicPin::type_bidir, "RB2", "PORTB", 2},
+    {36, PicPin::type_bidir, "RB3", "PORTB", 3},
+    {37, PicPin::type_bidir, "RB4", "PORTB", 4},
+    {38, PicPin::type_bidir, "RB5", "PORTB", 5},
+    {39, PicPin::type_bidir, "RB6", "PORTB", 6},
+    {40, PicPin::type_bidir, "RB7", "PORTB", 7},
+
+    {15, PicPin::type_bidir, "RC0", "PORTC", 0},
+    {16, PicPin::type_bidir, "RC1", "PORTC", 1},
+    {17, PicPin::type_bidir, "RC2", "PORTC", 2},
+    {18, PicPin::type_bidir, "RC3", "PORTC", 3},
+    {23, PicPin::type_bidir, "RC4", "PORTC", 4},
+    {24, PicPin::type_bidir, "RC5", "PORTC", 5},
+    {25, PicPin::type_bidir, "RC6", "PORTC", 6},
+    {26, PicPin::type_bidir, "RC7", "PORTC", 7},
+
+    {19, PicPin::type_bidir, "RD0", "PORTD", 0},
+    {20, PicPin::type_bidir, "RD1", "PORTD", 1},
+    {21, PicPin::type_bidir, "RD2", "PORTD", 2},
+    {22, PicPin::type_bidir, "RD3", "PORTD", 3},
+    {27, PicPin::type_bidir, "RD4", "PORTD", 4},
+    {28, PicPin::type_bidir, "RD5", "PORTD", 5},
+    {29, PicPin::type_bidir, "RD6", "PORTD", 6},
+    {30, PicPin::type_bidir, "RD7", "PORTD", 7},
+
+    {8, PicPin::type_bidir, "RE0", "PORTE", 0},
+    {9, PicPin::type_bidir, "RE1", "PORTE", 1},
+    {10, PicPin::type_bidir, "RE2", "PORTE", 2},
+
+    {1, PicPin::type_mclr, "MCLR", "", -1},
+    {11, PicPin::type_vdd, "VDD", "", -1},
+    {12, PicPin::type_vss, "VSS", "", -1},
+    {13, PicPin::type_osc, "OSC1", "", -1},
+    {14, PicPin::type_osc, "OSC2", "", -1},
+    {31, PicPin::type_vss, "VSS", "", -1},
+    {32, PicPin::type_vdd, "VDD", "", -1},
+};
+
 PicInfo18C4x2::PicInfo18C4x2()
     : PicInfo16bit()
 {
     m_id = QString::fromLatin1("P18C4x2");
 
-    delete m_package;
-    m_package = new MicroPackage(40);
-
-    m_package->assignPin(2, PicPin::type_bidir, "RA0", "PORTA", 0);
-    m_package->assignPin(3, PicPin::type_bidir, "RA1", "PORTA", 1);
-    m_package->assignPin(4, PicPin::type_bidir, "RA2", "PORTA", 2);
-    m_package->assignPin(5, PicPin::type_bidir, "RA3", "PORTA", 3);
-    m_package->assignPin(6, PicPin::type_open, "RA4", "PORTA", 4);
-    m_package->assignPin(7, PicPin::type_bidir, "RA5", "PORTB", 5);
-
-    m_package->assignPin(33, PicPin::type_bidir, "RB0", "PORTB", 0);
-    m_package->assignPin(34, PicPin::type_bidir, "RB1", "PORTB", 1);
-    m_package->assignPin(35, PicPin::type_bidir, "RB2", "PORTB", 2);
-    m_package->assignPin(36, PicPin::type_bidir, "RB3", "PORTB", 3);
-    m_package->assignPin(37, PicPin::type_bidir, "RB4", "PORTB", 4);
-    m_package->assignPin(38, PicPin::type_bidir, "RB5", "PORTB", 5);
-    m_package->assignPin(39, PicPin::type_bidir, "RB6", "PORTB", 6);
-    m_package->assignPin(40, PicPin::type_bidir, "RB7", "PORTB", 7);
-
-    m_package->assignPin(15, PicPin::type_bidir, "RC0", "PORTC", 0);
-    m_package->assignPin(16, PicPin::type_bidir, "RC1", "PORTC", 1);
-    m_package->assignPin(17, PicPin::type_bidir, "RC2", "PORTC", 2);
-    m_package->assignPin(18, PicPin::type_bidir, "RC3", "PORTC", 3);
-    m_package->assignPin(23, PicPin::type_bidir, "RC4", "PORTC", 4);
-    m_package->assignPin(24, PicPin::type_bidir, "RC5", "PORTC", 5);
-    m_package->assignPin(25, PicPin::type_bidir, "RC6", "PORTC", 6);
-    m_package->assignPin(26, PicPin::type_bidir, "RC7", "PORTC", 7);
-
-    m_package->assignPin(19, PicPin::type_bidir, "RD0", "PORTD", 0);
-    m_package->assignPin(20, PicPin::type_bidir, "RD1", "PORTD", 1);
-    m_package->assignPin(21, PicPin::type_bidir, "RD2", "PORTD", 2);
-    m_package->assignPin(22, PicPin::type_bidir, "RD3", "PORTD", 3);
-    m_package->assignPin(27, PicPin::type_bidir, "RD4", "PORTD", 4);
-    m_package->assignPin(28, PicPin::type_bidir, "RD5", "PORTD", 5);
-    m_package->assignPin(29, PicPin::type_bidir, "RD6", "PORTD", 6);
-    m_package->assignPin(30, PicPin::type_bidir, "RD7", "PORTD", 7);
-
-    m_package->assignPin(8, PicPin::type_bidir, "RE0", "PORTE", 0);
-    m_package->assignPin(9, PicPin::type_bidir, "RE1", "PORTE", 1);
-    m_package->assignPin(10, PicPin::type_bidir, "RE2", "PORTE", 2);
-
-    m_package->assignPin(1, PicPin::type_mclr, "MCLR");
-    m_package->assignPin(11, PicPin::type_vdd, "VDD");
-    m_package->assignPin(12, PicPin::type_vss, "VSS");
-    m_package->assignPin(13, PicPin::type_osc, "OSC1");
-    m_package->assignPin(14, PicPin::type_osc, "OSC2");
-    m_package->assignPin(31, PicPin::type_vss, "VSS");
-    m_package->assignPin(32, PicPin::type_vdd, "VDD");
+    setPackage(40, pic18C4x2Pins);
 }
 
 PicInfo18C4x2::~PicInfo18C4x2()
 {
-    delete m_package;
-    m_package = nullptr;
 }
 
 PicInfo18C442::PicInfo18C442()
@@ -316,34 +315,35 @@ PicInfo18Fxx20::~PicInfo18Fxx20()
 {
 }
 
+static constexpr PicPinAssignment pic18F1220Pins[] = {
+    {1, PicPin::type_bidir, "RA0", "PORTA", 0},
+    {2, PicPin::type_bidir, "RA1", "PORTA", 1},
+    {6, PicPin::type_bidir, "RA2", "PORTA", 2},
+    {7, PicPin::type_bidir, "RA3", "PORTA", 3},
+    {3, PicPin::type_open, "RA4", "PORTA", 4},
+    {4, PicPin::type_open, "RA5", "PORTA", 5},
+    {15, PicPin::type_open, "RA6", "PORTA", 6},
+    {16, PicPin::type_open, "RA7", "PORTA", 7},
+
+    {8, PicPin::type_bidir, "RB0", "PORTB", 0},
+    {9, PicPin::type_bidir, "RB1", "PORTB", 1},
+    {17, PicPin::type_bidir, "RB2", "PORTB", 2},
+    {18, PicPin::type_bidir, "RB3", "PORTB", 3},
+    {10, PicPin::type_bidir, "RB4", "PORTB", 4},
+    {11, PicPin::type_bidir, "RB5", "PORTB", 5},
+    {12, PicPin::type_bidir, "RB6", "PORTB", 6},
+    {13, PicPin::type_bidir, "RB7", "PORTB", 7},
+
+    {5, PicPin::type_vss, "VSS", "", -1},
+    {14, PicPin::type_vdd, "VDD", "", -1},
+};
+
 PicInfo18F1220::PicInfo18F1220()
     : PicInfo18Fxx20()
 {
     m_id = QString::fromLatin1("P18F1220");
 
-    delete m_package;
-    m_package = new MicroPackage(18);
-
-    m_package->assignPin(1, PicPin::type_bidir, "RA0", "PORTA", 0);
-    m_package->assignPin(2, PicPin::type_bidir, "RA1", "PORTA", 1);
-    m_package->assignPin(6, PicPin::type_bidir, "RA2", "PORTA", 2);
-    m_package->assignPin(7, PicPin::type_bidir, "RA3", "PORTA", 3);
-    m_package->assignPin(3, PicPin::type_open, "RA4", "PORTA", 4);
-    m_package->assignPin(4, PicPin::type_open, "RA5", "PORTA", 5);
-    m_package->assignPin(15, PicPin::type_open, "RA6", "PORTA", 6);
-    m_package->assignPin(16, PicPin::type_open, "RA7", "PORTA", 7);
-
-    m_package->assignPin(8, PicPin::type_bidir, "RB0", "PORTB", 0);
-    m_package->assignPin(9, PicPin::type_bidir, "RB1", "PORTB", 1);
-    m_package->assignPin(17, PicPin::type_bidir, "RB2", "PORTB", 2);
-    m_package->assignPin(18, PicPin::type_bidir, "RB3", "PORTB", 3);
-    m_package->assignPin(10, PicPin::type_bidir, "RB4", "PORTB", 4);
-    m_package->assignPin(11, PicPin::type_bidir, "RB5", "PORTB", 5);
-    m_package->assignPin(12, PicPin::type_bidir, "RB6", "PORTB", 6);
-    m_package->assignPin(13, PicPin::type_bidir, "RB7", "PORTB", 7);
-
-    m_package->assignPin(5, PicPin::type_vss, "VSS");
-    m_package->assignPin(14, PicPin::type_vdd, "VDD");
+    setPackage(18, pic18F1220Pins);
 }
 
 PicInfo18F1220::~PicInfo18F1220()
@@ -14,9 +14,10 @@
 #include "icndocument.h"
 #include "node.h"
 
-#include <cassert>
 #include <cstdlib>
 
+#include <QSet>
+
 #include <ktechlab_debug.h>
 
 NodeGroup::NodeGroup(ICNDocument *icnDocument)
@@ -24,6 +25,7 @@ NodeGroup::NodeGroup(ICNDocument *icnDocument)
 {
     p_icnDocument = icnDocument;
     b_visible = true;
+    b_graphDirty = true;
 }
 
 NodeGroup::~NodeGroup()
@@ -65,6 +67,7 @@ void NodeGroup::addNode(Node *node, bool checkSurrouding)
     m_nodeList.append(node);
     node->setNodeGroup(this);
     node->setVisible(b_visible);
+    b_graphDirty = true;
 
     if (checkSurrouding) {
         ConnectorList con = node->getAllConnectors();
@@ -100,15 +103,67 @@ void NodeGroup::translate(int dx, int dy)
         (*it)->moveBy(dx, dy);
 }
 
+void NodeGroup::invalidateRoute(Connector *connector)
+{
+    if (connector && !m_invalidConList.contains(connector))
+        m_invalidConList.append(connector);
+}
+
 void NodeGroup::updateRoutes()
 {
-    resetRoutedMap();
+    if (b_graphDirty)
+        buildGraph();
+
+    if (m_routes.isEmpty() || m_invalidConList.isEmpty())
+        routeAll();
+    else
+        rerouteInvalidated();
+
+    m_invalidConList.clear();
+}
+
+void NodeGroup::buildGraph()
+{
+    const int n = nodeCount();
+
+    m_nodePos.clear();
+    for (int i = 0; i < n; ++i) {
+        if (Node *node = getNodePtr(i))
+            m_nodePos.insert(node, i);
+    }
+
+    m_edges.clear();
+    m_adjacency = QVector<IntList>(n);
+    const ConnectorList::iterator end = m_conList.end();
+    for (ConnectorList::iterator it = m_conList.begin(); it != end; ++it) {
+        Connector *con = *it;
+        if (!con)
+            continue;
+        Edge edge;
+        edge.n1 = getNodePos(con->startNode());
+        edge.n2 = getNodePos(con->endNode());
+        edge.connector = con;
+        if (edge.n1 == -1 || edge.n2 == -1 || edge.n1 == edge.n2)
+            continue;
+        m_adjacency[edge.n1].append(m_edges.size());
+        m_adjacency[edge.n2].append(m_edges.size());
+        m_edges.append(edge);
+    }
+
+    // The routes were between nodes at the old positions
+    m_routes.clear();
+    b_graphDirty = false;
+}
+
+void NodeGroup::routeAll()
+{
+    m_routes.clear();
 
-    // Basic algorithm used here: starting with the external nodes, find the
-    // pair with the shortest distance between them. Route the connectors
-    // between the two nodes appropriately. Remove that pair of nodes from the
-    // list, and add the nodes along the connector route (which have been spaced
-    // equally along the route). Repeat until all the nodes are connected.
+    const int n = nodeCount();
+    b_unrouted.fill(true, m_edges.size());
+    m_unroutedCount.resize(n);
+    for (int i = 0; i < n; ++i)
+        m_unroutedCount[i] = m_adjacency[i].size();
 
     const ConnectorList::iterator conEnd = m_conList.end();
     for (ConnectorList::iterator it = m_conList.begin(); it != conEnd; ++it) {
@@ -123,114 +178,207 @@ void NodeGroup::updateRoutes()
         if (n1 == nullptr || n2 == nullptr) {
             return;
         }
-        NodeList route = findRoute(n1, n2);
-        currentList += route;
-
-        ConRouter cr(p_icnDocument);
-        cr.mapRoute(int(n1->x()), int(n1->y()), int(n2->x()), int(n2->y()));
-        if (cr.pointList(false).size() <= 0) {
-            qCDebug(KTL_LOG) << "no ConRouter points, giving up";
+        Route route;
+        if (!findRoute(getNodePos(n1), getNodePos(n2), &route) || !applyRoute(route)) {
+            // Only a complete set of routes can be partly redone later
+            m_routes.clear();
             return; // continue might get to an infinite loop
         }
-        QPointListList pl = cr.dividePoints(route.size() + 1);
-
-        const NodeList::iterator routeEnd = route.end();
-        const QPointListList::iterator plEnd = pl.end();
-        Node *prev = n1;
-        NodeList::iterator routeIt = route.begin();
-        for (QPointListList::iterator it = pl.begin(); it != plEnd; ++it) {
-            Node *next = (routeIt == routeEnd) ? n2 : static_cast<Node *>(*(routeIt++));
-            removeRoutedNodes(&currentList, prev, next);
-            QPointList pointList = *it;
-            if (!pointList.isEmpty() && prev != n1) {
-                QPoint first = pointList.first();
-                prev->moveBy(first.x() - prev->x(), first.y() - prev->y());
-            }
-            Connector *con = findCommonConnector(prev, next);
-            if (con) {
-                con->updateConnectorPoints(false);
-                con->setRoutePoints(pointList, false, false);
-                con->updateConnectorPoints(true);
-                // 				con->conRouter()->setPoints( &pointList, con->startNode() != prev );
-                // 				con->conRouter()->setPoints( &pointList, con->pointsAreReverse( &pointList ) );
-                // 				con->calcBoundingPoints();
-            }
-            prev = next;
+        m_routes.append(route);
+
+        const IntList::const_iterator edgesEnd = route.edges.constEnd();
+        for (IntList::const_iterator it = route.edges.constBegin(); it != edgesEnd; ++it) {
+            b_unrouted.clearBit(*it);
+            --m_unroutedCount[m_edges[*it].n1];
+            --m_unroutedCount[m_edges[*it].n2];
+        }
+
+        const IntList::const_iterator nodesEnd = route.nodes.constEnd();
+        for (IntList::const_iterator it = route.nodes.constBegin(); it != nodesEnd; ++it) {
+            Node *node = getNodePtr(*it);
+            if (!currentList.contains(node))
+                currentList.append(node);
+        }
+
+        // Drop the nodes that have all of their connectors routed
+        for (NodeList::iterator it = currentList.begin(); it != currentList.end();) {
+            const int pos = getNodePos(*it);
+            if (pos == -1 || m_unroutedCount[pos] == 0)
+                it = currentList.erase(it);
+            else
+                ++it;
         }
     }
 }
 
-NodeList NodeGroup::findRoute(Node *startNode, Node *endNode)
+void NodeGroup::rerouteInvalidated()
 {
-    NodeList nl;
-    if (!startNode || !endNode || startNode == endNode) {
-        return nl;
+    QSet<Connector *> invalid;
+    const ConnectorList::const_iterator invalidEnd = m_invalidConList.constEnd();
+    for (ConnectorList::const_iterator it = m_invalidConList.constBegin(); it != invalidEnd; ++it) {
+        if (*it)
+            invalid.insert(*it);
+    }
+
+    // A route is redone if it has an invalidated connector, or if one of its
+    // ends is a node that was spaced along a route that is redone (which,
+    // as the nodes along a route are only routed from afterwards, is an
+    // earlier route)
+    const int routeCount = m_routes.size();
+    QBitArray moved(nodeCount());
+    QBitArray redo(routeCount);
+    for (int i = 0; i < routeCount; ++i) {
+        const Route &route = m_routes[i];
+        bool affected = moved.testBit(route.start) || moved.testBit(route.end);
+        const IntList::const_iterator edgesEnd = route.edges.constEnd();
+        for (IntList::const_iterator it = route.edges.constBegin(); !affected && it != edgesEnd; ++it)
+            affected = invalid.contains(m_edges[*it].connector);
+        if (!affected)
+            continue;
+
+        redo.setBit(i);
+        const IntList::const_iterator nodesEnd = route.nodes.constEnd();
+        for (IntList::const_iterator it = route.nodes.constBegin(); it != nodesEnd; ++it)
+            moved.setBit(*it);
+    }
+
+    // Start with clean routes for all of the connectors being rerouted
+    for (int i = 0; i < routeCount; ++i) {
+        if (!redo.testBit(i))
+            continue;
+        const IntList::const_iterator edgesEnd = m_routes[i].edges.constEnd();
+        for (IntList::const_iterator it = m_routes[i].edges.constBegin(); it != edgesEnd; ++it) {
+            if (Connector *con = m_edges[*it].connector)
+                con->updateConnectorPoints(false);
+        }
     }
 
-    IntList temp;
-    IntList il = findRoute(temp, getNodePos(startNode), getNodePos(endNode));
-
-    const IntList::iterator end = il.end();
-    for (IntList::iterator it = il.begin(); it != end; ++it) {
-        Node *node = getNodePtr(*it);
-        if (node) {
-            nl += node;
+    for (int i = 0; i < routeCount; ++i) {
+        if (redo.testBit(i) && !applyRoute(m_routes[i])) {
+            routeAll();
+            return;
         }
     }
 
-    nl.removeAll(startNode);
-    nl.removeAll(endNode);
-
-    return nl;
+    // The points of the connectors left alone may have been taken out by
+    // ICNDocument::rerouteInvalidatedConnectors
+    const ConnectorList::iterator conEnd = m_conList.end();
+    for (ConnectorList::iterator it = m_conList.begin(); it != conEnd; ++it) {
+        if (*it)
+            (*it)->updateConnectorPoints(true);
+    }
 }
 
-IntList NodeGroup::findRoute(IntList used, int currentNode, int endNode, bool *success)
+bool NodeGroup::applyRoute(const Route &route)
 {
-    bool temp;
-    if (!success) {
-        success = &temp;
+    Node *n1 = getNodePtr(route.start);
+    Node *n2 = getNodePtr(route.end);
+    if (!n1 || !n2)
+        return false;
+
+    ConRouter cr(p_icnDocument);
+    cr.mapRoute(int(n1->x()), int(n1->y()), int(n2->x()), int(n2->y()));
+    if (cr.pointList(false).size() <= 0) {
+        qCDebug(KTL_LOG) << "no ConRouter points, giving up";
+        return false;
     }
-    *success = false;
+    const QPointListList pl = cr.dividePoints(route.nodes.size() + 1);
 
-    if (!used.contains(currentNode)) {
-        used.append(currentNode);
+    Node *prev = n1;
+    for (int i = 0; i < pl.size(); ++i) {
+        Node *next = (i < route.nodes.size()) ? getNodePtr(route.nodes[i]) : n2;
+        const QPointList &pointList = pl[i];
+        if (!pointList.isEmpty() && prev != n1) {
+            QPoint first = pointList.first();
+            prev->moveBy(first.x() - prev->x(), first.y() - prev->y());
+        }
+        Connector *con = m_edges[route.edges[i]].connector;
+        if (con) {
+            con->updateConnectorPoints(false);
+            con->setRoutePoints(pointList, false, false);
+            con->updateConnectorPoints(true);
+        }
+        prev = next;
     }
+    return true;
+}
+
+bool NodeGroup::findRoute(int startNode, int endNode, Route *route) const
+{
+    route->start = startNode;
+    route->end = endNode;
+    route->nodes.clear();
+    route->edges.clear();
 
-    if (currentNode == endNode) {
-        *success = true;
-        return used;
+    if (startNode == -1 || endNode == -1 || startNode == endNode) {
+        return false;
     }
 
-    const uint n = m_nodeList.size() + m_extNodeList.size();
-    for (uint i = 0; i < n; ++i) {
-        if (b_routedMap[i * n + currentNode] && !used.contains(i)) {
-            IntList il = findRoute(used, i, endNode, success);
-            if (*success) {
-                return il;
+    // Breadth-first, along the connectors still to be routed, remembering the
+    // connector that each node was first reached by
+    QVector<int> via(nodeCount(), -1);
+    QVector<int> queue;
+    queue.reserve(nodeCount());
+    queue.append(startNode);
+    via[startNode] = -2;
+    for (int head = 0; head < queue.size() && via[endNode] == -1; ++head) {
+        const int node = queue[head];
+        const IntList::const_iterator end = m_adjacency[node].constEnd();
+        for (IntList::const_iterator it = m_adjacency[node].constBegin(); it != end; ++it) {
+            if (!b_unrouted.testBit(*it))
+                continue;
+            const Edge &edge = m_edges[*it];
+            const int other = (edge.n1 == node) ? edge.n2 : edge.n1;
+            if (via[other] == -1) {
+                via[other] = *it;
+                queue.append(other);
             }
         }
     }
 
-    IntList il;
-    return il;
-}
-
-Connector *NodeGroup::findCommonConnector(Node *n1, Node *n2)
-{
-    if (!n1 || !n2 || n1 == n2) {
-        return nullptr;
+    if (via[endNode] == -1) {
+        return false;
     }
 
-    ConnectorList n1Con = n1->getAllConnectors();
-    ConnectorList n2Con = n2->getAllConnectors();
+    for (int node = endNode; node != startNode;) {
+        const Edge &edge = m_edges[via[node]];
+        route->edges.prepend(via[node]);
+        node = (edge.n1 == node) ? edge.n2 : edge.n1;
+        if (node != startNode)
+            route->nodes.prepend(node);
+    }
+    return true;
+}
 
-    const ConnectorList::iterator end = n1Con.end();
-    for (ConnectorList::iterator it = n1Con.begin(); it != end; ++it) {
-        if (n2Con.contains(*it)) {
-            return *it;
+QVector<int> NodeGroup::routableParts() const
+{
+    const int n = nodeCount();
+    QVector<int> parts(n, -1);
+    QVector<int> queue;
+    queue.reserve(n);
+
+    for (int i = 0; i < n; ++i) {
+        if (parts[i] != -1)
+            continue;
+        parts[i] = i;
+        queue.clear();
+        queue.append(i);
+        for (int head = 0; head < queue.size(); ++head) {
+            const int node = queue[head];
+            const IntList::const_iterator end = m_adjacency[node].constEnd();
+            for (IntList::const_iterator it = m_adjacency[node].constBegin(); it != end; ++it) {
+                if (!b_unrouted.testBit(*it))
+                    continue;
+                const Edge &edge = m_edges[*it];
+                const int other = (edge.n1 == node) ? edge.n2 : edge.n1;
+                if (parts[other] == -1) {
+                    parts[other] = i;
+                    queue.append(other);
+                }
+            }
         }
     }
-    return nullptr;
+    return parts;
 }
 
 void NodeGroup::findBestPair(NodeList *list, Node **n1, Node **n2)
@@ -242,19 +390,29 @@ void NodeGroup::findBestPair(NodeList *list, Node **n1, Node **n2)
         return;
     }
 
-    const NodeList::iterator end = list->end();
+    // Two nodes can be routed between if they are in the same part, which is
+    // worked out once here rather than for every pair
+    const QVector<int> parts = routableParts();
+    const int count = list->size();
+    QVector<Node *> nodes(count);
+    QVector<int> nodeParts(count);
+    for (int i = 0; i < count; ++i) {
+        nodes[i] = (*list)[i];
+        const int pos = getNodePos(nodes[i]);
+        nodeParts[i] = (pos == -1) ? -1 - i : parts[pos];
+    }
+
     int shortest = 1 << 30;
 
     // Try and find any that are aligned horizontally
-    for (NodeList::iterator it1 = list->begin(); it1 != end; ++it1) {
-        NodeList::iterator it2 = it1;
-        for (++it2; it2 != end; ++it2) {
-            if (*it1 != *it2 && (*it1)->y() == (*it2)->y() && canRoute(*it1, *it2)) {
-                const int distance = std::abs(int((*it1)->x() - (*it2)->x()));
+    for (int i = 0; i < count; ++i) {
+        for (int j = i + 1; j < count; ++j) {
+            if (nodes[i] != nodes[j] && nodeParts[i] == nodeParts[j] && nodes[i]->y() == nodes[j]->y()) {
+                const int distance = std::abs(int(nodes[i]->x() - nodes[j]->x()));
                 if (distance < shortest) {
                     shortest = distance;
-                    *n1 = *it1;
-                    *n2 = *it2;
+                    *n1 = nodes[i];
+                    *n2 = nodes[j];
                 }
             }
         }
@@ -264,15 +422,14 @@ void NodeGroup::findBestPair(NodeList *list, Node **n1, Node **n2)
     }
 
     // Try and find any that are aligned vertically
-    for (NodeList::iterator it1 = list->begin(); it1 != end; ++it1) {
-        NodeList::iterator it2 = it1;
-        for (++it2; it2 != end; ++it2) {
-            if (*it1 != *it2 && (*it1)->x() == (*it2)->x() && canRoute(*it1, *it2)) {
-                const int distance = std::abs(int((*it1)->y() - (*it2)->y()));
+    for (int i = 0; i < count; ++i) {
+        for (int j = i + 1; j < count; ++j) {
+            if (nodes[i] != nodes[j] && nodeParts[i] == nodeParts[j] && nodes[i]->x() == nodes[j]->x()) {
+                const int distance = std::abs(int(nodes[i]->y() - nodes[j]->y()));
                 if (distance < shortest) {
                     shortest = distance;
-                    *n1 = *it1;
-                    *n2 = *it2;
+                    *n1 = nodes[i];
+                    *n2 = nodes[j];
                 }
             }
         }
@@ -282,17 +439,16 @@ void NodeGroup::findBestPair(NodeList *list, Node **n1, Node **n2)
     }
 
     // Now, lets just find the two closest nodes
-    for (NodeList::iterator it1 = list->begin(); it1 != end; ++it1) {
-        NodeList::iterator it2 = it1;
-        for (++it2; it2 != end; ++it2) {
-            if (*it1 != *it2 && canRoute(*it1, *it2)) {
-                const int dx = int((*it1)->x() - (*it2)->x());
-                const int dy = int((*it1)->y() - (*it2)->y());
+    for (int i = 0; i < count; ++i) {
+        for (int j = i + 1; j < count; ++j) {
+            if (nodes[i] != nodes[j] && nodeParts[i] == nodeParts[j]) {
+                const int dx = int(nodes[i]->x() - nodes[j]->x());
+                const int dy = int(nodes[i]->y() - nodes[j]->y());
                 const int distance = std::abs(dx) + std::abs(dy);
                 if (distance < shortest) {
                     shortest = distance;
-                    *n1 = *it1;
-                    *n2 = *it2;
+                    *n1 = nodes[i];
+                    *n2 = nodes[j];
                 }
             }
         }
@@ -303,112 +459,15 @@ void NodeGroup::findBestPair(NodeList *list, Node **n1, Node **n2)
     }
 }
 
-bool NodeGroup::canRoute(Node *n1, Node *n2)
-{
-    if (!n1 || !n2) {
-        return false;
-    }
-
-    IntList reachable;
-    getReachable(&reachable, getNodePos(n1));
-    return reachable.contains(getNodePos(n2));
-}
-
-void NodeGroup::getReachable(IntList *reachable, int node)
-{
-    if (!reachable || reachable->contains(node)) {
-        return;
-    }
-    reachable->append(node);
-
-    const uint n = m_nodeList.size() + m_extNodeList.size();
-    assert(node < int(n));
-    for (uint i = 0; i < n; ++i) {
-        if (b_routedMap[i * n + node]) {
-            getReachable(reachable, i);
-        }
-    }
-}
-
-void NodeGroup::resetRoutedMap()
-{
-    const uint n = m_nodeList.size() + m_extNodeList.size();
-
-    b_routedMap.resize(n * n);
-
-    const ConnectorList::iterator end = m_conList.end();
-    for (ConnectorList::iterator it = m_conList.begin(); it != end; ++it) {
-        Connector *con = *it;
-        if (con) {
-            int n1 = getNodePos(con->startNode());
-            int n2 = getNodePos(con->endNode());
-            if (n1 != -1 && n2 != -1) {
-                b_routedMap[n1 * n + n2] = b_routedMap[n2 * n + n1] = true;
-            }
-        }
-    }
-}
-
-void NodeGroup::removeRoutedNodes(NodeList *nodes, Node *n1, Node *n2)
-{
-    if (!nodes) {
-        return;
-    }
-
-    // Lets get rid of any duplicate nodes in nodes (as a general cleaning operation)
-    const NodeList::iterator end = nodes->end();
-    for (NodeList::iterator it = nodes->begin(); it != end; ++it) {
-        // if ( nodes->contains(*it) > 1 ) {
-        if (nodes->count(*it) > 1) {
-            *it = nullptr;
-        }
-    }
-    nodes->removeAll(static_cast<Node *>(nullptr));
-
-    const int n1pos = getNodePos(n1);
-    const int n2pos = getNodePos(n2);
-
-    if (n1pos == -1 || n2pos == -1) {
-        return;
-    }
-
-    const uint n = m_nodeList.size() + m_extNodeList.size();
-
-    b_routedMap[n1pos * n + n2pos] = b_routedMap[n2pos * n + n1pos] = false;
-
-    bool n1HasCon = false;
-    bool n2HasCon = false;
-
-    for (uint i = 0; i < n; ++i) {
-        n1HasCon |= b_routedMap[n1pos * n + i];
-        n2HasCon |= b_routedMap[n2pos * n + i];
-    }
-
-    if (!n1HasCon) {
-        nodes->removeAll(n1);
-    }
-    if (!n2HasCon) {
-        nodes->removeAll(n2);
-    }
-}
-
-int NodeGroup::getNodePos(Node *n)
+int NodeGroup::getNodePos(Node *n) const
 {
     if (!n) {
         return -1;
     }
-    int pos = m_nodeList.indexOf(n);
-    if (pos != -1) {
-        return pos;
-    }
-    pos = m_extNodeList.indexOf(n);
-    if (pos != -1) {
-        return pos + m_nodeList.size();
-    }
-    return -1;
+    return m_nodePos.value(n, -1);
 }
 
-Node *NodeGroup::getNodePtr(int n)
+Node *NodeGroup::getNodePtr(int n) const
 {
     if (n < 0) {
         return nullptr;
@@ -485,6 +544,8 @@ void NodeGroup::init()
         // 		connect( *it, SIGNAL(moved(Node*)), this, SLOT(extNodeMoved()) );
         connect(*it, SIGNAL(removed(Node *)), this, SLOT(nodeRemoved(Node *)));
     }
+
+    buildGraph();
 }
 
 void NodeGroup::nodeRemoved(Node *node)
@@ -494,11 +555,13 @@ void NodeGroup::nodeRemoved(Node *node)
     node->setNodeGroup(nullptr);
     node->setVisible(true);
     m_extNodeList.removeAll(node);
+    b_graphDirty = true;
 }
 
 void NodeGroup::connectorRemoved(Connector *connector)
 {
     m_conList.removeAll(connector);
+    b_graphDirty = true;
 }
 
 void NodeGroup::addExtNode(Node *node)
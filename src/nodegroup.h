@@ -12,9 +12,11 @@
 #define NODEGROUP_H
 
 #include <QBitArray>
+#include <QHash>
 #include <QList>
 #include <QObject>
 #include <QPointer>
+#include <QVector>
 
 #include "cnitem.h"
 
@@ -80,10 +82,29 @@ public:
     {
         return m_nodeList.contains(node);
     }
+    /**
+     * Notes that the route of the connector (one of ours) needs updating, so
+     * that the next updateRoutes only reroutes the parts of the group that
+     * depend on it.
+     */
+    void invalidateRoute(Connector *connector);
+    /**
+     * @return the connectors passed to invalidateRoute since the last
+     * updateRoutes
+     */
+    ConnectorList invalidatedRoutes() const
+    {
+        return m_invalidConList;
+    }
     /**
      * Reroute the NodeGroup. This function should only ever be called by
      * ICNDocument::rerouteInvalidatedConnectors(), as it is important that
      * there is only ever one entity controlling the routing of connectors.
+     *
+     * If the nodes and connectors of the group are the same as when it was
+     * last routed, only the routes with invalidated connectors (and those
+     * starting from nodes placed by them) are redone, between the same nodes
+     * as before.
      */
     void updateRoutes();
     /**
@@ -102,11 +123,58 @@ public slots:
     void connectorRemoved(Connector *connector);
 
 protected:
+    /**
+     * A connector between two nodes of the group (as positions from
+     * getNodePos).
+     */
+    class Edge
+    {
+    public:
+        int n1;
+        int n2;
+        QPointer<Connector> connector;
+    };
+    /**
+     * A path of connectors routed in one go, with the nodes along it spaced
+     * out equally.
+     */
+    class Route
+    {
+    public:
+        int start;
+        int end;
+        IntList nodes; // Between the start and the end
+        IntList edges; // Positions in m_edges, from the start to the end
+    };
+
     void clearConList();
     /**
-     * Finds the common connector between two nodes
+     * Indexes the nodes and connectors of the group, for looking up the
+     * position of a node and the connectors at each node. This is done by
+     * init, and again by updateRoutes if the nodes or connectors have changed
+     * since.
+     */
+    void buildGraph();
+    /**
+     * Routes the whole group. Basic algorithm used here: starting with the
+     * external nodes, find the pair with the shortest distance between them.
+     * Route the connectors between the two nodes appropriately. Remove that
+     * pair of nodes from the list, and add the nodes along the connector
+     * route (which have been spaced equally along the route). Repeat until
+     * all the nodes are connected.
      */
-    Connector *findCommonConnector(Node *n1, Node *n2);
+    void routeAll();
+    /**
+     * Redoes the routes of m_routes that contain invalidated connectors or
+     * that start or end at a node moved by one that is redone.
+     */
+    void rerouteInvalidated();
+    /**
+     * Maps the route between its end nodes, and spaces the nodes and
+     * connectors along it.
+     * @return false if no route could be mapped
+     */
+    bool applyRoute(const Route &route);
     /**
      * Find the best pair of nodes in the given list to route between. These
      * will be nodes that give a ncie path (e.g. if they're aligned horizontally
@@ -115,44 +183,50 @@ protected:
      */
     void findBestPair(NodeList *list, Node **n1, Node **n2);
     /**
-     * Finds the nodes along the route with the given start and end nodes (which
-     * will be unique). The end nodes are not included in the returned list.
+     * Finds the path with the fewest connectors between the given nodes that
+     * only goes along connectors not yet routed.
+     * @return false if there is no such path
      */
-    NodeList findRoute(Node *startNode, Node *endNode);
+    bool findRoute(int startNode, int endNode, Route *route) const;
+    /**
+     * @return the connected part of the group that each node is in, counting
+     * only the connectors not yet routed; two nodes can be routed between if
+     * they are in the same part
+     */
+    QVector<int> routableParts() const;
 
     ConnectorList m_conList;
     NodeList m_nodeList;
     NodeList m_extNodeList;
     ICNDocument *p_icnDocument;
-    QBitArray b_routedMap; // Routes between different nodes
     bool b_visible;
 
+    QHash<Node *, int> m_nodePos;
+    QVector<Edge> m_edges;
+    QVector<IntList> m_adjacency; // Positions in m_edges of the connectors at each node
+    bool b_graphDirty; // Whether nodes or connectors have changed since buildGraph
+
+    QBitArray b_unrouted;        // Whether each edge is still to be routed by routeAll
+    QVector<int> m_unroutedCount; // The number of edges still to be routed at each node
+    QVector<Route> m_routes;      // As routed by routeAll, in order
+    ConnectorList m_invalidConList;
+
 private:
-    IntList findRoute(IntList used, int currentNode, int endNode, bool *success = nullptr);
-    void resetRoutedMap();
-    /**
-     * Looks at b_routedMap as well as the connectors coming out of nodes, and
-     * removes the nodes from the given list that have all of their connectors
-     * routed.
-     */
-    void removeRoutedNodes(NodeList *nodes, Node *n1, Node *n2);
     void addExtNode(Node *node);
-    /**
-     * Looks at b_mappedRoute to see if there is a completely unrouted set of
-     * connectors between the two given nodes;
-     */
-    bool canRoute(Node *n1, Node *n2);
-    void getReachable(IntList *reachable, int node);
     /**
      * Either: position of node in m_nodeList,
      * or: (position of node in m_extNodeList) + m_nodeList.size()
      * or: -1
      */
-    int getNodePos(Node *n);
+    int getNodePos(Node *n) const;
     /**
      * Essentially the inverse of getNodePos
      */
-    Node *getNodePtr(int n);
+    Node *getNodePtr(int n) const;
+    int nodeCount() const
+    {
+        return m_nodeList.size() + m_extNodeList.size();
+    }
 };
 
 #endif
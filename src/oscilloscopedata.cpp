@@ -10,23 +10,121 @@
 
 #include "oscilloscopedata.h"
 #include "oscilloscope.h"
+#include "probedatawriter.h"
+#include "protocoldecoder.h"
+
+#include <ktechlab_debug.h>
+#include <ktlconfig.h>
+
+#include <QDir>
+
+#include <algorithm>
 
 using namespace std;
 
+// BEGIN class ProbeCaptureFile
+ProbeCaptureFile::ProbeCaptureFile()
+    : m_file(QDir::tempPath() + QLatin1String("/ktechlab-probe-XXXXXX.capture"))
+{
+    m_file.open();
+}
+
+ProbeCaptureFile::~ProbeCaptureFile()
+{
+    for (uchar *segment : m_segments)
+        m_file.unmap(segment);
+}
+
+bool ProbeCaptureFile::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+uchar *ProbeCaptureFile::addSegment()
+{
+    const qint64 offset = qint64(m_segments.size()) * PROBE_CAPTURE_SEGMENT_SIZE;
+    if (!m_file.resize(offset + PROBE_CAPTURE_SEGMENT_SIZE))
+        return nullptr;
+
+    uchar *segment = m_file.map(offset, PROBE_CAPTURE_SEGMENT_SIZE);
+    if (segment)
+        m_segments.push_back(segment);
+    return segment;
+}
+// END class ProbeCaptureFile
+
 // BEGIN class ProbeData
 ProbeData::ProbeData(int id)
     : m_id(id)
     , m_drawPosition(0.5)
     , m_resetTime(Simulator::self()->time())
     , m_color(Qt::black)
+    , m_capture(nullptr)
+    , m_captureBegin(0)
+    , m_captureEnd(0)
+    , m_bRecording(true)
+    , m_triggerType(NoTrigger)
+    , m_triggerLevel(0)
+    , m_triggerPreTime(0)
+    , m_triggerPostTime(0)
+    , m_triggerChecked(0)
 {
 }
 
 ProbeData::~ProbeData()
 {
+    delete m_capture;
     unregisterProbe(m_id);
 }
 
+void ProbeData::resetCapture()
+{
+    delete m_capture;
+    m_capture = nullptr;
+    m_captureBegin = 0;
+    m_captureEnd = 0;
+
+    if (!KTLConfig::captureProbesToDisk())
+        return;
+
+    m_capture = new ProbeCaptureFile();
+    if (!m_capture->isOpen()) {
+        qCWarning(KTL_LOG) << "Could not create a file to record probe data to, keeping it in memory";
+        delete m_capture;
+        m_capture = nullptr;
+    }
+}
+
+void ProbeData::setTrigger(TriggerType type, double level, uint64_t preTime, uint64_t postTime)
+{
+    m_triggerType = type;
+    m_triggerLevel = level;
+    m_triggerPreTime = preTime;
+    m_triggerPostTime = postTime;
+}
+
+bool ProbeData::meetsTrigger(bool hasPrevious, double previous, double value) const
+{
+    const bool wasHigh = previous >= m_triggerLevel;
+    const bool isHigh = value >= m_triggerLevel;
+
+    switch (m_triggerType) {
+    case NoTrigger:
+        return false;
+    case RisingEdge:
+        return hasPrevious && !wasHigh && isHigh;
+    case FallingEdge:
+        return hasPrevious && wasHigh && !isHigh;
+    case EitherEdge:
+        return hasPrevious && wasHigh != isHigh;
+    case HighLevel:
+        return isHigh;
+    case LowLevel:
+        return !isHigh;
+    }
+    return false;
+}
+
 void ProbeData::setColor(QColor color)
 {
     m_color = color;
@@ -35,121 +133,443 @@ void ProbeData::setColor(QColor color)
 // END class ProbeData
 
 // BEGIN class LogicProbeData
+// Each segment of the capture file starts with the time of its first data
+// point, followed by the data points with their times relative to that,
+// shifted up by a bit to make room for the value
+static const uint64_t LOGIC_CAPTURE_SEGMENT_POINTS = (PROBE_CAPTURE_SEGMENT_SIZE - sizeof(quint64)) / sizeof(quint32);
+
 LogicProbeData::LogicProbeData(int id)
     : ProbeData(id)
+    , m_data(DEFAULT_PROBE_DATA_DEPTH)
+    , m_pyramid(DEFAULT_PROBE_DATA_DEPTH)
+    , m_timeIndex(timeIndexDepth(DEFAULT_PROBE_DATA_DEPTH))
+    , m_lastValue(false)
+    , m_hasLastValue(false)
+    , m_pDecoder(nullptr)
 {
-    m_data = new vector<LogicDataPoint>;
+    resetCapture();
+    if (m_capture) {
+        m_pyramid.setDepth(0);
+        m_timeIndex.setDepth(0);
+    }
 }
 
-void LogicProbeData::addDataPoint(LogicDataPoint data)
+LogicProbeData::~LogicProbeData()
 {
-    if (m_data->size() < MAX_PROBE_DATA_SIZE) {
-        m_data->push_back(data);
-    }
+    delete m_pDecoder;
+}
+
+void LogicProbeData::setDecoder(ProtocolDecoder *decoder)
+{
+    if (decoder == m_pDecoder)
+        return;
+    delete m_pDecoder;
+    m_pDecoder = decoder;
+}
+
+void LogicProbeData::collectData()
+{
+    m_queue.take([this](const LogicDataPoint &data) { storeDataPoint(data); });
 }
 
 void LogicProbeData::eraseData()
 {
-    bool lastValue = false;
-    bool hasLastValue = false;
+    // For the last value
+    collectData();
+
+    m_data.clear();
+    m_triggerChecked = 0;
+    resetCapture();
+    m_captureSegmentBegins.clear();
+    m_pyramid.setDepth(m_capture ? 0 : m_data.depth());
+    m_pyramid.clear();
+    m_timeIndex.setDepth(m_capture ? 0 : timeIndexDepth(m_data.depth()));
+    m_timeIndex.clear();
 
-    if (!m_data->empty()) {
-        lastValue = m_data->back().value;
-        hasLastValue = true;
+    m_resetTime = Simulator::self()->time();
+
+    if (m_hasLastValue)
+        storeDataPoint(LogicDataPoint(m_lastValue, m_resetTime));
+
+    if (m_pDecoder)
+        m_pDecoder->reset();
+}
+
+bool LogicProbeData::captureDataPoint(LogicDataPoint data)
+{
+    uchar *segment = nullptr;
+    uint64_t count = 0;
+    uint64_t base = 0;
+    if (!m_captureSegmentBegins.empty()) {
+        segment = m_capture->segment(m_capture->segmentCount() - 1);
+        count = m_captureEnd - m_captureSegmentBegins.back();
+        base = *reinterpret_cast<const quint64 *>(segment);
     }
 
-    delete m_data;
-    m_data = new vector<LogicDataPoint>;
+    // Start a new segment when this one is full, or the time is too far on
+    // from its first data point to fit
+    if (!segment || count == LOGIC_CAPTURE_SEGMENT_POINTS || data.time - base >= (uint64_t(1) << 31)) {
+        segment = m_capture->addSegment();
+        if (!segment)
+            return false;
+        count = 0;
+        base = data.time;
+        *reinterpret_cast<quint64 *>(segment) = base;
+        m_captureSegmentBegins.push_back(m_captureEnd);
+    }
 
-    m_resetTime = Simulator::self()->time();
+    reinterpret_cast<quint32 *>(segment + sizeof(quint64))[count] = quint32(((data.time - base) << 1) | data.value);
+    ++m_captureEnd;
+    return true;
+}
 
-    if (hasLastValue)
-        addDataPoint(LogicDataPoint(lastValue, m_resetTime));
+LogicDataPoint LogicProbeData::capturedDataPoint(uint64_t at) const
+{
+    const size_t n = upper_bound(m_captureSegmentBegins.begin(), m_captureSegmentBegins.end(), at) - m_captureSegmentBegins.begin() - 1;
+    const uchar *segment = m_capture->segment(n);
+    const quint64 base = *reinterpret_cast<const quint64 *>(segment);
+    const quint32 entry = reinterpret_cast<const quint32 *>(segment + sizeof(quint64))[at - m_captureSegmentBegins[n]];
+    return LogicDataPoint(entry & 1, base + (entry >> 1));
 }
 
 uint64_t LogicProbeData::findPos(uint64_t time) const
 {
-    unsigned int pos = m_data->size();
-    if (!time || !pos)
-        return 0;
+    const uint64_t begin = beginIndex();
+    const uint64_t end = endIndex();
+    if (begin == end || dataPoint(begin).time > time)
+        return begin;
+
+    // Binary search the index for the last block of data points starting at
+    // or before the time. The first block may have lost its start, but the
+    // data point at begin is known to be early enough.
+    uint64_t bottom = begin / LOGIC_TIME_INDEX_STRIDE;
+    uint64_t top = (end - 1) / LOGIC_TIME_INDEX_STRIDE + 1;
+    while (top - bottom > 1) {
+        const uint64_t block = bottom + (top - bottom) / 2;
+        if (m_timeIndex[block] <= time)
+            bottom = block;
+        else
+            top = block;
+    }
 
-    // binary search
+    // Then the block for the last data point at or before the time, knowing
+    // that the next block starts after it
+    uint64_t first = qMax(begin, bottom * LOGIC_TIME_INDEX_STRIDE);
+    uint64_t last = qMin(end, (bottom + 1) * LOGIC_TIME_INDEX_STRIDE);
+    while (last - first > 1) {
+        const uint64_t at = first + (last - first) / 2;
+        if (dataPoint(at).time <= time)
+            first = at;
+        else
+            last = at;
+    }
 
-    // TODO: test and debug this code.
-    unsigned int top = pos;
-    pos >>= 1;
-    unsigned int bottom = 0;
+    return first;
+}
 
-    do {
-        uint64_t datatime = (*m_data)[pos].time;
-        if (datatime == time)
-            return pos;
+uint64_t LogicProbeData::memoryUsage() const
+{
+    return m_data.memoryUsage() + m_pyramid.memoryUsage() + m_timeIndex.memoryUsage() + m_captureSegmentBegins.capacity() * sizeof(uint64_t);
+}
 
-        if (datatime >= time) {
-            top = pos;
-            pos -= (top - bottom) >> 1;
-        } else {
-            bottom = pos;
-            pos += (top - bottom) >> 1;
-        }
-        // try to avoid infinite loop when top-bottom==1
-        if (top - bottom == 1) {
-            if (datatime >= time)
-                bottom = top;
-            else
-                top = bottom;
+void LogicProbeData::setDepth(uint64_t depth)
+{
+    if (depth == m_data.depth())
+        return;
+
+    m_data.setDepth(depth);
+    if (m_capture) // Everything is kept in the capture file
+        return;
+
+    m_timeIndex.setDepth(timeIndexDepth(depth));
+
+    m_pyramid.setDepth(depth);
+    m_pyramid.clear(m_data.beginIndex());
+    for (uint64_t at = m_data.beginIndex(); at < m_data.endIndex(); ++at)
+        m_pyramid.append(m_data[at].value);
+}
+
+MinMax<bool> LogicProbeData::valueRange(uint64_t begin, uint64_t end) const
+{
+    return m_pyramid.range(begin, end, [this](uint64_t at) { return bool(dataPoint(at).value); });
+}
+
+void LogicProbeData::discardBefore(uint64_t time)
+{
+    const uint64_t at = findPos(time);
+    if (m_capture)
+        m_captureBegin = qMax(m_captureBegin, at);
+    else
+        m_data.discardBefore(at);
+}
+
+bool LogicProbeData::findTrigger(uint64_t *time)
+{
+    const uint64_t end = endIndex();
+    uint64_t at = qMax(m_triggerChecked, beginIndex());
+    bool hasPrevious = at > beginIndex();
+    bool previous = hasPrevious && dataPoint(at - 1).value;
+
+    for (; at < end; ++at) {
+        const LogicDataPoint point = dataPoint(at);
+        if (meetsTrigger(hasPrevious, previous, point.value)) {
+            *time = point.time;
+            m_triggerChecked = at + 1;
+            return true;
         }
+        hasPrevious = true;
+        previous = point.value;
+    }
 
-    } while (top != bottom && pos != bottom);
+    m_triggerChecked = end;
+    return false;
+}
 
-    return pos;
+void LogicProbeData::exportData(ProbeDataWriter &writer, uint64_t begin, uint64_t end) const
+{
+    // Start from the data point before the range, which gives the value at
+    // its beginning
+    for (uint64_t at = findPos(begin); at < endIndex(); ++at) {
+        const LogicDataPoint point = dataPoint(at);
+        if (point.time > end)
+            break;
+        writer.writeSample(qMax<uint64_t>(point.time, begin), point.value);
+    }
 }
 // END class LogicProbeData
 
 // BEGIN class FloatingProbeData
+// The capture file holds the runs of samples
+static const uint64_t FLOATING_CAPTURE_SEGMENT_RUNS = PROBE_CAPTURE_SEGMENT_SIZE / sizeof(FloatingRun);
+
 FloatingProbeData::FloatingProbeData(int id)
     : ProbeData(id)
+    , m_runs(DEFAULT_PROBE_DATA_DEPTH)
+    , m_pyramid(DEFAULT_PROBE_DATA_DEPTH)
+    , m_end(0)
+    , m_lastValue(0)
+    , m_stepsPerPeriod(1)
+    , m_decimation(LatestDecimation)
+    , m_periodSteps(0)
+    , m_periodSum(0)
+    , m_periodMin(0)
+    , m_periodMax(0)
+    , m_periodMinFirst(true)
 {
-    m_data = new vector<float>;
     m_scaling = Linear;
     m_upperAbsValue = 10.0;
     m_lowerAbsValue = 0.1;
+
+    resetCapture();
+    if (m_capture)
+        m_pyramid.setDepth(0);
 }
 
-void FloatingProbeData::addDataPoint(float data)
+void FloatingProbeData::collectData()
 {
-    if (m_data->size() < MAX_PROBE_DATA_SIZE) {
-        m_data->push_back(data);
-    }
+    m_queue.take([this](float data) { storeDataPoint(data); });
 }
 
 void FloatingProbeData::eraseData()
 {
-    delete m_data;
-    m_data = new vector<float>;
+    collectData();
+
+    m_runs.clear();
+    m_end = 0;
+    m_triggerChecked = 0;
+    resetCapture();
+    m_pyramid.setDepth(m_capture ? 0 : m_runs.depth());
+    m_pyramid.clear();
 
     m_resetTime = Simulator::self()->time();
 }
 
+void FloatingProbeData::setSampling(unsigned stepsPerPeriod, Decimation decimation)
+{
+    stepsPerPeriod = qMax(1u, stepsPerPeriod);
+    if (stepsPerPeriod == m_stepsPerPeriod && decimation == m_decimation)
+        return;
+
+    m_stepsPerPeriod = stepsPerPeriod;
+    m_decimation = decimation;
+    m_periodSteps = 0;
+    eraseData();
+}
+
+double FloatingProbeData::sampleRate() const
+{
+    return double(LINEAR_UPDATE_RATE) * (m_decimation == MinMaxDecimation ? 2 : 1) / m_stepsPerPeriod;
+}
+
+void FloatingProbeData::decimateDataPoint(float data)
+{
+    if (m_periodSteps == 0) {
+        m_periodSum = 0;
+        m_periodMin = m_periodMax = data;
+        m_periodMinFirst = true;
+    } else if (data < m_periodMin) {
+        m_periodMin = data;
+        m_periodMinFirst = false;
+    } else if (data > m_periodMax) {
+        m_periodMax = data;
+        m_periodMinFirst = true;
+    }
+    m_periodSum += data;
+
+    if (++m_periodSteps < m_stepsPerPeriod)
+        return;
+    m_periodSteps = 0;
+
+    switch (m_decimation) {
+    case LatestDecimation:
+        m_queue.push(data);
+        break;
+    case AverageDecimation:
+        m_queue.push(float(m_periodSum / m_stepsPerPeriod));
+        break;
+    case MinMaxDecimation:
+        m_queue.push(m_periodMinFirst ? m_periodMin : m_periodMax);
+        m_queue.push(m_periodMinFirst ? m_periodMax : m_periodMin);
+        break;
+    }
+}
+
+bool FloatingProbeData::captureRun(FloatingRun run)
+{
+    const uint64_t pos = m_captureEnd % FLOATING_CAPTURE_SEGMENT_RUNS;
+    uchar *segment = (pos == 0) ? m_capture->addSegment() : m_capture->segment(m_capture->segmentCount() - 1);
+    if (!segment)
+        return false;
+
+    reinterpret_cast<FloatingRun *>(segment)[pos] = run;
+    ++m_captureEnd;
+    return true;
+}
+
+FloatingRun FloatingProbeData::capturedRun(uint64_t n) const
+{
+    return reinterpret_cast<const FloatingRun *>(m_capture->segment(n / FLOATING_CAPTURE_SEGMENT_RUNS))[n % FLOATING_CAPTURE_SEGMENT_RUNS];
+}
+
+uint64_t FloatingProbeData::findRun(uint64_t at) const
+{
+    // binary search for the last run starting at or before the sample
+    uint64_t bottom = runBeginIndex();
+    uint64_t top = runEndIndex();
+    while (top - bottom > 1) {
+        const uint64_t n = bottom + (top - bottom) / 2;
+        if (run(n).begin <= at)
+            bottom = n;
+        else
+            top = n;
+    }
+
+    return bottom;
+}
+
 uint64_t FloatingProbeData::findPos(uint64_t time) const
 {
     if (time <= 0 || uint64_t(time) <= m_resetTime)
-        return 0;
+        return beginIndex();
 
-    uint64_t at = uint64_t((time - m_resetTime) * double(LINEAR_UPDATE_RATE) / double(LOGIC_UPDATE_RATE));
+    uint64_t at = uint64_t((time - m_resetTime) * sampleRate() / double(LOGIC_UPDATE_RATE));
 
-    if (m_data->size() <= at) { // index is out of bound
+    if (endIndex() <= at) { // index is out of bound
         if (at > 0) {
             --at;
         }
     }
 
+    // The older samples may have been dropped
+    if (at < beginIndex())
+        at = beginIndex();
+
     return at;
 }
 
+uint64_t FloatingProbeData::memoryUsage() const
+{
+    return m_runs.memoryUsage() + m_pyramid.memoryUsage();
+}
+
+void FloatingProbeData::setDepth(uint64_t depth)
+{
+    if (depth == m_runs.depth())
+        return;
+
+    m_runs.setDepth(depth);
+    if (m_capture) // Everything is kept in the capture file
+        return;
+
+    m_pyramid.setDepth(depth);
+    m_pyramid.clear(m_runs.beginIndex());
+    for (uint64_t n = m_runs.beginIndex(); n < m_runs.endIndex(); ++n)
+        m_pyramid.append(m_runs[n].value);
+}
+
+MinMax<float> FloatingProbeData::valueRange(uint64_t begin, uint64_t end) const
+{
+    return m_pyramid.range(findRun(begin), findRun(end - 1) + 1, [this](uint64_t n) { return run(n).value; });
+}
+
+void FloatingProbeData::discardBefore(uint64_t time)
+{
+    const uint64_t n = findRun(findPos(time));
+    if (m_capture)
+        m_captureBegin = qMax(m_captureBegin, n);
+    else
+        m_runs.discardBefore(n);
+}
+
+bool FloatingProbeData::findTrigger(uint64_t *time)
+{
+    // The value only changes from one run to the next, so only the first
+    // sample of each run needs looking at
+    const uint64_t end = runEndIndex();
+    uint64_t n = qMax(m_triggerChecked, runBeginIndex());
+    bool hasPrevious = n > runBeginIndex();
+    float previous = hasPrevious ? run(n - 1).value : 0;
+
+    for (; n < end; ++n) {
+        const FloatingRun r = run(n);
+        if (meetsTrigger(hasPrevious, previous, r.value)) {
+            *time = toTime(r.begin);
+            m_triggerChecked = n + 1;
+            return true;
+        }
+        hasPrevious = true;
+        previous = r.value;
+    }
+
+    m_triggerChecked = end;
+    return false;
+}
+
+void FloatingProbeData::exportData(ProbeDataWriter &writer, uint64_t begin, uint64_t end) const
+{
+    if (isEmpty() || toTime(beginIndex()) > end)
+        return;
+
+    const uint64_t first = findPos(begin);
+    const uint64_t last = qMax(first, findPos(end));
+
+    // Only the first sample of each run is written, and the last sample so
+    // that it is clear how long the last run went on for
+    uint64_t written = first;
+    for (uint64_t n = findRun(first); n < runEndIndex(); ++n) {
+        const FloatingRun r = run(n);
+        if (r.begin > last)
+            break;
+        written = qMax(r.begin, first);
+        writer.writeSample(toTime(written), r.value);
+    }
+    if (written != last)
+        writer.writeSample(toTime(last), value(last));
+}
+
 uint64_t FloatingProbeData::toTime(uint64_t at) const
 {
-    return uint64_t(m_resetTime + (at * LOGIC_UPDATE_RATE * LINEAR_UPDATE_PERIOD));
+    return uint64_t(m_resetTime + (at * LOGIC_UPDATE_RATE / sampleRate()));
 }
 
 void FloatingProbeData::setScaling(Scaling scaling)
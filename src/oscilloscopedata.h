@@ -11,11 +11,17 @@
 #ifndef OSCILLOSCOPEDATA_H
 #define OSCILLOSCOPEDATA_H
 
+#include <QAtomicInt>
+#include <QAtomicPointer>
 #include <QColor>
 #include <QObject>
+#include <QTemporaryFile>
 #include <stdint.h>
 #include <vector>
 
+class ProbeDataWriter;
+class ProtocolDecoder;
+
 #define DATA_CHUNK_SIZE (8192 / sizeof(T))
 
 /*
@@ -28,9 +34,8 @@
 #define DCARRAY_ARRAY_SIZE ((67108864/(8192*DATA_CHUNK_ARRAY_SIZE))+1)
 */
 
-/** max number of samples that a probe can hold */
-#define MAX_PROBE_DATA_SIZE (1 * 1024 * 1024)
-// TODO ^ should be configurable
+/** default number of samples that a probe keeps */
+#define DEFAULT_PROBE_DATA_DEPTH (1 * 1024 * 1024)
 
 /**
 For use in LogicProbe: Every time the input changes state, the new input state
@@ -54,6 +59,513 @@ public:
     uint64_t time : 63;
 };
 
+/**
+For use in FloatingProbeData: a run of samples that all have the same value,
+from the sample with index begin up to the start of the next run.
+ */
+class FloatingRun
+{
+public:
+    FloatingRun()
+        : begin(0)
+        , value(0)
+    {
+    }
+    FloatingRun(uint64_t b, float v)
+        : begin(b)
+        , value(v)
+    {
+    }
+
+    uint64_t begin;
+    float value;
+};
+
+/**
+Holds the most recent samples recorded by a probe, up to its depth. The
+samples are stored in fixed-size chunks that are used as a ring, so once the
+depth has been reached the oldest samples are overwritten; nothing is moved
+or reallocated as samples are added.
+
+Samples are indexed by the number of samples added before them since the
+buffer was last cleared, so an index stays the same as older samples are
+dropped. The samples kept are those from beginIndex() to endIndex().
+
+A depth of zero keeps every sample, adding chunks as they are needed.
+ */
+template<typename T> class ProbeDataBuffer
+{
+public:
+    ProbeDataBuffer(uint64_t depth)
+        : m_depth(0)
+        , m_origin(0)
+        , m_begin(0)
+        , m_end(0)
+    {
+        setDepth(depth);
+    }
+    ~ProbeDataBuffer()
+    {
+        for (T *chunk : m_chunks)
+            delete[] chunk;
+    }
+    ProbeDataBuffer(const ProbeDataBuffer &) = delete;
+    ProbeDataBuffer &operator=(const ProbeDataBuffer &) = delete;
+
+    /**
+     * @return the greatest number of samples that are kept
+     */
+    uint64_t depth() const
+    {
+        return m_depth;
+    }
+    /**
+     * Sets the greatest number of samples kept, or zero to keep them all.
+     * As many of the newest samples as will fit are kept.
+     */
+    void setDepth(uint64_t depth)
+    {
+        if (depth == m_depth)
+            return;
+
+        std::vector<T *> oldChunks((depth + DATA_CHUNK_SIZE - 1) / DATA_CHUNK_SIZE, nullptr);
+        oldChunks.swap(m_chunks);
+        const uint64_t oldDepth = m_depth;
+        const uint64_t oldOrigin = m_origin;
+        m_depth = depth;
+
+        if (depth && m_end - m_begin > depth)
+            m_begin = m_end - depth;
+        m_origin = m_begin;
+        for (uint64_t at = m_begin; at < m_end; ++at) {
+            const uint64_t oldPos = oldDepth ? at % oldDepth : at - oldOrigin;
+            store(at, oldChunks[oldPos / DATA_CHUNK_SIZE][oldPos % DATA_CHUNK_SIZE]);
+        }
+
+        for (T *chunk : oldChunks)
+            delete[] chunk;
+    }
+    /**
+     * @return the index of the oldest sample kept
+     */
+    uint64_t beginIndex() const
+    {
+        return m_begin;
+    }
+    /**
+     * @return one past the index of the newest sample, which is the number
+     * of samples added since the buffer was cleared
+     */
+    uint64_t endIndex() const
+    {
+        return m_end;
+    }
+    bool isEmpty() const
+    {
+        return m_begin == m_end;
+    }
+    /**
+     * @return the bytes allocated for the samples
+     */
+    uint64_t memoryUsage() const
+    {
+        uint64_t bytes = m_chunks.capacity() * sizeof(T *);
+        for (const T *chunk : m_chunks) {
+            if (chunk)
+                bytes += DATA_CHUNK_SIZE * sizeof(T);
+        }
+        return bytes;
+    }
+    /**
+     * @param at between beginIndex() and endIndex()
+     */
+    const T &operator[](uint64_t at) const
+    {
+        const uint64_t pos = position(at);
+        return m_chunks[pos / DATA_CHUNK_SIZE][pos % DATA_CHUNK_SIZE];
+    }
+    const T &back() const
+    {
+        return (*this)[m_end - 1];
+    }
+    /**
+     * Adds the sample after the newest one, dropping the oldest one if the
+     * depth has been reached.
+     */
+    void append(const T &value)
+    {
+        store(m_end, value);
+        ++m_end;
+        if (m_depth && m_end - m_begin > m_depth)
+            ++m_begin;
+    }
+    /**
+     * Removes all the samples. The chunks are kept for reuse.
+     * @param start the index that the next sample is given
+     */
+    void clear(uint64_t start = 0)
+    {
+        m_origin = start;
+        m_begin = start;
+        m_end = start;
+    }
+    /**
+     * Drops the samples before the given index.
+     */
+    void discardBefore(uint64_t at)
+    {
+        if (at > m_end)
+            at = m_end;
+        if (at > m_begin)
+            m_begin = at;
+    }
+
+protected:
+    uint64_t position(uint64_t at) const
+    {
+        return m_depth ? at % m_depth : at - m_origin;
+    }
+    void store(uint64_t at, const T &value)
+    {
+        const uint64_t pos = position(at);
+        if (pos / DATA_CHUNK_SIZE >= m_chunks.size())
+            m_chunks.resize(pos / DATA_CHUNK_SIZE + 1, nullptr);
+        T *&chunk = m_chunks[pos / DATA_CHUNK_SIZE];
+        if (!chunk)
+            chunk = new T[DATA_CHUNK_SIZE];
+        chunk[pos % DATA_CHUNK_SIZE] = value;
+    }
+
+    std::vector<T *> m_chunks;
+    uint64_t m_depth;
+    uint64_t m_origin; // The index of the first sample in the first chunk, when every sample is kept
+    uint64_t m_begin;
+    uint64_t m_end;
+};
+
+/** number of data points of a LogicProbeData for each time in its index */
+#define LOGIC_TIME_INDEX_STRIDE 256
+
+/** number of blocks (or samples) that each block of a ProbeDataPyramid covers */
+#define PROBE_PYRAMID_FACTOR 8
+/** number of levels of a ProbeDataPyramid that keeps every sample */
+#define PROBE_PYRAMID_UNBOUNDED_LEVELS 16
+/** number of samples in the smallest blocks kept by a ProbeDataPyramid that
+ * keeps every sample */
+#define PROBE_PYRAMID_UNBOUNDED_MIN_BLOCK 512
+
+/**
+The least and greatest of a set of values.
+ */
+template<typename T> class MinMax
+{
+public:
+    MinMax()
+        : min()
+        , max()
+    {
+    }
+    MinMax(T value)
+        : min(value)
+        , max(value)
+    {
+    }
+
+    void include(const MinMax &other)
+    {
+        if (other.min < min)
+            min = other.min;
+        if (max < other.max)
+            max = other.max;
+    }
+
+    T min;
+    T max;
+};
+
+/**
+Keeps the least and greatest values of the samples in a ProbeDataBuffer, in
+blocks of PROBE_PYRAMID_FACTOR samples, blocks of PROBE_PYRAMID_FACTOR of
+those blocks, and so on. It is added to as the samples are, so that the
+least and greatest values over any range of samples can be found without
+going through each of them, as the oscilloscope does when zoomed out.
+
+When every sample is kept (a depth of zero), the blocks of fewer than
+PROBE_PYRAMID_UNBOUNDED_MIN_BLOCK samples are not stored, so that the memory
+used stays small next to the samples; the samples are read instead.
+ */
+template<typename T> class ProbeDataPyramid
+{
+public:
+    ProbeDataPyramid(uint64_t depth)
+        : m_end(0)
+    {
+        setDepth(depth);
+    }
+    ~ProbeDataPyramid()
+    {
+        for (ProbeDataBuffer<MinMax<T>> *level : m_levels)
+            delete level;
+    }
+    ProbeDataPyramid(const ProbeDataPyramid &) = delete;
+    ProbeDataPyramid &operator=(const ProbeDataPyramid &) = delete;
+
+    /**
+     * Makes enough levels of blocks for the given number of samples, which
+     * should be the depth of the samples' buffer. This clears the blocks.
+     */
+    void setDepth(uint64_t depth)
+    {
+        for (ProbeDataBuffer<MinMax<T>> *level : m_levels)
+            delete level;
+        m_levels.clear();
+
+        if (depth) {
+            // Each level holds one or two blocks more than it covers, for the
+            // blocks that the oldest and newest samples are part way through
+            for (uint64_t size = PROBE_PYRAMID_FACTOR; size <= depth; size *= PROBE_PYRAMID_FACTOR)
+                m_levels.push_back(new ProbeDataBuffer<MinMax<T>>(depth / size + 2));
+        } else {
+            uint64_t size = 1;
+            for (int level = 0; level < PROBE_PYRAMID_UNBOUNDED_LEVELS; ++level) {
+                size *= PROBE_PYRAMID_FACTOR;
+                m_levels.push_back((size < PROBE_PYRAMID_UNBOUNDED_MIN_BLOCK) ? nullptr : new ProbeDataBuffer<MinMax<T>>(0));
+            }
+        }
+        m_pending.assign(m_levels.size(), MinMax<T>());
+        clear(m_end);
+    }
+    /**
+     * @return the bytes allocated for the blocks
+     */
+    uint64_t memoryUsage() const
+    {
+        uint64_t bytes = 0;
+        for (const ProbeDataBuffer<MinMax<T>> *level : m_levels) {
+            if (level)
+                bytes += level->memoryUsage();
+        }
+        return bytes;
+    }
+    /**
+     * Removes all the blocks.
+     * @param start the index of the sample that is added next
+     */
+    void clear(uint64_t start = 0)
+    {
+        m_end = start;
+        uint64_t size = 1;
+        for (ProbeDataBuffer<MinMax<T>> *level : m_levels) {
+            size *= PROBE_PYRAMID_FACTOR;
+            if (level)
+                level->clear(start / size);
+        }
+    }
+    /**
+     * Adds the value of the sample after the last one added.
+     */
+    void append(T value)
+    {
+        MinMax<T> block(value);
+        uint64_t at = m_end++;
+        for (unsigned level = 0; level < m_levels.size(); ++level) {
+            MinMax<T> &pending = m_pending[level];
+            if (at % PROBE_PYRAMID_FACTOR == 0)
+                pending = block;
+            else
+                pending.include(block);
+
+            if (at % PROBE_PYRAMID_FACTOR != PROBE_PYRAMID_FACTOR - 1)
+                return;
+
+            // The block is complete, so goes on to the next level up
+            if (m_levels[level])
+                m_levels[level]->append(pending);
+            block = pending;
+            at /= PROBE_PYRAMID_FACTOR;
+        }
+    }
+    /**
+     * Finds the least and greatest values of the samples from begin up to
+     * end, which must be at least one sample, all still kept.
+     * @param sample gives the value of the sample at an index, for the
+     * samples at the ends of the range that are not in a whole block
+     */
+    template<typename Sample> MinMax<T> range(uint64_t begin, uint64_t end, Sample sample) const
+    {
+        MinMax<T> result(sample(begin));
+        uint64_t at = begin + 1;
+        while (at < end) {
+            // Take the largest block that starts here and fits in the range
+            unsigned level = 0;
+            uint64_t size = 1;
+            while (level < m_levels.size() && at % (size * PROBE_PYRAMID_FACTOR) == 0 && at + size * PROBE_PYRAMID_FACTOR <= end) {
+                size *= PROBE_PYRAMID_FACTOR;
+                ++level;
+            }
+            if (level > 0 && !m_levels[level - 1]) {
+                level = 0;
+                size = 1;
+            }
+
+            if (level == 0)
+                result.include(MinMax<T>(sample(at)));
+            else
+                result.include((*m_levels[level - 1])[at / size]);
+            at += size;
+        }
+        return result;
+    }
+
+protected:
+    std::vector<ProbeDataBuffer<MinMax<T>> *> m_levels; // m_levels[k] has blocks of PROBE_PYRAMID_FACTOR^(k+1) samples, or is null if not stored
+    std::vector<MinMax<T>> m_pending; // The incomplete block at each level
+    uint64_t m_end;
+};
+
+/** number of samples in each block of a ProbeSampleQueue */
+#define PROBE_QUEUE_BLOCK_SIZE 4096
+
+/**
+Passes the samples recorded by a probe from the simulation, which may run in
+its own thread, to the GUI thread, without either of them ever waiting for
+the other. One thread adds samples with push(), and one other thread takes
+them with take().
+
+The samples are kept in blocks that are added as they fill up, so push()
+never fails however long it is before the samples are taken.
+ */
+template<typename T> class ProbeSampleQueue
+{
+public:
+    ProbeSampleQueue()
+        : m_head(new Block)
+        , m_readPos(0)
+        , m_tail(m_head)
+        , m_writePos(0)
+    {
+    }
+    ~ProbeSampleQueue()
+    {
+        while (m_head) {
+            Block *next = m_head->next.loadAcquire();
+            delete m_head;
+            m_head = next;
+        }
+    }
+    ProbeSampleQueue(const ProbeSampleQueue &) = delete;
+    ProbeSampleQueue &operator=(const ProbeSampleQueue &) = delete;
+
+    /**
+     * Adds the sample after the last one.
+     */
+    void push(const T &value)
+    {
+        if (m_writePos == PROBE_QUEUE_BLOCK_SIZE) {
+            Block *block = new Block;
+            m_tail->next.storeRelease(block);
+            m_tail = block;
+            m_writePos = 0;
+        }
+        m_tail->samples[m_writePos] = value;
+        m_tail->count.storeRelease(++m_writePos);
+    }
+    /**
+     * Passes each of the samples added since the last call, oldest first,
+     * to the given function.
+     */
+    template<typename Function> void take(Function function)
+    {
+        for (;;) {
+            const int count = m_head->count.loadAcquire();
+            while (m_readPos < count)
+                function(m_head->samples[m_readPos++]);
+
+            if (m_readPos < PROBE_QUEUE_BLOCK_SIZE)
+                return;
+
+            // This block has been used up, so go on to the next if it has
+            // been added yet
+            Block *next = m_head->next.loadAcquire();
+            if (!next)
+                return;
+            delete m_head;
+            m_head = next;
+            m_readPos = 0;
+        }
+    }
+
+protected:
+    class Block
+    {
+    public:
+        Block()
+            : count(0)
+            , next(nullptr)
+        {
+        }
+
+        T samples[PROBE_QUEUE_BLOCK_SIZE];
+        QAtomicInt count; // Number of samples that have been written
+        QAtomicPointer<Block> next;
+    };
+
+    // Only used by the thread taking samples
+    Block *m_head;
+    int m_readPos;
+
+    // Only used by the thread adding samples
+    Block *m_tail;
+    int m_writePos;
+};
+
+/** size in bytes of each part of a ProbeCaptureFile that is mapped into memory */
+#define PROBE_CAPTURE_SEGMENT_SIZE (1024 * 1024)
+
+/**
+A temporary file that a probe records its samples to when capturing to disk
+(see KTLConfig::captureProbesToDisk), so that long recordings are not limited
+by the memory available. The file is grown a segment of
+PROBE_CAPTURE_SEGMENT_SIZE bytes at a time, and each segment is mapped into
+memory as it is added. The file is removed when this is destroyed.
+ */
+class ProbeCaptureFile
+{
+public:
+    ProbeCaptureFile();
+    ~ProbeCaptureFile();
+    ProbeCaptureFile(const ProbeCaptureFile &) = delete;
+    ProbeCaptureFile &operator=(const ProbeCaptureFile &) = delete;
+
+    /**
+     * @return whether the file could be created
+     */
+    bool isOpen() const;
+    /**
+     * @return the number of segments added so far
+     */
+    size_t segmentCount() const
+    {
+        return m_segments.size();
+    }
+    /**
+     * @param n less than segmentCount()
+     */
+    uchar *segment(size_t n) const
+    {
+        return m_segments[n];
+    }
+    /**
+     * Grows the file by a segment.
+     * @return the new segment, or null if the file could not be grown
+     */
+    uchar *addSegment();
+
+protected:
+    QTemporaryFile m_file;
+    std::vector<uchar *> m_segments;
+};
+
 /**
 @author David Saxton
  */
@@ -61,6 +573,8 @@ class ProbeData : public QObject
 {
     Q_OBJECT
 public:
+    enum TriggerType { NoTrigger, RisingEdge, FallingEdge, EitherEdge, HighLevel, LowLevel };
+
     ProbeData(int id);
     ~ProbeData() override;
 
@@ -71,6 +585,17 @@ public:
     {
         return m_id;
     }
+    /**
+     * Sets the name that the probe data is given when it is exported.
+     */
+    void setName(const QString &name)
+    {
+        m_name = name;
+    }
+    QString name() const
+    {
+        return m_name;
+    }
     /**
      * Set the proportion (0 = top, 1 = bottom) of the way down the
      * oscilloscope view that the probe output is drawn. If the proportion
@@ -125,6 +650,79 @@ public:
      * yet.
      */
     virtual uint64_t findPos(uint64_t time) const = 0;
+    /**
+     * Sets the greatest number of samples that are kept, after which the
+     * oldest ones are dropped as new ones are recorded. Samples that are
+     * the same as the one before are not counted.
+     */
+    virtual void setDepth(uint64_t depth) = 0;
+    /**
+     * Passes the recorded data from the Simulator time begin up to end to
+     * the writer, one sample at a time. The first sample gives the value
+     * at begin, and the last the value at end (if there is data that far).
+     */
+    virtual void exportData(ProbeDataWriter &writer, uint64_t begin, uint64_t end) const = 0;
+    /**
+     * @return whether the data is being recorded to a temporary file
+     * rather than kept in memory
+     */
+    bool isCapturing() const
+    {
+        return m_capture;
+    }
+    /**
+     * Sets whether data points are recorded, or ignored. The oscilloscope
+     * stops recording once it has all the data it wants around a trigger.
+     */
+    void setRecording(bool recording)
+    {
+        m_bRecording = recording;
+    }
+    /**
+     * Drops the data recorded before the given Simulator time, other than
+     * what is needed to give the value at that time.
+     */
+    virtual void discardBefore(uint64_t time) = 0;
+    /**
+     * @return the bytes allocated for the data kept in memory (data that is
+     * being captured to a file is not counted)
+     */
+    virtual uint64_t memoryUsage() const = 0;
+    /**
+     * Sets the condition that makes this probe trigger the oscilloscope.
+     * @param level the value that edges go across, and that levels are
+     * compared against
+     * @param preTime the Simulator time before the trigger that data is
+     * kept for
+     * @param postTime the Simulator time after the trigger that data is
+     * recorded for
+     */
+    void setTrigger(TriggerType type, double level, uint64_t preTime, uint64_t postTime);
+    TriggerType triggerType() const
+    {
+        return m_triggerType;
+    }
+    uint64_t triggerPreTime() const
+    {
+        return m_triggerPreTime;
+    }
+    uint64_t triggerPostTime() const
+    {
+        return m_triggerPostTime;
+    }
+    /**
+     * Looks through the data added since this was last called, or since the
+     * data was erased, for the trigger condition.
+     * @param time set to the Simulator time that the condition was first met
+     * @return whether the condition was met
+     */
+    virtual bool findTrigger(uint64_t *time) = 0;
+    /**
+     * Adds the data points that the simulation has recorded since the last
+     * call to the data. Only the GUI thread reads and changes the data, so
+     * this is called from there before looking at it.
+     */
+    virtual void collectData() = 0;
 
 signals:
     /**
@@ -134,10 +732,32 @@ signals:
     void displayAttributeChanged();
 
 protected:
+    /**
+     * Starts recording to a new capture file if capturing to disk is turned
+     * on, or otherwise goes back to keeping the data in memory. The data
+     * should have been erased first.
+     */
+    void resetCapture();
+    /**
+     * @return whether going from the previous value (if there is one) to
+     * the value meets the trigger condition
+     */
+    bool meetsTrigger(bool hasPrevious, double previous, double value) const;
+
     const int m_id;
+    QString m_name;
     float m_drawPosition;
     uint64_t m_resetTime;
     QColor m_color;
+    ProbeCaptureFile *m_capture; // Null when the data is kept in memory
+    uint64_t m_captureBegin; // Index of the oldest data point (or run) kept in m_capture
+    uint64_t m_captureEnd; // Number of data points, or runs of them, recorded to m_capture
+    bool m_bRecording;
+    TriggerType m_triggerType;
+    double m_triggerLevel;
+    uint64_t m_triggerPreTime;
+    uint64_t m_triggerPostTime;
+    uint64_t m_triggerChecked; // Index of the first data point (or run) not yet looked at for the trigger
 };
 
 /**
@@ -147,29 +767,111 @@ class LogicProbeData : public ProbeData
 {
 public:
     LogicProbeData(int id);
-    ~LogicProbeData() override
-    {
-        delete m_data;
-    }
+    ~LogicProbeData() override;
 
     /**
-     * Appends the data point to the set of data.
+     * Records the data point, to be added to the set of data when
+     * collectData() is next called. Only to be called from the simulation.
      */
-    void addDataPoint(LogicDataPoint data); /* {
-       m_data->push_back(data);
-   } */                                     // 2016.05.06 - moved to cpp
+    void addDataPoint(LogicDataPoint data)
+    {
+        m_queue.push(data);
+    }
 
+    void collectData() override;
     void eraseData() override;
     uint64_t findPos(uint64_t time) const override;
+    void setDepth(uint64_t depth) override;
+    void exportData(ProbeDataWriter &writer, uint64_t begin, uint64_t end) const override;
+    void discardBefore(uint64_t time) override;
+    uint64_t memoryUsage() const override;
+    bool findTrigger(uint64_t *time) override;
+    /**
+     * Finds whether the data points from begin up to end (at least one)
+     * are all low, all high, or both.
+     */
+    MinMax<bool> valueRange(uint64_t begin, uint64_t end) const;
+    /**
+     * @return the index of the oldest data point kept
+     */
+    uint64_t beginIndex() const
+    {
+        return m_capture ? m_captureBegin : m_data.beginIndex();
+    }
+    /**
+     * @return one past the index of the newest data point
+     */
+    uint64_t endIndex() const
+    {
+        return m_capture ? m_captureEnd : m_data.endIndex();
+    }
+    /**
+     * @param at between beginIndex() and endIndex()
+     */
+    LogicDataPoint dataPoint(uint64_t at) const
+    {
+        return m_capture ? capturedDataPoint(at) : m_data[at];
+    }
 
     bool isEmpty() const
     {
-        return m_data->size() == 0;
+        return beginIndex() == endIndex();
+    }
+
+    /**
+     * Sets the decoder of the protocol on this probe's line, which this
+     * takes ownership of (deleting any previous decoder); or none, if null.
+     */
+    void setDecoder(ProtocolDecoder *decoder);
+    ProtocolDecoder *decoder() const
+    {
+        return m_pDecoder;
     }
 
 protected:
-    std::vector<LogicDataPoint> *m_data;
-    friend class OscilloscopeView;
+    /**
+     * Appends the data point to the set of data.
+     */
+    void storeDataPoint(LogicDataPoint data)
+    {
+        m_lastValue = data.value;
+        m_hasLastValue = true;
+        if (!m_bRecording)
+            return;
+
+        if (m_capture) {
+            if (!captureDataPoint(data))
+                return;
+        } else
+            m_data.append(data);
+        m_pyramid.append(data.value);
+
+        if ((endIndex() - 1) % LOGIC_TIME_INDEX_STRIDE == 0)
+            m_timeIndex.append(data.time);
+    }
+    /**
+     * @return the number of times that m_timeIndex needs to keep for the
+     * given depth of data points
+     */
+    static uint64_t timeIndexDepth(uint64_t depth)
+    {
+        return depth ? depth / LOGIC_TIME_INDEX_STRIDE + 2 : 0;
+    }
+    /**
+     * Records the data point to the capture file.
+     * @return false if the file could not be grown
+     */
+    bool captureDataPoint(LogicDataPoint data);
+    LogicDataPoint capturedDataPoint(uint64_t at) const;
+
+    ProbeSampleQueue<LogicDataPoint> m_queue;
+    ProbeDataBuffer<LogicDataPoint> m_data;
+    ProbeDataPyramid<bool> m_pyramid;
+    ProbeDataBuffer<uint64_t> m_timeIndex; // The time of every LOGIC_TIME_INDEX_STRIDE-th data point, for findPos
+    std::vector<uint64_t> m_captureSegmentBegins; // Index of the first data point in each segment of m_capture
+    bool m_lastValue; // The newest value, whether or not it was recorded
+    bool m_hasLastValue;
+    ProtocolDecoder *m_pDecoder;
 };
 
 /**
@@ -179,17 +881,42 @@ class FloatingProbeData : public ProbeData
 {
 public:
     enum Scaling { Linear, Logarithmic };
+    enum Decimation {
+        LatestDecimation, // Keep the last value of each sample period
+        AverageDecimation, // Keep the mean of the values of each sample period
+        MinMaxDecimation // Keep the least and greatest values of each sample period, in the order they came
+    };
 
     FloatingProbeData(int id);
 
     /**
-     * Appends the data point to the set of data.
+     * Records the data point, to be added to the set of data when
+     * collectData() is next called. Only to be called from the simulation,
+     * once every linear step.
      */
-    void addDataPoint(float data); // { m_data->push_back(data); } // 2016.05.06 - moved to cpp
+    void addDataPoint(float data)
+    {
+        if (m_stepsPerPeriod == 1)
+            m_queue.push(data);
+        else
+            decimateDataPoint(data);
+    }
+
+    void collectData() override;
     /**
      * Converts the insert position to a Simulator time.
      */
     uint64_t toTime(uint64_t at) const;
+    /**
+     * Sets how many linear steps the values are combined over before they
+     * are recorded, and how. Changing these erases the data, as the times of
+     * the samples would no longer fit.
+     */
+    void setSampling(unsigned stepsPerPeriod, Decimation decimation);
+    /**
+     * @return the number of samples recorded in a second of Simulator time
+     */
+    double sampleRate() const;
     /**
      * Sets the scaling to use in the oscilloscope display.
      */
@@ -228,18 +955,126 @@ public:
 
     void eraseData() override;
     uint64_t findPos(uint64_t time) const override;
+    void setDepth(uint64_t depth) override;
+    void exportData(ProbeDataWriter &writer, uint64_t begin, uint64_t end) const override;
+    void discardBefore(uint64_t time) override;
+    uint64_t memoryUsage() const override;
+    bool findTrigger(uint64_t *time) override;
+    /**
+     * @return the least and greatest of the values from begin up to end
+     * (at least one)
+     */
+    MinMax<float> valueRange(uint64_t begin, uint64_t end) const;
+    /**
+     * @return the index of the oldest sample kept
+     */
+    uint64_t beginIndex() const
+    {
+        return isEmpty() ? m_end : run(runBeginIndex()).begin;
+    }
+    /**
+     * @return one past the index of the newest sample
+     */
+    uint64_t endIndex() const
+    {
+        return m_end;
+    }
+    /**
+     * @param at between beginIndex() and endIndex()
+     */
+    float value(uint64_t at) const
+    {
+        return run(findRun(at)).value;
+    }
+    /**
+     * @return the value of the newest sample
+     */
+    float lastValue() const
+    {
+        return m_lastValue;
+    }
 
     bool isEmpty() const
     {
-        return m_data->size() == 0;
+        return runBeginIndex() == runEndIndex();
+    }
+    /**
+     * @return the index of the oldest run of samples kept
+     */
+    uint64_t runBeginIndex() const
+    {
+        return m_capture ? m_captureBegin : m_runs.beginIndex();
+    }
+    /**
+     * @return one past the index of the newest run of samples
+     */
+    uint64_t runEndIndex() const
+    {
+        return m_capture ? m_captureEnd : m_runs.endIndex();
+    }
+    /**
+     * @param n between runBeginIndex() and runEndIndex()
+     */
+    FloatingRun run(uint64_t n) const
+    {
+        return m_capture ? capturedRun(n) : m_runs[n];
     }
+    /**
+     * @return the index of the run that the sample at the given index is
+     * part of
+     */
+    uint64_t findRun(uint64_t at) const;
 
 protected:
+    /**
+     * Appends the data point to the set of data.
+     */
+    void storeDataPoint(float data)
+    {
+        if (!m_bRecording)
+            return;
+
+        // A sample that is the same as the one before just makes its run longer
+        if (data != m_lastValue || isEmpty()) {
+            if (m_capture) {
+                if (!captureRun(FloatingRun(m_end, data)))
+                    return;
+            } else
+                m_runs.append(FloatingRun(m_end, data));
+            m_pyramid.append(data);
+            m_lastValue = data;
+        }
+        ++m_end;
+    }
+    /**
+     * Records the run to the capture file.
+     * @return false if the file could not be grown
+     */
+    bool captureRun(FloatingRun run);
+    FloatingRun capturedRun(uint64_t n) const;
+    /**
+     * Adds the value to those of the current sample period, and records the
+     * sample(s) for the period once it is over.
+     */
+    void decimateDataPoint(float data);
+
     Scaling m_scaling;
     double m_upperAbsValue;
     double m_lowerAbsValue;
-    std::vector<float> *m_data;
-    friend class OscilloscopeView;
+    ProbeSampleQueue<float> m_queue;
+    ProbeDataBuffer<FloatingRun> m_runs;
+    ProbeDataPyramid<float> m_pyramid; // Over the runs, rather than the samples
+    uint64_t m_end; // Number of samples added since the data was erased
+    float m_lastValue;
+
+    // The rest is only used by the simulation, other than when it is stopped
+    unsigned m_stepsPerPeriod; // Linear steps in each sample period
+    Decimation m_decimation;
+    unsigned m_periodSteps; // Linear steps so far in the current sample period
+    double m_periodSum;
+    float m_periodMin;
+    float m_periodMax;
+    bool m_periodMinFirst; // Whether the least value came before the greatest
 };
 
 #endif
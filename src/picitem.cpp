@@ -87,10 +87,7 @@ void PinItem::drawShape(QPainter &p)
     p.setFont(m_font);
     p.setBrush(Qt::NoBrush);
     QRect r = m_textRect;
-    if (onLeft)
-        p.drawText(r, Qt::AlignLeft, m_pinSettings->id());
-    else
-        p.drawText(r, Qt::AlignRight, m_pinSettings->id());
+    m_canvasText.draw(p, r, onLeft ? Qt::AlignLeft : Qt::AlignRight, m_pinSettings->id());
     // QRect br = p.boundingRect( r, Qt::AlignLeft, m_pinSettings->id() ); // 2017.10.01 - comment out unused variable
 
     int left;
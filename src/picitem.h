@@ -11,6 +11,7 @@
 #ifndef PICITEM_H
 #define PICITEM_H
 
+#include "canvastext.h"
 #include "cnitem.h"
 
 #include <QObject>
@@ -54,6 +55,7 @@ private:
     PinSettings *m_pinSettings;
     QRect m_textRect;
     QFont m_font;
+    CanvasText m_canvasText;
 };
 typedef QList<PinItem *> PinItemList;
 
@@ -0,0 +1,217 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "probedatawriter.h"
+#include "oscilloscopedata.h"
+#include "simulator.h"
+
+#include <QDateTime>
+
+#include <algorithm>
+
+/** Number of samples written to a binary file in one go */
+static const quint32 BINARY_CHUNK_SAMPLES = 4096;
+
+/** Simulator time that the samples of a Value Change Dump are sorted over at once (10 ms) */
+static const uint64_t VCD_SLICE_TIME = LOGIC_UPDATE_RATE / 100;
+
+// BEGIN class ProbeDataWriter
+ProbeDataWriter::ProbeDataWriter(QIODevice *device)
+    : m_device(device)
+{
+}
+
+ProbeDataWriter::~ProbeDataWriter()
+{
+}
+
+void ProbeDataWriter::write(const QList<ProbeData *> &probes, uint64_t begin, uint64_t end)
+{
+    for (ProbeData *probe : probes) {
+        beginProbe(probe);
+        probe->exportData(*this, begin, end);
+        endProbe();
+    }
+}
+
+void ProbeDataWriter::beginProbe(const ProbeData *probe)
+{
+    Q_UNUSED(probe);
+}
+
+void ProbeDataWriter::endProbe()
+{
+}
+// END class ProbeDataWriter
+
+// BEGIN class CsvProbeDataWriter
+CsvProbeDataWriter::CsvProbeDataWriter(QIODevice *device)
+    : ProbeDataWriter(device)
+    , m_stream(device)
+{
+    m_stream.setRealNumberPrecision(12);
+}
+
+void CsvProbeDataWriter::write(const QList<ProbeData *> &probes, uint64_t begin, uint64_t end)
+{
+    m_stream << "probe,time,value\n";
+    ProbeDataWriter::write(probes, begin, end);
+}
+
+void CsvProbeDataWriter::beginProbe(const ProbeData *probe)
+{
+    m_probeName = probe->name();
+}
+
+void CsvProbeDataWriter::writeSample(uint64_t time, double value)
+{
+    m_stream << m_probeName << ',' << double(time) / LOGIC_UPDATE_RATE << ',' << value << '\n';
+}
+// END class CsvProbeDataWriter
+
+// BEGIN class BinaryProbeDataWriter
+BinaryProbeDataWriter::BinaryProbeDataWriter(QIODevice *device)
+    : ProbeDataWriter(device)
+    , m_stream(device)
+    , m_chunkSamples(0)
+    , m_isLogic(false)
+{
+    m_chunk.open(QIODevice::WriteOnly);
+    m_chunkStream.setDevice(&m_chunk);
+
+    m_stream.setVersion(QDataStream::Qt_5_0);
+    m_chunkStream.setVersion(QDataStream::Qt_5_0);
+    m_chunkStream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+}
+
+void BinaryProbeDataWriter::write(const QList<ProbeData *> &probes, uint64_t begin, uint64_t end)
+{
+    m_stream << quint32(0x4b544c50) << quint32(1) << quint32(LOGIC_UPDATE_RATE);
+    ProbeDataWriter::write(probes, begin, end);
+}
+
+void BinaryProbeDataWriter::beginProbe(const ProbeData *probe)
+{
+    m_isLogic = dynamic_cast<const LogicProbeData *>(probe);
+    m_stream << quint8(m_isLogic ? 0 : 1) << probe->name();
+}
+
+void BinaryProbeDataWriter::writeSample(uint64_t time, double value)
+{
+    m_chunkStream << quint64(time);
+    if (m_isLogic)
+        m_chunkStream << quint8(value != 0);
+    else
+        m_chunkStream << float(value);
+
+    if (++m_chunkSamples == BINARY_CHUNK_SAMPLES)
+        flushChunk();
+}
+
+void BinaryProbeDataWriter::endProbe()
+{
+    flushChunk();
+    m_stream << quint32(0);
+}
+
+void BinaryProbeDataWriter::flushChunk()
+{
+    if (!m_chunkSamples)
+        return;
+
+    m_stream << m_chunkSamples;
+    m_stream.writeRawData(m_chunk.data().constData(), int(m_chunk.pos()));
+    m_chunk.seek(0);
+    m_chunkSamples = 0;
+}
+// END class BinaryProbeDataWriter
+
+// BEGIN class VcdProbeDataWriter
+VcdProbeDataWriter::VcdProbeDataWriter(QIODevice *device)
+    : ProbeDataWriter(device)
+    , m_stream(device)
+    , m_probe(0)
+{
+    m_stream.setRealNumberPrecision(9);
+}
+
+QString VcdProbeDataWriter::code(int probe)
+{
+    // Identifiers are made of the printable characters from '!' to '~'
+    QString code;
+    do {
+        code += QChar('!' + probe % 94);
+        probe /= 94;
+    } while (probe);
+    return code;
+}
+
+void VcdProbeDataWriter::write(const QList<ProbeData *> &probes, uint64_t begin, uint64_t end)
+{
+    static_assert(LOGIC_UPDATE_RATE == 1000000, "The timescale assumes a Simulator time step of a microsecond");
+
+    std::vector<bool> isLogic(probes.size());
+    for (int i = 0; i < probes.size(); ++i)
+        isLogic[i] = dynamic_cast<const LogicProbeData *>(probes[i]);
+
+    m_stream << "$date\n\t" << QDateTime::currentDateTime().toString(Qt::RFC2822Date) << "\n$end\n";
+    m_stream << "$version\n\tKTechLab\n$end\n";
+    m_stream << "$timescale 1us $end\n";
+    m_stream << "$scope module ktechlab $end\n";
+    for (int i = 0; i < probes.size(); ++i) {
+        QString name = probes[i]->name();
+        name.replace(' ', '_');
+        m_stream << "$var " << (isLogic[i] ? "wire 1 " : "real 64 ") << code(i) << ' ' << name << " $end\n";
+    }
+    m_stream << "$upscope $end\n$enddefinitions $end\n";
+
+    // The value last written for each probe, as the data passed at the start
+    // of each slice repeats the value at the end of the one before
+    std::vector<double> values(probes.size());
+    std::vector<bool> hasValue(probes.size(), false);
+    bool hasTime = false;
+    uint64_t time = 0;
+
+    for (uint64_t slice = begin; slice <= end; slice += VCD_SLICE_TIME) {
+        const uint64_t sliceEnd = qMin(end, slice + VCD_SLICE_TIME - 1);
+
+        m_changes.clear();
+        for (m_probe = 0; m_probe < probes.size(); ++m_probe)
+            probes[m_probe]->exportData(*this, slice, sliceEnd);
+        std::stable_sort(m_changes.begin(), m_changes.end(), [](const Change &a, const Change &b) { return a.time < b.time; });
+
+        for (const Change &change : m_changes) {
+            if (hasValue[change.probe] && values[change.probe] == change.value)
+                continue;
+            values[change.probe] = change.value;
+            hasValue[change.probe] = true;
+
+            if (!hasTime || change.time != time) {
+                time = change.time;
+                hasTime = true;
+                m_stream << '#' << (time - begin) << '\n';
+            }
+
+            if (isLogic[change.probe])
+                m_stream << (change.value ? '1' : '0') << code(change.probe) << '\n';
+            else
+                m_stream << 'r' << change.value << ' ' << code(change.probe) << '\n';
+        }
+
+        if (sliceEnd == end)
+            break;
+    }
+}
+
+void VcdProbeDataWriter::writeSample(uint64_t time, double value)
+{
+    m_changes.push_back({time, m_probe, value});
+}
+// END class VcdProbeDataWriter
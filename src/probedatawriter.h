@@ -0,0 +1,143 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef PROBEDATAWRITER_H
+#define PROBEDATAWRITER_H
+
+#include <QBuffer>
+#include <QDataStream>
+#include <QList>
+#include <QTextStream>
+
+#include <stdint.h>
+#include <vector>
+
+class ProbeData;
+class QIODevice;
+
+/**
+Writes the data recorded by probes to a file. The samples are passed to the
+writer one at a time by ProbeData::exportData, so that the data never has to
+be held in memory as a whole.
+*/
+class ProbeDataWriter
+{
+public:
+    ProbeDataWriter(QIODevice *device);
+    virtual ~ProbeDataWriter();
+
+    /**
+     * Writes the data of the probes from the Simulator time begin up to end.
+     */
+    virtual void write(const QList<ProbeData *> &probes, uint64_t begin, uint64_t end);
+    /**
+     * Writes a sample of the probe being written.
+     * @param time the Simulator time of the sample
+     */
+    virtual void writeSample(uint64_t time, double value) = 0;
+
+protected:
+    /**
+     * Called before the samples of each probe are written.
+     */
+    virtual void beginProbe(const ProbeData *probe);
+    /**
+     * Called after the samples of each probe have been written.
+     */
+    virtual void endProbe();
+
+    QIODevice *m_device;
+};
+
+/**
+Writes lines of the probe name, the time in seconds and the value, separated
+by commas.
+*/
+class CsvProbeDataWriter : public ProbeDataWriter
+{
+public:
+    CsvProbeDataWriter(QIODevice *device);
+
+    void write(const QList<ProbeData *> &probes, uint64_t begin, uint64_t end) override;
+    void writeSample(uint64_t time, double value) override;
+
+protected:
+    void beginProbe(const ProbeData *probe) override;
+
+    QTextStream m_stream;
+    QString m_probeName;
+};
+
+/**
+Writes the data in a compact binary form, using QDataStream. The file starts
+with the magic number 0x4b544c50 ("KTLP"), the version of the format and the
+number of Simulator time steps in a second. Then for each probe there is its
+type (0 for logic and 1 for floating), its name, and its samples in chunks:
+the number of samples in the chunk followed by the samples, each a quint64
+Simulator time and a quint8 (logic) or float (floating) value. A chunk of no
+samples ends the probe.
+*/
+class BinaryProbeDataWriter : public ProbeDataWriter
+{
+public:
+    BinaryProbeDataWriter(QIODevice *device);
+
+    void write(const QList<ProbeData *> &probes, uint64_t begin, uint64_t end) override;
+    void writeSample(uint64_t time, double value) override;
+
+protected:
+    void beginProbe(const ProbeData *probe) override;
+    void endProbe() override;
+    /**
+     * Writes the samples collected in m_chunk.
+     */
+    void flushChunk();
+
+    QDataStream m_stream;
+    QBuffer m_chunk;
+    QDataStream m_chunkStream;
+    quint32 m_chunkSamples;
+    bool m_isLogic;
+};
+
+/**
+Writes the data as a Value Change Dump, as read by waveform viewers such as
+GTKWave, with logic probes as wires and floating probes as real variables.
+The changes have to be written in time order, so the data is gone through a
+slice of time at a time, and only the samples of the one slice are held.
+*/
+class VcdProbeDataWriter : public ProbeDataWriter
+{
+public:
+    VcdProbeDataWriter(QIODevice *device);
+
+    void write(const QList<ProbeData *> &probes, uint64_t begin, uint64_t end) override;
+    void writeSample(uint64_t time, double value) override;
+
+protected:
+    class Change
+    {
+    public:
+        uint64_t time;
+        int probe;
+        double value;
+    };
+
+    /**
+     * @return the identifier code of the probe at the position in the list
+     */
+    static QString code(int probe);
+
+    QTextStream m_stream;
+    std::vector<Change> m_changes; // The samples of the slice being written
+    int m_probe; // The position in the list of the probe being written
+};
+
+#endif
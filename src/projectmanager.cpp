@@ -28,6 +28,8 @@
 #include <QDomDocument>
 #include <QDomElement>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
 // #include <q3popupmenu.h>
 #include <QDir>
 #include <QMenu>
@@ -60,6 +62,15 @@ static QString resolvedLocalFile(const QString &baseDir, const QString &path)
     return QDir::cleanPath(baseDir + path);
 }
 
+/**
+ * @return the item of the library linked internally as linkedInternal (which
+ * is relative to the project directory once edited, or absolute once loaded)
+ */
+static ProjectItem *internalLibrary(ProjectInfo *projectInfo, const QString &linkedInternal)
+{
+    return projectInfo->findItem(QUrl::fromLocalFile(::resolvedLocalFile(projectInfo->directory(), linkedInternal)));
+}
+
 // BEGIN class LinkerOptions
 LinkerOptions::LinkerOptions()
 {
@@ -202,6 +213,8 @@ ProjectItem::ProjectItem(ProjectItem *parent, Type type, ProjectManager *project
     m_pILVItem = nullptr;
     m_pProjectManager = projectManager;
     m_type = type;
+    m_bUpToDate = false;
+    m_bOutOfDate = false;
 }
 
 ProjectItem::~ProjectItem()
@@ -415,7 +428,7 @@ bool ProjectItem::build(ProcessOptionsList *pol)
     // Build all internal libraries that we depend on
     QStringList::iterator send = m_linkedInternal.end();
     for (QStringList::iterator it = m_linkedInternal.begin(); it != send; ++it) {
-        ProjectItem *lib = projectInfo->findItem(QUrl::fromLocalFile(projectInfo->directory() + *it));
+        ProjectItem *lib = ::internalLibrary(projectInfo, *it);
         if (!lib) {
             KMessageBox::error(nullptr, i18n("Do not know how to build \"%1\" (library does not exist in project).", *it));
             return false;
@@ -433,6 +446,9 @@ bool ProjectItem::build(ProcessOptionsList *pol)
             return false;
     }
 
+    if (isUpToDate())
+        return true;
+
     // Now build ourself
     ProcessOptions po;
     po.b_addToProject = false;
@@ -495,7 +511,7 @@ bool ProjectItem::build(ProcessOptionsList *pol)
     // Link against libraries
     QStringList::iterator lend = m_linkedInternal.end();
     for (QStringList::iterator it = m_linkedInternal.begin(); it != lend; ++it)
-        po.m_linkLibraries += projectInfo->directory() + *it;
+        po.m_linkLibraries += ::resolvedLocalFile(projectInfo->directory(), *it);
     lend = m_linkedExternal.end();
     for (QStringList::iterator it = m_linkedExternal.begin(); it != lend; ++it)
         po.m_linkLibraries += *it;
@@ -505,10 +521,102 @@ bool ProjectItem::build(ProcessOptionsList *pol)
     if (currentDoc)
         currentDoc->fileSave();
     pol->append(po);
+    m_bOutOfDate = false;
 
     return true;
 }
 
+bool ProjectItem::isUpToDate()
+{
+    ProjectInfo *projectInfo = ProjectManager::self()->currentProject();
+    if (!projectInfo || m_bOutOfDate || !outputURL().isLocalFile())
+        return false;
+
+    // The children and libraries are checked even when this item is known
+    // to be up to date, as it is not watching their inputs
+    QStringList inputFiles;
+
+    switch (type()) {
+    case ProjectType:
+        return false;
+
+    case FileType: {
+        // Building saves the file first
+        Document *document = DocManager::self()->findDocument(url());
+        if (document && document->isModified())
+            return false;
+
+        inputFiles << url().toLocalFile();
+        break;
+    }
+    case ProgramType:
+    case LibraryType:
+        m_children.removeAll(static_cast<ProjectItem *>(nullptr));
+        for (ProjectItem *child : qAsConst(m_children)) {
+            if (!child->isUpToDate())
+                return false;
+            inputFiles << child->outputURL().toLocalFile();
+        }
+        break;
+    }
+
+    for (const QString &linkedInternal : qAsConst(m_linkedInternal)) {
+        ProjectItem *lib = ::internalLibrary(projectInfo, linkedInternal);
+        if (!lib || !lib->isUpToDate())
+            return false;
+        inputFiles << lib->outputURL().toLocalFile();
+    }
+
+    if (m_bUpToDate)
+        return true;
+
+    const QFileInfo output(outputURL().toLocalFile());
+    if (!output.exists())
+        return false;
+
+    const QDateTime outputModified = output.lastModified();
+    for (const QString &inputFile : qAsConst(inputFiles)) {
+        const QFileInfo input(inputFile);
+        if (!input.exists() || input.lastModified() > outputModified)
+            return false;
+    }
+
+    projectInfo->watchFiles(inputFiles << output.filePath());
+    m_bUpToDate = true;
+    return true;
+}
+
+void ProjectItem::invalidate(const QString &fileName)
+{
+    if (url().toLocalFile() == fileName || outputURL().toLocalFile() == fileName)
+        m_bUpToDate = false;
+
+    m_children.removeAll(static_cast<ProjectItem *>(nullptr));
+    for (ProjectItem *child : qAsConst(m_children)) {
+        // Items built from the output of a child
+        if (child->outputURL().toLocalFile() == fileName)
+            m_bUpToDate = false;
+        child->invalidate(fileName);
+    }
+
+    ProjectInfo *projectInfo = ProjectManager::self()->currentProject();
+    for (const QString &linkedInternal : qAsConst(m_linkedInternal)) {
+        ProjectItem *lib = projectInfo ? ::internalLibrary(projectInfo, linkedInternal) : nullptr;
+        if (lib && lib->outputURL().toLocalFile() == fileName)
+            m_bUpToDate = false;
+    }
+}
+
+void ProjectItem::setOutOfDate()
+{
+    m_bUpToDate = false;
+    m_bOutOfDate = true;
+
+    m_children.removeAll(static_cast<ProjectItem *>(nullptr));
+    for (ProjectItem *child : qAsConst(m_children))
+        child->setOutOfDate();
+}
+
 void ProjectItem::upload(ProcessOptionsList *pol)
 {
     build(pol);
@@ -723,6 +831,9 @@ ProjectInfo::ProjectInfo(ProjectManager *projectManager)
     : ProjectItem(nullptr, ProjectItem::ProjectType, projectManager)
 {
     m_microID = QString();
+
+    m_pWatcher = new QFileSystemWatcher(this);
+    connect(m_pWatcher, &QFileSystemWatcher::fileChanged, this, &ProjectInfo::slotFileChanged);
 }
 
 ProjectInfo::~ProjectInfo()
@@ -831,6 +942,33 @@ bool ProjectInfo::save()
     return true;
 }
 
+void ProjectInfo::watchFiles(const QStringList &fileNames)
+{
+    QStringList newFileNames;
+    for (const QString &fileName : fileNames) {
+        if (!m_watchedFiles.contains(fileName))
+            newFileNames << fileName;
+    }
+    if (newFileNames.isEmpty())
+        return;
+
+    const QStringList failed = m_pWatcher->addPaths(newFileNames);
+    for (const QString &fileName : qAsConst(newFileNames)) {
+        if (!failed.contains(fileName))
+            m_watchedFiles.insert(fileName);
+    }
+}
+
+void ProjectInfo::slotFileChanged(const QString &fileName)
+{
+    // Files that are saved by replacing them are no longer watched, so the
+    // file is watched again once its items are found to be up to date
+    m_pWatcher->removePath(fileName);
+    m_watchedFiles.remove(fileName);
+
+    invalidate(fileName);
+}
+
 bool ProjectInfo::saveAndClose()
 {
     if (!save())
@@ -1095,7 +1233,8 @@ void ProjectManager::slotSubprojectLinkerOptions()
         return;
 
     LinkerOptionsDlg *dlg = new LinkerOptionsDlg(currentItem->projectItem(), this);
-    dlg->exec();
+    if (dlg->exec() == QDialog::Accepted)
+        currentItem->projectItem()->setOutOfDate();
     currentProject()->save();
 
     // The dialog sets the options for us if it was accepted, so we don't need to do anything
@@ -1109,7 +1248,8 @@ void ProjectManager::slotItemProcessingOptions()
         return;
 
     ProcessingOptionsDlg *dlg = new ProcessingOptionsDlg(currentItem->projectItem(), this);
-    dlg->exec();
+    if (dlg->exec() == QDialog::Accepted)
+        currentItem->projectItem()->setOutOfDate();
     currentProject()->save();
 
     // The dialog sets the options for us if it was accepted, so we don't need to do anything
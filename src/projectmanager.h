@@ -15,6 +15,7 @@
 
 #include <QList>
 #include <QPointer>
+#include <QSet>
 #include <QUrl>
 
 class Document;
@@ -26,6 +27,7 @@ class ProjectItem;
 class ProjectManager;
 class QDomDocument;
 class QDomElement;
+class QFileSystemWatcher;
 class QStringList;
 namespace KateMDI
 {
@@ -279,8 +281,30 @@ public:
      */
     QDomElement toDomElement(QDomDocument &doc, const QUrl &baseDirUrl) const;
 
+    /**
+     * Appends the processing needed to build this item to pol, after that
+     * of the children and internal libraries it is built from. Nothing is
+     * appended for items that are up to date (see isUpToDate).
+     */
     bool build(ProcessOptionsList *pol);
     void upload(ProcessOptionsList *pol);
+    /**
+     * @return whether the output of this item is newer than everything it
+     * is built from, and so does not need building again. Once found to be
+     * up to date, the files are watched by the project, and the item is
+     * only checked again after one of them changes (see invalidate).
+     */
+    bool isUpToDate();
+    /**
+     * Marks this item and its children as needing to be checked again, if
+     * they are built from (or to) the given file.
+     */
+    void invalidate(const QString &fileName);
+    /**
+     * Makes this item and its children be built again however new their
+     * outputs are, e.g. after their processing options have been changed.
+     */
+    void setOutOfDate();
 
     void setMicroID(const QString &id) override;
     QString microID() const override;
@@ -307,6 +331,8 @@ protected:
     QPointer<ILVItem> m_pILVItem;
     ProjectManager *m_pProjectManager;
     ProjectItem *m_pParent;
+    bool m_bUpToDate; // Whether the output was found to be newer than the files it is built from, which have not changed since
+    bool m_bOutOfDate; // Whether to be built again regardless of the files (see setOutOfDate)
 };
 
 /**
@@ -337,6 +363,19 @@ public:
     bool save();
 
     bool open(const QUrl &url);
+
+    /**
+     * Watches the files for changes, which then make the items built from
+     * them out of date.
+     */
+    void watchFiles(const QStringList &fileNames);
+
+protected slots:
+    void slotFileChanged(const QString &fileName);
+
+protected:
+    QFileSystemWatcher *m_pWatcher;
+    QSet<QString> m_watchedFiles;
 };
 
 /**
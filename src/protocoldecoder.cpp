@@ -0,0 +1,308 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "protocoldecoder.h"
+#include "oscilloscopedata.h"
+#include "simulator.h"
+
+#include <KLocalizedString>
+
+#include <algorithm>
+#include <limits>
+
+// BEGIN class ProtocolDecoder
+ProtocolDecoder::ProtocolDecoder(LogicProbeData *data)
+    : m_changedFrom(0)
+{
+    m_inputs[DataInput] = data;
+    m_next[DataInput] = data->beginIndex();
+    m_next[ClockInput] = 0;
+    m_level[DataInput] = m_level[ClockInput] = false;
+    m_hasLevel[DataInput] = m_hasLevel[ClockInput] = false;
+}
+
+ProtocolDecoder::~ProtocolDecoder()
+{
+}
+
+ProtocolDecoder *ProtocolDecoder::create(LogicProbeData *data, const QString &protocol, const QString &clockProbe, double baudRate, bool risingEdge)
+{
+    if (protocol == "UART" && baudRate > 0.)
+        return new UartDecoder(data, baudRate);
+    if (protocol == "SPI" && !clockProbe.isEmpty())
+        return new SpiDecoder(data, clockProbe, risingEdge);
+    if (protocol == "I2C" && !clockProbe.isEmpty())
+        return new I2cDecoder(data, clockProbe);
+    return nullptr;
+}
+
+void ProtocolDecoder::setClock(LogicProbeData *clock)
+{
+    m_inputs[ClockInput] = clock;
+    m_next[ClockInput] = clock ? clock->beginIndex() : 0;
+    m_hasLevel[ClockInput] = false;
+    restart();
+}
+
+void ProtocolDecoder::update(uint64_t now)
+{
+    LogicProbeData *const inputs[2] = {m_inputs[DataInput], m_inputs[ClockInput]};
+    const int count = m_clockName.isEmpty() ? 1 : 2;
+    for (int i = 0; i < count; ++i) {
+        if (!inputs[i])
+            return;
+    }
+
+    // Edges that were dropped before they were decoded leave the state
+    // machine out of step
+    for (int i = 0; i < count; ++i) {
+        if (m_next[i] >= inputs[i]->beginIndex() && m_next[i] <= inputs[i]->endIndex())
+            continue;
+        m_next[i] = inputs[i]->beginIndex();
+        m_hasLevel[i] = false;
+        restart();
+    }
+
+    for (;;) {
+        // The next edge of either input; on a tie, the clock goes first, so
+        // data that changes with the clock edge counts as changing after it
+        int input = -1;
+        uint64_t time = 0;
+        for (int i = count - 1; i >= 0; --i) {
+            if (m_next[i] >= inputs[i]->endIndex())
+                continue;
+            const uint64_t t = inputs[i]->dataPoint(m_next[i]).time;
+            if (input < 0 || t < time) {
+                input = i;
+                time = t;
+            }
+        }
+        if (input < 0)
+            break;
+
+        const LogicDataPoint point = inputs[input]->dataPoint(m_next[input]++);
+        if (!m_hasLevel[input]) {
+            m_hasLevel[input] = true;
+            m_level[input] = point.value;
+            continue;
+        }
+        if (point.value == m_level[input])
+            continue;
+
+        advanceTo(point.time);
+        m_level[input] = point.value;
+        edge(Input(input), point.time);
+    }
+
+    advanceTo(now);
+}
+
+void ProtocolDecoder::reset()
+{
+    m_annotations.clear();
+    m_changedFrom = 0;
+
+    for (int i = 0; i < 2; ++i) {
+        m_next[i] = m_inputs[i] ? m_inputs[i]->beginIndex() : 0;
+        m_hasLevel[i] = false;
+    }
+    restart();
+}
+
+size_t ProtocolDecoder::findAnnotation(uint64_t time) const
+{
+    const std::deque<Annotation>::const_iterator it = std::lower_bound(m_annotations.begin(), m_annotations.end(), time, [](const Annotation &annotation, uint64_t t) { return annotation.end < t; });
+    return it - m_annotations.begin();
+}
+
+uint64_t ProtocolDecoder::takeChangedFrom()
+{
+    const uint64_t changedFrom = m_changedFrom;
+    m_changedFrom = std::numeric_limits<uint64_t>::max();
+    return changedFrom;
+}
+
+void ProtocolDecoder::annotate(uint64_t begin, uint64_t end, const QString &text, bool error)
+{
+    if (m_annotations.size() >= MAX_ANNOTATIONS)
+        m_annotations.pop_front();
+    m_annotations.push_back({begin, end, text, error});
+    m_changedFrom = std::min(m_changedFrom, begin);
+}
+
+QString ProtocolDecoder::byteText(unsigned byte)
+{
+    QString text = QLatin1String("0x") + QString::number(byte, 16).rightJustified(2, '0').toUpper();
+    if (byte >= 0x20 && byte < 0x7f)
+        text += QString(" '%1'").arg(QChar(byte));
+    return text;
+}
+// END class ProtocolDecoder
+
+// BEGIN class UartDecoder
+UartDecoder::UartDecoder(LogicProbeData *data, double baudRate)
+    : ProtocolDecoder(data)
+    , m_bitTime(LOGIC_UPDATE_RATE / baudRate)
+{
+    restart();
+}
+
+void UartDecoder::restart()
+{
+    m_receiving = false;
+    m_start = 0;
+    m_bit = 0;
+    m_byte = 0;
+}
+
+void UartDecoder::edge(Input input, uint64_t time)
+{
+    // A frame starts with the line going low
+    if (input != DataInput || m_receiving || m_level[DataInput])
+        return;
+
+    m_receiving = true;
+    m_start = time;
+    m_bit = 0;
+    m_byte = 0;
+}
+
+void UartDecoder::advanceTo(uint64_t time)
+{
+    while (m_receiving) {
+        const double sampleTime = m_start + (m_bit + 0.5) * m_bitTime;
+        if (sampleTime >= time)
+            return;
+
+        const bool level = m_level[DataInput];
+        if (m_bit == 0) {
+            // Back high before the middle of the start bit: a glitch
+            if (level) {
+                m_receiving = false;
+                return;
+            }
+        } else if (m_bit <= 8) {
+            if (level)
+                m_byte |= 1u << (m_bit - 1);
+        } else {
+            // A low stop bit is a framing error
+            annotate(m_start, m_start + uint64_t(10 * m_bitTime), byteText(m_byte), !level);
+            m_receiving = false;
+            return;
+        }
+        m_bit++;
+    }
+}
+// END class UartDecoder
+
+// BEGIN class SpiDecoder
+SpiDecoder::SpiDecoder(LogicProbeData *data, const QString &clockProbe, bool risingEdge)
+    : ProtocolDecoder(data)
+    , m_risingEdge(risingEdge)
+{
+    m_clockName = clockProbe;
+    restart();
+}
+
+void SpiDecoder::restart()
+{
+    m_bits = 0;
+    m_byte = 0;
+    m_begin = 0;
+}
+
+void SpiDecoder::edge(Input input, uint64_t time)
+{
+    if (input != ClockInput || m_level[ClockInput] != m_risingEdge || !m_hasLevel[DataInput])
+        return;
+
+    if (m_bits == 0)
+        m_begin = time;
+    m_byte = (m_byte << 1) | (m_level[DataInput] ? 1 : 0);
+    if (++m_bits < 8)
+        return;
+
+    annotate(m_begin, time, byteText(m_byte));
+    m_bits = 0;
+    m_byte = 0;
+}
+// END class SpiDecoder
+
+// BEGIN class I2cDecoder
+I2cDecoder::I2cDecoder(LogicProbeData *data, const QString &clockProbe)
+    : ProtocolDecoder(data)
+{
+    m_clockName = clockProbe;
+    restart();
+}
+
+void I2cDecoder::restart()
+{
+    m_inFrame = false;
+    m_addressNext = false;
+    m_bits = 0;
+    m_byte = 0;
+    m_begin = 0;
+}
+
+void I2cDecoder::edge(Input input, uint64_t time)
+{
+    if (!m_hasLevel[DataInput] || !m_hasLevel[ClockInput])
+        return;
+
+    if (input == DataInput) {
+        // The data only changes while the clock is high for a start (going
+        // low) or a stop (going high)
+        if (!m_level[ClockInput])
+            return;
+
+        if (!m_level[DataInput]) {
+            annotate(time, time, m_inFrame ? QStringLiteral("Sr") : QStringLiteral("S"));
+            m_inFrame = true;
+            m_addressNext = true;
+            m_bits = 0;
+            m_byte = 0;
+        } else {
+            if (m_inFrame)
+                annotate(time, time, QStringLiteral("P"));
+            restart();
+        }
+        return;
+    }
+
+    if (!m_inFrame || !m_level[ClockInput])
+        return;
+
+    if (m_bits == 0)
+        m_begin = time;
+    if (m_bits < 8) {
+        m_byte = (m_byte << 1) | (m_level[DataInput] ? 1 : 0);
+        m_bits++;
+        return;
+    }
+
+    // The ninth bit is the acknowledge, pulled low by the receiver. Only an
+    // address that is not acknowledged is an error, as the master does not
+    // acknowledge the last byte it reads.
+    const bool acknowledged = !m_level[DataInput];
+    QString text;
+    if (m_addressNext) {
+        const QString address = QLatin1String("0x") + QString::number(m_byte >> 1, 16).rightJustified(2, '0').toUpper();
+        text = (m_byte & 1) ? i18n("Read %1", address) : i18n("Write %1", address);
+    } else
+        text = byteText(m_byte);
+    text += acknowledged ? QLatin1String(" ACK") : QLatin1String(" NAK");
+
+    annotate(m_begin, time, text, m_addressNext && !acknowledged);
+    m_addressNext = false;
+    m_bits = 0;
+    m_byte = 0;
+}
+// END class I2cDecoder
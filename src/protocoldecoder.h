@@ -0,0 +1,224 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef PROTOCOLDECODER_H
+#define PROTOCOLDECODER_H
+
+#include <QPointer>
+#include <QString>
+
+#include <deque>
+#include <stdint.h>
+
+class LogicProbeData;
+
+/**
+Decodes the traffic of a serial protocol (such as UART, SPI or I2C) from the
+edges recorded by logic probes, for showing over the traces in the
+oscilloscope.
+
+A decoder is given the probe of the data line, and for clocked protocols the
+probe of the clock line as well. Each update only goes through the edges that
+have been added to the probes since the one before, in order of time, feeding
+them to the state machine of the protocol; the history is never scanned
+again, so the cost is in proportion to the new edges. The state machine is
+started again if edges it has not seen were dropped (e.g. the probe data was
+erased, or the oldest data points were dropped to keep within its depth).
+
+@short Incremental protocol decoder over logic probe data
+*/
+class ProtocolDecoder
+{
+public:
+    /**
+     * Something decoded, such as a byte, over a span of Simulator time.
+     */
+    class Annotation
+    {
+    public:
+        uint64_t begin;
+        uint64_t end;
+        QString text;
+        bool error; ///< e.g. a framing error, or a byte that was not acknowledged
+    };
+
+    /**
+     * @param data the probe of the data line, which owns the decoder
+     */
+    ProtocolDecoder(LogicProbeData *data);
+    virtual ~ProtocolDecoder();
+
+    /**
+     * Creates the decoder for the protocol ("UART", "SPI" or "I2C"), or
+     * returns nullptr for any other.
+     * @param clockProbe the name of the probe of the clock line (SPI's SCK,
+     * I2C's SCL)
+     * @param baudRate in bits per second, for UART
+     * @param risingEdge whether SPI data is sampled on the rising edge of
+     * the clock (rather than the falling edge)
+     */
+    static ProtocolDecoder *create(LogicProbeData *data, const QString &protocol, const QString &clockProbe, double baudRate, bool risingEdge);
+
+    /**
+     * @return the name of the probe of the clock line, or an empty string
+     * if the protocol is not clocked
+     */
+    QString clockProbeName() const
+    {
+        return m_clockName;
+    }
+    /**
+     * @return whether the probe of the clock line still has to be found
+     */
+    bool needsClock() const
+    {
+        return !m_clockName.isEmpty() && !m_inputs[ClockInput];
+    }
+    /**
+     * Sets the probe data of the clock line, once it has been found from
+     * its name.
+     */
+    void setClock(LogicProbeData *clock);
+
+    /**
+     * Feeds the edges added to the probes since the last update to the state
+     * machine, up to the Simulator time now (which all of the probes have
+     * been collected up to).
+     */
+    void update(uint64_t now);
+    /**
+     * Throws away the annotations, and starts the state machine again from
+     * the oldest data kept by the probes.
+     */
+    void reset();
+
+    const std::deque<Annotation> &annotations() const
+    {
+        return m_annotations;
+    }
+    /**
+     * @return the index of the first annotation that ends at or after the
+     * time
+     */
+    size_t findAnnotation(uint64_t time) const;
+    /**
+     * @return the earliest beginning of the annotations added since this was
+     * last called (or UINT64_MAX if there are none), so that the part of the
+     * view from there can be drawn again.
+     */
+    uint64_t takeChangedFrom();
+
+    /**
+     * The oldest annotations are dropped once there are more than this.
+     */
+    static const size_t MAX_ANNOTATIONS = 1 << 16;
+
+protected:
+    enum Input { DataInput = 0, ClockInput = 1 };
+
+    /**
+     * Called for each edge, in order of time, with m_level already set to
+     * the new level.
+     */
+    virtual void edge(Input input, uint64_t time) = 0;
+    /**
+     * Called before each edge and at the end of each update, for protocols
+     * that sample at times of their own (UART), with m_level the level of
+     * the lines up to the time.
+     */
+    virtual void advanceTo(uint64_t time)
+    {
+        Q_UNUSED(time);
+    }
+    /**
+     * Puts the state machine back to waiting for the start of a frame.
+     */
+    virtual void restart() = 0;
+
+    void annotate(uint64_t begin, uint64_t end, const QString &text, bool error = false);
+    /**
+     * @return the text for a byte, e.g. "0x41 'A'"
+     */
+    static QString byteText(unsigned byte);
+
+    QString m_clockName;
+    QPointer<LogicProbeData> m_inputs[2];
+    uint64_t m_next[2]; ///< index of the next data point of each input
+    bool m_level[2];
+    bool m_hasLevel[2]; ///< whether the level of the input is known yet
+
+private:
+    std::deque<Annotation> m_annotations;
+    uint64_t m_changedFrom;
+};
+
+/**
+Asynchronous serial: a low start bit, 8 data bits (least significant first)
+and a high stop bit, at the baud rate. Each bit is sampled in its middle.
+*/
+class UartDecoder : public ProtocolDecoder
+{
+public:
+    UartDecoder(LogicProbeData *data, double baudRate);
+
+protected:
+    void edge(Input input, uint64_t time) override;
+    void advanceTo(uint64_t time) override;
+    void restart() override;
+
+    double m_bitTime; ///< in Simulator time
+    bool m_receiving;
+    uint64_t m_start; ///< of the start bit
+    int m_bit; ///< of the frame to sample next (0 is the start bit)
+    unsigned m_byte;
+};
+
+/**
+SPI: a bit on each sampling edge of the clock, most significant first, with
+each 8 bits making a byte.
+*/
+class SpiDecoder : public ProtocolDecoder
+{
+public:
+    SpiDecoder(LogicProbeData *data, const QString &clockProbe, bool risingEdge);
+
+protected:
+    void edge(Input input, uint64_t time) override;
+    void restart() override;
+
+    bool m_risingEdge;
+    int m_bits;
+    unsigned m_byte;
+    uint64_t m_begin; ///< of the first bit of the byte
+};
+
+/**
+I2C: start and stop conditions (the data changing while the clock is high),
+and the bytes between them sampled on the rising edges of the clock, each
+followed by its acknowledge bit. The first byte after a start is shown as the
+address and direction.
+*/
+class I2cDecoder : public ProtocolDecoder
+{
+public:
+    I2cDecoder(LogicProbeData *data, const QString &clockProbe);
+
+protected:
+    void edge(Input input, uint64_t time) override;
+    void restart() override;
+
+    bool m_inFrame;
+    bool m_addressNext; ///< whether the next byte is the address
+    int m_bits;
+    unsigned m_byte;
+    uint64_t m_begin; ///< of the first bit of the byte
+};
+
+#endif
@@ -9,12 +9,27 @@
  ***************************************************************************/
 
 #include "simulator.h"
+#include "circuitworkerpool.h"
+#include "cnitem.h"
 #include "component.h"
+#include "diode.h"
+#include "ecnode.h"
 #include "gpsimprocessor.h"
+#include "led.h"
+#include "logicnetlist.h"
+#include "matrix.h"
+#include "ngspicecircuit.h"
 #include "pin.h"
+#include "simulatorthread.h"
+#include "stallwatch.h"
+#include "stimulus.h"
 #include "switch.h"
+#include "telemetrystream.h"
 
 #include "ktechlab_debug.h"
+#include <ktlconfig.h>
+
+#include <KLocalizedString>
 
 // #include <k3staticdeleter.h>
 
@@ -22,12 +37,26 @@
 #include <QElapsedTimer>
 #include <QGlobalStatic>
 #include <QSet>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
 #include <QTimer>
 
+#include <algorithm>
 #include <cassert>
+#include <limits>
 
 using namespace std;
 
+#ifndef NO_GPSIM
+/// @return the document of the PIC component that the processor is of, if any
+static const CircuitDocument *processorDocument(const GpsimProcessor *cpu)
+{
+    const Component *component = qobject_cast<const Component *>(cpu->parent());
+    return component ? component->circuitDocument() : nullptr;
+}
+#endif
+
 // BEGIN class Simulator
 // Simulator *Simulator::m_pSelf = 0;
 // static K3StaticDeleter<Simulator> staticSimulatorDeleter;
@@ -50,32 +79,52 @@ Simulator *Simulator::self()
 
 Simulator::Simulator()
     : m_bIsSimulating(false)
-    , m_printTimingStatsTimer(nullptr)
+    , m_mutex(QMutex::Recursive)
+    , m_lockRequests(0)
+    , m_stimulusQueued(0)
+    , m_pThread(nullptr)
+    , m_bIdle(true)
     , m_stepMaxNs(0)
     , m_stepRollingAvgNs(0)
     , m_stepLastNs(0)
-    , m_stepsSinceStart(0)
-    , m_stepsSincePrint(0)
+    , m_statsTicks(0)
+    , m_statsStartStep(0)
+    , m_logicEvents(0)
+    , m_detachedGpsimCycles(0)
+    , m_speed(1.)
+    , m_stepBudget(0.)
+    , m_bFreeRunning(false)
+    , m_targetTime(-1)
+    , m_bTargetReached(false)
+    , m_targetStartStep(0)
+    , m_stepRateStartStep(0)
+    , m_stepRate(0.)
     , m_llNumber(0)
     , m_stepNumber(0)
     , m_currentChain(0)
+    , m_bBatchProcessorCycles(true)
 {
-    m_gpsimProcessors = new list<GpsimProcessor *>;
-    m_componentCallbacks = new list<ComponentCallback>;
-    m_components = new list<Component *>;
-    m_ordinaryCircuits = new list<Circuit *>;
-
-    // use integer math for these, update period is double.
-    unsigned max = unsigned(LOGIC_UPDATE_RATE / LINEAR_UPDATE_RATE);
+    m_pWorkerPool = nullptr;
+    m_pTelemetryStream = nullptr;
+    m_bParallelCircuitsDirty = true;
 
-    for (unsigned i = 0; i < max; i++) {
-        m_pStartStepCallback[i] = nullptr;
+    m_componentCallbacks = new std::vector<ComponentCallback>;
+    m_ordinaryCircuits = new list<Circuit *>;
+    m_heldDocumentCount = 0;
+    m_bRunningDirty = true;
+
+    // The heap keeps its storage when callbacks are taken off it, so after
+    // this there is only an allocation when more callbacks are waiting at
+    // once than ever before
+    m_scheduledCallbacks.reserve(SCHEDULED_CALLBACK_RESERVE);
+    m_scheduledCallbackOrder = 0;
+    m_processorOrder = 0;
+
+    for (unsigned i = 0; i < LOGIC_WHEEL_SIZE; i++) {
+        m_pLogicWheel[i] = nullptr;
+        m_pLogicWheelLast[i] = nullptr;
     }
-
-    LogicConfig lc;
-
-    m_pChangedLogicStart = new LogicOut(lc, false);
-    m_pChangedLogicLast = m_pChangedLogicStart;
+    m_logicWheelPos = 0;
 
     m_pChangedCircuitStart = new Circuit;
     m_pChangedCircuitLast = m_pChangedCircuitStart;
@@ -83,24 +132,23 @@ Simulator::Simulator()
     m_stepTimer = new QTimer(this);
     connect(m_stepTimer, &QTimer::timeout, this, &Simulator::step);
 
-    m_printTimingStatsTimer = new QTimer(this);
-    connect(m_printTimingStatsTimer, &QTimer::timeout, this, &Simulator::printTimingStatistics);
-    if (0) { // note: enable this when you want to debug the performance of the simulator; maybe turn it to run-time options
-        m_printTimingStatsTimer->start(1000);
-    }
+    m_statsTimer.start();
 
+    slotUpdateConfiguration();
     slotSetSimulating(true); // start the timer
 }
 
 Simulator::~Simulator()
 {
-    delete m_pChangedLogicStart;
+    delete m_pThread;
+
     delete m_pChangedCircuitStart;
 
-    delete m_gpsimProcessors;
-    delete m_components;
     delete m_componentCallbacks;
     delete m_ordinaryCircuits;
+    delete m_pWorkerPool;
+    delete m_pTelemetryStream;
+    qDeleteAll(m_documents);
 }
 
 long long Simulator::time() const
@@ -110,223 +158,1071 @@ long long Simulator::time() const
 
 void Simulator::step()
 {
-    if (!m_bIsSimulating)
-        return;
-
+    StallWatch::Region region("Simulator step");
     QElapsedTimer execTimer;
     execTimer.start();
 
-    // We are called a thousand times a second (the maximum allowed by QTimer),
-    // so divide the LINEAR_UPDATE_RATE by 1e3 for the number of loops we need
-    // to do.
-    const unsigned maxSteps = unsigned(LINEAR_UPDATE_RATE / SIMULATOR_STEP_INTERVAL_MS);
+    unsigned maxSteps;
+    qint64 maxNs = -1;
+    {
+        SimulationLocker locker(this);
+        if (!m_documents.isEmpty())
+            shareDocuments();
+
+        if (m_bFreeRunning) {
+            // As many steps as fit in the tick (leaving time for the GUI
+            // when it shares our thread)
+            maxSteps = std::numeric_limits<unsigned>::max();
+            maxNs = qint64(SIMULATOR_STEP_INTERVAL_MS) * 10000 * (m_pThread ? 100 : FREE_RUN_BUSY_PERCENT);
+        } else {
+            m_stepBudget += LINEAR_STEPS_PER_TICK * m_speed;
+            maxSteps = unsigned(m_stepBudget);
+            m_stepBudget -= maxSteps;
+        }
+    }
+
+    unsigned i = 0;
+    for (; i < maxSteps; ++i) {
+        if (maxNs >= 0 && (i % 16) == 0 && i > 0 && execTimer.nsecsElapsed() >= maxNs)
+            break;
+
+        // Let anyone waiting for the lock (i.e. the GUI thread, when we are
+        // running in our own thread) in between linear steps
+        while (m_lockRequests.loadAcquire() > 0)
+            QThread::yieldCurrentThread();
+
+        QMutexLocker locker(&m_mutex);
+        if (!m_bIsSimulating)
+            break;
+
+        if (m_targetTime >= 0 && m_stepNumber * LOGIC_UPDATE_PER_STEP >= m_targetTime) {
+            if (!m_bTargetReached) {
+                m_bTargetReached = true;
+                // Pause from the thread that owns the step timer
+                QMetaObject::invokeMethod(this, "slotSetSimulating", Qt::QueuedConnection, Q_ARG(bool, false));
+                emit targetTimeReached();
+            }
+            break;
+        }
 
-    for (unsigned i = 0; i < maxSteps; ++i) {
-        // here starts 1 linear step
-        m_stepNumber++;
+        if (isStimulusDue()) {
+            // The changes are made as the user makes them, from the GUI
+            // thread, which may need the lock; the rest of the tick is left
+            // until they have been
+            locker.unlock();
+            const bool applied = applyStimulus();
+            locker.relock();
+            if (!applied || !m_bIsSimulating)
+                break;
+        }
 
-        // Update the non-logic parts of the simulation
-        {
-            list<Component *>::iterator components_end = m_components->end();
+        stepLinear();
+    }
 
-            for (list<Component *>::iterator component = m_components->begin(); component != components_end; component++) {
-                (*component)->stepNonLogic();
+    if (i == 0)
+        return;
+
+    {
+        SimulationLocker locker(this);
+        const qint64 elapsedNs = execTimer.nsecsElapsed();
+        m_stepLastNs = elapsedNs;
+        if (elapsedNs > m_stepMaxNs) {
+            m_stepMaxNs = elapsedNs;
+        }
+        m_stepRollingAvgNs = 0.9 * m_stepRollingAvgNs + 0.1 * elapsedNs;
+        m_statsTicks++;
+
+        const qint64 rateElapsedMs = m_stepRateTimer.elapsed();
+        if (rateElapsedMs >= 1000) {
+            m_stepRate = (m_stepNumber - m_stepRateStartStep) * 1e3 / rateElapsedMs;
+            m_stepRateStartStep = m_stepNumber;
+            m_stepRateTimer.start();
+
+            for (DocumentSimulation *document : qAsConst(m_documents)) {
+                const long long steps = documentSteps(document);
+                document->realTimeRatio = double(steps - document->rateStartSteps) * 1e3 / rateElapsedMs / LINEAR_UPDATE_RATE;
+                document->rateStartSteps = steps;
             }
+
+            emit stepRateChanged(m_stepRate);
+        }
+    }
+}
+
+void Simulator::runSteps(long long steps)
+{
+    for (long long i = 0; i < steps; ++i) {
+        QMutexLocker locker(&m_mutex);
+        if (isStimulusDue()) {
+            locker.unlock();
+            applyStimulus();
+            locker.relock();
         }
+        stepLinear();
+    }
+}
 
-        {
-            list<Circuit *>::iterator circuits_end = m_ordinaryCircuits->end();
+bool Simulator::isStimulusDue() const
+{
+    if (!m_pStimulusPlayer)
+        return false;
+
+    const long long next = m_pStimulusPlayer->nextStep();
+    return next >= 0 && next <= m_stepNumber;
+}
+
+bool Simulator::applyStimulus()
+{
+    const long long step = m_stepNumber;
+
+    if (QThread::currentThread() == thread()) {
+        if (m_pStimulusPlayer)
+            m_pStimulusPlayer->applyDue(step);
+        return true;
+    }
+
+    // Not blocking on the GUI thread, which may be waiting in
+    // setRunInThread for this thread to finish. The player is looked at again
+    // from the GUI thread, as it may have been deleted there since; if the
+    // simulation has gone back to the GUI thread in the meantime, the changes
+    // have been made already and there is nothing left to do.
+    if (!m_stimulusQueued.testAndSetOrdered(0, 1))
+        return false;
+
+    QMetaObject::invokeMethod(
+        this,
+        [this, step]() {
+            if (m_pStimulusPlayer)
+                m_pStimulusPlayer->applyDue(step);
+            m_stimulusQueued.storeRelease(0);
+        },
+        Qt::QueuedConnection);
+    return false;
+}
+
+void Simulator::setStimulusPlayer(StimulusPlayer *player)
+{
+    {
+        SimulationLocker locker(this);
+        m_pStimulusPlayer = player;
+    }
+    updateIdle();
+}
+
+TelemetryStream *Simulator::telemetryStream()
+{
+    if (!m_pTelemetryStream)
+        m_pTelemetryStream = new TelemetryStream;
+    return m_pTelemetryStream;
+}
+
+// BEGIN Sharing the simulation between documents
+DocumentSimulation::DocumentSimulation(const CircuitDocument *document)
+    : document(document)
+    , paused(false)
+    , share(1.)
+    , credit(0.)
+    , held(false)
+    , heldSince(0)
+    , heldSteps(0)
+    , rateStartSteps(0)
+    , realTimeRatio(0.)
+{
+}
+
+DocumentSimulation *Simulator::documentSimulation(const CircuitDocument *document)
+{
+    DocumentSimulation *&simulation = m_documents[document];
+    if (!simulation) {
+        simulation = new DocumentSimulation(document);
+        // Only the steps from now on count
+        simulation->heldSteps = m_stepNumber;
+    }
+    return simulation;
+}
+
+void Simulator::setDocumentPaused(const CircuitDocument *document, bool paused)
+{
+    SimulationLocker locker(this);
+    DocumentSimulation *simulation = documentSimulation(document);
+    simulation->paused = paused;
+
+    // Carried on straight away, and then held in the ticks that are not
+    // its share
+    if (simulation->held != paused)
+        setDocumentHeld(simulation, paused);
+}
+
+bool Simulator::isDocumentPaused(const CircuitDocument *document) const
+{
+    const DocumentSimulation *simulation = m_documents.value(document);
+    return simulation && simulation->paused;
+}
+
+void Simulator::setDocumentShare(const CircuitDocument *document, double share)
+{
+    SimulationLocker locker(this);
+    DocumentSimulation *simulation = documentSimulation(document);
+    simulation->share = qBound(0., share, 1.);
+    if (simulation->share >= 1.)
+        simulation->credit = 0.;
+}
+
+double Simulator::documentRealTimeRatio(const CircuitDocument *document) const
+{
+    const DocumentSimulation *simulation = m_documents.value(document);
+    return simulation ? simulation->realTimeRatio : 0.;
+}
+
+void Simulator::removeDocument(const CircuitDocument *document)
+{
+    SimulationLocker locker(this);
+    DocumentSimulation *simulation = m_documents.take(document);
+    if (!simulation)
+        return;
+
+    if (simulation->held)
+        setDocumentHeld(simulation, false);
+    delete simulation;
+}
+
+void Simulator::shareDocuments()
+{
+    for (DocumentSimulation *document : qAsConst(m_documents)) {
+        bool run = !document->paused;
+        if (run && document->share < 1.) {
+            document->credit += document->share;
+            run = (document->credit >= 1.);
+            if (run)
+                document->credit -= 1.;
+        }
+
+        if (run == document->held)
+            setDocumentHeld(document, !run);
+    }
+}
+
+void Simulator::setDocumentHeld(DocumentSimulation *document, bool held)
+{
+    const CircuitDocument *circuitDocument = document->document;
+    document->held = held;
+    m_heldDocumentCount += held ? 1 : -1;
+    m_bRunningDirty = true;
+    m_bParallelCircuitsDirty = true;
+
+    if (held) {
+        document->heldSince = m_stepNumber;
+
+        // Waiting in the queues of the held documents would only hold up
+        // the rest
+        const std::vector<ScheduledCallback>::iterator callbacksEnd = std::partition(m_scheduledCallbacks.begin(), m_scheduledCallbacks.end(), [circuitDocument](const ScheduledCallback &scheduled) {
+            return scheduled.callback->component()->circuitDocument() != circuitDocument;
+        });
+        document->heldCallbacks.insert(document->heldCallbacks.end(), callbacksEnd, m_scheduledCallbacks.end());
+        m_scheduledCallbacks.erase(callbacksEnd, m_scheduledCallbacks.end());
+        std::make_heap(m_scheduledCallbacks.begin(), m_scheduledCallbacks.end(), std::greater<ScheduledCallback>());
+
+#ifndef NO_GPSIM
+        const std::vector<ScheduledProcessor>::iterator processorsEnd = std::partition(m_processorQueue.begin(), m_processorQueue.end(), [circuitDocument](const ScheduledProcessor &scheduled) {
+            return processorDocument(scheduled.processor) != circuitDocument;
+        });
+        document->heldProcessors.insert(document->heldProcessors.end(), processorsEnd, m_processorQueue.end());
+        m_processorQueue.erase(processorsEnd, m_processorQueue.end());
+        std::make_heap(m_processorQueue.begin(), m_processorQueue.end(), std::greater<ScheduledProcessor>());
+#endif
+        return;
+    }
 
-            for (list<Circuit *>::iterator circuit = m_ordinaryCircuits->begin(); circuit != circuits_end; circuit++) {
-                (*circuit)->doNonLogic();
+    const long long heldFor = m_stepNumber - document->heldSince;
+    document->heldSteps += heldFor;
+    const long long heldForUpdates = heldFor * LOGIC_UPDATE_PER_STEP;
+    const long long heldForFine = heldForUpdates * TIME_UNITS_PER_LOGIC_UPDATE;
+
+    QSet<Component *> resumed;
+    for (ScheduledCallback &scheduled : document->heldCallbacks) {
+        scheduled.time += heldForUpdates;
+        m_scheduledCallbacks.push_back(scheduled);
+        std::push_heap(m_scheduledCallbacks.begin(), m_scheduledCallbacks.end(), std::greater<ScheduledCallback>());
+        resumed.insert(scheduled.callback->component());
+    }
+    document->heldCallbacks.clear();
+
+    for (ScheduledProcessor &scheduled : document->heldProcessors) {
+        scheduled.time += heldForFine;
+        m_processorQueue.push_back(scheduled);
+        std::push_heap(m_processorQueue.begin(), m_processorQueue.end(), std::greater<ScheduledProcessor>());
+    }
+    document->heldProcessors.clear();
+
+    if (heldFor > 0) {
+        for (Component *component : qAsConst(resumed))
+            component->simulationResumed(heldForFine);
+    }
+}
+
+void Simulator::updateRunning()
+{
+    m_bRunningDirty = false;
+    m_bParallelCircuitsDirty = true;
+
+    m_runningCallbacks.clear();
+    for (const ComponentCallback &callback : *m_componentCallbacks) {
+        if (!heldDocument(callback.component()->circuitDocument()))
+            m_runningCallbacks.push_back(callback);
+    }
+
+    m_runningNonLogicComponents.clear();
+    m_runningNonLogicStepDividers.clear();
+    for (size_t i = 0; i < m_nonLogicComponents.size(); ++i) {
+        if (!heldDocument(m_nonLogicComponents[i]->circuitDocument())) {
+            m_runningNonLogicComponents.push_back(m_nonLogicComponents[i]);
+            m_runningNonLogicStepDividers.push_back(m_nonLogicStepDividers[i]);
+        }
+    }
+
+    m_runningCircuits.clear();
+    for (Circuit *circuit : *m_ordinaryCircuits) {
+        if (!heldDocument(m_circuitDocuments.value(circuit)))
+            m_runningCircuits.push_back(circuit);
+    }
+}
+// END Sharing the simulation between documents
+
+void Simulator::stepLinear()
+{
+    // here starts 1 linear step
+    m_stepNumber++;
+
+    // While documents are held, only the rest are stepped
+    if (m_heldDocumentCount && m_bRunningDirty)
+        updateRunning();
+    const bool held = m_heldDocumentCount;
+    const std::vector<Component *> &nonLogicComponents = held ? m_runningNonLogicComponents : m_nonLogicComponents;
+    const std::vector<int> &nonLogicStepDividers = held ? m_runningNonLogicStepDividers : m_nonLogicStepDividers;
+    std::vector<ComponentCallback> *componentCallbacks = held ? &m_runningCallbacks : m_componentCallbacks;
+    list<Circuit *> *circuits = held ? &m_runningCircuits : m_ordinaryCircuits;
+
+    // Update the non-logic parts of the simulation
+    {
+        const bool profile = Circuit::timingEnabled() && (m_stepNumber % PROFILE_SAMPLE_INTERVAL) == 0;
+        const size_t count = nonLogicComponents.size();
+        for (size_t i = 0; i < count; ++i) {
+            const int divider = nonLogicStepDividers[i];
+            if (divider != 1 && m_stepNumber % divider != 0)
+                continue;
+
+            if (!profile) {
+                nonLogicComponents[i]->stepNonLogic();
+                continue;
             }
+
+            QElapsedTimer timer;
+            timer.start();
+            nonLogicComponents[i]->stepNonLogic();
+            m_componentNs[nonLogicComponents[i]] += timer.nsecsElapsed() * PROFILE_SAMPLE_INTERVAL;
+        }
+    }
+
+    // Add up the brightness of the LEDs
+    {
+        const size_t count = m_brightnessDiodes.size();
+        for (size_t i = 0; i < count; ++i) {
+            if (const Diode *diode = m_brightnessDiodes[i])
+                m_brightnessSums[i] += LED::brightness(diode->current());
         }
+    }
+
+    if (m_bParallelCircuitsDirty)
+        updateParallelCircuits();
+
+    if (!m_parallelCircuits.empty()) {
+        // Solve the circuits in parallel, but pass the results on to the
+        // pins and logic in the same order as when solving serially
+        m_pWorkerPool->solveNonLogic(m_parallelCircuits, m_parallelBatchEnds);
+
+        list<Circuit *>::iterator circuits_end = circuits->end();
+
+        for (list<Circuit *>::iterator circuit = circuits->begin(); circuit != circuits_end; circuit++) {
+            (*circuit)->finishNonLogic();
+        }
+    } else {
+        list<Circuit *>::iterator circuits_end = circuits->end();
+
+        for (list<Circuit *>::iterator circuit = circuits->begin(); circuit != circuits_end; circuit++) {
+            (*circuit)->doNonLogic();
+        }
+    }
+
+    // Update the logic parts of our simulation
+    // const unsigned max = unsigned(LOGIC_UPDATE_RATE / LINEAR_UPDATE_RATE); // 2015.09.27 - use constants for logic updates
+
+    for (m_llNumber = 0; m_llNumber < LOGIC_UPDATE_PER_STEP; ++m_llNumber) {
+        // here starts 1 logic update
+        bool processorsExecuted = false;
+#ifndef NO_GPSIM
+        if (m_bBatchProcessorCycles && !m_gpsimProcessors.empty()) {
+            processorsExecuted = executeProcessorsAlone();
+            if (m_llNumber >= LOGIC_UPDATE_PER_STEP)
+                break;
+        }
+#endif
 
-        // Update the logic parts of our simulation
-        // const unsigned max = unsigned(LOGIC_UPDATE_RATE / LINEAR_UPDATE_RATE); // 2015.09.27 - use constants for logic updates
+        const long long now = m_stepNumber * LOGIC_UPDATE_PER_STEP + m_llNumber;
+        const bool profile = Circuit::timingEnabled() && (now % PROFILE_SAMPLE_INTERVAL) == 0;
 
-        for (m_llNumber = 0; m_llNumber < LOGIC_UPDATE_PER_STEP; ++m_llNumber) {
-            // here starts 1 logic update
-            // Update the logic components
-            {
-                list<ComponentCallback>::iterator callbacks_end = m_componentCallbacks->end();
+        // Update the logic components
+        {
+            std::vector<ComponentCallback>::iterator callbacks_end = componentCallbacks->end();
 
-                for (list<ComponentCallback>::iterator callback = m_componentCallbacks->begin(); callback != callbacks_end; callback++) {
+            if (profile) {
+                for (std::vector<ComponentCallback>::iterator callback = componentCallbacks->begin(); callback != callbacks_end; callback++)
+                    callProfiled(*callback);
+            } else {
+                for (std::vector<ComponentCallback>::iterator callback = componentCallbacks->begin(); callback != callbacks_end; callback++) {
                     callback->callback();
                 }
             }
+        }
 
-            if (m_pStartStepCallback[m_llNumber]) {
-                list<ComponentCallback *>::iterator callbacks_end = m_pStartStepCallback[m_llNumber]->end();
-
-                for (list<ComponentCallback *>::iterator callback = m_pStartStepCallback[m_llNumber]->begin(); callback != callbacks_end; callback++) {
-                    (*callback)->callback();
-                    // should we delete the list entry? no
+        // The callbacks may schedule themselves again, so take each off the
+        // heap before calling it
+        while (!m_scheduledCallbacks.empty() && m_scheduledCallbacks.front().time <= now) {
+            std::pop_heap(m_scheduledCallbacks.begin(), m_scheduledCallbacks.end(), std::greater<ScheduledCallback>());
+            ComponentCallback *callback = m_scheduledCallbacks.back().callback;
+            if (held) {
+                // Kept for when the document carries on
+                if (DocumentSimulation *document = heldDocument(callback->component()->circuitDocument())) {
+                    document->heldCallbacks.push_back(m_scheduledCallbacks.back());
+                    m_scheduledCallbacks.pop_back();
+                    continue;
                 }
             }
+            m_scheduledCallbacks.pop_back();
+            if (profile)
+                callProfiled(*callback);
+            else
+                callback->callback();
+        }
+
+#ifndef NO_GPSIM
+        // Update the gpsim processors
+        if (!processorsExecuted)
+            executeProcessors();
+#else
+        Q_UNUSED(processorsExecuted);
+#endif
+
+        // why do we change this here instead of later?
+        int prevChain = m_currentChain;
+        m_currentChain ^= 1;
+
+        // Update the non-logic circuits
+        if (Circuit *changed = m_pChangedCircuitStart->nextChanged(prevChain)) {
+            QSet<Circuit *> canAddChangedSet;
+            for (Circuit *circuit = changed; circuit && (!canAddChangedSet.contains(circuit)); circuit = circuit->nextChanged(prevChain)) {
+                circuit->setCanAddChanged(true);
+                canAddChangedSet.insert(circuit);
+            }
+
+            m_pChangedCircuitStart->setNextChanged(nullptr, prevChain);
+            m_pChangedCircuitLast = m_pChangedCircuitStart;
+
+            do {
+                Circuit *next = changed->nextChanged(prevChain);
+                changed->setNextChanged(nullptr, prevChain);
+                changed->doLogic();
+                changed = next;
+            } while (changed);
+        }
+
+        // Call the logic callbacks
+        passOnChangedLogic();
+    }
 
-            delete m_pStartStepCallback[m_llNumber];
-            m_pStartStepCallback[m_llNumber] = nullptr;
+    if (m_pTelemetryStream && m_pTelemetryStream->isPublishing())
+        m_pTelemetryStream->publish(time());
+}
 
 #ifndef NO_GPSIM
-            // Update the gpsim processors
-            {
-                list<GpsimProcessor *>::iterator processors_end = m_gpsimProcessors->end();
+bool Simulator::isLogicUpdateIdle() const
+{
+    if (!(m_heldDocumentCount ? m_runningCallbacks : *m_componentCallbacks).empty())
+        return false;
 
-                for (list<GpsimProcessor *>::iterator processor = m_gpsimProcessors->begin(); processor != processors_end; processor++) {
-                    (*processor)->executeNext();
-                }
+    const long long now = m_stepNumber * LOGIC_UPDATE_PER_STEP + m_llNumber;
+    if (!m_scheduledCallbacks.empty() && m_scheduledCallbacks.front().time <= now)
+        return false;
+
+    if (m_pChangedCircuitStart->nextChanged(m_currentChain) || m_pLogicWheel[m_logicWheelPos])
+        return false;
+
+    for (std::vector<LogicNetlist *>::const_iterator it = m_logicNetlists.begin(); it != m_logicNetlists.end(); ++it) {
+        if ((*it)->isDirty())
+            return false;
+    }
+
+    return true;
+}
+
+bool Simulator::executeProcessorsAlone()
+{
+    while (m_llNumber < LOGIC_UPDATE_PER_STEP && isLogicUpdateIdle()) {
+        executeProcessors();
+
+        // A pin of a processor changed, so the rest of the logic update has
+        // to be done as usual
+        if (!isLogicUpdateIdle())
+            return true;
+
+        // What the rest of the logic update would have done with nothing
+        // changed
+        m_currentChain ^= 1;
+        m_logicWheelPos = (m_logicWheelPos + 1) & (LOGIC_WHEEL_SIZE - 1);
+        ++m_llNumber;
+    }
+
+    return false;
+}
+
+void Simulator::executeProcessors()
+{
+    const long long end = fineTime() + TIME_UNITS_PER_LOGIC_UPDATE;
+    const bool profile = Circuit::timingEnabled() && (time() % PROFILE_SAMPLE_INTERVAL) == 0;
+
+    // At the default clock, each processor is due once per logic update
+    while (!m_processorQueue.empty() && m_processorQueue.front().time < end) {
+        std::pop_heap(m_processorQueue.begin(), m_processorQueue.end(), std::greater<ScheduledProcessor>());
+        ScheduledProcessor &next = m_processorQueue.back();
+
+        if (m_heldDocumentCount) {
+            // Kept for when the document carries on
+            if (DocumentSimulation *document = heldDocument(processorDocument(next.processor))) {
+                document->heldProcessors.push_back(next);
+                m_processorQueue.pop_back();
+                continue;
             }
+        }
+
+        if (profile) {
+            QElapsedTimer timer;
+            timer.start();
+            next.processor->executeNext();
+            m_processorNs[next.processor] += timer.nsecsElapsed() * PROFILE_SAMPLE_INTERVAL;
+        } else
+            next.processor->executeNext();
+
+        next.time += next.processor->cyclePeriod();
+        std::push_heap(m_processorQueue.begin(), m_processorQueue.end(), std::greater<ScheduledProcessor>());
+    }
+}
 #endif
 
-            // why do we change this here instead of later?
-            int prevChain = m_currentChain;
-            m_currentChain ^= 1;
+void Simulator::callProfiled(ComponentCallback &callback)
+{
+    QElapsedTimer timer;
+    timer.start();
+    callback.callback();
+    m_componentNs[callback.component()] += timer.nsecsElapsed() * PROFILE_SAMPLE_INTERVAL;
+}
 
-            // Update the non-logic circuits
-            if (Circuit *changed = m_pChangedCircuitStart->nextChanged(prevChain)) {
-                QSet<Circuit *> canAddChangedSet;
-                for (Circuit *circuit = changed; circuit && (!canAddChangedSet.contains(circuit)); circuit = circuit->nextChanged(prevChain)) {
-                    circuit->setCanAddChanged(true);
-                    canAddChangedSet.insert(circuit);
-                }
+void Simulator::passOnChangedLogic()
+{
+    const unsigned slot = m_logicWheelPos;
+
+    // Outputs without a delay that change from the callbacks are added to
+    // the same slot again, so that a path of gates settles at once
+    for (int delta = 0; delta < LOGIC_MAX_DELTAS; ++delta) {
+        // The compiled gates go first, as their outputs are added to the slot
+        for (std::vector<LogicNetlist *>::const_iterator it = m_logicNetlists.begin(); it != m_logicNetlists.end(); ++it) {
+            if ((*it)->isDirty())
+                (*it)->evaluate();
+        }
 
-                m_pChangedCircuitStart->setNextChanged(nullptr, prevChain);
-                m_pChangedCircuitLast = m_pChangedCircuitStart;
+        LogicOut *changed = m_pLogicWheel[slot];
+        if (!changed)
+            break;
 
-                do {
-                    Circuit *next = changed->nextChanged(prevChain);
-                    changed->setNextChanged(nullptr, prevChain);
-                    changed->doLogic();
-                    changed = next;
-                } while (changed);
-            }
+        m_pLogicWheel[slot] = m_pLogicWheelLast[slot] = nullptr;
+
+        do {
+            LogicOut *next = changed->nextChanged();
+            changed->setNextChanged(nullptr);
+            changed->setCanAddChanged(true);
 
-            // Call the logic callbacks
-            if (LogicOut *changed = m_pChangedLogicStart->nextChanged(prevChain)) {
-                for (LogicOut *out = changed; out; out = out->nextChanged(prevChain))
-                    out->setCanAddChanged(true);
+            // Skip the outputs that changed back before anything saw them
+            if (changed->takeScheduledState()) {
+                m_logicEvents++;
 
-                m_pChangedLogicStart->setNextChanged(nullptr, prevChain);
-                m_pChangedLogicLast = m_pChangedLogicStart;
+                double v = changed->isHigh() ? changed->outputHighVoltage() : 0.0;
 
-                do {
-                    LogicOut *next = changed->nextChanged(prevChain);
-                    changed->setNextChanged(nullptr, prevChain);
+                for (PinList::iterator it = changed->pinListBegin; it != changed->pinListEnd; ++it) {
+                    if (Pin *pin = *it)
+                        pin->setVoltage(v);
+                }
 
-                    double v = changed->isHigh() ? changed->outputHighVoltage() : 0.0;
+                changed->callChainCallbacks();
+            }
 
-                    for (PinList::iterator it = changed->pinListBegin; it != changed->pinListEnd; ++it) {
-                        if (Pin *pin = *it)
-                            pin->setVoltage(v);
-                    }
+            changed = next;
+        } while (changed);
+    }
 
-                    LogicIn *logicCallback = changed;
+    const unsigned nextSlot = (slot + 1) & (LOGIC_WHEEL_SIZE - 1);
+    if (LogicOut *unsettled = m_pLogicWheel[slot]) {
+        if (m_pLogicWheelLast[nextSlot])
+            m_pLogicWheelLast[nextSlot]->setNextChanged(unsettled);
+        else
+            m_pLogicWheel[nextSlot] = unsettled;
+        m_pLogicWheelLast[nextSlot] = m_pLogicWheelLast[slot];
+        m_pLogicWheel[slot] = m_pLogicWheelLast[slot] = nullptr;
+    }
+    m_logicWheelPos = nextSlot;
+}
 
-                    while (logicCallback) {
-                        logicCallback->callCallback();
-                        logicCallback = logicCallback->nextLogic();
-                    }
+void Simulator::slotSetSimulating(bool simulate)
+{
+    if (m_bIsSimulating == simulate)
+        return;
 
-                    changed = next;
-                } while (changed);
+    {
+        SimulationLocker locker(this);
+        m_bIsSimulating = simulate;
+
+        if (simulate) {
+            // Carry on past a target we have stopped at
+            if (m_bTargetReached) {
+                m_targetTime = -1;
+                m_bTargetReached = false;
             }
+            m_stepRateStartStep = m_stepNumber;
+            m_stepRateTimer.start();
+            for (DocumentSimulation *document : qAsConst(m_documents))
+                document->rateStartSteps = documentSteps(document);
         }
     }
+    updateStepTimers();
+    emit simulatingStateChanged(simulate);
+}
 
+void Simulator::slotUpdateConfiguration()
+{
+    setSolverThreadCount(KTLConfig::simulationThreads());
+    setRunInThread(KTLConfig::simulateInThread());
+    setBatchProcessorCycles(KTLConfig::batchProcessorCycles());
     {
-        const qint64 elapsedNs = execTimer.nsecsElapsed();
-        m_stepLastNs = elapsedNs;
-        if (elapsedNs > m_stepMaxNs) {
-            m_stepMaxNs = elapsedNs;
-        }
-        m_stepRollingAvgNs = 0.9 * m_stepRollingAvgNs + 0.1 * elapsedNs;
-        m_stepsSinceStart++;
-        m_stepsSincePrint++;
+        SimulationLocker locker(this);
+        LogicOut::setIdealLogic(KTLConfig::idealLogic());
     }
+    Matrix::setRefactorInterval(KTLConfig::refactorInterval());
+    Matrix::setMixedPrecision(KTLConfig::mixedPrecisionLU());
+    NgspiceCircuit::setLibrary(KTLConfig::ngspiceLibrary());
+    NgspiceCircuit::setMinEquations(KTLConfig::ngspiceMinEquations());
 }
 
-void Simulator::printTimingStatistics() {
-    qCDebug(KTL_LOG) << "Simulator::printTimingStatistics"
-        << "m_stepMaxNs=" << m_stepMaxNs
-        << "m_stepRollingAvgNs=" << m_stepRollingAvgNs
-        << "m_stepLastNs=" << m_stepLastNs
-        << "m_stepsSinceStart=" << m_stepsSinceStart
-        << "m_stepsSincePrint=" << m_stepsSincePrint;
-    m_stepsSincePrint = 0;
+void Simulator::setBatchProcessorCycles(bool batch)
+{
+    SimulationLocker locker(this);
+    m_bBatchProcessorCycles = batch;
 }
 
-void Simulator::slotSetSimulating(bool simulate)
+void Simulator::setRunInThread(bool runInThread)
 {
-    if (m_bIsSimulating == simulate)
+    if (runInThread == runsInThread())
         return;
 
-    if (simulate) {
-        m_stepTimer->start(SIMULATOR_STEP_INTERVAL_MS);
-    } else {
+    if (runInThread) {
         m_stepTimer->stop();
+        m_pThread = new SimulatorThread(this);
+        m_pThread->start();
+    } else {
+        delete m_pThread;
+        m_pThread = nullptr;
     }
+    updateStepTimers();
+}
 
-    m_bIsSimulating = simulate;
-    emit simulatingStateChanged(simulate);
+void Simulator::updateIdle()
+{
+    SimulationLocker locker(this);
+
+    const bool idle = m_ordinaryCircuits->empty() && m_componentCallbacks->empty() && m_scheduledCallbacks.empty() && m_gpsimProcessors.empty() && m_nonLogicComponents.empty() && m_logicNetlists.empty() && m_logicChainStarts.isEmpty() && !m_pStimulusPlayer;
+    if (idle == m_bIdle)
+        return;
+
+    m_bIdle = idle;
+
+    // This may be called with the simulation locked, and from the thread of
+    // the simulation, so the timers are seen to from the event loop of the
+    // thread that owns them
+    QMetaObject::invokeMethod(this, &Simulator::updateStepTimers, Qt::QueuedConnection);
 }
 
-void Simulator::createLogicChain(LogicOut *logicOut, const LogicInList &logicInList, const PinList &pinList)
+void Simulator::updateStepTimers()
 {
-    if (!logicOut)
+    const bool stepping = m_bIsSimulating && !m_bIdle;
+
+    if (m_pThread)
+        m_pThread->setStepping(stepping);
+    else if (!stepping)
+        m_stepTimer->stop();
+    else if (!m_stepTimer->isActive())
+        m_stepTimer->start(SIMULATOR_STEP_INTERVAL_MS);
+}
+
+void Simulator::setSpeed(double multiplier)
+{
+    if (multiplier <= 0.)
         return;
 
-    bool state = logicOut->outputState();
+    SimulationLocker locker(this);
+    m_speed = multiplier;
+    m_stepBudget = 0.;
+}
 
-    logicOut->setUseLogicChain(true);
-    logicOut->pinList = pinList;
-    logicOut->pinListBegin = logicOut->pinList.begin();
-    logicOut->pinListEnd = logicOut->pinList.end();
+void Simulator::setFreeRunning(bool freeRunning)
+{
+    SimulationLocker locker(this);
+    m_bFreeRunning = freeRunning;
+}
+
+void Simulator::setTargetTime(long long time)
+{
+    SimulationLocker locker(this);
+    m_targetTime = time;
+    m_bTargetReached = false;
+    m_targetStartStep = m_stepNumber;
+    m_targetTimer.start();
+}
+
+double Simulator::targetStepRate() const
+{
+    const qint64 elapsedMs = m_targetTimer.isValid() ? m_targetTimer.elapsed() : 0;
+    if (elapsedMs <= 0)
+        return 0.;
 
-    LogicIn *last = logicOut;
+    return (m_stepNumber - m_targetStartStep) * 1e3 / elapsedMs;
+}
 
-    const LogicInList::const_iterator end = logicInList.end();
+/**
+ * @return the ids of the components that the circuit's pins belong to, for
+ * telling circuits apart in the statistics.
+ */
+static QString circuitDescription(const Circuit *circuit)
+{
+    // Only the first few, as a circuit can take in a whole document
+    const int maxIds = 4;
+
+    QStringList ids;
+    const PinList &pins = circuit->pins();
+    for (PinList::const_iterator it = pins.begin(); it != pins.end(); ++it) {
+        Pin *pin = *it;
+        ECNode *node = pin ? pin->parentECNode() : nullptr;
+        CNItem *item = node ? node->parentItem() : nullptr;
+        if (item && !ids.contains(item->id()))
+            ids << item->id();
+    }
 
-    for (LogicInList::const_iterator it = logicInList.begin(); it != end; ++it) {
-        LogicIn *next = *it;
-        last->setNextLogic(next);
-        last->setLastState(state);
-        last = next;
+    ids.sort();
+    const int total = ids.size();
+    if (total > maxIds) {
+        ids = ids.mid(0, maxIds);
+        ids << i18n("and %1 more", total - maxIds);
     }
+    return ids.join(", ");
+}
+
+SimulatorStatistics Simulator::statistics()
+{
+    SimulationLocker locker(this);
+
+    SimulatorStatistics statistics;
+    statistics.elapsedNs = m_statsTimer.nsecsElapsed();
+    statistics.steps = m_stepNumber - m_statsStartStep;
+    statistics.ticks = m_statsTicks;
+    statistics.tickLastNs = m_stepLastNs;
+    statistics.tickMaxNs = m_stepMaxNs;
+    statistics.tickAverageNs = m_stepRollingAvgNs;
+    statistics.logicEvents = m_logicEvents;
+    statistics.timingEnabled = Circuit::timingEnabled();
+
+    statistics.gpsimCycles = m_detachedGpsimCycles;
+#ifndef NO_GPSIM
+    for (GpsimProcessor *processor : m_gpsimProcessors)
+        statistics.gpsimCycles += processor->cyclesExecuted();
+#endif
 
-    last->setNextLogic(nullptr);
-    last->setLastState(state);
+    const list<Circuit *>::iterator circuits_end = m_ordinaryCircuits->end();
+    for (list<Circuit *>::iterator it = m_ordinaryCircuits->begin(); it != circuits_end; ++it) {
+        const Circuit *circuit = *it;
+
+        CircuitStatistics c;
+        c.description = circuitDescription(circuit);
+        c.equations = circuit->equationCount();
+        c.sparse = circuit->usesSparseSolver();
+        c.banded = circuit->usesBandedSolver();
+        c.luCache = circuit->usesLUCache();
+        c.logicCache = circuit->usesLogicCache();
+        c.choosingStrategy = circuit->isChoosingStrategy();
+        c.nonLinear = circuit->containsNonLinear();
+        c.parked = circuit->isParked();
+        c.stats = circuit->stats();
+        c.nonLinearStats = circuit->nonLinearStats();
+        c.factorizations = circuit->factorizationCount();
+        c.restoredFactorizations = circuit->restoredFactorizationCount();
+        c.factorizationNs = circuit->factorizationNs();
+        statistics.circuits.push_back(c);
+    }
 
-    // Mark it as changed, if it isn't already changed...
-    LogicOut *changed = m_pChangedLogicStart->nextChanged(m_currentChain);
+    if (statistics.timingEnabled)
+        componentStatistics(&statistics.components);
 
-    while (changed) {
-        if (changed == logicOut)
-            return;
+    return statistics;
+}
 
-        changed = changed->nextChanged(m_currentChain);
+void Simulator::componentStatistics(std::vector<ComponentStatistics> *statistics) const
+{
+    QHash<const Component *, ComponentStatistics> components;
+    auto add = [&components](const Component *component) -> ComponentStatistics & {
+        QHash<const Component *, ComponentStatistics>::iterator it = components.find(component);
+        if (it == components.end())
+            it = components.insert(component, ComponentStatistics {component, component->id(), 0, 0, 0});
+        return *it;
+    };
+
+    for (QHash<const Component *, qint64>::const_iterator it = m_componentNs.begin(); it != m_componentNs.end(); ++it)
+        add(it.key()).callbackNs += it.value();
+
+#ifndef NO_GPSIM
+    // The processors of PICComponents belong to them
+    for (QHash<const GpsimProcessor *, qint64>::const_iterator it = m_processorNs.begin(); it != m_processorNs.end(); ++it) {
+        if (const Component *component = qobject_cast<const Component *>(it.key()->parent()))
+            add(component).processorNs += it.value();
+    }
+#endif
+
+    const list<Circuit *>::const_iterator circuits_end = m_ordinaryCircuits->end();
+    for (list<Circuit *>::const_iterator it = m_ordinaryCircuits->begin(); it != circuits_end; ++it) {
+        const Circuit *circuit = *it;
+        const qint64 solveNs = circuit->stats().solveNs;
+        if (solveNs == 0)
+            continue;
+
+        QSet<const Component *> circuitComponents;
+        const PinList &pins = circuit->pins();
+        for (PinList::const_iterator pin = pins.begin(); pin != pins.end(); ++pin) {
+            ECNode *node = *pin ? (*pin)->parentECNode() : nullptr;
+            if (const Component *component = node ? dynamic_cast<const Component *>(node->parentItem()) : nullptr)
+                circuitComponents.insert(component);
+        }
+
+        if (circuitComponents.isEmpty())
+            continue;
+
+        const qint64 share = solveNs / circuitComponents.size();
+        for (QSet<const Component *>::const_iterator component = circuitComponents.begin(); component != circuitComponents.end(); ++component)
+            add(*component).circuitNs += share;
     }
 
-    addChangedLogic(logicOut);
-    logicOut->setCanAddChanged(false);
+    statistics->assign(components.begin(), components.end());
+    std::stable_sort(statistics->begin(), statistics->end(), [](const ComponentStatistics &a, const ComponentStatistics &b) {
+        return a.totalNs() > b.totalNs();
+    });
+}
+
+void Simulator::resetStatistics()
+{
+    SimulationLocker locker(this);
+
+    m_stepMaxNs = 0;
+    m_stepRollingAvgNs = 0;
+    m_stepLastNs = 0;
+    m_statsTicks = 0;
+    m_statsStartStep = m_stepNumber;
+    m_logicEvents = 0;
+    m_detachedGpsimCycles = 0;
+    m_componentNs.clear();
+    m_processorNs.clear();
+    m_statsTimer.start();
+
+#ifndef NO_GPSIM
+    for (GpsimProcessor *processor : m_gpsimProcessors)
+        processor->resetCyclesExecuted();
+#endif
+
+    const list<Circuit *>::iterator circuits_end = m_ordinaryCircuits->end();
+    for (list<Circuit *>::iterator circuit = m_ordinaryCircuits->begin(); circuit != circuits_end; ++circuit)
+        (*circuit)->resetStats();
+}
+
+void Simulator::setTimingEnabled(bool enabled)
+{
+    SimulationLocker locker(this);
+    Circuit::setTimingEnabled(enabled);
+}
+
+void Simulator::lock()
+{
+    m_lockRequests.ref();
+    m_mutex.lock();
+    m_lockRequests.deref();
+}
+
+void Simulator::unlock()
+{
+    m_mutex.unlock();
+}
+
+void Simulator::setSolverThreadCount(int count)
+{
+    if (count == 0)
+        count = QThread::idealThreadCount();
+
+    // The simulator thread also takes part in solving
+    const int workers = std::max(count, 1) - 1;
+
+    if (workers == (m_pWorkerPool ? m_pWorkerPool->threadCount() : 0))
+        return;
+
+    SimulationLocker locker(this);
+    delete m_pWorkerPool;
+    m_pWorkerPool = (workers > 0) ? new CircuitWorkerPool(workers) : nullptr;
+    m_bParallelCircuitsDirty = true;
+}
+
+int Simulator::solverThreadCount() const
+{
+    return m_pWorkerPool ? m_pWorkerPool->threadCount() + 1 : 1;
+}
+
+void Simulator::updateParallelCircuits()
+{
+    m_bParallelCircuitsDirty = false;
+    m_parallelCircuits.clear();
+    m_parallelBatchEnds.clear();
+
+    if (!m_pWorkerPool)
+        return;
+
+    list<Circuit *> *circuits = m_heldDocumentCount ? &m_runningCircuits : m_ordinaryCircuits;
+
+    // Large circuits are solved on their own, and the small circuits of each
+    // document together, so that documents made of many small circuits (such
+    // as the boards of a lab setup) are still solved in parallel
+    std::vector<std::vector<Circuit *>> batches;
+    std::vector<int> batchEquations;
+    QHash<const CircuitDocument *, int> documentBatches;
+    const list<Circuit *>::iterator circuits_end = circuits->end();
+    for (list<Circuit *>::iterator circuit = circuits->begin(); circuit != circuits_end; ++circuit) {
+        int batch;
+        if ((*circuit)->equationCount() >= PARALLEL_MIN_EQUATIONS) {
+            batch = batches.size();
+        } else {
+            const CircuitDocument *document = m_circuitDocuments.value(*circuit);
+            batch = documentBatches.value(document, -1);
+            if (batch == -1) {
+                batch = batches.size();
+                documentBatches.insert(document, batch);
+            }
+        }
+
+        if (batch == int(batches.size())) {
+            batches.emplace_back();
+            batchEquations.push_back(0);
+        }
+        batches[batch].push_back(*circuit);
+        batchEquations[batch] += (*circuit)->equationCount();
+    }
+
+    const int largeBatches = std::count_if(batchEquations.begin(), batchEquations.end(), [](int equations) {
+        return equations >= PARALLEL_MIN_EQUATIONS;
+    });
+    if (largeBatches < 2)
+        return;
+
+    std::vector<int> order(batches.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&batchEquations](int a, int b) {
+        return batchEquations[a] > batchEquations[b];
+    });
+
+    for (int batch : order) {
+        m_parallelCircuits.insert(m_parallelCircuits.end(), batches[batch].begin(), batches[batch].end());
+        m_parallelBatchEnds.push_back(m_parallelCircuits.size());
+    }
+}
+
+void Simulator::createLogicChain(LogicOut *logicOut, const LogicInList &logicInList, const PinList &pinList)
+{
+    SimulationLocker locker(this);
+    if (!logicOut)
+        return;
+
+    logicOut->setUseLogicChain(true);
+    logicOut->pinList = pinList;
+    logicOut->pinListBegin = logicOut->pinList.begin();
+    logicOut->pinListEnd = logicOut->pinList.end();
+    logicOut->setFanOut(logicInList);
 
     if (!m_logicChainStarts.contains(logicOut))
         m_logicChainStarts << logicOut;
+
+    // Pass the state on to the new chain, scheduling it if it isn't already
+    logicOut->resetPassedOnState();
+    if (logicOut->canAddChanged()) {
+        addChangedLogic(logicOut);
+        logicOut->setCanAddChanged(false);
+    }
+
+    updateIdle();
 }
 
 void Simulator::attachGpsimProcessor(GpsimProcessor *cpu)
 {
-    m_gpsimProcessors->push_back(cpu);
+    SimulationLocker locker(this);
+    if (std::find(m_gpsimProcessors.begin(), m_gpsimProcessors.end(), cpu) != m_gpsimProcessors.end())
+        return;
+
+    m_gpsimProcessors.push_back(cpu);
+    m_processorQueue.push_back(ScheduledProcessor{fineTime(), m_processorOrder++, cpu});
+    std::push_heap(m_processorQueue.begin(), m_processorQueue.end(), std::greater<ScheduledProcessor>());
+
+    updateIdle();
 }
 
 void Simulator::detachGpsimProcessor(GpsimProcessor *cpu)
 {
-    m_gpsimProcessors->remove(cpu);
+    SimulationLocker locker(this);
+    const std::vector<GpsimProcessor *>::iterator it = std::find(m_gpsimProcessors.begin(), m_gpsimProcessors.end(), cpu);
+    if (it == m_gpsimProcessors.end())
+        return;
+
+#ifndef NO_GPSIM
+    m_detachedGpsimCycles += cpu->cyclesExecuted();
+#endif
+    m_gpsimProcessors.erase(it);
+    m_processorQueue.erase(std::remove_if(m_processorQueue.begin(), m_processorQueue.end(), [cpu](const ScheduledProcessor &scheduled) {
+        return scheduled.processor == cpu;
+    }), m_processorQueue.end());
+    std::make_heap(m_processorQueue.begin(), m_processorQueue.end(), std::greater<ScheduledProcessor>());
+    for (DocumentSimulation *document : qAsConst(m_documents)) {
+        std::vector<ScheduledProcessor> &held = document->heldProcessors;
+        held.erase(std::remove_if(held.begin(), held.end(), [cpu](const ScheduledProcessor &scheduled) {
+            return scheduled.processor == cpu;
+        }), held.end());
+    }
+    m_processorNs.remove(cpu);
+
+    updateIdle();
 }
 
 void Simulator::attachComponentCallback(Component *component, VoidCallbackPtr function)
 {
+    SimulationLocker locker(this);
     m_componentCallbacks->push_back(ComponentCallback(component, function));
+    m_bRunningDirty = true;
+
+    updateIdle();
 }
 
 void Simulator::attachComponent(Component *component)
@@ -334,86 +1230,171 @@ void Simulator::attachComponent(Component *component)
     if (!component || !component->doesStepNonLogic())
         return;
 
-    m_components->push_back(component);
+    SimulationLocker locker(this);
+
+    if (std::find(m_nonLogicComponents.begin(), m_nonLogicComponents.end(), component) != m_nonLogicComponents.end())
+        return;
+
+    m_nonLogicComponents.push_back(component);
+    m_nonLogicStepDividers.push_back(std::max(1, component->nonLogicStepDivider()));
+    m_bRunningDirty = true;
+
+    updateIdle();
 }
 
 void Simulator::detachComponent(Component *component)
 {
-    m_components->remove(component);
+    SimulationLocker locker(this);
+
+    const std::vector<Component *>::iterator it = std::find(m_nonLogicComponents.begin(), m_nonLogicComponents.end(), component);
+    if (it != m_nonLogicComponents.end()) {
+        m_nonLogicStepDividers.erase(m_nonLogicStepDividers.begin() + (it - m_nonLogicComponents.begin()));
+        m_nonLogicComponents.erase(it);
+        m_bRunningDirty = true;
+    }
+
     detachComponentCallbacks(*component);
 }
 
-static Component *compx;
+int Simulator::attachDiodeBrightness(Diode *diode)
+{
+    SimulationLocker locker(this);
+
+    int handle;
+    if (m_freeBrightnessHandles.empty()) {
+        handle = int(m_brightnessDiodes.size());
+        m_brightnessDiodes.push_back(diode);
+        m_brightnessSums.push_back(0.);
+        m_brightnessStartSteps.push_back(m_stepNumber);
+    } else {
+        handle = m_freeBrightnessHandles.back();
+        m_freeBrightnessHandles.pop_back();
+        m_brightnessDiodes[handle] = diode;
+        restartDiodeBrightness(handle);
+    }
+
+    return handle;
+}
 
-bool pred1(ComponentCallback &x)
+void Simulator::detachDiodeBrightness(int handle)
 {
-    return x.component() == compx;
+    SimulationLocker locker(this);
+    m_brightnessDiodes[handle] = nullptr;
+    m_freeBrightnessHandles.push_back(handle);
 }
 
 void Simulator::detachComponentCallbacks(Component &component)
 {
-    compx = &component;
-    m_componentCallbacks->remove_if(pred1);
+    SimulationLocker locker(this);
+
+    m_componentNs.remove(&component);
+
+    m_componentCallbacks->erase(std::remove_if(m_componentCallbacks->begin(), m_componentCallbacks->end(), [&component](const ComponentCallback &callback) {
+                                    return callback.component() == &component;
+                                }),
+                                m_componentCallbacks->end());
+    m_bRunningDirty = true;
+
+    if (DocumentSimulation *document = m_documents.value(component.circuitDocument())) {
+        std::vector<ScheduledCallback> &held = document->heldCallbacks;
+        held.erase(std::remove_if(held.begin(), held.end(), [&component](const ScheduledCallback &scheduled) {
+            return scheduled.callback->component() == &component;
+        }), held.end());
+    }
+
+    const std::vector<ScheduledCallback>::iterator scheduledEnd = std::remove_if(m_scheduledCallbacks.begin(), m_scheduledCallbacks.end(), [&component](const ScheduledCallback &scheduled) {
+        return scheduled.callback->component() == &component;
+    });
+    if (scheduledEnd != m_scheduledCallbacks.end()) {
+        m_scheduledCallbacks.erase(scheduledEnd, m_scheduledCallbacks.end());
+        std::make_heap(m_scheduledCallbacks.begin(), m_scheduledCallbacks.end(), std::greater<ScheduledCallback>());
+    }
+
+    updateIdle();
 }
 
-void Simulator::attachCircuit(Circuit *circuit)
+void Simulator::attachCircuit(Circuit *circuit, const CircuitDocument *document)
 {
     if (!circuit)
         return;
 
+    SimulationLocker locker(this);
+
     m_ordinaryCircuits->push_back(circuit);
+    if (document)
+        m_circuitDocuments.insert(circuit, document);
+    m_bParallelCircuitsDirty = true;
+    m_bRunningDirty = true;
 
     //	if ( circuit->canAddChanged() ) {
     addChangedCircuit(circuit);
     circuit->setCanAddChanged(false);
     //	}
+
+    updateIdle();
 }
 
-void Simulator::removeLogicInReferences(LogicIn *logicIn)
+void Simulator::attachLogicNetlist(LogicNetlist *netlist)
 {
-    if (!logicIn)
+    if (!netlist)
         return;
 
-    QList<LogicOut *>::iterator end = m_logicChainStarts.end();
+    SimulationLocker locker(this);
+    m_logicNetlists.push_back(netlist);
 
-    for (QList<LogicOut *>::iterator it = m_logicChainStarts.begin(); it != end; ++it) {
-        LogicIn *logicCallback = *it;
+    updateIdle();
+}
 
-        while (logicCallback) {
-            if (logicCallback->nextLogic() == logicIn)
-                logicCallback->setNextLogic(logicCallback->nextLogic()->nextLogic());
+void Simulator::detachLogicNetlist(LogicNetlist *netlist)
+{
+    SimulationLocker locker(this);
+    m_logicNetlists.erase(std::remove(m_logicNetlists.begin(), m_logicNetlists.end(), netlist), m_logicNetlists.end());
 
-            logicCallback = logicCallback->nextLogic();
-        }
-    }
+    updateIdle();
+}
+
+void Simulator::removeLogicInReferences(LogicIn *logicIn)
+{
+    if (!logicIn)
+        return;
+
+    SimulationLocker locker(this);
+    logicIn->removeFromLogicChain();
 }
 
 void Simulator::removeLogicOutReferences(LogicOut *logic)
 {
+    SimulationLocker locker(this);
+    logic->clearFanOut();
     m_logicChainStarts.removeAll(logic);
+    removeChangedLogic(logic);
 
-    // Any changes to the code below will probably also apply to Simulator::detachCircuit
-    if (m_pChangedLogicLast == logic) {
-        LogicOut *previous_1 = nullptr;
-        LogicOut *previous_2 = nullptr;
+    updateIdle();
+}
 
-        for (LogicOut *logic = m_pChangedLogicStart; logic;) {
-            if (previous_1)
-                previous_2 = previous_1;
+void Simulator::removeChangedLogic(LogicOut *logic)
+{
+    SimulationLocker locker(this);
 
-            previous_1 = logic;
-            logic = logic->nextChanged(m_currentChain);
-        }
+    for (unsigned slot = 0; slot < LOGIC_WHEEL_SIZE; ++slot) {
+        LogicOut *previous = nullptr;
 
-        m_pChangedLogicLast = previous_2;
-    }
+        for (LogicOut *changed = m_pLogicWheel[slot]; changed; changed = changed->nextChanged()) {
+            if (changed != logic) {
+                previous = changed;
+                continue;
+            }
 
-    for (unsigned chain = 0; chain < 2; ++chain) {
-        for (LogicOut *prevChanged = m_pChangedLogicStart; prevChanged; prevChanged = prevChanged->nextChanged(chain)) {
-            LogicOut *nextChanged = prevChanged->nextChanged(chain);
+            if (previous)
+                previous->setNextChanged(changed->nextChanged());
+            else
+                m_pLogicWheel[slot] = changed->nextChanged();
 
-            if (nextChanged == logic)
-                prevChanged->setNextChanged(nextChanged->nextChanged(chain), chain);
+            if (m_pLogicWheelLast[slot] == changed)
+                m_pLogicWheelLast[slot] = previous;
+
+            changed->setNextChanged(nullptr);
+            return;
         }
     }
 }
@@ -423,9 +1404,13 @@ void Simulator::detachCircuit(Circuit *circuit)
     if (!circuit)
         return;
 
+    SimulationLocker locker(this);
+
     m_ordinaryCircuits->remove(circuit);
+    m_circuitDocuments.remove(circuit);
+    m_bParallelCircuitsDirty = true;
+    m_bRunningDirty = true;
 
-    // Any changes to the code below will probably also apply to Simulator::removeLogicOutReferences
 
     if (m_pChangedCircuitLast == circuit) {
         Circuit *previous_1 = nullptr;
@@ -450,8 +1435,89 @@ void Simulator::detachCircuit(Circuit *circuit)
                 prevChanged->setNextChanged(nextChanged->nextChanged(chain), chain);
         }
     }
+
+    updateIdle();
 }
 
 // END class Simulator
 
+// BEGIN class SimulatorStatistics
+static QString csvField(const QString &field)
+{
+    if (!field.contains(',') && !field.contains('"'))
+        return field;
+
+    QString quoted = field;
+    quoted.replace('"', "\"\"");
+    return '"' + quoted + '"';
+}
+
+QString SimulatorStatistics::toCsv() const
+{
+    QString csv;
+    QTextStream stream(&csv);
+
+    const double elapsedS = elapsedNs * 1e-9;
+
+    stream << "elapsed_s," << elapsedS << '\n';
+    stream << "linear_steps," << steps << '\n';
+    stream << "linear_steps_per_s," << (elapsedS > 0. ? steps / elapsedS : 0.) << '\n';
+    stream << "ticks," << ticks << '\n';
+    stream << "tick_last_us," << tickLastNs * 1e-3 << '\n';
+    stream << "tick_max_us," << tickMaxNs * 1e-3 << '\n';
+    stream << "tick_average_us," << tickAverageNs * 1e-3 << '\n';
+    stream << "logic_events," << logicEvents << '\n';
+    stream << "logic_events_per_s," << (elapsedS > 0. ? logicEvents / elapsedS : 0.) << '\n';
+    stream << "gpsim_cycles," << gpsimCycles << '\n';
+    stream << "gpsim_cycles_per_s," << (elapsedS > 0. ? gpsimCycles / elapsedS : 0.) << '\n';
+    stream << "timing_enabled," << (timingEnabled ? 1 : 0) << '\n';
+    stream << '\n';
+
+    stream << "circuit,equations,solver,nonlinear,parked,solves,solve_ms,solve_share,logic_solves,"
+              "factorizations,restored_factorizations,factorization_ms,newton_solves,newton_iterations,newton_most_iterations,"
+              "newton_damped_steps,newton_failures,cache_hits,cache_misses,cache_hit_ratio,lu_cache,logic_cache,choosing_strategy\n";
+
+    for (std::vector<CircuitStatistics>::const_iterator it = circuits.begin(); it != circuits.end(); ++it) {
+        const CircuitStats &s = it->stats;
+        const NonLinearStats &nl = it->nonLinearStats;
+        const unsigned long lookups = s.cacheHits + s.cacheMisses;
+
+        stream << csvField(it->description) << ',' << it->equations << ',' << (it->sparse ? "sparse" : (it->banded ? "banded" : "dense")) << ',' << (it->nonLinear ? 1 : 0) << ',' << (it->parked ? 1 : 0) << ',' << s.solves << ','
+               << s.solveNs * 1e-6 << ',' << (elapsedNs > 0 ? double(s.solveNs) / elapsedNs : 0.) << ',' << s.logicSolves << ',' << it->factorizations << ',' << it->restoredFactorizations << ',' << it->factorizationNs * 1e-6 << ',' << nl.solves << ','
+               << nl.iterations << ',' << nl.mostIterations << ',' << nl.dampedSteps << ',' << nl.failures << ',' << s.cacheHits << ',' << s.cacheMisses << ','
+               << (lookups > 0 ? double(s.cacheHits) / lookups : 0.) << ',' << (it->luCache ? 1 : 0) << ',' << (it->logicCache ? 1 : 0) << ',' << (it->choosingStrategy ? 1 : 0) << '\n';
+    }
+
+    if (!components.empty()) {
+        stream << '\n';
+        stream << "component,callback_ms,processor_ms,circuit_ms,share\n";
+
+        for (std::vector<ComponentStatistics>::const_iterator it = components.begin(); it != components.end(); ++it) {
+            stream << csvField(it->id) << ',' << it->callbackNs * 1e-6 << ',' << it->processorNs * 1e-6 << ',' << it->circuitNs * 1e-6 << ',' << (elapsedNs > 0 ? double(it->totalNs()) / elapsedNs : 0.) << '\n';
+        }
+    }
+
+    stream.flush();
+    return csv;
+}
+// END class SimulatorStatistics
+
+// BEGIN class SimulationLocker
+SimulationLocker::SimulationLocker(Simulator *simulator)
+    : m_pSimulator(simulator)
+{
+    if (!m_pSimulator && !Simulator::isDestroyedSim())
+        m_pSimulator = Simulator::self();
+
+    if (m_pSimulator)
+        m_pSimulator->lock();
+}
+
+SimulationLocker::~SimulationLocker()
+{
+    if (m_pSimulator)
+        m_pSimulator->unlock();
+}
+// END class SimulationLocker
+
 #include "moc_simulator.cpp"
@@ -11,11 +11,21 @@
 #ifndef SIMULATOR_H
 #define SIMULATOR_H
 
+#include <algorithm>
+#include <functional>
 #include <list>
+#include <vector>
 
 #include "circuit.h"
 #include "logic.h"
 
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QPointer>
+#include <QString>
+
 /**
 This should be a multiple of 1000. It is the number of times a second that
 linear elements are updated.
@@ -33,30 +43,84 @@ const int LOGIC_UPDATE_RATE = int(1000000);
 
 const int LOGIC_UPDATE_PER_STEP = int(LOGIC_UPDATE_RATE / LINEAR_UPDATE_RATE);
 
+/**
+The resolution of the fine time base (picoseconds), used for the parts of the
+simulation that run at their own rate within the logic updates, such as the
+processors at their own clock. In 64 bits it covers over a hundred days of
+simulated time.
+*/
+const long long TIME_UNITS_PER_SECOND = 1000000000000LL;
+
+const long long TIME_UNITS_PER_LOGIC_UPDATE = TIME_UNITS_PER_SECOND / LOGIC_UPDATE_RATE;
+
+/**
+The number of slots in the timing wheel of changed LogicOuts (a power of two).
+The longest propagation delay a LogicOut can have is one less than this, in
+logic updates.
+*/
+const int LOGIC_WHEEL_SIZE = 256;
+
+/**
+The most times the changed LogicOuts are passed on within one logic update.
+Outputs without a propagation delay that are still changing after this (e.g.
+a ring of gates) carry on in the next logic update.
+*/
+const int LOGIC_MAX_DELTAS = 64;
+
+/**
+The number of scheduled component callbacks there is room for from the start.
+*/
+const int SCHEDULED_CALLBACK_RESERVE = 256;
+
+/**
+The number of linear steps done per timer tick at normal speed.
+*/
+const int LINEAR_STEPS_PER_TICK = int(LINEAR_UPDATE_RATE / SIMULATOR_STEP_INTERVAL_MS);
+
+/**
+While timing is enabled, the component callbacks and processors are timed in
+one logic update out of this many (and the non-logic steps in one linear step
+out of this many), and the times scaled up to estimate the whole. Prime, so
+that the samples do not keep landing on the same phase of a periodic
+callback.
+*/
+const int PROFILE_SAMPLE_INTERVAL = 61;
+
 class QTimer;
 
 class Circuit;
 
 class CircuitDocument;
 
+class CircuitWorkerPool;
+
+class SimulatorThread;
+
+class StimulusPlayer;
+
 class Component;
 
 class ComponentCallback;
 
+class Diode;
+
 class ECNode;
 
 class GpsimProcessor;
 
 class LogicIn;
 
+class LogicNetlist;
+
 class LogicOut;
 
 class Switch;
 
+class TelemetryStream;
+
 class Wire;
 
 typedef QList<ECNode *> ECNodeList;
-typedef QList<LogicIn *> LogicInList;
 typedef void (Component::*VoidCallbackPtr)();
 
 class ComponentCallback
@@ -83,6 +147,135 @@ protected:
     VoidCallbackPtr m_pFunction;
 };
 
+/**
+A ComponentCallback waiting in the simulator for the logic update it is due
+in, ordered so that callbacks due at the same time are called in the order
+they were scheduled.
+*/
+class ScheduledCallback
+{
+public:
+    long long time;
+    unsigned long long order;
+    ComponentCallback *callback;
+
+    bool operator>(const ScheduledCallback &other) const
+    {
+        return (time != other.time) ? (time > other.time) : (order > other.order);
+    }
+};
+
+/**
+A GpsimProcessor waiting in the simulator for its next instruction cycle, at
+a time in TIME_UNITS_PER_SECOND. Processors due at the same time run in the
+order they were attached.
+*/
+class ScheduledProcessor
+{
+public:
+    long long time;
+    unsigned long long order;
+    GpsimProcessor *processor;
+
+    bool operator>(const ScheduledProcessor &other) const
+    {
+        return (time != other.time) ? (time > other.time) : (order > other.order);
+    }
+};
+
+/**
+How the simulation is shared with one document (see
+Simulator::setDocumentPaused), and what of it is held back while the document
+is not being simulated.
+*/
+class DocumentSimulation
+{
+public:
+    DocumentSimulation(const CircuitDocument *document);
+
+    const CircuitDocument *document;
+    bool paused;
+    double share;             ///< of the timer ticks that the document is simulated in
+    double credit;            ///< towards the next tick that it is simulated in
+    bool held;                ///< whether it is not being simulated at the moment
+    long long heldSince;      ///< the step number it was last held at
+    long long heldSteps;      ///< linear steps it was held for, before heldSince
+    long long rateStartSteps; ///< steps it had been simulated in when the ratio was last measured
+    double realTimeRatio;
+    /// Callbacks of its components that were scheduled, or fell due, while held
+    std::vector<ScheduledCallback> heldCallbacks;
+    std::vector<ScheduledProcessor> heldProcessors;
+};
+
+/**
+What one Circuit has been doing, as part of SimulatorStatistics.
+*/
+class CircuitStatistics
+{
+public:
+    QString description; ///< the ids of (some of) the components in the circuit
+    int equations;
+    bool sparse;
+    bool banded;
+    bool luCache;    ///< whether the matrix keeps its factorizations in its LU cache
+    bool logicCache; ///< whether solutions are kept for each state of the LogicOuts
+    bool choosingStrategy; ///< whether the ways of solving the circuit are still being timed
+    bool nonLinear;
+    bool parked;
+    CircuitStats stats;
+    NonLinearStats nonLinearStats;
+    unsigned long factorizations;
+    unsigned long restoredFactorizations;
+    qint64 factorizationNs; ///< time spent in LU decompositions, while timing is enabled
+};
+
+/**
+The simulation time spent on one component, as part of SimulatorStatistics.
+The callback and processor times are estimated from samples.
+*/
+class ComponentStatistics
+{
+public:
+    const Component *component; ///< only to compare with, as it may have been deleted since
+    QString id;
+    qint64 callbackNs;  ///< time spent in the callbacks and non-logic steps of the component
+    qint64 processorNs; ///< time spent running the PIC processor of the component
+    qint64 circuitNs;   ///< an even share of the solve time of each circuit the pins of the component are in
+
+    qint64 totalNs() const
+    {
+        return callbackNs + processorNs + circuitNs;
+    }
+};
+
+/**
+What the simulator has been doing since its statistics were last reset.
+@see Simulator::statistics
+*/
+class SimulatorStatistics
+{
+public:
+    qint64 elapsedNs;               ///< real time since the statistics were reset
+    long long steps;                ///< linear steps done
+    unsigned long ticks;            ///< calls to Simulator::step (one per timer tick)
+    qint64 tickLastNs;              ///< time taken by the last tick
+    qint64 tickMaxNs;               ///< time taken by the slowest tick
+    double tickAverageNs;           ///< rolling average of the time taken by the ticks
+    unsigned long logicEvents;      ///< changed LogicOuts passed on to their logic chains
+    unsigned long long gpsimCycles; ///< cycles run by all the PIC processors
+    bool timingEnabled;             ///< whether the circuits' solve times were measured
+    std::vector<CircuitStatistics> circuits;
+    std::vector<ComponentStatistics> components; ///< while timing is enabled, most expensive first
+
+    /**
+     * @return the statistics as comma separated values: the simulator
+     * totals as name / value pairs, followed by a table with a row for each
+     * circuit and (while timing is enabled) one with a row for each
+     * component.
+     */
+    QString toCsv() const;
+};
+
 /**
 This singleton class oversees all simulation (keeping in sync linear, nonlinear,
 logic, external simulators (such as gpsim), mechanical simulation, etc).
@@ -105,19 +298,37 @@ public:
     long long time() const; /* {
        return m_stepNumber * LOGIC_UPDATE_PER_STEP + m_llNumber;
    } */
+    /**
+     * The start of the current logic update, in TIME_UNITS_PER_SECOND.
+     */
+    long long fineTime() const
+    {
+        return time() * TIME_UNITS_PER_LOGIC_UPDATE;
+    }
 
     /**
      * Initializes a new logic chain.
      */
     void createLogicChain(LogicOut *logicOut, const LogicInList &logicInList, const PinList &pinList);
     /**
-     * Adds the given LogicOut to the list of changed LogicOuts
+     * Schedules the given LogicOut to have its change passed on to its logic
+     * chain, after delay logic updates. With no delay, it is passed on in the
+     * current logic update (or, between steps, the first of the next step).
      */
-    void addChangedLogic(LogicOut *changed)
+    void addChangedLogic(LogicOut *changed, unsigned delay = 0)
     {
-        m_pChangedLogicLast->setNextChanged(changed, m_currentChain);
-        m_pChangedLogicLast = changed;
+        const unsigned slot = (m_logicWheelPos + std::min<unsigned>(delay, LOGIC_WHEEL_SIZE - 1)) & (LOGIC_WHEEL_SIZE - 1);
+        changed->setNextChanged(nullptr);
+        if (m_pLogicWheelLast[slot])
+            m_pLogicWheelLast[slot]->setNextChanged(changed);
+        else
+            m_pLogicWheel[slot] = changed;
+        m_pLogicWheelLast[slot] = changed;
     }
+    /**
+     * Removes the given LogicOut from the changed LogicOuts, if it is there.
+     */
+    void removeChangedLogic(LogicOut *logic);
 
     /**
      * Remove pointers to the given LogicOut, called when it is deleted for
@@ -132,10 +343,12 @@ public:
      */
     void removeLogicInReferences(LogicIn *logic);
     /**
-     * Adds the given Circuit to the list of changed Circuits
+     * Adds the given Circuit to the list of changed Circuits (waking it up if
+     * it had settled)
      */
     void addChangedCircuit(Circuit *changed)
     {
+        changed->wake();
         m_pChangedCircuitLast->setNextChanged(changed, m_currentChain);
         m_pChangedCircuitLast = changed;
     }
@@ -147,6 +360,35 @@ public:
      *      object remains at the caller
      */
     inline void addStepCallback(int at, ComponentCallback *ccb);
+    /**
+     * Calls the callback once, at the start of the logic update where time()
+     * is at (or in the next one, if that has already started). Components
+     * that only do something now and again (such as clocks at their
+     * transitions) should schedule themselves with this, rather than being
+     * called in every logic update with attachComponentCallback. The caller
+     * must hold the simulation lock, and keeps the ownership of the callback,
+     * which must stay valid until it is called or detachComponentCallbacks is
+     * called.
+     */
+    void scheduleCallback(long long at, ComponentCallback *ccb)
+    {
+        m_scheduledCallbacks.push_back(ScheduledCallback{at, m_scheduledCallbackOrder++, ccb});
+        std::push_heap(m_scheduledCallbacks.begin(), m_scheduledCallbacks.end(), std::greater<ScheduledCallback>());
+        if (m_bIdle)
+            updateIdle();
+    }
+    /**
+     * As scheduleCallback, for the next edge of a clock-like component, at
+     * a fine time (in TIME_UNITS_PER_SECOND): the callback is called at the
+     * start of the first logic update that starts at or after it. Keeping
+     * the edges in fine time means periods that are not a whole number of
+     * logic updates do not drift, while the component is still only called
+     * once per edge.
+     */
+    void scheduleEdge(long long at, ComponentCallback *ccb)
+    {
+        scheduleCallback((at + TIME_UNITS_PER_LOGIC_UPDATE - 1) / TIME_UNITS_PER_LOGIC_UPDATE, ccb);
+    }
     /**
      * Add the given processor to the simulator. GpsimProcessor::step will
      * be called while present in the simulator (it is at GpsimProcessor's
@@ -166,25 +408,80 @@ public:
      */
     void attachComponentCallback(Component *component, VoidCallbackPtr function);
     /**
-     * Removes the callbacks for the given component from the simulator.
+     * Removes the callbacks for the given component from the simulator,
+     * including the scheduled ones.
      */
     void detachComponentCallbacks(Component &component);
     /**
-     * Attach the component to the simulator.
+     * Attach the component to the simulator. Only components that return
+     * true from Component::doesStepNonLogic are kept, and their
+     * Component::nonLogicStepDivider is read once here.
      */
     void attachComponent(Component *component);
     /**
      * Detaches the component from the simulator.
      */
     void detachComponent(Component *component);
+    /**
+     * Adds the diode to those whose brightness as a LED (see LED::brightness)
+     * is added up in every linear step. The brightnesses are all added up
+     * in one go, so that components showing LEDs do not have to be stepped
+     * themselves.
+     * @return the handle to read the brightness with
+     */
+    int attachDiodeBrightness(Diode *diode);
+    /**
+     * Stops adding up the brightness of the diode with the given handle,
+     * which must be done before the diode is removed.
+     */
+    void detachDiodeBrightness(int handle);
+    /**
+     * @return the brightness of the diode with the given handle, averaged
+     * over the linear steps since it was last restarted, or -1 if there
+     * have been none.
+     */
+    int diodeBrightness(int handle) const
+    {
+        const long long steps = diodeBrightnessSteps(handle);
+        return steps ? int(m_brightnessSums[handle] / steps) : -1;
+    }
+    /**
+     * @return the number of linear steps that the brightness of the diode
+     * with the given handle has been added up over.
+     */
+    long long diodeBrightnessSteps(int handle) const
+    {
+        return m_stepNumber - m_brightnessStartSteps[handle];
+    }
+    /**
+     * Starts adding up the brightness of the diode with the given handle
+     * again, e.g. once it has been drawn.
+     */
+    void restartDiodeBrightness(int handle)
+    {
+        m_brightnessSums[handle] = 0.;
+        m_brightnessStartSteps[handle] = m_stepNumber;
+    }
     /**
      * Attach a circuit to the simulator
+     * @param document the document the circuit is of, so that it is held
+     * along with the document (see setDocumentPaused)
      */
-    void attachCircuit(Circuit *circuit);
+    void attachCircuit(Circuit *circuit, const CircuitDocument *document = nullptr);
     /**
      * Detach a circuit from the simulator.
      */
     void detachCircuit(Circuit *circuit);
+    /**
+     * Attach the compiled logic gates of a document, which are evaluated
+     * whenever their inputs have changed, before the changed logic is passed
+     * on in each logic update.
+     */
+    void attachLogicNetlist(LogicNetlist *netlist);
+    /**
+     * Detach compiled logic gates from the simulator.
+     */
+    void detachLogicNetlist(LogicNetlist *netlist);
 
     /**
      * @return whether or not we are currently simulating stuff
@@ -194,6 +491,184 @@ public:
     {
         return m_bIsSimulating;
     }
+    /**
+     * Sets the number of threads used to solve independent circuits in
+     * parallel (including the simulator thread itself). A count of 1 or less
+     * solves every circuit in the simulator thread, and 0 uses one thread
+     * per processor core.
+     */
+    void setSolverThreadCount(int count);
+    int solverThreadCount() const;
+
+    /**
+     * Circuits with fewer equations than this are not handed to another
+     * thread on their own, as that costs more than solving them; they are
+     * solved along with the other small circuits of their document.
+     */
+    static const int PARALLEL_MIN_EQUATIONS = 16;
+
+    /**
+     * Runs the simulation from its own thread rather than from a timer in the
+     * GUI thread. While this is enabled, GUI code that changes or reads the
+     * state of the simulation must hold a SimulationLocker. Must not be
+     * called while holding the lock, as stopping the thread waits for it.
+     */
+    void setRunInThread(bool runInThread);
+    bool runsInThread() const
+    {
+        return m_pThread;
+    }
+    /**
+     * @return whether nothing is attached to the simulator (no circuits,
+     * logic, components or processors), in which case it stops stepping
+     * until something is, even while simulating.
+     */
+    bool isIdle() const
+    {
+        return m_bIdle;
+    }
+    /**
+     * While enabled, logic updates in which nothing but the PIC processors
+     * would do anything are run as just the processors. Processors still run
+     * one instruction cycle per logic update, and a logic update is done as
+     * usual as soon as one of their pins changes, so the simulation comes
+     * out the same either way.
+     */
+    void setBatchProcessorCycles(bool batch);
+    bool batchProcessorCycles() const
+    {
+        return m_bBatchProcessorCycles;
+    }
+    /**
+     * Acquires the simulation lock (recursively). The simulation thread
+     * takes the lock for each linear step, and lets waiting threads in
+     * between steps. Prefer SimulationLocker to calling this directly.
+     */
+    void lock();
+    void unlock();
+
+    /**
+     * Sets how fast simulated time runs, relative to normal speed (1.0).
+     * Ignored while free running.
+     */
+    void setSpeed(double multiplier);
+    double speed() const
+    {
+        return m_speed;
+    }
+    /**
+     * When free running, the simulator does as many steps as it can in each
+     * timer tick (while leaving some time for the GUI), instead of a fixed
+     * number.
+     */
+    void setFreeRunning(bool freeRunning);
+    bool isFreeRunning() const
+    {
+        return m_bFreeRunning;
+    }
+    /**
+     * Pauses the simulation once time() reaches the given value, and emits
+     * targetTimeReached. A negative time removes the target.
+     */
+    void setTargetTime(long long time);
+    long long targetTime() const
+    {
+        return m_targetTime;
+    }
+    /**
+     * @return the number of linear steps done per second of real time,
+     * measured over roughly the last second.
+     */
+    double stepRate() const
+    {
+        return m_stepRate;
+    }
+    /**
+     * @return the average number of linear steps per second of real time
+     * since the target time was last set.
+     */
+    double targetStepRate() const;
+
+    /**
+     * Does the given number of linear steps straight away, in the calling
+     * thread, for running a simulation without the step timer (e.g. from
+     * a batch job). The simulation should be paused while doing this, so
+     * that the timer does not step it as well.
+     */
+    void runSteps(long long steps);
+
+    /**
+     * @return the number of linear steps done since the simulator was
+     * created.
+     */
+    long long stepNumber() const
+    {
+        return m_stepNumber;
+    }
+    /**
+     * Sets the stimulus that is replayed on a circuit, between the linear
+     * steps that its changes are due at, or removes it if null. The player
+     * is not owned by the simulator; it removes itself when deleted.
+     */
+    void setStimulusPlayer(StimulusPlayer *player);
+    StimulusPlayer *stimulusPlayer() const
+    {
+        return m_pStimulusPlayer;
+    }
+    /**
+     * @return the stream that the values of a watch list of nodes and probes
+     * are published to after each linear step, for other processes to read
+     * (created the first time this is called)
+     */
+    TelemetryStream *telemetryStream();
+
+    /**
+     * Pauses or carries on simulating one document, while the others carry
+     * on. A paused document is held where it is: its circuits are not
+     * solved, and its components are neither stepped nor called back. When
+     * it carries on, the callbacks that its components have scheduled and
+     * its processors are moved on by as long as it was held for (see
+     * Component::simulationResumed), so that it picks up where it left off.
+     * Logic changes that were already on their way are still passed on
+     * while it is held.
+     */
+    void setDocumentPaused(const CircuitDocument *document, bool paused);
+    bool isDocumentPaused(const CircuitDocument *document) const;
+    /**
+     * Sets the share of the timer ticks (from 0 to 1) that the document is
+     * simulated in. It is held, as when paused, in the other ticks, so that
+     * simulated time runs that much slower for it.
+     */
+    void setDocumentShare(const CircuitDocument *document, double share);
+    /**
+     * @return the simulated time of the document per second of real time,
+     * measured over roughly the last second (as stepRate is).
+     */
+    double documentRealTimeRatio(const CircuitDocument *document) const;
+    /**
+     * Forgets the document, carrying it on first if it was held. Called
+     * when it is deleted.
+     */
+    void removeDocument(const CircuitDocument *document);
+
+    /**
+     * @return what the simulator and each circuit have been doing since the
+     * statistics were last reset.
+     */
+    SimulatorStatistics statistics();
+    void resetStatistics();
+    /**
+     * Sets whether the time taken to solve each circuit is measured (which
+     * costs a little for every solve, so is only done while someone is
+     * looking at the statistics).
+     */
+    void setTimingEnabled(bool enabled);
+
+    /**
+     * Percentage of each timer tick spent stepping when free running in the
+     * GUI thread.
+     */
+    static const int FREE_RUN_BUSY_PERCENT = 80;
 
 signals:
     /**
@@ -201,6 +676,16 @@ signals:
      * @see slotSetSimulating
      */
     void simulatingStateChanged(bool isSimulating);
+    /**
+     * Emitted about once a second while simulating, with the number of
+     * linear steps done per second of real time.
+     */
+    void stepRateChanged(double stepsPerSecond);
+    /**
+     * Emitted when the target time set with setTargetTime has been reached
+     * (the simulation is paused at this point).
+     */
+    void targetTimeReached();
 
 public slots:
     /**
@@ -208,44 +693,219 @@ public slots:
      * @see isSimulating
      */
     void slotSetSimulating(bool simulate);
+    /**
+     * Reads the simulation settings (e.g. the number of solver threads).
+     */
+    void slotUpdateConfiguration();
 
 private slots:
     void step();
-    void printTimingStatistics();
 
 private:
+    /**
+     * Does one linear step, including the LOGIC_UPDATE_PER_STEP logic
+     * updates in it. The caller must hold the simulation lock.
+     */
+    void stepLinear();
+    /**
+     * Passes on the changes of the LogicOuts due in the current logic update
+     * to their logic chains, including the changes that causes in outputs
+     * without a propagation delay.
+     */
+    void passOnChangedLogic();
+    /**
+     * Calls the callback, adding the time it takes (scaled up by
+     * PROFILE_SAMPLE_INTERVAL) to its component.
+     */
+    void callProfiled(ComponentCallback &callback);
+    /**
+     * @return whether the stimulus player has changes due before the next
+     * linear step. The caller must hold the simulation lock.
+     */
+    bool isStimulusDue() const;
+    /**
+     * Has the stimulus player make the changes that are due, from the GUI
+     * thread. The caller must not hold the simulation lock. From the thread
+     * of the simulation, the changes are only queued for the GUI thread
+     * (which may itself be waiting for the simulation thread, e.g. to stop
+     * it), and the simulation must not be stepped until they are made.
+     * @return whether the changes have been made
+     */
+    bool applyStimulus();
+    /**
+     * @return the simulation of the document, which is made if there is
+     * none yet.
+     */
+    DocumentSimulation *documentSimulation(const CircuitDocument *document);
+    /**
+     * @return the simulation of the document if it is being held, else null
+     */
+    DocumentSimulation *heldDocument(const CircuitDocument *document) const
+    {
+        DocumentSimulation *simulation = document ? m_documents.value(document) : nullptr;
+        return (simulation && simulation->held) ? simulation : nullptr;
+    }
+    /**
+     * Holds or carries on the documents for the next timer tick, by their
+     * shares and whether they are paused.
+     */
+    void shareDocuments();
+    /**
+     * Holds the document, taking its scheduled callbacks and processors off
+     * their queues, or carries it on, putting them back moved on by as long
+     * as it was held for.
+     */
+    void setDocumentHeld(DocumentSimulation *document, bool held);
+    /**
+     * @return the number of linear steps the document has been simulated in
+     */
+    long long documentSteps(const DocumentSimulation *document) const
+    {
+        return m_stepNumber - document->heldSteps - (document->held ? m_stepNumber - document->heldSince : 0);
+    }
+    /**
+     * Fills the lists of the callbacks, components and circuits that are
+     * not being held, which are stepped in place of all of them while any
+     * document is held.
+     */
+    void updateRunning();
+    /**
+     * Adds up the time spent on each component from the samples and the
+     * solve times of the circuits, for statistics().
+     */
+    void componentStatistics(std::vector<ComponentStatistics> *statistics) const;
+#ifndef NO_GPSIM
+    /**
+     * @return whether the logic update m_llNumber is at has nothing to do
+     * besides running the processors: no component callbacks are due, and
+     * no circuits, logic or compiled gates have changed.
+     */
+    bool isLogicUpdateIdle() const;
+    /**
+     * Runs the processors for each of the logic updates from m_llNumber for
+     * as long as they are idle, leaving m_llNumber at the first update that
+     * is not.
+     * @return whether the processors have already been run in that update
+     * (as it was one of their pins that changed)
+     */
+    bool executeProcessorsAlone();
+    /**
+     * Executes the instruction cycles of the processors that are due before
+     * the end of the current logic update, in time order, each processor
+     * running at its own clock.
+     */
+    void executeProcessors();
+#endif
+    /**
+     * Works out whether anything is attached to the simulator, and suspends
+     * or resumes the stepping when that changes. Called after anything is
+     * attached or detached.
+     */
+    void updateIdle();
+    /**
+     * Starts or stops the step timer (or that of the simulator thread), so
+     * that steps are only taken while simulating and not idle.
+     */
+    void updateStepTimers();
+
     bool m_bIsSimulating;
     // 	static Simulator *m_pSelf;
 
+    QMutex m_mutex;
+    QAtomicInt m_lockRequests; ///< Number of threads waiting in lock()
+    QAtomicInt m_stimulusQueued; ///< Whether changes of the stimulus are waiting for the GUI thread
+    SimulatorThread *m_pThread;
+    bool m_bIdle; ///< Whether nothing is attached, see isIdle
+    QPointer<StimulusPlayer> m_pStimulusPlayer;
+    TelemetryStream *m_pTelemetryStream;
+
     QTimer *m_stepTimer;
 
     /// List of LogicOuts that are at the start of a LogicChain
     QList<LogicOut *> m_logicChainStarts;
-    std::list<GpsimProcessor *> *m_gpsimProcessors;
+    std::vector<LogicNetlist *> m_logicNetlists;
+    /// Stepped one after another: gpsim keeps its cycle counter and
+    /// breakpoints in globals, so the processors cannot run in parallel
+    std::vector<GpsimProcessor *> m_gpsimProcessors;
+    /// Heap of when each of m_gpsimProcessors is next due
+    std::vector<ScheduledProcessor> m_processorQueue;
+    unsigned long long m_processorOrder;
 
-    // doesn't look too appropriate.
     // essentially a grab bag of every odd *component* that answers "true" to does step non-logic,
     // Which is every component that has special UI-related code that needs to be called every time the simulator steps.
     // this is not to be confused with elements which have nonLinear and Reactive components. =P
-    std::list<Component *> *m_components;
-    std::list<ComponentCallback> *m_componentCallbacks;
+    std::vector<Component *> m_nonLogicComponents;
+    /// The Component::nonLogicStepDivider of each of m_nonLogicComponents
+    std::vector<int> m_nonLogicStepDividers;
+
+    /// The diodes whose brightness is added up, with null for unused handles
+    std::vector<Diode *> m_brightnessDiodes;
+    std::vector<double> m_brightnessSums;
+    std::vector<long long> m_brightnessStartSteps; ///< m_stepNumber when each sum was restarted
+    std::vector<int> m_freeBrightnessHandles;
+    std::vector<ComponentCallback> *m_componentCallbacks;
     std::list<Circuit *> *m_ordinaryCircuits;
 
-    // allow a variable number of callbacks be scheduled at each possible time.
-    std::list<ComponentCallback *> *m_pStartStepCallback[LOGIC_UPDATE_PER_STEP];
+    QHash<const CircuitDocument *, DocumentSimulation *> m_documents;
+    QHash<const Circuit *, const CircuitDocument *> m_circuitDocuments;
+    int m_heldDocumentCount;
+    bool m_bRunningDirty; ///< Whether the lists below need to be made again
+    /// Those of m_componentCallbacks, m_nonLogicComponents and
+    /// m_ordinaryCircuits that are not being held
+    std::vector<ComponentCallback> m_runningCallbacks;
+    std::vector<Component *> m_runningNonLogicComponents;
+    std::vector<int> m_runningNonLogicStepDividers;
+    std::list<Circuit *> m_runningCircuits;
+
+    /**
+     * Fills m_parallelCircuits with the circuits in batches, largest first:
+     * each large circuit is a batch of its own, and the small circuits of a
+     * document are one batch. Leaves it empty if there are not enough large
+     * batches for solving in parallel to be worthwhile.
+     */
+    void updateParallelCircuits();
+
+    CircuitWorkerPool *m_pWorkerPool;
+    std::vector<Circuit *> m_parallelCircuits;
+    std::vector<int> m_parallelBatchEnds; ///< see CircuitWorkerPool::solveNonLogic
+    bool m_bParallelCircuitsDirty;
+
+    /// Scheduled callbacks, as a heap with the earliest due at the front
+    std::vector<ScheduledCallback> m_scheduledCallbacks;
+    unsigned long long m_scheduledCallbackOrder;
 
     Circuit *m_pChangedCircuitStart;
     Circuit *m_pChangedCircuitLast;
 
-    LogicOut *m_pChangedLogicStart;
-    LogicOut *m_pChangedLogicLast;
+    /// Changed LogicOuts, in lists by the logic update they are due in
+    LogicOut *m_pLogicWheel[LOGIC_WHEEL_SIZE];
+    LogicOut *m_pLogicWheelLast[LOGIC_WHEEL_SIZE];
+    unsigned m_logicWheelPos; ///< slot of the current logic update
 
-    QTimer *m_printTimingStatsTimer;
+    // Stuff for statistics
     qint64 m_stepMaxNs;
     double m_stepRollingAvgNs;
     qint64 m_stepLastNs;
-    qint64 m_stepsSinceStart;
-    qint64 m_stepsSincePrint;
+    unsigned long m_statsTicks;
+    long long m_statsStartStep;
+    unsigned long m_logicEvents;
+    unsigned long long m_detachedGpsimCycles; ///< cycles run by processors since detached
+    QHash<const Component *, qint64> m_componentNs;        ///< sampled time of the callbacks and non-logic steps
+    QHash<const GpsimProcessor *, qint64> m_processorNs;   ///< sampled time of running the processors
+    QElapsedTimer m_statsTimer;
+
+    double m_speed;
+    double m_stepBudget; ///< Fractional steps carried over to the next tick
+    bool m_bFreeRunning;
+
+    long long m_targetTime;
+    bool m_bTargetReached;
+    long long m_targetStartStep;
+    QElapsedTimer m_targetTimer;
+
+    QElapsedTimer m_stepRateTimer;
+    long long m_stepRateStartStep;
+    double m_stepRate;
 
 public:
     Simulator();
@@ -256,6 +916,28 @@ private:
 
     // looks like there are only ever two chains, 0 and 1, code elsewhere toggles between the two...
     unsigned char m_currentChain;
+    bool m_bBatchProcessorCycles;
+
+    friend class SimulatorThread;
+};
+
+/**
+Holds the simulation lock for as long as it is in scope. Only has an effect
+on other threads when the simulation runs in its own thread.
+@see Simulator::setRunInThread
+*/
+class SimulationLocker
+{
+public:
+    /**
+     * @param simulator the simulator to lock, or nullptr for the global one
+     * (if it still exists).
+     */
+    explicit SimulationLocker(Simulator *simulator = nullptr);
+    ~SimulationLocker();
+
+protected:
+    Simulator *m_pSimulator;
 };
 
 inline void Simulator::addStepCallback(int at, ComponentCallback *ccb)
@@ -265,11 +947,8 @@ inline void Simulator::addStepCallback(int at, ComponentCallback *ccb)
     if ((at < 0) || (at >= LOGIC_UPDATE_PER_STEP)) {
         return; // note: maybe log here the error
     }
-    if (!m_pStartStepCallback[at]) {
-        m_pStartStepCallback[at] = new std::list<ComponentCallback *>;
-    }
 
-    m_pStartStepCallback[at]->push_back(ccb);
+    scheduleCallback(m_stepNumber * LOGIC_UPDATE_PER_STEP + at, ccb);
 }
 
 #endif
@@ -0,0 +1,56 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "simulatorthread.h"
+#include "simulator.h"
+
+#include <QTimer>
+
+SimulatorThread::SimulatorThread(Simulator *simulator)
+    : m_pSimulator(simulator)
+{
+    setObjectName("SimulatorThread");
+
+    // The timer lives in this thread, and the direct connection makes the
+    // steps run here rather than in the thread of the Simulator object.
+    m_pStepTimer = new QTimer;
+    m_pStepTimer->moveToThread(this);
+    QObject::connect(m_pStepTimer, &QTimer::timeout, m_pSimulator, &Simulator::step, Qt::DirectConnection);
+}
+
+SimulatorThread::~SimulatorThread()
+{
+    stop();
+    delete m_pStepTimer;
+}
+
+void SimulatorThread::stop()
+{
+    quit();
+    wait();
+}
+
+void SimulatorThread::setStepping(bool stepping)
+{
+    // The timer can only be started and stopped from its own thread
+    QTimer *timer = m_pStepTimer;
+    QMetaObject::invokeMethod(timer, [timer, stepping]() {
+        if (!stepping)
+            timer->stop();
+        else if (!timer->isActive())
+            timer->start(SIMULATOR_STEP_INTERVAL_MS);
+    }, Qt::QueuedConnection);
+}
+
+void SimulatorThread::run()
+{
+    exec();
+    m_pStepTimer->stop();
+}
@@ -0,0 +1,50 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef SIMULATORTHREAD_H
+#define SIMULATORTHREAD_H
+
+#include <QThread>
+
+class QTimer;
+class Simulator;
+
+/**
+Drives Simulator::step from its own event loop, so that the simulation keeps
+running at a steady rate while the GUI thread is busy (e.g. with dialogs or
+layout). Access to the simulation from the GUI thread is serialised with
+SimulationLocker.
+
+@short Thread in which the simulation runs
+*/
+class SimulatorThread : public QThread
+{
+public:
+    SimulatorThread(Simulator *simulator);
+    ~SimulatorThread() override;
+
+    /**
+     * Stops the event loop and waits for the current step to finish.
+     */
+    void stop();
+    /**
+     * Starts or stops the stepping of the simulation in this thread. The
+     * thread does not step until this is first called.
+     */
+    void setStepping(bool stepping);
+
+protected:
+    void run() override;
+
+    Simulator *m_pSimulator;
+    QTimer *m_pStepTimer; ///< Lives in this thread
+};
+
+#endif
@@ -0,0 +1,193 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "stallwatch.h"
+#include "document.h"
+
+#include <KLocalizedString>
+
+#include <QAbstractEventDispatcher>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QThread>
+
+#include <ktechlab_debug.h>
+
+namespace
+{
+// The upper bounds of the buckets of the histogram, in milliseconds; the
+// last bucket has none
+const int bucketBounds[StallWatch::BUCKET_COUNT - 1] = {4, 16, 50, 100, 250, 500, 1000, 2000};
+
+// The most regions kept for one iteration; a region finishing straight after
+// another of the same name and document is added to it instead
+const int MAX_ITERATION_REGIONS = 256;
+
+QElapsedTimer watchTimer;
+QThread *guiThread = nullptr;
+qint64 iterationStart = -1;
+int regionDepth = 0;
+int thresholdMs = StallWatch::DEFAULT_THRESHOLD_MS;
+quint64 changes = 0;
+
+QVector<StallWatch::RegionTime> iterationRegions;
+QVector<StallWatch::Stall> stallList;
+QMap<QString, StallWatch::RegionStats> regionTotals;
+QVector<qint64> bucketCounts(StallWatch::BUCKET_COUNT, 0);
+}
+
+// BEGIN class StallWatch::Region
+StallWatch::Region::Region(const char *name, const Document *document)
+    : m_name(name)
+    , m_pDocument(document)
+    , m_start(-1)
+{
+    if (!guiThread || QThread::currentThread() != guiThread)
+        return;
+    m_start = watchTimer.nsecsElapsed();
+    regionDepth++;
+}
+
+StallWatch::Region::~Region()
+{
+    if (m_start < 0)
+        return;
+    regionDepth--;
+    StallWatch::addRegion(m_name, m_pDocument, watchTimer.nsecsElapsed() - m_start);
+}
+// END class StallWatch::Region
+
+// BEGIN class StallWatch
+void StallWatch::install()
+{
+    if (guiThread)
+        return;
+
+    QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance();
+    if (!dispatcher) {
+        qCWarning(KTL_LOG) << "No event dispatcher to watch";
+        return;
+    }
+
+    guiThread = QThread::currentThread();
+    watchTimer.start();
+    QObject::connect(dispatcher, &QAbstractEventDispatcher::awake, qApp, &StallWatch::awake);
+    QObject::connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, qApp, &StallWatch::aboutToBlock);
+}
+
+void StallWatch::setThreshold(int ms)
+{
+    thresholdMs = ms;
+}
+
+int StallWatch::threshold()
+{
+    return thresholdMs;
+}
+
+const QVector<StallWatch::Stall> &StallWatch::stalls()
+{
+    return stallList;
+}
+
+const QMap<QString, StallWatch::RegionStats> &StallWatch::regionStats()
+{
+    return regionTotals;
+}
+
+const QVector<qint64> &StallWatch::histogram()
+{
+    return bucketCounts;
+}
+
+QString StallWatch::bucketLabel(int bucket)
+{
+    const auto duration = [](int ms) { return (ms >= 1000) ? i18n("%1 s", ms / 1000) : i18n("%1 ms", ms); };
+
+    if (bucket <= 0)
+        return i18n("Under %1", duration(bucketBounds[0]));
+    if (bucket >= BUCKET_COUNT - 1)
+        return i18n("%1 or more", duration(bucketBounds[BUCKET_COUNT - 2]));
+    return i18n("%1 to %2", duration(bucketBounds[bucket - 1]), duration(bucketBounds[bucket]));
+}
+
+void StallWatch::reset()
+{
+    stallList.clear();
+    regionTotals.clear();
+    bucketCounts.fill(0);
+    changes++;
+}
+
+quint64 StallWatch::changeCount()
+{
+    return changes;
+}
+
+void StallWatch::awake()
+{
+    // A nested event loop waking up ends the iteration it was run from
+    iterationStart = watchTimer.nsecsElapsed();
+    iterationRegions.clear();
+}
+
+void StallWatch::aboutToBlock()
+{
+    if (iterationStart < 0)
+        return;
+
+    const qint64 ns = watchTimer.nsecsElapsed() - iterationStart;
+    iterationStart = -1;
+
+    int bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && ns >= qint64(bucketBounds[bucket]) * 1000000)
+        bucket++;
+    bucketCounts[bucket]++;
+    changes++;
+
+    if (ns >= qint64(thresholdMs) * 1000000) {
+        if (stallList.size() >= MAX_STALLS)
+            stallList.removeFirst();
+        stallList.append({QDateTime::currentDateTime(), ns, iterationRegions});
+
+        QSet<QString> names;
+        for (const RegionTime &region : qAsConst(iterationRegions))
+            names.insert(region.name);
+        for (const QString &name : qAsConst(names))
+            regionTotals[name].stalls++;
+    }
+
+    iterationRegions.clear();
+}
+
+void StallWatch::addRegion(const char *name, const Document *document, qint64 ns)
+{
+    const QString regionName = QString::fromLatin1(name);
+    RegionStats &totals = regionTotals[regionName];
+    totals.count++;
+    totals.totalNs += ns;
+    totals.maxNs = qMax(totals.maxNs, ns);
+
+    if (iterationStart < 0)
+        return;
+
+    const QString documentName = document ? document->caption() : QString();
+    if (!iterationRegions.isEmpty()) {
+        RegionTime &last = iterationRegions.last();
+        if (last.name == regionName && last.document == documentName && last.depth == regionDepth) {
+            last.ns += ns;
+            return;
+        }
+    }
+    if (iterationRegions.size() < MAX_ITERATION_REGIONS)
+        iterationRegions.append({regionName, documentName, ns, regionDepth});
+}
+// END class StallWatch
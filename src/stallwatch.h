@@ -0,0 +1,148 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef STALLWATCH_H
+#define STALLWATCH_H
+
+#include <QDateTime>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+class Document;
+
+/**
+Watches for the GUI thread being kept from handling events, and finds what
+kept it. Each iteration of the event loop is timed from when it wakes up to
+when it next waits for events; the iterations taking longer than the
+threshold are recorded as stalls, along with the regions of code that ran in
+them (and the documents they ran for). Regions are the slow operations that
+are worth knowing about, such as assigning circuits, rerouting connectors or
+saving the undo state, timed with StallWatch::Region objects; they are only
+timed on the GUI thread.
+
+All the iterations go into a histogram of their durations, so how responsive
+the GUI has been can be seen along with the worst stalls.
+
+Nested event loops (such as those of modal dialogs) split the iteration they
+are run from, so a stall is never blamed on the time spent in a dialog.
+
+@see StallWatchView
+@author KTechLab developers
+*/
+class StallWatch
+{
+public:
+    /**
+     * Times a region of code on the GUI thread, from construction to
+     * destruction.
+     */
+    class Region
+    {
+    public:
+        Region(const char *name, const Document *document = nullptr);
+        ~Region();
+
+    protected:
+        const char *m_name;
+        const Document *m_pDocument;
+        qint64 m_start; ///< or -1 if not timed
+    };
+
+    /**
+     * The time taken by a region in a stall.
+     */
+    class RegionTime
+    {
+    public:
+        QString name;
+        QString document;
+        qint64 ns;
+        int depth; ///< how many regions it was nested in
+    };
+
+    class Stall
+    {
+    public:
+        QDateTime when; ///< when the iteration ended
+        qint64 ns;
+        QVector<RegionTime> regions; ///< in the order they finished
+    };
+
+    /**
+     * The totals for a region, over all of the iterations.
+     */
+    class RegionStats
+    {
+    public:
+        qint64 count = 0;
+        qint64 totalNs = 0;
+        qint64 maxNs = 0;
+        qint64 stalls = 0; ///< how many stalls the region ran in
+    };
+
+    /**
+     * Starts timing the iterations of the event loop of the application.
+     * This must be called from the GUI thread, once the application has
+     * been created.
+     */
+    static void install();
+
+    /**
+     * Sets how long an iteration can take, in milliseconds, before it is
+     * recorded as a stall.
+     */
+    static void setThreshold(int ms);
+    static int threshold();
+
+    /**
+     * @return the stalls recorded since the last reset, oldest first (at
+     * most MAX_STALLS of the most recent)
+     */
+    static const QVector<Stall> &stalls();
+    /**
+     * @return the totals for each region, keyed by its name
+     */
+    static const QMap<QString, RegionStats> &regionStats();
+
+    /**
+     * The number of buckets of the histogram of iteration times.
+     */
+    static const int BUCKET_COUNT = 9;
+    /**
+     * @return the number of iterations with durations in each bucket
+     */
+    static const QVector<qint64> &histogram();
+    /**
+     * @return the text describing the range of durations of the bucket,
+     * e.g. "50 - 100 ms"
+     */
+    static QString bucketLabel(int bucket);
+
+    /**
+     * Forgets the stalls, region totals and histogram.
+     */
+    static void reset();
+    /**
+     * @return a count that goes up whenever something is recorded, so that
+     * a view can see whether it needs updating
+     */
+    static quint64 changeCount();
+
+    static const int MAX_STALLS = 200;
+    static const int DEFAULT_THRESHOLD_MS = 100;
+
+protected:
+    static void awake();
+    static void aboutToBlock();
+    static void addRegion(const char *name, const Document *document, qint64 ns);
+};
+
+#endif
@@ -0,0 +1,128 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "startuptrace.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QVector>
+
+#include <ktechlab_debug.h>
+
+namespace
+{
+class TracedPhase
+{
+public:
+    const char *name;
+    qint64 start;
+    qint64 end;
+};
+
+QElapsedTimer traceTimer;
+QVector<TracedPhase> tracedPhases;
+QString traceFileName;
+bool traceFinished = false;
+}
+
+// BEGIN class StartupTrace::Phase
+StartupTrace::Phase::Phase(const char *name)
+    : m_name(name)
+    , m_start(StartupTrace::elapsed())
+    , m_bEnded(false)
+{
+}
+
+StartupTrace::Phase::~Phase()
+{
+    end();
+}
+
+void StartupTrace::Phase::end()
+{
+    if (m_bEnded)
+        return;
+    m_bEnded = true;
+    StartupTrace::addPhase(m_name, m_start, StartupTrace::elapsed());
+}
+// END class StartupTrace::Phase
+
+// BEGIN class StartupTrace
+void StartupTrace::start()
+{
+    traceTimer.start();
+}
+
+void StartupTrace::setOutputFile(const QString &fileName)
+{
+    traceFileName = fileName;
+}
+
+qint64 StartupTrace::elapsed()
+{
+    if (!traceTimer.isValid())
+        traceTimer.start();
+    return traceTimer.nsecsElapsed();
+}
+
+void StartupTrace::addPhase(const char *name, qint64 start, qint64 end)
+{
+    if (!traceFinished)
+        tracedPhases.append({name, start, end});
+}
+
+void StartupTrace::finish()
+{
+    if (traceFinished)
+        return;
+    traceFinished = true;
+
+    qCDebug(KTL_LOG) << "Startup took" << elapsed() / 1000000 << "ms";
+    for (const TracedPhase &phase : qAsConst(tracedPhases))
+        qCDebug(KTL_LOG) << "  " << phase.name << "at" << phase.start / 1000000 << "ms took" << (phase.end - phase.start) / 1000000 << "ms";
+
+    if (!traceFileName.isEmpty() && !writeFile())
+        qCWarning(KTL_LOG) << "Could not write the startup trace to" << traceFileName;
+
+    tracedPhases.clear();
+    tracedPhases.squeeze();
+}
+
+bool StartupTrace::writeFile()
+{
+    QFile file(traceFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    // Complete events ("X"), with the times in microseconds
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray events;
+    for (const TracedPhase &phase : qAsConst(tracedPhases)) {
+        QJsonObject event;
+        event["name"] = QString::fromLatin1(phase.name);
+        event["cat"] = QStringLiteral("startup");
+        event["ph"] = QStringLiteral("X");
+        event["ts"] = double(phase.start) / 1000.;
+        event["dur"] = double(phase.end - phase.start) / 1000.;
+        event["pid"] = pid;
+        event["tid"] = 1;
+        events.append(event);
+    }
+
+    QJsonObject trace;
+    trace["traceEvents"] = events;
+    trace["displayTimeUnit"] = QStringLiteral("ms");
+    return file.write(QJsonDocument(trace).toJson()) != -1;
+}
+// END class StartupTrace
@@ -0,0 +1,73 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef STARTUPTRACE_H
+#define STARTUPTRACE_H
+
+#include <QString>
+
+/**
+Records how long the phases of starting KTechLab take. Phases are timed with
+StartupTrace::Phase objects, which may be nested; once startup has finished
+(see finish), the phases are written to the debug output, and to a file in
+the Chrome trace event format if one was given (see setOutputFile), which can
+be opened in chrome://tracing or Perfetto.
+
+@author KTechLab developers
+*/
+class StartupTrace
+{
+public:
+    /**
+     * Times the phase from construction to destruction, or to end().
+     */
+    class Phase
+    {
+    public:
+        Phase(const char *name);
+        ~Phase();
+
+        /**
+         * Ends the phase before the object is destroyed.
+         */
+        void end();
+
+    protected:
+        const char *m_name;
+        qint64 m_start;
+        bool m_bEnded;
+    };
+
+    /**
+     * Takes the time startup begins at, which the times of the phases are
+     * relative to. If this is not called, they are relative to the first
+     * phase.
+     */
+    static void start();
+    /**
+     * Sets the file to write the trace to when startup has finished.
+     */
+    static void setOutputFile(const QString &fileName);
+    /**
+     * Marks the end of startup, writing out the phases recorded. Phases
+     * ending after this are not recorded.
+     */
+    static void finish();
+    /**
+     * @return the time in nanoseconds since startup began
+     */
+    static qint64 elapsed();
+
+protected:
+    static void addPhase(const char *name, qint64 start, qint64 end);
+    static bool writeFile();
+};
+
+#endif
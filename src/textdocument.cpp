@@ -29,7 +29,12 @@
 // #include <kate/katedocument.h>
 #include <QAction>
 #include <QDir>
+#include <QFileDialog>
+#include <QPainter>
 #include <QTemporaryFile>
+#include <QTimer>
+
+#include <algorithm>
 
 #include <KLocalizedString>
 #include <KMessageBox>
@@ -39,6 +44,9 @@
 
 #include <ktechlab_debug.h>
 
+/// Assembly with fewer lines than this is formatted without a thread
+static const int minBackgroundFormatLines = 2000;
+
 bool TextDocument::isUndoAvailable() const
 {
     // return (m_doc->undoCount() != 0);
@@ -70,10 +78,13 @@ TextDocument::TextDocument(const QString &caption)
     b_lockSyncBreakpoints = false;
     m_lastDebugLineAt = -1;
     m_pDebugger = nullptr;
+    m_pProfileTimer = new QTimer(this);
+    connect(m_pProfileTimer, &QTimer::timeout, this, &TextDocument::updateHeatMarks);
 #endif
 
     m_pLastTextOutputTarget = nullptr;
     m_guessedCodeType = TextDocument::ct_unknown;
+    m_pFormatThread = nullptr;
     m_type = Document::dt_text;
     // m_bookmarkActions.setAutoDelete(true); // TODO see if this generates memory leaks
     m_pDocumentIface = new TextDocumentIface(this);
@@ -104,6 +115,12 @@ TextDocument::TextDocument(const QString &caption)
     markIface->setMarkPixmap(KTextEditor::MarkInterface::BreakpointReached, *reachedBreakpointPixmap());
     markIface->setMarkPixmap(KTextEditor::MarkInterface::BreakpointDisabled, *disabledBreakpointPixmap());
     markIface->setMarkPixmap(KTextEditor::MarkInterface::Execution, *executionPointPixmap());
+    markIface->setMarkDescription(static_cast<KTextEditor::MarkInterface::MarkTypes>(HeatLow), i18n("Some Cycles"));
+    markIface->setMarkDescription(static_cast<KTextEditor::MarkInterface::MarkTypes>(HeatMedium), i18n("More Cycles"));
+    markIface->setMarkDescription(static_cast<KTextEditor::MarkInterface::MarkTypes>(HeatHigh), i18n("Many Cycles"));
+    markIface->setMarkDescription(static_cast<KTextEditor::MarkInterface::MarkTypes>(HeatHighest), i18n("Most Cycles"));
+    for (MarkType heat : {HeatLow, HeatMedium, HeatHigh, HeatHighest})
+        markIface->setMarkPixmap(static_cast<KTextEditor::MarkInterface::MarkTypes>(heat), *heatPixmap(heat));
     markIface->setEditableMarks(KTextEditor::MarkInterface::Bookmark | Breakpoint);
 
     m_constructorSuccessful = true;
@@ -126,6 +143,11 @@ TextDocument::~TextDocument()
         }
     }
 
+    if (m_pFormatThread) {
+        m_pFormatThread->wait();
+        delete m_pFormatThread;
+    }
+
     delete m_doc;
     delete m_pDocumentIface;
 }
@@ -299,15 +321,60 @@ void TextDocument::slotInitLanguage(CodeType type)
 
 void TextDocument::formatAssembly()
 {
-    AsmFormatter formatter;
+    // Lines that are edited while formatting are left alone, so formatting
+    // again before the last one has finished would not change anything more
+    if (m_pFormatThread)
+        return;
+
     // QStringList lines = QStringList::split( "\n", m_doc->text(), true ); // 2018.12.01
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
     QStringList lines = m_doc->text().split("\n", Qt::KeepEmptyParts);
 #else
     QStringList lines = m_doc->text().split("\n", QString::KeepEmptyParts);
 #endif
-    setText(formatter.tidyAsm(lines), false);
-    setModified(true);
+
+    m_pFormatThread = new AsmFormatterThread(lines);
+    if (lines.size() < minBackgroundFormatLines) {
+        // Not worth a thread, and the caller sees the result straight away
+        m_pFormatThread->tidy();
+        slotAssemblyFormatted();
+        return;
+    }
+
+    connect(m_pFormatThread, &QThread::finished, this, &TextDocument::slotAssemblyFormatted);
+    m_pFormatThread->start();
+}
+
+void TextDocument::slotAssemblyFormatted()
+{
+    AsmFormatterThread *formatThread = m_pFormatThread;
+    m_pFormatThread = nullptr;
+    if (!formatThread)
+        return;
+
+    const QStringList &lines = formatThread->lines();
+    const QStringList &tidiedLines = formatThread->tidiedLines();
+
+    // Only the lines that tidying changed are replaced, as one undo step. Each
+    // line is tidied on its own, so a line still holding the text it had in
+    // the snapshot can take the tidied text even if lines have been added or
+    // removed around it in the meantime.
+    bool changed = false;
+    {
+        KTextEditor::Document::EditingTransaction transaction(m_doc);
+        const int count = qMin(tidiedLines.size(), m_doc->lines());
+        for (int i = 0; i < count; ++i) {
+            if (tidiedLines[i] == lines[i] || m_doc->line(i) != lines[i])
+                continue;
+            m_doc->replaceText(KTextEditor::Range(i, 0, i, lines[i].length()), tidiedLines[i]);
+            changed = true;
+        }
+    }
+
+    delete formatThread;
+
+    if (changed)
+        setModified(true);
 }
 
 void TextDocument::fileSave(const QUrl &url)
@@ -809,6 +876,35 @@ void TextDocument::debugStop()
 #endif // !NO_GPSIM
 }
 
+void TextDocument::debugProfile(bool profiling)
+{
+#ifndef NO_GPSIM
+    if (!m_pDebugger)
+        return;
+
+    m_pDebugger->gpsim()->setProfiling(profiling);
+    updateHeatMarks();
+    slotInitDebugActions();
+#else
+    Q_UNUSED(profiling);
+#endif // !NO_GPSIM
+}
+
+void TextDocument::debugExportProfile()
+{
+#ifndef NO_GPSIM
+    if (!m_pDebugger || !m_pDebugger->gpsim()->isProfiling())
+        return;
+
+    const QString fileName = QFileDialog::getSaveFileName(nullptr, i18n("Export Profile"), QString(), i18n("CSV Files (*.csv);;All Files (*)"));
+    if (fileName.isEmpty())
+        return;
+
+    if (!m_pDebugger->exportProfile(fileName))
+        KMessageBox::error(nullptr, i18n("Could not open '%1' for writing. Check that you have write permissions", fileName), i18n("Saving File"));
+#endif // !NO_GPSIM
+}
+
 void TextDocument::debugStep()
 {
 #ifndef NO_GPSIM
@@ -867,6 +963,13 @@ void TextDocument::slotDebugSetCurrentLine(const SourceLine &line)
 void TextDocument::slotInitDebugActions()
 {
 #ifndef NO_GPSIM
+    if (debuggerIsProfiling())
+        m_pProfileTimer->start(1000);
+    else {
+        m_pProfileTimer->stop();
+        updateHeatMarks();
+    }
+
     if (m_pDebugger) {
         if (m_pDebugger->gpsim()->isRunning())
             slotDebugSetCurrentLine(SourceLine());
@@ -905,6 +1008,7 @@ void TextDocument::slotDebuggerDestroyed()
 #ifndef NO_GPSIM
     slotDebugSetCurrentLine(SourceLine());
     m_pDebugger = nullptr;
+    updateHeatMarks();
     m_debugFile = QString();
     slotInitDebugActions();
 #endif // !NO_GPSIM
@@ -983,6 +1087,51 @@ bool TextDocument::debuggerIsStepping() const
     return m_pDebugger && !m_pDebugger->gpsim()->isRunning();
 }
 
+bool TextDocument::debuggerIsProfiling() const
+{
+    return m_pDebugger && m_pDebugger->gpsim()->isProfiling();
+}
+
+void TextDocument::updateHeatMarks()
+{
+    KTextEditor::MarkInterface *iface = qobject_cast<KTextEditor::MarkInterface *>(m_doc);
+    if (!iface)
+        return;
+
+    QHash<int, uint> heatMarks;
+    if (debuggerIsProfiling()) {
+        const QMap<int, unsigned long long> lineCycles = m_pDebugger->lineCycles(m_debugFile);
+
+        unsigned long long maxCycles = 0;
+        for (unsigned long long cycles : lineCycles)
+            maxCycles = std::max(maxCycles, cycles);
+
+        for (QMap<int, unsigned long long>::const_iterator it = lineCycles.begin(); it != lineCycles.end(); ++it) {
+            const double heat = double(it.value()) / maxCycles;
+            if (heat >= 0.5)
+                heatMarks[it.key()] = HeatHighest;
+            else if (heat >= 0.2)
+                heatMarks[it.key()] = HeatHigh;
+            else if (heat >= 0.05)
+                heatMarks[it.key()] = HeatMedium;
+            else
+                heatMarks[it.key()] = HeatLow;
+        }
+    }
+
+    // Only the lines whose heat has changed are touched, so that the border
+    // is not redrawn every time
+    for (QHash<int, uint>::const_iterator it = m_heatMarks.constBegin(); it != m_heatMarks.constEnd(); ++it) {
+        if (heatMarks.value(it.key()) != it.value())
+            iface->removeMark(it.key(), it.value());
+    }
+    for (QHash<int, uint>::const_iterator it = heatMarks.constBegin(); it != heatMarks.constEnd(); ++it) {
+        if (m_heatMarks.value(it.key()) != it.value())
+            iface->addMark(it.key(), it.value());
+    }
+    m_heatMarks = heatMarks;
+}
+
 void TextDocument::setDebugger(GpsimDebugger *debugger, bool ownDebugger)
 {
     if (debugger == m_pDebugger)
@@ -1063,4 +1212,24 @@ const QPixmap *TextDocument::executionPointPixmap()
     return &pixmap;
 }
 
+const QPixmap *TextDocument::heatPixmap(MarkType markType)
+{
+    // From a pale yellow for the lines that took the fewest cycles to a deep
+    // red for those that took the most
+    static QPixmap pixmaps[4];
+    static const QColor colors[4] = {QColor(255, 236, 140), QColor(255, 176, 64), QColor(240, 96, 32), QColor(200, 0, 0)};
+
+    const int index = (markType == HeatHighest) ? 3 : (markType == HeatHigh) ? 2 : (markType == HeatMedium) ? 1 : 0;
+    QPixmap &pixmap = pixmaps[index];
+    if (pixmap.isNull()) {
+        pixmap = QPixmap(11, 16);
+        pixmap.fill(Qt::transparent);
+        QPainter p(&pixmap);
+        p.fillRect(3, 1, 5, 14, colors[index]);
+        p.setPen(colors[index].darker(150));
+        p.drawRect(3, 1, 4, 13);
+    }
+    return &pixmap;
+}
+
 #include "moc_textdocument.cpp"
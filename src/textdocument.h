@@ -15,6 +15,7 @@
 #include "document.h"
 #include "gpsimprocessor.h"
 
+#include <QHash>
 #include <QPointer>
 // #include <q3ptrlist.h>
 
@@ -22,9 +23,11 @@
 #include <KTextEditor/Document>
 #include <KTextEditor/MarkInterface>
 
+class AsmFormatterThread;
 class GpsimDebugger;
 class SourceLine;
 class TextView;
+class QTimer;
 
 namespace KTextEditor
 {
@@ -47,6 +50,13 @@ public:
 
     enum MarkType {
         Breakpoint = KTextEditor::MarkInterface::markType10,
+        // How many of the profiled cycles were spent on the line, compared
+        // to the line that took the most
+        HeatLow = KTextEditor::MarkInterface::markType11,
+        HeatMedium = KTextEditor::MarkInterface::markType12,
+        HeatHigh = KTextEditor::MarkInterface::markType13,
+        HeatHighest = KTextEditor::MarkInterface::markType14,
+        HeatMarks = HeatLow | HeatMedium | HeatHigh | HeatHighest,
     };
 
     View *createView(ViewContainer *viewContainer, uint viewAreaId) override;
@@ -118,6 +128,10 @@ public:
         return m_debugFile;
     }
     virtual void clearBreakpoints();
+    /**
+     * @return whether the debugger is counting the cycles spent on each line
+     */
+    bool debuggerIsProfiling() const;
 #endif
 
     bool openURL(const QUrl &url) override;
@@ -169,6 +183,10 @@ public:
     static const QPixmap *reachedBreakpointPixmap();
     static const QPixmap *disabledBreakpointPixmap();
     static const QPixmap *executionPointPixmap();
+    /**
+     * @param markType one of the heat marks, e.g. HeatLow
+     */
+    static const QPixmap *heatPixmap(MarkType markType);
     /**
      * Returns a TextView pointer to the active TextView (if there is one)
      */
@@ -201,6 +219,12 @@ public slots:
     void debugStepOver();
     void debugStepOut();
     void debugStop() override;
+    /**
+     * Sets whether the debugger counts the cycles spent on each line, which
+     * are shown by the heat marks in the border.
+     */
+    void debugProfile(bool profiling);
+    void debugExportProfile();
     void slotInitLanguage(CodeType type);
     /**
      * Called when change line / toggle marks
@@ -229,6 +253,11 @@ protected:
      * marks that we know about
      */
     void syncBreakpoints();
+    /**
+     * Sets the heat marks from the cycles the debugger has counted, or
+     * removes them if it is not profiling.
+     */
+    void updateHeatMarks();
 
     int m_lastDebugLineAt; // Last line with a debug point reached mark
     bool m_bLoadDebuggerAsHLL;
@@ -240,6 +269,10 @@ protected:
 private slots:
     void setLastTextOutputTarget(TextDocument *target);
     void slotSyncModifiedStates();
+    /**
+     * Called when m_pFormatThread has finished, to apply the tidied lines.
+     */
+    void slotAssemblyFormatted();
     void slotCODCreationSucceeded();
     void slotCODCreationFailed();
     void slotDebuggerDestroyed();
@@ -251,6 +284,7 @@ private:
     bool m_constructorSuccessful;
     CodeType m_guessedCodeType;
     QList<QAction *> m_bookmarkActions;
+    AsmFormatterThread *m_pFormatThread; // Formatting assembly in the background, if non-null
 
 #ifndef NO_GPSIM
     bool b_lockSyncBreakpoints; // Used to avoid calling syncMarks() when we are currently doing so
@@ -258,6 +292,8 @@ private:
     QPointer<GpsimDebugger> m_pDebugger;
     QString m_symbolFile;
     QString m_debugFile;
+    QTimer *m_pProfileTimer; // Updates the heat marks while profiling
+    QHash<int, uint> m_heatMarks; // The heat mark on each line that has one
 #endif
 };
 
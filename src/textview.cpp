@@ -136,6 +136,19 @@ TextView::TextView(TextDocument *textDocument, ViewContainer *viewContainer, uin
         connect(action, &QAction::triggered, textDocument, &TextDocument::debugStepOut);
         ac->addAction(action->objectName(), action);
     }
+    {
+        QAction *action = new QAction(QIcon::fromTheme("office-chart-bar"), i18n("Profile Cycles"), ac);
+        action->setObjectName("debug_profile");
+        action->setCheckable(true);
+        connect(action, &QAction::triggered, textDocument, &TextDocument::debugProfile);
+        ac->addAction(action->objectName(), action);
+    }
+    {
+        QAction *action = new QAction(QIcon::fromTheme("document-export"), i18n("Export Profile..."), ac);
+        action->setObjectName("debug_export_profile");
+        connect(action, &QAction::triggered, textDocument, &TextDocument::debugExportProfile);
+        ac->addAction(action->objectName(), action);
+    }
     // END Debug Actions
 #endif
 
@@ -527,6 +540,11 @@ void TextView::slotInitDebugActions()
     actionByName("debug_step")->setEnabled(isRunning && isStepping);
     actionByName("debug_step_over")->setEnabled(isRunning && isStepping);
     actionByName("debug_step_out")->setEnabled(isRunning && isStepping);
+
+    const bool isProfiling = textDocument()->debuggerIsProfiling();
+    actionByName("debug_profile")->setEnabled(isRunning);
+    actionByName("debug_profile")->setChecked(isProfiling);
+    actionByName("debug_export_profile")->setEnabled(isProfiling);
 #endif // !NO_GPSIM
 }
 
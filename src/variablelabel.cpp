@@ -34,6 +34,11 @@ VariableLabel::VariableLabel(TextView *parent)
     adjustSize();
 }
 
+VariableLabel::~VariableLabel()
+{
+    disconnectRegisterInfo();
+}
+
 void VariableLabel::setRegister(RegisterInfo *info, const QString &name)
 {
     disconnectRegisterInfo();
@@ -47,6 +52,7 @@ void VariableLabel::setRegister(RegisterInfo *info, const QString &name)
 
     connect(m_pRegisterInfo, &RegisterInfo::destroyed, this, &VariableLabel::hide);
     connect(m_pRegisterInfo, &RegisterInfo::valueChanged, this, &VariableLabel::updateText);
+    m_pRegisterInfo->watch();
 
     updateText();
 }
@@ -58,6 +64,7 @@ void VariableLabel::disconnectRegisterInfo()
 
     disconnect(m_pRegisterInfo, &RegisterInfo::destroyed, this, &VariableLabel::hide);
     disconnect(m_pRegisterInfo, &RegisterInfo::valueChanged, this, &VariableLabel::updateText);
+    m_pRegisterInfo->unwatch();
 
     m_pRegisterInfo = nullptr;
     m_registerName = QString();
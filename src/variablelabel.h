@@ -31,6 +31,7 @@ class VariableLabel : public QLabel
     Q_OBJECT
 public:
     VariableLabel(TextView *parent);
+    ~VariableLabel() override;
     /**
      * Sets the register that this label is displaying the value of.
      */
@@ -24,6 +24,9 @@ Variant::Variant(const QString &id, Type::Value type)
     , m_id(id)
 {
     m_type = type;
+    m_doubleValue = 0.0;
+    m_intValue = 0;
+    m_boolValue = false;
     m_bSetDefault = false;
     m_bHidden = false;
     m_bAdvanced = false;
@@ -131,6 +134,9 @@ void Variant::setValue(QVariant val)
 
     const QVariant old = m_value;
     m_value = val;
+    m_doubleValue = m_value.toDouble();
+    m_intValue = m_value.toInt();
+    m_boolValue = m_value.toBool();
     emit(valueChanged(val, old));
 
     switch (type()) {
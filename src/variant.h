@@ -234,6 +234,23 @@ public:
     {
         return m_value;
     }
+    /**
+     * The value converted to a double, int or bool. These are converted
+     * once when the value is set, so are cheap to read (unlike converting
+     * value() each time).
+     */
+    double doubleValue() const
+    {
+        return m_doubleValue;
+    }
+    int intValue() const
+    {
+        return m_intValue;
+    }
+    bool boolValue() const
+    {
+        return m_boolValue;
+    }
     void setValue(QVariant val);
 
 signals:
@@ -273,6 +290,9 @@ signals:
 
 private:
     QVariant m_value; // the actual data
+    double m_doubleValue; // m_value.toDouble()
+    int m_intValue;       // m_value.toInt()
+    bool m_boolValue;     // m_value.toBool()
     QVariant m_defaultValue;
     QString m_unit;
     const QString m_id;
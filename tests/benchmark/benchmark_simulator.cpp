@@ -0,0 +1,259 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+/*
+ * benchmark_simulator: simulates each of the circuits given on the command
+ * line for a fixed amount of simulated time, and writes one CSV row per
+ * circuit with the linear steps per second, the time spent solving and in
+ * LU decompositions, and the memory the circuit took.
+ *
+ * With --baseline, the steps per second are compared against the rows of an
+ * earlier run, and the exit status is non-zero if any circuit has become
+ * slower than --tolerance allows.
+ *
+ * A circuit that is driven by the user (with switches, keypads or
+ * potentiometers) can be given a stimulus of the same name next to it (e.g.
+ * keypad.stimulus for keypad.circuit), recorded with Tools > Record Stimulus,
+ * which is replayed from the start of the warmup.
+ */
+
+#include "circuitdocument.h"
+#include "headless.h"
+#include "simulator.h"
+#include "stimulus.h"
+
+#include <KLocalizedString>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QTextStream>
+
+#include <algorithm>
+
+using Headless::printError;
+using Headless::processPendingEvents;
+using Headless::runSteps;
+
+/**
+ * @return the value of the given field (e.g. "VmRSS") of /proc/self/status
+ * in kB, or -1 where that is not available.
+ */
+static long memoryKb(const char *field)
+{
+    QFile file("/proc/self/status");
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return -1;
+
+    const QByteArray prefix = QByteArray(field) + ':';
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine();
+        if (line.startsWith(prefix))
+            return line.mid(prefix.size()).trimmed().split(' ').first().toLong();
+    }
+    return -1;
+}
+
+/**
+ * @return the steps per second of each circuit in a CSV file written by an
+ * earlier run, keyed on the circuit name.
+ */
+static QMap<QString, double> readBaseline(const QString &fileName, bool *ok)
+{
+    QMap<QString, double> baseline;
+
+    QFile file(fileName);
+    *ok = file.open(QIODevice::ReadOnly | QIODevice::Text);
+    if (!*ok)
+        return baseline;
+
+    QTextStream stream(&file);
+    const QStringList header = stream.readLine().split(',');
+    const int nameColumn = header.indexOf("circuit");
+    const int stepsColumn = header.indexOf("steps_per_s");
+    *ok = (nameColumn >= 0 && stepsColumn >= 0);
+    if (!*ok)
+        return baseline;
+
+    while (!stream.atEnd()) {
+        const QStringList fields = stream.readLine().split(',');
+        if (fields.size() > std::max(nameColumn, stepsColumn))
+            baseline[fields[nameColumn]] = fields[stepsColumn].toDouble();
+    }
+    return baseline;
+}
+
+int main(int argc, char **argv)
+{
+    Headless::useOffscreenPlatform();
+
+    QApplication app(argc, argv);
+    QCoreApplication::setApplicationName("ktechlab");
+    KLocalizedString::setApplicationDomain("ktechlab");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(i18n("Measures how fast circuits are simulated"));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("circuits"), i18n("The circuits to simulate."), i18n("circuit..."));
+
+    QCommandLineOption timeOption(QStringList() << "t" << "time", i18n("Simulated time to run each circuit for, in seconds (default 1)."), i18n("seconds"), "1");
+    QCommandLineOption warmupOption("warmup", i18n("Simulated time to run each circuit for before measuring, in seconds (default 0.05)."), i18n("seconds"), "0.05");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", i18n("File to write the results to, instead of standard output."), i18n("file"));
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads", i18n("Number of threads for solving separate circuits (default 1)."), i18n("count"), "1");
+    QCommandLineOption baselineOption(QStringList() << "b" << "baseline", i18n("Results of an earlier run to compare the steps per second against."), i18n("file"));
+    QCommandLineOption toleranceOption("tolerance", i18n("How much slower than the baseline a circuit may be, in percent (default 20)."), i18n("percent"), "20");
+    parser.addOption(timeOption);
+    parser.addOption(warmupOption);
+    parser.addOption(outputOption);
+    parser.addOption(threadsOption);
+    parser.addOption(baselineOption);
+    parser.addOption(toleranceOption);
+
+    parser.process(app);
+
+    const QStringList circuits = parser.positionalArguments();
+    if (circuits.isEmpty())
+        parser.showHelp(1);
+
+    const long long measuredSteps = qRound64(parser.value(timeOption).toDouble() * LINEAR_UPDATE_RATE);
+    const long long warmupSteps = qRound64(parser.value(warmupOption).toDouble() * LINEAR_UPDATE_RATE);
+    if (measuredSteps <= 0 || warmupSteps < 0) {
+        printError(i18n("Invalid time: %1", parser.value(timeOption)));
+        return 1;
+    }
+    const double tolerance = parser.value(toleranceOption).toDouble() / 100.;
+
+    QMap<QString, double> baseline;
+    if (parser.isSet(baselineOption)) {
+        bool ok = false;
+        baseline = readBaseline(parser.value(baselineOption), &ok);
+        if (!ok) {
+            printError(i18n("Could not read the baseline %1", parser.value(baselineOption)));
+            return 1;
+        }
+    }
+
+    QFile outputFile;
+    if (parser.isSet(outputOption)) {
+        outputFile.setFileName(parser.value(outputOption));
+        if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            printError(i18n("Could not open '%1' for writing", outputFile.fileName()));
+            return 1;
+        }
+    } else {
+        outputFile.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+    }
+    QTextStream output(&outputFile);
+
+    HeadlessSession *session = new HeadlessSession();
+    Simulator *simulator = session->simulator();
+    simulator->setSolverThreadCount(parser.value(threadsOption).toInt());
+    simulator->setTimingEnabled(true);
+
+    output << "circuit,circuits,equations,sparse_circuits,steps,elapsed_s,steps_per_s,step_us,solve_ms,factorization_ms,"
+              "factorizations,restored_factorizations,newton_iterations,logic_events,gpsim_cycles,memory_kb\n";
+
+    int failed = 0;
+    int regressed = 0;
+
+    for (QStringList::const_iterator it = circuits.begin(); it != circuits.end(); ++it) {
+        const QUrl url = QUrl::fromUserInput(*it, QDir::currentPath(), QUrl::AssumeLocalFile);
+        const QString name = QFileInfo(url.toLocalFile()).completeBaseName();
+
+        const long memoryBefore = memoryKb("VmRSS");
+
+        CircuitDocument *document = new CircuitDocument(url.fileName());
+        if (!document->openURL(url)) {
+            printError(i18n("Could not load %1", url.toDisplayString()));
+            delete document;
+            failed++;
+            continue;
+        }
+        processPendingEvents();
+
+        const QString stimulusFileName = QFileInfo(url.toLocalFile()).path() + '/' + name + ".stimulus";
+        if (QFile::exists(stimulusFileName)) {
+            QFile stimulusFile(stimulusFileName);
+            Stimulus stimulus;
+            QString errorMessage;
+            if (!stimulusFile.open(QIODevice::ReadOnly | QIODevice::Text) || !stimulus.load(&stimulusFile, &errorMessage)) {
+                printError(i18n("Could not read the stimulus %1: %2", stimulusFileName, errorMessage.isEmpty() ? stimulusFile.errorString() : errorMessage));
+                delete document;
+                failed++;
+                continue;
+            }
+            document->playStimulus(stimulus);
+        }
+
+        runSteps(simulator, warmupSteps);
+        simulator->resetStatistics();
+
+        QElapsedTimer timer;
+        timer.start();
+        runSteps(simulator, measuredSteps);
+        const qint64 elapsedNs = timer.nsecsElapsed();
+
+        const SimulatorStatistics statistics = simulator->statistics();
+        const long memoryAfter = memoryKb("VmRSS");
+
+        int equations = 0;
+        int sparseCircuits = 0;
+        qint64 solveNs = 0;
+        qint64 factorizationNs = 0;
+        unsigned long factorizations = 0;
+        unsigned long restoredFactorizations = 0;
+        unsigned long newtonIterations = 0;
+        for (std::vector<CircuitStatistics>::const_iterator c = statistics.circuits.begin(); c != statistics.circuits.end(); ++c) {
+            equations += c->equations;
+            if (c->sparse)
+                sparseCircuits++;
+            solveNs += c->stats.solveNs;
+            factorizationNs += c->factorizationNs;
+            factorizations += c->factorizations;
+            restoredFactorizations += c->restoredFactorizations;
+            newtonIterations += c->nonLinearStats.iterations;
+        }
+
+        const double elapsedS = elapsedNs * 1e-9;
+        const double stepsPerS = (elapsedNs > 0) ? statistics.steps / elapsedS : 0.;
+
+        output << name << ',' << statistics.circuits.size() << ',' << equations << ',' << sparseCircuits << ',' << statistics.steps << ',' << elapsedS << ',' << qRound64(stepsPerS) << ','
+               << (statistics.steps > 0 ? elapsedNs * 1e-3 / statistics.steps : 0.) << ',' << solveNs * 1e-6 << ',' << factorizationNs * 1e-6 << ',' << factorizations << ',' << restoredFactorizations << ','
+               << newtonIterations << ',' << statistics.logicEvents << ',' << statistics.gpsimCycles << ',' << ((memoryBefore >= 0 && memoryAfter >= 0) ? memoryAfter - memoryBefore : -1) << '\n';
+        output.flush();
+
+        if (baseline.contains(name)) {
+            const double expected = baseline[name];
+            if (stepsPerS < expected * (1. - tolerance)) {
+                printError(i18n("%1: %2 steps/s, down from %3", name, qRound64(stepsPerS), qRound64(expected)));
+                regressed++;
+            }
+        }
+
+        delete document;
+        processPendingEvents();
+    }
+
+    const long peakMemory = memoryKb("VmHWM");
+    if (peakMemory >= 0)
+        printError(i18n("Peak memory: %1 kB", peakMemory));
+
+    delete session;
+
+    if (failed > 0)
+        printError(i18n("%1 of %2 circuits could not be loaded", failed, circuits.size()));
+    if (regressed > 0)
+        printError(i18n("%1 of %2 circuits are slower than the baseline", regressed, circuits.size()));
+    return (failed > 0 || regressed > 0) ? 1 : 0;
+}
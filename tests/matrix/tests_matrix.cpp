@@ -0,0 +1,609 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+/*
+ * tests_matrix: solves random systems shaped like the MNA equations of a
+ * circuit (conductances between nodes and to ground, and voltage sources as
+ * branch rows with a zero diagonal) with the solvers of Matrix, and checks
+ * them against the dense solver on the same values. Also checks the
+ * vectorised kernels of the dense solver against the plain loops.
+ */
+
+#include "math/qkernels.h"
+#include "matrix.h"
+#include "sparselu.h"
+
+#include <QTest>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+/**
+A random circuit: a chain through all the nodes (so that it is connected),
+some more conductances between random nodes, a conductance from every node to
+ground, and voltage sources from random nodes to ground (or to another node,
+if given a return node before stamping).
+ */
+class RandomCircuit
+{
+public:
+    class Conductance
+    {
+    public:
+        int a, b; ///< the nodes, b being -1 for ground
+        double g;
+    };
+
+    RandomCircuit(unsigned nodes, unsigned branches, unsigned extra, unsigned seed)
+        : nodeCount(nodes)
+        , branchNodes(branches)
+        , branchReturns(branches, -1)
+    {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<double> value(0.1, 10.);
+
+        // The nodes are numbered at random along the chain, as they are by
+        // the partitions of a real circuit
+        std::vector<int> order(nodes);
+        for (unsigned i = 0; i < nodes; i++)
+            order[i] = i;
+        std::shuffle(order.begin(), order.end(), random);
+        for (unsigned i = 1; i < nodes; i++)
+            conductances.push_back({order[i - 1], order[i], value(random)});
+
+        for (unsigned i = 0; i < extra; i++) {
+            const int a = random() % nodes;
+            const int b = random() % nodes;
+            if (a != b)
+                conductances.push_back({a, b, value(random)});
+        }
+        for (unsigned i = 0; i < nodes; i++)
+            conductances.push_back({int(i), -1, 1e-3 * value(random)});
+
+        for (unsigned k = 0; k < branches; k++)
+            branchNodes[k] = random() % nodes;
+
+        rhs.resize(nodes + branches);
+        for (double &x : rhs)
+            x = value(random) - 5.;
+    }
+
+    /**
+     * Gives the matrix its pattern, lets it pick a solver, and then adds the
+     * values.
+     */
+    void stamp(Matrix *matrix, bool allowSparse) const
+    {
+        for (const Conductance &c : conductances) {
+            matrix->setUse(c.a, c.a);
+            if (c.b >= 0) {
+                matrix->setUse(c.b, c.b);
+                matrix->setUse(c.a, c.b);
+                matrix->setUse(c.b, c.a);
+            }
+        }
+        for (unsigned k = 0; k < branchNodes.size(); k++) {
+            matrix->setUse(branchNodes[k], nodeCount + k);
+            matrix->setUse(nodeCount + k, branchNodes[k]);
+            if (branchReturns[k] >= 0) {
+                matrix->setUse(branchReturns[k], nodeCount + k);
+                matrix->setUse(nodeCount + k, branchReturns[k]);
+            }
+        }
+        matrix->createMap(allowSparse);
+
+        for (const Conductance &c : conductances)
+            addConductance(matrix, c.a, c.b, c.g);
+        for (unsigned k = 0; k < branchNodes.size(); k++) {
+            matrix->b(branchNodes[k], k) = 1.;
+            matrix->c(k, branchNodes[k]) = 1.;
+            if (branchReturns[k] >= 0) {
+                matrix->b(branchReturns[k], k) = -1.;
+                matrix->c(k, branchReturns[k]) = -1.;
+            }
+        }
+    }
+
+    static void addConductance(Matrix *matrix, int a, int b, double g)
+    {
+        matrix->add(a, a, g);
+        if (b >= 0) {
+            matrix->add(b, b, g);
+            matrix->add(a, b, -g);
+            matrix->add(b, a, -g);
+        }
+    }
+
+    unsigned nodeCount;
+    std::vector<unsigned> branchNodes; ///< the node of each voltage source
+    std::vector<int> branchReturns; ///< the other node of each, or -1 for ground
+    std::vector<Conductance> conductances;
+    std::vector<double> rhs;
+};
+
+class MatrixTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    /**
+     * @return the solution of the matrix for the right side
+     */
+    static std::vector<double> solve(Matrix *matrix, const std::vector<double> &rhs)
+    {
+        matrix->performLU();
+        QuickVector x(rhs.size());
+        std::copy(rhs.begin(), rhs.end(), x.data());
+        matrix->fbSub(&x);
+        return std::vector<double>(x.data(), x.data() + rhs.size());
+    }
+
+    /**
+     * @return the solution of the circuit with the dense solver, on a
+     * matrix of its own
+     */
+    static std::vector<double> solveDense(const RandomCircuit &circuit)
+    {
+        Matrix matrix(circuit.nodeCount, circuit.branchNodes.size());
+        circuit.stamp(&matrix, false);
+        return solve(&matrix, circuit.rhs);
+    }
+
+    /**
+     * @return the largest difference between the solutions, relative to the
+     * largest value in the expected one
+     */
+    static double difference(const std::vector<double> &actual, const std::vector<double> &expected)
+    {
+        double largest = 0.;
+        double diff = 0.;
+        for (unsigned i = 0; i < expected.size(); i++) {
+            largest = std::max(largest, std::abs(expected[i]));
+            diff = std::max(diff, std::abs(actual[i] - expected[i]));
+        }
+        return diff / largest;
+    }
+
+private slots:
+    void initTestCase()
+    {
+        SparseLU::clearStructureCache();
+    }
+
+    void cleanup()
+    {
+        // In case a test of mixed precision failed part way through
+        Matrix::setMixedPrecision(false);
+    }
+
+    void testSparseMatchesDense_data()
+    {
+        QTest::addColumn<unsigned>("nodes");
+        QTest::addColumn<unsigned>("branches");
+
+        QTest::newRow("small") << 40u << 4u;
+        QTest::newRow("medium") << 120u << 10u;
+        // Enough nodes to be ordered by nested dissection
+        QTest::newRow("dissected") << 2 * SparseLU::DISSECTION_MIN_NODES << 12u;
+    }
+
+    void testSparseMatchesDense()
+    {
+        QFETCH(unsigned, nodes);
+        QFETCH(unsigned, branches);
+
+        RandomCircuit circuit(nodes, branches, nodes / 2, nodes);
+        Matrix matrix(nodes, branches);
+        circuit.stamp(&matrix, true);
+        QVERIFY(matrix.setSolverType(Matrix::SparseSolver));
+        if (nodes >= SparseLU::DISSECTION_MIN_NODES)
+            QVERIFY(!matrix.m_sparse->m_structure->blockStart.empty());
+        QVERIFY(difference(solve(&matrix, circuit.rhs), solveDense(circuit)) < 1e-10);
+
+        // Changing a conductance marks the factorization as needing redoing
+        // from its row, so only the rows after that one are refactored
+        unsigned last = 0;
+        for (unsigned i = 0; i < nodes; i++) {
+            if (matrix.m_sparse->permutation()[i] > matrix.m_sparse->permutation()[last])
+                last = i;
+        }
+        const unsigned long factorizations = matrix.factorizationCount();
+        RandomCircuit::addConductance(&matrix, last, -1, 2.5);
+        circuit.conductances.push_back({int(last), -1, 2.5});
+        QVERIFY(matrix.isChanged());
+        QVERIFY(matrix.max_k > 0);
+        QVERIFY(difference(solve(&matrix, circuit.rhs), solveDense(circuit)) < 1e-10);
+        QCOMPARE(matrix.factorizationCount(), factorizations + 1);
+
+        // And the same for a change nearer the start
+        RandomCircuit::addConductance(&matrix, circuit.conductances[0].a, circuit.conductances[0].b, 0.75);
+        circuit.conductances.push_back({circuit.conductances[0].a, circuit.conductances[0].b, 0.75});
+        QVERIFY(difference(solve(&matrix, circuit.rhs), solveDense(circuit)) < 1e-10);
+    }
+
+    void testSparseStructureCache()
+    {
+        SparseLU::clearStructureCache();
+
+        // The same connectivity with different values, as when a circuit is
+        // rebuilt after a value is edited, takes the ordering from the cache
+        const RandomCircuit first(80, 6, 40, 1);
+        RandomCircuit second(80, 6, 40, 1);
+        for (RandomCircuit::Conductance &c : second.conductances)
+            c.g *= 1.5;
+
+        Matrix firstMatrix(80, 6);
+        first.stamp(&firstMatrix, true);
+        QVERIFY(firstMatrix.setSolverType(Matrix::SparseSolver));
+        QVERIFY(!firstMatrix.m_sparse->structureWasCached());
+
+        Matrix secondMatrix(80, 6);
+        second.stamp(&secondMatrix, true);
+        QVERIFY(secondMatrix.setSolverType(Matrix::SparseSolver));
+        QVERIFY(secondMatrix.m_sparse->structureWasCached());
+        QVERIFY(secondMatrix.m_sparse->permutation() == firstMatrix.m_sparse->permutation());
+
+        QVERIFY(difference(solve(&firstMatrix, first.rhs), solveDense(first)) < 1e-10);
+        QVERIFY(difference(solve(&secondMatrix, second.rhs), solveDense(second)) < 1e-10);
+
+        // A different connectivity does not
+        const RandomCircuit other(80, 6, 40, 2);
+        Matrix otherMatrix(80, 6);
+        other.stamp(&otherMatrix, true);
+        QVERIFY(otherMatrix.setSolverType(Matrix::SparseSolver));
+        QVERIFY(!otherMatrix.m_sparse->structureWasCached());
+        QVERIFY(difference(solve(&otherMatrix, other.rhs), solveDense(other)) < 1e-10);
+    }
+
+    void testLUCache()
+    {
+        // Going back to earlier values restores their factorization
+        RandomCircuit circuit(60, 4, 30, 3);
+        Matrix matrix(60, 4);
+        circuit.stamp(&matrix, true);
+        QVERIFY(matrix.setSolverType(Matrix::SparseSolver));
+        const std::vector<double> before = solve(&matrix, circuit.rhs);
+
+        const int node = circuit.conductances[0].a;
+        RandomCircuit::addConductance(&matrix, node, -1, 4.);
+        solve(&matrix, circuit.rhs);
+        RandomCircuit::addConductance(&matrix, node, -1, -4.);
+        matrix.setChangedFrom(0);
+
+        const unsigned long restored = matrix.restoredFactorizationCount();
+        QVERIFY(difference(solve(&matrix, circuit.rhs), before) < 1e-10);
+        QCOMPARE(matrix.restoredFactorizationCount(), restored + 1);
+    }
+
+    void testLUCacheCollision_data()
+    {
+        QTest::addColumn<int>("solver");
+        QTest::addColumn<unsigned>("extra");
+
+        QTest::newRow("dense") << int(Matrix::DenseSolver) << 30u;
+        QTest::newRow("sparse") << int(Matrix::SparseSolver) << 30u;
+        QTest::newRow("banded") << int(Matrix::BandedSolver) << 0u;
+    }
+
+    void testLUCacheCollision()
+    {
+        QFETCH(int, solver);
+        QFETCH(unsigned, extra);
+
+        RandomCircuit circuit(60, 4, extra, 3);
+        Matrix matrix(60, 4);
+        circuit.stamp(&matrix, true);
+        QVERIFY(matrix.setSolverType(Matrix::SolverType(solver)));
+        solve(&matrix, circuit.rhs);
+
+        // A different matrix, with the hash of the cached factorization
+        // forced to be the same as its own, is still factorized
+        RandomCircuit changed = circuit;
+        changed.conductances[0].g += 4.;
+        RandomCircuit::addConductance(&matrix, circuit.conductances[0].a, circuit.conductances[0].b, 4.);
+        matrix.setChangedFrom(0);
+
+        std::vector<double> key;
+        matrix.luCacheKey(&key);
+        QVERIFY(!matrix.m_luCache.empty());
+        for (Matrix::CachedLU &entry : matrix.m_luCache)
+            entry.hash = Matrix::valueHash(key);
+
+        const unsigned long restored = matrix.restoredFactorizationCount();
+        QVERIFY(difference(solve(&matrix, circuit.rhs), solveDense(changed)) < 1e-10);
+        QCOMPARE(matrix.restoredFactorizationCount(), restored);
+
+        // Only the lowest bits of the values are ignored
+        QVERIFY(Matrix::sameValues({1.5}, {std::nextafter(1.5, 2.)}));
+        QVERIFY(!Matrix::sameValues({1.5}, {1.5 * (1. + 1e-9)}));
+        QVERIFY(!Matrix::sameValues(key, std::vector<double>(key.begin(), key.end() - 1)));
+    }
+
+    void testBandedMatchesDense_data()
+    {
+        QTest::addColumn<unsigned>("nodes");
+        QTest::addColumn<unsigned>("branches");
+
+        // Too small for the sparse solver to be tried
+        QTest::newRow("short ladder") << 20u << 2u;
+        QTest::newRow("ladder") << 60u << 4u;
+    }
+
+    void testBandedMatchesDense()
+    {
+        QFETCH(unsigned, nodes);
+        QFETCH(unsigned, branches);
+
+        // A ladder, with its nodes numbered at random, and the last voltage
+        // source across two neighbouring nodes of it rather than to ground
+        RandomCircuit circuit(nodes, branches, 0, nodes + 1);
+        circuit.branchNodes.back() = circuit.conductances[nodes / 2].a;
+        circuit.branchReturns.back() = circuit.conductances[nodes / 2].b;
+
+        Matrix matrix(nodes, branches);
+        circuit.stamp(&matrix, true);
+        QCOMPARE(matrix.solverType(), Matrix::BandedSolver);
+
+        // Reverse Cuthill-McKee numbers the nodes along the ladder, so each
+        // node is next to the one before it (there being no other
+        // conductances between the nodes)
+        const std::vector<unsigned> &perm = matrix.m_banded->permutation();
+        std::vector<int> rows(nodes + branches, -1);
+        for (unsigned i = 0; i < nodes; i++)
+            rows[perm[i]] = i;
+        std::vector<int> ladder;
+        for (int node : rows) {
+            if (node >= 0)
+                ladder.push_back(node);
+        }
+        QCOMPARE(unsigned(ladder.size()), nodes);
+        for (unsigned i = 1; i < nodes; i++) {
+            bool adjacent = false;
+            for (unsigned c = 0; c < nodes - 1; c++) {
+                const RandomCircuit::Conductance &g = circuit.conductances[c];
+                if ((g.a == ladder[i - 1] && g.b == ladder[i]) || (g.a == ladder[i] && g.b == ladder[i - 1]))
+                    adjacent = true;
+            }
+            QVERIFY(adjacent);
+        }
+
+        // Each branch row goes after the last of its nodes, with only other
+        // branch rows in between
+        for (unsigned k = 0; k < branches; k++) {
+            unsigned after = perm[circuit.branchNodes[k]];
+            if (circuit.branchReturns[k] >= 0)
+                after = std::max(after, perm[circuit.branchReturns[k]]);
+            QVERIFY(perm[nodes + k] > after);
+            for (unsigned row = after + 1; row < perm[nodes + k]; row++)
+                QCOMPARE(rows[row], -1);
+        }
+        QVERIFY(matrix.m_banded->bandwidth() <= 1 + branches);
+
+        // The zero diagonal of the branch rows has been filled in by the
+        // time it is reached, so the factorization without pivoting holds
+        QVERIFY(difference(solve(&matrix, circuit.rhs), solveDense(circuit)) < 1e-10);
+
+        // A change part way along is refactored from its row (or column,
+        // if that comes first)
+        unsigned middle = nodes / 2;
+        while (ladder[middle] < 2)
+            middle++;
+        const int node = ladder[middle];
+        RandomCircuit::addConductance(&matrix, node, -1, 3.);
+        circuit.conductances.push_back({node, -1, 3.});
+        QVERIFY(matrix.max_k > 0);
+        QVERIFY(difference(solve(&matrix, circuit.rhs), solveDense(circuit)) < 1e-10);
+    }
+
+    void testRankOneUpdates_data()
+    {
+        QTest::addColumn<bool>("sparse");
+
+        QTest::newRow("dense") << false;
+        QTest::newRow("sparse") << true;
+    }
+
+    void testRankOneUpdates()
+    {
+        QFETCH(bool, sparse);
+
+        RandomCircuit circuit(48, 4, 24, 5);
+        Matrix matrix(48, 4);
+        circuit.stamp(&matrix, sparse);
+        if (sparse)
+            QVERIFY(matrix.setSolverType(Matrix::SparseSolver));
+        else
+            QCOMPARE(matrix.solverType(), Matrix::DenseSolver);
+        // So that each factorization is counted as one
+        matrix.setLUCacheEnabled(false);
+        solve(&matrix, circuit.rhs);
+        const unsigned long factorizations = matrix.factorizationCount();
+
+        // Changes to the same conductance are merged, and the solution is
+        // corrected for them without refactoring
+        const RandomCircuit::Conductance toggled = circuit.conductances[0];
+        matrix.addRankOne(toggled.a, toggled.b, toggled.a, toggled.b, 2.);
+        matrix.addRankOne(toggled.a, toggled.b, toggled.a, toggled.b, 0.5);
+        QCOMPARE(unsigned(matrix.m_updates.size()), 1u);
+        QCOMPARE(matrix.m_updates[0].delta, 2.5);
+        QVERIFY(matrix.isChanged());
+        circuit.conductances.push_back({toggled.a, toggled.b, 2.5});
+        QVERIFY(difference(solve(&matrix, circuit.rhs), solveDense(circuit)) < 1e-10);
+        QCOMPARE(matrix.factorizationCount(), factorizations);
+
+        // Toggling it back leaves no update at all
+        matrix.addRankOne(toggled.a, toggled.b, toggled.a, toggled.b, -2.5);
+        QVERIFY(matrix.m_updates.empty());
+        circuit.conductances.pop_back();
+        QVERIFY(difference(solve(&matrix, circuit.rhs), solveDense(circuit)) < 1e-10);
+        QVERIFY(matrix.m_factoredUpdates.empty());
+        QCOMPARE(matrix.factorizationCount(), factorizations);
+
+        // Up to MAX_RANK_ONE_UPDATES different updates are kept...
+        for (unsigned i = 0; i < Matrix::MAX_RANK_ONE_UPDATES; i++) {
+            const RandomCircuit::Conductance c = circuit.conductances[i + 1];
+            matrix.addRankOne(c.a, c.b, c.a, c.b, 1. + i);
+            circuit.conductances.push_back({c.a, c.b, 1. + i});
+        }
+        QCOMPARE(unsigned(matrix.m_updates.size()), Matrix::MAX_RANK_ONE_UPDATES);
+        QVERIFY(difference(solve(&matrix, circuit.rhs), solveDense(circuit)) < 1e-10);
+        QCOMPARE(unsigned(matrix.m_factoredUpdates.size()), Matrix::MAX_RANK_ONE_UPDATES);
+        QCOMPARE(matrix.factorizationCount(), factorizations);
+
+        // ...and one more folds them all into the matrix to be refactored
+        const int node = circuit.branchNodes[0];
+        matrix.addRankOne(node, -1, node, -1, 0.25);
+        circuit.conductances.push_back({node, -1, 0.25});
+        QVERIFY(matrix.m_updates.empty());
+        QVERIFY(matrix.isChanged());
+        QVERIFY(difference(solve(&matrix, circuit.rhs), solveDense(circuit)) < 1e-10);
+        QVERIFY(matrix.m_factoredUpdates.empty());
+        QCOMPARE(matrix.factorizationCount(), factorizations + 1);
+
+        // An update that makes the matrix singular is not kept either: with
+        // z = A^-1 e, A - e e^T / z_other is singular
+        const int other = toggled.b;
+        std::vector<double> unit(circuit.rhs.size(), 0.);
+        unit[other] = 1.;
+        const std::vector<double> z = solve(&matrix, unit);
+        matrix.addRankOne(other, -1, other, -1, -1. / z[other]);
+        QCOMPARE(unsigned(matrix.m_updates.size()), 1u);
+        matrix.performLU();
+        QVERIFY(!matrix.isChanged());
+        QVERIFY(matrix.m_updates.empty());
+        QVERIFY(matrix.m_factoredUpdates.empty());
+        QCOMPARE(matrix.factorizationCount(), factorizations + 2);
+    }
+
+    void testMixedPrecision_data()
+    {
+        QTest::addColumn<double>("spread");
+        QTest::addColumn<bool>("converges");
+
+        QTest::newRow("well conditioned") << 1. << true;
+        // Conductances from 1e-6 to 1e6 along the ladder, which single
+        // precision cannot factorize closely enough for refinement
+        QTest::newRow("ill conditioned") << 1e6 << false;
+    }
+
+    void testMixedPrecision()
+    {
+        QFETCH(double, spread);
+        QFETCH(bool, converges);
+
+        const unsigned nodes = Matrix::MIXED_PRECISION_MIN_SIZE + 16;
+        RandomCircuit circuit(nodes, 2, 0, 7);
+        for (unsigned i = 0; i < nodes - 1; i++)
+            circuit.conductances[i].g *= (i % 2) ? spread : 1. / spread;
+
+        const std::vector<double> expected = solveDense(circuit);
+
+        Matrix::setMixedPrecision(true);
+        Matrix matrix(nodes, 2);
+        circuit.stamp(&matrix, false);
+        const std::vector<double> x = solve(&matrix, circuit.rhs);
+        Matrix::setMixedPrecision(false);
+
+        QVERIFY(difference(x, expected) < 1e-10);
+        QCOMPARE(matrix.m_bMixedPrecisionFailed, !converges);
+        QCOMPARE(matrix.m_bFloatLU, converges);
+
+        // Once refinement has failed, the matrix stays in double precision
+        if (!converges) {
+            RandomCircuit::addConductance(&matrix, circuit.conductances[0].a, -1, 1.);
+            circuit.conductances.push_back({circuit.conductances[0].a, -1, 1.});
+            Matrix::setMixedPrecision(true);
+            const std::vector<double> y = solve(&matrix, circuit.rhs);
+            Matrix::setMixedPrecision(false);
+            QVERIFY(!matrix.m_bFloatLU);
+            QVERIFY(difference(y, solveDense(circuit)) < 1e-10);
+        }
+    }
+
+    void testKernels_data()
+    {
+        QTest::addColumn<unsigned>("n");
+        QTest::addColumn<unsigned>("offset");
+
+        QTest::newRow("empty") << 0u << 0u;
+        QTest::newRow("shorter than a vector") << 3u << 0u;
+        QTest::newRow("one vector") << 4u << 0u;
+        // Leaves a tail after the steps of eight and of four
+        QTest::newRow("tails") << 15u << 1u;
+        QTest::newRow("unaligned") << 64u << 1u;
+        QTest::newRow("long") << 1001u << 3u;
+    }
+
+    void testKernels()
+    {
+        QFETCH(unsigned, n);
+        QFETCH(unsigned, offset);
+
+        // Values over six orders of magnitude and of both signs, so that the
+        // sums cancel. The vectors start offset into their buffers, so that
+        // the loads are not aligned, and end before a guard.
+        const unsigned guard = 8;
+        std::mt19937 random(n);
+        std::uniform_real_distribution<double> mantissa(-1., 1.);
+        std::uniform_int_distribution<int> exponent(-3, 3);
+        std::vector<double> x(offset + n + guard), y(offset + n + guard);
+        for (unsigned i = 0; i < x.size(); i++) {
+            x[i] = std::ldexp(mantissa(random), 3 * exponent(random));
+            y[i] = std::ldexp(mantissa(random), 3 * exponent(random));
+        }
+        const double a = -0.375;
+        const double epsilon = std::numeric_limits<double>::epsilon();
+
+        double magnitude = 0.;
+        for (unsigned i = offset; i < offset + n; i++)
+            magnitude += std::abs(x[i] * y[i]);
+
+        const QuickKernels::Implementation *scalar = QuickKernels::implementations();
+        QCOMPARE(scalar->name, "scalar");
+        const double dot = scalar->dot(x.data() + offset, y.data() + offset, n);
+        std::vector<double> axpy(y);
+        scalar->axpy(axpy.data() + offset, x.data() + offset, a, n);
+
+        bool dispatched = false;
+        for (const QuickKernels::Implementation *kernels = scalar; kernels->name; kernels++) {
+            // The terms are added in a different order and with fused
+            // multiply-adds, so each can be off by n roundings of the sum of
+            // the magnitudes
+            const double kernelDot = kernels->dot(x.data() + offset, y.data() + offset, n);
+            QVERIFY2(std::abs(kernelDot - dot) <= 2 * n * epsilon * magnitude, kernels->name);
+
+            std::vector<double> kernelAxpy(y);
+            kernels->axpy(kernelAxpy.data() + offset, x.data() + offset, a, n);
+            for (unsigned i = 0; i < y.size(); i++) {
+                if (i < offset || i >= offset + n)
+                    QVERIFY2(kernelAxpy[i] == y[i], kernels->name);
+                else
+                    QVERIFY2(std::abs(kernelAxpy[i] - axpy[i]) <= 2 * epsilon * (std::abs(y[i]) + std::abs(a * x[i])), kernels->name);
+            }
+
+            // The dispatched kernels are this version, exactly
+            if (!std::strcmp(kernels->name, QuickKernels::instructionSet())) {
+                dispatched = true;
+                QCOMPARE(QuickKernels::dot(x.data() + offset, y.data() + offset, n), kernelDot);
+                std::vector<double> dispatchedAxpy(y);
+                QuickKernels::axpy(dispatchedAxpy.data() + offset, x.data() + offset, a, n);
+                QVERIFY(dispatchedAxpy == kernelAxpy);
+            }
+        }
+        QVERIFY(dispatched);
+    }
+};
+
+QTEST_GUILESS_MAIN(MatrixTest)
+#include "tests_matrix.moc"
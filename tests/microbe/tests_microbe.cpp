@@ -0,0 +1,271 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+/*
+ * tests_microbe: splits sample Microbe lines into tokens, parses sample
+ * expressions into trees, and compiles sample programs, to pin down how the
+ * lexer based parser reads them; in particular that AND, OR, XOR and NOT are
+ * operators with or without spaces around them.
+ */
+
+#include <microbe/arena.h>
+#include <microbe/btreebase.h>
+#include <microbe/btreenode.h>
+#include <microbe/expression.h>
+#include <microbe/lexer.h>
+#include <microbe/microbe.h>
+#include <microbe/pic14.h>
+#include <microbe/variable.h>
+
+#include <QDir>
+#include <QTemporaryFile>
+#include <QTest>
+#include <QTextStream>
+
+using namespace MicrobeCompiler;
+
+Q_DECLARE_METATYPE(QVector<Token::Type>)
+
+class MicrobeTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    /**
+     * @return the types of the tokens of the lexer.
+     */
+    static QVector<Token::Type> tokenTypes(const Lexer &lexer)
+    {
+        QVector<Token::Type> types;
+        for (int i = 0; i < lexer.count(); ++i)
+            types << lexer.at(i).type;
+        return types;
+    }
+
+    /**
+     * @return the tree below the node written out as "op(left,right)", with
+     * the value of the leaves, e.g. "bwnot(,x)" for "NOT x".
+     */
+    static QString describe(const BTreeNode *node)
+    {
+        if (!node)
+            return QString();
+        if (!node->hasChildren())
+            return node->value();
+
+        static const char *const names[] = {"noop", "addition", "subtraction", "multiplication", "division", "exponent", "equals",
+                                            "notequals", "pin", "notpin", "read_keypad", "function", "bwand", "bwor", "bwxor",
+                                            "bwnot", "divbyzero", "gt", "lt", "ge", "le"};
+        return QString("%1(%2,%3)").arg(names[node->childOp()], describe(node->left()), describe(node->right()));
+    }
+
+    /**
+     * Parses the expression with x, y, z and ANDY declared as variables.
+     * @return the tree written out by describe(), followed by " !" and the
+     * errors reported if there were any.
+     */
+    static QString parse(const QString &expression)
+    {
+        Arena arena;
+        MicrobeApp mb;
+        mb.addVariable(Variable(Variable::charType, "x"));
+        mb.addVariable(Variable(Variable::charType, "y"));
+        mb.addVariable(Variable(Variable::charType, "z"));
+        mb.addVariable(Variable(Variable::charType, "ANDY"));
+
+        // The PIC is only asked whether unknown names are its registers
+        PIC14 pic(&mb, PIC14::P16F84);
+        Expression parser(&pic, &mb, SourceLineMicrobe(expression, "test.microbe", 0), false);
+        BTreeBase tree;
+        BTreeNode *root = new BTreeNode();
+        tree.setRoot(root);
+
+        const Lexer lexer(expression);
+        parser.buildTree(lexer, 0, lexer.count(), &tree, root, 0);
+
+        QString result = describe(root);
+        if (!mb.errorReport().isEmpty())
+            result += " !" + mb.errorReport().trimmed();
+        return result;
+    }
+
+private slots:
+    void testTokens_data()
+    {
+        QTest::addColumn<QString>("text");
+        QTest::addColumn<QVector<Token::Type>>("types");
+
+        QTest::newRow("leading NOT") << "NOT x" << QVector<Token::Type>{Token::Not, Token::Word};
+        QTest::newRow("AND without spaces") << "(a)AND(c)"
+                                            << QVector<Token::Type>{Token::OpenBracket, Token::Word, Token::CloseBracket, Token::And,
+                                                                    Token::OpenBracket, Token::Word, Token::CloseBracket};
+        QTest::newRow("keyword inside a name") << "ANDY OR NOTE" << QVector<Token::Type>{Token::Word, Token::Or, Token::Word};
+        QTest::newRow("lower case keyword") << "x and y" << QVector<Token::Type>{Token::Word, Token::Word, Token::Word};
+        QTest::newRow("literals") << "b'0101' XOR h'3A'" << QVector<Token::Type>{Token::Word, Token::Xor, Token::Word};
+        QTest::newRow("character") << "x = 'A' + 1"
+                                   << QVector<Token::Type>{Token::Word, Token::Assign, Token::Character, Token::Plus, Token::Word};
+        QTest::newRow("pin") << "porta.3=1" << QVector<Token::Type>{Token::Word, Token::Assign, Token::Word};
+        QTest::newRow("comparisons") << "x<=y != z>1"
+                                     << QVector<Token::Type>{Token::Word, Token::LessOrEqual, Token::Word, Token::NotEquals,
+                                                             Token::Word, Token::Greater, Token::Word};
+        QTest::newRow("block") << "while x<5 {"
+                               << QVector<Token::Type>{Token::Word, Token::Word, Token::Less, Token::Word, Token::OpenBrace};
+    }
+
+    void testTokens()
+    {
+        QFETCH(QString, text);
+        QFETCH(QVector<Token::Type>, types);
+
+        QCOMPARE(tokenTypes(Lexer(text)), types);
+    }
+
+    void testBracketMatching()
+    {
+        const Lexer nested("((x)+y)*(z");
+        QCOMPARE(nested.count(), 10);
+        QCOMPARE(nested.at(0).match, 6);
+        QCOMPARE(nested.at(6).match, 0);
+        QCOMPARE(nested.at(1).match, 3);
+        QCOMPARE(nested.at(3).match, 1);
+        QCOMPARE(nested.at(8).match, -1); // not closed
+
+        const Lexer stray("x)");
+        QCOMPARE(stray.at(1).match, -1);
+    }
+
+    void testExpressionTree_data()
+    {
+        QTest::addColumn<QString>("expression");
+        QTest::addColumn<QString>("tree");
+
+        // The operators are found whether or not there are spaces around them
+        QTest::newRow("leading NOT") << "NOT x" << "bwnot(,x)";
+        QTest::newRow("AND with spaces") << "x AND y" << "bwand(x,y)";
+        QTest::newRow("AND without spaces") << "(x)AND(y)" << "bwand(x,y)";
+        QTest::newRow("OR without spaces") << "(x)OR(h'0F')" << "bwor(x,h'0F')";
+        QTest::newRow("NOT after AND") << "x AND NOT y" << "bwand(x,bwnot(,y))";
+        QTest::newRow("NOT of brackets") << "NOT(x AND y)" << "bwnot(,bwand(x,y))";
+        QTest::newRow("keyword inside a name") << "ANDY + 1" << "addition(ANDY,1)";
+
+        // AND is split at first, before OR and XOR, wherever they are
+        QTest::newRow("AND then OR") << "x AND y OR z" << "bwand(x,bwor(y,z))";
+        QTest::newRow("OR then AND") << "x OR y AND z" << "bwand(bwor(x,y),z)";
+        QTest::newRow("XOR") << "x XOR b'0101'" << "bwxor(x,b'0101')";
+
+        // Arithmetic and comparisons
+        QTest::newRow("precedence") << "x + y * 2 == 7" << "equals(addition(x,multiplication(y,2)),7)";
+        QTest::newRow("brackets") << "(x + 1) * 2" << "multiplication(addition(x,1),2)";
+        QTest::newRow("enclosing brackets") << "((x))" << "x";
+        QTest::newRow("comparison") << "x >= 3" << "ge(x,3)";
+        QTest::newRow("bitwise in comparison") << "(x)AND(y) != 0" << "notequals(bwand(x,y),0)";
+
+        // Characters are turned into their codes, even of operators
+        QTest::newRow("character") << "x + 'A'" << "addition(x,65)";
+        QTest::newRow("operator character") << "'-' + 1" << "addition(45,1)";
+    }
+
+    void testExpressionTree()
+    {
+        QFETCH(QString, expression);
+        QFETCH(QString, tree);
+
+        QCOMPARE(parse(expression), tree);
+    }
+
+    void testExpressionMistakes_data()
+    {
+        QTest::addColumn<QString>("expression");
+
+        QTest::newRow("missing operator") << "x y";
+        QTest::newRow("consecutive operators") << "x + AND y";
+        QTest::newRow("trailing operator") << "x AND";
+        QTest::newRow("unclosed bracket") << "(x AND y";
+    }
+
+    void testExpressionMistakes()
+    {
+        QFETCH(QString, expression);
+
+        QVERIFY2(parse(expression).contains(" !"), qPrintable(parse(expression)));
+    }
+
+    void testCompile_data()
+    {
+        QTest::addColumn<QString>("program");
+        QTest::addColumn<bool>("valid");
+
+        QTest::newRow("bitwise operators") << "x = 3\n"
+                                              "y = (x)AND(h'0F')\n"
+                                              "y = NOT x\n"
+                                              "y = x XOR b'0101' OR 1\n"
+                                              "end\n"
+                                           << true;
+        QTest::newRow("control flow") << "x = 0\n"
+                                         "y = 0\n"
+                                         "if (x)AND(1) == 0 then\n"
+                                         "{\n"
+                                         "\ty = y + 1\n"
+                                         "}\n"
+                                         "else\n"
+                                         "{\n"
+                                         "\ty = 2\n"
+                                         "}\n"
+                                         "while y < 10\n"
+                                         "{\n"
+                                         "\ty = y + 1\n"
+                                         "}\n"
+                                         "for x = 1 to 5\n"
+                                         "{\n"
+                                         "\tPORTB = x\n"
+                                         "}\n"
+                                         "repeat\n"
+                                         "{\n"
+                                         "\tPORTA = y\n"
+                                         "\ty = y - 1\n"
+                                         "}\n"
+                                         "until y == 0\n"
+                                         "end\n"
+                                      << true;
+        QTest::newRow("trailing operator") << "x = 3 +\n"
+                                              "end\n"
+                                           << false;
+        QTest::newRow("missing operator") << "x = 3\n"
+                                             "y = x 2\n"
+                                             "end\n"
+                                          << false;
+    }
+
+    void testCompile()
+    {
+        QFETCH(QString, program);
+        QFETCH(bool, valid);
+
+        QTemporaryFile file(QDir::tempPath() + "/tests_microbe_XXXXXX.microbe");
+        QVERIFY(file.open());
+        {
+            QTextStream stream(&file);
+            stream << "P16F84\n" << program;
+        }
+        file.close();
+
+        MicrobeApp mb;
+        const QString assembly = mb.compile(file.fileName(), true);
+
+        if (valid) {
+            QVERIFY2(mb.errorReport().isEmpty(), qPrintable(mb.errorReport()));
+            QVERIFY(!assembly.isEmpty());
+        } else
+            QVERIFY(!mb.errorReport().isEmpty());
+    }
+};
+
+QTEST_GUILESS_MAIN(MicrobeTest)
+#include "tests_microbe.moc"
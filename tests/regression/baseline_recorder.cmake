@@ -0,0 +1,43 @@
+# Copied into a worktree of the baseline commit as tests/baseline_recorder/
+# CMakeLists.txt by record-baseline-goldens.sh; the target is not part of
+# this tree's build
+
+set(SRC_DIR ${PROJECT_SOURCE_DIR}/src/)
+
+include_directories(
+    ${SRC_DIR}  # needed for subdirs
+    ${SRC_DIR}/core
+    ${CMAKE_BINARY_DIR}/src/core  # for the kcfg file
+    ${SRC_DIR}/drawparts
+    ${SRC_DIR}/electronics
+    ${SRC_DIR}/electronics/components
+    ${SRC_DIR}/electronics/simulation
+    ${SRC_DIR}/flowparts
+    ${SRC_DIR}/gui
+    ${CMAKE_BINARY_DIR}/src/gui  # for ui-generated files
+    ${SRC_DIR}/gui/itemeditor
+    ${SRC_DIR}/languages
+    ${SRC_DIR}/mechanics
+    ${SRC_DIR}/micro
+)
+if(GPSim_FOUND)
+    include_directories(SYSTEM ${GPSim_INCLUDE_DIRS})
+    kde_enable_exceptions()
+endif()
+
+add_executable(baseline_recorder baseline_recorder.cpp)
+
+target_link_libraries( baseline_recorder
+    test_ktechlab
+    KF5::ConfigCore
+    KF5::ConfigGui
+    KF5::KIOCore
+    KF5::CoreAddons
+    KF5::XmlGui
+    KF5::TextEditor
+
+    Qt5::Widgets
+)
+if(GPSim_FOUND)
+    target_link_libraries(baseline_recorder ${GPSim_LIBRARIES})
+endif()
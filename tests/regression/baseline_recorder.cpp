@@ -0,0 +1,206 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+/*
+ * baseline_recorder: records the golden traces of regression_simulator with
+ * the simulator as it was before the faster solvers, the adaptive integration
+ * and the timing wheel, so that the regression test checks the current
+ * simulator against an independent one rather than against itself.
+ *
+ * This is not built in this tree. record-baseline-goldens.sh builds it in a
+ * worktree of the baseline commit, and so it only uses what that commit has:
+ * no headless session, no Simulator::runSteps and no probe data export. The
+ * simulator is stepped through its timer slot, with the timer stopped, and the
+ * samples are read from the probes' data directly. The traces are written in
+ * the format of regression_simulator, on the same grid of times.
+ */
+
+#include "docmanager.h"
+#include "document.h"
+#include "electronics/circuitdocument.h"
+#include "electronics/components/probe.h"
+#include "ktechlab.h"
+#include "oscilloscopedata.h"
+#include "simulator.h"
+
+#include <KLocalizedString>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+/**
+Reads the samples that the baseline keeps to itself (its oscilloscope is a
+friend of the probe data, and nothing else needs them).
+*/
+class FloatingProbeAccess : public FloatingProbe
+{
+public:
+    static FloatingProbeData *probeData(FloatingProbe *probe)
+    {
+        return probe->*(&FloatingProbeAccess::m_pFloatingProbeData);
+    }
+};
+
+class FloatingProbeDataAccess : public FloatingProbeData
+{
+public:
+    static const std::vector<float> &samples(const FloatingProbeData *data)
+    {
+        return *(data->*(&FloatingProbeDataAccess::m_data));
+    }
+};
+
+static void printError(const QString &message)
+{
+    fprintf(stderr, "%s\n", qPrintable(message));
+}
+
+static void processPendingEvents()
+{
+    for (int i = 0; i < 4; ++i)
+        QCoreApplication::processEvents();
+}
+
+int main(int argc, char **argv)
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication app(argc, argv);
+    QCoreApplication::setApplicationName("ktechlab");
+    KLocalizedString::setApplicationDomain("ktechlab");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(i18n("Records the golden traces of the simulation regression test with the baseline simulator"));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("circuits"), i18n("The circuits to simulate."), i18n("circuit..."));
+
+    QCommandLineOption goldenOption(QStringList() << "g" << "golden", i18n("Directory to write the golden traces to, one <circuit>.csv file per circuit."), i18n("directory"));
+    QCommandLineOption timeOption(QStringList() << "t" << "time", i18n("Simulated time to run each circuit for, in seconds (default 0.1)."), i18n("seconds"), "0.1");
+    QCommandLineOption intervalOption("interval", i18n("Simulated time between the points the traces are recorded at, in seconds (default 0.0005)."), i18n("seconds"), "0.0005");
+    parser.addOption(goldenOption);
+    parser.addOption(timeOption);
+    parser.addOption(intervalOption);
+
+    parser.process(app);
+
+    const QStringList circuits = parser.positionalArguments();
+    if (circuits.isEmpty() || !parser.isSet(goldenOption))
+        parser.showHelp(1);
+
+    // Simulator::step does this many linear steps each time it is called
+    const long long stepsPerCall = LINEAR_UPDATE_RATE / SIMULATOR_STEP_INTERVAL_MS;
+
+    const QDir goldenDir(parser.value(goldenOption));
+    const double interval = parser.value(intervalOption).toDouble();
+    const long long steps = qRound64(parser.value(timeOption).toDouble() * LINEAR_UPDATE_RATE);
+    const uint64_t intervalTime = qRound64(interval * LOGIC_UPDATE_RATE);
+    if (steps <= 0 || steps % stepsPerCall != 0 || intervalTime == 0) {
+        printError(i18n("Invalid time or interval; the time must be a multiple of %1 s", double(stepsPerCall) / LINEAR_UPDATE_RATE));
+        return 1;
+    }
+    const int points = int(steps * LOGIC_UPDATE_PER_STEP / intervalTime) + 1;
+
+    if (!goldenDir.exists() && !QDir().mkpath(goldenDir.path())) {
+        printError(i18n("Could not create %1", goldenDir.path()));
+        return 1;
+    }
+
+    KTechlab *ktechlab = new KTechlab();
+    Simulator *simulator = Simulator::self();
+    simulator->slotSetSimulating(false);
+
+    int failed = 0;
+
+    for (QStringList::const_iterator it = circuits.begin(); it != circuits.end(); ++it) {
+        const QUrl url = QUrl::fromUserInput(*it, QDir::currentPath(), QUrl::AssumeLocalFile);
+        const QString name = QFileInfo(url.toLocalFile()).completeBaseName();
+
+        Document *document = DocManager::self()->openURL(url, nullptr);
+        if (!document || document->type() != Document::dt_circuit) {
+            printError(i18n("Could not load %1", url.toDisplayString()));
+            DocManager::self()->closeAll();
+            failed++;
+            continue;
+        }
+        processPendingEvents();
+        // Opening the document may have started the simulation
+        simulator->slotSetSimulating(false);
+
+        QMap<QString, FloatingProbeData *> probeMap;
+        const ItemList items = static_cast<CircuitDocument *>(document)->itemList();
+        for (Item *item : items) {
+            FloatingProbe *probe = dynamic_cast<FloatingProbe *>(item);
+            if (probe && FloatingProbeAccess::probeData(probe))
+                probeMap[probe->id()] = FloatingProbeAccess::probeData(probe);
+        }
+
+        const uint64_t begin = simulator->time();
+
+        // The step timer is started but never gets to fire, as the event
+        // loop does not run until the simulation is stopped again
+        QElapsedTimer timer;
+        timer.start();
+        simulator->slotSetSimulating(true);
+        for (long long done = 0; done < steps; done += stepsPerCall)
+            QMetaObject::invokeMethod(simulator, "step", Qt::DirectConnection);
+        simulator->slotSetSimulating(false);
+        const qint64 elapsedNs = timer.nsecsElapsed();
+        const double stepsPerS = (elapsedNs > 0) ? steps * 1e9 / elapsedNs : 0.;
+
+        QFile file(goldenDir.filePath(name + ".csv"));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            printError(i18n("Could not write %1", file.fileName()));
+            DocManager::self()->closeAll();
+            failed++;
+            continue;
+        }
+
+        QTextStream stream(&file);
+        stream.setRealNumberPrecision(12);
+        stream << "# steps_per_s=" << qRound64(stepsPerS) << '\n';
+        stream << "probe,time_s,value\n";
+        for (QMap<QString, FloatingProbeData *>::const_iterator probe = probeMap.constBegin(); probe != probeMap.constEnd(); ++probe) {
+            // Sample n was taken at resetTime() + n linear steps; each point
+            // of the grid gets the last sample at or before it, as in
+            // regression_simulator
+            const std::vector<float> &samples = FloatingProbeDataAccess::samples(probe.value());
+            const uint64_t resetTime = probe.value()->resetTime();
+            for (int i = 0; i < points; ++i) {
+                const uint64_t time = begin + i * intervalTime;
+                double value = 0.;
+                if (!samples.empty() && time >= resetTime)
+                    value = samples[std::min<uint64_t>((time - resetTime) / LOGIC_UPDATE_PER_STEP, samples.size() - 1)];
+                stream << probe.key() << ',' << i * interval << ',' << value << '\n';
+            }
+        }
+        file.close();
+        printf("%s: %d probes recorded\n", qPrintable(name), probeMap.size());
+
+        DocManager::self()->closeAll();
+        processPendingEvents();
+    }
+
+    delete ktechlab;
+
+    if (failed > 0)
+        printError(i18n("%1 of %2 circuits could not be loaded or written", failed, circuits.size()));
+    return (failed > 0) ? 1 : 0;
+}
@@ -0,0 +1,42 @@
+#!/bin/bash
+# Records the golden traces of the simulation regression test with the
+# baseline simulator, and then the tolerance of each circuit from how far the
+# current simulator is from them.
+#
+# usage: record-baseline-goldens.sh <baseline commit> <golden directory>
+#            <regression_simulator> <circuit>...
+#
+# The baseline commit is checked out in a temporary worktree, where
+# baseline_recorder is built against its own sources; nothing of this tree
+# goes into the traces. Commit the golden directory afterwards.
+
+set -e
+
+if [ $# -lt 4 ]; then
+    echo "usage: $0 <baseline commit> <golden directory> <regression_simulator> <circuit>..." >&2
+    exit 1
+fi
+
+BASELINE="$1"
+GOLDEN_DIR="$2"
+REGRESSION_SIMULATOR="$3"
+shift 3
+
+SCRIPTDIR=$(cd "$(dirname "$0")" && pwd)
+SOURCEDIR=$(git -C "$SCRIPTDIR" rev-parse --show-toplevel)
+WORKDIR=$(mktemp -d)
+trap 'git -C "$SOURCEDIR" worktree remove --force "$WORKDIR/baseline" 2>/dev/null; rm -rf "$WORKDIR"' EXIT
+
+git -C "$SOURCEDIR" worktree add --detach "$WORKDIR/baseline" "$BASELINE"
+
+mkdir "$WORKDIR/baseline/tests/baseline_recorder"
+cp "$SCRIPTDIR/baseline_recorder.cpp" "$WORKDIR/baseline/tests/baseline_recorder/"
+cp "$SCRIPTDIR/baseline_recorder.cmake" "$WORKDIR/baseline/tests/baseline_recorder/CMakeLists.txt"
+echo "add_subdirectory(baseline_recorder)" >> "$WORKDIR/baseline/tests/CMakeLists.txt"
+
+cmake -S "$WORKDIR/baseline" -B "$WORKDIR/build" -DBUILD_TESTING=ON -DCMAKE_BUILD_TYPE=Release
+cmake --build "$WORKDIR/build" --target baseline_recorder -j"$(nproc)"
+
+rm -f "$GOLDEN_DIR"/*.csv
+"$WORKDIR/build/tests/baseline_recorder/baseline_recorder" --golden "$GOLDEN_DIR" "$@"
+"$REGRESSION_SIMULATOR" --measure --golden "$GOLDEN_DIR" "$@"
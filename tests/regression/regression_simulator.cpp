@@ -0,0 +1,389 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the KTechLab developers                         *
+ *   ktechlab-devel@kde.org                                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+/*
+ * regression_simulator: simulates each of the circuits given on the command
+ * line for a fixed amount of simulated time, samples the trace of each of
+ * their probes on a regular grid of times, and compares the traces against
+ * golden traces recorded with the baseline simulator (see
+ * record-baseline-goldens.sh). One CSV row is written per circuit, with the
+ * largest difference from the golden traces and the linear steps per second
+ * against those of the baseline.
+ *
+ * Each golden file carries the tolerance of its circuit, which --measure
+ * works out from the differences of this simulator from the baseline and
+ * writes into it when the golden traces are recorded. With --reference, the
+ * circuits are simulated the way they were before the faster solvers and the
+ * adaptive integration (see Circuit::setReferenceMode), to tell whether a
+ * difference comes from those. The exit status is non-zero if a circuit could
+ * not be loaded, has no golden traces, or has a trace further from its golden
+ * trace than the tolerance allows.
+ */
+
+#include "circuit.h"
+#include "circuitdocument.h"
+#include "headless.h"
+#include "oscilloscopedata.h"
+#include "probe.h"
+#include "probedatawriter.h"
+#include "simulator.h"
+
+#include <KLocalizedString>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using Headless::printError;
+using Headless::processPendingEvents;
+using Headless::runSteps;
+
+/**
+Picks out the value of each probe at each time of a regular grid, i.e. that
+of the last sample at or before the time.
+*/
+class GridSampler : public ProbeDataWriter
+{
+public:
+    GridSampler(uint64_t begin, uint64_t interval, int points)
+        : ProbeDataWriter(nullptr)
+        , m_begin(begin)
+        , m_interval(interval)
+        , m_points(points)
+        , m_next(0)
+        , m_last(0.)
+    {
+    }
+
+    void writeSample(uint64_t time, double value) override
+    {
+        // The samples come in time order, so the grid is filled up to this one
+        while (m_next < m_points && m_begin + m_next * m_interval < time) {
+            m_traces.back().push_back(m_last);
+            m_next++;
+        }
+        m_last = value;
+    }
+
+    /**
+     * @return the values on the grid of each probe written, in order
+     */
+    const std::vector<std::vector<double>> &traces() const
+    {
+        return m_traces;
+    }
+
+protected:
+    void beginProbe(const ProbeData *probe) override
+    {
+        Q_UNUSED(probe);
+        m_traces.emplace_back();
+        m_traces.back().reserve(m_points);
+        m_next = 0;
+        m_last = 0.;
+    }
+
+    void endProbe() override
+    {
+        for (; m_next < m_points; ++m_next)
+            m_traces.back().push_back(m_last);
+    }
+
+    const uint64_t m_begin;
+    const uint64_t m_interval;
+    const int m_points;
+    int m_next; // The grid point to fill next
+    double m_last;
+    std::vector<std::vector<double>> m_traces;
+};
+
+/**
+The golden traces of a circuit: the probe ids, the values of each on the
+grid, the steps per second that the baseline did, and the largest difference
+allowed from them (zero until measured).
+*/
+class GoldenTraces
+{
+public:
+    QStringList probes;
+    std::vector<std::vector<double>> traces;
+    double interval = 0.;
+    double stepsPerS = 0.;
+    double tolerance = 0.;
+};
+
+/**
+ * Writes the traces as lines of the probe id, the time in seconds and the
+ * value, after comment lines with the steps per second and the tolerance.
+ */
+static bool writeGolden(const QString &fileName, const GoldenTraces &golden)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QTextStream stream(&file);
+    stream.setRealNumberPrecision(12);
+    stream << "# steps_per_s=" << qRound64(golden.stepsPerS) << '\n';
+    if (golden.tolerance > 0.)
+        stream << "# tolerance=" << golden.tolerance << '\n';
+    stream << "probe,time_s,value\n";
+    for (int p = 0; p < golden.probes.size(); ++p) {
+        const std::vector<double> &trace = golden.traces[p];
+        for (size_t i = 0; i < trace.size(); ++i)
+            stream << golden.probes[p] << ',' << i * golden.interval << ',' << trace[i] << '\n';
+    }
+    return true;
+}
+
+static bool readGolden(const QString &fileName, GoldenTraces *golden)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    QTextStream stream(&file);
+    while (!stream.atEnd()) {
+        const QString line = stream.readLine();
+        if (line.startsWith("# steps_per_s=")) {
+            golden->stepsPerS = line.section('=', 1).toDouble();
+            continue;
+        }
+        if (line.startsWith("# tolerance=")) {
+            golden->tolerance = line.section('=', 1).toDouble();
+            continue;
+        }
+        if (line.isEmpty() || line.startsWith('#') || line.startsWith("probe,"))
+            continue;
+
+        const QStringList fields = line.split(',');
+        if (fields.size() < 3)
+            return false;
+
+        int p = golden->probes.indexOf(fields[0]);
+        if (p < 0) {
+            p = golden->probes.size();
+            golden->probes << fields[0];
+            golden->traces.emplace_back();
+        }
+        std::vector<double> &trace = golden->traces[p];
+        if (trace.size() == 1)
+            golden->interval = fields[1].toDouble();
+        trace.push_back(fields[2].toDouble());
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    Headless::useOffscreenPlatform();
+
+    QApplication app(argc, argv);
+    QCoreApplication::setApplicationName("ktechlab");
+    KLocalizedString::setApplicationDomain("ktechlab");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(i18n("Checks the probe traces of circuits against golden traces"));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("circuits"), i18n("The circuits to simulate."), i18n("circuit..."));
+
+    QCommandLineOption goldenOption(QStringList() << "g" << "golden", i18n("Directory of the golden traces, one <circuit>.csv file per circuit."), i18n("directory"));
+    QCommandLineOption measureOption("measure", i18n("Write the tolerance of each circuit into its golden traces, from the differences of this run from them, rather than checking against it."));
+    QCommandLineOption referenceOption("reference", i18n("Simulate with the dense solver and fixed step backward Euler integration, as before the faster solvers."));
+    QCommandLineOption timeOption(QStringList() << "t" << "time", i18n("Simulated time to run each circuit for, in seconds (default 0.1)."), i18n("seconds"), "0.1");
+    QCommandLineOption intervalOption("interval", i18n("Simulated time between the points the traces are compared at, in seconds (default 0.0005)."), i18n("seconds"), "0.0005");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", i18n("File to write the results to, instead of standard output."), i18n("file"));
+    parser.addOption(goldenOption);
+    parser.addOption(measureOption);
+    parser.addOption(referenceOption);
+    parser.addOption(timeOption);
+    parser.addOption(intervalOption);
+    parser.addOption(outputOption);
+
+    parser.process(app);
+
+    const QStringList circuits = parser.positionalArguments();
+    if (circuits.isEmpty() || !parser.isSet(goldenOption))
+        parser.showHelp(1);
+
+    const QDir goldenDir(parser.value(goldenOption));
+    const bool measure = parser.isSet(measureOption);
+    const double interval = parser.value(intervalOption).toDouble();
+    const long long steps = qRound64(parser.value(timeOption).toDouble() * LINEAR_UPDATE_RATE);
+    const uint64_t intervalTime = qRound64(interval * LOGIC_UPDATE_RATE);
+    if (steps <= 0 || intervalTime == 0) {
+        printError(i18n("Invalid time or interval"));
+        return 1;
+    }
+    const int points = int(steps * LOGIC_UPDATE_PER_STEP / intervalTime) + 1;
+
+    QFile outputFile;
+    if (parser.isSet(outputOption)) {
+        outputFile.setFileName(parser.value(outputOption));
+        if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            printError(i18n("Could not open '%1' for writing", outputFile.fileName()));
+            return 1;
+        }
+    } else {
+        outputFile.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+    }
+    QTextStream output(&outputFile);
+
+    // Before any circuit is built, as the matrices pick their solver then
+    Circuit::setReferenceMode(parser.isSet(referenceOption));
+
+    HeadlessSession *session = new HeadlessSession();
+    Simulator *simulator = session->simulator();
+
+    output << "circuit,status,probes,max_error,worst_probe,worst_time_s,steps_per_s,golden_steps_per_s,throughput_change_percent\n";
+
+    int failed = 0;
+    int mismatched = 0;
+
+    for (QStringList::const_iterator it = circuits.begin(); it != circuits.end(); ++it) {
+        const QUrl url = QUrl::fromUserInput(*it, QDir::currentPath(), QUrl::AssumeLocalFile);
+        const QString name = QFileInfo(url.toLocalFile()).completeBaseName();
+
+        CircuitDocument *document = new CircuitDocument(url.fileName());
+        if (!document->openURL(url)) {
+            printError(i18n("Could not load %1", url.toDisplayString()));
+            output << name << ",error\n";
+            delete document;
+            failed++;
+            continue;
+        }
+        processPendingEvents();
+
+        // The probes, in the order of their ids so that the traces are in
+        // the same order from one run to the next
+        QMap<QString, ProbeData *> probeMap;
+        const ItemList items = document->itemList();
+        for (Item *item : items) {
+            Probe *probe = dynamic_cast<Probe *>(item);
+            if (probe && probe->probeData())
+                probeMap[probe->id()] = probe->probeData();
+        }
+
+        const uint64_t begin = simulator->time();
+
+        QElapsedTimer timer;
+        timer.start();
+        runSteps(simulator, steps);
+        const qint64 elapsedNs = timer.nsecsElapsed();
+        const double stepsPerS = (elapsedNs > 0) ? steps * 1e9 / elapsedNs : 0.;
+
+        const QList<ProbeData *> probes = probeMap.values();
+        for (ProbeData *probe : probes)
+            probe->collectData();
+
+        GridSampler sampler(begin, intervalTime, points);
+        sampler.write(probes, begin, simulator->time());
+
+        GoldenTraces run;
+        run.probes = probeMap.keys();
+        run.traces = sampler.traces();
+
+        const QString goldenFile = goldenDir.filePath(name + ".csv");
+        QString status;
+        double maxError = 0.;
+        QString worstProbe;
+        double worstTime = 0.;
+        GoldenTraces golden;
+
+        if (!QFile::exists(goldenFile)) {
+            printError(i18n("%1: no golden traces, record them with record-baseline-goldens.sh", name));
+            status = "missing";
+            mismatched++;
+        } else if (!readGolden(goldenFile, &golden) || golden.probes != run.probes || std::abs(golden.interval - interval) > 1e-12) {
+            printError(i18n("%1: the golden traces are not of the same probes and interval", name));
+            status = "fail";
+            mismatched++;
+        } else {
+            // Whether the traces are of the same length and without NaNs
+            bool comparable = true;
+            double peak = 0.;
+            for (int p = 0; p < run.probes.size(); ++p) {
+                const std::vector<double> &trace = run.traces[p];
+                const std::vector<double> &expected = golden.traces[p];
+                const size_t count = std::min(trace.size(), expected.size());
+                if (trace.size() != expected.size())
+                    comparable = false;
+
+                for (size_t i = 0; i < count; ++i) {
+                    const double error = std::abs(trace[i] - expected[i]);
+                    if (!std::isfinite(error))
+                        comparable = false;
+                    else if (error > maxError) {
+                        maxError = error;
+                        worstProbe = run.probes[p];
+                        worstTime = i * interval;
+                    }
+                    peak = std::max(peak, std::abs(expected[i]));
+                }
+            }
+
+            if (measure) {
+                // Twice the difference from the baseline, so that rounding
+                // that differs between compilers and processors passes but a
+                // change that moves the traces further does not; and no less
+                // than the rounding of the baseline's single precision probe
+                // data
+                golden.tolerance = std::max({2. * maxError, 1e-6 * peak, 1e-12});
+                if (!comparable) {
+                    printError(i18n("%1: the traces cannot be compared with the golden traces", name));
+                    status = "fail";
+                    mismatched++;
+                } else if (!writeGolden(goldenFile, golden)) {
+                    printError(i18n("Could not write %1", goldenFile));
+                    status = "error";
+                    failed++;
+                } else
+                    status = "measured";
+            } else if (golden.tolerance <= 0.) {
+                printError(i18n("%1: the golden traces have no tolerance, record them with record-baseline-goldens.sh", name));
+                status = "fail";
+                mismatched++;
+            } else if (!comparable || maxError > golden.tolerance) {
+                printError(i18n("%1: probe %2 differs from the golden trace by %3 at %4 s, more than %5", name, worstProbe, maxError, worstTime, golden.tolerance));
+                status = "fail";
+                mismatched++;
+            } else
+                status = "pass";
+        }
+
+        output << name << ',' << status << ',' << run.probes.size() << ',' << maxError << ',' << worstProbe << ',' << worstTime << ',' << qRound64(stepsPerS) << ',';
+        if (golden.stepsPerS > 0.)
+            output << qRound64(golden.stepsPerS) << ',' << (stepsPerS / golden.stepsPerS - 1.) * 100.;
+        else
+            output << ',';
+        output << '\n';
+        output.flush();
+
+        delete document;
+        processPendingEvents();
+    }
+
+    delete session;
+
+    if (failed > 0)
+        printError(i18n("%1 of %2 circuits could not be loaded or written", failed, circuits.size()));
+    if (mismatched > 0)
+        printError(i18n("%1 of %2 circuits do not match their golden traces", mismatched, circuits.size()));
+    return (failed > 0 || mismatched > 0) ? 1 : 0;
+}
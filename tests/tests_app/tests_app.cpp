@@ -21,9 +21,22 @@
  */
 
 #include "../src/ktechlab.h"
+#include "canvasmanipulator.h"
+#include "cnitem.h"
 #include "config.h"
+#include "connector.h"
 #include "docmanager.h"
 #include "electronics/circuitdocument.h"
+#include "electronics/components/discretelogic.h"
+#include "electronics/ecnode.h"
+#include "electronics/pin.h"
+#include "eventinfo.h"
+#include "itemdocumentdata.h"
+#include "itemgroup.h"
+#include "itemview.h"
+#include "node.h"
+#include "oscilloscopedata.h"
+#include "simulator.h"
 
 #include <KAboutData>
 #include <KLocalizedString>
@@ -33,9 +46,21 @@
 #include <QTemporaryFile>
 #include <QApplication>
 #include <QCommandLineParser>
+#include <QDir>
 
 #include <ktechlab_version.h>
+#include <ktlconfig.h>
 
+#include <vector>
+
+// The large circuit of the benchmarks: rows of resistors, each wired to the
+// next one in its row
+const int LARGE_CIRCUIT_PARTS = 2000;
+const int LARGE_CIRCUIT_COLUMNS = 50;
+const int DRAG_SELECTION_PARTS = 100;
+
+// More inverters than there are logic updates in a linear step
+const int IDEAL_LOGIC_CHAIN_GATES = LOGIC_UPDATE_PER_STEP + 50;
 
 class KtlTestsAppFixture : public QObject {
     Q_OBJECT
@@ -44,6 +69,107 @@ public:
     QApplication *app;
     KTechlab *ktechlab;
 
+private:
+    QTemporaryFile largeCircuitFile;
+
+    /**
+     * Closes the open documents without asking about saving them.
+     */
+    void closeDocuments() {
+        for (Document *document : DocManager::self()->m_documentList)
+            document->setModified(false);
+        DocManager::self()->closeAll();
+    }
+
+    /**
+     * Opens the large circuit written by initTestCase.
+     */
+    CircuitDocument *openLargeCircuit() {
+        closeDocuments();
+        Document *doc = DocManager::self()->openURL(QUrl::fromLocalFile(largeCircuitFile.fileName()), nullptr);
+        return dynamic_cast<CircuitDocument*>(doc);
+    }
+
+    /**
+     * Builds the large circuit in a new document and saves it, so that the
+     * benchmarks load it like any other file.
+     */
+    bool writeLargeCircuit() {
+        CircuitDocument *circDoc = DocManager::self()->createCircuitDocument();
+        if (!circDoc)
+            return false;
+        {
+            ItemDocumentBulkLoad bulkLoad(circDoc);
+            CNItem *previous = nullptr;
+            for (int i = 0; i < LARGE_CIRCUIT_PARTS; ++i) {
+                const int column = i % LARGE_CIRCUIT_COLUMNS;
+                const int row = i / LARGE_CIRCUIT_COLUMNS;
+                CNItem *resistor = dynamic_cast<CNItem*>(circDoc->addItem("ec/resistor", QPoint(64 + 80 * column, 64 + 48 * row), true));
+                if (!resistor)
+                    return false;
+                if (previous && column != 0)
+                    circDoc->createConnector(previous->childNode("p1"), resistor->childNode("n1"));
+                previous = resistor;
+            }
+        }
+        if (!largeCircuitFile.open())
+            return false;
+        largeCircuitFile.close();
+        ItemDocumentData data(circDoc->type());
+        data.saveDocumentState(circDoc);
+        const bool saved = data.saveData(QUrl::fromLocalFile(largeCircuitFile.fileName()));
+        closeDocuments();
+        return saved;
+    }
+
+    /**
+     * Adds the given number of data points to the probe data and to points,
+     * a few time steps apart, or now and again in a run of a few hundred at
+     * the same time (so that runs cross the blocks of the time index).
+     */
+    static void addLogicDataPoints(LogicProbeData &data, std::vector<LogicDataPoint> &points, int count, unsigned &seed) {
+        auto random = [&seed]() {
+            seed = seed * 1103515245u + 12345u;
+            return (seed >> 16) & 0x7fff;
+        };
+        uint64_t time = points.empty() ? 0 : uint64_t(points.back().time);
+        int repeats = 0;
+        for (int i = 0; i < count; ++i) {
+            if (repeats > 0)
+                --repeats;
+            else if (random() % 64 == 0)
+                repeats = 300 + random() % 200;
+            else
+                time += random() % 4;
+            points.push_back(LogicDataPoint(random() & 1, time));
+            data.addDataPoint(points.back());
+        }
+        data.collectData();
+    }
+
+    /**
+     * Checks that the data points kept are the ones added at the same
+     * index, and that findPos gives what a linear scan of them does for
+     * every time from just before the oldest to just after the newest.
+     */
+    static void verifyFindPos(const LogicProbeData &data, const std::vector<LogicDataPoint> &points) {
+        const uint64_t begin = data.beginIndex();
+        const uint64_t end = data.endIndex();
+        QCOMPARE( end, uint64_t(points.size()) );
+        QVERIFY( begin < end );
+        for (uint64_t at = begin; at < end; ++at)
+            QCOMPARE( uint64_t(data.dataPoint(at).time), uint64_t(points[at].time) );
+
+        const uint64_t first = data.dataPoint(begin).time;
+        const uint64_t last = points.back().time;
+        uint64_t expected = begin;
+        for (uint64_t time = (first > 2) ? first - 2 : 0; time <= last + 2; ++time) {
+            while (expected + 1 < end && data.dataPoint(expected + 1).time <= time)
+                ++expected;
+            QCOMPARE( data.findPos(time), expected );
+        }
+    }
+
 private slots:
     void initTestCase() {
         int argc = 1;
@@ -65,6 +191,8 @@ private slots:
 
         ktechlab = new KTechlab;
 
+        largeCircuitFile.setFileTemplate(QDir::tempPath() + "/tests_app_large_XXXXXX.circuit");
+        QVERIFY( writeLargeCircuit() );
     }
     void cleanupTestCase() {
         delete ktechlab;
@@ -115,6 +243,277 @@ private slots:
         DocManager::self()->closeAll();
         QCOMPARE( DocManager::self()->m_documentList.size(), 0);
     }
+
+    void testBusConnectorWires() {
+        closeDocuments();
+        CircuitDocument *circDoc = DocManager::self()->createCircuitDocument();
+        QVERIFY( circDoc );
+
+        // Two buses joined by one connector, and a third joined part way
+        // along it, through a junction node
+        ECNode *busNodes[3];
+        const QPoint positions[3] = { QPoint(64, 64), QPoint(256, 64), QPoint(160, 200) };
+        for (int i = 0; i < 3; ++i) {
+            CNItem *bus = dynamic_cast<CNItem*>(circDoc->addItem("ec/bus", positions[i], true));
+            QVERIFY( bus );
+            busNodes[i] = dynamic_cast<ECNode*>(bus->childNode("n1"));
+            QVERIFY( busNodes[i] );
+        }
+        const unsigned busSize = busNodes[0]->numPins();
+        QVERIFY( busSize > 1 );
+
+        Connector *connector = circDoc->createConnector(busNodes[0], busNodes[1]);
+        QVERIFY( connector );
+        QCOMPARE( connector->numWires(), busSize );
+        const QPointList points = connector->connectorPoints();
+        QVERIFY( !points.isEmpty() );
+        Connector *branch = circDoc->createConnector(busNodes[2], connector, points.at(points.size() / 2));
+        QVERIFY( branch );
+        QCOMPARE( branch->numWires(), busSize );
+
+        // Each bit of a bus has the wire inside its splitter and the one
+        // wire of the bus connector
+        for (ECNode *node : busNodes) {
+            for (unsigned i = 0; i < busSize; ++i) {
+                int wires = 0;
+                const WireList wireList = node->pin(i)->inputWireList() + node->pin(i)->outputWireList();
+                for (Wire *wire : wireList) {
+                    if (wire)
+                        ++wires;
+                }
+                QCOMPARE( wires, 2 );
+            }
+        }
+
+        closeDocuments();
+    }
+
+    void testIdealLogicChain_data() {
+        QTest::addColumn<bool>("ideal");
+
+        QTest::newRow("propagation delays") << false;
+        QTest::newRow("ideal logic") << true;
+    }
+
+    void testIdealLogicChain() {
+        QFETCH(bool, ideal);
+
+        KConfigSkeletonItem *idealItem = KTLConfig::self()->findItem("IdealLogic");
+        QVERIFY( idealItem );
+        const QVariant oldIdeal = idealItem->property();
+        idealItem->setProperty(ideal);
+        Simulator::self()->slotUpdateConfiguration();
+
+        closeDocuments();
+        Simulator::self()->slotSetSimulating(false);
+        CircuitDocument *circDoc = DocManager::self()->createCircuitDocument();
+        QVERIFY( circDoc );
+        Simulator::self()->slotSetSimulating(false);
+
+        // A logic input driving a chain of inverters as they come from the
+        // library, longer than the logic updates in a linear step; with an
+        // even number of them, the end follows the input
+        ECLogicInput *input = dynamic_cast<ECLogicInput*>(circDoc->addItem("ec/logic_input", QPoint(32, 64), true));
+        QVERIFY( input );
+        CNItem *previous = input;
+        for (int i = 0; i < IDEAL_LOGIC_CHAIN_GATES; ++i) {
+            CNItem *inverter = dynamic_cast<CNItem*>(circDoc->addItem("ec/not", QPoint(96 + 48 * (i % 40), 64 + 48 * (i / 40)), true));
+            QVERIFY( inverter );
+            QCOMPARE( inverter->dataDouble("delay"), 1. / LOGIC_UPDATE_RATE );
+            QVERIFY( circDoc->createConnector(previous->childNode("p1"), inverter->childNode("n1")) );
+            previous = inverter;
+        }
+        CNItem *output = dynamic_cast<CNItem*>(circDoc->addItem("ec/logic_output", QPoint(96, 64 + 48 * (IDEAL_LOGIC_CHAIN_GATES / 40 + 1)), true));
+        QVERIFY( output );
+        QVERIFY( circDoc->createConnector(previous->childNode("p1"), output->childNode("n1")) );
+        ECNode *end = dynamic_cast<ECNode*>(previous->childNode("p1"));
+        QVERIFY( end );
+
+        circDoc->assignPendingCircuits();
+        Simulator::self()->runSteps(10);
+        QCOMPARE( end->pin(0)->voltage(), 0. );
+
+        // With ideal logic, the change has reached the end of the chain by
+        // the end of the linear step it was made in; with the delays it is
+        // still on its way
+        input->buttonStateChanged("button", true);
+        Simulator::self()->runSteps(1);
+        QCOMPARE( end->pin(0)->voltage() > 0., ideal );
+        Simulator::self()->runSteps(1);
+        QVERIFY( end->pin(0)->voltage() > 0. );
+
+        closeDocuments();
+        idealItem->setProperty(oldIdeal);
+        Simulator::self()->slotUpdateConfiguration();
+    }
+
+    void testLogicProbeFindPos_data() {
+        QTest::addColumn<quint64>("depth");
+        QTest::addColumn<bool>("capture");
+
+        QTest::newRow("unbounded") << quint64(0) << false;
+        QTest::newRow("depth 1000") << quint64(1000) << false;
+        QTest::newRow("depth 4096") << quint64(4096) << false;
+        QTest::newRow("capture") << quint64(0) << true;
+    }
+
+    void testLogicProbeFindPos() {
+        QFETCH(quint64, depth);
+        QFETCH(bool, capture);
+
+        KConfigSkeletonItem *captureItem = KTLConfig::self()->findItem("CaptureProbesToDisk");
+        QVERIFY( captureItem );
+        const QVariant oldCapture = captureItem->property();
+        captureItem->setProperty(capture);
+        LogicProbeData data(-1);
+        captureItem->setProperty(oldCapture);
+        if (capture && !data.isCapturing())
+            QSKIP("Could not create a file to capture to");
+        QCOMPARE( data.isCapturing(), capture );
+
+        if (depth)
+            data.setDepth(depth);
+
+        std::vector<LogicDataPoint> points;
+        unsigned seed = 1;
+        addLogicDataPoints(data, points, 10000, seed);
+        verifyFindPos(data, points);
+        if (QTest::currentTestFailed())
+            return;
+
+        // The data kept when the depth is changed are found the same
+        if (depth) {
+            data.setDepth(depth / 3);
+            verifyFindPos(data, points);
+            if (QTest::currentTestFailed())
+                return;
+        }
+        addLogicDataPoints(data, points, 5000, seed);
+        verifyFindPos(data, points);
+        if (QTest::currentTestFailed())
+            return;
+        if (depth) {
+            data.setDepth(depth * 2);
+            verifyFindPos(data, points);
+            if (QTest::currentTestFailed())
+                return;
+        }
+        addLogicDataPoints(data, points, 5000, seed);
+        verifyFindPos(data, points);
+        if (QTest::currentTestFailed())
+            return;
+
+        // And so are those left after dropping the older ones
+        data.discardBefore(points[points.size() - 300].time);
+        QVERIFY( data.beginIndex() > points.size() - 600 );
+        verifyFindPos(data, points);
+        if (QTest::currentTestFailed())
+            return;
+        addLogicDataPoints(data, points, 1000, seed);
+        verifyFindPos(data, points);
+    }
+
+    // The benchmarks below time the interactions that get slow with big
+    // circuits. Run with e.g. "-o results.csv,csv" to keep the results for
+    // comparing between builds ("make benchmark-gui" does this).
+
+    void benchmarkLoadLargeCircuit() {
+        closeDocuments();
+        CircuitDocument *circDoc = nullptr;
+        QBENCHMARK_ONCE {
+            circDoc = openLargeCircuit();
+            QVERIFY( circDoc );
+            circDoc->processItemDocumentEvents();
+        }
+        QCOMPARE( circDoc->m_itemList.size(), LARGE_CIRCUIT_PARTS );
+        closeDocuments();
+    }
+
+    void benchmarkDragSelection() {
+        CircuitDocument *circDoc = openLargeCircuit();
+        QVERIFY( circDoc );
+        circDoc->processItemDocumentEvents();
+
+        // The first rows of the circuit, dragged the way the mouse would
+        // through the item move manipulator
+        circDoc->unselectAll();
+        const ItemList items = circDoc->itemList();
+        Item *dragged = nullptr;
+        for (Item *item : items) {
+            CNItem *cnItem = dynamic_cast<CNItem*>(item);
+            if (!cnItem || cnItem->y() >= 64 + 48 * (DRAG_SELECTION_PARTS / LARGE_CIRCUIT_COLUMNS))
+                continue;
+            circDoc->select(cnItem);
+            if (!dragged)
+                dragged = cnItem;
+        }
+        QVERIFY( dragged );
+        QCOMPARE( circDoc->selectList()->items().size(), DRAG_SELECTION_PARTS );
+
+        QBENCHMARK {
+            EventInfo eventInfo;
+            eventInfo.pos = QPoint(int(dragged->x()), int(dragged->y()));
+            eventInfo.qcanvasItemClickedOn = dragged;
+            circDoc->m_cmManager->mousePressEvent(eventInfo);
+            for (int i = 0; i < 20; ++i) {
+                eventInfo.pos += QPoint(8, 8);
+                circDoc->m_cmManager->mouseMoveEvent(eventInfo);
+            }
+            circDoc->m_cmManager->mouseReleaseEvent(eventInfo);
+            circDoc->processItemDocumentEvents();
+        }
+        closeDocuments();
+    }
+
+    void benchmarkRerouteAll() {
+        CircuitDocument *circDoc = openLargeCircuit();
+        QVERIFY( circDoc );
+        circDoc->processItemDocumentEvents();
+        QVERIFY( !circDoc->connectorList().isEmpty() );
+
+        QBENCHMARK {
+            circDoc->rerouteConnectors(circDoc->connectorList());
+        }
+        closeDocuments();
+    }
+
+    void benchmarkZoom() {
+        CircuitDocument *circDoc = openLargeCircuit();
+        QVERIFY( circDoc );
+        circDoc->processItemDocumentEvents();
+        ItemView *itemView = dynamic_cast<ItemView*>(circDoc->activeView());
+        QVERIFY( itemView );
+
+        // Zoom in and out again, painting the view at each level
+        QBENCHMARK {
+            itemView->zoomIn();
+            circDoc->processItemDocumentEvents();
+            itemView->cvbEditor()->viewport()->grab();
+            itemView->zoomOut();
+            circDoc->processItemDocumentEvents();
+            itemView->cvbEditor()->viewport()->grab();
+        }
+        closeDocuments();
+    }
+
+    void benchmarkUndoLargePaste() {
+        CircuitDocument *circDoc = openLargeCircuit();
+        QVERIFY( circDoc );
+        circDoc->processItemDocumentEvents();
+
+        circDoc->selectAll();
+        circDoc->copy();
+        circDoc->paste();
+        circDoc->processItemDocumentEvents();
+        QCOMPARE( circDoc->m_itemList.size(), 2 * LARGE_CIRCUIT_PARTS );
+
+        QBENCHMARK_ONCE {
+            circDoc->undo();
+            circDoc->processItemDocumentEvents();
+        }
+        QCOMPARE( circDoc->m_itemList.size(), LARGE_CIRCUIT_PARTS );
+        closeDocuments();
+    }
 };
 
 QTEST_MAIN(KtlTestsAppFixture)